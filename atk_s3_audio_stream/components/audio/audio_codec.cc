@@ -2,6 +2,9 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cassert>
 #include <cstring>
 #include <driver/i2s_common.h>
 
@@ -10,13 +13,140 @@ static const char* TAG = "AudioCodec";
 AudioCodec::AudioCodec() {}
 AudioCodec::~AudioCodec() {}
 
-void AudioCodec::OutputData(std::vector<int16_t>& data) {
-    Write(data.data(), data.size());
+// One RX DMA descriptor completed: note how many frames the capture clock has reached and when
+bool IRAM_ATTR AudioCodec::OnRecv(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto* codec = static_cast<AudioCodec*>(user_ctx);
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&codec->rx_lock_);
+    codec->rx_dma_frames_ += event->size / (codec->input_channels_ * sizeof(int16_t));
+    codec->rx_dma_us_ = now;
+    portEXIT_CRITICAL_ISR(&codec->rx_lock_);
+    return false;
+}
+
+// The oldest captured descriptor was discarded; its frames will never reach InputData
+bool IRAM_ATTR AudioCodec::OnRecvQueueOverflow(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto* codec = static_cast<AudioCodec*>(user_ctx);
+    portENTER_CRITICAL_ISR(&codec->rx_lock_);
+    codec->rx_dropped_frames_ += event->size / (codec->input_channels_ * sizeof(int16_t));
+    codec->rx_overflow_++;
+    portEXIT_CRITICAL_ISR(&codec->rx_lock_);
+    return false;
+}
+
+bool IRAM_ATTR AudioCodec::OnSendQueueOverflow(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    static_cast<AudioCodec*>(user_ctx)->tx_underflow_++;
+    return false;
+}
+
+void AudioCodec::OutputData(const std::vector<int16_t>& data) {
+    OutputData(data.data(), (int)data.size());
+}
+
+bool AudioCodec::OutputData(const int16_t* data, int samples) {
+    return OutputData(std::span<const int16_t>(data, samples), pdMS_TO_TICKS(AUDIO_CODEC_WRITE_TIMEOUT_MS)) == samples;
+}
+
+int AudioCodec::OutputData(std::span<const int16_t> data, TickType_t timeout) {
+    if (!out_resampler_) {
+        return Write(data.data(), (int)data.size(), timeout);
+    }
+    // Convert and write a chunk at a time; report how much of the caller's data made it out
+    const size_t frames = data.size() / output_channels_;
+    size_t done = 0;
+    while (done < frames) {
+        size_t n = std::min(frames - done, (size_t)AUDIO_CODEC_RESAMPLE_CHUNK);
+        size_t out = out_resampler_->Process(data.data() + done * output_channels_, n, out_bus_.data());
+        int want = (int)(out * output_channels_);
+        if (want > 0 && Write(out_bus_.data(), want, timeout) < want) break;
+        done += n;
+    }
+    return (int)(done * output_channels_);
+}
+
+void AudioCodec::CreateResamplers() {
+    if (bus_sample_rate_ == 0) bus_sample_rate_ = output_sample_rate_;
+    if (input_sample_rate_ != bus_sample_rate_) {
+        in_resampler_ = std::make_unique<PcmResampler>(bus_sample_rate_, input_sample_rate_, input_channels_);
+        assert(in_resampler_->valid());
+        in_bus_.resize(AUDIO_CODEC_RESAMPLE_CHUNK * input_channels_);
+        in_pending_.reserve(in_resampler_->MaxOutput(AUDIO_CODEC_RESAMPLE_CHUNK) * input_channels_);
+    }
+    if (output_sample_rate_ != bus_sample_rate_) {
+        out_resampler_ = std::make_unique<PcmResampler>(output_sample_rate_, bus_sample_rate_, output_channels_);
+        assert(out_resampler_->valid());
+        out_bus_.resize(out_resampler_->MaxOutput(AUDIO_CODEC_RESAMPLE_CHUNK) * output_channels_);
+    }
 }
 
 bool AudioCodec::InputData(std::vector<int16_t>& data) {
-    int samples = Read(data.data(), data.size());
-    return samples > 0;
+    return InputData(data.data(), (int)data.size());
+}
+
+bool AudioCodec::InputData(int16_t* dest, int samples, int64_t* capture_us) {
+    int got = InputData(std::span<int16_t>(dest, samples), pdMS_TO_TICKS(AUDIO_CODEC_READ_TIMEOUT_MS), capture_us);
+    if (got < samples) {
+        ESP_LOGW(TAG, "Short capture read: %d of %d samples", got, samples);
+        return false;
+    }
+    return true;
+}
+
+int AudioCodec::InputData(std::span<int16_t> dest, TickType_t timeout, int64_t* capture_us) {
+    int64_t end_us = 0;
+    if (!in_resampler_) {
+        const int got = ReadBus(dest.data(), (int)dest.size(), timeout, &end_us);
+        if (capture_us != nullptr && got > 0) {
+            *capture_us = end_us - (int64_t)(got / input_channels_) * 1000000 / input_sample_rate_;
+        }
+        return got;
+    }
+
+    // Resampled: convert bus chunks into in_pending_ and hand out exactly what was asked for
+    size_t got = 0;
+    while (got < dest.size()) {
+        if (in_pending_off_ == in_pending_.size()) {
+            size_t need = (dest.size() - got) / input_channels_;
+            size_t bus_frames = std::min((size_t)AUDIO_CODEC_RESAMPLE_CHUNK,
+                need * (size_t)bus_sample_rate_ / (size_t)input_sample_rate_ + 1);
+            int n = ReadBus(in_bus_.data(), (int)(bus_frames * input_channels_), timeout, &in_pending_end_us_);
+            if (n <= 0) break;
+            in_pending_.resize(in_resampler_->MaxOutput(n / input_channels_) * input_channels_);
+            in_pending_.resize(in_resampler_->Process(in_bus_.data(), n / input_channels_, in_pending_.data()) * input_channels_);
+            in_pending_off_ = 0;
+            continue;
+        }
+        size_t n = std::min(dest.size() - got, in_pending_.size() - in_pending_off_);
+        memcpy(dest.data() + got, in_pending_.data() + in_pending_off_, n * sizeof(int16_t));
+        in_pending_off_ += n;
+        got += n;
+    }
+    if (capture_us != nullptr && got > 0) {
+        // Everything converted so far ends at in_pending_end_us_; this block sits before what is still pending
+        size_t behind = (in_pending_.size() - in_pending_off_ + got) / input_channels_;
+        *capture_us = in_pending_end_us_ - (int64_t)behind * 1000000 / input_sample_rate_;
+    }
+    return (int)got;
+}
+
+// Raw bus read; end_us receives the capture time just past the last frame read
+int AudioCodec::ReadBus(int16_t* dest, int samples, TickType_t timeout, int64_t* end_us) {
+    const int got = Read(dest, samples, timeout);
+    const int frames = got / input_channels_;
+    portENTER_CRITICAL(&rx_lock_);
+    rx_read_frames_ += frames;
+    // Frames still queued behind the newest completed descriptor put this block that far back in time
+    int64_t behind = (int64_t)(rx_dma_frames_ - rx_dropped_frames_ - rx_read_frames_);
+    if (behind < 0) {
+        // Read ahead of the counted DMA (e.g. data from before a reconfigure): rebase on the newest descriptor
+        rx_read_frames_ = rx_dma_frames_ - rx_dropped_frames_;
+        behind = 0;
+    }
+    int64_t dma_us = rx_dma_us_;
+    portEXIT_CRITICAL(&rx_lock_);
+
+    *end_us = dma_us - behind * 1000000 / bus_sample_rate_;
+    return got;
 }
 
 void AudioCodec::Start() {
@@ -27,6 +157,19 @@ void AudioCodec::Start() {
         output_volume_ = 10;
     }
 
+    // Callbacks can only be registered while the channels are still disabled
+    if (tx_handle_ != nullptr) {
+        i2s_event_callbacks_t cbs = {};
+        cbs.on_send_q_ovf = OnSendQueueOverflow;
+        ESP_ERROR_CHECK(i2s_channel_register_event_callback(tx_handle_, &cbs, this));
+    }
+    if (rx_handle_ != nullptr) {
+        i2s_event_callbacks_t cbs = {};
+        cbs.on_recv = OnRecv;
+        cbs.on_recv_q_ovf = OnRecvQueueOverflow;
+        ESP_ERROR_CHECK(i2s_channel_register_event_callback(rx_handle_, &cbs, this));
+    }
+
     if (tx_handle_ != nullptr) {
         ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
     }
@@ -48,6 +191,12 @@ void AudioCodec::SetOutputVolume(int volume) {
 
 void AudioCodec::EnableInput(bool enable) {
     if (enable == input_enabled_) return;
+    if (enable) {
+        // Opening the input reconfigures the channel and empties its queue: nothing captured is pending
+        portENTER_CRITICAL(&rx_lock_);
+        rx_read_frames_ = rx_dma_frames_ - rx_dropped_frames_;
+        portEXIT_CRITICAL(&rx_lock_);
+    }
     input_enabled_ = enable;
     ESP_LOGI(TAG, "Set input enable to %s", enable ? "true" : "false");
 }
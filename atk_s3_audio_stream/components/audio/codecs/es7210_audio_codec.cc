@@ -0,0 +1,267 @@
+#include "es7210_audio_codec.h"
+#include "shared_i2c.h"
+
+#include <esp_log.h>
+#include <driver/i2s_tdm.h>
+#include <algorithm>
+
+static const char* TAG = "Es7210AudioCodec";
+
+Es7210AudioCodec::Es7210AudioCodec(void* i2c_master_handle, i2c_port_t i2c_port, int input_sample_rate, int output_sample_rate,
+    gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
+    gpio_num_t pa_pin, uint8_t es8311_addr, uint8_t es7210_addr, const AudioDmaProfile& dma) {
+    duplex_ = true;
+    input_reference_ = false;
+    input_channels_ = ES7210_AUDIO_CODEC_SLOTS;
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+    pa_pin_ = pa_pin;
+    // Both directions share BCLK/WS, so as with the ES8388 the bus runs at the higher rate
+    bus_sample_rate_ = std::max(input_sample_rate, output_sample_rate);
+    CreateResamplers();
+    CreateDuplexChannels(mclk, bclk, ws, dout, din, dma);
+
+    audio_codec_i2s_cfg_t i2s_cfg = {
+        .port = I2S_NUM_0,
+        .rx_handle = rx_handle_,
+        .tx_handle = tx_handle_,
+    };
+    data_if_ = audio_codec_new_i2s_data(&i2s_cfg);
+    assert(data_if_ != NULL);
+
+    audio_codec_i2c_cfg_t i2c_cfg = {
+        .port = i2c_port,
+        .addr = es8311_addr,
+        .bus_handle = i2c_master_handle,
+    };
+    out_ctrl_if_ = audio_codec_new_i2c_ctrl(&i2c_cfg);
+    assert(out_ctrl_if_ != NULL);
+
+    gpio_if_ = audio_codec_new_gpio();
+    assert(gpio_if_ != NULL);
+
+    es8311_codec_cfg_t es8311_cfg = {};
+    es8311_cfg.ctrl_if = out_ctrl_if_;
+    es8311_cfg.gpio_if = gpio_if_;
+    es8311_cfg.codec_mode = ESP_CODEC_DEV_WORK_MODE_DAC;
+    es8311_cfg.pa_pin = pa_pin;
+    es8311_cfg.pa_reverted = false;
+    es8311_cfg.master_mode = false;
+    es8311_cfg.use_mclk = true;
+    es8311_cfg.hw_gain.pa_voltage = 5.0;
+    es8311_cfg.hw_gain.codec_dac_voltage = 3.3;
+    out_codec_if_ = es8311_codec_new(&es8311_cfg);
+    assert(out_codec_if_ != NULL);
+
+    esp_codec_dev_cfg_t outdev_cfg = {
+        .dev_type = ESP_CODEC_DEV_TYPE_OUT,
+        .codec_if = out_codec_if_,
+        .data_if = data_if_,
+    };
+    output_dev_ = esp_codec_dev_new(&outdev_cfg);
+    assert(output_dev_ != NULL);
+
+    i2c_cfg.addr = es7210_addr;
+    in_ctrl_if_ = audio_codec_new_i2c_ctrl(&i2c_cfg);
+    assert(in_ctrl_if_ != NULL);
+
+    // Three or more selected mics switch the ES7210 to TDM output, one slot per mic
+    es7210_codec_cfg_t es7210_cfg = {};
+    es7210_cfg.ctrl_if = in_ctrl_if_;
+    es7210_cfg.mic_selected = ES7210_SEL_MIC1 | ES7210_SEL_MIC2 | ES7210_SEL_MIC3 | ES7210_SEL_MIC4;
+    in_codec_if_ = es7210_codec_new(&es7210_cfg);
+    assert(in_codec_if_ != NULL);
+
+    esp_codec_dev_cfg_t indev_cfg = {
+        .dev_type = ESP_CODEC_DEV_TYPE_IN,
+        .codec_if = in_codec_if_,
+        .data_if = data_if_,
+    };
+    input_dev_ = esp_codec_dev_new(&indev_cfg);
+    assert(input_dev_ != NULL);
+    esp_codec_set_disable_when_closed(output_dev_, false);
+    esp_codec_set_disable_when_closed(input_dev_, false);
+    ESP_LOGI(TAG, "Es7210AudioCodec initialized");
+}
+
+Es7210AudioCodec::~Es7210AudioCodec() {
+    ESP_ERROR_CHECK(esp_codec_dev_close(output_dev_));
+    esp_codec_dev_delete(output_dev_);
+    ESP_ERROR_CHECK(esp_codec_dev_close(input_dev_));
+    esp_codec_dev_delete(input_dev_);
+
+    audio_codec_delete_codec_if(in_codec_if_);
+    audio_codec_delete_ctrl_if(in_ctrl_if_);
+    audio_codec_delete_codec_if(out_codec_if_);
+    audio_codec_delete_ctrl_if(out_ctrl_if_);
+    audio_codec_delete_gpio_if(gpio_if_);
+    audio_codec_delete_data_if(data_if_);
+}
+
+// TX stays a standard (Philips) mono channel on the left slot for the ES8311; RX is TDM with all four
+// ES7210 slots, the same mask esp_codec_dev_open() applies for a four-channel input device.
+void Es7210AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
+    const AudioDmaProfile& dma){
+    i2s_chan_config_t chan_cfg = {
+        .id = I2S_NUM_0,
+        .role = I2S_ROLE_MASTER,
+        .dma_desc_num = dma.desc_num,
+        .dma_frame_num = dma.frame_num,
+        .auto_clear_after_cb = true,
+        .auto_clear_before_cb = false,
+        .intr_priority = 0,
+    };
+    ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, &tx_handle_, &rx_handle_));
+
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = {
+            .sample_rate_hz = (uint32_t)bus_sample_rate_,
+            .clk_src = I2S_CLK_SRC_DEFAULT,
+            .ext_clk_freq_hz = 0,
+            .mclk_multiple = I2S_MCLK_MULTIPLE_256
+        },
+        .slot_cfg = {
+            .data_bit_width = I2S_DATA_BIT_WIDTH_16BIT,
+            .slot_bit_width = I2S_SLOT_BIT_WIDTH_AUTO,
+            .slot_mode = I2S_SLOT_MODE_MONO,
+            .slot_mask = I2S_STD_SLOT_LEFT,
+            .ws_width = I2S_DATA_BIT_WIDTH_16BIT,
+            .ws_pol = false,
+            .bit_shift = true,
+            .left_align = true,
+            .big_endian = false,
+            .bit_order_lsb = false
+        },
+        .gpio_cfg = {
+            .mclk = mclk,
+            .bclk = bclk,
+            .ws = ws,
+            .dout = dout,
+            .din = I2S_GPIO_UNUSED,
+            .invert_flags = {
+                .mclk_inv = false,
+                .bclk_inv = false,
+                .ws_inv = false
+            }
+        }
+    };
+
+    i2s_tdm_config_t tdm_cfg = {
+        .clk_cfg = {
+            .sample_rate_hz = (uint32_t)bus_sample_rate_,
+            .clk_src = I2S_CLK_SRC_DEFAULT,
+            .ext_clk_freq_hz = 0,
+            .mclk_multiple = I2S_MCLK_MULTIPLE_256,
+            .bclk_div = 8,
+        },
+        .slot_cfg = {
+            .data_bit_width = I2S_DATA_BIT_WIDTH_16BIT,
+            .slot_bit_width = I2S_SLOT_BIT_WIDTH_AUTO,
+            .slot_mode = I2S_SLOT_MODE_STEREO,
+            .slot_mask = i2s_tdm_slot_mask_t(I2S_TDM_SLOT0 | I2S_TDM_SLOT1 | I2S_TDM_SLOT2 | I2S_TDM_SLOT3),
+            .ws_width = I2S_TDM_AUTO_WS_WIDTH,
+            .ws_pol = false,
+            .bit_shift = true,
+            .left_align = false,
+            .big_endian = false,
+            .bit_order_lsb = false,
+            .skip_mask = false,
+            .total_slot = I2S_TDM_AUTO_SLOT_NUM
+        },
+        .gpio_cfg = {
+            .mclk = mclk,
+            .bclk = bclk,
+            .ws = ws,
+            .dout = I2S_GPIO_UNUSED,
+            .din = din,
+            .invert_flags = {
+                .mclk_inv = false,
+                .bclk_inv = false,
+                .ws_inv = false
+            }
+        }
+    };
+
+    ESP_ERROR_CHECK(i2s_channel_init_std_mode(tx_handle_, &std_cfg));
+    ESP_ERROR_CHECK(i2s_channel_init_tdm_mode(rx_handle_, &tdm_cfg));
+    ESP_LOGI(TAG, "Duplex channels created, DMA %lu x %lu frames (%lu ms), rx %d ch TDM, tx %d ch", (unsigned long)dma.desc_num,
+        (unsigned long)dma.frame_num, (unsigned long)(dma.desc_num * dma.frame_num * 1000 / bus_sample_rate_),
+        input_channels_, output_channels_);
+}
+
+void Es7210AudioCodec::SetOutputVolume(int volume) {
+    ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(output_dev_, volume));
+    AudioCodec::SetOutputVolume(volume);
+}
+
+void Es7210AudioCodec::EnableInput(bool enable) {
+    std::lock_guard<std::mutex> lock(data_if_mutex_);
+    if (enable == input_enabled_) return;
+    if (enable) {
+        esp_codec_dev_sample_info_t fs = {
+            .bits_per_sample = 16,
+            .channel = (uint8_t) input_channels_,
+            .channel_mask = 0,
+            .sample_rate = (uint32_t)bus_sample_rate_,
+            .mclk_multiple = 0,
+        };
+        for (int i = 0; i < input_channels_; i++) {
+            fs.channel_mask |= ESP_CODEC_DEV_MAKE_CHANNEL_MASK(i);
+        }
+        ESP_ERROR_CHECK(esp_codec_dev_open(input_dev_, &fs));
+        {
+            // One gain register per mic, written as a group; equal gains because the beamformer sums them unweighted
+            SharedI2cLock bus_lock;
+            ESP_ERROR_CHECK(esp_codec_dev_set_in_gain(input_dev_, AUDIO_CODEC_DEFAULT_MIC_GAIN));
+        }
+    } else {
+        ESP_ERROR_CHECK(esp_codec_dev_close(input_dev_));
+    }
+    AudioCodec::EnableInput(enable);
+}
+
+void Es7210AudioCodec::EnableOutput(bool enable) {
+    std::lock_guard<std::mutex> lock(data_if_mutex_);
+    if (enable == output_enabled_) return;
+    if (enable) {
+        esp_codec_dev_sample_info_t fs = {
+            .bits_per_sample = 16,
+            .channel = (uint8_t) output_channels_,
+            .channel_mask = 0,
+            .sample_rate = (uint32_t)bus_sample_rate_,
+            .mclk_multiple = 0,
+        };
+        ESP_ERROR_CHECK(esp_codec_dev_open(output_dev_, &fs));
+        ESP_ERROR_CHECK(esp_codec_dev_set_out_vol(output_dev_, output_volume_));
+        if (pa_pin_ != GPIO_NUM_NC) { gpio_set_level(pa_pin_, 1); }
+    } else {
+        ESP_ERROR_CHECK(esp_codec_dev_close(output_dev_));
+        if (pa_pin_ != GPIO_NUM_NC) { gpio_set_level(pa_pin_, 0); }
+    }
+    AudioCodec::EnableOutput(enable);
+}
+
+int Es7210AudioCodec::Read(int16_t* dest, int samples, TickType_t timeout) {
+    if (!input_enabled_) {
+        return 0;
+    }
+    size_t bytes_read = 0;
+    esp_err_t err = i2s_channel_read(rx_handle_, dest, samples * sizeof(int16_t), &bytes_read, timeout);
+    if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
+        ESP_LOGW(TAG, "i2s_channel_read failed: %s", esp_err_to_name(err));
+    }
+    return (int)(bytes_read / sizeof(int16_t));
+}
+
+int Es7210AudioCodec::Write(const int16_t* data, int samples, TickType_t timeout) {
+    if (!output_enabled_ || data == nullptr) {
+        return 0;
+    }
+    // Hardware volume on the ES8311, so the samples go to the TX channel untouched (see Es8388AudioCodec)
+    size_t bytes_written = 0;
+    esp_err_t err = i2s_channel_write(tx_handle_, data, samples * sizeof(int16_t), &bytes_written, timeout);
+    if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
+        ESP_LOGW(TAG, "i2s_channel_write failed: %s", esp_err_to_name(err));
+    }
+    return (int)(bytes_written / sizeof(int16_t));
+}
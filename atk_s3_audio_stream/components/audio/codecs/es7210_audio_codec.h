@@ -0,0 +1,49 @@
+#ifndef _ES7210_AUDIO_CODEC_H
+#define _ES7210_AUDIO_CODEC_H
+
+#include "audio_codec.h"
+
+#include <driver/i2c_master.h>
+#include <driver/gpio.h>
+#include <esp_codec_dev.h>
+#include <esp_codec_dev_defaults.h>
+#include <mutex>
+
+#define ES7210_AUDIO_CODEC_SLOTS 4      // TDM slots captured, one per ES7210 mic input
+
+// Mic-array boards (ESP32-S3-Korvo-2, S3-BOX-3) put an ES7210 four-channel ADC and an ES8311 DAC on
+// one I2S port. Capture runs the RX channel in TDM mode and hands out every slot interleaved
+// (input_channels() == ES7210_AUDIO_CODEC_SLOTS, slot k = MIC(k+1)); playback is mono on the ES8311.
+class Es7210AudioCodec : public AudioCodec {
+private:
+    const audio_codec_data_if_t* data_if_ = nullptr;
+    const audio_codec_ctrl_if_t* out_ctrl_if_ = nullptr;
+    const audio_codec_ctrl_if_t* in_ctrl_if_ = nullptr;
+    const audio_codec_if_t* out_codec_if_ = nullptr;
+    const audio_codec_if_t* in_codec_if_ = nullptr;
+    const audio_codec_gpio_if_t* gpio_if_ = nullptr;
+
+    esp_codec_dev_handle_t output_dev_ = nullptr;
+    esp_codec_dev_handle_t input_dev_ = nullptr;
+    gpio_num_t pa_pin_ = GPIO_NUM_NC;
+    std::mutex data_if_mutex_;
+
+    void CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
+        const AudioDmaProfile& dma);
+
+    virtual int Read(int16_t* dest, int samples, TickType_t timeout) override;
+    virtual int Write(const int16_t* data, int samples, TickType_t timeout) override;
+
+public:
+    Es7210AudioCodec(void* i2c_master_handle, i2c_port_t i2c_port, int input_sample_rate, int output_sample_rate,
+        gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
+        gpio_num_t pa_pin, uint8_t es8311_addr, uint8_t es7210_addr,
+        const AudioDmaProfile& dma = AUDIO_DMA_PROFILE_DEFAULT);
+    virtual ~Es7210AudioCodec();
+
+    virtual void SetOutputVolume(int volume) override;
+    virtual void EnableInput(bool enable) override;
+    virtual void EnableOutput(bool enable) override;
+};
+
+#endif // _ES7210_AUDIO_CODEC_H
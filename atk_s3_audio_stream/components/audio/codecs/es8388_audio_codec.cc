@@ -1,19 +1,24 @@
 #include "es8388_audio_codec.h"
+#include "shared_i2c.h"
 
 #include <esp_log.h>
+#include <algorithm>
 
 static const char* TAG = "Es8388AudioCodec";
 
 Es8388AudioCodec::Es8388AudioCodec(void* i2c_master_handle, i2c_port_t i2c_port, int input_sample_rate, int output_sample_rate,
     gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
-    gpio_num_t pa_pin, uint8_t es8388_addr, bool input_reference) {
+    gpio_num_t pa_pin, uint8_t es8388_addr, bool input_reference, const AudioDmaProfile& dma) {
     duplex_ = true;
     input_reference_ = input_reference;
     input_channels_ = input_reference_ ? 2 : 1;
     input_sample_rate_ = input_sample_rate;
     output_sample_rate_ = output_sample_rate;
     pa_pin_ = pa_pin;
-    CreateDuplexChannels(mclk, bclk, ws, dout, din);
+    // The bus runs at the higher rate so neither direction loses bandwidth; the other is resampled
+    bus_sample_rate_ = std::max(input_sample_rate, output_sample_rate);
+    CreateResamplers();
+    CreateDuplexChannels(mclk, bclk, ws, dout, din, dma);
 
     audio_codec_i2s_cfg_t i2s_cfg = {
         .port = I2S_NUM_0,
@@ -78,14 +83,22 @@ Es8388AudioCodec::~Es8388AudioCodec() {
     audio_codec_delete_data_if(data_if_);
 }
 
-void Es8388AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din){
-    assert(input_sample_rate_ == output_sample_rate_);
+// Only the slots a direction uses go through its DMA: one channel runs the I2S channel in mono on the
+// left slot (half the DMA bytes of stereo per frame), two (mic + DAC reference) use both. The bus always
+// carries two slots, so the ES8388 sees the same frames either way. These are also the masks
+// esp_codec_dev_open() applies, so opening a device keeps the DMA buffers allocated here.
+static void set_slots(i2s_std_slot_config_t& slot_cfg, int channels) {
+    slot_cfg.slot_mode = channels == 1 ? I2S_SLOT_MODE_MONO : I2S_SLOT_MODE_STEREO;
+    slot_cfg.slot_mask = channels == 1 ? I2S_STD_SLOT_LEFT : I2S_STD_SLOT_BOTH;
+}
 
+void Es8388AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
+    const AudioDmaProfile& dma){
     i2s_chan_config_t chan_cfg = {
         .id = I2S_NUM_0,
         .role = I2S_ROLE_MASTER,
-        .dma_desc_num = AUDIO_CODEC_DMA_DESC_NUM,
-        .dma_frame_num = AUDIO_CODEC_DMA_FRAME_NUM,
+        .dma_desc_num = dma.desc_num,
+        .dma_frame_num = dma.frame_num,
         .auto_clear_after_cb = true,
         .auto_clear_before_cb = false,
         .intr_priority = 0,
@@ -94,7 +107,7 @@ void Es8388AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gp
 
     i2s_std_config_t std_cfg = {
         .clk_cfg = {
-            .sample_rate_hz = (uint32_t)output_sample_rate_,
+            .sample_rate_hz = (uint32_t)bus_sample_rate_,
             .clk_src = I2S_CLK_SRC_DEFAULT,
             .ext_clk_freq_hz = 0,
             .mclk_multiple = I2S_MCLK_MULTIPLE_256
@@ -125,9 +138,13 @@ void Es8388AudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gp
         }
     };
 
+    set_slots(std_cfg.slot_cfg, output_channels_);
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(tx_handle_, &std_cfg));
+    set_slots(std_cfg.slot_cfg, input_channels_);
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle_, &std_cfg));
-    ESP_LOGI(TAG, "Duplex channels created");
+    ESP_LOGI(TAG, "Duplex channels created, DMA %lu x %lu frames (%lu ms), rx %d ch, tx %d ch", (unsigned long)dma.desc_num,
+        (unsigned long)dma.frame_num, (unsigned long)(dma.desc_num * dma.frame_num * 1000 / bus_sample_rate_),
+        input_channels_, output_channels_);
 }
 
 void Es8388AudioCodec::SetOutputVolume(int volume) {
@@ -143,7 +160,7 @@ void Es8388AudioCodec::EnableInput(bool enable) {
             .bits_per_sample = 16,
             .channel = (uint8_t) input_channels_,
             .channel_mask = ESP_CODEC_DEV_MAKE_CHANNEL_MASK(0),
-            .sample_rate = (uint32_t)input_sample_rate_,
+            .sample_rate = (uint32_t)bus_sample_rate_,
             .mclk_multiple = 0,
         };
         if (input_reference_) {
@@ -168,9 +185,9 @@ void Es8388AudioCodec::EnableOutput(bool enable) {
     if (enable) {
         esp_codec_dev_sample_info_t fs = {
             .bits_per_sample = 16,
-            .channel = 1,
+            .channel = (uint8_t) output_channels_,
             .channel_mask = 0,
-            .sample_rate = (uint32_t)output_sample_rate_,
+            .sample_rate = (uint32_t)bus_sample_rate_,
             .mclk_multiple = 0,
         };
         ESP_ERROR_CHECK(esp_codec_dev_open(output_dev_, &fs));
@@ -179,8 +196,12 @@ void Es8388AudioCodec::EnableOutput(bool enable) {
         uint8_t reg_val = 30; // 0dB
         if(input_reference_){ reg_val = 27; }
         uint8_t regs[] = { 46, 47, 48, 49 }; // HP_LVOL, HP_RVOL, SPK_LVOL, SPK_RVOL
-        for (uint8_t reg : regs) {
-            ctrl_if_->write_reg(ctrl_if_, reg, 1, &reg_val, 1);
+        {
+            // Write the volume group back-to-back instead of interleaving with other bus users
+            SharedI2cLock bus_lock;
+            for (uint8_t reg : regs) {
+                ctrl_if_->write_reg(ctrl_if_, reg, 1, &reg_val, 1);
+            }
         }
         if (pa_pin_ != GPIO_NUM_NC) { gpio_set_level(pa_pin_, 1); }
     } else {
@@ -190,17 +211,29 @@ void Es8388AudioCodec::EnableOutput(bool enable) {
     AudioCodec::EnableOutput(enable);
 }
 
-int Es8388AudioCodec::Read(int16_t* dest, int samples) {
-    if (input_enabled_) {
-        ESP_ERROR_CHECK_WITHOUT_ABORT(esp_codec_dev_read(input_dev_, (void*)dest, samples * sizeof(int16_t)));
+int Es8388AudioCodec::Read(int16_t* dest, int samples, TickType_t timeout) {
+    if (!input_enabled_) {
+        return 0;
+    }
+    // Same channel esp_codec_dev_read uses, but it also tells us how much arrived before the timeout
+    size_t bytes_read = 0;
+    esp_err_t err = i2s_channel_read(rx_handle_, dest, samples * sizeof(int16_t), &bytes_read, timeout);
+    if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
+        ESP_LOGW(TAG, "i2s_channel_read failed: %s", esp_err_to_name(err));
     }
-    return samples;
+    return (int)(bytes_read / sizeof(int16_t));
 }
 
-int Es8388AudioCodec::Write(const int16_t* data, int samples) {
-    if (output_enabled_ && output_dev_ && data != nullptr) {
-        ESP_ERROR_CHECK_WITHOUT_ABORT(esp_codec_dev_write(output_dev_, (void*)data, samples * sizeof(int16_t)));
+int Es8388AudioCodec::Write(const int16_t* data, int samples, TickType_t timeout) {
+    if (!output_enabled_ || data == nullptr) {
+        return 0;
     }
-    return samples;
+    // Straight to the TX channel: esp_codec_dev_write would apply software volume in place, which the
+    // ES8388 does not need (hardware volume) and which would break the const contract on shared buffers
+    size_t bytes_written = 0;
+    esp_err_t err = i2s_channel_write(tx_handle_, data, samples * sizeof(int16_t), &bytes_written, timeout);
+    if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
+        ESP_LOGW(TAG, "i2s_channel_write failed: %s", esp_err_to_name(err));
+    }
+    return (int)(bytes_written / sizeof(int16_t));
 }
-
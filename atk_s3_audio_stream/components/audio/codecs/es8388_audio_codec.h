@@ -21,15 +21,17 @@ private:
     gpio_num_t pa_pin_ = GPIO_NUM_NC;
     std::mutex data_if_mutex_;
 
-    void CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din);
+    void CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
+        const AudioDmaProfile& dma);
 
-    virtual int Read(int16_t* dest, int samples) override;
-    virtual int Write(const int16_t* data, int samples) override;
+    virtual int Read(int16_t* dest, int samples, TickType_t timeout) override;
+    virtual int Write(const int16_t* data, int samples, TickType_t timeout) override;
 
 public:
     Es8388AudioCodec(void* i2c_master_handle, i2c_port_t i2c_port, int input_sample_rate, int output_sample_rate,
         gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din,
-        gpio_num_t pa_pin, uint8_t es8388_addr, bool input_reference = false);
+        gpio_num_t pa_pin, uint8_t es8388_addr, bool input_reference = false,
+        const AudioDmaProfile& dma = AUDIO_DMA_PROFILE_DEFAULT);
     virtual ~Es8388AudioCodec();
 
     virtual void SetOutputVolume(int volume) override;
@@ -0,0 +1,83 @@
+#include "ima_adpcm.h"
+
+static const int16_t kStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t kIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static constexpr int kMaxIndex = 88;
+
+// Applies one code to the state; the encoder runs the same step so both ends reconstruct identically
+static inline void ima_step(int32_t& predictor, int& index, uint8_t code) {
+    const int32_t step = kStepTable[index];
+    int32_t diff = step >> 3;
+    if (code & 4) diff += step;
+    if (code & 2) diff += step >> 1;
+    if (code & 1) diff += step >> 2;
+    predictor += (code & 8) ? -diff : diff;
+    // Compiles to the Xtensa CLAMPS instruction
+    predictor = predictor < INT16_MIN ? INT16_MIN : (predictor > INT16_MAX ? INT16_MAX : predictor);
+    index += kIndexTable[code];
+    index = index < 0 ? 0 : (index > kMaxIndex ? kMaxIndex : index);
+}
+
+static inline uint8_t ima_code(int32_t predictor, int index, int32_t sample) {
+    int32_t step = kStepTable[index];
+    int32_t diff = sample - predictor;
+    uint8_t code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) { code |= 4; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { code |= 2; diff -= step; }
+    step >>= 1;
+    if (diff >= step) code |= 1;
+    return code;
+}
+
+size_t ima_adpcm_encode(ImaAdpcmState& state, const int16_t* in, size_t samples, size_t stride, uint8_t* out) {
+    out[0] = (uint8_t)state.predictor;
+    out[1] = (uint8_t)((uint16_t)state.predictor >> 8);
+    out[2] = state.index;
+    out[3] = 0;
+    uint8_t* p = out + IMA_ADPCM_HEADER_BYTES;
+    int32_t predictor = state.predictor;
+    int index = state.index;
+    for (size_t i = 0; i < samples; i++) {
+        uint8_t code = ima_code(predictor, index, in[i * stride]);
+        ima_step(predictor, index, code);
+        if ((i & 1) == 0) {
+            *p = (uint8_t)(code << 4);
+        } else {
+            *p++ |= code;
+        }
+    }
+    state.predictor = (int16_t)predictor;
+    state.index = (uint8_t)index;
+    return IMA_ADPCM_BLOCK_BYTES(samples);
+}
+
+size_t ima_adpcm_decode(const uint8_t* in, size_t bytes, int16_t* out, size_t max_samples, size_t stride) {
+    if (bytes <= IMA_ADPCM_HEADER_BYTES || in[2] > kMaxIndex) return 0;
+    int32_t predictor = (int16_t)(in[0] | (in[1] << 8));
+    int index = in[2];
+    size_t samples = 2 * (bytes - IMA_ADPCM_HEADER_BYTES);
+    if (samples > max_samples) samples = max_samples;
+    const uint8_t* p = in + IMA_ADPCM_HEADER_BYTES;
+    for (size_t i = 0; i < samples; i++) {
+        uint8_t code = (i & 1) == 0 ? (p[i >> 1] >> 4) : (p[i >> 1] & 0x0F);
+        ima_step(predictor, index, code);
+        out[i * stride] = (int16_t)predictor;
+    }
+    return samples;
+}
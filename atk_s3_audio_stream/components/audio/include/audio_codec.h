@@ -3,18 +3,41 @@
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
+#include <freertos/portmacro.h>
 #include <driver/i2s_std.h>
 
+#include <memory>
 #include <vector>
+#include <span>
 #include <string>
 #include <functional>
 
 // Minimal stub include to satisfy original header dependency
 #include "board.h"
+#include "pcm_resampler.h"
 
 #define AUDIO_CODEC_DMA_DESC_NUM 6
 #define AUDIO_CODEC_DMA_FRAME_NUM 240
 #define AUDIO_CODEC_DEFAULT_MIC_GAIN 30.0
+#define AUDIO_CODEC_READ_TIMEOUT_MS 200     // a capture read that waits longer than this reports a short read
+#define AUDIO_CODEC_WRITE_TIMEOUT_MS 200    // default playback wait for DMA space
+#define AUDIO_CODEC_RESAMPLE_CHUNK 480      // bus frames converted per step when a direction is resampled
+
+// I2S DMA depth per direction: desc_num descriptors of frame_num frames each.
+// Buffered time = desc_num * frame_num / sample_rate; one descriptor is also the wake-up granularity.
+struct AudioDmaProfile {
+    uint32_t desc_num;
+    uint32_t frame_num;
+};
+static constexpr AudioDmaProfile AUDIO_DMA_PROFILE_DEFAULT = { AUDIO_CODEC_DMA_DESC_NUM, AUDIO_CODEC_DMA_FRAME_NUM }; // 60 ms at 24 kHz
+static constexpr AudioDmaProfile AUDIO_DMA_PROFILE_LOW_LATENCY = { 4, 120 };  // 20 ms at 24 kHz, intercom
+static constexpr AudioDmaProfile AUDIO_DMA_PROFILE_ROBUST = { 8, 480 };      // 160 ms at 24 kHz, streaming over busy Wi-Fi
+
+// DMA queue events counted from the I2S ISR since Start()
+struct AudioI2sStats {
+    uint32_t rx_overflow;   // capture buffers overwritten before InputData read them
+    uint32_t tx_underflow;  // playback ran dry and the DMA sent silence (also counts while nothing is playing)
+};
 
 class AudioCodec {
 public:
@@ -25,19 +48,30 @@ public:
     virtual void EnableInput(bool enable);
     virtual void EnableOutput(bool enable);
 
-    virtual void OutputData(std::vector<int16_t>& data);
+    // Zero-copy views over caller-owned storage (a packet buffer past its header, a pooled receive buffer).
+    // Both wait at most `timeout` and return the samples actually transferred. capture_us receives the
+    // esp_timer time of the first sample read, derived from I2S DMA completion (untouched if none).
+    int InputData(std::span<int16_t> dest, TickType_t timeout, int64_t* capture_us = nullptr);
+    int OutputData(std::span<const int16_t> data, TickType_t timeout);
+
+    // Whole-block convenience forms using the default timeouts; true only when every sample was transferred
+    virtual void OutputData(const std::vector<int16_t>& data);
+    bool OutputData(const int16_t* data, int samples);
     virtual bool InputData(std::vector<int16_t>& data);
+    bool InputData(int16_t* dest, int samples, int64_t* capture_us = nullptr);
     virtual void Start();
 
     inline bool duplex() const { return duplex_; }
     inline bool input_reference() const { return input_reference_; }
     inline int input_sample_rate() const { return input_sample_rate_; }
     inline int output_sample_rate() const { return output_sample_rate_; }
+    inline int bus_sample_rate() const { return bus_sample_rate_; }
     inline int input_channels() const { return input_channels_; }
     inline int output_channels() const { return output_channels_; }
     inline int output_volume() const { return output_volume_; }
     inline bool input_enabled() const { return input_enabled_; }
     inline bool output_enabled() const { return output_enabled_; }
+    inline AudioI2sStats i2s_stats() const { return { rx_overflow_, tx_underflow_ }; }
 
 protected:
     i2s_chan_handle_t tx_handle_ = nullptr;
@@ -49,12 +83,43 @@ protected:
     bool output_enabled_ = false;
     int input_sample_rate_ = 0;
     int output_sample_rate_ = 0;
+    int bus_sample_rate_ = 0;           // I2S clock; a direction at another rate goes through a resampler
     int input_channels_ = 1;
     int output_channels_ = 1;
     int output_volume_ = 70;
+    volatile uint32_t rx_overflow_ = 0;
+    volatile uint32_t tx_underflow_ = 0;
+
+    // Capture clock: frames completed by the RX DMA (and when the latest one finished), frames dropped on
+    // queue overflow, and frames handed to InputData. Updated by the I2S ISR under rx_lock_.
+    portMUX_TYPE rx_lock_ = portMUX_INITIALIZER_UNLOCKED;
+    uint64_t rx_dma_frames_ = 0;
+    int64_t rx_dma_us_ = 0;
+    uint64_t rx_dropped_frames_ = 0;
+    uint64_t rx_read_frames_ = 0;
+
+    // Per-direction rate conversion between the bus and input_sample_rate_/output_sample_rate_
+    std::unique_ptr<PcmResampler> in_resampler_;
+    std::unique_ptr<PcmResampler> out_resampler_;
+    std::vector<int16_t> in_bus_;       // raw bus frames read for one conversion step
+    std::vector<int16_t> in_pending_;   // converted input not yet handed out
+    size_t in_pending_off_ = 0;
+    int64_t in_pending_end_us_ = 0;     // capture time just past the last converted frame
+    std::vector<int16_t> out_bus_;      // converted output for one write step
+
+    // Called by a codec once the rates are known and before Start()
+    void CreateResamplers();
+    int ReadBus(int16_t* dest, int samples, TickType_t timeout, int64_t* end_us);
+
+    static bool OnRecv(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
+    static bool OnRecvQueueOverflow(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
+    static bool OnSendQueueOverflow(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
 
-    virtual int Read(int16_t* dest, int samples) = 0;
-    virtual int Write(const int16_t* data, int samples) = 0;
+    // Streaming fast path: straight to i2s_channel_read/i2s_channel_write on rx_handle_/tx_handle_, never through
+    // esp_codec_dev (which stays in charge of codec registers and hardware volume), so a block costs one DMA copy.
+    // Return the number of samples actually transferred (fewer on timeout, 0 when the direction is disabled)
+    virtual int Read(int16_t* dest, int samples, TickType_t timeout) = 0;
+    virtual int Write(const int16_t* data, int samples, TickType_t timeout) = 0;
 };
 
 #endif // _AUDIO_CODEC_H
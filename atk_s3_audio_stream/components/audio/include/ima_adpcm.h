@@ -0,0 +1,29 @@
+#ifndef _IMA_ADPCM_H
+#define _IMA_ADPCM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// IMA/DVI ADPCM, 4 bits per sample (4:1 against 16-bit PCM). Every block is self-contained so a lost
+// packet never desynchronises the next one: a 4-byte header holding the coder state before the first
+// sample (int16 little-endian predictor, uint8 step index, uint8 zero), then one nibble per sample with
+// the first sample in the high nibble, the layout Python's audioop.lin2adpcm produces. An odd sample
+// count pads the last byte. Multi-channel frames go as one block per channel, back to back.
+#define IMA_ADPCM_HEADER_BYTES 4
+#define IMA_ADPCM_BLOCK_BYTES(samples) (IMA_ADPCM_HEADER_BYTES + ((samples) + 1) / 2)
+
+struct ImaAdpcmState {
+    int16_t predictor = 0;
+    uint8_t index = 0;
+};
+
+// Codes in[0], in[stride], ... (stride = channels picks one channel of an interleaved frame) into one
+// block at out, IMA_ADPCM_BLOCK_BYTES(samples) long. state carries over so consecutive blocks track
+// the signal without restarting.
+size_t ima_adpcm_encode(ImaAdpcmState& state, const int16_t* in, size_t samples, size_t stride, uint8_t* out);
+
+// Decodes one block of `bytes` to out[0], out[stride], ... and returns the sample count (at most
+// max_samples); 0 when the block is too short or its header is out of range.
+size_t ima_adpcm_decode(const uint8_t* in, size_t bytes, int16_t* out, size_t max_samples, size_t stride);
+
+#endif // _IMA_ADPCM_H
@@ -0,0 +1,49 @@
+#ifndef _MIC_BEAMFORMER_H
+#define _MIC_BEAMFORMER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define MIC_BEAMFORMER_MAX_MICS 4
+#define MIC_BEAMFORMER_MAX_BEAMS 13
+#define MIC_BEAMFORMER_SPAN_DEG 60     // beams are spread over +/- this angle from broadside
+
+// Fixed-point delay-and-sum beamformer for a uniform linear mic array. Each of `beams` steering
+// directions delays every mic by its plane-wave lag (Q8 samples, two-tap linear interpolation) and
+// averages the mics, so sound from that direction adds coherently and diffuse noise and reverberation
+// do not. The beam with the highest smoothed energy is sent; a switch needs a ~1 dB margin and
+// crossfades over one block, so the output does not flutter between two talkers. The delays are
+// designed once at construction (float, init only); filtering is integer only.
+class MicBeamformer {
+public:
+    // channels: interleaved slots per input frame, the first `mics` of which are the array in order
+    MicBeamformer(int sample_rate, int channels, int mics, int spacing_mm, int beams);
+
+    bool valid() const { return !delay_q8_.empty(); }
+    int beams() const { return beams_; }
+    int beam() const { return current_; }
+    int beam_angle(int beam) const;                 // degrees from broadside, positive towards the last mic
+
+    // Consumes `frames` interleaved input frames and writes as many mono samples to out
+    void Process(const int16_t* in, size_t frames, int16_t* out);
+
+    void Reset();
+
+private:
+    int sample_rate_;
+    int channels_;
+    int mics_;
+    int beams_;
+    int history_ = 0;                               // input samples kept per mic for the longest delay
+    int32_t mic_gain_q15_ = 0;                      // 1 / mics
+    int current_ = 0;                               // beam being sent
+    std::vector<uint16_t> delay_q8_;                // [beam][mic], in 1/256 samples
+    std::vector<int16_t> work_;                     // [mic][history + block], history then the current block
+    std::vector<int16_t> beam_out_;                 // [beam][block]
+    std::vector<int32_t> acc_;                      // one beam's sum over the block
+    std::vector<int64_t> energy_;                   // smoothed energy per beam
+    size_t block_ = 0;                              // frames work_ and beam_out_ are sized for
+};
+
+#endif // _MIC_BEAMFORMER_H
@@ -0,0 +1,22 @@
+#ifndef _PCM_DSP_H
+#define _PCM_DSP_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Q15 gain: 32767 ~ 0 dB, 0 = mute. All kernels work in place (out may equal in).
+#define PCM_DSP_GAIN_UNITY 32767
+#define PCM_DSP_RAMP_BLOCK 16      // samples per gain step while ramping (0.7 ms at 24 kHz, inaudible)
+
+// out[i] = in[i] * gain >> 15
+void pcm_gain_q15(int16_t* out, const int16_t* in, size_t samples, int16_t gain);
+
+// Linear ramp from `from` to `to` across the buffer, held constant over each PCM_DSP_RAMP_BLOCK so
+// every block runs through the vector kernel. Falls back to pcm_gain_q15 when from == to.
+void pcm_ramp_q15(int16_t* out, const int16_t* in, size_t samples, int16_t from, int16_t to);
+
+// out[i] = sat16(sum_k in[k][i] * gains[k] >> 15) for `streams` inputs in one pass, e.g. a prompt
+// on top of the intercom channel. out may alias in[0].
+void pcm_mix_q15(int16_t* out, const int16_t* const* in, const int16_t* gains, size_t streams, size_t samples);
+
+#endif // _PCM_DSP_H
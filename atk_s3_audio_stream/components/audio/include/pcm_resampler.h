@@ -0,0 +1,73 @@
+#ifndef _PCM_RESAMPLER_H
+#define _PCM_RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define PCM_RESAMPLER_TAPS 16          // FIR taps per polyphase branch (at the input rate)
+#define PCM_RESAMPLER_MAX_PHASES 160   // largest interpolation factor L (covers 44.1 <-> 48 kHz)
+
+// Rational L/M polyphase resampler for interleaved 16-bit PCM. The windowed-sinc prototype is
+// designed once at construction (float, init only); filtering is Q15 with a 32-bit accumulator,
+// one branch of PCM_RESAMPLER_TAPS multiply-accumulates per output sample and channel.
+class PcmResampler {
+public:
+    PcmResampler(int in_rate, int out_rate, int channels);
+
+    bool valid() const { return !coeffs_.empty(); }
+    int in_rate() const { return in_rate_; }
+    int out_rate() const { return out_rate_; }
+
+    // Upper bound on the output frames produced from `in_frames` input frames
+    size_t MaxOutput(size_t in_frames) const { return in_frames * L_ / M_ + 2; }
+
+    // Consumes all `in_frames` frames and writes the produced frames to out; returns their count
+    size_t Process(const int16_t* in, size_t in_frames, int16_t* out);
+
+    void Reset();
+
+private:
+    int in_rate_;
+    int out_rate_;
+    int channels_;
+    uint32_t L_ = 1;                       // interpolation factor
+    uint32_t M_ = 1;                       // decimation factor
+    uint32_t pos_ = 0;                     // next output position in 1/L input samples, from the first new frame
+    std::vector<int16_t> coeffs_;          // [phase][tap], tap 0 multiplies the newest input
+    std::vector<int16_t> work_;            // history (TAPS - 1 frames) followed by the current input
+};
+
+#define PCM_DRIFT_PHASES 64            // fractional delay branches; adjacent branches are interpolated linearly
+#define PCM_DRIFT_MAX_PPM 2000         // SetRatio() clamp: far beyond crystal tolerance, so only a bad estimate hits it
+
+// Asynchronous resampler for clock-drift correction: the ratio stays within a few hundred ppm of 1
+// and may change on every call without a click, since the read position is carried over as a
+// 32.32 fixed-point phase. Each output sample is a 16-tap windowed-sinc fractional delay at the
+// exact phase, interpolated between the two nearest of PCM_DRIFT_PHASES precomputed branches.
+class PcmDriftResampler {
+public:
+    explicit PcmDriftResampler(int channels);
+
+    // Output frames per input frame (> 1 stretches, < 1 shrinks), clamped to 1 +/- PCM_DRIFT_MAX_PPM
+    void SetRatio(double ratio);
+    double ratio() const { return ratio_; }
+
+    // Upper bound on the output frames produced from `in_frames` input frames
+    size_t MaxOutput(size_t in_frames) const { return in_frames + in_frames * PCM_DRIFT_MAX_PPM / 1000000 + 2; }
+
+    // Consumes all `in_frames` frames and writes the produced frames to out; returns their count
+    size_t Process(const int16_t* in, size_t in_frames, int16_t* out);
+
+    void Reset();
+
+private:
+    int channels_;
+    double ratio_ = 1.0;
+    uint64_t step_ = 1ull << 32;           // input advance per output frame, 32.32
+    uint64_t pos_ = 0;                     // next output position in input frames (32.32), from the first new frame
+    std::vector<int16_t> coeffs_;          // [phase 0..PHASES][tap], tap 0 multiplies the newest input
+    std::vector<int16_t> work_;            // history (TAPS - 1 frames) followed by the current input
+};
+
+#endif // _PCM_RESAMPLER_H
@@ -1,23 +1,37 @@
-#ifndef SETTINGS_STUB_H
-#define SETTINGS_STUB_H
+#ifndef _SETTINGS_H
+#define _SETTINGS_H
 
+#include <cstdint>
 #include <string>
-#include <unordered_map>
 
+#define SETTINGS_COMMIT_DELAY_MS 2000   // writes within this window after the first pending one share a commit
+
+// Persistent key/value settings in an NVS namespace (nvs_flash_init() must have run), behind a RAM cache
+// shared by every instance. Reads come from the cache; a key's first read loads it from NVS once. Writes
+// only update the cache and wake a low-priority writer task, which commits everything pending
+// SETTINGS_COMMIT_DELAY_MS after the first change. A burst of writes (a volume slider) costs one commit,
+// and flash wear is bounded to one commit per window however often a value changes.
+// Instances are cheap handles meant to live on the stack; a read-only one ignores writes.
 class Settings {
 public:
-    Settings(const char*, bool) {}
-    int GetInt(const char* key, int def) {
-        auto it = ints_.find(key);
-        return it == ints_.end() ? def : it->second;
-    }
-    void SetInt(const char* key, int value) { ints_[key] = value; }
-    std::string GetString(const char* key) { auto it = strs_.find(key); return it==strs_.end()?std::string():it->second; }
-    void SetString(const char* key, const std::string& v) { strs_[key]=v; }
+    Settings(const char* ns, bool read_write);
+
+    int32_t GetInt(const char* key, int32_t def = 0);
+    void SetInt(const char* key, int32_t value);
+    bool GetBool(const char* key, bool def = false);
+    void SetBool(const char* key, bool value);
+    std::string GetString(const char* key, const std::string& def = std::string());
+    void SetString(const char* key, const std::string& value);
+    void EraseKey(const char* key);
+
+    // Commits pending writes now, e.g. right before esp_restart(); callable from any task
+    static void Flush();
+
 private:
-    std::unordered_map<std::string,int> ints_;
-    std::unordered_map<std::string,std::string> strs_;
-};
+    std::string ns_;
+    bool read_write_;
 
-#endif // SETTINGS_STUB_H
+    bool Writable(const char* key) const;
+};
 
+#endif // _SETTINGS_H
@@ -0,0 +1,35 @@
+#ifndef SHARED_I2C_H
+#define SHARED_I2C_H
+
+// Hooks into the camera BSP's I2C bus manager (components/BSP/MYIIC) for
+// combined audio + video images. Both boards wire XL9555 and ES8388 to the
+// same SDA 41 / SCL 42 master, so only one side may create the bus.
+//
+// The symbols are weak: in this standalone project myiic is not linked and
+// they resolve to nullptr, so callers fall back to their own bus and skip
+// the arbitration.
+
+#include <esp_err.h>
+#include <driver/i2c_master.h>
+#include <freertos/FreeRTOS.h>
+
+extern "C" {
+i2c_master_bus_handle_t myiic_bus_get(void) __attribute__((weak));
+esp_err_t myiic_lock(int prio, TickType_t timeout) __attribute__((weak));
+void myiic_unlock(void) __attribute__((weak));
+}
+
+// Holds the shared bus for a group of transfers (low priority, so camera
+// power sequencing is not queued behind codec setup). No-op when standalone.
+class SharedI2cLock {
+public:
+    SharedI2cLock() : locked_(myiic_lock && myiic_lock(0, portMAX_DELAY) == ESP_OK) {}
+    ~SharedI2cLock() { if (locked_) { myiic_unlock(); } }
+    SharedI2cLock(const SharedI2cLock&) = delete;
+    SharedI2cLock& operator=(const SharedI2cLock&) = delete;
+
+private:
+    bool locked_;
+};
+
+#endif // SHARED_I2C_H
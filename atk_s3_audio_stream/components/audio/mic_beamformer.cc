@@ -0,0 +1,116 @@
+#include "mic_beamformer.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const char* TAG = "MicBeamformer";
+
+static constexpr double SPEED_OF_SOUND = 343.0;      // m/s at 20 degrees C
+static constexpr int ENERGY_SMOOTH_SHIFT = 3;        // one-pole smoothing over ~8 blocks (160 ms of 20 ms blocks)
+
+MicBeamformer::MicBeamformer(int sample_rate, int channels, int mics, int spacing_mm, int beams)
+    : sample_rate_(sample_rate), channels_(channels), mics_(mics), beams_(beams) {
+    if (mics < 1 || mics > MIC_BEAMFORMER_MAX_MICS || mics > channels || beams < 1 || beams > MIC_BEAMFORMER_MAX_BEAMS) {
+        ESP_LOGE(TAG, "%d mics of %d channels, %d beams not supported", mics, channels, beams);
+        return;
+    }
+
+    // Plane wave from angle a: mic m hears it (m - centre) * d * sin(a) / c later than the array centre.
+    // Delaying each mic by the largest lag minus its own lines them all up on the latest one.
+    const double centre = (mics - 1) / 2.0;
+    const double max_lag = centre * spacing_mm / 1000.0 * std::sin(MIC_BEAMFORMER_SPAN_DEG * M_PI / 180.0) /
+                           SPEED_OF_SOUND * sample_rate;
+    delay_q8_.resize(beams * mics);
+    for (int b = 0; b < beams; b++) {
+        const double s = std::sin(beam_angle(b) * M_PI / 180.0);
+        for (int m = 0; m < mics; m++) {
+            double lag = (m - centre) * spacing_mm / 1000.0 * s / SPEED_OF_SOUND * sample_rate;
+            delay_q8_[b * mics + m] = (uint16_t)std::lround((max_lag - lag) * 256.0);
+        }
+    }
+    history_ = (int)std::ceil(2.0 * max_lag) + 2;   // integer part plus the second interpolation tap
+    mic_gain_q15_ = 32768 / mics;
+    energy_.assign(beams, 0);
+    current_ = beams / 2;                            // broadside until something is heard
+    ESP_LOGI(TAG, "%d mics %d mm apart, %d beams over +/-%d deg, max delay %.2f samples", mics, spacing_mm, beams,
+             beams > 1 ? MIC_BEAMFORMER_SPAN_DEG : 0, 2.0 * max_lag);
+}
+
+int MicBeamformer::beam_angle(int beam) const {
+    if (beams_ <= 1) return 0;
+    return -MIC_BEAMFORMER_SPAN_DEG + 2 * MIC_BEAMFORMER_SPAN_DEG * beam / (beams_ - 1);
+}
+
+void MicBeamformer::Process(const int16_t* in, size_t frames, int16_t* out) {
+    if (!valid()) {
+        memset(out, 0, frames * sizeof(int16_t));
+        return;
+    }
+    if (frames > block_) {
+        // Sized on the first block (capture blocks are all the same length); history is carried over
+        std::vector<int16_t> work((history_ + frames) * mics_, 0);
+        for (int m = 0; m < mics_ && block_ > 0; m++) {
+            memcpy(&work[m * (history_ + frames)], &work_[m * (history_ + block_)], history_ * sizeof(int16_t));
+        }
+        work_.swap(work);
+        block_ = frames;
+        beam_out_.resize(beams_ * block_);
+        acc_.resize(block_);
+    }
+    const size_t stride = history_ + block_;
+
+    for (int m = 0; m < mics_; m++) {
+        int16_t* w = &work_[m * stride + history_];
+        for (size_t i = 0; i < frames; i++) w[i] = in[i * channels_ + m];
+    }
+
+    int best = current_;
+    for (int b = 0; b < beams_; b++) {
+        std::fill(acc_.begin(), acc_.begin() + frames, 0);
+        for (int m = 0; m < mics_; m++) {
+            const uint16_t d = delay_q8_[b * mics_ + m];
+            const int32_t f = d & 0xFF;
+            const int32_t g = 256 - f;
+            // x[n - k] * (1 - f) + x[n - k - 1] * f, with n indexing the current block
+            const int16_t* x = &work_[m * stride + history_ - (d >> 8)];
+            for (size_t i = 0; i < frames; i++) {
+                acc_[i] += x[i] * g + x[(ptrdiff_t)i - 1] * f;
+            }
+        }
+        int16_t* y = &beam_out_[b * block_];
+        int64_t e = 0;
+        for (size_t i = 0; i < frames; i++) {
+            int32_t v = (int32_t)(((int64_t)acc_[i] * mic_gain_q15_) >> 23);
+            v = v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : v);
+            y[i] = (int16_t)v;
+            e += v * v;
+        }
+        energy_[b] += (e - energy_[b]) >> ENERGY_SMOOTH_SHIFT;
+        if (energy_[b] > energy_[best]) best = b;
+    }
+
+    const int16_t* cur = &beam_out_[current_ * block_];
+    if (best != current_ && energy_[best] > energy_[current_] + (energy_[current_] >> 2)) {
+        // Linear crossfade across the block from the old beam to the new one
+        const int16_t* next = &beam_out_[best * block_];
+        for (size_t i = 0; i < frames; i++) {
+            out[i] = (int16_t)(((int32_t)cur[i] * (int32_t)(frames - i) + (int32_t)next[i] * (int32_t)i) / (int32_t)frames);
+        }
+        current_ = best;
+    } else {
+        memcpy(out, cur, frames * sizeof(int16_t));
+    }
+
+    for (int m = 0; m < mics_; m++) {
+        int16_t* w = &work_[m * stride];
+        memmove(w, w + frames, history_ * sizeof(int16_t));
+    }
+}
+
+void MicBeamformer::Reset() {
+    std::fill(work_.begin(), work_.end(), 0);
+    std::fill(energy_.begin(), energy_.end(), 0);
+    current_ = beams_ / 2;
+}
@@ -0,0 +1,49 @@
+#include "pcm_dsp.h"
+
+#include <cstring>
+#include <dsps_mulc.h>
+
+// dsps_mulc_s16 is the esp-dsp Q15 scale; on the S3 it resolves to the hand-scheduled assembly
+// version (CONFIG_DSP_OPTIMIZED), elsewhere to the ANSI C one.
+void pcm_gain_q15(int16_t* out, const int16_t* in, size_t samples, int16_t gain) {
+    if (samples == 0) return;
+    if (gain <= 0) {
+        memset(out, 0, samples * sizeof(int16_t));
+        return;
+    }
+    if (gain == PCM_DSP_GAIN_UNITY) {
+        if (out != in) memcpy(out, in, samples * sizeof(int16_t));
+        return;
+    }
+    dsps_mulc_s16(in, out, (int)samples, gain, 1, 1);
+}
+
+void pcm_ramp_q15(int16_t* out, const int16_t* in, size_t samples, int16_t from, int16_t to) {
+    if (from == to) {
+        pcm_gain_q15(out, in, samples, from);
+        return;
+    }
+    const size_t blocks = (samples + PCM_DSP_RAMP_BLOCK - 1) / PCM_DSP_RAMP_BLOCK;
+    for (size_t b = 0; b < blocks; b++) {
+        // Gain at the middle of the block keeps the ramp symmetric around its end points
+        int32_t gain = from + (int32_t)(to - from) * (int32_t)(2 * b + 1) / (int32_t)(2 * blocks);
+        size_t off = b * PCM_DSP_RAMP_BLOCK;
+        size_t n = samples - off < PCM_DSP_RAMP_BLOCK ? samples - off : PCM_DSP_RAMP_BLOCK;
+        pcm_gain_q15(out + off, in + off, n, (int16_t)gain);
+    }
+}
+
+void pcm_mix_q15(int16_t* out, const int16_t* const* in, const int16_t* gains, size_t streams, size_t samples) {
+    if (streams == 0) {
+        memset(out, 0, samples * sizeof(int16_t));
+        return;
+    }
+    for (size_t i = 0; i < samples; i++) {
+        int32_t acc = 0;
+        for (size_t k = 0; k < streams; k++) {
+            acc += ((int32_t)in[k][i] * gains[k]) >> 15;
+        }
+        // Compiles to the Xtensa CLAMPS instruction
+        out[i] = (int16_t)(acc < INT16_MIN ? INT16_MIN : (acc > INT16_MAX ? INT16_MAX : acc));
+    }
+}
@@ -0,0 +1,155 @@
+#include "pcm_resampler.h"
+
+#include <esp_log.h>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+static const char* TAG = "PcmResampler";
+
+PcmResampler::PcmResampler(int in_rate, int out_rate, int channels)
+    : in_rate_(in_rate), out_rate_(out_rate), channels_(channels) {
+    int g = std::gcd(in_rate, out_rate);
+    L_ = (uint32_t)(out_rate / g);
+    M_ = (uint32_t)(in_rate / g);
+    if (L_ > PCM_RESAMPLER_MAX_PHASES) {
+        ESP_LOGE(TAG, "%d -> %d Hz needs %lu phases (max %d)", in_rate, out_rate, (unsigned long)L_, PCM_RESAMPLER_MAX_PHASES);
+        return;
+    }
+
+    // Prototype low-pass at L x the input rate: cut off below the lower of the two Nyquist limits
+    const int n = PCM_RESAMPLER_TAPS * (int)L_;
+    const double fc = 0.45 / (double)(L_ > M_ ? L_ : M_);   // cycles per sample at the upsampled rate
+    const double centre = (n - 1) / 2.0;
+    std::vector<double> h(n);
+    for (int i = 0; i < n; i++) {
+        double x = i - centre;
+        double sinc = (x == 0.0) ? 2.0 * fc : std::sin(2.0 * M_PI * fc * x) / (M_PI * x);
+        double window = 0.42 - 0.5 * std::cos(2.0 * M_PI * i / (n - 1)) + 0.08 * std::cos(4.0 * M_PI * i / (n - 1));
+        h[i] = sinc * window;
+    }
+
+    // Split into branches and normalise each to unity DC gain, so every phase passes a constant unchanged
+    coeffs_.resize(n);
+    for (uint32_t p = 0; p < L_; p++) {
+        double sum = 0.0;
+        for (int j = 0; j < PCM_RESAMPLER_TAPS; j++) sum += h[p + j * L_];
+        for (int j = 0; j < PCM_RESAMPLER_TAPS; j++) {
+            coeffs_[p * PCM_RESAMPLER_TAPS + j] = (int16_t)std::lround(h[p + j * L_] / sum * 32767.0);
+        }
+    }
+    Reset();
+    ESP_LOGI(TAG, "%d -> %d Hz (L=%lu, M=%lu, %d taps)", in_rate, out_rate, (unsigned long)L_, (unsigned long)M_, PCM_RESAMPLER_TAPS);
+}
+
+void PcmResampler::Reset() {
+    work_.assign((PCM_RESAMPLER_TAPS - 1) * channels_, 0);
+    pos_ = 0;
+}
+
+size_t PcmResampler::Process(const int16_t* in, size_t in_frames, int16_t* out) {
+    if (!valid()) return 0;
+    const size_t hist = PCM_RESAMPLER_TAPS - 1;
+    work_.resize((hist + in_frames) * channels_);
+    memcpy(work_.data() + hist * channels_, in, in_frames * channels_ * sizeof(int16_t));
+
+    size_t produced = 0;
+    while (pos_ / L_ < in_frames) {
+        const int16_t* h = coeffs_.data() + (pos_ % L_) * PCM_RESAMPLER_TAPS;
+        const int16_t* x = work_.data() + (hist + pos_ / L_) * channels_;  // newest input for this output
+        for (int c = 0; c < channels_; c++) {
+            int32_t acc = 1 << 14;
+            const int16_t* xc = x + c;
+            for (int j = 0; j < PCM_RESAMPLER_TAPS; j++, xc -= channels_) {
+                acc += (int32_t)h[j] * *xc;
+            }
+            acc >>= 15;
+            *out++ = (int16_t)(acc < INT16_MIN ? INT16_MIN : (acc > INT16_MAX ? INT16_MAX : acc));
+        }
+        produced++;
+        pos_ += M_;
+    }
+    pos_ -= (uint32_t)(in_frames * L_);
+
+    // Keep the last TAPS - 1 frames as history for the next call
+    memmove(work_.data(), work_.data() + in_frames * channels_, hist * channels_ * sizeof(int16_t));
+    work_.resize(hist * channels_);
+    return produced;
+}
+
+static constexpr int DRIFT_PHASE_BITS = 6;
+static_assert((1 << DRIFT_PHASE_BITS) == PCM_DRIFT_PHASES, "phase index is taken from the top fraction bits");
+
+PcmDriftResampler::PcmDriftResampler(int channels) : channels_(channels) {
+    // One prototype at PHASES x the rate, one sample longer than the branches need, so branch PHASES
+    // (a whole input frame later, equal to branch 0 on the next frame) exists for the last phase to
+    // interpolate towards
+    const int n = PCM_RESAMPLER_TAPS * PCM_DRIFT_PHASES + 1;
+    const double fc = 0.45 / PCM_DRIFT_PHASES;
+    const double centre = (n - 1) / 2.0;
+    std::vector<double> h(n);
+    for (int i = 0; i < n; i++) {
+        double x = i - centre;
+        double sinc = (x == 0.0) ? 2.0 * fc : std::sin(2.0 * M_PI * fc * x) / (M_PI * x);
+        double window = 0.42 - 0.5 * std::cos(2.0 * M_PI * i / (n - 1)) + 0.08 * std::cos(4.0 * M_PI * i / (n - 1));
+        h[i] = sinc * window;
+    }
+    coeffs_.resize((PCM_DRIFT_PHASES + 1) * PCM_RESAMPLER_TAPS);
+    for (int p = 0; p <= PCM_DRIFT_PHASES; p++) {
+        double sum = 0.0;
+        for (int j = 0; j < PCM_RESAMPLER_TAPS; j++) sum += h[p + j * PCM_DRIFT_PHASES];
+        for (int j = 0; j < PCM_RESAMPLER_TAPS; j++) {
+            coeffs_[p * PCM_RESAMPLER_TAPS + j] = (int16_t)std::lround(h[p + j * PCM_DRIFT_PHASES] / sum * 32767.0);
+        }
+    }
+    Reset();
+}
+
+void PcmDriftResampler::SetRatio(double ratio) {
+    const double max = PCM_DRIFT_MAX_PPM * 1e-6;
+    if (ratio > 1.0 + max) ratio = 1.0 + max;
+    if (ratio < 1.0 - max) ratio = 1.0 - max;
+    ratio_ = ratio;
+    step_ = (uint64_t)std::llround(4294967296.0 / ratio);
+}
+
+void PcmDriftResampler::Reset() {
+    work_.assign((PCM_RESAMPLER_TAPS - 1) * channels_, 0);
+    pos_ = 0;
+}
+
+size_t PcmDriftResampler::Process(const int16_t* in, size_t in_frames, int16_t* out) {
+    const size_t hist = PCM_RESAMPLER_TAPS - 1;
+    work_.resize((hist + in_frames) * channels_);
+    memcpy(work_.data() + hist * channels_, in, in_frames * channels_ * sizeof(int16_t));
+
+    size_t produced = 0;
+    while ((pos_ >> 32) < in_frames) {
+        uint32_t frac = (uint32_t)pos_;
+        uint32_t p = frac >> (32 - DRIFT_PHASE_BITS);
+        int32_t t = (int32_t)((frac >> (32 - DRIFT_PHASE_BITS - 15)) & 0x7FFF);   // Q15 position between branch p and p + 1
+        const int16_t* h0 = coeffs_.data() + p * PCM_RESAMPLER_TAPS;
+        const int16_t* h1 = h0 + PCM_RESAMPLER_TAPS;
+        const int16_t* x = work_.data() + (hist + (pos_ >> 32)) * channels_;   // newest input for this output
+        for (int c = 0; c < channels_; c++) {
+            int32_t a0 = 0;
+            int32_t a1 = 0;
+            const int16_t* xc = x + c;
+            for (int j = 0; j < PCM_RESAMPLER_TAPS; j++, xc -= channels_) {
+                a0 += (int32_t)h0[j] * *xc;
+                a1 += (int32_t)h1[j] * *xc;
+            }
+            int32_t acc = a0 + (int32_t)((((int64_t)a1 - a0) * t) >> 15);
+            acc = (acc + (1 << 14)) >> 15;
+            *out++ = (int16_t)(acc < INT16_MIN ? INT16_MIN : (acc > INT16_MAX ? INT16_MAX : acc));
+        }
+        produced++;
+        pos_ += step_;
+    }
+    pos_ -= (uint64_t)in_frames << 32;
+
+    // Keep the last TAPS - 1 frames as history for the next call
+    memmove(work_.data(), work_.data() + in_frames * channels_, hist * channels_ * sizeof(int16_t));
+    work_.resize(hist * channels_);
+    return produced;
+}
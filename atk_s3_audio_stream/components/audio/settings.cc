@@ -0,0 +1,191 @@
+#include "settings.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <nvs.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+static const char* TAG = "Settings";
+
+namespace {
+
+enum class Kind : uint8_t { Absent, Int, String };
+
+struct Entry {
+    Kind kind = Kind::Absent;
+    int32_t i = 0;
+    std::string s;
+    bool dirty = false;                     // changed in RAM since the last commit
+};
+
+struct Pending {
+    std::string ns;
+    std::string key;
+    Entry entry;
+};
+
+// namespace -> key -> cached value (also caches keys known to be absent, so a miss reads flash only once)
+std::map<std::string, std::map<std::string, Entry>> g_cache;
+std::mutex g_cache_mutex;
+std::mutex g_commit_mutex;                  // one commit at a time (writer task or Flush)
+TaskHandle_t g_writer = nullptr;
+
+constexpr uint32_t SETTINGS_WRITER_STACK = 3072;
+
+// First read of a key: fetch it from NVS as the type the caller expects. Runs under g_cache_mutex.
+Entry& Lookup(const std::string& ns, const char* key, Kind kind) {
+    auto& keys = g_cache[ns];
+    auto it = keys.find(key);
+    if (it != keys.end()) return it->second;
+
+    Entry entry;
+    nvs_handle_t h;
+    if (nvs_open(ns.c_str(), NVS_READONLY, &h) == ESP_OK) {
+        if (kind == Kind::Int && nvs_get_i32(h, key, &entry.i) == ESP_OK) {
+            entry.kind = Kind::Int;
+        } else if (kind == Kind::String) {
+            size_t len = 0;
+            if (nvs_get_str(h, key, nullptr, &len) == ESP_OK && len > 0) {
+                entry.s.resize(len);
+                if (nvs_get_str(h, key, entry.s.data(), &len) == ESP_OK) {
+                    entry.s.resize(len - 1);        // drop the terminator
+                    entry.kind = Kind::String;
+                } else {
+                    entry.s.clear();
+                }
+            }
+        }
+        nvs_close(h);
+    }
+    return keys.emplace(key, std::move(entry)).first->second;
+}
+
+void Commit() {
+    std::lock_guard<std::mutex> commit_lock(g_commit_mutex);
+    // Snapshot under the cache lock and write without it, so readers never wait on flash
+    std::vector<Pending> pending;
+    {
+        std::lock_guard<std::mutex> lock(g_cache_mutex);
+        for (auto& [ns, keys] : g_cache) {
+            for (auto& [key, entry] : keys) {
+                if (!entry.dirty) continue;
+                entry.dirty = false;
+                pending.push_back({ ns, key, entry });
+            }
+        }
+    }
+
+    size_t i = 0;
+    while (i < pending.size()) {
+        const std::string& ns = pending[i].ns;
+        nvs_handle_t h;
+        esp_err_t err = nvs_open(ns.c_str(), NVS_READWRITE, &h);
+        size_t end = i;
+        while (end < pending.size() && pending[end].ns == ns) end++;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "nvs_open(%s) failed: %s, %u settings not saved", ns.c_str(), esp_err_to_name(err), (unsigned)(end - i));
+            i = end;
+            continue;
+        }
+        for (; i < end; i++) {
+            const Pending& p = pending[i];
+            switch (p.entry.kind) {
+            case Kind::Int: err = nvs_set_i32(h, p.key.c_str(), p.entry.i); break;
+            case Kind::String: err = nvs_set_str(h, p.key.c_str(), p.entry.s.c_str()); break;
+            case Kind::Absent:
+                err = nvs_erase_key(h, p.key.c_str());
+                if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+                break;
+            }
+            if (err != ESP_OK) ESP_LOGE(TAG, "saving %s/%s failed: %s", ns.c_str(), p.key.c_str(), esp_err_to_name(err));
+        }
+        err = nvs_commit(h);
+        if (err != ESP_OK) ESP_LOGE(TAG, "nvs_commit(%s) failed: %s", ns.c_str(), esp_err_to_name(err));
+        nvs_close(h);
+    }
+    if (!pending.empty()) ESP_LOGI(TAG, "Committed %u settings", (unsigned)pending.size());
+}
+
+// Sleeps until a write arrives, lets the window collect more, then commits them together
+void WriterTask(void*) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(SETTINGS_COMMIT_DELAY_MS));
+        ulTaskNotifyTake(pdTRUE, 0);                // writes during the window are in this commit
+        Commit();
+    }
+}
+
+// Runs under g_cache_mutex after an entry changed
+void ScheduleCommit(Entry& entry) {
+    entry.dirty = true;
+    if (g_writer == nullptr) {
+        xTaskCreate(&WriterTask, "settings", SETTINGS_WRITER_STACK, nullptr, tskIDLE_PRIORITY + 1, &g_writer);
+    }
+    if (g_writer != nullptr) xTaskNotifyGive(g_writer);
+}
+
+} // namespace
+
+Settings::Settings(const char* ns, bool read_write) : ns_(ns), read_write_(read_write) {}
+
+bool Settings::Writable(const char* key) const {
+    if (!read_write_) ESP_LOGW(TAG, "%s/%s: read-only settings, write ignored", ns_.c_str(), key);
+    return read_write_;
+}
+
+int32_t Settings::GetInt(const char* key, int32_t def) {
+    std::lock_guard<std::mutex> lock(g_cache_mutex);
+    const Entry& e = Lookup(ns_, key, Kind::Int);
+    return e.kind == Kind::Int ? e.i : def;
+}
+
+void Settings::SetInt(const char* key, int32_t value) {
+    if (!Writable(key)) return;
+    std::lock_guard<std::mutex> lock(g_cache_mutex);
+    Entry& e = Lookup(ns_, key, Kind::Int);
+    if (e.kind == Kind::Int && e.i == value) return;    // unchanged: no flash write at all
+    e.kind = Kind::Int;
+    e.i = value;
+    e.s.clear();
+    ScheduleCommit(e);
+}
+
+bool Settings::GetBool(const char* key, bool def) {
+    return GetInt(key, def ? 1 : 0) != 0;
+}
+
+void Settings::SetBool(const char* key, bool value) {
+    SetInt(key, value ? 1 : 0);
+}
+
+std::string Settings::GetString(const char* key, const std::string& def) {
+    std::lock_guard<std::mutex> lock(g_cache_mutex);
+    const Entry& e = Lookup(ns_, key, Kind::String);
+    return e.kind == Kind::String ? e.s : def;
+}
+
+void Settings::SetString(const char* key, const std::string& value) {
+    if (!Writable(key)) return;
+    std::lock_guard<std::mutex> lock(g_cache_mutex);
+    Entry& e = Lookup(ns_, key, Kind::String);
+    if (e.kind == Kind::String && e.s == value) return;
+    e.kind = Kind::String;
+    e.s = value;
+    ScheduleCommit(e);
+}
+
+void Settings::EraseKey(const char* key) {
+    if (!Writable(key)) return;
+    std::lock_guard<std::mutex> lock(g_cache_mutex);
+    Entry& e = g_cache[ns_][key];
+    e = Entry();
+    ScheduleCommit(e);
+}
+
+void Settings::Flush() {
+    Commit();
+}
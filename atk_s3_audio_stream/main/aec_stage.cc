@@ -0,0 +1,64 @@
+#include "aec_stage.h"
+
+#include <esp_afe_sr_models.h>
+#include <esp_afe_config.h>
+#include <esp_log.h>
+
+static const char* TAG = "aec_stage";
+
+AecStage::AecStage() {
+    // "MR": one mic, then the reference, interleaved in that order per frame
+    afe_config_t* cfg = afe_config_init("MR", nullptr, AFE_TYPE_VC, AFE_MODE_HIGH_PERF);
+    if (cfg == nullptr) {
+        ESP_LOGE(TAG, "afe_config_init failed");
+        return;
+    }
+    cfg->aec_init = true;
+    cfg->aec_mode = AEC_MODE_VOIP_HIGH_PERF;
+    cfg->ns_init = true;
+    cfg->afe_ns_mode = AFE_NS_MODE_WEBRTC;      // no model partition needed
+    cfg->vad_init = false;
+    cfg->agc_init = false;
+    cfg->wakenet_init = false;
+    cfg->memory_alloc_mode = AFE_MEMORY_ALLOC_MORE_PSRAM;
+
+    afe_iface_ = esp_afe_handle_from_config(cfg);
+    afe_data_ = afe_iface_ != nullptr ? afe_iface_->create_from_config(cfg) : nullptr;
+    afe_config_free(cfg);
+    if (afe_data_ == nullptr) {
+        ESP_LOGE(TAG, "AFE create failed (PSRAM enabled?)");
+        return;
+    }
+    feed_frames_ = (size_t)afe_iface_->get_feed_chunksize(afe_data_);
+    ESP_LOGI(TAG, "AEC + NS ready, %u frames per feed", (unsigned)feed_frames_);
+}
+
+AecStage::~AecStage() {
+    if (afe_data_ != nullptr) afe_iface_->destroy(afe_data_);
+}
+
+void AecStage::Feed(const int16_t* mic_ref, int64_t capture_us) {
+    portENTER_CRITICAL(&lock_);
+    feed_us_ = capture_us;
+    feed_index_ += feed_frames_;
+    portEXIT_CRITICAL(&lock_);
+    afe_iface_->feed(afe_data_, mic_ref);
+}
+
+size_t AecStage::Fetch(const int16_t** mono, int64_t* capture_us) {
+    afe_fetch_result_t* res = afe_iface_->fetch(afe_data_);
+    if (res == nullptr || res->ret_value == ESP_FAIL || res->data == nullptr || res->data_size <= 0) {
+        return 0;
+    }
+    size_t samples = (size_t)res->data_size / sizeof(int16_t);
+
+    portENTER_CRITICAL(&lock_);
+    int64_t behind = (int64_t)(feed_index_ - feed_frames_) - (int64_t)fetch_index_;
+    int64_t feed_us = feed_us_;
+    fetch_index_ += samples;
+    portEXIT_CRITICAL(&lock_);
+
+    *capture_us = feed_us - behind * 1000000 / SAMPLE_RATE;
+    *mono = res->data;
+    return samples;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <freertos/FreeRTOS.h>
+#include <esp_afe_sr_iface.h>
+
+// Echo cancellation + noise suppression on the mic uplink (esp-sr AFE, voice-communication mode).
+// Input is interleaved [mic, speaker reference] at 16 kHz from Es8388AudioCodec with
+// input_reference = true; output is the cleaned mono mic signal at the same rate.
+// Feed() and Fetch() are meant for two different tasks: Fetch() blocks until the AFE has output.
+class AecStage {
+public:
+    static constexpr int SAMPLE_RATE = 16000;  // the AFE only runs at 16 kHz
+
+    AecStage();
+    ~AecStage();
+
+    bool valid() const { return afe_data_ != nullptr; }
+
+    // Stereo frames per Feed() call
+    size_t feed_frames() const { return feed_frames_; }
+
+    // capture_us: time of the first frame, as reported by AudioCodec::InputData
+    void Feed(const int16_t* mic_ref, int64_t capture_us);
+
+    // Points *mono at the next block of cleaned samples and returns its length (0 on error);
+    // capture_us receives the capture time of its first sample
+    size_t Fetch(const int16_t** mono, int64_t* capture_us);
+
+private:
+    const esp_afe_sr_iface_t* afe_iface_ = nullptr;
+    esp_afe_sr_data_t* afe_data_ = nullptr;
+    size_t feed_frames_ = 0;
+
+    // Sample clock shared by the two sides: the AFE passes samples through 1:1, so output sample k
+    // was captured at feed_us_ + (k - feed_index_) / SAMPLE_RATE
+    uint64_t feed_index_ = 0;
+    int64_t feed_us_ = 0;
+    uint64_t fetch_index_ = 0;
+    portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+};
@@ -0,0 +1,153 @@
+#include "feature_stage.h"
+
+#include <dsps_fft2r.h>
+#include <dsps_wind_hann.h>
+#include <esp_log.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#ifndef CONFIG_STREAM_FEATURE_EVENT_DB
+#define CONFIG_STREAM_FEATURE_EVENT_DB 15
+#endif
+
+static const char* TAG = "feature_stage";
+
+static constexpr int FEATURE_QUEUE_FRAMES = 8;        // captured frames queued before Feed() starts dropping
+static constexpr int FEATURE_OUTPUT_VECTORS = 32;     // finished vectors waiting for the uplink (640 ms)
+static constexpr float FEATURE_FMIN_HZ = 50.0f;       // lowest band edge; the top edge is Nyquist
+static constexpr float FEATURE_ABS_MIN_DBFS = -80.0f; // quieter bands never count towards an event
+static constexpr int FEATURE_EVENT_BANDS = 2;         // a tonal alarm lifts its fundamental and a harmonic
+static constexpr uint32_t FEATURE_TASK_STACK = 3072;
+static constexpr UBaseType_t FEATURE_TASK_PRIORITY = 4;
+static constexpr BaseType_t FEATURE_TASK_CORE = 1;
+
+static float hz_to_mel(float hz) { return 2595.0f * std::log10(1.0f + hz / 700.0f); }
+static float mel_to_hz(float mel) { return 700.0f * (std::pow(10.0f, mel / 2595.0f) - 1.0f); }
+
+FeatureStage::FeatureStage(int in_rate, int in_channels)
+    : in_rate_(in_rate), in_channels_(in_channels), frame_((size_t)in_rate * HOP_MS / 1000) {
+    fft_n_ = 1;
+    while ((size_t)fft_n_ < frame_) fft_n_ <<= 1;
+    esp_err_t err = dsps_fft2r_init_fc32(nullptr, fft_n_);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "dsps_fft2r_init_fc32(%d) failed: %s", fft_n_, esp_err_to_name(err));
+        return;
+    }
+    window_.resize(frame_);
+    dsps_wind_hann_f32(window_.data(), (int)frame_);
+    fft_.resize(2 * fft_n_);
+
+    // Full-scale sine: the Hann window's coherent gain puts (sum(w) / 2)^2 into its bin
+    float wsum = 0.0f;
+    for (float w : window_) wsum += w;
+    norm_db_ = -20.0f * std::log10(wsum / 2.0f);
+
+    // Triangular mel filters on the FFT bins; a band narrower than a bin takes its centre bin whole
+    const float bin_hz = (float)in_rate / fft_n_;
+    const float mel_lo = hz_to_mel(FEATURE_FMIN_HZ);
+    const float mel_hi = hz_to_mel(in_rate / 2.0f);
+    float edge[BANDS + 2];
+    for (int i = 0; i < BANDS + 2; i++) edge[i] = mel_to_hz(mel_lo + (mel_hi - mel_lo) * i / (BANDS + 1));
+    for (int b = 0; b < BANDS; b++) {
+        const float lo = edge[b], mid = edge[b + 1], hi = edge[b + 2];
+        int first = (int)std::ceil(lo / bin_hz);
+        int last = std::min((int)std::floor(hi / bin_hz), fft_n_ / 2);
+        band_start_.push_back((uint16_t)first);
+        size_t start = weights_.size();
+        for (int k = first; k <= last; k++) {
+            float f = k * bin_hz;
+            weights_.push_back(f <= mid ? (f - lo) / (mid - lo) : (hi - f) / (hi - mid));
+        }
+        float sum = 0.0f;
+        for (size_t i = start; i < weights_.size(); i++) sum += weights_[i];
+        if (sum <= 0.0f) {
+            weights_.resize(start);
+            band_start_.back() = (uint16_t)std::min((int)std::lround(mid / bin_hz), fft_n_ / 2);
+            weights_.push_back(1.0f);
+        }
+        band_len_.push_back((uint16_t)(weights_.size() - start));
+    }
+
+    const size_t msg_bytes = sizeof(uint64_t) + frame_ * sizeof(int16_t);
+    msg_.resize(msg_bytes);
+    input_ = xMessageBufferCreate(FEATURE_QUEUE_FRAMES * (msg_bytes + sizeof(size_t)));
+    output_ = xQueueCreate(FEATURE_OUTPUT_VECTORS, sizeof(Vector));
+    assert(input_ && output_);
+    xTaskCreatePinnedToCore(&FeatureStage::Task, "features", FEATURE_TASK_STACK, this, FEATURE_TASK_PRIORITY,
+                            nullptr, FEATURE_TASK_CORE);
+    ESP_LOGI(TAG, "%d log-mel bands every %d ms (%d-point FFT at %d Hz), events at +%d dB", BANDS, HOP_MS, fft_n_,
+             in_rate, CONFIG_STREAM_FEATURE_EVENT_DB);
+}
+
+void FeatureStage::Feed(const int16_t* frame, size_t samples, uint64_t ts) {
+    const size_t frames = std::min(samples / in_channels_, frame_);
+    int16_t* mono = (int16_t*)(msg_.data() + sizeof(uint64_t));
+    memcpy(msg_.data(), &ts, sizeof(ts));
+    for (size_t i = 0; i < frames; i++) mono[i] = frame[i * in_channels_];
+    xMessageBufferSend(input_, msg_.data(), sizeof(uint64_t) + frames * sizeof(int16_t), 0);
+}
+
+size_t FeatureStage::Take(Vector* out, size_t max) {
+    size_t n = 0;
+    while (n < max && xQueueReceive(output_, &out[n], 0) == pdTRUE) n++;
+    return n;
+}
+
+void FeatureStage::Reset() {
+    xQueueReset(output_);
+    event_.store(false);
+}
+
+void FeatureStage::Compute(const int16_t* pcm, size_t n, Vector& v) {
+    for (int i = 0; i < fft_n_; i++) {
+        fft_[2 * i] = (size_t)i < n ? pcm[i] * window_[i] * (1.0f / 32768.0f) : 0.0f;
+        fft_[2 * i + 1] = 0.0f;
+    }
+    dsps_fft2r_fc32(fft_.data(), fft_n_);
+    dsps_bit_rev_fc32(fft_.data(), fft_n_);
+
+    v.flags = 0;
+    int jumped = 0;
+    const float event_db = (float)CONFIG_STREAM_FEATURE_EVENT_DB;
+    const float* w = weights_.data();
+    for (int b = 0; b < BANDS; b++) {
+        float e = 0.0f;
+        for (int i = 0; i < band_len_[b]; i++) {
+            const float* x = &fft_[2 * (band_start_[b] + i)];
+            e += w[i] * (x[0] * x[0] + x[1] * x[1]);
+        }
+        w += band_len_[b];
+        float db = 10.0f * std::log10(e + 1e-20f) + norm_db_;
+        v.bands[b] = (uint8_t)std::clamp(std::lround((db + DB_OFFSET) * 2.0f), 0L, 255L);
+
+        if (!floor_init_) floor_db_[b] = db;
+        // Noise floor as in the VAD: follows drops within a few frames, rises over ~10 s
+        if (db > floor_db_[b] + event_db && db > FEATURE_ABS_MIN_DBFS) jumped++;
+        floor_db_[b] += (db < floor_db_[b]) ? (db - floor_db_[b]) * 0.2f : (db - floor_db_[b]) * 0.002f;
+    }
+    floor_init_ = true;
+    if (jumped >= FEATURE_EVENT_BANDS) v.flags |= FLAG_EVENT;
+}
+
+void FeatureStage::Task(void* arg) {
+    FeatureStage* self = static_cast<FeatureStage*>(arg);
+    std::vector<uint8_t> msg(self->msg_.size());
+    bool in_event = false;
+
+    while (true) {
+        size_t n = xMessageBufferReceive(self->input_, msg.data(), msg.size(), portMAX_DELAY);
+        if (n < sizeof(uint64_t)) continue;
+        Vector v;
+        memcpy(&v.ts, msg.data(), sizeof(v.ts));
+        self->Compute((const int16_t*)(msg.data() + sizeof(uint64_t)), (n - sizeof(uint64_t)) / sizeof(int16_t), v);
+
+        bool event = (v.flags & FLAG_EVENT) != 0;
+        if (event) self->event_.store(true);
+        if (event && !in_event) ESP_LOGI(TAG, "acoustic event");
+        in_event = event;
+        xQueueSend(self->output_, &v, 0);           // the uplink is behind: this vector is lost
+    }
+}
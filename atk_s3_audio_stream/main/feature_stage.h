@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/message_buffer.h>
+#include <freertos/queue.h>
+
+// Log-mel features for the acoustic-event uplink (STREAM_UPLINK_FEATURES).
+// The uplink task hands over each captured frame with Feed(), which only copies the first channel
+// into a message buffer and never blocks; a task pinned to core 1 windows the 20 ms frame, runs an
+// esp-dsp FFT and sums the power spectrum into BANDS mel bands, quantised to 0.5 dB steps. The same
+// task flags acoustic events: every band keeps a noise floor (fast down, slow up), and a frame where
+// at least EVENT_BANDS bands jump STREAM_FEATURE_EVENT_DB above their floor is an event.
+class FeatureStage {
+public:
+    static constexpr int BANDS = 32;
+    static constexpr int HOP_MS = 20;                   // one vector per captured frame
+    static constexpr uint8_t FLAG_EVENT = 0x01;
+
+    // Quantised band energy: (dBFS + DB_OFFSET) * 2, saturated to 0..255 (-120 .. +7.5 dBFS)
+    static constexpr float DB_OFFSET = 120.0f;
+
+    struct Vector {
+        uint64_t ts;                                    // capture time of the frame
+        uint8_t flags;
+        uint8_t bands[BANDS];
+    };
+
+    // in_rate / in_channels: the captured frames handed to Feed()
+    FeatureStage(int in_rate, int in_channels);
+
+    bool valid() const { return output_ != nullptr; }
+
+    // samples: interleaved int16 count of one captured frame. Drops the frame while the task is behind.
+    void Feed(const int16_t* frame, size_t samples, uint64_t ts);
+
+    // True once per event
+    bool TakeEvent() { return event_.exchange(false); }
+
+    size_t Pending() const { return uxQueueMessagesWaiting(output_); }
+
+    // Moves up to `max` finished vectors to out, oldest first; never blocks
+    size_t Take(Vector* out, size_t max);
+
+    // New connection: vectors and an event nobody took belong to the old one
+    void Reset();
+
+private:
+    static void Task(void* arg);
+    void Compute(const int16_t* pcm, size_t n, Vector& v);
+
+    int in_rate_;
+    int in_channels_;
+    size_t frame_;                                      // mono samples per captured frame
+    int fft_n_ = 0;                                     // frame zero-padded to a power of two
+    std::vector<float> window_;                         // Hann over one frame
+    std::vector<float> fft_;                            // interleaved re/im, fft_n_ points
+    std::vector<uint16_t> band_start_;                  // first FFT bin of each band
+    std::vector<uint16_t> band_len_;
+    std::vector<float> weights_;                        // triangle weights, bands back to back
+    float norm_db_ = 0.0f;                              // makes a full-scale sine 0 dBFS
+    float floor_db_[BANDS] = {};
+    bool floor_init_ = false;
+    MessageBufferHandle_t input_ = nullptr;             // ts + mono frame, Feed() -> Task()
+    QueueHandle_t output_ = nullptr;                    // Vector, Task() -> Take()
+    std::vector<uint8_t> msg_;                          // Feed() scratch (uplink task)
+    std::atomic<bool> event_{ false };
+};
@@ -0,0 +1,306 @@
+#include "latency_test.h"
+#include "audio_codec.h"
+
+#include <lwip/sockets.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <vector>
+
+static const char* TAG = "latency_test";
+
+#ifndef CONFIG_STREAM_LATENCY_TEST_REPORT_S
+#define CONFIG_STREAM_LATENCY_TEST_REPORT_S 10
+#endif
+
+static constexpr int CLICK_INTERVAL_MS = 1000;      // longer than any DMA profile's round trip, so an onset always belongs to the last burst
+static constexpr int CLICK_MS = 5;                  // burst length
+static constexpr int CLICK_HZ = 1000;               // burst tone, well inside the speaker's passband
+static constexpr float CLICK_AMPLITUDE = 16000.0f;
+static constexpr int ONSET_MIN_LEVEL = 2000;        // onset threshold never drops below this
+static constexpr int ONSET_FLOOR_RATIO = 8;         // and stays this far above the channel's noise peaks
+static constexpr int ECHO_INTERVAL_MS = 20;         // one echo per 20 ms, the pace of the audio packets
+static constexpr uint16_t ECHO_PAYLOAD = 960;       // same size as a 20 ms 24 kHz PCM packet
+static constexpr int ECHO_TIMEOUT_MS = 2000;        // no echo for this long: reconnect
+
+// Fixed-width latency histogram; the last bin collects everything beyond the range. Add() may run on
+// any task, Log() takes a snapshot under the same lock.
+class LatencyHistogram {
+public:
+    static constexpr size_t BINS = 512;
+
+    LatencyHistogram(const char* name, int32_t bin_us) : name_(name), bin_us_(bin_us) {}
+
+    void Add(int64_t us) {
+        if (us < 0) us = 0;
+        size_t bin = std::min((size_t)(us / bin_us_), BINS - 1);
+        portENTER_CRITICAL(&lock_);
+        bins_[bin]++;
+        min_ = count_ == 0 ? us : std::min(min_, us);
+        max_ = std::max(max_, us);
+        sum_ += us;
+        count_++;
+        portEXIT_CRITICAL(&lock_);
+    }
+
+    // Summary line with percentiles (bin resolution), then the non-empty bins as "from_ms:count"
+    void Log() {
+        std::vector<uint32_t> bins(BINS);
+        portENTER_CRITICAL(&lock_);
+        memcpy(bins.data(), bins_, sizeof(bins_));
+        uint32_t count = count_;
+        int64_t min = min_, max = max_, sum = sum_;
+        portEXIT_CRITICAL(&lock_);
+
+        if (count == 0) {
+            ESP_LOGI(TAG, "%-10s no samples", name_);
+            return;
+        }
+        ESP_LOGI(TAG, "%-10s n=%lu min %.2f mean %.2f p50 %.2f p90 %.2f p99 %.2f max %.2f ms", name_,
+                 (unsigned long)count, min / 1000.0, (double)sum / count / 1000.0, Percentile(bins, count, 50),
+                 Percentile(bins, count, 90), Percentile(bins, count, 99), max / 1000.0);
+
+        char line[160];
+        size_t len = 0;
+        for (size_t i = 0; i < BINS; i++) {
+            if (bins[i] == 0) continue;
+            int n = snprintf(line + len, sizeof(line) - len, " %g:%lu", i * bin_us_ / 1000.0, (unsigned long)bins[i]);
+            if (n < 0 || len + n >= sizeof(line) - 1) {
+                line[len] = '\0';
+                ESP_LOGI(TAG, "%-10s%s", name_, line);
+                len = 0;
+                n = snprintf(line, sizeof(line), " %g:%lu", i * bin_us_ / 1000.0, (unsigned long)bins[i]);
+            }
+            len += n;
+        }
+        if (len > 0) ESP_LOGI(TAG, "%-10s%s", name_, line);
+    }
+
+private:
+    // Upper edge of the bin holding the pct-th percentile, in ms
+    double Percentile(const std::vector<uint32_t>& bins, uint32_t count, int pct) const {
+        uint64_t want = ((uint64_t)count * pct + 99) / 100;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BINS; i++) {
+            seen += bins[i];
+            if (seen >= want) return (i + 1) * bin_us_ / 1000.0;
+        }
+        return BINS * bin_us_ / 1000.0;
+    }
+
+    const char* name_;
+    int32_t bin_us_;
+    portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t bins_[BINS] = {};
+    uint32_t count_ = 0;
+    int64_t min_ = 0;
+    int64_t max_ = 0;
+    int64_t sum_ = 0;
+};
+
+static LatencyHistogram g_ref_hist("dac->ref", 1000);       // up to 512 ms, covers the robust profile both ways
+static LatencyHistogram g_mic_hist("dac->mic", 1000);
+static LatencyHistogram g_rtt_hist("net rtt", 2000);
+static LatencyHistogram g_jitter_hist("net jitter", 500);
+
+static std::atomic<int64_t> g_click_us{0};                  // when the latest burst was handed to OutputData
+static std::atomic<uint32_t> g_clicks{0};
+static std::atomic<uint32_t> g_echo_sent{0};
+static std::atomic<uint32_t> g_echo_lost{0};
+
+// Onset detector for one input channel: the first sample of a block that rises well above the noise
+// peaks seen in blocks without a burst. Each burst is matched at most once.
+class OnsetDetector {
+public:
+    OnsetDetector(LatencyHistogram& hist, int channel) : hist_(hist), channel_(channel) {}
+
+    uint32_t detected() const { return detected_; }
+
+    void Scan(const int16_t* frames, size_t n, int channels, int sample_rate, int64_t capture_us) {
+        const int threshold = std::max(ONSET_MIN_LEVEL, floor_ * ONSET_FLOOR_RATIO);
+        int peak = 0;
+        for (size_t i = 0; i < n; i++) {
+            int v = abs(frames[i * channels + channel_]);
+            if (v > threshold) {
+                Onset(capture_us + (int64_t)i * 1000000 / sample_rate);
+                return;
+            }
+            peak = std::max(peak, v);
+        }
+        floor_ += (peak - floor_) / 8;
+    }
+
+private:
+    void Onset(int64_t onset_us) {
+        int64_t click_us = g_click_us.load(std::memory_order_acquire);
+        // Ringing of a burst already matched, or noise before the first one
+        if (click_us == 0 || click_us == matched_us_ || onset_us < click_us) return;
+        if (onset_us - click_us >= CLICK_INTERVAL_MS * 1000) return;
+        matched_us_ = click_us;
+        detected_++;
+        hist_.Add(onset_us - click_us);
+    }
+
+    LatencyHistogram& hist_;
+    int channel_;
+    int floor_ = 0;
+    int64_t matched_us_ = 0;
+    uint32_t detected_ = 0;
+};
+
+static OnsetDetector* g_mic_onset = nullptr;
+static OnsetDetector* g_ref_onset = nullptr;
+
+// Continuous 20 ms blocks keep the TX DMA in the same steady state as streaming playback; one block
+// per interval starts with the burst
+static void click_task(void* arg) {
+    AudioCodec* codec = static_cast<AudioCodec*>(arg);
+    const int sample_rate = codec->output_sample_rate();
+    const size_t block = (size_t)sample_rate / 50;
+    std::vector<int16_t> silence(block);
+    std::vector<int16_t> burst(block);
+    for (size_t i = 0; i < (size_t)(sample_rate * CLICK_MS / 1000) && i < block; i++) {
+        burst[i] = (int16_t)(CLICK_AMPLITUDE * sinf(2.0f * (float)M_PI * CLICK_HZ * i / sample_rate));
+    }
+
+    codec->EnableOutput(true);
+    const int blocks_per_click = CLICK_INTERVAL_MS / 20;
+    for (uint32_t n = 0;; n++) {
+        const bool click = n % blocks_per_click == 0;
+        const std::vector<int16_t>& pcm = click ? burst : silence;
+        if (click) {
+            g_click_us.store(esp_timer_get_time(), std::memory_order_release);
+            g_clicks.fetch_add(1, std::memory_order_relaxed);
+        }
+        codec->OutputData(std::span<const int16_t>(pcm.data(), pcm.size()), portMAX_DELAY);
+    }
+}
+
+static void detect_task(void* arg) {
+    AudioCodec* codec = static_cast<AudioCodec*>(arg);
+    const int channels = codec->input_channels();
+    const int sample_rate = codec->input_sample_rate();
+    const size_t frames = (size_t)sample_rate / 50;
+    std::vector<int16_t> buf(frames * channels);
+
+    codec->EnableInput(true);
+    while (true) {
+        int64_t capture_us;
+        if (!codec->InputData(buf.data(), (int)buf.size(), &capture_us)) {
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+        g_mic_onset->Scan(buf.data(), frames, channels, sample_rate, capture_us);
+        if (g_ref_onset != nullptr) g_ref_onset->Scan(buf.data(), frames, channels, sample_rate, capture_us);
+    }
+}
+
+// Timestamped packets through the bridge and back. Both ends of the round trip use esp_timer, so no
+// clock sync is needed; a sequence number in the payload counts echoes that never came back.
+static void echo_task(void* arg) {
+    NetConfig* cfg = static_cast<NetConfig*>(arg);
+    std::vector<uint8_t> tx(sizeof(PcmHeader) + ECHO_PAYLOAD);
+    std::vector<uint8_t> rx(ECHO_PAYLOAD);
+
+    while (true) {
+        int sock = connect_to(*cfg);
+        if (sock < 0) { vTaskDelay(pdMS_TO_TICKS(2000)); continue; }
+
+        const char hello[] = "HELLO-EC";
+        bool ok = send_all(sock, (const uint8_t*)hello, sizeof(hello) - 1);
+        uint32_t seq = 0;
+        uint32_t expect = 0;
+        int64_t last_rtt = -1;
+        int64_t next_send = esp_timer_get_time();
+        int64_t last_rx = next_send;
+
+        while (ok) {
+            int64_t now = esp_timer_get_time();
+            if (now >= next_send) {
+                PcmHeader hdr{ PCM_MAGIC, PCM_TYPE_ECHO, ECHO_PAYLOAD, (uint64_t)now };
+                memcpy(tx.data(), &hdr, sizeof(hdr));
+                memcpy(tx.data() + sizeof(hdr), &seq, sizeof(seq));
+                seq++;
+                g_echo_sent.fetch_add(1, std::memory_order_relaxed);
+                ok = send_all(sock, tx.data(), tx.size());
+                // After a stalled send keep the 20 ms spacing instead of sending a burst to catch up
+                next_send = std::max(next_send + ECHO_INTERVAL_MS * 1000, now);
+                continue;
+            }
+            if (now - last_rx > ECHO_TIMEOUT_MS * 1000) {
+                ESP_LOGW(TAG, "no echo for %d ms, is the bridge up to date?", ECHO_TIMEOUT_MS);
+                break;
+            }
+
+            // Wait for an echo until the next packet is due
+            fd_set rfds;
+            FD_ZERO(&rfds);
+            FD_SET(sock, &rfds);
+            struct timeval tv = { 0, (long)(next_send - now) };
+            int ret = ::select(sock + 1, &rfds, nullptr, nullptr, &tv);
+            if (ret < 0) break;
+            if (ret == 0) continue;
+
+            PcmHeader hdr;
+            if (!recv_all(sock, (uint8_t*)&hdr, sizeof(hdr))) break;
+            if (hdr.magic != PCM_MAGIC || hdr.type != PCM_TYPE_ECHO || hdr.len != ECHO_PAYLOAD) {
+                ESP_LOGW(TAG, "Invalid echo: magic=%08x type=%u len=%u", hdr.magic, hdr.type, hdr.len);
+                break;
+            }
+            if (!recv_all(sock, rx.data(), rx.size())) break;
+            last_rx = esp_timer_get_time();
+
+            uint32_t got;
+            memcpy(&got, rx.data(), sizeof(got));
+            if ((int32_t)(got - expect) > 0) g_echo_lost.fetch_add(got - expect, std::memory_order_relaxed);
+            expect = got + 1;
+
+            // Consecutive round trips differ by the queueing a jitter buffer has to absorb
+            int64_t rtt = last_rx - (int64_t)hdr.timestamp_us;
+            g_rtt_hist.Add(rtt);
+            if (last_rtt >= 0) g_jitter_hist.Add(llabs(rtt - last_rtt));
+            last_rtt = rtt;
+        }
+        ::close(sock);
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+static void report_task(void* arg) {
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_STREAM_LATENCY_TEST_REPORT_S * 1000));
+        ESP_LOGI(TAG, "bursts %lu, detected ref %lu mic %lu; echoes sent %lu lost %lu",
+                 (unsigned long)g_clicks.load(), (unsigned long)(g_ref_onset ? g_ref_onset->detected() : 0),
+                 (unsigned long)g_mic_onset->detected(), (unsigned long)g_echo_sent.load(),
+                 (unsigned long)g_echo_lost.load());
+        g_ref_hist.Log();
+        g_mic_hist.Log();
+        g_rtt_hist.Log();
+        g_jitter_hist.Log();
+    }
+}
+
+void start_latency_test(AudioCodec* codec, const NetConfig& cfg) {
+    g_mic_onset = new OnsetDetector(g_mic_hist, 0);
+    if (codec->input_reference()) {
+        g_ref_onset = new OnsetDetector(g_ref_hist, 1);
+    } else {
+        ESP_LOGW(TAG, "codec has no DAC reference channel, only dac->mic is measured");
+    }
+    ESP_LOGI(TAG, "latency test: burst every %d ms, echo every %d ms, report every %d s",
+             CLICK_INTERVAL_MS, ECHO_INTERVAL_MS, CONFIG_STREAM_LATENCY_TEST_REPORT_S);
+
+    // Same priorities as the stream tasks they stand in for: capture above playback above network
+    xTaskCreate(&detect_task, "lat_detect", 4096, codec, 8, nullptr);
+    xTaskCreate(&click_task, "lat_click", 3072, codec, 6, nullptr);
+    xTaskCreate(&echo_task, "lat_echo", 4096, new NetConfig(cfg), 5, nullptr);
+    xTaskCreate(&report_task, "lat_report", 4096, nullptr, 2, nullptr);
+}
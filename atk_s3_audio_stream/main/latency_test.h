@@ -0,0 +1,17 @@
+#pragma once
+#include "net_stream.h"
+
+class AudioCodec;
+
+// Loopback latency test, run instead of the stream tasks (CONFIG_STREAM_LATENCY_TEST).
+// The codec must capture with input_reference = true: frames are [mic, DAC reference].
+//
+// Codec path: a short tone burst is written into OutputData once per interval and its onset is
+// detected on both input channels. dac->ref is the electrical ES8388 loopback (TX DMA + DAC + ADC +
+// RX DMA); dac->mic adds the speaker and the air gap to the microphone. Both are measured from
+// the moment the burst is handed to OutputData to the capture time of its first detected sample.
+// Network path: a 20 ms PcmHeader type 5 packet stamped with its send time goes out every 20 ms on
+// a "HELLO-EC" connection; the bridge returns it unchanged. net rtt is the round trip, net jitter the
+// change in transit time between consecutive echoes (RFC 3550 D), which is what the jitter buffer absorbs.
+// Per-stage histograms are logged every CONFIG_STREAM_LATENCY_TEST_REPORT_S seconds.
+void start_latency_test(AudioCodec* codec, const NetConfig& cfg);
@@ -2,20 +2,62 @@
 #include <cstring>
 #include <string>
 #include <esp_log.h>
+#include <esp_mac.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <driver/i2c_master.h>
 #include <driver/gpio.h>
+#include <nvs_flash.h>
 
 #include "wifi.h"
 #include "net_stream.h"
+#include "latency_test.h"
+#include "usb_audio.h"
 
 #include "es8388_audio_codec.h"
+#include "es7210_audio_codec.h"
+#include "shared_i2c.h"
 
 static const char* TAG = "main";
 
 // ATK-DNESP32S3 audio pins and params (from repo config)
-static constexpr int INPUT_SR = 24000;
-static constexpr int OUTPUT_SR = 24000;
+#ifndef CONFIG_STREAM_AEC
+#define CONFIG_STREAM_AEC 0
+#endif
+#ifndef CONFIG_STREAM_LATENCY_TEST
+#define CONFIG_STREAM_LATENCY_TEST 0
+#endif
+#ifndef CONFIG_STREAM_USB_AUDIO
+#define CONFIG_STREAM_USB_AUDIO 0
+#endif
+#ifndef CONFIG_STREAM_MIC_ARRAY
+#define CONFIG_STREAM_MIC_ARRAY 0
+#endif
+#ifndef CONFIG_UAC_SAMPLE_RATE
+#define CONFIG_UAC_SAMPLE_RATE 48000
+#endif
 
+// With AEC the mic is captured with its DAC reference at the 16 kHz the esp-sr AFE needs;
+// as a USB sound card both directions run at the rate the UAC descriptors announce
+static constexpr int INPUT_SR = CONFIG_STREAM_USB_AUDIO ? CONFIG_UAC_SAMPLE_RATE : CONFIG_STREAM_AEC ? 16000 : 24000;
+// The latency test detects its bursts on the DAC reference as well as on the mic
+static constexpr bool INPUT_REFERENCE = CONFIG_STREAM_AEC || CONFIG_STREAM_LATENCY_TEST;
+static constexpr int OUTPUT_SR = CONFIG_STREAM_USB_AUDIO ? CONFIG_UAC_SAMPLE_RATE : 24000;
+
+#if CONFIG_STREAM_MIC_ARRAY
+// ES7210 + ES8311 mic-array board, ESP32-S3-Korvo-2 V3 wiring
+static constexpr gpio_num_t PIN_MCLK = GPIO_NUM_16;
+static constexpr gpio_num_t PIN_WS   = GPIO_NUM_45;
+static constexpr gpio_num_t PIN_BCLK = GPIO_NUM_9;
+static constexpr gpio_num_t PIN_DIN  = GPIO_NUM_10; // ES7210 TDM -> ESP DIN
+static constexpr gpio_num_t PIN_DOUT = GPIO_NUM_8;  // ESP DOUT -> ES8311
+static constexpr gpio_num_t PIN_PA   = GPIO_NUM_48;
+
+static constexpr gpio_num_t I2C_SDA = GPIO_NUM_17;
+static constexpr gpio_num_t I2C_SCL = GPIO_NUM_18;
+static constexpr uint8_t ES8311_ADDR = ES8311_CODEC_DEFAULT_ADDR;
+static constexpr uint8_t ES7210_ADDR = ES7210_CODEC_DEFAULT_ADDR;
+#else
 static constexpr gpio_num_t PIN_MCLK = GPIO_NUM_3;
 static constexpr gpio_num_t PIN_WS   = GPIO_NUM_9;
 static constexpr gpio_num_t PIN_BCLK = GPIO_NUM_46;
@@ -25,6 +67,7 @@ static constexpr gpio_num_t PIN_DOUT = GPIO_NUM_10; // ESP DOUT -> SPK
 static constexpr gpio_num_t I2C_SDA = GPIO_NUM_41;
 static constexpr gpio_num_t I2C_SCL = GPIO_NUM_42;
 static constexpr uint8_t ES8388_ADDR = ES8388_CODEC_DEFAULT_ADDR;
+#endif
 
 // Configurable via menuconfig (defaults provided in Kconfig)
 #ifndef CONFIG_STREAM_SERVER_HOST
@@ -33,17 +76,56 @@ static constexpr uint8_t ES8388_ADDR = ES8388_CODEC_DEFAULT_ADDR;
 #ifndef CONFIG_STREAM_SERVER_PORT
 #define CONFIG_STREAM_SERVER_PORT 9002
 #endif
+#ifndef CONFIG_STREAM_ROOM
+#define CONFIG_STREAM_ROOM "default"
+#endif
+#ifndef CONFIG_STREAM_BOARD_ID
+#define CONFIG_STREAM_BOARD_ID ""
+#endif
+
+#if defined(CONFIG_STREAM_AUDIO_DMA_LOW_LATENCY)
+static constexpr AudioDmaProfile DMA_PROFILE = AUDIO_DMA_PROFILE_LOW_LATENCY;
+#elif defined(CONFIG_STREAM_AUDIO_DMA_ROBUST)
+static constexpr AudioDmaProfile DMA_PROFILE = AUDIO_DMA_PROFILE_ROBUST;
+#else
+static constexpr AudioDmaProfile DMA_PROFILE = AUDIO_DMA_PROFILE_DEFAULT;
+#endif
+
+static constexpr int I2S_STATS_INTERVAL_MS = 10000;
+
+// "<room>/<board>"; without a configured name the board is "esp-" + the last three bytes of its STA MAC
+static std::string board_id() {
+    std::string id = CONFIG_STREAM_BOARD_ID;
+    if (id.empty()) {
+        uint8_t mac[6] = {};
+        esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        char buf[16];
+        snprintf(buf, sizeof(buf), "esp-%02x%02x%02x", mac[3], mac[4], mac[5]);
+        id = buf;
+    }
+    return std::string(CONFIG_STREAM_ROOM) + "/" + id;
+}
 
 extern "C" void app_main(void) {
     ESP_LOGI(TAG, "Starting atk_s3_audio_stream");
 
+#if CONFIG_STREAM_USB_AUDIO
+    // No network as a USB sound card; NVS still backs the codec settings (output volume)
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+#else
     if (!wifi_init_and_connect()) {
         ESP_LOGE(TAG, "WiFi connect failed");
         return;
     }
+#endif
 
-    // I2C bus for ES8388
-    i2c_master_bus_handle_t i2c_bus = nullptr;
+    // I2C bus for the codec. In a combined image the camera BSP owns the bus; reuse it
+    i2c_master_bus_handle_t i2c_bus = myiic_bus_get ? myiic_bus_get() : nullptr;
     i2c_master_bus_config_t i2c_bus_cfg = {
         .i2c_port = I2C_NUM_0,
         .sda_io_num = I2C_SDA,
@@ -54,8 +136,27 @@ extern "C" void app_main(void) {
         .trans_queue_depth = 0,
         .flags = { .enable_internal_pullup = 1 },
     };
-    ESP_ERROR_CHECK(i2c_new_master_bus(&i2c_bus_cfg, &i2c_bus));
+    if (i2c_bus == nullptr) {
+        ESP_ERROR_CHECK(i2c_new_master_bus(&i2c_bus_cfg, &i2c_bus));
+    }
 
+#if CONFIG_STREAM_MIC_ARRAY
+    static Es7210AudioCodec audio_codec(
+        i2c_bus,
+        I2C_NUM_0,
+        INPUT_SR,
+        OUTPUT_SR,
+        PIN_MCLK,
+        PIN_BCLK,
+        PIN_WS,
+        PIN_DOUT,
+        PIN_DIN,
+        PIN_PA,
+        ES8311_ADDR,
+        ES7210_ADDR,
+        DMA_PROFILE
+    );
+#else
     static Es8388AudioCodec audio_codec(
         i2c_bus,
         I2C_NUM_0,
@@ -68,12 +169,36 @@ extern "C" void app_main(void) {
         PIN_DIN,
         GPIO_NUM_NC,
         ES8388_ADDR,
-        false /* input_reference */
+        INPUT_REFERENCE,
+        DMA_PROFILE
     );
+#endif
 
     audio_codec.Start();
 
-    NetConfig cfg{ std::string(CONFIG_STREAM_SERVER_HOST), (uint16_t)CONFIG_STREAM_SERVER_PORT };
+#if CONFIG_STREAM_USB_AUDIO
+    start_usb_audio(&audio_codec);
+#else
+    NetConfig cfg{ std::string(CONFIG_STREAM_SERVER_HOST), (uint16_t)CONFIG_STREAM_SERVER_PORT, board_id() };
+    ESP_LOGI(TAG, "Board %s", cfg.board_id.c_str());
+#if CONFIG_STREAM_LATENCY_TEST
+    start_latency_test(&audio_codec, cfg);
+#else
     start_stream_tasks(&audio_codec, cfg);
+#endif
+#endif
+
+    // Report new DMA overflow/underflow events so the profile can be tuned from data
+    AudioI2sStats last = audio_codec.i2s_stats();
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(I2S_STATS_INTERVAL_MS));
+        AudioI2sStats now = audio_codec.i2s_stats();
+        if (now.rx_overflow != last.rx_overflow || now.tx_underflow != last.tx_underflow) {
+            ESP_LOGW(TAG, "I2S rx overflow %lu (+%lu), tx underflow %lu (+%lu)",
+                     (unsigned long)now.rx_overflow, (unsigned long)(now.rx_overflow - last.rx_overflow),
+                     (unsigned long)now.tx_underflow, (unsigned long)(now.tx_underflow - last.tx_underflow));
+        }
+        last = now;
+    }
 }
 
@@ -1,34 +1,530 @@
 #include "net_stream.h"
 #include "audio_codec.h"
+#include "pcm_dsp.h"
+#include "ima_adpcm.h"
 
 #include <lwip/sockets.h>
 #include <lwip/netdb.h>
+#include <fcntl.h>
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/queue.h>
+#include <esp_timer.h>
+#include <esp_random.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <memory>
+#include <cstdlib>
 #include <cstring>
+#if CONFIG_STREAM_UPLINK_OPUS
+#include <opus.h>
+#endif
+#include "pcm_resampler.h"
+#if CONFIG_STREAM_AEC
+#include "aec_stage.h"
+#endif
+#if CONFIG_STREAM_MIC_ARRAY
+#include "mic_beamformer.h"
+#endif
+#if CONFIG_STREAM_WAKE_WORD
+#include "wake_stage.h"
+#endif
+#if CONFIG_STREAM_UPLINK_FEATURES
+#include "feature_stage.h"
+#endif
 
 static const char* TAG = "net_stream";
 
-// Packet header: magic 'PCM0', type(1=mic_up,2=spk_down), len (bytes)
-struct __attribute__((packed)) PcmHeader {
-    uint32_t magic;
-    uint8_t type;
-    uint16_t len;
+#ifndef CONFIG_STREAM_DUPLEX
+#define CONFIG_STREAM_DUPLEX 0
+#endif
+#ifndef CONFIG_STREAM_UPLINK_OPUS
+#define CONFIG_STREAM_UPLINK_OPUS 0
+#endif
+#ifndef CONFIG_STREAM_UPLINK_ADPCM
+#define CONFIG_STREAM_UPLINK_ADPCM 0
+#endif
+#ifndef CONFIG_STREAM_DOWNLINK_ADPCM
+#define CONFIG_STREAM_DOWNLINK_ADPCM 0
+#endif
+#ifndef CONFIG_STREAM_DRIFT_COMP
+#define CONFIG_STREAM_DRIFT_COMP 0
+#endif
+#ifndef CONFIG_STREAM_AEC
+#define CONFIG_STREAM_AEC 0
+#endif
+#ifndef CONFIG_STREAM_MIC_ARRAY
+#define CONFIG_STREAM_MIC_ARRAY 0
+#endif
+#ifndef CONFIG_STREAM_VAD
+#define CONFIG_STREAM_VAD 0
+#endif
+#ifndef CONFIG_STREAM_WAKE_WORD
+#define CONFIG_STREAM_WAKE_WORD 0
+#endif
+#ifndef CONFIG_STREAM_UPLINK_FEATURES
+#define CONFIG_STREAM_UPLINK_FEATURES 0
+#endif
+#ifndef CONFIG_STREAM_CAPTURE_RING_MS
+#define CONFIG_STREAM_CAPTURE_RING_MS 400
+#endif
+#ifndef CONFIG_STREAM_SERVER_SPREAD
+#define CONFIG_STREAM_SERVER_SPREAD 0
+#endif
+#ifndef CONFIG_STREAM_DSCP_TCP
+#define CONFIG_STREAM_DSCP_TCP 0
+#endif
+#ifndef CONFIG_STREAM_DSCP_RTP
+#define CONFIG_STREAM_DSCP_RTP 0
+#endif
+#if defined(CONFIG_STREAM_TRANSPORT_RTP)
+#define STREAM_TRANSPORT_RTP 1
+#else
+#define STREAM_TRANSPORT_RTP 0
+#endif
+#if defined(CONFIG_STREAM_CAPTURE_DROP_NEWEST)
+static constexpr bool CAPTURE_DROP_OLDEST = false;
+#else
+static constexpr bool CAPTURE_DROP_OLDEST = true;
+#endif
+
+static constexpr int64_t PCM_RESYNC_US = 5000;     // re-anchor when the sample clock drifts from esp_timer (e.g. DMA overrun)
+static constexpr uint16_t PCM_MAX_LEN = 2048;      // larger downlink packets are treated as a corrupt stream (20 ms = 960 B)
+static constexpr int PCM_PLAYBACK_BUFFERS = 10;    // jitter buffer capacity (~200 ms of 20 ms packets)
+
+static constexpr size_t OPUS_MAX_PACKET = 1275;    // largest single-frame Opus packet (RFC 6716)
+static constexpr size_t ADPCM_MAX_LEN = IMA_ADPCM_BLOCK_BYTES(PCM_MAX_LEN / sizeof(int16_t)); // one block fills at most a jitter buffer slot
+
+// Dead-peer detection (AP roam, PC asleep without a FIN): an idle connection is probed after
+// KEEPIDLE s and dropped after KEEPCNT unanswered probes KEEPINTVL s apart; a send() that makes no
+// progress for SEND_TIMEOUT_MS fails, so send_all() reports a disconnect. Roughly 3 s either way.
+static constexpr int TCP_KEEPALIVE_IDLE_S = 1;
+static constexpr int TCP_KEEPALIVE_INTVL_S = 1;
+static constexpr int TCP_KEEPALIVE_CNT = 2;
+static constexpr int TCP_SEND_TIMEOUT_MS = 2000;
+
+// CONFIG_STREAM_SERVER_HOST may list several bridges, comma-separated. A dead one is skipped after
+// CONNECT_TIMEOUT_MS instead of the lwIP SYN retry budget (~20 s), so a standby takes over quickly.
+static constexpr int TCP_CONNECT_TIMEOUT_MS = 1500;
+
+// WMM: the Wi-Fi driver takes the 802.11 user priority from the top three TOS bits (DSCP >> 3), so
+// EF (46) puts voice on AC_VO ahead of bulk traffic from other stations and from a camera sharing
+// the AP. Set before connect() so the SYN and every retransmission carry the same mark.
+static void set_dscp(int sock, int dscp) {
+    if (dscp <= 0) return;
+    int tos = dscp << 2;
+    if (::setsockopt(sock, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) != 0) {
+        ESP_LOGW(TAG, "IP_TOS %d not set: errno %d", tos, errno);
+    }
+}
+
+// What the uplink carries. With AEC the codec captures mic + reference at 16 kHz, and only the
+// cleaned mono signal goes out, converted back to the 24 kHz the bridge and web page expect.
+// A mic array captures every ES7210 slot and sends only the beamformed channel.
+static constexpr int AEC_UPLINK_RATE = 24000;
+
+static int uplink_rate(const AudioCodec* codec) {
+    return CONFIG_STREAM_AEC ? AEC_UPLINK_RATE : codec->input_sample_rate();
+}
+
+static int uplink_channels(const AudioCodec* codec) {
+    return (CONFIG_STREAM_AEC || CONFIG_STREAM_MIC_ARRAY) ? 1 : codec->input_channels();
+}
+
+static bool pcm_header_valid(const PcmHeader& hdr, uint8_t type) {
+    return hdr.magic == PCM_MAGIC && hdr.type == type && hdr.len != 0 &&
+           hdr.len <= PCM_MAX_LEN && (hdr.len & 1) == 0;
+}
+
+// Speaker packets are raw PCM or, when the bridge honours STREAM_DOWNLINK_ADPCM, one IMA-ADPCM block
+static bool spk_header_valid(const PcmHeader& hdr) {
+    if (hdr.magic == PCM_MAGIC && hdr.type == PCM_TYPE_SPK_ADPCM) {
+        return hdr.len > IMA_ADPCM_HEADER_BYTES && hdr.len <= ADPCM_MAX_LEN;
+    }
+    return pcm_header_valid(hdr, PCM_TYPE_SPK);
+}
+
+// Timestamps follow the sample count from an anchor so the server sees exactly one frame of audio
+// time per packet; the anchor moves only when the DMA-measured capture time drifts away (lost samples)
+class PcmClock {
+public:
+    PcmClock(int sample_rate, size_t frame_samples)
+        : sample_rate_(sample_rate), frame_samples_(frame_samples) {}
+
+    // capture_us: time of the frame's first sample as reported by InputData; returns its timestamp
+    uint64_t Stamp(int64_t capture_us) {
+        int64_t expected = base_us_ + (int64_t)(count_ * 1000000ULL / sample_rate_);
+        if (base_us_ == 0 || llabs(capture_us - expected) > PCM_RESYNC_US) {
+            base_us_ = capture_us;
+            count_ = 0;
+            expected = capture_us;
+        }
+        count_ += frame_samples_;
+        return (uint64_t)expected;
+    }
+
+    void Reset() { base_us_ = 0; count_ = 0; }
+
+private:
+    int sample_rate_;
+    size_t frame_samples_;
+    int64_t base_us_ = 0;
+    uint64_t count_ = 0;
 };
-static constexpr uint32_t PCM_MAGIC = 0x304D4350u; // 'PCM0'
 
-static bool send_all(int sock, const uint8_t* data, size_t len) {
+// Builds one uplink packet per mic frame: the codec reads straight into samples(), Pack() adds
+// the header (and encodes to Opus or IMA-ADPCM when enabled) and returns the bytes to send from data().
+class UplinkPacket {
+public:
+    UplinkPacket(int sample_rate, int channels, size_t frame_samples)
+        : frame_samples_(frame_samples), frame_len_(frame_samples * channels),
+          pcm_(hdr_words + frame_len_) {
+#if CONFIG_STREAM_UPLINK_OPUS
+        int err = OPUS_OK;
+        enc_ = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &err);
+        if (enc_ == nullptr) {
+            ESP_LOGE(TAG, "opus_encoder_create failed: %d", err);
+        } else {
+            opus_encoder_ctl(enc_, OPUS_SET_BITRATE(CONFIG_STREAM_OPUS_BITRATE));
+            opus_encoder_ctl(enc_, OPUS_SET_COMPLEXITY(CONFIG_STREAM_OPUS_COMPLEXITY));
+            opus_encoder_ctl(enc_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+            opus_.resize(sizeof(PcmHeader) + OPUS_MAX_PACKET);
+            ESP_LOGI(TAG, "Opus uplink: %d bit/s, complexity %d", CONFIG_STREAM_OPUS_BITRATE, CONFIG_STREAM_OPUS_COMPLEXITY);
+        }
+#else
+        (void)sample_rate;
+#endif
+#if CONFIG_STREAM_UPLINK_ADPCM
+        adpcm_state_.resize(channels);
+        adpcm_.resize(sizeof(PcmHeader) + channels * IMA_ADPCM_BLOCK_BYTES(frame_samples));
+        ESP_LOGI(TAG, "IMA-ADPCM uplink: %u bytes per 20 ms", (unsigned)(adpcm_.size() - sizeof(PcmHeader)));
+#endif
+    }
+
+    int16_t* samples() { return pcm_.data() + hdr_words; }
+    size_t frame_len() const { return frame_len_; }
+    const uint8_t* data() const { return data_; }
+
+    // Returns the packet length, 0 if the frame could not be encoded
+    size_t Pack(uint64_t timestamp_us) {
+#if CONFIG_STREAM_UPLINK_OPUS
+        if (enc_ != nullptr) {
+            int n = opus_encode(enc_, samples(), (int)frame_samples_, opus_.data() + sizeof(PcmHeader), OPUS_MAX_PACKET);
+            if (n <= 0) {
+                ESP_LOGW(TAG, "opus_encode failed: %d", n);
+                return 0;
+            }
+            PcmHeader hdr{ PCM_MAGIC, PCM_TYPE_MIC_OPUS, (uint16_t)n, timestamp_us };
+            memcpy(opus_.data(), &hdr, sizeof(hdr));
+            data_ = opus_.data();
+            return sizeof(hdr) + (size_t)n;
+        }
+#endif
+#if CONFIG_STREAM_UPLINK_ADPCM
+        {
+            // One block per channel, each read from the interleaved frame with a stride
+            const size_t channels = adpcm_state_.size();
+            size_t n = 0;
+            for (size_t ch = 0; ch < channels; ch++) {
+                n += ima_adpcm_encode(adpcm_state_[ch], samples() + ch, frame_samples_, channels,
+                                      adpcm_.data() + sizeof(PcmHeader) + n);
+            }
+            PcmHeader hdr{ PCM_MAGIC, PCM_TYPE_MIC_ADPCM, (uint16_t)n, timestamp_us };
+            memcpy(adpcm_.data(), &hdr, sizeof(hdr));
+            data_ = adpcm_.data();
+            return sizeof(hdr) + n;
+        }
+#endif
+        // Raw PCM: the header sits right in front of the samples, which start on a 16-bit boundary
+        const size_t bytes = frame_len_ * sizeof(int16_t);
+        PcmHeader hdr{ PCM_MAGIC, PCM_TYPE_MIC, (uint16_t)bytes, timestamp_us };
+        data_ = (const uint8_t*)samples() - sizeof(hdr);
+        memcpy((uint8_t*)data_, &hdr, sizeof(hdr));
+        return sizeof(hdr) + bytes;
+    }
+
+    // New connection: the decoder on the other end starts from scratch
+    void Reset() {
+#if CONFIG_STREAM_UPLINK_OPUS
+        if (enc_ != nullptr) opus_encoder_ctl(enc_, OPUS_RESET_STATE);
+#endif
+#if CONFIG_STREAM_UPLINK_ADPCM
+        for (auto& st : adpcm_state_) st = ImaAdpcmState();
+#endif
+    }
+
+private:
+    static constexpr size_t hdr_words = (sizeof(PcmHeader) + sizeof(int16_t) - 1) / sizeof(int16_t);
+
+    size_t frame_samples_;
+    size_t frame_len_;
+    std::vector<int16_t> pcm_;
+    const uint8_t* data_ = nullptr;
+#if CONFIG_STREAM_UPLINK_OPUS
+    OpusEncoder* enc_ = nullptr;
+    std::vector<uint8_t> opus_;
+#endif
+#if CONFIG_STREAM_UPLINK_ADPCM
+    std::vector<ImaAdpcmState> adpcm_state_;
+    std::vector<uint8_t> adpcm_;
+#endif
+};
+
+// Voice-activity gate in front of UplinkPacket. Speech goes out frame by frame; silence is held back
+// except for a keepalive (type 4, current noise level) every STREAM_VAD_KEEPALIVE_MS. When speech
+// starts, the last STREAM_VAD_PREROLL_MS of held-back frames go out first so onsets are not clipped,
+// and STREAM_VAD_HANGOVER_MS after the last voiced frame keeps word endings and short pauses.
+//
+// Detection is energy against an adaptive noise floor (fast down, slow up), with a lower threshold
+// for frames with a high zero-crossing rate so unvoiced fricatives still count as speech.
+// With STREAM_WAKE_WORD speech alone does not open the gate: held-back frames also go to WakeNet,
+// and a detection releases the last STREAM_WAKE_PREROLL_MS (the wake word itself) and keeps the gate
+// open for STREAM_WAKE_LISTEN_MS, or until the VAD hangover after the command runs out.
+// With STREAM_UPLINK_FEATURES every frame goes to the feature stage instead, its log-mel vectors
+// take the place of the keepalives, and only an acoustic event opens the gate, for
+// STREAM_FEATURE_EVENT_MS after the pre-roll.
+// Without STREAM_VAD every frame is due and is captured straight into the packet.
+#if CONFIG_STREAM_WAKE_WORD
+static WakeStage* g_wake = nullptr;         // nullptr when WakeNet is unavailable: plain VAD gating
+#endif
+#if CONFIG_STREAM_UPLINK_FEATURES
+static FeatureStage* g_features = nullptr;  // nullptr when the FFT is unavailable: plain VAD gating
+#endif
+
+class UplinkGate {
+public:
+    UplinkGate(UplinkPacket& packet) : packet_(packet) {
+#if CONFIG_STREAM_WAKE_WORD
+        slots_ = CONFIG_STREAM_WAKE_PREROLL_MS / 20 + 1;
+#elif CONFIG_STREAM_VAD
+        slots_ = CONFIG_STREAM_VAD_PREROLL_MS / 20 + 1;
+#endif
+#if CONFIG_STREAM_VAD
+        frames_.resize(slots_ * packet.frame_len());
+        ts_.resize(slots_);
+#endif
+    }
+
+    // Where the next captured frame goes
+    int16_t* Slot() {
+#if CONFIG_STREAM_VAD
+        return frames_.data() + head_ * packet_.frame_len();
+#else
+        return packet_.samples();
+#endif
+    }
+
+    // Classify the frame just written to Slot(); returns how many frames are now due, oldest first
+    size_t Commit(uint64_t ts) {
+#if CONFIG_STREAM_VAD
+        const size_t idx = head_;
+        ts_[idx] = ts;
+        head_ = (head_ + 1) % slots_;
+        buffered_ = std::min(buffered_ + 1, slots_);
+
+        const int16_t* frame = frames_.data() + idx * packet_.frame_len();
+        bool voiced = Voiced(frame, packet_.frame_len());
+#if CONFIG_STREAM_UPLINK_FEATURES
+        if (g_features != nullptr) {
+            g_features->Feed(frame, packet_.frame_len(), ts);
+            if (g_features->TakeEvent()) hang_ = CONFIG_STREAM_FEATURE_EVENT_MS / 20;
+            voiced = false;
+        }
+#endif
+#if CONFIG_STREAM_WAKE_WORD
+        if (!talking_ && g_wake != nullptr) {
+            g_wake->Feed(frame, packet_.frame_len());
+            if (!g_wake->Take()) {
+                due_ = 0;
+                return 0;
+            }
+            hang_ = CONFIG_STREAM_WAKE_LISTEN_MS / 20;
+        }
+#endif
+        if (voiced) {
+            hang_ = std::max(hang_, CONFIG_STREAM_VAD_HANGOVER_MS / 20);
+        } else if (hang_ > 0) {
+            hang_--;
+        } else {
+            talking_ = false;
+            due_ = 0;
+            return 0;
+        }
+        due_ = talking_ ? 1 : buffered_;
+        talking_ = true;
+        buffered_ = 0;
+        first_ = (idx + slots_ + 1 - due_) % slots_;
+        last_tx_us_ = ts;
+        return due_;
+#else
+        ts_ = ts;
+        return 1;
+#endif
+    }
+
+    // Packs the i-th due frame into the packet; returns the packet length (0 on encode failure)
+    size_t PackDue(size_t i) {
+#if CONFIG_STREAM_VAD
+        size_t f = (first_ + i) % slots_;
+        memcpy(packet_.samples(), frames_.data() + f * packet_.frame_len(), packet_.frame_len() * sizeof(int16_t));
+        return packet_.Pack(ts_[f]);
+#else
+        (void)i;
+        return packet_.Pack(ts_);
+#endif
+    }
+
+    // During silence: returns the length of a keepalive packet in keepalive_data() when one is due.
+    // With the feature stage: a batch of feature vectors whenever one is complete, talking or not.
+    size_t PackKeepalive(uint64_t ts) {
+#if CONFIG_STREAM_UPLINK_FEATURES
+        if (g_features != nullptr) return PackFeatures();
+#endif
+#if CONFIG_STREAM_VAD
+        if (talking_ || (int64_t)(ts - last_tx_us_) < (int64_t)CONFIG_STREAM_VAD_KEEPALIVE_MS * 1000) return 0;
+        last_tx_us_ = ts;
+        uint16_t level = (uint16_t)std::min(65535.0f, std::pow(10.0f, floor_db_ / 20.0f));
+        PcmHeader hdr{ PCM_MAGIC, PCM_TYPE_MIC_SILENCE, sizeof(level), ts };
+        memcpy(keepalive_, &hdr, sizeof(hdr));
+        memcpy(keepalive_ + sizeof(hdr), &level, sizeof(level));
+        side_ = keepalive_;
+        return sizeof(keepalive_);
+#else
+        (void)ts;
+        return 0;
+#endif
+    }
+
+    const uint8_t* keepalive_data() const { return side_; }
+
+    // Largest packet PackKeepalive() returns
+    size_t max_keepalive() const {
+#if CONFIG_STREAM_UPLINK_FEATURES
+        return sizeof(PcmHeader) + 2 + CONFIG_STREAM_FEATURE_BATCH * (1 + FeatureStage::BANDS);
+#else
+        return sizeof(keepalive_);
+#endif
+    }
+
+    // Most frames a single Commit() can make due (the whole pre-roll)
+    size_t max_due() const {
+#if CONFIG_STREAM_VAD
+        return slots_;
+#else
+        return 1;
+#endif
+    }
+
+    // New connection: start from silence with an empty pre-roll
+    void Reset() {
+#if CONFIG_STREAM_VAD
+        buffered_ = 0;
+        hang_ = 0;
+        talking_ = false;
+        last_tx_us_ = 0;
+#endif
+#if CONFIG_STREAM_WAKE_WORD
+        if (g_wake != nullptr) g_wake->Reset();
+#endif
+#if CONFIG_STREAM_UPLINK_FEATURES
+        if (g_features != nullptr) g_features->Reset();
+#endif
+    }
+
+private:
+#if CONFIG_STREAM_UPLINK_FEATURES
+    // Payload: u8 bands, u8 hop ms, then per vector u8 flags + the bands; stamped with the first vector
+    size_t PackFeatures() {
+        constexpr size_t batch = CONFIG_STREAM_FEATURE_BATCH;
+        constexpr size_t vec_bytes = 1 + FeatureStage::BANDS;
+        if (g_features->Pending() < batch) return 0;
+        batch_.resize(batch);
+        const FeatureStage::Vector* v = batch_.data();
+        size_t n = g_features->Take(batch_.data(), batch);
+        if (n == 0) return 0;
+        features_.resize(sizeof(PcmHeader) + 2 + n * vec_bytes);
+        PcmHeader hdr{ PCM_MAGIC, PCM_TYPE_MIC_FEATURES, (uint16_t)(2 + n * vec_bytes), v[0].ts };
+        memcpy(features_.data(), &hdr, sizeof(hdr));
+        uint8_t* p = features_.data() + sizeof(hdr);
+        *p++ = FeatureStage::BANDS;
+        *p++ = FeatureStage::HOP_MS;
+        for (size_t i = 0; i < n; i++) {
+            *p++ = v[i].flags;
+            memcpy(p, v[i].bands, FeatureStage::BANDS);
+            p += FeatureStage::BANDS;
+        }
+        side_ = features_.data();
+        return features_.size();
+    }
+
+    std::vector<FeatureStage::Vector> batch_;
+    std::vector<uint8_t> features_;
+#endif
+#if CONFIG_STREAM_VAD
+    bool Voiced(const int16_t* pcm, size_t n) {
+        int64_t energy = 0;
+        size_t crossings = 0;
+        for (size_t i = 0; i < n; i++) {
+            energy += (int32_t)pcm[i] * pcm[i];
+            crossings += (i > 0) && ((pcm[i] ^ pcm[i - 1]) < 0);
+        }
+        float db = 10.0f * std::log10((float)energy / (float)n + 1.0f);
+        float zcr = (float)crossings / (float)n;
+
+        if (!floor_init_) {
+            floor_db_ = db;
+            floor_init_ = true;
+        }
+        // Noise floor: follows drops within a few frames, rises over ~10 s so speech does not lift it
+        floor_db_ += (db < floor_db_) ? (db - floor_db_) * 0.2f : (db - floor_db_) * 0.002f;
+
+        const float threshold = (float)CONFIG_STREAM_VAD_THRESHOLD_DB;
+        if (db < VAD_ABS_MIN_DB) return false;
+        return db > floor_db_ + threshold || (zcr > VAD_FRICATIVE_ZCR && db > floor_db_ + threshold / 2);
+    }
+
+    static constexpr float VAD_ABS_MIN_DB = 30.0f;      // below rms ~32 nothing counts as speech
+    static constexpr float VAD_FRICATIVE_ZCR = 0.25f;   // crossings per sample typical of s/f/sh
+
+    std::vector<int16_t> frames_;                       // pre-roll ring, including the current frame
+    std::vector<uint64_t> ts_;
+    size_t slots_ = 1;
+    size_t head_ = 0;
+    size_t buffered_ = 0;                               // held-back frames not yet sent
+    size_t first_ = 0;
+    size_t due_ = 0;
+    int hang_ = 0;
+    bool talking_ = false;
+    bool floor_init_ = false;
+    float floor_db_ = 0.0f;
+    uint64_t last_tx_us_ = 0;
+#else
+    uint64_t ts_ = 0;
+#endif
+    UplinkPacket& packet_;
+    uint8_t keepalive_[sizeof(PcmHeader) + sizeof(uint16_t)] = {};
+    const uint8_t* side_ = keepalive_;                  // what keepalive_data() hands out
+};
+
+bool send_all(int sock, const uint8_t* data, size_t len) {
     size_t sent = 0;
     while (sent < len) {
         int ret = ::send(sock, (const char*)data + sent, (int)(len - sent), 0);
-        if (ret <= 0) return false;
+        if (ret <= 0) {
+            // EAGAIN here means SO_SNDTIMEO expired with no progress: the peer is gone
+            if (ret < 0 && errno == EAGAIN) ESP_LOGW(TAG, "send stalled for %d ms", TCP_SEND_TIMEOUT_MS);
+            return false;
+        }
         sent += (size_t)ret;
     }
     return true;
 }
 
-static bool recv_all(int sock, uint8_t* data, size_t len) {
+bool recv_all(int sock, uint8_t* data, size_t len) {
     size_t recvd = 0;
     while (recvd < len) {
         int ret = ::recv(sock, (char*)data + recvd, (int)(len - recvd), 0);
@@ -38,16 +534,73 @@ static bool recv_all(int sock, uint8_t* data, size_t len) {
     return true;
 }
 
-static int connect_to(const NetConfig& cfg) {
+// Board ID record: u8 length + "<room>/<board>", appended to the RTP hello and sent after "HELLO-ID" on TCP
+static std::string board_id_record(const NetConfig& cfg) {
+    // "?down=adpcm" after the ID asks the bridge for an IMA-ADPCM downlink
+    std::string id = cfg.board_id + (CONFIG_STREAM_DOWNLINK_ADPCM ? "?down=adpcm" : "");
+    size_t n = std::min(id.size(), (size_t)255);
+    std::string rec(1, (char)n);
+    rec.append(id, 0, n);
+    return rec;
+}
+
+// Direction hello, preceded by the board ID when one is configured (the bridge routes rooms on it)
+static bool send_hello(int sock, const NetConfig& cfg, const char* hello) {
+    std::string msg;
+    if (!cfg.board_id.empty()) msg = "HELLO-ID" + board_id_record(cfg);
+    msg += hello;
+    return send_all(sock, (const uint8_t*)msg.data(), msg.size());
+}
+
+// Entry i of the server list (empty entries dropped); *count gets the list length
+static std::string server_host(const NetConfig& cfg, size_t i, size_t* count) {
+    std::string host;
+    size_t n = 0;
+    size_t pos = 0;
+    while (pos <= cfg.host.size()) {
+        size_t end = cfg.host.find(',', pos);
+        if (end == std::string::npos) end = cfg.host.size();
+        size_t b = cfg.host.find_first_not_of(' ', pos);
+        size_t e = cfg.host.find_last_not_of(' ', end - 1);
+        if (b < end && e != std::string::npos && e >= b) {
+            if (n == i) host = cfg.host.substr(b, e - b + 1);
+            n++;
+        }
+        pos = end + 1;
+    }
+    if (count) *count = n;
+    return host;
+}
+
+// Index of the server the streams use. All streams of a board follow the last successful connect,
+// so uplink and downlink end up on the same bridge. With CONFIG_STREAM_SERVER_SPREAD the first pick
+// is a hash of the board ID, spreading a fleet over equal bridges without per-board configuration.
+static std::atomic<int> s_server_idx{-1};
+
+static size_t server_current(const NetConfig& cfg, size_t n) {
+    int idx = s_server_idx.load();
+    if (idx < 0 || (size_t)idx >= n) {
+        uint32_t h = 2166136261u;
+        if (CONFIG_STREAM_SERVER_SPREAD) {
+            for (char c : cfg.board_id) h = (h ^ (uint8_t)c) * 16777619u;
+        }
+        idx = (CONFIG_STREAM_SERVER_SPREAD && !cfg.board_id.empty()) ? (int)(h % n) : 0;
+        s_server_idx.store(idx);
+    }
+    return (size_t)idx;
+}
+
+// Non-blocking connect bounded by TCP_CONNECT_TIMEOUT_MS; the socket is left blocking on success
+static int connect_host(const std::string& host, uint16_t port) {
     struct addrinfo hints = {};
     hints.ai_family = AF_INET;
     hints.ai_socktype = SOCK_STREAM;
     struct addrinfo* res = nullptr;
     char portstr[16];
-    snprintf(portstr, sizeof(portstr), "%u", cfg.port);
-    int err = getaddrinfo(cfg.host.c_str(), portstr, &hints, &res);
+    snprintf(portstr, sizeof(portstr), "%u", port);
+    int err = getaddrinfo(host.c_str(), portstr, &hints, &res);
     if (err != 0 || !res) {
-        ESP_LOGE(TAG, "getaddrinfo failed: %d", err);
+        ESP_LOGE(TAG, "getaddrinfo %s failed: %d", host.c_str(), err);
         return -1;
     }
     int sock = ::socket(res->ai_family, res->ai_socktype, 0);
@@ -56,26 +609,278 @@ static int connect_to(const NetConfig& cfg) {
         ESP_LOGE(TAG, "socket create failed");
         return -1;
     }
-    if (::connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
-        ESP_LOGE(TAG, "connect failed");
+    set_dscp(sock, CONFIG_STREAM_DSCP_TCP);
+    int flags = ::fcntl(sock, F_GETFL, 0);
+    ::fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    bool ok = ::connect(sock, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+    if (!ok && errno == EINPROGRESS) {
+        fd_set wset;
+        FD_ZERO(&wset);
+        FD_SET(sock, &wset);
+        struct timeval tv = { .tv_sec = TCP_CONNECT_TIMEOUT_MS / 1000, .tv_usec = (TCP_CONNECT_TIMEOUT_MS % 1000) * 1000 };
+        int so_err = 0;
+        socklen_t len = sizeof(so_err);
+        ok = ::select(sock + 1, nullptr, &wset, nullptr, &tv) > 0 &&
+             ::getsockopt(sock, SOL_SOCKET, SO_ERROR, &so_err, &len) == 0 && so_err == 0;
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "connect to %s:%u failed", host.c_str(), port);
         ::close(sock);
-        freeaddrinfo(res);
         return -1;
     }
-    freeaddrinfo(res);
-    ESP_LOGI(TAG, "Connected to %s:%u", cfg.host.c_str(), cfg.port);
+    ::fcntl(sock, F_SETFL, flags);
+    return sock;
+}
+
+int connect_to(const NetConfig& cfg) {
+    size_t n = 0;
+    server_host(cfg, 0, &n);
+    if (n == 0) {
+        ESP_LOGE(TAG, "no stream server configured");
+        return -1;
+    }
+    // Current server first, then the rest in list order; the caller backs off only when all fail
+    size_t start = server_current(cfg, n);
+    int sock = -1;
+    std::string host;
+    for (size_t k = 0; k < n && sock < 0; k++) {
+        size_t idx = (start + k) % n;
+        host = server_host(cfg, idx, nullptr);
+        sock = connect_host(host, cfg.port);
+        if (sock >= 0 && k != 0) {
+            ESP_LOGW(TAG, "Failing over to %s", host.c_str());
+        }
+        if (sock >= 0) s_server_idx.store((int)idx);
+    }
+    if (sock < 0) return -1;
+    // Each packet goes out in one send(); don't let Nagle hold it back waiting for an ACK
+    int nodelay = 1;
+    ::setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    int keepalive = 1;
+    int idle = TCP_KEEPALIVE_IDLE_S;
+    int intvl = TCP_KEEPALIVE_INTVL_S;
+    int cnt = TCP_KEEPALIVE_CNT;
+    struct timeval sndtimeo = { .tv_sec = TCP_SEND_TIMEOUT_MS / 1000, .tv_usec = (TCP_SEND_TIMEOUT_MS % 1000) * 1000 };
+    ::setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(keepalive));
+    ::setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    ::setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+    ::setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+    ::setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &sndtimeo, sizeof(sndtimeo));
+    ESP_LOGI(TAG, "Connected to %s:%u", host.c_str(), cfg.port);
     return sock;
 }
 
+// Single-producer/single-consumer ring of captured frames between the capture task and the network
+// task, so a stalled send never stops the I2S RX from being drained. Lock-free: the producer owns
+// head_, the consumer advances tail_. With CAPTURE_DROP_OLDEST the producer may also advance tail_
+// when the ring is full; the consumer copies a frame out before claiming it with a CAS on tail_, and
+// throws the copy away if the producer got there first (the slot may have been overwritten meanwhile).
+class CaptureRing {
+public:
+    CaptureRing(size_t slots, size_t frame_len)
+        : slots_(slots), frame_len_(frame_len), pcm_(new int16_t[(slots + 1) * frame_len]),
+          capture_us_(new int64_t[slots + 1]) {}
+
+    // Producer: where the next frame goes. When full and dropping the newest, that is the spare slot.
+    int16_t* Begin() {
+        uint32_t h = head_.load(std::memory_order_relaxed);
+        uint32_t t = tail_.load(std::memory_order_acquire);
+        full_ = false;
+        if (h - t >= slots_) {
+            if (!CAPTURE_DROP_OLDEST) {
+                full_ = true;
+                return pcm_.get() + slots_ * frame_len_;
+            }
+            // Evict the oldest frame; a failed CAS means the consumer just took it, which frees the slot too
+            full_ = tail_.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel);
+        }
+        return Slot(h);
+    }
+
+    // Producer: publish the frame written at Begin() and wake the consumer
+    void Commit(int64_t capture_us) {
+        if (full_) dropped_.fetch_add(1, std::memory_order_relaxed);
+        if (full_ && !CAPTURE_DROP_OLDEST) return;
+        uint32_t h = head_.load(std::memory_order_relaxed);
+        capture_us_[h % slots_] = capture_us;
+        head_.store(h + 1, std::memory_order_release);
+        TaskHandle_t consumer = consumer_.load(std::memory_order_acquire);
+        if (consumer != nullptr) xTaskNotifyGive(consumer);
+    }
+
+    // Consumer: copy the oldest frame into dest; waits up to `wait` for one to arrive
+    bool Pop(int16_t* dest, int64_t* capture_us, TickType_t wait) {
+        while (true) {
+            uint32_t t = tail_.load(std::memory_order_acquire);
+            if (t == head_.load(std::memory_order_acquire)) {
+                if (wait == 0 || ulTaskNotifyTake(pdTRUE, wait) == 0) return false;
+                wait = 0;
+                continue;
+            }
+            memcpy(dest, Slot(t), frame_len_ * sizeof(int16_t));
+            *capture_us = capture_us_[t % slots_];
+            if (tail_.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel)) return true;
+        }
+    }
+
+    // Consumer: register the task to notify, and forget frames captured while nobody was sending
+    void Attach() {
+        consumer_.store(xTaskGetCurrentTaskHandle(), std::memory_order_release);
+        uint32_t t = tail_.load(std::memory_order_acquire);
+        while (!tail_.compare_exchange_weak(t, head_.load(std::memory_order_acquire), std::memory_order_acq_rel)) {}
+    }
+
+    uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    int16_t* Slot(uint32_t index) { return pcm_.get() + (index % slots_) * frame_len_; }
+
+    const uint32_t slots_;
+    const size_t frame_len_;
+    std::unique_ptr<int16_t[]> pcm_;            // slots_ frames plus one spare the producer reads into when dropping
+    std::unique_ptr<int64_t[]> capture_us_;
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    std::atomic<uint32_t> dropped_{0};
+    std::atomic<TaskHandle_t> consumer_{nullptr};
+    bool full_ = false;                         // producer only
+};
+
+static CaptureRing* g_capture = nullptr;
+
+// Log ring drops every 50 frames; called by whichever task produces into the ring
+static void report_capture_drops(uint32_t& reported) {
+    uint32_t dropped = g_capture->dropped();
+    if (dropped - reported >= 50) {
+        ESP_LOGW(TAG, "capture ring overflow, %lu frames dropped", (unsigned long)dropped);
+        reported = dropped;
+    }
+}
+
+#if CONFIG_STREAM_AEC
+static AecStage* g_aec = nullptr;
+
+// Capture side of the AEC: mic + reference chunks straight into the AFE
+static void aec_capture_loop(AudioCodec* codec) {
+    std::vector<int16_t> chunk(g_aec->feed_frames() * codec->input_channels());
+    while (true) {
+        if (!codec->input_enabled()) codec->EnableInput(true);
+        int64_t capture_us;
+        if (!codec->InputData(chunk.data(), (int)chunk.size(), &capture_us)) {
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+        g_aec->Feed(chunk.data(), capture_us);
+    }
+}
+
+// Output side: cleaned 16 kHz mono -> uplink rate -> 20 ms frames in the ring (the ring's only producer)
+static void aec_fetch_task(void* arg) {
+    AudioCodec* codec = static_cast<AudioCodec*>(arg);
+    const size_t frame_len = (size_t)(uplink_rate(codec) / 50);
+    PcmResampler resampler(AecStage::SAMPLE_RATE, uplink_rate(codec), 1);
+    std::vector<int16_t> converted;
+    int16_t* frame = nullptr;
+    size_t filled = 0;
+    int64_t frame_us = 0;
+    uint32_t reported = 0;
+
+    while (true) {
+        const int16_t* mono;
+        int64_t block_us;
+        size_t n = g_aec->Fetch(&mono, &block_us);
+        if (n == 0) continue;
+        converted.resize(resampler.MaxOutput(n));
+        converted.resize(resampler.Process(mono, n, converted.data()));
+
+        for (size_t off = 0; off < converted.size();) {
+            if (frame == nullptr) {
+                frame = g_capture->Begin();
+                filled = 0;
+                frame_us = block_us + (int64_t)off * 1000000 / uplink_rate(codec);
+            }
+            size_t take = std::min(frame_len - filled, converted.size() - off);
+            memcpy(frame + filled, converted.data() + off, take * sizeof(int16_t));
+            filled += take;
+            off += take;
+            if (filled == frame_len) {
+                g_capture->Commit(frame_us);
+                frame = nullptr;
+                report_capture_drops(reported);
+            }
+        }
+    }
+}
+#endif
+
+#if CONFIG_STREAM_MIC_ARRAY
+// Capture side of the mic array: a 20 ms block of every TDM slot in, the steered mono frame into the ring.
+// Beamforming is a few integer multiply-accumulates per mic, beam and sample, cheap enough to stay inline.
+static void beam_capture_loop(AudioCodec* codec) {
+    const size_t frames = (size_t)(codec->input_sample_rate() / 50);
+    MicBeamformer beam(codec->input_sample_rate(), codec->input_channels(), CONFIG_STREAM_MIC_ARRAY_MICS,
+                       CONFIG_STREAM_MIC_ARRAY_SPACING_MM, CONFIG_STREAM_MIC_ARRAY_BEAMS);
+    std::vector<int16_t> block(frames * codec->input_channels());
+    uint32_t reported = 0;
+    int steered = beam.beam();
+
+    while (true) {
+        if (!codec->input_enabled()) codec->EnableInput(true);
+        int64_t capture_us;
+        if (!codec->InputData(block.data(), (int)block.size(), &capture_us)) {
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+        int16_t* frame = g_capture->Begin();
+        beam.Process(block.data(), frames, frame);
+        g_capture->Commit(capture_us);
+        report_capture_drops(reported);
+        if (beam.beam() != steered) {
+            steered = beam.beam();
+            ESP_LOGD(TAG, "mic array steered to %d deg", beam.beam_angle(steered));
+        }
+    }
+}
+#endif
+
+// Highest-priority audio task: drains I2S RX into the ring at the DMA's pace, nothing else
+static void mic_capture_task(void* arg) {
+    AudioCodec* codec = static_cast<AudioCodec*>(arg);
+#if CONFIG_STREAM_AEC
+    aec_capture_loop(codec);
+#elif CONFIG_STREAM_MIC_ARRAY
+    beam_capture_loop(codec);
+#endif
+    const size_t frame_len = (size_t)(codec->input_sample_rate() / 50) * codec->input_channels();
+    uint32_t reported = 0;
+
+    while (true) {
+        if (!codec->input_enabled()) codec->EnableInput(true);
+        int16_t* frame = g_capture->Begin();
+        int64_t capture_us;
+        if (!codec->InputData(frame, (int)frame_len, &capture_us)) {
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+        g_capture->Commit(capture_us);
+        report_capture_drops(reported);
+    }
+}
+
 static void mic_uplink_task(void* arg) {
     auto* pair = static_cast<std::pair<AudioCodec*, NetConfig>*>(arg);
     AudioCodec* codec = pair->first;
     NetConfig cfg = pair->second;
     delete pair;
 
-    const int sample_rate = codec->input_sample_rate();
+    const int sample_rate = uplink_rate(codec);
     const size_t frame_samples = sample_rate / 50; // 20ms
-    std::vector<int16_t> frame(frame_samples * codec->input_channels());
+    PcmClock clock(sample_rate, frame_samples);
+
+    // One contiguous packet per frame, one send() each
+    UplinkPacket packet(sample_rate, uplink_channels(codec), frame_samples);
+    UplinkGate gate(packet);
 
     while (true) {
         int sock = connect_to(cfg);
@@ -85,61 +890,929 @@ static void mic_uplink_task(void* arg) {
         }
 
         // Identify stream direction
-        {
-            const char hello[] = "HELLO-UP"; // uplink (mic)
-            send_all(sock, (const uint8_t*)hello, sizeof(hello)-1);
-        }
+        send_hello(sock, cfg, "HELLO-UP"); // uplink (mic)
 
-        while (true) {
-            if (!codec->input_enabled()) codec->EnableInput(true);
-            if (!codec->InputData(frame)) { vTaskDelay(pdMS_TO_TICKS(5)); continue; }
+        clock.Reset();
+        packet.Reset();
+        gate.Reset();
+        g_capture->Attach();
+
+        bool ok = true;
+        while (ok) {
+            // A send stalled by Wi-Fi retries only backs up the ring; capture keeps running
+            int64_t capture_us;
+            if (!g_capture->Pop(gate.Slot(), &capture_us, portMAX_DELAY)) continue;
 
-            PcmHeader hdr{ PCM_MAGIC, 0x01, (uint16_t)(frame.size() * sizeof(int16_t)) };
-            if (!send_all(sock, (uint8_t*)&hdr, sizeof(hdr))) break;
-            if (!send_all(sock, (uint8_t*)frame.data(), frame.size() * sizeof(int16_t))) break;
+            uint64_t ts = clock.Stamp(capture_us);
+            size_t due = gate.Commit(ts);
+            for (size_t i = 0; i < due && ok; i++) {
+                size_t len = gate.PackDue(i);
+                ok = len == 0 || send_all(sock, packet.data(), len);
+            }
+            if (size_t len = gate.PackKeepalive(ts)) ok = ok && send_all(sock, gate.keepalive_data(), len);
         }
         ::close(sock);
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
 }
 
+// Rate of the sender's media clock against esp_timer (which shares the crystal with the I2S clock).
+// Each packet gives offset = arrival - media time; queueing only ever adds delay, so the minimum
+// offset per window tracks the clock difference without the jitter, and a least-squares line
+// through the last DRIFT_WINDOWS minima gives the drift. A jump of more than DRIFT_RESET_US means the
+// sender restarted its clock, not drift, and starts the estimate over.
+class DriftEstimator {
+public:
+    void Add(int64_t arrival_us, int64_t media_us) {
+        int64_t offset = arrival_us - media_us;
+        if (started_ && llabs(offset - last_offset_) > DRIFT_RESET_US) Reset();
+        last_offset_ = offset;
+        if (!started_) {
+            started_ = true;
+            win_start_us_ = arrival_us;
+            win_min_ = offset;
+            return;
+        }
+        if (offset < win_min_) win_min_ = offset;
+        if (arrival_us - win_start_us_ < DRIFT_WINDOW_US) return;
+
+        t_[head_] = win_start_us_ + DRIFT_WINDOW_US / 2;
+        min_[head_] = win_min_;
+        head_ = (head_ + 1) % DRIFT_WINDOWS;
+        if (count_ < DRIFT_WINDOWS) count_++;
+        win_start_us_ = arrival_us;
+        win_min_ = offset;
+        if (count_ >= DRIFT_MIN_WINDOWS) Fit();
+    }
+
+    void Reset() {
+        started_ = false;
+        count_ = 0;
+        head_ = 0;
+        valid_ = false;
+    }
+
+    bool valid() const { return valid_; }
+    // d(offset)/d(arrival): positive when the sender's clock runs slow against ours
+    double slope() const { return slope_; }
+
+private:
+    void Fit() {
+        // Relative to the oldest point, so the sums stay well inside double precision
+        int oldest = (head_ + DRIFT_WINDOWS - count_) % DRIFT_WINDOWS;
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (int i = 0; i < count_; i++) {
+            int k = (oldest + i) % DRIFT_WINDOWS;
+            double x = (double)(t_[k] - t_[oldest]);
+            double y = (double)(min_[k] - min_[oldest]);
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+        }
+        double den = count_ * sxx - sx * sx;
+        if (den <= 0) return;
+        slope_ = (count_ * sxy - sx * sy) / den;
+        valid_ = true;
+    }
+
+    static constexpr int64_t DRIFT_WINDOW_US = 5000000;        // one minimum per 5 s
+    static constexpr int DRIFT_WINDOWS = 60;                   // fit over the last 5 minutes
+    static constexpr int DRIFT_MIN_WINDOWS = 6;                // first estimate after 30 s
+    static constexpr int64_t DRIFT_RESET_US = 1000000;
+
+    bool started_ = false;
+    bool valid_ = false;
+    int64_t last_offset_ = 0;
+    int64_t win_start_us_ = 0;
+    int64_t win_min_ = 0;
+    int64_t t_[DRIFT_WINDOWS];
+    int64_t min_[DRIFT_WINDOWS];
+    int head_ = 0;
+    int count_ = 0;
+    double slope_ = 0.0;
+};
+
+// Jitter buffer in front of the codec output. Buffers come from a fixed pool allocated once:
+// the socket reader fills a free buffer and queues it, and the player task plays queued buffers.
+//
+// The receive side tracks inter-arrival jitter (RFC 3550 style, J += (|D| - J) / 16). The playout
+// target is about twice that jitter, rounded up to whole packets, and never below a floor that an
+// underrun raises and a quiet period lowers again. Playback starts (or resumes) only when the
+// queue reaches the target. If the queue stays above target + 1 for a while, one packet is
+// skipped to cut latency.
+// An underrun conceals the gap by replaying the tail of the last packet faded to silence, and
+// the next packet fades back in, so the listener hears a soft dip instead of a click.
+// Packets a sequenced transport reports as lost are queued as markers in their place; each plays
+// the previous packet again at falling gain (1 -> 1/2 -> 1/4 -> 1/8, then silence).
+class PcmPlayback {
+public:
+    explicit PcmPlayback(AudioCodec* codec) : codec_(codec), sample_rate_(codec->output_sample_rate()) {
+        free_ = xQueueCreate(PCM_PLAYBACK_BUFFERS, sizeof(Slot));
+        ready_ = xQueueCreate(2 * PCM_PLAYBACK_BUFFERS, sizeof(Slot)); // pool buffers plus loss markers
+        assert(free_ && ready_);
+        for (auto& buf : bufs_) {
+            Slot slot{ buf, 0 };
+            xQueueSend(free_, &slot, 0);
+        }
+        xTaskCreate(&PcmPlayback::Task, "spk_play", 3072, this, 6, nullptr);
+    }
+
+    // Blocks until a buffer is free (back-pressures the TCP stream while playback is behind)
+    int16_t* Acquire() { return Acquire(portMAX_DELAY); }
+
+    // nullptr when no buffer frees up within `wait`
+    int16_t* Acquire(TickType_t wait) {
+        Slot slot;
+        if (xQueueReceive(free_, &slot, wait) != pdTRUE) return nullptr;
+        return slot.data;
+    }
+
+    // media_us: sender timestamp of the packet's first sample, -1 when the stream carries none (the
+    // drift estimate then runs on the count of samples received)
+    void Submit(int16_t* data, size_t samples, int64_t media_us = -1) {
+        TrackArrival(samples, media_us);
+        Slot slot{ data, samples };
+        xQueueSend(ready_, &slot, portMAX_DELAY);
+    }
+
+    // Hand back a buffer that was acquired but not filled
+    void Release(int16_t* data) {
+        Slot slot{ data, 0 };
+        xQueueSend(free_, &slot, portMAX_DELAY);
+    }
+
+    // `packets` of `samples` each went missing before the next Submit(). Markers never take the
+    // space every pool buffer needs in ready_, so Submit() still cannot block on them.
+    void Conceal(size_t packets, size_t samples) {
+        for (size_t i = 0; i < packets; i++) {
+            if (uxQueueSpacesAvailable(ready_) <= PCM_PLAYBACK_BUFFERS) break;
+            Slot slot{ nullptr, samples };
+            xQueueSend(ready_, &slot, 0);
+        }
+        last_duration_us_ += (int64_t)packets * DurationUs(samples);   // lost packets are not late arrivals
+        concealed_ += packets;
+    }
+
+    uint32_t concealed() const { return concealed_; }
+    int sample_rate() const { return sample_rate_; }
+
+private:
+    struct Slot {
+        int16_t* data;
+        size_t samples;
+    };
+
+    int64_t DurationUs(size_t samples) const { return (int64_t)samples * 1000000 / sample_rate_; }
+
+    void TrackArrival(size_t samples, int64_t media_us) {
+        int64_t now = esp_timer_get_time();
+        if (last_arrival_us_ != 0) {
+            int64_t d = (now - last_arrival_us_) - last_duration_us_;
+            int32_t j = jitter_us_;
+            j += (int32_t)((llabs(d) - j) / 16);
+            jitter_us_ = j;
+        }
+        // Without timestamps the media clock is the sample count; Conceal() has already added the lost packets
+        if (media_us < 0) media_us = last_arrival_us_ != 0 ? last_media_us_ + last_duration_us_ : 0;
+        last_media_us_ = media_us;
+        last_arrival_us_ = now;
+        last_duration_us_ = DurationUs(samples);
+        frame_us_ = (int32_t)last_duration_us_;
+#if CONFIG_STREAM_DRIFT_COMP
+        drift_.Add(now, media_us);
+        if (drift_.valid()) drift_ppb_ = (int32_t)(drift_.slope() * 1e9);
+#endif
+    }
+
+    int Target() const {
+        int32_t frame_us = frame_us_ > 0 ? frame_us_ : 20000;
+        int target = 1 + (int)((2 * jitter_us_ + frame_us - 1) / frame_us);
+        if (target < floor_) target = floor_;
+        if (target > PCM_PLAYBACK_BUFFERS - 1) target = PCM_PLAYBACK_BUFFERS - 1;
+        return target;
+    }
+
+    // Linear ramp over the whole buffer: up (fade in) or down (fade out)
+    static void Ramp(int16_t* pcm, size_t n, bool up) {
+        pcm_ramp_q15(pcm, pcm, n, up ? 0 : PCM_DSP_GAIN_UNITY, up ? PCM_DSP_GAIN_UNITY : 0);
+    }
+
+    // Straight from the pool slot to the DMA; a stalled I2S gives up after two frames rather than wedging the player
+    void Play(const int16_t* pcm, size_t n) {
+        if (!codec_->output_enabled()) codec_->EnableOutput(true);
+        TickType_t timeout = pdMS_TO_TICKS(2 * DurationUs(n) / 1000);
+        int written = codec_->OutputData(std::span<const int16_t>(pcm, n), timeout > 0 ? timeout : 1);
+        if (written < (int)n) ESP_LOGW(TAG, "playout write short: %d of %u samples", written, (unsigned)n);
+    }
+
+    // Packet repetition: the kept packet decays by half on every replay, silence once it is used up
+    void PlayLost(size_t samples, int repeats) {
+        if (last_len_ == 0 || repeats >= PCM_CONCEAL_REPEATS) {
+            last_len_ = samples < PCM_LAST_SAMPLES ? samples : PCM_LAST_SAMPLES;
+            memset(last_, 0, last_len_ * sizeof(int16_t));
+            Play(last_, last_len_);
+            last_len_ = 0;
+            return;
+        }
+        pcm_ramp_q15(last_, last_, last_len_, PCM_DSP_GAIN_UNITY, PCM_DSP_GAIN_UNITY / 2);
+        Play(last_, last_len_);
+    }
+
+    void Run() {
+        bool buffering = true;
+        bool fade_in = false;
+        int over = 0;
+        int repeats = 0;
+        int64_t last_underrun_us = 0;
+        Slot slot;
+
+        while (true) {
+            if (buffering) {
+                // Prefill up to the target; whatever is queued starts after PCM_PREFILL_MAX_MS regardless
+                int64_t start = esp_timer_get_time();
+                while (uxQueueMessagesWaiting(ready_) < (UBaseType_t)Target() &&
+                       (uxQueueMessagesWaiting(ready_) == 0 || esp_timer_get_time() - start < PCM_PREFILL_MAX_MS * 1000)) {
+                    vTaskDelay(pdMS_TO_TICKS(5));
+                }
+                buffering = false;
+            }
+
+            // Allow up to a frame and a half of lateness before calling it an underrun
+            TickType_t wait = pdMS_TO_TICKS((frame_us_ > 0 ? frame_us_ : 20000) * 3 / 2000);
+            if (xQueueReceive(ready_, &slot, wait) != pdTRUE) {
+                if (last_len_ > 0) {
+                    size_t n = last_len_ < PCM_TAIL_SAMPLES ? last_len_ : PCM_TAIL_SAMPLES;
+                    int16_t* tail = last_ + last_len_ - n;
+                    Ramp(tail, n, false);
+                    Play(tail, n);
+                    last_len_ = 0;
+                }
+                underruns_++;
+                last_underrun_us = esp_timer_get_time();
+                if (floor_ < PCM_PLAYBACK_BUFFERS - 1) floor_++;
+                ESP_LOGW(TAG, "playout underrun #%lu, target %d, jitter %ld us, drift %+ld ppm",
+                         (unsigned long)underruns_, Target(), (long)jitter_us_, (long)(drift_ppb_ / 1000));
+                buffering = true;
+                fade_in = true;
+#if CONFIG_STREAM_DRIFT_COMP
+                asrc_.Reset();                                  // resume from silence, not the old history
+#endif
+                continue;
+            }
+
+            // Latency trim: the link has been steadier than the current depth needs
+            if (uxQueueMessagesWaiting(ready_) > (UBaseType_t)Target() + 1) {
+                if (++over >= PCM_TRIM_PACKETS) {
+                    over = 0;
+                    if (slot.data != nullptr) xQueueSend(free_, &slot, portMAX_DELAY);
+                    continue;
+                }
+            } else {
+                over = 0;
+            }
+
+            // Underrun floor decays after a quiet period
+            if (floor_ > 1 && esp_timer_get_time() - last_underrun_us > PCM_FLOOR_DECAY_MS * 1000) {
+                floor_--;
+                last_underrun_us = esp_timer_get_time();
+            }
+
+            if (slot.data == nullptr) {
+                PlayLost(slot.samples, repeats);
+                repeats++;
+                fade_in = true;
+#if CONFIG_STREAM_DRIFT_COMP
+                asrc_.Reset();
+#endif
+                continue;
+            }
+            repeats = 0;
+
+            if (fade_in) {
+                Ramp(slot.data, slot.samples, true);
+                fade_in = false;
+            }
+
+            // Keep this packet for concealment
+            last_len_ = slot.samples;
+            memcpy(last_, slot.data, last_len_ * sizeof(int16_t));
+
+#if CONFIG_STREAM_DRIFT_COMP
+            asrc_.SetRatio(PlayoutRatio());
+            size_t n = asrc_.Process(slot.data, slot.samples, out_);
+            xQueueSend(free_, &slot, portMAX_DELAY);
+            Play(out_, n);
+#else
+            Play(slot.data, slot.samples);
+            xQueueSend(free_, &slot, portMAX_DELAY);
+#endif
+        }
+    }
+
+#if CONFIG_STREAM_DRIFT_COMP
+    // Output per input samples: the measured drift, plus a correction that walks the average depth
+    // back to the target over PCM_DEPTH_CENTRE_S. The depth term also covers the part of the drift
+    // the estimate has not caught yet, so the trim and the underrun refill stay safety nets.
+    double PlayoutRatio() {
+        int target = Target();
+        double depth = (double)uxQueueMessagesWaiting(ready_);
+        depth_ = depth_ < 0 ? depth : depth_ + (depth - depth_) / PCM_DEPTH_SMOOTH;
+        int32_t frame_us = frame_us_ > 0 ? frame_us_ : 20000;
+        double centre = -(depth_ - target) * frame_us * 1e-6 / PCM_DEPTH_CENTRE_S;
+        const double centre_max = PCM_DEPTH_MAX_PPM * 1e-6;
+        centre = centre > centre_max ? centre_max : (centre < -centre_max ? -centre_max : centre);
+        double ratio = 1.0 + drift_ppb_ * 1e-9 + centre;
+
+        int64_t now = esp_timer_get_time();
+        if (now - last_drift_log_us_ > PCM_DRIFT_LOG_S * 1000000LL) {
+            last_drift_log_us_ = now;
+            ESP_LOGI(TAG, "playout drift %+ld ppm, depth %ld ms (target %ld ms), ratio %+ld ppm",
+                     (long)(drift_ppb_ / 1000), (long)(depth_ * frame_us / 1000), (long)target * frame_us / 1000,
+                     (long)lround((ratio - 1.0) * 1e6));
+        }
+        return ratio;
+    }
+#endif
+
+    static void Task(void* arg) { static_cast<PcmPlayback*>(arg)->Run(); }
+
+    static constexpr size_t PCM_LAST_SAMPLES = PCM_MAX_LEN / sizeof(int16_t);
+    static constexpr size_t PCM_TAIL_SAMPLES = 240;            // 10 ms at 24 kHz used for the fade-out
+    static constexpr int PCM_CONCEAL_REPEATS = 3;              // lost packets bridged by repetition before going silent
+    static constexpr int PCM_PREFILL_MAX_MS = 200;             // start with what we have if the target is not reached
+    static constexpr int PCM_TRIM_PACKETS = 50;                // packets above target + 1 (~1 s) before skipping one
+    static constexpr int PCM_FLOOR_DECAY_MS = 10000;           // underrun-free time before lowering the floor
+    static constexpr double PCM_DEPTH_SMOOTH = 256;            // depth average over ~5 s of 20 ms packets
+    static constexpr double PCM_DEPTH_CENTRE_S = 60;           // time to work off a depth error
+    static constexpr int PCM_DEPTH_MAX_PPM = 500;               // bound on the depth correction
+    static constexpr int PCM_DRIFT_LOG_S = 60;
+
+    AudioCodec* codec_;
+    int sample_rate_;
+    QueueHandle_t free_ = nullptr;
+    QueueHandle_t ready_ = nullptr;
+    // Aligned like the DMA buffers Play() copies them into, so i2s_channel_write moves whole words
+    alignas(16) int16_t bufs_[PCM_PLAYBACK_BUFFERS][PCM_MAX_LEN / sizeof(int16_t)];
+    alignas(16) int16_t last_[PCM_LAST_SAMPLES];               // previous packet, source for loss and underrun concealment
+    size_t last_len_ = 0;
+    volatile int32_t jitter_us_ = 0;                           // written by the reader, read by the player
+    volatile int32_t frame_us_ = 0;
+    volatile int floor_ = 1;
+    int64_t last_arrival_us_ = 0;
+    int64_t last_duration_us_ = 0;
+    int64_t last_media_us_ = 0;
+    uint32_t underruns_ = 0;
+    volatile uint32_t concealed_ = 0;
+    volatile int32_t drift_ppb_ = 0;                           // written by the reader, read by the player
+#if CONFIG_STREAM_DRIFT_COMP
+    DriftEstimator drift_;
+    PcmDriftResampler asrc_{ 1 };
+    alignas(16) int16_t out_[PCM_LAST_SAMPLES + PCM_LAST_SAMPLES * PCM_DRIFT_MAX_PPM / 1000000 + 2];
+    double depth_ = -1.0;                                      // average packets queued, -1 until the first one
+    int64_t last_drift_log_us_ = 0;
+#endif
+};
+
+// Decodes a downlink IMA-ADPCM block into an acquired jitter buffer slot and queues it; a corrupt
+// block hands the slot back
+static void submit_adpcm(PcmPlayback* playback, int16_t* buf, const uint8_t* block, size_t len, int64_t media_us) {
+    size_t samples = ima_adpcm_decode(block, len, buf, PCM_MAX_LEN / sizeof(int16_t), 1);
+    if (samples == 0) {
+        playback->Release(buf);
+    } else {
+        playback->Submit(buf, samples, media_us);
+    }
+}
+
+// The bridge stamps the downlink with its mixer clock; 0 (older bridges) means no timestamp
+static int64_t spk_media_us(const PcmHeader& hdr) {
+    return hdr.timestamp_us != 0 ? (int64_t)hdr.timestamp_us : -1;
+}
+
 static void spk_downlink_task(void* arg) {
     auto* pair = static_cast<std::pair<AudioCodec*, NetConfig>*>(arg);
     AudioCodec* codec = pair->first;
     NetConfig cfg = pair->second;
     delete pair;
 
+    // Allocated once for the lifetime of the task
+    PcmPlayback* playback = new PcmPlayback(codec);
+    std::vector<uint8_t> adpcm(ADPCM_MAX_LEN);
+
     while (true) {
         int sock = connect_to(cfg);
         if (sock < 0) { vTaskDelay(pdMS_TO_TICKS(2000)); continue; }
 
         // Identify stream direction
-        {
-            const char hello[] = "HELLO-DOWN"; // downlink (speaker)
-            send_all(sock, (const uint8_t*)hello, sizeof(hello)-1);
-        }
+        send_hello(sock, cfg, "HELLO-DOWN"); // downlink (speaker)
         // Read loop (speaker data from server)
         while (true) {
             PcmHeader hdr{};
             if (!recv_all(sock, (uint8_t*)&hdr, sizeof(hdr))) break;
-            if (hdr.magic != PCM_MAGIC || hdr.type != 0x02 || hdr.len == 0) {
+            if (!spk_header_valid(hdr)) {
                 ESP_LOGW(TAG, "Invalid packet: magic=%08x type=%u len=%u", hdr.magic, hdr.type, hdr.len);
                 break;
             }
-            std::vector<int16_t> buf(hdr.len / sizeof(int16_t));
-            if (!recv_all(sock, (uint8_t*)buf.data(), hdr.len)) break;
-            if (!codec->output_enabled()) codec->EnableOutput(true);
-            codec->OutputData(buf);
+            int16_t* buf = playback->Acquire();
+            if (hdr.type == PCM_TYPE_SPK_ADPCM) {
+                if (!recv_all(sock, adpcm.data(), hdr.len)) { playback->Release(buf); break; }
+                submit_adpcm(playback, buf, adpcm.data(), hdr.len, spk_media_us(hdr));
+                continue;
+            }
+            if (!recv_all(sock, (uint8_t*)buf, hdr.len)) { playback->Release(buf); break; }
+            playback->Submit(buf, hdr.len / sizeof(int16_t), spk_media_us(hdr));
         }
         ::close(sock);
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
 }
 
+// Downlink packet being reassembled from non-blocking reads
+struct DuplexRx {
+    PcmHeader hdr{};
+    size_t got = 0;                 // bytes of header + payload received so far
+    int16_t* buf = nullptr;         // jitter buffer slot being filled (scratch when the pool is full)
+    std::vector<int16_t> scratch = std::vector<int16_t>(PCM_MAX_LEN / sizeof(int16_t)); // sized once; overflow packets are read and dropped here
+    std::vector<uint8_t> adpcm = std::vector<uint8_t>(ADPCM_MAX_LEN); // IMA-ADPCM payload, decoded into buf once complete
+};
+
+// Uplink packet (header + PCM) still being written
+struct DuplexTx {
+    std::vector<uint8_t> buf;
+    size_t off = 0;
+    bool busy() const { return off < buf.size(); }
+};
+
+// Drain everything readable; queues each complete packet for playout. Returns false on error or close.
+static bool duplex_rx(int sock, PcmPlayback* playback, DuplexRx& rx) {
+    while (true) {
+        uint8_t* dst;
+        size_t want;
+        if (rx.got < sizeof(PcmHeader)) {
+            dst = (uint8_t*)&rx.hdr + rx.got;
+            want = sizeof(PcmHeader) - rx.got;
+        } else {
+            size_t off = rx.got - sizeof(PcmHeader);
+            dst = (rx.hdr.type == PCM_TYPE_SPK_ADPCM ? rx.adpcm.data() : (uint8_t*)rx.buf) + off;
+            want = rx.hdr.len - off;
+        }
+
+        int ret = ::recv(sock, (char*)dst, (int)want, MSG_DONTWAIT);
+        if (ret == 0) return false;
+        if (ret < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+        rx.got += (size_t)ret;
+
+        if (rx.got == sizeof(PcmHeader)) {
+            if (!spk_header_valid(rx.hdr)) {
+                ESP_LOGW(TAG, "Invalid packet: magic=%08x type=%u len=%u", rx.hdr.magic, rx.hdr.type, rx.hdr.len);
+                return false;
+            }
+            // Never block this loop: with the jitter buffer full the packet is read and dropped
+            rx.buf = playback->Acquire(0);
+            if (rx.buf == nullptr) rx.buf = rx.scratch.data();
+        } else if (rx.got == sizeof(PcmHeader) + rx.hdr.len) {
+            if (rx.buf == rx.scratch.data()) {
+                // dropped: the jitter buffer was full
+            } else if (rx.hdr.type == PCM_TYPE_SPK_ADPCM) {
+                submit_adpcm(playback, rx.buf, rx.adpcm.data(), rx.hdr.len, spk_media_us(rx.hdr));
+            } else {
+                playback->Submit(rx.buf, rx.hdr.len / sizeof(int16_t), spk_media_us(rx.hdr));
+            }
+            rx.buf = nullptr;
+            rx.got = 0;
+        }
+    }
+}
+
+// Push as much of the pending uplink packet as the socket accepts. Returns false on error.
+static bool duplex_tx(int sock, DuplexTx& tx) {
+    while (tx.busy()) {
+        int ret = ::send(sock, (const char*)tx.buf.data() + tx.off, (int)(tx.buf.size() - tx.off), MSG_DONTWAIT);
+        if (ret < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+        if (ret == 0) return false;
+        tx.off += (size_t)ret;
+    }
+    return true;
+}
+
+// Mic uplink and speaker downlink on one socket ("HELLO-DX"), served by this task alone.
+// Captured frames from the ring pace the loop (one per 20 ms); socket I/O never blocks, and
+// downlink playout runs from the jitter buffer's own task so an I2S write never stalls the socket.
+static void duplex_task(void* arg) {
+    auto* pair = static_cast<std::pair<AudioCodec*, NetConfig>*>(arg);
+    AudioCodec* codec = pair->first;
+    NetConfig cfg = pair->second;
+    delete pair;
+
+    const int sample_rate = uplink_rate(codec);
+    const size_t frame_samples = sample_rate / 50; // 20ms
+    UplinkPacket packet(sample_rate, uplink_channels(codec), frame_samples);
+    UplinkGate gate(packet);
+    PcmClock clock(sample_rate, frame_samples);
+    uint32_t dropped = 0;
+    PcmPlayback* playback = new PcmPlayback(codec);             // allocated once for the lifetime of the task
+
+    while (true) {
+        int sock = connect_to(cfg);
+        if (sock < 0) { vTaskDelay(pdMS_TO_TICKS(2000)); continue; }
+
+        if (!send_hello(sock, cfg, "HELLO-DX")) { ::close(sock); continue; }
+
+        DuplexRx rx;
+        DuplexTx tx;
+        // A pre-roll burst is the most that goes out at once; Opus and ADPCM packets are smaller than raw ones
+        tx.buf.reserve(gate.max_due() * (sizeof(PcmHeader) + packet.frame_len() * sizeof(int16_t)) +
+                       gate.max_keepalive());
+        clock.Reset();
+        packet.Reset();
+        gate.Reset();
+        g_capture->Attach();
+
+        while (true) {
+            // Short wait so the downlink is still polled every few ms between frames
+            int64_t capture_us;
+            if (g_capture->Pop(gate.Slot(), &capture_us, pdMS_TO_TICKS(5))) {
+                uint64_t ts = clock.Stamp(capture_us);
+                size_t due = gate.Commit(ts);
+                if (tx.busy()) {
+                    // Link is slower than real time: keep the partial packet intact, skip these frames
+                    if (due > 0 && ((dropped += due) % 50) < due) ESP_LOGW(TAG, "uplink congested, %lu frames dropped", (unsigned long)dropped);
+                } else {
+                    tx.buf.clear();
+                    tx.off = 0;
+                    for (size_t i = 0; i < due; i++) {
+                        size_t len = gate.PackDue(i);
+                        tx.buf.insert(tx.buf.end(), packet.data(), packet.data() + len);
+                    }
+                    if (size_t len = gate.PackKeepalive(ts)) {
+                        tx.buf.insert(tx.buf.end(), gate.keepalive_data(), gate.keepalive_data() + len);
+                    }
+                }
+            }
+
+            fd_set rfds, wfds;
+            FD_ZERO(&rfds);
+            FD_ZERO(&wfds);
+            FD_SET(sock, &rfds);
+            if (tx.busy()) FD_SET(sock, &wfds);
+            struct timeval tv = { 0, 0 };
+            if (::select(sock + 1, &rfds, &wfds, nullptr, &tv) < 0) break;
+            if (FD_ISSET(sock, &wfds) && !duplex_tx(sock, tx)) break;
+            if (FD_ISSET(sock, &rfds) && !duplex_rx(sock, playback, rx)) break;
+        }
+        if (rx.buf != nullptr && rx.buf != rx.scratch.data()) playback->Release(rx.buf);
+        ESP_LOGW(TAG, "duplex connection lost");
+        ::close(sock);
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+#if STREAM_TRANSPORT_RTP
+// RTP over UDP (RFC 3550) instead of the PcmHeader stream: a lost datagram costs one 20 ms packet
+// instead of stalling every later one behind a TCP retransmit. Both directions share one
+// connected UDP socket. The board sends "HELLO-RTP" every second so the bridge knows where to
+// send the downlink even while the mic is silent.
+//
+// Payload types are dynamic: 96 = 16-bit little-endian PCM (uplink at the uplink rate, downlink
+// at the output rate), 97 = one 20 ms Opus frame, 98 = VAD silence keepalive (uint16 noise rms),
+// 99 = IMA-ADPCM (one ima_adpcm block per channel; downlink only with STREAM_DOWNLINK_ADPCM).
+// Uplink packets carry the esp_timer capture time of their first sample in a one-byte header
+// extension (RFC 8285, id 1, 8 bytes big-endian), so the bridge keeps camera sync.
+struct __attribute__((packed)) RtpHeader {
+    uint8_t vpxcc;                  // version 2, padding, extension, CSRC count
+    uint8_t mpt;                    // marker, payload type
+    uint16_t seq;                   // network byte order, as are the fields below
+    uint32_t timestamp;             // sample clock
+    uint32_t ssrc;
+};
+
+struct __attribute__((packed)) RtpCaptureExt {
+    uint16_t profile;               // 0xBEDE: one-byte elements
+    uint16_t words;                 // 3 (12 bytes follow)
+    uint8_t id_len;                 // id 1, length 8 (encoded as len - 1)
+    uint8_t capture_us[8];
+    uint8_t pad[3];
+};
+
+static constexpr uint8_t RTP_PT_PCM = 96;
+static constexpr uint8_t RTP_PT_OPUS = 97;
+static constexpr uint8_t RTP_PT_SILENCE = 98;
+static constexpr uint8_t RTP_PT_ADPCM = 99;
+static constexpr uint8_t RTP_PT_FEATURES = 100;
+static constexpr int64_t RTP_TALKSPURT_GAP_US = 30000;     // a wider timestamp jump marks a new talkspurt
+static constexpr size_t RTP_CONCEAL_MAX_GAP = 5;           // longer gaps are left to the underrun path
+static constexpr int16_t RTP_MAX_MISORDER = 100;           // older than this is a restarted sender, not a late packet
+static constexpr int RTP_HELLO_INTERVAL_MS = 1000;
+static constexpr size_t RTP_MAX_DATAGRAM = sizeof(RtpHeader) + 15 * 4 + 4 + 255 * 4 + PCM_MAX_LEN; // CSRCs + largest extension
+
+// Rewraps the PcmHeader packets built by UplinkPacket / UplinkGate as RTP datagrams
+class RtpSender {
+public:
+    explicit RtpSender(int sample_rate) : sample_rate_(sample_rate), ssrc_(esp_random()) {}
+
+    void Reset() { started_ = false; }
+
+    void Send(int sock, const uint8_t* pkt, size_t len) {
+        PcmHeader hdr;
+        memcpy(&hdr, pkt, sizeof(hdr));
+        uint8_t pt = hdr.type == PCM_TYPE_MIC_OPUS ? RTP_PT_OPUS : hdr.type == PCM_TYPE_MIC_SILENCE ? RTP_PT_SILENCE
+                   : hdr.type == PCM_TYPE_MIC_ADPCM ? RTP_PT_ADPCM : hdr.type == PCM_TYPE_MIC_FEATURES ? RTP_PT_FEATURES
+                   : RTP_PT_PCM;
+
+        // Sample clock follows the capture time, so VAD gaps advance it by the silence they skipped
+        int64_t delta = started_ ? (int64_t)(hdr.timestamp_us - last_us_) : 0;
+        bool marker = !started_ || last_pt_ == RTP_PT_SILENCE || delta > RTP_TALKSPURT_GAP_US;
+        uint32_t ts = rtp_ts_ + (uint32_t)((delta * sample_rate_ + 500000) / 1000000);
+        if (pt == RTP_PT_FEATURES) {
+            marker = false;                                     // a batch lags the audio: stamp it, leave the talkspurt state alone
+        } else {
+            rtp_ts_ = ts;
+            last_us_ = hdr.timestamp_us;
+            last_pt_ = pt;
+            started_ = true;
+        }
+
+        size_t payload = len - sizeof(PcmHeader);
+        buf_.resize(sizeof(RtpHeader) + sizeof(RtpCaptureExt) + payload);
+        RtpHeader rtp{ 0x90, (uint8_t)((marker && pt != RTP_PT_SILENCE ? 0x80 : 0) | pt), htons(seq_++),
+                       htonl(ts), htonl(ssrc_) };
+        RtpCaptureExt ext{ htons(0xBEDE), htons(3), (1 << 4) | 7, {}, {} };
+        for (int i = 0; i < 8; i++) ext.capture_us[i] = (uint8_t)(hdr.timestamp_us >> (56 - 8 * i));
+        memcpy(buf_.data(), &rtp, sizeof(rtp));
+        memcpy(buf_.data() + sizeof(rtp), &ext, sizeof(ext));
+        memcpy(buf_.data() + sizeof(rtp) + sizeof(ext), pkt + sizeof(PcmHeader), payload);
+
+        // A full Wi-Fi TX queue drops this packet only; the receiver conceals it like any other loss
+        if (::send(sock, (const char*)buf_.data(), (int)buf_.size(), 0) < 0 && (++send_errors_ % 50) == 1) {
+            ESP_LOGW(TAG, "rtp send failed (errno %d), %lu packets dropped", errno, (unsigned long)send_errors_);
+        }
+    }
+
+private:
+    int sample_rate_;
+    uint32_t ssrc_;
+    uint16_t seq_ = 0;
+    uint32_t rtp_ts_ = 0;
+    uint64_t last_us_ = 0;
+    uint8_t last_pt_ = 0;
+    bool started_ = false;
+    uint32_t send_errors_ = 0;
+    std::vector<uint8_t> buf_;
+};
+
+// Downlink sequencing: reports how many packets were skipped before each one, drops late and
+// duplicate packets (their place was already concealed), and restarts on a new sender
+class RtpReceiver {
+public:
+    struct Packet {
+        uint8_t pt;
+        uint16_t seq;
+        uint32_t ts;
+        uint32_t ssrc;
+        const uint8_t* payload;
+        size_t len;
+    };
+
+    static bool Parse(const uint8_t* d, size_t n, Packet& out) {
+        RtpHeader hdr;
+        if (n < sizeof(hdr)) return false;
+        memcpy(&hdr, d, sizeof(hdr));
+        if ((hdr.vpxcc >> 6) != 2) return false;
+        size_t off = sizeof(hdr) + 4 * (hdr.vpxcc & 0x0F);
+        if ((hdr.vpxcc & 0x10) != 0) {
+            if (n < off + 4) return false;
+            off += 4 + 4 * (((size_t)d[off + 2] << 8) | d[off + 3]);
+        }
+        size_t pad = (hdr.vpxcc & 0x20) != 0 && n > off ? d[n - 1] : 0;
+        if (n < off + pad) return false;
+        out.pt = hdr.mpt & 0x7F;
+        out.seq = ntohs(hdr.seq);
+        out.ts = ntohl(hdr.timestamp);
+        out.ssrc = ntohl(hdr.ssrc);
+        out.payload = d + off;
+        out.len = n - off - pad;
+        return true;
+    }
+
+    // Number of packets lost before this one, or -1 to drop it
+    int Accept(const Packet& pkt) {
+        int16_t delta = (int16_t)(pkt.seq - next_seq_);
+        if (!started_ || pkt.ssrc != ssrc_ || delta < -RTP_MAX_MISORDER) {
+            started_ = true;
+            ssrc_ = pkt.ssrc;
+            delta = 0;
+            media_ = 0;
+        } else if (delta < 0) {
+            late_++;
+            return -1;
+        } else {
+            media_ += (int32_t)(pkt.ts - last_ts_);
+        }
+        last_ts_ = pkt.ts;
+        next_seq_ = pkt.seq + 1;
+        lost_ += (uint32_t)delta;
+        return delta;
+    }
+
+    void Reset() { started_ = false; }
+    // Timestamp of the last accepted packet, unwrapped: samples since the sender was first heard
+    int64_t media() const { return media_; }
+    uint32_t lost() const { return lost_; }
+    uint32_t late() const { return late_; }
+
+private:
+    bool started_ = false;
+    uint32_t ssrc_ = 0;
+    uint16_t next_seq_ = 0;
+    uint32_t last_ts_ = 0;
+    int64_t media_ = 0;
+    uint32_t lost_ = 0;
+    uint32_t late_ = 0;
+};
+
+static int udp_connect(const NetConfig& cfg) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* res = nullptr;
+    char portstr[16];
+    snprintf(portstr, sizeof(portstr), "%u", cfg.port);
+    // UDP has no connect failure to fail over on; use the current server, the first entry by default
+    size_t n = 0;
+    std::string host = server_host(cfg, 0, &n);
+    if (n > 1) host = server_host(cfg, server_current(cfg, n), nullptr);
+    int err = getaddrinfo(host.c_str(), portstr, &hints, &res);
+    if (err != 0 || !res) {
+        ESP_LOGE(TAG, "getaddrinfo failed: %d", err);
+        return -1;
+    }
+    int sock = ::socket(res->ai_family, res->ai_socktype, 0);
+    if (sock >= 0) set_dscp(sock, CONFIG_STREAM_DSCP_RTP);
+    if (sock < 0 || ::connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+        ESP_LOGE(TAG, "udp socket setup failed");
+        if (sock >= 0) ::close(sock);
+        freeaddrinfo(res);
+        return -1;
+    }
+    freeaddrinfo(res);
+    ESP_LOGI(TAG, "RTP to %s:%u", host.c_str(), cfg.port);
+    return sock;
+}
+
+// One downlink datagram into the jitter buffer, with markers for whatever went missing before it
+static void rtp_deliver(PcmPlayback* playback, RtpReceiver& rx, const uint8_t* d, size_t n) {
+    RtpReceiver::Packet pkt;
+    bool ok = RtpReceiver::Parse(d, n, pkt);
+    if (ok && pkt.pt == RTP_PT_ADPCM) {
+        ok = pkt.len > IMA_ADPCM_HEADER_BYTES && pkt.len <= ADPCM_MAX_LEN;
+    } else {
+        ok = ok && pkt.pt == RTP_PT_PCM && pkt.len != 0 && pkt.len <= PCM_MAX_LEN && (pkt.len & 1) == 0;
+    }
+    if (!ok) {
+        ESP_LOGW(TAG, "Invalid RTP packet: %u bytes", (unsigned)n);
+        return;
+    }
+    int lost = rx.Accept(pkt);
+    if (lost < 0) return;
+
+    size_t samples = pkt.pt == RTP_PT_ADPCM ? 2 * (pkt.len - IMA_ADPCM_HEADER_BYTES) : pkt.len / sizeof(int16_t);
+    if (lost > 0) playback->Conceal(std::min((size_t)lost, RTP_CONCEAL_MAX_GAP), samples);
+    int16_t* buf = playback->Acquire(0);
+    if (buf == nullptr) return;                                 // jitter buffer full: the trim would drop it anyway
+    int64_t media_us = rx.media() * 1000000 / playback->sample_rate();
+    if (pkt.pt == RTP_PT_ADPCM) {
+        submit_adpcm(playback, buf, pkt.payload, pkt.len, media_us);
+        return;
+    }
+    memcpy(buf, pkt.payload, pkt.len);
+    playback->Submit(buf, samples, media_us);
+}
+
+// Mic uplink and speaker downlink over RTP, one task like the TCP duplex path: captured frames pace
+// the loop, every datagram is a whole packet, so nothing is ever partially sent or received
+static void rtp_task(void* arg) {
+    auto* pair = static_cast<std::pair<AudioCodec*, NetConfig>*>(arg);
+    AudioCodec* codec = pair->first;
+    NetConfig cfg = pair->second;
+    delete pair;
+
+    const int sample_rate = uplink_rate(codec);
+    const size_t frame_samples = sample_rate / 50; // 20ms
+    UplinkPacket packet(sample_rate, uplink_channels(codec), frame_samples);
+    UplinkGate gate(packet);
+    PcmClock clock(sample_rate, frame_samples);
+    RtpSender sender(sample_rate);
+    RtpReceiver receiver;
+    PcmPlayback* playback = new PcmPlayback(codec);             // allocated once for the lifetime of the task
+    std::vector<uint8_t> dgram(RTP_MAX_DATAGRAM);
+    const std::string hello = "HELLO-RTP" + (cfg.board_id.empty() ? std::string() : board_id_record(cfg));
+
+    while (true) {
+        int sock = udp_connect(cfg);
+        if (sock < 0) { vTaskDelay(pdMS_TO_TICKS(2000)); continue; }
+
+        clock.Reset();
+        packet.Reset();
+        gate.Reset();
+        sender.Reset();
+        receiver.Reset();
+        g_capture->Attach();
+        int64_t last_hello_us = 0;
+        int64_t last_report_us = esp_timer_get_time();
+        uint32_t reported_lost = 0;
+        bool ok = true;
+
+        while (ok) {
+            int64_t now = esp_timer_get_time();
+            if (now - last_hello_us >= RTP_HELLO_INTERVAL_MS * 1000) {
+                ::send(sock, hello.data(), hello.size(), 0);
+                last_hello_us = now;
+            }
+            if (now - last_report_us >= 10 * 1000000 && receiver.lost() != reported_lost) {
+                ESP_LOGI(TAG, "rtp downlink: %lu lost, %lu late, %lu concealed", (unsigned long)receiver.lost(),
+                         (unsigned long)receiver.late(), (unsigned long)playback->concealed());
+                reported_lost = receiver.lost();
+                last_report_us = now;
+            }
+
+            // Short wait so the downlink is still polled every few ms between frames
+            int64_t capture_us;
+            if (g_capture->Pop(gate.Slot(), &capture_us, pdMS_TO_TICKS(5))) {
+                uint64_t ts = clock.Stamp(capture_us);
+                size_t due = gate.Commit(ts);
+                for (size_t i = 0; i < due; i++) {
+                    if (size_t len = gate.PackDue(i)) sender.Send(sock, packet.data(), len);
+                }
+                if (size_t len = gate.PackKeepalive(ts)) sender.Send(sock, gate.keepalive_data(), len);
+            }
+
+            while (true) {
+                int ret = ::recv(sock, (char*)dgram.data(), (int)dgram.size(), MSG_DONTWAIT);
+                if (ret < 0) {
+                    ok = errno == EAGAIN || errno == EWOULDBLOCK;
+                    break;
+                }
+                rtp_deliver(playback, receiver, dgram.data(), (size_t)ret);
+            }
+        }
+        ESP_LOGW(TAG, "rtp socket error %d", errno);
+        ::close(sock);
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+#endif
+
+// libopus keeps its per-frame scratch on the stack (no pseudo-stack in this port)
+static constexpr uint32_t UPLINK_TASK_STACK = CONFIG_STREAM_UPLINK_OPUS ? 24 * 1024 : 4096;
+
 void start_stream_tasks(AudioCodec* codec, const NetConfig& cfg) {
+    const size_t frame_len = (size_t)(uplink_rate(codec) / 50) * uplink_channels(codec);
+    g_capture = new CaptureRing(std::max(2, CONFIG_STREAM_CAPTURE_RING_MS / 20), frame_len);
+#if CONFIG_STREAM_AEC
+    assert(codec->input_reference() && codec->input_sample_rate() == AecStage::SAMPLE_RATE);
+    g_aec = new AecStage();
+    if (g_aec->valid()) {
+        xTaskCreate(&aec_fetch_task, "aec_fetch", 4096, codec, 7, nullptr);
+        xTaskCreate(&mic_capture_task, "mic_capture", 3072, codec, 8, nullptr);
+    } else {
+        ESP_LOGE(TAG, "AEC unavailable, mic uplink stays silent");   // downlink still runs
+    }
+#elif CONFIG_STREAM_MIC_ARRAY
+    // The beamformer runs in the capture task; core 1 keeps it off the core that runs Wi-Fi and lwIP
+    xTaskCreatePinnedToCore(&mic_capture_task, "mic_capture", 3072, codec, 8, nullptr, 1);
+#else
+    xTaskCreate(&mic_capture_task, "mic_capture", 3072, codec, 8, nullptr);
+#endif
+#if CONFIG_STREAM_WAKE_WORD
+    g_wake = new WakeStage(uplink_rate(codec), uplink_channels(codec));
+    if (!g_wake->valid()) {
+        ESP_LOGE(TAG, "WakeNet unavailable, uplink gated on voice activity only");
+        delete g_wake;
+        g_wake = nullptr;
+    }
+#endif
+#if CONFIG_STREAM_UPLINK_FEATURES
+    g_features = new FeatureStage(uplink_rate(codec), uplink_channels(codec));
+    if (!g_features->valid()) {
+        ESP_LOGE(TAG, "feature stage unavailable, uplink gated on voice activity only");
+        delete g_features;
+        g_features = nullptr;
+    }
+#endif
+
+#if STREAM_TRANSPORT_RTP
+    auto* rtp = new std::pair<AudioCodec*, NetConfig>(codec, cfg);
+    xTaskCreate(&rtp_task, "pcm_rtp", UPLINK_TASK_STACK, rtp, 5, nullptr);
+#elif CONFIG_STREAM_DUPLEX
+    // One full-duplex connection: a single TCP control block and buffer set, both directions up or down together
+    auto* dx = new std::pair<AudioCodec*, NetConfig>(codec, cfg);
+    xTaskCreate(&duplex_task, "pcm_duplex", UPLINK_TASK_STACK, dx, 5, nullptr);
+#else
     // Two separate connections (uplink/downlink) keep roles simple.
     auto* up = new std::pair<AudioCodec*, NetConfig>(codec, cfg);
-    xTaskCreate(&mic_uplink_task, "mic_uplink", 4096, up, 5, nullptr);
+    xTaskCreate(&mic_uplink_task, "mic_uplink", UPLINK_TASK_STACK, up, 5, nullptr);
     auto* dn = new std::pair<AudioCodec*, NetConfig>(codec, cfg);
     xTaskCreate(&spk_downlink_task, "spk_downlink", 4096, dn, 5, nullptr);
+#endif
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 #include <string>
@@ -6,9 +7,37 @@
 struct NetConfig {
     std::string host;
     uint16_t port;
+    std::string board_id; // "<room>/<board>", sent in a HELLO-ID record so the bridge can route per board
 };
 
+// Packet header: magic 'PCM1', type(1=mic_up,2=spk_down,3=mic_up Opus, one 20 ms frame,
+// 4=mic_up silence keepalive, payload uint16 noise rms, 5=latency echo, returned as is,
+// 6=mic_up / 7=spk_down IMA-ADPCM, one ima_adpcm block per channel, 8=mic_up log-mel features:
+// u8 bands, u8 hop ms, then per 20 ms frame u8 flags (bit 0 = event) + one u8 per band), len (bytes),
+// timestamp_us = esp_timer time of the first sample (same clock as camera fb->timestamp); on the downlink
+// the bridge's mixer clock, 0 from bridges without one
+struct __attribute__((packed)) PcmHeader {
+    uint32_t magic;
+    uint8_t type;
+    uint16_t len;
+    uint64_t timestamp_us;
+};
+static constexpr uint32_t PCM_MAGIC = 0x314D4350u; // 'PCM1'
+
+static constexpr uint8_t PCM_TYPE_MIC = 0x01;
+static constexpr uint8_t PCM_TYPE_SPK = 0x02;
+static constexpr uint8_t PCM_TYPE_MIC_OPUS = 0x03;
+static constexpr uint8_t PCM_TYPE_MIC_SILENCE = 0x04;
+static constexpr uint8_t PCM_TYPE_ECHO = 0x05;     // latency test: timestamp_us = send time, echoed by the bridge
+static constexpr uint8_t PCM_TYPE_MIC_ADPCM = 0x06;
+static constexpr uint8_t PCM_TYPE_SPK_ADPCM = 0x07;
+static constexpr uint8_t PCM_TYPE_MIC_FEATURES = 0x08;
+
 class AudioCodec;
 
 void start_stream_tasks(AudioCodec* codec, const NetConfig& cfg);
 
+// Blocking TCP helpers (TCP_NODELAY, keepalive and a send timeout are set on connect); the latency test reuses them
+int connect_to(const NetConfig& cfg);
+bool send_all(int sock, const uint8_t* data, size_t len);
+bool recv_all(int sock, uint8_t* data, size_t len);
@@ -0,0 +1,199 @@
+#include "usb_audio.h"
+#include "audio_codec.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/stream_buffer.h>
+#include <usb_device_uac.h>
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+static const char* TAG = "usb_audio";
+
+#ifndef CONFIG_UAC_SAMPLE_RATE
+#define CONFIG_UAC_SAMPLE_RATE 48000
+#endif
+#ifndef CONFIG_UAC_MIC_CHANNEL_NUM
+#define CONFIG_UAC_MIC_CHANNEL_NUM 1
+#endif
+#ifndef CONFIG_UAC_SPEAKER_CHANNEL_NUM
+#define CONFIG_UAC_SPEAKER_CHANNEL_NUM 2
+#endif
+
+static constexpr int USB_AUDIO_BLOCK_MS = 5;        // I2S read/write granularity of the two pump tasks
+static constexpr int USB_AUDIO_FIFO_MS = 40;        // elastic FIFO per direction
+static constexpr int USB_AUDIO_SPK_TARGET_MS = 10;  // speaker FIFO level the slip keeps
+static constexpr int USB_AUDIO_SPK_BAND_MS = 4;     // slip when the average level leaves target +- band
+static constexpr int USB_AUDIO_LOG_MS = 10000;
+
+namespace {
+
+struct UsbAudio {
+    AudioCodec* codec;
+    StreamBufferHandle_t mic;           // capture task -> input_cb, UAC channel layout
+    StreamBufferHandle_t spk;           // output_cb -> player task, UAC channel layout
+    int volume;                         // last volume the host set, restored on unmute
+    volatile uint32_t mic_overflow = 0;
+    volatile uint32_t spk_overflow = 0;
+    volatile uint32_t spk_slips = 0;
+};
+
+UsbAudio* g_usb = nullptr;
+
+size_t ms_bytes(int ms, int channels) {
+    return (size_t)CONFIG_UAC_SAMPLE_RATE * ms / 1000 * channels * sizeof(int16_t);
+}
+
+// Frame-wise channel mapping; extra output channels repeat the last input channel
+void remap(const int16_t* in, int in_ch, int16_t* out, int out_ch, size_t frames) {
+    for (size_t f = 0; f < frames; f++) {
+        for (int c = 0; c < out_ch; c++) out[f * out_ch + c] = in[f * in_ch + std::min(c, in_ch - 1)];
+    }
+}
+
+// Host -> speaker FIFO; called from the component's task for every OUT packet
+esp_err_t output_cb(uint8_t* buf, size_t len, void*) {
+    // Whole packets only, so the FIFO never holds a partial frame
+    if (xStreamBufferSpacesAvailable(g_usb->spk) < len) {
+        g_usb->spk_overflow++;
+        return ESP_OK;
+    }
+    xStreamBufferSend(g_usb->spk, buf, len, 0);
+    return ESP_OK;
+}
+
+// Mic FIFO -> host; an asynchronous source sends what the I2S clock has produced, whole frames only
+esp_err_t input_cb(uint8_t* buf, size_t len, size_t* bytes_read, void*) {
+    const size_t frame = CONFIG_UAC_MIC_CHANNEL_NUM * sizeof(int16_t);
+    size_t avail = xStreamBufferBytesAvailable(g_usb->mic);
+    *bytes_read = xStreamBufferReceive(g_usb->mic, buf, std::min(len, avail) / frame * frame, 0);
+    return ESP_OK;
+}
+
+void set_mute_cb(uint32_t mute, void*) {
+    g_usb->codec->SetOutputVolume(mute ? 0 : g_usb->volume);
+}
+
+void set_volume_cb(uint32_t volume, void*) {
+    g_usb->volume = (int)std::min<uint32_t>(volume, 100);
+    g_usb->codec->SetOutputVolume(g_usb->volume);
+}
+
+// I2S RX -> mic FIFO. The FIFO keeps the newest audio: on overflow the block is dropped and counted.
+void mic_task(void*) {
+    AudioCodec* codec = g_usb->codec;
+    const size_t frames = (size_t)CONFIG_UAC_SAMPLE_RATE * USB_AUDIO_BLOCK_MS / 1000;
+    std::vector<int16_t> in(frames * codec->input_channels());
+    std::vector<int16_t> out(frames * CONFIG_UAC_MIC_CHANNEL_NUM);
+    while (true) {
+        if (!codec->input_enabled()) codec->EnableInput(true);
+        if (!codec->InputData(in.data(), (int)in.size())) {
+            vTaskDelay(pdMS_TO_TICKS(USB_AUDIO_BLOCK_MS));
+            continue;
+        }
+        remap(in.data(), codec->input_channels(), out.data(), CONFIG_UAC_MIC_CHANNEL_NUM, frames);
+        size_t bytes = out.size() * sizeof(int16_t);
+        if (xStreamBufferSpacesAvailable(g_usb->mic) < bytes) {
+            g_usb->mic_overflow++;                  // host not polling (stream closed): drop
+            continue;
+        }
+        xStreamBufferSend(g_usb->mic, out.data(), bytes, 0);
+    }
+}
+
+// Speaker FIFO -> I2S TX, one block per iteration paced by the DMA. The FIFO level is averaged over
+// ~1 s; above the band one frame of the block is dropped, below it the last frame is played twice.
+void spk_task(void*) {
+    AudioCodec* codec = g_usb->codec;
+    const int in_ch = CONFIG_UAC_SPEAKER_CHANNEL_NUM;
+    const int out_ch = codec->output_channels();
+    const size_t frames = (size_t)CONFIG_UAC_SAMPLE_RATE * USB_AUDIO_BLOCK_MS / 1000;
+    const size_t frame_bytes = in_ch * sizeof(int16_t);
+    const float target = (float)ms_bytes(USB_AUDIO_SPK_TARGET_MS, in_ch);
+    const float band = (float)ms_bytes(USB_AUDIO_SPK_BAND_MS, in_ch);
+    std::vector<int16_t> in((frames + 1) * in_ch);
+    std::vector<int16_t> out((frames + 1) * out_ch);
+    float level = target;
+    bool playing = false;
+    uint32_t logged_slips = 0;
+    TickType_t log_at = xTaskGetTickCount();
+
+    while (true) {
+        if (xTaskGetTickCount() - log_at >= pdMS_TO_TICKS(USB_AUDIO_LOG_MS)) {
+            log_at = xTaskGetTickCount();
+            if (g_usb->spk_slips != logged_slips) {
+                logged_slips = g_usb->spk_slips;
+                ESP_LOGI(TAG, "speaker slips %lu, speaker overflow %lu, mic overflow %lu", (unsigned long)logged_slips,
+                         (unsigned long)g_usb->spk_overflow, (unsigned long)g_usb->mic_overflow);
+            }
+        }
+
+        size_t avail = xStreamBufferBytesAvailable(g_usb->spk);
+        if (!playing) {
+            // Start (or restart after the host paused) only once the target is queued
+            if (avail < (size_t)target) {
+                vTaskDelay(pdMS_TO_TICKS(USB_AUDIO_BLOCK_MS));
+                continue;
+            }
+            playing = true;
+            level = target;
+            if (!codec->output_enabled()) codec->EnableOutput(true);
+        }
+        level += ((float)avail - level) / (1000.0f / USB_AUDIO_BLOCK_MS);
+
+        size_t want = frames;
+        if (level > target + band) {
+            want = frames + 1;                      // host clock fast: consume one extra frame
+        } else if (level < target - band) {
+            want = frames - 1;                      // host clock slow: stretch by one frame
+        }
+        size_t got = xStreamBufferReceive(g_usb->spk, in.data(), want * frame_bytes, pdMS_TO_TICKS(USB_AUDIO_BLOCK_MS)) /
+                     frame_bytes;
+        if (got == 0) {
+            playing = false;                        // host stopped sending
+            continue;
+        }
+        if (want != frames) {
+            g_usb->spk_slips++;
+            level = target;                         // let the average settle before the next slip
+        }
+        size_t play = got;
+        if (want == frames + 1 && got == want) {
+            play = frames;                          // drop the last frame
+        } else if (want == frames - 1 && got == want) {
+            std::copy_n(in.data() + (got - 1) * in_ch, in_ch, in.data() + got * in_ch);
+            play = frames;                          // repeat the last frame
+        }
+        remap(in.data(), in_ch, out.data(), out_ch, play);
+        codec->OutputData(out.data(), (int)(play * out_ch));
+    }
+}
+
+} // namespace
+
+void start_usb_audio(AudioCodec* codec) {
+    assert(codec->input_sample_rate() == CONFIG_UAC_SAMPLE_RATE && codec->output_sample_rate() == CONFIG_UAC_SAMPLE_RATE);
+    g_usb = new UsbAudio{ codec,
+                          xStreamBufferCreate(ms_bytes(USB_AUDIO_FIFO_MS, CONFIG_UAC_MIC_CHANNEL_NUM), 1),
+                          xStreamBufferCreate(ms_bytes(USB_AUDIO_FIFO_MS, CONFIG_UAC_SPEAKER_CHANNEL_NUM), 1),
+                          codec->output_volume() };
+    assert(g_usb->mic && g_usb->spk);
+
+    xTaskCreate(&mic_task, "uac_mic", 3072, nullptr, 8, nullptr);
+    xTaskCreate(&spk_task, "uac_spk", 3072, nullptr, 7, nullptr);
+
+    uac_device_config_t config = {};
+    config.output_cb = output_cb;
+    config.input_cb = input_cb;
+    config.set_mute_cb = set_mute_cb;
+    config.set_volume_cb = set_volume_cb;
+    esp_err_t err = uac_device_init(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "uac_device_init failed: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "USB sound card: %d Hz, mic %d ch, speaker %d ch", CONFIG_UAC_SAMPLE_RATE,
+             CONFIG_UAC_MIC_CHANNEL_NUM, CONFIG_UAC_SPEAKER_CHANNEL_NUM);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+class AudioCodec;
+
+// USB sound card mode, run instead of the stream tasks (CONFIG_STREAM_USB_AUDIO). The S3's OTG port
+// enumerates as a UAC device (espressif/usb_device_uac, TinyUSB) with the ES8388 mic as its input and
+// the speaker as its output; rate and channel counts come from the component's menuconfig
+// (UAC_SAMPLE_RATE must match the codec rates set in main.cc).
+//
+// Both directions stream between the USB callbacks and the I2S DMA through a short elastic FIFO.
+// The mic side is an asynchronous source: each IN packet carries whatever the I2S clock produced
+// since the last one, so the host follows the board's clock. The speaker side cannot pace the host,
+// so the player slips one frame (drops or repeats it) whenever the FIFO level drifts out of a band
+// around its target, absorbing the USB SOF vs I2S clock difference without underruns.
+void start_usb_audio(AudioCodec* codec);
@@ -0,0 +1,83 @@
+#include "wake_stage.h"
+
+#include <esp_wn_models.h>
+#include <model_path.h>
+#include <esp_log.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+static const char* TAG = "wake_stage";
+
+static constexpr int WAKE_BUFFER_MS = 300;         // queued audio before Feed() starts dropping
+static constexpr int WAKE_READ_MS = 20;            // one captured frame per wakeup
+static constexpr uint32_t WAKE_TASK_STACK = 8192;  // WakeNet's detect() needs a deep stack
+static constexpr UBaseType_t WAKE_TASK_PRIORITY = 4;
+static constexpr BaseType_t WAKE_TASK_CORE = 1;
+
+WakeStage::WakeStage(int in_rate, int in_channels)
+    : in_channels_(in_channels), resampler_(in_rate, SAMPLE_RATE, 1) {
+    srmodel_list_t* models = esp_srmodel_init("model");
+    char* name = models != nullptr ? esp_srmodel_filter(models, ESP_WN_PREFIX, nullptr) : nullptr;
+    if (name == nullptr) {
+        ESP_LOGE(TAG, "no WakeNet model in the \"model\" partition");
+        return;
+    }
+    wakenet_ = (const esp_wn_iface_t*)esp_wn_handle_from_name(name);
+    model_ = wakenet_ != nullptr ? wakenet_->create(name, DET_MODE_95) : nullptr;
+    if (model_ == nullptr || !resampler_.valid()) {
+        ESP_LOGE(TAG, "WakeNet create failed (%s)", name);
+        model_ = nullptr;
+        return;
+    }
+    if (char* word = esp_wn_wakeword_from_name(name)) word_ = word;
+    chunk_ = (size_t)wakenet_->get_samp_chunksize(model_);
+
+    const size_t frame_bytes = (size_t)in_rate * WAKE_READ_MS / 1000 * sizeof(int16_t);
+    input_ = xStreamBufferCreate((size_t)in_rate * WAKE_BUFFER_MS / 1000 * sizeof(int16_t), frame_bytes);
+    assert(input_);
+    xTaskCreatePinnedToCore(&WakeStage::Task, "wake_word", WAKE_TASK_STACK, this, WAKE_TASK_PRIORITY,
+                            nullptr, WAKE_TASK_CORE);
+    ESP_LOGI(TAG, "WakeNet %s ready, wake word \"%s\", %u samples per detect", name, word_, (unsigned)chunk_);
+}
+
+WakeStage::~WakeStage() {
+    if (model_ != nullptr) wakenet_->destroy(model_);
+}
+
+void WakeStage::Feed(const int16_t* frame, size_t samples) {
+    const size_t frames = samples / in_channels_;
+    mono_.resize(frames);
+    for (size_t i = 0; i < frames; i++) mono_[i] = frame[i * in_channels_];
+    xStreamBufferSend(input_, mono_.data(), frames * sizeof(int16_t), 0);
+}
+
+void WakeStage::Task(void* arg) {
+    WakeStage* self = static_cast<WakeStage*>(arg);
+    const size_t read_max = (size_t)self->resampler_.in_rate() * WAKE_READ_MS / 1000;
+    std::vector<int16_t> in(read_max);
+    std::vector<int16_t> converted;
+    std::vector<int16_t> chunk(self->chunk_);
+    size_t filled = 0;
+
+    while (true) {
+        size_t n = xStreamBufferReceive(self->input_, in.data(), read_max * sizeof(int16_t), portMAX_DELAY) /
+                   sizeof(int16_t);
+        converted.resize(self->resampler_.MaxOutput(n));
+        converted.resize(self->resampler_.Process(in.data(), n, converted.data()));
+
+        for (size_t off = 0; off < converted.size();) {
+            size_t take = std::min(self->chunk_ - filled, converted.size() - off);
+            memcpy(chunk.data() + filled, converted.data() + off, take * sizeof(int16_t));
+            filled += take;
+            off += take;
+            if (filled < self->chunk_) break;
+            filled = 0;
+            if (self->wakenet_->detect(self->model_, chunk.data()) == WAKENET_DETECTED) {
+                ESP_LOGI(TAG, "wake word \"%s\" detected", self->word_);
+                self->detected_.store(true);
+            }
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/stream_buffer.h>
+#include <esp_wn_iface.h>
+#include "pcm_resampler.h"
+
+// Wake-word detector for the uplink gate (esp-sr WakeNet, model from the "model" partition).
+// The uplink task hands over each captured frame with Feed(), which only copies the first channel
+// into a stream buffer and never blocks; a task pinned to core 1 resamples it to 16 kHz and runs
+// WakeNet on it, so detection costs the network tasks nothing but the copy.
+class WakeStage {
+public:
+    static constexpr int SAMPLE_RATE = 16000;  // WakeNet only runs at 16 kHz
+
+    // in_rate / in_channels: the captured frames handed to Feed()
+    WakeStage(int in_rate, int in_channels);
+    ~WakeStage();
+
+    bool valid() const { return model_ != nullptr; }
+
+    // samples: interleaved int16 count of one captured frame. Drops audio while the detector is behind.
+    void Feed(const int16_t* frame, size_t samples);
+
+    // True once per detection
+    bool Take() { return detected_.exchange(false); }
+
+    // New connection: forget a detection nobody took
+    void Reset() { detected_.store(false); }
+
+private:
+    static void Task(void* arg);
+
+    const esp_wn_iface_t* wakenet_ = nullptr;
+    model_iface_data_t* model_ = nullptr;
+    const char* word_ = "";
+    int in_channels_;
+    size_t chunk_ = 0;                          // samples per detect() call
+    PcmResampler resampler_;
+    StreamBufferHandle_t input_ = nullptr;      // mono int16 at in_rate, Feed() -> Task()
+    std::vector<int16_t> mono_;                 // Feed() scratch (uplink task)
+    std::atomic<bool> detected_{ false };
+};
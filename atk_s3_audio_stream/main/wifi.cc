@@ -15,6 +15,9 @@ static const char* TAG = "wifi";
 #ifndef CONFIG_WIFI_PASSWORD
 #define CONFIG_WIFI_PASSWORD "YOUR_PASSWORD"
 #endif
+#ifndef CONFIG_STREAM_SOFTAP_CHANNEL
+#define CONFIG_STREAM_SOFTAP_CHANNEL 1
+#endif
 
 static EventGroupHandle_t s_wifi_event_group;
 static const int WIFI_CONNECTED_BIT = BIT0;
@@ -27,9 +30,48 @@ static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_
         ESP_LOGW(TAG, "retry to connect to the AP");
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_AP_STAIPASSIGNED) {
+        auto* event = static_cast<ip_event_ap_staipassigned_t*>(event_data);
+        ESP_LOGI(TAG, "Client joined: " IPSTR, IP2STR(&event->ip));
+        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
+#ifdef CONFIG_STREAM_WIFI_SOFTAP
+// Access point for a single client on a fixed channel: DTIM 1 so a dozing client collects buffered
+// packets at every beacon, and no modem sleep on the board. Waits until the client has an address.
+static bool wifi_start_softap(void) {
+    esp_netif_create_default_wifi_ap();
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+
+    s_wifi_event_group = xEventGroupCreate();
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_AP_STAIPASSIGNED, &event_handler, NULL, NULL));
+
+    wifi_config_t wifi_config = {};
+    strncpy((char*)wifi_config.ap.ssid, CONFIG_WIFI_SSID, sizeof(wifi_config.ap.ssid));
+    strncpy((char*)wifi_config.ap.password, CONFIG_WIFI_PASSWORD, sizeof(wifi_config.ap.password));
+    wifi_config.ap.ssid_len = strlen(CONFIG_WIFI_SSID);
+    wifi_config.ap.channel = CONFIG_STREAM_SOFTAP_CHANNEL;
+    wifi_config.ap.authmode = WIFI_AUTH_WPA2_PSK;
+    wifi_config.ap.max_connection = 1;
+    wifi_config.ap.beacon_interval = 100;
+    wifi_config.ap.dtim_period = 1;
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
+    ESP_ERROR_CHECK(esp_wifi_start());
+    esp_wifi_set_ps(WIFI_PS_NONE);
+    esp_wifi_set_inactive_time(WIFI_IF_AP, 10);     // a client that left frees the only slot quickly
+
+    ESP_LOGI(TAG, "Access point %s on channel %d, waiting for the bridge PC", CONFIG_WIFI_SSID, CONFIG_STREAM_SOFTAP_CHANNEL);
+    xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    return true;
+}
+#endif
+
 bool wifi_init_and_connect(void) {
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -40,6 +82,9 @@ bool wifi_init_and_connect(void) {
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
+#ifdef CONFIG_STREAM_WIFI_SOFTAP
+    return wifi_start_softap();
+#endif
     esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
@@ -1,39 +1,590 @@
 #!/usr/bin/env python3
 import asyncio
+import collections
 import websockets
 import threading
 from http.server import SimpleHTTPRequestHandler, HTTPServer
 import os
+import random
+import socket
 import struct
+import time
+from urllib.parse import parse_qs, unquote
+
+import numpy as np
+
+import ima_adpcm
+
+try:
+    import opuslib  # only needed when the board sends Opus (CONFIG_STREAM_UPLINK_OPUS)
+except ImportError:
+    opuslib = None
 
 # Ports
 HTTP_PORT = int(os.getenv('HTTP_PORT', '9000'))
 WS_PORT = int(os.getenv('WS_PORT', '9001'))
 TCP_PORT = int(os.getenv('TCP_PORT', '9002'))
+UDP_PORT = int(os.getenv('UDP_PORT', str(TCP_PORT)))  # RTP transport (CONFIG_STREAM_TRANSPORT_RTP)
+
+PCM_MAGIC = 0x314D4350  # 'PCM1'
+# magic, type, len, timestamp_us (esp_timer time of the first sample, same clock as camera frames)
+PCM_HEADER = struct.Struct('<IBHQ')
+PCM_TYPE_MIC = 0x01       # raw 16-bit PCM
+PCM_TYPE_SPK = 0x02
+PCM_TYPE_MIC_OPUS = 0x03  # one 20 ms Opus frame
+PCM_TYPE_MIC_SILENCE = 0x04  # VAD keepalive during silence, payload uint16 noise rms
+PCM_TYPE_ECHO = 0x05      # latency test (CONFIG_STREAM_LATENCY_TEST): returned to the board unchanged
+PCM_TYPE_MIC_ADPCM = 0x06  # one IMA-ADPCM block (ima_adpcm.py), CONFIG_STREAM_UPLINK_ADPCM
+PCM_TYPE_SPK_ADPCM = 0x07  # the same for the downlink, sent to boards that ask with "?down=adpcm"
+PCM_TYPE_MIC_FEATURES = 0x08  # log-mel feature vectors (CONFIG_STREAM_UPLINK_FEATURES), see Board.features()
+MIC_TYPES = (PCM_TYPE_MIC, PCM_TYPE_MIC_OPUS, PCM_TYPE_MIC_SILENCE, PCM_TYPE_MIC_ADPCM, PCM_TYPE_MIC_FEATURES)
+
+# RTP payload types used by the board (dynamic range)
+RTP_PT_PCM = 96       # 16-bit little-endian PCM
+RTP_PT_OPUS = 97
+RTP_PT_SILENCE = 98   # VAD keepalive
+RTP_PT_ADPCM = 99     # IMA-ADPCM block, either direction
+RTP_PT_FEATURES = 100  # log-mel feature vectors
+RTP_PT_TYPES = {RTP_PT_PCM: PCM_TYPE_MIC, RTP_PT_OPUS: PCM_TYPE_MIC_OPUS, RTP_PT_ADPCM: PCM_TYPE_MIC_ADPCM}
+RTP_HELLO = b"HELLO-RTP"
+RTP_BOARD_TIMEOUT = 3.0  # seconds without a datagram before falling back to the TCP downlink
+RTP_MAX_GAP = 5          # uplink losses filled with silence so the page keeps its timing
+
+MIC_SAMPLE_RATE = 24000
+MIC_FRAME_SAMPLES = MIC_SAMPLE_RATE // 50
+SPK_FRAME_BYTES = 2 * (24000 // 50)  # downlink RTP packet: 20 ms of 24 kHz mono
+WS_CLIENT_QUEUE = int(os.getenv('WS_CLIENT_QUEUE', '10'))  # packets queued per browser (10 x 20 ms) before dropping the oldest
+WS_REPORT_S = 10.0  # how often slow browsers are reported
 
-PCM_MAGIC = 0x304D4350  # 'PCM0'
+# Rooms: every board and browser belongs to one room and hears the mix of everyone else in it
+DEFAULT_ROOM = 'default'
+HELLO_ID = b"HELLO-ID"  # optional prefix before the direction hello: u8 length + "<room>/<board>[?down=adpcm]" (UTF-8)
+MIX_FRAME_SAMPLES = MIC_FRAME_SAMPLES  # the mixer runs one 20 ms frame per tick
+MIX_FRAME_BYTES = 2 * MIX_FRAME_SAMPLES
+MIX_INTERVAL_S = MIX_FRAME_SAMPLES / MIC_SAMPLE_RATE
+MIX_PREBUFFER = int(os.getenv('MIX_PREBUFFER', '2'))  # frames a source buffers before it joins the mix (again after running dry)
+MIX_MAX_FRAMES = 5  # a source that runs ahead of the mixer loses its oldest audio beyond this
+# Clock drift: every source is resampled by the measured rate of its clock against the mixer, plus a
+# slow pull of its buffer depth back to MIX_PREBUFFER frames, so the depth stays put for days
+DRIFT_WINDOW_S = 5.0       # one minimum transit offset per window
+DRIFT_WINDOWS = 60         # the rate is fitted over the last 5 minutes of minima
+DRIFT_MIN_WINDOWS = 6      # no estimate for the first 30 s
+DRIFT_RESET_S = 1.0        # an offset jump this large is a restarted sender, not drift
+DRIFT_MAX = 0.002          # ratio clamp (2000 ppm, far beyond crystal tolerance)
+DEPTH_CENTRE_S = 60.0      # time to work off a depth error
+DEPTH_SMOOTH = 256         # depth average over ~5 s of mixer ticks
+DRIFT_REPORT_S = 60.0
+FEATURE_LOG = os.getenv('FEATURE_LOG', '')  # CSV file the boards' log-mel vectors are appended to (empty: not kept)
+FEATURE_EVENT = 0x01  # vector flag: the board saw an acoustic event in this frame
+VOICE_DSCP = int(os.getenv('VOICE_DSCP', '46'))  # EF: board downlink on WMM AC_VO (0 leaves it unmarked), as CONFIG_STREAM_DSCP_*
+BOARD_TX_LIMIT = 8 * (PCM_HEADER.size + MIX_FRAME_BYTES)  # unsent TCP downlink bytes before frames are dropped
 
 # Global state
-clients = set()  # websocket clients
-board_writer = None  # asyncio StreamWriter to ESP32 board (downlink)
+rooms = {}  # name -> Room
+boards = {}  # board id -> Board ("<room>/<board>" from HELLO-ID, else the board's IP in DEFAULT_ROOM)
+clients = set()  # WsClient per connected browser
+slow_clients = 0  # browsers that have fallen behind and dropped packets since the bridge started
+rtp_protocol = None  # RtpBoardProtocol, the UDP endpoint shared by all RTP boards
+feature_log = None  # open FEATURE_LOG
+mix_clock = 0  # mixer sample clock: samples since the bridge started, the downlink timestamps
+
+
+class UplinkDecoder:
+    """Turns uplink payloads into the raw PCM the web page plays; one per board stream."""
+
+    def __init__(self):
+        self.opus = None
+
+    def decode(self, ptype, payload):
+        """PcmHeader type and payload -> PCM; RuntimeError/ValueError when it cannot be decoded."""
+        if ptype == PCM_TYPE_MIC_ADPCM:
+            return ima_adpcm.decode(payload)  # each block carries its own coder state
+        if ptype != PCM_TYPE_MIC_OPUS:
+            return payload
+        # The mixer only takes raw PCM
+        if opuslib is None:
+            raise RuntimeError("Opus uplink needs 'pip install opuslib'")
+        if self.opus is None:
+            print("[BRIDGE] Opus uplink")
+            self.opus = opuslib.Decoder(MIC_SAMPLE_RATE, 1)
+        return self.opus.decode(payload, MIC_FRAME_SAMPLES)
+
+
+class DriftTracker:
+    """Rate of a sender's media clock against ours, from (arrival, media time) pairs. Queueing only adds
+    delay, so the minimum of arrival - media per window follows the clock difference without the jitter;
+    a least-squares line through the recent minima gives the drift."""
+
+    def __init__(self):
+        self.minima = collections.deque(maxlen=DRIFT_WINDOWS)  # (window centre, min offset), seconds
+        self.window_start = None
+        self.window_min = 0.0
+        self.last_offset = 0.0
+        self.slope = 0.0  # d(offset)/d(arrival): positive when the sender's clock runs slow; kept across resets
+
+    def add(self, arrival, media):
+        offset = arrival - media
+        if self.window_start is not None and abs(offset - self.last_offset) > DRIFT_RESET_S:
+            self.minima.clear()
+            self.window_start = None
+        self.last_offset = offset
+        if self.window_start is None:
+            self.window_start, self.window_min = arrival, offset
+            return
+        self.window_min = min(self.window_min, offset)
+        if arrival - self.window_start < DRIFT_WINDOW_S:
+            return
+        self.minima.append((self.window_start + DRIFT_WINDOW_S / 2, self.window_min))
+        self.window_start, self.window_min = arrival, offset
+        if len(self.minima) >= DRIFT_MIN_WINDOWS:
+            t, m = np.array(self.minima).T
+            self.slope = float(np.polyfit(t - t[0], m - m[0], 1)[0])
+
+
+class MixSource:
+    """One participant's audio on its way into the room mix: a byte FIFO popped one frame per mixer tick.
+    Each pop reads the FIFO at a rate that tracks the sender's clock (cubic interpolation with the
+    fractional read position carried between frames), so a fast or slow sender neither fills the FIFO
+    up to MIX_MAX_FRAMES nor drains it into a rebuffer."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.primed = False
+        self.overflow = 0  # frames dropped because the source ran ahead
+        self.drift = DriftTracker()
+        self.media = None  # media time (s) at the end of the audio fed so far
+        self.depth = None  # average samples buffered at pop time
+        self.phase = 0.0  # read position between buf[0] and buf[1]
+        self.prev = 0.0  # sample before buf[0], the left neighbour for the interpolation
+
+    def feed(self, pcm, media_us=None):
+        """media_us: sender timestamp of the first sample (board esp_timer time); without it, the
+        samples are counted against the arrival time, which still carries the sender's rate."""
+        now = time.monotonic()
+        if media_us is None:
+            media = self.media if self.media is not None else now
+        else:
+            media = media_us / 1e6
+        self.drift.add(now, media)
+        self.media = media + len(pcm) / 2 / MIC_SAMPLE_RATE
+        self.buf += pcm
+        excess = len(self.buf) - MIX_MAX_FRAMES * MIX_FRAME_BYTES
+        if excess > 0:
+            excess += excess & 1
+            del self.buf[:excess]
+            self.overflow += 1
+
+    def step(self):
+        """Input samples per output sample: the drift, plus the pull towards MIX_PREBUFFER frames."""
+        samples = len(self.buf) // 2
+        self.depth = samples if self.depth is None else self.depth + (samples - self.depth) / DEPTH_SMOOTH
+        error = (self.depth - max(1, MIX_PREBUFFER) * MIX_FRAME_SAMPLES) / MIC_SAMPLE_RATE
+        return 1.0 + float(np.clip(-self.drift.slope + error / DEPTH_CENTRE_S, -DRIFT_MAX, DRIFT_MAX))
+
+    def pop(self):
+        """Next frame, or None while this source is silent or rebuffering."""
+        if not self.primed:
+            if len(self.buf) < max(1, MIX_PREBUFFER) * MIX_FRAME_BYTES:
+                return None
+            self.primed = True
+            self.phase, self.prev = 0.0, 0.0
+        pos = self.phase + self.step() * np.arange(MIX_FRAME_SAMPLES)
+        need = int(pos[-1]) + 3  # the last output reads up to two samples past its position
+        if len(self.buf) < 2 * need:
+            self.primed = False  # ran dry: rebuffer before contributing again
+            return None
+        x = np.empty(need + 1)
+        x[0] = self.prev
+        x[1:] = np.frombuffer(self.buf, dtype='<i2', count=need)
+        i = pos.astype(np.int64)
+        t = pos - i
+        p0, p1, p2, p3 = x[i], x[i + 1], x[i + 2], x[i + 3]
+        out = p1 + 0.5 * t * (p2 - p0 + t * (2 * p0 - 5 * p1 + 4 * p2 - p3 + t * (3 * (p1 - p2) + p3 - p0)))
+        end = pos[-1] + (pos[1] - pos[0])
+        used = int(end)
+        self.phase = end - used
+        self.prev = x[used]
+        del self.buf[:2 * used]
+        return np.clip(np.rint(out), -32768, 32767).astype('<i2').tobytes()
+
+
+class Room:
+    """Mix-minus for one room: every member receives the sum of all other active members, saturated to int16.
+    All members are mixed in one vectorized pass, so the cost per tick is linear in the member count."""
+
+    def __init__(self, name):
+        self.name = name
+        self.members = []
+
+    def mix(self):
+        frames = [m.source.pop() for m in self.members]
+        active = [i for i, f in enumerate(frames) if f is not None]
+        if not active:
+            return
+        mat = np.frombuffer(b''.join(frames[i] for i in active), dtype='<i2').reshape(len(active), MIX_FRAME_SAMPLES)
+        mat = mat.astype(np.int32)
+        total = mat.sum(axis=0)
+        own = np.clip(total - mat, -32768, 32767).astype('<i2')  # active members do not hear themselves
+        others = np.clip(total, -32768, 32767).astype('<i2').tobytes() if len(active) < len(self.members) else None
+        row = 0
+        for i, m in enumerate(self.members):
+            if frames[i] is None:
+                m.send_mix(others)
+            else:
+                if len(active) > 1:
+                    m.send_mix(own[row].tobytes())
+                row += 1
+
+
+def get_room(name):
+    room = rooms.get(name)
+    if room is None:
+        room = rooms[name] = Room(name)
+    return room
+
+
+def join(member, room_name):
+    member.room = get_room(room_name)
+    member.room.members.append(member)
+    print(f"[ROOM] {member.label()} joined '{room_name}' ({len(member.room.members)} members)")
+
+
+def leave(member):
+    room = member.room
+    if room is None:
+        return
+    room.members.remove(member)
+    member.room = None
+    if not room.members:
+        del rooms[room.name]
+    print(f"[ROOM] {member.label()} left '{room.name}' ({len(room.members)} members)")
+
+
+class Board:
+    """A board in a room: its uplink (TCP or RTP) feeds the mix; the mix for it goes out its downlink."""
+
+    def __init__(self, board_id):
+        self.id = board_id
+        self.room = None
+        self.source = MixSource()
+        self.connections = 0  # open TCP connections
+        self.writer = None  # TCP downlink (HELLO-DOWN or HELLO-DX)
+        self.rtp = None  # RtpPeer once the board has sent something over UDP
+        self.tx_dropped = 0
+        self.down_adpcm = None  # ima_adpcm.Encoder when the board asked for an IMA-ADPCM downlink
+        self.in_event = False
+
+    def label(self):
+        return f"board {self.id}"
+
+    def features(self, payload, timestamp_us):
+        """Feature packet: u8 bands, u8 hop ms, then per frame u8 flags + one u8 per band, where
+        dBFS = value / 2 - 120. Events are logged; with FEATURE_LOG every vector is appended as
+        board,timestamp_us,flags,band0..bandN for the server-side models."""
+        global feature_log
+        if len(payload) < 2 or payload[0] == 0:
+            return
+        bands, hop_ms = payload[0], payload[1]
+        vectors = [payload[off:off + 1 + bands] for off in range(2, len(payload) - bands, 1 + bands)]
+        event = any(v[0] & FEATURE_EVENT for v in vectors)
+        if event and not self.in_event:
+            print(f"[FEAT] {self.label()}: acoustic event")
+        self.in_event = event
+        if not FEATURE_LOG:
+            return
+        if feature_log is None:
+            feature_log = open(FEATURE_LOG, 'a', buffering=1)
+        for i, v in enumerate(vectors):
+            ts = timestamp_us + i * hop_ms * 1000
+            feature_log.write(f"{self.id},{ts},{v[0]}," + ','.join(map(str, v[1:])) + '\n')
+
+    def alive(self):
+        return self.connections > 0 or (self.rtp is not None and self.rtp.alive())
+
+    def send_mix(self, pcm):
+        if self.rtp is not None and self.rtp.alive():
+            self.rtp.send_downlink(pcm)
+        elif self.writer is not None:
+            # Never await the board from the mixer: drop frames while its socket is backed up
+            if self.writer.transport.get_write_buffer_size() > BOARD_TX_LIMIT:
+                self.tx_dropped += 1
+                return
+            ptype = PCM_TYPE_SPK
+            if self.down_adpcm is not None:
+                ptype, pcm = PCM_TYPE_SPK_ADPCM, self.down_adpcm.encode(pcm)
+            self.writer.write(PCM_HEADER.pack(PCM_MAGIC, ptype, len(pcm), mix_us()) + pcm)
+
+
+def get_board(board_id, room_name, down_adpcm=False):
+    board = boards.get(board_id)
+    if board is None:
+        board = boards[board_id] = Board(board_id)
+        join(board, room_name)
+    if down_adpcm != (board.down_adpcm is not None):  # the latest hello decides, e.g. after a reflash
+        board.down_adpcm = ima_adpcm.Encoder() if down_adpcm else None
+        print(f"[ROOM] {board.label()}: {'IMA-ADPCM' if down_adpcm else 'PCM'} downlink")
+    return board
+
+
+def release_board(board):
+    if not board.alive() and boards.get(board.id) is board:
+        del boards[board.id]
+        leave(board)
+
+
+def parse_board_id(text, peer_ip):
+    """HELLO-ID payload "<room>/<board>" (or "<board>"), optionally followed by "?down=adpcm"
+    -> (board id, room, IMA-ADPCM downlink); legacy boards are keyed by IP."""
+    text, _, query = text.partition('?')
+    down_adpcm = parse_qs(query).get('down', [''])[0] == 'adpcm'
+    if not text:
+        return peer_ip, DEFAULT_ROOM, down_adpcm
+    return text, text.rpartition('/')[0] or DEFAULT_ROOM, down_adpcm
+
+
+class WsClient:
+    """One browser in a room: mixed packets wait in a bounded queue drained by the client's own sender task,
+    so the mixer never awaits a browser. A full queue drops its oldest packet. Its mic feeds the room mix.
+    A page that connects with "?codec=adpcm" sends and receives IMA-ADPCM blocks instead of raw PCM."""
+
+    def __init__(self, websocket, adpcm=False):
+        self.ws = websocket
+        self.room = None
+        self.source = MixSource()
+        self.adpcm = ima_adpcm.Encoder() if adpcm else None
+        self.queue = collections.deque(maxlen=max(1, WS_CLIENT_QUEUE))
+        self.ready = asyncio.Event()
+        self.sent = 0
+        self.dropped = 0
+        self.reported = 0  # dropped count at the last report
+
+    def label(self):
+        return f"browser {self.ws.remote_address}"
+
+    def send_mix(self, payload):
+        global slow_clients
+        if self.adpcm is not None:
+            payload = self.adpcm.encode(payload)
+        if len(self.queue) == self.queue.maxlen:
+            if not self.dropped:
+                slow_clients += 1
+            self.dropped += 1
+        self.queue.append(payload)
+        self.ready.set()
+
+    async def sender(self):
+        try:
+            while True:
+                await self.ready.wait()
+                while self.queue:
+                    await self.ws.send(self.queue.popleft())
+                    self.sent += 1
+                self.ready.clear()
+        except websockets.ConnectionClosed:
+            pass
+
+
+def mix_us():
+    """Mixer clock in microseconds; the TCP downlink timestamp (0 is reserved for "none")."""
+    return mix_clock * 1000000 // MIC_SAMPLE_RATE
+
+
+async def mixer():
+    """Mixes every room once per 20 ms frame, on a fixed schedule that does not drift with loop latency.
+    mix_clock counts the frames, so the boards can measure their speaker clock against it."""
+    global mix_clock
+    loop = asyncio.get_running_loop()
+    due = loop.time()
+    while True:
+        due += MIX_INTERVAL_S
+        delay = due - loop.time()
+        if delay < -10 * MIX_INTERVAL_S:
+            due = loop.time()  # the loop stalled: skip ahead instead of mixing a burst
+            mix_clock += int(-delay / MIX_INTERVAL_S) * MIX_FRAME_SAMPLES  # the clock skips with it
+        elif delay > 0:
+            await asyncio.sleep(delay)
+        mix_clock += MIX_FRAME_SAMPLES
+        for room in list(rooms.values()):
+            room.mix()
+
+
+async def housekeeping():
+    """Reports slow browsers and boards, and removes RTP boards that went quiet."""
+    while True:
+        await asyncio.sleep(WS_REPORT_S)
+        for c in list(clients):
+            if c.dropped != c.reported:
+                print(f"[WS] Slow client {c.ws.remote_address}: dropped {c.dropped - c.reported} packets "
+                      f"in {WS_REPORT_S:.0f} s ({c.dropped} total, {c.sent} sent, queue {len(c.queue)})")
+                c.reported = c.dropped
+        for board in list(boards.values()):
+            if board.tx_dropped:
+                print(f"[ROOM] {board.label()}: dropped {board.tx_dropped} downlink frames on a backed-up socket")
+                board.tx_dropped = 0
+            release_board(board)
+
+
+class RtpPeer:
+    """RTP state of one board: uplink sequence tracking and decoder, downlink sequence and timestamp."""
+
+    def __init__(self, addr, board):
+        self.addr = addr
+        self.board = board
+        self.last_seen = 0.0
+        self.ssrc = None
+        self.next_seq = 0
+        self.decoder = UplinkDecoder()
+        self.down_ssrc = random.getrandbits(32)
+        self.down_seq = random.getrandbits(16)
+        self.down_ts_base = random.getrandbits(32)  # downlink timestamp = base + mixer clock, so it runs on across gaps
+
+    def alive(self):
+        return time.monotonic() - self.last_seen < RTP_BOARD_TIMEOUT
+
+    def send_downlink(self, pcm):
+        """Packetizes mixed PCM into 20 ms RTP datagrams (one IMA-ADPCM block each if the board asked for it)."""
+        encoder = self.board.down_adpcm
+        ts = self.down_ts_base + mix_clock
+        for off in range(0, len(pcm) - 1, SPK_FRAME_BYTES):
+            chunk = pcm[off:off + SPK_FRAME_BYTES]
+            chunk = chunk[:len(chunk) & ~1]
+            samples = len(chunk) // 2
+            pt = RTP_PT_PCM
+            if encoder is not None:
+                pt, chunk = RTP_PT_ADPCM, encoder.encode(chunk)
+            hdr = struct.pack('!BBHII', 0x80, pt, self.down_seq, ts & 0xFFFFFFFF, self.down_ssrc)
+            rtp_protocol.transport.sendto(hdr + chunk, self.addr)
+            self.down_seq = (self.down_seq + 1) & 0xFFFF
+            ts += samples
+
+
+def set_dscp(sock):
+    # The AP queues its downlink per access category from the DSCP, so voice to the boards skips
+    # past bulk traffic (camera frames, downloads) queued for the same radio
+    if sock is None or VOICE_DSCP <= 0:
+        return
+    try:
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_TOS, VOICE_DSCP << 2)
+    except OSError as e:  # e.g. Windows without a QoS policy
+        print(f"[QoS] IP_TOS not set: {e}")
+
+class RtpBoardProtocol(asyncio.DatagramProtocol):
+    """RTP over UDP from/to all boards: each source address is one RtpPeer; uplink audio feeds the board's room."""
+
+    def __init__(self):
+        self.transport = None
+        self.peers = {}  # addr -> RtpPeer
+
+    def connection_made(self, transport):
+        global rtp_protocol
+        self.transport = transport
+        rtp_protocol = self
+        set_dscp(transport.get_extra_info('socket'))
+
+    def _peer(self, addr, id_text):
+        board_id, room, down_adpcm = parse_board_id(id_text, addr[0])
+        peer = self.peers.get(addr)
+        if peer is None or peer.board.id != board_id or boards.get(board_id) is not peer.board:
+            print(f"[UDP] Board RTP from {addr} ({board_id})")
+            peer = self.peers[addr] = RtpPeer(addr, get_board(board_id, room, down_adpcm))
+            peer.board.rtp = peer
+        return peer
+
+    def datagram_received(self, data, addr):
+        if data.startswith(RTP_HELLO):
+            # "HELLO-RTP" [+ u8 length + "<room>/<board>"], once a second
+            n = data[len(RTP_HELLO)] if len(data) > len(RTP_HELLO) else 0
+            text = data[len(RTP_HELLO) + 1:len(RTP_HELLO) + 1 + n].decode('utf-8', 'replace')
+            self._peer(addr, text).last_seen = time.monotonic()
+            return
+        peer = self.peers.get(addr) or self._peer(addr, '')
+        peer.last_seen = time.monotonic()
+        pkt = parse_rtp(data)
+        if pkt is None:
+            print(f"[UDP] Bad datagram ({len(data)} bytes)")
+            return
+        pt, seq, ssrc, capture_us, payload = pkt
+        if ssrc != peer.ssrc:  # board restarted: new SSRC, fresh Opus decoder
+            peer.ssrc = ssrc
+            peer.next_seq = seq
+            peer.decoder = UplinkDecoder()
+        gap = (seq - peer.next_seq) & 0xFFFF
+        if gap >= 0x8000:
+            return  # late or duplicate
+        peer.next_seq = (seq + 1) & 0xFFFF
+        if pt == RTP_PT_SILENCE:
+            return  # board is alive but nobody is talking; it adds nothing to the mix
+        if pt == RTP_PT_FEATURES:
+            peer.board.features(payload, capture_us or 0)
+            return
+        if pt not in RTP_PT_TYPES:
+            return
+        try:
+            pcm = peer.decoder.decode(RTP_PT_TYPES[pt], payload)
+        except Exception as e:
+            print(f"[UDP] {e}")
+            return
+        if gap:
+            peer.board.source.feed(bytes(2 * MIC_FRAME_SAMPLES * min(gap, RTP_MAX_GAP)))  # keep the timing across losses
+        peer.board.source.feed(pcm, capture_us)
+
+
+def parse_rtp(data):
+    """Returns (pt, seq, ssrc, capture_us or None, payload) for an RTP v2 datagram, else None."""
+    if len(data) < 12 or data[0] >> 6 != 2:
+        return None
+    vpxcc, mpt, seq, _ts, ssrc = struct.unpack_from('!BBHII', data)
+    off = 12 + 4 * (vpxcc & 0x0F)
+    capture_us = None
+    if vpxcc & 0x10:
+        if len(data) < off + 4:
+            return None
+        profile, words = struct.unpack_from('!HH', data, off)
+        ext = data[off + 4:off + 4 + 4 * words]
+        off += 4 + 4 * words
+        if profile == 0xBEDE:  # one-byte elements; id 1 is the board's esp_timer capture time
+            i = 0
+            while i < len(ext):
+                if ext[i] == 0:
+                    i += 1
+                    continue
+                eid, elen = ext[i] >> 4, (ext[i] & 0x0F) + 1
+                if eid == 1 and elen == 8 and i + 9 <= len(ext):
+                    capture_us = struct.unpack_from('!Q', ext, i + 1)[0]
+                i += 1 + elen
+    end = len(data) - (data[-1] if vpxcc & 0x20 else 0)
+    if end < off:
+        return None
+    return mpt & 0x7F, seq, ssrc, capture_us, data[off:end]
 
 async def ws_handler(websocket):
-    global board_writer
-    clients.add(websocket)
+    # The URL path names the room: ws://host:9001/<room>
+    request = getattr(websocket, 'request', None)  # websockets >= 13; older versions expose .path
+    path = request.path if request is not None else getattr(websocket, 'path', '/')
+    path, _, query = path.partition('?')
+    room = unquote(path.strip('/')) or DEFAULT_ROOM
+    client = WsClient(websocket, parse_qs(query).get('codec', [''])[0] == 'adpcm')
+    clients.add(client)
+    join(client, room)
+    sender = asyncio.create_task(client.sender())
     try:
         async for message in websocket:
-            # Expect binary PCM 24k/16bit mono from browser mic; forward to board
+            # Expect binary PCM 24k/16bit mono from browser mic (or one IMA-ADPCM block of it); it joins the room mix
             if isinstance(message, (bytes, bytearray)):
-                if board_writer is not None:
-                    hdr = struct.pack('<IBH', PCM_MAGIC, 0x02, len(message))
+                if client.adpcm is not None:
                     try:
-                        board_writer.write(hdr)
-                        board_writer.write(message)
-                        await board_writer.drain()
-                    except Exception:
-                        pass
+                        message = ima_adpcm.decode(message)
+                    except ValueError as e:
+                        print(f"[WS] {e}")
+                        continue
+                client.source.feed(message)
     finally:
-        clients.discard(websocket)
+        clients.discard(client)
+        leave(client)
+        sender.cancel()
+        if client.dropped:
+            print(f"[WS] Client {websocket.remote_address} left after dropping {client.dropped} packets "
+                  f"({slow_clients} slow clients so far)")
 
 async def ws_server():
     async with websockets.serve(ws_handler, '0.0.0.0', WS_PORT, max_size=None, ping_interval=None):
@@ -42,40 +593,73 @@ async def ws_server():
 
 async def tcp_board_server():
     async def handle_board(reader: asyncio.StreamReader, writer: asyncio.StreamWriter):
-        global board_writer
         peer = writer.get_extra_info('peername')
         print(f"[TCP] Board connected: {peer}")
-        board_writer = writer
+        set_dscp(writer.get_extra_info('socket'))
+        board = None
         # Robust hello detection (read 8 first for HELLO-UP, else try HELLO-DOWN 10 bytes)
         try:
             hello8 = await reader.readexactly(8)
+            id_text = ''
+            if hello8 == HELLO_ID:  # board ID ahead of the direction hello
+                n = (await reader.readexactly(1))[0]
+                id_text = (await reader.readexactly(n)).decode('utf-8', 'replace')
+                hello8 = await reader.readexactly(8)
         except asyncio.IncompleteReadError:
             writer.close()
             await writer.wait_closed()
             return
 
         try:
-            if hello8 == b"HELLO-UP":  # uplink connection (from board mic)
-                print("[TCP] Uplink channel")
+            if hello8 in (b"HELLO-UP", b"HELLO-DX"):  # uplink connection (from board mic), DX also carries downlink
+                board = get_board(*parse_board_id(id_text, peer[0]))
+                board.connections += 1
+                if hello8 == b"HELLO-DX":
+                    print(f"[TCP] Duplex channel ({board.id})")
+                    board.writer = writer
+                else:
+                    print(f"[TCP] Uplink channel ({board.id})")
+                decoder = UplinkDecoder()  # per connection: the board resets its encoder on reconnect
                 while True:
-                    hdr = await reader.readexactly(7)  # <IBH
-                    magic, ptype, length = struct.unpack('<IBH', hdr)
-                    if magic != PCM_MAGIC or ptype != 0x01 or length == 0:
+                    hdr = await reader.readexactly(PCM_HEADER.size)
+                    magic, ptype, length, timestamp_us = PCM_HEADER.unpack(hdr)
+                    if magic != PCM_MAGIC or ptype not in MIC_TYPES or length == 0:
                         print(f"[TCP] Bad header magic={magic:x} type={ptype} len={length}")
                         break
                     payload = await reader.readexactly(length)
-                    if clients:
-                        await asyncio.gather(*(c.send(payload) for c in list(clients)))
+                    if ptype == PCM_TYPE_MIC_SILENCE:
+                        continue  # board is alive but nobody is talking; it adds nothing to the mix
+                    if ptype == PCM_TYPE_MIC_FEATURES:
+                        board.features(payload, timestamp_us)
+                        continue
+                    try:
+                        payload = decoder.decode(ptype, payload)
+                    except (RuntimeError, ValueError) as e:
+                        print(f"[TCP] {e}")
+                        break
+                    board.source.feed(payload, timestamp_us or None)
+            elif hello8 == b"HELLO-EC":  # latency test: the board times the round trip of each packet
+                print("[TCP] Echo channel")
+                while True:
+                    hdr = await reader.readexactly(PCM_HEADER.size)
+                    magic, ptype, length, _timestamp_us = PCM_HEADER.unpack(hdr)
+                    if magic != PCM_MAGIC or ptype != PCM_TYPE_ECHO:
+                        print(f"[TCP] Bad echo header magic={magic:x} type={ptype} len={length}")
+                        break
+                    payload = await reader.readexactly(length)
+                    writer.write(hdr + payload)
+                    await writer.drain()
             else:
                 extra = await reader.readexactly(2)  # to form 10 bytes
                 hello10 = hello8 + extra
                 if hello10 == b"HELLO-DOWN":  # downlink connection (to board speaker)
-                    print("[TCP] Downlink channel")
-                    # keep writer globally to forward WS mic to board
-                    board_writer = writer
-                    # keep connection open
-                    while True:
-                        await asyncio.sleep(1)
+                    board = get_board(*parse_board_id(id_text, peer[0]))
+                    board.connections += 1
+                    print(f"[TCP] Downlink channel ({board.id})")
+                    board.writer = writer
+                    # The board sends nothing here; wait for it to close
+                    while await reader.read(1024):
+                        pass
                 else:
                     print(f"[TCP] Unknown hello: {hello8 + extra}")
         except asyncio.IncompleteReadError:
@@ -92,8 +676,11 @@ async def tcp_board_server():
                 await writer.wait_closed()
             except Exception:
                 pass
-            if board_writer is writer:
-                board_writer = None
+            if board is not None:
+                if board.writer is writer:
+                    board.writer = None
+                board.connections -= 1
+                release_board(board)
 
     server = await asyncio.start_server(handle_board, '0.0.0.0', TCP_PORT)
     addrs = ', '.join(str(sock.getsockname()) for sock in server.sockets)
@@ -102,6 +689,8 @@ async def tcp_board_server():
         await server.serve_forever()
 
 class SPAHandler(SimpleHTTPRequestHandler):
+    extensions_map = {**SimpleHTTPRequestHandler.extensions_map, '.js': 'text/javascript'}  # worklet modules
+
     def translate_path(self, path):
         # Serve files from tools/www
         webroot = os.path.join(os.path.dirname(__file__), 'www')
@@ -109,20 +698,32 @@ class SPAHandler(SimpleHTTPRequestHandler):
             path = '/index.html'
         return os.path.join(webroot, path.lstrip('/'))
 
+    def end_headers(self):
+        # Cross-origin isolation, so the page may share a SharedArrayBuffer ring with its AudioWorklet
+        self.send_header('Cross-Origin-Opener-Policy', 'same-origin')
+        self.send_header('Cross-Origin-Embedder-Policy', 'require-corp')
+        super().end_headers()
+
 def http_thread():
     httpd = HTTPServer(('0.0.0.0', HTTP_PORT), SPAHandler)
     print(f"[HTTP] Serving http://0.0.0.0:{HTTP_PORT}")
     httpd.serve_forever()
 
+async def udp_board_server():
+    loop = asyncio.get_running_loop()
+    await loop.create_datagram_endpoint(RtpBoardProtocol, local_addr=('0.0.0.0', UDP_PORT))
+    print(f"[UDP] Board RTP server on 0.0.0.0:{UDP_PORT}")
+    await asyncio.Future()
+
 async def async_main():
     t = threading.Thread(target=http_thread, daemon=True)
     t.start()
-    await asyncio.gather(ws_server(), tcp_board_server())
+    await asyncio.gather(ws_server(), tcp_board_server(), udp_board_server(), mixer(), housekeeping())
 
 def main():
     asyncio.run(async_main())
 
 if __name__ == '__main__':
     print("Run: python bridge_server.py ; then open http://localhost:9000")
-    print("Ports: HTTP 9000, WS 9001, TCP 9002 (configurable via env)")
+    print("Ports: HTTP 9000, WS 9001, TCP/UDP 9002 (configurable via env)")
     main()
@@ -0,0 +1,108 @@
+"""IMA-ADPCM blocks as the board codes them (components/audio/ima_adpcm.cc).
+
+A block is a 4-byte header with the coder state before its first sample (int16 little-endian
+predictor, u8 step index, u8 zero) followed by 4 bits per sample, first sample in the high nibble.
+Coding runs in audioop's C implementation (standard library up to Python 3.12, the audioop-lts
+package after that); without it a pure-Python coder of the same algorithm takes over.
+"""
+import struct
+import warnings
+
+try:
+    with warnings.catch_warnings():
+        warnings.simplefilter('ignore', DeprecationWarning)
+        import audioop
+except ImportError:
+    audioop = None
+
+HEADER = struct.Struct('<hBx')  # predictor, step index
+MAX_INDEX = 88
+
+STEP_TABLE = (
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+)
+INDEX_TABLE = (-1, -1, -1, -1, 2, 4, 6, 8) * 2
+
+
+def _step(predictor, index, code):
+    step = STEP_TABLE[index]
+    diff = step >> 3
+    if code & 4:
+        diff += step
+    if code & 2:
+        diff += step >> 1
+    if code & 1:
+        diff += step >> 2
+    predictor = max(-32768, min(32767, predictor - diff if code & 8 else predictor + diff))
+    index = max(0, min(MAX_INDEX, index + INDEX_TABLE[code]))
+    return predictor, index
+
+
+def _encode_py(pcm, state):
+    predictor, index = state
+    out = bytearray(len(pcm) // 4)
+    for i, (sample,) in enumerate(struct.iter_unpack('<h', pcm)):
+        step = STEP_TABLE[index]
+        diff = sample - predictor
+        code = 0
+        if diff < 0:
+            code, diff = 8, -diff
+        if diff >= step:
+            code |= 4
+            diff -= step
+        if diff >= step >> 1:
+            code |= 2
+            diff -= step >> 1
+        if diff >= step >> 2:
+            code |= 1
+        predictor, index = _step(predictor, index, code)
+        out[i >> 1] |= code if i & 1 else code << 4
+    return bytes(out), (predictor, index)
+
+
+def _decode_py(data, state):
+    predictor, index = state
+    out = []
+    for byte in data:
+        for code in (byte >> 4, byte & 0x0F):
+            predictor, index = _step(predictor, index, code)
+            out.append(predictor)
+    return struct.pack(f'<{len(out)}h', *out)
+
+
+class Encoder:
+    """Codes 16-bit little-endian PCM into blocks; one per stream, the state runs on from block to block."""
+
+    def __init__(self):
+        self.state = (0, 0)
+
+    def encode(self, pcm):
+        if len(pcm) % 4:
+            pcm = bytes(pcm[:len(pcm) & ~1]) + b'\0\0'  # odd sample count: pad the last byte
+        header = HEADER.pack(*self.state)
+        if audioop is not None:
+            data, self.state = audioop.lin2adpcm(pcm, 2, self.state)
+        else:
+            data, self.state = _encode_py(pcm, self.state)
+        return header + data
+
+
+def decode(block):
+    """One block -> 16-bit little-endian PCM; ValueError for a malformed block."""
+    if len(block) <= HEADER.size:
+        raise ValueError(f"IMA-ADPCM block too short ({len(block)} bytes)")
+    predictor, index = HEADER.unpack_from(block)
+    if index > MAX_INDEX:
+        raise ValueError(f"IMA-ADPCM step index {index} out of range")
+    data = bytes(block[HEADER.size:])
+    if audioop is not None:
+        return audioop.adpcm2lin(data, 2, (predictor, index))[0]
+    return _decode_py(data, (predictor, index))
+
+
+def block_samples(block_len):
+    return 2 * (block_len - HEADER.size)
@@ -0,0 +1,194 @@
+// AudioWorklet processors for the bridge page: playback of the board's
+// 24 kHz mic stream and capture of the browser mic at 24 kHz. Both run on the
+// audio rendering thread; nothing touches the page's main thread per block.
+import { PcmRing, RING_HIGH, RING_TARGET } from './pcm_ring.js';
+
+function gcd(a, b) {
+  while (b) [a, b] = [b, a % b];
+  return a;
+}
+
+// Rational L/M polyphase resampler with a Blackman-windowed sinc prototype of
+// taps * L coefficients, cut off below the lower of the two Nyquist rates.
+// Each phase is normalised to unity DC gain. An instance is driven either by
+// output (run: player) or by input (push: capture), never both.
+class PolyphaseResampler {
+  constructor(inRate, outRate, taps = 16) {
+    const g = gcd(inRate, outRate);
+    this.L = outRate / g;
+    this.M = inRate / g;
+    this.taps = taps;
+    const n = taps * this.L;
+    const fc = 0.45 / Math.max(this.L, this.M); // cycles per sample at L * inRate
+    const mid = (n - 1) / 2;
+    this.phases = [];
+    for (let p = 0; p < this.L; p++) {
+      const c = new Float32Array(taps);
+      let sum = 0;
+      for (let j = 0; j < taps; j++) {
+        const k = p + j * this.L;
+        const t = k - mid;
+        const sinc = t === 0 ? 2 * fc : Math.sin(2 * Math.PI * fc * t) / (Math.PI * t);
+        const w = 0.42 - 0.5 * Math.cos(2 * Math.PI * k / (n - 1)) + 0.08 * Math.cos(4 * Math.PI * k / (n - 1));
+        c[j] = sinc * w;
+        sum += c[j];
+      }
+      for (let j = 0; j < taps; j++) c[j] /= sum;
+      this.phases.push(c);
+    }
+    this.hist = new Float32Array(2 * taps); // each sample stored twice so a tap window never wraps
+    this.pos = 0;
+    this.phase = 0;
+  }
+
+  _dot() {
+    const c = this.phases[this.phase];
+    const h = this.hist;
+    const base = this.pos + this.taps;
+    let acc = 0;
+    for (let j = 0; j < this.taps; j++) acc += c[j] * h[base - j];
+    return acc;
+  }
+
+  _push(x) {
+    this.pos = (this.pos + 1) % this.taps;
+    this.hist[this.pos] = this.hist[this.pos + this.taps] = x;
+  }
+
+  // Input samples run() consumes to produce n outputs.
+  inputFor(n) {
+    return Math.floor((this.phase + n * this.M) / this.L);
+  }
+
+  // Output driven: fills out[0..n) from exactly inputFor(n) samples of input.
+  run(input, out, n) {
+    let k = 0;
+    for (let i = 0; i < n; i++) {
+      out[i] = this._dot();
+      this.phase += this.M;
+      while (this.phase >= this.L) {
+        this.phase -= this.L;
+        this._push(input[k++]);
+      }
+    }
+  }
+
+  // Input driven: consumes all of input, appends outputs to out, returns their count.
+  push(input, out) {
+    let k = 0;
+    for (let i = 0; i < input.length; i++) {
+      this._push(input[i]);
+      while (this.phase < this.L) {
+        out[k++] = this._dot();
+        this.phase += this.M;
+      }
+      this.phase -= this.L;
+    }
+    return k;
+  }
+}
+
+const STATS_INTERVAL_S = 0.5;
+
+// Plays PCM from a PcmRing. Before starting, and after any underrun, waits
+// until the ring holds the page's jitter target; if the fill climbs above the
+// high-water mark (a burst after a stall) it drops back to the target so
+// latency does not ratchet up.
+class PcmPlayer extends AudioWorkletProcessor {
+  constructor(options) {
+    super();
+    const o = options.processorOptions;
+    this.ring = new PcmRing(o.sab || new ArrayBuffer(PcmRing.bytes(o.capacity)), o.capacity);
+    Atomics.store(this.ring.hdr, RING_TARGET, o.target);
+    Atomics.store(this.ring.hdr, RING_HIGH, o.high);
+    if (!o.sab) {
+      // Not cross-origin isolated: the page posts samples and targets instead
+      this.port.onmessage = (e) => {
+        const m = e.data;
+        if (m.pcm) this.ring.write(m.pcm);
+        if (m.target) {
+          Atomics.store(this.ring.hdr, RING_TARGET, m.target);
+          Atomics.store(this.ring.hdr, RING_HIGH, m.high);
+        }
+      };
+    }
+    this.rs = new PolyphaseResampler(o.inRate, sampleRate);
+    this.scratch = new Float32Array(0);
+    this.buffering = true;
+    this.underruns = 0;
+    this.dropped = 0;
+    this.statsAt = 0;
+  }
+
+  process(inputs, outputs) {
+    const chans = outputs[0];
+    const out = chans[0];
+    if (!out) return true;
+    const n = out.length;
+    const need = this.rs.inputFor(n);
+    const hdr = this.ring.hdr;
+    const avail = this.ring.available();
+    const target = Atomics.load(hdr, RING_TARGET);
+    if (currentFrame >= this.statsAt) {
+      this.statsAt = currentFrame + STATS_INTERVAL_S * sampleRate;
+      this.port.postMessage({ fill: avail, underruns: this.underruns, dropped: this.dropped });
+    }
+    if (this.buffering && avail >= Math.max(target, need)) {
+      this.buffering = false;
+    } else if (!this.buffering && avail < need) {
+      this.underruns++;
+      this.buffering = true;
+    }
+    if (this.buffering) {
+      for (const c of chans) c.fill(0);
+      return true;
+    }
+    const high = Atomics.load(hdr, RING_HIGH);
+    if (high && avail > high) {
+      const keep = Math.max(target, need);
+      this.ring.skip(avail - keep);
+      this.dropped += avail - keep;
+    }
+    if (this.scratch.length < need) this.scratch = new Float32Array(need);
+    this.ring.read(this.scratch, need);
+    this.rs.run(this.scratch, out, n);
+    for (let c = 1; c < chans.length; c++) chans[c].set(out);
+    return true;
+  }
+}
+
+// Resamples the mic to outRate and posts Int16 frames of frameSamples to the
+// page (transferred, not copied), which sends each one as a WebSocket message.
+class PcmCapture extends AudioWorkletProcessor {
+  constructor(options) {
+    super();
+    const o = options.processorOptions;
+    this.rs = new PolyphaseResampler(sampleRate, o.outRate);
+    this.frameSamples = o.frameSamples;
+    this.frame = new Int16Array(this.frameSamples);
+    this.fill = 0;
+    this.tmp = new Float32Array(0);
+  }
+
+  process(inputs) {
+    const input = inputs[0] && inputs[0][0];
+    if (!input) return true;
+    const max = Math.ceil(input.length * this.rs.L / this.rs.M) + 1;
+    if (this.tmp.length < max) this.tmp = new Float32Array(max);
+    const n = this.rs.push(input, this.tmp);
+    for (let i = 0; i < n; i++) {
+      let s = this.tmp[i];
+      if (s > 1) s = 1; else if (s < -1) s = -1;
+      this.frame[this.fill++] = s * 32767;
+      if (this.fill === this.frameSamples) {
+        this.port.postMessage(this.frame.buffer, [this.frame.buffer]);
+        this.frame = new Int16Array(this.frameSamples);
+        this.fill = 0;
+      }
+    }
+    return true;
+  }
+}
+
+registerProcessor('pcm-player', PcmPlayer);
+registerProcessor('pcm-capture', PcmCapture);
@@ -0,0 +1,69 @@
+// IMA-ADPCM blocks in the board's layout (components/audio/ima_adpcm.cc), for the page's optional
+// 4:1 WebSocket stream: a 4-byte header with the coder state before the first sample (int16
+// little-endian predictor, u8 step index, u8 zero), then 4 bits per sample, first in the high nibble.
+
+const STEP_TABLE = new Int16Array([
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+  337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+  2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+  15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+]);
+const INDEX_TABLE = new Int8Array([-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]);
+const MAX_INDEX = 88;
+export const ADPCM_HEADER_BYTES = 4;
+
+// Applies one code to state {p, i}; the encoder runs the same step so both ends stay in lockstep
+function step(s, code) {
+  const st = STEP_TABLE[s.i];
+  let diff = st >> 3;
+  if (code & 4) diff += st;
+  if (code & 2) diff += st >> 1;
+  if (code & 1) diff += st >> 2;
+  const p = code & 8 ? s.p - diff : s.p + diff;
+  s.p = p < -32768 ? -32768 : p > 32767 ? 32767 : p;
+  const i = s.i + INDEX_TABLE[code];
+  s.i = i < 0 ? 0 : i > MAX_INDEX ? MAX_INDEX : i;
+}
+
+export class ImaAdpcmEncoder {
+  constructor() {
+    this.s = { p: 0, i: 0 };
+  }
+
+  // Int16Array -> Uint8Array block; the state runs on into the next block
+  encode(pcm) {
+    const out = new Uint8Array(ADPCM_HEADER_BYTES + ((pcm.length + 1) >> 1));
+    const s = this.s;
+    new DataView(out.buffer).setInt16(0, s.p, true);
+    out[2] = s.i;
+    for (let n = 0; n < pcm.length; n++) {
+      let st = STEP_TABLE[s.i];
+      let diff = pcm[n] - s.p;
+      let code = 0;
+      if (diff < 0) { code = 8; diff = -diff; }
+      if (diff >= st) { code |= 4; diff -= st; }
+      st >>= 1;
+      if (diff >= st) { code |= 2; diff -= st; }
+      st >>= 1;
+      if (diff >= st) code |= 1;
+      step(s, code);
+      out[ADPCM_HEADER_BYTES + (n >> 1)] |= n & 1 ? code : code << 4;
+    }
+    return out;
+  }
+}
+
+// ArrayBuffer holding one block -> Int16Array, or null when the block is malformed
+export function imaAdpcmDecode(buffer) {
+  const b = new Uint8Array(buffer);
+  if (b.length <= ADPCM_HEADER_BYTES || b[2] > MAX_INDEX) return null;
+  const s = { p: new DataView(buffer).getInt16(0, true), i: b[2] };
+  const out = new Int16Array(2 * (b.length - ADPCM_HEADER_BYTES));
+  for (let n = 0; n < out.length; n++) {
+    const byte = b[ADPCM_HEADER_BYTES + (n >> 1)];
+    step(s, n & 1 ? byte & 0x0F : byte >> 4);
+    out[n] = s.p;
+  }
+  return out;
+}
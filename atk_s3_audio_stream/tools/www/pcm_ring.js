@@ -0,0 +1,61 @@
+// Single-producer / single-consumer ring of float samples, shared between
+// the page (WebSocket handler) and the AudioWorklet thread.
+//
+// Layout: Int32 header followed by `capacity` Float32 samples. Read and write
+// indices run freely and wrap at 2^32; capacity is a power of two so
+// `index & mask` stays correct across the wrap. Only the producer stores the
+// write index and only the consumer stores the read index, so Atomics
+// load/store is all the synchronisation needed. Works on a plain ArrayBuffer
+// too (fallback when the page is not cross-origin isolated).
+
+export const RING_WRITE = 0;
+export const RING_READ = 1;
+export const RING_TARGET = 2; // jitter target in samples, set by the page
+export const RING_HIGH = 3; // fill above which the player drops back to the target
+const HEADER_INTS = 4;
+const HEADER_BYTES = HEADER_INTS * 4;
+
+export class PcmRing {
+  static bytes(capacity) {
+    return HEADER_BYTES + capacity * 4;
+  }
+
+  constructor(buffer, capacity) {
+    if (capacity & (capacity - 1)) throw new Error('ring capacity must be a power of two');
+    this.hdr = new Int32Array(buffer, 0, HEADER_INTS);
+    this.data = new Float32Array(buffer, HEADER_BYTES, capacity);
+    this.capacity = capacity;
+    this.mask = capacity - 1;
+  }
+
+  available() {
+    return (Atomics.load(this.hdr, RING_WRITE) - Atomics.load(this.hdr, RING_READ)) | 0;
+  }
+
+  // Producer: appends as much of src as fits, returns the count written.
+  write(src) {
+    const w = Atomics.load(this.hdr, RING_WRITE);
+    const n = Math.min(src.length, this.capacity - this.available());
+    const pos = w & this.mask;
+    const first = Math.min(n, this.capacity - pos);
+    this.data.set(src.subarray(0, first), pos);
+    if (n > first) this.data.set(src.subarray(first, n), 0);
+    Atomics.store(this.hdr, RING_WRITE, (w + n) | 0);
+    return n;
+  }
+
+  // Consumer: copies exactly n samples into dst (caller checks available()).
+  read(dst, n) {
+    const r = Atomics.load(this.hdr, RING_READ);
+    const pos = r & this.mask;
+    const first = Math.min(n, this.capacity - pos);
+    dst.set(this.data.subarray(pos, pos + first), 0);
+    if (n > first) dst.set(this.data.subarray(0, n - first), first);
+    Atomics.store(this.hdr, RING_READ, (r + n) | 0);
+  }
+
+  // Consumer: discards n samples.
+  skip(n) {
+    Atomics.store(this.hdr, RING_READ, (Atomics.load(this.hdr, RING_READ) + n) | 0);
+  }
+}
@@ -22,14 +22,56 @@
 
 
 i2c_master_bus_handle_t bus_handle;     /* 总线句柄 */
+static SemaphoreHandle_t g_iic_lock = NULL;         /* 总线独占锁(递归互斥量, 带优先级继承) */
+static volatile uint32_t g_iic_urgent = 0;          /* 正在等待总线的高优先级访问数 */
+static portMUX_TYPE g_iic_init_mux = portMUX_INITIALIZER_UNLOCKED;
 
 /**
  * @brief       初始化MYIIC
+ * @note        总线只创建一次, 重复调用直接返回; 同一总线上的所有器件(XL9555, ES8388等)都应通过本模块获取总线句柄,
+ *              不能各自调用 i2c_new_master_bus
  * @param       无
  * @retval      ESP_OK:初始化成功
  */
 esp_err_t myiic_init(void)
 {
+    SemaphoreHandle_t lock;
+
+    if (bus_handle != NULL)
+    {
+        return ESP_OK;
+    }
+
+    lock = xSemaphoreCreateRecursiveMutex();
+
+    if (lock == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    taskENTER_CRITICAL(&g_iic_init_mux);
+
+    if (g_iic_lock == NULL)
+    {
+        g_iic_lock = lock;
+        lock = NULL;
+    }
+
+    taskEXIT_CRITICAL(&g_iic_init_mux);
+
+    if (lock != NULL)
+    {
+        vSemaphoreDelete(lock);             /* 其他线程已完成创建 */
+    }
+
+    xSemaphoreTakeRecursive(g_iic_lock, portMAX_DELAY);
+
+    if (bus_handle != NULL)
+    {
+        xSemaphoreGiveRecursive(g_iic_lock);
+        return ESP_OK;
+    }
+
     i2c_master_bus_config_t i2c_bus_config = {
         .clk_source                     = I2C_CLK_SRC_DEFAULT,  /* 时钟源 */
         .i2c_port                       = IIC_NUM_PORT,         /* I2C端口 */
@@ -41,5 +83,131 @@ esp_err_t myiic_init(void)
     /* 新建I2C总线 */
     ESP_ERROR_CHECK(i2c_new_master_bus(&i2c_bus_config, &bus_handle));
 
+    xSemaphoreGiveRecursive(g_iic_lock);
+
     return ESP_OK;
 }
+
+/**
+ * @brief       获取共享总线句柄(未初始化时先初始化)
+ * @param       无
+ * @retval      总线句柄
+ */
+i2c_master_bus_handle_t myiic_bus_get(void)
+{
+    if (bus_handle == NULL)
+    {
+        ESP_ERROR_CHECK(myiic_init());
+    }
+
+    return bus_handle;
+}
+
+/**
+ * @brief       独占总线
+ * @note        驱动本身对每次传输加锁, 这里用于把一组传输作为整体执行, 避免与其他器件交错;
+ *              有高优先级访问在等待时, 新的低优先级访问先让出, 高优先级访问不会排在一串低优先级批量写之后.
+ *              可嵌套调用(同一线程已持有时直接进入)
+ * @param       prio    : 访问优先级
+ * @param       timeout : 等待超时
+ * @retval      ESP_OK:成功; ESP_ERR_TIMEOUT:超时; ESP_ERR_INVALID_STATE:总线未初始化
+ */
+esp_err_t myiic_lock(myiic_prio_t prio, TickType_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t elapsed;
+
+    if (g_iic_lock == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (xSemaphoreGetMutexHolder(g_iic_lock) == xTaskGetCurrentTaskHandle())
+    {
+        xSemaphoreTakeRecursive(g_iic_lock, portMAX_DELAY);     /* 嵌套 */
+        return ESP_OK;
+    }
+
+    if (prio == MYIIC_PRIO_HIGH)
+    {
+        __atomic_add_fetch(&g_iic_urgent, 1, __ATOMIC_RELAXED);
+
+        if (xSemaphoreTakeRecursive(g_iic_lock, timeout) != pdTRUE)
+        {
+            __atomic_sub_fetch(&g_iic_urgent, 1, __ATOMIC_RELAXED);
+            return ESP_ERR_TIMEOUT;
+        }
+
+        __atomic_sub_fetch(&g_iic_urgent, 1, __ATOMIC_RELAXED);
+        return ESP_OK;
+    }
+
+    while (1)
+    {
+        elapsed = xTaskGetTickCount() - start;
+
+        if (timeout != portMAX_DELAY && elapsed >= timeout)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        if (g_iic_urgent != 0)
+        {
+            vTaskDelay(1);                                          /* 让高优先级访问先执行 */
+            continue;
+        }
+
+        if (xSemaphoreTakeRecursive(g_iic_lock, (timeout == portMAX_DELAY) ? portMAX_DELAY : (timeout - elapsed)) != pdTRUE)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        if (g_iic_urgent == 0)
+        {
+            return ESP_OK;
+        }
+
+        xSemaphoreGiveRecursive(g_iic_lock);                        /* 等待期间来了高优先级访问, 让出 */
+    }
+}
+
+/**
+ * @brief       释放总线
+ * @param       无
+ * @retval      无
+ */
+void myiic_unlock(void)
+{
+    xSemaphoreGiveRecursive(g_iic_lock);
+}
+
+/**
+ * @brief       批量写寄存器(8位地址, 8位数据)
+ * @note        整组写入期间独占总线, 每个寄存器一次传输, 中途失败立即返回
+ * @param       dev  : 器件句柄
+ * @param       regs : 寄存器列表
+ * @param       num  : 寄存器个数
+ * @param       prio : 访问优先级
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+esp_err_t myiic_write_regs(i2c_master_dev_handle_t dev, const myiic_reg_t *regs, size_t num, myiic_prio_t prio)
+{
+    esp_err_t ret = myiic_lock(prio, portMAX_DELAY);
+    uint8_t buf[2];
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    for (size_t i = 0; i < num && ret == ESP_OK; i++)
+    {
+        buf[0] = regs[i].reg;
+        buf[1] = regs[i].val;
+        ret = i2c_master_transmit(dev, buf, 2, -1);
+    }
+
+    myiic_unlock();
+
+    return ret;
+}
@@ -21,6 +21,8 @@
 #ifndef __MYIIC_H
 #define __MYIIC_H
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "driver/gpio.h"
 #include "driver/i2c_master.h"
 #include "esp_err.h"
@@ -32,9 +34,27 @@
 #define IIC_SDA_GPIO_PIN   GPIO_NUM_41      /* IIC0_SDA引脚 */
 #define IIC_SCL_GPIO_PIN   GPIO_NUM_42      /* IIC0_SCL引脚 */
 
+/* 总线访问优先级 */
+typedef enum
+{
+    MYIIC_PRIO_LOW = 0,                     /* 普通访问(按键/状态读取, 音频参数) */
+    MYIIC_PRIO_HIGH,                        /* 紧急访问(摄像头/LCD上电复位时序) */
+} myiic_prio_t;
+
+/* 一次寄存器写入 */
+typedef struct
+{
+    uint8_t reg;
+    uint8_t val;
+} myiic_reg_t;
+
 extern i2c_master_bus_handle_t bus_handle;  /* 总线句柄 */
 
 /* 函数声明 */
-esp_err_t myiic_init(void);                 /* 初始化MYIIC */
+esp_err_t myiic_init(void);                                                                         /* 初始化MYIIC(可重复调用) */
+i2c_master_bus_handle_t myiic_bus_get(void);                                                        /* 获取共享总线句柄 */
+esp_err_t myiic_lock(myiic_prio_t prio, TickType_t timeout);                                        /* 独占总线 */
+void myiic_unlock(void);                                                                            /* 释放总线 */
+esp_err_t myiic_write_regs(i2c_master_dev_handle_t dev, const myiic_reg_t *regs, size_t num, myiic_prio_t prio);   /* 批量写寄存器 */
 
 #endif
@@ -19,11 +19,19 @@
  */
 
 #include "my_spi.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
 
 
 /* SD卡设备句柄 */
 spi_device_handle_t MY_SD_Handle = NULL;
 
+static const char *const g_spi_dev_names[MY_SPI_DEV_NUM] = { "lcd", "sd" };
+static portMUX_TYPE g_spi_mux = portMUX_INITIALIZER_UNLOCKED;
+static my_spi_stats_t g_spi_stats;
+static volatile bool g_spi_sd_prio = false;
+static int64_t g_spi_sd_prio_start = 0;                         /* 本次SD卡优先的开始时间 */
+
 /**
  * @brief       spi初始化
  * @param       无
@@ -37,7 +45,13 @@ esp_err_t my_spi_init(void)
         .miso_io_num     = SPI_MISO_PIN,    /* 主机输入从机输出引脚 */
         .quadwp_io_num   = -1,              /* 用于Quad模式的WP引脚,未使用时设置为-1 */
         .quadhd_io_num   = -1,              /* 用于Quad模式的HD引脚,未使用时设置为-1 */
+#if MY_SPI_LCD_PANEL == 0
+        .max_transfer_sz = 0,               /* 只有SD卡(默认4092字节, 单块512字节) */
+#elif MY_SPI_SCHED_EN
+        .max_transfer_sz = MY_SPI_LCD_CHUNK_SIZE,           /* LCD绘制已按分块传输 */
+#else
         .max_transfer_sz = 320 * 240 * sizeof(uint16_t),   /* 最大传输大小(整屏(RGB565格式)) */
+#endif
     };
     /* 初始化SPI总线 */
     ESP_ERROR_CHECK(spi_bus_initialize(MY_SPI_HOST, &buscfg, SPI_DMA_CH_AUTO));
@@ -54,4 +68,95 @@ esp_err_t my_spi_init(void)
     ESP_ERROR_CHECK(spi_bus_add_device(MY_SPI_HOST, &devcfg, &MY_SD_Handle));
 
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief       累计设备的总线占用(任意任务调用)
+ * @param       dev     : 设备
+ * @param       bytes   : 传输字节数
+ * @param       busy_us : 占用时间
+ * @retval      无
+ */
+void my_spi_account(my_spi_dev_t dev, uint32_t bytes, uint32_t busy_us)
+{
+#if MY_SPI_SCHED_EN
+    portENTER_CRITICAL(&g_spi_mux);
+    g_spi_stats.dev[dev].busy_us += busy_us;
+    g_spi_stats.dev[dev].bytes += bytes;
+    g_spi_stats.dev[dev].trans++;
+    portEXIT_CRITICAL(&g_spi_mux);
+#else
+    (void)dev;
+    (void)bytes;
+    (void)busy_us;
+#endif
+}
+
+/**
+ * @brief       设置/取消SD卡优先(录像缓冲积压时由写卡一方调用)
+ * @param       on : true:SD卡优先, LCD限制在途分块数; false:恢复
+ * @retval      无
+ */
+void my_spi_sd_priority(bool on)
+{
+#if MY_SPI_SCHED_EN
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_spi_mux);
+
+    if (on && !g_spi_sd_prio)
+    {
+        g_spi_sd_prio_start = now;
+        g_spi_stats.sd_prio_count++;
+    }
+    else if (!on && g_spi_sd_prio)
+    {
+        g_spi_stats.sd_prio_us += now - g_spi_sd_prio_start;
+    }
+
+    g_spi_sd_prio = on;
+    portEXIT_CRITICAL(&g_spi_mux);
+#else
+    (void)on;
+#endif
+}
+
+/**
+ * @brief       查询SD卡优先
+ * @param       无
+ * @retval      true:SD卡优先
+ */
+bool my_spi_sd_priority_active(void)
+{
+    return g_spi_sd_prio;
+}
+
+/**
+ * @brief       获取总线统计
+ * @param       stats : 输出统计(SD卡优先进行中时计入到当前时刻)
+ * @retval      无
+ */
+void my_spi_get_stats(my_spi_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_spi_mux);
+    *stats = g_spi_stats;
+
+    if (g_spi_sd_prio)
+    {
+        stats->sd_prio_us += now - g_spi_sd_prio_start;
+    }
+
+    portEXIT_CRITICAL(&g_spi_mux);
+}
+
+/**
+ * @brief       设备名称
+ * @param       dev : 设备
+ * @retval      名称
+ */
+const char *my_spi_dev_name(my_spi_dev_t dev)
+{
+    return (dev < MY_SPI_DEV_NUM) ? g_spi_dev_names[dev] : "?";
+}
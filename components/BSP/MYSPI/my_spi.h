@@ -15,6 +15,15 @@
  * 公司网址:www.alientek.com
  * 购买地址:openedv.taobao.com
  *
+ * SPI2总线由LCD(spilcd, 60MHz, 异步DMA传输)与SD卡(sdspi, 20MHz)共用. SPI驱动在两次传输之间才把总线交给另一个设备,
+ * 因此 MY_SPI_SCHED_EN 为1时: spilcd 把每次绘制按 MY_SPI_LCD_CHUNK_SIZE 拆成多次传输, SD卡命令最多等待一个分块;
+ * 录像缓冲积压时 sd_recorder 调用 my_spi_sd_priority(true), 此后LCD最多 MY_SPI_LCD_PRIO_DEPTH 个分块在途,
+ * 每个分块之间总线空出, SD卡的连续写命令不再排在整队LCD传输之后.
+ * 各设备的总线占用时间由使用者经 my_spi_account() 累计(LCD按字节数与时钟换算, SD卡为写卡调用的耗时,
+ * 含等待卡忙), 由 /metrics 输出, 占用率为 rate(camera_spi_busy_seconds_total[1m]).
+ * 不接屏的设备把 MY_SPI_LCD_PANEL 设为0(无头模式): spilcd_init 直接返回, 不复位面板、不清屏, 也不申请绘图缓存,
+ * 总线的 max_transfer_sz 只按SD卡配置; 设为2时复位后读取面板ID(RDDID), 读不到ID按无屏处理(须接LCD的SDO).
+ *
  ****************************************************************************************************
  */
 
@@ -22,6 +31,7 @@
 #define __MY_SPI_H
 
 #include <unistd.h>
+#include <stdbool.h>
 #include "driver/sdspi_host.h"
 #include "driver/spi_common.h"
 #include "esp_err.h"
@@ -34,10 +44,46 @@
 #define SD_CS_PIN           GPIO_NUM_2
 /* SPI端口 */
 #define MY_SPI_HOST         SPI2_HOST
+/* 总线调度 */
+#define MY_SPI_SCHED_EN     1                                   /* 1:LCD传输分块, 录像积压时SD卡优先 */
+#define MY_SPI_LCD_CHUNK_SIZE   (320 * 8 * sizeof(uint16_t))    /* LCD单次传输上限(5KB, 60MHz约0.7ms) */
+#define MY_SPI_LCD_PRIO_DEPTH   1                               /* SD卡优先期间LCD最多在途的分块数 */
+/* LCD面板 */
+#define MY_SPI_LCD_PANEL    1                                   /* 0:不接屏(无头模式); 1:接屏; 2:启动时读取面板ID检测 */
+
+/* 总线上的设备 */
+typedef enum
+{
+    MY_SPI_DEV_LCD = 0,
+    MY_SPI_DEV_SD,
+    MY_SPI_DEV_NUM
+} my_spi_dev_t;
+
+/* 一个设备的累计占用 */
+typedef struct
+{
+    uint64_t busy_us;                                           /* 占用总线的时间 */
+    uint64_t bytes;                                             /* 传输字节数 */
+    uint32_t trans;                                             /* 传输(LCD分块/SD写卡调用)次数 */
+} my_spi_dev_stats_t;
+
+/* 总线统计 */
+typedef struct
+{
+    my_spi_dev_stats_t dev[MY_SPI_DEV_NUM];
+    uint32_t sd_prio_count;                                     /* 进入SD卡优先的次数 */
+    uint64_t sd_prio_us;                                        /* SD卡优先的累计时间 */
+} my_spi_stats_t;
+
 /* 设备句柄 */
 extern spi_device_handle_t MY_SD_Handle;   /* SD卡句柄 */
 
 /* 函数声明 */
 esp_err_t my_spi_init(void);    /* SPI初始化 */
+void my_spi_account(my_spi_dev_t dev, uint32_t bytes, uint32_t busy_us);   /* 累计设备的总线占用 */
+void my_spi_sd_priority(bool on);                                           /* 设置/取消SD卡优先 */
+bool my_spi_sd_priority_active(void);                                       /* 查询SD卡优先 */
+void my_spi_get_stats(my_spi_stats_t *stats);                               /* 获取总线统计 */
+const char *my_spi_dev_name(my_spi_dev_t dev);                              /* 设备名称 */
 
 #endif
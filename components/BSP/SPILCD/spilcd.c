@@ -20,10 +20,23 @@
 
 #include "spilcd.h"
 #include "spilcdfont.h"
+#include "my_spi.h"
+#include <string.h>
 
-DRAM_ATTR uint8_t refresh_done_flag = 0;    
 esp_lcd_panel_handle_t panel_handle = NULL;
 _spilcd_dev spilcddev;
+static esp_lcd_panel_io_handle_t g_io_handle = NULL;            /* LCD IO句柄(发送面板命令) */
+static SemaphoreHandle_t g_spilcd_lock = NULL;                  /* 保证一次绘制的窗口命令与像素数据不被其他任务打断 */
+static SemaphoreHandle_t g_trans_slot = NULL;                   /* 空闲的传输队列项(计数信号量, 初值为队列深度) */
+static SemaphoreHandle_t g_trans_idle = NULL;                   /* 全部传输完成时在中断中释放 */
+static portMUX_TYPE g_trans_mux = portMUX_INITIALIZER_UNLOCKED;
+static DRAM_ATTR SemaphoreHandle_t g_trans_done[SPILCD_TRANS_QUEUE_DEPTH];   /* 每个在途传输完成时释放的信号量(按提交顺序) */
+static DRAM_ATTR int8_t g_trans_scratch[SPILCD_TRANS_QUEUE_DEPTH];         /* 每个在途传输占用的绘图缓存序号(-1:无) */
+static DRAM_ATTR uint8_t g_trans_head = 0;
+static SemaphoreHandle_t g_scratch_sem = NULL;                  /* 空闲绘图缓存数(计数信号量) */
+static SemaphoreHandle_t g_text_free = NULL;                    /* 字符串行缓存空闲(上一行发送完成时释放) */
+static SemaphoreHandle_t g_fb_lock = NULL;                      /* 保护影子帧缓存的脏矩形列表 */
+static DRAM_ATTR volatile uint8_t g_trans_count = 0;            /* 在途传输数 */
 #define SPI_LCD_TYPE    1           /* SPI接口屏幕类型（1：2.4寸SPILCD  0：1.3寸SPILCD） */ 
 
 /* LCD的宽和高定义 */
@@ -35,20 +48,521 @@ uint16_t spilcd_width  = 240;       /* 屏幕的宽度 240(横屏) */
 uint16_t spilcd_height = 240;       /* 屏幕的宽度 240(横屏) */
 #endif                              /* 1.3寸SPI_LCD屏幕 */
 
-static bool notify_lcd_flush_ready(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+/**
+ * @brief       刷新完成回调(SPI中断中调用, 每次 esp_lcd_panel_draw_bitmap 的数据发送完成后一次)
+ * @note        传输按提交顺序完成, 依次取出对应的完成信号量
+ * @param       panel_io : LCD IO句柄
+ * @param       edata    : 事件数据
+ * @param       user_ctx : 用户参数(未用到)
+ * @retval      true:唤醒了更高优先级任务
+ */
+static IRAM_ATTR bool notify_lcd_flush_ready(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    BaseType_t woken = pdFALSE;
+    SemaphoreHandle_t done = NULL;
+    int8_t scratch = -1;
+    uint8_t idle = 0;
+
+    portENTER_CRITICAL_ISR(&g_trans_mux);
+
+    if (g_trans_count > 0)
+    {
+        done = g_trans_done[g_trans_head];
+        scratch = g_trans_scratch[g_trans_head];
+        g_trans_head = (g_trans_head + 1) % SPILCD_TRANS_QUEUE_DEPTH;
+        g_trans_count--;
+        idle = (g_trans_count == 0);
+    }
+
+    portEXIT_CRITICAL_ISR(&g_trans_mux);
+
+    if (done != NULL)
+    {
+        xSemaphoreGiveFromISR(done, &woken);
+    }
+
+    if (scratch >= 0)                                           /* 归还绘图缓存 */
+    {
+        __atomic_or_fetch(&spilcddev.scratch_free, 1u << scratch, __ATOMIC_RELEASE);
+        xSemaphoreGiveFromISR(g_scratch_sem, &woken);
+    }
+
+    if (idle)
+    {
+        xSemaphoreGiveFromISR(g_trans_idle, &woken);
+    }
+
+    xSemaphoreGiveFromISR(g_trans_slot, &woken);
+
+    return woken == pdTRUE;
+}
+
+/**
+ * @brief       SD卡优先期间等待LCD在途分块数降到 MY_SPI_LCD_PRIO_DEPTH 以下(调用者持有 g_spilcd_lock)
+ * @param       无
+ * @retval      无
+ */
+static void spilcd_bus_yield(void)
+{
+#if MY_SPI_SCHED_EN
+    bool waited = false;
+
+    while (my_spi_sd_priority_active() && g_trans_count >= MY_SPI_LCD_PRIO_DEPTH)
+    {
+        xSemaphoreTake(g_trans_idle, 1);                        /* 在途传输全部完成时释放, 超时后重新检查优先状态 */
+        waited = true;
+    }
+
+    if (waited)
+    {
+        xSemaphoreGive(g_trans_idle);                           /* 同 spilcd_wait_idle(), 传递给其他等待者 */
+    }
+#endif
+}
+
+/**
+ * @brief       提交一次绘制
+ * @note        MY_SPI_SCHED_EN 为1时按 MY_SPI_LCD_CHUNK_SIZE 拆成多次整行传输(与SD卡共用总线, 见 my_spi.h),
+ *              done 与绘图缓存只登记在最后一个分块上
+ * @param       sx,sy   : 起始坐标(包含)
+ * @param       ex,ey   : 结束坐标(不包含)
+ * @param       data    : 位图数据
+ * @param       done    : 完成时释放的信号量, NULL:不通知
+ * @param       scratch : 完成时归还的绘图缓存序号, -1:无
+ * @retval      ESP_OK:成功; 其他:失败(done 不会被释放, 绘图缓存不会被归还; 返回时之前的分块已发送完成)
+ */
+static esp_err_t spilcd_submit(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, const void *data, SemaphoreHandle_t done, int8_t scratch)
+{
+    size_t line = (size_t)(ex - sx) * sizeof(uint16_t);
+    esp_err_t ret = ESP_OK;
+    uint16_t rows;
+    uint16_t cy;
+    uint16_t ny;
+    uint8_t tail;
+    uint8_t last;
+
+#if MY_SPI_SCHED_EN
+    rows = (line > 0 && line < MY_SPI_LCD_CHUNK_SIZE) ? MY_SPI_LCD_CHUNK_SIZE / line : 1;
+#else
+    rows = UINT16_MAX;
+#endif
+
+    xSemaphoreTake(g_spilcd_lock, portMAX_DELAY);
+
+    for (cy = sy; cy < ey && ret == ESP_OK; cy = ny)
+    {
+        ny = (ey - cy > rows) ? cy + rows : ey;
+        last = (ny == ey);
+
+        spilcd_bus_yield();
+        xSemaphoreTake(g_trans_slot, portMAX_DELAY);
+
+        /* 先登记再提交, 传输可能在 esp_lcd_panel_draw_bitmap 返回前就已完成 */
+        portENTER_CRITICAL(&g_trans_mux);
+        tail = (g_trans_head + g_trans_count) % SPILCD_TRANS_QUEUE_DEPTH;
+        g_trans_done[tail] = last ? done : NULL;
+        g_trans_scratch[tail] = last ? scratch : -1;
+        g_trans_count++;
+        portEXIT_CRITICAL(&g_trans_mux);
+
+        ret = esp_lcd_panel_draw_bitmap(panel_handle, sx, cy, ex, ny, (const uint8_t *)data + (size_t)(cy - sy) * line);
+
+        if (ret != ESP_OK)
+        {
+            /* 未入队, 撤销登记(持有锁期间不会有其他任务提交, 失败的一项仍在队尾) */
+            portENTER_CRITICAL(&g_trans_mux);
+            g_trans_count--;
+            portEXIT_CRITICAL(&g_trans_mux);
+            xSemaphoreGive(g_trans_slot);
+
+            if (cy != sy)                                       /* 之前的分块仍在读取位图, 完成后调用者才能归还缓存 */
+            {
+                while (g_trans_count != 0)
+                {
+                    xSemaphoreTake(g_trans_idle, 1);
+                }
+
+                xSemaphoreGive(g_trans_idle);
+            }
+        }
+        else
+        {
+            my_spi_account(MY_SPI_DEV_LCD, line * (ny - cy),
+                           (uint32_t)((uint64_t)line * (ny - cy) * 8 * 1000000 / SPILCD_PCLK_HZ));
+        }
+    }
+
+    xSemaphoreGive(g_spilcd_lock);
+
+    return ret;
+}
+
+/**
+ * @brief       从缓存池取得一个绘图缓存(无空闲时等待在途传输完成)
+ * @param       无
+ * @retval      缓存序号
+ */
+static int8_t spilcd_scratch_get(void)
 {
-    bool temp = (void *)user_ctx;
-    refresh_done_flag = 1;
-    return false;
+    uint32_t mask;
+    int8_t index;
+
+    xSemaphoreTake(g_scratch_sem, portMAX_DELAY);
+
+    do
+    {
+        mask = __atomic_load_n(&spilcddev.scratch_free, __ATOMIC_ACQUIRE);
+        index = __builtin_ctz(mask);                            /* 信号量保证至少有一个空闲 */
+    }
+    while (!__atomic_compare_exchange_n(&spilcddev.scratch_free, &mask, mask & ~(1u << index),
+                                        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    return index;
+}
+
+/**
+ * @brief       发送绘图缓存中的位图, 传输完成后缓存自动归还缓存池
+ * @param       sx,sy   : 起始坐标(包含)
+ * @param       ex,ey   : 结束坐标(不包含)
+ * @param       scratch : 缓存序号
+ * @retval      无
+ */
+static void spilcd_scratch_draw(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, int8_t scratch)
+{
+    if (spilcd_submit(sx, sy, ex, ey, spilcddev.scratch[scratch], NULL, scratch) != ESP_OK)
+    {
+        __atomic_or_fetch(&spilcddev.scratch_free, 1u << scratch, __ATOMIC_RELEASE);
+        xSemaphoreGive(g_scratch_sem);
+    }
+}
+
+/**
+ * @brief       绘制一块位图(异步), 数据发送完成后释放 done 信号量
+ * @note        可在多个任务中调用; 在途传输达到队列深度时等待空闲队列项.
+ *              位图缓存须为DMA可访问内存, 且在发送完成前不能修改或释放
+ * @param       sx,sy : 起始坐标(包含)
+ * @param       ex,ey : 结束坐标(不包含)
+ * @param       data  : 位图数据(RGB565, 高字节在前)
+ * @param       done  : 完成时释放的信号量(二值或计数), NULL:不通知
+ * @retval      ESP_OK:成功; 其他:失败(done 不会被释放)
+ */
+esp_err_t spilcd_draw_bitmap_notify(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, const void *data, SemaphoreHandle_t done)
+{
+    if (panel_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return spilcd_submit(sx, sy, ex, ey, data, done, -1);
+}
+
+/**
+ * @brief       绘制一块位图(异步, 不通知完成)
+ * @param       sx,sy : 起始坐标(包含)
+ * @param       ex,ey : 结束坐标(不包含)
+ * @param       data  : 位图数据(RGB565, 高字节在前)
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+esp_err_t spilcd_draw_bitmap(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, const void *data)
+{
+    return spilcd_draw_bitmap_notify(sx, sy, ex, ey, data, NULL);
+}
+
+/**
+ * @brief       等待所有在途传输完成
+ * @param       timeout : 超时时间
+ * @retval      ESP_OK:已全部完成; ESP_ERR_TIMEOUT:超时
+ */
+esp_err_t spilcd_wait_idle(TickType_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t spent;
+
+    if (panel_handle == NULL)
+    {
+        return ESP_OK;
+    }
+
+    while (g_trans_count != 0)
+    {
+        spent = xTaskGetTickCount() - start;
+
+        if (spent >= timeout || xSemaphoreTake(g_trans_idle, timeout - spent) != pdTRUE)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+
+    xSemaphoreGive(g_trans_idle);                               /* 可能有多个任务在等待, 传递给下一个 */
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       设置面板接收RGB565像素的字节序(ST7789 RAMCTRL)
+ * @note        默认高字节在前; 像素数据由低字节在前的来源(如摄像头)直接DMA时设为 true, 省去逐像素交换.
+ *              字节序对之后的全部绘制生效, 文字与填充等仍按高字节在前生成, 两种来源不能同时使用
+ * @param       little : true:低字节在前; false:高字节在前
+ * @retval      ESP_OK:成功; 其他:发送失败
+ */
+esp_err_t spilcd_set_data_endian(bool little)
+{
+    const uint8_t param[2] = { 0x00, little ? 0xF8 : 0xF0 };   /* 第二个参数 bit3: ENDIAN */
+    esp_err_t ret;
+
+    if (panel_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(g_spilcd_lock, portMAX_DELAY);
+    spilcd_wait_idle(portMAX_DELAY);                            /* 在途的像素数据按原字节序发送完 */
+    ret = esp_lcd_panel_io_tx_param(g_io_handle, 0xB0, param, sizeof(param));
+    xSemaphoreGive(g_spilcd_lock);
+
+    return ret;
+}
+
+/**
+ * @brief       获取在途传输数
+ * @param       无
+ * @retval      在途传输数
+ */
+uint8_t spilcd_pending(void)
+{
+    return g_trans_count;
+}
+
+/**
+ * @brief       合并两个矩形(取外接矩形)
+ * @param       a,b : 矩形
+ * @retval      外接矩形
+ */
+static spilcd_rect_t spilcd_rect_union(const spilcd_rect_t *a, const spilcd_rect_t *b)
+{
+    spilcd_rect_t r;
+
+    r.x0 = (a->x0 < b->x0) ? a->x0 : b->x0;
+    r.y0 = (a->y0 < b->y0) ? a->y0 : b->y0;
+    r.x1 = (a->x1 > b->x1) ? a->x1 : b->x1;
+    r.y1 = (a->y1 > b->y1) ? a->y1 : b->y1;
+
+    return r;
+}
+
+/**
+ * @brief       矩形面积
+ * @param       r : 矩形
+ * @retval      面积(像素)
+ */
+static uint32_t spilcd_rect_area(const spilcd_rect_t *r)
+{
+    return (uint32_t)(r->x1 - r->x0 + 1) * (r->y1 - r->y0 + 1);
+}
+
+/**
+ * @brief       记录一个脏矩形(调用者持有 g_fb_lock)
+ * @note        与已有矩形相交或相邻时合并; 列表已满时并入使面积增加最少的一个
+ * @param       r : 脏矩形(已裁剪到屏幕内)
+ * @retval      无
+ */
+static void spilcd_fb_mark(spilcd_rect_t r)
+{
+    spilcd_rect_t u;
+    uint32_t cost;
+    uint32_t best_cost = UINT32_MAX;
+    int best = 0;
+    int i = 0;
+
+    while (i < spilcddev.dirty_num)
+    {
+        spilcd_rect_t *d = &spilcddev.dirty[i];
+
+        if (r.x0 <= d->x1 + 1 && d->x0 <= r.x1 + 1 && r.y0 <= d->y1 + 1 && d->y0 <= r.y1 + 1)
+        {
+            /* 相交或相邻: 合并后从列表移除, 用合并结果继续与其余矩形比较 */
+            r = spilcd_rect_union(&r, d);
+            spilcddev.dirty[i] = spilcddev.dirty[--spilcddev.dirty_num];
+            i = 0;
+            continue;
+        }
+
+        i++;
+    }
+
+    if (spilcddev.dirty_num < SPILCD_FB_DIRTY_MAX)
+    {
+        spilcddev.dirty[spilcddev.dirty_num++] = r;
+        return;
+    }
+
+    for (i = 0; i < spilcddev.dirty_num; i++)
+    {
+        u = spilcd_rect_union(&r, &spilcddev.dirty[i]);
+        cost = spilcd_rect_area(&u) - spilcd_rect_area(&spilcddev.dirty[i]);
+
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            best = i;
+        }
+    }
+
+    spilcddev.dirty[best] = spilcd_rect_union(&r, &spilcddev.dirty[best]);
+}
+
+/**
+ * @brief       向影子帧缓存写入一块位图
+ * @param       sx,sy  : 起始坐标
+ * @param       w,h    : 宽高
+ * @param       src    : 位图数据(LCD字节序), NULL:用 color 填充
+ * @param       color  : 填充颜色(LCD字节序)
+ * @param       dirty  : 1:记录为脏区域(稍后刷新); 0:屏幕已同步更新
+ * @retval      无
+ */
+static void spilcd_fb_write(uint16_t sx, uint16_t sy, uint16_t w, uint16_t h, const uint16_t *src, uint16_t color, uint8_t dirty)
+{
+    uint16_t cw;
+    uint16_t ch;
+    uint16_t *out;
+
+    if (spilcddev.fb == NULL || sx >= spilcddev.width || sy >= spilcddev.height || w == 0 || h == 0)
+    {
+        return;
+    }
+
+    cw = (sx + w > spilcddev.width) ? (spilcddev.width - sx) : w;      /* 裁剪到屏幕内 */
+    ch = (sy + h > spilcddev.height) ? (spilcddev.height - sy) : h;
+
+    xSemaphoreTake(g_fb_lock, portMAX_DELAY);
+
+    for (uint16_t row = 0; row < ch; row++)
+    {
+        out = spilcddev.fb + (size_t)(sy + row) * spilcddev.width + sx;
+
+        if (src != NULL)
+        {
+            memcpy(out, src + (size_t)row * w, cw * sizeof(uint16_t));
+        }
+        else
+        {
+            for (uint16_t col = 0; col < cw; col++)
+            {
+                out[col] = color;
+            }
+        }
+    }
+
+    if (dirty)
+    {
+        spilcd_fb_mark((spilcd_rect_t){ sx, sy, sx + cw - 1, sy + ch - 1 });
+    }
+
+    xSemaphoreGive(g_fb_lock);
+}
+
+/**
+ * @brief       把影子帧缓存的脏区域刷新到屏幕
+ * @note        每个脏矩形按行拷贝到DMA行缓存中, 行缓存装满后一次发送; 行缓存发送期间不会被覆盖
+ * @param       无
+ * @retval      无
+ */
+void spilcd_fb_flush(void)
+{
+    spilcd_rect_t dirty[SPILCD_FB_DIRTY_MAX];
+    uint8_t num;
+    uint16_t w;
+    uint16_t lines;
+
+    if (spilcddev.fb == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_fb_lock, portMAX_DELAY);
+    num = spilcddev.dirty_num;
+    memcpy(dirty, spilcddev.dirty, num * sizeof(spilcd_rect_t));
+    spilcddev.dirty_num = 0;
+    xSemaphoreGive(g_fb_lock);
+
+    for (uint8_t i = 0; i < num; i++)
+    {
+        w = dirty[i].x1 - dirty[i].x0 + 1;
+
+        for (uint16_t y = dirty[i].y0; y <= dirty[i].y1; y += lines)
+        {
+            lines = SPILCD_TEXT_BUF_SIZE / (w * sizeof(uint16_t));
+            lines = (lines > dirty[i].y1 - y + 1) ? (dirty[i].y1 - y + 1) : lines;
+
+            xSemaphoreTake(g_text_free, portMAX_DELAY);
+
+            for (uint16_t row = 0; row < lines; row++)
+            {
+                memcpy(spilcddev.text_buf + (size_t)row * w,
+                       spilcddev.fb + (size_t)(y + row) * spilcddev.width + dirty[i].x0,
+                       w * sizeof(uint16_t));
+            }
+
+            if (spilcd_draw_bitmap_notify(dirty[i].x0, y, dirty[i].x1 + 1, y + lines, spilcddev.text_buf, g_text_free) != ESP_OK)
+            {
+                xSemaphoreGive(g_text_free);
+            }
+        }
+    }
+}
+
+#if MY_SPI_LCD_PANEL == 2
+/**
+ * @brief       读取面板ID判断是否接了屏
+ * @note        ST7789 RDDID 在4线SPI下先输出一个空位, 读到的字节错开一位; 只判断是否全为0或全为1(MISO无驱动)
+ * @param       io : LCD IO句柄
+ * @retval      true:有屏; false:无屏或读取失败
+ */
+static bool spilcd_probe(esp_lcd_panel_io_handle_t io)
+{
+    uint8_t id[4] = { 0 };
+    uint8_t all_or = 0;
+    uint8_t all_and = 0xFF;
+
+    if (esp_lcd_panel_io_rx_param(io, LCD_CMD_RDDID, id, sizeof(id)) != ESP_OK)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(id); i++)
+    {
+        all_or |= id[i];
+        all_and &= id[i];
+    }
+
+    ESP_LOGI("TAG", "LCD id %02x %02x %02x %02x", id[0], id[1], id[2], id[3]);
+    return all_or != 0x00 && all_and != 0xFF;
+}
+#endif
+
+/**
+ * @brief       查询是否接了屏(spilcd_init 成功后为 true)
+ * @note        无屏时各绘制函数直接返回, 调用者不必区分
+ * @param       无
+ * @retval      true:有屏; false:无头模式或未检测到面板
+ */
+bool spilcd_present(void)
+{
+    return panel_handle != NULL;
 }
 
 /**
  * @brief       spilcd初始化
+ * @note        MY_SPI_LCD_PANEL 为0时直接返回; 为2时复位后先读取面板ID, 无屏则删除IO设备, 不申请绘图缓存
  * @param       无
- * @retval      ESP_OK:初始化成功
+ * @retval      ESP_OK:初始化成功; ESP_ERR_NOT_FOUND:无头模式或未检测到面板
  */
 esp_err_t spilcd_init(void)
 {
+#if MY_SPI_LCD_PANEL == 0
+    ESP_LOGI("TAG", "headless: LCD not initialized");
+    return ESP_ERR_NOT_FOUND;
+#else
     LCD_RST(0);
     vTaskDelay(pdMS_TO_TICKS(100));
     LCD_RST(1);
@@ -59,15 +573,54 @@ esp_err_t spilcd_init(void)
     esp_lcd_panel_io_spi_config_t io_config = {
         .dc_gpio_num         = LCD_DC_PIN,          /* DC IO */
         .cs_gpio_num         = LCD_CS_PIN,          /* CS IO */
-        .pclk_hz             = 60 * 1000 * 1000,    /* PCLK为60MHz */
+        .pclk_hz             = SPILCD_PCLK_HZ,      /* PCLK为60MHz */
         .lcd_cmd_bits        = 8,                   /* 命令位宽 */
         .lcd_param_bits      = 8,                   /* LCD参数位宽 */
         .spi_mode            = 0,                   /* SPI模式 */
-        .trans_queue_depth   = 7,                   /* 传输队列 */
+        .trans_queue_depth   = SPILCD_TRANS_QUEUE_DEPTH,    /* 传输队列 */
     };
     /* 将LCD设备挂载至SPI总线上 */
     ESP_ERROR_CHECK(esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)LCD_HOST, &io_config, &io_handle));
 
+#if MY_SPI_LCD_PANEL == 2
+    if (!spilcd_probe(io_handle))
+    {
+        esp_lcd_panel_io_del(io_handle);
+        ESP_LOGI("TAG", "headless: no LCD panel detected");
+        return ESP_ERR_NOT_FOUND;
+    }
+#endif
+
+    g_spilcd_lock = xSemaphoreCreateMutex();
+    g_trans_slot = xSemaphoreCreateCounting(SPILCD_TRANS_QUEUE_DEPTH, SPILCD_TRANS_QUEUE_DEPTH);
+    g_trans_idle = xSemaphoreCreateBinary();
+    g_scratch_sem = xSemaphoreCreateCounting(SPILCD_SCRATCH_NUM, SPILCD_SCRATCH_NUM);
+    g_text_free = xSemaphoreCreateBinary();
+    assert(g_spilcd_lock && g_trans_slot && g_trans_idle && g_scratch_sem && g_text_free);
+    xSemaphoreGive(g_text_free);
+
+    /* 绘图缓存池一次分配, 常驻内存, 避免每次绘制都申请/释放DMA内存 */
+    for (int i = 0; i < SPILCD_SCRATCH_NUM; i++)
+    {
+        spilcddev.scratch[i] = heap_caps_malloc(SPILCD_SCRATCH_SIZE, MALLOC_CAP_DMA);
+        assert(spilcddev.scratch[i]);
+        spilcddev.scratch_free |= 1u << i;
+    }
+
+    spilcddev.text_buf = heap_caps_malloc(SPILCD_TEXT_BUF_SIZE, MALLOC_CAP_DMA);
+    assert(spilcddev.text_buf);
+
+#if SPILCD_FB_EN
+    g_fb_lock = xSemaphoreCreateMutex();
+    assert(g_fb_lock);
+    spilcddev.fb = heap_caps_calloc(spilcd_width * spilcd_height, sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+
+    if (spilcddev.fb == NULL)
+    {
+        ESP_LOGW("TAG", "no PSRAM for LCD shadow framebuffer, drawing directly");
+    }
+#endif
+
     spilcddev.pheight = spilcd_height;  /* 高度 */
     spilcddev.pwidth  = spilcd_width;   /* 宽度 */
 
@@ -94,12 +647,14 @@ esp_err_t spilcd_init(void)
     };
     /* 注册屏幕刷新完成回调函数 */
     ESP_ERROR_CHECK(esp_lcd_panel_io_register_event_callbacks(io_handle, &cbs, NULL));
+    g_io_handle = io_handle;
 
     spilcd_display_dir(1);      /* 横屏显示 */
     
     spilcd_clear(WHITE);        /* 清屏 */
     LCD_PWR(1);
     return ESP_OK;
+#endif
 }
 
 /**
@@ -109,6 +664,11 @@ esp_err_t spilcd_init(void)
  */
 void spilcd_display_dir(uint8_t dir)
 {
+    if (panel_handle == NULL)
+    {
+        return;
+    }
+
     spilcddev.dir = dir;
 
     if (spilcddev.dir == 0)         /* 竖屏 */
@@ -144,36 +704,8 @@ void spilcd_display_dir(uint8_t dir)
  */
 void spilcd_clear(uint16_t color)
 {
-    /* 以40行作为缓冲,提高速率,若出现内存不足,可以减少缓冲行数 */
-    uint16_t *buffer = heap_caps_malloc(spilcddev.width * sizeof(uint16_t) * 40, MALLOC_CAP_DMA);
-    uint16_t color_tmp = ((color & 0x00FF) << 8) | ((color & 0xFF00) >> 8);   /* 需要转换一下颜色值 */
-    if (NULL == buffer)
-    {
-        ESP_LOGE("TAG", "Memory for bitmap is not enough");
-    }
-    else
-    {
-        for (uint32_t i = 0; i < spilcddev.width * 40; i++)
-        {
-            buffer[i] = color_tmp;
-        }
-        
-        for (uint16_t y = 0; y < spilcddev.height; y+=40)
-        {
-            esp_lcd_panel_draw_bitmap(panel_handle, 0, y, spilcddev.width, y + 40, buffer);
-        }
-    }
-
-    refresh_done_flag = 0;
-
-    do
-    {
-        /* 等待内部缓存刷新完成 */
-        vTaskDelay(1);
-    }
-    while (refresh_done_flag != 1);
-
-    heap_caps_free(buffer);
+    spilcd_fill(0, 0, spilcddev.width, spilcddev.height, color);
+    spilcd_wait_idle(portMAX_DELAY);                            /* 等待清屏完成 */
 }
 
 /**
@@ -187,32 +719,34 @@ void spilcd_fill(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint16_t co
     /* 计算填充区域宽度 */
     uint16_t width = ex -sx;
     uint16_t height = ey - sy;
-
-    /* 分配内存 */
-    uint16_t *buffer = heap_caps_malloc(width * sizeof(uint16_t), MALLOC_CAP_INTERNAL);
+    uint16_t lines;
+    uint16_t *buffer;
+    int8_t scratch;
     uint16_t color_tmp = ((color & 0x00FF) << 8) | ((color & 0xFF00) >> 8);   /* 需要转换一下颜色值 */
 
-    if (NULL == buffer)
+    if (panel_handle == NULL || width == 0 || height == 0 || width * sizeof(uint16_t) > SPILCD_SCRATCH_SIZE)
     {
-        ESP_LOGE("TAG", "Memory for bitmap is not enough");
+        return;
     }
-    else
+
+    /* 每次发送一个缓存能容纳的行数, 多个缓存可同时在途 */
+    for (uint16_t y = 0; y < height; y += lines)
     {
-        /* 填充颜色 */
-        for (uint16_t i = 0; i < width; i++)
-        {
-            buffer[i] = color_tmp;
-        }
+        lines = SPILCD_SCRATCH_SIZE / (width * sizeof(uint16_t));
+        lines = (lines > height - y) ? (height - y) : lines;
+
+        scratch = spilcd_scratch_get();
+        buffer = spilcddev.scratch[scratch];
 
-        /* 绘制填充区域 */
-        for (uint16_t y = 0; y < height; y++)
+        for (uint32_t i = 0; i < (uint32_t)width * lines; i++)
         {
-            esp_lcd_panel_draw_bitmap(panel_handle, sx, sy + y, ex, sy + y + 1, buffer);
+            buffer[i] = color_tmp;
         }
 
-        /* 释放内存 */
-        heap_caps_free(buffer);
+        spilcd_scratch_draw(sx, sy + y, ex, sy + y + lines, scratch);
     }
+
+    spilcd_fb_write(sx, sy, width, height, NULL, color_tmp, 0);
 }
 
 /**
@@ -225,7 +759,22 @@ void spilcd_fill(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint16_t co
 void spilcd_draw_point(uint16_t x, uint16_t y, uint16_t color)
 {
     uint16_t color_tmp = ((color & 0x00FF) << 8) | ((color & 0xFF00) >> 8);   /* 需要转换一下颜色值 */
-    esp_lcd_panel_draw_bitmap(panel_handle, x, y, x + 1, y + 1, &color_tmp);
+    int8_t scratch;
+
+    if (panel_handle == NULL)
+    {
+        return;
+    }
+
+    if (spilcddev.fb != NULL)
+    {
+        spilcd_fb_write(x, y, 1, 1, NULL, color_tmp, 1);        /* 画到影子帧缓存, 由 spilcd_fb_flush 刷新 */
+        return;
+    }
+
+    scratch = spilcd_scratch_get();
+    spilcddev.scratch[scratch][0] = color_tmp;
+    spilcd_scratch_draw(x, y, x + 1, y + 1, scratch);
 }
 
 /**
@@ -320,20 +869,23 @@ void spilcd_draw_hline(uint16_t x, uint16_t y, uint16_t len, uint16_t color)
     /* 填充颜色区域 */
     uint32_t width = ex - x + 1;
     uint32_t h = ey - y + 1;
-    uint16_t *color_buffer = malloc(width * h * sizeof(uint16_t));
+    uint16_t color_tmp = ((color & 0x00FF) << 8) | ((color & 0xFF00) >> 8);   /* 需要转换一下颜色值 */
 
-    if (color_buffer == NULL) 
+    if (spilcddev.fb != NULL)
     {
-        return; /* 检查内存分配是否成功 */
+        spilcd_fb_write(x, y, width, h, NULL, color_tmp, 1);    /* 画到影子帧缓存, 由 spilcd_fb_flush 刷新 */
+        return;
     }
 
+    int8_t scratch = spilcd_scratch_get();                      /* 一行最多为屏幕宽度, 缓存池的缓存可以容纳 */
+    uint16_t *color_buffer = spilcddev.scratch[scratch];
+
     for (uint32_t i = 0; i < width * h; i++)
     {
-        color_buffer[i] = color;
+        color_buffer[i] = color_tmp;
     }
 
-    esp_lcd_panel_draw_bitmap(panel_handle, x, y, ex + 1, ey + 1, color_buffer);
-    free(color_buffer);
+    spilcd_scratch_draw(x, y, ex + 1, ey + 1, scratch);
 }
 
 /**
@@ -394,113 +946,119 @@ void spilcd_draw_circle(uint16_t x0, uint16_t y0, uint16_t r, uint16_t color)
 }
 
 /**
- * @brief       在指定位置显示一个字符
- * @param       x,y  : 坐标
- * @param       chr  : 要显示的字符:" "--->"~"
+ * @brief       获取字符的点阵数据
+ * @param       chr  : 字符:" "--->"~"
  * @param       size : 字体大小 12/16/24/32
- * @param       mode : 叠加方式(1); 非叠加方式(0);
- * @param       color : 字符的颜色;
- * @retval      无
+ * @retval      点阵数据首地址(阴码, 逐行式, 顺向), NULL:不支持的字体
  */
-void spilcd_show_char(uint16_t x, uint16_t y, uint8_t chr, uint8_t size, uint8_t mode, uint16_t color)
+static const uint8_t *spilcd_font_glyph(uint8_t chr, uint8_t size)
 {
-    const uint8_t *ch_code;     /* 存放chr字符对应数组的首地址 */
-    uint8_t ch_width;           /* 字符的宽度 */
-    uint8_t ch_height;          /* 字符的高度 */
-    uint8_t ch_size;            /* 字符的大小(字节) */
-    uint8_t ch_offset;          /* 字符在字库的相对位置 */
-    uint8_t byte_index;         /* 字符对应数据的索引值 */
-    uint8_t byte_code;          /* 字符对应数据 */
-    uint8_t bit_index;          /* 字符对应字节数据的位索引 */
-    uint16_t colortemp = 0;     /* 颜色数据 */
-    uint16_t pix_index = 0;
-    uint16_t *pcolor = NULL;
-
-    /* 字体大小(字节) =       字体宽度占用字体大小              * 字体高度 */
-    ch_size = ((size / 2) / 8 +  (((size / 2) % 8) ? 1 : 0)) * size;         /* 得到字体一个字符对应点阵集所占的字节数 */
-
-    pcolor = heap_caps_malloc(size * (size / 2) * 2, MALLOC_CAP_DMA);        /* 申请大小 */
-    uint16_t color_tmp = ((color & 0x00FF) << 8) | ((color & 0xFF00) >> 8);  /* 需要转换一下颜色值 */
-
-    if (NULL == pcolor)
-    {
-        ESP_LOGE("TAG", "Memory for bitmap is not enough");
-    }
-
-    ch_offset = chr - ' ';    /* 得到偏移后的值（ASCII字库是从空格开始取模，所以-' '就是对应字符的字库） */
+    uint8_t ch_offset = chr - ' ';    /* 得到偏移后的值（ASCII字库是从空格开始取模，所以-' '就是对应字符的字库） */
 
     switch (size)
     {
         case 12:
-            ch_code = (uint8_t *)asc2_1206[ch_offset];  /* 调用1206字体 */
-            ch_width = 6;
-            ch_height = 12;
-            break;
+            return asc2_1206[ch_offset];    /* 调用1206字体 */
 
         case 16:
-            ch_code = (uint8_t *)asc2_1608[ch_offset];  /* 调用1608字体 */
-            ch_width = 8;
-            ch_height = 16;
-            break;
+            return asc2_1608[ch_offset];    /* 调用1608字体 */
 
         case 24:
-            ch_code = (uint8_t *)asc2_2412[ch_offset];  /* 调用2412字体 */
-            ch_width = 12;
-            ch_height = 24;
-            break;
+            return asc2_2412[ch_offset];    /* 调用2412字体 */
 
         case 32:
-            ch_code = (uint8_t *)asc2_3216[ch_offset];  /* 调用3216字体 */
-            ch_width = 16;
-            ch_height = 32;
-            break;
+            return asc2_3216[ch_offset];    /* 调用3216字体 */
 
         default:
-            return ;
+            return NULL;
     }
+}
 
-    for (byte_index = 0; byte_index < ch_size; byte_index++)
-    {
-        byte_code = ch_code[byte_index];    /* 获取字符的点阵数据 */
+/**
+ * @brief       把一个字符光栅化到缓存中
+ * @note        字库逐行存放, 每行占 (宽度 + 7) / 8 个字节, 高位在前, 每行只有前"宽度"位有效
+ * @param       out     : 输出位置(字符左上角)
+ * @param       stride  : 输出缓存每行的像素数
+ * @param       ch_code : 点阵数据
+ * @param       size    : 字体大小(高度, 宽度为其一半)
+ * @param       fg,bg   : 前景色/背景色(已转换为LCD字节序)
+ * @retval      无
+ */
+static void spilcd_glyph_raster(uint16_t *out, uint16_t stride, const uint8_t *ch_code, uint8_t size, uint16_t fg, uint16_t bg)
+{
+    uint8_t ch_width = size / 2;
+    uint8_t row_bytes = ch_width / 8 + ((ch_width % 8) ? 1 : 0);
 
-        for (bit_index = 0; bit_index < 8; bit_index++)   /* 一个字节8个点 */
+    for (uint8_t row = 0; row < size; row++, ch_code += row_bytes, out += stride)
+    {
+        for (uint8_t col = 0; col < ch_width; col++)
         {
-            if ((byte_code & 0x80) != 0)        /* 有效点,需要显示 */
-            {
-                colortemp = color_tmp;  
-            }
-            else if (mode == 0)     /* 无效点,不显示 */
-            {
-                colortemp = 0xFFFF;
-            }
+            out[col] = (ch_code[col >> 3] & (0x80 >> (col & 7))) ? fg : bg;
+        }
+    }
+}
 
-            pcolor[pix_index] = colortemp;
-            pix_index++;
+/**
+ * @brief       在指定位置显示一个字符
+ * @param       x,y  : 坐标
+ * @param       chr  : 要显示的字符:" "--->"~"
+ * @param       size : 字体大小 12/16/24/32
+ * @param       mode : 叠加方式(1); 非叠加方式(0); 屏幕内容无法读回, 两种方式的无效点都填充白色
+ * @param       color : 字符的颜色;
+ * @retval      无
+ */
+void spilcd_show_char(uint16_t x, uint16_t y, uint8_t chr, uint8_t size, uint8_t mode, uint16_t color)
+{
+    const uint8_t *ch_code = spilcd_font_glyph(chr, size);     /* 存放chr字符对应数组的首地址 */
+    uint8_t ch_width = size / 2;                                /* 字符的宽度 */
+    uint16_t color_tmp = ((color & 0x00FF) << 8) | ((color & 0xFF00) >> 8);  /* 需要转换一下颜色值 */
+    int8_t scratch;
 
-            if ((size == 24) && (byte_index % 2))   /* 24号字体比较特殊,奇数字节只有四位有效 */
-            {
-                if (bit_index == 3)
-                {
-                    break;
-                }
-            }
+    (void)mode;
 
-            byte_code <<= 1; /* 移位, 以便获取下一个位的状态 */
-        }
+    if (ch_code == NULL || panel_handle == NULL)
+    {
+        return;
     }
 
-    esp_lcd_panel_draw_bitmap(panel_handle, x, y, x + ch_width, y + ch_height, (uint16_t *)pcolor);
+    scratch = spilcd_scratch_get();                             /* 最大32x16点, 缓存池的缓存可以容纳 */
+    spilcd_glyph_raster(spilcddev.scratch[scratch], ch_width, ch_code, size, color_tmp, 0xFFFF);
+    spilcd_fb_write(x, y, ch_width, size, spilcddev.scratch[scratch], 0, 0);
+    spilcd_scratch_draw(x, y, x + ch_width, y + size, scratch); /* 异步发送, 完成后缓存自动归还 */
+}
+
+/**
+ * @brief       把一个字符画到影子帧缓存并记录为脏区域(不立即发送)
+ * @note        多个字符画完后调用一次 spilcd_fb_flush(), 相邻的字符合并为一次传输; 未使能影子帧缓存时直接显示
+ * @param       x,y   : 坐标
+ * @param       chr   : 要显示的字符:" "--->"~"
+ * @param       size  : 字体大小 12/16/24/32
+ * @param       color : 字符的颜色
+ * @param       bg    : 背景色
+ * @retval      无
+ */
+void spilcd_fb_show_char(uint16_t x, uint16_t y, uint8_t chr, uint8_t size, uint16_t color, uint16_t bg)
+{
+    const uint8_t *ch_code = spilcd_font_glyph(chr, size);
+    uint8_t ch_width = size / 2;
+    uint16_t fg_tmp = ((color & 0x00FF) << 8) | ((color & 0xFF00) >> 8);   /* 需要转换一下颜色值 */
+    uint16_t bg_tmp = ((bg & 0x00FF) << 8) | ((bg & 0xFF00) >> 8);
 
-    refresh_done_flag = 0;
+    if (ch_code == NULL || x + ch_width > spilcddev.width || y + size > spilcddev.height)
+    {
+        return;
+    }
 
-    do
+    if (spilcddev.fb == NULL)
     {
-        /* 等待内部缓存刷新完成 */
-        vTaskDelay(1);
+        spilcd_show_char(x, y, chr, size, 0, color);
+        return;
     }
-    while (refresh_done_flag != 1);
 
-    heap_caps_free(pcolor);
+    xSemaphoreTake(g_fb_lock, portMAX_DELAY);
+    spilcd_glyph_raster(spilcddev.fb + (size_t)y * spilcddev.width + x, spilcddev.width, ch_code, size, fg_tmp, bg_tmp);
+    spilcd_fb_mark((spilcd_rect_t){ x, y, x + ch_width - 1, y + size - 1 });
+    xSemaphoreGive(g_fb_lock);
 }
 
 /**
@@ -607,10 +1165,22 @@ void spilcd_show_xnum(uint16_t x, uint16_t y, uint32_t num, uint8_t len, uint8_t
  */
 void spilcd_show_string(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t size, char *p, uint16_t color)
 {
-    uint8_t x0 = x;
+    uint16_t x0 = x;
+    uint8_t ch_width = size / 2;
+    uint16_t max_chars;
+    uint16_t n;
+    uint16_t stride;
+    uint16_t color_tmp = ((color & 0x00FF) << 8) | ((color & 0xFF00) >> 8);  /* 需要转换一下颜色值 */
     width += x;
     height += y;
 
+    if (spilcd_font_glyph(' ', size) == NULL || panel_handle == NULL)
+    {
+        return;
+    }
+
+    max_chars = SPILCD_TEXT_BUF_SIZE / (ch_width * size * sizeof(uint16_t));   /* 行缓存一次能容纳的字符数 */
+
     while ((*p <= '~') && (*p >= ' '))   /* 判断是不是非法字符! */
     {
         if (x >= width)
@@ -621,10 +1191,27 @@ void spilcd_show_string(uint16_t x, uint16_t y, uint16_t width, uint16_t height,
 
         if (y >= height) break;  /* 退出 */
 
-        spilcd_show_char(x, y, *p, size, 0, color);
+        /* 本行剩余宽度内连续的字符一起光栅化, 一次传输 */
+        for (n = 1; (p[n] <= '~') && (p[n] >= ' ') && (x + n * ch_width < width) && (n < max_chars); n++);
+
+        stride = n * ch_width;
+        xSemaphoreTake(g_text_free, portMAX_DELAY);             /* 等待上一行发送完成 */
+
+        for (uint16_t i = 0; i < n; i++)
+        {
+            spilcd_glyph_raster(spilcddev.text_buf + i * ch_width, stride, spilcd_font_glyph(p[i], size), size, color_tmp, 0xFFFF);
+        }
+
+        spilcd_fb_write(x, y, stride, size, spilcddev.text_buf, 0, 0);
 
-        x += size / 2;
-        p++;
+        if (spilcd_draw_bitmap_notify(x, y, x + stride, y + size, spilcddev.text_buf, g_text_free) != ESP_OK)
+        {
+            xSemaphoreGive(g_text_free);
+        }
+
+        x += stride;
+        p += n;
     }
 }
 
+
@@ -31,6 +31,8 @@
 #include "esp_lcd_panel_st7789.h"
 #include "xl9555.h"
 #include "math.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 
 /* 管脚声明 */
@@ -50,6 +52,13 @@
                             } while(0)
 
 #define LCD_HOST            SPI2_HOST
+#define SPILCD_PCLK_HZ      (60 * 1000 * 1000)  /* SPI时钟 */
+#define SPILCD_TRANS_QUEUE_DEPTH    7   /* SPI传输队列深度, 即可同时在途的绘制数 */
+#define SPILCD_SCRATCH_NUM          SPILCD_TRANS_QUEUE_DEPTH    /* 绘图缓存池的缓存数, 每个在途传输占用一个 */
+#define SPILCD_SCRATCH_SIZE         (320 * 4 * sizeof(uint16_t))/* 每个绘图缓存的大小(4行整屏宽度, 可容纳32号字符) */
+#define SPILCD_TEXT_BUF_SIZE        (320 * 16 * sizeof(uint16_t))   /* 字符串行缓存大小(整屏宽度的16号字一行只需一次传输) */
+#define SPILCD_FB_EN                1   /* 1:使能PSRAM影子帧缓存, 画点/线/圆/矩形先画到内存, 由 spilcd_fb_flush 按脏矩形批量刷新 */
+#define SPILCD_FB_DIRTY_MAX         8   /* 最多记录的脏矩形数, 超出时合并 */
 
 /* 常用颜色值 */
 #define WHITE               0xFFFF      /* 白色 */
@@ -73,6 +82,15 @@
 #define LGRAYBLUE           0XA651      /* 浅灰蓝色(中间层颜色) */ 
 #define LBBLUE              0X2B12      /* 浅棕蓝色(选择条目的反色) */ 
 
+/* 矩形区域(坐标均包含) */
+typedef struct
+{
+    uint16_t x0;
+    uint16_t y0;
+    uint16_t x1;
+    uint16_t y1;
+} spilcd_rect_t;
+
 typedef struct  
 {
     uint32_t pwidth;    /* 临时设定值（宽度） */
@@ -80,6 +98,12 @@ typedef struct
     uint8_t  dir;       /* 屏幕方向 */
     uint16_t width;     /* 宽度 */
     uint16_t height;    /* 高度 */
+    uint16_t *scratch[SPILCD_SCRATCH_NUM];  /* 常驻的DMA绘图缓存池, 传输完成后自动归还 */
+    volatile uint32_t scratch_free;         /* 空闲缓存位图 */
+    uint16_t *text_buf;                     /* 字符串行缓存, 一行文字光栅化后一次发送 */
+    uint16_t *fb;                           /* 影子帧缓存(PSRAM, LCD字节序), NULL:未使能 */
+    spilcd_rect_t dirty[SPILCD_FB_DIRTY_MAX];   /* 尚未刷新到屏幕的区域 */
+    uint8_t dirty_num;
 } _spilcd_dev; 
 
 extern _spilcd_dev spilcddev;;
@@ -87,6 +111,7 @@ extern esp_lcd_panel_handle_t panel_handle;
 
 /* 函数声明 */
 esp_err_t spilcd_init(void);                /* spilcd初始化 */
+bool spilcd_present(void);                  /* 是否接了屏(无头模式下各绘制函数直接返回) */
 void spilcd_display_dir(uint8_t dir);       /* 设置屏幕方向 */
 void spilcd_clear(uint16_t color);          /* 清屏 */
 void spilcd_fill(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint16_t color);           /* 在指定区域内填充单个颜色 */
@@ -99,6 +124,13 @@ void spilcd_show_char(uint16_t x, uint16_t y, uint8_t chr, uint8_t size, uint8_t
 void spilcd_show_num(uint16_t x, uint16_t y, uint32_t num, uint8_t len, uint8_t size, uint16_t color);                      /* 显示len个数字 */
 void spilcd_show_xnum(uint16_t x, uint16_t y, uint32_t num, uint8_t len, uint8_t size, uint8_t mode, uint16_t color);       /* 扩展显示len个数字(高位是0也显示) */
 void spilcd_show_string(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t size, char *p, uint16_t color);    /* 显示字符串 */
+esp_err_t spilcd_draw_bitmap(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, const void *data);                         /* 异步绘制一块位图 */
+esp_err_t spilcd_draw_bitmap_notify(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, const void *data, SemaphoreHandle_t done);  /* 异步绘制, 完成时释放信号量 */
+esp_err_t spilcd_wait_idle(TickType_t timeout);                                                                             /* 等待所有在途传输完成 */
+uint8_t spilcd_pending(void);                                                                                               /* 获取在途传输数 */
+esp_err_t spilcd_set_data_endian(bool little);                                                                              /* 设置像素数据字节序 */
+void spilcd_fb_flush(void);                                                                                                 /* 把影子帧缓存的脏区域刷新到屏幕 */
+void spilcd_fb_show_char(uint16_t x, uint16_t y, uint8_t chr, uint8_t size, uint16_t color, uint16_t bg);                   /* 把一个字符画到影子帧缓存(由 spilcd_fb_flush 刷新) */
 
 
 
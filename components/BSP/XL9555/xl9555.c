@@ -23,6 +23,11 @@
 
 const char *xl9555_tag = "xl9555";
 i2c_master_dev_handle_t xl9555_handle = NULL;
+static uint16_t g_xl9555_out = 0xFFFF;                              /* 输出寄存器影子(上电默认全高, 持有总线锁时访问) */
+static TaskHandle_t g_xl9555_event_task = NULL;                     /* 输入事件线程(周期查询, XL9555_INT_EN 时由INT唤醒) */
+static QueueHandle_t g_xl9555_event_queue = NULL;                   /* 输入事件队列 */
+static volatile uint16_t g_xl9555_trigger_mask = 0;                 /* 触发IO(xl9555_trigger_set) */
+static volatile xl9555_trigger_cb_t g_xl9555_trigger_cb = NULL;     /* 触发回调 */
 
 /**
  * @brief       读取XL9555的IO值
@@ -33,8 +38,17 @@ i2c_master_dev_handle_t xl9555_handle = NULL;
 esp_err_t xl9555_read_byte(uint8_t *data, size_t len)
 {
     uint8_t reg_addr = XL9555_INPUT_PORT0_REG;
-    
-    return i2c_master_transmit_receive(xl9555_handle, &reg_addr, 1, data, len, -1);
+    esp_err_t ret = myiic_lock(MYIIC_PRIO_LOW, portMAX_DELAY);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    ret = i2c_master_transmit_receive(xl9555_handle, &reg_addr, 1, data, len, -1);
+    myiic_unlock();
+
+    return ret;
 }
 
 /**
@@ -46,68 +60,80 @@ esp_err_t xl9555_read_byte(uint8_t *data, size_t len)
  */
 esp_err_t xl9555_write_byte(uint8_t reg, uint8_t *data, size_t len)
 {
+    uint8_t buf[1 + XL9555_WRITE_MAX];
     esp_err_t ret;
 
-    uint8_t *buf = malloc(1 + len);
-    if (buf == NULL)
+    if (len > XL9555_WRITE_MAX)
     {
-        ESP_LOGE(xl9555_tag, "%s memory failed", __func__);
-        return ESP_ERR_NO_MEM;      /* 分配内存失败 */
+        ESP_LOGE(xl9555_tag, "%s len %d too long", __func__, (int)len);
+        return ESP_ERR_INVALID_ARG;
     }
 
     buf[0] = reg;                   /* 0号元素为寄存器数值 */
     memcpy(buf + 1, data, len);     /* 拷贝数据至存储区中 */
 
-    ret = i2c_master_transmit(xl9555_handle, buf, len + 1, -1);
+    ret = myiic_lock(MYIIC_PRIO_LOW, portMAX_DELAY);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
 
-    free(buf);                      /* 发送完成释放内存 */
+    ret = i2c_master_transmit(xl9555_handle, buf, len + 1, -1);
+    myiic_unlock();
 
     return ret;
 }
 
 /**
- * @brief       控制某个IO的电平
- * @param       pin     : 控制的IO
- * @param       val     : 电平
- * @retval      返回所有IO状态
+ * @brief       一次更新多个IO的电平
+ * @note        基于输出寄存器影子计算新值, 直接写入两个输出寄存器, 不再先读回;
+ *              电平没有变化时不访问总线, 写入失败时影子保持不变
+ * @param       mask    : 要更新的IO(可以是多个IO的组合)
+ * @param       val     : mask中各IO对应的电平(对应位为1:高电平, 0:低电平)
+ * @retval      返回所有IO的输出状态
  */
-uint16_t xl9555_pin_write(uint16_t pin, int val)
+uint16_t xl9555_pins_write(uint16_t mask, uint16_t val)
 {
     uint8_t w_data[2];
-    uint16_t temp = 0x0000;
+    uint16_t temp;
 
-    xl9555_read_byte(w_data, 2);
-
-    if (pin <= 0x0080)
+    /* 以高优先级独占总线(摄像头/LCD的上电复位时序), 同时保护输出寄存器影子 */
+    if (myiic_lock(MYIIC_PRIO_HIGH, portMAX_DELAY) != ESP_OK)
     {
-        if (val)
-        {
-            w_data[0] |= (uint8_t)(0xFF & pin);
-        }
-        else
-        {
-            w_data[0] &= ~(uint8_t)(0xFF & pin);
-        }
+        return g_xl9555_out;
     }
-    else
+
+    temp = (g_xl9555_out & ~mask) | (val & mask);
+
+    if (temp != g_xl9555_out)
     {
-        if (val)
-        {
-            w_data[1] |= (uint8_t)(0xFF & (pin >> 8));
-        }
-        else
+        w_data[0] = (uint8_t)(0xFF & temp);
+        w_data[1] = (uint8_t)(0xFF & (temp >> 8));
+
+        if (xl9555_write_byte(XL9555_OUTPUT_PORT0_REG, w_data, 2) == ESP_OK)
         {
-            w_data[1] &= ~(uint8_t)(0xFF & (pin >> 8));
+            g_xl9555_out = temp;
         }
     }
 
-    temp = ((uint16_t)w_data[1] << 8) | w_data[0]; 
+    temp = g_xl9555_out;
+    myiic_unlock();
 
-    xl9555_write_byte(XL9555_OUTPUT_PORT0_REG, w_data, 2);
-    
     return temp;
 }
 
+/**
+ * @brief       控制某个IO的电平
+ * @param       pin     : 控制的IO
+ * @param       val     : 电平
+ * @retval      返回所有IO的输出状态
+ */
+uint16_t xl9555_pin_write(uint16_t pin, int val)
+{
+    return xl9555_pins_write(pin, val ? pin : 0);
+}
+
 /**
  * @brief       获取某个IO状态
  * @param       pin : 要获取状态的IO
@@ -162,16 +188,13 @@ void xl9555_ioconfig(uint16_t config_value)
 static void IRAM_ATTR xl9555_exit_gpio_isr_handler(void *arg)
 {
     uint32_t gpio_num = (uint32_t)arg;
+    BaseType_t woken = pdFALSE;
     
-    if (gpio_num == XL9555_INT_IO)
+    if (gpio_num == XL9555_INT_IO && g_xl9555_event_task != NULL)
     {
-        esp_rom_delay_us(20000);
-
-        if (gpio_get_level(XL9555_INT_IO) == 0)
-        {
-            /* 中断处理 */
-            // ESP_DRAM_LOGI("xl9555", "xl9555 int");
-        }
+        /* 中断中不能访问IIC, 交给输入事件线程读取并消抖 */
+        vTaskNotifyGiveFromISR(g_xl9555_event_task, &woken);
+        portYIELD_FROM_ISR(woken);
     }
 }
 
@@ -192,13 +215,232 @@ void xl9555_int_init(void)
     gpio_init_struct.pin_bit_mask = 1ull << XL9555_INT_IO;  /* 设置的引脚的位掩码 */
     gpio_config(&gpio_init_struct);                         /* 配置使能 */
     
-    /* 注册中断服务 */
+    /* 注册中断服务(可能已由其他驱动注册) */
     gpio_install_isr_service(0);
     
     /* 设置GPIO的中断回调函数 */
     gpio_isr_handler_add(XL9555_INT_IO, xl9555_exit_gpio_isr_handler, (void*)XL9555_INT_IO);
 }
 
+/**
+ * @brief       读取输入IO的电平(同时清除XL9555的中断)
+ * @param       level : 输出电平
+ * @retval      ESP_OK:读取成功; 其他:读取失败
+ */
+static esp_err_t xl9555_input_read(uint16_t *level)
+{
+    uint8_t r_data[2];
+    esp_err_t ret = xl9555_read_byte(r_data, 2);
+
+    if (ret == ESP_OK)
+    {
+        *level = (((uint16_t)r_data[1] << 8) | r_data[0]) & XL9555_INPUT_MASK;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief       等待输入可能发生变化
+ * @param       timeout : 超时时间
+ * @retval      1:有新的跳变(INT中断或INT仍为低电平); 0:超时
+ */
+static int xl9555_input_wait(TickType_t timeout)
+{
+#if XL9555_INT_EN
+    if (ulTaskNotifyTake(pdTRUE, timeout) != 0 || gpio_get_level(XL9555_INT_IO) == 0)
+    {
+        return 1;
+    }
+
+    return 0;
+#else
+    vTaskDelay(timeout);
+    return 0;
+#endif
+}
+
+/**
+ * @brief       触发IO跳变时立即回调(输入事件线程调用)
+ * @param       level  : 本次读到的输入电平
+ * @param       stable : 上次上报的稳定电平
+ * @param       fired  : 本次跳变中已回调过的触发IO, 输出加上本次回调的IO
+ * @retval      无
+ */
+static void xl9555_trigger_fire(uint16_t level, uint16_t stable, uint16_t *fired)
+{
+    xl9555_trigger_cb_t cb = g_xl9555_trigger_cb;
+    uint16_t edge = (level ^ stable) & g_xl9555_trigger_mask & ~*fired;
+
+    if (edge == 0 || cb == NULL)
+    {
+        return;
+    }
+
+    *fired |= edge;
+    cb(edge, level, esp_timer_get_time());
+}
+
+/**
+ * @brief       输入事件线程函数
+ * @note        由INT下降沿唤醒(未使能中断时每 XL9555_POLL_MS 查询一次)读取输入寄存器; 电平变化后
+ *              XL9555_DEBOUNCE_MS 内读到相同电平且没有新的跳变才认为稳定, 与上次上报的电平比较后投递事件.
+ *              读取后INT仍为低电平(读取期间又有跳变)时继续读取, 避免丢失边沿.
+ *              触发IO在第一次读到跳变时立即回调(不等消抖), 电平稳定前同一IO只回调一次;
+ *              未使能中断时注册了触发IO则以 XL9555_TRIGGER_POLL_MS 查询
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void xl9555_event_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    uint16_t stable = 0;
+    uint16_t level = 0;
+    uint16_t prev;
+    uint16_t fired = 0;
+    int changed;
+    int64_t edge_us = 0;
+    xl9555_event_t evt;
+
+    while (xl9555_input_read(&stable) != ESP_OK)
+    {
+        vTaskDelay(pdMS_TO_TICKS(XL9555_DEBOUNCE_MS));
+    }
+
+    while (1)
+    {
+#if XL9555_INT_EN
+        xl9555_input_wait(portMAX_DELAY);
+#else
+        xl9555_input_wait(pdMS_TO_TICKS(g_xl9555_trigger_mask ? XL9555_TRIGGER_POLL_MS : XL9555_POLL_MS));
+#endif
+        edge_us = esp_timer_get_time();
+
+        if (xl9555_input_read(&level) != ESP_OK || level == stable)
+        {
+            continue;
+        }
+
+        fired = 0;
+
+        /* 消抖: 等到 XL9555_DEBOUNCE_MS 内不再有跳变 */
+        do
+        {
+            xl9555_trigger_fire(level, stable, &fired);
+            prev = level;
+            changed = xl9555_input_wait(pdMS_TO_TICKS(XL9555_DEBOUNCE_MS));
+
+            if (xl9555_input_read(&level) != ESP_OK)
+            {
+                level = prev;
+                break;
+            }
+        } while (changed || level != prev);
+
+        if (level == stable)
+        {
+            continue;                                               /* 抖动后恢复原电平 */
+        }
+
+        evt.changed = level ^ stable;
+        evt.level = level;
+        evt.time_us = edge_us;
+        evt.key = 0;
+
+        /* 按键低电平有效 */
+        if ((evt.changed & KEY0_IO) && !(level & KEY0_IO))
+        {
+            evt.key = KEY0_PRES;
+        }
+        else if ((evt.changed & KEY1_IO) && !(level & KEY1_IO))
+        {
+            evt.key = KEY1_PRES;
+        }
+        else if ((evt.changed & KEY2_IO) && !(level & KEY2_IO))
+        {
+            evt.key = KEY2_PRES;
+        }
+        else if ((evt.changed & KEY3_IO) && !(level & KEY3_IO))
+        {
+            evt.key = KEY3_PRES;
+        }
+
+        stable = level;
+
+        if (xQueueSend(g_xl9555_event_queue, &evt, 0) != pdTRUE)
+        {
+            ESP_LOGW(xl9555_tag, "event queue full, event dropped");
+        }
+    }
+}
+
+/**
+ * @brief       初始化输入事件
+ * @note        输入IO的变化由事件线程统一读取(XL9555_INT_EN 时由INT中断触发), 使用者通过 xl9555_event_get 阻塞等待,
+ *              不再各自调用 xl9555_key_scan 查询IIC总线
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:内存不足
+ */
+esp_err_t xl9555_event_init(void)
+{
+    if (g_xl9555_event_queue != NULL)
+    {
+        return ESP_OK;
+    }
+
+    g_xl9555_event_queue = xQueueCreate(XL9555_EVENT_QUEUE_LEN, sizeof(xl9555_event_t));
+
+    if (g_xl9555_event_queue == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(xl9555_event_thread, "xl9555_event_thread", 3 * 1024, NULL,
+                    XL9555_EVENT_THREAD_PRIO, &g_xl9555_event_task) != pdPASS)
+    {
+        vQueueDelete(g_xl9555_event_queue);
+        g_xl9555_event_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+#if XL9555_INT_EN
+    xl9555_int_init();
+#endif
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       注册不经消抖的边沿触发回调(PIR、门磁等需要低延迟响应的输入)
+ * @note        回调在输入事件线程中执行, 须尽快返回; 消抖后的输入事件照常投递.
+ *              本板未使能INT中断, 注册后查询周期缩短为 XL9555_TRIGGER_POLL_MS
+ * @param       mask : 触发IO(须为输入IO), 0:取消
+ * @param       cb   : 回调函数
+ * @retval      无
+ */
+void xl9555_trigger_set(uint16_t mask, xl9555_trigger_cb_t cb)
+{
+    g_xl9555_trigger_mask = 0;
+    g_xl9555_trigger_cb = cb;
+    g_xl9555_trigger_mask = (cb != NULL) ? (mask & XL9555_INPUT_MASK) : 0;
+}
+
+/**
+ * @brief       等待一个输入事件
+ * @param       evt     : 输出事件
+ * @param       timeout : 超时时间
+ * @retval      pdTRUE:收到事件; pdFALSE:超时或未初始化
+ */
+BaseType_t xl9555_event_get(xl9555_event_t *evt, TickType_t timeout)
+{
+    if (g_xl9555_event_queue == NULL)
+    {
+        return pdFALSE;
+    }
+
+    return xQueueReceive(g_xl9555_event_queue, evt, timeout);
+}
+
 /**
  * @brief       初始化XL9555
  * @param       无
@@ -207,12 +449,10 @@ void xl9555_int_init(void)
 esp_err_t xl9555_init(void)
 {
     uint8_t r_data[2];
+    uint8_t reg_addr = XL9555_OUTPUT_PORT0_REG;
 
-    /* 未调用myiic_init初始化IIC */
-    if (bus_handle == NULL)
-    {
-        ESP_ERROR_CHECK(myiic_init());
-    }
+    /* 未调用myiic_init时先初始化共享总线 */
+    i2c_master_bus_handle_t bus = myiic_bus_get();
 
     i2c_device_config_t xl9555_i2c_dev_conf = {
         .dev_addr_length = I2C_ADDR_BIT_LEN_7,  /* 从机地址长度 */
@@ -220,25 +460,35 @@ esp_err_t xl9555_init(void)
         .device_address  = XL9555_ADDR,         /* 从机7位的地址 */
     };
     /* I2C总线上添加XL9555设备 */
-    ESP_ERROR_CHECK(i2c_master_bus_add_device(bus_handle, &xl9555_i2c_dev_conf, &xl9555_handle));
+    ESP_ERROR_CHECK(i2c_master_bus_add_device(bus, &xl9555_i2c_dev_conf, &xl9555_handle));
 
     /* 输入模式下，中断才有效（读取IO电平） */
     // xl9555_int_init();
 
     /* 上电先读取一次清除中断标志 */
     xl9555_read_byte(r_data, 2);
+
+    /* 读取一次输出寄存器作为影子初值, 之后的IO写入不再读回 */
+    myiic_lock(MYIIC_PRIO_LOW, portMAX_DELAY);
+
+    if (i2c_master_transmit_receive(xl9555_handle, &reg_addr, 1, r_data, 2, -1) == ESP_OK)
+    {
+        g_xl9555_out = ((uint16_t)r_data[1] << 8) | r_data[0];
+    }
+
+    myiic_unlock();
+
     /* 配置那些扩展管脚为输入输出模式 */
-    xl9555_ioconfig(0xF003);
-    /* 关闭蜂鸣器 */
-    xl9555_pin_write(BEEP_IO, 1);
-    /* 关闭喇叭 */
-    xl9555_pin_write(SPK_EN_IO, 1);
+    xl9555_ioconfig(XL9555_INPUT_MASK);
+    /* 关闭蜂鸣器和喇叭 */
+    xl9555_pins_write(BEEP_IO | SPK_EN_IO, BEEP_IO | SPK_EN_IO);
 
     return ESP_OK;
 }
 
 /**
  * @brief       按键扫描函数
+ * @note        轮询方式, 每次调用都会访问IIC总线; 使能 xl9555_event_init 后建议改用 xl9555_event_get
  * @param       mode:0->不连续;1->连续
  * @retval      键值, 定义如下:
  *              KEY0_PRES, 1, KEY0按下
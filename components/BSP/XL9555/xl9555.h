@@ -23,6 +23,9 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 #include "myiic.h"
 #include "string.h"
@@ -42,6 +45,17 @@
 #define XL9555_CONFIG_PORT1_REG     7                               /* 方向配置寄存器1地址 */
 
 #define XL9555_ADDR                 0X20                            /* XL9555器件7位地址-->请看手册（9.1. Device Address） */
+#define XL9555_WRITE_MAX            8                               /* 单次写入的最大数据长度(寄存器总数) */
+
+/* 输入事件参数 */
+#define XL9555_INPUT_MASK           0xF003                          /* 输入方向的IO(与 xl9555_ioconfig 一致) */
+#define XL9555_KEY_MASK             (KEY0_IO | KEY1_IO | KEY2_IO | KEY3_IO)
+#define XL9555_INT_EN               0                               /* 1:INT中断唤醒; 0:周期查询(本板IO40同时是SPILCD的DC引脚, 不能配置为中断输入) */
+#define XL9555_POLL_MS              30                              /* 未使能中断时的查询周期 */
+#define XL9555_TRIGGER_POLL_MS      5                               /* 注册了触发IO且未使能中断时的查询周期(边沿到回调的最大延迟) */
+#define XL9555_DEBOUNCE_MS          20                              /* 消抖时间: 最后一次跳变后保持该时间才认为稳定 */
+#define XL9555_EVENT_QUEUE_LEN      8                               /* 输入事件队列长度 */
+#define XL9555_EVENT_THREAD_PRIO    6                               /* 输入事件线程优先级 */
 
 /* XL9555各个IO的功能 */
 #define AP_INT_IO                   0x0001
@@ -71,13 +85,29 @@
 #define KEY2_PRES                   3                               /* KEY1按下 */
 #define KEY3_PRES                   4                               /* KEY1按下 */
 
+/* 输入事件(消抖后的一次电平变化) */
+typedef struct
+{
+    uint16_t changed;                                               /* 发生变化的IO */
+    uint16_t level;                                                 /* 变化后所有输入IO的电平 */
+    uint8_t key;                                                    /* 新按下的按键 KEYx_PRES, 0:无按键按下 */
+    int64_t time_us;                                                /* 首次检测到跳变的时间 */
+} xl9555_event_t;
+
+/* 触发回调(输入事件线程中调用, 不经消抖): changed 为本次跳变的触发IO, level 为读到的所有输入IO电平, time_us 为读到跳变的时间 */
+typedef void (*xl9555_trigger_cb_t)(uint16_t changed, uint16_t level, int64_t time_us);
+
 /* 函数声明 */
 esp_err_t xl9555_init(void);                                            /* 初始化XL9555 */
 int xl9555_pin_read(uint16_t pin);                                      /* 获取某个IO状态 */
 uint16_t xl9555_pin_write(uint16_t pin, int val);                       /* 控制某个IO的电平 */
+uint16_t xl9555_pins_write(uint16_t mask, uint16_t val);                /* 一次更新多个IO的电平 */
 esp_err_t xl9555_read_byte(uint8_t* data, size_t len);                  /* 读取XL9555的IO值 */
 esp_err_t xl9555_write_byte(uint8_t reg, uint8_t *data, size_t len);    /* 向XL9555寄存器写入数据 */
 uint8_t xl9555_key_scan(uint8_t mode);                                  /* 扫描扩展按键 */
 void xl9555_int_init(void);                                             /* 初始化XL9555的中断引脚 */
+esp_err_t xl9555_event_init(void);                                      /* 初始化输入事件(本板为周期查询, XL9555_INT_EN 时由INT唤醒) */
+BaseType_t xl9555_event_get(xl9555_event_t *evt, TickType_t timeout);   /* 等待一个输入事件 */
+void xl9555_trigger_set(uint16_t mask, xl9555_trigger_cb_t cb);         /* 注册不经消抖的边沿触发回调 */
 
 #endif
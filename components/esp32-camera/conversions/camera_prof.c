@@ -11,33 +11,19 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
-#ifndef _ESP_JPG_DECODE_H_
-#define _ESP_JPG_DECODE_H_
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
 #include <stddef.h>
-#include <stdint.h>
-#include <stdbool.h>
-#include "esp_err.h"
-
-typedef enum {
-    JPG_SCALE_NONE,
-    JPG_SCALE_2X,
-    JPG_SCALE_4X,
-    JPG_SCALE_8X,
-    JPG_SCALE_MAX = JPG_SCALE_8X
-} jpg_scale_t;
-
-typedef size_t (* jpg_reader_cb)(void * arg, size_t index, uint8_t *buf, size_t len);
-typedef bool (* jpg_writer_cb)(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data);
+#include "camera_prof.h"
 
-esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void * arg);
-
-#ifdef __cplusplus
-}
+#if CONFIG_CAMERA_PROF_HOOKS
+// read once per region by camera_prof_begin(), so a region always ends with the hooks it began with
+const camera_prof_hooks_t *volatile camera_prof_hooks = NULL;
 #endif
 
-#endif /* _ESP_JPG_DECODE_H_ */
+void camera_prof_set_hooks(const camera_prof_hooks_t *hooks)
+{
+#if CONFIG_CAMERA_PROF_HOOKS
+    camera_prof_hooks = hooks;
+#else
+    (void)hooks;
+#endif
+}
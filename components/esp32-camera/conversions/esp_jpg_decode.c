@@ -0,0 +1,235 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "esp_jpg_decode.h"
+#include "esp_heap_caps.h"
+#include "camera_prof.h"
+
+#include "esp_system.h"
+#include "sdkconfig.h"
+#if ESP_IDF_VERSION_MAJOR >= 4 // IDF 4+
+#if CONFIG_IDF_TARGET_ESP32 // ESP32/PICO-D4
+#include "esp32/rom/tjpgd.h"
+#elif CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/tjpgd.h"
+#elif CONFIG_IDF_TARGET_ESP32C3
+#include "esp32c3/rom/tjpgd.h"
+#elif CONFIG_ESP_ROM_HAS_JPEG_DECODE // available since IDF 4.4
+#include "rom/tjpgd.h"  // latest IDFs have `rom/` includes available
+#else
+#include "tjpgd.h"  // using software decoder
+#endif
+#else // ESP32 Before IDF 4.0
+#include "rom/tjpgd.h"
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "esp_jpg_decode";
+#endif
+
+typedef struct {
+        jpg_scale_t scale;
+        jpg_reader_cb reader;
+        jpg_writer_cb writer;
+        void * arg;
+        const uint8_t *src;     // whole JPEG in memory, read directly instead of through reader
+        size_t len;
+        size_t index;
+} esp_jpg_decoder_t;
+
+static const char * jd_errors[] = {
+    "Succeeded",
+    "Interrupted by output function",
+    "Device error or wrong termination of input stream",
+    "Insufficient memory pool for the image",
+    "Insufficient stream input buffer",
+    "Parameter error",
+    "Data format error",
+    "Right format but not supported",
+    "Not supported JPEG standard"
+};
+
+static unsigned int _jpg_write(JDEC *decoder, void *bitmap, JRECT *rect)
+{
+    uint16_t x = rect->left;
+    uint16_t y = rect->top;
+    uint16_t w = rect->right + 1 - x;
+    uint16_t h = rect->bottom + 1 - y;
+    uint8_t *data = (uint8_t *)bitmap;
+
+    esp_jpg_decoder_t * jpeg = (esp_jpg_decoder_t *)decoder->device;
+
+    if (jpeg->writer) {
+        return jpeg->writer(jpeg->arg, x, y, w, h, data);
+    }
+    return 0;
+}
+
+static unsigned int _jpg_read(JDEC *decoder, uint8_t *buf, unsigned int len)
+{
+    esp_jpg_decoder_t * jpeg = (esp_jpg_decoder_t *)decoder->device;
+    if (jpeg->len && len > (jpeg->len - jpeg->index)) {
+        len = jpeg->len - jpeg->index;
+    }
+    if (len && jpeg->src) {
+        if (buf) {
+            memcpy(buf, jpeg->src + jpeg->index, len);
+        }
+        jpeg->index += len;
+    } else if (len) {
+        len = jpeg->reader(jpeg->arg, jpeg->index, buf, len);
+        if (!len) {
+            ESP_LOGE(TAG, "Read Fail at %u/%u", jpeg->index, jpeg->len);
+        }
+        jpeg->index += len;
+    }
+    return len;
+}
+
+static esp_err_t _jpg_decode(esp_jpg_dec_t *dec, const uint8_t *src, size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void * arg)
+{
+    JDEC decoder;
+    esp_jpg_decoder_t jpeg;
+
+    jpeg.src = src;
+    jpeg.len = len;
+    jpeg.reader = reader;
+    jpeg.writer = writer;
+    jpeg.arg = arg;
+    jpeg.scale = scale;
+    jpeg.index = 0;
+
+    JRESULT jres = jd_prepare(&decoder, _jpg_read, dec->work, sizeof(dec->work), &jpeg);
+    if(jres != JDR_OK){
+        ESP_LOGE(TAG, "JPG Header Parse Failed! %s", jd_errors[jres]);
+        return ESP_FAIL;
+    }
+
+    uint16_t output_width = decoder.width / (1 << (uint8_t)(jpeg.scale));
+    uint16_t output_height = decoder.height / (1 << (uint8_t)(jpeg.scale));
+
+    //output start, the writer may refuse the image (output buffer too small or not allocated)
+    if (!writer(arg, 0, 0, output_width, output_height, NULL)) {
+        ESP_LOGE(TAG, "JPG output rejected %ux%u", output_width, output_height);
+        return ESP_FAIL;
+    }
+    //output write
+    jres = jd_decomp(&decoder, _jpg_write, (uint8_t)jpeg.scale);
+    //output end
+    writer(arg, output_width, output_height, output_width, output_height, NULL);
+
+    if (jres == JDR_INTR) {
+        //the writer stopped the decode, e.g. it has all the lines it needs
+        ESP_LOGD(TAG, "JPG Decompression stopped by the writer");
+        return ESP_FAIL;
+    }
+    if (jres != JDR_OK) {
+        ESP_LOGE(TAG, "JPG Decompression Failed! %s", jd_errors[jres]);
+        return ESP_FAIL;
+    }
+    //check if all data has been consumed.
+    if (len && jpeg.index < len) {
+        _jpg_read(&decoder, NULL, len - jpeg.index);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_jpg_decode_ctx(esp_jpg_dec_t *dec, size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void * arg)
+{
+    camera_prof_mark_t mark;
+
+    camera_prof_begin(&mark);
+    esp_err_t ret = _jpg_decode(dec, NULL, len, scale, reader, writer, arg);
+    camera_prof_end(CAMERA_PROF_JPG_DECODE, &mark);
+    return ret;
+}
+
+esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void * arg)
+{
+    //per call instead of a static work area, so concurrent decodes do not share tables
+    esp_jpg_dec_t *dec = (esp_jpg_dec_t *)heap_caps_malloc(sizeof(esp_jpg_dec_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!dec) {
+        ESP_LOGE(TAG, "decoder state alloc failed (%u bytes)", sizeof(esp_jpg_dec_t));
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = esp_jpg_decode_ctx(dec, len, scale, reader, writer, arg);
+    heap_caps_free(dec);
+    return ret;
+}
+
+#if CONFIG_CAMERA_JPEG_FAST_DECODE
+//ESP_ERR_NOT_SUPPORTED if jpg_fast does not handle this file and tjpgd has to
+static esp_err_t _jpg_decode_fast(jpg_fast_t *jd, const uint8_t *src, size_t len, jpg_scale_t scale, bool luma_only, jpg_writer_cb writer, void * arg)
+{
+    if (!jpg_fast_prepare(jd, src, len)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    uint16_t output_width = jd->width >> (uint8_t)scale;
+    uint16_t output_height = jd->height >> (uint8_t)scale;
+
+    //output start, same protocol as the tjpgd path
+    if (!writer(arg, 0, 0, output_width, output_height, NULL)) {
+        ESP_LOGE(TAG, "JPG output rejected %ux%u", output_width, output_height);
+        return ESP_FAIL;
+    }
+    int res = jpg_fast_decomp(jd, (uint8_t)scale, luma_only, writer, arg);
+    writer(arg, output_width, output_height, output_width, output_height, NULL);
+
+    if (res == JPG_FAST_INTR) {
+        ESP_LOGD(TAG, "JPG Decompression stopped by the writer");
+        return ESP_FAIL;
+    }
+    if (res != JPG_FAST_OK) {
+        ESP_LOGE(TAG, "JPG Decompression Failed! Data format error");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+#endif
+
+esp_err_t esp_jpg_decode_buf(esp_jpg_dec_t *dec, const uint8_t *src, size_t len, jpg_scale_t scale, bool luma_only, jpg_writer_cb writer, void * arg)
+{
+    esp_jpg_dec_t *own = NULL;
+    camera_prof_mark_t mark;
+    esp_err_t ret;
+
+    if (!dec) {
+        own = (esp_jpg_dec_t *)heap_caps_malloc(sizeof(esp_jpg_dec_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!own) {
+            ESP_LOGE(TAG, "decoder state alloc failed (%u bytes)", sizeof(esp_jpg_dec_t));
+            return ESP_ERR_NO_MEM;
+        }
+        dec = own;
+    }
+
+    camera_prof_begin(&mark);
+#if CONFIG_CAMERA_JPEG_FAST_DECODE
+    ret = _jpg_decode_fast(&dec->fast, src, len, scale, luma_only, writer, arg);
+    if (ret == ESP_ERR_NOT_SUPPORTED)
+#endif
+    {
+        ret = _jpg_decode(dec, src, len, scale, NULL, writer, arg);
+    }
+    camera_prof_end(CAMERA_PROF_JPG_DECODE, &mark);
+
+    heap_caps_free(own);
+    return ret;
+}
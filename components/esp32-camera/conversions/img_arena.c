@@ -0,0 +1,84 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stddef.h>
+#include <stdlib.h>
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include "img_converters.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "img_arena";
+#endif
+
+// output images go to SPIRAM when available, like the allocating converters
+static void *_malloc_out(size_t size)
+{
+#if (CONFIG_SPIRAM_SUPPORT && (CONFIG_SPIRAM_USE_CAPS_ALLOC || CONFIG_SPIRAM_USE_MALLOC))
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    return malloc(size);
+}
+
+// the encoder scratch is touched for every pixel, prefer internal memory
+static void *_malloc_work(size_t size)
+{
+    void * res = malloc(size);
+    if(res) {
+        return res;
+    }
+#if (CONFIG_SPIRAM_SUPPORT && (CONFIG_SPIRAM_USE_CAPS_ALLOC || CONFIG_SPIRAM_USE_MALLOC))
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    return NULL;
+}
+
+bool img_arena_reserve(img_arena_t *arena, size_t size, size_t work_size)
+{
+    // buffers only grow: the old contents are not needed, so free before allocating instead of realloc()
+    if(size > arena->size) {
+        free(arena->buf);
+        arena->buf = (uint8_t *)_malloc_out(size);
+        arena->size = arena->buf ? size : 0;
+        if(!arena->buf) {
+            ESP_LOGE(TAG, "Output malloc failed! %u", size);
+            return false;
+        }
+        arena->grows++;
+    }
+    if(work_size > arena->work_size) {
+        free(arena->work);
+        arena->work = (uint8_t *)_malloc_work(work_size);
+        arena->work_size = arena->work ? work_size : 0;
+        if(!arena->work) {
+            ESP_LOGE(TAG, "Work malloc failed! %u", work_size);
+            return false;
+        }
+        arena->grows++;
+    }
+    return true;
+}
+
+void img_arena_free(img_arena_t *arena)
+{
+    free(arena->buf);
+    free(arena->work);
+    arena->buf = NULL;
+    arena->size = 0;
+    arena->work = NULL;
+    arena->work_size = 0;
+}
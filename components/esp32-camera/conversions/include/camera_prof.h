@@ -0,0 +1,91 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Hot-path regions of the driver and the converters that can be profiled
+ */
+typedef enum {
+    CAMERA_PROF_COPY,           /*!< cam_task moving DMA data into the frame buffer (memcpy, or cache writeback/invalidate with DMA to PSRAM) */
+    CAMERA_PROF_EOI,            /*!< JPEG end marker search before a frame is queued */
+    CAMERA_PROF_CONVERT,        /*!< convert_image(): JPEG encoding of a raw frame */
+    CAMERA_PROF_JPG_DECODE,     /*!< esp_jpg_decode(): JPEG decoding for the RGB/BMP converters */
+    CAMERA_PROF_REGION_NUM
+} camera_prof_region_t;
+
+struct camera_prof_hooks;
+
+/**
+ * @brief Start of one profiled region, kept on the caller's stack
+ */
+typedef struct {
+    const struct camera_prof_hooks *hooks;  /*!< Hooks that opened the region, NULL when no profiler was installed */
+    uint32_t data[6];                       /*!< Counter snapshot, owned by the profiler */
+} camera_prof_mark_t;
+
+/**
+ * @brief Profiler installed by the application
+ *
+ * Both hooks run in the profiled task, on its stack, and must be short: they usually read
+ * CPU performance counters into the mark and accumulate the difference per region.
+ */
+typedef struct camera_prof_hooks {
+    void (*begin)(camera_prof_mark_t *mark);
+    void (*end)(int region, const camera_prof_mark_t *mark);
+} camera_prof_hooks_t;
+
+#if CONFIG_CAMERA_PROF_HOOKS
+extern const camera_prof_hooks_t *volatile camera_prof_hooks;
+
+static inline void camera_prof_begin(camera_prof_mark_t *mark)
+{
+    const camera_prof_hooks_t *hooks = camera_prof_hooks;
+
+    mark->hooks = hooks;
+    if (hooks) {
+        hooks->begin(mark);
+    }
+}
+
+static inline void camera_prof_end(int region, const camera_prof_mark_t *mark)
+{
+    if (mark->hooks) {
+        mark->hooks->end(region, mark);
+    }
+}
+#else
+static inline void camera_prof_begin(camera_prof_mark_t *mark) { mark->hooks = NULL; }
+static inline void camera_prof_end(int region, const camera_prof_mark_t *mark) { (void)region; (void)mark; }
+#endif
+
+/**
+ * @brief Install or remove (NULL) the profiler
+ *
+ * Regions already open when the hooks change are closed with the hooks that opened them,
+ * so the hooks structure must stay valid after it is replaced.
+ *
+ * @param hooks Profiler hooks, NULL to stop profiling
+ */
+void camera_prof_set_hooks(const camera_prof_hooks_t *hooks);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,89 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef _ESP_JPG_DECODE_H_
+#define _ESP_JPG_DECODE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "jpg_fast.h"
+
+typedef enum {
+    JPG_SCALE_NONE,
+    JPG_SCALE_2X,
+    JPG_SCALE_4X,
+    JPG_SCALE_8X,
+    JPG_SCALE_MAX = JPG_SCALE_8X
+} jpg_scale_t;
+
+typedef size_t (* jpg_reader_cb)(void * arg, size_t index, uint8_t *buf, size_t len);
+typedef bool (* jpg_writer_cb)(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data);
+
+#define ESP_JPG_DECODE_WORK_SIZE 3100
+
+/**
+ * @brief Decoder state: Huffman and quantization tables and the MCU buffer
+ *
+ * One decode uses it at a time; threads decoding concurrently need one each.
+ * Keep it in internal RAM (static or MALLOC_CAP_INTERNAL), it is read for every MCU.
+ */
+typedef union {
+    uint8_t work[ESP_JPG_DECODE_WORK_SIZE];     // tjpgd
+    jpg_fast_t fast;                            // jpg_fast, esp_jpg_decode_buf() only
+} esp_jpg_dec_t;
+
+/**
+ * @brief Decode a JPEG, allocating the decoder state for this call
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the state could not be allocated,
+ *         ESP_FAIL on a decode error or when the writer stopped the decode
+ */
+esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void * arg);
+
+/**
+ * @brief Decode a JPEG using a caller-provided decoder state, without allocating
+ *
+ * @param dec       Decoder state, not shared with a concurrent decode
+ *
+ * @return ESP_OK on success, ESP_FAIL on a decode error or when the writer stopped the decode
+ */
+esp_err_t esp_jpg_decode_ctx(esp_jpg_dec_t *dec, size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void * arg);
+
+/**
+ * @brief Decode a JPEG held in memory
+ *
+ * Baseline JPEGs as the camera produces them go through jpg_fast (see jpg_fast.h), other
+ * files through tjpgd; the writer sees the same calls either way.
+ * The fast path is used with CONFIG_CAMERA_JPEG_FAST_DECODE.
+ *
+ * @param dec       Decoder state, or NULL to allocate it for this call
+ * @param src       JPEG data
+ * @param len       Length of the JPEG data
+ * @param luma_only Only the luma is needed (R=G=B=Y is enough), chroma decoding may be skipped
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the state could not be allocated,
+ *         ESP_FAIL on a decode error or when the writer stopped the decode
+ */
+esp_err_t esp_jpg_decode_buf(esp_jpg_dec_t *dec, const uint8_t *src, size_t len, jpg_scale_t scale, bool luma_only, jpg_writer_cb writer, void * arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_JPG_DECODE_H_ */
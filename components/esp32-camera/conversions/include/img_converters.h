@@ -0,0 +1,352 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef _IMG_CONVERTERS_H_
+#define _IMG_CONVERTERS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_camera.h"
+#include "esp_jpg_decode.h"
+
+typedef size_t (* jpg_out_cb)(void * arg, size_t index, const void* data, size_t len);
+
+// Chunk callback of fmt2jpg_chunks(): index is the offset of data in the JPEG, last is set on the final chunk.
+// Return false to stop the conversion.
+typedef bool (* jpg_chunk_cb)(void * arg, size_t index, const uint8_t *data, size_t len, bool last);
+
+/**
+ * @brief Reusable buffers for the *_arena converters
+ *
+ * The buffers only grow and are kept between calls, so a pipeline converting frames of
+ * a steady size allocates on its first frames and then not at all. Use one arena per
+ * output that must stay valid at the same time (e.g. one per in-flight frame).
+ * Zero-initialize it (IMG_ARENA_INIT) and release it with img_arena_free().
+ */
+typedef struct {
+    uint8_t *buf;       // output image, valid until the next call with this arena
+    size_t size;        // capacity of buf
+    uint8_t *work;      // JPEG encoder scratch (scan line and MCU rows)
+    size_t work_size;   // capacity of work
+    uint32_t grows;     // number of (re)allocations so far, stays constant in steady state
+} img_arena_t;
+
+#define IMG_ARENA_INIT { NULL, 0, NULL, 0, 0 }
+
+/**
+ * @brief Make sure the arena holds at least size output bytes and work_size work bytes
+ *
+ * @return true on success, false if an allocation failed
+ */
+bool img_arena_reserve(img_arena_t *arena, size_t size, size_t work_size);
+
+/**
+ * @brief Free the arena buffers
+ */
+void img_arena_free(img_arena_t *arena);
+
+/**
+ * @brief Convert image buffer to JPEG
+ *
+ * @param src       Source buffer in RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Format of the source image
+ * @param quality   JPEG quality of the resulting image
+ * @param cp        Callback to be called to write the bytes of the output JPEG
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool fmt2jpg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpg_out_cb cb, void * arg);
+
+/**
+ * @brief Convert camera frame buffer to JPEG
+ *
+ * @param fb        Source camera frame buffer
+ * @param quality   JPEG quality of the resulting image
+ * @param cp        Callback to be called to write the bytes of the output JPEG
+ * @param arg       Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool frame2jpg_cb(camera_fb_t * fb, uint8_t quality, jpg_out_cb cb, void * arg);
+
+/**
+ * @brief Convert image buffer to JPEG buffer
+ *
+ * @param src       Source buffer in RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Format of the source image
+ * @param quality   JPEG quality of the resulting image
+ * @param out       Pointer to be populated with the address of the resulting buffer.
+ *                  You MUST free the pointer once you are done with it.
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Convert camera frame buffer to JPEG buffer
+ *
+ * @param fb        Source camera frame buffer
+ * @param quality   JPEG quality of the resulting image
+ * @param out       Pointer to be populated with the address of the resulting buffer
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool frame2jpg(camera_fb_t * fb, uint8_t quality, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Size of the work buffer fmt2jpg_buf() needs for an image of this width
+ */
+size_t fmt2jpg_work_size(uint16_t width, pixformat_t format);
+
+/**
+ * @brief Convert image buffer to JPEG in a caller-provided buffer, without allocating
+ *
+ * @param src       Source buffer in RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Format of the source image
+ * @param quality   JPEG quality of the resulting image
+ * @param out       Output buffer
+ * @param out_size  Capacity of the output buffer
+ * @param work      fmt2jpg_work_size() bytes of scratch memory, or NULL to allocate it for this call
+ * @param out_len   Pointer to be populated with the length of the JPEG
+ *
+ * @return true on success, false if the JPEG did not fit in out_size bytes or on error
+ */
+bool fmt2jpg_buf(const uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, uint8_t *out, size_t out_size, uint8_t *work, size_t *out_len);
+
+/**
+ * @brief Convert image buffer to JPEG, handing the output to a callback in fixed-size chunks while encoding
+ *
+ * Every chunk but the last is exactly chunk_size bytes, so a transport can size the chunk to its MTU and
+ * send each one as it fills instead of waiting for the whole JPEG.
+ *
+ * @param src        Source buffer in RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len    Length in bytes of the source buffer
+ * @param width      Width in pixels of the source image
+ * @param height     Height in pixels of the source image
+ * @param format     Format of the source image
+ * @param quality    JPEG quality of the resulting image
+ * @param scan_only  Output only the entropy-coded data (with its restart markers), no headers and no EOI,
+ *                   for transports that carry the tables out of band such as RTP/JPEG (RFC 2435)
+ * @param chunk      Buffer the chunks are assembled in
+ * @param chunk_size Size of each chunk
+ * @param work       fmt2jpg_work_size() bytes of scratch memory, or NULL to allocate it for this call
+ * @param cb         Callback receiving each chunk
+ * @param arg        Pointer to be passed to the callback
+ *
+ * @return true on success
+ */
+bool fmt2jpg_chunks(const uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, bool scan_only,
+                    uint8_t *chunk, size_t chunk_size, uint8_t *work, jpg_chunk_cb cb, void * arg);
+
+/**
+ * @brief Restart interval (in MCUs) the fmt2jpg* converters use for an image of this size and format
+ *
+ * Non-zero only with CONFIG_CAMERA_JPEG_DUAL_CORE, where frames are split into two bands; transports that
+ * signal the interval out of band (the RTP/JPEG restart header) need it before the first chunk.
+ */
+uint16_t fmt2jpg_restart_interval(uint16_t width, uint16_t height, pixformat_t format);
+
+/**
+ * @brief Convert image buffer to JPEG in arena->buf, growing the arena if the image does not fit
+ *
+ * @param arena     Arena holding the output (arena->buf) and the encoder scratch
+ * @param out_len   Pointer to be populated with the length of the JPEG
+ *
+ * @return true on success
+ */
+bool fmt2jpg_arena(const uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, img_arena_t *arena, size_t *out_len);
+
+/**
+ * @brief Convert image buffer to BMP buffer
+ *
+ * @param src       Source buffer in JPEG, RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Format of the source image
+ * @param out       Pointer to be populated with the address of the resulting buffer
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Convert camera frame buffer to BMP buffer
+ *
+ * @param fb        Source camera frame buffer
+ * @param out       Pointer to be populated with the address of the resulting buffer
+ * @param out_len   Pointer to be populated with the length of the output buffer
+ *
+ * @return true on success
+ */
+bool frame2bmp(camera_fb_t * fb, uint8_t ** out, size_t * out_len);
+
+/**
+ * @brief Size of the BMP fmt2bmp_buf() produces from a non-JPEG image
+ *
+ * @return BMP size in bytes, 0 for PIXFORMAT_JPEG (use jpg2bmp_size())
+ */
+size_t fmt2bmp_size(uint16_t width, uint16_t height, pixformat_t format);
+
+/**
+ * @brief Size of the BMP jpg2bmp_buf() produces, read from the JPEG frame header
+ *
+ * @return BMP size in bytes, 0 if the frame header was not found
+ */
+size_t jpg2bmp_size(const uint8_t *src, size_t src_len);
+
+/**
+ * @brief Convert image buffer to BMP in a caller-provided buffer, without allocating
+ *
+ * @param src       Source buffer in JPEG, RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param width     Width in pixels of the source image
+ * @param height    Height in pixels of the source image
+ * @param format    Format of the source image
+ * @param out       Output buffer of at least fmt2bmp_size() (or jpg2bmp_size()) bytes
+ * @param out_size  Capacity of the output buffer
+ * @param out_len   Pointer to be populated with the length of the BMP
+ *
+ * @return true on success, false if out_size is too small or on error
+ */
+bool fmt2bmp_buf(const uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t *out, size_t out_size, size_t *out_len);
+
+/**
+ * @brief Convert JPEG to BMP in a caller-provided buffer, without allocating
+ *
+ * @return true on success, false if out_size is smaller than jpg2bmp_size() or on error
+ */
+bool jpg2bmp_buf(const uint8_t *src, size_t src_len, uint8_t *out, size_t out_size, size_t *out_len);
+
+/**
+ * @brief Convert image buffer to BMP in arena->buf, growing the arena if needed
+ *
+ * @return true on success
+ */
+bool fmt2bmp_arena(const uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, img_arena_t *arena, size_t *out_len);
+
+/**
+ * @brief Convert image buffer to RGB888 buffer (used for face detection)
+ *
+ * @param src       Source buffer in JPEG, RGB565, RGB888, YUYV or GRAYSCALE format
+ * @param src_len   Length in bytes of the source buffer
+ * @param format    Format of the source image
+ * @param rgb_buf   Pointer to the output buffer (width * height * 3)
+ *
+ * @return true on success
+ */
+bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint8_t * rgb_buf);
+
+bool jpg2rgb565(const uint8_t *src, size_t src_len, uint8_t * out, jpg_scale_t scale);
+
+// Output pixel layout of jpg2strips()
+typedef enum {
+    JPG_STRIP_GRAY,         // 8-bit luma (BT.601)
+    JPG_STRIP_RGB565,       // RGB565 little endian, as jpg2rgb565()
+    JPG_STRIP_RGB565_BE,    // RGB565 big endian (SPI LCD byte order)
+    JPG_STRIP_RGB888,       // R, G, B
+} jpg_strip_format_t;
+
+// One strip of decoded lines
+typedef struct {
+    uint16_t width;         // scaled image width, also the pixels per strip line
+    uint16_t height;        // scaled image height
+    uint16_t y;             // first line of the strip
+    uint16_t lines;         // valid lines, the last strip may be shorter
+    uint8_t *data;          // pixels, row-major without padding
+} jpg_strip_t;
+
+/**
+ * @brief Called by jpg2strips() for every filled strip
+ *
+ * The callback may point strip->data to another buffer of the same size for the next strip
+ * (double buffering, e.g. while DMA still sends this one).
+ *
+ * @return true to continue, false to stop decoding (jpg2strips() still returns true)
+ */
+typedef bool (*jpg_strip_cb)(void *arg, jpg_strip_t *strip);
+
+/**
+ * @brief Bytes per pixel of a strip format
+ */
+size_t jpg_strip_bpp(jpg_strip_format_t format);
+
+/**
+ * @brief Decode a JPEG in strips of a few MCU rows, without a whole-frame output buffer
+ *
+ * A QVGA..SVGA RGB565 strip of 16 lines fits in 10-25 KB of internal RAM instead of a
+ * w*h*2 PSRAM frame. Decoding goes through esp_jpg_decode_buf() and is reentrant when
+ * each thread has its own dec.
+ *
+ * @param dec           Decoder state, or NULL to allocate it for this call
+ * @param src           JPEG data
+ * @param src_len       Length of the JPEG data
+ * @param scale         Output scale
+ * @param format        Output pixel format
+ * @param buf           First strip buffer
+ * @param buf_size      Capacity of buf, at least scaled width * strip_lines * jpg_strip_bpp()
+ * @param strip_lines   Strip height, a multiple of the scaled MCU height (8 or 16 >> scale);
+ *                      0 decodes the whole image into buf as one strip
+ * @param cb            Strip callback, may be NULL only with strip_lines 0
+ * @param arg           Pointer to be passed to the callback
+ *
+ * @return true on success or when cb stopped the decode, false on a decode error,
+ *         a too small buf or a strip height that is not a multiple of the MCU height
+ */
+bool jpg2strips(esp_jpg_dec_t *dec, const uint8_t *src, size_t src_len, jpg_scale_t scale, jpg_strip_format_t format,
+                uint8_t *buf, size_t buf_size, uint16_t strip_lines, jpg_strip_cb cb, void *arg);
+
+/**
+ * @brief Extract a 1/8 resolution thumbnail from a JPEG
+ *
+ * Each 8x8 block becomes one pixel from its DC coefficient: the Huffman data is walked to
+ * skip the AC terms, but no AC value is reconstructed and no IDCT runs. For motion
+ * detection, thumbnails and indexing that only need a small image.
+ *
+ * @param dec       Decoder state, or NULL to allocate it for this call
+ * @param src       JPEG data
+ * @param src_len   Length of the JPEG data
+ * @param format    Output pixel format, JPG_STRIP_GRAY also skips the chroma blocks
+ * @param out       Output buffer, row-major without padding
+ * @param out_size  Capacity of out, at least (width / 8) * (height / 8) * jpg_strip_bpp(format)
+ * @param width     Pointer to be populated with the thumbnail width, may be NULL
+ * @param height    Pointer to be populated with the thumbnail height, may be NULL
+ *
+ * @return true on success, false on a decode error or if out_size is too small
+ */
+bool jpg2thumb(esp_jpg_dec_t *dec, const uint8_t *src, size_t src_len, jpg_strip_format_t format,
+               uint8_t *out, size_t out_size, uint16_t *width, uint16_t *height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IMG_CONVERTERS_H_ */
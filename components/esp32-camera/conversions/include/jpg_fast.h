@@ -0,0 +1,128 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef _JPG_FAST_H_
+#define _JPG_FAST_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Fast decoder for the baseline JPEGs the camera produces, with the whole file in memory.
+// esp_jpg_decode_buf() tries it first and falls back to tjpgd for anything it rejects.
+//
+// Differences from tjpgd:
+// - The JPEG is read in place (no read callback, no input buffer copy) through a 32-bit
+//   left-aligned bit buffer refilled to more than 24 bits.
+// - Huffman codes up to JPG_FAST_LUT_BITS long resolve with one table lookup.
+// - Coefficients are dequantized while decoding and blocks without AC terms skip the IDCT.
+//   1/1 uses an integer LL&M IDCT; scaled decodes run a (8>>scale)x(8>>scale) IDCT on the
+//   low coefficients directly (DC only at 1/8) instead of a full IDCT followed by averaging.
+//   At 1/2 and 1/4 chroma blocks are decoded at the scaled MCU size, keeping the same chroma
+//   resolution as tjpgd.
+// - YCbCr->RGB is fixed point and the chroma terms are computed once per chroma sample;
+//   with luma_only the chroma IDCT and colour conversion are skipped (grey output).
+//
+// Supported: 8-bit baseline/extended Huffman (SOF0/SOF1), grey or YCbCr with luma sampling
+// 1x1/2x1/1x2/2x2 and chroma 1x1 (the camera's 4:2:2 and 4:2:0), one scan, restart markers.
+// jpg_fast_coefs() only decodes the Huffman data and hands out quantized coefficients per
+// block, for compressed-domain transcoding.
+
+#define JPG_FAST_LUT_BITS   8       // bits of the Huffman lookup tables (2^n 16-bit entries each)
+
+// jpg_fast_decomp()/jpg_fast_coefs() results
+#define JPG_FAST_OK         0
+#define JPG_FAST_INTR       1       // the callback stopped the decode
+#define JPG_FAST_ERR        -1      // corrupt data
+
+// Output callback, same as the esp_jpg_decode() writer: one call per MCU, RGB888 with a
+// stride of w pixels. Return false to stop the decode.
+typedef bool (*jpg_fast_out_cb)(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *rgb);
+
+// Coefficient callback: comp is the component index, zz one block of quantized coefficients
+// in zigzag order with zz[0] the absolute DC. Return false to stop.
+typedef bool (*jpg_fast_coef_cb)(void *arg, uint8_t comp, const int16_t *zz);
+
+typedef struct {
+    uint16_t lut[1 << JPG_FAST_LUT_BITS];   // (length << 8) | symbol, 0 if the code is longer than the LUT
+    int32_t maxcode[17];                    // largest code of each length, -1 if there is none
+    int16_t delta[17];                      // symbol index = code + delta[length]
+    uint8_t huffval[256];
+} jpg_fast_huff_t;
+
+typedef struct {
+    uint8_t id;         // component id from SOF
+    uint8_t h;          // horizontal sampling factor
+    uint8_t v;          // vertical sampling factor
+    uint8_t tq;         // quantization table
+    uint8_t td;         // DC Huffman table
+    uint8_t ta;         // AC Huffman table
+    int16_t pred;       // DC predictor
+} jpg_fast_comp_t;
+
+// Decoder state, about 6 KB; keep it in internal RAM
+typedef struct {
+    jpg_fast_huff_t huff[4];    // DC0, DC1, AC0, AC1
+    uint16_t qt[4][64];         // quantization tables, zigzag order
+    jpg_fast_comp_t comp[3];
+    uint8_t ncomp;
+    uint16_t width;
+    uint16_t height;
+    uint16_t restart;           // restart interval in MCUs, 0 if none
+    const uint8_t *p;           // entropy-coded data read position
+    const uint8_t *end;
+    uint32_t bitbuf;            // left-aligned bit buffer
+    int bits;                   // valid bits in bitbuf
+    bool marker;                // reached a marker, feed zeros from here
+    int16_t blk[64];            // dequantized coefficients of the current block, natural order
+    uint8_t plane[3][16 * 16];  // pixels of the current MCU per component, stride 16
+    uint8_t rgb[16 * 16 * 3];   // output of the current MCU
+} jpg_fast_t;
+
+/**
+ * @brief Parse the headers up to the entropy-coded data of the scan
+ *
+ * @return true if the format is supported, false on corrupt data or an unsupported format
+ *         (the caller falls back to tjpgd)
+ */
+bool jpg_fast_prepare(jpg_fast_t *jd, const uint8_t *src, size_t len);
+
+/**
+ * @brief Decode all MCUs after jpg_fast_prepare(), calling cb once per MCU
+ *
+ * @param scale     0..3 for 1/1..1/8, the output is the image size shifted right by scale
+ * @param luma_only skip chroma, output R=G=B=Y
+ *
+ * @return JPG_FAST_OK, JPG_FAST_INTR or JPG_FAST_ERR
+ */
+int jpg_fast_decomp(jpg_fast_t *jd, uint8_t scale, bool luma_only, jpg_fast_out_cb cb, void *arg);
+
+/**
+ * @brief Huffman-decode all blocks after jpg_fast_prepare(), calling cb per block in scan order
+ *
+ * Each MCU gives the h x v luma blocks and then each chroma block. Restart markers are
+ * handled here, cb sees one continuous sequence of blocks.
+ *
+ * @return JPG_FAST_OK, JPG_FAST_INTR or JPG_FAST_ERR
+ */
+int jpg_fast_coefs(jpg_fast_t *jd, jpg_fast_coef_cb cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JPG_FAST_H_ */
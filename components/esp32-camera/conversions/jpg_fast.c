@@ -0,0 +1,729 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stddef.h>
+#include <string.h>
+#include "jpg_fast.h"
+
+#define JF_FIX(x)   ((int32_t)((x) * 4096 + 0.5))   // 12-bit fixed point constant
+
+// zigzag -> natural order
+static const uint8_t jf_zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Basis of the scaled IDCTs [x][u]: round(4096 * c(u)/2 * cos((2x+1)u*pi/2N) * a(u)), where a(u)
+// is the attenuation of frequency u by averaging 8/N neighbouring pixels (1/2: cos(u*pi/16),
+// 1/4: cos(u*pi/16)*cos(u*pi/8)). The low frequencies then match a full 8x8 IDCT followed by
+// averaging, which is how tjpgd scales.
+static const int16_t jf_idct4[4][4] = {
+    { 1448,  1856,  1338,   652 },
+    { 1448,   769, -1338, -1573 },
+    { 1448,  -769, -1338,  1573 },
+    { 1448, -1856,  1338,  -652 },
+};
+
+static const int16_t jf_idct2[2][2] = {
+    { 1448,  1312 },
+    { 1448, -1312 },
+};
+
+static inline uint8_t jf_clamp(int32_t v)
+{
+    if ((uint32_t)v > 255) {
+        return (v < 0) ? 0 : 255;
+    }
+    return (uint8_t)v;
+}
+
+static inline uint16_t jf_be16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// Fill the bit buffer to more than 24 bits. A marker (0xFF not followed by 0x00) stops the
+// reader in front of it and zeros are fed from then on.
+static inline void jf_refill(jpg_fast_t *jd)
+{
+    uint32_t c;
+
+    while (jd->bits <= 24) {
+        c = 0;
+        if (!jd->marker && jd->p < jd->end) {
+            c = *jd->p++;
+            if (c == 0xFF) {
+                if (jd->p < jd->end && *jd->p == 0x00) {
+                    jd->p++;            // stuffed 0xFF 0x00
+                } else {
+                    jd->p--;            // marker, left for the restart handling
+                    jd->marker = true;
+                    c = 0;
+                }
+            }
+        }
+        jd->bitbuf |= c << (24 - jd->bits);
+        jd->bits += 8;
+    }
+}
+
+// One Huffman symbol, -1 on corrupt data
+static inline int jf_huff(jpg_fast_t *jd, const jpg_fast_huff_t *h)
+{
+    uint32_t code;
+    uint16_t e;
+
+    if (jd->bits < 16) {
+        jf_refill(jd);
+    }
+
+    e = h->lut[jd->bitbuf >> (32 - JPG_FAST_LUT_BITS)];
+    if (e != 0) {
+        jd->bitbuf <<= e >> 8;
+        jd->bits -= e >> 8;
+        return e & 0xFF;
+    }
+
+    for (int len = JPG_FAST_LUT_BITS + 1; len <= 16; len++) {
+        code = jd->bitbuf >> (32 - len);
+        if ((int32_t)code <= h->maxcode[len]) {
+            jd->bitbuf <<= len;
+            jd->bits -= len;
+            return h->huffval[(code + h->delta[len]) & 0xFF];
+        }
+    }
+    return -1;
+}
+
+// Read s (1..15) extra bits and sign-extend them
+static inline int32_t jf_extend(jpg_fast_t *jd, int s)
+{
+    uint32_t v;
+
+    if (jd->bits < s) {
+        jf_refill(jd);
+    }
+
+    v = jd->bitbuf >> (32 - s);
+    jd->bitbuf <<= s;
+    jd->bits -= s;
+
+    return (v < (1U << (s - 1))) ? (int32_t)v - (1 << s) + 1 : (int32_t)v;
+}
+
+// Skip s (1..15) extra bits of a coefficient that is not kept
+static inline void jf_skip(jpg_fast_t *jd, int s)
+{
+    if (jd->bits < s) {
+        jf_refill(jd);
+    }
+    jd->bitbuf <<= s;
+    jd->bits -= s;
+}
+
+// Build a Huffman table from the DHT code counts (lengths 1..16) and symbols
+static bool jf_build_huff(jpg_fast_huff_t *h, const uint8_t *counts, const uint8_t *vals, int total)
+{
+    uint32_t code = 0;
+    int k = 0;
+
+    memset(h, 0, sizeof(jpg_fast_huff_t));
+    memcpy(h->huffval, vals, total);
+
+    for (int len = 1; len <= 16; len++) {
+        h->delta[len] = (int16_t)(k - (int32_t)code);
+        h->maxcode[len] = -1;
+
+        for (int i = 0; i < counts[len - 1]; i++, k++, code++) {
+            if (code >= (1U << len)) {
+                return false;
+            }
+            if (len <= JPG_FAST_LUT_BITS) {
+                int shift = JPG_FAST_LUT_BITS - len;
+                for (uint32_t j = 0; j < (1U << shift); j++) {
+                    h->lut[(code << shift) | j] = (uint16_t)((len << 8) | vals[k]);
+                }
+            }
+        }
+
+        if (counts[len - 1] != 0) {
+            h->maxcode[len] = (int32_t)code - 1;
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+bool jpg_fast_prepare(jpg_fast_t *jd, const uint8_t *src, size_t len)
+{
+    const uint8_t *p = src;
+    const uint8_t *end = src + len;
+    const uint8_t *seg;
+    uint8_t counts[16];
+    uint32_t qt_set = 0;
+    uint32_t huff_set = 0;
+    bool sof = false;
+    uint16_t seg_len;
+    uint8_t m;
+    int total;
+
+    memset(jd, 0, offsetof(jpg_fast_t, blk));
+
+    if (len < 4 || p[0] != 0xFF || p[1] != 0xD8) {
+        return false;
+    }
+    p += 2;
+
+    while (1) {
+        while (p < end && *p != 0xFF) {
+            p++;                        // tolerate stray bytes between segments
+        }
+        while (p < end && *p == 0xFF) {
+            p++;
+        }
+        if (p + 3 > end) {
+            return false;
+        }
+
+        m = *p++;
+        if (m == 0xD8 || (m >= 0xD0 && m <= 0xD7) || m == 0x01) {
+            continue;                   // markers without a length
+        }
+        if (m == 0xD9) {
+            return false;               // no scan
+        }
+
+        seg_len = jf_be16(p);
+        if (seg_len < 2 || p + seg_len > end) {
+            return false;
+        }
+        seg = p + 2;
+        p += seg_len;
+
+        switch (m) {
+        case 0xDB:  // DQT
+            while (seg < p) {
+                uint8_t pq = seg[0] >> 4;
+                uint8_t tq = seg[0] & 0x03;
+
+                if (pq > 1 || seg + 1 + 64 * (pq + 1) > p) {
+                    return false;
+                }
+                for (int i = 0; i < 64; i++) {
+                    jd->qt[tq][i] = pq ? jf_be16(seg + 1 + 2 * i) : seg[1 + i];
+                }
+                qt_set |= 1U << tq;
+                seg += 1 + 64 * (pq + 1);
+            }
+            break;
+
+        case 0xC4:  // DHT
+            while (seg < p) {
+                uint8_t tc = seg[0] >> 4;
+                uint8_t th = seg[0] & 0x0F;
+
+                if (tc > 1 || th > 1 || seg + 17 > p) {
+                    return false;
+                }
+                memcpy(counts, seg + 1, 16);
+                total = 0;
+                for (int i = 0; i < 16; i++) {
+                    total += counts[i];
+                }
+                if (total > 256 || seg + 17 + total > p ||
+                    !jf_build_huff(&jd->huff[tc * 2 + th], counts, seg + 17, total)) {
+                    return false;
+                }
+                huff_set |= 1U << (tc * 2 + th);
+                seg += 17 + total;
+            }
+            break;
+
+        case 0xC0:  // SOF0 baseline
+        case 0xC1:  // SOF1 extended, Huffman
+            if (seg_len < 8 || seg[0] != 8) {
+                return false;
+            }
+            jd->height = jf_be16(seg + 1);
+            jd->width = jf_be16(seg + 3);
+            jd->ncomp = seg[5];
+            if (jd->width == 0 || jd->height == 0 || (jd->ncomp != 1 && jd->ncomp != 3) ||
+                seg_len < 8 + 3 * jd->ncomp) {
+                return false;
+            }
+            for (int i = 0; i < jd->ncomp; i++) {
+                jd->comp[i].id = seg[6 + 3 * i];
+                jd->comp[i].h = seg[7 + 3 * i] >> 4;
+                jd->comp[i].v = seg[7 + 3 * i] & 0x0F;
+                jd->comp[i].tq = seg[8 + 3 * i] & 0x03;
+            }
+            if (jd->ncomp == 1) {
+                // a single-component scan is not interleaved, its MCU is one block
+                jd->comp[0].h = 1;
+                jd->comp[0].v = 1;
+            } else if (jd->comp[0].h < 1 || jd->comp[0].h > 2 || jd->comp[0].v < 1 || jd->comp[0].v > 2 ||
+                       jd->comp[1].h != 1 || jd->comp[1].v != 1 || jd->comp[2].h != 1 || jd->comp[2].v != 1) {
+                return false;           // chroma must be 1x1
+            }
+            sof = true;
+            break;
+
+        case 0xDD:  // DRI
+            if (seg_len < 4) {
+                return false;
+            }
+            jd->restart = jf_be16(seg);
+            break;
+
+        case 0xDA:  // SOS
+            if (!sof || seg_len < 6 + 2 * seg[0] || seg[0] != jd->ncomp) {
+                return false;           // only one scan holding all components
+            }
+            for (int i = 0; i < jd->ncomp; i++) {
+                int c = 0;
+
+                while (c < jd->ncomp && jd->comp[c].id != seg[1 + 2 * i]) {
+                    c++;
+                }
+                if (c != i) {
+                    return false;       // scan order differs from SOF
+                }
+                jd->comp[i].td = seg[2 + 2 * i] >> 4;
+                jd->comp[i].ta = seg[2 + 2 * i] & 0x0F;
+                if (jd->comp[i].td > 1 || jd->comp[i].ta > 1 ||
+                    !(qt_set & (1U << jd->comp[i].tq)) ||
+                    !(huff_set & (1U << jd->comp[i].td)) || !(huff_set & (1U << (2 + jd->comp[i].ta)))) {
+                    return false;
+                }
+            }
+            seg += 1 + 2 * jd->ncomp;
+            if (seg[0] != 0 || seg[1] != 63 || seg[2] != 0) {
+                return false;           // progressive spectral selection / successive approximation
+            }
+            jd->p = p;
+            jd->end = end;
+            return true;
+
+        default:
+            if ((m >= 0xC2 && m <= 0xCF) && m != 0xC4 && m != 0xC8 && m != 0xCC) {
+                return false;           // progressive, lossless, arithmetic coding
+            }
+            break;                      // APPn, COM
+        }
+    }
+}
+
+// Decode and dequantize one block, keeping the top-left n x n coefficients.
+// store == false only parses it (chroma with luma_only).
+// Returns 1 if there are nonzero AC terms, 0 for DC only, -1 on corrupt data.
+static int jf_block(jpg_fast_t *jd, jpg_fast_comp_t *c, int n, bool store)
+{
+    const jpg_fast_huff_t *ac = &jd->huff[2 + c->ta];
+    const uint16_t *q = jd->qt[c->tq];
+    int16_t *blk = jd->blk;
+    int has_ac = 0;
+    int s;
+    int rs;
+    int z;
+    int32_t v;
+
+    s = jf_huff(jd, &jd->huff[c->td]);
+    if (s < 0 || s > 15) {
+        return -1;
+    }
+    c->pred += (s != 0) ? (int16_t)jf_extend(jd, s) : 0;
+
+    if (store) {
+        memset(blk, 0, sizeof(jd->blk));
+        blk[0] = (int16_t)(c->pred * q[0]);
+    }
+
+    for (int k = 1; k < 64; k++) {
+        rs = jf_huff(jd, ac);
+        if (rs < 0) {
+            return -1;
+        }
+        s = rs & 0x0F;
+        if (s == 0) {
+            if (rs != 0xF0) {
+                break;                  // EOB
+            }
+            k += 15;                    // ZRL: 16 zeros
+            continue;
+        }
+        k += rs >> 4;
+        if (k > 63) {
+            return -1;
+        }
+        if (!store || n == 1) {
+            jf_skip(jd, s);             // not kept, DC-only at 1/8
+            continue;
+        }
+        z = jf_zigzag[k];
+        if ((z & 7) < n && (z >> 3) < n) {
+            v = jf_extend(jd, s);
+            blk[z] = (int16_t)(v * q[k]);
+            has_ac = 1;
+        } else {
+            jf_skip(jd, s);
+        }
+    }
+    return has_ac;
+}
+
+// Decode the quantized coefficients of one block (no dequantization) in zigzag order,
+// zz[0] is the DC with the predictor added. Returns 0, or -1 on corrupt data.
+static int jf_block_coefs(jpg_fast_t *jd, jpg_fast_comp_t *c, int16_t *zz)
+{
+    const jpg_fast_huff_t *ac = &jd->huff[2 + c->ta];
+    int s;
+    int rs;
+
+    s = jf_huff(jd, &jd->huff[c->td]);
+    if (s < 0 || s > 15) {
+        return -1;
+    }
+    c->pred += (s != 0) ? (int16_t)jf_extend(jd, s) : 0;
+    memset(zz, 0, 64 * sizeof(int16_t));
+    zz[0] = c->pred;
+
+    for (int k = 1; k < 64; k++) {
+        rs = jf_huff(jd, ac);
+        if (rs < 0) {
+            return -1;
+        }
+        s = rs & 0x0F;
+        if (s == 0) {
+            if (rs != 0xF0) {
+                break;                  // EOB
+            }
+            k += 15;                    // ZRL: 16 zeros
+            continue;
+        }
+        k += rs >> 4;
+        if (k > 63) {
+            return -1;
+        }
+        zz[k] = (int16_t)jf_extend(jd, s);
+    }
+    return 0;
+}
+
+// 8x8 integer IDCT (LL&M, 12-bit fixed point), natural-order coefficients -> pixels, stride 16
+static void jf_idct8(const int16_t *blk, uint8_t *out)
+{
+    int32_t ws[64];
+    int32_t s0, s1, s2, s3, s4, s5, s6, s7;
+    int32_t t0, t1, t2, t3, p1, p2, p3, p4, p5, x0, x1, x2, x3;
+    const int16_t *d;
+    int32_t *w;
+
+    for (int i = 0; i < 16; i++) {
+        int col = (i < 8);              // columns first, then rows
+        int k = i & 7;
+
+        if (col) {
+            d = blk + k;
+            if (d[8] == 0 && d[16] == 0 && d[24] == 0 && d[32] == 0 && d[40] == 0 && d[48] == 0 && d[56] == 0) {
+                // no AC in this column
+                w = ws + k;
+                w[0] = w[8] = w[16] = w[24] = w[32] = w[40] = w[48] = w[56] = d[0] * 4;
+                continue;
+            }
+            s0 = d[0]; s1 = d[8]; s2 = d[16]; s3 = d[24]; s4 = d[32]; s5 = d[40]; s6 = d[48]; s7 = d[56];
+        } else {
+            w = ws + k * 8;
+            s0 = w[0]; s1 = w[1]; s2 = w[2]; s3 = w[3]; s4 = w[4]; s5 = w[5]; s6 = w[6]; s7 = w[7];
+        }
+
+        // even part
+        p1 = (s2 + s6) * JF_FIX(0.541196100);
+        t2 = p1 + s6 * JF_FIX(-1.847759065);
+        t3 = p1 + s2 * JF_FIX(0.765366865);
+        t0 = (s0 + s4) * 4096;
+        t1 = (s0 - s4) * 4096;
+        x0 = t0 + t3;
+        x3 = t0 - t3;
+        x1 = t1 + t2;
+        x2 = t1 - t2;
+
+        // odd part
+        t0 = s7;
+        t1 = s5;
+        t2 = s3;
+        t3 = s1;
+        p3 = t0 + t2;
+        p4 = t1 + t3;
+        p1 = t0 + t3;
+        p2 = t1 + t2;
+        p5 = (p3 + p4) * JF_FIX(1.175875602);
+        t0 *= JF_FIX(0.298631336);
+        t1 *= JF_FIX(2.053119869);
+        t2 *= JF_FIX(3.072711026);
+        t3 *= JF_FIX(1.501321110);
+        p1 *= JF_FIX(-0.899976223);
+        p2 *= JF_FIX(-2.562915447);
+        p3 = p5 + p3 * JF_FIX(-1.961570560);
+        p4 = p5 + p4 * JF_FIX(-0.390180644);
+        t3 += p1 + p4;
+        t2 += p2 + p3;
+        t1 += p2 + p4;
+        t0 += p1 + p3;
+
+        if (col) {
+            // drop the 12-bit fixed point, keep 2 bits of precision
+            w = ws + k;
+            x0 += 512; x1 += 512; x2 += 512; x3 += 512;
+            w[0]  = (x0 + t3) >> 10;
+            w[56] = (x0 - t3) >> 10;
+            w[8]  = (x1 + t2) >> 10;
+            w[48] = (x1 - t2) >> 10;
+            w[16] = (x2 + t1) >> 10;
+            w[40] = (x2 - t1) >> 10;
+            w[24] = (x3 + t0) >> 10;
+            w[32] = (x3 - t0) >> 10;
+        } else {
+            // 12-bit fixed point + 2 bits precision + sqrt(8) of each 1D pass = 17 bits,
+            // plus the level shift of 128
+            uint8_t *o = out + k * 16;
+            x0 += 65536 + (128 << 17); x1 += 65536 + (128 << 17);
+            x2 += 65536 + (128 << 17); x3 += 65536 + (128 << 17);
+            o[0] = jf_clamp((x0 + t3) >> 17);
+            o[7] = jf_clamp((x0 - t3) >> 17);
+            o[1] = jf_clamp((x1 + t2) >> 17);
+            o[6] = jf_clamp((x1 - t2) >> 17);
+            o[2] = jf_clamp((x2 + t1) >> 17);
+            o[5] = jf_clamp((x2 - t1) >> 17);
+            o[3] = jf_clamp((x3 + t0) >> 17);
+            o[4] = jf_clamp((x3 - t0) >> 17);
+        }
+    }
+}
+
+// n x n IDCT (n = 4 or 2) of the top-left n x n coefficients for scaled decodes, stride 16
+static void jf_idct_small(const int16_t *blk, int n, uint8_t *out)
+{
+    const int16_t *t = (n == 4) ? &jf_idct4[0][0] : &jf_idct2[0][0];
+    int32_t ws[4][4];
+    int32_t sum;
+
+    for (int v = 0; v < n; v++) {       // horizontal pass for each vertical frequency
+        for (int x = 0; x < n; x++) {
+            sum = 0;
+            for (int u = 0; u < n; u++) {
+                sum += t[x * n + u] * blk[v * 8 + u];
+            }
+            ws[v][x] = (sum + 2048) >> 12;
+        }
+    }
+
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            sum = 0;
+            for (int v = 0; v < n; v++) {
+                sum += t[y * n + v] * ws[v][x];
+            }
+            out[y * 16 + x] = jf_clamp(((sum + 2048) >> 12) + 128);
+        }
+    }
+}
+
+// Write the current block to its component plane (stride 16); has_ac is the jf_block() result
+static void jf_block_out(jpg_fast_t *jd, int has_ac, int n, uint8_t *out)
+{
+    uint8_t dc;
+
+    if (!has_ac) {
+        dc = jf_clamp(((jd->blk[0] + 4) >> 3) + 128);  // same DC gain as the 8x8 IDCT
+        for (int y = 0; y < n; y++) {
+            memset(out + y * 16, dc, n);
+        }
+    } else if (n == 8) {
+        jf_idct8(jd->blk, out);
+    } else {
+        jf_idct_small(jd->blk, n, out);
+    }
+}
+
+// Component planes of the current MCU -> RGB888 with stride w.
+// nc is the chroma block size, ow x oh the scaled MCU size, w x h the output clipped to the image.
+static void jf_color(jpg_fast_t *jd, int nc, int ow, int oh, int w, int h, bool luma_only)
+{
+    int16_t cr_r[64];
+    int16_t cbcr_g[64];
+    int16_t cb_b[64];
+    uint8_t cx[16];
+    uint8_t cy[16];
+    const uint8_t *yp;
+    uint8_t *o = jd->rgb;
+    int32_t cb;
+    int32_t cr;
+    int ci;
+
+    if (jd->ncomp == 1 || luma_only) {
+        for (int y = 0; y < h; y++) {
+            yp = jd->plane[0] + y * 16;
+            for (int x = 0; x < w; x++, o += 3) {
+                o[0] = o[1] = o[2] = yp[x];
+            }
+        }
+        return;
+    }
+
+    // colour terms once per chroma sample
+    for (int y = 0; y < nc; y++) {
+        for (int x = 0; x < nc; x++) {
+            cb = jd->plane[1][y * 16 + x] - 128;
+            cr = jd->plane[2][y * 16 + x] - 128;
+            ci = y * 8 + x;
+            cr_r[ci] = (int16_t)((91881 * cr + 32768) >> 16);                   // 1.402
+            cbcr_g[ci] = (int16_t)((22554 * cb + 46802 * cr + 32768) >> 16);   // 0.344136, 0.714136
+            cb_b[ci] = (int16_t)((116130 * cb + 32768) >> 16);                  // 1.772
+        }
+    }
+
+    // output pixel -> chroma sample, nearest neighbour
+    for (int i = 0; i < ow; i++) {
+        cx[i] = (uint8_t)(i * nc / ow);
+    }
+    for (int i = 0; i < oh; i++) {
+        cy[i] = (uint8_t)(i * nc / oh * 8);
+    }
+
+    for (int y = 0; y < h; y++) {
+        yp = jd->plane[0] + y * 16;
+        for (int x = 0; x < w; x++, o += 3) {
+            int32_t lum = yp[x];
+
+            ci = cy[y] + cx[x];
+            o[0] = jf_clamp(lum + cr_r[ci]);
+            o[1] = jf_clamp(lum - cbcr_g[ci]);
+            o[2] = jf_clamp(lum + cb_b[ci]);
+        }
+    }
+}
+
+// Restart: drop the bit buffer, skip the next RSTn marker and reset the DC predictors
+static void jf_restart(jpg_fast_t *jd)
+{
+    const uint8_t *p = jd->p;
+
+    while (p + 1 < jd->end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7)) {
+        p++;                            // corrupt data: resynchronize at the next RSTn
+    }
+
+    jd->p = (p + 1 < jd->end) ? p + 2 : jd->end;
+    jd->bitbuf = 0;
+    jd->bits = 0;
+    jd->marker = false;
+
+    for (int i = 0; i < jd->ncomp; i++) {
+        jd->comp[i].pred = 0;
+    }
+}
+
+int jpg_fast_decomp(jpg_fast_t *jd, uint8_t scale, bool luma_only, jpg_fast_out_cb cb, void *arg)
+{
+    const int n = 8 >> (scale & 3);
+    const int hmax = jd->comp[0].h;
+    const int vmax = jd->comp[0].v;
+    const int ow = hmax * n;            // scaled MCU size
+    const int oh = vmax * n;
+    // chroma block size: 1/2 and 1/4 keep the chroma resolution, 1/8 uses the DC only
+    const int nc = (n == 1) ? 1 : (ow > oh) ? ((ow > 8) ? 8 : ow) : ((oh > 8) ? 8 : oh);
+    const int out_w = jd->width >> (scale & 3);
+    const int out_h = jd->height >> (scale & 3);
+    const int mx_num = (jd->width + hmax * 8 - 1) / (hmax * 8);
+    const int my_num = (jd->height + vmax * 8 - 1) / (vmax * 8);
+    uint32_t left = jd->restart;
+    int has_ac;
+    int w;
+    int h;
+
+    for (int my = 0; my < my_num; my++) {
+        for (int mx = 0; mx < mx_num; mx++) {
+            if (jd->restart != 0) {
+                if (left == 0) {
+                    jf_restart(jd);
+                    left = jd->restart;
+                }
+                left--;
+            }
+
+            for (int c = 0; c < jd->ncomp; c++) {
+                jpg_fast_comp_t *comp = &jd->comp[c];
+                bool store = (c == 0 || !luma_only);
+                int bn = (c == 0) ? n : nc;
+
+                for (int by = 0; by < comp->v; by++) {
+                    for (int bx = 0; bx < comp->h; bx++) {
+                        has_ac = jf_block(jd, comp, bn, store);
+                        if (has_ac < 0) {
+                            return JPG_FAST_ERR;
+                        }
+                        if (store) {
+                            jf_block_out(jd, has_ac, bn, jd->plane[c] + by * bn * 16 + bx * bn);
+                        }
+                    }
+                }
+            }
+
+            w = out_w - mx * ow;
+            h = out_h - my * oh;
+            if (w <= 0 || h <= 0) {
+                continue;               // outside the image after scaling
+            }
+            w = (w > ow) ? ow : w;
+            h = (h > oh) ? oh : h;
+            jf_color(jd, nc, ow, oh, w, h, luma_only);
+
+            if (!cb(arg, (uint16_t)(mx * ow), (uint16_t)(my * oh), (uint16_t)w, (uint16_t)h, jd->rgb)) {
+                return JPG_FAST_INTR;
+            }
+        }
+    }
+    return JPG_FAST_OK;
+}
+
+int jpg_fast_coefs(jpg_fast_t *jd, jpg_fast_coef_cb cb, void *arg)
+{
+    const int mx_num = (jd->width + jd->comp[0].h * 8 - 1) / (jd->comp[0].h * 8);
+    const int my_num = (jd->height + jd->comp[0].v * 8 - 1) / (jd->comp[0].v * 8);
+    uint32_t left = jd->restart;
+
+    for (int m = 0; m < mx_num * my_num; m++) {
+        if (jd->restart != 0) {
+            if (left == 0) {
+                jf_restart(jd);
+                left = jd->restart;
+            }
+            left--;
+        }
+
+        for (int c = 0; c < jd->ncomp; c++) {
+            jpg_fast_comp_t *comp = &jd->comp[c];
+
+            for (int b = 0; b < comp->h * comp->v; b++) {
+                if (jf_block_coefs(jd, comp, jd->blk) < 0) {
+                    return JPG_FAST_ERR;
+                }
+                if (!cb(arg, (uint8_t)c, jd->blk)) {
+                    return JPG_FAST_INTR;
+                }
+            }
+        }
+    }
+    return JPG_FAST_OK;
+}
@@ -39,7 +39,7 @@ namespace jpge {
     static inline void jpge_free(void *p) { free(p); }
 
     // Various JPEG enums and tables.
-    enum { M_SOF0 = 0xC0, M_DHT = 0xC4, M_SOI = 0xD8, M_EOI = 0xD9, M_SOS = 0xDA, M_DQT = 0xDB, M_APP0 = 0xE0 };
+    enum { M_SOF0 = 0xC0, M_DHT = 0xC4, M_RST0 = 0xD0, M_SOI = 0xD8, M_EOI = 0xD9, M_SOS = 0xDA, M_DQT = 0xDB, M_DRI = 0xDD, M_APP0 = 0xE0 };
     enum { DC_LUM_CODES = 12, AC_LUM_CODES = 256, DC_CHROMA_CODES = 12, AC_CHROMA_CODES = 256, MAX_HUFF_SYMBOLS = 257, MAX_HUFF_CODESIZE = 32 };
 
     static const uint8 s_zag[64] = { 0,1,8,16,9,2,3,10,17,24,32,25,18,11,4,5,12,19,26,33,40,48,41,34,27,20,13,6,7,14,21,28,35,42,49,56,57,50,43,36,29,22,15,23,30,37,44,51,58,59,52,45,38,31,39,46,53,60,61,54,47,55,62,63 };
@@ -70,10 +70,8 @@ namespace jpge {
 
     const int YR = 19595, YG = 38470, YB = 7471, CB_R = -11059, CB_G = -21709, CB_B = 32768, CR_R = 32768, CR_G = -27439, CR_B = -5329;
 
-    static int32 m_last_quality = 0;
-    static int32 m_quantization_tables[2][64];
-
-    static bool m_huff_initialized = false;
+    // the Huffman tables are the same for every encoder; concurrent first calls write identical values
+    static volatile bool m_huff_initialized = false;
     static uint m_huff_codes[4][256];
     static uint8 m_huff_code_sizes[4][256];
     static uint8 m_huff_bits[4][17];
@@ -88,12 +86,12 @@ namespace jpge {
         return static_cast<uint8>(i);
     }
 
-    static void RGB_to_YCC(uint8* pDst, const uint8 *pSrc, int num_pixels) {
-        for ( ; num_pixels; pDst += 3, pSrc += 3, num_pixels--) {
+    static void RGB_to_YCC(uint8* pY, uint8* pCb, uint8* pCr, const uint8 *pSrc, int num_pixels) {
+        for ( ; num_pixels; pSrc += 3, num_pixels--) {
             const int r = pSrc[0], g = pSrc[1], b = pSrc[2];
-            pDst[0] = static_cast<uint8>((r * YR + g * YG + b * YB + 32768) >> 16);
-            pDst[1] = clamp(128 + ((r * CB_R + g * CB_G + b * CB_B + 32768) >> 16));
-            pDst[2] = clamp(128 + ((r * CR_R + g * CR_G + b * CR_B + 32768) >> 16));
+            *pY++ = static_cast<uint8>((r * YR + g * YG + b * YB + 32768) >> 16);
+            *pCb++ = clamp(128 + ((r * CB_R + g * CB_G + b * CB_B + 32768) >> 16));
+            *pCr++ = clamp(128 + ((r * CR_R + g * CR_G + b * CR_B + 32768) >> 16));
         }
     }
 
@@ -103,14 +101,6 @@ namespace jpge {
         }
     }
 
-    static void Y_to_YCC(uint8* pDst, const uint8* pSrc, int num_pixels) {
-        for( ; num_pixels; pDst += 3, pSrc++, num_pixels--) {
-            pDst[0] = pSrc[0];
-            pDst[1] = 128;
-            pDst[2] = 128;
-        }
-    }
-
     // Forward DCT - DCT derived from jfdctint.
     enum { CONST_BITS = 13, ROW_BITS = 2 };
 #define DCT_DESCALE(x, n) (((x) + (((int32)1) << ((n) - 1))) >> (n))
@@ -321,30 +311,38 @@ namespace jpge {
         emit_byte(0);
     }
 
-    void jpeg_encoder::load_block_8_8_grey(int x)
+    // emit restart interval
+    void jpeg_encoder::emit_dri()
     {
-        uint8 *pSrc;
-        sample_array_t *pDst = m_sample_array;
-        x <<= 3;
-        for (int i = 0; i < 8; i++, pDst += 8)
-        {
-            pSrc = m_mcu_lines[i] + x;
-            pDst[0] = pSrc[0] - 128; pDst[1] = pSrc[1] - 128; pDst[2] = pSrc[2] - 128; pDst[3] = pSrc[3] - 128;
-            pDst[4] = pSrc[4] - 128; pDst[5] = pSrc[5] - 128; pDst[6] = pSrc[6] - 128; pDst[7] = pSrc[7] - 128;
-        }
+        emit_marker(M_DRI);
+        emit_word(4);
+        emit_word(m_params.m_restart_interval);
     }
 
+    // End of a restart interval: pad the last byte with 1 bits, write RSTn and restart DC prediction
+    void jpeg_encoder::emit_restart()
+    {
+        put_bits(0x7F, 7);
+        m_bit_buffer = 0;
+        m_bits_in = 0;
+        emit_marker(M_RST0 + m_restart_num);
+        m_restart_num = (m_restart_num + 1) & 7;
+        m_restart_left = m_params.m_restart_interval;
+        memset(m_last_dc_val, 0, 3 * sizeof(m_last_dc_val[0]));
+    }
+
+    // The MCU lines are planar, so every block loads 8 contiguous samples per row.
     void jpeg_encoder::load_block_8_8(int x, int y, int c)
     {
         uint8 *pSrc;
         sample_array_t *pDst = m_sample_array;
-        x = (x * (8 * 3)) + c;
+        x = (x * 8) + c * m_image_x_mcu;
         y <<= 3;
         for (int i = 0; i < 8; i++, pDst += 8)
         {
             pSrc = m_mcu_lines[y + i] + x;
-            pDst[0] = pSrc[0 * 3] - 128; pDst[1] = pSrc[1 * 3] - 128; pDst[2] = pSrc[2 * 3] - 128; pDst[3] = pSrc[3 * 3] - 128;
-            pDst[4] = pSrc[4 * 3] - 128; pDst[5] = pSrc[5 * 3] - 128; pDst[6] = pSrc[6 * 3] - 128; pDst[7] = pSrc[7 * 3] - 128;
+            pDst[0] = pSrc[0] - 128; pDst[1] = pSrc[1] - 128; pDst[2] = pSrc[2] - 128; pDst[3] = pSrc[3] - 128;
+            pDst[4] = pSrc[4] - 128; pDst[5] = pSrc[5] - 128; pDst[6] = pSrc[6] - 128; pDst[7] = pSrc[7] - 128;
         }
     }
 
@@ -352,16 +350,16 @@ namespace jpge {
     {
         uint8 *pSrc1, *pSrc2;
         sample_array_t *pDst = m_sample_array;
-        x = (x * (16 * 3)) + c;
+        x = (x * 16) + c * m_image_x_mcu;
         int a = 0, b = 2;
         for (int i = 0; i < 16; i += 2, pDst += 8)
         {
             pSrc1 = m_mcu_lines[i + 0] + x;
             pSrc2 = m_mcu_lines[i + 1] + x;
-            pDst[0] = ((pSrc1[ 0 * 3] + pSrc1[ 1 * 3] + pSrc2[ 0 * 3] + pSrc2[ 1 * 3] + a) >> 2) - 128; pDst[1] = ((pSrc1[ 2 * 3] + pSrc1[ 3 * 3] + pSrc2[ 2 * 3] + pSrc2[ 3 * 3] + b) >> 2) - 128;
-            pDst[2] = ((pSrc1[ 4 * 3] + pSrc1[ 5 * 3] + pSrc2[ 4 * 3] + pSrc2[ 5 * 3] + a) >> 2) - 128; pDst[3] = ((pSrc1[ 6 * 3] + pSrc1[ 7 * 3] + pSrc2[ 6 * 3] + pSrc2[ 7 * 3] + b) >> 2) - 128;
-            pDst[4] = ((pSrc1[ 8 * 3] + pSrc1[ 9 * 3] + pSrc2[ 8 * 3] + pSrc2[ 9 * 3] + a) >> 2) - 128; pDst[5] = ((pSrc1[10 * 3] + pSrc1[11 * 3] + pSrc2[10 * 3] + pSrc2[11 * 3] + b) >> 2) - 128;
-            pDst[6] = ((pSrc1[12 * 3] + pSrc1[13 * 3] + pSrc2[12 * 3] + pSrc2[13 * 3] + a) >> 2) - 128; pDst[7] = ((pSrc1[14 * 3] + pSrc1[15 * 3] + pSrc2[14 * 3] + pSrc2[15 * 3] + b) >> 2) - 128;
+            pDst[0] = ((pSrc1[ 0] + pSrc1[ 1] + pSrc2[ 0] + pSrc2[ 1] + a) >> 2) - 128; pDst[1] = ((pSrc1[ 2] + pSrc1[ 3] + pSrc2[ 2] + pSrc2[ 3] + b) >> 2) - 128;
+            pDst[2] = ((pSrc1[ 4] + pSrc1[ 5] + pSrc2[ 4] + pSrc2[ 5] + a) >> 2) - 128; pDst[3] = ((pSrc1[ 6] + pSrc1[ 7] + pSrc2[ 6] + pSrc2[ 7] + b) >> 2) - 128;
+            pDst[4] = ((pSrc1[ 8] + pSrc1[ 9] + pSrc2[ 8] + pSrc2[ 9] + a) >> 2) - 128; pDst[5] = ((pSrc1[10] + pSrc1[11] + pSrc2[10] + pSrc2[11] + b) >> 2) - 128;
+            pDst[6] = ((pSrc1[12] + pSrc1[13] + pSrc2[12] + pSrc2[13] + a) >> 2) - 128; pDst[7] = ((pSrc1[14] + pSrc1[15] + pSrc2[14] + pSrc2[15] + b) >> 2) - 128;
             int temp = a; a = b; b = temp;
         }
     }
@@ -370,43 +368,49 @@ namespace jpge {
     {
         uint8 *pSrc1;
         sample_array_t *pDst = m_sample_array;
-        x = (x * (16 * 3)) + c;
+        x = (x * 16) + c * m_image_x_mcu;
         for (int i = 0; i < 8; i++, pDst += 8)
         {
             pSrc1 = m_mcu_lines[i + 0] + x;
-            pDst[0] = ((pSrc1[ 0 * 3] + pSrc1[ 1 * 3]) >> 1) - 128; pDst[1] = ((pSrc1[ 2 * 3] + pSrc1[ 3 * 3]) >> 1) - 128;
-            pDst[2] = ((pSrc1[ 4 * 3] + pSrc1[ 5 * 3]) >> 1) - 128; pDst[3] = ((pSrc1[ 6 * 3] + pSrc1[ 7 * 3]) >> 1) - 128;
-            pDst[4] = ((pSrc1[ 8 * 3] + pSrc1[ 9 * 3]) >> 1) - 128; pDst[5] = ((pSrc1[10 * 3] + pSrc1[11 * 3]) >> 1) - 128;
-            pDst[6] = ((pSrc1[12 * 3] + pSrc1[13 * 3]) >> 1) - 128; pDst[7] = ((pSrc1[14 * 3] + pSrc1[15 * 3]) >> 1) - 128;
+            pDst[0] = ((pSrc1[ 0] + pSrc1[ 1]) >> 1) - 128; pDst[1] = ((pSrc1[ 2] + pSrc1[ 3]) >> 1) - 128;
+            pDst[2] = ((pSrc1[ 4] + pSrc1[ 5]) >> 1) - 128; pDst[3] = ((pSrc1[ 6] + pSrc1[ 7]) >> 1) - 128;
+            pDst[4] = ((pSrc1[ 8] + pSrc1[ 9]) >> 1) - 128; pDst[5] = ((pSrc1[10] + pSrc1[11]) >> 1) - 128;
+            pDst[6] = ((pSrc1[12] + pSrc1[13]) >> 1) - 128; pDst[7] = ((pSrc1[14] + pSrc1[15]) >> 1) - 128;
         }
     }
 
-    void jpeg_encoder::load_quantized_coefficients(int component_num)
+    // Rounds each coefficient to the nearest multiple of its quantizer and returns the zigzag index of the
+    // last non-zero one. (j + q/2) / q is computed as ((j + q/2) * (2^31 / q + 1)) >> 31, which is exact
+    // for every q <= 255 and dividend below 2^20 (the DCT output stays far below that), so the output is
+    // the same as with a division per coefficient.
+    int jpeg_encoder::load_quantized_coefficients(int component_num)
     {
-        int32 *q = m_quantization_tables[component_num > 0];
+        const int32 *q = m_quantization_tables[component_num > 0];
+        const uint32 *r = m_quantization_recip[component_num > 0];
         int16 *pDst = m_coefficient_array;
+        int last = 0;
         for (int i = 0; i < 64; i++)
         {
             sample_array_t j = m_sample_array[s_zag[i]];
+            int16 v;
             if (j < 0)
-            {
-                if ((j = -j + (*q >> 1)) < *q)
-                    *pDst++ = 0;
-                else
-                    *pDst++ = static_cast<int16>(-(j / *q));
-            }
+                v = -static_cast<int16>(((uint64_t)(uint32)(-j + (q[i] >> 1)) * r[i]) >> 31);
             else
-            {
-                if ((j = j + (*q >> 1)) < *q)
-                    *pDst++ = 0;
-                else
-                    *pDst++ = static_cast<int16>((j / *q));
-            }
-            q++;
+                v = static_cast<int16>(((uint64_t)(uint32)(j + (q[i] >> 1)) * r[i]) >> 31);
+            pDst[i] = v;
+            if (v)
+                last = i;
         }
+        return last;
     }
 
-    void jpeg_encoder::code_coefficients_pass_two(int component_num)
+    // Bit length of a non-zero magnitude (the JPEG size category)
+    static inline int bit_length(uint v)
+    {
+        return 32 - __builtin_clz(v);
+    }
+
+    void jpeg_encoder::code_coefficients_pass_two(int component_num, int last)
     {
         int i, j, run_len, nbits, temp1, temp2;
         int16 *pSrc = m_coefficient_array;
@@ -432,16 +436,13 @@ namespace jpge {
             temp1 = -temp1; temp2--;
         }
 
-        nbits = 0;
-        while (temp1)
-        {
-            nbits++; temp1 >>= 1;
-        }
+        nbits = temp1 ? bit_length(temp1) : 0;
 
         put_bits(codes[0][nbits], code_sizes[0][nbits]);
         if (nbits) put_bits(temp2 & ((1 << nbits) - 1), nbits);
 
-        for (run_len = 0, i = 1; i < 64; i++)
+        // coefficients after the last non-zero one are all covered by the EOB code
+        for (run_len = 0, i = 1; i <= last; i++)
         {
             if ((temp1 = m_coefficient_array[i]) == 0)
                 run_len++;
@@ -457,24 +458,27 @@ namespace jpge {
                     temp1 = -temp1;
                     temp2--;
                 }
-                nbits = 1;
-                while (temp1 >>= 1)
-                    nbits++;
+                nbits = bit_length(temp1);
                 j = (run_len << 4) + nbits;
                 put_bits(codes[1][j], code_sizes[1][j]);
                 put_bits(temp2 & ((1 << nbits) - 1), nbits);
                 run_len = 0;
             }
         }
-        if (run_len)
+        if (last < 63)
             put_bits(codes[1][0], code_sizes[1][0]);
     }
 
     void jpeg_encoder::code_block(int component_num)
     {
         DCT2D(m_sample_array);
-        load_quantized_coefficients(component_num);
-        code_coefficients_pass_two(component_num);
+        code_coefficients_pass_two(component_num, load_quantized_coefficients(component_num));
+    }
+
+    inline void jpeg_encoder::end_mcu()
+    {
+        if (m_params.m_restart_interval && --m_mcus_left && !--m_restart_left)
+            emit_restart();
     }
 
     void jpeg_encoder::process_mcu_row()
@@ -483,7 +487,8 @@ namespace jpge {
         {
             for (int i = 0; i < m_mcus_per_row; i++)
             {
-                load_block_8_8_grey(i); code_block(0);
+                load_block_8_8(i, 0, 0); code_block(0);
+                end_mcu();
             }
         }
         else if ((m_comp_h_samp[0] == 1) && (m_comp_v_samp[0] == 1))
@@ -491,6 +496,7 @@ namespace jpge {
             for (int i = 0; i < m_mcus_per_row; i++)
             {
                 load_block_8_8(i, 0, 0); code_block(0); load_block_8_8(i, 0, 1); code_block(1); load_block_8_8(i, 0, 2); code_block(2);
+                end_mcu();
             }
         }
         else if ((m_comp_h_samp[0] == 2) && (m_comp_v_samp[0] == 1))
@@ -499,6 +505,7 @@ namespace jpge {
             {
                 load_block_8_8(i * 2 + 0, 0, 0); code_block(0); load_block_8_8(i * 2 + 1, 0, 0); code_block(0);
                 load_block_16_8_8(i, 1); code_block(1); load_block_16_8_8(i, 2); code_block(2);
+                end_mcu();
             }
         }
         else if ((m_comp_h_samp[0] == 2) && (m_comp_v_samp[0] == 2))
@@ -508,6 +515,7 @@ namespace jpge {
                 load_block_8_8(i * 2 + 0, 0, 0); code_block(0); load_block_8_8(i * 2 + 1, 0, 0); code_block(0);
                 load_block_8_8(i * 2 + 0, 1, 0); code_block(0); load_block_8_8(i * 2 + 1, 1, 0); code_block(0);
                 load_block_16_8(i, 1); code_block(1); load_block_16_8(i, 2); code_block(2);
+                end_mcu();
             }
         }
     }
@@ -516,32 +524,27 @@ namespace jpge {
     {
         const uint8* Psrc = reinterpret_cast<const uint8*>(pSrc);
 
-        uint8* pDst = m_mcu_lines[m_mcu_y_ofs]; // OK to write up to m_image_bpl_xlt bytes to pDst
+        uint8* pDst = m_mcu_lines[m_mcu_y_ofs]; // one plane of m_image_x_mcu bytes per component
 
         if (m_num_components == 1) {
             if (m_image_bpp == 3)
                 RGB_to_Y(pDst, Psrc, m_image_x);
             else
                 memcpy(pDst, Psrc, m_image_x);
+        } else if (m_params.m_src_ycbcr) {
+            for (int c = 0; c < 3; c++)
+                memcpy(pDst + c * m_image_x_mcu, Psrc + c * m_image_x, m_image_x);
+        } else if (m_image_bpp == 3) {
+            RGB_to_YCC(pDst, pDst + m_image_x_mcu, pDst + 2 * m_image_x_mcu, Psrc, m_image_x);
         } else {
-            if (m_image_bpp == 3)
-                RGB_to_YCC(pDst, Psrc, m_image_x);
-            else
-                Y_to_YCC(pDst, Psrc, m_image_x);
+            memcpy(pDst, Psrc, m_image_x);
+            memset(pDst + m_image_x_mcu, 128, m_image_x);
+            memset(pDst + 2 * m_image_x_mcu, 128, m_image_x);
         }
 
         // Possibly duplicate pixels at end of scanline if not a multiple of 8 or 16
-        if (m_num_components == 1)
-            memset(m_mcu_lines[m_mcu_y_ofs] + m_image_bpl_xlt, pDst[m_image_bpl_xlt - 1], m_image_x_mcu - m_image_x);
-        else
-        {
-            const uint8 y = pDst[m_image_bpl_xlt - 3 + 0], cb = pDst[m_image_bpl_xlt - 3 + 1], cr = pDst[m_image_bpl_xlt - 3 + 2];
-            uint8 *q = m_mcu_lines[m_mcu_y_ofs] + m_image_bpl_xlt;
-            for (int i = m_image_x; i < m_image_x_mcu; i++)
-            {
-                *q++ = y; *q++ = cb; *q++ = cr;
-            }
-        }
+        for (int c = 0; c < m_num_components; c++, pDst += m_image_x_mcu)
+            memset(pDst + m_image_x, pDst[m_image_x - 1], m_image_x_mcu - m_image_x);
 
         if (++m_mcu_y_ofs == m_mcu_y)
         {
@@ -551,7 +554,7 @@ namespace jpge {
     }
 
     // Quantization table generation.
-    void jpeg_encoder::compute_quant_table(int32 *pDst, const int16 *pSrc)
+    void jpeg_encoder::compute_quant_table(int32 *pDst, uint32 *pRecip, const int16 *pSrc)
     {
         int32 q;
         if (m_params.m_quality < 50)
@@ -561,12 +564,13 @@ namespace jpge {
         for (int i = 0; i < 64; i++)
         {
             int32 j = *pSrc++; j = (j * q + 50L) / 100L;
-            *pDst++ = JPGE_MIN(JPGE_MAX(j, 1), 255);
+            *pDst = JPGE_MIN(JPGE_MAX(j, 1), 255);
+            *pRecip++ = (uint32)((1ULL << 31) / *pDst++ + 1);
         }
     }
 
     // Higher-level methods.
-    bool jpeg_encoder::jpg_open(int p_x_res, int p_y_res, int src_channels)
+    bool jpeg_encoder::jpg_setup(int p_x_res, int p_y_res, int src_channels)
     {
         m_num_components = 3;
         switch (m_params.m_subsampling)
@@ -608,25 +612,26 @@ namespace jpge {
         m_image_bpl      = m_image_x * src_channels;
         m_image_x_mcu    = (m_image_x + m_mcu_x - 1) & (~(m_mcu_x - 1));
         m_image_y_mcu    = (m_image_y + m_mcu_y - 1) & (~(m_mcu_y - 1));
-        m_image_bpl_xlt  = m_image_x * m_num_components;
         m_image_bpl_mcu  = m_image_x_mcu * m_num_components;
         m_mcus_per_row   = m_image_x_mcu / m_mcu_x;
 
-        if ((m_mcu_lines[0] = static_cast<uint8*>(jpge_malloc(m_image_bpl_mcu * m_mcu_y))) == NULL) {
+        if (m_pMcu_buf) {
+            m_mcu_lines[0] = m_pMcu_buf;
+        } else if ((m_mcu_lines[0] = static_cast<uint8*>(jpge_malloc(m_image_bpl_mcu * m_mcu_y))) == NULL) {
             return false;
+        } else {
+            m_mcu_lines_owned = true;
         }
         for (int i = 1; i < m_mcu_y; i++)
             m_mcu_lines[i] = m_mcu_lines[i-1] + m_image_bpl_mcu;
 
         if(m_last_quality != m_params.m_quality){
             m_last_quality = m_params.m_quality;
-            compute_quant_table(m_quantization_tables[0], s_std_lum_quant);
-            compute_quant_table(m_quantization_tables[1], s_std_croma_quant);
+            compute_quant_table(m_quantization_tables[0], m_quantization_recip[0], s_std_lum_quant);
+            compute_quant_table(m_quantization_tables[1], m_quantization_recip[1], s_std_croma_quant);
         }
 
         if(!m_huff_initialized){
-            m_huff_initialized = true;
-
             memcpy(m_huff_bits[0+0], s_dc_lum_bits, 17);    memcpy(m_huff_val[0+0], s_dc_lum_val, DC_LUM_CODES);
             memcpy(m_huff_bits[2+0], s_ac_lum_bits, 17);    memcpy(m_huff_val[2+0], s_ac_lum_val, AC_LUM_CODES);
             memcpy(m_huff_bits[0+1], s_dc_chroma_bits, 17); memcpy(m_huff_val[0+1], s_dc_chroma_val, DC_CHROMA_CODES);
@@ -636,8 +641,26 @@ namespace jpge {
             compute_huffman_table(&m_huff_codes[2+0][0], &m_huff_code_sizes[2+0][0], m_huff_bits[2+0], m_huff_val[2+0]);
             compute_huffman_table(&m_huff_codes[0+1][0], &m_huff_code_sizes[0+1][0], m_huff_bits[0+1], m_huff_val[0+1]);
             compute_huffman_table(&m_huff_codes[2+1][0], &m_huff_code_sizes[2+1][0], m_huff_bits[2+1], m_huff_val[2+1]);
+            m_huff_initialized = true;
         }
+        return true;
+    }
 
+    bool jpeg_encoder::jpg_open()
+    {
+        // bands start on a restart boundary of whole MCU rows and all but the last end on one, see init_band()
+        uint interval = m_params.m_restart_interval;
+        uint first_mcu = (m_band_y / m_mcu_y) * m_mcus_per_row;
+        uint band_end_mcu = ((m_band_y + m_band_height) / m_mcu_y) * m_mcus_per_row;
+        if (m_band_y && (!interval || (m_band_y % m_mcu_y) || (first_mcu % interval)))
+            return false;
+        if ((m_band_y + m_band_height < m_image_y) && (!interval || (m_band_height % m_mcu_y) || (band_end_mcu % interval)))
+            return false;
+        m_mcus_left = (m_image_y_mcu / m_mcu_y) * m_mcus_per_row - first_mcu;
+        m_restart_left = interval;
+        m_restart_num = interval ? (first_mcu / interval) & 7 : 0;
+
+        m_all_stream_writes_succeeded = true;
         m_out_buf_left = JPGE_OUT_BUF_SIZE;
         m_pOut_buf = m_out_buf;
         m_bit_buffer = 0;
@@ -647,12 +670,16 @@ namespace jpge {
         memset(m_last_dc_val, 0, 3 * sizeof(m_last_dc_val[0]));
 
         // Emit all markers at beginning of image file.
-        emit_marker(M_SOI);
-        emit_jfif_app0();
-        emit_dqt();
-        emit_sof();
-        emit_dhts();
-        emit_sos();
+        if (!m_band_y && !m_params.m_scan_only) {
+            emit_marker(M_SOI);
+            emit_jfif_app0();
+            emit_dqt();
+            emit_sof();
+            emit_dhts();
+            if (interval)
+                emit_dri();
+            emit_sos();
+        }
 
         return m_all_stream_writes_succeeded;
     }
@@ -668,10 +695,16 @@ namespace jpge {
             process_mcu_row();
         }
 
-        put_bits(0x7F, 7);
-        emit_marker(M_EOI);
+        // a band that is not the last ends right after the RSTn of its last interval
+        bool last_band = (m_band_y + m_band_height >= m_image_y);
+        if (last_band) {
+            put_bits(0x7F, 7);
+            if (!m_params.m_scan_only)
+                emit_marker(M_EOI);
+        }
         flush_output_buffer();
-        m_all_stream_writes_succeeded = m_all_stream_writes_succeeded && m_pStream->put_buf(NULL, 0);
+        if (last_band)
+            m_all_stream_writes_succeeded = m_all_stream_writes_succeeded && m_pStream->put_buf(NULL, 0);
         m_pass_num++; // purposely bump up m_pass_num, for debugging
         return true;
     }
@@ -679,12 +712,15 @@ namespace jpge {
     void jpeg_encoder::clear()
     {
         m_mcu_lines[0] = NULL;
+        m_pMcu_buf = NULL;
+        m_mcu_lines_owned = false;
         m_pass_num = 0;
         m_all_stream_writes_succeeded = true;
     }
 
     jpeg_encoder::jpeg_encoder()
     {
+        m_last_quality = 0;
         clear();
     }
 
@@ -693,18 +729,37 @@ namespace jpge {
         deinit();
     }
 
-    bool jpeg_encoder::init(output_stream *pStream, int width, int height, int src_channels, const params &comp_params)
+    bool jpeg_encoder::init(output_stream *pStream, int width, int height, int src_channels, const params &comp_params, uint8 *pMcu_buf)
     {
-        deinit();
+        return init_band(pStream, width, height, src_channels, comp_params, 0, height, pMcu_buf);
+    }
+
+    bool jpeg_encoder::init_band(output_stream *pStream, int width, int height, int src_channels, const params &comp_params, int band_y, int band_height, uint8 *pMcu_buf)
+    {
+        // an encoder kept between images only redoes its setup when the setup key changed
+        bool same = m_mcu_lines[0] && (width == m_image_x) && (height == m_image_y) && (src_channels == m_image_bpp) &&
+                    (comp_params.m_quality == m_params.m_quality) && (comp_params.m_subsampling == m_params.m_subsampling) && (pMcu_buf == m_pMcu_buf);
+        if (!same)
+            deinit();
         if (((!pStream) || (width < 1) || (height < 1)) || ((src_channels != 1) && (src_channels != 3) && (src_channels != 4)) || (!comp_params.check())) return false;
+        if ((band_y < 0) || (band_y >= height) || (band_height < 1)) return false;
         m_pStream = pStream;
         m_params = comp_params;
-        return jpg_open(width, height, src_channels);
+        m_pMcu_buf = pMcu_buf;
+        m_band_y = band_y;
+        m_band_height = JPGE_MIN(band_height, height - band_y);
+        if (!same && !jpg_setup(width, height, src_channels)) {
+            deinit();
+            return false;
+        }
+        return jpg_open();
     }
 
     void jpeg_encoder::deinit()
     {
-        jpge_free(m_mcu_lines[0]);
+        if (m_mcu_lines_owned) {
+            jpge_free(m_mcu_lines[0]);
+        }
         clear();
     }
 
@@ -0,0 +1,467 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stddef.h>
+#include <string.h>
+#include <array>
+#include <type_traits>
+#include <utility>
+#include "sdkconfig.h"
+#include "pixel_conv.h"
+#include "yuv.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "esp_idf_version.h"
+// PIE registers are saved on context switch since IDF 5.2, as for ll_cam_memcpy
+#define PIXEL_CONV_PIE (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0))
+#else
+#define PIXEL_CONV_PIE 0
+#endif
+
+// Pixel conversion kernels, one per (source, destination) layout pair.
+// Each layout describes how to load and store one pixel; convert<S, D> is a straight loop with
+// no format test inside, so the compiler inlines load/store and unrolls it per pair. Callers look
+// the kernel up once per image with pixel_conv_get() and run it per line or per decoder block.
+// Adding a layout means adding a pixel_layout_t value and a layout<> specialization; every pair
+// involving it is generated. Scaling stays in the JPEG decoder, kernels only see output rows.
+
+template <pixel_layout_t L> struct layout;
+
+template <> struct layout<PIXEL_GRAY> {
+    static constexpr size_t bpp = 1;
+    static inline void load(const uint8_t *p, uint8_t &r, uint8_t &g, uint8_t &b)
+    {
+        r = g = b = p[0];
+    }
+    static inline void store(uint8_t *p, uint8_t r, uint8_t g, uint8_t b)
+    {
+        p[0] = (uint8_t)((77 * r + 150 * g + 29 * b) >> 8);  // BT.601 luma
+    }
+};
+
+template <> struct layout<PIXEL_BGR888> {
+    static constexpr size_t bpp = 3;
+    static inline void load(const uint8_t *p, uint8_t &r, uint8_t &g, uint8_t &b)
+    {
+        b = p[0];
+        g = p[1];
+        r = p[2];
+    }
+    static inline void store(uint8_t *p, uint8_t r, uint8_t g, uint8_t b)
+    {
+        p[0] = b;
+        p[1] = g;
+        p[2] = r;
+    }
+};
+
+template <> struct layout<PIXEL_RGB888> {
+    static constexpr size_t bpp = 3;
+    static inline void load(const uint8_t *p, uint8_t &r, uint8_t &g, uint8_t &b)
+    {
+        r = p[0];
+        g = p[1];
+        b = p[2];
+    }
+    static inline void store(uint8_t *p, uint8_t r, uint8_t g, uint8_t b)
+    {
+        p[0] = r;
+        p[1] = g;
+        p[2] = b;
+    }
+};
+
+template <> struct layout<PIXEL_RGB565_BE> {
+    static constexpr size_t bpp = 2;
+    static inline void load(const uint8_t *p, uint8_t &r, uint8_t &g, uint8_t &b)
+    {
+        r = p[0] & 0xF8;
+        g = (p[0] & 0x07) << 5 | (p[1] & 0xE0) >> 3;
+        b = (p[1] & 0x1F) << 3;
+    }
+    static inline void store(uint8_t *p, uint8_t r, uint8_t g, uint8_t b)
+    {
+        uint16_t c = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+        p[0] = c >> 8;
+        p[1] = c & 0xFF;
+    }
+};
+
+template <> struct layout<PIXEL_RGB565_LE> {
+    static constexpr size_t bpp = 2;
+    static inline void load(const uint8_t *p, uint8_t &r, uint8_t &g, uint8_t &b)
+    {
+        r = p[1] & 0xF8;
+        g = (p[1] & 0x07) << 5 | (p[0] & 0xE0) >> 3;
+        b = (p[0] & 0x1F) << 3;
+    }
+    static inline void store(uint8_t *p, uint8_t r, uint8_t g, uint8_t b)
+    {
+        uint16_t c = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+        p[0] = c & 0xFF;
+        p[1] = c >> 8;
+    }
+};
+
+// YUYV carries chroma per pixel pair, so it has no per-pixel load/store; convert<> handles it
+template <> struct layout<PIXEL_YUYV> {
+    static constexpr size_t bpp = 2;
+};
+
+// Planar, so no per-pixel load/store either; only written, by the ycbcr kernels below
+template <> struct layout<PIXEL_YCBCR> {
+    static constexpr size_t bpp = 3;
+};
+
+static inline uint8_t clamp_u8(int v)
+{
+    return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
+
+// Same arithmetic as jpge's RGB_to_YCC, so RGB sources encode exactly as through an RGB888 line
+static inline void rgb_to_ycbcr(uint8_t r, uint8_t g, uint8_t b, uint8_t *y, uint8_t *cb, uint8_t *cr)
+{
+    *y = (uint8_t)((r * 19595 + g * 38470 + b * 7471 + 32768) >> 16);
+    *cb = clamp_u8(128 + ((r * -11059 + g * -21709 + b * 32768 + 32768) >> 16));
+    *cr = clamp_u8(128 + ((r * 32768 + g * -27439 + b * -5329 + 32768) >> 16));
+}
+
+// Camera YUV422 is BT.601 studio range (Y 16..235, C 16..240, as yuv2rgb() assumes) and JPEG full
+// range, so YUYV -> YCbCr only stretches the range; chroma is already subsampled 2:1 horizontally.
+// The 8-bit gains are the ones the PIE kernel multiplies with, both paths give the same bytes.
+static inline uint8_t yuv_expand_y(int y)
+{
+    return clamp_u8(((y - 16) * 298) >> 8);
+}
+
+static inline uint8_t yuv_expand_c(int c)
+{
+    return clamp_u8((((c - 128) * 291) >> 8) + 128);
+}
+
+// RGB565 -> YCbCr with 7-bit coefficients, so every product and sum fits a 16-bit PIE lane; within
+// one level of rgb_to_ycbcr(). The C and PIE paths give the same bytes.
+static inline void rgb565_to_ycbcr(const uint8_t *p, uint8_t *y, uint8_t *cb, uint8_t *cr)
+{
+    int r = p[0] & 0xF8;
+    int g = (p[0] & 0x07) << 5 | (p[1] & 0xE0) >> 3;
+    int b = (p[1] & 0x1F) << 3;
+    *y = (uint8_t)((38 * r + 75 * g + 15 * b + 64) >> 7);
+    *cb = (uint8_t)(((-22 * r - 42 * g + 64 * b + 64) >> 7) + 128);
+    *cr = (uint8_t)(((64 * r - 54 * g - 10 * b + 64) >> 7) + 128);
+}
+
+#if PIXEL_CONV_PIE
+// Vector kernels for the two capture formats that get software-encoded. vld/vst ignore the low
+// address bits, so the callers below only take these with aligned buffers.
+
+// 16 pixels per iteration: 32 bytes of YUYV -> 16 bytes of Y, Cb and Cr; all pointers 16-byte aligned
+static const int16_t s_yuyv_k[] = { 16, 298, 255, 128, 291 };
+
+static void yuyv_ycbcr_pie(const uint8_t *src, uint8_t *y, uint8_t *cb, uint8_t *cr, size_t blocks)
+{
+    for (size_t i = 0; i < blocks; i++) {
+        const int16_t *k = s_yuyv_k;
+        __asm__ volatile (
+            "ee.vld.128.ip      q0, %[src], 16\n"
+            "ee.vld.128.ip      q1, %[src], 16\n"
+            "ee.vunzip.8        q0, q1\n"          // q0: Y0..Y15, q1: U0 V0 .. U7 V7
+            "ssai               8\n"
+            "ee.zero.q          q7\n"
+            "ee.vldbc.16.ip     q4, %[k], 2\n"     // 16
+            "ee.vldbc.16.ip     q5, %[k], 2\n"     // 298
+            "ee.vldbc.16.ip     q6, %[k], 2\n"     // 255
+            "ee.zero.q          q2\n"
+            "ee.vzip.8          q0, q2\n"          // 16-bit lanes: q0 Y0..Y7, q2 Y8..Y15
+            "ee.vsubs.s16       q0, q0, q4\n"
+            "ee.vsubs.s16       q2, q2, q4\n"
+            "ee.vmul.s16        q0, q0, q5\n"
+            "ee.vmul.s16        q2, q2, q5\n"
+            "ee.vmax.s16        q0, q0, q7\n"
+            "ee.vmax.s16        q2, q2, q7\n"
+            "ee.vmin.s16        q0, q0, q6\n"
+            "ee.vmin.s16        q2, q2, q6\n"
+            "ee.vunzip.8        q0, q2\n"          // q0: 16 Y bytes
+            "ee.vst.128.ip      q0, %[y], 16\n"
+            "ee.vldbc.16.ip     q4, %[k], 2\n"     // 128
+            "ee.vldbc.16.ip     q5, %[k], 2\n"     // 291
+            "ee.zero.q          q3\n"
+            "ee.vzip.8          q1, q3\n"          // 16-bit lanes: q1 U0 V0 .. U3 V3, q3 U4 V4 .. U7 V7
+            "ee.vsubs.s16       q1, q1, q4\n"
+            "ee.vsubs.s16       q3, q3, q4\n"
+            "ee.vmul.s16        q1, q1, q5\n"
+            "ee.vmul.s16        q3, q3, q5\n"
+            "ee.vadds.s16       q1, q1, q4\n"
+            "ee.vadds.s16       q3, q3, q4\n"
+            "ee.vmax.s16        q1, q1, q7\n"
+            "ee.vmax.s16        q3, q3, q7\n"
+            "ee.vmin.s16        q1, q1, q6\n"
+            "ee.vmin.s16        q3, q3, q6\n"
+            "ee.vunzip.8        q1, q3\n"          // q1: U0 V0 .. U7 V7
+            "ee.zero.q          q3\n"
+            "ee.vunzip.8        q1, q3\n"          // low halves: q1 U0..U7, q3 V0..V7
+            "ee.orq             q2, q1, q1\n"
+            "ee.vzip.8          q1, q2\n"          // U0 U0 U1 U1 .. U7 U7
+            "ee.vst.128.ip      q1, %[cb], 16\n"
+            "ee.orq             q2, q3, q3\n"
+            "ee.vzip.8          q3, q2\n"
+            "ee.vst.128.ip      q3, %[cr], 16\n"
+            : [src] "+r"(src), [y] "+r"(y), [cb] "+r"(cb), [cr] "+r"(cr), [k] "+r"(k)
+            :
+            : "memory");
+    }
+}
+
+// 8 pixels per iteration: 16 bytes of RGB565 -> 8 bytes of Y, Cb and Cr; src 16-byte, planes 8-byte aligned
+static const int16_t s_rgb565_k[] = { 0xF8, 0x1F, 8, 0x07, 32, 0xE0, 1, 38, 75, 15, -22, -42, 64, -54, -10, 64, 1, 128 };
+
+static void rgb565_ycbcr_pie(const uint8_t *src, uint8_t *y, uint8_t *cb, uint8_t *cr, size_t blocks)
+{
+    for (size_t i = 0; i < blocks; i++) {
+        const int16_t *k = s_rgb565_k;
+        __asm__ volatile (
+            "ee.vld.128.ip      q0, %[src], 16\n"
+            "ee.zero.q          q1\n"
+            "ee.vunzip.8        q0, q1\n"          // low halves: q0 RRRRRGGG, q1 GGGBBBBB bytes
+            "ee.zero.q          q2\n"
+            "ee.vzip.8          q0, q2\n"          // widen both to 16-bit lanes
+            "ee.zero.q          q2\n"
+            "ee.vzip.8          q1, q2\n"
+            "ssai               0\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // 0xf8
+            "ee.andq            q2, q0, q7\n"      // q2: R
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // 0x1f
+            "ee.andq            q3, q1, q7\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // 8
+            "ee.vmul.s16        q3, q3, q7\n"      // q3: B
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // 0x07
+            "ee.andq            q0, q0, q7\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // 32
+            "ee.vmul.s16        q0, q0, q7\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // 0xe0
+            "ee.andq            q1, q1, q7\n"
+            "ssai               3\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // 1
+            "ee.vmul.s16        q1, q1, q7\n"
+            "ee.orq             q0, q0, q1\n"      // q0: G
+            "ssai               0\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // Y = 38 R + 75 G + 15 B
+            "ee.vmul.s16        q1, q2, q7\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"
+            "ee.vmul.s16        q4, q0, q7\n"
+            "ee.vadds.s16       q1, q1, q4\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"
+            "ee.vmul.s16        q4, q3, q7\n"
+            "ee.vadds.s16       q1, q1, q4\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // Cb = -22 R - 42 G + 64 B
+            "ee.vmul.s16        q4, q2, q7\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"
+            "ee.vmul.s16        q5, q0, q7\n"
+            "ee.vadds.s16       q4, q4, q5\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"
+            "ee.vmul.s16        q5, q3, q7\n"
+            "ee.vadds.s16       q4, q4, q5\n"
+            "ee.vmul.s16        q5, q2, q7\n"      // Cr = 64 R - 54 G - 10 B
+            "ee.vldbc.16.ip     q7, %[k], 2\n"
+            "ee.vmul.s16        q6, q0, q7\n"
+            "ee.vadds.s16       q5, q5, q6\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"
+            "ee.vmul.s16        q6, q3, q7\n"
+            "ee.vadds.s16       q5, q5, q6\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // + 64, >> 7
+            "ee.vadds.s16       q1, q1, q7\n"
+            "ee.vadds.s16       q4, q4, q7\n"
+            "ee.vadds.s16       q5, q5, q7\n"
+            "ssai               7\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"
+            "ee.vmul.s16        q1, q1, q7\n"
+            "ee.vmul.s16        q4, q4, q7\n"
+            "ee.vmul.s16        q5, q5, q7\n"
+            "ee.vldbc.16.ip     q7, %[k], 2\n"     // chroma + 128
+            "ee.vadds.s16       q4, q4, q7\n"
+            "ee.vadds.s16       q5, q5, q7\n"
+            "ee.zero.q          q7\n"              // narrow to bytes, the low 64 bits hold the 8 results
+            "ee.vunzip.8        q1, q7\n"
+            "ee.vst.l.64.ip     q1, %[y], 8\n"
+            "ee.zero.q          q7\n"
+            "ee.vunzip.8        q4, q7\n"
+            "ee.vst.l.64.ip     q4, %[cb], 8\n"
+            "ee.zero.q          q7\n"
+            "ee.vunzip.8        q5, q7\n"
+            "ee.vst.l.64.ip     q5, %[cr], 8\n"
+            : [src] "+r"(src), [y] "+r"(y), [cb] "+r"(cb), [cr] "+r"(cr), [k] "+r"(k)
+            :
+            : "memory");
+    }
+}
+#endif
+
+// Kernel shapes, picked per pair by overload on a tag (the code is C++14, no if constexpr)
+struct copy_tag {};
+struct yuyv_tag {};
+struct pixel_tag {};
+struct ycbcr_tag {};
+struct yuyv_ycbcr_tag {};
+struct rgb565_ycbcr_tag {};
+
+template <pixel_layout_t S>
+using ycbcr_tag_of = typename std::conditional<S == PIXEL_YUYV, yuyv_ycbcr_tag,
+                     typename std::conditional<S == PIXEL_RGB565_BE, rgb565_ycbcr_tag, ycbcr_tag>::type>::type;
+
+template <pixel_layout_t S, pixel_layout_t D>
+using convert_tag = typename std::conditional<S == D, copy_tag,
+                    typename std::conditional<D == PIXEL_YCBCR, ycbcr_tag_of<S>,
+                    typename std::conditional<S == PIXEL_YUYV, yuyv_tag, pixel_tag>::type>::type>::type;
+
+template <pixel_layout_t S, pixel_layout_t D>
+static inline void convert(const uint8_t *src, uint8_t *dst, size_t n, copy_tag)
+{
+    memcpy(dst, src, n * layout<S>::bpp);
+}
+
+template <pixel_layout_t S, pixel_layout_t D>
+static inline void convert(const uint8_t *src, uint8_t *dst, size_t n, yuyv_tag)
+{
+    uint8_t r, g, b;
+    for (size_t i = 0; i + 1 < n; i += 2) {
+        yuv2rgb(src[0], src[1], src[3], &r, &g, &b);
+        layout<D>::store(dst, r, g, b);
+        yuv2rgb(src[2], src[1], src[3], &r, &g, &b);
+        layout<D>::store(dst + layout<D>::bpp, r, g, b);
+        src += 4;
+        dst += 2 * layout<D>::bpp;
+    }
+}
+
+template <pixel_layout_t S, pixel_layout_t D>
+static inline void convert(const uint8_t *src, uint8_t *dst, size_t n, pixel_tag)
+{
+    uint8_t r, g, b;
+    for (size_t i = 0; i < n; i++) {
+        layout<S>::load(src, r, g, b);
+        layout<D>::store(dst, r, g, b);
+        src += layout<S>::bpp;
+        dst += layout<D>::bpp;
+    }
+}
+
+template <pixel_layout_t S, pixel_layout_t D>
+static inline void convert(const uint8_t *src, uint8_t *dst, size_t n, ycbcr_tag)
+{
+    uint8_t r, g, b;
+    for (size_t i = 0; i < n; i++) {
+        layout<S>::load(src, r, g, b);
+        rgb_to_ycbcr(r, g, b, &dst[i], &dst[n + i], &dst[2 * n + i]);
+        src += layout<S>::bpp;
+    }
+}
+
+template <pixel_layout_t S, pixel_layout_t D>
+static inline void convert(const uint8_t *src, uint8_t *dst, size_t n, yuyv_ycbcr_tag)
+{
+#if PIXEL_CONV_PIE
+    if ((((uintptr_t)src | (uintptr_t)dst | n) & 15) == 0) {
+        yuyv_ycbcr_pie(src, dst, dst + n, dst + 2 * n, n / 16);
+        return;
+    }
+#endif
+    for (size_t i = 0; i + 1 < n; i += 2) {
+        dst[i] = yuv_expand_y(src[0]);
+        dst[i + 1] = yuv_expand_y(src[2]);
+        dst[n + i] = dst[n + i + 1] = yuv_expand_c(src[1]);
+        dst[2 * n + i] = dst[2 * n + i + 1] = yuv_expand_c(src[3]);
+        src += 4;
+    }
+}
+
+template <pixel_layout_t S, pixel_layout_t D>
+static inline void convert(const uint8_t *src, uint8_t *dst, size_t n, rgb565_ycbcr_tag)
+{
+#if PIXEL_CONV_PIE
+    if ((((uintptr_t)src & 15) | (((uintptr_t)dst | n) & 7)) == 0) {
+        rgb565_ycbcr_pie(src, dst, dst + n, dst + 2 * n, n / 8);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        rgb565_to_ycbcr(src, &dst[i], &dst[n + i], &dst[2 * n + i]);
+        src += 2;
+    }
+}
+
+template <pixel_layout_t S, pixel_layout_t D>
+static void convert(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    convert<S, D>(src, dst, n, convert_tag<S, D>{});
+}
+
+// no encoder to YUYV and no decoder from planar YCbCr: those pairs get no kernel (and convert<> is
+// never instantiated for them)
+template <pixel_layout_t S, pixel_layout_t D,
+          bool = ((D == PIXEL_YUYV || S == PIXEL_YCBCR) && S != D)>
+struct kernel {
+    static constexpr pixel_conv_fn get()
+    {
+        return &convert<S, D>;
+    }
+};
+
+template <pixel_layout_t S, pixel_layout_t D>
+struct kernel<S, D, true> {
+    static constexpr pixel_conv_fn get()
+    {
+        return nullptr;
+    }
+};
+
+template <size_t... I>
+static constexpr std::array<pixel_conv_fn, sizeof...(I)> kernel_table(std::index_sequence<I...>)
+{
+    return {{ kernel<(pixel_layout_t)(I / PIXEL_LAYOUT_MAX), (pixel_layout_t)(I % PIXEL_LAYOUT_MAX)>::get()... }};
+}
+
+static constexpr auto s_kernels = kernel_table(std::make_index_sequence<PIXEL_LAYOUT_MAX * PIXEL_LAYOUT_MAX>{});
+
+pixel_conv_fn pixel_conv_get(pixel_layout_t src, pixel_layout_t dst)
+{
+    if (src >= PIXEL_LAYOUT_MAX || dst >= PIXEL_LAYOUT_MAX) {
+        return NULL;
+    }
+    return s_kernels[src * PIXEL_LAYOUT_MAX + dst];
+}
+
+pixel_layout_t pixel_layout_of(pixformat_t format)
+{
+    switch (format) {
+    case PIXFORMAT_GRAYSCALE:
+        return PIXEL_GRAY;
+    case PIXFORMAT_RGB888:
+        return PIXEL_BGR888;
+    case PIXFORMAT_RGB565:
+        return PIXEL_RGB565_BE;
+    case PIXFORMAT_YUV422:
+        return PIXEL_YUYV;
+    default:
+        return PIXEL_LAYOUT_MAX;
+    }
+}
+
+size_t pixel_layout_bpp(pixel_layout_t l)
+{
+    static constexpr size_t bpp[PIXEL_LAYOUT_MAX] = {
+        layout<PIXEL_GRAY>::bpp, layout<PIXEL_BGR888>::bpp, layout<PIXEL_RGB888>::bpp,
+        layout<PIXEL_RGB565_BE>::bpp, layout<PIXEL_RGB565_LE>::bpp, layout<PIXEL_YUYV>::bpp,
+        layout<PIXEL_YCBCR>::bpp,
+    };
+    return (l < PIXEL_LAYOUT_MAX) ? bpp[l] : 0;
+}
@@ -18,7 +18,7 @@ namespace jpge
 
     // JPEG compression parameters structure.
     struct params {
-            inline params() : m_quality(85), m_subsampling(H2V2) { }
+            inline params() : m_quality(85), m_subsampling(H2V2), m_src_ycbcr(false), m_restart_interval(0), m_scan_only(false) { }
 
             inline bool check() const {
                 if ((m_quality < 1) || (m_quality > 100)) {
@@ -27,6 +27,9 @@ namespace jpge
                 if ((uint)m_subsampling > (uint)H2V2) {
                     return false;
                 }
+                if ((m_restart_interval < 0) || (m_restart_interval > 0xFFFF)) {
+                    return false;
+                }
                 return true;
             }
 
@@ -39,6 +42,18 @@ namespace jpge
             // 2 = H2V1 subsampling (YCbCr 2x1x1, 4 blocks per MCU)
             // 3 = H2V2 subsampling (YCbCr 4x1x1, 6 blocks per MCU-- very common)
             subsampling_t m_subsampling;
+
+            // Source scanlines hold a Y, a Cb and a Cr plane of width bytes each (src_channels 3, JFIF
+            // full range) instead of interleaved RGB, so the encoder does no colour conversion.
+            bool m_src_ycbcr;
+
+            // MCUs per restart interval, 0 for none. A DRI segment is written and every interval but the
+            // last ends with an RSTn marker, after which the DC predictors start again from zero.
+            int m_restart_interval;
+
+            // Write only the entropy-coded data (with its RSTn markers): no headers and no EOI, for
+            // transports that carry the tables and image size out of band such as RTP/JPEG (RFC 2435).
+            bool m_scan_only;
     };
     
     // Output stream abstract class - used by the jpeg_encoder class to write to the output stream.
@@ -61,8 +76,28 @@ namespace jpge
             // params - Compression parameters structure, defined above.
             // width, height  - Image dimensions.
             // channels - May be 1, or 3. 1 indicates grayscale, 3 indicates RGB source data.
+            // pMcu_buf - Optional caller-owned buffer of at least mcu_buf_size() bytes for the MCU rows,
+            //            kept until deinit(). NULL allocates it here.
             // Returns false on out of memory or if a stream write fails.
-            bool init(output_stream *pStream, int width, int height, int src_channels, const params &comp_params = params());
+            bool init(output_stream *pStream, int width, int height, int src_channels, const params &comp_params = params(), uint8 *pMcu_buf = 0);
+
+            // Initializes the compressor for the band_height scanlines from band_y of a width x height image,
+            // so that bands can be encoded independently (e.g. on different cores). Only the first band
+            // writes the headers and only the last one EOI, so the outputs of consecutive bands joined in
+            // order are the image init() would give with the same params (only the last band signals the end
+            // with put_buf(NULL, 0)). A band has to start and, unless it is the last, end on a restart
+            // interval boundary of whole MCU rows.
+            // An encoder that is kept and initialized again for the same width, height, src_channels, quality,
+            // subsampling and pMcu_buf keeps its layout, quantization tables and MCU rows, so encoding a
+            // stream of frames does no setup and no allocation after the first one.
+            bool init_band(output_stream *pStream, int width, int height, int src_channels, const params &comp_params, int band_y, int band_height, uint8 *pMcu_buf = 0);
+
+            // MCU size of a subsampling; bands and restart intervals are counted in these.
+            static int mcu_width(subsampling_t subsampling) { return (subsampling >= H2V1) ? 16 : 8; }
+            static int mcu_height(subsampling_t subsampling) { return (subsampling == H2V2) ? 16 : 8; }
+
+            // Size of the MCU row buffer init() needs for an image of this width (upper bound over all subsamplings).
+            static uint mcu_buf_size(int width, int src_channels) { return ((width + 15) & ~15) * ((src_channels == 1) ? 1 : 3) * 16; }
 
             // Call this method with each source scanline.
             // width * src_channels bytes per scanline is expected (RGB or Y format).
@@ -86,14 +121,23 @@ namespace jpge
             uint8 m_comp_h_samp[3], m_comp_v_samp[3];
             int m_image_x, m_image_y, m_image_bpp, m_image_bpl;
             int m_image_x_mcu, m_image_y_mcu;
-            int m_image_bpl_xlt, m_image_bpl_mcu;
+            int m_image_bpl_mcu;
             int m_mcus_per_row;
             int m_mcu_x, m_mcu_y;
+            int m_band_y, m_band_height;
+            uint m_mcus_left, m_restart_left;
+            uint8 m_restart_num;
             uint8 *m_mcu_lines[16];
+            uint8 *m_pMcu_buf;
+            bool m_mcu_lines_owned;
             uint8 m_mcu_y_ofs;
             sample_array_t m_sample_array[64];
             int16 m_coefficient_array[64];
 
+            int m_last_quality;
+            int32 m_quantization_tables[2][64];
+            uint32 m_quantization_recip[2][64];  // 2^31 / q + 1, see load_quantized_coefficients()
+
             int m_last_dc_val[3];
             uint8 m_out_buf[JPGE_OUT_BUF_SIZE];
             uint8 *m_pOut_buf;
@@ -103,7 +147,8 @@ namespace jpge
             uint8 m_pass_num;
             bool m_all_stream_writes_succeeded;
 
-            bool jpg_open(int p_x_res, int p_y_res, int src_channels);
+            bool jpg_setup(int p_x_res, int p_y_res, int src_channels);
+            bool jpg_open();
 
             void flush_output_buffer();
             void put_bits(uint bits, uint len);
@@ -118,17 +163,19 @@ namespace jpge
             void emit_dht(uint8 *bits, uint8 *val, int index, bool ac_flag);
             void emit_dhts();
             void emit_sos();
+            void emit_dri();
+            void emit_restart();
 
-            void compute_quant_table(int32 *dst, const int16 *src);
-            void load_quantized_coefficients(int component_num);
+            void compute_quant_table(int32 *dst, uint32 *recip, const int16 *src);
+            int load_quantized_coefficients(int component_num);
 
-            void load_block_8_8_grey(int x);
             void load_block_8_8(int x, int y, int c);
             void load_block_16_8(int x, int c);
             void load_block_16_8_8(int x, int c);
 
-            void code_coefficients_pass_two(int component_num);
+            void code_coefficients_pass_two(int component_num, int last);
             void code_block(int component_num);
+            void end_mcu();
 
             void process_mcu_row();
             bool process_end_of_image();
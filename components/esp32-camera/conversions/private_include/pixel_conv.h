@@ -0,0 +1,53 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef _CONVERSIONS_PIXEL_CONV_H_
+#define _CONVERSIONS_PIXEL_CONV_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sensor.h"
+
+// Byte layouts the converters read and write
+typedef enum {
+    PIXEL_GRAY,         // 1 byte luma
+    PIXEL_BGR888,       // B, G, R: camera RGB888 frames and BMP pixel data
+    PIXEL_RGB888,       // R, G, B: JPEG encoder input and decoder output
+    PIXEL_RGB565_BE,    // RRRRRGGG GGGBBBBB: camera RGB565 frames
+    PIXEL_RGB565_LE,    // GGGBBBBB RRRRRGGG: jpg2rgb565() output
+    PIXEL_YUYV,         // Y0, U, Y1, V: camera YUV422 frames, width must be even
+    PIXEL_YCBCR,        // Y, Cb, Cr planes of n bytes each (JFIF full range): JPEG encoder input, destination only
+    PIXEL_LAYOUT_MAX,
+} pixel_layout_t;
+
+// Converts n pixels from src to dst; the buffers must not overlap
+typedef void (*pixel_conv_fn)(const uint8_t *src, uint8_t *dst, size_t n);
+
+// Kernel for one (source, destination) pair, looked up once per image; NULL if the pair is unsupported
+pixel_conv_fn pixel_conv_get(pixel_layout_t src, pixel_layout_t dst);
+
+// Layout of a camera frame format, PIXEL_LAYOUT_MAX for JPEG and formats without a kernel
+pixel_layout_t pixel_layout_of(pixformat_t format);
+
+// Bytes per pixel of a layout (YUYV: 2, averaged over a pixel pair; YCBCR: 3, over the three planes)
+size_t pixel_layout_bpp(pixel_layout_t layout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CONVERSIONS_PIXEL_CONV_H_ */
@@ -0,0 +1,484 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stddef.h>
+#include <string.h>
+#include "img_converters.h"
+#include "soc/efuse_reg.h"
+#include "esp_heap_caps.h"
+#include "pixel_conv.h"
+#include "sdkconfig.h"
+#include "esp_jpg_decode.h"
+
+#include "esp_system.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "to_bmp";
+#endif
+
+static const int BMP_HEADER_LEN = 54;
+
+typedef struct {
+    uint32_t filesize;
+    uint32_t reserved;
+    uint32_t fileoffset_to_pixelarray;
+    uint32_t dibheadersize;
+    int32_t width;
+    int32_t height;
+    uint16_t planes;
+    uint16_t bitsperpixel;
+    uint32_t compression;
+    uint32_t imagesize;
+    uint32_t ypixelpermeter;
+    uint32_t xpixelpermeter;
+    uint32_t numcolorspallette;
+    uint32_t mostimpcolor;
+} bmp_header_t;
+
+typedef struct {
+        uint16_t width;
+        uint16_t height;
+        uint16_t data_offset;
+        uint8_t out_bpp;
+        pixel_conv_fn convert;  // decoder RGB888 block rows to the output layout
+        uint8_t *output;
+        size_t output_size;     // capacity of output, 0 if the caller sized it from the image already
+} rgb_jpg_decoder;
+
+static void *_malloc(size_t size)
+{
+    // check if SPIRAM is enabled and allocate on SPIRAM if allocatable
+#if (CONFIG_SPIRAM_SUPPORT && (CONFIG_SPIRAM_USE_CAPS_ALLOC || CONFIG_SPIRAM_USE_MALLOC))
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    // try allocating in internal memory
+    return malloc(size);
+}
+
+//output buffer and image width
+static bool _rgb_write(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    rgb_jpg_decoder * jpeg = (rgb_jpg_decoder *)arg;
+    if(!data){
+        if(x == 0 && y == 0){
+            //write start
+            jpeg->width = w;
+            jpeg->height = h;
+            if(jpeg->output_size && (size_t)w * h * jpeg->out_bpp + jpeg->data_offset > jpeg->output_size){
+                ESP_LOGE(TAG, "Output buffer too small: %u < %u", jpeg->output_size, (size_t)w * h * jpeg->out_bpp + jpeg->data_offset);
+                return false;
+            }
+        } else {
+            //write end
+        }
+        return true;
+    }
+
+    size_t jw = jpeg->width * jpeg->out_bpp;
+    uint8_t *o = jpeg->output + jpeg->data_offset + y * jw + x * jpeg->out_bpp;
+
+    for(uint16_t iy=0; iy<h; iy++) {
+        jpeg->convert(data, o, w);
+        o += jw;
+        data += w * 3;
+    }
+    return true;
+}
+
+static bool jpg2rgb888(const uint8_t *src, size_t src_len, uint8_t * out, jpg_scale_t scale)
+{
+    rgb_jpg_decoder jpeg;
+    jpeg.width = 0;
+    jpeg.height = 0;
+    jpeg.output = out;
+    jpeg.output_size = 0;
+    jpeg.data_offset = 0;
+    jpeg.out_bpp = 3;
+    jpeg.convert = pixel_conv_get(PIXEL_RGB888, PIXEL_BGR888);
+
+    if(esp_jpg_decode_buf(NULL, src, src_len, scale, false, _rgb_write, (void*)&jpeg) != ESP_OK){
+        return false;
+    }
+    return true;
+}
+
+bool jpg2rgb565(const uint8_t *src, size_t src_len, uint8_t * out, jpg_scale_t scale)
+{
+    rgb_jpg_decoder jpeg;
+    jpeg.width = 0;
+    jpeg.height = 0;
+    jpeg.output = out;
+    jpeg.output_size = 0;
+    jpeg.data_offset = 0;
+    jpeg.out_bpp = 2;
+    jpeg.convert = pixel_conv_get(PIXEL_RGB888, PIXEL_RGB565_LE);
+
+    if(esp_jpg_decode_buf(NULL, src, src_len, scale, false, _rgb_write, (void*)&jpeg) != ESP_OK){
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+        jpg_strip_t strip;      // current strip
+        uint16_t strip_lines;
+        uint8_t out_bpp;
+        pixel_conv_fn convert;  // decoder RGB888 block rows to the strip format
+        size_t buf_size;
+        jpg_strip_cb cb;
+        void *arg;
+        bool stopped;           // the callback ended the decode
+} jpg_strip_decoder;
+
+static const pixel_layout_t strip_layout[] = {
+    [JPG_STRIP_GRAY] = PIXEL_GRAY,
+    [JPG_STRIP_RGB565] = PIXEL_RGB565_LE,
+    [JPG_STRIP_RGB565_BE] = PIXEL_RGB565_BE,
+    [JPG_STRIP_RGB888] = PIXEL_RGB888,
+};
+
+size_t jpg_strip_bpp(jpg_strip_format_t format)
+{
+    return (format <= JPG_STRIP_RGB888) ? pixel_layout_bpp(strip_layout[format]) : 0;
+}
+
+//hand the current strip to the callback
+static bool _strip_flush(jpg_strip_decoder * jpeg)
+{
+    jpg_strip_t * strip = &jpeg->strip;
+    strip->lines = strip->height - strip->y;
+    if(strip->lines > jpeg->strip_lines) {
+        strip->lines = jpeg->strip_lines;
+    }
+    if(!strip->lines || !jpeg->cb) {
+        return true;
+    }
+    if(!jpeg->cb(jpeg->arg, strip) || !strip->data) {
+        jpeg->stopped = true;
+        return false;
+    }
+    return true;
+}
+
+static bool _strip_write(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    jpg_strip_decoder * jpeg = (jpg_strip_decoder *)arg;
+    jpg_strip_t * strip = &jpeg->strip;
+    if(!data){
+        if(x == 0 && y == 0){
+            //write start
+            strip->width = w;
+            strip->height = h;
+            strip->y = 0;
+            if(!jpeg->strip_lines) {
+                jpeg->strip_lines = h;
+            }
+            if((size_t)w * jpeg->strip_lines * jpeg->out_bpp > jpeg->buf_size){
+                ESP_LOGE(TAG, "Strip buffer too small: %u < %u", jpeg->buf_size, (size_t)w * jpeg->strip_lines * jpeg->out_bpp);
+                return false;
+            }
+            return true;
+        }
+        //write end, the last strip
+        return jpeg->stopped || _strip_flush(jpeg);
+    }
+
+    if(y >= strip->y + jpeg->strip_lines) {
+        //next strip
+        if(!_strip_flush(jpeg)) {
+            return false;
+        }
+        strip->y = y - (y % jpeg->strip_lines);
+    }
+    if(y + h > strip->y + jpeg->strip_lines) {
+        ESP_LOGE(TAG, "Strip height %u is not a multiple of the MCU height", jpeg->strip_lines);
+        return false;
+    }
+
+    //stay inside the strip even if a block reaches past the image edge
+    size_t stride = w * 3;
+    size_t jw = (size_t)strip->width * jpeg->out_bpp;
+    uint8_t *o = strip->data + (y - strip->y) * jw + x * jpeg->out_bpp;
+    if(x >= strip->width || y >= strip->height) {
+        return true;
+    }
+    w = (x + w > strip->width) ? strip->width - x : w;
+    h = (y + h > strip->height) ? strip->height - y : h;
+    for(uint16_t iy=0; iy<h; iy++) {
+        jpeg->convert(data, o, w);
+        o += jw;
+        data += stride;
+    }
+    return true;
+}
+
+bool jpg2strips(esp_jpg_dec_t *dec, const uint8_t *src, size_t src_len, jpg_scale_t scale, jpg_strip_format_t format,
+                uint8_t *buf, size_t buf_size, uint16_t strip_lines, jpg_strip_cb cb, void *arg)
+{
+    if(!buf || format > JPG_STRIP_RGB888 || (!cb && strip_lines)) {
+        return false;
+    }
+
+    jpg_strip_decoder jpeg;
+    memset(&jpeg, 0, sizeof(jpeg));
+    jpeg.strip.data = buf;
+    jpeg.strip_lines = strip_lines;
+    jpeg.out_bpp = jpg_strip_bpp(format);
+    jpeg.convert = pixel_conv_get(PIXEL_RGB888, strip_layout[format]);
+    jpeg.buf_size = buf_size;
+    jpeg.cb = cb;
+    jpeg.arg = arg;
+
+    //a stop requested by the callback ends the decode with ESP_FAIL
+    if(esp_jpg_decode_buf(dec, src, src_len, scale, format == JPG_STRIP_GRAY, _strip_write, (void*)&jpeg) != ESP_OK){
+        return jpeg.stopped;
+    }
+    return true;
+}
+
+//whole-image strip of jpg2thumb(): keep the size
+static bool _thumb_done(void * arg, jpg_strip_t *strip)
+{
+    uint16_t *size = (uint16_t *)arg;
+    size[0] = strip->width;
+    size[1] = strip->height;
+    return true;
+}
+
+bool jpg2thumb(esp_jpg_dec_t *dec, const uint8_t *src, size_t src_len, jpg_strip_format_t format,
+               uint8_t *out, size_t out_size, uint16_t *width, uint16_t *height)
+{
+    uint16_t size[2] = {0, 0};
+
+    //at 1/8 both decoders keep only the DC term of each block
+    if(!jpg2strips(dec, src, src_len, JPG_SCALE_8X, format, out, out_size, 0, _thumb_done, size)) {
+        return false;
+    }
+    if(width) {
+        *width = size[0];
+    }
+    if(height) {
+        *height = size[1];
+    }
+    return true;
+}
+
+//BMP file and info header, followed by the palette (palette_size bytes) and the pixels
+static void _bmp_header(uint8_t *buf, uint16_t width, uint16_t height, int bpp, int palette_size)
+{
+    size_t image_size = (size_t)width * height * bpp;
+
+    buf[0] = 'B';
+    buf[1] = 'M';
+    bmp_header_t * bitmap  = (bmp_header_t*)&buf[2];
+    bitmap->reserved = 0;
+    bitmap->filesize = image_size + BMP_HEADER_LEN + palette_size;
+    bitmap->fileoffset_to_pixelarray = BMP_HEADER_LEN + palette_size;
+    bitmap->dibheadersize = 40;
+    bitmap->width = width;
+    bitmap->height = -height;//set negative for top to bottom
+    bitmap->planes = 1;
+    bitmap->bitsperpixel = bpp * 8;
+    bitmap->compression = 0;
+    bitmap->imagesize = image_size;
+    bitmap->ypixelpermeter = 0x0B13 ; //2835 , 72 DPI
+    bitmap->xpixelpermeter = 0x0B13 ; //2835 , 72 DPI
+    bitmap->numcolorspallette = 0;
+    bitmap->mostimpcolor = 0;
+}
+
+//image size from the first SOFn marker, without decoding
+static bool _jpg_dimensions(const uint8_t *src, size_t src_len, uint16_t *width, uint16_t *height)
+{
+    if(src_len < 4 || src[0] != 0xFF || src[1] != 0xD8) {
+        return false;
+    }
+    size_t i = 2;
+    while(i + 9 <= src_len) {
+        if(src[i] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = src[i + 1];
+        if(marker == 0xFF) {
+            //fill byte
+            i++;
+            continue;
+        }
+        if(marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            *height = (src[i + 5] << 8) | src[i + 6];
+            *width = (src[i + 7] << 8) | src[i + 8];
+            return *width && *height;
+        }
+        if(marker == 0xD9 || marker == 0xDA) {
+            //end of image or scan data before any frame header
+            return false;
+        }
+        i += 2 + ((src[i + 2] << 8) | src[i + 3]);
+    }
+    return false;
+}
+
+size_t jpg2bmp_size(const uint8_t *src, size_t src_len)
+{
+    uint16_t width, height;
+    if(!_jpg_dimensions(src, src_len, &width, &height)) {
+        return 0;
+    }
+    return (size_t)width * height * 3 + BMP_HEADER_LEN;
+}
+
+bool jpg2bmp_buf(const uint8_t *src, size_t src_len, uint8_t *out, size_t out_size, size_t *out_len)
+{
+    rgb_jpg_decoder jpeg;
+    jpeg.width = 0;
+    jpeg.height = 0;
+    jpeg.output = out;
+    jpeg.output_size = out_size;
+    jpeg.data_offset = BMP_HEADER_LEN;
+    jpeg.out_bpp = 3;
+    jpeg.convert = pixel_conv_get(PIXEL_RGB888, PIXEL_BGR888);
+
+    if(out_size < BMP_HEADER_LEN || esp_jpg_decode_buf(NULL, src, src_len, JPG_SCALE_NONE, false, _rgb_write, (void*)&jpeg) != ESP_OK){
+        return false;
+    }
+
+    _bmp_header(out, jpeg.width, jpeg.height, 3, 0);
+    *out_len = (size_t)jpeg.width * jpeg.height * 3 + BMP_HEADER_LEN;
+    return true;
+}
+
+bool jpg2bmp(const uint8_t *src, size_t src_len, uint8_t ** out, size_t * out_len)
+{
+    size_t out_size = jpg2bmp_size(src, src_len);
+    if(!out_size) {
+        ESP_LOGE(TAG, "JPEG frame header not found");
+        return false;
+    }
+    uint8_t * out_buf = (uint8_t *)_malloc(out_size);
+    if(!out_buf) {
+        ESP_LOGE(TAG, "_malloc failed! %u", out_size);
+        return false;
+    }
+    if(!jpg2bmp_buf(src, src_len, out_buf, out_size, out_len)) {
+        free(out_buf);
+        return false;
+    }
+    *out = out_buf;
+    return true;
+}
+
+bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint8_t * rgb_buf)
+{
+    if(format == PIXFORMAT_JPEG) {
+        return jpg2rgb888(src_buf, src_len, rgb_buf, JPG_SCALE_NONE);
+    }
+    pixel_layout_t layout = pixel_layout_of(format);
+    pixel_conv_fn convert = pixel_conv_get(layout, PIXEL_BGR888);
+    if(convert) {
+        convert(src_buf, rgb_buf, src_len / pixel_layout_bpp(layout));
+    }
+    return true;
+}
+
+// With BMP, 8-bit greyscale requires a palette.
+// For a 640x480 image though, that's a savings
+// over going RGB-24.
+#define BMP_BPP(format)             (((format) == PIXFORMAT_GRAYSCALE) ? 1 : 3)
+#define BMP_PALETTE_SIZE(format)    (((format) == PIXFORMAT_GRAYSCALE) ? 4 * 256 : 0)
+
+size_t fmt2bmp_size(uint16_t width, uint16_t height, pixformat_t format)
+{
+    if(format == PIXFORMAT_JPEG) {
+        return 0;
+    }
+    return (size_t)width * height * BMP_BPP(format) + BMP_HEADER_LEN + BMP_PALETTE_SIZE(format);
+}
+
+bool fmt2bmp_buf(const uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t *out, size_t out_size, size_t *out_len)
+{
+    if(format == PIXFORMAT_JPEG) {
+        return jpg2bmp_buf(src, src_len, out, out_size, out_len);
+    }
+
+    size_t needed = fmt2bmp_size(width, height, format);
+    if(out_size < needed) {
+        ESP_LOGE(TAG, "Output buffer too small: %u < %u", out_size, needed);
+        return false;
+    }
+
+    int bpp = BMP_BPP(format);
+    int palette_size = BMP_PALETTE_SIZE(format);
+    _bmp_header(out, width, height, bpp, palette_size);
+
+    uint8_t * palette_buf = out + BMP_HEADER_LEN;
+    uint8_t * pix_buf = palette_buf + palette_size;
+
+    if (palette_size > 0) {
+        // Grayscale palette
+        for (int i = 0; i < 256; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                *palette_buf = i;
+                palette_buf++;
+            }
+            // Reserved / alpha channel.
+            *palette_buf = 0;
+            palette_buf++;
+        }
+    }
+
+    //convert data to RGB888, greyscale stays 8-bit
+    pixel_conv_fn convert = pixel_conv_get(pixel_layout_of(format), (bpp == 1) ? PIXEL_GRAY : PIXEL_BGR888);
+    if(convert) {
+        convert(src, pix_buf, width * height);
+    }
+    *out_len = needed;
+    return true;
+}
+
+bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t ** out, size_t * out_len)
+{
+    if(format == PIXFORMAT_JPEG) {
+        return jpg2bmp(src, src_len, out, out_len);
+    }
+
+    *out = NULL;
+    *out_len = 0;
+
+    size_t out_size = fmt2bmp_size(width, height, format);
+    uint8_t * out_buf = (uint8_t *)_malloc(out_size);
+    if(!out_buf) {
+        ESP_LOGE(TAG, "_malloc failed! %u", out_size);
+        return false;
+    }
+    fmt2bmp_buf(src, src_len, width, height, format, out_buf, out_size, out_len);
+    *out = out_buf;
+    return true;
+}
+
+bool fmt2bmp_arena(const uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, img_arena_t *arena, size_t *out_len)
+{
+    size_t out_size = (format == PIXFORMAT_JPEG) ? jpg2bmp_size(src, src_len) : fmt2bmp_size(width, height, format);
+    if(!out_size || !img_arena_reserve(arena, out_size, 0)) {
+        return false;
+    }
+    return fmt2bmp_buf(src, src_len, width, height, format, arena->buf, arena->size, out_len);
+}
+
+bool frame2bmp(camera_fb_t * fb, uint8_t ** out, size_t * out_len)
+{
+    return fmt2bmp(fb->buf, fb->len, fb->width, fb->height, fb->format, out, out_len);
+}
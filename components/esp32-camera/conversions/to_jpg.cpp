@@ -0,0 +1,669 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include <atomic>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "soc/efuse_reg.h"
+#include "esp_heap_caps.h"
+#include "esp_camera.h"
+#include "img_converters.h"
+#include "camera_prof.h"
+#include "jpge.h"
+#include "pixel_conv.h"
+
+#if CONFIG_CAMERA_JPEG_DUAL_CORE
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char* TAG = "to_jpg";
+#endif
+
+static void *_malloc(size_t size)
+{
+    void * res = malloc(size);
+    if(res) {
+        return res;
+    }
+
+    // check if SPIRAM is enabled and is allocatable
+#if (CONFIG_SPIRAM_SUPPORT && (CONFIG_SPIRAM_USE_CAPS_ALLOC || CONFIG_SPIRAM_USE_MALLOC))
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    return NULL;
+}
+
+// the scan line is 16-byte aligned for the S3 vector kernels in pixel_conv.cpp
+#define JPG_LINE_ALIGN 16
+
+static inline size_t jpg_line_size(uint16_t width, int num_channels)
+{
+    return (width * num_channels + JPG_LINE_ALIGN - 1) & ~(JPG_LINE_ALIGN - 1);
+}
+
+// Feeds rows [y0, y1) of the frame to an encoder set up for them and finishes it
+static bool encode_rows(jpge::jpeg_encoder &enc, pixel_conv_fn convert_line, const uint8_t *src, size_t src_stride, uint16_t width, int y0, int y1, uint8_t *line)
+{
+    for (int i = y0; i < y1; i++) {
+        convert_line(src + i * src_stride, line, width);
+        if (!enc.process_scanline(line)) {
+            ESP_LOGE(TAG, "JPG process line %u failed", i);
+            return false;
+        }
+    }
+    if (!enc.process_scanline(NULL)) {
+        ESP_LOGE(TAG, "JPG image finish failed");
+        return false;
+    }
+    return true;
+}
+
+// Dual-core encoding: the frame is split at the middle MCU row into two bands with a restart marker
+// between them. The calling task encodes the upper band straight into the output stream while a
+// worker task on the other core encodes the lower band into a buffer kept between frames, which is
+// appended afterwards. jpge writes the headers only for the first band and EOI only for the last, so
+// the two outputs join without re-encoding. When another task holds the worker both bands are
+// encoded on the calling core, so the restart interval only depends on the image size.
+
+// Returns the first row of the lower band and sets the restart interval to the upper band,
+// height if the frame is not split.
+static int jpg_band_split(uint16_t width, uint16_t height, jpge::params *params)
+{
+#if CONFIG_CAMERA_JPEG_DUAL_CORE
+    int mcu_w = jpge::jpeg_encoder::mcu_width(params->m_subsampling);
+    int mcu_h = jpge::jpeg_encoder::mcu_height(params->m_subsampling);
+    int rows = (height + mcu_h - 1) / mcu_h;
+    int upper = (rows + 1) / 2;
+    int interval = upper * ((width + mcu_w - 1) / mcu_w);
+    if (rows < 2 || interval > 0xFFFF) {
+        return height;
+    }
+    params->m_restart_interval = interval;
+    return upper * mcu_h;
+#else
+    return height;
+#endif
+}
+
+#if CONFIG_CAMERA_JPEG_DUAL_CORE
+
+#define JPG_WORKER_STACK 4096
+
+// the band output is written once and copied once, SPIRAM is fine when available
+static void *_realloc_out(void *ptr, size_t size)
+{
+#if (CONFIG_SPIRAM_SUPPORT && (CONFIG_SPIRAM_USE_CAPS_ALLOC || CONFIG_SPIRAM_USE_MALLOC))
+    return heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    return realloc(ptr, size);
+}
+
+// grows to the largest lower band seen and is reused for the following frames
+class band_stream : public jpge::output_stream {
+protected:
+    uint8_t *out_buf;
+    size_t max_len, index;
+
+public:
+    band_stream() : out_buf(NULL), max_len(0), index(0) { }
+    virtual ~band_stream() { }
+
+    virtual bool put_buf(const void* pBuf, int len)
+    {
+        if (!pBuf) {
+            //end of image
+            return true;
+        }
+        if ((size_t)len > (max_len - index)) {
+            size_t n = max_len ? max_len : 16 * 1024;
+            while (n < index + len) {
+                n *= 2;
+            }
+            uint8_t *buf = (uint8_t *)_realloc_out(out_buf, n);
+            if (!buf) {
+                ESP_LOGE(TAG, "JPG band buffer realloc failed: %u", n);
+                return false;
+            }
+            out_buf = buf;
+            max_len = n;
+        }
+        memcpy(out_buf + index, pBuf, len);
+        index += len;
+        return true;
+    }
+
+    virtual size_t get_size() const
+    {
+        return index;
+    }
+
+    const uint8_t *data() const
+    {
+        return out_buf;
+    }
+
+    void rewind()
+    {
+        index = 0;
+    }
+};
+
+typedef struct {
+    TaskHandle_t task;
+    SemaphoreHandle_t done;
+    uint8_t *work;              // scan line and MCU rows of the worker, kept between frames
+    size_t work_size;
+    jpge::jpeg_encoder enc;     // kept between frames, see jpeg_encoder::init_band()
+    band_stream out;
+    // the job, set before the task is notified
+    const uint8_t *src;
+    size_t src_stride;
+    uint16_t width;
+    uint16_t height;
+    int num_channels;
+    int band_y;
+    jpge::params params;
+    pixel_conv_fn convert_line;
+    bool ok;
+} jpg_worker_t;
+
+static jpg_worker_t s_worker;
+
+// one dual-core encode at a time, a concurrent caller encodes on its own core
+static SemaphoreHandle_t jpg_worker_lock()
+{
+    static SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    return lock;
+}
+
+static void jpg_worker_task(void *arg)
+{
+    jpg_worker_t *w = (jpg_worker_t *)arg;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint8_t *line = (uint8_t *)(((uintptr_t)w->work + JPG_LINE_ALIGN - 1) & ~(uintptr_t)(JPG_LINE_ALIGN - 1));
+        w->out.rewind();
+        w->ok = w->enc.init_band(&w->out, w->width, w->height, w->num_channels, w->params, w->band_y, w->height - w->band_y,
+                              line + jpg_line_size(w->width, w->num_channels));
+        if (!w->ok) {
+            ESP_LOGE(TAG, "JPG band encoder init failed");
+        }
+        w->ok = w->ok && encode_rows(w->enc, w->convert_line, w->src, w->src_stride, w->width, w->band_y, w->height, line);
+        xSemaphoreGive(w->done);
+    }
+}
+
+// Takes the worker for this frame, starting it and sizing its work buffer on first use.
+// false if another task holds it or it could not be set up; encode on one core then.
+static bool jpg_worker_acquire(uint16_t width, pixformat_t format)
+{
+    SemaphoreHandle_t lock = jpg_worker_lock();
+    if (!lock || xSemaphoreTake(lock, 0) != pdTRUE) {
+        return false;
+    }
+    jpg_worker_t *w = &s_worker;
+    size_t work_size = fmt2jpg_work_size(width, format);
+    if (!w->done && (w->done = xSemaphoreCreateBinary()) == NULL) {
+        goto fail;
+    }
+    if (!w->task && xTaskCreate(jpg_worker_task, "jpg_worker", JPG_WORKER_STACK, w, uxTaskPriorityGet(NULL), &w->task) != pdPASS) {
+        w->task = NULL;
+        goto fail;
+    }
+    if (w->work_size < work_size) {
+        free(w->work);
+        if ((w->work = (uint8_t *)_malloc(work_size)) == NULL) {
+            w->work_size = 0;
+            goto fail;
+        }
+        w->work_size = work_size;
+    }
+    return true;
+
+fail:
+    ESP_LOGW(TAG, "JPG worker setup failed, encoding on one core");
+    xSemaphoreGive(lock);
+    return false;
+}
+
+static void jpg_worker_release()
+{
+    xSemaphoreGive(jpg_worker_lock());
+}
+
+// Encodes the lower band on the worker and the upper one on this core, then appends the lower band.
+// enc is already set up for the upper band.
+static bool jpg_dual_encode(jpge::jpeg_encoder &enc, jpge::output_stream *dst_stream, pixel_conv_fn convert_line, const uint8_t *src, size_t src_stride,
+                            uint16_t width, uint16_t height, int num_channels, const jpge::params &params, int band_y, uint8_t *line)
+{
+    jpg_worker_t *w = &s_worker;
+
+    w->src = src;
+    w->src_stride = src_stride;
+    w->width = width;
+    w->height = height;
+    w->num_channels = num_channels;
+    w->band_y = band_y;
+    w->params = params;
+    w->convert_line = convert_line;
+    vTaskPrioritySet(w->task, uxTaskPriorityGet(NULL));
+    xTaskNotifyGive(w->task);
+
+    bool ok = encode_rows(enc, convert_line, src, src_stride, width, 0, band_y, line);
+    xSemaphoreTake(w->done, portMAX_DELAY);
+    if (!ok || !w->ok) {
+        return false;
+    }
+    return dst_stream->put_buf(w->out.data(), w->out.get_size()) && dst_stream->put_buf(NULL, 0);
+}
+#endif
+
+// Encoder context kept between frames. While the key (size, format, quality, scan_only) stays the same
+// the scan line kernel, params and band split are reused and the encoder keeps its layout, quantization
+// tables and MCU rows (see jpeg_encoder::init_band()), and the work buffer only grows, so a steady stream
+// of frames is encoded without setup or heap allocation. One task at a time uses the shared context, a
+// concurrent caller gets one allocated for its call.
+typedef struct {
+    jpge::jpeg_encoder enc;
+    uint8_t *work;              // scan line and MCU rows when the caller passes none
+    size_t work_size;
+    // key, width 0 until the first setup
+    uint16_t width;
+    uint16_t height;
+    pixformat_t format;
+    uint8_t quality;
+    bool scan_only;
+    // derived from the key
+    int num_channels;
+    pixel_conv_fn convert_line;
+    size_t src_stride;
+    jpge::params params;
+    int band_y;
+} jpg_ctx_t;
+
+static jpg_ctx_t *s_ctx;
+static std::atomic_flag s_ctx_busy = ATOMIC_FLAG_INIT;
+
+static jpg_ctx_t *jpg_ctx_new()
+{
+    void *mem = _malloc(sizeof(jpg_ctx_t));
+    return mem ? new (mem) jpg_ctx_t() : NULL;
+}
+
+static void jpg_ctx_delete(jpg_ctx_t *ctx)
+{
+    free(ctx->work);
+    ctx->~jpg_ctx_t();
+    free(ctx);
+}
+
+// The shared context, created on first use, or one for this call if another task holds it; NULL when out of memory
+static jpg_ctx_t *jpg_ctx_acquire()
+{
+    if (!s_ctx_busy.test_and_set(std::memory_order_acquire)) {
+        if (s_ctx || (s_ctx = jpg_ctx_new()) != NULL) {
+            return s_ctx;
+        }
+        s_ctx_busy.clear(std::memory_order_release);
+    }
+    return jpg_ctx_new();
+}
+
+static void jpg_ctx_release(jpg_ctx_t *ctx)
+{
+    if (ctx == s_ctx) {
+        s_ctx_busy.clear(std::memory_order_release);
+    } else {
+        jpg_ctx_delete(ctx);
+    }
+}
+
+// Derives the encoder setup from the key unless it is the one of the previous frame
+static bool jpg_ctx_setup(jpg_ctx_t *ctx, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, bool scan_only)
+{
+    if (ctx->width == width && ctx->height == height && ctx->format == format && ctx->quality == quality && ctx->scan_only == scan_only) {
+        return true;
+    }
+    ctx->width = 0;
+
+    int num_channels = 3;
+    jpge::subsampling_t subsampling = jpge::H2V2;
+
+    if(format == PIXFORMAT_GRAYSCALE) {
+        num_channels = 1;
+        subsampling = jpge::Y_ONLY;
+    }
+
+    // the encoder takes luma or planar YCbCr scanlines, so colour frames are converted straight to
+    // YCbCr (YUV422 only has its range stretched); pick the kernel once, not per line
+    pixel_layout_t src_layout = pixel_layout_of(format);
+    pixel_conv_fn convert_line = pixel_conv_get(src_layout, num_channels == 1 ? PIXEL_GRAY : PIXEL_YCBCR);
+    if(!convert_line) {
+        ESP_LOGE(TAG, "Unsupported format %d", format);
+        return false;
+    }
+
+    jpge::params comp_params = jpge::params();
+    comp_params.m_subsampling = subsampling;
+    comp_params.m_quality = quality ? (quality > 100 ? 100 : quality) : 1;
+    comp_params.m_src_ycbcr = (num_channels == 3);
+    comp_params.m_scan_only = scan_only;
+
+    ctx->num_channels = num_channels;
+    ctx->convert_line = convert_line;
+    ctx->src_stride = width * pixel_layout_bpp(src_layout);
+    // rows from band_y on are encoded on the other core when the worker is free
+    ctx->band_y = jpg_band_split(width, height, &comp_params);
+    ctx->params = comp_params;
+    ctx->height = height;
+    ctx->format = format;
+    ctx->quality = quality;
+    ctx->scan_only = scan_only;
+    ctx->width = width;
+    return true;
+}
+
+static bool convert_image_run(jpg_ctx_t *ctx, const uint8_t *src, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpge::output_stream *dst_stream, uint8_t *work, bool scan_only)
+{
+    if (!jpg_ctx_setup(ctx, width, height, format, quality, scan_only)) {
+        return false;
+    }
+    int num_channels = ctx->num_channels;
+    int band_y = ctx->band_y;
+
+    if (!work) {
+        size_t work_size = fmt2jpg_work_size(width, format);
+        if (ctx->work_size < work_size) {
+            free(ctx->work);
+            if ((ctx->work = (uint8_t *)_malloc(work_size)) == NULL) {
+                ctx->work_size = 0;
+                ESP_LOGE(TAG, "Scan line malloc failed");
+                return false;
+            }
+            ctx->work_size = work_size;
+        }
+        work = ctx->work;
+    }
+    uint8_t *line = (uint8_t *)(((uintptr_t)work + JPG_LINE_ALIGN - 1) & ~(uintptr_t)(JPG_LINE_ALIGN - 1));
+    uint8_t *mcu_buf = line + jpg_line_size(width, num_channels);
+
+    bool dual = false;
+#if CONFIG_CAMERA_JPEG_DUAL_CORE
+    dual = (band_y < height) && jpg_worker_acquire(width, format);
+#endif
+
+    jpge::jpeg_encoder &dst_image = ctx->enc;
+    bool ok = dst_image.init_band(dst_stream, width, height, num_channels, ctx->params, 0, band_y, mcu_buf);
+    if (!ok) {
+        ESP_LOGE(TAG, "JPG encoder init failed");
+    }
+
+#if CONFIG_CAMERA_JPEG_DUAL_CORE
+    if (dual) {
+        ok = ok && jpg_dual_encode(dst_image, dst_stream, ctx->convert_line, src, ctx->src_stride, width, height, num_channels, ctx->params, band_y, line);
+        jpg_worker_release();
+    }
+#endif
+    if (!dual) {
+        ok = ok && encode_rows(dst_image, ctx->convert_line, src, ctx->src_stride, width, 0, band_y, line);
+        if (ok && band_y < height) {
+            ok = dst_image.init_band(dst_stream, width, height, num_channels, ctx->params, band_y, height - band_y, mcu_buf) &&
+                 encode_rows(dst_image, ctx->convert_line, src, ctx->src_stride, width, band_y, height, line);
+        }
+    }
+    return ok;
+}
+
+// work: optional fmt2jpg_work_size() bytes for the scan line and the encoder MCU rows, NULL uses the context's
+// scan_only: write only the entropy-coded data, see jpge::params::m_scan_only
+bool convert_image(const uint8_t *src, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpge::output_stream *dst_stream, uint8_t *work, bool scan_only = false)
+{
+    camera_prof_mark_t mark;
+
+    camera_prof_begin(&mark);
+    jpg_ctx_t *ctx = jpg_ctx_acquire();
+    if (!ctx) {
+        ESP_LOGE(TAG, "JPG context malloc failed");
+        return false;
+    }
+    bool ok = convert_image_run(ctx, src, width, height, format, quality, dst_stream, work, scan_only);
+    jpg_ctx_release(ctx);
+    camera_prof_end(CAMERA_PROF_CONVERT, &mark);
+    return ok;
+}
+
+class callback_stream : public jpge::output_stream {
+protected:
+    jpg_out_cb ocb;
+    void * oarg;
+    size_t index;
+
+public:
+    callback_stream(jpg_out_cb cb, void * arg) : ocb(cb), oarg(arg), index(0) { }
+    virtual ~callback_stream() { }
+    virtual bool put_buf(const void* data, int len)
+    {
+        index += ocb(oarg, index, data, len);
+        return true;
+    }
+    virtual size_t get_size() const
+    {
+        return index;
+    }
+};
+
+bool fmt2jpg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpg_out_cb cb, void * arg)
+{
+    callback_stream dst_stream(cb, arg);
+    return convert_image(src, width, height, format, quality, &dst_stream, NULL);
+}
+
+bool frame2jpg_cb(camera_fb_t * fb, uint8_t quality, jpg_out_cb cb, void * arg)
+{
+    return fmt2jpg_cb(fb->buf, fb->len, fb->width, fb->height, fb->format, quality, cb, arg);
+}
+
+// Fills the caller's chunk and hands it to the callback whenever it is full. A full chunk is held
+// until more output follows, so the callback sees last set on the final one.
+class chunk_stream : public jpge::output_stream {
+protected:
+    jpg_chunk_cb ocb;
+    void * oarg;
+    uint8_t *chunk;
+    size_t chunk_size, fill, index;
+
+public:
+    chunk_stream(uint8_t *buf, size_t size, jpg_chunk_cb cb, void * arg) : ocb(cb), oarg(arg), chunk(buf), chunk_size(size), fill(0), index(0) { }
+    virtual ~chunk_stream() { }
+
+    virtual bool put_buf(const void* pBuf, int len)
+    {
+        const uint8_t *data = static_cast<const uint8_t*>(pBuf);
+        if (!data) {
+            //end of image
+            bool ok = ocb(oarg, index, chunk, fill, true);
+            index += fill;
+            fill = 0;
+            return ok;
+        }
+        while (len) {
+            if (fill == chunk_size) {
+                if (!ocb(oarg, index, chunk, fill, false)) {
+                    return false;
+                }
+                index += fill;
+                fill = 0;
+            }
+            size_t n = ((size_t)len < chunk_size - fill) ? (size_t)len : chunk_size - fill;
+            memcpy(chunk + fill, data, n);
+            fill += n;
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    virtual size_t get_size() const
+    {
+        return index + fill;
+    }
+};
+
+bool fmt2jpg_chunks(const uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, bool scan_only,
+                    uint8_t *chunk, size_t chunk_size, uint8_t *work, jpg_chunk_cb cb, void * arg)
+{
+    if (!chunk || !chunk_size) {
+        return false;
+    }
+    chunk_stream dst_stream(chunk, chunk_size, cb, arg);
+    return convert_image(src, width, height, format, quality, &dst_stream, work, scan_only);
+}
+
+uint16_t fmt2jpg_restart_interval(uint16_t width, uint16_t height, pixformat_t format)
+{
+    jpge::params params;
+    params.m_subsampling = (format == PIXFORMAT_GRAYSCALE) ? jpge::Y_ONLY : jpge::H2V2;
+    jpg_band_split(width, height, &params);
+    return params.m_restart_interval;
+}
+
+
+
+class memory_stream : public jpge::output_stream {
+protected:
+    uint8_t *out_buf;
+    size_t max_len, index;
+    bool overflow;
+
+public:
+    memory_stream(void *pBuf, uint buf_size) : out_buf(static_cast<uint8_t*>(pBuf)), max_len(buf_size), index(0), overflow(false) { }
+
+    virtual ~memory_stream() { }
+
+    virtual bool put_buf(const void* pBuf, int len)
+    {
+        if (!pBuf) {
+            //end of image
+            return true;
+        }
+        if ((size_t)len > (max_len - index)) {
+            //ESP_LOGW(TAG, "JPG output overflow: %d bytes (%d,%d,%d)", len - (max_len - index), len, index, max_len);
+            len = max_len - index;
+            overflow = true;
+        }
+        if (len) {
+            memcpy(out_buf + index, pBuf, len);
+            index += len;
+        }
+        return true;
+    }
+
+    virtual size_t get_size() const
+    {
+        return index;
+    }
+
+    // true if the image did not fit and the output was truncated
+    bool overflowed() const
+    {
+        return overflow;
+    }
+};
+
+bool fmt2jpg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, uint8_t ** out, size_t * out_len)
+{
+    //todo: allocate proper buffer for holding JPEG data
+    //this should be enough for CIF frame size
+    int jpg_buf_len = 128*1024;
+
+
+    uint8_t * jpg_buf = (uint8_t *)_malloc(jpg_buf_len);
+    if(jpg_buf == NULL) {
+        ESP_LOGE(TAG, "JPG buffer malloc failed");
+        return false;
+    }
+    memory_stream dst_stream(jpg_buf, jpg_buf_len);
+
+    if(!convert_image(src, width, height, format, quality, &dst_stream, NULL)) {
+        free(jpg_buf);
+        return false;
+    }
+
+    *out = jpg_buf;
+    *out_len = dst_stream.get_size();
+    return true;
+}
+
+bool frame2jpg(camera_fb_t * fb, uint8_t quality, uint8_t ** out, size_t * out_len)
+{
+    return fmt2jpg(fb->buf, fb->len, fb->width, fb->height, fb->format, quality, out, out_len);
+}
+
+size_t fmt2jpg_work_size(uint16_t width, pixformat_t format)
+{
+    int num_channels = (format == PIXFORMAT_GRAYSCALE) ? 1 : 3;
+    return JPG_LINE_ALIGN - 1 + jpg_line_size(width, num_channels) + jpge::jpeg_encoder::mcu_buf_size(width, num_channels);
+}
+
+bool fmt2jpg_buf(const uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, uint8_t *out, size_t out_size, uint8_t *work, size_t *out_len)
+{
+    memory_stream dst_stream(out, out_size);
+
+    if(!convert_image(src, width, height, format, quality, &dst_stream, work)) {
+        return false;
+    }
+    if(dst_stream.overflowed()) {
+        ESP_LOGE(TAG, "JPG output buffer too small: %u", out_size);
+        return false;
+    }
+    *out_len = dst_stream.get_size();
+    return true;
+}
+
+bool fmt2jpg_arena(const uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, img_arena_t *arena, size_t *out_len)
+{
+    // the first frame starts from a 4:1 guess; on overflow the buffer doubles up to the raw RGB888 size
+    // (plus headers), after which the arena is large enough for every following frame of this size
+    size_t raw = (size_t)width * height * ((format == PIXFORMAT_GRAYSCALE) ? 1 : 3) + 1024;
+    size_t out_size = arena->size ? arena->size : raw / 4;
+
+    while(true) {
+        if(!img_arena_reserve(arena, out_size, fmt2jpg_work_size(width, format))) {
+            return false;
+        }
+        memory_stream dst_stream(arena->buf, arena->size);
+        if(!convert_image(src, width, height, format, quality, &dst_stream, arena->work)) {
+            return false;
+        }
+        if(!dst_stream.overflowed()) {
+            *out_len = dst_stream.get_size();
+            return true;
+        }
+        if(arena->size >= raw) {
+            ESP_LOGE(TAG, "JPG output larger than %u", arena->size);
+            return false;
+        }
+        out_size = (arena->size * 2 < raw) ? arena->size * 2 : raw;
+    }
+}
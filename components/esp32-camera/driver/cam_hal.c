@@ -0,0 +1,1983 @@
+// Copyright 2010-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdalign.h>
+#include <sys/param.h>
+#include "esp_heap_caps.h"
+#include "ll_cam.h"
+#include "cam_hal.h"
+#include "camera_prof.h"
+#if CONFIG_CAMERA_TASK_STATIC
+#include "esp_ipc.h"
+#endif
+
+#if (ESP_IDF_VERSION_MAJOR == 3) && (ESP_IDF_VERSION_MINOR == 3)
+#include "rom/ets_sys.h"
+#else
+#include "esp_timer.h"
+#if CONFIG_IDF_TARGET_ESP32
+#include "esp32/rom/ets_sys.h"  // will be removed in idf v5.0
+#elif CONFIG_IDF_TARGET_ESP32S2
+#include "esp32s2/rom/ets_sys.h"
+#elif CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/ets_sys.h"
+#endif
+#endif // ESP_IDF_VERSION_MAJOR
+#define ESP_CAMERA_ETS_PRINTF ets_printf
+
+// GDMA writes PSRAM frame buffers behind the data cache, so psram_mode frames need explicit cache maintenance
+#if CONFIG_IDF_TARGET_ESP32S3 && CONFIG_SPIRAM
+#include "esp_cache.h"
+#include "esp_memory_utils.h"
+#define CAM_FB_CACHE_SYNC          1
+#define CAM_FB_CACHE_LINE          CONFIG_ESP32S3_DATA_CACHE_LINE_SIZE
+#else
+#define CAM_FB_CACHE_SYNC          0
+#define CAM_FB_CACHE_LINE          0
+#endif
+
+#if CONFIG_CAMERA_TASK_STACK_SIZE
+#define CAM_TASK_STACK             CONFIG_CAMERA_TASK_STACK_SIZE
+#else
+#define CAM_TASK_STACK             (2*1024)
+#endif
+
+#if CONFIG_CAMERA_CORE0
+#define CAM_TASK_CORE              0
+#elif CONFIG_CAMERA_CORE1
+#define CAM_TASK_CORE              1
+#else
+#define CAM_TASK_CORE              tskNO_AFFINITY
+#endif
+
+#define CAM_FB_COUNT_MAX           32
+
+#if CONFIG_CAMERA_FB_POOL
+#define CAM_POOL_CLASSES           4  // slot sizes fb_size/16, /8, /4 and /2
+#define CAM_POOL_ALIGN             32 // slot start and size, a PSRAM cache line
+#endif
+
+// chosen with esp_camera_set_alloc_caps(), 0: driver default
+static uint32_t s_cam_alloc_caps[CAMERA_ALLOC_MAX];
+
+#if CONFIG_CAMERA_TRACE
+_Static_assert((CONFIG_CAMERA_TRACE_EVENTS & (CONFIG_CAMERA_TRACE_EVENTS - 1)) == 0,
+               "CONFIG_CAMERA_TRACE_EVENTS must be a power of two");
+// probe ring in internal RAM, written from the camera ISRs and tasks, drained by one reader.
+// A slot's seq is its event number + 1 once complete and 0 while it is written, so the
+// reader drops an event it raced with instead of returning a torn one.
+static camera_trace_event_t s_trace_ring[CONFIG_CAMERA_TRACE_EVENTS];
+static uint32_t s_trace_seq[CONFIG_CAMERA_TRACE_EVENTS];
+static uint32_t s_trace_head;//events recorded
+static uint32_t s_trace_tail;//events read, owned by the reader
+#endif
+
+#if CONFIG_CAMERA_TASK_STATIC
+// cam_task and the driver's queue and semaphores are rebuilt in these .bss (internal RAM) buffers
+// on every cam_init(), so re-initialisation never depends on the state of the heap
+static StackType_t s_cam_task_stack[CAM_TASK_STACK];
+static StaticTask_t s_cam_task_tcb;
+static StaticQueue_t s_cam_fb_queue;
+static uint8_t s_cam_fb_queue_storage[CAM_FB_COUNT_MAX * sizeof(camera_fb_t *)];
+static StaticSemaphore_t s_cam_mailbox_sem;
+#if CONFIG_CAMERA_CUT_THROUGH
+static StaticSemaphore_t s_cam_stream_sem;
+#endif
+#endif
+
+// number of corrupt (NO-EOI) frames cam_take skips before giving up
+#define CAM_TAKE_NO_EOI_RETRY      3
+
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+// VSYNCs without a frame EOF before continuous capture restarts (one may be the manual VSYNC)
+#define CAM_CONTINUOUS_EOF_WAIT    2
+#endif
+
+#if CONFIG_CAMERA_DMA_WATCHDOG
+// the stall limit is CONFIG_CAMERA_DMA_WATCHDOG_FRAMES VSYNC intervals, but never below this
+#define CAM_WDT_MIN_US             (100 * 1000)
+// longer VSYNC gaps are pauses (cam_stop, sensor reconfiguration), not part of the cadence
+#define CAM_WDT_PERIOD_MAX_US      (1000 * 1000)
+#endif
+
+static const char *TAG = "cam_hal";
+static cam_obj_t *cam_obj = NULL;
+
+static const uint16_t JPEG_EOI_MARKER = 0xD9FF;  // written in little-endian for esp32
+
+static inline bool cam_is_jpeg_soi(const uint8_t *p)
+{
+    return p[0] == 0xFF && p[1] == 0xD8 && p[2] == 0xFF;
+}
+
+static int cam_verify_jpeg_soi(const uint8_t *inbuf, uint32_t length)
+{
+    if (length < 3) {
+        ESP_LOGW(TAG, "NO-SOI");
+        return -1;
+    }
+    // a valid frame starts with SOI, so the common case never enters the scan
+    if (cam_is_jpeg_soi(inbuf)) {
+        return 0;
+    }
+
+    uint32_t i = 1;
+    uint32_t last = length - 2; // SOI must fit in the buffer
+
+    // byte steps up to the first word boundary
+    while (i < last && ((uintptr_t)&inbuf[i] & 3)) {
+        if (inbuf[i] == 0xFF && cam_is_jpeg_soi(&inbuf[i])) {
+            return i;
+        }
+        i++;
+    }
+    // word at a time: only words containing a 0xFF byte are inspected
+    while (i + 4 <= last) {
+        uint32_t v = ~*(const uint32_t *)&inbuf[i];
+        if ((v - 0x01010101U) & ~v & 0x80808080U) {
+            for (uint32_t j = i; j < i + 4; j++) {
+                if (inbuf[j] == 0xFF && cam_is_jpeg_soi(&inbuf[j])) {
+                    return j;
+                }
+            }
+        }
+        i += 4;
+    }
+    for (; i < last; i++) {
+        if (inbuf[i] == 0xFF && cam_is_jpeg_soi(&inbuf[i])) {
+            return i;
+        }
+    }
+    ESP_LOGW(TAG, "NO-SOI");
+    return -1;
+}
+
+static int cam_verify_jpeg_eoi(const uint8_t *inbuf, uint32_t length)
+{
+    if (length < 3) {
+        return -1;
+    }
+    // search backwards for the last FF D9; offset 0 is never a valid EOI
+    int32_t i = length - 2;
+
+    // byte steps until inbuf[i - 3 .. i] is an aligned word
+    while (i >= 1 && ((uintptr_t)&inbuf[i + 1] & 3)) {
+        if (inbuf[i] == 0xFF && inbuf[i + 1] == 0xD9) {
+            return i;
+        }
+        i--;
+    }
+    // word at a time: only words containing a 0xFF byte are inspected
+    while (i >= 4) {
+        uint32_t v = ~*(const uint32_t *)&inbuf[i - 3];
+        if ((v - 0x01010101U) & ~v & 0x80808080U) {
+            for (int32_t j = i; j > i - 4; j--) {
+                if (inbuf[j] == 0xFF && inbuf[j + 1] == 0xD9) {
+                    return j;
+                }
+            }
+        }
+        i -= 4;
+    }
+    for (; i >= 1; i--) {
+        if (inbuf[i] == 0xFF && inbuf[i + 1] == 0xD9) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+// Hand a frame buffer's descriptors to GDMA (own) or take them back so the ring stops in
+// front of the buffer. length/eof are cleared so cam_dma_frame_len only sees this frame.
+static void cam_dma_arm(lldesc_t *dma, uint32_t cnt, bool own)
+{
+    for (uint32_t x = 0; x < cnt; x++) {
+        dma[x].length = 0;
+        dma[x].eof = 0;
+        dma[x].owner = own;
+    }
+}
+
+// Bytes GDMA wrote into a frame buffer up to the descriptor closed by the VSYNC EOF.
+// Returns false if no descriptor of this buffer was closed: the frame ran past its end.
+static bool cam_dma_frame_len(const lldesc_t *dma, uint32_t cnt, size_t *len)
+{
+    size_t total = 0;
+    for (uint32_t x = 0; x < cnt; x++) {
+        total += dma[x].length;
+        if (dma[x].eof) {
+            *len = total;
+            return true;
+        }
+    }
+    *len = total;
+    return false;
+}
+#endif
+
+// Frame slot ownership: bit x of frame_free_mask is set while frames[x] is free for DMA.
+// cam_task clears the bit when a frame completes, cam_give sets it again from any core.
+// With CONFIG_CAMERA_FB_POOL the pool slots follow the fb_count DMA slots and use the same bits.
+static inline uint32_t cam_slot_cnt(void)
+{
+#if CONFIG_CAMERA_FB_POOL
+    return cam_obj->frame_cnt + cam_obj->pool_cnt;
+#else
+    return cam_obj->frame_cnt;
+#endif
+}
+
+static inline uint32_t cam_dma_slot_mask(void)
+{
+    return (uint32_t)((1ULL << cam_obj->frame_cnt) - 1);
+}
+
+static inline bool cam_frame_is_free(int pos)
+{
+    return (__atomic_load_n(&cam_obj->frame_free_mask, __ATOMIC_ACQUIRE) & (1U << pos)) != 0;
+}
+
+static inline void cam_frame_set_free(int pos)
+{
+    __atomic_store_n(&cam_obj->frames[pos].refcnt, 0, __ATOMIC_RELAXED);
+    __atomic_fetch_or(&cam_obj->frame_free_mask, 1U << pos, __ATOMIC_RELEASE);
+}
+
+static inline void cam_frame_set_busy(int pos)
+{
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+    if (cam_obj->continuous && pos < (int)cam_obj->frame_cnt) {
+        cam_dma_arm(cam_obj->frames[pos].dma, cam_obj->dma_node_cnt, false);
+    }
+#endif
+    __atomic_fetch_and(&cam_obj->frame_free_mask, ~(1U << pos), __ATOMIC_ACQ_REL);
+    // the frame queue (and then the first esp_camera_fb_get caller) owns the initial reference
+    __atomic_store_n(&cam_obj->frames[pos].refcnt, 1, __ATOMIC_RELEASE);
+}
+
+// slot index of a driver frame buffer, -1 if fb does not belong to the driver
+static inline int cam_frame_index(const camera_fb_t *fb)
+{
+    const cam_frame_t *frame = __containerof(fb, cam_frame_t, fb);
+    int pos = frame - cam_obj->frames;
+    if (pos < 0 || pos >= (int)cam_slot_cnt() || &cam_obj->frames[pos].fb != fb) {
+        return -1;
+    }
+    return pos;
+}
+
+// CAMERA_GRAB_NEWEST: the newest completed frame replaces the pending one in a single-slot mailbox
+static void cam_mailbox_post(camera_fb_t *fb)
+{
+    camera_fb_t *old = __atomic_exchange_n(&cam_obj->mailbox, fb, __ATOMIC_ACQ_REL);
+    if (old) {
+        cam_give(old);
+        cam_obj->stats.superseded++;
+    }
+    xSemaphoreGive(cam_obj->mailbox_sem);
+}
+
+#if CONFIG_CAMERA_FB_META
+// copy the latest register sample into a completed frame and ask for a new one every
+// CONFIG_CAMERA_FB_META_INTERVAL frames, while the sensor is between frames
+static void cam_meta_frame(int frame_pos)
+{
+    camera_fb_meta_t *meta = &cam_obj->frames[frame_pos].meta;
+    uint32_t frames = cam_obj->stats.frames;
+
+    portENTER_CRITICAL(&cam_obj->meta_lock);
+    *meta = cam_obj->meta;
+    meta->age = (uint8_t)MIN(frames - cam_obj->meta_frame, 255U);
+    portEXIT_CRITICAL(&cam_obj->meta_lock);
+
+    if (cam_obj->meta_task && frames % CONFIG_CAMERA_FB_META_INTERVAL == 0) {
+        xTaskNotify(cam_obj->meta_task, frames, eSetValueWithOverwrite);
+    }
+}
+#endif
+
+// wait for a completed frame from the mailbox or the frame buffer queue
+static camera_fb_t *cam_receive(TickType_t timeout)
+{
+    camera_fb_t *fb = NULL;
+    if (cam_obj->grab_mode != CAMERA_GRAB_NEWEST) {
+        xQueueReceive(cam_obj->frame_buffer_queue, (void *)&fb, timeout);
+        return fb;
+    }
+    TickType_t start = xTaskGetTickCount();
+    while ((fb = __atomic_exchange_n(&cam_obj->mailbox, NULL, __ATOMIC_ACQ_REL)) == NULL) {
+        TickType_t spent = xTaskGetTickCount() - start;
+        if (spent >= timeout || xSemaphoreTake(cam_obj->mailbox_sem, timeout - spent) != pdTRUE) {
+            break;
+        }
+    }
+    return fb;
+}
+
+static bool cam_get_next_frame(int * frame_pos)
+{
+    uint32_t mask = __atomic_load_n(&cam_obj->frame_free_mask, __ATOMIC_ACQUIRE) & cam_dma_slot_mask();
+    if (mask & (1U << *frame_pos)) {
+        return true;
+    }
+    if (mask == 0) {
+        return false;
+    }
+    *frame_pos = __builtin_ctz(mask);
+    return true;
+}
+
+#if CAM_FB_CACHE_SYNC
+// before_dma: write back and drop any cached lines so none is evicted over DMA data later.
+// after DMA: drop stale lines so the CPU reads what the DMA wrote.
+static void cam_fb_cache_sync(const camera_fb_t *fb, size_t len, bool before_dma)
+{
+    camera_prof_mark_t mark;
+
+    if (!esp_ptr_external_ram(fb->buf) || len == 0) {
+        return;
+    }
+    len = (len + CAM_FB_CACHE_LINE - 1) & ~(CAM_FB_CACHE_LINE - 1);
+    int flags = before_dma ? (ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_INVALIDATE) : ESP_CACHE_MSYNC_FLAG_DIR_M2C;
+    // with DMA to PSRAM this replaces the copy out of the DMA buffers
+    camera_prof_begin(&mark);
+    if (esp_cache_msync(fb->buf, len, flags) != ESP_OK) {
+        ESP_LOGW(TAG, "cache sync failed");
+    }
+    camera_prof_end(CAMERA_PROF_COPY, &mark);
+}
+
+#if CONFIG_CAMERA_CUT_THROUGH
+// DMA has written buf[off, off + len) of a frame still being captured; off and len are DMA node
+// multiples, so no line is shared with data GDMA writes later
+static void cam_fb_cache_invalidate(const camera_fb_t *fb, size_t off, size_t len)
+{
+    if (!esp_ptr_external_ram(fb->buf) || len == 0) {
+        return;
+    }
+    if (esp_cache_msync(fb->buf + off, len, ESP_CACHE_MSYNC_FLAG_DIR_M2C) != ESP_OK) {
+        ESP_LOGW(TAG, "cache sync failed");
+    }
+}
+#endif
+#else
+#define cam_fb_cache_sync(fb, len, before_dma)
+#define cam_fb_cache_invalidate(fb, off, len)
+#endif
+
+#if CONFIG_CAMERA_CUT_THROUGH
+// The frame the reader follows was abandoned (no SOI, overflow, capture restarted): called
+// before every frame start, when its slot is still free instead of completed.
+static void cam_stream_drop(void)
+{
+    bool dropped = false;
+
+    portENTER_CRITICAL(&cam_obj->stream_lock);
+    cam_stream_state_t state = cam_obj->stream_state;
+    if ((state == CAM_STREAM_ACTIVE || state == CAM_STREAM_CANCEL) && cam_frame_is_free(cam_obj->stream_pos)) {
+        dropped = (state == CAM_STREAM_ACTIVE);
+        cam_obj->stream_state = dropped ? CAM_STREAM_DROPPED : CAM_STREAM_IDLE;
+    }
+    portEXIT_CRITICAL(&cam_obj->stream_lock);
+    if (dropped) {
+        xSemaphoreGive(cam_obj->stream_sem);
+    }
+}
+
+// avail bytes of frames[pos] are in memory. A waiting reader claims the frame with its first data.
+static void cam_stream_progress(int pos, size_t avail)
+{
+    size_t from = 0;
+    bool publish = false;
+
+    portENTER_CRITICAL(&cam_obj->stream_lock);
+    if (cam_obj->stream_state == CAM_STREAM_WAIT && avail) {
+        cam_obj->stream_state = CAM_STREAM_ACTIVE;
+        cam_obj->stream_pos = pos;
+        cam_obj->stream_avail = 0;
+    }
+    if (cam_obj->stream_state == CAM_STREAM_ACTIVE && cam_obj->stream_pos == pos && avail > cam_obj->stream_avail) {
+        from = cam_obj->stream_avail;
+        publish = true;
+    }
+    portEXIT_CRITICAL(&cam_obj->stream_lock);
+    if (!publish) {
+        return;
+    }
+    cam_fb_cache_invalidate(&cam_obj->frames[pos].fb, from, avail - from);
+    portENTER_CRITICAL(&cam_obj->stream_lock);
+    if (cam_obj->stream_state == CAM_STREAM_ACTIVE && cam_obj->stream_pos == pos) {
+        cam_obj->stream_avail = avail;
+    }
+    portEXIT_CRITICAL(&cam_obj->stream_lock);
+    xSemaphoreGive(cam_obj->stream_sem);
+}
+
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+// Continuous capture has no per-node EOF: count the descriptors GDMA has written back since the
+// last DMA done interrupt. The descriptor closing the frame is left to the frame EOF.
+static void cam_stream_poll(int pos)
+{
+    cam_stream_state_t state = cam_obj->stream_state;
+    if (!cam_obj->continuous || cam_obj->state != CAM_STATE_READ_BUF ||
+        (state != CAM_STREAM_WAIT && state != CAM_STREAM_ACTIVE)) {
+        return;
+    }
+    const lldesc_t *dma = cam_obj->frames[pos].dma;
+    while (cam_obj->stream_node < cam_obj->dma_node_cnt && dma[cam_obj->stream_node].length &&
+           !dma[cam_obj->stream_node].eof) {
+        cam_obj->stream_walk += dma[cam_obj->stream_node].length;
+        cam_obj->stream_node++;
+    }
+    cam_stream_progress(pos, cam_obj->stream_walk);
+}
+#endif
+
+// A completed frame the reader follows (or waits for) goes to the reader instead of the frame
+// queue. Returns false if the frame is not the reader's.
+static bool cam_stream_complete(int pos)
+{
+    cam_frame_t *frame = &cam_obj->frames[pos];
+    bool eoi = frame->jpeg_eoi;
+    bool mine = false;
+
+    portENTER_CRITICAL(&cam_obj->stream_lock);
+    cam_stream_state_t state = cam_obj->stream_state;
+    if (state == CAM_STREAM_WAIT) {
+        cam_obj->stream_pos = pos;
+        state = CAM_STREAM_ACTIVE;
+    }
+    if (cam_obj->stream_pos == pos && state == CAM_STREAM_ACTIVE) {
+        cam_obj->stream_avail = frame->fb.len;
+        cam_obj->stream_state = eoi ? CAM_STREAM_DONE : CAM_STREAM_DROPPED;
+        mine = true;
+    } else if (cam_obj->stream_pos == pos && state == CAM_STREAM_CANCEL) {
+        cam_obj->stream_state = CAM_STREAM_IDLE;
+    }
+    portEXIT_CRITICAL(&cam_obj->stream_lock);
+    if (!mine) {
+        return false;
+    }
+    if (eoi) {
+        cam_obj->stats.frames++;
+#if CONFIG_CAMERA_FB_META
+        cam_meta_frame(pos);
+#endif
+    } else {
+        ESP_LOGW(TAG, "NO-EOI");
+        cam_obj->stats.no_eoi++;
+        cam_frame_set_free(pos);
+    }
+    xSemaphoreGive(cam_obj->stream_sem);
+    return true;
+}
+#endif
+
+// handoff: continuous capture between two frames, relink GDMA instead of restarting the engine
+static bool cam_start_frame(int * frame_pos, bool handoff)
+{
+#if CONFIG_CAMERA_CUT_THROUGH
+    cam_stream_drop();
+#endif
+    if (!cam_get_next_frame(frame_pos)) {
+        return false;
+    }
+    if (cam_obj->psram_mode) {
+        cam_fb_cache_sync(&cam_obj->frames[*frame_pos].fb, cam_obj->fb_size, true);
+    }
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+    if (cam_obj->continuous) {
+        cam_dma_arm(cam_obj->frames[*frame_pos].dma, cam_obj->dma_node_cnt, true);
+    }
+    if (handoff && !ll_cam_next_frame(cam_obj, *frame_pos)) {
+        // the owner check stopped GDMA in front of a held buffer
+        cam_obj->stats.dma_restart++;
+        handoff = false;
+    }
+#endif
+    if (!handoff) {
+        if (!ll_cam_start(cam_obj, *frame_pos)) {
+            return false;
+        }
+        // Vsync the frame manually
+        ll_cam_do_vsync(cam_obj);
+    }
+#if CONFIG_CAMERA_CUT_THROUGH
+    cam_obj->stream_node = 0;
+    cam_obj->stream_walk = 0;
+#endif
+    uint64_t us = (uint64_t)esp_timer_get_time();
+    cam_obj->frames[*frame_pos].fb.timestamp.tv_sec = us / 1000000UL;
+    cam_obj->frames[*frame_pos].fb.timestamp.tv_usec = us % 1000000UL;
+#if CONFIG_CAMERA_FRAME_TIMING
+    memset(&cam_obj->frames[*frame_pos].timing, 0, sizeof(camera_fb_timing_t));
+    // targets without an ISR timestamp fall back to the time the frame was started
+    cam_obj->frames[*frame_pos].timing.vsync_us = cam_obj->vsync_isr_us ? cam_obj->vsync_isr_us : (int64_t)us;
+#endif
+    CAM_TRACE(CAMERA_TRACE_FRAME_START, *frame_pos);
+    return true;
+}
+
+#if CONFIG_CAMERA_TRACE
+void IRAM_ATTR cam_trace_record(camera_trace_id_t id, uint32_t arg)
+{
+    uint32_t n = __atomic_fetch_add(&s_trace_head, 1, __ATOMIC_RELAXED);
+    uint32_t slot = n & (CONFIG_CAMERA_TRACE_EVENTS - 1);
+
+    __atomic_store_n(&s_trace_seq[slot], 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    s_trace_ring[slot].time_us = esp_timer_get_time();
+    s_trace_ring[slot].arg = arg;
+    s_trace_ring[slot].id = id;
+    s_trace_ring[slot].core = xPortGetCoreID();
+    __atomic_store_n(&s_trace_seq[slot], n + 1, __ATOMIC_RELEASE);
+}
+#endif
+
+size_t cam_trace_read(camera_trace_event_t *events, size_t max, uint32_t *lost)
+{
+    size_t cnt = 0;
+    uint32_t dropped = 0;
+#if CONFIG_CAMERA_TRACE
+    uint32_t head = __atomic_load_n(&s_trace_head, __ATOMIC_ACQUIRE);
+    uint32_t tail = s_trace_tail;
+
+    if (head - tail > CONFIG_CAMERA_TRACE_EVENTS) {
+        dropped = head - tail - CONFIG_CAMERA_TRACE_EVENTS;
+        tail = head - CONFIG_CAMERA_TRACE_EVENTS;
+    }
+    while (tail != head && cnt < max) {
+        uint32_t slot = tail & (CONFIG_CAMERA_TRACE_EVENTS - 1);
+        uint32_t seq = __atomic_load_n(&s_trace_seq[slot], __ATOMIC_ACQUIRE);
+        if (seq == 0) {
+            break;//still being written, read it next time
+        }
+        events[cnt] = s_trace_ring[slot];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq == tail + 1 && __atomic_load_n(&s_trace_seq[slot], __ATOMIC_RELAXED) == seq) {
+            cnt++;
+        } else {
+            dropped++;//overwritten by a newer event
+        }
+        tail++;
+    }
+    s_trace_tail = tail;
+#else
+    (void)events;
+    (void)max;
+#endif
+    if (lost) {
+        *lost = dropped;
+    }
+    return cnt;
+}
+
+static inline void cam_set_state(cam_state_t state)
+{
+    if (cam_obj->state != state) {
+        CAM_TRACE(CAMERA_TRACE_TASK_STATE, state);
+    }
+    cam_obj->state = state;
+}
+
+// Count the event and wake cam_task. Repeated notifications coalesce, so the ISR
+// never fails; cam_task replays the counters in order (see cam_next_event).
+void IRAM_ATTR ll_cam_send_event(cam_obj_t *cam, cam_event_t cam_event, BaseType_t * HPTaskAwoken)
+{
+    if (cam->task_handle == NULL) {
+        return;
+    }
+    if (cam_event == CAM_IN_DONE_EVENT) {
+        // progress only, cam_task reads the finished descriptors itself
+        xTaskNotifyFromISR(cam->task_handle, CAM_NOTIFY_DONE, eSetBits, HPTaskAwoken);
+        return;
+    }
+    if (cam_event == CAM_VSYNC_EVENT) {
+        cam->ev_vsync_eof[cam->ev_vsync_cnt % CAM_EV_VSYNC_RING] = cam->ev_eof_cnt;
+        __atomic_store_n(&cam->ev_vsync_cnt, cam->ev_vsync_cnt + 1, __ATOMIC_RELEASE);
+    } else {
+        __atomic_store_n(&cam->ev_eof_cnt, cam->ev_eof_cnt + 1, __ATOMIC_RELEASE);
+    }
+    xTaskNotifyFromISR(cam->task_handle, cam_event == CAM_VSYNC_EVENT ? CAM_NOTIFY_VSYNC : CAM_NOTIFY_EOF,
+                       eSetBits, HPTaskAwoken);
+}
+
+typedef struct {
+    uint32_t eof;//EOF events handled
+    uint32_t vsync;//VSYNC events handled
+} cam_ev_cursor_t;
+
+static void cam_ev_resync(cam_ev_cursor_t *cur)
+{
+    cur->vsync = __atomic_load_n(&cam_obj->ev_vsync_cnt, __ATOMIC_ACQUIRE);
+    cur->eof = __atomic_load_n(&cam_obj->ev_eof_cnt, __ATOMIC_ACQUIRE);
+}
+
+// cam_task fell too far behind: VSYNC marks were overwritten, or (copy mode) DMA
+// wrapped over half buffers not yet copied. Same recovery the queue overflow had.
+static void cam_ev_overflow(cam_ev_cursor_t *cur, bool vsync)
+{
+    ll_cam_stop(cam_obj);
+    cam_set_state(CAM_STATE_IDLE);
+    cam_obj->stats.event_overflow++;
+    ESP_LOGW(TAG, "EV-%s-OVF", vsync ? "VSYNC" : "EOF");
+    cam_ev_resync(cur);
+}
+
+// Next ISR event in arrival order. EOFs counted before a VSYNC's mark are returned
+// before that VSYNC; all pending events are drained before cam_task sleeps again.
+static bool cam_next_event(cam_ev_cursor_t *cur, cam_event_t *cam_event)
+{
+    while (1) {
+        uint32_t vsync = __atomic_load_n(&cam_obj->ev_vsync_cnt, __ATOMIC_ACQUIRE);
+        uint32_t eof;
+
+        if (vsync - cur->vsync > CAM_EV_VSYNC_RING) {
+            cam_ev_overflow(cur, true);
+            return false;
+        }
+        if (vsync != cur->vsync) {
+            eof = cam_obj->ev_vsync_eof[cur->vsync % CAM_EV_VSYNC_RING];
+            if (__atomic_load_n(&cam_obj->ev_vsync_cnt, __ATOMIC_ACQUIRE) - cur->vsync > CAM_EV_VSYNC_RING) {
+                continue;//mark overwritten while reading it
+            }
+        } else {
+            eof = __atomic_load_n(&cam_obj->ev_eof_cnt, __ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&cam_obj->ev_vsync_cnt, __ATOMIC_ACQUIRE) != vsync) {
+                continue;//a VSYNC arrived, some of these EOFs may belong after it
+            }
+        }
+        if (!cam_obj->psram_mode && eof - cur->eof >= cam_obj->dma_half_buffer_cnt) {
+            cam_ev_overflow(cur, false);
+            return false;
+        }
+        if (eof != cur->eof) {
+            cur->eof++;
+            *cam_event = CAM_IN_SUC_EOF_EVENT;
+            return true;
+        }
+        if (vsync != cur->vsync) {
+            cur->vsync++;
+            *cam_event = CAM_VSYNC_EVENT;
+            return true;
+        }
+        return false;
+    }
+}
+
+#if CONFIG_CAMERA_DMA_WATCHDOG
+typedef struct {
+    int64_t progress_us;//last EOF, completed frame or frame start
+    int64_t vsync_us;//last VSYNC handled
+    int64_t period_us;//smoothed VSYNC interval, 0 until measured
+    uint32_t frames;//stats.frames at the last progress
+} cam_wdt_t;
+
+static void cam_wdt_event(cam_wdt_t *wdt, cam_event_t cam_event, cam_state_t prev_state)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (cam_event == CAM_VSYNC_EVENT) {
+        int64_t d = now - wdt->vsync_us;
+        if (wdt->vsync_us && d < CAM_WDT_PERIOD_MAX_US) {
+            wdt->period_us = wdt->period_us ? wdt->period_us + (d - wdt->period_us) / 8 : d;
+        }
+        wdt->vsync_us = now;
+    }
+    // with EOF interrupts enabled a frame can "complete" empty while GDMA is stuck, so only EOFs count
+    bool eof_irq = cam_obj->jpeg_mode || !cam_obj->psram_mode;
+    if (cam_event == CAM_IN_SUC_EOF_EVENT || prev_state != CAM_STATE_READ_BUF ||
+        (!eof_irq && wdt->frames != cam_obj->stats.frames)) {
+        wdt->progress_us = now;
+        wdt->frames = cam_obj->stats.frames;
+    }
+}
+
+// A frame is in flight but GDMA delivered nothing for a few frame times (the IDF
+// GDMA lockup seen while Wi-Fi STA connects): reset the channel and let the next
+// VSYNC start a fresh frame, instead of making cam_take time out.
+static void cam_wdt_recover(cam_wdt_t *wdt, int64_t stalled_us)
+{
+    ll_cam_stop(cam_obj);
+#if CONFIG_IDF_TARGET_ESP32S3
+    ll_cam_dma_reset(cam_obj);
+#endif
+    cam_set_state(CAM_STATE_IDLE);
+    cam_obj->stats.dma_reset++;
+    wdt->progress_us = esp_timer_get_time();
+    ESP_LOGW(TAG, "DMA-WDT: no data for %lld ms, capture re-armed", stalled_us / 1000);
+}
+
+// How long cam_task may sleep; recovers first if the deadline has already passed.
+static TickType_t cam_wdt_wait(cam_wdt_t *wdt)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (!cam_obj->running || cam_obj->state != CAM_STATE_READ_BUF) {
+        wdt->progress_us = now;
+        return portMAX_DELAY;
+    }
+    int64_t limit = MAX((int64_t)CAM_WDT_MIN_US, (int64_t)CONFIG_CAMERA_DMA_WATCHDOG_FRAMES * wdt->period_us);
+    int64_t left = wdt->progress_us + limit - now;
+    if (left <= 0) {
+        cam_wdt_recover(wdt, now - wdt->progress_us);
+        return portMAX_DELAY;
+    }
+    return pdMS_TO_TICKS((left + 999) / 1000) + 1;
+}
+#endif
+
+#if CONFIG_CAMERA_FB_POOL
+// Copy a completed JPEG frame into the smallest free pool slot it fits and give its DMA slot
+// straight back to capture. Returns the slot now holding the frame.
+static int cam_pool_compact(int frame_pos)
+{
+    cam_frame_t *src = &cam_obj->frames[frame_pos];
+    uint32_t end = cam_slot_cnt();
+
+    for (uint32_t x = cam_obj->frame_cnt; x < end; x++) {
+        cam_frame_t *dst = &cam_obj->frames[x];
+        if (dst->cap < src->fb.len || !cam_frame_is_free(x)) {
+            continue;
+        }
+        // only cam_task takes pool slots, cam_give can just set the bit again meanwhile
+        __atomic_fetch_and(&cam_obj->frame_free_mask, ~(1U << x), __ATOMIC_ACQ_REL);
+        uint8_t *buf = dst->fb.buf;
+        memcpy(buf, src->fb.buf, src->fb.len);
+        dst->fb = src->fb;
+        dst->fb.buf = buf;
+        dst->jpeg_eoi = src->jpeg_eoi;
+#if CONFIG_CAMERA_FRAME_TIMING
+        dst->timing = src->timing;
+#endif
+        __atomic_store_n(&dst->refcnt, 1, __ATOMIC_RELEASE);
+        cam_frame_set_free(frame_pos);
+        return x;
+    }
+    cam_obj->stats.pool_miss++;
+    return frame_pos;
+}
+#endif
+
+// Trim a completed frame to its JPEG end marker and hand it to the frame queue or mailbox.
+// The slot must already be marked busy; it is freed again if the frame cannot be queued.
+static void cam_queue_frame(int frame_pos)
+{
+    camera_fb_t *frame_buffer_event = &cam_obj->frames[frame_pos].fb;
+
+    // find the JPEG end marker while the frame tail is still hot, so cam_take
+    // does not have to rescan it. Data after the marker is discarded.
+    if (cam_obj->jpeg_mode && !cam_frame_is_free(frame_pos)) {
+        camera_prof_mark_t mark;
+        camera_prof_begin(&mark);
+        int offset_e = cam_verify_jpeg_eoi(frame_buffer_event->buf, frame_buffer_event->len);
+        camera_prof_end(CAMERA_PROF_EOI, &mark);
+        cam_obj->frames[frame_pos].jpeg_eoi = (offset_e >= 0);
+        if (offset_e >= 0) {
+            frame_buffer_event->len = offset_e + sizeof(JPEG_EOI_MARKER);
+        }
+    }
+    //send frame
+#if CONFIG_CAMERA_FRAME_TIMING
+    cam_obj->frames[frame_pos].timing.queued_us = esp_timer_get_time();
+#endif
+    CAM_TRACE(CAMERA_TRACE_FRAME_QUEUED, frame_pos);
+#if CONFIG_CAMERA_CUT_THROUGH
+    if (cam_obj->jpeg_mode && !cam_frame_is_free(frame_pos) && cam_stream_complete(frame_pos)) {
+        return;
+    }
+#endif
+#if CONFIG_CAMERA_FB_POOL
+    if (cam_obj->jpeg_mode && !cam_frame_is_free(frame_pos) && frame_pos < (int)cam_obj->frame_cnt) {
+        frame_pos = cam_pool_compact(frame_pos);
+        frame_buffer_event = &cam_obj->frames[frame_pos].fb;
+    }
+#endif
+    if (!cam_frame_is_free(frame_pos)) {
+        cam_obj->stats.frames++;
+#if CONFIG_CAMERA_FB_META
+        cam_meta_frame(frame_pos);
+#endif
+    }
+    if (!cam_frame_is_free(frame_pos) && cam_obj->grab_mode == CAMERA_GRAB_NEWEST) {
+        cam_mailbox_post(frame_buffer_event);
+    } else if(!cam_frame_is_free(frame_pos) && xQueueSend(cam_obj->frame_buffer_queue, (void *)&frame_buffer_event, 0) != pdTRUE) {
+        //pop frame buffer from the queue
+        camera_fb_t * fb2 = NULL;
+        if(xQueueReceive(cam_obj->frame_buffer_queue, &fb2, 0) == pdTRUE) {
+            //push the new frame to the end of the queue
+            if (xQueueSend(cam_obj->frame_buffer_queue, (void *)&frame_buffer_event, 0) != pdTRUE) {
+                cam_frame_set_free(frame_pos);
+                cam_obj->stats.fbq_overflow++;
+                ESP_LOGE(TAG, "FBQ-SND");
+            }
+            //free the popped buffer
+            cam_give(fb2);
+            cam_obj->stats.fbq_overflow++;
+        } else {
+            //queue is full and we could not pop a frame from it
+            cam_frame_set_free(frame_pos);
+            cam_obj->stats.fbq_overflow++;
+            ESP_LOGE(TAG, "FBQ-RCV");
+        }
+    }
+}
+
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+// Continuous capture: the VSYNC EOF closed the frame in frames[*frame_pos]. GDMA is relinked to
+// the next free buffer first, while the sensor is still in vertical blanking; the EOI scan and
+// queueing of the finished frame come after. Returns false if no buffer is free.
+static bool cam_continuous_eof(int *frame_pos)
+{
+    int pos = *frame_pos;
+    camera_fb_t *fb = &cam_obj->frames[pos].fb;
+    size_t len = 0;
+    bool handoff = cam_dma_frame_len(cam_obj->frames[pos].dma, cam_obj->dma_node_cnt, &len);
+    bool keep = false;
+
+#if CONFIG_CAMERA_FRAME_TIMING
+    cam_obj->frames[pos].timing.dma_eof_us = cam_obj->eof_isr_us ? cam_obj->eof_isr_us : esp_timer_get_time();
+#endif
+    if (!handoff) {
+        // ran into the next buffer or stopped on a held one: restart at the frame boundary
+        ESP_LOGW(TAG, "FB-OVF");
+        cam_obj->stats.fb_overflow++;
+        cam_obj->stats.dma_restart++;
+    } else if (len) {
+        // an empty EOF (the manual VSYNC after a restart) just re-arms the same buffer
+        fb->len = len;
+        cam_fb_cache_sync(fb, len, false);
+        if (cam_verify_jpeg_soi(fb->buf, len) != 0) {
+            cam_obj->stats.no_soi++;
+        } else {
+            cam_frame_set_busy(pos);
+            keep = true;
+        }
+    }
+
+    bool started = cam_start_frame(frame_pos, handoff);
+    if (started) {
+        cam_obj->frames[*frame_pos].fb.len = 0;
+    } else {
+        ll_cam_stop(cam_obj);
+    }
+    if (keep) {
+        cam_queue_frame(pos);
+    }
+    return started;
+}
+#endif
+
+//Copy fram from DMA dma_buffer to fram dma_buffer
+static void cam_task(void *arg)
+{
+    int cnt = 0;
+    int frame_pos = 0;
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+    int eof_wait = 0;
+#endif
+    cam_set_state(CAM_STATE_IDLE);
+    cam_event_t cam_event = 0;
+    cam_ev_cursor_t cursor;
+    camera_prof_mark_t mark;
+#if CONFIG_CAMERA_DMA_WATCHDOG
+    cam_wdt_t wdt = {0};
+    cam_state_t prev_state;
+#endif
+#if CONFIG_PM_ENABLE
+    bool boosted = false;
+#endif
+
+    cam_ev_resync(&cursor);
+
+    while (1) {
+        if (!cam_next_event(&cursor, &cam_event)) {
+#if CONFIG_PM_ENABLE
+            if (boosted) {
+                esp_pm_lock_release(cam_obj->pm_cpu);
+                boosted = false;
+            }
+#endif
+#if CONFIG_CAMERA_DMA_WATCHDOG
+            xTaskNotifyWait(0, UINT32_MAX, NULL, cam_wdt_wait(&wdt));
+#else
+            xTaskNotifyWait(0, UINT32_MAX, NULL, portMAX_DELAY);
+#endif
+#if CONFIG_CAMERA_CUT_THROUGH && CONFIG_CAMERA_CONTINUOUS_CAPTURE
+            cam_stream_poll(frame_pos);
+#endif
+            continue;
+        }
+#if CONFIG_PM_ENABLE
+        if (!boosted) {
+            // the EOI scan and GDMA relink run in vertical blanking, do them at full speed
+            esp_pm_lock_acquire(cam_obj->pm_cpu);
+            boosted = true;
+        }
+#endif
+        DBG_PIN_SET(1);
+#if CONFIG_CAMERA_DMA_WATCHDOG
+        prev_state = cam_obj->state;
+#endif
+        switch (cam_obj->state) {
+
+            case CAM_STATE_IDLE: {
+                if (cam_event == CAM_VSYNC_EVENT) {
+                    //DBG_PIN_SET(1);
+                    if(cam_start_frame(&frame_pos, false)){
+                        cam_obj->frames[frame_pos].fb.len = 0;
+                        cam_set_state(CAM_STATE_READ_BUF);
+                    }
+                    cnt = 0;
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+                    eof_wait = 0;
+#endif
+                }
+            }
+            break;
+
+            case CAM_STATE_READ_BUF: {
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+                // frames end on the VSYNC EOF, the VSYNC interrupt itself only starts from IDLE
+                if (cam_obj->continuous) {
+                    bool started = true;
+                    if (cam_event == CAM_IN_SUC_EOF_EVENT) {
+                        eof_wait = 0;
+                        started = cam_continuous_eof(&frame_pos);
+                    } else if (++eof_wait > CAM_CONTINUOUS_EOF_WAIT) {
+                        // GDMA stopped in front of a held buffer and never closed the frame
+                        ESP_LOGW(TAG, "FB-OVF");
+                        cam_obj->stats.fb_overflow++;
+                        cam_obj->stats.dma_restart++;
+                        eof_wait = 0;
+                        started = cam_start_frame(&frame_pos, false);
+                        if (started) {
+                            cam_obj->frames[frame_pos].fb.len = 0;
+                        }
+                    }
+                    if (!started) {
+                        cam_set_state(CAM_STATE_IDLE);
+                    }
+                    break;
+                }
+#endif
+                camera_fb_t * frame_buffer_event = &cam_obj->frames[frame_pos].fb;
+                size_t pixels_per_dma = (cam_obj->dma_half_buffer_size * cam_obj->fb_bytes_per_pixel) / (cam_obj->dma_bytes_per_item * cam_obj->in_bytes_per_pixel);
+
+                if (cam_event == CAM_IN_SUC_EOF_EVENT) {
+#if CONFIG_CAMERA_FRAME_TIMING
+                    cam_obj->frames[frame_pos].timing.dma_eof_us = cam_obj->eof_isr_us ? cam_obj->eof_isr_us : esp_timer_get_time();
+#endif
+                    if(!cam_obj->psram_mode){
+                        if (cam_obj->fb_size < (frame_buffer_event->len + pixels_per_dma)) {
+                            ESP_LOGW(TAG, "FB-OVF");
+                            cam_obj->stats.fb_overflow++;
+                            ll_cam_stop(cam_obj);
+                            DBG_PIN_SET(0);
+                            continue;
+                        }
+                        camera_prof_begin(&mark);
+                        frame_buffer_event->len += ll_cam_memcpy(cam_obj,
+                            &frame_buffer_event->buf[frame_buffer_event->len],
+                            &cam_obj->dma_buffer[(cnt % cam_obj->dma_half_buffer_cnt) * cam_obj->dma_half_buffer_size],
+                            cam_obj->dma_half_buffer_size);
+                        camera_prof_end(CAMERA_PROF_COPY, &mark);
+                    }
+                    if (cam_obj->psram_mode && cam_obj->jpeg_mode && cnt == 0) {
+                        cam_fb_cache_sync(frame_buffer_event, cam_obj->dma_half_buffer_size, false);
+                    }
+                    //Check for JPEG SOI in the first buffer. stop if not found
+                    if (cam_obj->jpeg_mode && cnt == 0 && cam_verify_jpeg_soi(frame_buffer_event->buf, frame_buffer_event->len) != 0) {
+                        cam_obj->stats.no_soi++;
+                        ll_cam_stop(cam_obj);
+                        cam_set_state(CAM_STATE_IDLE);
+                    }
+                    cnt++;
+#if CONFIG_CAMERA_CUT_THROUGH
+                    if (cam_obj->psram_mode && cam_obj->jpeg_mode && cam_obj->state == CAM_STATE_READ_BUF) {
+                        // the chain wraps after dma_node_cnt nodes, such a frame is dropped as NO-EOI
+                        cam_stream_progress(frame_pos, MIN((uint32_t)cnt, cam_obj->dma_node_cnt) * cam_obj->dma_half_buffer_size);
+                    }
+#endif
+
+                } else if (cam_event == CAM_VSYNC_EVENT) {
+                    //DBG_PIN_SET(1);
+                    ll_cam_stop(cam_obj);
+
+                    if (cnt || !cam_obj->jpeg_mode || cam_obj->psram_mode) {
+                        if (cam_obj->jpeg_mode) {
+                            if (!cam_obj->psram_mode) {
+                                if (cam_obj->fb_size < (frame_buffer_event->len + pixels_per_dma)) {
+                                    ESP_LOGW(TAG, "FB-OVF");
+                                    cam_obj->stats.fb_overflow++;
+                                    cnt--;
+                                } else {
+                                    camera_prof_begin(&mark);
+                                    frame_buffer_event->len += ll_cam_memcpy(cam_obj,
+                                        &frame_buffer_event->buf[frame_buffer_event->len],
+                                        &cam_obj->dma_buffer[(cnt % cam_obj->dma_half_buffer_cnt) * cam_obj->dma_half_buffer_size],
+                                        cam_obj->dma_half_buffer_size);
+                                    camera_prof_end(CAMERA_PROF_COPY, &mark);
+                                }
+                            }
+                            cnt++;
+                        }
+
+                        cam_frame_set_busy(frame_pos);
+
+                        if (cam_obj->psram_mode) {
+                            if (cam_obj->jpeg_mode) {
+                                // the descriptor chain ends at the last full node, DMA cannot write past it
+                                frame_buffer_event->len = MIN((uint32_t)cnt, cam_obj->dma_node_cnt) * cam_obj->dma_half_buffer_size;
+                            } else {
+                                frame_buffer_event->len = cam_obj->recv_size;
+                            }
+                            cam_fb_cache_sync(frame_buffer_event, frame_buffer_event->len, false);
+                        } else if (!cam_obj->jpeg_mode) {
+                            if (frame_buffer_event->len != cam_obj->fb_size) {
+                                cam_frame_set_free(frame_pos);
+                                ESP_LOGE(TAG, "FB-SIZE: %u != %u", frame_buffer_event->len, (unsigned) cam_obj->fb_size);
+                            }
+                        }
+                        cam_queue_frame(frame_pos);
+                    }
+
+                    if(!cam_start_frame(&frame_pos, false)){
+                        cam_set_state(CAM_STATE_IDLE);
+                    } else {
+                        cam_obj->frames[frame_pos].fb.len = 0;
+                    }
+                    cnt = 0;
+                }
+            }
+            break;
+        }
+#if CONFIG_CAMERA_DMA_WATCHDOG
+        cam_wdt_event(&wdt, cam_event, prev_state);
+#endif
+        DBG_PIN_SET(0);
+    }
+}
+
+static void init_dma_descriptors(lldesc_t *dma, uint32_t count, uint16_t size, uint8_t *buffer)
+{
+    for (int x = 0; x < count; x++) {
+        dma[x].size = size;
+        dma[x].length = 0;
+        dma[x].sosf = 0;
+        dma[x].eof = 0;
+        dma[x].owner = 1;
+        dma[x].buf = (buffer + size * x);
+        dma[x].empty = (uint32_t)&dma[(x + 1) % count];
+    }
+}
+
+static lldesc_t * allocate_dma_descriptors(uint32_t count, uint16_t size, uint8_t * buffer)
+{
+    lldesc_t *dma = (lldesc_t *)heap_caps_malloc(count * sizeof(lldesc_t), MALLOC_CAP_DMA);
+    if (dma == NULL) {
+        return dma;
+    }
+    init_dma_descriptors(dma, count, size, buffer);
+    return dma;
+}
+
+#if CONFIG_CAMERA_FB_POOL
+// Split CONFIG_CAMERA_FB_POOL_SIZE evenly between the size classes, keeping fb_count plus the
+// pool slots within the 32 bits of frame_free_mask. Returns the number of pool slots.
+static uint32_t cam_pool_layout(uint32_t cap[CAM_POOL_CLASSES], uint32_t num[CAM_POOL_CLASSES])
+{
+    size_t budget = (size_t)CONFIG_CAMERA_FB_POOL_SIZE * 1024 / CAM_POOL_CLASSES;
+    uint32_t left = CAM_FB_COUNT_MAX - cam_obj->frame_cnt;
+    uint32_t total = 0;
+
+    for (int c = 0; c < CAM_POOL_CLASSES; c++) {
+        cap[c] = ((cam_obj->fb_size >> (CAM_POOL_CLASSES - c)) + CAM_POOL_ALIGN - 1) & ~(CAM_POOL_ALIGN - 1);
+        num[c] = cap[c] ? budget / cap[c] : 0;
+        total += num[c];
+    }
+    if (total > left) {
+        uint32_t scaled = 0;
+        for (int c = 0; c < CAM_POOL_CLASSES; c++) {
+            num[c] = num[c] * left / total;
+            scaled += num[c];
+        }
+        total = scaled;
+    }
+    return total;
+}
+#endif
+
+static esp_err_t cam_dma_config(const camera_config_t *config)
+{
+    bool ret = ll_cam_dma_sizes(cam_obj);
+    if (0 == ret) {
+        return ESP_FAIL;
+    }
+
+    cam_obj->dma_node_cnt = (cam_obj->dma_buffer_size) / cam_obj->dma_node_buffer_size; // Number of DMA nodes
+    cam_obj->frame_copy_cnt = cam_obj->recv_size / cam_obj->dma_half_buffer_size; // Number of interrupted copies, ping-pong copy
+
+    ESP_LOGI(TAG, "buffer_size: %d, half_buffer_size: %d, node_buffer_size: %d, node_cnt: %d, total_cnt: %d",
+             (int) cam_obj->dma_buffer_size, (int) cam_obj->dma_half_buffer_size, (int) cam_obj->dma_node_buffer_size,
+             (int) cam_obj->dma_node_cnt, (int) cam_obj->frame_copy_cnt);
+
+    cam_obj->dma_buffer = NULL;
+    cam_obj->dma = NULL;
+
+#if CONFIG_CAMERA_FB_POOL
+    uint32_t pool_cap[CAM_POOL_CLASSES];
+    uint32_t pool_num[CAM_POOL_CLASSES];
+    cam_obj->pool = NULL;
+    cam_obj->pool_cnt = cam_obj->jpeg_mode ? cam_pool_layout(pool_cap, pool_num) : 0;
+#endif
+    // cam_task writes the slot table on every event: keep it out of PSRAM unless asked to
+    cam_obj->frames = (cam_frame_t *)heap_caps_aligned_calloc(alignof(cam_frame_t), 1, cam_slot_cnt() * sizeof(cam_frame_t),
+                                                              cam_alloc_caps(CAMERA_ALLOC_CTRL, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    CAM_CHECK(cam_obj->frames != NULL, "frames malloc failed", ESP_FAIL);
+
+    uint8_t dma_align = 0;
+    size_t fb_size = cam_obj->fb_size;
+    if (cam_obj->psram_mode) {
+        dma_align = ll_cam_get_dma_align(cam_obj);
+        if (cam_obj->fb_size < cam_obj->recv_size) {
+            fb_size = cam_obj->recv_size;
+        }
+#if CAM_FB_CACHE_SYNC
+        // cache maintenance works on whole lines: start and end the buffer on a line boundary
+        if (dma_align < CAM_FB_CACHE_LINE) {
+            dma_align = CAM_FB_CACHE_LINE;
+        }
+        fb_size = (fb_size + CAM_FB_CACHE_LINE - 1) & ~(CAM_FB_CACHE_LINE - 1);
+#endif
+    }
+
+    // cam_reconfig() switches frame sizes within these allocations
+    cam_obj->fb_alloc_size = fb_size;
+    cam_obj->dma_buffer_alloc_size = cam_obj->dma_buffer_size;
+    cam_obj->dma_node_alloc_cnt = cam_obj->dma_node_cnt;
+
+    /* Allocate memory for frame buffer */
+    size_t alloc_size = fb_size * sizeof(uint8_t) + dma_align;
+    uint32_t _caps = MALLOC_CAP_8BIT;
+    if (CAMERA_FB_IN_DRAM == config->fb_location) {
+        _caps |= MALLOC_CAP_INTERNAL;
+    } else {
+        _caps |= MALLOC_CAP_SPIRAM;
+    }
+#if CONFIG_CAMERA_FB_POOL
+    uint32_t pool_caps = cam_alloc_caps(CAMERA_ALLOC_FB_POOL, _caps);
+#endif
+    _caps = cam_alloc_caps(CAMERA_ALLOC_FB, _caps);
+    for (int x = 0; x < cam_obj->frame_cnt; x++) {
+        cam_obj->frames[x].dma = NULL;
+        cam_obj->frames[x].fb_offset = 0;
+        ESP_LOGI(TAG, "Allocating %d Byte frame buffer in %s", alloc_size, _caps & MALLOC_CAP_SPIRAM ? "PSRAM" : "OnBoard RAM");
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 3, 0)
+        // In IDF v4.2 and earlier, memory returned by heap_caps_aligned_alloc must be freed using heap_caps_aligned_free.
+        // And heap_caps_aligned_free is deprecated on v4.3.
+        cam_obj->frames[x].fb.buf = (uint8_t *)heap_caps_aligned_alloc(16, alloc_size, _caps);
+#else
+        cam_obj->frames[x].fb.buf = (uint8_t *)heap_caps_malloc(alloc_size, _caps);
+#endif
+        CAM_CHECK(cam_obj->frames[x].fb.buf != NULL, "frame buffer malloc failed", ESP_FAIL);
+        if (cam_obj->psram_mode) {
+            //align PSRAM buffer. TODO: save the offset so proper address can be freed later
+            cam_obj->frames[x].fb_offset = dma_align - ((uint32_t)cam_obj->frames[x].fb.buf & (dma_align - 1));
+            cam_obj->frames[x].fb.buf += cam_obj->frames[x].fb_offset;
+            ESP_LOGI(TAG, "Frame[%d]: Offset: %u, Addr: 0x%08X", x, cam_obj->frames[x].fb_offset, (unsigned) cam_obj->frames[x].fb.buf);
+            cam_obj->frames[x].dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->frames[x].fb.buf);
+            CAM_CHECK(cam_obj->frames[x].dma != NULL, "frame dma malloc failed", ESP_FAIL);
+        }
+        cam_frame_set_free(x);
+    }
+
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+    if (cam_obj->continuous) {
+        // one ring over all frame buffers: a frame running past its buffer continues into the
+        // next one, and the owner check stops it there if the application still holds it
+        for (int x = 0; x < cam_obj->frame_cnt; x++) {
+            cam_obj->frames[x].dma[cam_obj->dma_node_cnt - 1].empty = (uint32_t)&cam_obj->frames[(x + 1) % cam_obj->frame_cnt].dma[0];
+        }
+    }
+#endif
+
+#if CONFIG_CAMERA_FB_POOL
+    if (cam_obj->pool_cnt) {
+        size_t pool_size = 0;
+        for (int c = 0; c < CAM_POOL_CLASSES; c++) {
+            pool_size += pool_cap[c] * pool_num[c];
+        }
+        cam_obj->pool = (uint8_t *)heap_caps_aligned_alloc(CAM_POOL_ALIGN, pool_size, pool_caps);
+        if (cam_obj->pool == NULL) {
+            ESP_LOGW(TAG, "frame pool %d Byte malloc failed, frames stay in their frame buffers", (int) pool_size);
+            cam_obj->pool_cnt = 0;
+        } else {
+            uint32_t x = cam_obj->frame_cnt;
+            uint8_t *buf = cam_obj->pool;
+            for (int c = 0; c < CAM_POOL_CLASSES; c++) {
+                ESP_LOGI(TAG, "frame pool: %u x %u Byte", (unsigned) pool_num[c], (unsigned) pool_cap[c]);
+                for (uint32_t n = 0; n < pool_num[c]; n++, x++) {
+                    cam_obj->frames[x].fb.buf = buf;
+                    cam_obj->frames[x].cap = pool_cap[c];
+                    buf += pool_cap[c];
+                    cam_frame_set_free(x);
+                }
+            }
+        }
+    }
+#endif
+
+    if (!cam_obj->psram_mode) {
+        cam_obj->dma_buffer = (uint8_t *)heap_caps_malloc(cam_obj->dma_buffer_size * sizeof(uint8_t), cam_alloc_caps(CAMERA_ALLOC_DMA_BUF, MALLOC_CAP_DMA));
+        if(NULL == cam_obj->dma_buffer) {
+            ESP_LOGE(TAG,"%s(%d): DMA buffer %d Byte malloc failed, the current largest free block:%d Byte", __FUNCTION__, __LINE__,
+                     (int) cam_obj->dma_buffer_size, (int) heap_caps_get_largest_free_block(MALLOC_CAP_DMA));
+            return ESP_FAIL;
+        }
+
+        cam_obj->dma = allocate_dma_descriptors(cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->dma_buffer);
+        CAM_CHECK(cam_obj->dma != NULL, "dma malloc failed", ESP_FAIL);
+    }
+
+    return ESP_OK;
+}
+
+void cam_set_alloc_caps(camera_alloc_t what, uint32_t caps)
+{
+    s_cam_alloc_caps[what] = caps;
+}
+
+uint32_t cam_alloc_caps(camera_alloc_t what, uint32_t def)
+{
+    return s_cam_alloc_caps[what] ? s_cam_alloc_caps[what] : def;
+}
+
+esp_err_t cam_init(const camera_config_t *config)
+{
+    CAM_CHECK(NULL != config, "config pointer is invalid", ESP_ERR_INVALID_ARG);
+    // the swap pairs bytes of the stream: only meaningful for 2 byte pixels that reach the
+    // frame buffer as captured, it would break JPEG data and the YUV422 to GRAYSCALE copy
+    if (config->swap_bytes) {
+#if CONFIG_IDF_TARGET_ESP32
+        CAM_CHECK(false, "byte swap is not supported on ESP32", ESP_ERR_NOT_SUPPORTED);
+#endif
+        CAM_CHECK(config->pixel_format == PIXFORMAT_RGB565 || config->pixel_format == PIXFORMAT_YUV422,
+                  "byte swap needs RGB565 or YUV422", ESP_ERR_INVALID_ARG);
+    }
+
+    esp_err_t ret = ESP_OK;
+    cam_obj = (cam_obj_t *)heap_caps_aligned_calloc(alignof(cam_obj_t), 1, sizeof(cam_obj_t),
+                                                    cam_alloc_caps(CAMERA_ALLOC_CTRL, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    CAM_CHECK(NULL != cam_obj, "lcd_cam object malloc error", ESP_ERR_NO_MEM);
+#if CONFIG_CAMERA_FB_META
+    portMUX_INITIALIZE(&cam_obj->meta_lock);
+#endif
+#if CONFIG_CAMERA_CUT_THROUGH
+    portMUX_INITIALIZE(&cam_obj->stream_lock);
+#endif
+
+#if CONFIG_PM_ENABLE
+    ret = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "cam", &cam_obj->pm_apb);
+    CAM_CHECK_GOTO(ret == ESP_OK, "pm lock create failed", err);
+    ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "cam_task", &cam_obj->pm_cpu);
+    CAM_CHECK_GOTO(ret == ESP_OK, "pm lock create failed", err);
+#endif
+
+    cam_obj->swap_data = config->swap_bytes;
+    cam_obj->vsync_pin = config->pin_vsync;
+    cam_obj->vsync_invert = true;
+
+    ll_cam_set_pin(cam_obj, config);
+    ret = ll_cam_config(cam_obj, config);
+    CAM_CHECK_GOTO(ret == ESP_OK, "ll_cam initialize failed", err);
+
+#if CAMERA_DBG_PIN_ENABLE
+    PIN_FUNC_SELECT(GPIO_PIN_MUX_REG[DBG_PIN_NUM], PIN_FUNC_GPIO);
+    gpio_set_direction(DBG_PIN_NUM, GPIO_MODE_OUTPUT);
+    gpio_set_pull_mode(DBG_PIN_NUM, GPIO_FLOATING);
+#endif
+
+    ESP_LOGI(TAG, "cam init ok");
+    return ESP_OK;
+
+err:
+#if CONFIG_PM_ENABLE
+    if (cam_obj->pm_apb) {
+        esp_pm_lock_delete(cam_obj->pm_apb);
+    }
+    if (cam_obj->pm_cpu) {
+        esp_pm_lock_delete(cam_obj->pm_cpu);
+    }
+#endif
+    free(cam_obj);
+    cam_obj = NULL;
+    return ESP_FAIL;
+}
+
+static void cam_set_frame_size(framesize_t frame_size)
+{
+    cam_obj->width = resolution[frame_size].width;
+    cam_obj->height = resolution[frame_size].height;
+
+    if(cam_obj->jpeg_mode){
+#ifdef CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE_AUTO
+        cam_obj->recv_size = cam_obj->width * cam_obj->height / 5;
+#else
+        cam_obj->recv_size = CONFIG_CAMERA_JPEG_MODE_FRAME_SIZE;
+#endif
+        cam_obj->fb_size = cam_obj->recv_size;
+    } else {
+        cam_obj->recv_size = cam_obj->width * cam_obj->height * cam_obj->in_bytes_per_pixel;
+        cam_obj->fb_size = cam_obj->width * cam_obj->height * cam_obj->fb_bytes_per_pixel;
+    }
+}
+
+esp_err_t cam_config(const camera_config_t *config, framesize_t frame_size, uint16_t sensor_pid)
+{
+    CAM_CHECK(NULL != config, "config pointer is invalid", ESP_ERR_INVALID_ARG);
+    esp_err_t ret = ESP_OK;
+
+    ret = ll_cam_set_sample_mode(cam_obj, (pixformat_t)config->pixel_format, config->xclk_freq_hz, sensor_pid);
+    CAM_CHECK_GOTO(ret == ESP_OK, "ll_cam_set_sample_mode failed", err);
+    
+    cam_obj->jpeg_mode = config->pixel_format == PIXFORMAT_JPEG;
+#if CONFIG_IDF_TARGET_ESP32
+    cam_obj->psram_mode = false;
+#else
+    cam_obj->psram_mode = (config->xclk_freq_hz == 16000000);
+#endif
+#if CONFIG_CAMERA_JPEG_DMA_TO_PSRAM
+    // let GDMA write JPEG data straight into the PSRAM frame buffer instead of ping-pong copying it
+    if (cam_obj->jpeg_mode && config->fb_location == CAMERA_FB_IN_PSRAM) {
+        cam_obj->psram_mode = true;
+    }
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+    cam_obj->continuous = cam_obj->jpeg_mode && cam_obj->psram_mode;
+#endif
+    // the DMA channel was configured for internal RAM at init, redo it for external memory
+    if (cam_obj->psram_mode) {
+        ll_cam_dma_reset(cam_obj);
+    }
+#endif
+    CAM_CHECK_GOTO(config->fb_count >= 1 && config->fb_count <= CAM_FB_COUNT_MAX, "fb_count must be 1..32", err);
+    cam_obj->frame_cnt = config->fb_count;
+    cam_set_frame_size(frame_size);
+
+    ret = cam_dma_config(config);
+    CAM_CHECK_GOTO(ret == ESP_OK, "cam_dma_config failed", err);
+
+    size_t frame_buffer_queue_len = cam_slot_cnt();
+    if (config->grab_mode == CAMERA_GRAB_LATEST && frame_buffer_queue_len > 1) {
+        frame_buffer_queue_len--;
+    }
+#if CONFIG_CAMERA_TASK_STATIC
+    cam_obj->frame_buffer_queue = xQueueCreateStatic(frame_buffer_queue_len, sizeof(camera_fb_t*),
+                                                     s_cam_fb_queue_storage, &s_cam_fb_queue);
+#else
+    cam_obj->frame_buffer_queue = xQueueCreate(frame_buffer_queue_len, sizeof(camera_fb_t*));
+#endif
+    CAM_CHECK_GOTO(cam_obj->frame_buffer_queue != NULL, "frame_buffer_queue create failed", err);
+
+    cam_obj->grab_mode = config->grab_mode;
+    cam_obj->mailbox = NULL;
+    if (cam_obj->grab_mode == CAMERA_GRAB_NEWEST) {
+#if CONFIG_CAMERA_TASK_STATIC
+        cam_obj->mailbox_sem = xSemaphoreCreateBinaryStatic(&s_cam_mailbox_sem);
+#else
+        cam_obj->mailbox_sem = xSemaphoreCreateBinary();
+#endif
+        CAM_CHECK_GOTO(cam_obj->mailbox_sem != NULL, "mailbox_sem create failed", err);
+    }
+#if CONFIG_CAMERA_CUT_THROUGH
+    cam_obj->stream_state = CAM_STREAM_IDLE;
+#if CONFIG_CAMERA_TASK_STATIC
+    cam_obj->stream_sem = xSemaphoreCreateBinaryStatic(&s_cam_stream_sem);
+#else
+    cam_obj->stream_sem = xSemaphoreCreateBinary();
+#endif
+    CAM_CHECK_GOTO(cam_obj->stream_sem != NULL, "stream_sem create failed", err);
+#endif
+
+    ret = ll_cam_init_isr(cam_obj);
+    CAM_CHECK_GOTO(ret == ESP_OK, "cam intr alloc failed", err);
+
+
+#if CONFIG_CAMERA_TASK_STATIC
+    cam_obj->task_handle = xTaskCreateStaticPinnedToCore(cam_task, "cam_task", CAM_TASK_STACK, NULL, configMAX_PRIORITIES - 2,
+                                                         s_cam_task_stack, &s_cam_task_tcb, CAM_TASK_CORE);
+#else
+    xTaskCreatePinnedToCore(cam_task, "cam_task", CAM_TASK_STACK, NULL, configMAX_PRIORITIES - 2, &cam_obj->task_handle, CAM_TASK_CORE);
+#endif
+
+    ESP_LOGI(TAG, "cam config ok");
+    return ESP_OK;
+
+err:
+    cam_deinit();
+    return ESP_FAIL;
+}
+
+// The ring sizes of a frame size, derived the way cam_dma_config does; false if they do not fit
+// the buffers and descriptors allocated there
+static bool cam_dma_fits(void)
+{
+    if (!ll_cam_dma_sizes(cam_obj)) {
+        return false;
+    }
+    cam_obj->dma_node_cnt = cam_obj->dma_buffer_size / cam_obj->dma_node_buffer_size;
+    cam_obj->frame_copy_cnt = cam_obj->recv_size / cam_obj->dma_half_buffer_size;
+    if (cam_obj->fb_size > cam_obj->fb_alloc_size || cam_obj->dma_node_cnt > cam_obj->dma_node_alloc_cnt) {
+        return false;
+    }
+    if (cam_obj->psram_mode) {
+        return cam_obj->recv_size <= cam_obj->fb_alloc_size;// the frame chains point into the frame buffers
+    }
+    return cam_obj->dma_buffer_size <= cam_obj->dma_buffer_alloc_size;
+}
+
+esp_err_t cam_reconfig(framesize_t frame_size)
+{
+    if (cam_obj->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint16_t width = cam_obj->width;
+    uint16_t height = cam_obj->height;
+    uint32_t recv_size = cam_obj->recv_size;
+    uint32_t fb_size = cam_obj->fb_size;
+
+    cam_set_frame_size(frame_size);
+    if (cam_obj->jpeg_mode) {
+        // recv_size is the slot capacity, not the image size: a smaller frame keeps the larger
+        // slots, and the DMA ring (or the continuous frame chains) stays linked as it is
+        bool fits = cam_obj->recv_size <= recv_size;
+        cam_obj->recv_size = recv_size;
+        cam_obj->fb_size = fb_size;
+        if (!fits) {
+            cam_obj->width = width;
+            cam_obj->height = height;
+            ESP_LOGE(TAG, "%ux%u needs more than the %u Byte JPEG buffers", resolution[frame_size].width,
+                     resolution[frame_size].height, (unsigned) recv_size);
+            return ESP_ERR_INVALID_SIZE;
+        }
+    } else {
+        if (!cam_dma_fits()) {
+            ESP_LOGE(TAG, "%ux%u does not fit the allocated frame buffers", resolution[frame_size].width, resolution[frame_size].height);
+            cam_obj->width = width;
+            cam_obj->height = height;
+            cam_obj->recv_size = recv_size;
+            cam_obj->fb_size = fb_size;
+            cam_dma_fits();// the old size fitted, this only restores its ring sizes
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (cam_obj->psram_mode) {
+            for (int x = 0; x < cam_obj->frame_cnt; x++) {
+                init_dma_descriptors(cam_obj->frames[x].dma, cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->frames[x].fb.buf);
+            }
+        } else {
+            init_dma_descriptors(cam_obj->dma, cam_obj->dma_node_cnt, cam_obj->dma_node_buffer_size, cam_obj->dma_buffer);
+        }
+    }
+
+    // frames still queued were captured at the old size, the caller labels them with the new one
+    camera_fb_t *fb = __atomic_exchange_n(&cam_obj->mailbox, NULL, __ATOMIC_ACQ_REL);
+    if (fb) {
+        cam_give(fb);
+    }
+    while (xQueueReceive(cam_obj->frame_buffer_queue, &fb, 0) == pdTRUE) {
+        cam_give(fb);
+    }
+    ESP_LOGI(TAG, "cam reconfig %ux%u", cam_obj->width, cam_obj->height);
+    return ESP_OK;
+}
+
+#if CONFIG_CAMERA_TASK_STATIC
+static void cam_task_delete(void *arg)
+{
+    vTaskDelete((TaskHandle_t)arg);
+}
+#endif
+
+esp_err_t cam_deinit(void)
+{
+    if (!cam_obj) {
+        return ESP_FAIL;
+    }
+
+    cam_stop();
+    if (cam_obj->task_handle) {
+#if CONFIG_CAMERA_TASK_STATIC
+        // deleted from its own core, where it cannot be running, so the delete completes before
+        // the static stack and TCB are reused by the next cam_init()
+        esp_ipc_call_blocking(CAM_TASK_CORE, cam_task_delete, cam_obj->task_handle);
+#else
+        vTaskDelete(cam_obj->task_handle);
+#endif
+        cam_obj->task_handle = NULL;
+    }
+    if (cam_obj->frame_buffer_queue) {
+        vQueueDelete(cam_obj->frame_buffer_queue);
+    }
+    if (cam_obj->mailbox_sem) {
+        vSemaphoreDelete(cam_obj->mailbox_sem);
+    }
+#if CONFIG_CAMERA_CUT_THROUGH
+    if (cam_obj->stream_sem) {
+        vSemaphoreDelete(cam_obj->stream_sem);
+    }
+#endif
+
+    ll_cam_deinit(cam_obj);
+#if CONFIG_PM_ENABLE
+    if (cam_obj->pm_apb) {
+        esp_pm_lock_delete(cam_obj->pm_apb);
+    }
+    if (cam_obj->pm_cpu) {
+        // cam_task was deleted above, possibly while holding it
+        esp_pm_lock_release(cam_obj->pm_cpu);
+        esp_pm_lock_delete(cam_obj->pm_cpu);
+    }
+#endif
+
+    if (cam_obj->dma) {
+        free(cam_obj->dma);
+    }
+    if (cam_obj->dma_buffer) {
+        free(cam_obj->dma_buffer);
+    }
+    if (cam_obj->frames) {
+        for (int x = 0; x < cam_obj->frame_cnt; x++) {
+            free(cam_obj->frames[x].fb.buf - cam_obj->frames[x].fb_offset);
+            if (cam_obj->frames[x].dma) {
+                free(cam_obj->frames[x].dma);
+            }
+        }
+        free(cam_obj->frames);
+#if CONFIG_CAMERA_FB_POOL
+        free(cam_obj->pool);
+#endif
+    }
+
+    free(cam_obj);
+    cam_obj = NULL;
+    return ESP_OK;
+}
+
+void cam_stop(void)
+{
+    bool was_running = cam_obj->running;
+
+    cam_obj->running = false;
+    ll_cam_vsync_intr_enable(cam_obj, false);
+    ll_cam_stop(cam_obj);
+#if CONFIG_PM_ENABLE
+    if (was_running) {
+        esp_pm_lock_release(cam_obj->pm_apb);
+    }
+#else
+    (void)was_running;
+#endif
+}
+
+bool cam_is_running(void)
+{
+    return cam_obj->running;
+}
+
+void cam_start(void)
+{
+    if (cam_obj->running) {
+        return;
+    }
+#if CONFIG_PM_ENABLE
+    // APB must stay at 80 MHz before XCLK and PCLK sampling resume
+    esp_pm_lock_acquire(cam_obj->pm_apb);
+#endif
+    cam_obj->running = true;
+    ll_cam_vsync_intr_enable(cam_obj, true);
+}
+
+camera_fb_t *cam_take(TickType_t timeout)
+{
+    camera_fb_t *dma_buffer = NULL;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t remaining = timeout;
+
+    CAM_TRACE(CAMERA_TRACE_TAKE_BEGIN, timeout);
+    for (int retry = 0; retry <= CAM_TAKE_NO_EOI_RETRY; retry++) {
+        dma_buffer = cam_receive(remaining);
+#if CONFIG_IDF_TARGET_ESP32S3 && !CONFIG_CAMERA_DMA_WATCHDOG
+        // With CONFIG_CAMERA_DMA_WATCHDOG cam_task resets a stalled GDMA within a few frames instead.
+        // Currently (22.01.2024) there is a bug in ESP-IDF v5.2, that causes
+        // GDMA to fall into a strange state if it is running while WiFi STA is connecting.
+        // This code tries to reset GDMA if frame is not received, to try and help with
+        // this case. It is possible to have some side effects too, though none come to mind
+        if (!dma_buffer) {
+            ll_cam_dma_reset(cam_obj);
+            dma_buffer = cam_receive(remaining);
+        }
+#endif
+        if (!dma_buffer) {
+            CAM_TRACE(CAMERA_TRACE_TAKE_END, 0);
+            ESP_LOGW(TAG, "Failed to get the frame on time!");
+// #if CONFIG_IDF_TARGET_ESP32S3
+//             ll_cam_dma_print_state(cam_obj);
+// #endif
+            return NULL;
+        }
+
+        cam_frame_t *frame = __containerof(dma_buffer, cam_frame_t, fb);
+#if CONFIG_CAMERA_FRAME_TIMING
+        frame->timing.dequeued_us = esp_timer_get_time();
+#endif
+        if (cam_obj->jpeg_mode) {
+            // the end marker was located by cam_task and len already trimmed to it
+            if (!frame->jpeg_eoi) {
+                ESP_LOGW(TAG, "NO-EOI");
+                CAM_TRACE(CAMERA_TRACE_TAKE_NO_EOI, cam_frame_index(dma_buffer));
+                cam_obj->stats.no_eoi++;
+                cam_give(dma_buffer);
+                TickType_t ticks_spent = xTaskGetTickCount() - start;
+                if (ticks_spent >= timeout) {
+                    CAM_TRACE(CAMERA_TRACE_TAKE_END, 0);
+                    return NULL; /* We are out of time */
+                }
+                remaining = timeout - ticks_spent;
+                continue;
+            }
+        } else if (cam_obj->psram_mode && cam_obj->in_bytes_per_pixel != cam_obj->fb_bytes_per_pixel) {
+            //currently this is used only for YUV to GRAYSCALE
+            dma_buffer->len = ll_cam_memcpy(cam_obj, dma_buffer->buf, dma_buffer->buf, dma_buffer->len);
+        }
+#if CONFIG_CAMERA_FRAME_TIMING
+        frame->timing.taken_us = esp_timer_get_time();
+#endif
+        CAM_TRACE(CAMERA_TRACE_TAKE_END, dma_buffer->len);
+        return dma_buffer;
+    }
+
+    CAM_TRACE(CAMERA_TRACE_TAKE_END, 0);
+    ESP_LOGW(TAG, "NO-EOI on %d frames in a row", CAM_TAKE_NO_EOI_RETRY + 1);
+    return NULL;
+}
+
+camera_fb_t *cam_ref(camera_fb_t *dma_buffer)
+{
+    int pos = cam_frame_index(dma_buffer);
+    if (pos < 0) {
+        return NULL;
+    }
+    uint32_t *refcnt = &cam_obj->frames[pos].refcnt;
+    uint32_t old = __atomic_load_n(refcnt, __ATOMIC_RELAXED);
+    do {
+        if (old == 0) {
+            return NULL; // already back in the DMA pool
+        }
+    } while (!__atomic_compare_exchange_n(refcnt, &old, old + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    return dma_buffer;
+}
+
+void cam_give(camera_fb_t *dma_buffer)
+{
+    int pos = cam_frame_index(dma_buffer);
+    if (pos < 0) {
+        return;
+    }
+    uint32_t *refcnt = &cam_obj->frames[pos].refcnt;
+    uint32_t old = __atomic_load_n(refcnt, __ATOMIC_RELAXED);
+    do {
+        if (old == 0) {
+            return; // double return, the slot is already free
+        }
+    } while (!__atomic_compare_exchange_n(refcnt, &old, old - 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    // the last reference hands the slot back to DMA
+    if (old == 1) {
+        cam_frame_set_free(pos);
+    }
+}
+
+void cam_give_all(void) {
+    __atomic_store_n(&cam_obj->mailbox, NULL, __ATOMIC_RELAXED);
+    for (int x = 0; x < cam_slot_cnt(); x++) {
+        __atomic_store_n(&cam_obj->frames[x].refcnt, 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&cam_obj->frame_free_mask, (uint32_t)((1ULL << cam_slot_cnt()) - 1), __ATOMIC_RELEASE);
+}
+
+// Replay: with capture stopped, copy a JPEG into a free slot and queue it the way cam_task would,
+// so references, timing and the frame queue or mailbox behave as for a captured frame
+esp_err_t cam_inject(const uint8_t *data, size_t len, TickType_t timeout)
+{
+    if (cam_obj->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!cam_obj->jpeg_mode) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (len > cam_obj->fb_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    int pos = -1;
+    while (pos < 0) {
+        uint32_t mask = __atomic_load_n(&cam_obj->frame_free_mask, __ATOMIC_ACQUIRE) & cam_dma_slot_mask();
+        if (mask != 0) {
+            int p = __builtin_ctz(mask);
+            if (__atomic_fetch_and(&cam_obj->frame_free_mask, ~(1U << p), __ATOMIC_ACQ_REL) & (1U << p)) {
+                pos = p;
+            }
+            continue;
+        }
+        // slots come back from cam_give on other tasks, nothing to block on
+        if (xTaskGetTickCount() - start >= timeout) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+    }
+
+    cam_frame_t *frame = &cam_obj->frames[pos];
+    uint64_t us = (uint64_t)esp_timer_get_time();
+    __atomic_store_n(&frame->refcnt, 1, __ATOMIC_RELEASE);
+    frame->fb.timestamp.tv_sec = us / 1000000UL;
+    frame->fb.timestamp.tv_usec = us % 1000000UL;
+#if CONFIG_CAMERA_FRAME_TIMING
+    memset(&frame->timing, 0, sizeof(camera_fb_timing_t));
+    frame->timing.vsync_us = (int64_t)us;
+#endif
+    memcpy(frame->fb.buf, data, len);
+    frame->fb.len = len;
+#if CONFIG_CAMERA_FRAME_TIMING
+    frame->timing.dma_eof_us = esp_timer_get_time();        // the copy stands in for sensor readout and DMA
+#endif
+    cam_queue_frame(pos);
+    return ESP_OK;
+}
+
+esp_err_t cam_get_timing(const camera_fb_t *fb, camera_fb_timing_t *timing)
+{
+#if CONFIG_CAMERA_FRAME_TIMING
+    int pos = cam_frame_index(fb);
+    if (pos < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *timing = cam_obj->frames[pos].timing;
+    return ESP_OK;
+#else
+    (void)fb;
+    (void)timing;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void cam_get_stats(camera_stats_t *stats)
+{
+    *stats = cam_obj->stats;
+}
+
+size_t cam_get_fb_size(void)
+{
+    return cam_obj->fb_size;
+}
+
+void cam_set_meta_task(TaskHandle_t task)
+{
+#if CONFIG_CAMERA_FB_META
+    cam_obj->meta_task = task;
+#else
+    (void)task;
+#endif
+}
+
+void cam_set_meta(const camera_fb_meta_t *meta, uint32_t frame)
+{
+#if CONFIG_CAMERA_FB_META
+    portENTER_CRITICAL(&cam_obj->meta_lock);
+    cam_obj->meta = *meta;
+    cam_obj->meta_frame = frame;
+    portEXIT_CRITICAL(&cam_obj->meta_lock);
+#else
+    (void)meta;
+    (void)frame;
+#endif
+}
+
+esp_err_t cam_get_meta(const camera_fb_t *fb, camera_fb_meta_t *meta)
+{
+#if CONFIG_CAMERA_FB_META
+    int pos = cam_frame_index(fb);
+    if (pos < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *meta = cam_obj->frames[pos].meta;
+    return meta->count ? ESP_OK : ESP_ERR_NOT_FOUND;
+#else
+    (void)fb;
+    (void)meta;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+#if CONFIG_CAMERA_CUT_THROUGH
+// wait until cam_task moves the stream out of state
+static bool cam_stream_wait_state(cam_stream_state_t state, TickType_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (cam_obj->stream_state == state) {
+        TickType_t spent = xTaskGetTickCount() - start;
+        if (spent >= timeout || xSemaphoreTake(cam_obj->stream_sem, timeout - spent) != pdTRUE) {
+            return cam_obj->stream_state != state;
+        }
+    }
+    return true;
+}
+#endif
+
+esp_err_t cam_stream_begin(camera_fb_t **fb, TickType_t timeout)
+{
+#if CONFIG_CAMERA_CUT_THROUGH
+    if (!cam_obj->jpeg_mode || !cam_obj->psram_mode) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    cam_stream_state_t state = cam_obj->stream_state;
+    if (state == CAM_STREAM_WAIT || state == CAM_STREAM_ACTIVE || state == CAM_STREAM_DONE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // a frame that completed in the meantime is older than the one in capture, but complete
+    camera_fb_t *done = NULL;
+    camera_fb_t *queued;
+    while ((queued = cam_receive(0)) != NULL) {
+        if (!__containerof(queued, cam_frame_t, fb)->jpeg_eoi) {
+            cam_obj->stats.no_eoi++;
+            cam_give(queued);
+            continue;
+        }
+        if (done) {
+            cam_give(done);
+            cam_obj->stats.superseded++;
+        }
+        done = queued;
+    }
+    if (done) {
+        portENTER_CRITICAL(&cam_obj->stream_lock);
+        cam_obj->stream_pos = cam_frame_index(done);
+        cam_obj->stream_avail = done->len;
+        cam_obj->stream_state = CAM_STREAM_DONE;
+        portEXIT_CRITICAL(&cam_obj->stream_lock);
+        *fb = done;
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(cam_obj->stream_sem, 0);
+    portENTER_CRITICAL(&cam_obj->stream_lock);
+    cam_obj->stream_state = CAM_STREAM_WAIT;
+    portEXIT_CRITICAL(&cam_obj->stream_lock);
+    if (!cam_stream_wait_state(CAM_STREAM_WAIT, timeout)) {
+        portENTER_CRITICAL(&cam_obj->stream_lock);
+        state = cam_obj->stream_state;
+        if (state == CAM_STREAM_WAIT) {
+            cam_obj->stream_state = CAM_STREAM_IDLE;
+        }
+        portEXIT_CRITICAL(&cam_obj->stream_lock);
+        if (state == CAM_STREAM_WAIT) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    *fb = &cam_obj->frames[cam_obj->stream_pos].fb;
+    return ESP_OK;
+#else
+    (void)fb;
+    (void)timeout;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t cam_stream_wait(camera_fb_t *fb, size_t *avail, TickType_t timeout)
+{
+#if CONFIG_CAMERA_CUT_THROUGH
+    if (cam_frame_index(fb) != cam_obj->stream_pos) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    TickType_t start = xTaskGetTickCount();
+    while (1) {
+        portENTER_CRITICAL(&cam_obj->stream_lock);
+        cam_stream_state_t state = cam_obj->stream_state;
+        size_t ready = cam_obj->stream_avail;
+        if (state == CAM_STREAM_DONE || state == CAM_STREAM_DROPPED) {
+            cam_obj->stream_state = CAM_STREAM_IDLE;
+        }
+        portEXIT_CRITICAL(&cam_obj->stream_lock);
+
+        if (state == CAM_STREAM_DROPPED) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (state == CAM_STREAM_DONE) {
+            // the reader now owns the frame like one from cam_take
+            *avail = ready;
+            return ESP_OK;
+        }
+        if (state != CAM_STREAM_ACTIVE) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (ready > *avail) {
+            *avail = ready;
+            return ESP_ERR_NOT_FINISHED;
+        }
+        TickType_t spent = xTaskGetTickCount() - start;
+        if (spent >= timeout || xSemaphoreTake(cam_obj->stream_sem, timeout - spent) != pdTRUE) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+#else
+    (void)fb;
+    (void)avail;
+    (void)timeout;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void cam_stream_cancel(camera_fb_t *fb)
+{
+#if CONFIG_CAMERA_CUT_THROUGH
+    bool give = false;
+
+    portENTER_CRITICAL(&cam_obj->stream_lock);
+    switch (cam_obj->stream_state) {
+    case CAM_STREAM_ACTIVE:
+        // cam_task still writes the frame, it goes to the frame queue when complete
+        cam_obj->stream_state = CAM_STREAM_CANCEL;
+        break;
+    case CAM_STREAM_DONE:
+        give = true;
+        cam_obj->stream_state = CAM_STREAM_IDLE;
+        break;
+    case CAM_STREAM_CANCEL:
+        break;
+    default:
+        cam_obj->stream_state = CAM_STREAM_IDLE;
+        break;
+    }
+    portEXIT_CRITICAL(&cam_obj->stream_lock);
+    if (give && fb) {
+        cam_give(fb);
+    }
+#else
+    (void)fb;
+#endif
+}
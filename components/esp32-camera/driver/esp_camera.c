@@ -0,0 +1,1098 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "time.h"
+#include "sys/param.h"
+#include "sys/time.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/gpio.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "sensor.h"
+#include "sccb.h"
+#include "cam_hal.h"
+#include "esp_camera.h"
+#include "xclk.h"
+#if CONFIG_OV2640_SUPPORT
+#include "ov2640.h"
+#endif
+#if CONFIG_OV7725_SUPPORT
+#include "ov7725.h"
+#endif
+#if CONFIG_OV3660_SUPPORT
+#include "ov3660.h"
+#endif
+#if CONFIG_OV5640_SUPPORT
+#include "ov5640.h"
+#endif
+#if CONFIG_NT99141_SUPPORT
+#include "nt99141.h"
+#endif
+#if CONFIG_OV7670_SUPPORT
+#include "ov7670.h"
+#endif
+#if CONFIG_GC2145_SUPPORT
+#include "gc2145.h"
+#endif
+#if CONFIG_GC032A_SUPPORT
+#include "gc032a.h"
+#endif
+#if CONFIG_GC0308_SUPPORT
+#include "gc0308.h"
+#endif
+#if CONFIG_BF3005_SUPPORT
+#include "bf3005.h"
+#endif
+#if CONFIG_BF20A6_SUPPORT
+#include "bf20a6.h"
+#endif
+#if CONFIG_SC101IOT_SUPPORT
+#include "sc101iot.h"
+#endif
+#if CONFIG_SC030IOT_SUPPORT
+#include "sc030iot.h"
+#endif
+#if CONFIG_SC031GS_SUPPORT
+#include "sc031gs.h"
+#endif
+#if CONFIG_MEGA_CCM_SUPPORT
+#include "mega_ccm.h"
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define TAG ""
+#else
+#include "esp_log.h"
+static const char *TAG = "camera";
+#endif
+
+#if CONFIG_CAMERA_JPEG_QUALITY_GOVERNOR
+// JPEG quality governor: compress busy scenes harder before they outgrow the frame
+// buffer (FB-OVF / NO-EOI drops) and give the quality back once frames shrink.
+// It is an offset on top of the quality last set through the sensor API, so
+// application rate control keeps working and the governor only adds headroom.
+#define GOV_HIGH_PCT               85 // frame above this share of the buffer: back off
+#define GOV_LOW_PCT                60 // frames below this share count towards recovery
+#define GOV_STEP_UP                2  // quality units per back-off, doubled after a real overflow
+#define GOV_RECOVER_FRAMES         30 // consecutive small frames before one unit is given back
+#define GOV_SETTLE_FRAMES          2  // frames skipped after a change while the sensor applies it
+#define GOV_QUALITY_MAX            63
+
+typedef struct {
+    int (*set_quality)(sensor_t *sensor, int quality);//sensor driver's own setter
+    int requested;//quality last set through the sensor API
+    int offset;//quality units added by the governor
+    int calm;//consecutive frames below GOV_LOW_PCT
+    int settle;
+    uint32_t overflows;//fb_overflow + no_eoi seen so far
+    uint32_t backoffs;
+} camera_gov_t;
+#endif
+
+#if CONFIG_CAMERA_FB_META
+#define META_TASK_STACK            2048
+
+typedef struct {
+    TaskHandle_t task;
+    uint8_t count;
+    uint16_t reg[CAMERA_FB_META_REGS_MAX];
+} camera_meta_t;
+
+// default samples: exposure, gain and AWB gains, register format of sensor_t::get_reg()
+static const uint16_t ov2640_meta_regs[] = {
+    0x145, 0x110, 0x104,        // AEC[15:10], AEC[9:2], AEC[1:0] (sensor bank)
+    0x100,                      // AGC gain
+    0x101, 0x102,               // AWB blue and red channel gain
+};
+
+static const uint16_t ov5640_meta_regs[] = {
+    0x3500, 0x3501, 0x3502,     // exposure[19:0], low 4 bits fractional
+    0x350A, 0x350B,             // AGC gain[9:0]
+    0x3400, 0x3401, 0x3402, 0x3403, 0x3404, 0x3405, // AWB red, green, blue gain[11:0]
+};
+#endif
+
+#if CONFIG_CAMERA_PROBE_CACHE
+#define PROBE_CACHE_NVS_NAMESPACE  "camera"
+#define PROBE_CACHE_NVS_KEY        "probe"
+
+// sensor found by the last successful esp_camera_init(), tried before the full SCCB scan
+typedef struct {
+    uint8_t slv_addr;
+    uint8_t sensor;//index into g_sensors
+    uint16_t pid;
+} camera_probe_cache_t;
+#endif
+
+typedef struct {
+    sensor_t sensor;
+    camera_fb_t fb;
+    SemaphoreHandle_t sensor_lock;//recursive, serializes sensor register access with the driver tasks
+    camera_config_t config;//as applied, frame_size clamped to the sensor; updated by esp_camera_reconfigure()
+    camera_model_t model;
+#if CONFIG_CAMERA_JPEG_QUALITY_GOVERNOR
+    camera_gov_t gov;
+#endif
+#if CONFIG_CAMERA_FB_META
+    camera_meta_t meta;
+#endif
+#if CONFIG_CAMERA_PROBE_CACHE
+    camera_probe_cache_t probe;
+#endif
+} camera_state_t;
+
+static const char *CAMERA_SENSOR_NVS_KEY = "sensor";
+static const char *CAMERA_PIXFORMAT_NVS_KEY = "pixformat";
+static camera_state_t *s_state = NULL;
+#if CONFIG_CAMERA_TASK_STATIC
+static StaticSemaphore_t s_sensor_lock;
+#endif
+
+#if CONFIG_IDF_TARGET_ESP32S3 // LCD_CAM module of ESP32-S3 will generate xclk
+#define CAMERA_ENABLE_OUT_CLOCK(v)
+#define CAMERA_DISABLE_OUT_CLOCK()
+#else
+#define CAMERA_ENABLE_OUT_CLOCK(v) camera_enable_out_clock((v))
+#define CAMERA_DISABLE_OUT_CLOCK() camera_disable_out_clock()
+#endif
+
+typedef struct {
+    camera_model_t model;
+    int (*detect)(int slv_addr, sensor_id_t *id);
+    int (*init)(sensor_t *sensor);
+} sensor_func_t;
+
+// only the sensors enabled in menuconfig are compiled (see CMakeLists.txt) and probed
+static const sensor_func_t g_sensors[] = {
+#if CONFIG_OV7725_SUPPORT
+    {CAMERA_OV7725, ov7725_detect, ov7725_init},
+#endif
+#if CONFIG_OV7670_SUPPORT
+    {CAMERA_OV7670, ov7670_detect, ov7670_init},
+#endif
+#if CONFIG_OV2640_SUPPORT
+    {CAMERA_OV2640, ov2640_detect, ov2640_init},
+#endif
+#if CONFIG_OV3660_SUPPORT
+    {CAMERA_OV3660, ov3660_detect, ov3660_init},
+#endif
+#if CONFIG_OV5640_SUPPORT
+    {CAMERA_OV5640, ov5640_detect, ov5640_init},
+#endif
+#if CONFIG_NT99141_SUPPORT
+    {CAMERA_NT99141, nt99141_detect, nt99141_init},
+#endif
+#if CONFIG_GC2145_SUPPORT
+    {CAMERA_GC2145, gc2145_detect, gc2145_init},
+#endif
+#if CONFIG_GC032A_SUPPORT
+    {CAMERA_GC032A, gc032a_detect, gc032a_init},
+#endif
+#if CONFIG_GC0308_SUPPORT
+    {CAMERA_GC0308, gc0308_detect, gc0308_init},
+#endif
+#if CONFIG_BF3005_SUPPORT
+    {CAMERA_BF3005, bf3005_detect, bf3005_init},
+#endif
+#if CONFIG_BF20A6_SUPPORT
+    {CAMERA_BF20A6, bf20a6_detect, bf20a6_init},
+#endif
+#if CONFIG_SC101IOT_SUPPORT
+    {CAMERA_SC101IOT, sc101iot_detect, sc101iot_init},
+#endif
+#if CONFIG_SC030IOT_SUPPORT
+    {CAMERA_SC030IOT, sc030iot_detect, sc030iot_init},
+#endif
+#if CONFIG_SC031GS_SUPPORT
+    {CAMERA_SC031GS, sc031gs_detect, sc031gs_init},
+#endif
+#if CONFIG_MEGA_CCM_SUPPORT
+    {CAMERA_MEGA_CCM, mega_ccm_detect, mega_ccm_init},
+#endif
+};
+
+#if CONFIG_CAMERA_PROBE_CACHE
+static bool camera_probe_cache_load(camera_probe_cache_t *cache)
+{
+    nvs_handle_t handle;
+    size_t size = sizeof(*cache);
+
+    if (nvs_open(PROBE_CACHE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    esp_err_t ret = nvs_get_blob(handle, PROBE_CACHE_NVS_KEY, cache, &size);
+    nvs_close(handle);
+    return ret == ESP_OK && size == sizeof(*cache);
+}
+
+// written only when the sensor changed, a normal boot does not touch flash
+static void camera_probe_cache_store(const camera_probe_cache_t *cache)
+{
+    camera_probe_cache_t old;
+    nvs_handle_t handle;
+
+    if (camera_probe_cache_load(&old) && memcmp(&old, cache, sizeof(old)) == 0) {
+        return;
+    }
+    if (nvs_open(PROBE_CACHE_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;// NVS not initialized: probe with a full scan every boot
+    }
+    if (nvs_set_blob(handle, PROBE_CACHE_NVS_KEY, cache, sizeof(*cache)) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+// try the sensor of the last boot: one address probe and one ID read instead of the full scan
+static uint8_t camera_probe_cached(size_t *sensor_index)
+{
+    camera_probe_cache_t cache;
+    sensor_id_t *id = &s_state->sensor.id;
+
+    if (!camera_probe_cache_load(&cache) || cache.sensor >= sizeof(g_sensors) / sizeof(sensor_func_t)) {
+        return 0;
+    }
+    if (SCCB_Probe_Addr(cache.slv_addr) == 0 || g_sensors[cache.sensor].detect(cache.slv_addr, id) != cache.pid) {
+        ESP_LOGW(TAG, "Cached camera 0x%04x at address=0x%02x not found, scanning", cache.pid, cache.slv_addr);
+        return 0;
+    }
+    *sensor_index = cache.sensor;
+    return cache.slv_addr;
+}
+#endif
+
+// probe the SCCB addresses of the compiled-in sensors, each address once, and run the
+// detectors registered for an address that answers (some sensors share an address)
+static uint8_t camera_probe_scan(size_t *sensor_index)
+{
+    sensor_id_t *id = &s_state->sensor.id;
+    size_t count = sizeof(g_sensors) / sizeof(sensor_func_t);
+    uint8_t found = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t addr = camera_sensor[g_sensors[i].model].sccb_addr;
+        bool probed = false;
+        for (size_t j = 0; j < i && !probed; j++) {
+            probed = (camera_sensor[g_sensors[j].model].sccb_addr == addr);
+        }
+        if (probed || SCCB_Probe_Addr(addr) == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "Detected camera at address=0x%02x", addr);
+        found = addr;
+        for (size_t j = i; j < count; j++) {
+            if (camera_sensor[g_sensors[j].model].sccb_addr == addr && g_sensors[j].detect(addr, id)
+                && esp_camera_sensor_get_info(id) != NULL) {
+                *sensor_index = j;
+                return addr;
+            }
+        }
+    }
+    return found;
+}
+
+static esp_err_t camera_probe(const camera_config_t *config, camera_model_t *out_camera_model)
+{
+    esp_err_t ret = ESP_OK;
+    *out_camera_model = CAMERA_NONE;
+    if (s_state != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_state = (camera_state_t *) heap_caps_calloc(1, sizeof(camera_state_t), cam_alloc_caps(CAMERA_ALLOC_STATE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    if (!s_state) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (config->pin_xclk >= 0) {
+        ESP_LOGD(TAG, "Enabling XCLK output");
+        CAMERA_ENABLE_OUT_CLOCK(config);
+    }
+
+    if (config->pin_sccb_sda != -1) {
+        ESP_LOGD(TAG, "Initializing SCCB");
+        ret = SCCB_Init(config->pin_sccb_sda, config->pin_sccb_scl);
+    } else {
+        ESP_LOGD(TAG, "Using existing I2C port");
+        ret = SCCB_Use_Port(config->sccb_i2c_port);
+    }
+
+    if(ret != ESP_OK) {
+        ESP_LOGE(TAG, "sccb init err");
+        goto err;
+    }
+
+    if (config->pin_pwdn >= 0) {
+        ESP_LOGD(TAG, "Resetting camera by power down line");
+        gpio_config_t conf = { 0 };
+        conf.pin_bit_mask = 1LL << config->pin_pwdn;
+        conf.mode = GPIO_MODE_OUTPUT;
+        gpio_config(&conf);
+
+        // carefull, logic is inverted compared to reset pin
+        gpio_set_level(config->pin_pwdn, 1);
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+        gpio_set_level(config->pin_pwdn, 0);
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+
+    if (config->pin_reset >= 0) {
+        ESP_LOGD(TAG, "Resetting camera");
+        gpio_config_t conf = { 0 };
+        conf.pin_bit_mask = 1LL << config->pin_reset;
+        conf.mode = GPIO_MODE_OUTPUT;
+        gpio_config(&conf);
+
+        gpio_set_level(config->pin_reset, 0);
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+        gpio_set_level(config->pin_reset, 1);
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+
+    ESP_LOGD(TAG, "Searching for camera address");
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+
+    sensor_id_t *id = &s_state->sensor.id;
+    size_t sensor_count = sizeof(g_sensors) / sizeof(sensor_func_t);
+    size_t sensor_index = sensor_count;
+    uint8_t slv_addr = 0;
+
+#if CONFIG_CAMERA_PROBE_CACHE
+    slv_addr = camera_probe_cached(&sensor_index);
+#endif
+    if (slv_addr == 0) {
+        slv_addr = camera_probe_scan(&sensor_index);
+
+        if (slv_addr == 0) {
+            ret = ESP_ERR_NOT_FOUND;
+            goto err;
+        }
+    }
+    s_state->sensor.slv_addr = slv_addr;
+    s_state->sensor.xclk_freq_hz = config->xclk_freq_hz;
+
+    camera_sensor_info_t *info = (sensor_index < sensor_count) ? esp_camera_sensor_get_info(id) : NULL;
+    if (NULL == info) { //If no supported sensors are detected
+        ESP_LOGE(TAG, "Detected camera not supported.");
+        ret = ESP_ERR_NOT_SUPPORTED;
+        goto err;
+    }
+    *out_camera_model = info->model;
+    ESP_LOGI(TAG, "Detected %s camera", info->name);
+    g_sensors[sensor_index].init(&s_state->sensor);
+#if CONFIG_CAMERA_PROBE_CACHE
+    s_state->probe.slv_addr = slv_addr;
+    s_state->probe.sensor = (uint8_t)sensor_index;
+    s_state->probe.pid = id->PID;
+#endif
+
+    ESP_LOGI(TAG, "Camera PID=0x%02x VER=0x%02x MIDL=0x%02x MIDH=0x%02x",
+             id->PID, id->VER, id->MIDH, id->MIDL);
+
+    ESP_LOGD(TAG, "Doing SW reset of sensor");
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+
+    return s_state->sensor.reset(&s_state->sensor);
+err :
+    CAMERA_DISABLE_OUT_CLOCK();
+    return ret;
+}
+
+#if CONFIG_CAMERA_CONVERTER_ENABLED
+static pixformat_t get_output_data_format(camera_conv_mode_t conv_mode)
+{
+    pixformat_t format = PIXFORMAT_RGB565;
+    switch (conv_mode) {
+    case YUV422_TO_YUV420:
+        format = PIXFORMAT_YUV420;
+        break;
+    case YUV422_TO_RGB565: // default format is RGB565
+    default:
+        break;
+    }
+    ESP_LOGD(TAG, "Convert to %d format enabled", format);
+    return format;
+}
+#endif
+
+#if CONFIG_CAMERA_JPEG_QUALITY_GOVERNOR
+static int camera_gov_apply(void)
+{
+    camera_gov_t *gov = &s_state->gov;
+    int quality = MIN(gov->requested + gov->offset, GOV_QUALITY_MAX);
+
+    gov->settle = GOV_SETTLE_FRAMES;
+    return gov->set_quality(&s_state->sensor, quality);
+}
+
+// installed as sensor->set_quality, so every caller sets the base the offset applies to
+static int camera_gov_set_quality(sensor_t *sensor, int quality)
+{
+    camera_gov_t *gov = &s_state->gov;
+
+    esp_camera_sensor_lock();
+    gov->requested = quality;
+    int ret = camera_gov_apply();
+    esp_camera_sensor_unlock();
+    return ret;
+}
+
+static void camera_gov_init(void)
+{
+    camera_gov_t *gov = &s_state->gov;
+
+    gov->set_quality = s_state->sensor.set_quality;
+    s_state->sensor.set_quality = camera_gov_set_quality;
+}
+
+static void camera_gov_frame(const camera_fb_t *fb)
+{
+    camera_gov_t *gov = &s_state->gov;
+    size_t capacity = cam_get_fb_size();
+    camera_stats_t stats;
+    int step = 0;
+
+    cam_get_stats(&stats);
+    if (stats.fb_overflow + stats.no_eoi != gov->overflows) {
+        gov->overflows = stats.fb_overflow + stats.no_eoi;
+        step = 2 * GOV_STEP_UP;
+    } else if (gov->settle > 0) {
+        gov->settle--;
+        return;
+    } else if (fb->len * 100 >= capacity * GOV_HIGH_PCT) {
+        step = GOV_STEP_UP;
+    } else if (fb->len * 100 < capacity * GOV_LOW_PCT && gov->offset > 0) {
+        if (++gov->calm < GOV_RECOVER_FRAMES) {
+            return;
+        }
+        step = -1;
+    } else {
+        gov->calm = 0;// in the hysteresis band
+        return;
+    }
+
+    gov->calm = 0;
+    esp_camera_sensor_lock();
+    int offset = MAX(0, MIN(gov->offset + step, GOV_QUALITY_MAX - gov->requested));
+    if (offset != gov->offset) {
+        gov->offset = offset;
+        if (step > 0) {
+            gov->backoffs++;
+        }
+        camera_gov_apply();
+        ESP_LOGD(TAG, "quality governor: %u of %u bytes, quality %d+%d", (unsigned) fb->len, (unsigned) capacity, gov->requested, offset);
+    }
+    esp_camera_sensor_unlock();
+}
+#endif
+
+#if CONFIG_CAMERA_FB_META
+// low priority: samples the registers after cam_task reports a completed frame, so the
+// SCCB reads fall into vertical blanking and never delay the capture path
+static void camera_meta_task(void *arg)
+{
+    camera_meta_t *m = &s_state->meta;
+    sensor_t *s = &s_state->sensor;
+    camera_fb_meta_t meta = { .sensor_pid = s->id.PID };
+    uint32_t frame;
+
+    while (1) {
+        xTaskNotifyWait(0, 0, &frame, portMAX_DELAY);
+        meta.count = 0;
+        esp_camera_sensor_lock();
+        for (int i = 0; i < m->count; i++) {
+            int value = s->get_reg(s, m->reg[i], 0xFF);
+            if (value < 0) {
+                meta.count = 0;
+                break;
+            }
+            meta.reg[meta.count] = m->reg[i];
+            meta.value[meta.count++] = (uint8_t)value;
+        }
+        meta.read_us = esp_timer_get_time();
+        cam_set_meta(&meta, frame);
+        esp_camera_sensor_unlock();
+    }
+}
+
+static esp_err_t camera_meta_init(void)
+{
+    camera_meta_t *m = &s_state->meta;
+    const uint16_t *regs = NULL;
+    size_t count = 0;
+
+    if (s_state->sensor.get_reg == NULL) {
+        return ESP_OK;
+    }
+    switch (s_state->sensor.id.PID) {
+    case OV2640_PID:
+        regs = ov2640_meta_regs;
+        count = sizeof(ov2640_meta_regs) / sizeof(ov2640_meta_regs[0]);
+        break;
+    case OV3660_PID:
+    case OV5640_PID:
+        regs = ov5640_meta_regs;
+        count = sizeof(ov5640_meta_regs) / sizeof(ov5640_meta_regs[0]);
+        break;
+    default:
+        break;
+    }
+    if (count) {
+        memcpy(m->reg, regs, count * sizeof(uint16_t));
+    }
+    m->count = count;
+
+    if (xTaskCreate(camera_meta_task, "cam_meta", META_TASK_STACK, NULL, 1, &m->task) != pdPASS) {
+        m->task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    cam_set_meta_task(m->task);
+    return ESP_OK;
+}
+#endif
+
+esp_err_t esp_camera_init(const camera_config_t *config)
+{
+    esp_err_t err;
+    err = cam_init(config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Camera init failed with error 0x%x", err);
+        return err;
+    }
+
+    camera_model_t camera_model = CAMERA_NONE;
+    err = camera_probe(config, &camera_model);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Camera probe failed with error 0x%x(%s)", err, esp_err_to_name(err));
+        goto fail;
+    }
+
+    framesize_t frame_size = (framesize_t) config->frame_size;
+    pixformat_t pix_format = (pixformat_t) config->pixel_format;
+
+    if (PIXFORMAT_JPEG == pix_format && (!camera_sensor[camera_model].support_jpeg)) {
+        ESP_LOGE(TAG, "JPEG format is not supported on this sensor");
+        err = ESP_ERR_NOT_SUPPORTED;
+        goto fail;
+    }
+
+    if (frame_size > camera_sensor[camera_model].max_size) {
+        ESP_LOGW(TAG, "The frame size exceeds the maximum for this sensor, it will be forced to the maximum possible value");
+        frame_size = camera_sensor[camera_model].max_size;
+    }
+
+#if CONFIG_CAMERA_TASK_STATIC
+    s_state->sensor_lock = xSemaphoreCreateRecursiveMutexStatic(&s_sensor_lock);
+#else
+    s_state->sensor_lock = xSemaphoreCreateRecursiveMutex();
+#endif
+    if (s_state->sensor_lock == NULL) {
+        err = ESP_ERR_NO_MEM;
+        goto fail;
+    }
+
+    err = cam_config(config, frame_size, s_state->sensor.id.PID);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Camera config failed with error 0x%x", err);
+        goto fail;
+    }
+    s_state->config = *config;
+    s_state->config.frame_size = frame_size;
+    s_state->model = camera_model;
+
+    s_state->sensor.status.framesize = frame_size;
+    s_state->sensor.pixformat = pix_format;
+
+    ESP_LOGD(TAG, "Setting frame size to %dx%d", resolution[frame_size].width, resolution[frame_size].height);
+    if (s_state->sensor.set_framesize(&s_state->sensor, frame_size) != 0) {
+        ESP_LOGE(TAG, "Failed to set frame size");
+        err = ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE;
+        goto fail;
+    }
+    s_state->sensor.set_pixformat(&s_state->sensor, pix_format);
+#if CONFIG_CAMERA_CONVERTER_ENABLED
+    if(config->conv_mode) {
+        s_state->sensor.pixformat = get_output_data_format(config->conv_mode); // If conversion enabled, change the out data format by conversion mode
+    }
+#endif
+
+    if (s_state->sensor.id.PID == OV2640_PID) {
+        s_state->sensor.set_gainceiling(&s_state->sensor, GAINCEILING_2X);
+        s_state->sensor.set_bpc(&s_state->sensor, false);
+        s_state->sensor.set_wpc(&s_state->sensor, true);
+        s_state->sensor.set_lenc(&s_state->sensor, true);
+    }
+
+    if (pix_format == PIXFORMAT_JPEG) {
+#if CONFIG_CAMERA_JPEG_QUALITY_GOVERNOR
+        camera_gov_init();
+#endif
+        s_state->sensor.set_quality(&s_state->sensor, config->jpeg_quality);
+    }
+    s_state->sensor.init_status(&s_state->sensor);
+
+#if CONFIG_CAMERA_FB_META
+    err = camera_meta_init();
+    if (err != ESP_OK) {
+        goto fail;
+    }
+#endif
+#if CONFIG_CAMERA_PROBE_CACHE
+    camera_probe_cache_store(&s_state->probe);
+#endif
+    cam_start();
+
+    return ESP_OK;
+
+fail:
+    esp_camera_deinit();
+    return err;
+}
+
+esp_err_t esp_camera_deinit()
+{
+    esp_camera_sensor_lock();// driver tasks are not in the middle of a sensor access
+    esp_err_t ret = cam_deinit();
+    CAMERA_DISABLE_OUT_CLOCK();
+    if (s_state) {
+#if CONFIG_CAMERA_FB_META
+        if (s_state->meta.task) {
+            vTaskDelete(s_state->meta.task);
+        }
+#endif
+        esp_camera_sensor_unlock();
+        SCCB_Deinit();
+        if (s_state->sensor_lock) {
+            vSemaphoreDelete(s_state->sensor_lock);
+        }
+
+        free(s_state);
+        s_state = NULL;
+    }
+
+    return ret;
+}
+
+#define FB_GET_TIMEOUT (4000 / portTICK_PERIOD_MS)
+
+camera_fb_t *esp_camera_fb_get()
+{
+    if (s_state == NULL) {
+        return NULL;
+    }
+    camera_fb_t *fb = cam_take(FB_GET_TIMEOUT);
+    //set the frame properties
+    if (fb) {
+        fb->width = resolution[s_state->sensor.status.framesize].width;
+        fb->height = resolution[s_state->sensor.status.framesize].height;
+        fb->format = s_state->sensor.pixformat;
+#if CONFIG_CAMERA_JPEG_QUALITY_GOVERNOR
+        if (s_state->gov.set_quality && fb->format == PIXFORMAT_JPEG) {
+            camera_gov_frame(fb);
+        }
+#endif
+    }
+    return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb)
+{
+    if (s_state == NULL) {
+        return;
+    }
+    cam_give(fb);
+}
+
+camera_fb_t *esp_camera_fb_acquire(camera_fb_t *fb)
+{
+    if (s_state == NULL || fb == NULL) {
+        return NULL;
+    }
+    return cam_ref(fb);
+}
+
+int64_t esp_camera_fb_get_age_us(const camera_fb_t *fb)
+{
+    if (fb == NULL) {
+        return 0;
+    }
+    int64_t ts = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    return esp_timer_get_time() - ts;
+}
+
+esp_err_t esp_camera_fb_inject(const uint8_t *data, size_t len, uint32_t timeout_ms)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (data == NULL || len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return cam_inject(data, len, pdMS_TO_TICKS(timeout_ms));
+}
+
+esp_err_t esp_camera_fb_get_timing(const camera_fb_t *fb, camera_fb_timing_t *timing)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (fb == NULL || timing == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return cam_get_timing(fb, timing);
+}
+
+size_t esp_camera_trace_read(camera_trace_event_t *events, size_t max, uint32_t *lost)
+{
+    if (events == NULL) {
+        max = 0;
+    }
+    return cam_trace_read(events, max, lost);
+}
+
+esp_err_t esp_camera_fb_get_meta(const camera_fb_t *fb, camera_fb_meta_t *meta)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (fb == NULL || meta == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return cam_get_meta(fb, meta);
+}
+
+esp_err_t esp_camera_fb_stream_begin(camera_fb_t **fb, uint32_t timeout_ms)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (fb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = cam_stream_begin(fb, pdMS_TO_TICKS(timeout_ms));
+    if (ret == ESP_OK) {
+        (*fb)->width = resolution[s_state->sensor.status.framesize].width;
+        (*fb)->height = resolution[s_state->sensor.status.framesize].height;
+        (*fb)->format = s_state->sensor.pixformat;
+    }
+    return ret;
+}
+
+esp_err_t esp_camera_fb_stream_wait(camera_fb_t *fb, size_t *avail, uint32_t timeout_ms)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (fb == NULL || avail == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = cam_stream_wait(fb, avail, pdMS_TO_TICKS(timeout_ms));
+#if CONFIG_CAMERA_JPEG_QUALITY_GOVERNOR
+    if (ret == ESP_OK && s_state->gov.set_quality) {
+        camera_gov_frame(fb);
+    }
+#endif
+    return ret;
+}
+
+void esp_camera_fb_stream_cancel(camera_fb_t *fb)
+{
+    if (s_state == NULL) {
+        return;
+    }
+    cam_stream_cancel(fb);
+}
+
+esp_err_t esp_camera_set_fb_meta_regs(const uint16_t *regs, size_t count)
+{
+#if CONFIG_CAMERA_FB_META
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (count > CAMERA_FB_META_REGS_MAX || (count && regs == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_camera_sensor_lock();
+    if (count) {
+        memcpy(s_state->meta.reg, regs, count * sizeof(uint16_t));
+    }
+    s_state->meta.count = count;
+    esp_camera_sensor_unlock();
+    return ESP_OK;
+#else
+    (void)regs;
+    (void)count;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t esp_camera_set_alloc_caps(camera_alloc_t what, uint32_t caps)
+{
+    if ((unsigned) what >= CAMERA_ALLOC_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_state != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (caps && what == CAMERA_ALLOC_DMA_BUF && !(caps & MALLOC_CAP_DMA)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+#if CONFIG_LCD_CAM_ISR_IRAM_SAFE
+    if (what == CAMERA_ALLOC_CTRL && (caps & MALLOC_CAP_SPIRAM)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+#endif
+    cam_set_alloc_caps(what, caps);
+    return ESP_OK;
+}
+
+void esp_camera_sensor_lock(void)
+{
+    if (s_state && s_state->sensor_lock) {
+        xSemaphoreTakeRecursive(s_state->sensor_lock, portMAX_DELAY);
+    }
+}
+
+void esp_camera_sensor_unlock(void)
+{
+    if (s_state && s_state->sensor_lock) {
+        xSemaphoreGiveRecursive(s_state->sensor_lock);
+    }
+}
+
+esp_err_t esp_camera_get_stats(camera_stats_t *stats)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    cam_get_stats(stats);
+#if CONFIG_CAMERA_JPEG_QUALITY_GOVERNOR
+    stats->quality_backoff = s_state->gov.backoffs;
+    stats->quality_offset = s_state->gov.offset;
+#endif
+    return ESP_OK;
+}
+
+sensor_t *esp_camera_sensor_get()
+{
+    if (s_state == NULL) {
+        return NULL;
+    }
+    return &s_state->sensor;
+}
+
+esp_err_t esp_camera_save_to_nvs(const char *key)
+{
+#if ESP_IDF_VERSION_MAJOR > 3
+    nvs_handle_t handle;
+#else
+    nvs_handle handle;
+#endif
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL) {
+        return ESP_ERR_CAMERA_NOT_DETECTED;
+    }
+
+    esp_err_t ret = nvs_open(key, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_set_blob(handle, CAMERA_SENSOR_NVS_KEY, &s->status, sizeof(camera_status_t));
+    if (ret == ESP_OK) {
+        uint8_t pf = s->pixformat;
+        ret = nvs_set_u8(handle, CAMERA_PIXFORMAT_NVS_KEY, pf);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return ret;
+}
+
+// only settings that differ from the sensor's current status are written
+#define CAMERA_NVS_APPLY(field, setter) \
+    if (st.field != s->status.field) { \
+        s->setter(s, st.field); \
+    }
+
+esp_err_t esp_camera_load_from_nvs(const char *key)
+{
+#if ESP_IDF_VERSION_MAJOR > 3
+    nvs_handle_t handle;
+#else
+    nvs_handle handle;
+#endif
+    uint8_t pf;
+    camera_status_t st;
+    size_t size = sizeof(camera_status_t);
+
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL) {
+        return ESP_ERR_CAMERA_NOT_DETECTED;
+    }
+
+    esp_err_t ret = nvs_open(key, NVS_READONLY, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Error (%d) opening nvs key \"%s\"", ret, key);
+        return ret;
+    }
+    ret = nvs_get_blob(handle, CAMERA_SENSOR_NVS_KEY, &st, &size);
+    if (ret == ESP_OK && size != sizeof(camera_status_t)) {
+        ret = ESP_ERR_INVALID_SIZE;// saved by a build with another camera_status_t
+    }
+    esp_err_t pf_ret = nvs_get_u8(handle, CAMERA_PIXFORMAT_NVS_KEY, &pf);
+    nvs_close(handle);
+
+    esp_camera_sensor_lock();
+    if (ret == ESP_OK) {
+        if (st.framesize != s->status.framesize) {
+            // keeps the DMA ring and frame buffers in step with the sensor output
+            camera_config_t config = s_state->config;
+            config.frame_size = st.framesize;
+            esp_camera_reconfigure(&config);
+        }
+        CAMERA_NVS_APPLY(ae_level, set_ae_level);
+        CAMERA_NVS_APPLY(aec2, set_aec2);
+        CAMERA_NVS_APPLY(aec_value, set_aec_value);
+        CAMERA_NVS_APPLY(agc_gain, set_agc_gain);
+        CAMERA_NVS_APPLY(awb_gain, set_awb_gain);
+        CAMERA_NVS_APPLY(bpc, set_bpc);
+        CAMERA_NVS_APPLY(brightness, set_brightness);
+        CAMERA_NVS_APPLY(colorbar, set_colorbar);
+        CAMERA_NVS_APPLY(contrast, set_contrast);
+        CAMERA_NVS_APPLY(dcw, set_dcw);
+        CAMERA_NVS_APPLY(denoise, set_denoise);
+        CAMERA_NVS_APPLY(aec, set_exposure_ctrl);
+        CAMERA_NVS_APPLY(agc, set_gain_ctrl);
+        CAMERA_NVS_APPLY(gainceiling, set_gainceiling);
+        CAMERA_NVS_APPLY(hmirror, set_hmirror);
+        CAMERA_NVS_APPLY(lenc, set_lenc);
+        CAMERA_NVS_APPLY(quality, set_quality);
+        CAMERA_NVS_APPLY(raw_gma, set_raw_gma);
+        CAMERA_NVS_APPLY(saturation, set_saturation);
+        CAMERA_NVS_APPLY(sharpness, set_sharpness);
+        CAMERA_NVS_APPLY(special_effect, set_special_effect);
+        CAMERA_NVS_APPLY(vflip, set_vflip);
+        CAMERA_NVS_APPLY(wb_mode, set_wb_mode);
+        CAMERA_NVS_APPLY(awb, set_whitebal);
+        CAMERA_NVS_APPLY(wpc, set_wpc);
+    }
+    if (pf_ret == ESP_OK && pf != s->pixformat) {
+        s->set_pixformat(s, pf);
+    }
+    esp_camera_sensor_unlock();
+    return ret == ESP_OK ? pf_ret : ret;
+}
+
+#undef CAMERA_NVS_APPLY
+
+void esp_camera_return_all(void) {
+    if (s_state == NULL) {
+        return;
+    }
+    cam_give_all();
+}
+
+esp_err_t esp_camera_suspend(void)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    cam_stop();
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_resume(void)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    cam_start();
+    return ESP_OK;
+}
+
+esp_err_t esp_camera_reconfigure(const camera_config_t *config)
+{
+    if (s_state == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const camera_config_t *cur = &s_state->config;
+    // these decide the sample mode and the buffer layout, changing them takes a deinit/init
+    if (config->pixel_format != cur->pixel_format || config->fb_count != cur->fb_count
+            || config->fb_location != cur->fb_location || config->grab_mode != cur->grab_mode
+            || config->xclk_freq_hz != cur->xclk_freq_hz || config->swap_bytes != cur->swap_bytes
+#if CONFIG_CAMERA_CONVERTER_ENABLED
+            || config->conv_mode != cur->conv_mode
+#endif
+            ) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    framesize_t frame_size = (framesize_t) config->frame_size;
+    if (frame_size > camera_sensor[s_state->model].max_size) {
+        ESP_LOGW(TAG, "The frame size exceeds the maximum for this sensor, it will be forced to the maximum possible value");
+        frame_size = camera_sensor[s_state->model].max_size;
+    }
+    framesize_t old_size = s_state->sensor.status.framesize;
+    bool size_changed = frame_size != old_size;
+#if CONFIG_CAMERA_JPEG_QUALITY_GOVERNOR
+    bool quality_changed = config->jpeg_quality != s_state->gov.requested;
+#else
+    bool quality_changed = config->jpeg_quality != s_state->sensor.status.quality;
+#endif
+    quality_changed = quality_changed && cur->pixel_format == PIXFORMAT_JPEG;
+    if (!size_changed && !quality_changed) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = ESP_OK;
+    esp_camera_sensor_lock();
+    if (size_changed) {
+        bool was_running = cam_is_running();
+        cam_stop();
+        err = cam_reconfig(frame_size);
+        if (err == ESP_OK && s_state->sensor.set_framesize(&s_state->sensor, frame_size) != 0) {
+            ESP_LOGE(TAG, "Failed to set frame size");
+            err = ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE;
+            cam_reconfig(old_size);
+        }
+        if (err == ESP_OK) {
+            s_state->config.frame_size = frame_size;
+        }
+        if (was_running) {
+            cam_start();
+        }
+    }
+    if (err == ESP_OK && quality_changed) {
+        s_state->sensor.set_quality(&s_state->sensor, config->jpeg_quality);
+        s_state->config.jpeg_quality = config->jpeg_quality;
+    }
+    esp_camera_sensor_unlock();
+    return err;
+}
+
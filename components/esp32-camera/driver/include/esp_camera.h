@@ -0,0 +1,596 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/*
+ * Example Use
+ *
+    static camera_config_t camera_example_config = {
+        .pin_pwdn       = PIN_PWDN,
+        .pin_reset      = PIN_RESET,
+        .pin_xclk       = PIN_XCLK,
+        .pin_sccb_sda   = PIN_SIOD,
+        .pin_sccb_scl   = PIN_SIOC,
+        .pin_d7         = PIN_D7,
+        .pin_d6         = PIN_D6,
+        .pin_d5         = PIN_D5,
+        .pin_d4         = PIN_D4,
+        .pin_d3         = PIN_D3,
+        .pin_d2         = PIN_D2,
+        .pin_d1         = PIN_D1,
+        .pin_d0         = PIN_D0,
+        .pin_vsync      = PIN_VSYNC,
+        .pin_href       = PIN_HREF,
+        .pin_pclk       = PIN_PCLK,
+
+        .xclk_freq_hz   = 20000000,
+        .ledc_timer     = LEDC_TIMER_0,
+        .ledc_channel   = LEDC_CHANNEL_0,
+        .pixel_format   = PIXFORMAT_JPEG,
+        .frame_size     = FRAMESIZE_SVGA,
+        .jpeg_quality   = 10,
+        .fb_count       = 2,
+        .grab_mode      = CAMERA_GRAB_WHEN_EMPTY
+    };
+
+    esp_err_t camera_example_init(){
+        return esp_camera_init(&camera_example_config);
+    }
+
+    esp_err_t camera_example_capture(){
+        //capture a frame
+        camera_fb_t * fb = esp_camera_fb_get();
+        if (!fb) {
+            ESP_LOGE(TAG, "Frame buffer could not be acquired");
+            return ESP_FAIL;
+        }
+
+        //replace this with your own function
+        display_image(fb->width, fb->height, fb->pixformat, fb->buf, fb->len);
+
+        //return the frame buffer back to be reused
+        esp_camera_fb_return(fb);
+
+        return ESP_OK;
+    }
+*/
+
+#pragma once
+
+#include "esp_err.h"
+#include "driver/ledc.h"
+#include "sensor.h"
+#include "sys/time.h"
+#include "sdkconfig.h"
+
+/**
+ * @brief define for if chip supports camera
+ */
+#define ESP_CAMERA_SUPPORTED (CONFIG_IDF_TARGET_ESP32 | CONFIG_IDF_TARGET_ESP32S3 | \
+                             CONFIG_IDF_TARGET_ESP32S2)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Configuration structure for camera initialization
+ */
+typedef enum {
+    CAMERA_GRAB_WHEN_EMPTY,         /*!< Fills buffers when they are empty. Less resources but first 'fb_count' frames might be old */
+    CAMERA_GRAB_LATEST,             /*!< Except when 1 frame buffer is used, queue will always contain the last 'fb_count' frames */
+    CAMERA_GRAB_NEWEST              /*!< Single-slot mailbox: each completed frame replaces the pending one, esp_camera_fb_get() always returns the newest frame. Use fb_count >= 3 */
+} camera_grab_mode_t;
+
+/**
+ * @brief Camera frame buffer location
+ */
+typedef enum {
+    CAMERA_FB_IN_PSRAM,         /*!< Frame buffer is placed in external PSRAM */
+    CAMERA_FB_IN_DRAM           /*!< Frame buffer is placed in internal DRAM */
+} camera_fb_location_t;
+
+/**
+ * @brief Driver allocations whose placement can be chosen with esp_camera_set_alloc_caps()
+ *
+ * DMA descriptors are not listed: GDMA reads them from internal RAM only, they always come
+ * from MALLOC_CAP_DMA. FreeRTOS objects come from the internal FreeRTOS heap (or from .bss with
+ * CONFIG_CAMERA_TASK_STATIC).
+ */
+typedef enum {
+    CAMERA_ALLOC_CTRL,          /*!< cam_obj_t and the frame slot table, used by cam_task and the ISRs on every event. Default internal RAM */
+    CAMERA_ALLOC_STATE,         /*!< Sensor state and settings (esp_camera_sensor_get()). Default internal RAM */
+    CAMERA_ALLOC_FB,            /*!< Frame buffers. Default from fb_location */
+    CAMERA_ALLOC_FB_POOL,       /*!< CONFIG_CAMERA_FB_POOL slots. Default from fb_location */
+    CAMERA_ALLOC_DMA_BUF,       /*!< Ping-pong DMA buffer when GDMA does not write the frame buffers directly. Default MALLOC_CAP_DMA */
+    CAMERA_ALLOC_MAX,
+} camera_alloc_t;
+
+#if CONFIG_CAMERA_CONVERTER_ENABLED
+/**
+ * @brief Camera RGB\YUV conversion mode
+ */
+typedef enum {
+    CONV_DISABLE,
+    RGB565_TO_YUV422,
+
+    YUV422_TO_RGB565,
+    YUV422_TO_YUV420
+} camera_conv_mode_t;
+#endif
+
+/**
+ * @brief Configuration structure for camera initialization
+ */
+typedef struct {
+    int pin_pwdn;                   /*!< GPIO pin for camera power down line */
+    int pin_reset;                  /*!< GPIO pin for camera reset line */
+    int pin_xclk;                   /*!< GPIO pin for camera XCLK line */
+    union {
+        int pin_sccb_sda;           /*!< GPIO pin for camera SDA line */
+        int pin_sscb_sda __attribute__((deprecated("please use pin_sccb_sda instead")));           /*!< GPIO pin for camera SDA line (legacy name) */
+    };
+    union {
+        int pin_sccb_scl;           /*!< GPIO pin for camera SCL line */
+        int pin_sscb_scl __attribute__((deprecated("please use pin_sccb_scl instead")));           /*!< GPIO pin for camera SCL line (legacy name) */
+    };
+    int pin_d7;                     /*!< GPIO pin for camera D7 line */
+    int pin_d6;                     /*!< GPIO pin for camera D6 line */
+    int pin_d5;                     /*!< GPIO pin for camera D5 line */
+    int pin_d4;                     /*!< GPIO pin for camera D4 line */
+    int pin_d3;                     /*!< GPIO pin for camera D3 line */
+    int pin_d2;                     /*!< GPIO pin for camera D2 line */
+    int pin_d1;                     /*!< GPIO pin for camera D1 line */
+    int pin_d0;                     /*!< GPIO pin for camera D0 line */
+    int pin_vsync;                  /*!< GPIO pin for camera VSYNC line */
+    int pin_href;                   /*!< GPIO pin for camera HREF line */
+    int pin_pclk;                   /*!< GPIO pin for camera PCLK line */
+
+    int xclk_freq_hz;               /*!< Frequency of XCLK signal, in Hz. EXPERIMENTAL: Set to 16MHz on ESP32-S2 or ESP32-S3 to enable EDMA mode */
+
+    ledc_timer_t ledc_timer;        /*!< LEDC timer to be used for generating XCLK  */
+    ledc_channel_t ledc_channel;    /*!< LEDC channel to be used for generating XCLK  */
+
+    pixformat_t pixel_format;       /*!< Format of the pixel data: PIXFORMAT_ + YUV422|GRAYSCALE|RGB565|JPEG  */
+    framesize_t frame_size;         /*!< Size of the output image: FRAMESIZE_ + QVGA|CIF|VGA|SVGA|XGA|SXGA|UXGA  */
+
+    int jpeg_quality;               /*!< Quality of JPEG output. 0-63 lower means higher quality  */
+    size_t fb_count;                /*!< Number of frame buffers to be allocated. If more than one, then each frame will be acquired (double speed)  */
+    camera_fb_location_t fb_location; /*!< The location where the frame buffer will be allocated */
+    camera_grab_mode_t grab_mode;   /*!< When buffers should be filled */
+#if CONFIG_CAMERA_CONVERTER_ENABLED
+    camera_conv_mode_t conv_mode;   /*!< RGB<->YUV Conversion mode */
+#endif
+
+    int sccb_i2c_port;              /*!< If pin_sccb_sda is -1, use the already configured I2C bus by number */
+
+    bool swap_bytes;                /*!< Swap the two bytes of every RGB565/YUV422 pixel in the capture peripheral
+                                         (LCD_CAM byte order on ESP32-S3, I2S on ESP32-S2), e.g. for a little endian
+                                         consumer of a high-byte-first sensor. Not supported on ESP32 */
+} camera_config_t;
+
+/**
+ * @brief Data structure of camera frame buffer
+ */
+typedef struct {
+    uint8_t * buf;              /*!< Pointer to the pixel data */
+    size_t len;                 /*!< Length of the buffer in bytes */
+    size_t width;               /*!< Width of the buffer in pixels */
+    size_t height;              /*!< Height of the buffer in pixels */
+    pixformat_t format;         /*!< Format of the pixel data */
+    struct timeval timestamp;   /*!< Timestamp since boot of the first DMA buffer of the frame */
+} camera_fb_t;
+
+/**
+ * @brief Driver-side pipeline timestamps of a frame buffer (esp_timer microseconds, 0 if not reached)
+ */
+typedef struct {
+    int64_t vsync_us;           /*!< VSYNC interrupt that started the frame */
+    int64_t dma_eof_us;         /*!< Last DMA EOF interrupt of the frame */
+    int64_t queued_us;          /*!< Frame pushed to the frame buffer queue by cam_task */
+    int64_t dequeued_us;        /*!< Frame popped from the queue in cam_take */
+    int64_t taken_us;           /*!< cam_take returned the frame (after the JPEG EOI search) */
+} camera_fb_timing_t;
+
+/**
+ * @brief Driver trace probes, see esp_camera_trace_read()
+ */
+typedef enum {
+    CAMERA_TRACE_VSYNC_ISR,     /*!< VSYNC interrupt, arg is the number of VSYNC events before it */
+    CAMERA_TRACE_EOF_ISR,       /*!< DMA EOF interrupt, arg is the number of EOF events before it */
+    CAMERA_TRACE_TASK_STATE,    /*!< cam_task changed state, arg is the new state: 0 idle, 1 reading a frame */
+    CAMERA_TRACE_FRAME_START,   /*!< cam_task started a frame, arg is the frame buffer slot */
+    CAMERA_TRACE_FRAME_QUEUED,  /*!< cam_task queued a completed frame, arg is the frame buffer slot */
+    CAMERA_TRACE_TAKE_BEGIN,    /*!< cam_take() entered, arg is the timeout in ticks */
+    CAMERA_TRACE_TAKE_NO_EOI,   /*!< cam_take() dropped a frame without JPEG end marker, arg is the slot */
+    CAMERA_TRACE_TAKE_END,      /*!< cam_take() returned, arg is the frame length, 0 if it timed out */
+    CAMERA_TRACE_ID_NUM
+} camera_trace_id_t;
+
+/**
+ * @brief One driver trace probe hit
+ */
+typedef struct {
+    int64_t time_us;            /*!< esp_timer_get_time(), the clock of camera_fb_timing_t */
+    uint32_t arg;               /*!< Probe argument, see camera_trace_id_t */
+    uint8_t id;                 /*!< camera_trace_id_t */
+    uint8_t core;               /*!< CPU core the probe ran on */
+} camera_trace_event_t;
+
+#define CAMERA_FB_META_REGS_MAX 12
+
+/**
+ * @brief Sensor registers sampled around a frame (see esp_camera_fb_get_meta())
+ */
+typedef struct {
+    uint16_t sensor_pid;        /*!< Sensor the registers belong to (OV2640_PID, ...) */
+    uint8_t count;              /*!< Valid entries in reg/value */
+    uint8_t age;                /*!< Frames queued between the sample and this frame, 1 if read in the blanking just before it */
+    int64_t read_us;            /*!< esp_timer time of the sample */
+    uint16_t reg[CAMERA_FB_META_REGS_MAX];  /*!< Register addresses, same format as sensor_t::get_reg() */
+    uint8_t value[CAMERA_FB_META_REGS_MAX]; /*!< Register values */
+} camera_fb_meta_t;
+
+/**
+ * @brief Capture health counters, accumulated since esp_camera_init()
+ */
+typedef struct {
+    uint32_t frames;            /*!< Frames handed to the frame buffer queue */
+    uint32_t no_soi;            /*!< Frames dropped because the first DMA buffer did not start with a JPEG SOI */
+    uint32_t no_eoi;            /*!< Frames dropped by esp_camera_fb_get() because no JPEG EOI was found */
+    uint32_t fb_overflow;       /*!< Frames larger than the frame buffer (FB-OVF) */
+    uint32_t fbq_overflow;      /*!< Frames dropped or replaced because the frame buffer queue was full */
+    uint32_t event_overflow;    /*!< Captures restarted because cam_task fell too far behind the VSYNC/EOF interrupts */
+    uint32_t superseded;        /*!< CAMERA_GRAB_NEWEST: frames replaced in the mailbox before anyone took them */
+    uint32_t dma_reset;         /*!< Captures re-armed by the DMA watchdog after the channel stalled mid-frame */
+    uint32_t dma_restart;       /*!< Continuous capture: frame starts that needed a full LCD_CAM/GDMA restart instead of a relink */
+    uint32_t pool_miss;         /*!< CONFIG_CAMERA_FB_POOL: JPEG frames left in their frame buffer because no pool slot was free */
+    uint32_t quality_backoff;   /*!< JPEG quality governor: times quality was lowered to keep frames inside the buffer */
+    uint32_t quality_offset;    /*!< JPEG quality governor: quality units currently added to the requested quality */
+} camera_stats_t;
+
+#define ESP_ERR_CAMERA_BASE 0x20000
+#define ESP_ERR_CAMERA_NOT_DETECTED             (ESP_ERR_CAMERA_BASE + 1)
+#define ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE (ESP_ERR_CAMERA_BASE + 2)
+#define ESP_ERR_CAMERA_FAILED_TO_SET_OUT_FORMAT (ESP_ERR_CAMERA_BASE + 3)
+#define ESP_ERR_CAMERA_NOT_SUPPORTED            (ESP_ERR_CAMERA_BASE + 4)
+
+/**
+ * @brief Choose where the driver places one kind of allocation
+ *
+ * Takes effect at the next esp_camera_init(). The caps are passed to heap_caps_malloc() as
+ * they are, so MALLOC_CAP_SPIRAM or MALLOC_CAP_INTERNAL (plus MALLOC_CAP_8BIT) select the
+ * memory; 0 restores the default.
+ *
+ * @param what  Allocation
+ * @param caps  MALLOC_CAP_* flags, 0 for the default
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if what is out of range
+ *      - ESP_ERR_INVALID_STATE if the camera is initialized
+ *      - ESP_ERR_NOT_SUPPORTED if the memory cannot hold that allocation: CAMERA_ALLOC_DMA_BUF
+ *        without MALLOC_CAP_DMA, or CAMERA_ALLOC_CTRL in PSRAM with CONFIG_LCD_CAM_ISR_IRAM_SAFE
+ *        (the ISRs use it while the cache may be disabled)
+ */
+esp_err_t esp_camera_set_alloc_caps(camera_alloc_t what, uint32_t caps);
+
+/**
+ * @brief Initialize the camera driver
+ *
+ * @note call camera_probe before calling this function
+ *
+ * This function detects and configures camera over I2C interface,
+ * allocates framebuffer and DMA buffers,
+ * initializes parallel I2S input, and sets up DMA descriptors.
+ *
+ * Currently this function can only be called once and there is
+ * no way to de-initialize this module.
+ *
+ * @param config  Camera configuration parameters
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t esp_camera_init(const camera_config_t* config);
+
+/**
+ * @brief Deinitialize the camera driver
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ */
+esp_err_t esp_camera_deinit(void);
+
+/**
+ * @brief Obtain pointer to a frame buffer.
+ *
+ * @return pointer to the frame buffer
+ */
+camera_fb_t* esp_camera_fb_get(void);
+
+/**
+ * @brief Return the frame buffer to be reused again.
+ *
+ * Drops one reference. The buffer goes back to the DMA pool when the last
+ * reference (see esp_camera_fb_acquire()) is returned.
+ *
+ * @param fb    Pointer to the frame buffer
+ */
+void esp_camera_fb_return(camera_fb_t * fb);
+
+/**
+ * @brief Take an additional reference to a frame buffer obtained from esp_camera_fb_get().
+ *
+ * Lets several consumers share one frame without copying. Every reference,
+ * including the one returned by esp_camera_fb_get(), must be released with
+ * esp_camera_fb_return().
+ *
+ * @param fb    Pointer to the frame buffer
+ *
+ * @return fb on success, NULL if fb is not a driver frame buffer or has already been returned
+ */
+camera_fb_t *esp_camera_fb_acquire(camera_fb_t *fb);
+
+/**
+ * @brief Queue a JPEG frame from elsewhere (a recording) as if the sensor had captured it
+ *
+ * Capture must be stopped with esp_camera_suspend() first. The data is copied into a
+ * free frame buffer, which then reaches esp_camera_fb_get() through the frame queue (or
+ * the CAMERA_GRAB_NEWEST mailbox) and is reference counted, timed and returned like a
+ * captured frame. fb->timestamp is the time of this call; width and height are those of
+ * the current frame size.
+ *
+ * @param data       JPEG data
+ * @param len        Length of data in bytes
+ * @param timeout_ms Time to wait for a free frame buffer
+ *
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_STATE if the camera is not initialized or still capturing
+ *     - ESP_ERR_NOT_SUPPORTED if the pixel format is not JPEG
+ *     - ESP_ERR_INVALID_SIZE if len exceeds the frame buffer size
+ *     - ESP_ERR_TIMEOUT if no frame buffer was returned in time
+ */
+esp_err_t esp_camera_fb_inject(const uint8_t *data, size_t len, uint32_t timeout_ms);
+
+/**
+ * @brief Get how old a frame buffer is: time since the start of its capture.
+ *
+ * @param fb    Pointer to the frame buffer
+ *
+ * @return age in microseconds
+ */
+int64_t esp_camera_fb_get_age_us(const camera_fb_t *fb);
+
+/**
+ * @brief Get the driver pipeline timestamps of a frame buffer obtained from esp_camera_fb_get()
+ *
+ * @param fb        Pointer to the frame buffer
+ * @param timing    Output timestamps
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if fb is not a driver frame buffer
+ *      - ESP_ERR_NOT_SUPPORTED if CONFIG_CAMERA_FRAME_TIMING is disabled
+ */
+esp_err_t esp_camera_fb_get_timing(const camera_fb_t *fb, camera_fb_timing_t *timing);
+
+/**
+ * @brief Drain the driver trace probes recorded since the previous call
+ *
+ * The VSYNC and DMA EOF interrupts, the cam_task state changes and cam_take() record into a
+ * ring of CONFIG_CAMERA_TRACE_EVENTS events in internal RAM. Only one task may read it; call
+ * this often enough (at least once per few frames) to keep up, older events are overwritten.
+ *
+ * @param events    Output events, oldest first
+ * @param max       Capacity of events
+ * @param lost      Optional, number of events overwritten or torn before they were read
+ *
+ * @return number of events written to events, 0 if CONFIG_CAMERA_TRACE is disabled
+ */
+size_t esp_camera_trace_read(camera_trace_event_t *events, size_t max, uint32_t *lost);
+
+/**
+ * @brief Get the sensor registers sampled for a frame buffer obtained from esp_camera_fb_get()
+ *
+ * The registers are read asynchronously by the driver (CONFIG_CAMERA_FB_META) and
+ * copied into the frame when it is queued, so this does no SCCB access.
+ *
+ * @param fb        Pointer to the frame buffer
+ * @param meta      Output registers
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if fb is not a driver frame buffer
+ *      - ESP_ERR_NOT_FOUND if no sample was taken yet or the sensor has no register set
+ *      - ESP_ERR_NOT_SUPPORTED if CONFIG_CAMERA_FB_META is disabled
+ */
+esp_err_t esp_camera_fb_get_meta(const camera_fb_t *fb, camera_fb_meta_t *meta);
+
+/**
+ * @brief Claim the JPEG frame in capture and read it while the DMA writes it (CONFIG_CAMERA_CUT_THROUGH)
+ *
+ * Returns the newest complete frame from the queue if there is one, otherwise the frame
+ * the DMA is writing (or starts next). Only one stream can be open at a time; read it with
+ * esp_camera_fb_stream_wait() until that returns ESP_OK, then give the frame back with
+ * esp_camera_fb_return() as usual. fb->len is not final before that.
+ *
+ * @param fb          Output frame buffer
+ * @param timeout_ms  Time to wait for the first data
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if no frame started within timeout_ms
+ *      - ESP_ERR_INVALID_STATE if a stream is already open
+ *      - ESP_ERR_NOT_SUPPORTED if the option is disabled or the frames are not JPEG in PSRAM
+ */
+esp_err_t esp_camera_fb_stream_begin(camera_fb_t **fb, uint32_t timeout_ms);
+
+/**
+ * @brief Wait for more data of the frame obtained from esp_camera_fb_stream_begin()
+ *
+ * fb->buf[0, *avail) is valid after each call. The data is published in DMA node
+ * steps (1 KB) and the tail of the frame may still be padding until ESP_OK.
+ *
+ * @param fb          Frame buffer from esp_camera_fb_stream_begin()
+ * @param avail       In: bytes already read; out: bytes readable
+ * @param timeout_ms  Time to wait for new data
+ *
+ * @return
+ *      - ESP_OK the frame is complete, *avail is its final length and the caller owns fb
+ *      - ESP_ERR_NOT_FINISHED more data is available, the frame is still in capture
+ *      - ESP_ERR_TIMEOUT no new data within timeout_ms
+ *      - ESP_ERR_INVALID_RESPONSE the frame was dropped (no EOI, overflow); the stream is closed
+ *      - ESP_ERR_INVALID_STATE if fb is not the open stream
+ */
+esp_err_t esp_camera_fb_stream_wait(camera_fb_t *fb, size_t *avail, uint32_t timeout_ms);
+
+/**
+ * @brief Close a stream without reading it to the end
+ *
+ * A frame still in capture goes to the frame queue when complete, a complete one is returned.
+ *
+ * @param fb          Frame buffer from esp_camera_fb_stream_begin()
+ */
+void esp_camera_fb_stream_cancel(camera_fb_t *fb);
+
+/**
+ * @brief Select the sensor registers sampled into frame buffers
+ *
+ * Replaces the default exposure/gain/AWB set of the detected sensor.
+ *
+ * @param regs      Register addresses, same format as sensor_t::get_reg(); NULL or count 0 stops sampling
+ * @param count     Number of registers, at most CAMERA_FB_META_REGS_MAX
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if count is too large
+ *      - ESP_ERR_NOT_SUPPORTED if CONFIG_CAMERA_FB_META is disabled
+ */
+esp_err_t esp_camera_set_fb_meta_regs(const uint16_t *regs, size_t count);
+
+/**
+ * @brief Serialize sensor register access with the driver
+ *
+ * The driver writes and reads sensor registers from its own tasks (JPEG quality
+ * governor, frame metadata sampling). Sensors with banked registers such as the
+ * OV2640 break when two tasks interleave a bank switch and an access, so tasks
+ * that change sensor settings at runtime should hold this lock around the calls.
+ * The lock is recursive.
+ */
+void esp_camera_sensor_lock(void);
+
+/**
+ * @brief Release the lock taken with esp_camera_sensor_lock()
+ */
+void esp_camera_sensor_unlock(void);
+
+/**
+ * @brief Get the capture health counters
+ *
+ * @param stats     Output counters
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if stats is NULL
+ *      - ESP_ERR_INVALID_STATE if the driver hasn't been initialized yet
+ */
+esp_err_t esp_camera_get_stats(camera_stats_t *stats);
+
+/**
+ * @brief Get a pointer to the image sensor control structure
+ *
+ * @return pointer to the sensor
+ */
+sensor_t * esp_camera_sensor_get(void);
+
+/**
+ * @brief Save camera settings to non-volatile-storage (NVS)
+ *
+ * The sensor status and pixel format are written and committed.
+ *
+ * @param key   A unique nvs key name for the camera settings
+ */
+esp_err_t esp_camera_save_to_nvs(const char *key);
+
+/**
+ * @brief Load camera settings from non-volatile-storage (NVS)
+ *
+ * Only the settings that differ from the current sensor status are written, under
+ * esp_camera_sensor_lock(). A different frame size goes through
+ * esp_camera_reconfigure(), so it must fit the buffers allocated at init.
+ *
+ * @param key   A unique nvs key name for the camera settings
+ */
+esp_err_t esp_camera_load_from_nvs(const char *key);
+
+/**
+ * @brief Return all frame buffers to be reused again.
+ */
+void esp_camera_return_all(void);
+
+/**
+ * @brief Stop capturing without releasing the driver
+ *
+ * VSYNC interrupts and GDMA are stopped and, with CONFIG_PM_ENABLE, the APB
+ * frequency lock the driver holds while capturing is released so the chip can
+ * scale down or enter light sleep. Frames already queued stay available.
+ * Put the sensor into standby (PWDN) after this call, not before.
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if the camera is not initialized
+ */
+esp_err_t esp_camera_suspend(void);
+
+/**
+ * @brief Resume capturing after esp_camera_suspend()
+ *
+ * Capture restarts at the next VSYNC. Frames started before the suspend may
+ * come out truncated and are dropped as NO-EOI.
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if the camera is not initialized
+ */
+esp_err_t esp_camera_resume(void);
+
+/**
+ * @brief Change the frame size and JPEG quality without a deinit/init
+ *
+ * The sensor is not probed or reset and the frame buffers, DMA buffer and descriptors
+ * allocated by esp_camera_init() are kept. Only the settings that differ from the
+ * current ones are written: a new frame size stops capture, re-derives the DMA ring
+ * sizes within the existing allocation, calls set_framesize and restarts capture
+ * (if it was running); a new quality calls set_quality. Frames queued at the old
+ * size are dropped; frames held by the application stay valid.
+ *
+ * Only frame_size and jpeg_quality may differ from the config passed to
+ * esp_camera_init(); pins and SCCB settings are not looked at.
+ *
+ * @param config    Camera configuration
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the camera is not initialized
+ *      - ESP_ERR_NOT_SUPPORTED if pixel_format, fb_count, fb_location, grab_mode,
+ *        xclk_freq_hz, conv_mode or swap_bytes differ
+ *      - ESP_ERR_INVALID_SIZE if the frame size needs larger buffers than were
+ *        allocated; initialize with the largest frame size that will be used
+ *      - ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE if the sensor rejected the size
+ */
+esp_err_t esp_camera_reconfigure(const camera_config_t *config);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "img_converters.h"
+
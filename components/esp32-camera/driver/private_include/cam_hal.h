@@ -47,16 +47,59 @@ esp_err_t cam_init(const camera_config_t *config);
 
 esp_err_t cam_config(const camera_config_t *config, framesize_t frame_size, uint16_t sensor_pid);
 
+void cam_set_alloc_caps(camera_alloc_t what, uint32_t caps);
+
+// caps chosen with esp_camera_set_alloc_caps(), or def if none
+uint32_t cam_alloc_caps(camera_alloc_t what, uint32_t def);
+
+/**
+ * @brief Switch the capture to another frame size, keeping the buffers allocated by cam_config
+ *
+ * Capture must be stopped. Frames still queued are dropped.
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_STATE Capture is running
+ *     - ESP_ERR_INVALID_SIZE The frame size needs larger buffers than were allocated
+ */
+esp_err_t cam_reconfig(framesize_t frame_size);
+
 void cam_stop(void);
 
 void cam_start(void);
 
+bool cam_is_running(void);
+
 camera_fb_t *cam_take(TickType_t timeout);
 
+camera_fb_t *cam_ref(camera_fb_t *dma_buffer);
+
 void cam_give(camera_fb_t *dma_buffer);
 
 void cam_give_all(void);
 
+esp_err_t cam_inject(const uint8_t *data, size_t len, TickType_t timeout);
+
+esp_err_t cam_get_timing(const camera_fb_t *fb, camera_fb_timing_t *timing);
+
+size_t cam_trace_read(camera_trace_event_t *events, size_t max, uint32_t *lost);
+
+void cam_get_stats(camera_stats_t *stats);
+
+size_t cam_get_fb_size(void);
+
+void cam_set_meta_task(TaskHandle_t task);
+
+void cam_set_meta(const camera_fb_meta_t *meta, uint32_t frame);
+
+esp_err_t cam_get_meta(const camera_fb_t *fb, camera_fb_meta_t *meta);
+
+esp_err_t cam_stream_begin(camera_fb_t **fb, TickType_t timeout);
+
+esp_err_t cam_stream_wait(camera_fb_t *fb, size_t *avail, TickType_t timeout);
+
+void cam_stream_cancel(camera_fb_t *fb);
+
 #ifdef __cplusplus
 }
 #endif
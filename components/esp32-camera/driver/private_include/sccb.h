@@ -9,14 +9,23 @@
 #ifndef __SCCB_H__
 #define __SCCB_H__
 #include <stdint.h>
+#include <stddef.h>
 int SCCB_Init(int pin_sda, int pin_scl);
 int SCCB_Use_Port(int sccb_i2c_port);
 int SCCB_Deinit(void);
 uint8_t SCCB_Probe(void);
+uint8_t SCCB_Probe_Addr(uint8_t slv_addr);
 uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg);
 int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data);
 uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg);
 int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data);
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg);
 int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data);
+// Register sequences: count {reg, value} pairs written in order to one device, which is looked up once.
+// SCCB_Write16_Seq() also sends each run of consecutive registers as one transaction of up to
+// SCCB_SEQ_BURST_MAX values, for sensors that increment the register address per data byte (OV5640).
+// Both stop at the first failed write.
+#define SCCB_SEQ_BURST_MAX 32
+int SCCB_Write_Seq(uint8_t slv_addr, const uint8_t (*regs)[2], size_t count);
+int SCCB_Write16_Seq(uint8_t slv_addr, const uint16_t (*regs)[2], size_t count);
 #endif // __SCCB_H__
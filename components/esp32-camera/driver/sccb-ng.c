@@ -198,9 +198,8 @@ int SCCB_Deinit(void)
     return ESP_OK;
 }
 
-uint8_t SCCB_Probe(void)
+uint8_t SCCB_Probe_Addr(uint8_t slv_addr)
 {
-    uint8_t slave_addr = 0x0;
     esp_err_t ret;
     i2c_master_bus_handle_t bus_handle;
 
@@ -208,9 +207,28 @@ uint8_t SCCB_Probe(void)
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "failed to get SCCB I2C Bus handle for port %d", sccb_i2c_port);
-        return ret;
+        return 0;
     }
 
+    if (i2c_master_probe(bus_handle, slv_addr, TIMEOUT_MS) != ESP_OK)
+    {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < device_count; i++)
+    {
+        if (devices[i].address == slv_addr)
+        {
+            return slv_addr; // already installed by an earlier probe
+        }
+    }
+    return (SCCB_Install_Device(slv_addr) == 0) ? slv_addr : 0;
+}
+
+uint8_t SCCB_Probe(void)
+{
+    uint8_t slave_addr = 0x0;
+
     for (size_t i = 0; i < CAMERA_MODEL_MAX; i++)
     {
         if (slave_addr == camera_sensor[i].sccb_addr)
@@ -219,14 +237,8 @@ uint8_t SCCB_Probe(void)
         }
         slave_addr = camera_sensor[i].sccb_addr;
 
-        ret = i2c_master_probe(bus_handle, slave_addr, TIMEOUT_MS);
-
-        if (ret == ESP_OK)
+        if (SCCB_Probe_Addr(slave_addr))
         {
-            if (SCCB_Install_Device(slave_addr) != 0)
-            {
-                return 0;
-            }
             return slave_addr;
         }
     }
@@ -307,6 +319,63 @@ int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data)
     return ret == ESP_OK ? 0 : -1;
 }
 
+int SCCB_Write_Seq(uint8_t slv_addr, const uint8_t (*regs)[2], size_t count)
+{
+    i2c_master_dev_handle_t *dev_handle = get_handle_from_address(slv_addr);
+    if (!dev_handle)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        esp_err_t ret = i2c_master_transmit(*dev_handle, regs[i], 2, TIMEOUT_MS);
+
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "SCCB_Write Failed addr:0x%02x, reg:0x%02x, data:0x%02x, ret:%d", slv_addr, regs[i][0], regs[i][1], ret);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int SCCB_Write16_Seq(uint8_t slv_addr, const uint16_t (*regs)[2], size_t count)
+{
+    i2c_master_dev_handle_t *dev_handle = get_handle_from_address(slv_addr);
+    if (!dev_handle)
+    {
+        return -1;
+    }
+
+    uint8_t tx_buffer[2 + SCCB_SEQ_BURST_MAX];
+    size_t i = 0;
+
+    while (i < count)
+    {
+        uint16_t reg = regs[i][0];
+        size_t n = 0;
+
+        tx_buffer[0] = reg >> 8;
+        tx_buffer[1] = reg & 0x00ff;
+        do
+        {
+            tx_buffer[2 + n] = regs[i + n][1];
+            n++;
+        } while (i + n < count && n < SCCB_SEQ_BURST_MAX && regs[i + n][0] == reg + n);
+
+        esp_err_t ret = i2c_master_transmit(*dev_handle, tx_buffer, 2 + n, TIMEOUT_MS);
+
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "W [%04x]=%02x +%u fail\n", reg, tx_buffer[2], n);
+            return -1;
+        }
+        i += n;
+    }
+    return 0;
+}
+
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
 {
     i2c_master_dev_handle_t dev_handle = *(get_handle_from_address(slv_addr));
@@ -93,6 +93,17 @@ int SCCB_Deinit(void)
     return i2c_driver_delete(sccb_i2c_port);
 }
 
+uint8_t SCCB_Probe_Addr(uint8_t slv_addr)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, ( slv_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(cmd);
+    return (ret == ESP_OK) ? slv_addr : 0;
+}
+
 uint8_t SCCB_Probe(void)
 {
     uint8_t slave_addr = 0x0;
@@ -102,13 +113,7 @@ uint8_t SCCB_Probe(void)
             continue;
         }
         slave_addr = camera_sensor[i].sccb_addr;
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, ( slave_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
-        i2c_master_stop(cmd);
-        esp_err_t ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
-        i2c_cmd_link_delete(cmd);
-        if( ret == ESP_OK) {
+        if (SCCB_Probe_Addr(slave_addr)) {
             return slave_addr;
         }
     }
@@ -259,3 +264,52 @@ int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data)
     }
     return ret == ESP_OK ? 0 : -1;
 }
+
+// one register write or auto-increment run, with the command link on the stack instead of the heap
+static esp_err_t sccb_write_buf(uint8_t slv_addr, const uint8_t *data, size_t len)
+{
+    uint8_t link_buf[I2C_LINK_RECOMMENDED_SIZE(3)] = { 0 };
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(link_buf, sizeof(link_buf));
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, ( slv_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
+    i2c_master_write(cmd, data, len, ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    i2c_cmd_link_delete_static(cmd);
+    return ret;
+}
+
+int SCCB_Write_Seq(uint8_t slv_addr, const uint8_t (*regs)[2], size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        esp_err_t ret = sccb_write_buf(slv_addr, regs[i], 2);
+        if(ret != ESP_OK) {
+            ESP_LOGE(TAG, "SCCB_Write Failed addr:0x%02x, reg:0x%02x, data:0x%02x, ret:%d", slv_addr, regs[i][0], regs[i][1], ret);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int SCCB_Write16_Seq(uint8_t slv_addr, const uint16_t (*regs)[2], size_t count)
+{
+    uint8_t tx_buffer[2 + SCCB_SEQ_BURST_MAX];
+    size_t i = 0;
+    while (i < count) {
+        uint16_t reg = regs[i][0];
+        size_t n = 0;
+        tx_buffer[0] = reg >> 8;
+        tx_buffer[1] = reg & 0x00ff;
+        do {
+            tx_buffer[2 + n] = regs[i + n][1];
+            n++;
+        } while (i + n < count && n < SCCB_SEQ_BURST_MAX && regs[i + n][0] == reg + n);
+        esp_err_t ret = sccb_write_buf(slv_addr, tx_buffer, 2 + n);
+        if(ret != ESP_OK) {
+            ESP_LOGE(TAG, "W [%04x]=%02x +%u fail\n", reg, tx_buffer[2], n);
+            return -1;
+        }
+        i += n;
+    }
+    return 0;
+}
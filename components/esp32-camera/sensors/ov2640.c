@@ -35,19 +35,25 @@ static int set_bank(sensor_t *sensor, ov2640_bank_t bank)
     return res;
 }
 
+// the registers between bank switches go out as one register sequence
 static int write_regs(sensor_t *sensor, const uint8_t (*regs)[2])
 {
     int i=0, res = 0;
     while (regs[i][0]) {
         if (regs[i][0] == BANK_SEL) {
             res = set_bank(sensor, regs[i][1]);
+            i++;
         } else {
-            res = SCCB_Write(sensor->slv_addr, regs[i][0], regs[i][1]);
+            int n = 0;
+            while (regs[i + n][0] && regs[i + n][0] != BANK_SEL) {
+                n++;
+            }
+            res = SCCB_Write_Seq(sensor->slv_addr, regs + i, n);
+            i += n;
         }
         if (res) {
             return res;
         }
-        i++;
     }
     return res;
 }
@@ -61,6 +67,21 @@ static int write_reg(sensor_t *sensor, ov2640_bank_t bank, uint8_t reg, uint8_t
     return ret;
 }
 
+// Writes a row of a level table (register addresses in row 0) as one register sequence
+static int write_reg_row(sensor_t *sensor, ov2640_bank_t bank, const uint8_t *regs, const uint8_t *values, int count)
+{
+    uint8_t seq[8][2];
+    int ret = set_bank(sensor, bank);
+    if(ret) {
+        return ret;
+    }
+    for (int i = 0; i < count; i++) {
+        seq[i][0] = regs[i];
+        seq[i][1] = values[i];
+    }
+    return SCCB_Write_Seq(sensor->slv_addr, seq, count);
+}
+
 static int set_reg_bits(sensor_t *sensor, uint8_t bank, uint8_t reg, uint8_t offset, uint8_t mask, uint8_t value)
 {
     int ret = 0;
@@ -253,9 +274,7 @@ static int set_contrast(sensor_t *sensor, int level)
         return -1;
     }
     sensor->status.contrast = level-3;
-    for (int i=0; i<7; i++) {
-        WRITE_REG_OR_RETURN(BANK_DSP, contrast_regs[0][i], contrast_regs[level][i]);
-    }
+    ret = write_reg_row(sensor, BANK_DSP, contrast_regs[0], contrast_regs[level], 7);
     return ret;
 }
 
@@ -267,9 +286,7 @@ static int set_brightness(sensor_t *sensor, int level)
         return -1;
     }
     sensor->status.brightness = level-3;
-    for (int i=0; i<5; i++) {
-        WRITE_REG_OR_RETURN(BANK_DSP, brightness_regs[0][i], brightness_regs[level][i]);
-    }
+    ret = write_reg_row(sensor, BANK_DSP, brightness_regs[0], brightness_regs[level], 5);
     return ret;
 }
 
@@ -281,9 +298,7 @@ static int set_saturation(sensor_t *sensor, int level)
         return -1;
     }
     sensor->status.saturation = level-3;
-    for (int i=0; i<5; i++) {
-        WRITE_REG_OR_RETURN(BANK_DSP, saturation_regs[0][i], saturation_regs[level][i]);
-    }
+    ret = write_reg_row(sensor, BANK_DSP, saturation_regs[0], saturation_regs[level], 5);
     return ret;
 }
 
@@ -295,9 +310,7 @@ static int set_special_effect(sensor_t *sensor, int effect)
         return -1;
     }
     sensor->status.special_effect = effect-1;
-    for (int i=0; i<5; i++) {
-        WRITE_REG_OR_RETURN(BANK_DSP, special_effects_regs[0][i], special_effects_regs[effect][i]);
-    }
+    ret = write_reg_row(sensor, BANK_DSP, special_effects_regs[0], special_effects_regs[effect], 5);
     return ret;
 }
 
@@ -310,9 +323,7 @@ static int set_wb_mode(sensor_t *sensor, int mode)
     sensor->status.wb_mode = mode;
     SET_REG_BITS_OR_RETURN(BANK_DSP, 0XC7, 6, 1, mode?1:0);
     if(mode) {
-        for (int i=0; i<3; i++) {
-            WRITE_REG_OR_RETURN(BANK_DSP, wb_modes_regs[0][i], wb_modes_regs[mode][i]);
-        }
+        ret = write_reg_row(sensor, BANK_DSP, wb_modes_regs[0], wb_modes_regs[mode], 3);
     }
     return ret;
 }
@@ -325,9 +336,7 @@ static int set_ae_level(sensor_t *sensor, int level)
         return -1;
     }
     sensor->status.ae_level = level-3;
-    for (int i=0; i<3; i++) {
-        WRITE_REG_OR_RETURN(BANK_SENSOR, ae_levels_regs[0][i], ae_levels_regs[level][i]);
-    }
+    ret = write_reg_row(sensor, BANK_SENSOR, ae_levels_regs[0], ae_levels_regs[level], 3);
     return ret;
 }
 
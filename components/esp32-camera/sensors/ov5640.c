@@ -142,16 +142,35 @@ static int set_reg_bits(uint8_t slv_addr, uint16_t reg, uint8_t offset, uint8_t
     return ret;
 }
 
+// Writes count {reg, value} pairs as one register sequence, runs of consecutive registers in one transaction
+static int write_reg_seq(uint8_t slv_addr, const uint16_t (*regs)[2], int count)
+{
+#ifndef REG_DEBUG_ON
+    return SCCB_Write16_Seq(slv_addr, regs, count);
+#else
+    int ret = 0;
+    for (int i = 0; !ret && i < count; i++) {
+        ret = write_reg(slv_addr, regs[i][0], regs[i][1]);
+    }
+    return ret;
+#endif
+}
+
 static int write_regs(uint8_t slv_addr, const uint16_t (*regs)[2])
 {
     int i = 0, ret = 0;
     while (!ret && regs[i][0] != REGLIST_TAIL) {
         if (regs[i][0] == REG_DLY) {
             vTaskDelay(regs[i][1] / portTICK_PERIOD_MS);
+            i++;
         } else {
-            ret = write_reg(slv_addr, regs[i][0], regs[i][1]);
+            int n = 0;
+            while (regs[i + n][0] != REGLIST_TAIL && regs[i + n][0] != REG_DLY) {
+                n++;
+            }
+            ret = write_reg_seq(slv_addr, regs + i, n);
+            i += n;
         }
-        i++;
     }
     return ret;
 }
@@ -874,12 +893,12 @@ static int set_saturation(sensor_t *sensor, int level)
     }
 
     uint8_t * regs = (uint8_t *)sensor_saturation_levels[level+4];
+    uint16_t seq[11][2];
     for(int i=0; i<11; i++) {
-        ret = write_reg(sensor->slv_addr, 0x5381 + i, regs[i]);
-        if (ret) {
-            break;
-        }
+        seq[i][0] = 0x5381 + i;
+        seq[i][1] = regs[i];
     }
+    ret = write_reg_seq(sensor->slv_addr, seq, 11);
 
     if (ret == 0) {
         ESP_LOGD(TAG, "Set saturation to: %d", level);
@@ -211,6 +211,7 @@ static void IRAM_ATTR ll_cam_vsync_isr(void *arg)
     // filter
     ets_delay_us(1);
     if (gpio_ll_get_level(&GPIO, cam->vsync_pin) == !cam->vsync_invert) {
+        CAM_TRACE(CAMERA_TRACE_VSYNC_ISR, cam->ev_vsync_cnt);
         ll_cam_send_event(cam, CAM_VSYNC_EVENT, &HPTaskAwoken);
         if (HPTaskAwoken == pdTRUE) {
             portYIELD_FROM_ISR();
@@ -233,6 +234,7 @@ static void IRAM_ATTR ll_cam_dma_isr(void *arg)
     I2S0.int_clr.val = status.val;
 
     if (status.in_suc_eof) {
+        CAM_TRACE(CAMERA_TRACE_EOF_ISR, cam->ev_eof_cnt);
         ll_cam_send_event(cam, CAM_IN_SUC_EOF_EVENT, &HPTaskAwoken);
     }
     if (HPTaskAwoken == pdTRUE) {
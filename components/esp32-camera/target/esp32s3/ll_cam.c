@@ -22,6 +22,7 @@
 #include "soc/gdma_reg.h"
 #include "hal/clk_gate_ll.h"
 #include "esp_private/gdma.h"
+#include "esp_timer.h"
 #include "ll_cam.h"
 #include "cam_hal.h"
 #include "esp_rom_gpio.h"
@@ -41,6 +42,15 @@
 
 static const char *TAG = "s3 ll_cam";
 
+#if CONFIG_CAMERA_CUT_THROUGH && CONFIG_CAMERA_CONTINUOUS_CAPTURE
+// continuous capture has one EOF per frame, cut-through progress comes from per-node done interrupts
+#define LL_CAM_DMA_DONE_INTR       1
+#define LL_CAM_DMA_INTR_MASK       (GDMA_IN_SUC_EOF_CH0_INT_ST_M | GDMA_IN_DONE_CH0_INT_ST_M)
+#else
+#define LL_CAM_DMA_DONE_INTR       0
+#define LL_CAM_DMA_INTR_MASK       GDMA_IN_SUC_EOF_CH0_INT_ST_M
+#endif
+
 void ll_cam_dma_print_state(cam_obj_t *cam)
 {
     esp_rom_printf("dma_infifo_status[%u]  :\n", cam->dma_num);
@@ -80,7 +90,12 @@ void ll_cam_dma_reset(cam_obj_t *cam)
         GDMA.channel[cam->dma_num].in.conf0.in_data_burst_en = 1;
     }
 
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+    // the frame buffer chains form one ring, stop in front of a buffer the application holds
+    GDMA.channel[cam->dma_num].in.conf1.in_check_owner = cam->continuous;
+#else
     GDMA.channel[cam->dma_num].in.conf1.in_check_owner = 0;
+#endif
     // GDMA.channel[cam->dma_num].in.conf1.in_ext_mem_bk_size = 2;
 
     GDMA.channel[cam->dma_num].in.peri_sel.sel = 5;
@@ -103,6 +118,10 @@ static void CAMERA_ISR_IRAM_ATTR ll_cam_vsync_isr(void *arg)
     LCD_CAM.lc_dma_int_clr.val = status.val;
 
     if (status.cam_vsync_int_st) {
+#if CONFIG_CAMERA_FRAME_TIMING
+        cam->vsync_isr_us = esp_timer_get_time();
+#endif
+        CAM_TRACE(CAMERA_TRACE_VSYNC_ISR, cam->ev_vsync_cnt);
         ll_cam_send_event(cam, CAM_VSYNC_EVENT, &HPTaskAwoken);
     }
 
@@ -124,7 +143,16 @@ static void CAMERA_ISR_IRAM_ATTR ll_cam_dma_isr(void *arg)
 
     GDMA.channel[cam->dma_num].in.int_clr.val = status.val;
 
+#if LL_CAM_DMA_DONE_INTR
+    if (status.in_done) {
+        ll_cam_send_event(cam, CAM_IN_DONE_EVENT, &HPTaskAwoken);
+    }
+#endif
     if (status.in_suc_eof) {
+#if CONFIG_CAMERA_FRAME_TIMING
+        cam->eof_isr_us = esp_timer_get_time();
+#endif
+        CAM_TRACE(CAMERA_TRACE_EOF_ISR, cam->ev_eof_cnt);
         ll_cam_send_event(cam, CAM_IN_SUC_EOF_EVENT, &HPTaskAwoken);
     }
 
@@ -139,6 +167,9 @@ bool IRAM_ATTR ll_cam_stop(cam_obj_t *cam)
         GDMA.channel[cam->dma_num].in.int_ena.in_suc_eof = 0;
         GDMA.channel[cam->dma_num].in.int_clr.in_suc_eof = 1;
     }
+#if LL_CAM_DMA_DONE_INTR
+    GDMA.channel[cam->dma_num].in.int_ena.in_done = 0;
+#endif
     GDMA.channel[cam->dma_num].in.link.stop = 1;
     return true;
 }
@@ -151,6 +182,13 @@ bool ll_cam_start(cam_obj_t *cam, int frame_pos)
         GDMA.channel[cam->dma_num].in.int_clr.in_suc_eof = 1;
         GDMA.channel[cam->dma_num].in.int_ena.in_suc_eof = 1;
     }
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+    GDMA.channel[cam->dma_num].in.int_clr.in_dscr_err = 1;
+#endif
+#if LL_CAM_DMA_DONE_INTR
+    GDMA.channel[cam->dma_num].in.int_clr.in_done = 1;
+    GDMA.channel[cam->dma_num].in.int_ena.in_done = cam->continuous;
+#endif
 
     LCD_CAM.cam_ctrl1.cam_reset = 1;
     LCD_CAM.cam_ctrl1.cam_reset = 0;
@@ -160,6 +198,9 @@ bool ll_cam_start(cam_obj_t *cam, int frame_pos)
     GDMA.channel[cam->dma_num].in.conf0.in_rst = 0;
 
     LCD_CAM.cam_ctrl1.cam_rec_data_bytelen = cam->dma_half_buffer_size - 1; // Ping pong operation
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+    LCD_CAM.cam_ctrl.cam_vs_eof_en = cam->continuous; // one EOF per frame, closing the frame's last descriptor
+#endif
 
     if (!cam->psram_mode) {
         GDMA.channel[cam->dma_num].in.link.addr = ((uint32_t)&cam->dma[0]) & 0xfffff;
@@ -174,6 +215,23 @@ bool ll_cam_start(cam_obj_t *cam, int frame_pos)
     return true;
 }
 
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+// Point GDMA at another frame buffer while LCD_CAM keeps running. Only valid right after the
+// VSYNC EOF: the sensor is in vertical blanking and the AFIFO is empty. Returns false when the
+// owner check stopped the channel, which needs the full ll_cam_start reset.
+bool ll_cam_next_frame(cam_obj_t *cam, int frame_pos)
+{
+    if (GDMA.channel[cam->dma_num].in.int_raw.in_dscr_err) {
+        return false;
+    }
+    GDMA.channel[cam->dma_num].in.link.stop = 1;
+    GDMA.channel[cam->dma_num].in.link.addr = ((uint32_t)&cam->frames[frame_pos].dma[0]) & 0xfffff;
+    GDMA.channel[cam->dma_num].in.link.start = 1;
+    return true;
+}
+
+#endif
+
 esp_err_t ll_cam_deinit(cam_obj_t *cam)
 {
     if (cam->cam_intr_handle) {
@@ -406,7 +464,7 @@ esp_err_t ll_cam_init_isr(cam_obj_t *cam)
 	esp_err_t ret = ESP_OK;
     ret = esp_intr_alloc_intrstatus(gdma_periph_signals.groups[0].pairs[cam->dma_num].rx_irq_id,
                                      ESP_INTR_FLAG_LOWMED | ESP_INTR_FLAG_SHARED | CAMERA_ISR_IRAM_FLAG,
-                                     (uint32_t)&GDMA.channel[cam->dma_num].in.int_st, GDMA_IN_SUC_EOF_CH0_INT_ST_M,
+                                     (uint32_t)&GDMA.channel[cam->dma_num].in.int_st, LL_CAM_DMA_INTR_MASK,
                                      ll_cam_dma_isr, cam, &cam->dma_intr_handle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "DMA interrupt allocation of camera failed");
@@ -533,19 +591,60 @@ bool ll_cam_dma_sizes(cam_obj_t *cam)
     return 1;
 }
 
+// PIE registers are saved on context switch since IDF 5.2; ll_cam_memcpy runs in cam_task, never in an ISR
+#define LL_CAM_PIE_ENABLED (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0))
+
+// Keep the Y bytes of YU/YV input: 8 input bytes -> 4 output bytes
+static inline void IRAM_ATTR ll_cam_yuv_to_gray(uint8_t *out, const uint8_t *in, size_t blocks)
+{
+    for (size_t i = 0; i < blocks; ++i) {
+        out[0] = in[0];
+        out[1] = in[2];
+        out[2] = in[4];
+        out[3] = in[6];
+        out += 4;
+        in += 8;
+    }
+}
+
+#if LL_CAM_PIE_ENABLED
+// 32 input bytes -> 16 output bytes per iteration; both pointers must be 16-byte aligned
+static inline void IRAM_ATTR ll_cam_yuv_to_gray_pie(uint8_t *out, const uint8_t *in, size_t blocks)
+{
+    for (size_t i = 0; i < blocks; ++i) {
+        __asm__ volatile (
+            "ee.vld.128.ip  q0, %0, 16\n"
+            "ee.vld.128.ip  q1, %0, 16\n"
+            "ee.vunzip.8    q0, q1\n"      // q0: even (Y) bytes, q1: odd (U/V) bytes
+            "ee.vst.128.ip  q0, %1, 16\n"
+            : "+r"(in), "+r"(out)
+            :
+            : "memory");
+    }
+}
+#endif
+
 size_t IRAM_ATTR ll_cam_memcpy(cam_obj_t *cam, uint8_t *out, const uint8_t *in, size_t len)
 {
     // YUV to Grayscale
     if (cam->in_bytes_per_pixel == 2 && cam->fb_bytes_per_pixel == 1) {
-        size_t end = len / 8;
-        for (size_t i = 0; i < end; ++i) {
-            out[0] = in[0];
-            out[1] = in[2];
-            out[2] = in[4];
-            out[3] = in[6];
-            out += 4;
-            in += 8;
+        size_t blocks = len / 8;
+#if LL_CAM_PIE_ENABLED
+        // scalar head until the output is aligned; the vector path needs the input aligned as well
+        size_t head = ((16 - ((uintptr_t)out & 15)) & 15) / 4;
+        if (((uintptr_t)out & 3) == 0 && head <= blocks && (((uintptr_t)in + head * 8) & 15) == 0) {
+            ll_cam_yuv_to_gray(out, in, head);
+            out += head * 4;
+            in += head * 8;
+            blocks -= head;
+            size_t vec = blocks / 4;
+            ll_cam_yuv_to_gray_pie(out, in, vec);
+            out += vec * 16;
+            in += vec * 32;
+            blocks -= vec * 4;
         }
+#endif
+        ll_cam_yuv_to_gray(out, in, blocks);
         return len / 2;
     }
 
@@ -34,6 +34,9 @@
 #include "freertos/queue.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
 
 #if __has_include("esp_private/periph_ctrl.h")
 # include "esp_private/periph_ctrl.h"
@@ -74,10 +77,15 @@
         }
 
 #define LCD_CAM_DMA_NODE_BUFFER_MAX_SIZE  (4092)
+#define CAM_EV_VSYNC_RING                 (8) //VSYNCs cam_task may fall behind before event order is lost
+#define CAM_NOTIFY_EOF                    (1UL << 0)
+#define CAM_NOTIFY_VSYNC                  (1UL << 1)
+#define CAM_NOTIFY_DONE                   (1UL << 2) //a DMA node finished (cut-through progress)
 
 typedef enum {
     CAM_IN_SUC_EOF_EVENT = 0,
-    CAM_VSYNC_EVENT
+    CAM_VSYNC_EVENT,
+    CAM_IN_DONE_EVENT
 } cam_event_t;
 
 typedef enum {
@@ -85,15 +93,40 @@ typedef enum {
     CAM_STATE_READ_BUF = 1,
 } cam_state_t;
 
-typedef struct {
+#if CONFIG_CAMERA_CUT_THROUGH
+typedef enum {
+    CAM_STREAM_IDLE = 0,
+    CAM_STREAM_WAIT,//reader waits for the next frame with data
+    CAM_STREAM_ACTIVE,//reader follows frames[stream_pos] while it is captured
+    CAM_STREAM_DONE,//frame complete, handed over by the next cam_stream_wait
+    CAM_STREAM_DROPPED,//frame dropped by cam_task, reader must give up on it
+    CAM_STREAM_CANCEL,//reader gave up, the frame goes to the queue when it completes
+} cam_stream_state_t;
+#endif
+
+// frame slots and cam_obj_t start on their own cache line: cam_task, the ISRs and cam_give on the
+// other core update them, and with the allocation policy they may sit in PSRAM
+#define CAM_CTRL_ALIGN 32
+
+typedef struct __attribute__((aligned(CAM_CTRL_ALIGN))) {
     camera_fb_t fb;
-    uint8_t en;
     //for RGB/YUV modes
     lldesc_t *dma;
     size_t fb_offset;
+    uint8_t jpeg_eoi;//JPEG end marker found by cam_task, fb.len is exact
+    uint32_t refcnt;//references held by the frame queue / users, slot is freed when it drops to 0
+#if CONFIG_CAMERA_FB_POOL
+    uint32_t cap;//pool slots: capacity of fb.buf
+#endif
+#if CONFIG_CAMERA_FRAME_TIMING
+    camera_fb_timing_t timing;
+#endif
+#if CONFIG_CAMERA_FB_META
+    camera_fb_meta_t meta;//latest register sample when the frame was queued
+#endif
 } cam_frame_t;
 
-typedef struct {
+typedef struct __attribute__((aligned(CAM_CTRL_ALIGN))) {
     uint32_t dma_bytes_per_item;
     uint32_t dma_buffer_size;
     uint32_t dma_half_buffer_size;
@@ -107,9 +140,20 @@ typedef struct {
     uint8_t  *dma_buffer;
 
     cam_frame_t *frames;
+    volatile uint32_t frame_free_mask;//bit x set: frames[x] is free for DMA (or, for a pool slot, for a copy)
+#if CONFIG_CAMERA_FB_POOL
+    uint32_t pool_cnt;//pool slots in frames[frame_cnt..], smallest first
+    uint8_t *pool;//one allocation holding the pool slots
+#endif
 
-    QueueHandle_t event_queue;
+    //ISR -> cam_task events: counters plus a task notification, nothing to overflow in the ISR
+    volatile uint32_t ev_eof_cnt;//DMA EOF events posted so far
+    volatile uint32_t ev_vsync_cnt;//VSYNC events posted so far
+    volatile uint32_t ev_vsync_eof[CAM_EV_VSYNC_RING];//ev_eof_cnt at each VSYNC, keeps EOFs ordered around it
     QueueHandle_t frame_buffer_queue;
+    camera_fb_t *mailbox;//CAMERA_GRAB_NEWEST: newest completed frame, taken with an atomic exchange
+    SemaphoreHandle_t mailbox_sem;//CAMERA_GRAB_NEWEST: given whenever a frame is posted
+    camera_grab_mode_t grab_mode;
     TaskHandle_t task_handle;
     intr_handle_t cam_intr_handle;
 
@@ -126,6 +170,9 @@ typedef struct {
     uint32_t recv_size;
     bool swap_data;
     bool psram_mode;
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+    bool continuous;//JPEG in psram_mode: engine keeps running, frames are handed off by relinking GDMA
+#endif
 
     //for RGB/YUV modes
     uint16_t width;
@@ -139,8 +186,36 @@ typedef struct {
     uint8_t fb_bytes_per_pixel;
 #endif
     uint32_t fb_size;
+    uint32_t fb_alloc_size;//bytes allocated per frame buffer by cam_config, fixed until cam_deinit
+    uint32_t dma_buffer_alloc_size;//ping-pong DMA buffer allocated by cam_config (not psram_mode)
+    uint32_t dma_node_alloc_cnt;//descriptors allocated per chain by cam_config
 
     cam_state_t state;
+    volatile bool running;//between cam_start and cam_stop
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t pm_apb;//held while running: XCLK comes from LEDC on APB and LCD_CAM samples PCLK
+    esp_pm_lock_handle_t pm_cpu;//held while cam_task has events to handle
+#endif
+    camera_stats_t stats;
+#if CONFIG_CAMERA_FRAME_TIMING
+    volatile int64_t vsync_isr_us;//set by the VSYNC ISR
+    volatile int64_t eof_isr_us;//set by the DMA EOF ISR
+#endif
+#if CONFIG_CAMERA_FB_META
+    TaskHandle_t meta_task;//notified with stats.frames every CONFIG_CAMERA_FB_META_INTERVAL frames
+    camera_fb_meta_t meta;//latest sample, guarded by meta_lock
+    uint32_t meta_frame;//stats.frames when the latest sample was requested
+    portMUX_TYPE meta_lock;
+#endif
+#if CONFIG_CAMERA_CUT_THROUGH
+    SemaphoreHandle_t stream_sem;//given when the cut-through frame gets data, completes or is dropped
+    portMUX_TYPE stream_lock;
+    volatile cam_stream_state_t stream_state;
+    int stream_pos;//slot followed by the cut-through reader
+    size_t stream_avail;//bytes of frames[stream_pos] the reader may access
+    uint32_t stream_node;//continuous: first descriptor of the current frame not yet counted
+    size_t stream_walk;//continuous: bytes in the descriptors before stream_node
+#endif
 } cam_obj_t;
 
 
@@ -160,6 +235,15 @@ esp_err_t ll_cam_set_sample_mode(cam_obj_t *cam, pixformat_t pix_format, uint32_
 void ll_cam_dma_print_state(cam_obj_t *cam);
 void ll_cam_dma_reset(cam_obj_t *cam);
 #endif
+#if CONFIG_CAMERA_CONTINUOUS_CAPTURE
+bool ll_cam_next_frame(cam_obj_t *cam, int frame_pos);
+#endif
 
 // implemented in cam_hal
 void ll_cam_send_event(cam_obj_t *cam, cam_event_t cam_event, BaseType_t * HPTaskAwoken);
+#if CONFIG_CAMERA_TRACE
+void cam_trace_record(camera_trace_id_t id, uint32_t arg);
+#define CAM_TRACE(id, arg) cam_trace_record((id), (arg))
+#else
+#define CAM_TRACE(id, arg)
+#endif
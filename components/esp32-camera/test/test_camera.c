@@ -1,14 +1,20 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "unity.h"
 #include <mbedtls/base64.h>
 #include "esp_log.h"
 #include "driver/i2c.h"
+#include "nvs_flash.h"
+#include "esp_cpu.h"
 
 #include "esp_camera.h"
+#include "img_converters.h"
+#include "ll_cam.h"
+#include "yuv.h"
 
 #ifdef CONFIG_IDF_TARGET_ESP32
 #define BOARD_WROVER_KIT 1
@@ -491,6 +497,193 @@ static void img_jpeg_decode_test(uint16_t pic_index, uint16_t lib_index)
     jpg_decode_test(lib_index, DECODE_RGB565, imgs[pic_index].buf, imgs[pic_index].length, imgs[pic_index].w, imgs[pic_index].h, 16);
 }
 
+// Conversion kernel micro-benchmark. Every kernel runs CAM_BENCH_REPEAT times per resolution and
+// the fastest run is reported in cycles per pixel. The first run on a board stores its results in
+// NVS as the baseline; later runs fail on any kernel more than CAM_BENCH_REGRESS_PCT slower.
+#define CAM_BENCH_REPEAT        3
+#define CAM_BENCH_QUALITY       12
+#define CAM_BENCH_REGRESS_PCT   10
+#define CAM_BENCH_NVS_NAMESPACE "cam_bench"
+#define CAM_BENCH_DMA_CHUNK     4096 // bytes handed to ll_cam_memcpy() per call, as one DMA half buffer
+
+typedef enum {
+    BENCH_FMT2JPG_RGB565,
+    BENCH_FMT2JPG_YUV422,
+    BENCH_FMT2RGB888_RGB565,
+    BENCH_FMT2RGB888_JPEG,
+    BENCH_JPG2RGB565,
+    BENCH_FMT2BMP_RGB565,
+    BENCH_YUV2RGB,
+    BENCH_LL_CAM_MEMCPY,
+    BENCH_LL_CAM_MEMCPY_GRAY,
+    BENCH_MAX,
+} bench_kernel_t;
+
+static const char *const g_bench_names[BENCH_MAX] = {
+    "fmt2jpg rgb565",
+    "fmt2jpg yuv422",
+    "fmt2rgb888 rgb565",
+    "fmt2rgb888 jpeg",
+    "jpg2rgb565",
+    "fmt2bmp rgb565",
+    "yuv2rgb",
+    "ll_cam_memcpy",
+    "ll_cam_memcpy gray",
+};
+
+typedef struct {
+    uint16_t w, h;
+    uint8_t *rgb565;
+    uint8_t *yuv422;
+    uint8_t *jpg;
+    size_t jpg_len;
+    uint8_t *out;       // big enough for the largest output, the RGB888 BMP
+    size_t out_size;
+    uint8_t *work;      // fmt2jpg_buf() scratch
+    uint8_t *dma;       // internal DMA capable source for ll_cam_memcpy(), like the driver's
+} bench_ctx_t;
+
+static bool bench_run(bench_kernel_t kernel, bench_ctx_t *ctx)
+{
+    size_t pixels = ctx->w * ctx->h;
+    size_t len;
+
+    switch (kernel) {
+    case BENCH_FMT2JPG_RGB565:
+        return fmt2jpg_buf(ctx->rgb565, pixels * 2, ctx->w, ctx->h, PIXFORMAT_RGB565, CAM_BENCH_QUALITY,
+                           ctx->out, ctx->out_size, ctx->work, &len);
+    case BENCH_FMT2JPG_YUV422:
+        return fmt2jpg_buf(ctx->yuv422, pixels * 2, ctx->w, ctx->h, PIXFORMAT_YUV422, CAM_BENCH_QUALITY,
+                           ctx->out, ctx->out_size, ctx->work, &len);
+    case BENCH_FMT2RGB888_RGB565:
+        return fmt2rgb888(ctx->rgb565, pixels * 2, PIXFORMAT_RGB565, ctx->out);
+    case BENCH_FMT2RGB888_JPEG:
+        return fmt2rgb888(ctx->jpg, ctx->jpg_len, PIXFORMAT_JPEG, ctx->out);
+    case BENCH_JPG2RGB565:
+        return jpg2rgb565(ctx->jpg, ctx->jpg_len, ctx->out, JPG_SCALE_NONE);
+    case BENCH_FMT2BMP_RGB565:
+        return fmt2bmp_buf(ctx->rgb565, pixels * 2, ctx->w, ctx->h, PIXFORMAT_RGB565, ctx->out, ctx->out_size, &len);
+    case BENCH_YUV2RGB: {
+        const uint8_t *in = ctx->yuv422;
+        uint8_t *out = ctx->out;
+        for (size_t i = 0; i < pixels; i += 2, in += 4, out += 6) {
+            yuv2rgb(in[0], in[1], in[3], &out[0], &out[1], &out[2]);
+            yuv2rgb(in[2], in[1], in[3], &out[3], &out[4], &out[5]);
+        }
+        return true;
+    }
+    case BENCH_LL_CAM_MEMCPY:
+    case BENCH_LL_CAM_MEMCPY_GRAY: {
+        // Same pattern as cam_task: one DMA sized chunk at a time from internal RAM into the frame buffer
+        static cam_obj_t cam;
+        cam.in_bytes_per_pixel = 2;
+        cam.fb_bytes_per_pixel = (kernel == BENCH_LL_CAM_MEMCPY_GRAY) ? 1 : 2;
+        uint8_t *out = ctx->out;
+        for (size_t off = 0; off < pixels * 2; off += CAM_BENCH_DMA_CHUNK) {
+            out += ll_cam_memcpy(&cam, out, ctx->dma, MIN(CAM_BENCH_DMA_CHUNK, pixels * 2 - off));
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static bool bench_ctx_init(bench_ctx_t *ctx, uint16_t w, uint16_t h)
+{
+    size_t pixels = w * h;
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->w = w;
+    ctx->h = h;
+    ctx->out_size = fmt2bmp_size(w, h, PIXFORMAT_RGB565);
+    ctx->rgb565 = heap_caps_malloc(pixels * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ctx->yuv422 = heap_caps_malloc(pixels * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ctx->jpg = heap_caps_malloc(pixels, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ctx->out = heap_caps_malloc(ctx->out_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ctx->work = heap_caps_malloc(fmt2jpg_work_size(w, PIXFORMAT_YUV422), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ctx->dma = heap_caps_malloc(CAM_BENCH_DMA_CHUNK, MALLOC_CAP_DMA);
+    if (!ctx->rgb565 || !ctx->yuv422 || !ctx->jpg || !ctx->out || !ctx->work || !ctx->dma) {
+        ESP_LOGE(TAG, "malloc for %ux%u benchmark buffers failed", w, h);
+        return false;
+    }
+
+    // Gradients rather than a flat field, so the JPEG kernels see real AC coefficients
+    uint16_t *rgb = (uint16_t *)ctx->rgb565;
+    for (size_t y = 0; y < h; y++) {
+        for (size_t x = 0; x < w; x++) {
+            uint8_t r = x * 255 / w, g = y * 255 / h, b = (x + y) & 0xff;
+            rgb[y * w + x] = ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+            uint8_t *yuv = &ctx->yuv422[(y * w + x) * 2];
+            yuv[0] = (r + g + b) / 3;
+            yuv[1] = (x & 1) ? b : r;
+        }
+    }
+    for (size_t i = 0; i < CAM_BENCH_DMA_CHUNK; i++) {
+        ctx->dma[i] = i & 0xff;
+    }
+    return fmt2jpg_buf(ctx->rgb565, pixels * 2, w, h, PIXFORMAT_RGB565, CAM_BENCH_QUALITY,
+                       ctx->jpg, pixels, ctx->work, &ctx->jpg_len);
+}
+
+static void bench_ctx_deinit(bench_ctx_t *ctx)
+{
+    heap_caps_free(ctx->rgb565);
+    heap_caps_free(ctx->yuv422);
+    heap_caps_free(ctx->jpg);
+    heap_caps_free(ctx->out);
+    heap_caps_free(ctx->work);
+    heap_caps_free(ctx->dma);
+}
+
+// Returns the number of kernels that regressed against the stored baseline
+static int conversions_bench(nvs_handle_t nvs, uint16_t w, uint16_t h)
+{
+    bench_ctx_t ctx;
+    int regressed = 0;
+
+    if (!bench_ctx_init(&ctx, w, h)) {
+        bench_ctx_deinit(&ctx);
+        return 1;
+    }
+
+    printf("%4u x %4u, jpeg %u bytes\n", w, h, (unsigned)ctx.jpg_len);
+    printf("kernel             , cycles/px, baseline\n");
+    for (bench_kernel_t k = 0; k < BENCH_MAX; k++) {
+        uint32_t best = UINT32_MAX;
+        for (int i = 0; i < CAM_BENCH_REPEAT; i++) {
+            uint32_t t = esp_cpu_get_cycle_count();
+            if (!bench_run(k, &ctx)) {
+                ESP_LOGE(TAG, "%s failed at %ux%u", g_bench_names[k], w, h);
+                best = 0;
+                break;
+            }
+            t = esp_cpu_get_cycle_count() - t;
+            best = MIN(best, t);
+        }
+        if (!best) {
+            regressed++;
+            continue;
+        }
+
+        // Hundredths of a cycle per pixel, stored per kernel and resolution
+        uint32_t cpp = (uint64_t)best * 100 / (w * h);
+        uint32_t base = 0;
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        snprintf(key, sizeof(key), "k%u_%ux%u", (unsigned)k, w, h);
+        if (nvs_get_u32(nvs, key, &base) != ESP_OK) {
+            nvs_set_u32(nvs, key, cpp);
+            base = cpp;
+        }
+        bool slow = cpp > base + base * CAM_BENCH_REGRESS_PCT / 100;
+        regressed += slow;
+        printf("%-19s, %5u.%02u, %5u.%02u%s\n", g_bench_names[k], (unsigned)(cpp / 100), (unsigned)(cpp % 100),
+               (unsigned)(base / 100), (unsigned)(base % 100), slow ? " REGRESSED" : "");
+    }
+
+    bench_ctx_deinit(&ctx);
+    return regressed;
+}
+
 /**
  * @brief i2c master initialization
  */
@@ -525,6 +718,26 @@ TEST_CASE("Conversions image 480x320 jpeg decode test", "[camera]")
     img_jpeg_decode_test(2, 0);
 }
 
+TEST_CASE("Conversions kernel micro-benchmark", "[camera]")
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        TEST_ESP_OK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    TEST_ESP_OK(ret);
+
+    nvs_handle_t nvs;
+    TEST_ESP_OK(nvs_open(CAM_BENCH_NVS_NAMESPACE, NVS_READWRITE, &nvs));
+    int regressed = 0;
+    regressed += conversions_bench(nvs, 320, 240);
+    regressed += conversions_bench(nvs, 640, 480);
+    regressed += conversions_bench(nvs, 800, 600);
+    TEST_ESP_OK(nvs_commit(nvs));
+    nvs_close(nvs);
+    TEST_ASSERT_EQUAL(0, regressed);
+}
+
 TEST_CASE("Camera driver uses an i2c port initialized by other devices test", "[camera]")
 {
     TEST_ESP_OK(i2c_master_init(I2C_MASTER_NUM));
@@ -0,0 +1,429 @@
+/**
+ ****************************************************************************************************
+ * @file        gateway.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       ESP-NOW图传网关: 重组各摄像头的分片, 经USB串口转发给PC
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 协议见 main/APP/espnow_proto.h. 接收回调只把包拷入队列, 重组线程按源地址找到对端(最多 GW_PEER_MAX 个),
+ * 收齐一帧立即回 ACK, 然后以 gw_relay_t 头 + 帧(frame_header_t + JPEG)写到USB-Serial-JTAG口.
+ * PC 端 tools/pc_viewer/espnow_serial.py 按源地址为每台摄像头建立一条TCP连接, 交给 viewer/ingest_server.
+ * 写串口超时的帧丢弃, PC端按 GW_RELAY_MAGIC 重新同步.
+ *
+ ****************************************************************************************************
+ */
+
+#include "espnow_proto.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "nvs_flash.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "driver/usb_serial_jtag.h"
+#include <string.h>
+
+
+#define GW_PEER_MAX                 8                               /* 同时接入的摄像头数 */
+#define GW_RX_QUEUE_LEN             48                              /* 接收回调到重组线程的包队列 */
+#define GW_THREAD_PRIO              10
+#define GW_THREAD_STACK             (4 * 1024)
+#define GW_OUT_BUF_SIZE             (32 * 1024)                     /* USB-Serial-JTAG发送缓冲 */
+#define GW_OUT_TIMEOUT_MS           100                             /* 写串口超时, 超时丢弃该帧 */
+#define GW_LOG_MS                   5000                            /* 输出统计的间隔 */
+#define GW_RELAY_MAGIC              0x57474E45                      /* 'ENGW' 小端 */
+
+/* 转发给PC的帧头(16字节, 小端), 后跟 len 字节的帧 */
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;                                                 /* GW_RELAY_MAGIC */
+    uint8_t  mac[ESP_NOW_ETH_ALEN];                                 /* 摄像头地址 */
+    uint16_t reserved;
+    uint32_t len;
+} gw_relay_t;
+
+/* 接收回调交给重组线程的包 */
+typedef struct
+{
+    uint8_t  mac[ESP_NOW_ETH_ALEN];
+    uint16_t len;
+    uint8_t  data[ESPNOW_PROTO_PKT_MAX];
+} gw_rx_t;
+
+/* 一台摄像头的重组状态 */
+typedef struct
+{
+    uint8_t  used;
+    uint8_t  done;                                                  /* 当前帧已收齐 */
+    uint8_t  mac[ESP_NOW_ETH_ALEN];
+    uint16_t frame_id;
+    uint16_t frag_count;
+    uint16_t frag_size;
+    uint16_t received;
+    uint32_t frame_len;
+    uint8_t  have[ESPNOW_PROTO_BITMAP_LEN];                         /* 已收到的分片 */
+    uint8_t *buf;                                                   /* 重组缓冲(PSRAM, ESPNOW_PROTO_FRAME_MAX) */
+    uint32_t frames;                                                /* 统计周期内转发的帧数 */
+    uint32_t lost;                                                  /* 统计周期内未收齐就被新帧取代的帧数 */
+} gw_peer_t;
+
+static const char *TAG = "gateway";
+static QueueHandle_t g_gw_rx = NULL;
+static gw_peer_t g_gw_peer[GW_PEER_MAX];
+static uint8_t g_gw_tx[ESPNOW_PROTO_PKT_MAX];
+static volatile uint32_t g_gw_rx_drop = 0;                          /* 队列满丢弃的包 */
+
+
+/**
+ * @brief       接收回调(WIFI任务中调用), 只拷贝入队
+ * @param       info : 接收信息
+ * @param       data : 数据
+ * @param       len  : 长度
+ * @retval      无
+ */
+static void gw_recv_cb(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    static gw_rx_t rx;                                              /* 只在WIFI任务中使用 */
+
+    if (!espnow_pkt_valid(data, len) || len > ESPNOW_PROTO_PKT_MAX)
+    {
+        return;
+    }
+
+    memcpy(rx.mac, info->src_addr, ESP_NOW_ETH_ALEN);
+    rx.len = (uint16_t)len;
+    memcpy(rx.data, data, len);
+
+    if (xQueueSend(g_gw_rx, &rx, 0) != pdTRUE)
+    {
+        g_gw_rx_drop++;                                             /* 摄像头询问时按NACK重发 */
+    }
+}
+
+/**
+ * @brief       按地址查找对端, 不存在时登记并加为ESP-NOW单播对端
+ * @param       mac : 摄像头地址
+ * @retval      对端, NULL:已满或内存不足
+ */
+static gw_peer_t *gw_peer_get(const uint8_t *mac)
+{
+    esp_now_peer_info_t info = { 0 };
+    gw_peer_t *free_slot = NULL;
+
+    for (int i = 0; i < GW_PEER_MAX; i++)
+    {
+        if (g_gw_peer[i].used && memcmp(g_gw_peer[i].mac, mac, ESP_NOW_ETH_ALEN) == 0)
+        {
+            return &g_gw_peer[i];
+        }
+
+        if (!g_gw_peer[i].used && free_slot == NULL)
+        {
+            free_slot = &g_gw_peer[i];
+        }
+    }
+
+    if (free_slot == NULL)
+    {
+        return NULL;
+    }
+
+    if (free_slot->buf == NULL)
+    {
+        free_slot->buf = heap_caps_malloc(ESPNOW_PROTO_FRAME_MAX, MALLOC_CAP_SPIRAM);
+
+        if (free_slot->buf == NULL)
+        {
+            ESP_LOGE(TAG, "no memory for peer " MACSTR, MAC2STR(mac));
+            return NULL;
+        }
+    }
+
+    memcpy(info.peer_addr, mac, ESP_NOW_ETH_ALEN);
+    info.channel = ESPNOW_PROTO_CHANNEL;
+    info.ifidx = WIFI_IF_STA;
+    info.encrypt = false;
+
+    if (!esp_now_is_peer_exist(mac) && esp_now_add_peer(&info) != ESP_OK)
+    {
+        return NULL;
+    }
+
+    memcpy(free_slot->mac, mac, ESP_NOW_ETH_ALEN);
+    free_slot->used = 1;
+    free_slot->done = 0;
+    free_slot->frag_count = 0;
+    free_slot->frame_id = 0;
+    free_slot->received = 0;
+    ESP_LOGI(TAG, "camera " MACSTR " joined", MAC2STR(mac));
+    return free_slot;
+}
+
+/**
+ * @brief       开始重组一帧(DATA或POLL带来了新的帧编号)
+ * @param       peer : 对端
+ * @param       pkt  : 包头
+ * @retval      1:参数合法; 0:帧过大或分片参数不一致
+ */
+static int gw_peer_begin(gw_peer_t *peer, const espnow_pkt_t *pkt)
+{
+    if (peer->frag_count != 0 && !peer->done)
+    {
+        peer->lost++;
+    }
+
+    peer->frame_id = pkt->frame_id;
+    peer->frag_count = 0;
+    peer->received = 0;
+    peer->done = 0;
+    memset(peer->have, 0, sizeof(peer->have));
+
+    if (pkt->frag_count == 0 || pkt->frag_size == 0 || pkt->frame_len > ESPNOW_PROTO_FRAME_MAX ||
+        (uint32_t)pkt->frag_size * (pkt->frag_count - 1) >= pkt->frame_len ||
+        (uint32_t)pkt->frag_size * pkt->frag_count < pkt->frame_len)
+    {
+        return 0;
+    }
+
+    peer->frag_count = pkt->frag_count;
+    peer->frag_size = pkt->frag_size;
+    peer->frame_len = pkt->frame_len;
+    return 1;
+}
+
+/**
+ * @brief       回复摄像头(ACK/NACK/HELLO), 发送失败时摄像头超时后会再询问
+ * @param       mac  : 摄像头地址
+ * @param       peer : 对端(HELLO时为NULL)
+ * @param       type : 包类型
+ * @retval      无
+ */
+static void gw_reply(const uint8_t *mac, gw_peer_t *peer, uint8_t type)
+{
+    espnow_pkt_t *pkt = (espnow_pkt_t *)g_gw_tx;
+    uint8_t *bitmap = g_gw_tx + sizeof(espnow_pkt_t);
+    size_t len = sizeof(espnow_pkt_t);
+
+    espnow_pkt_init(pkt, type, peer ? peer->frame_id : 0);
+
+    if (type == ESPNOW_PKT_NACK)
+    {
+        len += (peer->frag_count + 7) / 8;
+
+        for (uint16_t i = 0; i < (peer->frag_count + 7) / 8; i++)
+        {
+            bitmap[i] = (uint8_t)~peer->have[i];
+        }
+
+        if (peer->frag_count & 7)
+        {
+            bitmap[peer->frag_count >> 3] &= (uint8_t)((1 << (peer->frag_count & 7)) - 1);
+        }
+
+        pkt->frag_count = peer->frag_count;
+    }
+
+    esp_now_send(mac, g_gw_tx, len);
+}
+
+/**
+ * @brief       把收齐的帧写到USB-Serial-JTAG口
+ * @param       peer : 对端
+ * @retval      无
+ */
+static void gw_relay(gw_peer_t *peer)
+{
+    gw_relay_t hdr = {
+        .magic = GW_RELAY_MAGIC,
+        .reserved = 0,
+        .len = peer->frame_len,
+    };
+    TickType_t timeout = pdMS_TO_TICKS(GW_OUT_TIMEOUT_MS);
+
+    memcpy(hdr.mac, peer->mac, ESP_NOW_ETH_ALEN);
+
+    if (usb_serial_jtag_write_bytes(&hdr, sizeof(hdr), timeout) == sizeof(hdr) &&
+        usb_serial_jtag_write_bytes(peer->buf, peer->frame_len, timeout) == (int)peer->frame_len)
+    {
+        peer->frames++;
+    }
+}
+
+/**
+ * @brief       处理一个包
+ * @param       rx : 收到的包
+ * @retval      无
+ */
+static void gw_handle(const gw_rx_t *rx)
+{
+    const espnow_pkt_t *pkt = (const espnow_pkt_t *)rx->data;
+    gw_peer_t *peer = gw_peer_get(rx->mac);
+    uint32_t off;
+    uint32_t len;
+
+    if (peer == NULL)
+    {
+        return;
+    }
+
+    switch (pkt->type)
+    {
+        case ESPNOW_PKT_HELLO:
+            peer->frag_count = 0;                                   /* 摄像头重启后帧编号从0开始 */
+            peer->done = 0;
+            gw_reply(rx->mac, NULL, ESPNOW_PKT_HELLO);
+            break;
+
+        case ESPNOW_PKT_DATA:
+            if ((pkt->frame_id != peer->frame_id || peer->frag_count == 0) && !gw_peer_begin(peer, pkt))
+            {
+                break;
+            }
+
+            if (peer->done || pkt->frag >= peer->frag_count || pkt->frag_size != peer->frag_size ||
+                (peer->have[pkt->frag >> 3] & (1 << (pkt->frag & 7))))
+            {
+                break;                                              /* 已收齐、参数不符或重复的分片 */
+            }
+
+            off = (uint32_t)pkt->frag * peer->frag_size;
+            len = rx->len - sizeof(espnow_pkt_t);
+
+            if (off + len > peer->frame_len)
+            {
+                break;
+            }
+
+            memcpy(peer->buf + off, rx->data + sizeof(espnow_pkt_t), len);
+            peer->have[pkt->frag >> 3] |= (uint8_t)(1 << (pkt->frag & 7));
+
+            if (++peer->received == peer->frag_count)
+            {
+                peer->done = 1;
+                gw_reply(rx->mac, peer, ESPNOW_PKT_ACK);            /* 先放行摄像头, 再写串口 */
+                gw_relay(peer);
+            }
+            break;
+
+        case ESPNOW_PKT_POLL:
+            if (pkt->frame_id != peer->frame_id && !gw_peer_begin(peer, pkt))
+            {
+                break;                                              /* 一片都没收到: 位图全1 */
+            }
+
+            if (peer->frag_count != 0)
+            {
+                gw_reply(rx->mac, peer, peer->done ? ESPNOW_PKT_ACK : ESPNOW_PKT_NACK);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief       重组线程
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void gw_thread(void *pvParameters)
+{
+    static gw_rx_t rx;
+    int64_t log_start = esp_timer_get_time();
+    int64_t now;
+
+    (void)pvParameters;
+
+    while (1)
+    {
+        if (xQueueReceive(g_gw_rx, &rx, pdMS_TO_TICKS(GW_LOG_MS)) == pdTRUE)
+        {
+            gw_handle(&rx);
+        }
+
+        now = esp_timer_get_time();
+
+        if (now - log_start < GW_LOG_MS * 1000LL)
+        {
+            continue;
+        }
+
+        for (int i = 0; i < GW_PEER_MAX; i++)
+        {
+            if (g_gw_peer[i].used)
+            {
+                ESP_LOGI(TAG, MACSTR ": %.1f fps, %lu frames lost", MAC2STR(g_gw_peer[i].mac),
+                         (double)g_gw_peer[i].frames * 1e6 / (double)(now - log_start),
+                         (unsigned long)g_gw_peer[i].lost);
+                g_gw_peer[i].frames = 0;
+                g_gw_peer[i].lost = 0;
+            }
+        }
+
+        if (g_gw_rx_drop)
+        {
+            ESP_LOGW(TAG, "%lu packets dropped (queue full)", (unsigned long)g_gw_rx_drop);
+            g_gw_rx_drop = 0;
+        }
+
+        log_start = now;
+    }
+}
+
+/**
+ * @brief       程序入口
+ * @param       无
+ * @retval      无
+ */
+void app_main(void)
+{
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    usb_serial_jtag_driver_config_t usb_cfg = {
+        .tx_buffer_size = GW_OUT_BUF_SIZE,
+        .rx_buffer_size = 256,
+    };
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    esp_err_t ret;
+
+    ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ESP_ERROR_CHECK(nvs_flash_init());
+    }
+
+    ESP_ERROR_CHECK(usb_serial_jtag_driver_install(&usb_cfg));
+
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_start());
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));                 /* 网关一直收听 */
+    ESP_ERROR_CHECK(esp_wifi_set_channel(ESPNOW_PROTO_CHANNEL, WIFI_SECOND_CHAN_NONE));
+
+    g_gw_rx = xQueueCreate(GW_RX_QUEUE_LEN, sizeof(gw_rx_t));
+    assert(g_gw_rx);
+
+    ESP_ERROR_CHECK(esp_now_init());
+    ESP_ERROR_CHECK(esp_now_register_recv_cb(gw_recv_cb));
+    xTaskCreatePinnedToCore(gw_thread, "gw_thread", GW_THREAD_STACK, NULL, GW_THREAD_PRIO, NULL, 1);
+
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    ESP_LOGI(TAG, "espnow gateway " MACSTR " on channel %d", MAC2STR(mac), ESPNOW_PROTO_CHANNEL);
+}
@@ -0,0 +1,146 @@
+/**
+ ****************************************************************************************************
+ * @file        av_audio.cc
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       ES8388麦克风采集, 与图像帧在同一连接上发送(音画同步)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "av_audio.h"
+#include "task_topo.h"
+#include <stdlib.h>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "es8388_audio_codec.h"
+
+extern "C" {
+#include "myiic.h"
+#include "lwip_demo.h"
+#include "sd_recorder.h"
+#include "trace.h"
+#include "pm_ctrl.h"
+#include "load_gov.h"
+}
+
+
+/* ES8388引脚(ATK-DNESP32S3) */
+#define AV_AUDIO_PIN_MCLK           GPIO_NUM_3
+#define AV_AUDIO_PIN_WS             GPIO_NUM_9
+#define AV_AUDIO_PIN_BCLK           GPIO_NUM_46
+#define AV_AUDIO_PIN_DIN            GPIO_NUM_14                     /* MIC -> ESP */
+#define AV_AUDIO_PIN_DOUT           GPIO_NUM_10                     /* ESP -> SPK */
+
+static Es8388AudioCodec *g_av_codec = nullptr;
+
+
+/**
+ * @brief       音频采集线程函数
+ * @note        时间戳 = 对齐点 + 已读采样数 / 采样率, 避免逐帧调度抖动; 实测值为驱动按I2S DMA完成时刻推算的
+ *              首个采样时间, 两者偏差超过 AV_AUDIO_RESYNC_US 时以实测值重新对齐
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void av_audio_thread(void *pvParameters)
+{
+    (void)pvParameters;
+    const int channels = g_av_codec->input_channels();
+    const size_t samples = AV_AUDIO_SAMPLE_RATE * AV_AUDIO_FRAME_MS / 1000;
+    std::vector<int16_t> frame(samples * channels);
+    int64_t base_us = 0;                                            /* 对齐点 */
+    uint64_t count = 0;                                             /* 对齐后已读的采样数 */
+    int64_t measured;
+    int64_t expected;
+    int64_t start;
+
+    load_gov_watch(LOAD_GOV_AUDIO);                                 /* 只统计占用, 不降级 */
+
+    while (1)
+    {
+        start = esp_timer_get_time();
+
+        if (!g_av_codec->InputData(frame.data(), (int)frame.size(), &measured))
+        {
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+
+        trace_complete(TRACE_I2S_READ, start, esp_timer_get_time(), (uint32_t)(frame.size() * sizeof(int16_t)));
+        pm_ctrl_acquire(PM_CTRL_AUDIO);                             /* 等待I2S期间不持有, CPU可降频 */
+        expected = base_us + (int64_t)(count * 1000000ULL / AV_AUDIO_SAMPLE_RATE);
+
+        if (base_us == 0 || llabs(measured - expected) > AV_AUDIO_RESYNC_US)
+        {
+            base_us = measured;
+            count = 0;
+            expected = measured;
+        }
+
+        count += samples;
+        lwip_send_audio(frame.data(), frame.size() * sizeof(int16_t), AV_AUDIO_SAMPLE_RATE, (uint8_t)channels, (uint64_t)expected);
+        sd_recorder_offer_audio(frame.data(), frame.size() * sizeof(int16_t), AV_AUDIO_SAMPLE_RATE, (uint8_t)channels, (uint64_t)expected);
+        pm_ctrl_release(PM_CTRL_AUDIO);
+    }
+}
+
+/**
+ * @brief       初始化音频采集线程
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:内存不足
+ */
+esp_err_t av_audio_init(void)
+{
+#if AV_AUDIO_EN
+    static StackType_t stack[AV_AUDIO_THREAD_STACK];               /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+    static Es8388AudioCodec codec(myiic_bus_get(), IIC_NUM_PORT, AV_AUDIO_SAMPLE_RATE, AV_AUDIO_SAMPLE_RATE,
+                                  AV_AUDIO_PIN_MCLK, AV_AUDIO_PIN_BCLK, AV_AUDIO_PIN_WS, AV_AUDIO_PIN_DOUT, AV_AUDIO_PIN_DIN,
+                                  GPIO_NUM_NC, ES8388_CODEC_DEFAULT_ADDR, false);
+
+    g_av_codec = &codec;
+    g_av_codec->Start();
+    g_av_codec->EnableOutput(false);                                /* 只上传麦克风 */
+
+    if (xTaskCreateStaticPinnedToCore(av_audio_thread, "av_audio_thread", AV_AUDIO_THREAD_STACK, NULL,
+                                      AV_AUDIO_THREAD_PRIO, stack, &tcb, AV_AUDIO_THREAD_CORE) == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI("TAG", "audio %d Hz, %d ms per frame", AV_AUDIO_SAMPLE_RATE, AV_AUDIO_FRAME_MS);
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief       读取I2S DMA的溢出/欠载次数
+ * @param       rx_overflow  : 输出, 采集缓冲在被读取前被覆盖的次数
+ * @param       tx_underflow : 输出, 播放缓冲耗尽的次数(只上传麦克风时持续增长, 无意义)
+ * @retval      无
+ */
+void av_audio_i2s_stats(uint32_t *rx_overflow, uint32_t *tx_underflow)
+{
+    AudioI2sStats stats = {};
+
+    if (g_av_codec != nullptr)
+    {
+        stats = g_av_codec->i2s_stats();
+    }
+
+    *rx_overflow = stats.rx_overflow;
+    *tx_underflow = stats.tx_underflow;
+}
@@ -0,0 +1,49 @@
+/**
+ ****************************************************************************************************
+ * @file        av_audio.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       ES8388麦克风采集, 与图像帧在同一连接上发送(音画同步)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 复用 atk_s3_audio_stream/components/audio 中的 ES8388 驱动, IIC总线由 myiic 统一管理.
+ * 每 AV_AUDIO_FRAME_MS 读取一段PCM, 以 FRAME_FLAG_AUDIO 帧经 lwip_send_audio 发送, 同时交给SD卡录像(sd_recorder_offer_audio);
+ * 时间戳按采样点数推算(第一个采样点的 esp_timer 时间), 与 fb->timestamp 使用同一时钟
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __AV_AUDIO_H
+#define __AV_AUDIO_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+
+#define AV_AUDIO_EN                 1                               /* 1:同时采集并发送音频 */
+#define AV_AUDIO_SAMPLE_RATE        24000                           /* 采样率 */
+#define AV_AUDIO_FRAME_MS           20                              /* 每个音频帧的时长 */
+#define AV_AUDIO_RESYNC_US          5000                            /* 推算时间与实际读取时间偏差超过该值时(如DMA溢出丢数据)重新对齐 */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 函数声明 */
+esp_err_t av_audio_init(void);                                      /* 初始化音频采集线程 */
+void av_audio_i2s_stats(uint32_t *rx_overflow, uint32_t *tx_underflow);    /* I2S DMA溢出/欠载次数, 未使能时为0 */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
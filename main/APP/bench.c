@@ -0,0 +1,372 @@
+/**
+ ****************************************************************************************************
+ * @file        bench.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       端到端推流基准测试: 扫描参数组合, 每个组合的测量结果以JSON行输出
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "bench.h"
+#include "task_topo.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "sdkconfig.h"
+#include "lwip/sockets.h"
+#include "esp_heap_caps.h"
+#include "lwip_demo.h"
+#include "frame_proto.h"
+#include "wifi_profile.h"
+#include "bench_kernel.h"
+#include "net_qos.h"
+
+
+/* 一个组合的测量结果 */
+typedef struct
+{
+    uint32_t frames;                                                /* 测量期间取得的帧数 */
+    uint32_t captured;                                              /* 驱动入队的帧数 */
+    uint32_t dropped;                                               /* 驱动丢弃的帧数(SOI/EOI/溢出) */
+    uint64_t bytes;                                                 /* 图像字节数 */
+    uint64_t sent_bytes;                                            /* 已发送的字节数 */
+    int64_t get_us;                                                 /* esp_camera_fb_get() 等待时间之和 */
+    int64_t sensor_us;                                              /* VSYNC -> DMA EOF 之和 */
+    uint32_t sensor_frames;                                         /* 有驱动时间戳的帧数 */
+    int64_t send_us;                                                /* 发送阻塞时间之和 */
+    int64_t elapsed_us;                                             /* 实际测量时长 */
+    size_t heap_int_min;                                            /* 内部RAM剩余最低值 */
+    size_t heap_psram_min;                                          /* PSRAM剩余最低值 */
+    float load[portNUM_PROCESSORS];                                 /* 各核CPU占用 */
+} bench_result_t;
+
+static const char *g_bench_grab_name[] = { "when_empty", "latest", "newest" };
+static const char *g_bench_wifi_name[] = { "throughput", "latency", "battery" };
+static camera_config_t g_bench_config;                              /* 当前摄像头配置 */
+static int g_bench_sock = -1;                                       /* 与服务器的连接, -1:未连接 */
+static int64_t g_bench_rtt_us = 0;                                  /* 建立连接的耗时(三次握手, 约一个RTT) */
+static uint32_t g_bench_seq = 0;
+
+
+/**
+ * @brief       发送全部数据(阻塞)
+ * @param       data : 数据
+ * @param       len  : 长度
+ * @retval      0:成功; -1:连接断开(已关闭套接字)
+ */
+static int bench_send_all(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    int ret;
+
+    while (len > 0)
+    {
+        ret = send(g_bench_sock, p, len, 0);
+
+        if (ret > 0)
+        {
+            p += ret;
+            len -= ret;
+        }
+        else if (ret < 0 && (errno == EINTR || errno == EAGAIN))
+        {
+            vTaskDelay(1);
+        }
+        else
+        {
+            closesocket(g_bench_sock);
+            g_bench_sock = -1;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief       连接服务器(未连接时在每个组合开始前调用一次, 失败时本组合只测采集)
+ * @param       无
+ * @retval      无
+ */
+static void bench_connect(void)
+{
+    struct sockaddr_in addr;
+
+    if (g_bench_sock >= 0)
+    {
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    inet_pton(AF_INET, IP_ADDR, &addr.sin_addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(LWIP_DEMO_PORT);
+
+    g_bench_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+
+    if (g_bench_sock >= 0)
+    {
+        net_qos_set(g_bench_sock, NET_QOS_BULK_DSCP);               /* 测试流量不挤占视频与语音 */
+    }
+
+    g_bench_rtt_us = esp_timer_get_time();
+
+    if (g_bench_sock >= 0 && connect(g_bench_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        closesocket(g_bench_sock);
+        g_bench_sock = -1;
+    }
+
+    g_bench_rtt_us = (g_bench_sock >= 0) ? esp_timer_get_time() - g_bench_rtt_us : 0;
+
+    g_bench_seq = 0;
+}
+
+/**
+ * @brief       按 fb_count/grab_mode 重新初始化摄像头
+ * @param       fb_count  : 帧缓存数
+ * @param       grab_mode : 取帧模式
+ * @retval      ESP_OK:成功; 其他:初始化失败
+ */
+static esp_err_t bench_camera_reinit(size_t fb_count, camera_grab_mode_t grab_mode)
+{
+    esp_camera_deinit();
+
+    g_bench_config.fb_count = fb_count;
+    g_bench_config.grab_mode = grab_mode;
+
+    return esp_camera_init(&g_bench_config);
+}
+
+/**
+ * @brief       测量当前参数组合
+ * @param       result : 输出测量结果
+ * @retval      无
+ */
+static void bench_measure(bench_result_t *result)
+{
+    camera_stats_t start_stats;
+    camera_stats_t end_stats;
+    camera_fb_timing_t t;
+    frame_header_t hdr;
+    camera_fb_t *fb;
+    int64_t start;
+    int64_t now;
+    int64_t t0;
+    size_t free_size;
+
+    memset(result, 0, sizeof(bench_result_t));
+    result->heap_int_min = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    result->heap_psram_min = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+    for (int i = 0; i < BENCH_WARMUP_FRAMES; i++)
+    {
+        fb = esp_camera_fb_get();
+
+        if (fb != NULL)
+        {
+            esp_camera_fb_return(fb);
+        }
+    }
+
+    memset(&start_stats, 0, sizeof(start_stats));
+    esp_camera_get_stats(&start_stats);
+    task_topo_core_load(result->load);                              /* 从这里开始计算CPU占用 */
+    start = esp_timer_get_time();
+    now = start;
+
+    while (now - start < (int64_t)BENCH_RUN_MS * 1000)
+    {
+        t0 = esp_timer_get_time();
+        fb = esp_camera_fb_get();
+        now = esp_timer_get_time();
+        result->get_us += now - t0;
+
+        if (fb == NULL)
+        {
+            continue;
+        }
+
+        result->frames++;
+        result->bytes += fb->len;
+
+        if (esp_camera_fb_get_timing(fb, &t) == ESP_OK && t.dma_eof_us > t.vsync_us)
+        {
+            result->sensor_us += t.dma_eof_us - t.vsync_us;
+            result->sensor_frames++;
+        }
+
+        if (g_bench_sock >= 0)
+        {
+            frame_header_fill(&hdr, fb, g_bench_seq++);
+            t0 = esp_timer_get_time();
+
+            if (bench_send_all(&hdr, sizeof(hdr)) == 0 && bench_send_all(fb->buf, fb->len) == 0)
+            {
+                result->sent_bytes += sizeof(hdr) + fb->len;
+            }
+
+            result->send_us += esp_timer_get_time() - t0;
+        }
+
+        esp_camera_fb_return(fb);
+
+        free_size = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        result->heap_int_min = (free_size < result->heap_int_min) ? free_size : result->heap_int_min;
+        free_size = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+        result->heap_psram_min = (free_size < result->heap_psram_min) ? free_size : result->heap_psram_min;
+        now = esp_timer_get_time();
+    }
+
+    result->elapsed_us = now - start;
+    task_topo_core_load(result->load);
+
+    memset(&end_stats, 0, sizeof(end_stats));
+    esp_camera_get_stats(&end_stats);
+    result->captured = end_stats.frames - start_stats.frames;
+    result->dropped = (end_stats.no_soi - start_stats.no_soi) + (end_stats.no_eoi - start_stats.no_eoi) +
+                      (end_stats.fb_overflow - start_stats.fb_overflow) +
+                      (end_stats.event_overflow - start_stats.event_overflow);
+}
+
+/**
+ * @brief       输出一个组合的结果(串口, 已连接时同时发送到服务器)
+ * @param       quality : JPEG质量
+ * @param       profile : Wi-Fi组合
+ * @param       r       : 测量结果
+ * @retval      无
+ */
+static void bench_report(int quality, wifi_profile_t profile, const bench_result_t *r)
+{
+    static char line[640];
+    frame_header_t hdr;
+    double sec = (r->elapsed_us > 0) ? r->elapsed_us / 1e6 : 1.0;
+    double wnd_kbps = (g_bench_rtt_us > 0) ? CONFIG_LWIP_TCP_SND_BUF_DEFAULT * 8 * 1000.0 / g_bench_rtt_us : 0.0;
+    int len;
+
+    len = snprintf(line, sizeof(line),
+                   "{\"framesize\":%d,\"width\":%u,\"height\":%u,\"quality\":%d,\"fb_count\":%u,\"grab_mode\":\"%s\","
+                   "\"wifi\":\"%s\",\"connected\":%d,\"frames\":%lu,\"capture_fps\":%.2f,\"stream_fps\":%.2f,"
+                   "\"sensor_us\":%lld,\"get_us\":%lld,\"bytes_per_frame\":%llu,\"kbps\":%.1f,\"send_block_us\":%lld,"
+                   "\"snd_buf\":%u,\"rtt_us\":%lld,\"wnd_kbps\":%.1f,"
+                   "\"cpu0\":%.1f,\"cpu1\":%.1f,\"heap_int_min\":%u,\"heap_psram_min\":%u,\"dropped\":%lu}\n",
+                   (int)g_bench_config.frame_size,
+                   (unsigned)resolution[g_bench_config.frame_size].width,
+                   (unsigned)resolution[g_bench_config.frame_size].height,
+                   quality, (unsigned)g_bench_config.fb_count, g_bench_grab_name[g_bench_config.grab_mode],
+                   g_bench_wifi_name[profile], (g_bench_sock >= 0), (unsigned long)r->frames,
+                   r->captured / sec, r->frames / sec,
+                   (long long)(r->sensor_frames ? r->sensor_us / r->sensor_frames : 0),
+                   (long long)(r->frames ? r->get_us / r->frames : 0),
+                   (unsigned long long)(r->frames ? r->bytes / r->frames : 0),
+                   r->sent_bytes * 8 / 1000.0 / sec,
+                   (long long)(r->frames ? r->send_us / r->frames : 0),
+                   (unsigned)CONFIG_LWIP_TCP_SND_BUF_DEFAULT, (long long)g_bench_rtt_us, wnd_kbps,
+                   r->load[0], (portNUM_PROCESSORS > 1) ? r->load[portNUM_PROCESSORS - 1] : 0.0f,
+                   (unsigned)r->heap_int_min, (unsigned)r->heap_psram_min, (unsigned long)r->dropped);
+
+    if (len <= 0 || (size_t)len >= sizeof(line))
+    {
+        return;
+    }
+
+    printf("BENCH %s", line);
+
+    if (g_bench_sock >= 0)
+    {
+        frame_header_fill_stats(&hdr, len, g_bench_seq, esp_timer_get_time());
+
+        if (bench_send_all(&hdr, sizeof(hdr)) == 0)
+        {
+            bench_send_all(line, len);
+        }
+    }
+}
+
+/**
+ * @brief       基准测试线程: 扫描所有参数组合, 完成后恢复默认Wi-Fi组合并删除自身
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void bench_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    const framesize_t sizes[] = BENCH_FRAMESIZES;
+    const int qualities[] = BENCH_QUALITIES;
+    const size_t fb_counts[] = BENCH_FB_COUNTS;
+    const camera_grab_mode_t grab_modes[] = BENCH_GRAB_MODES;
+    static bench_result_t result;
+    sensor_t *s;
+
+#if BENCH_KERNEL_EN
+    bench_kernel_run();                                             /* 先测转换函数, 不受推流负载影响 */
+#endif
+
+    printf("BENCH start, %u combinations\n", (unsigned)(sizeof(sizes) / sizeof(sizes[0]) * sizeof(qualities) / sizeof(qualities[0]) *
+           sizeof(fb_counts) / sizeof(fb_counts[0]) * sizeof(grab_modes) / sizeof(grab_modes[0]) * WIFI_PROFILE_NUM));
+
+    for (size_t f = 0; f < sizeof(fb_counts) / sizeof(fb_counts[0]); f++)
+    {
+        for (size_t g = 0; g < sizeof(grab_modes) / sizeof(grab_modes[0]); g++)
+        {
+            if (bench_camera_reinit(fb_counts[f], grab_modes[g]) != ESP_OK)
+            {
+                ESP_LOGE("TAG", "bench: camera init failed, fb_count %u", (unsigned)fb_counts[f]);
+                continue;
+            }
+
+            s = esp_camera_sensor_get();
+
+            for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            {
+                if (s->set_framesize(s, sizes[i]) != 0)
+                {
+                    continue;                                       /* 传感器不支持该分辨率 */
+                }
+
+                g_bench_config.frame_size = sizes[i];
+
+                for (size_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++)
+                {
+                    s->set_quality(s, qualities[q]);
+
+                    for (int p = 0; p < WIFI_PROFILE_NUM; p++)
+                    {
+                        wifi_profile_apply((wifi_profile_t)p);
+                        bench_connect();
+                        bench_measure(&result);
+                        bench_report(qualities[q], (wifi_profile_t)p, &result);
+                    }
+                }
+            }
+        }
+    }
+
+    printf("BENCH done\n");
+    wifi_profile_apply(WIFI_PROFILE_DEFAULT);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief       启动基准测试线程(摄像头已初始化, Wi-Fi已连接)
+ * @param       config : 摄像头配置(引脚、时钟等作为每次重新初始化的基础)
+ * @retval      无
+ */
+void bench_run(const camera_config_t *config)
+{
+    g_bench_config = *config;
+
+    xTaskCreatePinnedToCore(bench_thread, "bench_thread", BENCH_THREAD_STACK, NULL,
+                            BENCH_THREAD_PRIO, NULL, BENCH_THREAD_CORE);
+}
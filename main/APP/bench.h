@@ -0,0 +1,50 @@
+/**
+ ****************************************************************************************************
+ * @file        bench.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       端到端推流基准测试: 扫描参数组合, 每个组合的测量结果以JSON行输出
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 基准测试固件: idf.py -B build_bench -D BENCH_BUILD=1 build(可与 -D RELEASE_BUILD=1 同时使用, 对比优化前后).
+ * BENCH_EN 为1时 app_main 不启动推流、取景、移动侦测与音频, 由 bench_run() 依次扫描
+ * 分辨率 x JPEG质量 x 帧缓存数 x 取帧模式 x Wi-Fi组合. fb_count/grab_mode 变化时重新初始化摄像头,
+ * 其余参数在运行时切换. 每个组合先丢弃 BENCH_WARMUP_FRAMES 帧, 然后在 BENCH_RUN_MS 内
+ * 采集并以帧协议发送到 IP_ADDR:LWIP_DEMO_PORT(viewer.py 接收并显示; 服务器未运行时只测采集).
+ * 每个组合输出一行JSON: 采集帧率(驱动入队)、推流帧率、传感器输出时间(VSYNC -> DMA EOF, 含传感器JPEG编码)、
+ * 取帧等待、平均帧长、网络吞吐、发送阻塞时间、各核CPU占用、内部RAM/PSRAM剩余最低值、驱动丢帧数.
+ * 结果打印到串口(以 "BENCH " 开头, 便于过滤), 已连接时同时以 FRAME_FLAG_STATS 帧发送到服务器.
+ * 参数扫描之前先运行图像转换函数的微基准(bench_kernel.c, BENCH_KERNEL_EN).
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include "esp_camera.h"
+
+
+#ifndef BENCH_EN
+#define BENCH_EN                    0                               /* 1:基准测试固件(CMake -D BENCH_BUILD=1 时置1) */
+#endif
+#define BENCH_RUN_MS                5000                            /* 每个组合的测量时间 */
+#define BENCH_WARMUP_FRAMES         5                               /* 切换参数后丢弃的帧数(等待曝光与码率稳定) */
+#define BENCH_FRAMESIZES            { FRAMESIZE_QVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_UXGA }
+#define BENCH_QUALITIES             { 10, 12, 20 }
+#define BENCH_FB_COUNTS             { 2, 4, 6 }
+#define BENCH_GRAB_MODES            { CAMERA_GRAB_WHEN_EMPTY, CAMERA_GRAB_LATEST, CAMERA_GRAB_NEWEST }
+
+/* 函数声明 */
+void bench_run(const camera_config_t *config);                      /* 启动基准测试线程(摄像头已初始化) */
+
+#endif
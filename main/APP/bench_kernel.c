@@ -0,0 +1,354 @@
+/**
+ ****************************************************************************************************
+ * @file        bench_kernel.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       图像转换函数的微基准测试(每像素周期数), 与NVS中保存的基线比较
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "bench_kernel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "img_converters.h"
+
+
+#define BENCH_KERNEL_WARMUP_FRAMES  3                               /* 切换分辨率后丢弃的帧数 */
+
+/* 被测函数 */
+typedef enum
+{
+    BENCH_K_JPG2RGB565 = 0,
+    BENCH_K_FMT2RGB888,
+    BENCH_K_FMT2JPG,
+    BENCH_K_FMT2BMP,
+    BENCH_K_YUV2RGB,
+    BENCH_K_LL_CAM_MEMCPY,
+    BENCH_K_FMT2JPG_YUV,                                            /* 追加在末尾, NVS基线的键(序号)不变 */
+    BENCH_K_NUM
+} bench_kernel_t;
+
+/* 一个分辨率的输入与输出缓冲(PSRAM) */
+typedef struct
+{
+    uint8_t *jpg;                                                   /* 采集的JPEG帧 */
+    size_t jpg_len;
+    uint8_t *rgb565;                                                /* w*h*2, 同时作为YUV422输入 */
+    uint8_t *rgb888;                                                /* w*h*3 */
+    uint16_t width;
+    uint16_t height;
+} bench_kernel_buf_t;
+
+static const char *g_kernel_name[BENCH_K_NUM] = { "jpg2rgb565", "fmt2rgb888", "fmt2jpg", "fmt2bmp", "yuv2rgb", "ll_cam_memcpy", "fmt2jpg_yuv" };
+
+/* conversions/yuv.c(私有头文件 yuv.h 不对组件外开放) */
+void yuv2rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t *r, uint8_t *g, uint8_t *b);
+
+
+/**
+ * @brief       执行一次被测函数
+ * @param       k   : 被测函数
+ * @param       buf : 输入输出缓冲
+ * @retval      true:成功; false:函数返回失败
+ */
+static bool bench_kernel_once(bench_kernel_t k, bench_kernel_buf_t *buf)
+{
+    uint8_t *out = NULL;
+    size_t out_len = 0;
+    const uint8_t *in;
+    uint8_t *rgb;
+    size_t pixels;
+    bool ok = true;
+
+    switch (k)
+    {
+        case BENCH_K_JPG2RGB565:
+            return jpg2rgb565(buf->jpg, buf->jpg_len, buf->rgb565, JPG_SCALE_NONE);
+
+        case BENCH_K_FMT2RGB888:
+            return fmt2rgb888(buf->jpg, buf->jpg_len, PIXFORMAT_JPEG, buf->rgb888);
+
+        case BENCH_K_FMT2JPG:
+            ok = fmt2jpg(buf->rgb565, (size_t)buf->width * buf->height * 2, buf->width, buf->height,
+                         PIXFORMAT_RGB565, BENCH_KERNEL_QUALITY, &out, &out_len);
+            free(out);
+            return ok;
+
+        case BENCH_K_FMT2JPG_YUV:
+            ok = fmt2jpg(buf->rgb565, (size_t)buf->width * buf->height * 2, buf->width, buf->height,
+                         PIXFORMAT_YUV422, BENCH_KERNEL_QUALITY, &out, &out_len);
+            free(out);
+            return ok;
+
+        case BENCH_K_FMT2BMP:
+            ok = fmt2bmp(buf->rgb565, (size_t)buf->width * buf->height * 2, buf->width, buf->height,
+                         PIXFORMAT_RGB565, &out, &out_len);
+            free(out);
+            return ok;
+
+        case BENCH_K_YUV2RGB:
+            in = buf->rgb565;                                       /* 内容不影响查表转换的耗时 */
+            rgb = buf->rgb888;
+            pixels = (size_t)buf->width * buf->height;
+
+            for (size_t i = 0; i < pixels; i += 2)                  /* Y0 U Y1 V */
+            {
+                yuv2rgb(in[0], in[1], in[3], &rgb[0], &rgb[1], &rgb[2]);
+                yuv2rgb(in[2], in[1], in[3], &rgb[3], &rgb[4], &rgb[5]);
+                in += 4;
+                rgb += 6;
+            }
+
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief       计时被测函数, 重复 BENCH_KERNEL_REPEAT 次取最小值
+ * @param       k   : 被测函数
+ * @param       buf : 输入输出缓冲
+ * @retval      周期数, 0:函数返回失败
+ */
+static uint32_t bench_kernel_cycles(bench_kernel_t k, bench_kernel_buf_t *buf)
+{
+    uint32_t best = UINT32_MAX;
+    uint32_t start;
+    uint32_t cycles;
+
+    for (int i = 0; i < BENCH_KERNEL_REPEAT; i++)
+    {
+        start = esp_cpu_get_cycle_count();
+
+        if (!bench_kernel_once(k, buf))
+        {
+            return 0;
+        }
+
+        cycles = esp_cpu_get_cycle_count() - start;                 /* 32位计数, 240MHz下单次不超过17秒 */
+        best = (cycles < best) ? cycles : best;
+        vTaskDelay(1);                                              /* 让出CPU, 避免触发任务看门狗 */
+    }
+
+    return best;
+}
+
+/**
+ * @brief       取驱动拷贝一帧(ll_cam_memcpy)所用的周期数, 取 BENCH_KERNEL_REPEAT 帧中的最小值
+ * @param       bytes : 输出对应帧的字节数
+ * @retval      周期数, 0:驱动未开启 CONFIG_CAMERA_FRAME_TIMING
+ */
+static uint32_t bench_kernel_memcpy_cycles(size_t *bytes)
+{
+    int64_t best_us = INT64_MAX;
+    camera_fb_timing_t t;
+    camera_fb_t *fb;
+
+    *bytes = 0;
+
+    for (int i = 0; i < BENCH_KERNEL_REPEAT; i++)
+    {
+        fb = esp_camera_fb_get();
+
+        if (fb == NULL)
+        {
+            continue;
+        }
+
+        if (esp_camera_fb_get_timing(fb, &t) == ESP_OK && t.queued_us >= t.dma_eof_us && t.queued_us - t.dma_eof_us < best_us)
+        {
+            best_us = t.queued_us - t.dma_eof_us;
+            *bytes = fb->len;
+        }
+
+        esp_camera_fb_return(fb);
+    }
+
+    return (*bytes > 0) ? (uint32_t)(best_us * esp_rom_get_cpu_ticks_per_us()) : 0;
+}
+
+/**
+ * @brief       与NVS中的基线比较, 没有基线(或 BENCH_KERNEL_SAVE_BASELINE)时保存本次结果
+ * @param       k     : 被测函数
+ * @param       size  : 分辨率
+ * @param       milli : 本次结果(千分之一周期/像素)
+ * @param       base  : 输出基线, 0:没有基线
+ * @retval      1:性能退化; 0:正常
+ */
+static int bench_kernel_baseline(bench_kernel_t k, framesize_t size, uint32_t milli, uint32_t *base)
+{
+    nvs_handle_t handle;
+    char key[16];
+    int regress = 0;
+
+    *base = 0;
+    snprintf(key, sizeof(key), "k%d_%d", (int)k, (int)size);
+
+    if (nvs_open(BENCH_KERNEL_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        return 0;
+    }
+
+    if (nvs_get_u32(handle, key, base) != ESP_OK)
+    {
+        *base = 0;
+    }
+
+    if (*base > 0)
+    {
+        regress = ((uint64_t)milli * 100 > (uint64_t)*base * (100 + BENCH_KERNEL_REGRESS_PCT));
+    }
+
+    if (*base == 0 || BENCH_KERNEL_SAVE_BASELINE)
+    {
+        if (nvs_set_u32(handle, key, milli) == ESP_OK)
+        {
+            nvs_commit(handle);
+        }
+    }
+
+    nvs_close(handle);
+    return regress;
+}
+
+/**
+ * @brief       输出一项结果
+ * @param       k      : 被测函数
+ * @param       buf    : 缓冲(宽高)
+ * @param       size   : 分辨率
+ * @param       cycles : 周期数
+ * @param       units  : 像素数(ll_cam_memcpy 为字节数)
+ * @retval      1:性能退化; 0:正常或测量失败
+ */
+static int bench_kernel_report(bench_kernel_t k, const bench_kernel_buf_t *buf, framesize_t size, uint32_t cycles, size_t units)
+{
+    uint32_t milli;
+    uint32_t base;
+    int regress;
+
+    if (cycles == 0 || units == 0)
+    {
+        printf("BENCH {\"kernel\":\"%s\",\"width\":%u,\"height\":%u,\"error\":\"failed\"}\n",
+               g_kernel_name[k], buf->width, buf->height);
+        return 0;
+    }
+
+    milli = (uint32_t)((uint64_t)cycles * 1000 / units);
+    regress = bench_kernel_baseline(k, size, milli, &base);
+
+    printf("BENCH {\"kernel\":\"%s\",\"width\":%u,\"height\":%u,\"cycles\":%lu,\"per\":\"%s\",\"cycles_per_unit\":%.3f,"
+           "\"baseline\":%.3f,\"regress\":%s}\n",
+           g_kernel_name[k], buf->width, buf->height, (unsigned long)cycles,
+           (k == BENCH_K_LL_CAM_MEMCPY) ? "byte" : "pixel", milli / 1000.0, base / 1000.0, regress ? "true" : "false");
+
+    return regress;
+}
+
+/**
+ * @brief       运行微基准(摄像头已按JPEG格式初始化)
+ * @note        运行结束后分辨率停留在列表中最后一项
+ * @param       无
+ * @retval      性能退化的项数
+ */
+int bench_kernel_run(void)
+{
+    const framesize_t sizes[] = BENCH_KERNEL_SIZES;
+    sensor_t *s = esp_camera_sensor_get();
+    bench_kernel_buf_t buf;
+    camera_fb_t *fb;
+    size_t bytes;
+    int regress = 0;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        if (s == NULL || s->set_framesize(s, sizes[i]) != 0)
+        {
+            continue;
+        }
+
+        for (int w = 0; w < BENCH_KERNEL_WARMUP_FRAMES; w++)
+        {
+            fb = esp_camera_fb_get();
+
+            if (fb != NULL)
+            {
+                esp_camera_fb_return(fb);
+            }
+        }
+
+        memset(&buf, 0, sizeof(buf));
+        fb = esp_camera_fb_get();
+
+        if (fb == NULL || fb->format != PIXFORMAT_JPEG)
+        {
+            if (fb != NULL)
+            {
+                esp_camera_fb_return(fb);
+            }
+
+            ESP_LOGE("TAG", "bench: no JPEG frame at framesize %d", (int)sizes[i]);
+            continue;
+        }
+
+        buf.width = fb->width;
+        buf.height = fb->height;
+        buf.jpg_len = fb->len;
+        buf.jpg = heap_caps_malloc(fb->len, MALLOC_CAP_SPIRAM);
+        buf.rgb565 = heap_caps_malloc((size_t)buf.width * buf.height * 2, MALLOC_CAP_SPIRAM);
+        buf.rgb888 = heap_caps_malloc((size_t)buf.width * buf.height * 3, MALLOC_CAP_SPIRAM);
+
+        if (buf.jpg != NULL)
+        {
+            memcpy(buf.jpg, fb->buf, fb->len);
+        }
+
+        esp_camera_fb_return(fb);
+
+        if (buf.jpg != NULL && buf.rgb565 != NULL && buf.rgb888 != NULL)
+        {
+            /* fmt2jpg/fmt2bmp 使用 jpg2rgb565 的输出, 先运行解码 */
+            for (int k = BENCH_K_JPG2RGB565; k <= BENCH_K_YUV2RGB; k++)
+            {
+                regress += bench_kernel_report((bench_kernel_t)k, &buf, sizes[i],
+                                               bench_kernel_cycles((bench_kernel_t)k, &buf), (size_t)buf.width * buf.height);
+            }
+
+            regress += bench_kernel_report(BENCH_K_FMT2JPG_YUV, &buf, sizes[i],
+                                           bench_kernel_cycles(BENCH_K_FMT2JPG_YUV, &buf), (size_t)buf.width * buf.height);
+            regress += bench_kernel_report(BENCH_K_LL_CAM_MEMCPY, &buf, sizes[i], bench_kernel_memcpy_cycles(&bytes), bytes);
+        }
+        else
+        {
+            ESP_LOGE("TAG", "bench: no memory for %ux%u buffers", buf.width, buf.height);
+        }
+
+        heap_caps_free(buf.jpg);
+        heap_caps_free(buf.rgb565);
+        heap_caps_free(buf.rgb888);
+    }
+
+    printf("BENCH {\"kernel_regressions\":%d}\n", regress);
+
+    return regress;
+}
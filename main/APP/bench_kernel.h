@@ -0,0 +1,46 @@
+/**
+ ****************************************************************************************************
+ * @file        bench_kernel.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       图像转换函数的微基准测试(每像素周期数), 与NVS中保存的基线比较
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 基准测试固件(BENCH_EN)在参数扫描之前运行. 对 BENCH_KERNEL_SIZES 中的每个分辨率先采集一帧JPEG作为输入,
+ * 以 esp_cpu_get_cycle_count() 计时 img_converters.h 的 jpg2rgb565、fmt2rgb888(JPEG)、fmt2jpg(RGB565与YUV422)、
+ * fmt2bmp(RGB565), 以及 yuv2rgb(YUV422逐像素转换); 每项重复 BENCH_KERNEL_REPEAT 次取最小值, 减少被Wi-Fi任务抢占的影响.
+ * ll_cam_memcpy 在驱动的 cam_task 中执行, 无法单独调用, 取实际帧的 DMA EOF -> 入队时间(驱动时间戳)换算为周期,
+ * 按帧字节数计算.
+ * 每项结果以一行JSON输出(行首 "BENCH "). 基线保存在NVS(命名空间 BENCH_KERNEL_NVS_NAMESPACE), 首次运行时写入,
+ * 之后比基线慢 BENCH_KERNEL_REGRESS_PCT 以上时标记 "regress":true; BENCH_KERNEL_SAVE_BASELINE 为1时用本次结果覆盖基线.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __BENCH_KERNEL_H
+#define __BENCH_KERNEL_H
+
+#include "esp_camera.h"
+
+
+#define BENCH_KERNEL_EN             1                               /* 1:基准测试固件中运行转换函数微基准 */
+#define BENCH_KERNEL_SIZES          { FRAMESIZE_QVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA }
+#define BENCH_KERNEL_REPEAT         3                               /* 每项的重复次数(取最小值) */
+#define BENCH_KERNEL_QUALITY        12                              /* fmt2jpg 的编码质量 */
+#define BENCH_KERNEL_REGRESS_PCT    10                              /* 比基线慢该比例以上视为性能退化 */
+#define BENCH_KERNEL_SAVE_BASELINE  0                               /* 1:用本次结果覆盖NVS中的基线 */
+#define BENCH_KERNEL_NVS_NAMESPACE  "bench"                         /* 基线的NVS命名空间 */
+
+/* 函数声明 */
+int bench_kernel_run(void);                                         /* 运行微基准, 返回性能退化的项数 */
+
+#endif
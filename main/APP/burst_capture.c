@@ -0,0 +1,370 @@
+/**
+ ****************************************************************************************************
+ * @file        burst_capture.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       曝光锁定的连拍(最高分辨率连续N帧, 整批交给使用者)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "burst_capture.h"
+#include "task_topo.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "rate_ctrl.h"
+#include "frame_pool.h"
+#include "heap_stats.h"
+#include "jpg_quality.h"
+
+
+/* 连拍状态 */
+typedef enum
+{
+    BURST_IDLE = 0,                                                 /* 空闲 */
+    BURST_RUNNING,                                                  /* 采集线程正在拷贝 */
+    BURST_DONE,                                                     /* 拍满或超时, 等待连拍线程交付 */
+} burst_state_t;
+
+static volatile burst_state_t g_burst_state = BURST_IDLE;
+static burst_t g_burst;                                             /* 当前一批 */
+static uint8_t g_burst_target = 0;                                  /* 需要的帧数 */
+static uint16_t g_burst_width = 0;                                  /* 连拍分辨率 */
+static uint16_t g_burst_height = 0;
+static int64_t g_burst_start_us = 0;
+static uint8_t g_burst_aec = 1;                                     /* 开始前的自动曝光/增益/白平衡状态 */
+static uint8_t g_burst_agc = 1;
+static uint8_t g_burst_awb = 1;
+static TaskHandle_t g_burst_task = NULL;
+static burst_capture_done_t g_burst_done = NULL;
+#if BURST_CAPTURE_TOP_K > 0
+static esp_jpg_dec_t g_burst_dec;                                   /* 评分的解码器工作区(内部RAM) */
+static uint8_t *g_burst_strip = NULL;                               /* 评分的灰度条带缓冲(PSRAM) */
+#endif
+
+
+/**
+ * @brief       按帧间隔估算漏拍帧数
+ * @param       batch : 一批连拍
+ * @retval      漏拍帧数
+ */
+static uint8_t burst_capture_dropped(const burst_t *batch)
+{
+    int64_t min = 0;
+    int64_t gap;
+    uint32_t dropped = 0;
+
+    for (int i = 1; i < batch->count; i++)
+    {
+        gap = (int64_t)(batch->frames[i].hdr.timestamp_us - batch->frames[i - 1].hdr.timestamp_us);
+        min = (min == 0 || gap < min) ? gap : min;
+    }
+
+    for (int i = 1; i < batch->count && min > 0; i++)
+    {
+        gap = (int64_t)(batch->frames[i].hdr.timestamp_us - batch->frames[i - 1].hdr.timestamp_us);
+
+        if (gap * 2 > min * 3)
+        {
+            dropped += (uint32_t)((gap + min / 2) / min) - 1;
+        }
+    }
+
+    return (dropped > 255) ? 255 : (uint8_t)dropped;
+}
+
+#if BURST_CAPTURE_TOP_K > 0
+/**
+ * @brief       按质量评分只保留最好的 BURST_CAPTURE_TOP_K 帧, 其余释放
+ * @note        保留的帧按拍摄顺序前移; 评分失败的帧记为0分
+ * @param       batch : 一批连拍
+ * @retval      无
+ */
+static void burst_capture_select(burst_t *batch)
+{
+    jpg_quality_t q[BURST_CAPTURE_MAX];
+    uint64_t score[BURST_CAPTURE_MAX];
+    uint8_t ok[BURST_CAPTURE_MAX];
+    uint8_t keep[BURST_CAPTURE_MAX];
+    uint16_t aniso_min = 1000;
+    uint32_t bytes = 0;
+    uint32_t kept = 0;
+    int64_t start = esp_timer_get_time();
+    int best;
+    int n = 0;
+
+    if (g_burst_strip == NULL || batch->count <= BURST_CAPTURE_TOP_K)
+    {
+        return;
+    }
+
+    for (int i = 0; i < batch->count; i++)
+    {
+        ok[i] = jpg_quality(&g_burst_dec, batch->frames[i].buf, batch->frames[i].hdr.payload_len,
+                            g_burst_strip, JPG_QUALITY_STRIP_SIZE, &q[i]);
+        n += ok[i];
+
+        if (ok[i] && q[i].aniso < aniso_min)
+        {
+            aniso_min = q[i].aniso;
+        }
+    }
+
+    if (n == 0)
+    {
+        ESP_LOGW("TAG", "burst: no frame scored, sending all");
+        return;
+    }
+
+    /* 不对称度只与本批最小值比较: 场景本身的方向性纹理各帧相同, 多出的部分才是运动模糊 */
+    for (int i = 0; i < batch->count; i++)
+    {
+        score[i] = ok[i] ? (uint64_t)q[i].sharpness * (1000 - q[i].clipped) * (1000 - (q[i].aniso - aniso_min)) : 0;
+        keep[i] = 0;
+        bytes += batch->frames[i].hdr.payload_len;
+    }
+
+    for (int k = 0; k < BURST_CAPTURE_TOP_K; k++)
+    {
+        best = -1;
+
+        for (int i = 0; i < batch->count; i++)
+        {
+            if (!keep[i] && (best < 0 || score[i] > score[best]))
+            {
+                best = i;
+            }
+        }
+
+        keep[best] = 1;
+    }
+
+    n = 0;
+
+    for (int i = 0; i < batch->count; i++)
+    {
+        if (keep[i])
+        {
+            ESP_LOGI("TAG", "burst: keep #%d sharp %lu clip %u%% aniso %u", i, (unsigned long)q[i].sharpness,
+                     q[i].clipped / 10, q[i].aniso);
+            kept += batch->frames[i].hdr.payload_len;
+            batch->frames[n++] = batch->frames[i];
+        }
+        else
+        {
+            frame_pool_free(batch->frames[i].buf);
+        }
+    }
+
+    batch->count = n;
+    ESP_LOGI("TAG", "burst: kept %d of %u frames, %lu of %lu bytes, scored in %lld ms", n, batch->shot,
+             (unsigned long)kept, (unsigned long)bytes, (long long)((esp_timer_get_time() - start) / 1000));
+}
+#endif
+
+/**
+ * @brief       恢复自动曝光/增益/白平衡与码率控制
+ * @param       无
+ * @retval      无
+ */
+static void burst_capture_unlock(void)
+{
+    sensor_t *s = esp_camera_sensor_get();
+
+    if (s != NULL)
+    {
+        esp_camera_sensor_lock();
+        s->set_exposure_ctrl(s, g_burst_aec);
+        s->set_gain_ctrl(s, g_burst_agc);
+        s->set_whitebal(s, g_burst_awb);
+        esp_camera_sensor_unlock();
+    }
+
+    rate_ctrl_hold(0);
+}
+
+/**
+ * @brief       连拍线程函数: 等待拍满或超时, 恢复传感器设置并交付整批
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void burst_capture_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+
+    while (1)
+    {
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100)) == 0 && g_burst_state == BURST_RUNNING)
+        {
+            if (esp_timer_get_time() - g_burst_start_us < (int64_t)BURST_CAPTURE_TIMEOUT_MS * 1000)
+            {
+                continue;
+            }
+
+            g_burst_state = BURST_DONE;                             /* 超时, 按已拍帧数交付 */
+            ESP_LOGW("TAG", "burst: timeout, %u of %u frames", g_burst.count, g_burst_target);
+        }
+
+        if (g_burst_state != BURST_DONE)
+        {
+            continue;
+        }
+
+        burst_capture_unlock();
+        g_burst.dropped = burst_capture_dropped(&g_burst);
+        g_burst.shot = g_burst.count;
+        ESP_LOGI("TAG", "burst: %u frames, %u dropped", g_burst.count, g_burst.dropped);
+#if BURST_CAPTURE_TOP_K > 0
+        burst_capture_select(&g_burst);                             /* 恢复传感器之后评分, 不推迟实时画面恢复自动曝光 */
+#endif
+
+        if (g_burst_done != NULL && g_burst.count > 0)
+        {
+            g_burst_done(&g_burst);
+        }
+
+        for (int i = 0; i < g_burst.count; i++)
+        {
+            frame_pool_free(g_burst.frames[i].buf);
+        }
+
+        memset(&g_burst, 0, sizeof(g_burst));
+        g_burst_state = BURST_IDLE;
+    }
+}
+
+/**
+ * @brief       启动连拍线程
+ * @param       done : 完成回调
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:帧缓冲池申请或线程创建失败
+ */
+esp_err_t burst_capture_init(burst_capture_done_t done)
+{
+#if BURST_CAPTURE_EN
+    g_burst_done = done;
+
+    if (frame_pool_init() != ESP_OK)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+#if BURST_CAPTURE_TOP_K > 0
+    if (g_burst_strip == NULL)
+    {
+        g_burst_strip = heap_stats_malloc(HEAP_TAG_BURST, JPG_QUALITY_STRIP_SIZE, MALLOC_CAP_SPIRAM);
+
+        if (g_burst_strip == NULL)
+        {
+            ESP_LOGW("TAG", "burst: no memory for scoring, sending all frames");
+        }
+    }
+#endif
+
+    if (g_burst_task == NULL &&
+        xTaskCreatePinnedToCore(burst_capture_thread, "burst_thread", BURST_CAPTURE_THREAD_STACK, NULL,
+                                BURST_CAPTURE_THREAD_PRIO, &g_burst_task, BURST_CAPTURE_THREAD_CORE) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+#else
+    (void)done;
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief       开始一次连拍(控制命令调用, 不阻塞)
+ * @param       count : 帧数, 1 ~ BURST_CAPTURE_MAX
+ * @retval      ESP_OK:已开始; ESP_ERR_INVALID_ARG:帧数超出范围; ESP_ERR_INVALID_STATE:上一次连拍未结束或未初始化
+ */
+esp_err_t burst_capture_start(uint8_t count)
+{
+#if BURST_CAPTURE_EN
+    sensor_t *s = esp_camera_sensor_get();
+    framesize_t size;
+
+    if (count == 0 || count > BURST_CAPTURE_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (g_burst_task == NULL || s == NULL || g_burst_state != BURST_IDLE)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* 关闭自动调节, 传感器保持当前的曝光、增益与白平衡增益 */
+    g_burst_aec = s->status.aec;
+    g_burst_agc = s->status.agc;
+    g_burst_awb = s->status.awb;
+    esp_camera_sensor_lock();
+    s->set_exposure_ctrl(s, 0);
+    s->set_gain_ctrl(s, 0);
+    s->set_whitebal(s, 0);
+    esp_camera_sensor_unlock();
+
+    size = rate_ctrl_hold(1);
+    memset(&g_burst, 0, sizeof(g_burst));
+    g_burst_target = count;
+    g_burst_width = resolution[size].width;
+    g_burst_height = resolution[size].height;
+    g_burst_start_us = esp_timer_get_time();
+    g_burst_state = BURST_RUNNING;
+
+    return ESP_OK;
+#else
+    (void)count;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       采集线程每取到一帧调用: 连拍期间拷贝分辨率已到位的帧
+ * @note        拷贝到 frame_pool 的槽位后即返回, 帧缓存仍归调用者; 没有空闲槽位时提前结束本批
+ * @param       fb : 帧缓存
+ * @retval      无
+ */
+void burst_capture_offer(const camera_fb_t *fb)
+{
+#if BURST_CAPTURE_EN
+    burst_frame_t *frame;
+
+    if (g_burst_state != BURST_RUNNING || fb->width != g_burst_width || fb->height != g_burst_height)
+    {
+        return;                                                     /* 未在连拍, 或分辨率尚未切换到位 */
+    }
+
+    frame = &g_burst.frames[g_burst.count];
+    frame->buf = frame_pool_alloc(fb->len);
+
+    if (frame->buf != NULL)
+    {
+        memcpy(frame->buf, fb->buf, fb->len);
+        frame_header_fill(&frame->hdr, fb, g_burst.count);
+        frame->hdr.flags |= FRAME_FLAG_BURST;
+        g_burst.count++;
+    }
+
+    if (frame->buf == NULL || g_burst.count >= g_burst_target)
+    {
+        g_burst_state = BURST_DONE;
+        xTaskNotifyGive(g_burst_task);
+    }
+#else
+    (void)fb;
+#endif
+}
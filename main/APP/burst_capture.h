@@ -0,0 +1,72 @@
+/**
+ ****************************************************************************************************
+ * @file        burst_capture.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       曝光锁定的连拍(最高分辨率连续N帧, 整批交给使用者)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * burst_capture_start() 关闭自动曝光、自动增益与自动白平衡(传感器保持当前值, 整批画面亮度与色彩一致),
+ * 并让码率控制保持初始配置的最高分辨率与质量上限. 采集线程每取到一帧调用 burst_capture_offer():
+ * 分辨率到位后把连续N帧逐帧拷贝到 frame_pool 中按帧长选取的槽位, 帧缓存立即归还驱动,
+ * 不会因为连拍占用帧缓存而使驱动丢帧. 拍满后由连拍线程恢复自动曝光/增益/白平衡与码率控制,
+ * 再以整批(每帧含帧头与采集时间戳)调用完成回调, 回调返回后释放拷贝.
+ * 相邻两帧间隔超过最小间隔1.5倍时按间隔估算漏拍帧数, 记入 burst_t::dropped.
+ * 帧缓存数(fb_count)在 esp_camera_init 时确定, 运行中不重新初始化驱动, 拷贝代替临时增加帧缓存.
+ * BURST_CAPTURE_TOP_K 不为0且拍到的帧数更多时, 连拍线程(核1)交付前逐帧计算质量评分(jpg_quality.h):
+ * 评分 = 清晰度 x (1 - 削顶像素比例) x (1 - 超出本批最小值的不对称度), 只交付评分最高的K帧(按拍摄顺序,
+ * seq仍为批内序号, 接收端可知是第几帧), 其余帧直接释放. 车牌、检测抓拍每次事件的上传量约为原来的 K/N.
+ * 评分失败的帧(数据错误)排在最后; 一批全部评分失败时按原样全部交付.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __BURST_CAPTURE_H
+#define __BURST_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "frame_proto.h"
+
+
+#define BURST_CAPTURE_EN            1                               /* 1:使能连拍 */
+#define BURST_CAPTURE_MAX           16                              /* 一批最多帧数 */
+#define BURST_CAPTURE_TIMEOUT_MS    5000                            /* 开始后未拍满的超时时间(按已拍帧数交付) */
+#define BURST_CAPTURE_TOP_K         2                               /* 只交付质量评分最高的帧数, 0:全部交付 */
+
+/* 连拍的一帧 */
+typedef struct
+{
+    frame_header_t hdr;                                             /* 帧头(FRAME_FLAG_BURST, seq为批内序号, 含采集时间戳) */
+    uint8_t *buf;                                                   /* JPEG数据(frame_pool槽位) */
+} burst_frame_t;
+
+/* 一批连拍 */
+typedef struct
+{
+    uint8_t count;                                                  /* 交付的帧数 */
+    uint8_t dropped;                                                /* 估算的漏拍帧数 */
+    uint8_t shot;                                                   /* 实际拍到的帧数(选帧前) */
+    burst_frame_t frames[BURST_CAPTURE_MAX];
+} burst_t;
+
+/* 完成回调(连拍线程调用), 返回后整批释放 */
+typedef void (*burst_capture_done_t)(const burst_t *batch);
+
+/* 函数声明 */
+esp_err_t burst_capture_init(burst_capture_done_t done);            /* 启动连拍线程 */
+esp_err_t burst_capture_start(uint8_t count);                       /* 开始一次连拍(不阻塞) */
+void burst_capture_offer(const camera_fb_t *fb);                    /* 采集线程每取到一帧调用 */
+
+#endif
@@ -0,0 +1,387 @@
+/**
+ ****************************************************************************************************
+ * @file        cam_resume.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       传感器曝光寄存器快照(深度睡眠唤醒后快速出图)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "cam_resume.h"
+#include <string.h>
+#include <stdbool.h>
+#include "nvs.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+
+#define CAM_RESUME_NVS_KEY          "regs"
+#define CAM_RESUME_REG_MAX          8                               /* 快照寄存器数上限 */
+
+/* 快照中的一个寄存器(地址格式与 sensor_t::get_reg/set_reg 相同) */
+typedef struct
+{
+    uint16_t reg;
+    uint8_t  mask;
+    uint8_t  value;
+} cam_resume_reg_t;
+
+/* 保存到NVS的快照 */
+typedef struct
+{
+    uint16_t pid;                                                   /* 传感器型号, 与当前不符时不恢复 */
+    uint8_t  count;
+    uint8_t  reserved;
+    cam_resume_reg_t regs[CAM_RESUME_REG_MAX];
+} cam_resume_snapshot_t;
+
+static cam_resume_snapshot_t g_resume_hold;                         /* cam_resume_standby() 保存的快照 */
+static bool g_resume_hold_valid = false;
+
+/* OV2640: 寄存器地址bit8为1表示传感器寄存器组(BANK_SEL=1) */
+static const cam_resume_reg_t g_ov2640_regs[] = {
+    {0x100, 0xFF, 0},                                               /* GAIN: AGC增益 */
+    {0x145, 0x3F, 0},                                               /* REG45: AEC[15:10] */
+    {0x110, 0xFF, 0},                                               /* AEC: AEC[9:2] */
+    {0x104, 0x03, 0},                                               /* REG04: AEC[1:0] */
+};
+
+/* OV3660/OV5640: 16位寄存器地址 */
+static const cam_resume_reg_t g_ov5640_regs[] = {
+    {0x3500, 0x0F, 0},                                              /* 曝光[19:16] */
+    {0x3501, 0xFF, 0},                                              /* 曝光[15:8] */
+    {0x3502, 0xFF, 0},                                              /* 曝光[7:0](低4位为小数) */
+    {0x350A, 0x03, 0},                                              /* 增益[9:8] */
+    {0x350B, 0xFF, 0},                                              /* 增益[7:0] */
+};
+
+
+/**
+ * @brief       取得传感器型号对应的快照寄存器表
+ * @param       pid   : 传感器型号
+ * @param       count : 输出寄存器数
+ * @retval      寄存器表, NULL:不支持该型号
+ */
+static const cam_resume_reg_t *cam_resume_table(uint16_t pid, uint8_t *count)
+{
+    switch (pid)
+    {
+        case OV2640_PID:
+            *count = sizeof(g_ov2640_regs) / sizeof(g_ov2640_regs[0]);
+            return g_ov2640_regs;
+
+        case OV3660_PID:
+        case OV5640_PID:
+            *count = sizeof(g_ov5640_regs) / sizeof(g_ov5640_regs[0]);
+            return g_ov5640_regs;
+
+        default:
+            *count = 0;
+            return NULL;
+    }
+}
+
+/**
+ * @brief       丢弃若干帧(等待自动曝光收敛)
+ * @param       frames : 帧数
+ * @retval      无
+ */
+static void cam_resume_drop(int frames)
+{
+    camera_fb_t *fb;
+
+    for (int i = 0; i < frames; i++)
+    {
+        fb = esp_camera_fb_get();
+
+        if (fb != NULL)
+        {
+            esp_camera_fb_return(fb);
+        }
+    }
+}
+
+/**
+ * @brief       读出NVS中的快照
+ * @param       snap : 输出快照
+ * @retval      ESP_OK:成功; 其他:没有快照
+ */
+static esp_err_t cam_resume_load(cam_resume_snapshot_t *snap)
+{
+    nvs_handle_t handle;
+    size_t len = sizeof(cam_resume_snapshot_t);
+    esp_err_t ret;
+
+    memset(snap, 0, sizeof(cam_resume_snapshot_t));
+    ret = nvs_open(CAM_RESUME_NVS_NAMESPACE, NVS_READONLY, &handle);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    ret = nvs_get_blob(handle, CAM_RESUME_NVS_KEY, snap, &len);
+    nvs_close(handle);
+
+    if (ret == ESP_OK && (len != sizeof(cam_resume_snapshot_t) || snap->count > CAM_RESUME_REG_MAX))
+    {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief       把快照写回传感器
+ * @param       s    : 传感器
+ * @param       snap : 快照
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_FOUND:快照不适用于该传感器
+ */
+static esp_err_t cam_resume_restore(sensor_t *s, const cam_resume_snapshot_t *snap)
+{
+    if (snap->pid != s->id.PID || snap->count == 0 || s->set_reg == NULL)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t ret = ESP_OK;
+
+    esp_camera_sensor_lock();                                       /* 不与驱动的质量调节/寄存器采样交错 */
+
+    for (uint8_t i = 0; i < snap->count; i++)
+    {
+        if (s->set_reg(s, snap->regs[i].reg, snap->regs[i].mask, snap->regs[i].value) < 0)
+        {
+            ret = ESP_FAIL;
+            break;
+        }
+    }
+
+    esp_camera_sensor_unlock();
+    return ret;
+}
+
+/**
+ * @brief       读出传感器当前的曝光/增益寄存器
+ * @param       s    : 传感器
+ * @param       snap : 输出快照
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_SUPPORTED:不支持该传感器; ESP_FAIL:读寄存器失败
+ */
+static esp_err_t cam_resume_read(sensor_t *s, cam_resume_snapshot_t *snap)
+{
+    const cam_resume_reg_t *table;
+    int value;
+
+    memset(snap, 0, sizeof(cam_resume_snapshot_t));
+    table = cam_resume_table(s->id.PID, &snap->count);
+
+    if (table == NULL || s->get_reg == NULL)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    snap->pid = s->id.PID;
+
+    for (uint8_t i = 0; i < snap->count; i++)
+    {
+        value = s->get_reg(s, table[i].reg, table[i].mask);
+
+        if (value < 0)
+        {
+            return ESP_FAIL;
+        }
+
+        snap->regs[i] = table[i];
+        snap->regs[i].value = (uint8_t)value;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       保存当前曝光/增益快照
+ * @note        与NVS中已有的快照相同时不写入, 减少Flash擦写
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_SUPPORTED:不支持该传感器; 其他:读寄存器或NVS失败
+ */
+esp_err_t cam_resume_save(void)
+{
+#if CAM_RESUME_EN
+    sensor_t *s = esp_camera_sensor_get();
+    cam_resume_snapshot_t snap;
+    cam_resume_snapshot_t old;
+    nvs_handle_t handle;
+    esp_err_t ret;
+
+    if (s == NULL)
+    {
+        return ESP_ERR_CAMERA_NOT_DETECTED;
+    }
+
+    ret = cam_resume_read(s, &snap);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    if (cam_resume_load(&old) == ESP_OK && memcmp(&old, &snap, sizeof(snap)) == 0)
+    {
+        return ESP_OK;
+    }
+
+    ret = nvs_open(CAM_RESUME_NVS_NAMESPACE, NVS_READWRITE, &handle);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    ret = nvs_set_blob(handle, CAM_RESUME_NVS_KEY, &snap, sizeof(snap));
+
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(handle);
+    }
+
+    nvs_close(handle);
+    return ret;
+#else
+    return ESP_OK;
+#endif
+}
+
+/**
+ * @brief       摄像头初始化后调用(在其他线程开始取帧之前)
+ * @note        深度睡眠唤醒: 恢复快照并丢弃 CAM_RESUME_DROP_FRAMES 帧;
+ *              冷启动或没有可用快照: 丢弃 CAM_COLD_DROP_FRAMES 帧等待曝光收敛, 然后保存快照
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_CAMERA_NOT_DETECTED:摄像头未初始化
+ */
+esp_err_t cam_resume_start(void)
+{
+#if CAM_RESUME_EN
+    sensor_t *s = esp_camera_sensor_get();
+    cam_resume_snapshot_t snap;
+    int64_t start = esp_timer_get_time();
+
+    if (s == NULL)
+    {
+        return ESP_ERR_CAMERA_NOT_DETECTED;
+    }
+
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED &&
+        cam_resume_load(&snap) == ESP_OK && cam_resume_restore(s, &snap) == ESP_OK)
+    {
+        cam_resume_drop(CAM_RESUME_DROP_FRAMES);
+        ESP_LOGI("TAG", "camera resumed from snapshot, first frame after %lld ms", (esp_timer_get_time() - start) / 1000);
+        return ESP_OK;
+    }
+
+    cam_resume_drop(CAM_COLD_DROP_FRAMES);
+
+    if (cam_resume_save() != ESP_OK)
+    {
+        ESP_LOGW("TAG", "camera exposure snapshot not saved");
+    }
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief       传感器进入待机(PWDN)前调用: 把当前曝光/增益保存在RAM中(不写NVS)
+ * @note        定时拍摄每个周期调用一次, 不擦写Flash; 需要在掉电后保留时仍调用 cam_resume_save()
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_CAMERA_NOT_DETECTED:摄像头未初始化; 其他:不支持该传感器或读寄存器失败
+ */
+esp_err_t cam_resume_standby(void)
+{
+#if CAM_RESUME_EN
+    sensor_t *s = esp_camera_sensor_get();
+    esp_err_t ret;
+
+    if (s == NULL)
+    {
+        return ESP_ERR_CAMERA_NOT_DETECTED;
+    }
+
+    ret = cam_resume_read(s, &g_resume_hold);
+    g_resume_hold_valid = (ret == ESP_OK);
+    return ret;
+#else
+    return ESP_OK;
+#endif
+}
+
+/**
+ * @brief       传感器退出待机后调用: 写回曝光/增益并丢弃待机前后的帧
+ * @note        优先使用 cam_resume_standby() 保存在RAM中的值, 没有时使用NVS中的快照.
+ *              待机前已在帧缓存中的帧与待机时未采完的帧(开始时间早于 since_us)全部丢弃,
+ *              之后再丢弃 CAM_RESUME_DROP_FRAMES 帧; 没有可用快照时丢弃 CAM_COLD_DROP_FRAMES 帧
+ * @param       since_us : 退出待机的时间(esp_timer)
+ * @retval      ESP_OK:成功; ESP_ERR_CAMERA_NOT_DETECTED:摄像头未初始化; ESP_ERR_TIMEOUT:超时未取到新帧
+ */
+esp_err_t cam_resume_wake(int64_t since_us)
+{
+#if CAM_RESUME_EN
+    sensor_t *s = esp_camera_sensor_get();
+    cam_resume_snapshot_t snap;
+    camera_fb_t *fb;
+    int drop;
+    int64_t start;
+
+    if (s == NULL)
+    {
+        return ESP_ERR_CAMERA_NOT_DETECTED;
+    }
+
+    if (g_resume_hold_valid)
+    {
+        snap = g_resume_hold;
+    }
+    else if (cam_resume_load(&snap) != ESP_OK)
+    {
+        snap.count = 0;
+    }
+
+    drop = (cam_resume_restore(s, &snap) == ESP_OK) ? CAM_RESUME_DROP_FRAMES : CAM_COLD_DROP_FRAMES;
+    start = esp_timer_get_time();
+
+    while (drop > 0)
+    {
+        if (esp_timer_get_time() - start > (int64_t)CAM_RESUME_WAKE_TIMEOUT_MS * 1000)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        fb = esp_camera_fb_get();
+
+        if (fb == NULL)
+        {
+            continue;
+        }
+
+        if ((int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec >= since_us)
+        {
+            drop--;
+        }
+
+        esp_camera_fb_return(fb);
+    }
+#else
+    (void)since_us;
+#endif
+    return ESP_OK;
+}
@@ -0,0 +1,49 @@
+/**
+ ****************************************************************************************************
+ * @file        cam_resume.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       传感器曝光寄存器快照(深度睡眠唤醒后快速出图)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 传感器上电后自动曝光(AEC/AGC)从默认值开始收敛, 前若干帧过暗或过曝, 冷启动时丢弃 CAM_COLD_DROP_FRAMES 帧,
+ * 然后读出曝光与增益寄存器(按传感器型号的寄存器表, 只有几个字节)保存到NVS.
+ * 从深度睡眠唤醒(定时器、PIR等)时, esp_camera_init() 之后把快照写回传感器作为自动曝光的起点,
+ * 光照变化不大时第一帧即可使用, 只丢弃 CAM_RESUME_DROP_FRAMES 帧.
+ * 进入深度睡眠前调用 cam_resume_save() 保存当时的曝光值, 快照与NVS中相同时不写Flash.
+ * 不掉电的待机(XL9555 PWDN, 见 timelapse.h)前调用 cam_resume_standby() 把曝光值留在RAM中, 退出待机后
+ * cam_resume_wake() 写回并丢弃待机前残留的帧, 每个周期都不擦写Flash.
+ * 快照只含曝光/增益, 画面调校(翻转、亮度、饱和度等)仍由 init_camera 按型号设置.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __CAM_RESUME_H
+#define __CAM_RESUME_H
+
+#include "esp_err.h"
+#include "esp_camera.h"
+
+
+#define CAM_RESUME_EN               1                               /* 1:使能曝光快照与唤醒快速出图 */
+#define CAM_RESUME_NVS_NAMESPACE    "cam_resume"                    /* NVS命名空间 */
+#define CAM_COLD_DROP_FRAMES        8                               /* 冷启动时丢弃的帧数(等待自动曝光收敛) */
+#define CAM_RESUME_DROP_FRAMES      1                               /* 唤醒并恢复快照后丢弃的帧数 */
+#define CAM_RESUME_WAKE_TIMEOUT_MS  2000                            /* 退出待机后等待新帧的超时时间 */
+
+/* 函数声明 */
+esp_err_t cam_resume_start(void);                                   /* 摄像头初始化后调用: 唤醒时恢复快照, 冷启动时收敛后保存快照 */
+esp_err_t cam_resume_save(void);                                    /* 保存当前曝光/增益快照(进入深度睡眠前调用) */
+esp_err_t cam_resume_standby(void);                                 /* 传感器待机前把曝光/增益留在RAM中 */
+esp_err_t cam_resume_wake(int64_t since_us);                        /* 退出待机后写回曝光/增益并丢弃旧帧 */
+
+#endif
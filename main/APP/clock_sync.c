@@ -0,0 +1,151 @@
+/**
+ ****************************************************************************************************
+ * @file        clock_sync.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       多台摄像头的公共时间基准(SNTP + 服务器双向校时)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "clock_sync.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_netif_sntp.h"
+#include <sys/time.h>
+
+
+static portMUX_TYPE g_clock_mux = portMUX_INITIALIZER_UNLOCKED;    /* 64位偏移的读写不是原子操作 */
+static int64_t g_clock_offset_us = 0;                               /* 公共时间 - esp_timer时间 */
+static clock_sync_src_t g_clock_src = CLOCK_SYNC_NONE;
+
+
+#if CLOCK_SYNC_SNTP_EN
+/**
+ * @brief       SNTP校时完成回调(系统时间已更新)
+ * @param       tv : 新的系统时间
+ * @retval      无
+ */
+static void clock_sync_sntp_cb(struct timeval *tv)
+{
+    struct timeval now;
+    int64_t offset;
+    int applied = 0;
+
+    (void)tv;
+    gettimeofday(&now, NULL);
+    offset = (int64_t)now.tv_sec * 1000000 + now.tv_usec - esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_clock_mux);
+
+    if (g_clock_src != CLOCK_SYNC_SERVER)                           /* 服务器校时更精确, 且与其他摄像头一致 */
+    {
+        g_clock_offset_us = offset;
+        g_clock_src = CLOCK_SYNC_SNTP;
+        applied = 1;
+    }
+
+    portEXIT_CRITICAL(&g_clock_mux);
+
+    if (applied)
+    {
+        ESP_LOGI("TAG", "clock: sntp synced, offset %lld us", offset);
+    }
+}
+#endif
+
+/**
+ * @brief       启动SNTP(须在获得IP之后调用, 未使能时只使用服务器校时)
+ * @param       无
+ * @retval      无
+ */
+void clock_sync_init(void)
+{
+#if CLOCK_SYNC_SNTP_EN
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CLOCK_SYNC_SNTP_SERVER);
+
+    config.sync_cb = clock_sync_sntp_cb;
+
+    if (esp_netif_sntp_init(&config) != ESP_OK)
+    {
+        ESP_LOGW("TAG", "clock: sntp unavailable");
+    }
+#endif
+}
+
+/**
+ * @brief       应用服务器下发的偏移
+ * @note        首次设置或修正量不小于 CLOCK_SYNC_SLEW_US 时直接采用; 否则只修正一部分, 平滑往返时间的抖动
+ * @param       offset_us : 公共时间 - esp_timer时间(us)
+ * @retval      无
+ */
+void clock_sync_set_offset(int64_t offset_us)
+{
+    int64_t delta;
+    int step;
+
+    portENTER_CRITICAL(&g_clock_mux);
+    delta = offset_us - g_clock_offset_us;
+    step = (g_clock_src != CLOCK_SYNC_SERVER || delta >= CLOCK_SYNC_SLEW_US || delta <= -CLOCK_SYNC_SLEW_US);
+    g_clock_offset_us += step ? delta : (delta >> CLOCK_SYNC_SLEW_SHIFT);
+    g_clock_src = CLOCK_SYNC_SERVER;
+    portEXIT_CRITICAL(&g_clock_mux);
+
+    if (step)
+    {
+        ESP_LOGI("TAG", "clock: server offset %lld us (step %lld us)", offset_us, delta);
+    }
+}
+
+/**
+ * @brief       esp_timer时间换算为公共时间
+ * @param       local_us : esp_timer时间(us)
+ * @retval      公共时间(us), 未校时时原样返回
+ */
+int64_t clock_sync_to_common(int64_t local_us)
+{
+    int64_t offset;
+
+    portENTER_CRITICAL(&g_clock_mux);
+    offset = g_clock_offset_us;
+    portEXIT_CRITICAL(&g_clock_mux);
+
+    return local_us + offset;
+}
+
+/**
+ * @brief       公共时间换算为esp_timer时间
+ * @param       common_us : 公共时间(us)
+ * @retval      esp_timer时间(us), 未校时时原样返回
+ */
+int64_t clock_sync_to_local(int64_t common_us)
+{
+    int64_t offset;
+
+    portENTER_CRITICAL(&g_clock_mux);
+    offset = g_clock_offset_us;
+    portEXIT_CRITICAL(&g_clock_mux);
+
+    return common_us - offset;
+}
+
+/**
+ * @brief       当前偏移的来源
+ * @param       无
+ * @retval      clock_sync_src_t
+ */
+clock_sync_src_t clock_sync_source(void)
+{
+    return g_clock_src;
+}
@@ -0,0 +1,57 @@
+/**
+ ****************************************************************************************************
+ * @file        clock_sync.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       多台摄像头的公共时间基准(SNTP + 服务器双向校时)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 设备内部(帧缓存、Flash缓存、录像)始终使用 esp_timer 时钟, 只在帧头离开设备时加上偏移换算为公共时间:
+ * Unix时间(us, UTC), 与服务器 time.time() 相同. 未校时时偏移为0, 帧头仍为 esp_timer 时间(远小于1e15),
+ * 接收端据此区分.
+ * 偏移的来源:
+ * 1. SNTP(CLOCK_SYNC_SNTP_EN): 能上网时自动获得, 精度为毫秒级
+ * 2. 服务器: 经控制通道发送若干 CTRL_CMD_CLOCK_PING(arg 为服务器发送时间 t1), 设备应答中带上应答时刻的
+ *    esp_timer 时间, 服务器记下收到时间 t4, 取往返时间最短的一次估计偏移后以 CTRL_CMD_CLOCK_SET 下发.
+ *    局域网内误差约为最短往返时间的一半(通常 < 1ms), 设置后不再采用SNTP结果, 同一服务器下各台摄像头时间一致
+ * 服务器周期性校准时, 小于 CLOCK_SYNC_SLEW_US 的修正量只应用 1/2^CLOCK_SYNC_SLEW_SHIFT, 时间戳不随往返抖动跳变.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __CLOCK_SYNC_H
+#define __CLOCK_SYNC_H
+
+#include <stdint.h>
+
+
+#define CLOCK_SYNC_SNTP_EN          1                               /* 1:联网后启动SNTP(服务器校时后以服务器为准) */
+#define CLOCK_SYNC_SNTP_SERVER      "pool.ntp.org"                  /* SNTP服务器 */
+#define CLOCK_SYNC_SLEW_US          2000                            /* 服务器修正量小于该值时逐步修正 */
+#define CLOCK_SYNC_SLEW_SHIFT       2                               /* 逐步修正时每次只应用 1/4 */
+
+/* 偏移来源 */
+typedef enum
+{
+    CLOCK_SYNC_NONE = 0,                                            /* 未校时, 公共时间即 esp_timer 时间 */
+    CLOCK_SYNC_SNTP,
+    CLOCK_SYNC_SERVER,
+} clock_sync_src_t;
+
+/* 函数声明 */
+void clock_sync_init(void);                                         /* 启动SNTP(须在获得IP之后) */
+void clock_sync_set_offset(int64_t offset_us);                      /* 服务器下发的偏移: 公共时间 - esp_timer时间 */
+int64_t clock_sync_to_common(int64_t local_us);                     /* esp_timer时间 -> 公共时间 */
+int64_t clock_sync_to_local(int64_t common_us);                     /* 公共时间 -> esp_timer时间 */
+clock_sync_src_t clock_sync_source(void);                           /* 当前偏移的来源 */
+
+#endif
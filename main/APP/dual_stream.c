@@ -0,0 +1,230 @@
+/**
+ ****************************************************************************************************
+ * @file        dual_stream.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       双码流: 高分辨率帧用于本地录像, 缩小转码后的低分辨率帧上传
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "dual_stream.h"
+#include "task_topo.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "heap_stats.h"
+#include "img_converters.h"
+#include "img_converters.h"
+
+
+/* 提交给转码线程的一帧 */
+typedef struct
+{
+    camera_fb_t *fb;
+    uint32_t seq;
+} dual_stream_item_t;
+
+/* 编码输出 */
+typedef struct
+{
+    uint8_t *buf;
+    size_t len;
+    bool overflow;
+} dual_stream_out_t;
+
+static QueueHandle_t g_dual_queue = NULL;                           /* 发送线程 -> 转码线程, 长度1 */
+static uint8_t *g_dual_pixels = NULL;                               /* 缩放解码缓冲(RGB565, PSRAM) */
+static size_t g_dual_pixels_size = 0;
+static uint8_t *g_dual_jpeg = NULL;                                 /* 编码输出缓冲(PSRAM) */
+static dual_stream_send_t g_dual_send = NULL;
+static esp_jpg_dec_t g_dual_dec;                                    /* 解码器工作区(内部RAM) */
+
+
+/**
+ * @brief       缩放解码完成, 记录缩放后的宽高
+ * @param       arg   : uint16_t[2] 宽高
+ * @param       strip : 整幅图像
+ * @retval      true
+ */
+static bool dual_stream_decoded(void *arg, jpg_strip_t *strip)
+{
+    uint16_t *size = (uint16_t *)arg;
+
+    size[0] = strip->width;
+    size[1] = strip->height;
+
+    return true;
+}
+
+/**
+ * @brief       编码输出回调, 写入预分配的输出缓冲
+ * @param       arg   : dual_stream_out_t
+ * @param       index : 写入位置
+ * @param       data  : 编码数据
+ * @param       len   : 长度
+ * @retval      写入的字节数, 缓冲不足时返回0结束编码
+ */
+static size_t dual_stream_write(void *arg, size_t index, const void *data, size_t len)
+{
+    dual_stream_out_t *out = (dual_stream_out_t *)arg;
+
+    if (index + len > DUAL_STREAM_JPEG_MAX)
+    {
+        out->overflow = true;
+        return 0;
+    }
+
+    memcpy(out->buf + index, data, len);
+    out->len = index + len;
+
+    return len;
+}
+
+/**
+ * @brief       转码线程函数
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void dual_stream_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    dual_stream_item_t item;
+    dual_stream_out_t out;
+    frame_header_t hdr;
+    uint16_t size[2];
+    bool ok;
+
+    while (1)
+    {
+        xQueueReceive(g_dual_queue, &item, portMAX_DELAY);
+
+        size[0] = 0;
+        size[1] = 0;
+        ok = jpg2strips(&g_dual_dec, item.fb->buf, item.fb->len, DUAL_STREAM_SCALE, JPG_STRIP_RGB565_BE,
+                         g_dual_pixels, g_dual_pixels_size, 0, dual_stream_decoded, size);
+        frame_header_fill(&hdr, item.fb, item.seq);                 /* 采集时间戳与序号沿用原始帧 */
+        esp_camera_fb_return(item.fb);                              /* 已解码, 尽早归还帧缓存 */
+
+        if (!ok || size[0] == 0)
+        {
+            ESP_LOGD("TAG", "dual stream: decode failed");
+            continue;
+        }
+
+        out.buf = g_dual_jpeg;
+        out.len = 0;
+        out.overflow = false;
+
+        /* fmt2jpg_cb 的 RGB565 输入为大端字节顺序 */
+        if (!fmt2jpg_cb(g_dual_pixels, (size_t)size[0] * size[1] * 2, size[0], size[1], PIXFORMAT_RGB565,
+                        DUAL_STREAM_QUALITY, dual_stream_write, &out) || out.overflow)
+        {
+            ESP_LOGD("TAG", "dual stream: encode failed");
+            continue;
+        }
+
+        hdr.flags |= FRAME_FLAG_PREVIEW;
+        hdr.width = size[0];
+        hdr.height = size[1];
+        hdr.payload_len = out.len;
+        g_dual_send(&hdr, out.buf, out.len);                        /* 未连接或拥塞时本帧丢弃 */
+    }
+}
+
+/**
+ * @brief       按最高分辨率分配缓冲并启动转码线程
+ * @param       config : 摄像头配置(frame_size 为最高分辨率)
+ * @param       send   : 子码流发送回调
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_SUPPORTED:未使能或非JPEG格式; ESP_ERR_NO_MEM:内存不足
+ */
+esp_err_t dual_stream_init(const camera_config_t *config, dual_stream_send_t send)
+{
+#if DUAL_STREAM_EN
+    static StaticQueue_t queue_buf;
+    static uint8_t queue_storage[sizeof(dual_stream_item_t)];
+    static StackType_t stack[DUAL_STREAM_THREAD_STACK];            /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+
+    if (config->pixel_format != PIXFORMAT_JPEG)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    /* 缩放后的尺寸向上取整到8像素(解码按8x8块输出) */
+    g_dual_pixels_size = (size_t)(((resolution[config->frame_size].width >> DUAL_STREAM_SCALE) + 7) & ~7) *
+                         (((resolution[config->frame_size].height >> DUAL_STREAM_SCALE) + 7) & ~7) * 2;
+    g_dual_pixels = heap_stats_malloc(HEAP_TAG_DUAL_STREAM, g_dual_pixels_size, MALLOC_CAP_SPIRAM);
+    g_dual_jpeg = heap_stats_malloc(HEAP_TAG_DUAL_STREAM, DUAL_STREAM_JPEG_MAX, MALLOC_CAP_SPIRAM);
+
+    if (g_dual_pixels == NULL || g_dual_jpeg == NULL)
+    {
+        heap_stats_free(HEAP_TAG_DUAL_STREAM, g_dual_pixels);
+        heap_stats_free(HEAP_TAG_DUAL_STREAM, g_dual_jpeg);
+        g_dual_pixels = NULL;
+        g_dual_jpeg = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_dual_queue = xQueueCreateStatic(1, sizeof(dual_stream_item_t), queue_storage, &queue_buf);
+    g_dual_send = send;
+    xTaskCreateStaticPinnedToCore(dual_stream_thread, "dual_stream_thread", DUAL_STREAM_THREAD_STACK, NULL,
+                                  DUAL_STREAM_THREAD_PRIO, stack, &tcb, DUAL_STREAM_THREAD_CORE);
+    return ESP_OK;
+#else
+    (void)config;
+    (void)send;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       提交一帧转码上传(发送线程调用, 不阻塞)
+ * @note        转码线程忙时跳过本帧; 接收后增加帧的引用计数, 解码完成后由转码线程归还
+ * @param       fb  : 帧缓存
+ * @param       seq : 帧序号
+ * @retval      1:已接收(或转码线程忙, 本帧不上传); 0:未以子码流上传, 调用者照常发送原始帧
+ */
+int dual_stream_offer(camera_fb_t *fb, uint32_t seq)
+{
+#if DUAL_STREAM_EN
+    dual_stream_item_t item;
+
+    if (g_dual_queue == NULL || fb->format != PIXFORMAT_JPEG)
+    {
+        return 0;
+    }
+
+    if (uxQueueSpacesAvailable(g_dual_queue) == 0 || esp_camera_fb_acquire(fb) == NULL)
+    {
+        return 1;
+    }
+
+    item.fb = fb;
+    item.seq = seq;
+
+    if (xQueueSend(g_dual_queue, &item, 0) != pdTRUE)
+    {
+        esp_camera_fb_return(fb);
+    }
+
+    return 1;
+#else
+    (void)fb;
+    (void)seq;
+    return 0;
+#endif
+}
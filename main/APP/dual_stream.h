@@ -0,0 +1,51 @@
+/**
+ ****************************************************************************************************
+ * @file        dual_stream.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       双码流: 高分辨率帧用于本地录像, 缩小转码后的低分辨率帧上传
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 传感器按 frame_size 输出高分辨率JPEG, SD卡录像、MJPEG客户端与LCD取景照常使用原始帧(主码流).
+ * 上传时发送线程不再发送原始帧, 而是经 dual_stream_offer() 交给转码线程(增加帧的引用计数, 转码线程忙时跳过):
+ * jpg2strips() 按 DUAL_STREAM_SCALE 缩放解码为RGB565(PSRAM整幅缓冲), 再以 fmt2jpg_cb() 按
+ * DUAL_STREAM_QUALITY 重新编码到预分配的输出缓冲, 以 FRAME_FLAG_PREVIEW 帧经发送回调上传(子码流).
+ * 两个码流的质量、帧率与去向相互独立: 主码流的质量与分辨率由码率控制按传感器配置, 帧率为传感器帧率;
+ * 子码流的质量固定为 DUAL_STREAM_QUALITY, 帧率受 frame_pacer/移动侦测限制, 链路拥塞时发送回调拒绝, 本帧丢弃.
+ * 子码流不上报码率控制, 上行链路拥塞不会降低录像画质.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __DUAL_STREAM_H
+#define __DUAL_STREAM_H
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "esp_jpg_decode.h"
+#include "frame_proto.h"
+
+
+#define DUAL_STREAM_EN              0                               /* 1:上传缩小转码的子码流(frame_size 宜设为SVGA以上) */
+#define DUAL_STREAM_SCALE           JPG_SCALE_4X                    /* 子码流缩放比例(UXGA->400x300, SVGA->200x150) */
+#define DUAL_STREAM_QUALITY         60                              /* 子码流JPEG质量(1~100, 数值越大质量越高) */
+#define DUAL_STREAM_JPEG_MAX        (64 * 1024)                     /* 子码流单帧上限(输出缓冲大小) */
+
+/* 子码流发送回调, 返回0:已发送; -1:未连接或链路拥塞(本帧丢弃) */
+typedef int (*dual_stream_send_t)(const frame_header_t *hdr, const void *data, size_t len);
+
+/* 函数声明 */
+esp_err_t dual_stream_init(const camera_config_t *config, dual_stream_send_t send);     /* 按最高分辨率分配缓冲并启动转码线程 */
+int dual_stream_offer(camera_fb_t *fb, uint32_t seq);               /* 提交一帧转码上传(不阻塞), 1:已接收 */
+
+#endif
@@ -0,0 +1,399 @@
+/**
+ ****************************************************************************************************
+ * @file        espnow_link.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       ESP-NOW图传(发往网关板, 不关联AP)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "espnow_link.h"
+#include "espnow_proto.h"
+#include "frame_proto.h"
+#include "wifi_profile.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_idf_version.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+
+
+/* 网关的回复(接收回调 -> 发送线程) */
+typedef struct
+{
+    uint8_t  mac[ESP_NOW_ETH_ALEN];
+    uint8_t  type;
+    uint16_t frame_id;
+    uint8_t  bitmap[ESPNOW_PROTO_BITMAP_LEN];                       /* NACK: 缺少的分片 */
+} espnow_reply_t;
+
+static const uint8_t g_espnow_bcast[ESP_NOW_ETH_ALEN] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+static uint8_t g_espnow_gw[ESP_NOW_ETH_ALEN];                       /* 网关地址, HELLO回复后有效 */
+static QueueHandle_t g_espnow_reply = NULL;
+static SemaphoreHandle_t g_espnow_window = NULL;                    /* 发送窗口, 发送回调归还 */
+static uint8_t g_espnow_pkt[ESPNOW_PROTO_PKT_MAX];
+
+
+/**
+ * @brief       发送完成回调(WIFI任务中调用), 归还一个发送窗口
+ * @note        单播失败表示MAC层重传也未送达, 由 NACK 选择重传补救
+ * @retval      无
+ */
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 5, 0)
+static void espnow_link_send_cb(const esp_now_send_info_t *tx_info, esp_now_send_status_t status)
+#else
+static void espnow_link_send_cb(const uint8_t *mac_addr, esp_now_send_status_t status)
+#endif
+{
+    (void)status;
+    xSemaphoreGive(g_espnow_window);
+}
+
+/**
+ * @brief       接收回调(WIFI任务中调用), 网关的回复交给发送线程
+ * @param       info : 接收信息
+ * @param       data : 数据
+ * @param       len  : 长度
+ * @retval      无
+ */
+static void espnow_link_recv_cb(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    const espnow_pkt_t *pkt = (const espnow_pkt_t *)data;
+    espnow_reply_t reply;
+    int bytes;
+
+    if (!espnow_pkt_valid(data, len) || pkt->type == ESPNOW_PKT_DATA || pkt->type == ESPNOW_PKT_POLL)
+    {
+        return;
+    }
+
+    memcpy(reply.mac, info->src_addr, ESP_NOW_ETH_ALEN);
+    reply.type = pkt->type;
+    reply.frame_id = pkt->frame_id;
+    memset(reply.bitmap, 0, sizeof(reply.bitmap));
+    bytes = len - (int)sizeof(espnow_pkt_t);
+
+    if (bytes > (int)sizeof(reply.bitmap))
+    {
+        bytes = sizeof(reply.bitmap);
+    }
+
+    if (bytes > 0)
+    {
+        memcpy(reply.bitmap, data + sizeof(espnow_pkt_t), bytes);
+    }
+
+    xQueueSend(g_espnow_reply, &reply, 0);
+}
+
+/**
+ * @brief       发送一个包, 发送窗口满或协议栈缓冲不足时等待
+ * @param       mac : 目的地址
+ * @param       len : 长度(g_espnow_pkt 中的数据)
+ * @retval      ESP_OK:已交给协议栈
+ */
+static esp_err_t espnow_link_send(const uint8_t *mac, size_t len)
+{
+    esp_err_t err;
+
+    while (1)
+    {
+        xSemaphoreTake(g_espnow_window, portMAX_DELAY);
+        err = esp_now_send(mac, g_espnow_pkt, len);                 /* 协议栈拷贝数据, 返回后即可复用缓冲 */
+
+        if (err == ESP_OK)
+        {
+            return ESP_OK;
+        }
+
+        xSemaphoreGive(g_espnow_window);                            /* 未发出, 不会有发送回调 */
+
+        if (err != ESP_ERR_ESPNOW_NO_MEM)
+        {
+            return err;
+        }
+
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * @brief       启动WIFI射频与ESP-NOW(不关联AP, 在启动线程中代替 wifi_sta_init 调用)
+ * @param       无
+ * @retval      无
+ */
+void espnow_link_wifi_init(void)
+{
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    esp_now_peer_info_t peer = { 0 };
+
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_start());
+    wifi_profile_apply(WIFI_PROFILE_LATENCY);                       /* 关闭modem sleep, 最大发射功率 */
+    ESP_ERROR_CHECK(esp_wifi_set_channel(ESPNOW_PROTO_CHANNEL, WIFI_SECOND_CHAN_NONE));
+
+    g_espnow_reply = xQueueCreate(8, sizeof(espnow_reply_t));
+    g_espnow_window = xSemaphoreCreateCounting(ESPNOW_LINK_WINDOW, ESPNOW_LINK_WINDOW);
+    assert(g_espnow_reply && g_espnow_window);
+
+    ESP_ERROR_CHECK(esp_now_init());
+    ESP_ERROR_CHECK(esp_now_register_send_cb(espnow_link_send_cb));
+    ESP_ERROR_CHECK(esp_now_register_recv_cb(espnow_link_recv_cb));
+
+    memcpy(peer.peer_addr, g_espnow_bcast, ESP_NOW_ETH_ALEN);
+    peer.channel = ESPNOW_PROTO_CHANNEL;
+    peer.ifidx = WIFI_IF_STA;
+    peer.encrypt = false;
+    ESP_ERROR_CHECK(esp_now_add_peer(&peer));
+}
+
+/**
+ * @brief       广播HELLO直到网关回复, 然后把网关加为单播对端
+ * @param       无
+ * @retval      无
+ */
+static void espnow_link_find_gateway(void)
+{
+    espnow_pkt_t *pkt = (espnow_pkt_t *)g_espnow_pkt;
+    esp_now_peer_info_t peer = { 0 };
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 4, 0)
+    esp_now_rate_config_t rate = {
+        .phymode = WIFI_PHY_MODE_HT20,
+        .rate = ESPNOW_LINK_PHY_RATE,
+        .ersu = false,
+        .dcm = false,
+    };
+#endif
+    espnow_reply_t reply;
+    int64_t start = esp_timer_get_time();
+
+    while (1)
+    {
+        espnow_pkt_init(pkt, ESPNOW_PKT_HELLO, 0);
+        espnow_link_send(g_espnow_bcast, sizeof(espnow_pkt_t));
+
+        if (xQueueReceive(g_espnow_reply, &reply, pdMS_TO_TICKS(ESPNOW_LINK_HELLO_MS)) == pdTRUE &&
+            reply.type == ESPNOW_PKT_HELLO)
+        {
+            break;
+        }
+    }
+
+    memcpy(g_espnow_gw, reply.mac, ESP_NOW_ETH_ALEN);
+    memcpy(peer.peer_addr, g_espnow_gw, ESP_NOW_ETH_ALEN);
+    peer.channel = ESPNOW_PROTO_CHANNEL;
+    peer.ifidx = WIFI_IF_STA;
+    peer.encrypt = false;
+
+    if (!esp_now_is_peer_exist(g_espnow_gw))
+    {
+        ESP_ERROR_CHECK(esp_now_add_peer(&peer));
+    }
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 4, 0)
+    if (esp_now_set_peer_rate_config(g_espnow_gw, &rate) != ESP_OK)
+#else
+    if (esp_wifi_config_espnow_rate(WIFI_IF_STA, ESPNOW_LINK_PHY_RATE) != ESP_OK)
+#endif
+    {
+        ESP_LOGW("TAG", "espnow: peer rate not set, using the default rate");
+    }
+
+    ESP_LOGI("TAG", "espnow: gateway " MACSTR " found in %lld ms", MAC2STR(g_espnow_gw),
+             (esp_timer_get_time() - start) / 1000);
+}
+
+/**
+ * @brief       发送一帧的第 frag 个分片
+ * @param       hdr   : 帧头(分片0的开头)
+ * @param       fb    : 帧缓存
+ * @param       id    : 帧编号
+ * @param       frag  : 分片序号
+ * @param       count : 分片数
+ * @retval      ESP_OK:已交给协议栈
+ */
+static esp_err_t espnow_link_send_frag(const frame_header_t *hdr, const camera_fb_t *fb, uint16_t id,
+                                       uint16_t frag, uint16_t count)
+{
+    espnow_pkt_t *pkt = (espnow_pkt_t *)g_espnow_pkt;
+    uint8_t *dst = g_espnow_pkt + sizeof(espnow_pkt_t);
+    uint32_t total = sizeof(frame_header_t) + fb->len;
+    uint32_t off = (uint32_t)frag * ESPNOW_PROTO_FRAG_SIZE;
+    uint32_t len = total - off;
+    uint32_t n;
+
+    if (len > ESPNOW_PROTO_FRAG_SIZE)
+    {
+        len = ESPNOW_PROTO_FRAG_SIZE;
+    }
+
+    espnow_pkt_init(pkt, ESPNOW_PKT_DATA, id);
+    pkt->frag = frag;
+    pkt->frag_count = count;
+    pkt->frag_size = ESPNOW_PROTO_FRAG_SIZE;
+    pkt->frame_len = total;
+
+    /* 帧在逻辑上是 帧头 + JPEG, 分片可能跨过两者的边界 */
+    n = 0;
+
+    if (off < sizeof(frame_header_t))
+    {
+        n = sizeof(frame_header_t) - off;
+        memcpy(dst, (const uint8_t *)hdr + off, n);
+    }
+
+    memcpy(dst + n, fb->buf + (off + n - sizeof(frame_header_t)), len - n);
+
+    return espnow_link_send(g_espnow_gw, sizeof(espnow_pkt_t) + len);
+}
+
+/**
+ * @brief       发送一帧: 全部分片, 然后按网关的NACK只重发缺少的分片
+ * @param       fb      : 帧缓存(发送期间持有)
+ * @param       seq     : 帧序号(frame_header_t)
+ * @param       id      : 帧编号(ESP-NOW)
+ * @param       resent  : 累加重发的分片数
+ * @retval      1:网关已收齐; 0:重试用尽
+ */
+static int espnow_link_send_frame(const camera_fb_t *fb, uint32_t seq, uint16_t id, uint32_t *resent)
+{
+    espnow_pkt_t *pkt = (espnow_pkt_t *)g_espnow_pkt;
+    frame_header_t hdr;
+    espnow_reply_t reply;
+    uint32_t total = sizeof(frame_header_t) + fb->len;
+    uint16_t count = (uint16_t)((total + ESPNOW_PROTO_FRAG_SIZE - 1) / ESPNOW_PROTO_FRAG_SIZE);
+    int round;
+
+    frame_header_fill(&hdr, fb, seq);
+    xQueueReset(g_espnow_reply);                                    /* 丢弃上一帧迟到的回复 */
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        espnow_link_send_frag(&hdr, fb, id, i, count);
+    }
+
+    for (round = 0; round < ESPNOW_LINK_RETRY; round++)
+    {
+        espnow_pkt_init(pkt, ESPNOW_PKT_POLL, id);
+        pkt->frag_count = count;
+        pkt->frag_size = ESPNOW_PROTO_FRAG_SIZE;
+        pkt->frame_len = total;
+        espnow_link_send(g_espnow_gw, sizeof(espnow_pkt_t));
+
+        do
+        {
+            if (xQueueReceive(g_espnow_reply, &reply, pdMS_TO_TICKS(ESPNOW_LINK_ACK_MS)) != pdTRUE)
+            {
+                reply.type = 0;                                     /* 超时: POLL或回复丢失, 再问一次 */
+                break;
+            }
+        } while (reply.frame_id != id || (reply.type != ESPNOW_PKT_ACK && reply.type != ESPNOW_PKT_NACK));
+
+        if (reply.type == ESPNOW_PKT_ACK)
+        {
+            return 1;
+        }
+
+        if (reply.type == ESPNOW_PKT_NACK)
+        {
+            for (uint16_t i = 0; i < count; i++)
+            {
+                if (reply.bitmap[i >> 3] & (1 << (i & 7)))
+                {
+                    espnow_link_send_frag(&hdr, fb, id, i, count);
+                    (*resent)++;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief       ESP-NOW图传(在 app_main 中代替 lwip_demo 调用, 不返回)
+ * @param       config : 摄像头配置(沿用启动时的设置)
+ * @retval      无
+ */
+void espnow_link_run(camera_config_t *config)
+{
+    camera_fb_t *fb;
+    uint32_t seq = 0;
+    uint16_t id = 0;
+    uint32_t frames = 0;
+    uint32_t lost = 0;
+    uint32_t resent = 0;
+    uint64_t bytes = 0;
+    int64_t log_start;
+    int64_t now;
+
+    (void)config;
+
+    espnow_link_find_gateway();
+    log_start = esp_timer_get_time();
+
+    while (1)
+    {
+        fb = esp_camera_fb_get();
+
+        if (fb == NULL)
+        {
+            continue;
+        }
+
+        if (fb->format != PIXFORMAT_JPEG || sizeof(frame_header_t) + fb->len > ESPNOW_PROTO_FRAME_MAX)
+        {
+            esp_camera_fb_return(fb);
+            lost++;
+            continue;
+        }
+
+        if (espnow_link_send_frame(fb, seq, id, &resent))
+        {
+            frames++;
+            bytes += fb->len;
+        }
+        else
+        {
+            lost++;
+        }
+
+        esp_camera_fb_return(fb);
+        seq++;
+        id++;
+
+        now = esp_timer_get_time();
+
+        if (now - log_start >= ESPNOW_LINK_LOG_MS * 1000LL)
+        {
+            ESP_LOGI("TAG", "espnow: %.1f fps %.0f kbit/s, %lu resent frags, %lu frames lost",
+                     (double)frames * 1e6 / (double)(now - log_start), (double)bytes * 8e3 / (double)(now - log_start),
+                     (unsigned long)resent, (unsigned long)lost);
+            frames = 0;
+            lost = 0;
+            resent = 0;
+            bytes = 0;
+            log_start = now;
+        }
+    }
+}
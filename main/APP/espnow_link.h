@@ -0,0 +1,45 @@
+/**
+ ****************************************************************************************************
+ * @file        espnow_link.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       ESP-NOW图传(发往网关板, 不关联AP)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * ESPNOW_LINK_EN 为1时不连接路由器、不走TCP/IP: WIFI只启动射频并固定在 ESPNOW_PROTO_CHANNEL 信道,
+ * 广播 HELLO 找到网关(espnow_gateway/ 工程)后以单播ESP-NOW发送帧, 上电到第一帧只需一次HELLO往返.
+ * 帧按 espnow_proto.h 分片, 发送窗口 ESPNOW_LINK_WINDOW 个包(发送回调归还), 每帧发完询问网关,
+ * 只重发网关报告缺少的分片. 网关把收齐的帧经USB串口交给PC(tools/pc_viewer/espnow_serial.py).
+ * 此模式没有控制命令通道, 帧率与画质沿用启动配置.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __ESPNOW_LINK_H
+#define __ESPNOW_LINK_H
+
+#include "esp_camera.h"
+
+
+#define ESPNOW_LINK_EN              0                               /* 1:ESP-NOW图传到网关, 代替TCP推流 */
+#define ESPNOW_LINK_WINDOW          8                               /* 已交给协议栈未完成发送的包数上限 */
+#define ESPNOW_LINK_ACK_MS          30                              /* 等待网关ACK/NACK的时间 */
+#define ESPNOW_LINK_RETRY           4                               /* 每帧最多询问/重发的轮数, 之后丢弃该帧 */
+#define ESPNOW_LINK_HELLO_MS        100                             /* 寻找网关时广播HELLO的间隔 */
+#define ESPNOW_LINK_PHY_RATE        WIFI_PHY_RATE_MCS5_LGI          /* 单播速率(HT20 MCS5 = 52Mbit/s) */
+#define ESPNOW_LINK_LOG_MS          5000                            /* 输出统计的间隔 */
+
+/* 函数声明 */
+void espnow_link_wifi_init(void);                                   /* 启动WIFI射频与ESP-NOW(不关联AP) */
+void espnow_link_run(camera_config_t *config);                      /* ESP-NOW图传(不返回) */
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ ****************************************************************************************************
+ * @file        espnow_proto.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       ESP-NOW图传分片协议(摄像头与网关共用)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 每个ESP-NOW包以 espnow_pkt_t 开头, 所有字段小端:
+ * HELLO : 摄像头广播寻找网关; 网关单播回复 HELLO, 双方随后互加为单播对端(单播有MAC层ACK与重传)
+ * DATA  : 一帧(frame_header_t + JPEG, 与TCP推流相同)的第 frag 个分片, 偏移 frag * frag_size
+ * POLL  : 摄像头发完一轮分片后询问网关(不带负载), 同时携带 frame_len/frag_count/frag_size
+ * ACK   : 网关已收齐 frame_id
+ * NACK  : 网关缺少的分片, 负载为 (frag_count + 7) / 8 字节位图, 第 i 位为1表示缺第 i 片
+ * 摄像头只重发位图中的分片, 收到 ACK 或重试 ESPNOW_LINK_RETRY 轮后才发下一帧, 所以网关每个对端只需一个重组缓冲.
+ * 本文件不依赖 esp_camera, 网关工程(espnow_gateway/)直接包含.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __ESPNOW_PROTO_H
+#define __ESPNOW_PROTO_H
+
+#include <stdint.h>
+#include "esp_now.h"
+
+
+#define ESPNOW_PROTO_MAGIC          0x4E45                          /* 'EN' 小端 */
+#define ESPNOW_PROTO_CHANNEL        1                               /* 摄像头与网关固定使用的信道 */
+#define ESPNOW_PROTO_FRAG_MAX       256                             /* 每帧最多分片数 */
+#define ESPNOW_PROTO_BITMAP_LEN     (ESPNOW_PROTO_FRAG_MAX / 8)
+
+/* ESP-NOW v2(IDF 5.4+)单包最多1470字节, 对端也须支持v2; 旧版本只有250字节 */
+#ifdef ESP_NOW_MAX_DATA_LEN_V2
+#define ESPNOW_PROTO_PKT_MAX        ESP_NOW_MAX_DATA_LEN_V2
+#else
+#define ESPNOW_PROTO_PKT_MAX        ESP_NOW_MAX_DATA_LEN
+#endif
+
+/* 包类型 */
+enum
+{
+    ESPNOW_PKT_HELLO = 1,
+    ESPNOW_PKT_DATA,
+    ESPNOW_PKT_POLL,
+    ESPNOW_PKT_ACK,
+    ESPNOW_PKT_NACK,
+};
+
+/* 包头(16字节) */
+typedef struct __attribute__((packed))
+{
+    uint16_t magic;                                                 /* ESPNOW_PROTO_MAGIC */
+    uint8_t  type;                                                  /* ESPNOW_PKT_xxx */
+    uint8_t  flags;                                                 /* 保留, 填0 */
+    uint16_t frame_id;                                              /* 帧编号, 每帧加1 */
+    uint16_t frag;                                                  /* 分片序号(DATA) */
+    uint16_t frag_count;                                            /* 本帧分片数 */
+    uint16_t frag_size;                                             /* 除最后一片外每片的负载长度 */
+    uint32_t frame_len;                                             /* 本帧总长度 */
+} espnow_pkt_t;
+
+#define ESPNOW_PROTO_FRAG_SIZE      (ESPNOW_PROTO_PKT_MAX - sizeof(espnow_pkt_t))
+#define ESPNOW_PROTO_FRAME_MAX      ((uint32_t)ESPNOW_PROTO_FRAG_SIZE * ESPNOW_PROTO_FRAG_MAX)
+
+/**
+ * @brief       填充包头
+ * @param       pkt  : 包头
+ * @param       type : 包类型
+ * @param       id   : 帧编号
+ * @retval      无
+ */
+static inline void espnow_pkt_init(espnow_pkt_t *pkt, uint8_t type, uint16_t id)
+{
+    pkt->magic      = ESPNOW_PROTO_MAGIC;
+    pkt->type       = type;
+    pkt->flags      = 0;
+    pkt->frame_id   = id;
+    pkt->frag       = 0;
+    pkt->frag_count = 0;
+    pkt->frag_size  = 0;
+    pkt->frame_len  = 0;
+}
+
+/**
+ * @brief       检查收到的包头
+ * @param       data : 数据
+ * @param       len  : 长度
+ * @retval      1:合法; 0:非本协议或长度不足
+ */
+static inline int espnow_pkt_valid(const uint8_t *data, int len)
+{
+    const espnow_pkt_t *pkt = (const espnow_pkt_t *)data;
+
+    return len >= (int)sizeof(espnow_pkt_t) && pkt->magic == ESPNOW_PROTO_MAGIC &&
+           pkt->frag_count <= ESPNOW_PROTO_FRAG_MAX;
+}
+
+#endif
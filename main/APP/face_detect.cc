@@ -0,0 +1,321 @@
+/**
+ ****************************************************************************************************
+ * @file        face_detect.cc
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       设备端人脸检测(ESP-DL), 检测结果以元数据帧上传
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "face_detect.h"
+#include "task_topo.h"
+#include "load_gov.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#if FACE_DETECT_EN
+#include "human_face_detect.hpp"
+#endif
+
+extern "C" {
+#include "heap_stats.h"
+#include "jpg_strip.h"
+#include "mqtt_events.h"
+#include "clock_sync.h"
+}
+
+
+#if FACE_DETECT_EN
+static QueueHandle_t g_face_queue = NULL;                           /* 发送线程 -> 检测线程, 长度1 */
+static SemaphoreHandle_t g_face_lock = NULL;                        /* 保护 g_face_result */
+#if MQTT_EVENTS_EN
+static bool g_face_reported = false;                                /* 上一个检测帧已发布人脸事件 */
+#endif
+static face_detect_result_t g_face_result;
+static uint8_t *g_face_rgb = NULL;                                  /* 缩放解码缓冲(RGB888, PSRAM) */
+static size_t g_face_rgb_size = 0;
+static int64_t g_face_last_us = 0;                                  /* 上一次接收检测帧的时间 */
+static HumanFaceDetect *g_face_model = nullptr;
+static jpg_dec_t g_face_dec;                                        /* 解码器工作区(内部RAM) */
+
+
+/**
+ * @brief       缩放解码完成, 记录缩放后的宽高
+ * @param       arg   : uint16_t[2] 宽高
+ * @param       strip : 整幅图像
+ * @retval      true
+ */
+static bool face_detect_decoded(void *arg, jpg_strip_t *strip)
+{
+    uint16_t *size = (uint16_t *)arg;
+
+    size[0] = strip->width;
+    size[1] = strip->height;
+
+    return true;
+}
+
+/**
+ * @brief       检测线程函数
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void face_detect_thread(void *pvParameters)
+{
+    (void)pvParameters;
+    camera_fb_t *fb = NULL;
+    frame_detect_t meta;
+    uint16_t size[2];
+    uint16_t width;
+    uint16_t height;
+    uint64_t timestamp_us;
+    bool ok;
+
+    load_gov_watch(LOAD_GOV_ANALYTICS);
+
+    while (1)
+    {
+        xQueueReceive(g_face_queue, &fb, portMAX_DELAY);
+
+        size[0] = 0;
+        size[1] = 0;
+        width = (uint16_t)fb->width;
+        height = (uint16_t)fb->height;
+        timestamp_us = (uint64_t)fb->timestamp.tv_sec * 1000000ULL + fb->timestamp.tv_usec;
+        ok = jpg_strip_decode(&g_face_dec, fb->buf, fb->len, FACE_DETECT_SCALE, JPG_STRIP_RGB888,
+                              g_face_rgb, g_face_rgb_size, 0, face_detect_decoded, size);
+        esp_camera_fb_return(fb);                                   /* 已解码, 尽早归还帧缓存 */
+
+        if (!ok || size[0] == 0)
+        {
+            ESP_LOGD("TAG", "face detect: decode failed");
+            continue;
+        }
+
+        dl::image::img_t img;
+        img.data = g_face_rgb;
+        img.width = size[0];
+        img.height = size[1];
+        img.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888;
+
+        std::list<dl::detect::result_t> &found = g_face_model->run(img);
+
+        memset(&meta, 0, sizeof(meta));
+
+        for (const dl::detect::result_t &r : found)                 /* 模型输出已按得分从高到低排序 */
+        {
+            int x0 = r.box[0] < 0 ? 0 : r.box[0];
+            int y0 = r.box[1] < 0 ? 0 : r.box[1];
+            int x1 = r.box[2] > size[0] ? size[0] : r.box[2];
+            int y1 = r.box[3] > size[1] ? size[1] : r.box[3];
+            frame_detect_box_t *box;
+
+            if (meta.count >= FRAME_DETECT_BOX_MAX)
+            {
+                break;
+            }
+
+            if (r.score * 100 < FACE_DETECT_SCORE_MIN || x1 <= x0 || y1 <= y0)
+            {
+                continue;
+            }
+
+            box = &meta.box[meta.count];
+
+            box->x = (uint16_t)(x0 << FACE_DETECT_SCALE);           /* 换算回原始帧坐标 */
+            box->y = (uint16_t)(y0 << FACE_DETECT_SCALE);
+            box->w = (uint16_t)((x1 - x0) << FACE_DETECT_SCALE);
+            box->h = (uint16_t)((y1 - y0) << FACE_DETECT_SCALE);
+            box->score = (uint8_t)(r.score * 100);
+            meta.count++;
+        }
+
+        xSemaphoreTake(g_face_lock, portMAX_DELAY);
+        g_face_result.meta = meta;
+        g_face_result.width = width;
+        g_face_result.height = height;
+        g_face_result.timestamp_us = timestamp_us;
+        g_face_result.frames++;
+
+        if (meta.count > 0)
+        {
+            g_face_result.last_face_us = esp_timer_get_time();
+        }
+
+        xSemaphoreGive(g_face_lock);
+
+#if MQTT_EVENTS_EN
+        if (meta.count > 0 || g_face_reported)                      /* 有人期间每个检测帧一条, 消失时一条 */
+        {
+            mqtt_event_box_t boxes[FRAME_DETECT_BOX_MAX];
+            mqtt_event_t event;
+
+            memset(&event, 0, sizeof(event));
+
+            for (uint8_t i = 0; i < meta.count; i++)
+            {
+                boxes[i].x = meta.box[i].x;
+                boxes[i].y = meta.box[i].y;
+                boxes[i].w = meta.box[i].w;
+                boxes[i].h = meta.box[i].h;
+                boxes[i].score = meta.box[i].score;
+            }
+
+            event.type = (meta.count > 0) ? MQTT_EVENT_FACE : MQTT_EVENT_FACE_END;
+            event.timestamp_us = clock_sync_to_common((int64_t)timestamp_us);
+            event.seq = g_face_result.frames;                       /* 只由本线程修改 */
+            event.score = (meta.count > 0) ? meta.box[0].score : 0;
+            event.box_count = meta.count;
+            event.boxes = boxes;
+            mqtt_events_put(&event);
+            g_face_reported = (meta.count > 0);
+        }
+#endif
+    }
+}
+#endif
+
+/**
+ * @brief       加载模型并启动检测线程
+ * @param       config : 摄像头配置(frame_size 为最高分辨率)
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_SUPPORTED:未使能或非JPEG格式; ESP_ERR_NO_MEM:内存不足
+ */
+esp_err_t face_detect_init(const camera_config_t *config)
+{
+#if FACE_DETECT_EN
+    static StaticQueue_t queue_buf;
+    static uint8_t queue_storage[sizeof(camera_fb_t *)];
+    static StaticSemaphore_t lock_buf;
+    static StackType_t stack[FACE_DETECT_THREAD_STACK];            /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+
+    if (config->pixel_format != PIXFORMAT_JPEG)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    /* 缩放后的尺寸向上取整到8像素(解码按8x8块输出) */
+    g_face_rgb_size = (size_t)(((resolution[config->frame_size].width >> FACE_DETECT_SCALE) + 7) & ~7) *
+                      (((resolution[config->frame_size].height >> FACE_DETECT_SCALE) + 7) & ~7) * 3;
+    g_face_rgb = (uint8_t *)heap_stats_malloc(HEAP_TAG_FACE_DETECT, g_face_rgb_size, MALLOC_CAP_SPIRAM);
+
+    if (g_face_rgb == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_face_model = new HumanFaceDetect();                           /* 模型参数在Flash中, 运行时张量在PSRAM */
+    g_face_lock = xSemaphoreCreateMutexStatic(&lock_buf);
+    g_face_queue = xQueueCreateStatic(1, sizeof(camera_fb_t *), queue_storage, &queue_buf);
+    xTaskCreateStaticPinnedToCore(face_detect_thread, "face_detect_thread", FACE_DETECT_THREAD_STACK, NULL,
+                                  FACE_DETECT_THREAD_PRIO, stack, &tcb, FACE_DETECT_THREAD_CORE);
+    return ESP_OK;
+#else
+    (void)config;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       提交一帧用于检测(发送线程调用, 不阻塞)
+ * @note        检测线程忙或距上一次不足 FACE_DETECT_INTERVAL_MS(过载时由负载调控延长)时忽略; 否则增加帧的引用计数, 解码后由检测线程归还
+ * @param       fb : 帧缓存
+ * @retval      无
+ */
+void face_detect_offer(camera_fb_t *fb)
+{
+#if FACE_DETECT_EN
+    int64_t now = esp_timer_get_time();
+
+    if (g_face_queue == NULL || fb->format != PIXFORMAT_JPEG || uxQueueSpacesAvailable(g_face_queue) == 0 ||
+        now - g_face_last_us < (int64_t)FACE_DETECT_INTERVAL_MS * 1000 * load_gov_scale(LOAD_GOV_ANALYTICS))
+    {
+        return;
+    }
+
+    if (esp_camera_fb_acquire(fb) == NULL)
+    {
+        return;
+    }
+
+    if (xQueueSend(g_face_queue, &fb, 0) != pdTRUE)
+    {
+        esp_camera_fb_return(fb);
+        return;
+    }
+
+    g_face_last_us = now;
+#else
+    (void)fb;
+#endif
+}
+
+/**
+ * @brief       读取最近一次的检测结果
+ * @param       result : 输出结果
+ * @retval      无
+ */
+void face_detect_get(face_detect_result_t *result)
+{
+    memset(result, 0, sizeof(face_detect_result_t));
+
+#if FACE_DETECT_EN
+    if (g_face_lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_face_lock, portMAX_DELAY);
+    *result = g_face_result;
+    xSemaphoreGive(g_face_lock);
+#endif
+}
+
+/**
+ * @brief       有新的检测结果时读取(发送线程上传元数据用)
+ * @param       result : 输出结果
+ * @param       seen   : 调用者已读取的检测帧数, 读取后更新
+ * @retval      1:已读取新结果; 0:没有新结果
+ */
+int face_detect_take(face_detect_result_t *result, uint32_t *seen)
+{
+    face_detect_get(result);
+
+    if (result->frames == *seen)
+    {
+        return 0;
+    }
+
+    *seen = result->frames;
+    return 1;
+}
+
+/**
+ * @brief       最近 FACE_DETECT_HOLD_MS 内是否检测到人脸
+ * @param       无
+ * @retval      1:有人; 0:无人或未使能
+ */
+int face_detect_active(void)
+{
+    face_detect_result_t result;
+
+    face_detect_get(&result);
+
+    return result.last_face_us != 0 && esp_timer_get_time() - result.last_face_us < (int64_t)FACE_DETECT_HOLD_MS * 1000;
+}
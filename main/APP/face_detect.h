@@ -0,0 +1,77 @@
+/**
+ ****************************************************************************************************
+ * @file        face_detect.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       设备端人脸检测(ESP-DL), 检测结果以元数据帧上传
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 与移动侦测相同, 发送线程经 face_detect_offer() 把帧交给检测线程(增加帧的引用计数, 检测线程忙或未到
+ * FACE_DETECT_INTERVAL_MS 时跳过). 检测线程以 jpg2strips() 按 FACE_DETECT_SCALE 缩放解码为RGB888
+ * (PSRAM整幅缓冲, 解码完成即归还帧缓存), 交给 ESP-DL 的 HumanFaceDetect 模型, 得分不低于 FACE_DETECT_SCORE_MIN
+ * 的前 FACE_DETECT_BOX_MAX 个人脸框换算回原始帧坐标保存.
+ * 服务器发送 CTRL_CMD_DETECT 后, 每个新的检测结果以 FRAME_PIXFORMAT_DETECT 帧(frame_detect_t, 十几个字节)上传,
+ * 时间戳为被检测帧的采集时间; arg 为2时图像帧只在最近 FACE_DETECT_HOLD_MS 内检测到人脸时上传, 无人时只有元数据,
+ * 服务器可随时用 CTRL_CMD_SNAPSHOT 取一帧. 取景、MJPEG客户端与SD录像不受影响.
+ * 依赖 espressif/human_face_detect 组件(main/idf_component.yml), 模型约占1MB Flash.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __FACE_DETECT_H
+#define __FACE_DETECT_H
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "esp_jpg_decode.h"
+#include "frame_proto.h"
+
+
+#if CONFIG_APP_FACE_DETECT                                           /* menuconfig 中设置, 同时决定是否拉取 espressif/human_face_detect */
+#define FACE_DETECT_EN              1                               /* 1:使能设备端人脸检测 */
+#else
+#define FACE_DETECT_EN              0
+#endif
+#define FACE_DETECT_SCALE           JPG_SCALE_NONE                  /* 检测前的缩放(QVGA原尺寸, VGA以上宜用 JPG_SCALE_2X) */
+#define FACE_DETECT_INTERVAL_MS     200                             /* 两次检测的最小间隔 */
+#define FACE_DETECT_SCORE_MIN       50                              /* 人脸框的最低得分(%) */
+#define FACE_DETECT_HOLD_MS         2000                            /* 最后一次检测到人脸后仍视为有人的时间 */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 检测结果 */
+typedef struct
+{
+    frame_detect_t meta;                                            /* 人脸框(原始帧坐标), 即上传的元数据 */
+    uint16_t width;                                                 /* 被检测帧的宽高 */
+    uint16_t height;
+    uint64_t timestamp_us;                                          /* 被检测帧的采集时间 */
+    int64_t last_face_us;                                           /* 最后一次检测到人脸的时间, 0:从未 */
+    uint32_t frames;                                                /* 已检测的帧数 */
+} face_detect_result_t;
+
+/* 函数声明 */
+esp_err_t face_detect_init(const camera_config_t *config);          /* 加载模型并启动检测线程 */
+void face_detect_offer(camera_fb_t *fb);                            /* 提交一帧用于检测(检测线程忙时忽略) */
+void face_detect_get(face_detect_result_t *result);                 /* 读取最近一次的检测结果 */
+int face_detect_take(face_detect_result_t *result, uint32_t *seen); /* 有比 *seen 更新的结果时读取, 1:已读取 */
+int face_detect_active(void);                                       /* 最近 FACE_DETECT_HOLD_MS 内是否检测到人脸 */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_pacer.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       上传帧率限制(按截止时间均匀放行), 可同时降低传感器帧率减少多余的采集
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "frame_pacer.h"
+#include "sensor_fps.h"
+#include "esp_log.h"
+
+
+static volatile uint32_t g_pacer_fps = FRAME_PACER_FPS;             /* 上传帧率上限, 0:不限制 */
+static volatile int64_t g_pacer_period_us = (FRAME_PACER_FPS > 0) ? 1000000 / FRAME_PACER_FPS : 0;
+static int64_t g_pacer_deadline_us = 0;                             /* 下一帧的放行时间(采集时间戳) */
+static volatile uint8_t g_pacer_sensor_pending = (FRAME_PACER_FPS > 0); /* 1:尚未测得传感器帧率, 待测得后降频 */
+
+
+/**
+ * @brief       按目标帧率(含余量)降低传感器帧率
+ * @param       fps : 目标帧率, 0:恢复全速
+ * @retval      无
+ */
+static void frame_pacer_sensor(uint32_t fps)
+{
+#if FRAME_PACER_SENSOR_EN
+    esp_err_t err = sensor_fps_set((fps * (100 + FRAME_PACER_HEADROOM_PCT) + 99) / 100);
+
+    g_pacer_sensor_pending = (err == ESP_ERR_INVALID_STATE);
+
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE && err != ESP_ERR_NOT_SUPPORTED)
+    {
+        ESP_LOGW("TAG", "pacer: sensor fps %lu failed", (unsigned long)fps);
+    }
+#else
+    (void)fps;
+#endif
+}
+
+/**
+ * @brief       设置上传帧率上限
+ * @note        尚未测得传感器帧率时(未开始采集)先只限制上传, 测得后由发送线程降频一次
+ * @param       fps : 帧率上限, 0:不限制
+ * @retval      ESP_OK:成功; ESP_ERR_INVALID_ARG:超出范围
+ */
+esp_err_t frame_pacer_set_fps(uint32_t fps)
+{
+    if (fps > FRAME_PACER_FPS_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    g_pacer_fps = fps;
+    g_pacer_period_us = (fps > 0) ? 1000000 / fps : 0;
+    g_pacer_deadline_us = 0;                                        /* 下一帧立即放行, 之后按新周期计时 */
+    frame_pacer_sensor(fps);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       当前上传帧率上限
+ * @param       无
+ * @retval      帧率上限, 0:不限制
+ */
+uint32_t frame_pacer_get_fps(void)
+{
+    return g_pacer_fps;
+}
+
+/**
+ * @brief       本帧是否到达放行时间(发送线程调用)
+ * @note        同时以采集时间戳测量传感器帧间隔(sensor_fps_observe)
+ * @param       fb : 帧缓存
+ * @retval      1:上传; 0:跳过
+ */
+int frame_pacer_admit(const camera_fb_t *fb)
+{
+    int64_t t = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    int64_t period = g_pacer_period_us;
+    int64_t interval;
+
+    sensor_fps_observe(fb);
+    interval = sensor_fps_interval_us();
+
+    if (period == 0)
+    {
+        return 1;
+    }
+
+    if (g_pacer_sensor_pending && interval > 0)
+    {
+        frame_pacer_sensor(g_pacer_fps);                            /* 只执行一次, 之后的降频在设置时完成 */
+    }
+
+    if (t + interval / 2 < g_pacer_deadline_us)
+    {
+        return 0;                                                   /* 离截止时间还超过半个帧间隔 */
+    }
+
+    g_pacer_deadline_us = (t - g_pacer_deadline_us > period) ? t + period : g_pacer_deadline_us + period;
+
+    return 1;
+}
@@ -0,0 +1,46 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_pacer.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       上传帧率限制(按截止时间均匀放行), 可同时降低传感器帧率减少多余的采集
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 设定目标帧率后, 发送线程对每帧调用 frame_pacer_admit(): 以采集时间戳与下一个截止时间比较,
+ * 距截止时间不足半个传感器帧间隔的帧放行, 截止时间随之推进一个周期(落后超过一个周期时从当前帧重新计时),
+ * 其余帧不上传. 放行的帧间隔均匀, 不会因为传感器帧率与目标帧率不成整数倍而忽快忽慢.
+ * FRAME_PACER_SENSOR_EN 为1时, 同时经 sensor_fps_set() 把传感器降到不低于目标帧率 x (1 + FRAME_PACER_HEADROOM_PCT%)
+ * 的最慢档位, 多余的帧不再采集、压缩与搬运; 传感器降频会同时降低LCD取景、MJPEG与SD录像的帧率,
+ * 取消限制(fps为0)时恢复全速.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __FRAME_PACER_H
+#define __FRAME_PACER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+
+#define FRAME_PACER_FPS             0                               /* 启动时的上传帧率上限, 0:不限制 */
+#define FRAME_PACER_FPS_MAX         120                             /* 可设置的帧率上限 */
+#define FRAME_PACER_SENSOR_EN       1                               /* 1:限制帧率时同时降低传感器帧率(sensor_fps) */
+#define FRAME_PACER_HEADROOM_PCT    25                              /* 降频后传感器帧率至少高出目标帧率的余量(%) */
+
+/* 函数声明 */
+esp_err_t frame_pacer_set_fps(uint32_t fps);                        /* 设置上传帧率上限, 0:不限制 */
+uint32_t frame_pacer_get_fps(void);                                 /* 当前上传帧率上限 */
+int frame_pacer_admit(const camera_fb_t *fb);                       /* 本帧是否到达放行时间(发送线程调用) */
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_pool.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       按尺寸分级的JPEG帧拷贝缓冲池(固定容量, PSRAM)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "frame_pool.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "heap_stats.h"
+
+
+/* 一个尺寸级 */
+typedef struct
+{
+    size_t slot_size;                                               /* 槽位大小 */
+    uint32_t slots;                                                 /* 槽位数 */
+    uint8_t *base;                                                  /* 第一个槽位 */
+    uint32_t used;                                                  /* 占用位图 */
+} frame_pool_class_t;
+
+static frame_pool_class_t g_pool_classes[FRAME_POOL_CLASS_NUM] = FRAME_POOL_CLASSES;
+static uint8_t *g_pool_arena = NULL;                                /* 整个池(PSRAM) */
+static SemaphoreHandle_t g_pool_lock = NULL;
+
+
+/**
+ * @brief       申请整个池
+ * @param       无
+ * @retval      ESP_OK:成功(或已申请); ESP_ERR_NO_MEM:内存不足
+ */
+esp_err_t frame_pool_init(void)
+{
+#if FRAME_POOL_EN
+    size_t total = 0;
+    uint8_t *p;
+
+    if (g_pool_arena != NULL)
+    {
+        return ESP_OK;
+    }
+
+    for (int i = 0; i < FRAME_POOL_CLASS_NUM; i++)
+    {
+        total += g_pool_classes[i].slot_size * g_pool_classes[i].slots;
+    }
+
+    g_pool_lock = xSemaphoreCreateMutex();
+    g_pool_arena = heap_stats_malloc(HEAP_TAG_FRAME_POOL, total, MALLOC_CAP_SPIRAM);
+
+    if (g_pool_lock == NULL || g_pool_arena == NULL)
+    {
+        ESP_LOGE("TAG", "frame pool: no memory for %u bytes", (unsigned int)total);
+        heap_stats_free(HEAP_TAG_FRAME_POOL, g_pool_arena);
+        g_pool_arena = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    p = g_pool_arena;
+
+    for (int i = 0; i < FRAME_POOL_CLASS_NUM; i++)
+    {
+        g_pool_classes[i].base = p;
+        p += g_pool_classes[i].slot_size * g_pool_classes[i].slots;
+    }
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief       取一个能容纳len字节的最小空闲槽位
+ * @param       len : 需要的字节数
+ * @retval      槽位地址, NULL:超过单帧上限或无空闲槽位
+ */
+void *frame_pool_alloc(size_t len)
+{
+#if FRAME_POOL_EN
+    void *ptr = NULL;
+
+    if (g_pool_arena == NULL)
+    {
+        return NULL;
+    }
+
+    xSemaphoreTake(g_pool_lock, portMAX_DELAY);
+
+    for (int i = 0; i < FRAME_POOL_CLASS_NUM && ptr == NULL; i++)
+    {
+        frame_pool_class_t *c = &g_pool_classes[i];
+
+        if (c->slot_size < len)
+        {
+            continue;
+        }
+
+        for (uint32_t n = 0; n < c->slots; n++)
+        {
+            if (!(c->used & (1UL << n)))
+            {
+                c->used |= 1UL << n;
+                ptr = c->base + c->slot_size * n;
+                break;
+            }
+        }
+    }
+
+    xSemaphoreGive(g_pool_lock);
+
+    return ptr;
+#else
+    (void)len;
+    return NULL;
+#endif
+}
+
+/**
+ * @brief       归还槽位
+ * @param       ptr : frame_pool_alloc 返回的地址, NULL时无操作
+ * @retval      无
+ */
+void frame_pool_free(void *ptr)
+{
+    uint8_t *p = (uint8_t *)ptr;
+
+    if (p == NULL || g_pool_arena == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_pool_lock, portMAX_DELAY);
+
+    for (int i = 0; i < FRAME_POOL_CLASS_NUM; i++)
+    {
+        frame_pool_class_t *c = &g_pool_classes[i];
+
+        if (p >= c->base && p < c->base + c->slot_size * c->slots)
+        {
+            c->used &= ~(1UL << ((p - c->base) / c->slot_size));
+            break;
+        }
+    }
+
+    xSemaphoreGive(g_pool_lock);
+}
+
+/**
+ * @brief       单帧上限
+ * @param       无
+ * @retval      最大一级的槽位大小
+ */
+size_t frame_pool_max(void)
+{
+    return g_pool_classes[FRAME_POOL_CLASS_NUM - 1].slot_size;
+}
@@ -0,0 +1,48 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_pool.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       按尺寸分级的JPEG帧拷贝缓冲池(固定容量, PSRAM)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * JPEG帧通常只有驱动帧缓存(宽x高/5)的5%~20%. 驱动自己的分级池(CONFIG_CAMERA_FB_POOL)只覆盖排队与
+ * esp_camera_fb_get 持有的帧; 应用需要在驱动之外长期保存较多帧时(连拍等), 把帧拷贝到本池中按帧长选取的
+ * 最小尺寸级槽位, 同样的PSRAM可以保存数倍的帧, 并尽早归还驱动帧缓存.
+ * frame_pool_init() 一次性从PSRAM申请整个池(各级合计约1.1MB), 之后的分配与释放只操作各级的空闲位图,
+ * 不经过堆分配器, 不产生碎片; 某一级用完时借用更大一级的槽位, 都用完时分配失败.
+ * SD卡事件录像的环形缓冲按字节预算紧密存放各帧, 不使用本池.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __FRAME_POOL_H
+#define __FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+
+#define FRAME_POOL_EN               1                               /* 1:使能帧缓冲池 */
+
+/* 尺寸级: 槽位大小 x 槽位数(由小到大, 每级最多32个槽位) */
+#define FRAME_POOL_CLASSES          { {8 * 1024, 16}, {16 * 1024, 16}, {32 * 1024, 8}, {64 * 1024, 4}, {128 * 1024, 2} }
+#define FRAME_POOL_CLASS_NUM        5
+
+/* 函数声明 */
+esp_err_t frame_pool_init(void);                                    /* 申请整个池(重复调用无操作) */
+void *frame_pool_alloc(size_t len);                                 /* 取一个能容纳len字节的最小槽位, NULL:无空闲槽位 */
+void frame_pool_free(void *ptr);                                    /* 归还槽位(NULL时无操作) */
+size_t frame_pool_max(void);                                        /* 单帧上限(最大一级的槽位大小) */
+
+#endif
@@ -0,0 +1,280 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_proto.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       摄像头TCP上行帧协议定义
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 每一帧数据 = frame_header_t(小端) + payload_len 字节的图像数据
+ * 接收端按帧头读取固定长度即可，无需再搜索 JPEG 的 SOI/EOI 标记
+ * 音频帧(FRAME_FLAG_AUDIO)与图像帧复用同一连接, 两者的 timestamp_us 都来自 esp_timer, 接收端可直接对齐音画;
+ * 校时后(clock_sync.h)所有帧头的 timestamp_us 在发送时换算为公共时间(Unix时间, us), 多台摄像头之间也可对齐
+ *
+ * 图像帧可带传感器寄存器采样(曝光/增益/白平衡, 驱动 esp_camera_fb_get_meta): 帧头为 frame_header_meta_t,
+ * ext_flags 置 FRAME_EXT_META; 寄存器由驱动每隔几帧在消隐期异步读取, age 为采样后经过的帧数
+ *
+ * 边采集边发送的图像帧(lwip_demo LWIP_CUT_THROUGH_EN): 帧头为 frame_header_jpeg_t, ext_flags 置 FRAME_EXT_CHUNKED,
+ * payload_len 为0(发送帧头时长度未知); 帧头之后为若干分段, 每段 = uint32 长度(小端) + 数据, 长度为0的分段结束本帧,
+ * 长度为 FRAME_CHUNK_ABORT 时本帧作废(采集出错), 已收到的分段丢弃
+ *
+ * 下行控制命令(服务器 -> 设备)为定长 ctrl_cmd_t(16字节, 小端), 与文本命令("stats"等)共用同一连接,
+ * 以 CTRL_PROTO_MAGIC 区分; 设备执行后回复一个 FRAME_FLAG_CTRL 帧, 负载为 ctrl_ack_t
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __FRAME_PROTO_H
+#define __FRAME_PROTO_H
+
+#include <stdint.h>
+#include "esp_camera.h"
+
+
+#define FRAME_PROTO_MAGIC           0x46414D43u                     /* 'CAMF' (小端) */
+#define FRAME_PROTO_VERSION         1                               /* 协议版本号 */
+
+/* 帧标志位 */
+#define FRAME_FLAG_KEY              0x01                            /* 完整的独立帧, 未置位的JPEG帧省略了表头(jpeg_abbrev) */
+#define FRAME_FLAG_STATS            0x02                            /* 负载为时延统计文本(UTF-8), 不是图像 */
+#define FRAME_FLAG_AUDIO            0x04                            /* 负载为16位小端PCM, width为采样率, height为声道数 */
+#define FRAME_FLAG_SPOOL            0x08                            /* 断线期间缓存、重连后回填的历史帧(seq/timestamp_us为原采集值) */
+#define FRAME_FLAG_MOTION           0x10                            /* 采集时处于移动状态(motion_detect), 未置位的帧为无移动期间的低帧率画面 */
+#define FRAME_FLAG_CTRL             0x20                            /* 负载为控制命令应答 ctrl_ack_t, 不是图像 */
+#define FRAME_FLAG_PREVIEW          0x40                            /* 由高分辨率帧缩小转码的子码流(dual_stream), width/height为缩小后尺寸 */
+#define FRAME_FLAG_BURST            0x80                            /* 连拍帧(burst_capture), seq为批内序号, 整批拍完后依次发送 */
+
+#define CTRL_PROTO_MAGIC            0x434D4143u                     /* 'CAMC' (小端) */
+
+/* 控制命令 */
+#define CTRL_CMD_SET_FRAMESIZE      0x01                            /* arg: framesize_t, 分辨率上限(不超过启动配置) */
+#define CTRL_CMD_SET_QUALITY        0x02                            /* arg: JPEG质量上限(数值越小质量越高) */
+#define CTRL_CMD_SET_FPS_CAP        0x03                            /* arg: 上传帧率上限(均匀放行, 同时降低传感器帧率), 0:不限制 */
+#define CTRL_CMD_SNAPSHOT           0x04                            /* 立即上传下一帧(不受暂停/帧率/移动侦测限制) */
+#define CTRL_CMD_START              0x05                            /* 恢复上传 */
+#define CTRL_CMD_STOP               0x06                            /* 暂停上传(保持连接, 本地录像与MJPEG不受影响) */
+#define CTRL_CMD_STATS              0x07                            /* 回复时延统计(FRAME_FLAG_STATS帧) */
+#define CTRL_CMD_WIFI_PROFILE       0x08                            /* arg: wifi_profile_t */
+#define CTRL_CMD_CLIP               0x09                            /* 触发一次SD卡事件录像 */
+#define CTRL_CMD_REPLAY             0x0A                            /* arg: 采集时间(us), 重新回填该时间之后的缓存帧 */
+#define CTRL_CMD_SET_ROI            0x0B                            /* arg: bit0~15 x, 16~31 y, 32~47 w, 48~63 h(全视场的千分比), 全视场即取消 */
+#define CTRL_CMD_BURST              0x0C                            /* arg: 帧数, 锁定曝光以最高分辨率连拍, 以 FRAME_FLAG_BURST 帧发送 */
+#define CTRL_CMD_JPEG_ABBREV        0x0D                            /* arg: 1:图像帧使用 frame_header_jpeg_t, 表头不变时省略; 0:关闭 */
+#define CTRL_CMD_JPEG_TILES         0x0E                            /* arg: 1:静态场景只发送变化的分块(jpg_tiles); 0:关闭 */
+#define CTRL_CMD_DETECT             0x0F                            /* arg: 1:上传人脸检测元数据; 2:同时只在有人时上传图像; 0:关闭 */
+#define CTRL_CMD_CLOCK_PING         0x10                            /* arg: 服务器发送时间(us), 应答负载为 ctrl_clock_ack_t */
+#define CTRL_CMD_CLOCK_SET          0x11                            /* arg: 时钟偏移(us), 公共时间 = esp_timer时间 + arg */
+#define CTRL_CMD_CAPTURE_AT         0x12                            /* arg: 公共时间(us), 上传采集时间最接近该时刻的一帧(不受暂停限制), -1:取消 */
+#define CTRL_CMD_STATIC_SKIP        0x13                            /* arg: 静止画面两次上传图像的最长间隔(ms), 其间以 FRAME_PIXFORMAT_UNCHANGED 代替; 0:关闭 */
+
+/* frame_header_jpeg_t.ext_flags */
+#define FRAME_EXT_META              0x01                            /* 扩展帧头之后附 frame_meta_t(帧头为 frame_header_meta_t) */
+#define FRAME_EXT_CHUNKED           0x02                            /* payload_len 为0, 负载以分段发送(见文件头说明) */
+#define FRAME_CHUNK_ABORT           0xFFFFFFFFu                     /* 分段长度: 本帧作废 */
+#define FRAME_META_REGS_MAX         12                              /* 与驱动 CAMERA_FB_META_REGS_MAX 相同 */
+
+/* 开启 CTRL_CMD_JPEG_TILES 后的增量帧: pixformat 为该值, 负载为 jpg_tiles_delta_t(完整帧仍为带DRI的JPEG并置 FRAME_FLAG_KEY) */
+#define FRAME_PIXFORMAT_JPEG_TILES  0x80
+/* 开启 CTRL_CMD_DETECT 后的元数据帧: pixformat 为该值, 负载为 frame_detect_t(count 个框), width/height 为被检测帧的宽高 */
+#define FRAME_PIXFORMAT_DETECT      0x81
+#define FRAME_DETECT_BOX_MAX        4                               /* 每帧元数据的框数上限 */
+/* 开启 CTRL_CMD_STATIC_SKIP 后与上一次上传的图像几乎相同(jpg_sig)的帧: pixformat 为该值, 负载为空, 占用图像帧序号,
+ * timestamp_us/width/height 为本帧的值, 接收端沿用上一帧图像 */
+#define FRAME_PIXFORMAT_UNCHANGED   0x82
+
+/* 控制命令应答状态 */
+#define CTRL_STATUS_OK              0
+#define CTRL_STATUS_INVALID_ARG     -1                              /* 参数超出范围 */
+#define CTRL_STATUS_UNSUPPORTED     -2                              /* 未知命令或当前配置不支持 */
+#define CTRL_STATUS_FAILED          -3                              /* 执行失败 */
+
+/* 帧头(所有字段均为小端) */
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;                 /* 固定为 FRAME_PROTO_MAGIC */
+    uint8_t  version;               /* 协议版本 */
+    uint8_t  header_len;            /* 帧头长度, 便于后续扩展字段 */
+    uint8_t  pixformat;             /* pixformat_t */
+    uint8_t  flags;                 /* FRAME_FLAG_xxx */
+    uint32_t seq;                   /* 帧序号, 每帧递增 */
+    uint64_t timestamp_us;          /* 采集时间戳(us), 来自 fb->timestamp */
+    uint16_t width;                 /* 图像宽度 */
+    uint16_t height;                /* 图像高度 */
+    uint32_t payload_len;           /* 图像数据长度 */
+} frame_header_t;
+
+/* 开启 CTRL_CMD_JPEG_ABBREV 后JPEG图像帧的帧头(header_len 为本结构的长度) */
+typedef struct __attribute__((packed))
+{
+    frame_header_t base;
+    uint8_t  table_id;              /* 表头编号: 完整帧定义该编号的表头, 省略表头的帧引用该编号 */
+    uint8_t  ext_flags;             /* FRAME_EXT_xxx */
+    uint8_t  reserved[2];
+} frame_header_jpeg_t;
+
+/* 传感器寄存器采样(寄存器地址格式与 sensor_t::get_reg 相同) */
+typedef struct __attribute__((packed))
+{
+    uint16_t sensor_pid;            /* 传感器型号(OV2640_PID等), 接收端据此解释寄存器 */
+    uint8_t  count;                 /* 有效寄存器数 */
+    uint8_t  age;                   /* 采样后经过的帧数, 1:紧邻本帧之前的消隐期读取 */
+    uint16_t reg[FRAME_META_REGS_MAX];
+    uint8_t  value[FRAME_META_REGS_MAX];
+} frame_meta_t;
+
+/* 带寄存器采样的图像帧头(header_len 为本结构的长度) */
+typedef struct __attribute__((packed))
+{
+    frame_header_jpeg_t jpeg;       /* 未开启 CTRL_CMD_JPEG_ABBREV 时 table_id 为0, 帧均为完整帧 */
+    frame_meta_t meta;
+} frame_header_meta_t;
+
+/* 检测框(像素坐标) */
+typedef struct __attribute__((packed))
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+    uint8_t  score;                 /* 得分(%) */
+    uint8_t  reserved;
+} frame_detect_box_t;
+
+/* 元数据帧的负载(只发送前 count 个框) */
+typedef struct __attribute__((packed))
+{
+    uint8_t  count;                 /* 框数, 0:未检测到 */
+    uint8_t  reserved[3];
+    frame_detect_box_t box[FRAME_DETECT_BOX_MAX];
+} frame_detect_t;
+
+/* 控制命令(服务器 -> 设备, 所有字段均为小端) */
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;                 /* 固定为 CTRL_PROTO_MAGIC */
+    uint8_t  cmd;                   /* CTRL_CMD_xxx */
+    uint8_t  seq;                   /* 命令序号, 原样回送 */
+    uint16_t reserved;
+    int64_t  arg;                   /* 命令参数 */
+} ctrl_cmd_t;
+
+/* 控制命令应答(FRAME_FLAG_CTRL帧的负载) */
+typedef struct __attribute__((packed))
+{
+    uint8_t  cmd;                   /* 对应的命令 */
+    uint8_t  seq;                   /* 对应的命令序号 */
+    int8_t   status;                /* CTRL_STATUS_xxx */
+    uint8_t  reserved;
+} ctrl_ack_t;
+
+/* CTRL_CMD_CLOCK_PING 的应答负载 */
+typedef struct __attribute__((packed))
+{
+    ctrl_ack_t ack;
+    int64_t  t1_us;                 /* 原样回送的服务器发送时间 */
+    int64_t  device_us;             /* 设备发出应答时的 esp_timer 时间(未换算) */
+} ctrl_clock_ack_t;
+
+/**
+ * @brief       根据帧缓存填充帧头
+ * @param       hdr : 帧头
+ * @param       fb  : 摄像头帧缓存
+ * @param       seq : 帧序号
+ * @retval      无
+ */
+static inline void frame_header_fill(frame_header_t *hdr, const camera_fb_t *fb, uint32_t seq)
+{
+    hdr->magic        = FRAME_PROTO_MAGIC;
+    hdr->version      = FRAME_PROTO_VERSION;
+    hdr->header_len   = sizeof(frame_header_t);
+    hdr->pixformat    = (uint8_t)fb->format;
+    hdr->flags        = FRAME_FLAG_KEY;
+    hdr->seq          = seq;
+    hdr->timestamp_us = (uint64_t)fb->timestamp.tv_sec * 1000000ULL + fb->timestamp.tv_usec;
+    hdr->width        = (uint16_t)fb->width;
+    hdr->height       = (uint16_t)fb->height;
+    hdr->payload_len  = (uint32_t)fb->len;
+}
+
+/**
+ * @brief       填充统计文本帧的帧头(不占用图像帧序号)
+ * @param       hdr          : 帧头
+ * @param       len          : 文本长度
+ * @param       seq          : 当前帧序号
+ * @param       timestamp_us : 时间戳(us)
+ * @retval      无
+ */
+static inline void frame_header_fill_stats(frame_header_t *hdr, uint32_t len, uint32_t seq, uint64_t timestamp_us)
+{
+    hdr->magic        = FRAME_PROTO_MAGIC;
+    hdr->version      = FRAME_PROTO_VERSION;
+    hdr->header_len   = sizeof(frame_header_t);
+    hdr->pixformat    = 0;
+    hdr->flags        = FRAME_FLAG_STATS;
+    hdr->seq          = seq;
+    hdr->timestamp_us = timestamp_us;
+    hdr->width        = 0;
+    hdr->height       = 0;
+    hdr->payload_len  = len;
+}
+
+/**
+ * @brief       填充检测元数据帧的帧头(不占用图像帧序号)
+ * @param       hdr          : 帧头
+ * @param       len          : 负载长度
+ * @param       seq          : 检测序号
+ * @param       timestamp_us : 被检测帧的采集时间(us)
+ * @param       width        : 被检测帧的宽度
+ * @param       height       : 被检测帧的高度
+ * @retval      无
+ */
+static inline void frame_header_fill_detect(frame_header_t *hdr, uint32_t len, uint32_t seq, uint64_t timestamp_us,
+                                            uint16_t width, uint16_t height)
+{
+    hdr->magic        = FRAME_PROTO_MAGIC;
+    hdr->version      = FRAME_PROTO_VERSION;
+    hdr->header_len   = sizeof(frame_header_t);
+    hdr->pixformat    = FRAME_PIXFORMAT_DETECT;
+    hdr->flags        = 0;
+    hdr->seq          = seq;
+    hdr->timestamp_us = timestamp_us;
+    hdr->width        = width;
+    hdr->height       = height;
+    hdr->payload_len  = len;
+}
+
+/**
+ * @brief       填充音频帧的帧头(音频有独立的序号)
+ * @param       hdr          : 帧头
+ * @param       len          : PCM数据长度
+ * @param       seq          : 音频帧序号
+ * @param       timestamp_us : 第一个采样点的时间戳(us, esp_timer)
+ * @param       sample_rate  : 采样率
+ * @param       channels     : 声道数
+ * @retval      无
+ */
+static inline void frame_header_fill_audio(frame_header_t *hdr, uint32_t len, uint32_t seq, uint64_t timestamp_us,
+                                           uint16_t sample_rate, uint8_t channels)
+{
+    hdr->magic        = FRAME_PROTO_MAGIC;
+    hdr->version      = FRAME_PROTO_VERSION;
+    hdr->header_len   = sizeof(frame_header_t);
+    hdr->pixformat    = 0;
+    hdr->flags        = FRAME_FLAG_AUDIO;
+    hdr->seq          = seq;
+    hdr->timestamp_us = timestamp_us;
+    hdr->width        = sample_rate;
+    hdr->height       = channels;
+    hdr->payload_len  = len;
+}
+
+#endif
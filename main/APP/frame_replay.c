@@ -0,0 +1,368 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_replay.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       录像重放: 把SD卡上的MJPEG录像或Flash断线缓存中的帧代替传感器注入摄像头驱动, 使测量可重复
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "frame_replay.h"
+#include "task_topo.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_camera.h"
+#include "heap_stats.h"
+#include "frame_spool.h"
+
+
+#if FRAME_REPLAY_EN
+/* 预载帧的索引项 */
+typedef struct
+{
+    uint32_t offset;                                                /* 在预载缓冲中的位置 */
+    uint32_t len;
+    int64_t at_us;                                                  /* 相对第一帧的原始时间 */
+} frame_replay_item_t;
+
+static uint8_t *g_replay_data = NULL;                               /* 预载缓冲(PSRAM) */
+static size_t g_replay_size = 0;                                    /* 预载缓冲大小 */
+static size_t g_replay_used = 0;
+static frame_replay_item_t *g_replay_items = NULL;
+static uint32_t g_replay_count = 0;
+static uint16_t g_replay_width = 0;                                 /* 录像分辨率 */
+static uint16_t g_replay_height = 0;
+static uint32_t g_replay_skipped = 0;                               /* 预载时跳过的帧(超出预算或分辨率不同) */
+
+
+/**
+ * @brief       读取小端32位数
+ */
+static uint32_t frame_replay_get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief       分配预载缓冲与索引表
+ * @param       size : 预载缓冲大小(不超过 FRAME_REPLAY_PRELOAD_MAX)
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:内存不足
+ */
+static esp_err_t frame_replay_alloc(size_t size)
+{
+    g_replay_size = (size < FRAME_REPLAY_PRELOAD_MAX) ? size : FRAME_REPLAY_PRELOAD_MAX;
+    g_replay_data = heap_stats_malloc(HEAP_TAG_REPLAY, g_replay_size, MALLOC_CAP_SPIRAM);
+    g_replay_items = heap_stats_malloc(HEAP_TAG_REPLAY, FRAME_REPLAY_FRAMES_MAX * sizeof(frame_replay_item_t), MALLOC_CAP_SPIRAM);
+
+    if (g_replay_data == NULL || g_replay_items == NULL)
+    {
+        ESP_LOGE("replay", "no memory for %u bytes of frames", (unsigned)g_replay_size);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       登记一帧(数据已在 g_replay_data + g_replay_used)
+ * @param       len   : 帧长
+ * @param       at_us : 相对第一帧的原始时间
+ * @retval      无
+ */
+static void frame_replay_add(uint32_t len, int64_t at_us)
+{
+    frame_replay_item_t *item = &g_replay_items[g_replay_count++];
+
+    item->offset = (uint32_t)g_replay_used;
+    item->len = len;
+    item->at_us = at_us;
+    g_replay_used += len;
+}
+
+#if FRAME_REPLAY_SOURCE == FRAME_REPLAY_SRC_SD
+/**
+ * @brief       预载SD卡上的AVI录像
+ * @note        RIFF 块逐个扫描: LIST 只跳过列表类型后进入其中, avih 取帧间隔与分辨率, '00dc' 为帧, idx1 处结束
+ * @param       无
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+static esp_err_t frame_replay_load(void)
+{
+    uint8_t hdr[56];
+    uint32_t us_per_frame = 33333;
+    uint32_t size;
+    struct stat st;
+    esp_err_t err;
+    FILE *f;
+
+    for (int i = 0; stat(FRAME_REPLAY_FILE, &st) != 0; i++)         /* SD卡由 sd_recorder_init 挂载 */
+    {
+        if (i >= FRAME_REPLAY_WAIT_SEC)
+        {
+            ESP_LOGE("replay", "%s not found", FRAME_REPLAY_FILE);
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+
+    f = fopen(FRAME_REPLAY_FILE, "rb");
+
+    if (f == NULL || fread(hdr, 1, 12, f) != 12 || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "AVI ", 4) != 0)
+    {
+        ESP_LOGE("replay", "%s is not an AVI file", FRAME_REPLAY_FILE);
+
+        if (f != NULL)
+        {
+            fclose(f);
+        }
+
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    err = frame_replay_alloc((size_t)st.st_size);
+
+    while (err == ESP_OK && fread(hdr, 1, 8, f) == 8)
+    {
+        size = frame_replay_get32(hdr + 4);
+
+        if (memcmp(hdr, "LIST", 4) == 0)
+        {
+            fseek(f, 4, SEEK_CUR);                                  /* 进入列表(hdrl/strl/movi) */
+            continue;
+        }
+
+        if (memcmp(hdr, "idx1", 4) == 0)
+        {
+            break;
+        }
+
+        if (memcmp(hdr, "avih", 4) == 0 && size >= sizeof(hdr) && fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr))
+        {
+            us_per_frame = frame_replay_get32(hdr) ? frame_replay_get32(hdr) : us_per_frame;
+            g_replay_width = (uint16_t)frame_replay_get32(hdr + 32);
+            g_replay_height = (uint16_t)frame_replay_get32(hdr + 36);
+            fseek(f, (long)(size - sizeof(hdr) + (size & 1)), SEEK_CUR);
+            continue;
+        }
+
+        if (hdr[2] == 'd' && hdr[3] == 'c' && g_replay_count < FRAME_REPLAY_FRAMES_MAX &&
+            g_replay_used + size <= g_replay_size)
+        {
+            if (fread(g_replay_data + g_replay_used, 1, size, f) != size)
+            {
+                break;                                              /* 录像未正常关闭, 最后一帧不完整 */
+            }
+
+            frame_replay_add(size, (int64_t)g_replay_count * us_per_frame);
+            fseek(f, (long)(size & 1), SEEK_CUR);
+            continue;
+        }
+
+        g_replay_skipped += (hdr[2] == 'd' && hdr[3] == 'c');
+        fseek(f, (long)(size + (size & 1)), SEEK_CUR);              /* 音频块与其他块 */
+    }
+
+    fclose(f);
+    return err;
+}
+#else
+/**
+ * @brief       预载Flash断线缓存中的全部记录
+ * @param       无
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+static esp_err_t frame_replay_load(void)
+{
+    frame_header_t hdr;
+    uint64_t first_us = 0;
+    uint16_t count;
+    esp_err_t err;
+
+    for (int i = 0; (count = frame_spool_count()) == 0; i++)        /* 日志由 frame_spool_init 恢复 */
+    {
+        if (i >= FRAME_REPLAY_WAIT_SEC)
+        {
+            ESP_LOGE("replay", "frame spool is empty");
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+
+    err = frame_replay_alloc((size_t)count * FRAME_SPOOL_FRAME_MAX);
+
+    for (uint16_t i = 0; err == ESP_OK && i < count && g_replay_count < FRAME_REPLAY_FRAMES_MAX; i++)
+    {
+        size_t room = g_replay_size - g_replay_used;
+
+        if (frame_spool_read(i, &hdr, g_replay_data + g_replay_used, room) != ESP_OK ||
+            (g_replay_count > 0 && (hdr.width != g_replay_width || hdr.height != g_replay_height)))
+        {
+            g_replay_skipped++;
+            continue;
+        }
+
+        if (g_replay_count == 0)
+        {
+            first_us = hdr.timestamp_us;
+            g_replay_width = hdr.width;
+            g_replay_height = hdr.height;
+        }
+
+        frame_replay_add(hdr.payload_len, (int64_t)(hdr.timestamp_us - first_us));
+    }
+
+    return err;
+}
+#endif
+
+/**
+ * @brief       把传感器分辨率设为录像的分辨率(驱动按当前分辨率填写 fb->width/height)
+ * @param       无
+ * @retval      无
+ */
+static void frame_replay_framesize(void)
+{
+    sensor_t *s = esp_camera_sensor_get();
+
+    for (int fs = 0; fs < FRAMESIZE_INVALID; fs++)
+    {
+        if (resolution[fs].width == g_replay_width && resolution[fs].height == g_replay_height)
+        {
+            if (s != NULL && s->status.framesize != (framesize_t)fs)
+            {
+                esp_camera_sensor_lock();
+                s->set_framesize(s, (framesize_t)fs);
+                esp_camera_sensor_unlock();
+            }
+
+            return;
+        }
+    }
+
+    ESP_LOGW("replay", "%ux%u is not a sensor frame size, fb->width/height stay at the sensor's",
+             (unsigned)g_replay_width, (unsigned)g_replay_height);
+}
+
+/**
+ * @brief       重放一遍
+ * @param       pass : 遍数(从1开始)
+ * @retval      无
+ */
+static void frame_replay_pass(uint32_t pass)
+{
+    int64_t start = esp_timer_get_time();
+    int64_t lag_max = 0;
+    int64_t now;
+    uint32_t sent = 0;
+    uint32_t failed = 0;
+
+    for (uint32_t i = 0; i < g_replay_count; i++)
+    {
+        const frame_replay_item_t *item = &g_replay_items[i];
+
+#if FRAME_REPLAY_REALTIME
+        int64_t due = start + item->at_us;
+
+        now = esp_timer_get_time();
+
+        if (due > now + 1000)
+        {
+            vTaskDelay(pdMS_TO_TICKS((due - now) / 1000));
+        }
+#endif
+
+        if (esp_camera_fb_inject(g_replay_data + item->offset, item->len, FRAME_REPLAY_INJECT_MS) == ESP_OK)
+        {
+            sent++;
+        }
+        else
+        {
+            failed++;                                               /* 帧大于驱动帧缓存, 或使用者长时间未归还 */
+        }
+
+#if FRAME_REPLAY_REALTIME
+        now = esp_timer_get_time();
+        lag_max = (now - due > lag_max) ? (now - due) : lag_max;
+#endif
+    }
+
+    now = esp_timer_get_time();
+    ESP_LOGI("replay", "pass %lu: %lu frames in %lld ms, %.2f fps, max lag %lld ms, %lu failed",
+             (unsigned long)pass, (unsigned long)sent, (long long)((now - start) / 1000),
+             (now > start) ? sent * 1e6f / (float)(now - start) : 0.0f, (long long)(lag_max / 1000),
+             (unsigned long)failed);
+}
+
+/**
+ * @brief       重放线程: 预载录像, 停止采集后逐帧注入驱动
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void frame_replay_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+
+    if (frame_replay_load() != ESP_OK || g_replay_count == 0)
+    {
+        ESP_LOGE("replay", "nothing to replay, live capture continues");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    ESP_LOGI("replay", "%lu frames (%ux%u, %u KB, %lld ms), %lu skipped, %s",
+             (unsigned long)g_replay_count, (unsigned)g_replay_width, (unsigned)g_replay_height,
+             (unsigned)(g_replay_used / 1024), (long long)(g_replay_items[g_replay_count - 1].at_us / 1000),
+             (unsigned long)g_replay_skipped, FRAME_REPLAY_REALTIME ? "real time" : "as fast as possible");
+
+    esp_camera_suspend();
+    frame_replay_framesize();
+
+    for (uint32_t pass = 1; FRAME_REPLAY_LOOPS == 0 || pass <= FRAME_REPLAY_LOOPS; pass++)
+    {
+        frame_replay_pass(pass);
+    }
+
+    esp_camera_resume();
+    ESP_LOGI("replay", "done, live capture resumed");
+    vTaskDelete(NULL);
+}
+#endif
+
+/**
+ * @brief       启动重放线程
+ * @note        在推流初始化之前调用即可: 线程先等待SD卡挂载或断线缓存恢复, 预载完成后才停止采集
+ * @param       无
+ * @retval      ESP_OK:成功; 其他:未使能或创建线程失败
+ */
+esp_err_t frame_replay_start(void)
+{
+#if FRAME_REPLAY_EN
+    if (xTaskCreatePinnedToCore(frame_replay_thread, "frame_replay_thread", FRAME_REPLAY_THREAD_STACK, NULL,
+                                FRAME_REPLAY_THREAD_PRIO, NULL, FRAME_REPLAY_THREAD_CORE) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
@@ -0,0 +1,63 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_replay.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       录像重放: 把SD卡上的MJPEG录像或Flash断线缓存中的帧代替传感器注入摄像头驱动, 使测量可重复
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 重放固件: idf.py -B build_replay -D REPLAY_BUILD=1 build.
+ * 启动后重放线程等待数据源就绪(SD卡由 sd_recorder_init 挂载, 断线缓存由 frame_spool_init 恢复), 把整段录像预载到
+ * PSRAM(之后不再读卡/Flash, 重放时序不受存储延时影响), 然后以 esp_camera_suspend() 停止采集, 逐帧调用
+ * esp_camera_fb_inject() 把帧拷贝进驱动的空闲帧缓存并排入帧队列. 此后 esp_camera_fb_get/acquire/return、
+ * 帧时间戳与驱动阶段计时都与真实采集相同, 推流、取景、移动侦测、人脸检测、双码流转码、MJPEG服务与录像不需任何改动,
+ * 同一段录像每次运行得到相同的输入.
+ * 数据源:
+ *     FRAME_REPLAY_SRC_SD     FRAME_REPLAY_FILE, sd_recorder 录制的AVI(把要重放的 RECnnnnn.AVI 复制为该文件名);
+ *                             逐块扫描 RIFF, 取 '00dc' 帧, 帧间隔为 avih 的 dwMicroSecPerFrame
+ *     FRAME_REPLAY_SRC_SPOOL  vfs分区的断线缓存, 从旧到新全部记录, 帧间隔为帧头中的原始采集时间差
+ * FRAME_REPLAY_REALTIME 为1时按原始帧间隔注入(使用者跟不上时注入等待空闲帧缓存, 记为落后); 为0时尽快注入,
+ * 速度只受使用者归还帧缓存的快慢限制, 用于测量处理能力. 每遍输出一行: 帧数、耗时、帧率、最大落后与注入失败数.
+ * 传感器分辨率设为录像的分辨率(fb->width/height 由驱动按当前分辨率填写); 大于驱动帧缓存或分辨率不同的帧被跳过.
+ * 重放期间不缓存断线帧(保留Flash中的录像); CAMERA_GRAB_NEWEST 模式下未及时取走的帧仍会被较新的帧替换.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __FRAME_REPLAY_H
+#define __FRAME_REPLAY_H
+
+#include "esp_err.h"
+#include "sd_recorder.h"
+
+
+#ifndef FRAME_REPLAY_EN
+#define FRAME_REPLAY_EN             0                               /* 1:重放固件(CMake -D REPLAY_BUILD=1 时置1) */
+#endif
+
+/* 数据源 */
+#define FRAME_REPLAY_SRC_SD         0                               /* SD卡上的MJPEG/AVI录像 */
+#define FRAME_REPLAY_SRC_SPOOL      1                               /* vfs分区的断线帧缓存 */
+
+#define FRAME_REPLAY_SOURCE         FRAME_REPLAY_SRC_SD             /* 数据源 */
+#define FRAME_REPLAY_FILE           SD_RECORD_MOUNT "/REPLAY.AVI"   /* FRAME_REPLAY_SRC_SD 的录像文件 */
+#define FRAME_REPLAY_REALTIME       1                               /* 1:按原始帧间隔; 0:尽快(受使用者归还帧缓存限制) */
+#define FRAME_REPLAY_LOOPS          0                               /* 重放遍数, 0:不停循环; 结束后恢复真实采集 */
+#define FRAME_REPLAY_PRELOAD_MAX    (4 * 1024 * 1024)               /* 预载到PSRAM的字节上限, 之后的帧不重放 */
+#define FRAME_REPLAY_FRAMES_MAX     4096                            /* 预载帧数上限(索引表大小) */
+#define FRAME_REPLAY_WAIT_SEC       15                              /* 等待SD卡挂载或断线缓存恢复的时间 */
+#define FRAME_REPLAY_INJECT_MS      2000                            /* 等待空闲帧缓存的超时 */
+
+/* 函数声明 */
+esp_err_t frame_replay_start(void);                                 /* 启动重放线程(摄像头已初始化) */
+
+#endif
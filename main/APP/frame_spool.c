@@ -0,0 +1,600 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_spool.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       断线期间的Flash帧缓存(存储转发, 原始分区上的循环日志)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "frame_spool.h"
+#include "task_topo.h"
+#include <string.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "heap_stats.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+
+#define FRAME_SPOOL_MAGIC           0x524C5053u                     /* 'SPLR' (小端) */
+#define FRAME_SPOOL_SECTOR          4096                            /* 记录按扇区对齐 */
+#define FRAME_SPOOL_SECTORS_PER_BLOCK (FRAME_SPOOL_ERASE_BLOCK / FRAME_SPOOL_SECTOR)
+
+/* 记录头, 位于记录首扇区开头, 其后紧跟图像数据 */
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;                                                 /* FRAME_SPOOL_MAGIC */
+    uint32_t log_seq;                                               /* 日志序号, 每条记录递增, 上电恢复时确定新旧 */
+    uint16_t sectors;                                               /* 记录占用的扇区数 */
+    uint16_t reserved;
+    uint32_t crc;                                                   /* frame 与图像数据的CRC32 */
+    uint32_t sent;                                                  /* 0xFFFFFFFF:未回填; 0:已回填(只把位写0, 无需擦除) */
+    frame_header_t frame;                                           /* 网络帧头(已置 FRAME_FLAG_SPOOL) */
+} frame_spool_record_t;
+
+/* 内存索引项(8字节), 按日志顺序(从旧到新)存放于环形数组 */
+typedef struct
+{
+    uint32_t timestamp_ms;                                          /* 采集时间(ms), 同一次上电内单调递增 */
+    uint16_t sector;                                                /* 记录首扇区 */
+    uint16_t sectors;
+} frame_spool_index_t;
+
+/* 上电恢复时的扫描结果 */
+typedef struct
+{
+    uint32_t log_seq;
+    uint8_t sent;
+    frame_spool_index_t index;
+} frame_spool_scan_t;
+
+static const esp_partition_t *g_spool_part = NULL;
+static uint16_t g_spool_total = 0;                                  /* 分区扇区数 */
+static frame_spool_index_t *g_spool_index = NULL;                   /* 索引(PSRAM), g_spool_total 项 */
+static uint16_t g_spool_first = 0;                                  /* 最旧记录在索引中的位置 */
+static uint16_t g_spool_count = 0;                                  /* 记录数 */
+static uint16_t g_spool_cursor = 0;                                 /* 下一条待回填记录(相对 g_spool_first 的序号) */
+static uint16_t g_spool_head = 0;                                   /* 下一条记录的首扇区 */
+static uint16_t g_spool_erased = 0;                                 /* [g_spool_head, g_spool_erased) 已擦除 */
+static uint32_t g_spool_log_seq = 0;
+static frame_spool_send_t g_spool_send = NULL;
+static SemaphoreHandle_t g_spool_staged = NULL;                     /* 暂存缓冲中有待写入的帧 */
+static uint8_t *g_spool_stage = NULL;                               /* 暂存缓冲(PSRAM): 发送线程 -> 写入线程 */
+static frame_header_t g_spool_stage_hdr;
+static volatile uint8_t g_spool_busy = 0;                           /* 1:暂存缓冲正在使用 */
+static int64_t g_spool_last_us = 0;                                 /* 上一次缓存的时间 */
+static uint8_t *g_spool_read_buf = NULL;                            /* 回填读缓冲(PSRAM) */
+static volatile int64_t g_spool_replay_us = -1;                     /* 待处理的重放请求(采集时间), -1:无 */
+static uint32_t g_spool_written = 0;                                /* 统计: 缓存帧数 */
+static uint32_t g_spool_sent = 0;                                   /* 统计: 回填帧数 */
+static uint32_t g_spool_lost = 0;                                   /* 统计: 未回填即被覆盖的帧数 */
+
+
+/**
+ * @brief       索引项(按日志顺序的第i条)
+ */
+static frame_spool_index_t *frame_spool_at(uint16_t i)
+{
+    return &g_spool_index[(g_spool_first + i) % g_spool_total];
+}
+
+/**
+ * @brief       记录占用的扇区数
+ */
+static uint16_t frame_spool_sectors(uint32_t payload_len)
+{
+    return (uint16_t)((sizeof(frame_spool_record_t) + payload_len + FRAME_SPOOL_SECTOR - 1) / FRAME_SPOOL_SECTOR);
+}
+
+/**
+ * @brief       记录CRC
+ */
+static uint32_t frame_spool_crc(const frame_header_t *frame, const uint8_t *data)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)frame, sizeof(*frame));
+
+    return esp_rom_crc32_le(crc, data, frame->payload_len);
+}
+
+/**
+ * @brief       丢弃最旧的记录(所在块即将被擦除)
+ * @param       无
+ * @retval      无
+ */
+static void frame_spool_drop_oldest(void)
+{
+    if (g_spool_cursor > 0)
+    {
+        g_spool_cursor--;
+    }
+    else
+    {
+        g_spool_lost++;                                             /* 断线时间超出分区容量: 最旧的帧未回填即被覆盖 */
+    }
+
+    g_spool_first = (g_spool_first + 1) % g_spool_total;
+    g_spool_count--;
+}
+
+/**
+ * @brief       保证 [g_spool_head, g_spool_head + sectors) 已擦除, 按擦除块向前推进
+ * @note        被擦除块内的旧记录一定是最旧的若干条, 先从索引中移除.
+ *              上电恢复后擦除位置可能不在块边界上, 先只擦到下一个块边界(分区大小是块的整数倍, 不会越过分区末尾)
+ * @param       sectors : 需要的扇区数
+ * @retval      ESP_OK:成功; 其他:擦除失败
+ */
+static esp_err_t frame_spool_erase_ahead(uint16_t sectors)
+{
+    esp_err_t err;
+    uint16_t start;
+    uint16_t end;
+
+    while (g_spool_erased < g_spool_head + sectors)
+    {
+        start = g_spool_erased;
+        end = (start / FRAME_SPOOL_SECTORS_PER_BLOCK + 1) * FRAME_SPOOL_SECTORS_PER_BLOCK;
+
+        if (end > g_spool_total)
+        {
+            end = g_spool_total;
+        }
+
+        while (g_spool_count > 0)
+        {
+            frame_spool_index_t *old = frame_spool_at(0);
+
+            if (old->sector + old->sectors <= start || old->sector >= end)
+            {
+                break;
+            }
+
+            frame_spool_drop_oldest();
+        }
+
+        err = esp_partition_erase_range(g_spool_part, (size_t)start * FRAME_SPOOL_SECTOR, (size_t)(end - start) * FRAME_SPOOL_SECTOR);
+
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+
+        g_spool_erased = end;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       把暂存缓冲中的帧追加为一条日志记录
+ * @param       无
+ * @retval      无
+ */
+static void frame_spool_append(void)
+{
+    frame_spool_record_t rec;
+    uint16_t sectors = frame_spool_sectors(g_spool_stage_hdr.payload_len);
+    frame_spool_index_t *idx;
+    size_t addr;
+    esp_err_t err;
+
+    if (g_spool_head + sectors > g_spool_total)                     /* 分区末尾放不下: 回到开头 */
+    {
+        /* 写入位置之后残留的上一轮记录是最旧的, 回绕后不再连续, 直接丢弃 */
+        while (g_spool_count > 0 && frame_spool_at(0)->sector >= g_spool_head)
+        {
+            frame_spool_drop_oldest();
+        }
+
+        g_spool_head = 0;
+        g_spool_erased = 0;
+    }
+
+    if (g_spool_count == g_spool_total)
+    {
+        frame_spool_drop_oldest();
+    }
+
+    err = frame_spool_erase_ahead(sectors);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE("TAG", "spool erase at sector %u failed: %s", (unsigned)g_spool_erased, esp_err_to_name(err));
+        g_spool_busy = 0;
+        return;
+    }
+
+    memset(&rec, 0xFF, sizeof(rec));
+    rec.magic = FRAME_SPOOL_MAGIC;
+    rec.log_seq = g_spool_log_seq++;
+    rec.sectors = sectors;
+    rec.frame = g_spool_stage_hdr;
+    rec.crc = frame_spool_crc(&rec.frame, g_spool_stage);
+
+    /* 先写数据后写头: 写入中途断电时头不完整或CRC不符, 恢复扫描会跳过 */
+    addr = (size_t)g_spool_head * FRAME_SPOOL_SECTOR;
+
+    if (esp_partition_write(g_spool_part, addr + sizeof(rec), g_spool_stage, rec.frame.payload_len) == ESP_OK &&
+        esp_partition_write(g_spool_part, addr, &rec, sizeof(rec)) == ESP_OK)
+    {
+        idx = frame_spool_at(g_spool_count);
+        idx->timestamp_ms = (uint32_t)(rec.frame.timestamp_us / 1000);
+        idx->sector = g_spool_head;
+        idx->sectors = sectors;
+        g_spool_count++;
+        g_spool_written++;
+    }
+
+    g_spool_head += sectors;
+    g_spool_busy = 0;
+}
+
+/**
+ * @brief       上电恢复: 逐扇区扫描记录头, 校验CRC, 按日志序号重建索引与写入位置
+ * @note        合法记录在分区内按扇区顺序排列, 日志序号只在写入位置处回绕; 从最新记录之后开始
+ *              按扇区顺序遍历即为从旧到新, 序号不递增的记录(更早一轮未擦除的残留)丢弃.
+ *              第一条未回填的记录之后的记录都视为未回填
+ * @param       无
+ * @retval      无
+ */
+static void frame_spool_recover(void)
+{
+    frame_spool_record_t rec;
+    frame_spool_scan_t *scan;
+    uint16_t found = 0;
+    uint16_t newest = 0;
+    uint16_t sector = 0;
+    uint32_t last_seq = 0;
+    uint8_t cursor_set = 0;
+
+    scan = heap_stats_malloc(HEAP_TAG_FRAME_SPOOL, g_spool_total * sizeof(frame_spool_scan_t), MALLOC_CAP_SPIRAM);
+
+    if (scan == NULL)
+    {
+        return;
+    }
+
+    while (sector < g_spool_total)
+    {
+        if (esp_partition_read(g_spool_part, (size_t)sector * FRAME_SPOOL_SECTOR, &rec, sizeof(rec)) != ESP_OK ||
+            rec.magic != FRAME_SPOOL_MAGIC || rec.frame.payload_len > FRAME_SPOOL_FRAME_MAX ||
+            rec.sectors != frame_spool_sectors(rec.frame.payload_len) || sector + rec.sectors > g_spool_total ||
+            esp_partition_read(g_spool_part, (size_t)sector * FRAME_SPOOL_SECTOR + sizeof(rec),
+                               g_spool_read_buf, rec.frame.payload_len) != ESP_OK ||
+            frame_spool_crc(&rec.frame, g_spool_read_buf) != rec.crc)
+        {
+            sector++;                                               /* 不是记录头(数据扇区/已擦除/写入中断电) */
+            continue;
+        }
+
+        scan[found].log_seq = rec.log_seq;
+        scan[found].sent = (rec.sent != 0xFFFFFFFF);
+        scan[found].index.timestamp_ms = (uint32_t)(rec.frame.timestamp_us / 1000);
+        scan[found].index.sector = sector;
+        scan[found].index.sectors = rec.sectors;
+
+        if (found == 0 || rec.log_seq >= scan[newest].log_seq)
+        {
+            newest = found;
+        }
+
+        found++;
+        sector += rec.sectors;
+    }
+
+    if (found > 0)
+    {
+        g_spool_head = scan[newest].index.sector + scan[newest].index.sectors;
+        g_spool_erased = g_spool_head;                              /* 写入位置之后不保证已擦除 */
+        g_spool_log_seq = scan[newest].log_seq + 1;
+    }
+
+    for (uint16_t i = 0; i < found; i++)
+    {
+        frame_spool_scan_t *entry = &scan[(newest + 1 + i) % found];
+
+        if (g_spool_count > 0 && entry->log_seq <= last_seq)
+        {
+            continue;
+        }
+
+        last_seq = entry->log_seq;
+
+        if (!entry->sent && !cursor_set)
+        {
+            g_spool_cursor = g_spool_count;
+            cursor_set = 1;
+        }
+
+        *frame_spool_at(g_spool_count++) = entry->index;
+    }
+
+    if (!cursor_set)
+    {
+        g_spool_cursor = g_spool_count;
+    }
+
+    heap_stats_free(HEAP_TAG_FRAME_SPOOL, scan);
+}
+
+/**
+ * @brief       按采集时间查找记录(二分查找, 要求索引中时间单调, 即同一次上电内的记录)
+ * @param       timestamp_ms : 采集时间(ms)
+ * @retval      第一条不早于该时间的记录序号(相对最旧记录), 都更早时返回记录数
+ */
+static uint16_t frame_spool_lookup(uint32_t timestamp_ms)
+{
+    uint16_t lo = 0;
+    uint16_t hi = g_spool_count;
+    uint16_t mid;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+
+        if (frame_spool_at(mid)->timestamp_ms < timestamp_ms)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * @brief       回填一帧(游标处的记录)
+ * @param       无
+ * @retval      距下一次回填的等待时间(ms)
+ */
+static uint32_t frame_spool_backfill(void)
+{
+    frame_spool_record_t rec;
+    frame_spool_index_t *idx;
+    size_t addr;
+    uint32_t sent = 0;
+
+    if (g_spool_cursor >= g_spool_count)
+    {
+        return FRAME_SPOOL_RETRY_MS;                                /* 没有待回填的记录 */
+    }
+
+    idx = frame_spool_at(g_spool_cursor);
+    addr = (size_t)idx->sector * FRAME_SPOOL_SECTOR;
+
+    if (esp_partition_read(g_spool_part, addr, &rec, sizeof(rec)) != ESP_OK ||
+        rec.magic != FRAME_SPOOL_MAGIC || rec.frame.payload_len > FRAME_SPOOL_FRAME_MAX ||
+        esp_partition_read(g_spool_part, addr + sizeof(rec), g_spool_read_buf, rec.frame.payload_len) != ESP_OK)
+    {
+        g_spool_cursor++;                                           /* 记录损坏: 跳过 */
+        return FRAME_SPOOL_BACKFILL_MS;
+    }
+
+    if (g_spool_send(&rec.frame, g_spool_read_buf, rec.frame.payload_len) != 0)
+    {
+        return FRAME_SPOOL_RETRY_MS;                                /* 未连接或链路拥塞, 稍后重试 */
+    }
+
+    if (rec.sent == 0xFFFFFFFF)                                     /* 只把位写0, 重启后不再回填 */
+    {
+        esp_partition_write(g_spool_part, addr + offsetof(frame_spool_record_t, sent), &sent, sizeof(sent));
+    }
+
+    g_spool_cursor++;
+    g_spool_sent++;
+
+    if (g_spool_cursor == g_spool_count)
+    {
+        ESP_LOGI("TAG", "spool drained, %u backfilled, %u lost", (unsigned)g_spool_sent, (unsigned)g_spool_lost);
+    }
+
+    return FRAME_SPOOL_BACKFILL_MS;
+}
+
+/**
+ * @brief       写入/回填线程: 有暂存帧时写入Flash, 空闲时回填
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void frame_spool_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    uint32_t wait = 0;
+    int64_t replay;
+
+    while (1)
+    {
+        if (xSemaphoreTake(g_spool_staged, pdMS_TO_TICKS(wait)) == pdTRUE)
+        {
+            frame_spool_append();
+            continue;
+        }
+
+        replay = g_spool_replay_us;
+
+        if (replay >= 0)
+        {
+            g_spool_replay_us = -1;
+            g_spool_cursor = frame_spool_lookup((uint32_t)(replay / 1000));
+            ESP_LOGI("TAG", "spool replay from %lld us, %u frames", (long long)replay,
+                     (unsigned)(g_spool_count - g_spool_cursor));
+        }
+
+        wait = frame_spool_backfill();
+    }
+}
+
+/**
+ * @brief       找到vfs分区, 恢复日志并启动写入/回填线程
+ * @param       send : 回填发送回调
+ * @retval      ESP_OK:成功; 其他:失败(不缓存)
+ */
+esp_err_t frame_spool_init(frame_spool_send_t send)
+{
+#if FRAME_SPOOL_EN
+    static StaticSemaphore_t staged_buf;
+    static StackType_t stack[FRAME_SPOOL_THREAD_STACK];            /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+
+    g_spool_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FRAME_SPOOL_PARTITION);
+
+    if (g_spool_part == NULL)
+    {
+        ESP_LOGW("TAG", "spool partition not found");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    /* 按擦除块取整, 保证块擦除不越界 */
+    g_spool_total = (uint16_t)(g_spool_part->size / FRAME_SPOOL_ERASE_BLOCK * FRAME_SPOOL_SECTORS_PER_BLOCK);
+    g_spool_index = heap_stats_malloc(HEAP_TAG_FRAME_SPOOL, g_spool_total * sizeof(frame_spool_index_t), MALLOC_CAP_SPIRAM);
+    g_spool_stage = heap_stats_malloc(HEAP_TAG_FRAME_SPOOL, FRAME_SPOOL_FRAME_MAX, MALLOC_CAP_SPIRAM);
+    g_spool_read_buf = heap_stats_malloc(HEAP_TAG_FRAME_SPOOL, FRAME_SPOOL_FRAME_MAX, MALLOC_CAP_SPIRAM);
+
+    if (g_spool_total == 0 || g_spool_index == NULL || g_spool_stage == NULL || g_spool_read_buf == NULL)
+    {
+        ESP_LOGE("TAG", "Memory for frame spool is not enough");
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_spool_staged = xSemaphoreCreateBinaryStatic(&staged_buf);
+    g_spool_send = send;
+    frame_spool_recover();
+
+    ESP_LOGI("TAG", "spool: %u records, %u to backfill", (unsigned)g_spool_count,
+             (unsigned)(g_spool_count - g_spool_cursor));
+
+    xTaskCreateStaticPinnedToCore(frame_spool_thread, "frame_spool_thread", FRAME_SPOOL_THREAD_STACK, NULL,
+                                  FRAME_SPOOL_THREAD_PRIO, stack, &tcb, FRAME_SPOOL_THREAD_CORE);
+#else
+    (void)send;
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief       断线期间提交一帧(发送线程调用, 不阻塞)
+ * @note        未到缓存间隔、上一帧仍在写Flash或帧过大时忽略; 否则拷贝到暂存缓冲, 调用返回后帧缓存即可归还
+ * @param       fb  : 帧缓存
+ * @param       seq : 帧序号(与实时帧连续, 接收端据此把回填帧放回原位置)
+ * @retval      无
+ */
+void frame_spool_offer(const camera_fb_t *fb, uint32_t seq)
+{
+#if FRAME_SPOOL_EN
+    int64_t now = esp_timer_get_time();
+
+    if (g_spool_staged == NULL || g_spool_busy || fb->format != PIXFORMAT_JPEG || fb->len > FRAME_SPOOL_FRAME_MAX ||
+        now - g_spool_last_us < (int64_t)FRAME_SPOOL_INTERVAL_MS * 1000)
+    {
+        return;
+    }
+
+    g_spool_busy = 1;
+    g_spool_last_us = now;
+
+    frame_header_fill(&g_spool_stage_hdr, fb, seq);
+    g_spool_stage_hdr.flags |= FRAME_FLAG_SPOOL;
+    memcpy(g_spool_stage, fb->buf, fb->len);
+
+    xSemaphoreGive(g_spool_staged);
+#else
+    (void)fb;
+    (void)seq;
+#endif
+}
+
+/**
+ * @brief       从指定采集时间开始重新回填(服务器"replay"命令, 不阻塞)
+ * @note        已回填的记录保留到被覆盖为止, 可按时间重新取回; 由写入/回填线程二分查找定位
+ * @param       timestamp_us : 采集时间(设备 esp_timer 时钟, 与帧头 timestamp_us 相同)
+ * @retval      无
+ */
+void frame_spool_replay(int64_t timestamp_us)
+{
+#if FRAME_SPOOL_EN
+    g_spool_replay_us = (timestamp_us < 0) ? 0 : timestamp_us;
+#else
+    (void)timestamp_us;
+#endif
+}
+
+/**
+ * @brief       日志中的记录数(含已回填的记录)
+ * @param       无
+ * @retval      记录数
+ */
+uint16_t frame_spool_count(void)
+{
+#if FRAME_SPOOL_EN
+    return g_spool_count;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief       读取一条记录(帧重放等离线使用; 与写入线程没有互斥, 调用期间不应有新帧缓存)
+ * @param       i    : 记录序号, 0 为最旧的记录
+ * @param       hdr  : 输出帧头(采集时间、分辨率与图像长度)
+ * @param       buf  : 图像数据输出缓冲
+ * @param       size : 缓冲大小
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_FOUND:序号越界; ESP_ERR_INVALID_SIZE:缓冲不够; ESP_ERR_INVALID_CRC:记录损坏
+ */
+esp_err_t frame_spool_read(uint16_t i, frame_header_t *hdr, void *buf, size_t size)
+{
+#if FRAME_SPOOL_EN
+    frame_spool_record_t rec;
+    size_t addr;
+
+    if (i >= g_spool_count)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    addr = (size_t)frame_spool_at(i)->sector * FRAME_SPOOL_SECTOR;
+
+    if (esp_partition_read(g_spool_part, addr, &rec, sizeof(rec)) != ESP_OK || rec.magic != FRAME_SPOOL_MAGIC)
+    {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    if (rec.frame.payload_len > size)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (esp_partition_read(g_spool_part, addr + sizeof(rec), buf, rec.frame.payload_len) != ESP_OK ||
+        frame_spool_crc(&rec.frame, buf) != rec.crc)
+    {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    *hdr = rec.frame;
+    return ESP_OK;
+#else
+    (void)i;
+    (void)hdr;
+    (void)buf;
+    (void)size;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
@@ -0,0 +1,60 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_spool.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       断线期间的Flash帧缓存(存储转发, 原始分区上的循环日志)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 直接以 esp_partition_read/write 使用分区表中的 vfs 分区(不挂载FAT, 没有目录与FAT表的元数据更新).
+ * 与服务器的TCP连接中断期间, 发送线程通过 frame_spool_offer() 每隔 FRAME_SPOOL_INTERVAL_MS 提交一帧,
+ * 帧拷贝到PSRAM暂存缓冲后立即返回(写Flash期间提交的帧被忽略), 由低优先级线程追加为一条日志记录:
+ * 记录从4KB扇区边界开始, 记录头(魔数、日志序号、扇区数、CRC32、回填标记) + frame_header_t + 图像数据.
+ * 整个分区是一个循环日志, 写入位置前方按 FRAME_SPOOL_ERASE_BLOCK 块擦除, 被擦除块中的最旧记录随之丢弃;
+ * 顺序写入使擦写均匀分布在整个分区, 不需要磨损均衡层, 写入速度接近Flash原始写速度.
+ * 内存中只保存每条记录8字节的索引(采集时间ms、首扇区、扇区数), 按采集时间二分查找;
+ * 上电时逐扇区扫描记录头并校验CRC, 按日志序号恢复索引、写入位置与回填游标(写入中断电的记录被跳过).
+ * 重新连接后同一线程从游标处回填, 每帧经发送回调发出; 回调在未连接或链路拥塞时返回失败,
+ * 回填暂停, 保证实时帧优先. 已回填的记录只清除回填标记位(无需擦除), 保留到被覆盖为止,
+ * 服务器可用 frame_spool_replay() 按采集时间重新取回.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __FRAME_SPOOL_H
+#define __FRAME_SPOOL_H
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "frame_proto.h"
+
+
+#define FRAME_SPOOL_EN              1                               /* 1:使能断线帧缓存 */
+#define FRAME_SPOOL_PARTITION       "vfs"                           /* 分区名(partitions-16MiB.csv) */
+#define FRAME_SPOOL_INTERVAL_MS     500                             /* 断线期间的缓存间隔, 限制Flash写入量与擦写次数 */
+#define FRAME_SPOOL_FRAME_MAX       (96 * 1024)                     /* 可缓存的单帧上限(暂存缓冲大小) */
+#define FRAME_SPOOL_ERASE_BLOCK     (64 * 1024)                     /* 写入位置前方的擦除单位(Flash块擦除) */
+#define FRAME_SPOOL_BACKFILL_MS     50                              /* 回填相邻两帧的最小间隔 */
+#define FRAME_SPOOL_RETRY_MS        1000                            /* 回填被拒绝(未连接/拥塞)后的重试间隔 */
+
+/* 回填发送回调, 返回0:已发送; -1:未连接或链路拥塞(稍后重试) */
+typedef int (*frame_spool_send_t)(const frame_header_t *hdr, const void *data, size_t len);
+
+/* 函数声明 */
+esp_err_t frame_spool_init(frame_spool_send_t send);                /* 恢复vfs分区上的日志并启动写入/回填线程 */
+void frame_spool_offer(const camera_fb_t *fb, uint32_t seq);        /* 断线期间提交一帧(不阻塞) */
+void frame_spool_replay(int64_t timestamp_us);                      /* 从指定采集时间开始重新回填(不阻塞) */
+uint16_t frame_spool_count(void);                                   /* 日志中的记录数 */
+esp_err_t frame_spool_read(uint16_t i, frame_header_t *hdr, void *buf, size_t size);   /* 读取第i条记录(从旧到新) */
+
+#endif
@@ -0,0 +1,348 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_stats.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       帧时延分段统计(VSYNC -> 发送 -> 确认归还)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "frame_stats.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+
+
+#define FRAME_STATS_SLOTS           8                               /* 同时在途的帧数上限(>= fb_count) */
+
+/* 一个统计窗口 */
+typedef struct
+{
+    int64_t start_us;                                               /* 窗口起始时间 */
+    int64_t end_us;                                                 /* 窗口结束时间(0:未结束) */
+    uint32_t frames;                                                /* 计入的帧数 */
+    uint32_t count[FRAME_STAGE_NUM];
+    uint64_t sum_us[FRAME_STAGE_NUM];
+    uint32_t max_us[FRAME_STAGE_NUM];
+    uint16_t hist[FRAME_STAGE_NUM][FRAME_STATS_BUCKETS];
+} frame_stats_window_t;
+
+/* 在途帧的应用侧时间戳 */
+typedef struct
+{
+    const camera_fb_t *fb;
+    int64_t first_us;
+    int64_t last_us;
+} frame_stats_slot_t;
+
+static const char *g_stage_name[FRAME_STAGE_NUM] = {
+    "sensor", "dma", "fbq", "eoi", "appq", "tx", "ack", "total"
+};
+
+static frame_stats_window_t g_stats_ring[FRAME_STATS_RING];
+static volatile uint32_t g_stats_head = 0;                          /* 当前写入的窗口序号(单调递增) */
+static frame_stats_slot_t g_stats_slot[FRAME_STATS_SLOTS];
+
+
+/**
+ * @brief       查找帧对应的在途记录
+ * @param       fb     : 帧缓存
+ * @param       create : 不存在时是否新建
+ * @retval      记录指针, 未找到返回NULL
+ */
+static frame_stats_slot_t *frame_stats_slot(const camera_fb_t *fb, int create)
+{
+    frame_stats_slot_t *empty = NULL;
+
+    for (int i = 0; i < FRAME_STATS_SLOTS; i++)
+    {
+        if (g_stats_slot[i].fb == fb)
+        {
+            return &g_stats_slot[i];
+        }
+
+        if (empty == NULL && g_stats_slot[i].fb == NULL)
+        {
+            empty = &g_stats_slot[i];
+        }
+    }
+
+    if (create && empty != NULL)
+    {
+        empty->fb = fb;
+        empty->first_us = 0;
+        empty->last_us = 0;
+    }
+
+    return create ? empty : NULL;
+}
+
+/**
+ * @brief       计入一个阶段的耗时
+ * @param       w     : 统计窗口
+ * @param       stage : 阶段
+ * @param       from  : 起始时间戳(0:未记录)
+ * @param       to    : 结束时间戳(0:未记录)
+ * @retval      无
+ */
+static void frame_stats_add(frame_stats_window_t *w, frame_stage_t stage, int64_t from, int64_t to)
+{
+    uint32_t us;
+    int bucket;
+
+    if (from == 0 || to == 0 || to < from)
+    {
+        return;
+    }
+
+    us = (uint32_t)(to - from);
+    bucket = (us == 0) ? 0 : (32 - __builtin_clz(us));
+    bucket = (bucket >= FRAME_STATS_BUCKETS) ? (FRAME_STATS_BUCKETS - 1) : bucket;
+
+    w->count[stage]++;
+    w->sum_us[stage] += us;
+    w->max_us[stage] = (us > w->max_us[stage]) ? us : w->max_us[stage];
+
+    if (w->hist[stage][bucket] < UINT16_MAX)
+    {
+        w->hist[stage][bucket]++;
+    }
+}
+
+/**
+ * @brief       由直方图估算百分位(返回所在桶的上界)
+ * @param       w     : 统计窗口
+ * @param       stage : 阶段
+ * @param       pct   : 百分位(1~100)
+ * @retval      耗时上界(us)
+ */
+static uint32_t frame_stats_percentile(const frame_stats_window_t *w, frame_stage_t stage, uint32_t pct)
+{
+    uint32_t target = (w->count[stage] * pct + 99) / 100;
+    uint32_t acc = 0;
+
+    for (int i = 0; i < FRAME_STATS_BUCKETS; i++)
+    {
+        acc += w->hist[stage][i];
+
+        if (acc >= target)
+        {
+            return (i == FRAME_STATS_BUCKETS - 1) ? w->max_us[stage] : (1u << i);
+        }
+    }
+
+    return w->max_us[stage];
+}
+
+/**
+ * @brief       把统计窗口格式化为文本
+ * @param       w    : 统计窗口
+ * @param       buf  : 输出缓冲区
+ * @param       size : 缓冲区大小
+ * @retval      写入的字节数(不含结束符)
+ */
+static int frame_stats_print_window(const frame_stats_window_t *w, char *buf, size_t size)
+{
+    int len;
+    int64_t span = w->end_us - w->start_us;
+    camera_stats_t cs;
+
+    len = snprintf(buf, size, "frames %lu in %lld ms\nstage       n     avg     p50     p99     max (us)\n",
+                   (unsigned long)w->frames, (long long)(span / 1000));
+
+    for (int i = 0; i < FRAME_STAGE_NUM && len > 0 && (size_t)len < size; i++)
+    {
+        uint32_t n = w->count[i];
+
+        len += snprintf(buf + len, size - len, "%-7s %6lu %7lu %7lu %7lu %7lu\n", g_stage_name[i],
+                        (unsigned long)n,
+                        (unsigned long)(n ? (w->sum_us[i] / n) : 0),
+                        (unsigned long)(n ? frame_stats_percentile(w, i, 50) : 0),
+                        (unsigned long)(n ? frame_stats_percentile(w, i, 99) : 0),
+                        (unsigned long)w->max_us[i]);
+    }
+
+    /* 驱动侧累计的采集异常计数 */
+    if (len > 0 && (size_t)len < size && esp_camera_get_stats(&cs) == ESP_OK)
+    {
+        len += snprintf(buf + len, size - len, "driver: frames %lu no_soi %lu no_eoi %lu fb_ovf %lu fbq_ovf %lu ev_ovf %lu superseded %lu dma_reset %lu dma_restart %lu q_backoff %lu q_offset +%lu\n",
+                        (unsigned long)cs.frames, (unsigned long)cs.no_soi, (unsigned long)cs.no_eoi,
+                        (unsigned long)cs.fb_overflow, (unsigned long)cs.fbq_overflow, (unsigned long)cs.event_overflow,
+                        (unsigned long)cs.superseded, (unsigned long)cs.dma_reset, (unsigned long)cs.dma_restart,
+                        (unsigned long)cs.quality_backoff, (unsigned long)cs.quality_offset);
+    }
+
+    return ((size_t)len < size) ? len : (int)size - 1;
+}
+
+/**
+ * @brief       当前窗口到期时切换到下一个窗口
+ * @param       now : 当前时间
+ * @retval      当前写入的窗口
+ */
+static frame_stats_window_t *frame_stats_window(int64_t now)
+{
+    uint32_t head = g_stats_head;
+    frame_stats_window_t *w = &g_stats_ring[head % FRAME_STATS_RING];
+
+    if (w->start_us == 0)
+    {
+        w->start_us = now;
+    }
+
+    if (now - w->start_us < (int64_t)FRAME_STATS_WINDOW_MS * 1000)
+    {
+        return w;
+    }
+
+    w->end_us = now;
+
+#if FRAME_STATS_PRINT_EN
+    {
+        static char text[640];
+
+        frame_stats_print_window(w, text, sizeof(text));
+        ESP_LOGI("TAG", "frame latency\n%s", text);
+    }
+#endif
+
+    /* 先清空下一个窗口, 再发布新的序号, 读取方只会看到已结束的窗口 */
+    w = &g_stats_ring[(head + 1) % FRAME_STATS_RING];
+    memset(w, 0, sizeof(*w));
+    w->start_us = now;
+    __atomic_store_n(&g_stats_head, head + 1, __ATOMIC_RELEASE);
+
+    return w;
+}
+
+/**
+ * @brief       记录一帧的发送起止时间(发送线程调用)
+ * @param       fb       : 帧缓存
+ * @param       first_us : 开始写入第一个字节的时间
+ * @param       last_us  : 最后一个字节写入协议栈的时间
+ * @retval      无
+ */
+void frame_stats_mark_tx(const camera_fb_t *fb, int64_t first_us, int64_t last_us)
+{
+#if FRAME_STATS_EN
+    frame_stats_slot_t *slot = frame_stats_slot(fb, 1);
+
+    if (slot != NULL)
+    {
+        slot->first_us = first_us;
+        slot->last_us = last_us;
+    }
+#else
+    (void)fb;
+    (void)first_us;
+    (void)last_us;
+#endif
+}
+
+/**
+ * @brief       帧归还时计入统计(发送线程调用, 须在 esp_camera_fb_return 之前)
+ * @param       fb   : 帧缓存
+ * @param       sent : 1:已发送; 0:被丢弃(只清除记录, 不计入统计)
+ * @retval      无
+ */
+void frame_stats_commit(const camera_fb_t *fb, int sent)
+{
+#if FRAME_STATS_EN
+    frame_stats_slot_t *slot = frame_stats_slot(fb, 0);
+    camera_fb_timing_t t;
+    frame_stats_window_t *w;
+    int64_t now;
+
+    if (slot == NULL)
+    {
+        return;
+    }
+
+    if (sent)
+    {
+        now = esp_timer_get_time();
+        w = frame_stats_window(now);
+
+        if (esp_camera_fb_get_timing(fb, &t) != ESP_OK)
+        {
+            memset(&t, 0, sizeof(t));                           /* 没有驱动时间戳(合成帧, 或未开启 CONFIG_CAMERA_FRAME_TIMING): 从 fb->timestamp 起算 */
+            t.vsync_us = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+            t.taken_us = t.vsync_us;
+        }
+
+        frame_stats_add(w, FRAME_STAGE_SENSOR, t.vsync_us, t.dma_eof_us);
+        frame_stats_add(w, FRAME_STAGE_DMA, t.dma_eof_us, t.queued_us);
+        frame_stats_add(w, FRAME_STAGE_FBQ, t.queued_us, t.dequeued_us);
+        frame_stats_add(w, FRAME_STAGE_EOI, t.dequeued_us, t.taken_us);
+        frame_stats_add(w, FRAME_STAGE_APPQ, t.taken_us, slot->first_us);
+        frame_stats_add(w, FRAME_STAGE_TX, slot->first_us, slot->last_us);
+        frame_stats_add(w, FRAME_STAGE_ACK, slot->last_us, now);
+        frame_stats_add(w, FRAME_STAGE_TOTAL, t.vsync_us, now);
+        w->frames++;
+    }
+
+    slot->fb = NULL;
+#else
+    (void)fb;
+    (void)sent;
+#endif
+}
+
+/**
+ * @brief       输出最近一个完整窗口的统计(可在任意线程调用)
+ * @param       buf  : 输出缓冲区
+ * @param       size : 缓冲区大小
+ * @retval      写入的字节数, 0:还没有完整的窗口
+ */
+int frame_stats_format(char *buf, size_t size)
+{
+    uint32_t head = __atomic_load_n(&g_stats_head, __ATOMIC_ACQUIRE);
+
+    if (head == 0 || size == 0)
+    {
+        return 0;
+    }
+
+    return frame_stats_print_window(&g_stats_ring[(head - 1) % FRAME_STATS_RING], buf, size);
+}
+
+/**
+ * @brief       读取最近一个完整窗口中某一阶段的p50/p99(可在任意线程调用)
+ * @param       stage : 阶段
+ * @param       p50   : 输出p50(us, 所在桶的上界)
+ * @param       p99   : 输出p99(us)
+ * @retval      true:成功; false:还没有完整的窗口或该阶段没有样本
+ */
+bool frame_stats_latency(frame_stage_t stage, uint32_t *p50, uint32_t *p99)
+{
+    uint32_t head = __atomic_load_n(&g_stats_head, __ATOMIC_ACQUIRE);
+    const frame_stats_window_t *w;
+
+    if (head == 0)
+    {
+        return false;
+    }
+
+    w = &g_stats_ring[(head - 1) % FRAME_STATS_RING];
+
+    if (w->count[stage] == 0)
+    {
+        return false;
+    }
+
+    *p50 = frame_stats_percentile(w, stage, 50);
+    *p99 = frame_stats_percentile(w, stage, 99);
+    return true;
+}
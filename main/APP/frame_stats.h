@@ -0,0 +1,60 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_stats.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       帧时延分段统计(VSYNC -> 发送 -> 确认归还)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 驱动侧时间戳来自 esp_camera_fb_get_timing()(需开启 CONFIG_CAMERA_FRAME_TIMING),
+ * 应用侧记录首/末字节写入时间和帧归还时间. 每帧各阶段耗时按 log2(us) 分桶计入直方图,
+ * 直方图按统计窗口组成环形缓冲: 只有发送线程写入, 读取方只读已结束的窗口, 无需加锁
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __FRAME_STATS_H
+#define __FRAME_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_camera.h"
+
+
+#define FRAME_STATS_EN              1                               /* 1:使能时延统计 */
+#define FRAME_STATS_WINDOW_MS       5000                            /* 统计窗口长度 */
+#define FRAME_STATS_RING            4                               /* 保留的窗口数 */
+#define FRAME_STATS_BUCKETS         20                              /* 直方图桶数, 第n桶为 [2^(n-1), 2^n) us */
+#define FRAME_STATS_PRINT_EN        1                               /* 每个窗口结束时打印统计结果 */
+
+/* 统计阶段 */
+typedef enum
+{
+    FRAME_STAGE_SENSOR = 0,                                         /* VSYNC -> 最后一次DMA EOF(传感器输出/DMA) */
+    FRAME_STAGE_DMA,                                                /* DMA EOF -> 放入帧队列(cam_task拷贝) */
+    FRAME_STAGE_FBQ,                                                /* 放入帧队列 -> 取出(驱动队列等待) */
+    FRAME_STAGE_EOI,                                                /* 取出 -> cam_take返回(JPEG EOI搜索) */
+    FRAME_STAGE_APPQ,                                               /* cam_take返回 -> 开始发送(应用排队) */
+    FRAME_STAGE_TX,                                                 /* 开始发送 -> 最后一字节写入协议栈 */
+    FRAME_STAGE_ACK,                                                /* 写入完成 -> 帧归还(零拷贝模式下为等待ACK) */
+    FRAME_STAGE_TOTAL,                                              /* VSYNC -> 帧归还 */
+    FRAME_STAGE_NUM
+} frame_stage_t;
+
+/* 函数声明 */
+void frame_stats_mark_tx(const camera_fb_t *fb, int64_t first_us, int64_t last_us);    /* 记录发送起止时间 */
+void frame_stats_commit(const camera_fb_t *fb, int sent);                              /* 帧归还时计入统计 */
+int frame_stats_format(char *buf, size_t size);                                        /* 输出最近一个完整窗口的统计 */
+bool frame_stats_latency(frame_stage_t stage, uint32_t *p50, uint32_t *p99);           /* 最近一个完整窗口某阶段的p50/p99 */
+
+#endif
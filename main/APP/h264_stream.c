@@ -0,0 +1,197 @@
+/**
+ ****************************************************************************************************
+ * @file        h264_stream.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       YUV422采集经 esp_h264 软件编码为H.264, 以RTP(RFC 6184)发送
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "h264_stream.h"
+#include "rtp_jpeg.h"
+#include "task_topo.h"
+#include "heap_stats.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#if H264_STREAM_EN
+#include "esp_h264_enc_single_sw.h"
+#include "esp_h264_enc_single.h"
+#endif
+
+
+#if H264_STREAM_EN
+/* 提交给编码线程的一帧 */
+typedef struct
+{
+    camera_fb_t *fb;
+    int sock;
+} h264_stream_item_t;
+
+static QueueHandle_t g_h264_queue = NULL;                           /* 发送线程 -> 编码线程, 长度1 */
+static esp_h264_enc_handle_t g_h264_enc = NULL;
+static uint8_t *g_h264_out = NULL;                                  /* 编码输出缓冲(PSRAM) */
+static uint32_t g_h264_bad_frames = 0;                              /* 编码失败的帧数 */
+
+
+/**
+ * @brief       编码线程函数
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void h264_stream_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    h264_stream_item_t item;
+    esp_h264_enc_in_frame_t in;
+    esp_h264_enc_out_frame_t out;
+    esp_h264_err_t err;
+    uint32_t ts;
+
+    while (1)
+    {
+        xQueueReceive(g_h264_queue, &item, portMAX_DELAY);
+
+        /* 90kHz时钟, 来自帧的采集时间 */
+        ts = (uint32_t)(((uint64_t)item.fb->timestamp.tv_sec * 1000000 + item.fb->timestamp.tv_usec) * 9 / 100);
+
+        memset(&in, 0, sizeof(in));
+        memset(&out, 0, sizeof(out));
+        in.raw_data.buffer = item.fb->buf;
+        in.raw_data.len = item.fb->len;
+        in.pts = ts;
+        out.raw_data.buffer = g_h264_out;
+        out.raw_data.len = H264_STREAM_OUT_MAX;
+
+        err = esp_h264_enc_process(g_h264_enc, &in, &out);
+        esp_camera_fb_return(item.fb);                              /* 已编码, 尽早归还帧缓存 */
+
+        if (err != ESP_H264_ERR_OK || out.length == 0)
+        {
+            if ((g_h264_bad_frames++ % 100) == 0)
+            {
+                ESP_LOGW("TAG", "h264 encode failed (%d)", (int)err);
+            }
+
+            continue;
+        }
+
+        rtp_h264_send_au(item.sock, g_h264_out, out.length, ts);    /* 中途失败时接收端丢弃该帧, 等待下一个IDR */
+    }
+}
+#endif
+
+/**
+ * @brief       创建编码器并启动编码线程
+ * @param       config : 摄像头配置(须为 PIXFORMAT_YUV422, 宽高为16的整数倍)
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_SUPPORTED:未使能或格式不支持; ESP_ERR_NO_MEM:内存不足; ESP_FAIL:编码器创建失败
+ */
+esp_err_t h264_stream_init(const camera_config_t *config)
+{
+#if H264_STREAM_EN
+    static StaticQueue_t queue_buf;
+    static uint8_t queue_storage[sizeof(h264_stream_item_t)];
+    static StackType_t stack[H264_STREAM_THREAD_STACK];            /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+    esp_h264_enc_cfg_sw_t cfg = { 0 };
+    uint16_t width = resolution[config->frame_size].width;
+    uint16_t height = resolution[config->frame_size].height;
+
+    if (config->pixel_format != PIXFORMAT_YUV422 || (width & 15) != 0 || (height & 15) != 0)
+    {
+        ESP_LOGW("TAG", "h264 stream needs YUV422 with 16-aligned size");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    cfg.pic_type = ESP_H264_RAW_FMT_YUYV;                           /* 直接读取摄像头的YUV422帧, 不做格式转换 */
+    cfg.gop = H264_STREAM_GOP;
+    cfg.fps = H264_STREAM_FPS;
+    cfg.res.width = width;
+    cfg.res.height = height;
+    cfg.rc.bitrate = H264_STREAM_BITRATE;
+    cfg.rc.qp_min = H264_STREAM_QP_MIN;
+    cfg.rc.qp_max = H264_STREAM_QP_MAX;
+
+    if (esp_h264_enc_sw_new(&cfg, &g_h264_enc) != ESP_H264_ERR_OK || esp_h264_enc_open(g_h264_enc) != ESP_H264_ERR_OK)
+    {
+        if (g_h264_enc != NULL)
+        {
+            esp_h264_enc_del(g_h264_enc);
+            g_h264_enc = NULL;
+        }
+
+        return ESP_FAIL;
+    }
+
+    g_h264_out = heap_stats_malloc(HEAP_TAG_H264, H264_STREAM_OUT_MAX, MALLOC_CAP_SPIRAM);
+
+    if (g_h264_out == NULL)
+    {
+        esp_h264_enc_close(g_h264_enc);
+        esp_h264_enc_del(g_h264_enc);
+        g_h264_enc = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_h264_queue = xQueueCreateStatic(1, sizeof(h264_stream_item_t), queue_storage, &queue_buf);
+    ESP_LOGI("TAG", "h264 stream %ux%u, gop %d, %d kbit/s", width, height, H264_STREAM_GOP, H264_STREAM_BITRATE / 1000);
+    xTaskCreateStaticPinnedToCore(h264_stream_thread, "h264_stream_thread", H264_STREAM_THREAD_STACK, NULL,
+                                  H264_STREAM_THREAD_PRIO, stack, &tcb, H264_STREAM_THREAD_CORE);
+    return ESP_OK;
+#else
+    (void)config;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       提交一帧编码发送(发送线程调用, 不阻塞)
+ * @note        编码线程忙时跳过本帧(编码器按采集时间戳计时, 跳帧不影响码率控制); 接收后增加帧的引用计数,
+ *              编码完成后由编码线程归还
+ * @param       fb   : 帧缓存
+ * @param       sock : rtp_jpeg_open 创建的套接字
+ * @retval      1:已接收或跳过(帧缓存仍归调用者); 0:未使能或不是YUV422帧, 调用者按原方式发送
+ */
+int h264_stream_offer(camera_fb_t *fb, int sock)
+{
+#if H264_STREAM_EN
+    h264_stream_item_t item;
+
+    if (g_h264_queue == NULL || fb->format != PIXFORMAT_YUV422)
+    {
+        return 0;
+    }
+
+    if (uxQueueSpacesAvailable(g_h264_queue) == 0 || esp_camera_fb_acquire(fb) == NULL)
+    {
+        return 1;
+    }
+
+    item.fb = fb;
+    item.sock = sock;
+
+    if (xQueueSend(g_h264_queue, &item, 0) != pdTRUE)
+    {
+        esp_camera_fb_return(fb);
+    }
+
+    return 1;
+#else
+    (void)fb;
+    (void)sock;
+    return 0;
+#endif
+}
@@ -0,0 +1,60 @@
+/**
+ ****************************************************************************************************
+ * @file        h264_stream.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       YUV422采集经 esp_h264 软件编码为H.264, 以RTP(RFC 6184)发送
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * MJPEG每帧独立编码, 静态场景下大部分码率是重复的画面; 按流量计费的链路可改用帧间编码.
+ * H264_STREAM_EN 为1时摄像头改为输出 PIXFORMAT_YUV422(YUYV, 见 main.c), LWIP_RTP_EN 模式的发送线程不再按
+ * RTP/JPEG 发送, 而是经 h264_stream_offer() 把帧交给编码线程(TASK_CORE_CAM, 增加帧的引用计数, 编码线程忙时跳过):
+ * esp_h264 软件编码器直接读取YUYV帧缓存, 按 H264_STREAM_GOP、H264_STREAM_BITRATE 编码, 编码完成即归还帧缓存,
+ * 输出的Annex-B码流按NAL单元经 rtp_h264_send_au() 发送(超过MTU的NAL按FU-A分片, 最后一个包置Marker位).
+ * 编码器每个IDR帧前输出SPS/PPS, 接收端随时加入, 最迟一个GOP后即可解码.
+ * 分辨率须为16的整数倍, 软件编码在ESP32-S3上宜用QVGA及以下. PIXFORMAT_JPEG 的各路径(MJPEG、录像、取景等)
+ * 都按帧格式判断, YUV帧直接跳过; H264_STREAM_EN 为0时摄像头仍输出JPEG, 本模块不参与.
+ * 依赖 espressif/esp_h264 组件(main/idf_component.yml).
+ *
+ * 接收示例:
+ *   gst-launch-1.0 udpsrc port=5004 caps="application/x-rtp,media=video,encoding-name=H264,clock-rate=90000,payload=96" ! rtph264depay ! avdec_h264 ! autovideosink
+ *   ffplay -protocol_whitelist file,udp,rtp camera.sdp    (m=video 5004 RTP/AVP 96, a=rtpmap:96 H264/90000)
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __H264_STREAM_H
+#define __H264_STREAM_H
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_camera.h"
+
+
+#if CONFIG_APP_H264_STREAM                                           /* menuconfig 中设置, 同时决定是否拉取 espressif/esp_h264 */
+#define H264_STREAM_EN              1                               /* 1:YUV422采集, H.264编码后以RTP发送(需 LWIP_RTP_EN) */
+#else
+#define H264_STREAM_EN              0
+#endif
+#define H264_STREAM_FPS             15                              /* 编码器码率控制假定的帧率 */
+#define H264_STREAM_GOP             30                              /* IDR间隔(帧), 也是接收端加入后的最长等待 */
+#define H264_STREAM_BITRATE         (300 * 1000)                    /* 目标码率(bit/s) */
+#define H264_STREAM_QP_MIN          20
+#define H264_STREAM_QP_MAX          40
+#define H264_STREAM_OUT_MAX         (64 * 1024)                     /* 单帧码流上限(输出缓冲大小, PSRAM) */
+
+/* 函数声明 */
+esp_err_t h264_stream_init(const camera_config_t *config);          /* 创建编码器并启动编码线程 */
+int h264_stream_offer(camera_fb_t *fb, int sock);                   /* 提交一帧编码发送(不阻塞), 1:已接收 */
+
+#endif
@@ -0,0 +1,338 @@
+/**
+ ****************************************************************************************************
+ * @file        heap_stats.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       堆内存遥测(各类内存的剩余/最大空闲块、按模块的分配计数、分配失败记录)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "heap_stats.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+
+/* 统计的内存类别 */
+typedef struct
+{
+    const char *name;
+    uint32_t caps;
+} heap_stats_class_t;
+
+/* 一个模块的分配计数 */
+typedef struct
+{
+    uint32_t allocs;                                                /* 成功分配次数 */
+    uint32_t frees;                                                 /* 释放次数 */
+    uint32_t fails;                                                 /* 失败次数 */
+    size_t live;                                                    /* 当前占用字节 */
+    size_t peak;                                                    /* 峰值占用字节 */
+} heap_stats_tag_t;
+
+static const heap_stats_class_t g_heap_classes[HEAP_STATS_CLASS_NUM] =
+{
+    { "dram",  MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT },
+    { "dma",   MALLOC_CAP_DMA },
+    { "psram", MALLOC_CAP_SPIRAM },
+};
+
+static const char *const g_heap_tag_names[HEAP_TAG_NUM] =
+{
+    "frame_pool", "sd_record", "frame_spool", "motion", "dual_stream", "lcd_preview", "metrics", "trace", "requant", "h264", "face_detect", "uvc", "synth", "replay", "soak", "mqtt", "burst", "rtp",
+};
+
+static portMUX_TYPE g_heap_mux = portMUX_INITIALIZER_UNLOCKED;     /* 失败回调可能在任意任务中调用 */
+static heap_stats_tag_t g_heap_tags[HEAP_TAG_NUM];
+static uint32_t g_heap_fails[HEAP_STATS_CLASS_NUM];                 /* 全部调用者的分配失败(按类别) */
+static size_t g_heap_fail_size = 0;                                 /* 最近一次失败 */
+static uint32_t g_heap_fail_caps = 0;
+static const char *g_heap_fail_func = NULL;
+static int64_t g_heap_fail_us = 0;
+static int64_t g_heap_report_us = 0;                                /* 上一次主动发送的时间 */
+
+
+/**
+ * @brief       分配失败回调(heap_caps_register_failed_alloc_callback), 不在其中打印或分配
+ * @param       size          : 申请的大小
+ * @param       caps          : 申请的内存属性
+ * @param       function_name : 发起分配的函数名
+ * @retval      无
+ */
+static void heap_stats_failed(size_t size, uint32_t caps, const char *function_name)
+{
+    uint32_t cls = (caps & MALLOC_CAP_SPIRAM) ? 2 : (caps & MALLOC_CAP_DMA) ? 1 : 0;
+
+    portENTER_CRITICAL_SAFE(&g_heap_mux);
+    g_heap_fails[cls]++;
+    g_heap_fail_size = size;
+    g_heap_fail_caps = caps;
+    g_heap_fail_func = function_name;
+    g_heap_fail_us = esp_timer_get_time();
+    portEXIT_CRITICAL_SAFE(&g_heap_mux);
+}
+
+/**
+ * @brief       记录一次模块分配的结果
+ * @param       tag : 模块
+ * @param       ptr : 分配结果, NULL:失败
+ * @retval      无
+ */
+static void heap_stats_account(heap_tag_t tag, void *ptr)
+{
+    heap_stats_tag_t *t = &g_heap_tags[tag];
+    size_t size = (ptr != NULL) ? heap_caps_get_allocated_size(ptr) : 0;
+
+    portENTER_CRITICAL(&g_heap_mux);
+
+    if (ptr == NULL)
+    {
+        t->fails++;
+    }
+    else
+    {
+        t->allocs++;
+        t->live += size;
+
+        if (t->live > t->peak)
+        {
+            t->peak = t->live;
+        }
+    }
+
+    portEXIT_CRITICAL(&g_heap_mux);
+}
+
+/**
+ * @brief       注册分配失败回调
+ * @param       无
+ * @retval      ESP_OK:成功; 其他:注册失败
+ */
+esp_err_t heap_stats_init(void)
+{
+#if HEAP_STATS_EN
+    g_heap_report_us = esp_timer_get_time();
+
+    return heap_caps_register_failed_alloc_callback(heap_stats_failed);
+#else
+    return ESP_OK;
+#endif
+}
+
+/**
+ * @brief       按模块计数的 heap_caps_malloc
+ * @param       tag  : 模块
+ * @param       size : 大小
+ * @param       caps : 内存属性
+ * @retval      分配的内存, NULL:失败
+ */
+void *heap_stats_malloc(heap_tag_t tag, size_t size, uint32_t caps)
+{
+    void *ptr = heap_caps_malloc(size, caps);
+
+#if HEAP_STATS_EN
+    heap_stats_account(tag, ptr);
+#else
+    (void)tag;
+#endif
+    return ptr;
+}
+
+/**
+ * @brief       按模块计数的 heap_caps_aligned_alloc
+ * @param       tag   : 模块
+ * @param       align : 对齐字节数(2的幂)
+ * @param       size  : 大小
+ * @param       caps  : 内存属性
+ * @retval      分配的内存, NULL:失败
+ */
+void *heap_stats_aligned_alloc(heap_tag_t tag, size_t align, size_t size, uint32_t caps)
+{
+    void *ptr = heap_caps_aligned_alloc(align, size, caps);
+
+#if HEAP_STATS_EN
+    heap_stats_account(tag, ptr);
+#else
+    (void)tag;
+#endif
+    return ptr;
+}
+
+/**
+ * @brief       按模块计数的 heap_caps_free
+ * @param       tag : 模块(须与分配时相同)
+ * @param       ptr : 内存, NULL时不操作
+ * @retval      无
+ */
+void heap_stats_free(heap_tag_t tag, void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+#if HEAP_STATS_EN
+    size_t size = heap_caps_get_allocated_size(ptr);
+    heap_stats_tag_t *t = &g_heap_tags[tag];
+
+    portENTER_CRITICAL(&g_heap_mux);
+    t->frees++;
+    t->live = (t->live > size) ? t->live - size : 0;
+    portEXIT_CRITICAL(&g_heap_mux);
+#else
+    (void)tag;
+#endif
+    heap_caps_free(ptr);
+}
+
+/**
+ * @brief       读取各类内存的状态
+ * @param       caps : 输出, 顺序同 g_heap_classes
+ * @retval      无
+ */
+void heap_stats_get(heap_stats_caps_t caps[HEAP_STATS_CLASS_NUM])
+{
+    for (uint32_t i = 0; i < HEAP_STATS_CLASS_NUM; i++)
+    {
+        caps[i].name = g_heap_classes[i].name;
+        caps[i].free_size = heap_caps_get_free_size(g_heap_classes[i].caps);
+        caps[i].largest = heap_caps_get_largest_free_block(g_heap_classes[i].caps);
+        caps[i].min_free = heap_caps_get_minimum_free_size(g_heap_classes[i].caps);
+    }
+
+    portENTER_CRITICAL(&g_heap_mux);
+
+    for (uint32_t i = 0; i < HEAP_STATS_CLASS_NUM; i++)
+    {
+        caps[i].fails = g_heap_fails[i];
+    }
+
+    portEXIT_CRITICAL(&g_heap_mux);
+}
+
+/**
+ * @brief       输出各类内存与各模块的统计
+ * @note        每类一行: 剩余 最大空闲块 历史最小剩余(KB) 碎片率% 失败次数;
+ *              每模块一行: 分配/释放/失败次数 当前/峰值占用(KB); 最后一行为最近一次分配失败
+ * @param       buf  : 输出缓冲
+ * @param       size : 缓冲大小
+ * @retval      输出长度; 0:未使能
+ */
+int heap_stats_format(char *buf, size_t size)
+{
+#if HEAP_STATS_EN
+    heap_stats_tag_t tags[HEAP_TAG_NUM];
+    heap_stats_caps_t caps[HEAP_STATS_CLASS_NUM];
+    size_t fail_size;
+    uint32_t fail_caps;
+    const char *fail_func;
+    int64_t fail_us;
+    int len;
+    int n;
+
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    heap_stats_get(caps);
+
+    portENTER_CRITICAL(&g_heap_mux);
+    memcpy(tags, g_heap_tags, sizeof(tags));
+    fail_size = g_heap_fail_size;
+    fail_caps = g_heap_fail_caps;
+    fail_func = g_heap_fail_func;
+    fail_us = g_heap_fail_us;
+    portEXIT_CRITICAL(&g_heap_mux);
+
+    len = snprintf(buf, size, "heap      free_kb largest_kb  min_kb frag%% fails\n");
+
+    for (uint32_t i = 0; i < HEAP_STATS_CLASS_NUM && len > 0 && (size_t)len < size; i++)
+    {
+        n = snprintf(buf + len, size - len, "%-8s %8u %10u %7u %5u %5lu\n",
+                     caps[i].name,
+                     (unsigned)(caps[i].free_size / 1024),
+                     (unsigned)(caps[i].largest / 1024),
+                     (unsigned)(caps[i].min_free / 1024),
+                     (caps[i].free_size > 0) ? (unsigned)(100 - (uint64_t)caps[i].largest * 100 / caps[i].free_size) : 0,
+                     (unsigned long)caps[i].fails);
+
+        if (n < 0)
+        {
+            return len;
+        }
+
+        len += n;
+    }
+
+    if (len > 0 && (size_t)len < size)
+    {
+        n = snprintf(buf + len, size - len, "alloc        allocs  frees fails live_kb peak_kb\n");
+        len = (n < 0) ? len : len + n;
+    }
+
+    for (uint32_t i = 0; i < HEAP_TAG_NUM && len > 0 && (size_t)len < size; i++)
+    {
+        n = snprintf(buf + len, size - len, "%-12s %6lu %6lu %5lu %7u %7u\n",
+                     g_heap_tag_names[i],
+                     (unsigned long)tags[i].allocs,
+                     (unsigned long)tags[i].frees,
+                     (unsigned long)tags[i].fails,
+                     (unsigned)(tags[i].live / 1024),
+                     (unsigned)(tags[i].peak / 1024));
+
+        if (n < 0)
+        {
+            return len;
+        }
+
+        len += n;
+    }
+
+    if (fail_func != NULL && len > 0 && (size_t)len < size)
+    {
+        n = snprintf(buf + len, size - len, "last alloc fail: %u bytes caps 0x%lx in %s, %lld s ago\n",
+                     (unsigned)fail_size, (unsigned long)fail_caps, fail_func,
+                     (long long)((esp_timer_get_time() - fail_us) / 1000000));
+        len = (n < 0) ? len : len + n;
+    }
+
+    return ((size_t)len < size) ? len : (int)size - 1;
+#else
+    (void)buf;
+    (void)size;
+    return 0;
+#endif
+}
+
+/**
+ * @brief       是否到了主动发送统计的时间(只由发送线程调用)
+ * @param       无
+ * @retval      1:应发送(并开始下一个间隔); 0:未到
+ */
+int heap_stats_due(void)
+{
+#if HEAP_STATS_EN && HEAP_STATS_INTERVAL_MS > 0
+    int64_t now = esp_timer_get_time();
+
+    if (now - g_heap_report_us >= (int64_t)HEAP_STATS_INTERVAL_MS * 1000)
+    {
+        g_heap_report_us = now;
+        return 1;
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ ****************************************************************************************************
+ * @file        heap_stats.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       堆内存遥测(各类内存的剩余/最大空闲块、按模块的分配计数、分配失败记录)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 长时间运行后的 FB-OVF 或分配失败通常是碎片化: 剩余总量足够, 但最大空闲块小于所需大小.
+ * heap_stats_format() 对内部RAM、DMA可用内存与PSRAM分别输出 剩余/最大空闲块/历史最小剩余 与碎片率
+ * (1 - 最大空闲块/剩余), 附在服务器的"stats"回复中; 发送线程每隔 HEAP_STATS_INTERVAL_MS 主动发送一次,
+ * 多日运行的趋势可在服务器端追溯.
+ * 各模块的缓冲经 heap_stats_malloc()/heap_stats_free() 申请与释放, 按 heap_tag_t 统计分配/释放/失败次数
+ * 与当前、峰值占用字节; 任何调用者(含驱动与协议栈)的分配失败经 heap_caps_register_failed_alloc_callback()
+ * 按内存类别计数, 并记录最近一次失败的大小、属性与函数名. 各任务的栈剩余见 task_topo_format().
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __HEAP_STATS_H
+#define __HEAP_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+
+#define HEAP_STATS_EN               1                               /* 1:使能堆内存遥测 */
+#define HEAP_STATS_INTERVAL_MS      60000                           /* 主动发送统计的间隔, 0:只在服务器请求时发送 */
+
+/* 分配归属的模块 */
+typedef enum
+{
+    HEAP_TAG_FRAME_POOL = 0,                                        /* 帧缓冲池 */
+    HEAP_TAG_SD_RECORD,                                             /* SD卡录像 */
+    HEAP_TAG_FRAME_SPOOL,                                           /* 断线帧缓存 */
+    HEAP_TAG_MOTION,                                                /* 移动侦测 */
+    HEAP_TAG_DUAL_STREAM,                                           /* 双码流转码 */
+    HEAP_TAG_LCD_PREVIEW,                                           /* LCD取景 */
+    HEAP_TAG_METRICS,                                               /* /metrics 输出缓冲 */
+    HEAP_TAG_TRACE,                                                 /* 跟踪事件环形缓冲与 /trace 输出缓冲 */
+    HEAP_TAG_REQUANT,                                               /* 压缩域转码 */
+    HEAP_TAG_H264,                                                  /* H.264编码输出 */
+    HEAP_TAG_FACE_DETECT,                                           /* 人脸检测 */
+    HEAP_TAG_UVC,                                                   /* USB UVC传输缓冲 */
+    HEAP_TAG_SYNTH,                                                 /* 合成帧缓冲 */
+    HEAP_TAG_REPLAY,                                                /* 录像重放的预载缓冲 */
+    HEAP_TAG_SOAK,                                                  /* 稳定性测试的任务状态表 */
+    HEAP_TAG_MQTT,                                                  /* MQTT事件批次缓存 */
+    HEAP_TAG_BURST,                                                 /* 连拍选帧的评分条带 */
+    HEAP_TAG_RTP,                                                   /* RTP原始帧编码的扫描行与MCU行缓冲 */
+    HEAP_TAG_NUM
+} heap_tag_t;
+
+#define HEAP_STATS_CLASS_NUM        3                               /* 统计的内存类别数: 内部RAM, DMA可用, PSRAM */
+
+/* 一类内存的状态 */
+typedef struct
+{
+    const char *name;                                               /* "dram" / "dma" / "psram" */
+    size_t free_size;                                               /* 剩余字节 */
+    size_t largest;                                                 /* 最大空闲块 */
+    size_t min_free;                                                /* 上电以来的最小剩余 */
+    uint32_t fails;                                                 /* 该类内存的分配失败次数(全部调用者) */
+} heap_stats_caps_t;
+
+/* 函数声明 */
+esp_err_t heap_stats_init(void);                                    /* 注册分配失败回调(上电后尽早调用) */
+void *heap_stats_malloc(heap_tag_t tag, size_t size, uint32_t caps);                    /* 按模块计数的 heap_caps_malloc */
+void *heap_stats_aligned_alloc(heap_tag_t tag, size_t align, size_t size, uint32_t caps); /* 按模块计数的 heap_caps_aligned_alloc */
+void heap_stats_free(heap_tag_t tag, void *ptr);                    /* 按模块计数的 heap_caps_free */
+void heap_stats_get(heap_stats_caps_t caps[HEAP_STATS_CLASS_NUM]);  /* 读取各类内存的状态 */
+int heap_stats_format(char *buf, size_t size);                      /* 输出各类内存与各模块的统计, 返回长度 */
+int heap_stats_due(void);                                           /* 是否到了主动发送的时间(发送线程调用) */
+
+#endif
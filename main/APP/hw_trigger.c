@@ -0,0 +1,247 @@
+/**
+ ****************************************************************************************************
+ * @file        hw_trigger.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       XL9555输入触发的低延迟事件抓拍(PIR、门磁)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "hw_trigger.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "rate_ctrl.h"
+#include "sd_recorder.h"
+
+
+#if HW_TRIGGER_EN
+static portMUX_TYPE g_trig_mux = portMUX_INITIALIZER_UNLOCKED;     /* 边沿时间在输入事件线程与发送线程间传递, 64位读写不是原子操作 */
+static int64_t g_trig_edge_us = 0;                                  /* 待发出的触发的边沿时间, 0:无 */
+static int64_t g_trig_taken_us = 0;                                 /* 发送线程已领取、尚未发出的触发的边沿时间(只在发送线程中使用) */
+static esp_timer_handle_t g_boost_timer = NULL;                     /* 最高分辨率与质量的保持时间 */
+static hw_trigger_stats_t g_trig_stats;
+
+#if HW_TRIGGER_BOOST_S > 0
+/**
+ * @brief       保持时间到, 码率控制恢复自适应(esp_timer任务调用)
+ * @param       arg : 未用到
+ * @retval      无
+ */
+static void hw_trigger_boost_end(void *arg)
+{
+    (void)arg;
+
+    portENTER_CRITICAL(&g_trig_mux);
+    g_trig_stats.boost = 0;
+    portEXIT_CRITICAL(&g_trig_mux);
+
+    rate_ctrl_hold(0);
+    ESP_LOGI("TAG", "trigger: boost end");
+}
+#endif
+
+/**
+ * @brief       开始或延长最高分辨率与质量的保持
+ * @param       无
+ * @retval      无
+ */
+static void hw_trigger_boost(void)
+{
+    uint8_t start;
+
+    if (g_boost_timer == NULL)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&g_trig_mux);
+    start = !g_trig_stats.boost;
+    g_trig_stats.boost = 1;
+    portEXIT_CRITICAL(&g_trig_mux);
+
+    if (start)
+    {
+        rate_ctrl_hold(1);
+    }
+
+    esp_timer_stop(g_boost_timer);
+    esp_timer_start_once(g_boost_timer, (uint64_t)HW_TRIGGER_BOOST_S * 1000000);
+}
+
+/**
+ * @brief       触发输入跳变回调(XL9555输入事件线程, 不经消抖)
+ * @param       changed : 本次跳变的触发输入
+ * @param       level   : 所有输入的电平
+ * @param       time_us : 读到跳变的时间
+ * @retval      无
+ */
+static void hw_trigger_edge(uint16_t changed, uint16_t level, int64_t time_us)
+{
+    uint16_t active = (level ^ HW_TRIGGER_ACTIVE_LOW) & changed;    /* 进入有效电平的输入, 离开有效电平不触发 */
+    uint8_t boost;
+
+    if (active == 0)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&g_trig_mux);
+
+    if (g_trig_edge_us == 0)
+    {
+        g_trig_edge_us = time_us;                                   /* 尚未发出时再次触发, 时延从第一次算起 */
+    }
+
+    g_trig_stats.triggers++;
+    boost = g_trig_stats.boost;
+    portEXIT_CRITICAL(&g_trig_mux);
+
+    sd_recorder_trigger();                                          /* 写出事件前缓冲中的帧, 录像中则延长 */
+
+    if (boost)
+    {
+        hw_trigger_boost();                                         /* 保持期间再次触发, 重新计时 */
+    }
+
+    ESP_LOGI("TAG", "trigger: input 0x%04x", active);
+}
+#endif
+
+/**
+ * @brief       注册XL9555触发回调
+ * @note        须在 xl9555_event_init 之后调用
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_SUPPORTED:未使能; 其他:创建定时器失败
+ */
+esp_err_t hw_trigger_init(void)
+{
+#if HW_TRIGGER_EN
+#if HW_TRIGGER_BOOST_S > 0
+    const esp_timer_create_args_t args = { .callback = hw_trigger_boost_end, .name = "hw_trigger" };
+    esp_err_t err = esp_timer_create(&args, &g_boost_timer);
+
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+#endif
+
+    xl9555_trigger_set(HW_TRIGGER_IO_MASK, hw_trigger_edge);
+    ESP_LOGI("TAG", "trigger: inputs 0x%04x, poll %d ms, boost %d s", HW_TRIGGER_IO_MASK, XL9555_TRIGGER_POLL_MS, HW_TRIGGER_BOOST_S);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       是否有待发出的触发帧(发送线程据此丢弃队列中较旧的帧)
+ * @param       无
+ * @retval      1:有; 0:无
+ */
+int hw_trigger_pending(void)
+{
+#if HW_TRIGGER_EN
+    int pending;
+
+    portENTER_CRITICAL(&g_trig_mux);
+    pending = (g_trig_edge_us != 0);
+    portEXIT_CRITICAL(&g_trig_mux);
+
+    return pending;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief       发送线程领取触发(每帧判断上传时调用)
+ * @note        领取后本帧强制上传; 超过 HW_TRIGGER_EXPIRE_MS 的触发作废
+ * @param       无
+ * @retval      1:本帧为触发帧; 0:无触发
+ */
+int hw_trigger_take(void)
+{
+#if HW_TRIGGER_EN
+    int64_t edge;
+
+    portENTER_CRITICAL(&g_trig_mux);
+    edge = g_trig_edge_us;
+    g_trig_edge_us = 0;
+    portEXIT_CRITICAL(&g_trig_mux);
+
+    if (edge == 0)
+    {
+        return 0;
+    }
+
+    if (esp_timer_get_time() - edge > (int64_t)HW_TRIGGER_EXPIRE_MS * 1000)
+    {
+        g_trig_stats.expired++;
+        return 0;
+    }
+
+    g_trig_taken_us = edge;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief       发送线程每发出一帧调用: 发出的是触发帧时记录时延并开始保持最高分辨率与质量
+ * @param       无
+ * @retval      无
+ */
+void hw_trigger_sent(void)
+{
+#if HW_TRIGGER_EN
+    uint32_t latency;
+
+    if (g_trig_taken_us == 0)
+    {
+        return;
+    }
+
+    latency = (uint32_t)(esp_timer_get_time() - g_trig_taken_us);
+    g_trig_taken_us = 0;
+    g_trig_stats.frames++;
+    g_trig_stats.last_us = latency;
+
+    if (latency > g_trig_stats.max_us)
+    {
+        g_trig_stats.max_us = latency;
+    }
+
+    hw_trigger_boost();                                             /* 第一帧发出后才切换, 传感器重配置不推迟第一帧 */
+    ESP_LOGI("TAG", "trigger: edge to frame sent %lu us", (unsigned long)latency);
+#endif
+}
+
+/**
+ * @brief       读取统计
+ * @param       stats : 输出统计
+ * @retval      无
+ */
+void hw_trigger_get_stats(hw_trigger_stats_t *stats)
+{
+#if HW_TRIGGER_EN
+    portENTER_CRITICAL(&g_trig_mux);
+    *stats = g_trig_stats;
+    portEXIT_CRITICAL(&g_trig_mux);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
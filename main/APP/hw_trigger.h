@@ -0,0 +1,61 @@
+/**
+ ****************************************************************************************************
+ * @file        hw_trigger.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       XL9555输入触发的低延迟事件抓拍(PIR、门磁)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * HW_TRIGGER_IO_MASK 中的输入进入有效电平时, XL9555输入事件线程不经消抖直接回调(xl9555_trigger_set):
+ * 立即触发SD卡事件录像(写出事件前缓冲中的帧), 并标记发送线程: 队列中较旧的帧直接丢弃, 最新一帧跳过
+ * 暂停/帧率上限/移动侦测/静止画面判断强制上传. 该帧发出后 HW_TRIGGER_BOOST_S 秒内码率控制保持最高分辨率与质量
+ * (rate_ctrl_hold), 切换分辨率的传感器重配置不会推迟第一帧; 保持期间再次触发则重新计时.
+ * 本板INT引脚与SPILCD的DC复用, 输入只能查询: 注册触发IO后查询周期为 XL9555_TRIGGER_POLL_MS,
+ * 边沿到发出第一帧 = 查询延迟(<= XL9555_TRIGGER_POLL_MS) + 等待下一帧(流水线队列中已有帧时为0) + 写入协议栈.
+ * 超过 HW_TRIGGER_EXPIRE_MS 仍未发出(未连接服务器)的触发作废, 不会把很久以后的帧计为触发帧.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __HW_TRIGGER_H
+#define __HW_TRIGGER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "xl9555.h"
+
+
+#define HW_TRIGGER_EN               0                               /* 1:XL9555输入触发事件抓拍(须外接PIR/门磁) */
+#define HW_TRIGGER_IO_MASK          KEY3_IO                         /* 触发输入(按实际接线修改, 须在 XL9555_INPUT_MASK 内) */
+#define HW_TRIGGER_ACTIVE_LOW       KEY3_IO                         /* 低电平有效的触发输入, 其余为高电平有效 */
+#define HW_TRIGGER_BOOST_S          10                              /* 触发后保持最高分辨率与质量的时间, 0:不切换 */
+#define HW_TRIGGER_EXPIRE_MS        1000                            /* 触发后未能发出帧的作废时间 */
+
+/* 统计 */
+typedef struct
+{
+    uint32_t triggers;                                              /* 有效边沿次数 */
+    uint32_t frames;                                                /* 已发出的触发帧数 */
+    uint32_t expired;                                               /* 作废的触发 */
+    uint32_t last_us;                                               /* 最近一次边沿到发出帧的时间 */
+    uint32_t max_us;                                                /* 最长的边沿到发出帧的时间 */
+    uint8_t  boost;                                                 /* 1:正在保持最高分辨率与质量 */
+} hw_trigger_stats_t;
+
+/* 函数声明 */
+esp_err_t hw_trigger_init(void);                                    /* 注册XL9555触发回调(须先 xl9555_event_init) */
+int hw_trigger_pending(void);                                       /* 是否有待发出的触发帧 */
+int hw_trigger_take(void);                                          /* 发送线程领取触发(本帧强制上传) */
+void hw_trigger_sent(void);                                         /* 发送线程每发出一帧调用 */
+void hw_trigger_get_stats(hw_trigger_stats_t *stats);               /* 读取统计 */
+
+#endif
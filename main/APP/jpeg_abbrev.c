@@ -0,0 +1,121 @@
+/**
+ ****************************************************************************************************
+ * @file        jpeg_abbrev.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       省略表头的JPEG推流: 表头(DQT/DHT/SOF等)与上一帧相同时只发送SOS之后的数据
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "jpeg_abbrev.h"
+#include <string.h>
+
+
+/**
+ * @brief       查找SOS标记的位置(只遍历标记段, 不扫描熵编码数据)
+ * @param       jpg : JPEG数据
+ * @param       len : 数据长度
+ * @retval      SOS标记(0xFFDA)的偏移, 0:不是JPEG或没有找到
+ */
+size_t jpeg_abbrev_sos(const uint8_t *jpg, size_t len)
+{
+    size_t pos = 2;
+
+    if (len < 4 || jpg[0] != 0xFF || jpg[1] != 0xD8)
+    {
+        return 0;
+    }
+
+    while (pos + 4 <= len)
+    {
+        uint8_t marker;
+
+        if (jpg[pos] != 0xFF)
+        {
+            return 0;
+        }
+
+        marker = jpg[pos + 1];
+
+        if (marker == 0xFF)                                         /* 填充字节 */
+        {
+            pos++;
+            continue;
+        }
+
+        if (marker == 0xDA)
+        {
+            return pos;
+        }
+
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+        {
+            pos += 2;                                               /* 无长度字段的标记 */
+            continue;
+        }
+
+        pos += 2 + ((jpg[pos + 2] << 8) | jpg[pos + 3]);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief       清空表头缓存, 下一帧按完整帧发送
+ * @param       ab : 发送端状态
+ * @retval      无
+ */
+void jpeg_abbrev_reset(jpeg_abbrev_t *ab)
+{
+    ab->table_id = 0;
+    ab->hdr_len = 0;
+    ab->saved = 0;
+}
+
+/**
+ * @brief       判断本帧能否省略表头
+ * @note        表头与上一帧不同时记录为新的表头(编号+1), 本帧按完整帧发送
+ * @param       ab       : 发送端状态
+ * @param       jpg      : JPEG数据
+ * @param       len      : 数据长度
+ * @param       table_id : 输出本帧的表头编号
+ * @param       skip     : 输出可省略的字节数(SOS之前), 完整帧为0
+ * @retval      true:省略表头; false:发送完整帧
+ */
+bool jpeg_abbrev_offer(jpeg_abbrev_t *ab, const uint8_t *jpg, size_t len, uint8_t *table_id, size_t *skip)
+{
+    size_t sos = jpeg_abbrev_sos(jpg, len);
+
+    *skip = 0;
+
+    if (sos == 0 || sos > JPEG_ABBREV_HDR_MAX)
+    {
+        ab->hdr_len = 0;                                            /* 无法缓存, 下一帧也按完整帧发送 */
+        *table_id = ab->table_id;
+        return false;
+    }
+
+    if (ab->hdr_len == sos && memcmp(ab->hdr, jpg, sos) == 0)
+    {
+        *table_id = ab->table_id;
+        *skip = sos;
+        ab->saved += sos;
+        return true;
+    }
+
+    memcpy(ab->hdr, jpg, sos);
+    ab->hdr_len = (uint16_t)sos;
+    *table_id = ++ab->table_id;
+    return false;
+}
@@ -0,0 +1,52 @@
+/**
+ ****************************************************************************************************
+ * @file        jpeg_abbrev.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       省略表头的JPEG推流: 表头(DQT/DHT/SOF等)与上一帧相同时只发送SOS之后的数据
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 传感器输出的每一帧JPEG都带有相同的量化表、霍夫曼表与SOF(OV2640约600字节), QVGA质量12时接近帧长的10%.
+ * 服务器以 CTRL_CMD_JPEG_ABBREV 开启后, 图像帧使用 frame_header_jpeg_t(帧头后附表头编号):
+ * 1 表头(SOI到SOS之前)与上一帧不同(首帧、分辨率或质量变化)时发送完整帧(置 FRAME_FLAG_KEY), 表头编号+1,
+ *   接收端按编号缓存该帧SOS之前的数据;
+ * 2 表头相同时清除 FRAME_FLAG_KEY, 负载只有从SOS标记开始的数据, 接收端在前面补上缓存的表头, 图像无损.
+ * 新连接(或重新开启)时清空缓存, 第一帧总是完整帧; 回填、连拍与子码流帧不经本模块, 仍为完整JPEG.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __JPEG_ABBREV_H
+#define __JPEG_ABBREV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+
+#define JPEG_ABBREV_HDR_MAX         1024                            /* 可省略的表头长度上限, 更长的表头按完整帧发送 */
+
+/* 发送端状态(每个连接一份) */
+typedef struct
+{
+    uint8_t table_id;                                               /* 当前表头编号 */
+    uint16_t hdr_len;                                               /* 当前表头长度, 0:无 */
+    uint8_t hdr[JPEG_ABBREV_HDR_MAX];                               /* 当前表头(SOI到SOS之前) */
+    uint32_t saved;                                                 /* 累计省略的字节数 */
+} jpeg_abbrev_t;
+
+/* 函数声明 */
+size_t jpeg_abbrev_sos(const uint8_t *jpg, size_t len);            /* 查找SOS标记的位置 */
+void jpeg_abbrev_reset(jpeg_abbrev_t *ab);                          /* 清空表头缓存(新连接) */
+bool jpeg_abbrev_offer(jpeg_abbrev_t *ab, const uint8_t *jpg, size_t len, uint8_t *table_id, size_t *skip);   /* 判断本帧能否省略表头 */
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ ****************************************************************************************************
+ * @file        jpg_quality.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       JPEG画面质量评分(清晰度、曝光削顶、运动模糊)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "jpg_quality.h"
+#include <string.h>
+
+
+/* 逐条带统计的状态 */
+typedef struct
+{
+    uint64_t energy;                                                /* 水平与垂直差的平方和 */
+    uint64_t sum_x;                                                 /* 水平差的绝对值之和 */
+    uint64_t sum_y;                                                 /* 垂直差的绝对值之和 */
+    uint32_t clipped;                                               /* 欠曝或过曝像素数 */
+    uint32_t pixels;                                                /* 已统计的像素数 */
+    uint16_t rows;                                                  /* 已统计的行数 */
+    uint8_t prev[JPG_QUALITY_MAX_W];                                /* 上一条带的最后一行(跨条带求垂直差) */
+} jpg_quality_ctx_t;
+
+
+/**
+ * @brief       条带回调: 累加本条带的梯度与削顶像素
+ * @param       arg   : 统计状态
+ * @param       strip : 灰度条带
+ * @retval      true
+ */
+static bool jpg_quality_strip(void *arg, jpg_strip_t *strip)
+{
+    jpg_quality_ctx_t *ctx = (jpg_quality_ctx_t *)arg;
+    const uint8_t *row;
+    const uint8_t *up;
+    int32_t dx;
+    int32_t dy;
+
+    for (uint16_t y = 0; y < strip->lines; y++)
+    {
+        row = strip->data + (size_t)y * strip->width;
+        up = (y > 0) ? row - strip->width : ctx->prev;
+
+        for (uint16_t x = 0; x < strip->width; x++)
+        {
+            if (row[x] <= JPG_QUALITY_CLIP_LO || row[x] >= JPG_QUALITY_CLIP_HI)
+            {
+                ctx->clipped++;
+            }
+
+            dx = (x > 0) ? (int32_t)row[x] - row[x - 1] : 0;
+            dy = (ctx->rows > 0) ? (int32_t)row[x] - up[x] : 0;
+            ctx->energy += (uint32_t)(dx * dx + dy * dy);
+            ctx->sum_x += (uint32_t)((dx < 0) ? -dx : dx);
+            ctx->sum_y += (uint32_t)((dy < 0) ? -dy : dy);
+        }
+
+        ctx->pixels += strip->width;
+        ctx->rows++;
+    }
+
+    if (strip->lines > 0)
+    {
+        memcpy(ctx->prev, strip->data + (size_t)(strip->lines - 1) * strip->width, strip->width);
+    }
+
+    return true;
+}
+
+/**
+ * @brief       计算一帧JPEG的质量评分
+ * @param       dec        : 解码器上下文
+ * @param       src        : JPEG数据
+ * @param       src_len    : JPEG数据长度
+ * @param       strip      : 条带缓冲
+ * @param       strip_size : 条带缓冲大小, 不小于 JPG_QUALITY_STRIP_SIZE
+ * @param       q          : 输出评分
+ * @retval      true:成功; false:JPEG数据错误或缩放后宽度超过 JPG_QUALITY_MAX_W
+ */
+bool jpg_quality(esp_jpg_dec_t *dec, const uint8_t *src, size_t src_len,
+                 uint8_t *strip, size_t strip_size, jpg_quality_t *q)
+{
+    jpg_quality_ctx_t ctx;
+    uint64_t sum;
+    uint64_t diff;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(q, 0, sizeof(*q));
+
+    if (strip_size > JPG_QUALITY_STRIP_SIZE)
+    {
+        strip_size = JPG_QUALITY_STRIP_SIZE;                        /* 上一行缓冲只有 JPG_QUALITY_MAX_W 字节 */
+    }
+
+    if (!jpg2strips(dec, src, src_len, JPG_QUALITY_SCALE, JPG_STRIP_GRAY, strip, strip_size,
+                     JPG_QUALITY_STRIP_LINES, jpg_quality_strip, &ctx) || ctx.pixels == 0)
+    {
+        return false;
+    }
+
+    sum = ctx.sum_x + ctx.sum_y;
+    diff = (ctx.sum_x > ctx.sum_y) ? ctx.sum_x - ctx.sum_y : ctx.sum_y - ctx.sum_x;
+
+    q->sharpness = (uint32_t)(ctx.energy / ctx.pixels);
+    q->clipped = (uint16_t)((uint64_t)ctx.clipped * 1000 / ctx.pixels);
+    q->aniso = (sum > 0) ? (uint16_t)(diff * 1000 / sum) : 0;
+
+    return true;
+}
@@ -0,0 +1,54 @@
+/**
+ ****************************************************************************************************
+ * @file        jpg_quality.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       JPEG画面质量评分(清晰度、曝光削顶、运动模糊)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 以 JPG_QUALITY_SCALE 缩放解码为灰度(jpg2strips 分条, 条带缓冲很小), 逐条带统计相邻像素差:
+ * - sharpness: 水平与垂直差的平方和的每像素平均值. 1/8缩放只有DC系数, 块内细节全部丢失;
+ *   1/4缩放仍保留低频AC系数, 对焦不准或抖动的帧边缘变缓, 该值明显变小.
+ * - clipped:   亮度 <= JPG_QUALITY_CLIP_LO 或 >= JPG_QUALITY_CLIP_HI 的像素千分比(欠曝/过曝, 车牌反光等).
+ * - aniso:     水平与垂直差的绝对值之和的不对称度千分比. 运动模糊只抹掉沿运动方向的边缘, 该值变大;
+ *   画面本身的纹理也有方向性, 只在同一场景的几帧之间比较才有意义.
+ * 各值只用于同一批(曝光锁定、同一场景)内的相对比较, 不同场景之间不可比.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __JPG_QUALITY_H
+#define __JPG_QUALITY_H
+
+#include "img_converters.h"
+
+
+#define JPG_QUALITY_SCALE           JPG_SCALE_4X                    /* 评分的解码缩放比例(UXGA->400x300) */
+#define JPG_QUALITY_STRIP_LINES     16                              /* 条带高度(缩放后MCU高度的整数倍) */
+#define JPG_QUALITY_MAX_W           512                             /* 缩放后最大宽度(QXGA 2048/4) */
+#define JPG_QUALITY_STRIP_SIZE      (JPG_QUALITY_MAX_W * JPG_QUALITY_STRIP_LINES)  /* 调用者提供的条带缓冲大小 */
+#define JPG_QUALITY_CLIP_LO         8                               /* 欠曝亮度 */
+#define JPG_QUALITY_CLIP_HI         247                             /* 过曝亮度 */
+
+/* 一帧的评分 */
+typedef struct
+{
+    uint32_t sharpness;                                             /* 每像素平均梯度能量, 越大越清晰 */
+    uint16_t clipped;                                               /* 欠曝或过曝像素千分比 */
+    uint16_t aniso;                                                 /* 水平/垂直梯度不对称度千分比 */
+} jpg_quality_t;
+
+/* 函数声明 */
+bool jpg_quality(esp_jpg_dec_t *dec, const uint8_t *src, size_t src_len,
+                 uint8_t *strip, size_t strip_size, jpg_quality_t *q);   /* 计算一帧的评分 */
+
+#endif
@@ -0,0 +1,889 @@
+/**
+ ****************************************************************************************************
+ * @file        jpg_requant.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       压缩域JPEG转码: 霍夫曼解码到量化系数, 换用更粗的量化表后重新熵编码(不做IDCT/DCT)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "jpg_requant.h"
+#include <string.h>
+
+
+/* IJG 标准量化表(之字形顺序) */
+static const uint8_t g_jr_std_qt[2][64] =
+{
+    {
+        16,  11,  12,  14,  12,  10,  16,  14,  13,  14,  18,  17,  16,  19,  24,  40,
+        26,  24,  22,  22,  24,  49,  35,  37,  29,  40,  58,  51,  61,  60,  57,  51,
+        56,  55,  64,  72,  92,  78,  64,  68,  87,  69,  55,  56,  80, 109,  81,  87,
+        95,  98, 103, 104, 103,  62,  77, 113, 121, 112, 100, 120,  92, 101, 103,  99,
+    },
+    {
+        17,  18,  18,  24,  21,  24,  47,  26,  26,  47,  99,  66,  56,  66,  99,  99,
+        99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,
+        99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,
+        99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,  99,
+    },
+};
+
+/* 标准霍夫曼表(JPEG Annex K): 各码长(1~16)的码数与符号; 0:亮度DC, 1:色度DC, 2:亮度AC, 3:色度AC */
+static const uint8_t g_jr_bits[4][16] =
+{
+    { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 },
+    { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 125 },
+    { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 119 },
+};
+
+static const uint8_t g_jr_dc_val[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t g_jr_ac_val[2][162] =
+{
+    {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+        0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+        0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+        0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA,
+    },
+    {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+        0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+        0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+        0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+        0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+        0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA,
+    },
+};
+
+/* 编码用的码表: 符号 -> (码长 << 16) | 码值 */
+static uint32_t g_jr_code[4][256];
+static bool g_jr_code_ready = false;
+
+/**
+ * @brief       由码长计数生成标准霍夫曼表的码值(多个线程同时调用时写入相同的值)
+ * @param       无
+ * @retval      无
+ */
+static void jr_build_codes(void)
+{
+    for (int t = 0; t < 4; t++)
+    {
+        const uint8_t *vals = (t < 2) ? g_jr_dc_val : g_jr_ac_val[t - 2];
+        uint32_t code = 0;
+        int k = 0;
+
+        for (int len = 1; len <= 16; len++)
+        {
+            for (int i = 0; i < g_jr_bits[t][len - 1]; i++)
+            {
+                g_jr_code[t][vals[k++]] = ((uint32_t)len << 16) | code++;
+            }
+
+            code <<= 1;
+        }
+    }
+
+    g_jr_code_ready = true;
+}
+
+/**
+ * @brief       输出一个字节(超出输出缓冲的部分只计数)
+ * @param       rq : 转码状态
+ * @param       b  : 字节
+ * @retval      无
+ */
+static inline void jr_byte(jpg_requant_t *rq, uint8_t b)
+{
+    if (rq->pos < rq->cap)
+    {
+        rq->out[rq->pos] = b;
+    }
+
+    rq->pos++;
+}
+
+/**
+ * @brief       输出一个大端16位数
+ * @param       rq : 转码状态
+ * @param       v  : 数值
+ * @retval      无
+ */
+static void jr_be16(jpg_requant_t *rq, uint16_t v)
+{
+    jr_byte(rq, (uint8_t)(v >> 8));
+    jr_byte(rq, (uint8_t)v);
+}
+
+/**
+ * @brief       输出若干位, 满一个字节写出, 0xFF后补0x00
+ * @param       rq   : 转码状态
+ * @param       code : 位(低位对齐)
+ * @param       len  : 位数(不超过16)
+ * @retval      无
+ */
+static inline void jr_put(jpg_requant_t *rq, uint32_t code, int len)
+{
+    uint8_t b;
+
+    rq->bitbuf = (rq->bitbuf << len) | code;
+    rq->bits += len;
+
+    while (rq->bits >= 8)
+    {
+        rq->bits -= 8;
+        b = (uint8_t)(rq->bitbuf >> rq->bits);
+        jr_byte(rq, b);
+
+        if (b == 0xFF)
+        {
+            jr_byte(rq, 0x00);
+        }
+    }
+
+    rq->bitbuf &= (1U << rq->bits) - 1;
+}
+
+/**
+ * @brief       输出一个霍夫曼符号与附加位
+ * @param       rq  : 转码状态
+ * @param       t   : 霍夫曼表(0~3)
+ * @param       sym : 符号(高4位为游程, 低4位为附加位数)
+ * @param       v   : 系数值(附加位数为0时不输出)
+ * @retval      无
+ */
+static inline void jr_put_sym(jpg_requant_t *rq, int t, int sym, int32_t v)
+{
+    uint32_t e = g_jr_code[t][sym];
+    int s = sym & 0x0F;
+
+    jr_put(rq, e & 0xFFFF, (int)(e >> 16));
+
+    if (s != 0)
+    {
+        jr_put(rq, (uint32_t)((v < 0) ? v - 1 : v) & ((1U << s) - 1), s);
+    }
+}
+
+/**
+ * @brief       系数按量化步长比例重新量化(四舍五入)
+ * @param       v     : 源系数
+ * @param       ratio : 源步长 / 输出步长(16.16)
+ * @param       lim   : 输出绝对值上限
+ * @retval      输出系数
+ */
+static inline int32_t jr_scale(int32_t v, uint32_t ratio, int32_t lim)
+{
+    int32_t a = (int32_t)(((uint32_t)((v < 0) ? -v : v) * ratio + 0x8000) >> 16);
+
+    a = (a > lim) ? lim : a;
+    return (v < 0) ? -a : a;
+}
+
+/**
+ * @brief       系数的附加位数
+ * @param       v : 系数(非零)
+ * @retval      位数(1~11)
+ */
+static inline int jr_nbits(int32_t v)
+{
+    return 32 - __builtin_clz((uint32_t)((v < 0) ? -v : v));
+}
+
+/**
+ * @brief       重新量化并熵编码一个块
+ * @param       rq   : 转码状态
+ * @param       comp : 分量号
+ * @param       zz   : 源量化系数(之字形顺序)
+ * @retval      无
+ */
+static void jr_encode_block(jpg_requant_t *rq, uint8_t comp, const int16_t *zz)
+{
+    const uint32_t *ratio = rq->ratio[rq->jd.comp[comp].tq];
+    int dc_t = (comp == 0) ? 0 : 1;
+    int ac_t = dc_t + 2;
+    int run = 0;
+    int32_t v;
+
+    v = jr_scale(zz[0], ratio[0], 1023);
+    jr_put_sym(rq, dc_t, (v == rq->pred[comp]) ? 0 : jr_nbits(v - rq->pred[comp]), v - rq->pred[comp]);
+    rq->pred[comp] = (int16_t)v;
+
+    for (int k = 1; k < 64; k++)
+    {
+        v = (zz[k] != 0) ? jr_scale(zz[k], ratio[k], 1023) : 0;
+
+        if (v == 0)
+        {
+            run++;                                                  /* 变得更粗后归零的系数并入游程 */
+            continue;
+        }
+
+        while (run > 15)
+        {
+            jr_put_sym(rq, ac_t, 0xF0, 0);                          /* ZRL */
+            run -= 16;
+        }
+
+        jr_put_sym(rq, ac_t, (run << 4) | jr_nbits(v), v);
+        run = 0;
+    }
+
+    if (run > 0)
+    {
+        jr_put_sym(rq, ac_t, 0x00, 0);                              /* EOB */
+    }
+}
+
+/**
+ * @brief       重新量化并熵编码一个块(jpg_fast_coefs 的回调)
+ * @param       arg  : 转码状态
+ * @param       comp : 分量号
+ * @param       zz   : 源量化系数(之字形顺序)
+ * @retval      true:继续; false:输出缓冲已满
+ */
+static bool jr_block(void *arg, uint8_t comp, const int16_t *zz)
+{
+    jpg_requant_t *rq = (jpg_requant_t *)arg;
+
+    jr_encode_block(rq, comp, zz);
+    return rq->pos <= rq->cap;
+}
+
+/**
+ * @brief       比特缓冲中剩余的位用1填充到字节边界(重同步标记与EOI之前)
+ * @param       rq : 转码状态
+ * @retval      无
+ */
+static void jr_flush_bits(jpg_requant_t *rq)
+{
+    if (rq->bits > 0)
+    {
+        jr_put(rq, (1U << (8 - rq->bits)) - 1, 8 - rq->bits);
+    }
+}
+
+/**
+ * @brief       按质量建立输出量化表与重新量化比例
+ * @param       rq      : 转码状态(jd 已解析文件头)
+ * @param       quality : 质量(1~100)
+ * @param       used    : 输出被分量引用的量化表(位图)
+ * @retval      true:成功; false:源量化表为16位精度(基线输出不支持)
+ */
+static bool jr_build_tables(jpg_requant_t *rq, uint8_t quality, uint32_t *used)
+{
+    int32_t scale = (quality < 50) ? 5000 / quality : 200 - quality * 2;
+
+    *used = 0;
+
+    for (int c = 0; c < rq->jd.ncomp; c++)
+    {
+        *used |= 1U << rq->jd.comp[c].tq;
+    }
+
+    for (int t = 0; t < 4; t++)
+    {
+        const uint8_t *std = g_jr_std_qt[(rq->jd.comp[0].tq == t) ? 0 : 1];
+
+        if (!(*used & (1U << t)))
+        {
+            continue;
+        }
+
+        for (int k = 0; k < 64; k++)
+        {
+            uint32_t q = rq->jd.qt[t][k];
+            int32_t n = (std[k] * scale + 50) / 100;
+
+            if (q == 0 || q > 255)
+            {
+                return false;
+            }
+
+            n = (n < 1) ? 1 : ((n > 255) ? 255 : n);
+            n = ((uint32_t)n < q) ? (int32_t)q : n;                 /* 不比源表更细 */
+            rq->qt[t][k] = (uint8_t)n;
+            rq->ratio[t][k] = (q << 16) / (uint32_t)n;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief       输出文件头: SOI, DQT, SOF0, DHT(标准表), [DRI], SOS
+ * @param       rq      : 转码状态
+ * @param       used    : 被引用的量化表(位图)
+ * @param       restart : 重同步间隔(MCU数), 0:不输出DRI
+ * @param       width   : 输出宽度
+ * @param       height  : 输出高度
+ * @retval      无
+ */
+static void jr_write_header(jpg_requant_t *rq, uint32_t used, uint16_t restart, uint16_t width, uint16_t height)
+{
+    const jpg_fast_t *jd = &rq->jd;
+    int n = 0;
+    int len = 0;
+
+    jr_be16(rq, 0xFFD8);
+
+    for (int t = 0; t < 4; t++)
+    {
+        n += (used >> t) & 1;
+    }
+
+    jr_be16(rq, 0xFFDB);
+    jr_be16(rq, (uint16_t)(2 + 65 * n));
+
+    for (int t = 0; t < 4; t++)
+    {
+        if (used & (1U << t))
+        {
+            jr_byte(rq, (uint8_t)t);                                /* 8位精度 */
+
+            for (int k = 0; k < 64; k++)
+            {
+                jr_byte(rq, rq->qt[t][k]);
+            }
+        }
+    }
+
+    jr_be16(rq, 0xFFC0);
+    jr_be16(rq, (uint16_t)(8 + 3 * jd->ncomp));
+    jr_byte(rq, 8);
+    jr_be16(rq, height);
+    jr_be16(rq, width);
+    jr_byte(rq, jd->ncomp);
+
+    for (int c = 0; c < jd->ncomp; c++)
+    {
+        jr_byte(rq, jd->comp[c].id);
+        jr_byte(rq, (uint8_t)((jd->comp[c].h << 4) | jd->comp[c].v));
+        jr_byte(rq, jd->comp[c].tq);
+    }
+
+    for (int t = 0; t < 4; t++)
+    {
+        len += 17 + ((t < 2) ? 12 : 162);
+    }
+
+    jr_be16(rq, 0xFFC4);
+    jr_be16(rq, (uint16_t)(2 + len));
+
+    for (int t = 0; t < 4; t++)
+    {
+        const uint8_t *vals = (t < 2) ? g_jr_dc_val : g_jr_ac_val[t - 2];
+        int count = (t < 2) ? 12 : 162;
+
+        jr_byte(rq, (uint8_t)(((t >> 1) << 4) | (t & 1)));         /* 类别(DC/AC) << 4 | 表号(亮度/色度) */
+
+        for (int i = 0; i < 16; i++)
+        {
+            jr_byte(rq, g_jr_bits[t][i]);
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            jr_byte(rq, vals[i]);
+        }
+    }
+
+    if (restart != 0)
+    {
+        jr_be16(rq, 0xFFDD);
+        jr_be16(rq, 4);
+        jr_be16(rq, restart);
+    }
+
+    jr_be16(rq, 0xFFDA);
+    jr_be16(rq, (uint16_t)(6 + 2 * jd->ncomp));
+    jr_byte(rq, jd->ncomp);
+
+    for (int c = 0; c < jd->ncomp; c++)
+    {
+        jr_byte(rq, jd->comp[c].id);
+        jr_byte(rq, (c == 0) ? 0x00 : 0x11);
+    }
+
+    jr_byte(rq, 0);                                                 /* 谱选择 0~63, 逐次逼近 0 */
+    jr_byte(rq, 63);
+    jr_byte(rq, 0);
+}
+
+/**
+ * @brief       转码一帧
+ * @param       rq      : 转码状态
+ * @param       src     : 源JPEG
+ * @param       len     : 源长度
+ * @param       quality : 输出质量(1~100, 数值越大质量越高; 不高于源图)
+ * @param       out     : 输出缓冲
+ * @param       cap     : 输出缓冲大小
+ * @param       out_len : 输出长度
+ * @retval      JPG_REQUANT_OK / JPG_REQUANT_UNSUPPORTED / JPG_REQUANT_OVERFLOW
+ */
+int jpg_requant(jpg_requant_t *rq, const uint8_t *src, size_t len, uint8_t quality,
+                uint8_t *out, size_t cap, size_t *out_len)
+{
+    uint32_t used;
+    int ret;
+
+    if (!g_jr_code_ready)
+    {
+        jr_build_codes();
+    }
+
+    quality = (quality < 1) ? 1 : ((quality > 100) ? 100 : quality);
+
+    if (!jpg_fast_prepare(&rq->jd, src, len) || !jr_build_tables(rq, quality, &used))
+    {
+        return JPG_REQUANT_UNSUPPORTED;
+    }
+
+    rq->out = out;
+    rq->cap = cap;
+    rq->pos = 0;
+    rq->bitbuf = 0;
+    rq->bits = 0;
+    memset(rq->pred, 0, sizeof(rq->pred));
+
+    jr_write_header(rq, used, 0, rq->jd.width, rq->jd.height);
+    ret = jpg_fast_coefs(&rq->jd, jr_block, rq);
+
+    if (ret == JPG_FAST_ERR)
+    {
+        return JPG_REQUANT_UNSUPPORTED;
+    }
+
+    jr_flush_bits(rq);
+    jr_be16(rq, 0xFFD9);
+    *out_len = rq->pos;
+
+    return (ret == JPG_FAST_OK && rq->pos <= cap) ? JPG_REQUANT_OK : JPG_REQUANT_OVERFLOW;
+}
+
+/**
+ * @brief       一个分块的块全部到齐: 变化或完整帧时编码输出并更新参考DC, 否则丢弃
+ * @param       jt : 分块状态
+ * @retval      true:继续; false:输出缓冲已满
+ */
+static bool jt_tile_done(jpg_tiles_t *jt)
+{
+    jpg_requant_t *rq = &jt->rq;
+    size_t start = rq->pos;
+    size_t len;
+
+    if (jt->key || jt->dirty)
+    {
+        if (!jt->key)
+        {
+            jr_be16(rq, 0);                                         /* jpg_tile_entry_t, 编码后回填 */
+            jr_be16(rq, 0);
+        }
+
+        memset(rq->pred, 0, sizeof(rq->pred));                      /* 每个分块是一个重同步间隔, DC预测从0开始 */
+
+        for (uint16_t i = 0; i < jt->nblk; i++)
+        {
+            jr_encode_block(rq, jt->comp[i], jt->coef[i]);
+        }
+
+        jr_flush_bits(rq);
+
+        if (jt->key && jt->tile + 1 < jt->tiles)
+        {
+            jr_be16(rq, (uint16_t)(0xFFD0 + (jt->tile & 7)));       /* RST0~7 循环 */
+        }
+        else if (!jt->key)
+        {
+            len = rq->pos - start - sizeof(jpg_tile_entry_t);
+
+            if (len > 0xFFFF)
+            {
+                return false;
+            }
+
+            if (rq->pos <= rq->cap)
+            {
+                rq->out[start + 0] = (uint8_t)jt->tile;             /* 小端 */
+                rq->out[start + 1] = (uint8_t)(jt->tile >> 8);
+                rq->out[start + 2] = (uint8_t)len;
+                rq->out[start + 3] = (uint8_t)(len >> 8);
+            }
+        }
+
+        memcpy(&jt->ref[jt->blk], jt->dc, jt->nblk * sizeof(jt->dc[0]));
+        jt->count++;
+    }
+
+    jt->blk += jt->nblk;
+    jt->tile++;
+    jt->nblk = 0;
+    jt->dirty = false;
+
+    return rq->pos <= rq->cap;
+}
+
+/**
+ * @brief       缓存一个分块内的块并比较DC(jpg_fast_coefs 的回调)
+ * @param       arg  : 分块状态
+ * @param       comp : 分量号
+ * @param       zz   : 源量化系数(之字形顺序)
+ * @retval      true:继续; false:输出缓冲已满
+ */
+static bool jt_block(void *arg, uint8_t comp, const int16_t *zz)
+{
+    jpg_tiles_t *jt = (jpg_tiles_t *)arg;
+    const jpg_fast_t *jd = &jt->rq.jd;
+    uint16_t n = jt->nblk;
+    int32_t dc = (int32_t)zz[0] * jd->qt[jd->comp[comp].tq][0];    /* 反量化, 与量化表无关 */
+    int32_t diff = dc - jt->ref[jt->blk + n];
+
+    memcpy(jt->coef[n], zz, sizeof(jt->coef[n]));
+    jt->comp[n] = comp;
+    jt->dc[n] = (int16_t)dc;
+
+    if (diff > JPG_TILES_DC_THRESH || diff < -JPG_TILES_DC_THRESH)
+    {
+        jt->dirty = true;
+    }
+
+    jt->nblk++;
+
+    return (jt->nblk < jt->tile_blocks) ? true : jt_tile_done(jt);
+}
+
+/**
+ * @brief       下一帧强制为完整帧(连接重建、发送失败后调用)
+ * @param       jt : 分块状态
+ * @retval      无
+ */
+void jpg_tiles_reset(jpg_tiles_t *jt)
+{
+    jt->valid = false;
+}
+
+/**
+ * @brief       按分块编码一帧: 完整帧, 或只含DC变化的分块的增量帧
+ * @note        jt->ref/ref_cap 由调用者分配(每个8x8块一项, 不少于 (宽/8)x(高/8)x3 时任何采样格式都够用)
+ * @param       jt      : 分块状态
+ * @param       src     : 源JPEG
+ * @param       len     : 源长度
+ * @param       quality : 输出质量(1~100, 100:沿用源量化表, 图像无损)
+ * @param       out     : 输出缓冲
+ * @param       cap     : 输出缓冲大小
+ * @param       out_len : 输出长度
+ * @param       key     : 输出 true:完整帧(带DRI的JPEG); false:增量帧(jpg_tiles_delta_t)
+ * @retval      JPG_REQUANT_OK / JPG_REQUANT_UNSUPPORTED / JPG_REQUANT_OVERFLOW
+ */
+int jpg_tiles_encode(jpg_tiles_t *jt, const uint8_t *src, size_t len, uint8_t quality,
+                     uint8_t *out, size_t cap, size_t *out_len, bool *key)
+{
+    jpg_requant_t *rq = &jt->rq;
+    const jpg_fast_t *jd = &rq->jd;
+    uint32_t used;
+    uint32_t hash = 2166136261u;                                    /* FNV-1a: 量化表、尺寸与采样格式 */
+    uint32_t mcus_x;
+    uint32_t mcus;
+    uint32_t bpm = 0;
+    int ret;
+
+    if (!g_jr_code_ready)
+    {
+        jr_build_codes();
+    }
+
+    quality = (quality < 1) ? 1 : ((quality > 100) ? 100 : quality);
+
+    if (!jpg_fast_prepare(&rq->jd, src, len) || !jr_build_tables(rq, quality, &used))
+    {
+        jt->valid = false;
+        return JPG_REQUANT_UNSUPPORTED;
+    }
+
+    for (int c = 0; c < jd->ncomp; c++)
+    {
+        bpm += jd->comp[c].h * jd->comp[c].v;
+        hash = (hash ^ (uint32_t)((jd->comp[c].h << 12) | (jd->comp[c].v << 8) | jd->comp[c].tq)) * 16777619u;
+    }
+
+    mcus_x = (jd->width + jd->comp[0].h * 8 - 1) / (jd->comp[0].h * 8);
+    mcus = mcus_x * ((jd->height + jd->comp[0].v * 8 - 1) / (jd->comp[0].v * 8));
+    jt->tile_mcus = JPG_TILES_MCUS_MAX;
+
+    while (mcus_x % jt->tile_mcus != 0)
+    {
+        jt->tile_mcus--;                                            /* 分块不跨MCU行, 重同步间隔即分块 */
+    }
+
+    if (mcus * bpm > jt->ref_cap || mcus / jt->tile_mcus > 0xFFFF || jt->tile_mcus * bpm > JPG_TILES_BLOCKS_MAX)
+    {
+        jt->valid = false;
+        return JPG_REQUANT_UNSUPPORTED;
+    }
+
+    hash = (hash ^ ((uint32_t)jd->width << 16 | jd->height)) * 16777619u;
+
+    for (int t = 0; t < 4; t++)
+    {
+        for (int k = 0; (used & (1U << t)) && k < 64; k++)
+        {
+            hash = (hash ^ rq->qt[t][k]) * 16777619u;
+        }
+    }
+
+    jt->key = !jt->valid || hash != jt->hdr_hash || jt->since_key >= JPG_TILES_REFRESH;
+    jt->valid = false;                                              /* 成功输出后才置位 */
+    jt->tiles = (uint16_t)(mcus / jt->tile_mcus);
+    jt->tile_blocks = (uint16_t)(jt->tile_mcus * bpm);
+    jt->tile = 0;
+    jt->blk = 0;
+    jt->nblk = 0;
+    jt->count = 0;
+    jt->dirty = false;
+
+    rq->out = out;
+    rq->cap = cap;
+    rq->pos = 0;
+    rq->bitbuf = 0;
+    rq->bits = 0;
+
+    if (jt->key)
+    {
+        jr_write_header(rq, used, jt->tile_mcus, jd->width, jd->height);
+    }
+    else
+    {
+        jr_be16(rq, 0);                                             /* jpg_tiles_delta_t, 编码后回填 */
+        jr_be16(rq, 0);
+    }
+
+    ret = jpg_fast_coefs(&rq->jd, jt_block, jt);
+
+    if (ret == JPG_FAST_ERR || (ret == JPG_FAST_OK && jt->tile != jt->tiles))
+    {
+        return JPG_REQUANT_UNSUPPORTED;
+    }
+
+    if (jt->key)
+    {
+        jr_be16(rq, 0xFFD9);
+    }
+    else if (cap >= sizeof(jpg_tiles_delta_t))
+    {
+        out[0] = (uint8_t)jt->tiles;
+        out[1] = (uint8_t)(jt->tiles >> 8);
+        out[2] = (uint8_t)jt->count;
+        out[3] = (uint8_t)(jt->count >> 8);
+    }
+
+    *out_len = rq->pos;
+    *key = jt->key;
+
+    if (ret != JPG_FAST_OK || rq->pos > cap)
+    {
+        return JPG_REQUANT_OVERFLOW;
+    }
+
+    jt->valid = true;
+    jt->since_key = jt->key ? 1 : jt->since_key + 1;
+    jt->hdr_hash = hash;
+
+    return JPG_REQUANT_OK;
+}
+
+/**
+ * @brief       把转码状态的输出切换到第 i 个裁剪区域(保存当前区域的位缓冲与DC预测值)
+ * @param       jc : 裁剪状态
+ * @param       i  : 区域序号
+ * @retval      无
+ */
+static void jc_switch(jpg_crop_t *jc, int i)
+{
+    jpg_requant_t *rq = &jc->rq;
+    jpg_crop_reg_t *r;
+
+    if (jc->cur == i)
+    {
+        return;
+    }
+
+    if (jc->cur >= 0)
+    {
+        r = &jc->reg[jc->cur];
+        r->pos = rq->pos;
+        r->bitbuf = rq->bitbuf;
+        r->bits = rq->bits;
+        memcpy(r->pred, rq->pred, sizeof(r->pred));
+    }
+
+    r = &jc->reg[i];
+    rq->out = r->out;
+    rq->cap = r->cap;
+    rq->pos = r->pos;
+    rq->bitbuf = r->bitbuf;
+    rq->bits = r->bits;
+    memcpy(rq->pred, r->pred, sizeof(rq->pred));
+    jc->cur = i;
+}
+
+/**
+ * @brief       区域内的块重新熵编码到对应区域, 区域外的块只解码(jpg_fast_coefs 的回调)
+ * @note        DC以绝对值给出, 每个区域各自计算差分, 区域左边缘的块即得到新的DC差分
+ * @param       arg  : 裁剪状态
+ * @param       comp : 分量号
+ * @param       zz   : 源量化系数(之字形顺序)
+ * @retval      true:继续; false:已过最后一个区域的底边
+ */
+static bool jc_block(void *arg, uint8_t comp, const int16_t *zz)
+{
+    jpg_crop_t *jc = (jpg_crop_t *)arg;
+
+    for (int i = 0; i < jc->count; i++)
+    {
+        const jpg_crop_reg_t *r = &jc->reg[i];
+
+        if (jc->mx >= r->mx0 && jc->mx < r->mx1 && jc->my >= r->my0 && jc->my < r->my1)
+        {
+            jc_switch(jc, i);
+            jr_encode_block(&jc->rq, comp, zz);
+        }
+    }
+
+    if (++jc->nblk == jc->bpm)
+    {
+        jc->nblk = 0;
+
+        if (++jc->mx == jc->mcus_x)
+        {
+            jc->mx = 0;
+            jc->my++;
+        }
+    }
+
+    return jc->my < jc->my_end;
+}
+
+/**
+ * @brief       压缩域裁剪: 一次霍夫曼解码输出若干个MCU对齐的子区域JPEG
+ * @note        区域向外对齐到MCU(4:2:0为16x16), 对齐后的位置与尺寸写回 rects; 解码到最后一个区域的底边即结束.
+ *              区域内的系数按 quality 重新量化(100:沿用源量化表, 系数不变), 以标准霍夫曼表重新编码
+ * @param       jc      : 裁剪状态
+ * @param       src     : 源JPEG
+ * @param       len     : 源长度
+ * @param       quality : 输出质量(1~100)
+ * @param       rects   : 裁剪区域(像素)与各自的输出缓冲, 各区域的 ret 为 JPG_REQUANT_OK / JPG_REQUANT_OVERFLOW
+ * @param       count   : 区域数(不超过 JPG_CROP_MAX)
+ * @retval      JPG_REQUANT_OK / JPG_REQUANT_UNSUPPORTED(格式不支持、数据错误或区域超出图像)
+ */
+int jpg_crop(jpg_crop_t *jc, const uint8_t *src, size_t len, uint8_t quality, jpg_crop_rect_t *rects, int count)
+{
+    jpg_requant_t *rq = &jc->rq;
+    const jpg_fast_t *jd = &rq->jd;
+    uint32_t used;
+    uint16_t mcu_w;
+    uint16_t mcu_h;
+    int ret;
+
+    if (!g_jr_code_ready)
+    {
+        jr_build_codes();
+    }
+
+    quality = (quality < 1) ? 1 : ((quality > 100) ? 100 : quality);
+
+    if (count < 1 || count > JPG_CROP_MAX || !jpg_fast_prepare(&rq->jd, src, len) || !jr_build_tables(rq, quality, &used))
+    {
+        return JPG_REQUANT_UNSUPPORTED;
+    }
+
+    mcu_w = jd->comp[0].h * 8;
+    mcu_h = jd->comp[0].v * 8;
+    jc->bpm = 0;
+
+    for (int c = 0; c < jd->ncomp; c++)
+    {
+        jc->bpm += jd->comp[c].h * jd->comp[c].v;
+    }
+
+    jc->mcus_x = (jd->width + mcu_w - 1) / mcu_w;
+    jc->count = count;
+    jc->cur = -1;
+    jc->mx = 0;
+    jc->my = 0;
+    jc->nblk = 0;
+    jc->my_end = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        jpg_crop_rect_t *rc = &rects[i];
+        jpg_crop_reg_t *r = &jc->reg[i];
+
+        if (rc->w == 0 || rc->h == 0 || (uint32_t)rc->x + rc->w > jd->width || (uint32_t)rc->y + rc->h > jd->height)
+        {
+            return JPG_REQUANT_UNSUPPORTED;
+        }
+
+        r->mx0 = rc->x / mcu_w;
+        r->my0 = rc->y / mcu_h;
+        r->mx1 = (rc->x + rc->w + mcu_w - 1) / mcu_w;
+        r->my1 = (rc->y + rc->h + mcu_h - 1) / mcu_h;
+        r->out = rc->out;
+        r->cap = rc->cap;
+        r->pos = 0;
+        r->bitbuf = 0;
+        r->bits = 0;
+        memset(r->pred, 0, sizeof(r->pred));
+        jc->my_end = (r->my1 > jc->my_end) ? r->my1 : jc->my_end;
+
+        /* 右/下边缘的MCU只有一部分在图像内, 输出尺寸截到图像边界 */
+        rc->x = r->mx0 * mcu_w;
+        rc->y = r->my0 * mcu_h;
+        rc->w = (uint16_t)(((r->mx1 * mcu_w > jd->width) ? jd->width : r->mx1 * mcu_w) - rc->x);
+        rc->h = (uint16_t)(((r->my1 * mcu_h > jd->height) ? jd->height : r->my1 * mcu_h) - rc->y);
+
+        jc_switch(jc, i);
+        jr_write_header(rq, used, 0, rc->w, rc->h);
+    }
+
+    ret = jpg_fast_coefs(&rq->jd, jc_block, jc);
+
+    if (ret == JPG_FAST_ERR || jc->my < jc->my_end)
+    {
+        return JPG_REQUANT_UNSUPPORTED;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        jc_switch(jc, i);
+        jr_flush_bits(rq);
+        jr_be16(rq, 0xFFD9);
+        rects[i].len = rq->pos;
+        rects[i].ret = (rq->pos <= rq->cap) ? JPG_REQUANT_OK : JPG_REQUANT_OVERFLOW;
+    }
+
+    return JPG_REQUANT_OK;
+}
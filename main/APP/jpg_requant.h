@@ -0,0 +1,164 @@
+/**
+ ****************************************************************************************************
+ * @file        jpg_requant.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       压缩域JPEG转码: 霍夫曼解码到量化系数, 换用更粗的量化表后重新熵编码(不做IDCT/DCT)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 给慢速客户端(或外网上行)一路码率更低的码流时, 不必解码到像素再用 jpge 重新编码:
+ * 1 jpg_fast_coefs() 逐块给出量化系数 v(源量化步长 q);
+ * 2 输出量化表取 IJG 标准表按 quality(1~100, 与 jpge 相同)缩放的结果, 且每项不小于源表
+ *   (不会比源图更细), 系数按 v * q / q' 四舍五入(16.16定点比例, 每帧建表一次);
+ * 3 以标准霍夫曼表(JPEG Annex K, 与 RFC 2435 接收端一致)重新编码, 输出不带重同步标记.
+ * 只有熵解码、每个非零系数一次乘法与熵编码, 与 tjpgd + jpge 的完整转码相比省去了IDCT、颜色转换、DCT与量化.
+ * 支持的格式与 jpg_fast 相同(基线、单扫描、色度1x1), 不支持时返回 JPG_REQUANT_UNSUPPORTED, 由调用者发送原图.
+ *
+ * jpg_tiles_encode() 为静态场景的条件补充: 每行MCU分成若干分块(每块 JPG_TILES_MCUS_MAX 个以内的相邻MCU),
+ * 完整帧为以分块为重同步间隔(DRI)的标准JPEG; 之后每帧只编码各8x8块DC(反量化后)与上次发送时相比变化超过
+ * JPG_TILES_DC_THRESH 的分块, 输出 jpg_tiles_delta_t 格式的增量帧, 接收端用这些分块替换上一帧对应的重同步间隔,
+ * 按顺序插入RST0~7后即为完整的JPEG. 表头变化(质量、分辨率)、每 JPG_TILES_REFRESH 帧或 jpg_tiles_reset() 后
+ * 发送完整帧. 未变化的分块只做霍夫曼解码, 不重新编码.
+ *
+ * jpg_crop() 为压缩域裁剪(不依赖传感器开窗, 任何输出JPEG的传感器都可用): 霍夫曼解码到区域的最后一行MCU为止,
+ * 区域内的块以源量化系数重新熵编码, 区域外的块只解码; 每个区域的DC差分各自从0开始计算, 区域左边缘的块
+ * 即换成相对区域内前一块的差分. 一次解码可同时输出 JPG_CROP_MAX 个区域, 区域按MCU向外对齐.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __JPG_REQUANT_H
+#define __JPG_REQUANT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "jpg_fast.h"
+
+
+#define JPG_REQUANT_EN              1                               /* 1:MJPEG/RTP 可按接收端设置转码质量 */
+
+#define JPG_TILES_MCUS_MAX          8                               /* 每个分块的MCU数上限(同一MCU行内相邻, 整除每行MCU数) */
+#define JPG_TILES_BLOCKS_MAX        (JPG_TILES_MCUS_MAX * 6)        /* 每个分块的8x8块数上限(4:2:0每MCU6块) */
+#define JPG_TILES_DC_THRESH         48                              /* 块的DC(反量化后)变化超过该值即发送该分块, 约为平均值变化6级 */
+#define JPG_TILES_REFRESH           150                             /* 每隔该帧数发送一帧完整帧 */
+
+/* jpg_requant() 返回值 */
+#define JPG_REQUANT_OK              0
+#define JPG_REQUANT_UNSUPPORTED     -1                              /* 格式不支持或数据错误 */
+#define JPG_REQUANT_OVERFLOW        -2                              /* 输出缓冲不足 */
+
+/* 转码状态(约8KB, 应位于内部RAM) */
+typedef struct
+{
+    jpg_fast_t jd;                                                  /* 霍夫曼解码 */
+    uint8_t qt[4][64];                                              /* 输出量化表(之字形顺序) */
+    uint32_t ratio[4][64];                                          /* 源量化步长 / 输出量化步长(16.16) */
+    int16_t pred[3];                                                /* 输出的DC预测值 */
+    uint8_t *out;                                                   /* 输出缓冲 */
+    size_t cap;
+    size_t pos;
+    uint32_t bitbuf;                                                /* 待输出的位(低位对齐) */
+    int bits;
+} jpg_requant_t;
+
+/* 分块增量帧的负载(小端): jpg_tiles_delta_t, 之后 count 个 { jpg_tile_entry_t, len 字节熵编码数据 } */
+typedef struct __attribute__((packed))
+{
+    uint16_t tiles;                                                 /* 整帧的分块数(与完整帧的重同步间隔数相同) */
+    uint16_t count;                                                 /* 本帧包含的分块数 */
+} jpg_tiles_delta_t;
+
+typedef struct __attribute__((packed))
+{
+    uint16_t index;                                                 /* 分块号(光栅顺序) */
+    uint16_t len;                                                   /* 熵编码数据长度(不含重同步标记) */
+} jpg_tile_entry_t;
+
+/* 分块编码状态(约15KB, 应位于内部RAM; ref 由调用者分配, 可在PSRAM) */
+typedef struct
+{
+    jpg_requant_t rq;
+    int16_t *ref;                                                   /* 各8x8块最近一次发送时的DC(反量化后) */
+    size_t ref_cap;                                                 /* ref 的项数 */
+    uint32_t hdr_hash;                                              /* 上一帧完整帧的量化表、尺寸与采样格式 */
+    uint16_t since_key;                                             /* 距上一帧完整帧的帧数 */
+    bool valid;                                                     /* false:下一帧须为完整帧 */
+    bool key;                                                       /* 以下为编码一帧时的状态 */
+    bool dirty;                                                     /* 当前分块有块的DC变化超过阈值 */
+    uint16_t tile_mcus;                                             /* 每个分块的MCU数 */
+    uint16_t tile_blocks;                                           /* 每个分块的8x8块数 */
+    uint16_t tiles;
+    uint16_t tile;                                                  /* 当前分块号 */
+    uint16_t count;                                                 /* 已输出的分块数 */
+    uint16_t nblk;                                                  /* 当前分块已缓存的块数 */
+    uint32_t blk;                                                   /* 当前分块第一个块的序号(整帧) */
+    uint8_t comp[JPG_TILES_BLOCKS_MAX];
+    int16_t dc[JPG_TILES_BLOCKS_MAX];
+    int16_t coef[JPG_TILES_BLOCKS_MAX][64];                         /* 当前分块的量化系数, 变化时才编码 */
+} jpg_tiles_t;
+
+#define JPG_CROP_MAX                4                               /* jpg_crop() 一次解码输出的区域数上限 */
+
+/* 裁剪区域与输出 */
+typedef struct
+{
+    uint16_t x;                                                     /* 左上角(像素), 返回时为对齐到MCU后的位置 */
+    uint16_t y;
+    uint16_t w;                                                     /* 宽高(像素), 返回时为输出图像的宽高 */
+    uint16_t h;
+    uint8_t *out;                                                   /* 输出缓冲 */
+    size_t cap;
+    size_t len;                                                     /* 输出长度 */
+    int ret;                                                        /* JPG_REQUANT_OK / JPG_REQUANT_OVERFLOW */
+} jpg_crop_rect_t;
+
+/* 一个裁剪区域的编码状态(当前区域的状态在 jpg_requant_t 中) */
+typedef struct
+{
+    uint16_t mx0;                                                   /* MCU范围 [mx0, mx1) x [my0, my1) */
+    uint16_t my0;
+    uint16_t mx1;
+    uint16_t my1;
+    uint8_t *out;
+    size_t cap;
+    size_t pos;
+    uint32_t bitbuf;
+    int bits;
+    int16_t pred[3];
+} jpg_crop_reg_t;
+
+/* 裁剪状态(约8KB, 应位于内部RAM) */
+typedef struct
+{
+    jpg_requant_t rq;
+    jpg_crop_reg_t reg[JPG_CROP_MAX];
+    int count;
+    int cur;                                                        /* rq 当前输出的区域, -1:无 */
+    uint16_t bpm;                                                   /* 每个MCU的块数 */
+    uint16_t nblk;                                                  /* 当前MCU已解码的块数 */
+    uint16_t mcus_x;
+    uint16_t mx;                                                    /* 当前MCU */
+    uint16_t my;
+    uint16_t my_end;                                                /* 最后一个区域底边的下一行MCU */
+} jpg_crop_t;
+
+/* 函数声明 */
+int jpg_requant(jpg_requant_t *rq, const uint8_t *src, size_t len, uint8_t quality,
+                uint8_t *out, size_t cap, size_t *out_len);         /* 转码一帧 */
+int jpg_tiles_encode(jpg_tiles_t *jt, const uint8_t *src, size_t len, uint8_t quality,
+                     uint8_t *out, size_t cap, size_t *out_len, bool *key);  /* 按分块编码一帧 */
+void jpg_tiles_reset(jpg_tiles_t *jt);                              /* 下一帧强制为完整帧 */
+int jpg_crop(jpg_crop_t *jc, const uint8_t *src, size_t len, uint8_t quality,
+             jpg_crop_rect_t *rects, int count);                    /* 压缩域裁剪出若干子区域 */
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ ****************************************************************************************************
+ * @file        jpg_sig.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       JPEG压缩域签名: 不解码, 以长度与熵编码数据的抽样哈希判断两帧是否几乎相同
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "jpg_sig.h"
+#include "jpeg_abbrev.h"
+#include <string.h>
+
+
+#define JPG_SIG_FNV_BASIS           2166136261u                     /* FNV-1a */
+#define JPG_SIG_FNV_PRIME           16777619u
+
+/**
+ * @brief       FNV-1a 哈希(按步长抽取字节)
+ * @param       hash : 初值
+ * @param       p    : 数据
+ * @param       n    : 抽取的字节数
+ * @param       step : 相邻两次抽取的间距
+ * @retval      哈希值
+ */
+static uint32_t jpg_sig_fnv(uint32_t hash, const uint8_t *p, size_t n, size_t step)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        hash = (hash ^ p[i * step]) * JPG_SIG_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief       计算一帧JPEG的签名(只读表头与熵编码数据中的抽样字节)
+ * @param       jpg    : JPEG数据
+ * @param       len    : 数据长度
+ * @param       width  : 图像宽度
+ * @param       height : 图像高度
+ * @param       sig    : 输出签名
+ * @retval      true:成功; false:不是JPEG或数据过短(sig->len 为0, 与任何帧都不相同)
+ */
+bool jpg_sig_compute(const uint8_t *jpg, size_t len, uint16_t width, uint16_t height, jpg_sig_t *sig)
+{
+    size_t sos = jpeg_abbrev_sos(jpg, len);
+    size_t start;
+    size_t seg;
+    size_t step;
+    size_t n;
+
+    memset(sig, 0, sizeof(*sig));
+
+    if (sos == 0 || sos + 4 > len)
+    {
+        return false;
+    }
+
+    start = sos + 2 + ((jpg[sos + 2] << 8) | jpg[sos + 3]);         /* SOS段之后为熵编码数据 */
+
+    if (start >= len || len - start < JPG_SIG_SEGS)
+    {
+        return false;
+    }
+
+    sig->width = width;
+    sig->height = height;
+    sig->hdr_hash = jpg_sig_fnv(JPG_SIG_FNV_BASIS, jpg, start, 1);
+    sig->len = (uint32_t)(len - start);
+    seg = sig->len / JPG_SIG_SEGS;
+    seg = (seg >= JPG_SIG_ALIGN) ? (seg & ~(size_t)(JPG_SIG_ALIGN - 1)) : seg;   /* 长度略有不同的两帧抽取相同的位置 */
+    n = (seg < JPG_SIG_SAMPLES) ? seg : JPG_SIG_SAMPLES;
+    step = seg / n;
+
+    for (int i = 0; i < JPG_SIG_SEGS; i++)
+    {
+        sig->hash[i] = jpg_sig_fnv(JPG_SIG_FNV_BASIS, jpg + start + i * seg, n, step);
+    }
+
+    return true;
+}
+
+/**
+ * @brief       判断两帧是否几乎相同
+ * @param       a : 签名
+ * @param       b : 签名
+ * @retval      true:宽高与表头相同, 长度相差不超过 JPG_SIG_LEN_PERMILLE, 不同的分段不超过 JPG_SIG_SEG_DIFF_MAX 个
+ */
+bool jpg_sig_similar(const jpg_sig_t *a, const jpg_sig_t *b)
+{
+    uint32_t diff;
+    int segs = 0;
+
+    if (a->len == 0 || b->len == 0 || a->width != b->width || a->height != b->height || a->hdr_hash != b->hdr_hash)
+    {
+        return false;
+    }
+
+    diff = (a->len > b->len) ? (a->len - b->len) : (b->len - a->len);
+
+    if ((uint64_t)diff * 1000 > (uint64_t)a->len * JPG_SIG_LEN_PERMILLE)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < JPG_SIG_SEGS; i++)
+    {
+        segs += (a->hash[i] != b->hash[i]);
+    }
+
+    return segs <= JPG_SIG_SEG_DIFF_MAX;
+}
@@ -0,0 +1,58 @@
+/**
+ ****************************************************************************************************
+ * @file        jpg_sig.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       JPEG压缩域签名: 不解码, 以长度与熵编码数据的抽样哈希判断两帧是否几乎相同
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 移动侦测(motion_detect)至少要解析Huffman码取DC系数; 本模块只读帧缓存中的少量字节, 作为更便宜的第一级判断:
+ * 签名 = 宽高 + 表头(SOI到SOS)的哈希 + 熵编码数据长度 + 熵编码数据分成 JPG_SIG_SEGS 段、每段等距抽取
+ * JPG_SIG_SAMPLES 个字节的哈希, 每帧只读约 JPG_SIG_SEGS x JPG_SIG_SAMPLES 个字节.
+ * 段长向下取整到 JPG_SIG_ALIGN 的倍数, 长度略有不同的两帧在相同的偏移抽样(末尾不足一段的数据只由长度反映).
+ * 熵编码数据逐字节从SOS之后开始对齐: 画面的某处变化后, 其后的数据整体错位, 对应的分段哈希都不相同.
+ * 因此"几乎相同"定义为: 宽高与表头相同, 长度相差不超过 JPG_SIG_LEN_PERMILLE, 不同的分段不超过
+ * JPG_SIG_SEG_DIFF_MAX 个(只允许画面底部少量变化, 或抽样未覆盖到的微小变化).
+ * 停车场、夜间等静止画面在高压缩比下熵编码数据往往逐字节相同, 用本模块即可在解码之前跳过这些帧.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __JPG_SIG_H
+#define __JPG_SIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+
+#define JPG_SIG_SEGS                16                              /* 熵编码数据的分段数 */
+#define JPG_SIG_SAMPLES             16                              /* 每段抽取的字节数 */
+#define JPG_SIG_ALIGN               64                              /* 段长向下取整到该值的倍数 */
+#define JPG_SIG_LEN_PERMILLE        4                               /* 长度相差不超过该千分比 */
+#define JPG_SIG_SEG_DIFF_MAX        1                               /* 允许不同的分段数 */
+
+/* 一帧的签名 */
+typedef struct
+{
+    uint16_t width;
+    uint16_t height;
+    uint32_t hdr_hash;                                              /* 表头(量化表、霍夫曼表、SOF等)的哈希 */
+    uint32_t len;                                                   /* 熵编码数据长度, 0:无效签名 */
+    uint32_t hash[JPG_SIG_SEGS];                                    /* 各段抽样的哈希 */
+} jpg_sig_t;
+
+/* 函数声明 */
+bool jpg_sig_compute(const uint8_t *jpg, size_t len, uint16_t width, uint16_t height, jpg_sig_t *sig);   /* 计算签名 */
+bool jpg_sig_similar(const jpg_sig_t *a, const jpg_sig_t *b);       /* 两帧是否几乎相同 */
+
+#endif
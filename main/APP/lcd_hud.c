@@ -0,0 +1,159 @@
+/**
+ ****************************************************************************************************
+ * @file        lcd_hud.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       LCD状态显示(帧率、码率、发送时延、RSSI、丢帧与剩余内存)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "lcd_hud.h"
+#include "task_topo.h"
+#include "metrics.h"
+#include "frame_stats.h"
+#include "heap_stats.h"
+#include "spilcd.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_wifi.h"
+#include "esp_camera.h"
+#include "esp_log.h"
+
+
+static char g_hud_text[LCD_HUD_LINES][LCD_HUD_COLS + 1];            /* 屏幕上当前显示的文本 */
+
+
+/**
+ * @brief       格式化一行并补齐到 LCD_HUD_COLS 个字符(超出部分截断)
+ * @param       line : 输出, LCD_HUD_COLS + 1 字节
+ * @param       fmt  : 格式
+ * @retval      无
+ */
+static void lcd_hud_format(char *line, const char *fmt, ...)
+{
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(line, LCD_HUD_COLS + 1, fmt, ap);
+    va_end(ap);
+
+    len = (len < 0) ? 0 : ((len > LCD_HUD_COLS) ? LCD_HUD_COLS : len);
+    memset(line + len, ' ', LCD_HUD_COLS - len);
+    line[LCD_HUD_COLS] = '\0';
+}
+
+/**
+ * @brief       读取各模块的统计并生成显示文本
+ * @param       text : 输出文本
+ * @retval      无
+ */
+static void lcd_hud_collect(char text[LCD_HUD_LINES][LCD_HUD_COLS + 1])
+{
+    metrics_snapshot_t snap;
+    heap_stats_caps_t caps[HEAP_STATS_CLASS_NUM];
+    wifi_ap_record_t ap;
+    camera_stats_t cs;
+    uint32_t p50 = 0;
+    uint32_t p99 = 0;
+    uint32_t drops;
+    int rssi = 0;
+
+    metrics_snapshot(&snap);
+    heap_stats_get(caps);
+    drops = snap.counters[METRIC_DROP_STALE] + snap.counters[METRIC_DROP_SEND_ERROR];
+
+    if (esp_camera_get_stats(&cs) == ESP_OK)
+    {
+        drops += cs.no_soi + cs.no_eoi + cs.fb_overflow + cs.fbq_overflow;
+    }
+
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+    {
+        rssi = ap.rssi;
+    }
+
+    frame_stats_latency(FRAME_STAGE_TX, &p50, &p99);
+
+    lcd_hud_format(text[0], "%4.1ffps %5lukbps %4ddBm", (double)snap.fps,
+                   (unsigned long)(snap.bitrate / 1000.0f), rssi);
+    lcd_hud_format(text[1], "tx%3lu/%3lums D%-4lu H%luK", (unsigned long)((p50 + 999) / 1000),
+                   (unsigned long)((p99 + 999) / 1000), (unsigned long)drops,
+                   (unsigned long)(caps[0].free_size / 1024));
+}
+
+/**
+ * @brief       状态显示线程函数
+ * @note        只重画与上一次不同的字符, 所有变化画完后一次刷新脏矩形
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void lcd_hud_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    static char text[LCD_HUD_LINES][LCD_HUD_COLS + 1];
+    TickType_t last = xTaskGetTickCount();
+
+    memset(g_hud_text, 0, sizeof(g_hud_text));                      /* 与任何字符都不同, 第一次全部画出 */
+
+    while (1)
+    {
+        lcd_hud_collect(text);
+
+        for (int i = 0; i < LCD_HUD_LINES; i++)
+        {
+            for (int j = 0; j < LCD_HUD_COLS; j++)
+            {
+                if (text[i][j] != g_hud_text[i][j])
+                {
+                    spilcd_fb_show_char(LCD_HUD_X + j * (LCD_HUD_FONT / 2), LCD_HUD_Y + i * LCD_HUD_FONT,
+                                        text[i][j], LCD_HUD_FONT, LCD_HUD_COLOR, WHITE);
+                    g_hud_text[i][j] = text[i][j];
+                }
+            }
+        }
+
+        spilcd_fb_flush();
+        vTaskDelayUntil(&last, pdMS_TO_TICKS(LCD_HUD_INTERVAL_MS));
+    }
+}
+
+/**
+ * @brief       创建状态显示线程
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_FAIL:创建线程失败; ESP_ERR_NOT_SUPPORTED:无屏(同样的数值见 /metrics)
+ */
+esp_err_t lcd_hud_init(void)
+{
+#if LCD_HUD_EN
+    static StackType_t stack[LCD_HUD_THREAD_STACK];                /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+
+    if (!spilcd_present())
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (xTaskCreateStaticPinnedToCore(lcd_hud_thread, "lcd_hud_thread", LCD_HUD_THREAD_STACK, NULL,
+                                      LCD_HUD_THREAD_PRIO, stack, &tcb, LCD_HUD_THREAD_CORE) == NULL)
+    {
+        ESP_LOGE("TAG", "lcd hud thread create failed");
+        return ESP_FAIL;
+    }
+#endif
+    return ESP_OK;
+}
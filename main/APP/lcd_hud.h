@@ -0,0 +1,46 @@
+/**
+ ****************************************************************************************************
+ * @file        lcd_hud.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       LCD状态显示(帧率、码率、发送时延、RSSI、丢帧与剩余内存)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 现场不接电脑时在屏幕左下角(连接状态文字下方, 取景窗口左侧)查看推流状态. 显示线程运行在核1(非网络核),
+ * 优先级低于取景与写卡, 每 LCD_HUD_INTERVAL_MS 读取一次 metrics_snapshot()(帧率/码率/丢帧)、
+ * frame_stats_latency()(发送阶段p50/p99, 最近一个完整统计窗口, 取所在桶的上界)、RSSI、
+ * esp_camera_get_stats()(驱动丢帧)与 heap_stats_get()(内部RAM/PSRAM剩余).
+ * 每行格式化为定长文本后与上一次逐字符比较, 只把变化的字符画到影子帧缓存(spilcd_fb_show_char),
+ * 再由 spilcd_fb_flush() 按合并后的脏矩形发送, 数值不变时没有SPI传输.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __LCD_HUD_H
+#define __LCD_HUD_H
+
+#include "esp_err.h"
+
+
+#define LCD_HUD_EN                  1                               /* 1:使能屏幕状态显示 */
+#define LCD_HUD_INTERVAL_MS         500                             /* 刷新间隔(2Hz) */
+#define LCD_HUD_X                   0                               /* 显示区域左上角(避开连接状态文字与取景窗口) */
+#define LCD_HUD_Y                   208
+#define LCD_HUD_FONT                12                              /* 字体大小, 12号字每字符6x12点 */
+#define LCD_HUD_LINES               2                               /* 行数 */
+#define LCD_HUD_COLS                26                              /* 每行字符数(12号字156点, 不进入取景窗口) */
+#define LCD_HUD_COLOR               0x001F                          /* 文字颜色(BLUE) */
+
+/* 函数声明 */
+esp_err_t lcd_hud_init(void);                                       /* 创建状态显示线程(LCD初始化之后调用) */
+
+#endif
@@ -0,0 +1,441 @@
+/**
+ ****************************************************************************************************
+ * @file        lcd_preview.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       SPILCD实时取景(JPEG分条解码 + 缩放旋转 + 双缓冲DMA刷屏)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "lcd_preview.h"
+#include "task_topo.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "heap_stats.h"
+#include "trace.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "img_converters.h"
+#include "rgb_resample.h"
+#include "spilcd.h"
+#include "pm_ctrl.h"
+#include "load_gov.h"
+
+
+#define LCD_PREVIEW_STRIP_NUM       2                               /* 条带缓存数量(双缓冲) */
+#define LCD_PREVIEW_WAIT_MS         100                             /* 等待条带缓存空闲的超时时间 */
+#define LCD_PREVIEW_SRC_W           (2 * (LCD_PREVIEW_W > LCD_PREVIEW_H ? LCD_PREVIEW_W : LCD_PREVIEW_H))   /* 解码条带的最大宽度(缩放阶段最多缩小2倍) */
+
+/* 一帧的解码状态 */
+typedef struct
+{
+    uint16_t *strip;                                                /* 持有但未发送的条带缓存, NULL:未持有 */
+    uint16_t x0;                                                    /* 输出图像在屏幕上的位置与大小 */
+    uint16_t y0;
+    uint16_t w;
+    uint16_t h;
+    bool ready;                                                     /* 缩放已初始化(第一个条带时) */
+} lcd_preview_ctx_t;
+
+static QueueHandle_t g_preview_queue = NULL;                        /* 发送线程 -> 取景线程, 长度1 */
+static SemaphoreHandle_t g_strip_free = NULL;                       /* 空闲条带缓存数(计数信号量, 条带发送完成时由SPILCD释放) */
+static uint16_t *g_strip_buf[LCD_PREVIEW_STRIP_NUM];
+static uint8_t g_strip_index = 0;
+static uint16_t *g_src_buf = NULL;                                  /* 解码条带(RGB565小端, 内部RAM), 缩放后写入 g_strip_buf */
+static int64_t g_preview_last_us = 0;                               /* 上一次提交取景的时间 */
+static esp_jpg_dec_t g_preview_dec;                                 /* 解码器工作区(内部RAM), 与移动侦测、双码流可同时解码 */
+static rgb_resample_t g_preview_rs;                                 /* 缩放旋转状态 */
+
+
+/**
+ * @brief       取得下一块空闲的条带缓存
+ * @param       ctx : 解码状态
+ * @retval      true:成功; false:超时
+ */
+static bool lcd_preview_strip_get(lcd_preview_ctx_t *ctx)
+{
+    int64_t start = esp_timer_get_time();
+    BaseType_t taken = xSemaphoreTake(g_strip_free, pdMS_TO_TICKS(LCD_PREVIEW_WAIT_MS));
+
+    trace_complete(TRACE_LCD_WAIT, start, esp_timer_get_time(), 0);    /* 条带全部在途时即等待SPI刷屏 */
+
+    if (taken != pdTRUE)
+    {
+        ctx->strip = NULL;
+        return false;
+    }
+
+    ctx->strip = g_strip_buf[g_strip_index];
+    g_strip_index = (g_strip_index + 1) % LCD_PREVIEW_STRIP_NUM;
+
+    return true;
+}
+
+/**
+ * @brief       缩放输出回调: 异步发送已缩放的矩形, 发送完成后SPILCD释放 g_strip_free 归还缓存, 再换上下一块条带缓存
+ * @param       arg : 解码状态
+ * @param       x   : 矩形位置与大小(相对于输出图像)
+ * @param       y
+ * @param       w
+ * @param       h
+ * @param       buf : 输出缓冲, 换成下一块条带缓存(已画满时为NULL)
+ * @retval      true:继续; false:没有空闲条带缓存, 结束
+ */
+static bool lcd_preview_out(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t **buf)
+{
+    lcd_preview_ctx_t *ctx = (lcd_preview_ctx_t *)arg;
+
+    if (spilcd_draw_bitmap_notify(ctx->x0 + x, ctx->y0 + y, ctx->x0 + x + w, ctx->y0 + y + h,
+                                  *buf, g_strip_free) != ESP_OK)
+    {
+        xSemaphoreGive(g_strip_free);                               /* 未发送, 直接归还 */
+    }
+
+    ctx->strip = NULL;
+    *buf = NULL;
+
+    if (rgb_resample_done(&g_preview_rs))
+    {
+        return true;                                                /* 已画满, 不再取缓存 */
+    }
+
+    if (!lcd_preview_strip_get(ctx))
+    {
+        return false;
+    }
+
+    *buf = ctx->strip;
+    return true;
+}
+
+/**
+ * @brief       条带回调: 把解码的条带送入缩放, 第一个条带时按缩放后的图像尺寸初始化
+ * @param       arg   : 解码状态
+ * @param       strip : 条带
+ * @retval      true:继续; false:取景窗口已画满或没有空闲条带缓存, 结束解码
+ */
+static bool lcd_preview_strip(void *arg, jpg_strip_t *strip)
+{
+    lcd_preview_ctx_t *ctx = (lcd_preview_ctx_t *)arg;
+
+    if (!ctx->ready)
+    {
+        if (!rgb_resample_init(&g_preview_rs, strip->width, strip->height, ctx->w, ctx->h,
+                               LCD_PREVIEW_ROTATE, LCD_PREVIEW_FILTER,
+                               ctx->strip, LCD_PREVIEW_W * LCD_PREVIEW_STRIP_LINES, lcd_preview_out, ctx))
+        {
+            return false;
+        }
+
+        ctx->ready = true;
+    }
+
+    return rgb_resample_rows(&g_preview_rs, (const uint16_t *)strip->data, strip->y, strip->lines);
+}
+
+/**
+ * @brief       计算输出图像在取景窗口(不超出屏幕)内的位置与大小(保持宽高比), 并选择解码缩放比例
+ * @note        解码缩放取使缩放后的图像不小于输出(旋转前)的最大比例, 缩放阶段最多缩小2倍; 解码宽度不超过 g_src_buf
+ * @param       fb  : 帧缓存
+ * @param       ctx : 解码状态, 写入输出位置与大小
+ * @retval      缩放比例
+ */
+static jpg_scale_t lcd_preview_plan(const camera_fb_t *fb, lcd_preview_ctx_t *ctx)
+{
+    bool swap = (LCD_PREVIEW_ROTATE == RGB_ROTATE_90 || LCD_PREVIEW_ROTATE == RGB_ROTATE_270);
+    uint32_t rw = swap ? fb->height : fb->width;                    /* 旋转后的源图像宽高 */
+    uint32_t rh = swap ? fb->width : fb->height;
+    uint16_t win_w = LCD_PREVIEW_W;
+    uint16_t win_h = LCD_PREVIEW_H;
+    uint16_t vw, vh;
+    jpg_scale_t scale = JPG_SCALE_NONE;
+
+    if (LCD_PREVIEW_X + win_w > spilcddev.width)                    /* 两种屏幕(SPI_LCD_TYPE)尺寸不同 */
+    {
+        win_w = (spilcddev.width > LCD_PREVIEW_X) ? spilcddev.width - LCD_PREVIEW_X : 0;
+    }
+
+    if (LCD_PREVIEW_Y + win_h > spilcddev.height)
+    {
+        win_h = (spilcddev.height > LCD_PREVIEW_Y) ? spilcddev.height - LCD_PREVIEW_Y : 0;
+    }
+
+    if (rw * win_h >= rh * win_w)
+    {
+        ctx->w = win_w;
+        ctx->h = (uint16_t)(rh * win_w / rw);
+    }
+    else
+    {
+        ctx->h = win_h;
+        ctx->w = (uint16_t)(rw * win_h / rh);
+    }
+
+    ctx->x0 = LCD_PREVIEW_X + (win_w - ctx->w) / 2;
+    ctx->y0 = LCD_PREVIEW_Y + (win_h - ctx->h) / 2;
+    vw = swap ? ctx->h : ctx->w;
+    vh = swap ? ctx->w : ctx->h;
+
+    while (scale < JPG_SCALE_MAX &&
+           (((fb->width >> (scale + 1)) >= vw && (fb->height >> (scale + 1)) >= vh) ||
+            (fb->width >> scale) > LCD_PREVIEW_SRC_W))
+    {
+        scale++;
+    }
+
+    return scale;
+}
+
+/**
+ * @brief       取景线程函数
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void lcd_preview_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    camera_fb_t *fb = NULL;
+    lcd_preview_ctx_t ctx;
+    jpg_scale_t scale;
+    int64_t start;
+
+    load_gov_watch(LOAD_GOV_PREVIEW);
+
+    while (1)
+    {
+        xQueueReceive(g_preview_queue, &fb, portMAX_DELAY);
+
+        pm_ctrl_acquire(PM_CTRL_LCD);                               /* 解码缩放期间CPU保持最高频率 */
+        start = esp_timer_get_time();
+        memset(&ctx, 0, sizeof(ctx));
+        scale = lcd_preview_plan(fb, &ctx);
+
+        if (ctx.w > 0 && ctx.h > 0 && lcd_preview_strip_get(&ctx) &&
+            !jpg2strips(&g_preview_dec, fb->buf, fb->len, scale, JPG_STRIP_RGB565,
+                         (uint8_t *)g_src_buf, LCD_PREVIEW_SRC_W * LCD_PREVIEW_STRIP_LINES * sizeof(uint16_t),
+                         LCD_PREVIEW_STRIP_LINES, lcd_preview_strip, &ctx))
+        {
+            ESP_LOGD("TAG", "preview decode failed");
+        }
+
+        if (ctx.strip != NULL)
+        {
+            xSemaphoreGive(g_strip_free);                           /* 中途失败时归还持有的条带 */
+        }
+
+        trace_complete(TRACE_LCD_DECODE, start, esp_timer_get_time(), (uint32_t)fb->len);
+        pm_ctrl_release(PM_CTRL_LCD);
+        esp_camera_fb_return(fb);
+    }
+}
+
+/**
+ * @brief       初始化取景线程
+ * @note        须在 spilcd_init 之后调用; 无屏时不申请条带缓存
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:内存不足; ESP_ERR_NOT_SUPPORTED:无屏
+ */
+esp_err_t lcd_preview_init(void)
+{
+#if LCD_PREVIEW_EN
+    static StaticQueue_t queue_buf;
+    static uint8_t queue_storage[sizeof(camera_fb_t *)];
+    static StaticSemaphore_t strip_free_buf;
+    static StackType_t stack[LCD_PREVIEW_THREAD_STACK];            /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+
+    if (!spilcd_present())
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    for (int i = 0; i < LCD_PREVIEW_STRIP_NUM; i++)
+    {
+        g_strip_buf[i] = heap_stats_malloc(HEAP_TAG_LCD_PREVIEW, LCD_PREVIEW_W * LCD_PREVIEW_STRIP_LINES * sizeof(uint16_t), MALLOC_CAP_DMA);
+
+        if (g_strip_buf[i] == NULL)
+        {
+            ESP_LOGE("TAG", "Memory for preview strip is not enough");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    g_src_buf = heap_stats_malloc(HEAP_TAG_LCD_PREVIEW, LCD_PREVIEW_SRC_W * LCD_PREVIEW_STRIP_LINES * sizeof(uint16_t),
+                                  MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+    if (g_src_buf == NULL)
+    {
+        ESP_LOGE("TAG", "Memory for preview strip is not enough");
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_strip_free = xSemaphoreCreateCountingStatic(LCD_PREVIEW_STRIP_NUM, LCD_PREVIEW_STRIP_NUM, &strip_free_buf);
+    g_preview_queue = xQueueCreateStatic(1, sizeof(camera_fb_t *), queue_storage, &queue_buf);
+    xTaskCreateStaticPinnedToCore(lcd_preview_thread, "lcd_preview_thread", LCD_PREVIEW_THREAD_STACK, NULL,
+                                  LCD_PREVIEW_THREAD_PRIO, stack, &tcb, LCD_PREVIEW_THREAD_CORE);
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief       提交一帧用于取景(发送线程调用, 不阻塞)
+ * @note        取景线程忙或未到刷新间隔(过载时由负载调控延长)时直接忽略; 否则增加帧的引用计数, 取景完成后由取景线程归还
+ * @param       fb : 帧缓存
+ * @retval      无
+ */
+void lcd_preview_offer(camera_fb_t *fb)
+{
+#if LCD_PREVIEW_EN
+    int64_t now = esp_timer_get_time();
+
+    if (g_preview_queue == NULL || fb->format != PIXFORMAT_JPEG ||
+        now - g_preview_last_us < (int64_t)LCD_PREVIEW_INTERVAL_MS * 1000 * load_gov_scale(LOAD_GOV_PREVIEW) ||
+        uxQueueSpacesAvailable(g_preview_queue) == 0)
+    {
+        return;
+    }
+
+    if (esp_camera_fb_acquire(fb) == NULL)
+    {
+        return;
+    }
+
+    if (xQueueSend(g_preview_queue, &fb, 0) != pdTRUE)
+    {
+        esp_camera_fb_return(fb);
+        return;
+    }
+
+    g_preview_last_us = now;
+#else
+    (void)fb;
+#endif
+}
+
+/**
+ * @brief       选择与屏幕尺寸最接近(不超过屏幕)的分辨率
+ * @param       无
+ * @retval      分辨率, FRAMESIZE_INVALID:没有可用的分辨率
+ */
+static framesize_t lcd_passthrough_size(void)
+{
+    framesize_t best = FRAMESIZE_INVALID;
+
+    for (int i = 0; i < FRAMESIZE_INVALID; i++)
+    {
+        if (resolution[i].width <= spilcddev.width && resolution[i].height <= spilcddev.height &&
+            (best == FRAMESIZE_INVALID ||
+             (uint32_t)resolution[i].width * resolution[i].height > (uint32_t)resolution[best].width * resolution[best].height))
+        {
+            best = (framesize_t)i;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief       本地取景直通模式: 摄像头RGB565帧直接DMA到LCD(在 app_main 中调用, 只在初始化失败时返回)
+ * @note        不推流; 屏幕上的状态文字被取景画面覆盖. 最多 LCD_PASSTHROUGH_FB_NUM - 1 帧同时在刷屏,
+ *              至少留一个帧缓存给驱动采集. 帧缓存在SPI发送完成前不归还, 发送期间不能被驱动改写
+ * @param       config : 摄像头配置(改为RGB565、屏幕尺寸后重新初始化)
+ * @retval      无
+ */
+void lcd_passthrough_run(camera_config_t *config)
+{
+    camera_fb_t *inflight[LCD_PASSTHROUGH_FB_NUM];
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(LCD_PASSTHROUGH_FB_NUM, 0);
+    framesize_t size = lcd_passthrough_size();
+    uint8_t head = 0;
+    uint8_t count = 0;
+    uint32_t frames = 0;
+    int64_t log_start;
+    int64_t now;
+    camera_fb_t *fb;
+    uint16_t x0;
+    uint16_t y0;
+
+    if (!spilcd_present())
+    {
+        ESP_LOGE("TAG", "passthrough: no LCD panel");
+        return;
+    }
+
+    if (done == NULL || size == FRAMESIZE_INVALID)
+    {
+        ESP_LOGE("TAG", "passthrough: no memory or no frame size fits %ux%u", spilcddev.width, spilcddev.height);
+        return;
+    }
+
+    esp_camera_deinit();
+    config->pixel_format = PIXFORMAT_RGB565;
+    config->frame_size = size;
+    config->fb_count = LCD_PASSTHROUGH_FB_NUM;
+    config->fb_location = CAMERA_FB_IN_PSRAM;
+    config->grab_mode = CAMERA_GRAB_LATEST;
+    config->swap_bytes = LCD_PASSTHROUGH_SENSOR_LE;                 /* LCD_CAM 在采集时换成高字节在前, 与LCD默认一致 */
+
+    if (esp_camera_init(config) != ESP_OK)
+    {
+        ESP_LOGE("TAG", "passthrough: camera setup failed");
+        return;
+    }
+
+    x0 = (spilcddev.width - resolution[size].width) / 2;
+    y0 = (spilcddev.height - resolution[size].height) / 2;
+    ESP_LOGI("TAG", "passthrough: %ux%u RGB565 at (%u, %u)", resolution[size].width, resolution[size].height, x0, y0);
+    log_start = esp_timer_get_time();
+
+    while (1)
+    {
+        fb = esp_camera_fb_get();
+
+        if (fb == NULL)
+        {
+            continue;
+        }
+
+        if (fb->format != PIXFORMAT_RGB565 || fb->width != resolution[size].width || fb->height != resolution[size].height ||
+            spilcd_draw_bitmap_notify(x0, y0, x0 + fb->width, y0 + fb->height, fb->buf, done) != ESP_OK)
+        {
+            esp_camera_fb_return(fb);
+            continue;
+        }
+
+        inflight[(head + count) % LCD_PASSTHROUGH_FB_NUM] = fb;
+        count++;
+
+        if (count >= LCD_PASSTHROUGH_FB_NUM - 1)                    /* 等待最早的一帧发送完成后归还 */
+        {
+            xSemaphoreTake(done, portMAX_DELAY);
+            esp_camera_fb_return(inflight[head]);
+            head = (head + 1) % LCD_PASSTHROUGH_FB_NUM;
+            count--;
+        }
+
+        frames++;
+        now = esp_timer_get_time();
+
+        if (now - log_start >= (int64_t)LCD_PASSTHROUGH_LOG_MS * 1000)
+        {
+            ESP_LOGI("TAG", "passthrough: %.1f fps", (double)frames * 1e6 / (double)(now - log_start));
+            frames = 0;
+            log_start = now;
+        }
+    }
+}
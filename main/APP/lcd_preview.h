@@ -0,0 +1,57 @@
+/**
+ ****************************************************************************************************
+ * @file        lcd_preview.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       SPILCD实时取景(JPEG分条解码 + 双缓冲DMA刷屏)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 发送线程通过 lcd_preview_offer() 把帧交给取景线程(增加一次引用计数, 不拷贝, 不阻塞).
+ * 取景线程运行在核1, 用 jpg2strips() 按 LCD_PREVIEW_STRIP_LINES 行的条带解码为RGB565, 每个条带经 rgb_resample
+ * 缩放(任意比例, 保持宽高比居中于取景窗口)与旋转(LCD_PREVIEW_ROTATE)后写入DMA条带缓存交给SPI发送, 两块条带缓存
+ * 交替使用: 一块在发送时缩放下一块; 解码缩放取不小于输出的最大比例, 缩放阶段最多缩小2倍, 全程没有整帧缓冲.
+ * 取景窗口超出屏幕(如 SPI_LCD_TYPE 为240x240)时裁到屏幕内; 窗口设为整屏即可以屏幕刷新率全屏取景
+ * LCD_PASSTHROUGH_EN 为1时为本地取景直通模式(不推流): lcd_passthrough_run() 把摄像头改为与屏幕同尺寸的RGB565,
+ * 字节序与LCD不同的传感器由摄像头驱动在采集时交换(camera_config_t.swap_bytes, LCD_CAM字节序), LCD保持默认,
+ * 帧缓存直接交给 esp_lcd_panel_draw_bitmap 由DMA从PSRAM
+ * 发送, CPU不处理像素; 一帧刷屏时驱动采集下一帧, 帧率受限于SPI(60MHz下QVGA整屏约20ms)
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __LCD_PREVIEW_H
+#define __LCD_PREVIEW_H
+
+#include "esp_camera.h"
+#include "rgb_resample.h"
+
+
+#define LCD_PREVIEW_EN              1                               /* 1:使能LCD实时取景 */
+#define LCD_PREVIEW_X               160                             /* 取景窗口位置与大小(避开状态文字区域) */
+#define LCD_PREVIEW_Y               110
+#define LCD_PREVIEW_W               160
+#define LCD_PREVIEW_H               120
+#define LCD_PREVIEW_STRIP_LINES     16                              /* 每个条带的行数(须为MCU高度的整数倍) */
+#define LCD_PREVIEW_ROTATE          RGB_ROTATE_0                    /* 取景画面旋转(顺时针), 见 rgb_rotate_t */
+#define LCD_PREVIEW_FILTER          RGB_FILTER_BILINEAR             /* 缩放插值, RGB_FILTER_NEAREST 更快 */
+#define LCD_PREVIEW_INTERVAL_MS     50                              /* 最小刷新间隔, 限制解码占用的CPU与帧缓存 */
+#define LCD_PASSTHROUGH_EN          0                               /* 1:本地取景直通模式, RGB565帧直接DMA到LCD, 不推流 */
+#define LCD_PASSTHROUGH_FB_NUM      3                               /* 直通模式的帧缓存数(最多 n-1 帧在刷屏) */
+#define LCD_PASSTHROUGH_SENSOR_LE   0                               /* 传感器RGB565字节序, 0:高字节在前(OV2640/OV3660/OV5640, 与LCD默认相同); 1:低字节在前, 由驱动交换 */
+#define LCD_PASSTHROUGH_LOG_MS      5000                            /* 直通模式输出帧率的间隔 */
+
+/* 函数声明 */
+esp_err_t lcd_preview_init(void);                                   /* 初始化取景线程 */
+void lcd_preview_offer(camera_fb_t *fb);                            /* 提交一帧用于取景(取景线程忙时忽略) */
+void lcd_passthrough_run(camera_config_t *config);                  /* 本地取景直通模式(只在初始化失败时返回) */
+
+#endif
@@ -0,0 +1,317 @@
+/**
+ ****************************************************************************************************
+ * @file        load_gov.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       负载调控(CPU或空口过载时按固定顺序降低次要流水线的负载, 音频不降级)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "load_gov.h"
+#include "task_topo.h"
+#include "rate_ctrl.h"
+#include "lwip_demo.h"
+#include "av_audio.h"
+#include "esp_camera.h"
+#include "esp_log.h"
+#include <string.h>
+
+
+/* 降级步骤 */
+typedef struct
+{
+    load_gov_target_t target;
+    uint8_t value;                                                  /* 取景/分析: 间隔倍数; 视频: JPEG质量放宽的步长 */
+} load_gov_step_t;
+
+/* 级别n生效前n个步骤, 同一流水线取最后一个生效的值; 调整顺序只需改动本表(不要加入 LOAD_GOV_AUDIO) */
+static const load_gov_step_t g_gov_steps[] =
+{
+    { LOAD_GOV_PREVIEW,   2 },                                      /* 取景帧率减半 */
+    { LOAD_GOV_PREVIEW,   4 },
+    { LOAD_GOV_ANALYTICS, 2 },                                      /* 分析频率减半 */
+    { LOAD_GOV_ANALYTICS, 4 },
+    { LOAD_GOV_VIDEO,     8 },                                      /* 放宽JPEG质量上限 */
+    { LOAD_GOV_VIDEO,     16 },
+};
+#define LOAD_GOV_STEP_NUM   (sizeof(g_gov_steps) / sizeof(g_gov_steps[0]))
+
+static const char *g_gov_target_name[LOAD_GOV_TARGET_NUM] = { "preview", "analytics", "video", "audio" };
+
+static portMUX_TYPE g_gov_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t g_gov_task[LOAD_GOV_TARGET_NUM][LOAD_GOV_TASK_MAX];    /* 登记的线程 */
+static task_topo_cursor_t g_gov_cursor[LOAD_GOV_TARGET_NUM][LOAD_GOV_TASK_MAX];
+static task_topo_cursor_t g_gov_idle_cursor[portNUM_PROCESSORS];
+static volatile uint8_t g_gov_scale[LOAD_GOV_TARGET_NUM] = { 1, 1, 1, 1 };
+static load_gov_stats_t g_gov_stats;
+
+
+/**
+ * @brief       切换级别, 下发各流水线的降级参数
+ * @param       level : 新级别(0 ~ LOAD_GOV_STEP_NUM)
+ * @retval      无
+ */
+static void load_gov_apply(uint8_t level)
+{
+    uint8_t value[LOAD_GOV_TARGET_NUM] = { 1, 1, 0, 1 };
+
+    for (uint8_t i = 0; i < level; i++)
+    {
+        value[g_gov_steps[i].target] = g_gov_steps[i].value;
+    }
+
+    g_gov_scale[LOAD_GOV_PREVIEW] = value[LOAD_GOV_PREVIEW];
+    g_gov_scale[LOAD_GOV_ANALYTICS] = value[LOAD_GOV_ANALYTICS];
+    rate_ctrl_shed(value[LOAD_GOV_VIDEO]);
+
+    portENTER_CRITICAL(&g_gov_mux);
+
+    if (level > g_gov_stats.level)
+    {
+        g_gov_stats.raises++;
+    }
+
+    g_gov_stats.level = level;
+    g_gov_stats.level_max = (level > g_gov_stats.level_max) ? level : g_gov_stats.level_max;
+    portEXIT_CRITICAL(&g_gov_mux);
+}
+
+/**
+ * @brief       采样各核与各流水线登记线程的CPU占用
+ * @param       core_load : 输出各核占用(%)
+ * @param       task_load : 输出各流水线的占用之和(%)
+ * @retval      无
+ */
+static void load_gov_sample(float core_load[portNUM_PROCESSORS], float task_load[LOAD_GOV_TARGET_NUM])
+{
+    TaskHandle_t handle;
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        core_load[core] = 100.0f - task_topo_task_load(xTaskGetIdleTaskHandleForCore(core), &g_gov_idle_cursor[core]);
+    }
+
+    for (int t = 0; t < LOAD_GOV_TARGET_NUM; t++)
+    {
+        task_load[t] = 0;
+
+        for (int i = 0; i < LOAD_GOV_TASK_MAX; i++)
+        {
+            portENTER_CRITICAL(&g_gov_mux);
+            handle = g_gov_task[t][i];
+            portEXIT_CRITICAL(&g_gov_mux);
+
+            if (handle != NULL)
+            {
+                task_load[t] += task_topo_task_load(handle, &g_gov_cursor[t][i]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief       过载时的下一个级别
+ * @param       level     : 当前级别
+ * @param       cpu_only  : 1:只有CPU过载(跳过对应线程几乎不占CPU的级别)
+ * @param       task_load : 各流水线的占用(%)
+ * @retval      新级别
+ */
+static uint8_t load_gov_raise(uint8_t level, int cpu_only, const float task_load[LOAD_GOV_TARGET_NUM])
+{
+    if (level >= LOAD_GOV_STEP_NUM)
+    {
+        return level;
+    }
+
+    level++;
+
+    while (cpu_only && level < LOAD_GOV_STEP_NUM &&
+           task_load[g_gov_steps[level - 1].target] < LOAD_GOV_IDLE_PCT)
+    {
+        level++;
+    }
+
+    return level;
+}
+
+/**
+ * @brief       负载调控线程
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void load_gov_thread(void *pvParameters)
+{
+    (void)pvParameters;
+    float core_load[portNUM_PROCESSORS];
+    float task_load[LOAD_GOV_TARGET_NUM];
+    camera_stats_t cam;
+    uint32_t cam_prev = 0;
+    uint32_t cam_ovf = 0;
+    uint32_t audio_prev = 0;
+    uint32_t audio_ovf;
+    uint32_t tx_underflow;
+    uint32_t queued;
+    uint8_t level = 0;
+    uint8_t calm = 0;
+    uint8_t next;
+    int cpu_high;
+    int cpu_low;
+    int backlog;
+    TickType_t wake;
+
+    load_gov_sample(core_load, task_load);                          /* 从这里开始计算占用 */
+
+    if (esp_camera_get_stats(&cam) == ESP_OK)
+    {
+        cam_prev = cam.fbq_overflow + cam.event_overflow;
+    }
+
+    av_audio_i2s_stats(&audio_prev, &tx_underflow);
+    wake = xTaskGetTickCount();
+
+    while (1)
+    {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(LOAD_GOV_PERIOD_MS));
+        load_gov_sample(core_load, task_load);
+
+        cpu_high = 0;
+        cpu_low = 1;
+
+        for (int core = 0; core < portNUM_PROCESSORS; core++)
+        {
+            cpu_high |= (core_load[core] > LOAD_GOV_CPU_HIGH);
+            cpu_low &= (core_load[core] < LOAD_GOV_CPU_LOW);
+        }
+
+        /* 驱动来不及交付帧(FBQ-SND/EV-EOF-OVF)、音频丢数据、WIFI发送积压 */
+        if (esp_camera_get_stats(&cam) == ESP_OK)
+        {
+            cam_ovf = cam.fbq_overflow + cam.event_overflow - cam_prev;
+            cam_prev = cam.fbq_overflow + cam.event_overflow;
+        }
+
+        av_audio_i2s_stats(&audio_ovf, &tx_underflow);
+        backlog = lwip_tx_backlog(&queued) || (cam_ovf > 0) || (audio_ovf != audio_prev);
+        audio_prev = audio_ovf;
+
+        if (cpu_high || backlog)
+        {
+            calm = 0;
+            next = load_gov_raise(level, !backlog, task_load);
+        }
+        else if (cpu_low && level > 0 && ++calm >= LOAD_GOV_CALM_PERIODS)
+        {
+            calm = 0;
+            next = level - 1;
+        }
+        else
+        {
+            calm = cpu_low ? calm : 0;
+            next = level;
+        }
+
+        if (next != level)
+        {
+            ESP_LOGI("TAG", "load gov: level %u -> %u (cpu %.0f%%/%.0f%%, fbq/ev ovf %lu, tx queued %lu)",
+                     (unsigned)level, (unsigned)next, (double)core_load[0], (double)core_load[portNUM_PROCESSORS - 1],
+                     (unsigned long)cam_ovf, (unsigned long)queued);
+            level = next;
+            load_gov_apply(level);
+        }
+
+        portENTER_CRITICAL(&g_gov_mux);
+        memcpy(g_gov_stats.core_load, core_load, sizeof(core_load));
+        memcpy(g_gov_stats.task_load, task_load, sizeof(task_load));
+        portEXIT_CRITICAL(&g_gov_mux);
+    }
+}
+
+/**
+ * @brief       创建负载调控线程(rate_ctrl_init 之后调用)
+ * @param       无
+ * @retval      无
+ */
+void load_gov_init(void)
+{
+#if LOAD_GOV_EN
+    static TaskHandle_t task = NULL;
+    static StackType_t stack[LOAD_GOV_THREAD_STACK];               /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+
+    if (task == NULL)
+    {
+        task = xTaskCreateStaticPinnedToCore(load_gov_thread, "load_gov_thread", LOAD_GOV_THREAD_STACK, NULL,
+                                             LOAD_GOV_THREAD_PRIO, stack, &tcb, LOAD_GOV_THREAD_CORE);
+    }
+#endif
+}
+
+/**
+ * @brief       登记调用线程属于哪条流水线(线程开始时调用, 用于统计占用与判断流水线是否在运行)
+ * @param       target : 流水线
+ * @retval      无
+ */
+void load_gov_watch(load_gov_target_t target)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    task_topo_cursor_t cursor = { 0 };
+
+    task_topo_task_load(self, &cursor);                             /* 从登记时开始计算占用 */
+
+    portENTER_CRITICAL(&g_gov_mux);
+
+    for (int i = 0; i < LOAD_GOV_TASK_MAX; i++)
+    {
+        if (g_gov_task[target][i] == NULL)
+        {
+            g_gov_cursor[target][i] = cursor;
+            g_gov_task[target][i] = self;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&g_gov_mux);
+}
+
+/**
+ * @brief       取景/分析的间隔倍数(提交帧时调用)
+ * @param       target : LOAD_GOV_PREVIEW 或 LOAD_GOV_ANALYTICS
+ * @retval      倍数, 1:未降级
+ */
+uint32_t load_gov_scale(load_gov_target_t target)
+{
+    return (target < LOAD_GOV_TARGET_NUM) ? g_gov_scale[target] : 1;
+}
+
+/**
+ * @brief       读取统计
+ * @param       stats : 输出统计
+ * @retval      无
+ */
+void load_gov_get_stats(load_gov_stats_t *stats)
+{
+    portENTER_CRITICAL(&g_gov_mux);
+    *stats = g_gov_stats;
+    portEXIT_CRITICAL(&g_gov_mux);
+}
+
+/**
+ * @brief       流水线名称
+ * @param       target : 流水线
+ * @retval      名称
+ */
+const char *load_gov_target_name(load_gov_target_t target)
+{
+    return (target < LOAD_GOV_TARGET_NUM) ? g_gov_target_name[target] : "?";
+}
@@ -0,0 +1,84 @@
+/**
+ ****************************************************************************************************
+ * @file        load_gov.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       负载调控(CPU或空口过载时按固定顺序降低次要流水线的负载, 音频不降级)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 摄像头、音频、LCD取景与分析同时运行时, 过载原本只表现为驱动的帧队列溢出(FBQ-SND、EV-EOF-OVF)与音频丢数据.
+ * LOAD_GOV_EN 为1时调控线程每 LOAD_GOV_PERIOD_MS 采样一次:
+ *     各核CPU占用(空闲任务的运行时间)与登记线程的CPU占用(task_topo_task_load)
+ *     驱动的帧队列溢出与事件溢出、I2S接收溢出(音频丢数据)
+ *     发送队列积压与单帧发送阻塞时间(WIFI发送积压)
+ * 任一核占用超过 LOAD_GOV_CPU_HIGH 或出现上述溢出/积压即为过载, 每个周期升一级; 连续 LOAD_GOV_CALM_PERIODS 个周期
+ * 各核占用低于 LOAD_GOV_CPU_LOW 且没有溢出/积压才降一级(滞回, 避免来回切换).
+ * 降级顺序见 load_gov.c 的 g_gov_steps[]: 先降低取景帧率, 再降低分析(移动侦测、人脸检测)频率, 最后放宽JPEG质量上限;
+ * 音频与视频的采集/发送线程不降级, 保持实时. 仅因CPU过载升级时, 跳过所登记线程几乎不占CPU的级别(该流水线未运行).
+ * 各流水线在提交帧时以 load_gov_scale() 延长自己的间隔, 视频质量由调控线程经 rate_ctrl_shed() 下发.
+ * 级别与各流水线的CPU占用经 /metrics 输出.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __LOAD_GOV_H
+#define __LOAD_GOV_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define LOAD_GOV_EN                 1                               /* 1:过载时按顺序降级 */
+#define LOAD_GOV_PERIOD_MS          1000                            /* 采样周期 */
+#define LOAD_GOV_CPU_HIGH           90                              /* 任一核占用超过该值(%)为过载 */
+#define LOAD_GOV_CPU_LOW            70                              /* 各核占用都低于该值(%)才算空闲 */
+#define LOAD_GOV_CALM_PERIODS       5                               /* 连续空闲这么多周期降一级 */
+#define LOAD_GOV_IDLE_PCT           1                               /* 登记线程占用低于该值(%)视为该流水线未运行 */
+#define LOAD_GOV_TASK_MAX           2                               /* 每条流水线可登记的线程数 */
+
+/* 流水线 */
+typedef enum
+{
+    LOAD_GOV_PREVIEW = 0,                                           /* LCD取景 */
+    LOAD_GOV_ANALYTICS,                                             /* 移动侦测、人脸检测 */
+    LOAD_GOV_VIDEO,                                                 /* 视频上传(只放宽JPEG质量, 不降帧率) */
+    LOAD_GOV_AUDIO,                                                 /* 音频(只统计, 不降级) */
+    LOAD_GOV_TARGET_NUM,
+} load_gov_target_t;
+
+/* 统计 */
+typedef struct
+{
+    uint8_t level;                                                  /* 当前级别, 0:未降级 */
+    uint8_t level_max;                                              /* 上电以来达到的最高级别 */
+    uint32_t raises;                                                /* 升级次数 */
+    float core_load[portNUM_PROCESSORS];                            /* 上一周期各核占用(%) */
+    float task_load[LOAD_GOV_TARGET_NUM];                           /* 上一周期各流水线登记线程的占用之和(%) */
+} load_gov_stats_t;
+
+/* 函数声明 */
+void load_gov_init(void);                                           /* 创建调控线程 */
+void load_gov_watch(load_gov_target_t target);                      /* 登记调用线程属于哪条流水线(线程开始时调用) */
+uint32_t load_gov_scale(load_gov_target_t target);                  /* 取景/分析的间隔倍数, 1:未降级 */
+void load_gov_get_stats(load_gov_stats_t *stats);                   /* 读取统计 */
+const char *load_gov_target_name(load_gov_target_t target);         /* 流水线名称(metrics标签) */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -19,14 +19,107 @@
  */
 
 #include "lwip_demo.h"
+#include "frame_proto.h"
+#include "lwip_zerocopy.h"
+#include "rate_ctrl.h"
+#include "frame_stats.h"
+#include "lcd_preview.h"
+#include "rtp_jpeg.h"
+#include "h264_stream.h"
+#include "mjpeg_server.h"
+#include "snapshot.h"
+#include "sd_recorder.h"
+#include "frame_spool.h"
+#include "motion_detect.h"
+#include "face_detect.h"
+#include "wifi_profile.h"
+#include "frame_pacer.h"
+#include "roi_stream.h"
+#include "dual_stream.h"
+#include "burst_capture.h"
+#include "task_topo.h"
+#include "heap_stats.h"
+#include "metrics.h"
+#include "trace.h"
+#include "jpeg_abbrev.h"
+#include "jpg_sig.h"
+#include "jpg_requant.h"
+#include "frame_pool.h"
+#include "clock_sync.h"
+#include "pm_ctrl.h"
+#include "load_gov.h"
+#include "tls_stream.h"
+#include "server_disc.h"
+#include "net_qos.h"
+#include "synth_frame.h"
+#include "frame_replay.h"
+#include "soak.h"
+#include "perf_prof.h"
+#include "hw_trigger.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include "esp_random.h"
 
 
-/* 需要自己设置远程IP地址 */
-#define IP_ADDR   "192.168.31.117"
-
 #define LWIP_DEMO_RX_BUFSIZE         128                        /* 最大接收数据长度 */
-#define LWIP_DEMO_PORT               8000                       /* 连接的本地端口号 */
-#define LWIP_SEND_THREAD_PRIO        10                         /* 发送数据线程优先级 */
+#define LWIP_CONNECTED_BIT           BIT0                       /* 事件位:已连接服务器 */
+#define LWIP_VIEWER_BIT              BIT1                       /* 事件位:有MJPEG HTTP客户端在观看 */
+#define LWIP_RECORD_BIT              BIT2                       /* 事件位:SD卡录像运行中 */
+#define LWIP_SPOOL_BIT               BIT3                       /* 事件位:与服务器的连接中断, 帧缓存到Flash */
+#define LWIP_SNAPSHOT_BIT            BIT4                       /* 事件位:最近有 /snapshot.jpg 轮询 */
+#define LWIP_PIPELINE_EN             1                          /* 1:采集与发送流水线并行; 0:串行采集发送 */
+#define LWIP_ZEROCOPY_EN             1                          /* 1:netconn零拷贝发送, 帧缓存在对端确认后归还; 0:socket拷贝发送 */
+#define LWIP_RTP_EN                  0                          /* 1:图像以RTP/JPEG(RFC 2435)经UDP发送到 RTP_JPEG_PORT; 0:TCP帧协议 */
+#define LWIP_RTP_MCAST_EN            0                          /* 1:RTP发送到组播地址(一对多观看); 0:发送到 IP_ADDR */
+#define LWIP_RTP_MCAST_ADDR          "239.255.0.1"              /* 组播地址(本地管理范围 239.255.0.0/16) */
+#define LWIP_ZC_POLL_MS              2                          /* 零拷贝模式下查询确认的间隔 */
+#define LWIP_FRAME_STALE_MS          100                        /* 帧龄超过该值且有更新的帧时丢弃 */
+#define LWIP_SEND_BLOCK_MAX_US       40000                      /* 单帧平均发送阻塞时间超过该值视为链路拥塞 */
+#define LWIP_ZC_BACKLOG_MAX          2                          /* 零拷贝模式下未确认帧数达到该值视为链路拥塞 */
+#define LWIP_BURST_SEND_TIMEOUT_MS   5000                       /* 连拍帧因拥塞/断线未能发送的放弃时间 */
+#define LWIP_CONNECT_TIMEOUT_MS      3000                       /* 单次连接的超时时间(服务器不可达时不等待SYN重传) */
+#define LWIP_BACKOFF_MIN_MS          250                        /* 连接失败后的首次退避 */
+#define LWIP_BACKOFF_MAX_MS          8000                       /* 退避上限(服务器恢复后最迟在该时间内重连) */
+#define LWIP_NET_TICK_MS             100                        /* 网络事件循环无数据时的最长等待, 即服务器发现与迁移检查的周期 */
+#define LWIP_FRAME_WINDOW_MAX        8                          /* 在途帧窗口上限(静态帧队列与窗口信号量的容量) */
+#define LWIP_ROAM_HOLD_MAX           32                         /* 漫游切换AP期间暂存的帧数上限(frame_pool槽位) */
+#define LWIP_CAPTURE_AT_HALF_MAX_US  250000                     /* CTRL_CMD_CAPTURE_AT 估计的半个帧间隔上限(us) */
+#define LWIP_FRAME_META_EN           1                          /* 1:图像帧头附带驱动采样的曝光/增益/白平衡寄存器(frame_header_meta_t) */
+#define LWIP_TILES_QUALITY           100                        /* CTRL_CMD_JPEG_TILES 的编码质量, 100:沿用摄像头的量化表(无损重排) */
+#define LWIP_CUT_THROUGH_EN          0                          /* 1:JPEG帧边采集边发送(FRAME_EXT_CHUNKED, 驱动须开启 CONFIG_CAMERA_CUT_THROUGH); 0:整帧采集完成后发送 */
+#define LWIP_CUT_THROUGH_WAIT_MS     200                        /* 边采集边发送时等待帧开始或新数据的超时 */
+
+#if LWIP_CUT_THROUGH_EN && DUAL_STREAM_EN
+#undef LWIP_CUT_THROUGH_EN
+#define LWIP_CUT_THROUGH_EN          0                          /* 子码流须由完整帧转码 */
+#endif
+
+#if LWIP_CUT_THROUGH_EN && SYNTH_FRAME_EN
+#undef LWIP_CUT_THROUGH_EN
+#define LWIP_CUT_THROUGH_EN          0                          /* 合成帧不经驱动, 整帧已在缓冲中 */
+#endif
+
+#if LWIP_CUT_THROUGH_EN
+#undef LWIP_PIPELINE_EN
+#define LWIP_PIPELINE_EN             0                          /* 帧在采集期间即由发送线程读取, 没有可并行的采集 */
+#undef LWIP_ZEROCOPY_EN
+#define LWIP_ZEROCOPY_EN             0                          /* 分段在采集期间写入协议栈, 不能等待整帧确认 */
+#undef LWIP_RTP_EN
+#define LWIP_RTP_EN                  0                          /* 分段依赖TCP帧协议 */
+#endif
+
+#if TLS_STREAM_EN
+#undef LWIP_ZEROCOPY_EN
+#define LWIP_ZEROCOPY_EN             0                          /* 加密时明文本来就要拷入记录缓冲, 不能引用帧缓存等待确认 */
+#undef LWIP_RTP_EN
+#define LWIP_RTP_EN                  0                          /* TLS只用于TCP帧协议 */
+#endif
+
+#if LWIP_RTP_EN
+#undef LWIP_ZEROCOPY_EN
+#define LWIP_ZEROCOPY_EN             0                          /* UDP发送后即可归还帧缓存, 无需等待确认 */
+#endif
+
 /* 接收数据缓冲区 */
 char g_lwip_demo_recvbuf[LWIP_DEMO_RX_BUFSIZE]; 
 
@@ -34,98 +127,2194 @@ char g_lwip_demo_recvbuf[LWIP_DEMO_RX_BUFSIZE];
 uint8_t g_lwip_send_flag;
 int g_sock = -1;
 int g_lwip_connect_state = 0;
+static EventGroupHandle_t g_lwip_event = NULL;                  /* 连接状态事件组 */
+static StaticEventGroup_t g_lwip_event_buf;
+static uint32_t g_frame_seq = 0;                                /* 帧序号 */
+static uint32_t g_audio_seq = 0;                                /* 音频帧序号 */
+#if !LWIP_ZEROCOPY_EN
+static SemaphoreHandle_t g_tx_lock = NULL;                      /* 各发送线程共用套接字, 保证帧头与负载连续; 事件循环持有它关闭 g_sock */
+static StaticSemaphore_t g_tx_lock_buf;
+#endif
+static uint32_t g_send_block_us = 0;                            /* 单帧发送阻塞时间(滑动平均) */
+static uint32_t g_frame_dropped = 0;                            /* 因链路拥塞丢弃的帧数 */
+static volatile uint8_t g_stats_request = 0;                    /* 服务器请求时延统计("stats") */
+static uint8_t g_spool_ready = 0;                               /* 1:断线帧缓存可用 */
+static volatile uint8_t g_uplink_paused = 0;                    /* 1:暂停上传(CTRL_CMD_STOP) */
+static volatile uint8_t g_snapshot_request = 0;                 /* 1:立即上传下一帧(CTRL_CMD_SNAPSHOT) */
+static volatile int64_t g_capture_at_us = -1;                   /* CTRL_CMD_CAPTURE_AT 的目标采集时间(esp_timer), -1:未设置 */
+static int64_t g_capture_prev_us = 0;                           /* 上一帧的采集时间, 估计帧间隔 */
+#if !LWIP_RTP_EN
+static volatile uint8_t g_jpeg_abbrev_on = 0;                   /* 1:省略不变的JPEG表头(CTRL_CMD_JPEG_ABBREV) */
+static volatile uint8_t g_jpeg_abbrev_reset = 0;                /* 1:发送线程在下一帧前清空表头缓存 */
+static jpeg_abbrev_t g_jpeg_abbrev;                             /* 表头缓存(只在发送线程中使用) */
+static volatile uint8_t g_jpeg_tiles_on = 0;                    /* 1:静态场景只发送变化的分块(CTRL_CMD_JPEG_TILES) */
+static volatile uint8_t g_jpeg_tiles_reset = 0;                 /* 1:发送线程在下一帧前强制完整帧 */
+static jpg_tiles_t *g_jpeg_tiles = NULL;                        /* 分块编码状态(内部RAM, 首次开启时申请) */
+static uint8_t *g_jpeg_tiles_buf = NULL;                        /* 分块编码输出(PSRAM) */
+static size_t g_jpeg_tiles_cap = 0;
+static volatile uint8_t g_detect_mode = 0;                      /* CTRL_CMD_DETECT: 1:上传检测元数据; 2:同时只在有人时上传图像 */
+static volatile uint32_t g_static_skip_ms = 0;                  /* CTRL_CMD_STATIC_SKIP: 静止画面上传图像的最长间隔, 0:关闭 */
+static volatile uint8_t g_static_reset = 0;                     /* 1:发送线程在下一帧前清除参考签名 */
+static jpg_sig_t g_static_ref;                                  /* 上一次上传的图像的签名(只在发送线程中使用) */
+static jpg_sig_t g_static_cur;                                  /* 当前帧的签名 */
+static int64_t g_static_ref_us = 0;                             /* 上一次上传图像的时间 */
+static uint32_t g_detect_seen = 0;                              /* 已上传的检测结果(face_detect_take) */
+#if WIFI_ROAM_EN
+/* 漫游期间暂存的帧(只在发送线程中使用), 按序号先进先出 */
+static struct
+{
+    frame_header_t hdr;
+    void *buf;
+} g_roam_held[LWIP_ROAM_HOLD_MAX];
+static uint8_t g_roam_head = 0;
+static uint8_t g_roam_num = 0;
+static uint32_t g_roam_lost = 0;                                /* 暂存已满或没有空闲槽位而丢弃的帧 */
+#endif
+#endif
+static uint8_t g_ctrl_pending[sizeof(ctrl_cmd_t)];              /* 跨多次接收累积的不完整控制命令(含不完整的 magic) */
+static size_t g_ctrl_pending_len = 0;
+#if !LWIP_PIPELINE_EN
+static size_t g_fb_count = 1;                                   /* 摄像头帧缓存数量 */
+#endif
+#if LWIP_PIPELINE_EN
+static QueueHandle_t g_frame_queue = NULL;                      /* 采集线程 -> 发送线程的帧队列 */
+static SemaphoreHandle_t g_frame_window = NULL;                 /* 在途帧窗口(计数信号量) */
+static StaticQueue_t g_frame_queue_buf;
+static uint8_t g_frame_queue_storage[LWIP_FRAME_WINDOW_MAX * sizeof(camera_fb_t *)];
+static StaticSemaphore_t g_frame_window_buf;
+static StackType_t g_capture_stack[LWIP_CAPTURE_THREAD_STACK];  /* 线程栈与TCB在内部RAM静态区(task_topo.h) */
+static StaticTask_t g_capture_tcb;
+static void lwip_capture_thread(void *arg);
+#endif
+static StackType_t g_send_stack[LWIP_SEND_THREAD_STACK];
+static StaticTask_t g_send_tcb;
+static StackType_t g_key_stack[LWIP_KEY_THREAD_STACK];
+static StaticTask_t g_key_tcb;
 static void lwip_send_thread(void *arg);
+static void lwip_key_thread(void *arg);
+#if !LWIP_RTP_EN
+static int lwip_send_spooled(const frame_header_t *hdr, const void *data, size_t len);
+#endif
+static int lwip_ctrl_input(const uint8_t *buf, int len);
+#if !LWIP_RTP_EN
+static void lwip_send_burst(const burst_t *batch);
+#endif
+#if !LWIP_ZEROCOPY_EN && !LWIP_RTP_EN
+static void lwip_set_liveness(int sock);
+#endif
+
+
+/**
+ * @brief       设置连接状态并通知发送线程
+ * @param       state : 1,已连接; 0,已断开
+ * @retval      无
+ */
+static void lwip_set_connect_state(int state)
+{
+    g_lwip_connect_state = state;
+
+    if (state)
+    {
+        xEventGroupClearBits(g_lwip_event, LWIP_SPOOL_BIT);
+        xEventGroupSetBits(g_lwip_event, LWIP_CONNECTED_BIT);
+    }
+    else
+    {
+        xEventGroupClearBits(g_lwip_event, LWIP_CONNECTED_BIT);
 
+        if (g_spool_ready && g_frame_seq > 0)                   /* 曾连接过: 断线期间继续采集并缓存 */
+        {
+            xEventGroupSetBits(g_lwip_event, LWIP_SPOOL_BIT);
+        }
+    }
+}
 
 /**
  * @brief       发送数据线程
+ * @param       fb_count : 摄像头帧缓存数量, 用于计算在途帧窗口
+ * @retval      无
+ */
+void lwip_data_send(size_t fb_count)
+{
+    g_lwip_event = xEventGroupCreateStatic(&g_lwip_event_buf);  /* 先创建事件组, 再创建发送线程 */
+    assert(g_lwip_event);
+#if !LWIP_ZEROCOPY_EN
+    g_tx_lock = xSemaphoreCreateMutexStatic(&g_tx_lock_buf);
+    assert(g_tx_lock);
+#endif
+
+#if LWIP_PIPELINE_EN
+    /* 至少留一个帧缓存给DMA采集(使能取景时再留一个给取景线程, 使能MJPEG服务时再留给其客户端), 其余帧可同时处于排队/发送状态 */
+    size_t reserved = 1 + LCD_PREVIEW_EN + MJPEG_SERVER_EN * MJPEG_FB_HELD_MAX;
+    UBaseType_t window = (fb_count > reserved) ? (UBaseType_t)(fb_count - reserved) : 1;
+
+    window = (window > LWIP_FRAME_WINDOW_MAX) ? LWIP_FRAME_WINDOW_MAX : window;
+    g_frame_queue = xQueueCreateStatic(window, sizeof(camera_fb_t *), g_frame_queue_storage, &g_frame_queue_buf);
+    g_frame_window = xSemaphoreCreateCountingStatic(window, window, &g_frame_window_buf);
+    assert(g_frame_queue && g_frame_window);
+    ESP_LOGI("TAG", "pipeline mode, in-flight window: %u", (unsigned)window);
+
+    xTaskCreateStaticPinnedToCore(lwip_capture_thread, "lwip_capture_thread", LWIP_CAPTURE_THREAD_STACK, NULL,
+                                  LWIP_CAPTURE_THREAD_PRIO, g_capture_stack, &g_capture_tcb, LWIP_CAPTURE_THREAD_CORE);
+#else
+    g_fb_count = fb_count;
+#endif
+    xTaskCreateStaticPinnedToCore(lwip_send_thread, "lwip_send_thread", LWIP_SEND_THREAD_STACK, NULL,
+                                  LWIP_SEND_THREAD_PRIO, g_send_stack, &g_send_tcb, LWIP_SEND_THREAD_CORE);
+
+    if (snapshot_init(g_lwip_event, LWIP_SNAPSHOT_BIT) != ESP_OK)  /* 须在 mjpeg_server_init 注册 /snapshot.jpg 之前 */
+    {
+        ESP_LOGW("TAG", "snapshot cache unavailable");
+    }
+
+    if (mjpeg_server_init(g_lwip_event, LWIP_VIEWER_BIT) != ESP_OK)
+    {
+        ESP_LOGW("TAG", "mjpeg server unavailable");
+    }
+
+    sd_recorder_init(g_lwip_event, LWIP_RECORD_BIT);           /* 未插卡时不录像 */
+    clock_sync_init();                                          /* 校时前帧头仍为 esp_timer 时间 */
+#if !LWIP_RTP_EN
+    g_spool_ready = (frame_spool_init(lwip_send_spooled) == ESP_OK) && !FRAME_REPLAY_EN;   /* 重放期间不缓存, 以免覆盖要重放的记录 */
+    burst_capture_init(lwip_send_burst);
+#if WIFI_ROAM_EN
+    if (frame_pool_init() != ESP_OK)
+    {
+        ESP_LOGW("TAG", "roam: no frame pool, frames are dropped while switching AP");
+    }
+#endif
+#else
+    burst_capture_init(NULL);                                   /* RTP流中没有连拍帧, 只在日志中输出结果 */
+#endif
+
+    if (xl9555_event_init() == ESP_OK)
+    {
+        xTaskCreateStaticPinnedToCore(lwip_key_thread, "lwip_key_thread", LWIP_KEY_THREAD_STACK, NULL,
+                                      LWIP_KEY_THREAD_PRIO, g_key_stack, &g_key_tcb, LWIP_KEY_THREAD_CORE);
+        hw_trigger_init();                                      /* PIR/门磁输入不经消抖直接触发抓拍 */
+    }
+}
+
+/**
+ * @brief       按键事件线程: 阻塞等待XL9555输入事件, 不轮询IIC总线
+ * @note        KEY0: 向服务器发送一次时延统计(与服务器发送"stats"相同)
+ *              KEY1: 触发一次SD卡事件录像(与服务器发送"clip"相同)
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void lwip_key_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    xl9555_event_t evt;
+
+    while (1)
+    {
+        if (xl9555_event_get(&evt, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+
+        switch (evt.key)
+        {
+            case KEY0_PRES:
+                g_stats_request = 1;                            /* 由发送线程在帧间隙发送 */
+                break;
+
+            case KEY1_PRES:
+                sd_recorder_trigger();
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * @brief       计算下一次重连前的等待时间(指数退避 + 随机抖动)
+ * @note        等待时间在 [backoff/2, backoff] 内随机, 多台设备不会同时重连; 之后 backoff 加倍, 不超过 LWIP_BACKOFF_MAX_MS
+ * @param       backoff : 当前退避时间(ms), 输出下一次的退避时间
+ * @retval      本次等待时间(ms)
+ */
+static uint32_t lwip_backoff_next(uint32_t *backoff)
+{
+    uint32_t delay = *backoff / 2 + esp_random() % (*backoff / 2 + 1);
+
+    *backoff = (*backoff * 2 > LWIP_BACKOFF_MAX_MS) ? LWIP_BACKOFF_MAX_MS : *backoff * 2;
+    return delay;
+}
+
+#if !LWIP_ZEROCOPY_EN && !LWIP_RTP_EN
+/**
+ * @brief       非阻塞连接服务器, 超时放弃
+ * @param       sock       : 套接字(阻塞方式, 返回时恢复)
+ * @param       addr       : 服务器地址
+ * @param       timeout_ms : 连接超时
+ * @retval      0:成功; -1:失败或超时
+ */
+static int lwip_connect_timeout(int sock, const struct sockaddr_in *addr, uint32_t timeout_ms)
+{
+    int flags = fcntl(sock, F_GETFL, 0);
+    int ret = -1;
+    int so_err = 0;
+    socklen_t len = sizeof(so_err);
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    fd_set wset;
+
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+    if (connect(sock, (const struct sockaddr *)addr, sizeof(*addr)) == 0)
+    {
+        ret = 0;
+    }
+    else if (errno == EINPROGRESS)
+    {
+        FD_ZERO(&wset);
+        FD_SET(sock, &wset);
+
+        if (select(sock + 1, NULL, &wset, NULL, &tv) > 0 &&
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &so_err, &len) == 0 && so_err == 0)
+        {
+            ret = 0;
+        }
+    }
+
+    fcntl(sock, F_SETFL, flags);
+    return ret;
+}
+#endif
+
+/**
+ * @brief       限时等待控制通道(或RTP套接字)的数据并接收
+ * @param       buf        : 接收缓冲区
+ * @param       size       : 缓冲区大小
+ * @param       timeout_ms : 最长等待时间
+ * @retval      >0:接收到的字节数; 0:超时, 没有数据; -1:出错或对端关闭
+ */
+static int lwip_net_recv(char *buf, size_t size, uint32_t timeout_ms)
+{
+    int ret;
+
+#if LWIP_ZEROCOPY_EN
+    ret = lwip_zc_wait(timeout_ms);
+
+    if (ret <= 0)
+    {
+        return ret;
+    }
+
+    ret = lwip_zc_recv(buf, size);
+#else
+#if TLS_STREAM_EN
+    ret = tls_stream_poll((int)timeout_ms);                     /* 先检查 mbedtls 中已解密未读出的数据 */
+#else
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    fd_set rset;
+
+    FD_ZERO(&rset);
+    FD_SET(g_sock, &rset);
+    ret = select(g_sock + 1, &rset, NULL, NULL, &tv);
+#endif
+
+    if (ret == 0 || (ret < 0 && errno == EINTR))
+    {
+        return 0;
+    }
+
+    if (ret < 0)
+    {
+        return -1;
+    }
+
+#if TLS_STREAM_EN
+    ret = tls_stream_recv(buf, size);
+#else
+    ret = recv(g_sock, buf, size, MSG_DONTWAIT);
+
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return 0;
+    }
+#endif
+#endif
+
+    return (ret > 0) ? ret : -1;
+}
+
+/**
+ * @brief       断开当前连接(只在网络事件循环中调用)
+ * @note        先 shutdown 使阻塞在发送中的线程立即返回, 再持有 g_tx_lock 关闭套接字:
+ *              发送线程只在 g_tx_lock 内使用 g_sock, 不会写到已关闭(或被新连接复用了描述符)的套接字
  * @param       无
  * @retval      无
  */
-void lwip_data_send(void)
+static void lwip_net_close(void)
+{
+    lwip_set_connect_state(0);
+#if LWIP_ZEROCOPY_EN
+    lwip_zc_close();
+#else
+    shutdown(g_sock, SHUT_RDWR);
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);
+#if TLS_STREAM_EN
+    tls_stream_close();
+#endif
+    closesocket(g_sock);
+    g_sock = -1;
+    xSemaphoreGive(g_tx_lock);
+#endif
+    server_disc_disconnected();
+}
+
+/**
+ * @brief       重连前的退避等待, 期间照常推进服务器发现
+ * @note        等待开始时所有服务器都在冷却中, 期间有服务器经探测或mDNS恢复可用时提前结束
+ * @param       ms : 最长等待时间
+ * @retval      无
+ */
+static void lwip_net_sleep(uint32_t ms)
 {
-    xTaskCreate(lwip_send_thread, "lwip_send_thread", 2*1024, NULL, LWIP_SEND_THREAD_PRIO, NULL);
+    int64_t end = esp_timer_get_time() + (int64_t)ms * 1000;
+    server_ep_t ep;
+    bool up = server_disc_pick(&ep);
+    int64_t left;
+
+    while ((left = end - esp_timer_get_time()) > 0)
+    {
+        server_disc_poll();
+
+        if (!up && server_disc_pick(&ep))
+        {
+            break;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS((left / 1000 < LWIP_NET_TICK_MS) ? left / 1000 : LWIP_NET_TICK_MS) + 1);
+    }
 }
 
 /**
  * @brief       lwip_demo实验入口
- * @param       无
+ * @param       config : 摄像头配置
  * @retval      无
  */
-void lwip_demo(void)
+void lwip_demo(const camera_config_t *config)
 {
     int err;
     struct sockaddr_in atk_client_addr;
     int recv_data_len;
-    char *tbuf;
-    char host_ip[] = IP_ADDR;
-    lwip_data_send();                                           /* 创建发送数据线程 */
-    
+    int ctrl_len;                                               /* 接收数据开头的二进制控制命令字节数 */
+    char tbuf[32];                                              /* 服务器地址显示(每次重连都用, 不从堆申请) */
+    server_ep_t ep;                                             /* 本次连接的服务器 */
+    uint32_t backoff = LWIP_BACKOFF_MIN_MS;                     /* 连接失败后的退避时间 */
+    bool retry = false;                                         /* 上一次连接失败, 重试前退避 */
+    bool shown = false;                                         /* 已显示断线状态 */
+#if !LWIP_ZEROCOPY_EN && !LWIP_RTP_EN
+    int reuse = 1;
+#endif
+#if LWIP_ZEROCOPY_EN
+    (void)atk_client_addr;
+    ESP_ERROR_CHECK(lwip_zc_init());
+#endif
+    rate_ctrl_init(config);
+    load_gov_init();                                            /* 过载时先降取景与分析, 最后降视频质量 */
+#if !LWIP_RTP_EN
+    dual_stream_init(config, lwip_send_spooled);                /* 未使能时照常上传原始帧 */
+#else
+    h264_stream_init(config);                                   /* 未使能或JPEG格式时照常按RTP/JPEG发送 */
+#endif
+    lwip_data_send(config->fb_count);                           /* 创建发送数据线程 */
+    server_disc_init();                                         /* 静态列表 + mDNS发现的服务器 */
+#if LWIP_RTP_EN
+    (void)atk_client_addr;
+    (void)err;
+    snprintf(tbuf, sizeof(tbuf), "RTP:%d", RTP_JPEG_PORT);      /* 接收端RTP端口号 */
+    spilcd_show_string(5, 170, 200, 16, 16, tbuf, MAGENTA);
+#endif
+
     while (1)
     {
 sock_start:
-        g_lwip_connect_state = 0;
-        inet_pton(AF_INET, host_ip, &atk_client_addr.sin_addr);
+        server_disc_pick(&ep);                                  /* 全部在冷却中时取最先恢复的一台, 下面退避 */
+
+        if (retry)
+        {
+            if (!shown)
+            {
+                spilcd_show_string(5, 190, 200, 16, 16, "State:Disconnect", MAGENTA);  /* 每次断线只显示一次 */
+                shown = true;
+            }
+
+            lwip_net_sleep(lwip_backoff_next(&backoff));
+        }
+
+        retry = true;                                           /* 本次失败时退避后重试 */
+        lwip_set_connect_state(0);
+#if LWIP_RTP_EN
+        /* UDP无连接, 套接字创建即可发送; 仍在该套接字上接收服务器的"stats"等命令(组播模式下没有命令来源, 按KEY0输出统计) */
+        g_sock = rtp_jpeg_open(LWIP_RTP_MCAST_EN ? LWIP_RTP_MCAST_ADDR : ep.ip, RTP_JPEG_PORT);
+
+        if (g_sock < 0)
+        {
+            goto sock_start;
+        }
+#else
+        /* 连接远程IP地址(非阻塞, 超时放弃) */
+#if LWIP_ZEROCOPY_EN
+        err = (lwip_zc_connect(ep.ip, ep.port, LWIP_CONNECT_TIMEOUT_MS) == ESP_OK) ? 0 : -1;
+#else
+        memset(&atk_client_addr, 0, sizeof(atk_client_addr));
+        inet_pton(AF_INET, ep.ip, &atk_client_addr.sin_addr);
         atk_client_addr.sin_family = AF_INET;                   /* 表示IPv4网络协议 */
-        atk_client_addr.sin_port = htons(LWIP_DEMO_PORT);       /* 端口号 */
-        g_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);               /* 可靠数据流交付服务既是TCP协议 */
-        memset(&(atk_client_addr.sin_zero), 0, sizeof(atk_client_addr.sin_zero));
-        
-        tbuf = malloc(200);                                     /* 申请内存 */
-        sprintf((char *)tbuf, "Port:%d", LWIP_DEMO_PORT);       /* 客户端端口号 */
-        spilcd_show_string(5, 170, 200, 16, 16, tbuf, MAGENTA);
-        
-        /* 连接远程IP地址 */
-        err = connect(g_sock, (struct sockaddr *)&atk_client_addr, sizeof(atk_client_addr));
+        atk_client_addr.sin_port = htons(ep.port);              /* 端口号 */
+        g_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);      /* 可靠数据流交付服务既是TCP协议 */
+
+        if (g_sock < 0)
+        {
+            ESP_LOGE("TAG", "socket create failed: errno %d", errno);
+            goto sock_start;
+        }
+
+        setsockopt(g_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));   /* TIME_WAIT中的本地端口可立即复用 */
+        net_qos_set(g_sock, NET_QOS_STREAM_DSCP);               /* 整条连接走AC_VI, 见 net_qos.h */
+        err = lwip_connect_timeout(g_sock, &atk_client_addr, LWIP_CONNECT_TIMEOUT_MS);
+#endif
 
         if (err == -1)
         {
-            spilcd_show_string(5, 190, 200, 16, 16, "State:Disconnect", MAGENTA);
-            free(tbuf);
+#if !LWIP_ZEROCOPY_EN
+            closesocket(g_sock);                                /* lwIP中连接失败的套接字不能再次connect */
+            g_sock = -1;
+#endif
+            retry = !server_disc_report(&ep, false);            /* 还有其他可用的服务器时立即改连, 不退避 */
             goto sock_start;
         }
+#endif
 
+#if LWIP_ZEROCOPY_EN
+        lwip_zc_set_liveness(LWIP_KEEPIDLE_S * 1000, LWIP_KEEPINTVL_S * 1000, LWIP_KEEPCNT, LWIP_SEND_TIMEOUT_MS);
+#elif !LWIP_RTP_EN
+        lwip_set_liveness(g_sock);
+#endif
+#if TLS_STREAM_EN
+        if (tls_stream_open(g_sock) != 0)                       /* 重连时以会话票据恢复, 不重新交换证书 */
+        {
+            closesocket(g_sock);
+            g_sock = -1;
+            retry = !server_disc_report(&ep, false);
+            goto sock_start;
+        }
+#endif
+        server_disc_report(&ep, true);
+#if !LWIP_RTP_EN
+        snprintf(tbuf, sizeof(tbuf), "%s:%d", ep.ip, ep.port);  /* 当前服务器 */
+        spilcd_show_string(5, 170, 200, 16, 16, tbuf, MAGENTA);
+#endif
+        backoff = LWIP_BACKOFF_MIN_MS;                          /* 连接成功, 断线后先立即重连一次 */
+        retry = false;
+        shown = false;
         spilcd_show_string(5, 190, 200, 16, 16, "State:Connection", MAGENTA);
-        g_lwip_connect_state = 1;
+        g_frame_seq = 0;                                        /* 新连接从0开始计数 */
+        g_audio_seq = 0;
+        g_ctrl_pending_len = 0;
+#if !LWIP_RTP_EN
+        g_jpeg_abbrev_on = 0;                                   /* 新的服务器须重新开启 */
+        g_jpeg_abbrev_reset = 1;
+        g_jpeg_tiles_on = 0;
+        g_jpeg_tiles_reset = 1;
+        g_detect_mode = 0;
+        g_static_skip_ms = 0;
+        g_static_reset = 1;
+#endif
+        lwip_set_connect_state(1);
         
+        /* 网络事件循环: 控制通道接收, 无数据时每 LWIP_NET_TICK_MS 唤醒一次推进服务器发现;
+         * 发送线程只在 g_tx_lock 内使用连接, 断线(含发送线程 shutdown 报告的)统一在这里关闭 */
         while (1)
         {
-            recv_data_len = recv(g_sock,g_lwip_demo_recvbuf,
-                                sizeof(g_lwip_demo_recvbuf) - 1,0);
-            if (recv_data_len < 0)
+            recv_data_len = lwip_net_recv(g_lwip_demo_recvbuf, sizeof(g_lwip_demo_recvbuf) - 1, LWIP_NET_TICK_MS);
+
+            if (recv_data_len < 0)                              /* 出错或对端关闭 */
             {
-                g_lwip_connect_state = 0;
                 ESP_LOGE("TAG", "recv failed: errno %d", errno);
+                lwip_net_close();
+                break;
+            }
+
+            server_disc_poll();
+
+            if (server_disc_should_move())                      /* 优先级更高的服务器恢复, 或新服务器改变了分摊结果 */
+            {
+                ESP_LOGI("TAG", "preferred server changed, reconnecting");
+                lwip_net_close();
                 break;
             }
+
+            if (recv_data_len == 0)
+            {
+                continue;                                       /* 超时, 没有数据 */
+            }
             else
             {
                g_lwip_demo_recvbuf[recv_data_len] = 0;
-               ESP_LOGI("TAG", "Received %d bytes from %s:", recv_data_len, host_ip);
+               ctrl_len = lwip_ctrl_input((const uint8_t *)g_lwip_demo_recvbuf, recv_data_len);
+
+               if (ctrl_len >= recv_data_len)
+               {
+                   continue;                                    /* 全部是二进制控制命令 */
+               }
+
+               if (ctrl_len > 0)                                /* 命令之后的字节按文本命令处理 */
+               {
+                   recv_data_len -= ctrl_len;
+                   memmove(g_lwip_demo_recvbuf, g_lwip_demo_recvbuf + ctrl_len, recv_data_len + 1);
+               }
+
+               ESP_LOGI("TAG", "Received %d bytes from %s:", recv_data_len, ep.ip);
                ESP_LOGI("TAG", "%s", g_lwip_demo_recvbuf);
+
+               if (strncmp(g_lwip_demo_recvbuf, "stats", 5) == 0)
+               {
+                   g_stats_request = 1;                         /* 由发送线程在帧间隙回复 */
+               }
+               else if (strncmp(g_lwip_demo_recvbuf, "clip", 4) == 0)
+               {
+                   sd_recorder_trigger();                       /* 事件录像(含事件前的帧) */
+               }
+               else if (strncmp(g_lwip_demo_recvbuf, "replay ", 7) == 0)
+               {
+                   frame_spool_replay(strtoll(g_lwip_demo_recvbuf + 7, NULL, 10));   /* 重新回填该采集时间(us)之后的缓存帧 */
+               }
+               else if (strncmp(g_lwip_demo_recvbuf, "wifi ", 5) == 0)
+               {
+                   wifi_profile_apply_name(g_lwip_demo_recvbuf + 5);    /* 切换WIFI推流参数组合 */
+               }
            }
         }
     }
 }
 
+#if !LWIP_ZEROCOPY_EN
+#if !LWIP_RTP_EN
 /**
- * @brief       发送数据线程函数
- * @param       pvParameters : 传入参数(未用到)
+ * @brief       设置连接的失联检测: TCP保活与发送超时
+ * @param       sock : 套接字
  * @retval      无
  */
-void lwip_send_thread(void *pvParameters)
+static void lwip_set_liveness(int sock)
 {
-    pvParameters = pvParameters;
-    camera_fb_t *camera_frame = NULL;
-    
-    while (1)
+    int keepalive = 1;
+    int idle = LWIP_KEEPIDLE_S;
+    int intvl = LWIP_KEEPINTVL_S;
+    int cnt = LWIP_KEEPCNT;
+    struct timeval tv = { .tv_sec = LWIP_SEND_TIMEOUT_MS / 1000, .tv_usec = (LWIP_SEND_TIMEOUT_MS % 1000) * 1000 };
+
+    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(keepalive));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));   /* 发送缓冲满且无确认时阻塞不超过该时间 */
+}
+#endif
+
+/**
+ * @brief       发送全部数据(处理部分发送)
+ * @note        套接字设置了 SO_SNDTIMEO, EAGAIN 表示超时内没有任何进展(对端失联)
+ * @param       sock : 套接字
+ * @param       data : 数据
+ * @param       len  : 数据长度
+ * @retval      0:发送成功; -1:发送失败
+ */
+static int lwip_send_all(int sock, const void *data, size_t len)
+{
+    if (sock < 0 || sock != g_sock)
+    {
+        return -1;                                              /* 取得 g_tx_lock 之前连接已被事件循环关闭 */
+    }
+
+#if TLS_STREAM_EN
+    if (tls_stream_send(data, len) != 0)                        /* 加密后按记录发送, 同样受 SO_SNDTIMEO 限制 */
+    {
+        if (errno == EAGAIN)
+        {
+            ESP_LOGW("TAG", "send stalled for %d ms, peer lost", LWIP_SEND_TIMEOUT_MS);
+        }
+
+        shutdown(sock, SHUT_RDWR);                              /* 接收循环随即返回并重连 */
+        return -1;
+    }
+
+    return 0;
+#else
+    const uint8_t *p = (const uint8_t *)data;
+    int ret;
+
+    while (len > 0)
     {
-        if (g_lwip_connect_state == 1) /* 有数据要发送 */
+        ret = send(sock, p, len, 0);
+
+        if (ret > 0)
+        {
+            p += ret;
+            len -= ret;
+        }
+        else if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else
         {
-            camera_frame = esp_camera_fb_get();
-            send(g_sock, camera_frame->buf, camera_frame->len,0);
-            esp_camera_fb_return(camera_frame);
+            if (ret < 0 && errno == EAGAIN)
+            {
+                ESP_LOGW("TAG", "send stalled for %d ms, peer lost", LWIP_SEND_TIMEOUT_MS);
+            }
+
+#if !LWIP_RTP_EN
+            shutdown(sock, SHUT_RDWR);                          /* 发送停滞或出错视为断线, 接收循环随即返回并重连 */
+#endif
+            return -1;
+        }
+    }
+
+    return 0;
+#endif
+}
+#endif
+
+/**
+ * @brief       回复服务器的时延统计请求(以 FRAME_FLAG_STATS 帧发送, 不打断图像帧)
+ * @param       sock : 套接字
+ * @retval      无
+ */
+static void lwip_send_stats(int sock)
+{
+    static char text[640 + 1536 + 1024 + 512];                  /* 时延统计 + 各任务CPU占用 + 堆内存 + 热点区间计数 */
+    frame_header_t hdr;
+    int len;
+
+    g_stats_request = 0;
+    len = frame_stats_format(text, 640);
+
+    if (len <= 0)
+    {
+        len = snprintf(text, 640, "no complete stats window yet\n");
+    }
+
+    len += task_topo_format(text + len, sizeof(text) - len - 1024 - 512);
+    len += heap_stats_format(text + len, sizeof(text) - len - 512);
+    len += perf_prof_format(text + len, sizeof(text) - len);
+
+    frame_header_fill_stats(&hdr, len, g_frame_seq, clock_sync_to_common(esp_timer_get_time()));
+
+#if LWIP_RTP_EN
+    (void)sock;
+    ESP_LOGI("TAG", "frame latency\n%s", text);                 /* RTP流中没有统计帧, 输出到日志 */
+#elif LWIP_ZEROCOPY_EN
+    (void)sock;
+    lwip_zc_send_copy(&hdr, text, len);
+#else
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);
+
+    if (lwip_send_all(sock, &hdr, sizeof(hdr)) == 0)
+    {
+        lwip_send_all(sock, text, len);
+    }
+
+    xSemaphoreGive(g_tx_lock);
+#endif
+}
+
+#if SOAK_EN && !LWIP_RTP_EN
+/**
+ * @brief       发送稳定性测试的每分钟一行(FRAME_FLAG_STATS帧, RTP流中只输出到串口)
+ * @param       sock : 套接字
+ * @retval      无
+ */
+static void lwip_send_soak(int sock)
+{
+    static char line[SOAK_LINE_SIZE];
+    frame_header_t hdr;
+    int len = soak_take(line, sizeof(line));
+
+    if (len <= 0)
+    {
+        return;
+    }
+
+    frame_header_fill_stats(&hdr, len, g_frame_seq, clock_sync_to_common(esp_timer_get_time()));
+
+#if LWIP_ZEROCOPY_EN
+    (void)sock;
+    lwip_zc_send_copy(&hdr, line, len);
+#else
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);
+
+    if (lwip_send_all(sock, &hdr, sizeof(hdr)) == 0)
+    {
+        lwip_send_all(sock, line, len);
+    }
+
+    xSemaphoreGive(g_tx_lock);
+#endif
+}
+#endif
+
+#if !LWIP_RTP_EN
+/**
+ * @brief       上传一个人脸检测结果(FRAME_PIXFORMAT_DETECT 元数据帧, 只发送有效的框)
+ * @param       sock   : 套接字
+ * @param       result : 检测结果
+ * @retval      无
+ */
+static void lwip_send_detect(int sock, const face_detect_result_t *result)
+{
+    frame_header_t hdr;
+    size_t len = offsetof(frame_detect_t, box) + result->meta.count * sizeof(frame_detect_box_t);
+
+    frame_header_fill_detect(&hdr, len, result->frames, clock_sync_to_common((int64_t)result->timestamp_us),
+                             result->width, result->height);
+
+#if LWIP_ZEROCOPY_EN
+    (void)sock;
+    lwip_zc_send_copy(&hdr, &result->meta, len);
+#else
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);
+
+    if (lwip_send_all(sock, &hdr, sizeof(hdr)) == 0)
+    {
+        lwip_send_all(sock, &result->meta, len);
+    }
+
+    xSemaphoreGive(g_tx_lock);
+#endif
+}
+#endif
+
+/**
+ * @brief       在同一连接上发送一段音频(FRAME_FLAG_AUDIO帧, 音频线程调用)
+ * @note        拷贝发送, 返回后PCM缓冲区即可复用; 未连接时直接返回
+ * @param       pcm          : 16位PCM数据
+ * @param       len          : 数据长度(字节)
+ * @param       sample_rate  : 采样率
+ * @param       channels     : 声道数
+ * @param       timestamp_us : 第一个采样点的时间戳(us, 与 fb->timestamp 同一时钟)
+ * @retval      0:发送成功; -1:未连接或发送失败
+ */
+int lwip_send_audio(const void *pcm, size_t len, uint16_t sample_rate, uint8_t channels, uint64_t timestamp_us)
+{
+    frame_header_t hdr;
+    int64_t start;
+    int ret = -1;
+
+    if (g_lwip_connect_state != 1 || LWIP_RTP_EN)               /* RTP模式只传输图像 */
+    {
+        return -1;
+    }
+
+    frame_header_fill_audio(&hdr, len, g_audio_seq++, clock_sync_to_common((int64_t)timestamp_us), sample_rate, channels);
+    start = esp_timer_get_time();
+
+#if LWIP_ZEROCOPY_EN
+    ret = lwip_zc_send_copy(&hdr, pcm, len);
+#else
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);
+    ret = lwip_send_all(g_sock, &hdr, sizeof(hdr));
+
+    if (ret == 0)
+    {
+        ret = lwip_send_all(g_sock, pcm, len);
+    }
+
+    xSemaphoreGive(g_tx_lock);
+#endif
+
+    trace_complete(TRACE_SEND_AUDIO, start, esp_timer_get_time(), (uint32_t)(sizeof(hdr) + len));
+
+    if (ret == 0)
+    {
+        metrics_count(METRIC_AUDIO_SENT);
+    }
+
+    return ret;
+}
+
+#if !LWIP_RTP_EN
+/**
+ * @brief       回填一帧断线期间缓存的图像(frame_spool线程调用), 也用于发送双码流的子码流(dual_stream线程调用)
+ * @note        未连接或链路拥塞(实时帧发送受阻)时拒绝, 回填不与实时帧争抢带宽
+ * @param       hdr  : 帧头(已置 FRAME_FLAG_SPOOL 或 FRAME_FLAG_PREVIEW, 时间戳为 esp_timer 时间, 发送时换算)
+ * @param       data : 图像数据
+ * @param       len  : 图像数据长度
+ * @retval      0:发送成功; -1:未发送
+ */
+static int lwip_send_spooled(const frame_header_t *hdr, const void *data, size_t len)
+{
+    frame_header_t out = *hdr;
+    int ret = -1;
+
+    if (g_lwip_connect_state != 1 || g_send_block_us > LWIP_SEND_BLOCK_MAX_US || wifi_sta_roaming())
+    {
+        return -1;
+    }
+
+    out.timestamp_us = clock_sync_to_common((int64_t)hdr->timestamp_us);
+
+#if LWIP_ZEROCOPY_EN
+    if (lwip_zc_pending() < LWIP_ZC_BACKLOG_MAX)
+    {
+        ret = lwip_zc_send_copy(&out, data, len);
+    }
+#else
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);
+    ret = lwip_send_all(g_sock, &out, sizeof(out));
+
+    if (ret == 0)
+    {
+        ret = lwip_send_all(g_sock, data, len);
+    }
+
+    xSemaphoreGive(g_tx_lock);
+#endif
+
+    return ret;
+}
+
+/**
+ * @brief       依次发送一批连拍帧(burst_capture线程调用)
+ * @note        与回填相同, 拥塞或断线时稍后重试, 超过 LWIP_BURST_SEND_TIMEOUT_MS 放弃剩余帧
+ * @param       batch : 一批连拍
+ * @retval      无
+ */
+static void lwip_send_burst(const burst_t *batch)
+{
+    int64_t deadline = esp_timer_get_time() + (int64_t)LWIP_BURST_SEND_TIMEOUT_MS * 1000;
+
+    for (int i = 0; i < batch->count; i++)
+    {
+        while (lwip_send_spooled(&batch->frames[i].hdr, batch->frames[i].buf, batch->frames[i].hdr.payload_len) != 0)
+        {
+            if (esp_timer_get_time() > deadline)
+            {
+                ESP_LOGW("TAG", "burst: %d of %u frames not sent", batch->count - i, batch->count);
+                return;
+            }
+
+            vTaskDelay(pdMS_TO_TICKS(20));
+        }
+    }
+}
+
+#if WIFI_ROAM_EN
+/**
+ * @brief       按序发出漫游期间暂存的帧, 未连接、拥塞或仍在切换时停下
+ * @param       无
+ * @retval      无
+ */
+static void lwip_roam_flush(void)
+{
+    while (g_roam_num > 0)
+    {
+        frame_header_t *hdr = &g_roam_held[g_roam_head].hdr;
+
+        if (lwip_send_spooled(hdr, g_roam_held[g_roam_head].buf, hdr->payload_len) != 0)
+        {
+            return;
+        }
+
+        metrics_frame_sent(hdr->header_len + hdr->payload_len, 0);
+        frame_pool_free(g_roam_held[g_roam_head].buf);
+        g_roam_head = (g_roam_head + 1) % LWIP_ROAM_HOLD_MAX;
+        g_roam_num--;
+
+        if (g_roam_num == 0)
+        {
+            ESP_LOGI("TAG", "roam: held frames sent, %lu lost", (unsigned long)g_roam_lost);
+            g_roam_lost = 0;
+        }
+    }
+}
+
+/**
+ * @brief       切换AP期间把帧拷贝到 frame_pool 暂存(TCP连接保持), 切换完成后先按序发出暂存帧再发实时帧
+ * @note        暂存未发完时新帧继续排在后面, 保证接收端按序号收到; 帧头已占用序号
+ * @param       hdr : 帧头(已按帧缓存填充)
+ * @param       fb  : 摄像头帧缓存
+ * @retval      1:已暂存或丢弃(帧缓存仍归调用者); 0:照常发送
+ */
+static int lwip_roam_hold(const frame_header_t *hdr, const camera_fb_t *fb)
+{
+    int roaming = wifi_sta_roaming();
+    uint8_t tail;
+    void *buf;
+
+    if (!roaming && g_roam_num == 0)
+    {
+        return 0;
+    }
+
+    if (!roaming)
+    {
+        lwip_roam_flush();
+
+        if (g_roam_num == 0)
+        {
+            return 0;
+        }
+    }
+
+    buf = (g_roam_num < LWIP_ROAM_HOLD_MAX && fb->format == PIXFORMAT_JPEG) ? frame_pool_alloc(fb->len) : NULL;
+
+    if (buf == NULL)
+    {
+        g_roam_lost++;
+        metrics_count(METRIC_DROP_OFFLINE);
+        return 1;
+    }
+
+    tail = (g_roam_head + g_roam_num) % LWIP_ROAM_HOLD_MAX;
+    memcpy(buf, fb->buf, fb->len);
+    g_roam_held[tail].hdr = *hdr;
+    g_roam_held[tail].buf = buf;
+    g_roam_num++;
+    return 1;
+}
+#endif
+#endif
+
+/**
+ * @brief       回复一条控制命令的执行结果(FRAME_FLAG_CTRL帧)
+ * @param       cmd    : 控制命令
+ * @param       status : CTRL_STATUS_xxx
+ * @retval      无
+ */
+static void lwip_send_ctrl_ack(const ctrl_cmd_t *cmd, int8_t status)
+{
+    frame_header_t hdr;
+    ctrl_clock_ack_t reply;                                     /* 其他命令只发送其中的 ctrl_ack_t */
+    size_t len = sizeof(ctrl_ack_t);
+
+    reply.ack.cmd = cmd->cmd;
+    reply.ack.seq = cmd->seq;
+    reply.ack.status = status;
+    reply.ack.reserved = 0;
+
+    if (cmd->cmd == CTRL_CMD_CLOCK_PING)
+    {
+        reply.t1_us = cmd->arg;
+        len = sizeof(reply);
+    }
+
+    frame_header_fill_stats(&hdr, len, g_frame_seq, clock_sync_to_common(esp_timer_get_time()));
+    hdr.flags = FRAME_FLAG_CTRL;
+
+#if LWIP_RTP_EN
+    ESP_LOGI("TAG", "ctrl cmd 0x%02x seq %u: %d", reply.ack.cmd, reply.ack.seq, reply.ack.status);  /* RTP流中没有应答帧, 输出到日志 */
+    (void)hdr;
+    (void)len;
+#elif LWIP_ZEROCOPY_EN
+    reply.device_us = esp_timer_get_time();
+    lwip_zc_send_copy(&hdr, &reply, len);
+#else
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);
+    reply.device_us = esp_timer_get_time();                     /* 取得发送锁后再记时间, 不含等待上一帧发完的时间 */
+
+    if (lwip_send_all(g_sock, &hdr, sizeof(hdr)) == 0)
+    {
+        lwip_send_all(g_sock, &reply, len);
+    }
+
+    xSemaphoreGive(g_tx_lock);
+#endif
+}
+
+/**
+ * @brief       执行一条控制命令
+ * @param       cmd : 控制命令
+ * @retval      CTRL_STATUS_xxx
+ */
+static int8_t lwip_ctrl_exec(const ctrl_cmd_t *cmd)
+{
+    roi_rect_t roi;
+    esp_err_t err;
+
+    switch (cmd->cmd)
+    {
+        case CTRL_CMD_SET_FRAMESIZE:
+            return (rate_ctrl_set_framesize((framesize_t)cmd->arg) == ESP_OK) ? CTRL_STATUS_OK : CTRL_STATUS_INVALID_ARG;
+
+        case CTRL_CMD_SET_QUALITY:
+            return (rate_ctrl_set_quality((int)cmd->arg) == ESP_OK) ? CTRL_STATUS_OK : CTRL_STATUS_INVALID_ARG;
+
+        case CTRL_CMD_SET_FPS_CAP:
+            if (cmd->arg < 0 || cmd->arg > FRAME_PACER_FPS_MAX)
+            {
+                return CTRL_STATUS_INVALID_ARG;
+            }
+
+            return (frame_pacer_set_fps((uint32_t)cmd->arg) == ESP_OK) ? CTRL_STATUS_OK : CTRL_STATUS_FAILED;
+
+        case CTRL_CMD_SNAPSHOT:
+            g_snapshot_request = 1;
+            return CTRL_STATUS_OK;
+
+        case CTRL_CMD_START:
+            g_uplink_paused = 0;
+            return CTRL_STATUS_OK;
+
+        case CTRL_CMD_STOP:
+            g_uplink_paused = 1;
+            return CTRL_STATUS_OK;
+
+        case CTRL_CMD_STATS:
+            g_stats_request = 1;                                /* 由发送线程在帧间隙回复 */
+            return CTRL_STATUS_OK;
+
+        case CTRL_CMD_WIFI_PROFILE:
+            if (cmd->arg < 0 || cmd->arg >= WIFI_PROFILE_NUM)
+            {
+                return CTRL_STATUS_INVALID_ARG;
+            }
+
+            return (wifi_profile_apply((wifi_profile_t)cmd->arg) == ESP_OK) ? CTRL_STATUS_OK : CTRL_STATUS_FAILED;
+
+        case CTRL_CMD_CLIP:
+            sd_recorder_trigger();
+            return CTRL_STATUS_OK;
+
+        case CTRL_CMD_REPLAY:
+            frame_spool_replay(clock_sync_to_local(cmd->arg));  /* 服务器看到的是换算后的时间戳 */
+            return CTRL_STATUS_OK;
+
+        case CTRL_CMD_SET_ROI:
+            roi.x = (uint16_t)(cmd->arg & 0xFFFF);
+            roi.y = (uint16_t)((cmd->arg >> 16) & 0xFFFF);
+            roi.w = (uint16_t)((cmd->arg >> 32) & 0xFFFF);
+            roi.h = (uint16_t)((cmd->arg >> 48) & 0xFFFF);
+            err = roi_stream_set(&roi);
+            return (err == ESP_OK) ? CTRL_STATUS_OK : ((err == ESP_ERR_INVALID_ARG) ? CTRL_STATUS_INVALID_ARG :
+                   ((err == ESP_ERR_NOT_SUPPORTED) ? CTRL_STATUS_UNSUPPORTED : CTRL_STATUS_FAILED));
+
+        case CTRL_CMD_BURST:
+            err = (cmd->arg > 0 && cmd->arg <= BURST_CAPTURE_MAX) ? burst_capture_start((uint8_t)cmd->arg) : ESP_ERR_INVALID_ARG;
+            return (err == ESP_OK) ? CTRL_STATUS_OK : ((err == ESP_ERR_INVALID_ARG) ? CTRL_STATUS_INVALID_ARG : CTRL_STATUS_FAILED);
+
+        case CTRL_CMD_JPEG_ABBREV:
+#if !LWIP_RTP_EN
+            g_jpeg_abbrev_reset = 1;                            /* 开启后的第一帧为完整帧 */
+            g_jpeg_abbrev_on = (cmd->arg != 0);
+            return CTRL_STATUS_OK;
+#else
+            return CTRL_STATUS_UNSUPPORTED;                     /* RTP/JPEG 自带表头处理 */
+#endif
+
+        case CTRL_CMD_JPEG_TILES:
+#if !LWIP_RTP_EN
+            g_jpeg_tiles_reset = 1;                             /* 开启后的第一帧为完整帧 */
+            g_jpeg_tiles_on = (cmd->arg != 0);
+            return CTRL_STATUS_OK;
+#else
+            return CTRL_STATUS_UNSUPPORTED;                     /* RTP/JPEG 接收端不支持分块替换 */
+#endif
+
+        case CTRL_CMD_STATIC_SKIP:
+#if !LWIP_RTP_EN
+            if (cmd->arg < 0 || cmd->arg > UINT32_MAX)
+            {
+                return CTRL_STATUS_INVALID_ARG;
+            }
+
+            g_static_reset = 1;                                 /* 开启后的第一帧上传图像 */
+            g_static_skip_ms = (uint32_t)cmd->arg;
+            return CTRL_STATUS_OK;
+#else
+            return CTRL_STATUS_UNSUPPORTED;                     /* RTP流中没有占位帧 */
+#endif
+
+        case CTRL_CMD_DETECT:
+#if !LWIP_RTP_EN && FACE_DETECT_EN
+            if (cmd->arg < 0 || cmd->arg > 2)
+            {
+                return CTRL_STATUS_INVALID_ARG;
+            }
+
+            g_detect_mode = (uint8_t)cmd->arg;
+            return CTRL_STATUS_OK;
+#else
+            return CTRL_STATUS_UNSUPPORTED;                     /* 未使能检测或RTP流中没有元数据帧 */
+#endif
+
+        case CTRL_CMD_CLOCK_PING:
+#if !LWIP_RTP_EN
+            return CTRL_STATUS_OK;                              /* 应答中附带设备时间 */
+#else
+            return CTRL_STATUS_UNSUPPORTED;                     /* RTP流中没有应答帧 */
+#endif
+
+        case CTRL_CMD_CLOCK_SET:
+            clock_sync_set_offset(cmd->arg);
+            return CTRL_STATUS_OK;
+
+        case CTRL_CMD_CAPTURE_AT:
+            if (cmd->arg < 0)
+            {
+                g_capture_at_us = -1;
+                return CTRL_STATUS_OK;
+            }
+
+            if (clock_sync_source() == CLOCK_SYNC_NONE)
+            {
+                return CTRL_STATUS_FAILED;                      /* 未校时, 各台摄像头没有共同的时刻 */
+            }
+
+            g_capture_at_us = clock_sync_to_local(cmd->arg);
+            return CTRL_STATUS_OK;
+
+        default:
+            return CTRL_STATUS_UNSUPPORTED;
+    }
+}
+
+/**
+ * @brief       解析接收到的数据中的二进制控制命令并执行
+ * @note        命令为定长 ctrl_cmd_t, 以 CTRL_PROTO_MAGIC 开头, 只从数据开头或上一条命令之后开始;
+ *              被TCP分段拆开的命令(包括只收到一部分的 magic)累积到 g_ctrl_pending, 补齐后再执行
+ * @param       buf : 接收到的数据
+ * @param       len : 数据长度
+ * @retval      从 buf 开头处理掉(执行或暂存)的字节数, 之后的字节不是控制命令, 由调用者按文本命令处理
+ */
+static int lwip_ctrl_input(const uint8_t *buf, int len)
+{
+    ctrl_cmd_t cmd;
+    uint32_t magic = CTRL_PROTO_MAGIC;
+    int offset = 0;
+    size_t n;
+    size_t m;
+
+    while (offset < len)
+    {
+        n = sizeof(ctrl_cmd_t) - g_ctrl_pending_len;
+        n = ((size_t)(len - offset) < n) ? (size_t)(len - offset) : n;
+        memcpy(g_ctrl_pending + g_ctrl_pending_len, buf + offset, n);
+
+        if (g_ctrl_pending_len < sizeof(magic))                 /* magic 还没有收全, 先核对已有的部分 */
+        {
+            m = g_ctrl_pending_len + n;
+            m = (m < sizeof(magic)) ? m : sizeof(magic);
+
+            if (memcmp(g_ctrl_pending, &magic, m) != 0)
+            {
+                if (g_ctrl_pending_len == 0)
+                {
+                    break;                                      /* 不是控制命令 */
+                }
+
+                g_ctrl_pending_len = 0;                         /* 暂存的只是文本末尾碰巧像 magic, 丢弃后从本次数据重新判断 */
+                continue;
+            }
+        }
+
+        g_ctrl_pending_len += n;
+        offset += n;
+
+        if (g_ctrl_pending_len < sizeof(ctrl_cmd_t))
+        {
+            break;                                              /* 数据已用完, 等下一次接收 */
+        }
+
+        memcpy(&cmd, g_ctrl_pending, sizeof(cmd));
+        g_ctrl_pending_len = 0;
+        lwip_send_ctrl_ack(&cmd, lwip_ctrl_exec(&cmd));
+    }
+
+    return offset;
+}
+
+/**
+ * @brief       把帧交给本地的其他使用者(LCD取景, MJPEG客户端各自增加引用计数; 抓图缓存、SD卡录像拷贝到自己的缓冲)
+ * @note        须在交给零拷贝发送之前调用
+ * @param       fb      : 摄像头帧缓存
+ * @param       analyze : 0:画面与上一次上传的几乎相同, 不交给移动侦测与人脸检测(结果不会变化, 省去解码)
+ * @retval      无
+ */
+static void lwip_frame_share(camera_fb_t *fb, int analyze)
+{
+    lcd_preview_offer(fb);
+    mjpeg_server_offer(fb);
+    snapshot_offer(fb);
+    sd_recorder_offer(fb);
+
+    if (analyze)
+    {
+        motion_detect_offer(fb);
+        face_detect_offer(fb);
+    }
+}
+
+/**
+ * @brief       未连接服务器时处理一帧: 交给本地使用者, 曾连接过时另缓存到Flash待重连后回填
+ * @param       fb : 摄像头帧缓存
+ * @retval      无
+ */
+static void lwip_frame_offline(camera_fb_t *fb)
+{
+    metrics_count(METRIC_DROP_OFFLINE);
+    lwip_frame_share(fb, 1);
+
+    if (g_spool_ready && g_frame_seq > 0)
+    {
+        frame_spool_offer(fb, g_frame_seq++);                   /* 占用序号, 接收端据此把回填帧放回原位置 */
+    }
+}
+
+/**
+ * @brief       判断本帧是否为 CTRL_CMD_CAPTURE_AT 指定时刻的帧(每帧调用一次)
+ * @note        传感器不与其他摄像头同步, 只能选最接近的一帧: 以上一帧间隔估计下一帧, 本帧比下一帧更接近目标时选中,
+ *              误差不超过半个帧间隔; 目标已过时选中当前帧
+ * @param       fb : 摄像头帧缓存
+ * @retval      1:选中(目标随即清除); 0:未到或未设置
+ */
+static int lwip_capture_at_hit(const camera_fb_t *fb)
+{
+    int64_t ts = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    int64_t half = (ts - g_capture_prev_us) / 2;
+    int64_t at = g_capture_at_us;
+
+    g_capture_prev_us = ts;
+
+    if (half <= 0 || half > LWIP_CAPTURE_AT_HALF_MAX_US)
+    {
+        half = LWIP_CAPTURE_AT_HALF_MAX_US;                     /* 刚开始采集或中间有帧被丢弃, 间隔不可信 */
+    }
+
+    if (at < 0 || ts + half < at)
+    {
+        return 0;
+    }
+
+    g_capture_at_us = -1;
+    ESP_LOGI("TAG", "capture at: frame %lld us from target", ts - at);
+    return 1;
+}
+
+/**
+ * @brief       判断本帧是否上传(控制命令的暂停/帧率上限/抓拍, 硬件触发, 以及移动侦测)
+ * @param       fb : 摄像头帧缓存
+ * @retval      2:抓拍, 须上传图像; 1:上传; 0:跳过
+ */
+static int lwip_uplink_gate(const camera_fb_t *fb)
+{
+    if (lwip_capture_at_hit(fb))
+    {
+        return 2;
+    }
+
+    if (hw_trigger_take())
+    {
+        return 2;                                               /* PIR/门磁触发, 跳过暂停与帧率上限 */
+    }
+
+    if (g_snapshot_request)
+    {
+        g_snapshot_request = 0;
+        return 2;
+    }
+
+    if (g_uplink_paused || !frame_pacer_admit(fb) || !motion_detect_gate(fb))
+    {
+        return 0;
+    }
+
+#if !LWIP_RTP_EN
+    if (g_detect_mode == 2 && fb->format == PIXFORMAT_JPEG && !face_detect_active())
+    {
+        return 0;                                               /* 无人期间只上传检测元数据 */
+    }
+#endif
+
+    return 1;
+}
+
+#if !LWIP_RTP_EN
+/**
+ * @brief       开启 CTRL_CMD_JPEG_ABBREV 时为JPEG帧附加表头编号, 表头与上一帧相同时省略
+ * @note        省略表头的帧清除 FRAME_FLAG_KEY, 负载为帧缓存末尾 payload_len 字节(从SOS标记开始)
+ * @param       hdr : 帧头(已按帧缓存填充)
+ * @param       fb  : 摄像头帧缓存
+ * @retval      无
+ */
+static void lwip_frame_abbrev(frame_header_jpeg_t *hdr, const camera_fb_t *fb)
+{
+    size_t skip;
+
+    memset(hdr->reserved, 0, sizeof(hdr->reserved));
+    hdr->table_id = 0;
+    hdr->ext_flags = 0;
+
+    if (g_jpeg_abbrev_reset)
+    {
+        g_jpeg_abbrev_reset = 0;
+        jpeg_abbrev_reset(&g_jpeg_abbrev);
+    }
+
+    if (!g_jpeg_abbrev_on || fb->format != PIXFORMAT_JPEG)
+    {
+        return;                                                 /* 帧头保持 frame_header_t 的长度 */
+    }
+
+    hdr->base.header_len = sizeof(frame_header_jpeg_t);
+
+    if (jpeg_abbrev_offer(&g_jpeg_abbrev, fb->buf, fb->len, &hdr->table_id, &skip))
+    {
+        hdr->base.flags &= ~FRAME_FLAG_KEY;
+        hdr->base.payload_len -= skip;
+    }
+}
+
+/**
+ * @brief       按帧尺寸准备分块编码的状态与缓冲(首次开启或帧变大时申请)
+ * @param       fb : 摄像头帧缓存
+ * @retval      true:可以编码; false:内存不足
+ */
+static bool lwip_tiles_prepare(const camera_fb_t *fb)
+{
+    size_t blocks = (size_t)((fb->width + 7) / 8) * ((fb->height + 7) / 8) * 3;
+    size_t cap = fb->len + fb->len / 4 + 2048;                  /* 完整帧有重同步标记, 比原图略大 */
+
+    if (g_jpeg_tiles == NULL)
+    {
+        g_jpeg_tiles = heap_stats_malloc(HEAP_TAG_REQUANT, sizeof(jpg_tiles_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+        if (g_jpeg_tiles == NULL)
+        {
+            return false;
+        }
+
+        memset(g_jpeg_tiles, 0, sizeof(jpg_tiles_t));
+    }
+
+    if (g_jpeg_tiles->ref_cap < blocks)
+    {
+        heap_stats_free(HEAP_TAG_REQUANT, g_jpeg_tiles->ref);
+        g_jpeg_tiles->ref = heap_stats_malloc(HEAP_TAG_REQUANT, blocks * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+        g_jpeg_tiles->ref_cap = (g_jpeg_tiles->ref != NULL) ? blocks : 0;
+        jpg_tiles_reset(g_jpeg_tiles);
+    }
+
+    if (g_jpeg_tiles_cap < cap)
+    {
+        heap_stats_free(HEAP_TAG_REQUANT, g_jpeg_tiles_buf);
+        g_jpeg_tiles_buf = heap_stats_malloc(HEAP_TAG_REQUANT, cap, MALLOC_CAP_SPIRAM);
+        g_jpeg_tiles_cap = (g_jpeg_tiles_buf != NULL) ? cap : 0;
+    }
+
+    return g_jpeg_tiles->ref_cap != 0 && g_jpeg_tiles_cap != 0;
+}
+
+/**
+ * @brief       开启 CTRL_CMD_JPEG_TILES 时按分块编码JPEG帧
+ * @note        完整帧保留 FRAME_FLAG_KEY(带DRI的JPEG); 增量帧清除 FRAME_FLAG_KEY, pixformat 为 FRAME_PIXFORMAT_JPEG_TILES
+ * @param       hdr : 帧头(已按帧缓存填充)
+ * @param       fb  : 摄像头帧缓存
+ * @retval      负载(hdr->payload_len 已更新); NULL:未开启或编码失败, 按原图发送
+ */
+static const uint8_t *lwip_frame_tiles(frame_header_t *hdr, const camera_fb_t *fb)
+{
+    size_t out_len;
+    bool key;
+
+    if (g_jpeg_tiles_reset && g_jpeg_tiles != NULL)
+    {
+        g_jpeg_tiles_reset = 0;
+        jpg_tiles_reset(g_jpeg_tiles);
+    }
+
+    if (!g_jpeg_tiles_on || fb->format != PIXFORMAT_JPEG || !lwip_tiles_prepare(fb))
+    {
+        return NULL;
+    }
+
+    g_jpeg_tiles_reset = 0;                                     /* 刚申请的状态本身就从完整帧开始 */
+
+    if (jpg_tiles_encode(g_jpeg_tiles, fb->buf, fb->len, LWIP_TILES_QUALITY,
+                         g_jpeg_tiles_buf, g_jpeg_tiles_cap, &out_len, &key) != JPG_REQUANT_OK)
+    {
+        jpg_tiles_reset(g_jpeg_tiles);                          /* 原图不带DRI, 下一帧重新从完整帧开始 */
+        return NULL;
+    }
+
+    if (!key)
+    {
+        hdr->flags &= ~FRAME_FLAG_KEY;
+        hdr->pixformat = FRAME_PIXFORMAT_JPEG_TILES;
+    }
+
+    hdr->payload_len = (uint32_t)out_len;
+    return g_jpeg_tiles_buf;
+}
+
+/**
+ * @brief       传感器不支持开窗时, 按ROI在压缩域裁剪JPEG帧(roi_stream_crop)
+ * @note        裁剪帧不再分块编码或省略表头, 帧头的宽高为裁剪后的尺寸
+ * @param       hdr : 帧头(已按帧缓存填充)
+ * @param       fb  : 摄像头帧缓存
+ * @retval      负载(hdr->payload_len 已更新); NULL:未设置压缩域裁剪或裁剪失败, 按原图发送
+ */
+static const uint8_t *lwip_frame_crop(frame_header_t *hdr, const camera_fb_t *fb)
+{
+    const uint8_t *out;
+    size_t out_len;
+    uint16_t w;
+    uint16_t h;
+
+    out = roi_stream_crop(fb, &out_len, &w, &h);
+
+    if (out == NULL)
+    {
+        return NULL;
+    }
+
+    g_jpeg_tiles_reset = g_jpeg_tiles_on;                       /* 接收端的分块参考换成了裁剪帧 */
+    hdr->width = w;
+    hdr->height = h;
+    hdr->payload_len = (uint32_t)out_len;
+    return out;
+}
+
+#if LWIP_FRAME_META_EN
+/**
+ * @brief       为图像帧附加驱动采样的传感器寄存器(曝光/增益/白平衡)
+ * @note        寄存器由驱动在消隐期异步读取并随帧缓存保存, 这里只是拷贝, 不访问SCCB;
+ *              驱动尚无采样(刚启动或传感器不支持)时帧头保持原长度
+ * @param       hdr : 帧头(已按帧缓存填充, 可能已由 lwip_frame_abbrev 扩展)
+ * @param       fb  : 摄像头帧缓存
+ * @retval      无
+ */
+static void lwip_frame_meta(frame_header_meta_t *hdr, const camera_fb_t *fb)
+{
+    camera_fb_meta_t meta;
+
+    if (esp_camera_fb_get_meta(fb, &meta) != ESP_OK)
+    {
+        return;
+    }
+
+    if (hdr->jpeg.base.header_len < sizeof(frame_header_jpeg_t))
+    {
+        hdr->jpeg.table_id = 0;                                 /* 未经 lwip_frame_abbrev(分块编码帧), 扩展字段须清零 */
+        memset(hdr->jpeg.reserved, 0, sizeof(hdr->jpeg.reserved));
+    }
+
+    hdr->jpeg.ext_flags = FRAME_EXT_META;
+    hdr->jpeg.base.header_len = sizeof(frame_header_meta_t);
+    hdr->meta.sensor_pid = meta.sensor_pid;
+    hdr->meta.count = meta.count;
+    hdr->meta.age = meta.age;
+    memset(hdr->meta.reg, 0, sizeof(hdr->meta.reg));
+    memset(hdr->meta.value, 0, sizeof(hdr->meta.value));
+    memcpy(hdr->meta.reg, meta.reg, meta.count * sizeof(uint16_t));
+    memcpy(hdr->meta.value, meta.value, meta.count);
+}
+#endif
+#endif
+
+/**
+ * @brief       发送图像帧之前先发送待发的统计与检测元数据帧
+ * @param       sock : 套接字
+ * @retval      无
+ */
+static void lwip_send_pending(int sock)
+{
+    if (heap_stats_due())
+    {
+        g_stats_request = 1;                                    /* 周期性主动发送, 多日运行的内存趋势可在服务器端追溯 */
+    }
+
+    if (g_stats_request)
+    {
+        lwip_send_stats(sock);
+    }
+
+#if SOAK_EN && !LWIP_RTP_EN
+    lwip_send_soak(sock);
+#endif
+
+#if !LWIP_RTP_EN
+    if (g_detect_mode != 0)
+    {
+        face_detect_result_t detect;
+
+        if (face_detect_take(&detect, &g_detect_seen))
+        {
+            lwip_send_detect(sock, &detect);                    /* 检测线程异步运行, 结果对应的是稍早的一帧 */
+        }
+    }
+#endif
+}
+
+#if !LWIP_RTP_EN
+/**
+ * @brief       开启 CTRL_CMD_STATIC_SKIP 时判断本帧是否与上一次上传的图像几乎相同(只读压缩数据, 不解码)
+ * @note        距上一次上传图像超过最长间隔时不算相同, 接收端至少每隔该时间收到一帧真实图像
+ * @param       fb : 摄像头帧缓存
+ * @retval      1:几乎相同; 0:有变化、未开启或不是JPEG
+ */
+static int lwip_static_same(const camera_fb_t *fb)
+{
+    uint32_t skip_ms = g_static_skip_ms;
+
+    if (g_static_reset)
+    {
+        g_static_reset = 0;
+        g_static_ref.len = 0;
+    }
+
+    if (skip_ms == 0 || fb->format != PIXFORMAT_JPEG ||
+        !jpg_sig_compute(fb->buf, fb->len, (uint16_t)fb->width, (uint16_t)fb->height, &g_static_cur))
+    {
+        g_static_cur.len = 0;                                   /* 本帧上传后不作为参考 */
+        return 0;
+    }
+
+    return jpg_sig_similar(&g_static_cur, &g_static_ref) &&
+           (esp_timer_get_time() - g_static_ref_us < (int64_t)skip_ms * 1000);
+}
+
+/**
+ * @brief       以占位帧(FRAME_PIXFORMAT_UNCHANGED, 只有帧头)代替与上一次上传几乎相同的帧
+ * @param       sock : 套接字
+ * @param       fb   : 摄像头帧缓存
+ * @retval      无
+ */
+static void lwip_send_unchanged(int sock, const camera_fb_t *fb)
+{
+    frame_header_t hdr;
+
+    frame_header_fill(&hdr, fb, g_frame_seq++);                 /* 占用序号, 接收端不把它当作丢帧 */
+    hdr.pixformat = FRAME_PIXFORMAT_UNCHANGED;
+    hdr.flags = motion_detect_active() ? FRAME_FLAG_MOTION : 0;
+    hdr.payload_len = 0;
+    hdr.timestamp_us = clock_sync_to_common((int64_t)hdr.timestamp_us);
+
+#if LWIP_ZEROCOPY_EN
+    (void)sock;
+    lwip_zc_send_copy(&hdr, NULL, 0);
+#else
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);
+    lwip_send_all(sock, &hdr, sizeof(hdr));
+    xSemaphoreGive(g_tx_lock);
+#endif
+
+    metrics_count(METRIC_DROP_STATIC);
+}
+#endif
+
+/**
+ * @brief       发送一帧图像(帧头 + 图像数据)
+ * @note        零拷贝模式下发送成功后帧缓存由 lwip_zerocopy 持有, 确认后经 lwip_frame_release 归还;
+ *              同时统计发送阻塞时间, 作为链路拥塞的依据
+ * @param       sock : 套接字
+ * @param       fb   : 摄像头帧缓存
+ * @retval      0:发送成功; 1:已拷贝发送(分块编码的负载, 帧缓存仍归调用者); -1:发送失败、无移动期间跳过
+ *              或画面未变化(帧缓存仍归调用者)
+ */
+static int lwip_send_frame(int sock, camera_fb_t *fb)
+{
+    frame_header_meta_t hdr;
+    const uint8_t *payload = NULL;
+    camera_prof_mark_t prof;
+    int64_t start;
+    int64_t end;
+    uint32_t cost;
+    int same = 0;
+    int gate;
+    int ret;
+
+    lwip_send_pending(sock);
+#if !LWIP_RTP_EN
+    same = lwip_static_same(fb);                                /* 在解码类分析之前, 只读压缩数据 */
+#endif
+    lwip_frame_share(fb, !same);                                /* 取景、MJPEG客户端与录像共享本帧, 须在交给零拷贝发送之前 */
+    gate = lwip_uplink_gate(fb);
+
+    if (gate == 0)
+    {
+        metrics_count(METRIC_DROP_GATED);
+        return -1;                                              /* 暂停、超过帧率上限或无移动期间的低帧率 */
+    }
+
+#if !LWIP_RTP_EN
+    if (same && gate == 1)
+    {
+        lwip_send_unchanged(sock, fb);
+        return -1;                                              /* 画面未变化, 只发送占位帧 */
+    }
+
+    if (g_static_cur.len != 0)
+    {
+        g_static_ref = g_static_cur;                            /* 本帧上传图像, 成为之后比较的参考 */
+        g_static_ref_us = esp_timer_get_time();
+    }
+
+    if (dual_stream_offer(fb, g_frame_seq))
+    {
+        g_frame_seq++;
+        return -1;                                              /* 子码流由转码线程缩小后发送, 帧缓存仍归调用者 */
+    }
+#else
+    if (h264_stream_offer(fb, sock))
+    {
+        g_frame_seq++;
+        return -1;                                              /* YUV帧由编码线程编码后发送, 帧缓存仍归调用者 */
+    }
+#endif
+
+    frame_header_fill(&hdr.jpeg.base, fb, g_frame_seq++);
+
+    if (motion_detect_active())
+    {
+        hdr.jpeg.base.flags |= FRAME_FLAG_MOTION;
+    }
+
+#if !LWIP_RTP_EN
+#if WIFI_ROAM_EN
+    if (lwip_roam_hold(&hdr.jpeg.base, fb))
+    {
+        return -1;                                              /* 正在切换AP或暂存帧未发完: 已拷贝暂存, 帧缓存仍归调用者 */
+    }
+#endif
+#endif
+
+    pm_ctrl_acquire(PM_CTRL_NET);                               /* 裁剪、分块编码与写入协议栈期间CPU保持最高频率 */
+
+#if !LWIP_RTP_EN
+    payload = lwip_frame_crop(&hdr.jpeg.base, fb);              /* 裁剪与分块编码在计时之外, 发送阻塞时间只反映链路 */
+    payload = (payload == NULL) ? lwip_frame_tiles(&hdr.jpeg.base, fb) : payload;
+
+    if (payload == NULL)
+    {
+        lwip_frame_abbrev(&hdr.jpeg, fb);
+        payload = fb->buf + fb->len - hdr.jpeg.base.payload_len;
+    }
+
+#if LWIP_FRAME_META_EN
+    lwip_frame_meta(&hdr, fb);
+#endif
+#endif
+    hdr.jpeg.base.timestamp_us = clock_sync_to_common((int64_t)hdr.jpeg.base.timestamp_us);  /* 暂存与分块编码之后再换算 */
+    perf_prof_begin(&prof);
+    start = esp_timer_get_time();
+
+#if LWIP_RTP_EN
+    (void)payload;
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);                   /* 事件循环不会在发送中途关闭套接字 */
+    ret = (sock == g_sock) ? rtp_jpeg_send_frame(sock, fb) : -1;
+    xSemaphoreGive(g_tx_lock);
+#elif LWIP_ZEROCOPY_EN
+    (void)sock;
+
+    if (payload == fb->buf + fb->len - hdr.jpeg.base.payload_len)
+    {
+        ret = lwip_zc_send_frame(&hdr.jpeg.base, fb);
+    }
+    else
+    {
+        ret = (lwip_zc_send_copy(&hdr.jpeg.base, payload, hdr.jpeg.base.payload_len) == 0) ? 1 : -1;
+    }
+#else
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);
+    ret = lwip_send_all(sock, &hdr, hdr.jpeg.base.header_len);
+
+    if (ret == 0)
+    {
+        ret = lwip_send_all(sock, payload, hdr.jpeg.base.payload_len);
+    }
+
+    xSemaphoreGive(g_tx_lock);
+#endif
+
+    end = esp_timer_get_time();
+    perf_prof_end(PERF_REGION_SEND, &prof);
+    cost = (uint32_t)(end - start);
+    trace_complete(TRACE_SEND_FRAME, start, end, (uint32_t)(hdr.jpeg.base.header_len + hdr.jpeg.base.payload_len));
+
+    /* 滑动平均: avg = avg * 7/8 + cur / 8 */
+    g_send_block_us = g_send_block_us - (g_send_block_us >> 3) + (cost >> 3);
+
+    if (ret >= 0)
+    {
+        frame_stats_mark_tx(fb, start, end);
+        rate_ctrl_on_frame(hdr.jpeg.base.header_len + hdr.jpeg.base.payload_len, cost);
+        metrics_frame_sent(hdr.jpeg.base.header_len + hdr.jpeg.base.payload_len, cost);
+        hw_trigger_sent();
+    }
+    else
+    {
+        metrics_count(METRIC_DROP_SEND_ERROR);
+#if !LWIP_RTP_EN
+        g_jpeg_tiles_reset = g_jpeg_tiles_on;                   /* 接收端缺了这一帧的分块, 下一帧须为完整帧 */
+        g_static_reset = 1;                                     /* 接收端没有收到参考帧 */
+#endif
+    }
+
+    pm_ctrl_release(PM_CTRL_NET);
+    return ret;
+}
+
+#if LWIP_PIPELINE_EN
+/**
+ * @brief       判断链路是否拥塞(发送阻塞时间过长或未确认帧积压)
+ * @param       无
+ * @retval      1:拥塞; 0:正常
+ */
+static int lwip_link_congested(void)
+{
+#if LWIP_ZEROCOPY_EN
+    if (lwip_zc_pending() >= LWIP_ZC_BACKLOG_MAX)
+    {
+        return 1;
+    }
+#endif
+    return g_send_block_us > LWIP_SEND_BLOCK_MAX_US;
+}
+#endif
+
+/**
+ * @brief       读取WIFI发送积压(负载调控线程调用)
+ * @param       queued : 输出等待发送的帧数(串行模式为0)
+ * @retval      1:已连接且链路拥塞; 0:正常或未连接
+ */
+int lwip_tx_backlog(uint32_t *queued)
+{
+#if LWIP_PIPELINE_EN
+    *queued = (g_frame_queue != NULL) ? (uint32_t)uxQueueMessagesWaiting(g_frame_queue) : 0;
+    return (g_lwip_connect_state == 1) && lwip_link_congested();
+#else
+    *queued = 0;
+    return (g_lwip_connect_state == 1) && (g_send_block_us > LWIP_SEND_BLOCK_MAX_US);
+#endif
+}
+
+/**
+ * @brief       判断帧是否已过时
+ * @param       fb : 摄像头帧缓存
+ * @retval      1:过时; 0:未过时
+ */
+static int lwip_frame_stale(const camera_fb_t *fb)
+{
+    int64_t ts = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+
+    return (esp_timer_get_time() - ts) > (LWIP_FRAME_STALE_MS * 1000);
+}
+
+/**
+ * @brief       从驱动取一帧(每一帧都先交给连拍, 之后才可能因过时或拥塞被丢弃)
+ * @param       无
+ * @retval      帧缓存, NULL:超时
+ */
+static camera_fb_t *lwip_camera_get(void)
+{
+#if SYNTH_FRAME_EN
+    camera_fb_t *fb = synth_frame_get();                        /* 合成帧固件: 只测量网络发送 */
+#else
+    camera_fb_t *fb = esp_camera_fb_get();
+#endif
+    camera_fb_timing_t t;
+
+    if (fb != NULL)
+    {
+        if (esp_camera_fb_get_timing(fb, &t) == ESP_OK)         /* 驱动中断与cam_task记下的时间, 补记为跟踪事件 */
+        {
+            trace_complete(TRACE_CAM_SENSOR, t.vsync_us, t.dma_eof_us, (uint32_t)fb->len);
+            trace_complete(TRACE_CAM_TASK, t.dma_eof_us, t.queued_us, 0);
+            trace_complete(TRACE_CAM_QUEUE, t.queued_us, t.dequeued_us, 0);
+            trace_complete(TRACE_CAM_TAKE, t.dequeued_us, t.taken_us, 0);
+        }
+
+        trace_camera_drain();                                   /* 驱动中断、cam_task 与 cam_take 的探针 */
+
+        metrics_count(METRIC_FRAMES_CAPTURED);
+        burst_capture_offer(fb);
+    }
+
+    return fb;
+}
+
+/**
+ * @brief       记录一次丢帧
+ * @param       无
+ * @retval      无
+ */
+static void lwip_frame_drop_count(void)
+{
+    g_frame_dropped++;
+    rate_ctrl_on_drop();
+    metrics_count(METRIC_DROP_STALE);
+
+    if ((g_frame_dropped % 100) == 0)
+    {
+        ESP_LOGW("TAG", "link congested, %lu stale frames dropped, send block avg %lu us",
+                 (unsigned long)g_frame_dropped, (unsigned long)g_send_block_us);
+    }
+}
+
+/**
+ * @brief       归还帧缓存(释放在途窗口)
+ * @param       fb : 摄像头帧缓存
+ * @retval      无
+ */
+static void lwip_frame_release(camera_fb_t *fb)
+{
+    frame_stats_commit(fb, 1);
+#if SYNTH_FRAME_EN
+    synth_frame_return(fb);
+#else
+    esp_camera_fb_return(fb);
+#endif
+#if LWIP_PIPELINE_EN
+    xSemaphoreGive(g_frame_window);
+#endif
+}
+
+#if LWIP_CUT_THROUGH_EN
+/**
+ * @brief       发送一个分段(uint32 长度 + 数据), 返回前累计发送耗时
+ * @param       sock : 套接字
+ * @param       len  : 分段长度(0 或 FRAME_CHUNK_ABORT 时 data 为 NULL)
+ * @param       data : 分段数据
+ * @param       cost : 累计发送耗时(us)
+ * @retval      0:成功; -1:失败
+ */
+static int lwip_send_chunk(int sock, uint32_t len, const void *data, uint32_t *cost)
+{
+    int64_t start = esp_timer_get_time();
+    int ret = lwip_send_all(sock, &len, sizeof(len));
+
+    if (ret == 0 && data != NULL)
+    {
+        ret = lwip_send_all(sock, data, len);
+    }
+
+    *cost += (uint32_t)(esp_timer_get_time() - start);
+    return ret;
+}
+
+/**
+ * @brief       边采集边发送一帧JPEG(FRAME_EXT_CHUNKED): DMA每写完一段即交给协议栈, 不等整帧采集完成
+ * @note        省略表头、分块编码、压缩域ROI裁剪与漫游暂存需要完整帧, 这些功能开启期间返回-1, 由调用者按整帧发送;
+ *              帧头到结束分段之间持有 g_tx_lock, 音频帧排在本帧之后
+ * @param       sock : 套接字
+ * @retval      0:已处理一帧(发送、跳过或作废); -1:不适用
+ */
+static int lwip_send_cut_through(int sock)
+{
+    frame_header_jpeg_t hdr;
+    camera_fb_t *fb = NULL;
+    size_t avail = 0;
+    size_t sent = 0;
+    uint32_t cost = 0;
+    int64_t start;
+    int64_t end;
+    esp_err_t err;
+    int send;
+    int ret = 0;
+
+#if WIFI_ROAM_EN
+    if (wifi_sta_roaming() || g_roam_num != 0)
+    {
+        return -1;
+    }
+#endif
+
+    if (g_jpeg_abbrev_on || g_jpeg_tiles_on || roi_stream_crop_active())
+    {
+        return -1;
+    }
+
+    err = esp_camera_fb_stream_begin(&fb, LWIP_CUT_THROUGH_WAIT_MS);
+
+    if (err == ESP_ERR_NOT_SUPPORTED)
+    {
+        return -1;                                              /* 驱动未开启或不是JPEG格式 */
+    }
+
+    if (err != ESP_OK)
+    {
+        return 0;
+    }
+
+    lwip_send_pending(sock);
+    send = lwip_uplink_gate(fb);                                /* 跳过的帧仍读完, 交给本地使用者 */
+
+    if (send)
+    {
+        frame_header_fill(&hdr.base, fb, g_frame_seq++);
+        hdr.base.header_len = sizeof(frame_header_jpeg_t);
+        hdr.base.payload_len = 0;
+        hdr.base.timestamp_us = clock_sync_to_common((int64_t)hdr.base.timestamp_us);
+        hdr.table_id = 0;
+        hdr.ext_flags = FRAME_EXT_CHUNKED;
+        memset(hdr.reserved, 0, sizeof(hdr.reserved));
+
+        if (motion_detect_active())
+        {
+            hdr.base.flags |= FRAME_FLAG_MOTION;
+        }
+    }
+    else
+    {
+        metrics_count(METRIC_DROP_GATED);
+    }
+
+    pm_ctrl_acquire(PM_CTRL_NET);                               /* 等待传感器期间也保持, 每段数据到达后立即写入协议栈 */
+    start = esp_timer_get_time();
+    xSemaphoreTake(g_tx_lock, portMAX_DELAY);
+
+    if (send)
+    {
+        ret = lwip_send_all(sock, &hdr, sizeof(hdr));
+    }
+
+    do
+    {
+        err = esp_camera_fb_stream_wait(fb, &avail, LWIP_CUT_THROUGH_WAIT_MS);
+
+        if (send && ret == 0 && avail > sent && (err == ESP_OK || err == ESP_ERR_NOT_FINISHED))
+        {
+            ret = lwip_send_chunk(sock, avail - sent, fb->buf + sent, &cost);
+            sent = avail;
+        }
+    } while (err == ESP_ERR_NOT_FINISHED);
+
+    if (send && ret == 0)
+    {
+        if (err == ESP_OK)
+        {
+            /* 结束分段之后为实际长度, 已发送的数据可能包含EOI之后的DMA填充 */
+            ret = lwip_send_chunk(sock, 0, NULL, &cost);
+            ret = (ret == 0) ? lwip_send_chunk(sock, (uint32_t)avail, NULL, &cost) : ret;
+        }
+        else
+        {
+            ret = lwip_send_chunk(sock, FRAME_CHUNK_ABORT, NULL, &cost);
+        }
+    }
+
+    xSemaphoreGive(g_tx_lock);
+    end = esp_timer_get_time();
+    pm_ctrl_release(PM_CTRL_NET);
+
+    if (err == ESP_ERR_TIMEOUT)
+    {
+        esp_camera_fb_stream_cancel(fb);                        /* 采集中的帧完成后进入帧队列 */
+    }
+
+    if (err != ESP_OK)
+    {
+        return 0;                                               /* 作废的帧已由驱动回收 */
+    }
+
+    trace_complete(TRACE_SEND_FRAME, start, end, (uint32_t)(sizeof(hdr) + sent));
+    metrics_count(METRIC_FRAMES_CAPTURED);
+    burst_capture_offer(fb);
+
+    if (send && ret == 0)
+    {
+        frame_stats_mark_tx(fb, start, end);
+        rate_ctrl_on_frame(sizeof(hdr) + avail, cost);          /* 只计入协议栈阻塞时间, 不含等待传感器的时间 */
+        metrics_frame_sent(sizeof(hdr) + avail, cost);
+        hw_trigger_sent();
+    }
+    else if (send)
+    {
+        metrics_count(METRIC_DROP_SEND_ERROR);
+    }
+
+    lwip_frame_share(fb, 1);
+    lwip_frame_release(fb);
+    return 0;
+}
+#endif
+
+#if LWIP_PIPELINE_EN
+/**
+ * @brief       选取最新的帧(流水线模式)
+ * @note        链路拥塞、当前帧已过时或有硬件触发待发出, 且队列中还有更新的帧时, 丢弃旧帧, 始终发送最新一帧
+ * @param       fb : 当前取出的帧
+ * @retval      需要发送的帧
+ */
+static camera_fb_t *lwip_pick_freshest(camera_fb_t *fb)
+{
+    camera_fb_t *newer = NULL;
+
+    while ((lwip_link_congested() || lwip_frame_stale(fb) || hw_trigger_pending()) &&
+           xQueueReceive(g_frame_queue, &newer, 0) == pdTRUE)
+    {
+        lwip_frame_release(fb);
+        lwip_frame_drop_count();
+        fb = newer;
+    }
+
+    return fb;
+}
+
+/**
+ * @brief       采集线程函数(流水线模式)
+ * @note        先占用一个在途窗口再取帧, 保证DMA始终有空闲帧缓存可写
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void lwip_capture_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    camera_fb_t *camera_frame = NULL;
+
+    load_gov_watch(LOAD_GOV_VIDEO);
+
+    while (1)
+    {
+        /* 连接了服务器、有MJPEG客户端、正在录像、断线缓存或有抓图轮询时才采集 */
+        xEventGroupWaitBits(g_lwip_event, LWIP_CONNECTED_BIT | LWIP_VIEWER_BIT | LWIP_RECORD_BIT | LWIP_SPOOL_BIT | LWIP_SNAPSHOT_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+        xSemaphoreTake(g_frame_window, portMAX_DELAY);
+
+        camera_frame = lwip_camera_get();
+
+        if (camera_frame == NULL)
+        {
+            xSemaphoreGive(g_frame_window);
+            continue;
+        }
+
+        xQueueSend(g_frame_queue, &camera_frame, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief       发送数据线程函数(流水线模式)
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void lwip_send_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    camera_fb_t *camera_frame = NULL;
+
+    load_gov_watch(LOAD_GOV_VIDEO);
+
+    while (1)
+    {
+#if LWIP_ZEROCOPY_EN
+        /* 有帧等待确认时限时等待, 以便及时归还已确认的帧 */
+        TickType_t wait = lwip_zc_pending() ? pdMS_TO_TICKS(LWIP_ZC_POLL_MS) : portMAX_DELAY;
+
+        if (xQueueReceive(g_frame_queue, &camera_frame, wait) != pdTRUE)
+        {
+            lwip_zc_reclaim(lwip_frame_release);
+            continue;
+        }
+
+        /* 未连接服务器时只给本地使用者(断开期间排队的旧帧也直接归还) */
+        if (g_lwip_connect_state != 1)
+        {
+            lwip_frame_offline(camera_frame);
+            lwip_frame_release(camera_frame);
+            lwip_zc_reclaim(lwip_frame_release);
+            continue;
+        }
+
+        camera_frame = lwip_pick_freshest(camera_frame);
+
+        if (lwip_send_frame(g_sock, camera_frame) != 0)
+        {
+            lwip_frame_release(camera_frame);
+        }
+
+        lwip_zc_reclaim(lwip_frame_release);
+#else
+        xQueueReceive(g_frame_queue, &camera_frame, portMAX_DELAY);
+
+        /* 未连接服务器时只给本地使用者(断开期间排队的旧帧也直接归还) */
+        if (g_lwip_connect_state == 1)
+        {
+            camera_frame = lwip_pick_freshest(camera_frame);
+            lwip_send_frame(g_sock, camera_frame);
+        }
+        else
+        {
+            lwip_frame_offline(camera_frame);
+        }
+
+        lwip_frame_release(camera_frame);
+#endif
+    }
+}
+#else
+/**
+ * @brief       发送数据线程函数
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void lwip_send_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    camera_fb_t *camera_frame = NULL;
+
+    load_gov_watch(LOAD_GOV_VIDEO);
+
+    while (1)
+    {
+        /* 未连接、无MJPEG客户端、未录像且无需断线缓存时阻塞等待事件, 不再轮询 */
+        xEventGroupWaitBits(g_lwip_event, LWIP_CONNECTED_BIT | LWIP_VIEWER_BIT | LWIP_RECORD_BIT | LWIP_SPOOL_BIT | LWIP_SNAPSHOT_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+
+#if LWIP_CUT_THROUGH_EN
+        if (g_lwip_connect_state == 1 && lwip_send_cut_through(g_sock) == 0)
+        {
+            continue;                                           /* 本帧已边采集边发送 */
+        }
+#endif
+
+        /* 阻塞等待帧缓存队列中的新帧 */
+        camera_frame = lwip_camera_get();
+
+        /* 驱动队列中积压的旧帧直接归还, 最多丢弃 fb_count 帧, 之后取到的是新采集的帧 */
+        for (size_t i = 0; camera_frame != NULL && i < g_fb_count; i++)
+        {
+            if (!lwip_frame_stale(camera_frame))
+            {
+                break;
+            }
+
+            lwip_frame_release(camera_frame);
+            lwip_frame_drop_count();
+            camera_frame = lwip_camera_get();
+        }
+
+        if (camera_frame != NULL && g_lwip_connect_state != 1)  /* 只有本地使用者 */
+        {
+            lwip_frame_offline(camera_frame);
+            lwip_frame_release(camera_frame);
+        }
+        else if (camera_frame != NULL)
+        {
+#if LWIP_ZEROCOPY_EN
+            if (lwip_send_frame(g_sock, camera_frame) != 0)
+            {
+                lwip_frame_release(camera_frame);
+            }
+
+            /* 串行模式: 等待本帧被确认(或连接断开)后再采集下一帧 */
+            while (lwip_zc_pending())
+            {
+                lwip_zc_reclaim(lwip_frame_release);
+
+                if (lwip_zc_pending())
+                {
+                    vTaskDelay(pdMS_TO_TICKS(LWIP_ZC_POLL_MS));
+                }
+            }
+#else
+            lwip_send_frame(g_sock, camera_frame);
+            lwip_frame_release(camera_frame);
+#endif
         }
-        vTaskDelay(pdMS_TO_TICKS(1));
     }
 }
+#endif
@@ -22,17 +22,41 @@
 #define __LWIP_DEMO_H
 
 #include <string.h>
+#include <stdlib.h>
 #include <sys/socket.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_camera.h"
 #include "spilcd.h"
+#include "wifi_config.h"
+
+
+/* 需要自己设置远程IP地址(热点模式下为连上热点的电脑) */
+#if WIFI_SOFTAP_EN
+#define IP_ADDR   WIFI_SOFTAP_CLIENT_IP
+#else
+#define IP_ADDR   "192.168.31.117"
+#endif
+
+#define LWIP_DEMO_PORT               8000                       /* 连接的本地端口号 */
+
+/* 对端失联检测(AP漫游、电脑休眠等没有FIN的断开): 空闲连接 LWIP_KEEPIDLE_S 后开始探测, LWIP_KEEPCNT 次探测
+ * (间隔 LWIP_KEEPINTVL_S)无应答即断开; 发送 LWIP_SEND_TIMEOUT_MS 无进展(或零拷贝帧这么久未被确认)也视为断线, 约3s内重连 */
+#define LWIP_KEEPIDLE_S              1
+#define LWIP_KEEPINTVL_S             1
+#define LWIP_KEEPCNT                 2
+#define LWIP_SEND_TIMEOUT_MS         2000
 
 /* 函数声明 */
-void lwip_demo(void);
+void lwip_demo(const camera_config_t *config);
+int lwip_send_audio(const void *pcm, size_t len, uint16_t sample_rate, uint8_t channels, uint64_t timestamp_us);   /* 在同一连接上发送一段音频 */
+int lwip_tx_backlog(uint32_t *queued);                              /* 读取WIFI发送积压(负载调控) */
 
 #endif
@@ -0,0 +1,546 @@
+/**
+ ****************************************************************************************************
+ * @file        lwip_zerocopy.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       基于netconn的零拷贝帧发送
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * send() 会把整帧JPEG从PSRAM拷贝到lwIP发送缓冲, 这里改用 netconn_write(NETCONN_NOCOPY),
+ * 报文段直接引用帧缓存. 每帧写入后记录其末尾序号(snd_lbb), 当 lastack 越过该序号时
+ * 说明数据已全部被对端确认, 此时才通过回调归还帧缓存.
+ * 未开启 LWIP_TCPIP_CORE_LOCKING, 读取/终止 tcp_pcb 均通过 tcpip_api_call 在tcpip线程中完成.
+ *
+ ****************************************************************************************************
+ */
+
+#include "lwip_zerocopy.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lwip/api.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcpip_priv.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "net_qos.h"
+
+
+/* tcpip线程中执行的操作 */
+#define LWIP_ZC_OP_SND_LBB          0                               /* 读取已写入数据的末尾序号 */
+#define LWIP_ZC_OP_LASTACK          1                               /* 读取对端已确认的序号 */
+#define LWIP_ZC_OP_ABORT            2                               /* 立即终止连接(RST) */
+#define LWIP_ZC_OP_KEEPALIVE        3                               /* 开启TCP保活 */
+
+typedef struct
+{
+    struct tcpip_api_call_data call;
+    struct netconn *conn;
+    uint8_t op;
+    uint32_t seq;                                                   /* 输出: 序号 */
+    uint32_t keep_idle;                                             /* 输入: 保活参数(ms, 次数) */
+    uint32_t keep_intvl;
+    uint32_t keep_cnt;
+} lwip_zc_call_t;
+
+/* 等待确认的帧 */
+typedef struct
+{
+    camera_fb_t *fb;
+    uint32_t end_seq;                                               /* 帧最后一个字节之后的序号 */
+    uint32_t gen;                                                   /* 所属连接代数 */
+    int64_t sent_us;                                                /* 入队时间 */
+} lwip_zc_pending_t;
+
+static struct netconn *g_zc_conn = NULL;                            /* 当前连接 */
+static uint32_t g_zc_gen = 0;                                       /* 连接代数, 每次建立连接+1 */
+static SemaphoreHandle_t g_zc_lock = NULL;                          /* 保护 g_zc_conn 的使用与删除 */
+static lwip_zc_pending_t g_zc_pending[LWIP_ZC_PENDING_MAX];         /* 等待确认的帧(环形队列) */
+static uint8_t g_zc_head = 0;
+static uint8_t g_zc_count = 0;
+static struct pbuf *g_zc_rx_pbuf = NULL;                            /* 未读完的接收数据 */
+static uint16_t g_zc_rx_offset = 0;
+static struct netconn *volatile g_zc_connecting = NULL;             /* 正在非阻塞连接的netconn */
+static volatile int8_t g_zc_connect_result = 0;                     /* 1:已连接; -1:失败; 0:未完成 */
+static SemaphoreHandle_t g_zc_connect_done = NULL;                  /* 连接完成或失败时释放 */
+static int64_t g_zc_ack_timeout_us = 0;                             /* 最早的帧超过该时间未被确认视为断线, 0:不检测 */
+
+
+/**
+ * @brief       tcpip线程中执行的回调
+ * @param       call : 调用参数(lwip_zc_call_t)
+ * @retval      ERR_OK:成功; ERR_CONN:连接已不存在
+ */
+static err_t lwip_zc_tcpip_cb(struct tcpip_api_call_data *call)
+{
+    lwip_zc_call_t *c = (lwip_zc_call_t *)call;
+    struct tcp_pcb *pcb = c->conn->pcb.tcp;
+
+    if (pcb == NULL)
+    {
+        return ERR_CONN;
+    }
+
+    switch (c->op)
+    {
+        case LWIP_ZC_OP_SND_LBB:
+            c->seq = pcb->snd_lbb;
+            break;
+
+        case LWIP_ZC_OP_LASTACK:
+            c->seq = pcb->lastack;
+            break;
+
+        case LWIP_ZC_OP_ABORT:
+            tcp_abort(pcb);                                         /* 释放所有引用帧缓存的报文段 */
+            break;
+
+        case LWIP_ZC_OP_KEEPALIVE:
+            ip_set_option(pcb, SOF_KEEPALIVE);
+            pcb->keep_idle = c->keep_idle;
+            pcb->keep_intvl = c->keep_intvl;
+            pcb->keep_cnt = c->keep_cnt;
+            break;
+
+        default:
+            return ERR_ARG;
+    }
+
+    return ERR_OK;
+}
+
+/**
+ * @brief       在tcpip线程中操作连接的tcp_pcb
+ * @param       conn : 连接
+ * @param       op   : LWIP_ZC_OP_xxx
+ * @param       seq  : 输出序号(可为NULL)
+ * @retval      ERR_OK:成功; 其他:失败
+ */
+static err_t lwip_zc_tcpip_call(struct netconn *conn, uint8_t op, uint32_t *seq)
+{
+    lwip_zc_call_t c;
+    err_t err;
+
+    memset(&c, 0, sizeof(c));
+    c.conn = conn;
+    c.op = op;
+
+    err = tcpip_api_call(lwip_zc_tcpip_cb, &c.call);
+
+    if (err == ERR_OK && seq != NULL)
+    {
+        *seq = c.seq;
+    }
+
+    return err;
+}
+
+/**
+ * @brief       初始化零拷贝发送模块
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:内存不足
+ */
+esp_err_t lwip_zc_init(void)
+{
+    static StaticSemaphore_t lock_buf;
+    static StaticSemaphore_t connect_done_buf;
+
+    if (g_zc_lock == NULL)
+    {
+        g_zc_lock = xSemaphoreCreateMutexStatic(&lock_buf);
+    }
+
+    if (g_zc_connect_done == NULL)
+    {
+        g_zc_connect_done = xSemaphoreCreateBinaryStatic(&connect_done_buf);
+    }
+
+    return (g_zc_lock != NULL && g_zc_connect_done != NULL) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief       连接过程中的netconn事件回调(tcpip线程)
+ * @note        非阻塞连接完成时lwIP发出 NETCONN_EVT_SENDPLUS, 失败时发出 NETCONN_EVT_ERROR; 连接建立后不再处理
+ * @param       conn : 连接
+ * @param       evt  : 事件
+ * @param       len  : 数据长度(未用到)
+ * @retval      无
+ */
+static void lwip_zc_connect_event(struct netconn *conn, enum netconn_evt evt, u16_t len)
+{
+    (void)len;
+
+    if (conn == NULL || conn != g_zc_connecting)
+    {
+        return;
+    }
+
+    if (evt == NETCONN_EVT_SENDPLUS)
+    {
+        g_zc_connect_result = 1;
+    }
+    else if (evt == NETCONN_EVT_ERROR)
+    {
+        g_zc_connect_result = -1;
+    }
+    else
+    {
+        return;
+    }
+
+    xSemaphoreGive(g_zc_connect_done);
+}
+
+/**
+ * @brief       连接服务器(非阻塞连接, 超时放弃)
+ * @note        服务器不可达时不等待TCP的SYN重传(数十秒), 由调用者退避后重试
+ * @param       ip         : 服务器IP地址(点分十进制)
+ * @param       port       : 服务器端口号
+ * @param       timeout_ms : 连接超时
+ * @retval      ESP_OK:成功; ESP_ERR_TIMEOUT:超时; 其他:失败
+ */
+esp_err_t lwip_zc_connect(const char *ip, uint16_t port, uint32_t timeout_ms)
+{
+    ip_addr_t addr;
+    struct netconn *conn;
+    err_t err;
+
+    if (ipaddr_aton(ip, &addr) == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    conn = netconn_new_with_callback(NETCONN_TCP, lwip_zc_connect_event);
+
+    if (conn == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    conn->pcb.ip->tos = net_qos_tos(NET_QOS_STREAM_DSCP);          /* 连接前pcb尚未进入协议栈, 可直接设置(同 IP_TOS) */
+    xSemaphoreTake(g_zc_connect_done, 0);                           /* 清除上一次残留的完成信号 */
+    g_zc_connect_result = 0;
+    g_zc_connecting = conn;
+    netconn_set_nonblocking(conn, 1);
+    err = netconn_connect(conn, &addr, port);
+
+    if (err == ERR_INPROGRESS)
+    {
+        if (xSemaphoreTake(g_zc_connect_done, pdMS_TO_TICKS(timeout_ms)) != pdTRUE)
+        {
+            err = ERR_TIMEOUT;
+        }
+        else
+        {
+            err = (g_zc_connect_result > 0) ? ERR_OK : ERR_CONN;
+        }
+    }
+
+    g_zc_connecting = NULL;
+    netconn_set_nonblocking(conn, 0);                               /* 之后的收发仍为阻塞方式 */
+
+    if (err != ERR_OK)
+    {
+        netconn_delete(conn);
+        return (err == ERR_TIMEOUT) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+    }
+
+    xSemaphoreTake(g_zc_lock, portMAX_DELAY);
+    g_zc_conn = conn;
+    g_zc_gen++;
+    xSemaphoreGive(g_zc_lock);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       断开连接
+ * @note        先终止连接释放报文段对帧缓存的引用(同时唤醒阻塞在写操作上的发送线程),
+ *              再等待发送线程退出写操作后删除netconn. 未确认的帧在下一次 lwip_zc_reclaim 时归还
+ * @param       无
+ * @retval      无
+ */
+void lwip_zc_close(void)
+{
+    struct netconn *conn = g_zc_conn;                               /* 仅本线程修改 g_zc_conn */
+
+    if (conn == NULL)
+    {
+        return;
+    }
+
+    lwip_zc_tcpip_call(conn, LWIP_ZC_OP_ABORT, NULL);
+
+    xSemaphoreTake(g_zc_lock, portMAX_DELAY);
+    g_zc_conn = NULL;
+    xSemaphoreGive(g_zc_lock);
+
+    if (g_zc_rx_pbuf != NULL)
+    {
+        pbuf_free(g_zc_rx_pbuf);
+        g_zc_rx_pbuf = NULL;
+        g_zc_rx_offset = 0;
+    }
+
+    netconn_delete(conn);
+}
+
+/**
+ * @brief       设置当前连接的失联检测
+ * @note        零拷贝发送不阻塞在发送缓冲上(帧缓存只是被引用), 对端失联表现为帧迟迟得不到确认,
+ *              因此除TCP保活与发送超时外, 最早的待确认帧超过 send_timeout_ms 未被确认时 reclaim 终止连接
+ * @param       idle_ms         : 空闲多久后开始发送保活探测
+ * @param       intvl_ms        : 保活探测间隔
+ * @param       cnt             : 保活探测次数, 全部无响应时断开
+ * @param       send_timeout_ms : 发送超时与确认超时
+ * @retval      ESP_OK:成功; ESP_ERR_INVALID_STATE:未连接
+ */
+esp_err_t lwip_zc_set_liveness(uint32_t idle_ms, uint32_t intvl_ms, uint32_t cnt, uint32_t send_timeout_ms)
+{
+    lwip_zc_call_t c;
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(g_zc_lock, portMAX_DELAY);
+
+    if (g_zc_conn != NULL)
+    {
+        memset(&c, 0, sizeof(c));
+        c.conn = g_zc_conn;
+        c.op = LWIP_ZC_OP_KEEPALIVE;
+        c.keep_idle = idle_ms;
+        c.keep_intvl = intvl_ms;
+        c.keep_cnt = cnt;
+
+        if (tcpip_api_call(lwip_zc_tcpip_cb, &c.call) == ERR_OK)
+        {
+            netconn_set_sendtimeout(g_zc_conn, (s32_t)send_timeout_ms);
+            g_zc_ack_timeout_us = (int64_t)send_timeout_ms * 1000;
+            ret = ESP_OK;
+        }
+    }
+
+    xSemaphoreGive(g_zc_lock);
+    return ret;
+}
+
+/**
+ * @brief       等待接收数据(限时)
+ * @note        取到的数据留给随后的 lwip_zc_recv(); 超时不影响连接(lwIP 2.1的接收超时不是粘滞错误)
+ * @param       timeout_ms : 超时时间
+ * @retval      1:有数据; 0:超时; -1:出错或对端关闭
+ */
+int lwip_zc_wait(uint32_t timeout_ms)
+{
+    err_t err;
+
+    if (g_zc_conn == NULL)
+    {
+        return -1;
+    }
+
+    if (g_zc_rx_pbuf != NULL)
+    {
+        return 1;
+    }
+
+    netconn_set_recvtimeout(g_zc_conn, (int)timeout_ms);
+    err = netconn_recv_tcp_pbuf(g_zc_conn, &g_zc_rx_pbuf);
+
+    if (err == ERR_TIMEOUT)
+    {
+        g_zc_rx_pbuf = NULL;
+        return 0;
+    }
+
+    if (err != ERR_OK)
+    {
+        g_zc_rx_pbuf = NULL;
+        return -1;
+    }
+
+    g_zc_rx_offset = 0;
+    return 1;
+}
+
+/**
+ * @brief       接收数据(阻塞)
+ * @param       buf  : 接收缓冲区
+ * @param       size : 缓冲区大小
+ * @retval      >0:接收到的字节数; <=0:出错或对端关闭
+ */
+int lwip_zc_recv(char *buf, size_t size)
+{
+    uint16_t len;
+
+    if (g_zc_conn == NULL)
+    {
+        return -1;
+    }
+
+    if (g_zc_rx_pbuf == NULL)
+    {
+        if (netconn_recv_tcp_pbuf(g_zc_conn, &g_zc_rx_pbuf) != ERR_OK)
+        {
+            g_zc_rx_pbuf = NULL;
+            return -1;
+        }
+
+        g_zc_rx_offset = 0;
+    }
+
+    len = pbuf_copy_partial(g_zc_rx_pbuf, buf, (uint16_t)size, g_zc_rx_offset);
+    g_zc_rx_offset += len;
+
+    if (g_zc_rx_offset >= g_zc_rx_pbuf->tot_len)
+    {
+        pbuf_free(g_zc_rx_pbuf);
+        g_zc_rx_pbuf = NULL;
+        g_zc_rx_offset = 0;
+    }
+
+    return len;
+}
+
+/**
+ * @brief       零拷贝发送一帧(帧头拷贝, 图像数据直接引用帧缓存)
+ * @note        成功后帧缓存由本模块持有, 直到 lwip_zc_reclaim 在确认后归还;
+ *              失败时帧缓存仍归调用者所有
+ * @param       hdr : 帧头(发送 header_len 字节, 可带扩展字段)
+ * @param       fb  : 摄像头帧缓存(发送末尾 payload_len 字节)
+ * @retval      0:发送成功; -1:发送失败(未连接/等待队列满/连接出错)
+ */
+int lwip_zc_send_frame(const frame_header_t *hdr, camera_fb_t *fb)
+{
+    int ret = -1;
+    uint32_t end_seq;
+    lwip_zc_pending_t *slot;
+
+    xSemaphoreTake(g_zc_lock, portMAX_DELAY);
+
+    if (g_zc_conn == NULL || g_zc_count >= LWIP_ZC_PENDING_MAX)
+    {
+        goto exit;
+    }
+
+    if (netconn_write(g_zc_conn, hdr, hdr->header_len, NETCONN_COPY | NETCONN_MORE) != ERR_OK)
+    {
+        lwip_zc_tcpip_call(g_zc_conn, LWIP_ZC_OP_ABORT, NULL);     /* 发送超时或出错视为断线, 接收随即失败并重连 */
+        goto exit;
+    }
+
+    if (netconn_write(g_zc_conn, fb->buf + fb->len - hdr->payload_len, hdr->payload_len, NETCONN_NOCOPY) != ERR_OK)
+    {
+        /* 部分数据可能已入队并引用帧缓存, 终止连接后由 reclaim 统一归还 */
+        lwip_zc_tcpip_call(g_zc_conn, LWIP_ZC_OP_ABORT, NULL);
+        end_seq = 0;
+    }
+    else if (lwip_zc_tcpip_call(g_zc_conn, LWIP_ZC_OP_SND_LBB, &end_seq) != ERR_OK)
+    {
+        end_seq = 0;
+    }
+
+    slot = &g_zc_pending[(g_zc_head + g_zc_count) % LWIP_ZC_PENDING_MAX];
+    slot->fb = fb;
+    slot->end_seq = end_seq;
+    slot->gen = g_zc_gen;
+    slot->sent_us = esp_timer_get_time();
+    g_zc_count++;
+    ret = 0;
+
+exit:
+    xSemaphoreGive(g_zc_lock);
+    return ret;
+}
+
+/**
+ * @brief       拷贝方式发送一帧(用于统计文本等小数据, 发送后数据即可释放)
+ * @param       hdr  : 帧头
+ * @param       data : 负载
+ * @param       len  : 负载长度, 0:只有帧头
+ * @retval      0:发送成功; -1:发送失败
+ */
+int lwip_zc_send_copy(const frame_header_t *hdr, const void *data, size_t len)
+{
+    int ret = -1;
+
+    xSemaphoreTake(g_zc_lock, portMAX_DELAY);
+
+    if (g_zc_conn != NULL &&
+        netconn_write(g_zc_conn, hdr, sizeof(*hdr), NETCONN_COPY | ((len > 0) ? NETCONN_MORE : 0)) == ERR_OK &&
+        (len == 0 || netconn_write(g_zc_conn, data, len, NETCONN_COPY) == ERR_OK))
+    {
+        ret = 0;
+    }
+
+    xSemaphoreGive(g_zc_lock);
+    return ret;
+}
+
+/**
+ * @brief       归还已被对端确认的帧
+ * @note        连接已断开(或已换新连接)时, 旧连接上的帧全部归还
+ * @param       release : 帧缓存归还回调
+ * @retval      无
+ */
+void lwip_zc_reclaim(lwip_zc_release_t release)
+{
+    uint32_t lastack = 0;
+    int alive;
+    lwip_zc_pending_t *slot;
+
+    if (g_zc_count == 0)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_zc_lock, portMAX_DELAY);
+
+    alive = (g_zc_conn != NULL) &&
+            (lwip_zc_tcpip_call(g_zc_conn, LWIP_ZC_OP_LASTACK, &lastack) == ERR_OK);
+
+    slot = &g_zc_pending[g_zc_head];
+
+    if (alive && g_zc_ack_timeout_us > 0 && slot->gen == g_zc_gen && !TCP_SEQ_GEQ(lastack, slot->end_seq) &&
+        esp_timer_get_time() - slot->sent_us > g_zc_ack_timeout_us)
+    {
+        ESP_LOGW("TAG", "frame unacked for %lld ms, peer lost", (long long)(g_zc_ack_timeout_us / 1000));
+        lwip_zc_tcpip_call(g_zc_conn, LWIP_ZC_OP_ABORT, NULL);     /* 接收随即失败并重连, 帧全部归还 */
+        alive = 0;
+    }
+
+    while (g_zc_count > 0)
+    {
+        slot = &g_zc_pending[g_zc_head];
+
+        if (alive && slot->gen == g_zc_gen && !TCP_SEQ_GEQ(lastack, slot->end_seq))
+        {
+            break;                                                  /* 按发送顺序确认, 后面的帧也未确认 */
+        }
+
+        release(slot->fb);
+        slot->fb = NULL;
+        g_zc_head = (g_zc_head + 1) % LWIP_ZC_PENDING_MAX;
+        g_zc_count--;
+    }
+
+    xSemaphoreGive(g_zc_lock);
+}
+
+/**
+ * @brief       获取等待确认的帧数
+ * @param       无
+ * @retval      帧数
+ */
+uint8_t lwip_zc_pending(void)
+{
+    return g_zc_count;
+}
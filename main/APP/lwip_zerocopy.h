@@ -0,0 +1,50 @@
+/**
+ ****************************************************************************************************
+ * @file        lwip_zerocopy.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       基于netconn的零拷贝帧发送
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 图像数据以 NETCONN_NOCOPY 方式交给lwIP, TCP报文段直接引用PSRAM中的帧缓存,
+ * 因此帧缓存必须等到对端确认(ACK)全部数据后才能归还给摄像头驱动
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __LWIP_ZEROCOPY_H
+#define __LWIP_ZEROCOPY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "frame_proto.h"
+
+
+#define LWIP_ZC_PENDING_MAX         4                               /* 最多等待确认的帧数 */
+
+/* 帧缓存归还回调 */
+typedef void (*lwip_zc_release_t)(camera_fb_t *fb);
+
+/* 函数声明 */
+esp_err_t lwip_zc_init(void);                                       /* 初始化零拷贝发送模块 */
+esp_err_t lwip_zc_connect(const char *ip, uint16_t port, uint32_t timeout_ms);    /* 连接服务器(超时放弃) */
+void lwip_zc_close(void);                                           /* 断开连接(立即终止, 释放对帧缓存的引用) */
+esp_err_t lwip_zc_set_liveness(uint32_t idle_ms, uint32_t intvl_ms, uint32_t cnt, uint32_t send_timeout_ms); /* 设置失联检测 */
+int lwip_zc_wait(uint32_t timeout_ms);                              /* 限时等待接收数据, 0:超时 */
+int lwip_zc_recv(char *buf, size_t size);                           /* 接收数据 */
+int lwip_zc_send_frame(const frame_header_t *hdr, camera_fb_t *fb); /* 零拷贝发送一帧 */
+int lwip_zc_send_copy(const frame_header_t *hdr, const void *data, size_t len);    /* 拷贝方式发送一帧(小数据) */
+void lwip_zc_reclaim(lwip_zc_release_t release);                    /* 归还已被确认的帧 */
+uint8_t lwip_zc_pending(void);                                      /* 等待确认的帧数 */
+
+#endif
@@ -0,0 +1,771 @@
+/**
+ ****************************************************************************************************
+ * @file        metrics.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       Prometheus文本格式的运行指标(HTTP /metrics)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "metrics.h"
+#include "task_topo.h"
+#include "heap_stats.h"
+#include "av_audio.h"
+#include "wifi_config.h"
+#include "my_spi.h"
+#include "spilcd.h"
+#include "mjpeg_server.h"
+#include "pm_ctrl.h"
+#include "load_gov.h"
+#include "tls_stream.h"
+#include "server_disc.h"
+#include "perf_prof.h"
+#include "mqtt_events.h"
+#include "hw_trigger.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "esp_camera.h"
+
+
+/* 一次抓取的输出状态: 缓冲满时以HTTP分块发出 */
+typedef struct
+{
+    httpd_req_t *req;
+    char *buf;
+    size_t len;
+    esp_err_t err;
+} metrics_out_t;
+
+static const char *const g_counter_reasons[] = { NULL, "stale", "gated", "send_error", "offline", "static", NULL };
+static const uint32_t g_send_bounds_ms[METRICS_SEND_BUCKET_NUM] = METRICS_SEND_BUCKETS;
+
+static portMUX_TYPE g_metrics_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t g_metrics_counters[METRIC_COUNTER_NUM];
+static uint32_t g_metrics_frames_sent = 0;
+static uint64_t g_metrics_bytes_sent = 0;
+static uint32_t g_metrics_send_buckets[METRICS_SEND_BUCKET_NUM];  /* 非累积, 输出时累加成 le 桶 */
+static uint64_t g_metrics_send_sum_us = 0;
+static int64_t g_metrics_win_start_us = 0;                          /* 帧率/码率测量窗口 */
+static uint32_t g_metrics_win_frames = 0;
+static uint64_t g_metrics_win_bytes = 0;
+static float g_metrics_fps = 0.0f;
+static float g_metrics_bitrate = 0.0f;
+static int64_t g_metrics_last_sent_us = 0;                          /* 最近一次发送, 停止推流后仪表归零 */
+static int64_t g_metrics_boot_us = 0;                               /* 启动到开始推流的时间, 0:尚未开始 */
+static char *g_metrics_buf = NULL;                                  /* 输出缓冲(PSRAM), 只由HTTP服务线程使用 */
+static TaskStatus_t *g_metrics_tasks = NULL;
+
+
+/**
+ * @brief       记录启动完成(app_main 开始推流前调用一次)
+ * @param       无
+ * @retval      无
+ */
+void metrics_boot_done(void)
+{
+    g_metrics_boot_us = esp_timer_get_time();
+}
+
+/**
+ * @brief       计数加1(任意线程调用)
+ * @param       counter : 计数项
+ * @retval      无
+ */
+void metrics_count(metric_counter_t counter)
+{
+#if METRICS_EN
+    portENTER_CRITICAL(&g_metrics_mux);
+    g_metrics_counters[counter]++;
+    portEXIT_CRITICAL(&g_metrics_mux);
+#else
+    (void)counter;
+#endif
+}
+
+/**
+ * @brief       记录一帧已发送(发送线程调用)
+ * @param       bytes   : 帧头与图像的总字节数
+ * @param       send_us : 发送耗时(写入协议栈的阻塞时间)
+ * @retval      无
+ */
+void metrics_frame_sent(size_t bytes, uint32_t send_us)
+{
+#if METRICS_EN
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed;
+    int bucket = METRICS_SEND_BUCKET_NUM;                           /* 超过最大上界只计入 +Inf */
+
+    for (int i = 0; i < METRICS_SEND_BUCKET_NUM; i++)
+    {
+        if (send_us <= g_send_bounds_ms[i] * 1000)
+        {
+            bucket = i;
+            break;
+        }
+    }
+
+    portENTER_CRITICAL(&g_metrics_mux);
+    g_metrics_frames_sent++;
+    g_metrics_bytes_sent += bytes;
+    g_metrics_send_sum_us += send_us;
+
+    if (bucket < METRICS_SEND_BUCKET_NUM)
+    {
+        g_metrics_send_buckets[bucket]++;
+    }
+
+    g_metrics_win_frames++;
+    g_metrics_win_bytes += bytes;
+    g_metrics_last_sent_us = now;
+    elapsed = now - g_metrics_win_start_us;
+
+    if (elapsed >= (int64_t)METRICS_RATE_WINDOW_MS * 1000)
+    {
+        g_metrics_fps = (g_metrics_win_start_us == 0) ? 0.0f : (float)g_metrics_win_frames * 1e6f / (float)elapsed;
+        g_metrics_bitrate = (g_metrics_win_start_us == 0) ? 0.0f : (float)g_metrics_win_bytes * 8e6f / (float)elapsed;
+        g_metrics_win_start_us = now;
+        g_metrics_win_frames = 0;
+        g_metrics_win_bytes = 0;
+    }
+
+    portEXIT_CRITICAL(&g_metrics_mux);
+#else
+    (void)bytes;
+    (void)send_us;
+#endif
+}
+
+/**
+ * @brief       读取计数与帧率/码率(任意线程调用)
+ * @param       snap : 输出快照, 停止推流后帧率与码率为0
+ * @retval      无
+ */
+void metrics_snapshot(metrics_snapshot_t *snap)
+{
+    memset(snap, 0, sizeof(*snap));
+#if METRICS_EN
+    portENTER_CRITICAL(&g_metrics_mux);
+    memcpy(snap->counters, g_metrics_counters, sizeof(snap->counters));
+    snap->frames_sent = g_metrics_frames_sent;
+    snap->bytes_sent = g_metrics_bytes_sent;
+
+    if (esp_timer_get_time() - g_metrics_last_sent_us <= 2LL * METRICS_RATE_WINDOW_MS * 1000)
+    {
+        snap->fps = g_metrics_fps;                                  /* 已停止推流时窗口不再更新, 保持为0 */
+        snap->bitrate = g_metrics_bitrate;
+    }
+
+    portEXIT_CRITICAL(&g_metrics_mux);
+#endif
+}
+
+#if METRICS_EN
+/**
+ * @brief       追加一段输出, 缓冲放不下时先把已有内容作为一个HTTP分块发出
+ * @param       out : 输出状态
+ * @param       fmt : 格式
+ * @retval      无
+ */
+static void metrics_printf(metrics_out_t *out, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (out->err != ESP_OK)
+    {
+        return;
+    }
+
+    for (int retry = 0; retry < 2; retry++)
+    {
+        va_start(ap, fmt);
+        n = vsnprintf(out->buf + out->len, METRICS_BUF_SIZE - out->len, fmt, ap);
+        va_end(ap);
+
+        if (n >= 0 && out->len + n < METRICS_BUF_SIZE)
+        {
+            out->len += n;
+            return;
+        }
+
+        if (out->len == 0)
+        {
+            return;                                                 /* 单行超过缓冲, 丢弃 */
+        }
+
+        out->err = httpd_resp_send_chunk(out->req, out->buf, out->len);
+        out->len = 0;
+
+        if (out->err != ESP_OK)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief       输出一个指标的 HELP/TYPE 行
+ * @param       out  : 输出状态
+ * @param       name : 指标名
+ * @param       type : counter / gauge / histogram
+ * @param       help : 说明
+ * @retval      无
+ */
+static void metrics_head(metrics_out_t *out, const char *name, const char *type, const char *help)
+{
+    metrics_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+ * @brief       输出发送线程累加的帧计数与发送耗时直方图
+ * @param       out : 输出状态
+ * @retval      无
+ */
+static void metrics_write_frames(metrics_out_t *out)
+{
+    metrics_snapshot_t snap;
+    uint32_t *counters = snap.counters;
+    uint32_t buckets[METRICS_SEND_BUCKET_NUM];
+    uint32_t sent;
+    uint64_t bytes;
+    uint64_t sum_us;
+    float fps;
+    float bitrate;
+    uint32_t cumulative = 0;
+    camera_stats_t cs;
+
+    portENTER_CRITICAL(&g_metrics_mux);
+    memcpy(buckets, g_metrics_send_buckets, sizeof(buckets));
+    bytes = g_metrics_bytes_sent;
+    sum_us = g_metrics_send_sum_us;
+    portEXIT_CRITICAL(&g_metrics_mux);
+
+    metrics_snapshot(&snap);
+    sent = snap.frames_sent;
+    fps = snap.fps;
+    bitrate = snap.bitrate;
+
+    metrics_head(out, "camera_frames_captured_total", "counter", "Frames taken from the camera driver");
+    metrics_printf(out, "camera_frames_captured_total %lu\n", (unsigned long)counters[METRIC_FRAMES_CAPTURED]);
+    metrics_head(out, "camera_frames_sent_total", "counter", "Frames sent to the server");
+    metrics_printf(out, "camera_frames_sent_total %lu\n", (unsigned long)sent);
+    metrics_head(out, "camera_frames_dropped_total", "counter", "Frames not sent, by reason");
+
+    for (int i = METRIC_DROP_STALE; i <= METRIC_DROP_STATIC; i++)
+    {
+        metrics_printf(out, "camera_frames_dropped_total{reason=\"%s\"} %lu\n", g_counter_reasons[i], (unsigned long)counters[i]);
+    }
+
+    if (esp_camera_get_stats(&cs) == ESP_OK)
+    {
+        metrics_printf(out, "camera_frames_dropped_total{reason=\"driver_no_soi\"} %lu\n", (unsigned long)cs.no_soi);
+        metrics_printf(out, "camera_frames_dropped_total{reason=\"driver_no_eoi\"} %lu\n", (unsigned long)cs.no_eoi);
+        metrics_printf(out, "camera_frames_dropped_total{reason=\"driver_fb_overflow\"} %lu\n", (unsigned long)cs.fb_overflow);
+        metrics_printf(out, "camera_frames_dropped_total{reason=\"driver_fbq_overflow\"} %lu\n", (unsigned long)cs.fbq_overflow);
+        metrics_printf(out, "camera_frames_dropped_total{reason=\"driver_event_overflow\"} %lu\n", (unsigned long)cs.event_overflow);
+        metrics_printf(out, "camera_frames_dropped_total{reason=\"driver_superseded\"} %lu\n", (unsigned long)cs.superseded);
+        metrics_head(out, "camera_dma_resets_total", "counter", "Captures re-armed by the driver DMA watchdog");
+        metrics_printf(out, "camera_dma_resets_total %lu\n", (unsigned long)cs.dma_reset);
+        metrics_head(out, "camera_dma_restarts_total", "counter", "Continuous capture frame starts that needed a full LCD_CAM/GDMA restart");
+        metrics_printf(out, "camera_dma_restarts_total %lu\n", (unsigned long)cs.dma_restart);
+        metrics_head(out, "camera_quality_backoffs_total", "counter", "JPEG quality lowered by the driver to keep frames inside the frame buffer");
+        metrics_printf(out, "camera_quality_backoffs_total %lu\n", (unsigned long)cs.quality_backoff);
+        metrics_head(out, "camera_quality_offset", "gauge", "Quality units the driver governor currently adds to the requested JPEG quality");
+        metrics_printf(out, "camera_quality_offset %lu\n", (unsigned long)cs.quality_offset);
+    }
+
+    metrics_head(out, "camera_bytes_sent_total", "counter", "Frame header and image bytes sent");
+    metrics_printf(out, "camera_bytes_sent_total %llu\n", (unsigned long long)bytes);
+    metrics_head(out, "camera_audio_frames_sent_total", "counter", "Audio frames sent on the video connection");
+    metrics_printf(out, "camera_audio_frames_sent_total %lu\n", (unsigned long)counters[METRIC_AUDIO_SENT]);
+
+    metrics_head(out, "camera_send_duration_seconds", "histogram", "Time a frame blocked in send");
+
+    for (int i = 0; i < METRICS_SEND_BUCKET_NUM; i++)
+    {
+        cumulative += buckets[i];
+        metrics_printf(out, "camera_send_duration_seconds_bucket{le=\"%g\"} %lu\n",
+                       g_send_bounds_ms[i] / 1000.0, (unsigned long)cumulative);
+    }
+
+    metrics_printf(out, "camera_send_duration_seconds_bucket{le=\"+Inf\"} %lu\n", (unsigned long)sent);
+    metrics_printf(out, "camera_send_duration_seconds_sum %.6f\n", (double)sum_us / 1e6);
+    metrics_printf(out, "camera_send_duration_seconds_count %lu\n", (unsigned long)sent);
+
+    metrics_head(out, "camera_fps", "gauge", "Frames sent per second over the last window");
+    metrics_printf(out, "camera_fps %.2f\n", (double)fps);
+    metrics_head(out, "camera_bitrate_bps", "gauge", "Bits sent per second over the last window");
+    metrics_printf(out, "camera_bitrate_bps %.0f\n", (double)bitrate);
+}
+
+/**
+ * @brief       输出Wi-Fi、堆内存、音频与任务的状态
+ * @param       out : 输出状态
+ * @retval      无
+ */
+static void metrics_write_system(metrics_out_t *out)
+{
+    heap_stats_caps_t caps[HEAP_STATS_CLASS_NUM];
+    my_spi_stats_t spi;
+    wifi_ap_record_t ap;
+    uint32_t rx_overflow;
+    uint32_t tx_underflow;
+
+    metrics_head(out, "camera_uptime_seconds", "counter", "Time since boot");
+    metrics_printf(out, "camera_uptime_seconds %.3f\n", (double)esp_timer_get_time() / 1e6);
+
+    if (g_metrics_boot_us != 0)
+    {
+        metrics_head(out, "camera_boot_seconds", "gauge", "Time from boot until streaming started");
+        metrics_printf(out, "camera_boot_seconds %.3f\n", (double)g_metrics_boot_us / 1e6);
+    }
+
+    metrics_head(out, "camera_display_present", "gauge", "1 when an LCD panel is attached, 0 when running headless");
+    metrics_printf(out, "camera_display_present %u\n", (unsigned)spilcd_present());
+
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+    {
+        metrics_head(out, "camera_wifi_rssi_dbm", "gauge", "RSSI of the associated AP");
+        metrics_printf(out, "camera_wifi_rssi_dbm %d\n", ap.rssi);
+        metrics_head(out, "camera_wifi_channel", "gauge", "Primary channel of the associated AP");
+        metrics_printf(out, "camera_wifi_channel %u\n", ap.primary);
+    }
+
+    metrics_head(out, "camera_wifi_disconnects_total", "counter", "Station disconnects and failed reconnect attempts");
+    metrics_printf(out, "camera_wifi_disconnects_total %lu\n", (unsigned long)wifi_sta_disconnects());
+
+    heap_stats_get(caps);
+    metrics_head(out, "camera_heap_free_bytes", "gauge", "Free heap by capability");
+
+    for (int i = 0; i < HEAP_STATS_CLASS_NUM; i++)
+    {
+        metrics_printf(out, "camera_heap_free_bytes{caps=\"%s\"} %u\n", caps[i].name, (unsigned)caps[i].free_size);
+    }
+
+    metrics_head(out, "camera_heap_largest_free_block_bytes", "gauge", "Largest free block by capability");
+
+    for (int i = 0; i < HEAP_STATS_CLASS_NUM; i++)
+    {
+        metrics_printf(out, "camera_heap_largest_free_block_bytes{caps=\"%s\"} %u\n", caps[i].name, (unsigned)caps[i].largest);
+    }
+
+    metrics_head(out, "camera_heap_min_free_bytes", "gauge", "Lowest free heap since boot by capability");
+
+    for (int i = 0; i < HEAP_STATS_CLASS_NUM; i++)
+    {
+        metrics_printf(out, "camera_heap_min_free_bytes{caps=\"%s\"} %u\n", caps[i].name, (unsigned)caps[i].min_free);
+    }
+
+    metrics_head(out, "camera_heap_alloc_failures_total", "counter", "Failed allocations by capability");
+
+    for (int i = 0; i < HEAP_STATS_CLASS_NUM; i++)
+    {
+        metrics_printf(out, "camera_heap_alloc_failures_total{caps=\"%s\"} %lu\n", caps[i].name, (unsigned long)caps[i].fails);
+    }
+
+    my_spi_get_stats(&spi);
+    metrics_head(out, "camera_spi_busy_seconds_total", "counter", "Time each device occupied the shared SPI2 bus");
+
+    for (int i = 0; i < MY_SPI_DEV_NUM; i++)
+    {
+        metrics_printf(out, "camera_spi_busy_seconds_total{device=\"%s\"} %.6f\n",
+                       my_spi_dev_name((my_spi_dev_t)i), (double)spi.dev[i].busy_us / 1e6);
+    }
+
+    metrics_head(out, "camera_spi_bytes_total", "counter", "Bytes each device transferred on the shared SPI2 bus");
+
+    for (int i = 0; i < MY_SPI_DEV_NUM; i++)
+    {
+        metrics_printf(out, "camera_spi_bytes_total{device=\"%s\"} %llu\n",
+                       my_spi_dev_name((my_spi_dev_t)i), (unsigned long long)spi.dev[i].bytes);
+    }
+
+    metrics_head(out, "camera_spi_sd_priority_seconds_total", "counter", "Time the SD card had priority over the LCD");
+    metrics_printf(out, "camera_spi_sd_priority_seconds_total %.3f\n", (double)spi.sd_prio_us / 1e6);
+    metrics_head(out, "camera_spi_sd_priority_total", "counter", "Times the recorder backlog gave the SD card priority");
+    metrics_printf(out, "camera_spi_sd_priority_total %lu\n", (unsigned long)spi.sd_prio_count);
+
+    av_audio_i2s_stats(&rx_overflow, &tx_underflow);
+    metrics_head(out, "camera_audio_overruns_total", "counter", "I2S capture buffers overwritten before they were read");
+    metrics_printf(out, "camera_audio_overruns_total %lu\n", (unsigned long)rx_overflow);
+    metrics_head(out, "camera_audio_underruns_total", "counter", "I2S playback buffers that ran dry");
+    metrics_printf(out, "camera_audio_underruns_total %lu\n", (unsigned long)tx_underflow);
+
+#if PERF_PROF_EN
+    perf_prof_stats_t prof[PERF_REGION_NUM];
+    static const char *const stall_names[PERF_STALL_NUM] = { "fetch", "data" };
+
+    for (int i = 0; i < PERF_REGION_NUM; i++)
+    {
+        perf_prof_get((perf_region_t)i, &prof[i]);
+    }
+
+    metrics_head(out, "camera_prof_calls_total", "counter", "Calls of each profiled hot-path region");
+
+    for (int i = 0; i < PERF_REGION_NUM; i++)
+    {
+        metrics_printf(out, "camera_prof_calls_total{region=\"%s\"} %lu\n", prof[i].name, (unsigned long)prof[i].calls);
+    }
+
+    metrics_head(out, "camera_prof_switched_total", "counter", "Calls during which the task was switched out (not in the cycle counts)");
+
+    for (int i = 0; i < PERF_REGION_NUM; i++)
+    {
+        metrics_printf(out, "camera_prof_switched_total{region=\"%s\"} %lu\n", prof[i].name, (unsigned long)prof[i].switched);
+    }
+
+    metrics_head(out, "camera_prof_cycles_total", "counter", "CPU cycles spent in each region");
+
+    for (int i = 0; i < PERF_REGION_NUM; i++)
+    {
+        metrics_printf(out, "camera_prof_cycles_total{region=\"%s\"} %llu\n", prof[i].name, (unsigned long long)prof[i].cycles);
+    }
+
+    metrics_head(out, "camera_prof_instructions_total", "counter", "Instructions completed in each region");
+
+    for (int i = 0; i < PERF_REGION_NUM; i++)
+    {
+        metrics_printf(out, "camera_prof_instructions_total{region=\"%s\"} %llu\n", prof[i].name, (unsigned long long)prof[i].insn);
+    }
+
+    metrics_head(out, "camera_prof_stall_cycles_total", "counter", "Stall cycles of each region while that stall kind was counted");
+    metrics_head(out, "camera_prof_stall_window_cycles_total", "counter", "Region cycles during which each stall kind was counted");
+
+    for (int i = 0; i < PERF_REGION_NUM; i++)
+    {
+        for (int k = 0; k < PERF_STALL_NUM; k++)
+        {
+            metrics_printf(out, "camera_prof_stall_cycles_total{region=\"%s\",kind=\"%s\"} %llu\n",
+                           prof[i].name, stall_names[k], (unsigned long long)prof[i].stall[k]);
+            metrics_printf(out, "camera_prof_stall_window_cycles_total{region=\"%s\",kind=\"%s\"} %llu\n",
+                           prof[i].name, stall_names[k], (unsigned long long)prof[i].stall_window[k]);
+        }
+    }
+#endif
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    UBaseType_t count = uxTaskGetSystemState(g_metrics_tasks, TASK_TOPO_TASK_MAX, NULL);
+    BaseType_t core;
+
+    metrics_head(out, "camera_task_cpu_seconds_total", "counter", "CPU time used by each task");
+
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        core = xTaskGetCoreID(g_metrics_tasks[i].xHandle);
+        metrics_printf(out, "camera_task_cpu_seconds_total{task=\"%s\",core=\"%s\"} %.3f\n",
+                       g_metrics_tasks[i].pcTaskName,
+                       (core == tskNO_AFFINITY) ? "any" : (core == 0) ? "0" : "1",
+                       (double)g_metrics_tasks[i].ulRunTimeCounter / 1e6);  /* CONFIG_FREERTOS_RUN_TIME_STATS_USING_ESP_TIMER: us */
+    }
+
+    metrics_head(out, "camera_task_stack_free_bytes", "gauge", "Lowest free stack of each task");
+
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        metrics_printf(out, "camera_task_stack_free_bytes{task=\"%s\"} %u\n",
+                       g_metrics_tasks[i].pcTaskName, (unsigned)g_metrics_tasks[i].usStackHighWaterMark);
+    }
+#endif
+}
+
+/**
+ * @brief       输出板载HTTP服务各客户端的发送统计(label slot 为客户端槽位)
+ * @param       out : 输出状态
+ * @retval      无
+ */
+static void metrics_write_viewers(metrics_out_t *out)
+{
+    mjpeg_client_stats_t st[MJPEG_CLIENT_MAX];
+    int n = mjpeg_server_clients(st, MJPEG_CLIENT_MAX);
+
+    metrics_head(out, "camera_viewers", "gauge", "Viewers connected to /stream and /ws");
+    metrics_printf(out, "camera_viewers %d\n", n);
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    metrics_head(out, "camera_viewer_frames_sent_total", "counter", "Frames sent to each viewer");
+
+    for (int i = 0; i < n; i++)
+    {
+        metrics_printf(out, "camera_viewer_frames_sent_total{slot=\"%u\",path=\"%s\"} %lu\n",
+                       (unsigned)st[i].slot, st[i].ws ? "ws" : "stream", (unsigned long)st[i].sent);
+    }
+
+    metrics_head(out, "camera_viewer_frames_skipped_total", "counter", "Frames skipped because the viewer was still sending");
+
+    for (int i = 0; i < n; i++)
+    {
+        metrics_printf(out, "camera_viewer_frames_skipped_total{slot=\"%u\"} %lu\n", (unsigned)st[i].slot, (unsigned long)st[i].skipped);
+    }
+
+    metrics_head(out, "camera_viewer_bytes_sent_total", "counter", "JPEG bytes sent to each viewer");
+
+    for (int i = 0; i < n; i++)
+    {
+        metrics_printf(out, "camera_viewer_bytes_sent_total{slot=\"%u\"} %llu\n", (unsigned)st[i].slot, (unsigned long long)st[i].bytes);
+    }
+
+    metrics_head(out, "camera_viewer_kbps", "gauge", "Send rate of each viewer over the last window");
+
+    for (int i = 0; i < n; i++)
+    {
+        metrics_printf(out, "camera_viewer_kbps{slot=\"%u\"} %lu\n", (unsigned)st[i].slot, (unsigned long)st[i].kbps);
+    }
+
+    metrics_head(out, "camera_viewer_quality", "gauge", "Requantization quality of each viewer (0: original)");
+
+    for (int i = 0; i < n; i++)
+    {
+        metrics_printf(out, "camera_viewer_quality{slot=\"%u\",adaptive=\"%u\"} %u\n",
+                       (unsigned)st[i].slot, (unsigned)st[i].adaptive, (unsigned)st[i].quality);
+    }
+
+    metrics_head(out, "camera_viewer_pending_frames", "gauge", "Frames assigned to each viewer and not yet sent");
+
+    for (int i = 0; i < n; i++)
+    {
+        metrics_printf(out, "camera_viewer_pending_frames{slot=\"%u\"} %u\n", (unsigned)st[i].slot, (unsigned)st[i].pending);
+    }
+}
+
+/**
+ * @brief       输出电源管理状态与各使用者持有锁的时间
+ * @note        功耗 ≈ 浅睡眠功耗 + 空闲任务以外的CPU时间 × 运行功耗, 空闲与浅睡眠时间见 IDLE 任务的 camera_task_cpu_seconds_total
+ * @param       out : 输出状态
+ * @retval      无
+ */
+static void metrics_write_power(metrics_out_t *out)
+{
+    pm_ctrl_stats_t pm;
+
+    pm_ctrl_get_stats(&pm);
+    metrics_head(out, "camera_pm_dfs_enabled", "gauge", "Dynamic frequency scaling is configured");
+    metrics_printf(out, "camera_pm_dfs_enabled %d\n", pm.dfs ? 1 : 0);
+    metrics_head(out, "camera_pm_light_sleep_enabled", "gauge", "Automatic light sleep is configured");
+    metrics_printf(out, "camera_pm_light_sleep_enabled %d\n", pm.light_sleep ? 1 : 0);
+    metrics_head(out, "camera_pm_cpu_freq_mhz", "gauge", "CPU frequency range");
+    metrics_printf(out, "camera_pm_cpu_freq_mhz{bound=\"max\"} %u\n", (unsigned)pm.max_mhz);
+    metrics_printf(out, "camera_pm_cpu_freq_mhz{bound=\"min\"} %u\n", (unsigned)pm.min_mhz);
+    metrics_head(out, "camera_pm_boost_seconds_total", "counter", "Time any pipeline held the CPU at maximum frequency");
+    metrics_printf(out, "camera_pm_boost_seconds_total %.6f\n", (double)pm.boost_us / 1e6);
+    metrics_head(out, "camera_pm_lock_seconds_total", "counter", "Time each pipeline held its CPU frequency lock");
+
+    for (int i = 0; i < PM_CTRL_USER_NUM; i++)
+    {
+        metrics_printf(out, "camera_pm_lock_seconds_total{user=\"%s\"} %.6f\n",
+                       pm_ctrl_user_name((pm_ctrl_user_t)i), (double)pm.user[i].held_us / 1e6);
+    }
+
+    metrics_head(out, "camera_pm_lock_acquires_total", "counter", "Times each pipeline took its CPU frequency lock");
+
+    for (int i = 0; i < PM_CTRL_USER_NUM; i++)
+    {
+        metrics_printf(out, "camera_pm_lock_acquires_total{user=\"%s\"} %lu\n",
+                       pm_ctrl_user_name((pm_ctrl_user_t)i), (unsigned long)pm.user[i].acquires);
+    }
+}
+
+/**
+ * @brief       输出负载调控级别与各流水线的CPU占用
+ * @param       out : 输出缓冲
+ * @retval      无
+ */
+static void metrics_write_load(metrics_out_t *out)
+{
+    load_gov_stats_t gov;
+
+    load_gov_get_stats(&gov);
+    metrics_head(out, "camera_shed_level", "gauge", "Current load shedding level, 0 when nothing is degraded");
+    metrics_printf(out, "camera_shed_level %u\n", (unsigned)gov.level);
+    metrics_head(out, "camera_shed_level_max", "gauge", "Highest load shedding level since boot");
+    metrics_printf(out, "camera_shed_level_max %u\n", (unsigned)gov.level_max);
+    metrics_head(out, "camera_shed_raises_total", "counter", "Times the load shedding level was raised");
+    metrics_printf(out, "camera_shed_raises_total %lu\n", (unsigned long)gov.raises);
+    metrics_head(out, "camera_pipeline_cpu_percent", "gauge", "CPU used by each pipeline's threads over the last governor period");
+
+    for (int i = 0; i < LOAD_GOV_TARGET_NUM; i++)
+    {
+        metrics_printf(out, "camera_pipeline_cpu_percent{pipeline=\"%s\"} %.1f\n",
+                       load_gov_target_name((load_gov_target_t)i), (double)gov.task_load[i]);
+    }
+}
+
+#if TLS_STREAM_EN
+/**
+ * @brief       输出TLS握手(完整/会话恢复)与加密发送的统计
+ * @param       out : 输出缓冲
+ * @retval      无
+ */
+static void metrics_write_tls(metrics_out_t *out)
+{
+    tls_stream_stats_t tls;
+
+    tls_stream_get_stats(&tls);
+    metrics_head(out, "camera_tls_handshakes_total", "counter", "Successful TLS handshakes, full or resumed from a session ticket");
+    metrics_printf(out, "camera_tls_handshakes_total{mode=\"full\"} %lu\n", (unsigned long)(tls.handshakes - tls.resumed));
+    metrics_printf(out, "camera_tls_handshakes_total{mode=\"resumed\"} %lu\n", (unsigned long)tls.resumed);
+    metrics_head(out, "camera_tls_handshake_failures_total", "counter", "Failed or timed out TLS handshakes");
+    metrics_printf(out, "camera_tls_handshake_failures_total %lu\n", (unsigned long)tls.failures);
+    metrics_head(out, "camera_tls_handshake_seconds", "gauge", "Duration of the last successful TLS handshake");
+    metrics_printf(out, "camera_tls_handshake_seconds %.3f\n", (double)tls.last_handshake_ms / 1e3);
+    metrics_head(out, "camera_tls_records_total", "counter", "TLS records written");
+    metrics_printf(out, "camera_tls_records_total %llu\n", (unsigned long long)tls.records);
+    metrics_head(out, "camera_tls_bytes_total", "counter", "Plaintext bytes sent over TLS");
+    metrics_printf(out, "camera_tls_bytes_total %llu\n", (unsigned long long)tls.bytes);
+}
+#endif
+
+/**
+ * @brief       输出服务器表与切换次数
+ * @param       out : 输出缓冲
+ * @retval      无
+ */
+static void metrics_write_servers(metrics_out_t *out)
+{
+    server_disc_stats_t disc;
+
+    server_disc_get_stats(&disc);
+    metrics_head(out, "camera_servers", "gauge", "Ingest servers known, by source and health");
+    metrics_printf(out, "camera_servers{state=\"up\"} %u\n", (unsigned)disc.up);
+    metrics_printf(out, "camera_servers{state=\"cooldown\"} %u\n", (unsigned)(disc.servers - disc.up));
+    metrics_printf(out, "camera_servers{state=\"discovered\"} %u\n", (unsigned)disc.discovered);
+    metrics_head(out, "camera_server_failovers_total", "counter", "Connect failures answered by switching to another server");
+    metrics_printf(out, "camera_server_failovers_total %lu\n", (unsigned long)disc.failovers);
+    metrics_head(out, "camera_server_moves_total", "counter", "Live connections moved because the preferred server changed");
+    metrics_printf(out, "camera_server_moves_total %lu\n", (unsigned long)disc.moves);
+}
+
+#if MQTT_EVENTS_EN
+/**
+ * @brief       输出MQTT事件批次的统计
+ * @param       out : 输出缓冲
+ * @retval      无
+ */
+static void metrics_write_mqtt(metrics_out_t *out)
+{
+    mqtt_events_stats_t mqtt;
+
+    mqtt_events_get_stats(&mqtt);
+    metrics_head(out, "camera_mqtt_records_total", "counter", "Motion and face events encoded into MQTT batches");
+    metrics_printf(out, "camera_mqtt_records_total %lu\n", (unsigned long)mqtt.records);
+    metrics_head(out, "camera_mqtt_batches_total", "counter", "MQTT event batches, by outcome");
+    metrics_printf(out, "camera_mqtt_batches_total{state=\"sealed\"} %lu\n", (unsigned long)mqtt.batches);
+    metrics_printf(out, "camera_mqtt_batches_total{state=\"published\"} %lu\n", (unsigned long)mqtt.published);
+    metrics_printf(out, "camera_mqtt_batches_total{state=\"dropped\"} %lu\n", (unsigned long)mqtt.dropped);
+    metrics_head(out, "camera_mqtt_backlog", "gauge", "Sealed MQTT batches waiting to be published");
+    metrics_printf(out, "camera_mqtt_backlog %lu\n", (unsigned long)mqtt.backlog);
+    metrics_head(out, "camera_mqtt_connected", "gauge", "1 while connected to the MQTT broker");
+    metrics_printf(out, "camera_mqtt_connected %u\n", (unsigned)mqtt.connected);
+    metrics_head(out, "camera_mqtt_connects_total", "counter", "Connections made to the MQTT broker");
+    metrics_printf(out, "camera_mqtt_connects_total %lu\n", (unsigned long)mqtt.connects);
+}
+#endif
+
+#if HW_TRIGGER_EN
+/**
+ * @brief       输出硬件触发抓拍的统计
+ * @param       out : 输出缓冲
+ * @retval      无
+ */
+static void metrics_write_trigger(metrics_out_t *out)
+{
+    hw_trigger_stats_t trig;
+
+    hw_trigger_get_stats(&trig);
+    metrics_head(out, "camera_trigger_total", "counter", "XL9555 trigger input edges, by outcome");
+    metrics_printf(out, "camera_trigger_total{state=\"edge\"} %lu\n", (unsigned long)trig.triggers);
+    metrics_printf(out, "camera_trigger_total{state=\"sent\"} %lu\n", (unsigned long)trig.frames);
+    metrics_printf(out, "camera_trigger_total{state=\"expired\"} %lu\n", (unsigned long)trig.expired);
+    metrics_head(out, "camera_trigger_latency_us", "gauge", "Trigger edge to first frame sent");
+    metrics_printf(out, "camera_trigger_latency_us{stat=\"last\"} %lu\n", (unsigned long)trig.last_us);
+    metrics_printf(out, "camera_trigger_latency_us{stat=\"max\"} %lu\n", (unsigned long)trig.max_us);
+    metrics_head(out, "camera_trigger_boost", "gauge", "1 while a trigger holds the highest resolution and quality");
+    metrics_printf(out, "camera_trigger_boost %u\n", (unsigned)trig.boost);
+}
+#endif
+
+/**
+ * @brief       /metrics 请求处理(Prometheus文本格式 0.0.4)
+ * @param       req : HTTP请求
+ * @retval      ESP_OK:成功; 其他:发送失败
+ */
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    metrics_out_t out = { .req = req, .buf = g_metrics_buf, .len = 0, .err = ESP_OK };
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    metrics_write_frames(&out);
+    metrics_write_system(&out);
+    metrics_write_power(&out);
+    metrics_write_load(&out);
+#if TLS_STREAM_EN
+    metrics_write_tls(&out);
+#endif
+    metrics_write_servers(&out);
+#if MQTT_EVENTS_EN
+    metrics_write_mqtt(&out);
+#endif
+#if HW_TRIGGER_EN
+    metrics_write_trigger(&out);
+#endif
+    metrics_write_viewers(&out);
+
+    if (out.err == ESP_OK && out.len > 0)
+    {
+        out.err = httpd_resp_send_chunk(req, out.buf, out.len);
+    }
+
+    if (out.err != ESP_OK)
+    {
+        return out.err;
+    }
+
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+#endif
+
+/**
+ * @brief       在HTTP服务上注册 /metrics
+ * @param       server : HTTP服务句柄
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:内存不足; 其他:注册失败
+ */
+esp_err_t metrics_register(httpd_handle_t server)
+{
+#if METRICS_EN
+    httpd_uri_t uri = { .uri = "/metrics", .method = HTTP_GET, .handler = metrics_handler };
+
+    g_metrics_buf = heap_stats_malloc(HEAP_TAG_METRICS, METRICS_BUF_SIZE, MALLOC_CAP_SPIRAM);
+    g_metrics_tasks = heap_stats_malloc(HEAP_TAG_METRICS, TASK_TOPO_TASK_MAX * sizeof(TaskStatus_t), MALLOC_CAP_SPIRAM);
+
+    if (g_metrics_buf == NULL || g_metrics_tasks == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return httpd_register_uri_handler(server, &uri);
+#else
+    (void)server;
+    return ESP_OK;
+#endif
+}
@@ -0,0 +1,75 @@
+/**
+ ****************************************************************************************************
+ * @file        metrics.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       Prometheus文本格式的运行指标(HTTP /metrics)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 注册在板载HTTP服务(mjpeg_server, 端口 MJPEG_SERVER_PORT)上, Prometheus 直接抓取 http://<板子IP>/metrics.
+ * 发送线程经 metrics_count()/metrics_frame_sent() 累加采集、发送与按原因分类的丢帧计数, 发送耗时计入
+ * METRICS_SEND_BUCKETS 分桶的直方图; 每个抓取请求时再读取驱动丢帧(esp_camera_get_stats)、RSSI与断线次数、
+ * 各类堆内存(heap_stats)、SPI2总线各设备的占用(my_spi)、I2S溢出/欠载(av_audio)、各任务累计运行时间
+ * 与板载HTTP服务每个观看者的发送/跳帧/码率/转码质量(mjpeg_server_clients), 以及电源管理配置与各流水线持有
+ * 调频锁的时间(pm_ctrl). 不接屏(无头模式)时屏幕状态显示的内容都可在这里读到, camera_display_present 为0.
+ * 计数器单调递增, 帧率与码率等由服务器端 rate() 计算; 另有最近 METRICS_RATE_WINDOW_MS 的帧率/码率测量值作为仪表.
+ * 每个任务的CPU占用为 rate(camera_task_cpu_seconds_total[1m]) (需 CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS).
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __METRICS_H
+#define __METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+
+#define METRICS_EN                  1                               /* 1:使能 /metrics */
+#define METRICS_RATE_WINDOW_MS      1000                            /* 帧率/码率仪表的测量窗口 */
+#define METRICS_SEND_BUCKETS        { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 }   /* 发送耗时直方图的上界(ms) */
+#define METRICS_SEND_BUCKET_NUM     10
+#define METRICS_BUF_SIZE            (6 * 1024)                      /* 一次抓取的输出缓冲(PSRAM) */
+
+/* 发送线程累加的计数 */
+typedef enum
+{
+    METRIC_FRAMES_CAPTURED = 0,                                     /* 从驱动取得的帧 */
+    METRIC_DROP_STALE,                                              /* 拥塞或过时, 被更新的帧替换 */
+    METRIC_DROP_GATED,                                              /* 暂停/帧率上限/无移动期间跳过 */
+    METRIC_DROP_SEND_ERROR,                                         /* 发送失败 */
+    METRIC_DROP_OFFLINE,                                            /* 未连接服务器(只给本地使用者) */
+    METRIC_DROP_STATIC,                                             /* 画面未变化, 以占位帧代替(CTRL_CMD_STATIC_SKIP) */
+    METRIC_AUDIO_SENT,                                              /* 已发送的音频帧 */
+    METRIC_COUNTER_NUM
+} metric_counter_t;
+
+/* 发送统计的快照 */
+typedef struct
+{
+    uint32_t counters[METRIC_COUNTER_NUM];
+    uint32_t frames_sent;                                           /* 已发送的帧 */
+    uint64_t bytes_sent;                                            /* 已发送的字节 */
+    float fps;                                                      /* 最近 METRICS_RATE_WINDOW_MS 的帧率 */
+    float bitrate;                                                  /* 最近 METRICS_RATE_WINDOW_MS 的码率(bps) */
+} metrics_snapshot_t;
+
+/* 函数声明 */
+esp_err_t metrics_register(httpd_handle_t server);                  /* 在HTTP服务上注册 /metrics */
+void metrics_count(metric_counter_t counter);                       /* 计数加1 */
+void metrics_frame_sent(size_t bytes, uint32_t send_us);            /* 记录一帧已发送(字节数与发送耗时) */
+void metrics_snapshot(metrics_snapshot_t *snap);                    /* 读取计数与帧率/码率(屏幕状态显示等) */
+void metrics_boot_done(void);                                       /* 记录启动完成(启动耗时) */
+
+#endif
@@ -0,0 +1,805 @@
+/**
+ ****************************************************************************************************
+ * @file        mjpeg_server.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       板载MJPEG HTTP服务(multipart/x-mixed-replace与WebSocket, 多客户端共享帧)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "mjpeg_server.h"
+#include "task_topo.h"
+#include "frame_proto.h"
+#include "metrics.h"
+#include "trace.h"
+#include "snapshot.h"
+#include "heap_stats.h"
+#include "jpg_requant.h"
+#include "net_qos.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_http_server.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+
+#define MJPEG_BOUNDARY              "atkframe"
+#define MJPEG_WAIT_MS               1000                            /* 客户端等待新帧的超时时间 */
+#define MJPEG_WS_RX_MAX             128                             /* 浏览器发来的WebSocket消息只读取不处理 */
+#define MJPEG_QUERY_MAX             32                              /* URL查询串(?q=NN)的长度上限 */
+#define MJPEG_Q_AUTO                0xFF                            /* ?q=auto: 按跳帧率自动选择质量档位 */
+
+/* 客户端类型 */
+#define MJPEG_CLIENT_FREE           0
+#define MJPEG_CLIENT_HTTP           1                               /* /stream: multipart JPEG */
+#define MJPEG_CLIENT_WS             2                               /* /ws: 每帧一个二进制消息 */
+
+/* 分给客户端的一帧 */
+typedef struct
+{
+    camera_fb_t *fb;
+    uint32_t seq;                                                   /* 提交序号, 客户端跳过的帧在序号上可见 */
+} mjpeg_item_t;
+
+/* 一个客户端 */
+typedef struct
+{
+    uint8_t kind;                                                   /* MJPEG_CLIENT_xxx */
+    httpd_req_t *req;                                               /* HTTP: 异步请求 */
+    int fd;                                                         /* WS: 套接字, -1:已被服务关闭 */
+    QueueHandle_t queue;                                            /* 待发送的帧(mjpeg_item_t), 长度1 */
+    uint8_t busy;                                                   /* 1:已分到帧, 尚未发送完 */
+    uint8_t quality;                                                /* 转码质量(1~100), 0:发送原图 */
+    uint8_t adaptive;                                               /* 1:按跳帧率自动选择质量档位 */
+    uint8_t tier;                                                   /* 当前档位(MJPEG_ADAPT_TIERS 下标) */
+    uint32_t sent;                                                  /* 已发送的帧 */
+    uint32_t skipped;                                               /* 因还在发送而跳过的帧 */
+    uint64_t bytes;                                                 /* 已发送的字节数 */
+    uint32_t kbps;                                                  /* 最近窗口的发送码率 */
+    uint32_t win_offered;                                           /* 统计窗口内提交给该客户端的帧 */
+    uint32_t win_skipped;                                           /* 统计窗口内跳过的帧 */
+    uint64_t win_bytes;
+    int64_t win_start_us;
+#if JPG_REQUANT_EN
+    jpg_requant_t *rq;                                              /* 转码状态(内部RAM, 第一帧时分配) */
+    uint8_t *rq_buf;                                                /* 转码输出缓冲(PSRAM) */
+#endif
+} mjpeg_client_t;
+
+/* 被客户端持有的帧 */
+typedef struct
+{
+    camera_fb_t *fb;
+    uint8_t refs;                                                   /* 持有该帧的客户端数 */
+} mjpeg_held_t;
+
+static httpd_handle_t g_mjpeg_httpd = NULL;
+static SemaphoreHandle_t g_mjpeg_lock = NULL;                       /* 保护客户端与持有帧表 */
+static mjpeg_client_t g_mjpeg_client[MJPEG_CLIENT_MAX];
+static mjpeg_held_t g_mjpeg_held[MJPEG_FB_HELD_MAX];
+static uint8_t g_mjpeg_clients = 0;                                 /* 当前客户端数 */
+static EventGroupHandle_t g_mjpeg_event = NULL;
+static EventBits_t g_mjpeg_active_bit = 0;
+static uint32_t g_mjpeg_seq = 0;
+static const uint8_t g_mjpeg_tiers[MJPEG_ADAPT_TIER_NUM] = MJPEG_ADAPT_TIERS;
+
+static const char g_mjpeg_index[] =
+    "<!DOCTYPE html><html><head><meta name=\"viewport\" content=\"width=device-width\"><title>ESP32-S3 Camera</title></head>"
+    "<body style=\"margin:0;background:#000\"><img src=\"/stream\" style=\"width:100%\"></body></html>";
+
+#if CONFIG_HTTPD_WS_SUPPORT
+/* WebSocket观看页: 消息 = frame_header_t + JPEG, 浏览器用 createImageBitmap 直接解码, 解码未完成时丢弃新消息 */
+static const char g_mjpeg_ws_page[] =
+    "<!DOCTYPE html><html><head><meta name=\"viewport\" content=\"width=device-width\"><title>ESP32-S3 Camera (WS)</title></head>"
+    "<body style=\"margin:0;background:#000\"><canvas id=\"c\" style=\"width:100%\"></canvas><script>"
+    "const c=document.getElementById('c'),g=c.getContext('2d');let busy=false;"
+    "function open(){const ws=new WebSocket('ws://'+location.host+'/ws');ws.binaryType='arraybuffer';"
+    "ws.onmessage=async e=>{const d=new DataView(e.data);if(busy||d.getUint32(0,true)!=0x46414D43||!(d.getUint8(7)&1))return;busy=true;"
+    "try{const b=await createImageBitmap(new Blob([new Uint8Array(e.data,d.getUint8(5))],{type:'image/jpeg'}));"
+    "if(c.width!=b.width){c.width=b.width;c.height=b.height;}g.drawImage(b,0,0);b.close();}catch(x){}busy=false;};"
+    "ws.onclose=()=>setTimeout(open,1000);}open();</script></body></html>";
+#endif
+
+
+/**
+ * @brief       客户端数变化时更新活动事件位(调用者持有 g_mjpeg_lock)
+ * @param       无
+ * @retval      无
+ */
+static void mjpeg_update_active(void)
+{
+    if (g_mjpeg_event == NULL)
+    {
+        return;
+    }
+
+    if (g_mjpeg_clients > 0)
+    {
+        xEventGroupSetBits(g_mjpeg_event, g_mjpeg_active_bit);
+    }
+    else
+    {
+        xEventGroupClearBits(g_mjpeg_event, g_mjpeg_active_bit);
+    }
+}
+
+/**
+ * @brief       持有帧表中减去一个客户端对该帧的引用(调用者持有 g_mjpeg_lock)
+ * @param       fb : 帧缓存, NULL:不处理
+ * @retval      无
+ */
+static void mjpeg_unhold(camera_fb_t *fb)
+{
+    for (int i = 0; i < MJPEG_FB_HELD_MAX && fb != NULL; i++)
+    {
+        if (g_mjpeg_held[i].fb == fb && --g_mjpeg_held[i].refs == 0)
+        {
+            g_mjpeg_held[i].fb = NULL;
+        }
+    }
+}
+
+/**
+ * @brief       客户端发送完一帧后归还引用
+ * @param       c  : 客户端, NULL:只归还帧引用(客户端仍在发送转码后的数据)
+ * @param       fb : 帧缓存, NULL:已提前归还
+ * @retval      无
+ */
+static void mjpeg_release(mjpeg_client_t *c, camera_fb_t *fb)
+{
+    xSemaphoreTake(g_mjpeg_lock, portMAX_DELAY);
+    mjpeg_unhold(fb);
+
+    if (c != NULL)
+    {
+        c->busy = 0;
+    }
+
+    xSemaphoreGive(g_mjpeg_lock);
+
+    if (fb != NULL)
+    {
+        esp_camera_fb_return(fb);
+    }
+}
+
+/**
+ * @brief       记录一帧已发送, 每个统计窗口结束时更新码率并按跳帧率调整质量档位
+ * @param       c     : 客户端
+ * @param       bytes : 本帧发送的字节数
+ * @retval      无
+ */
+static void mjpeg_account(mjpeg_client_t *c, size_t bytes)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed;
+    uint32_t pct;
+
+    xSemaphoreTake(g_mjpeg_lock, portMAX_DELAY);
+    c->sent++;
+    c->bytes += bytes;
+    c->win_bytes += bytes;
+    elapsed = now - c->win_start_us;
+
+    if (elapsed >= (int64_t)MJPEG_ADAPT_WINDOW_MS * 1000)
+    {
+        c->kbps = (uint32_t)(c->win_bytes * 8000 / (uint64_t)elapsed);
+        pct = (c->win_offered > 0) ? c->win_skipped * 100 / c->win_offered : 0;
+
+        if (c->adaptive)
+        {
+            if (pct > MJPEG_ADAPT_DOWN_PCT && c->tier + 1 < MJPEG_ADAPT_TIER_NUM)
+            {
+                c->tier++;
+            }
+            else if (pct < MJPEG_ADAPT_UP_PCT && c->tier > 0)
+            {
+                c->tier--;
+            }
+
+            if (c->quality != g_mjpeg_tiers[c->tier])
+            {
+                c->quality = g_mjpeg_tiers[c->tier];
+                ESP_LOGI("TAG", "viewer %d: %u%% skipped at %lu kbps, quality -> %u", (int)(c - g_mjpeg_client),
+                         (unsigned)pct, (unsigned long)c->kbps, (unsigned)c->quality);
+            }
+        }
+
+        c->win_start_us = now;
+        c->win_offered = 0;
+        c->win_skipped = 0;
+        c->win_bytes = 0;
+    }
+
+    xSemaphoreGive(g_mjpeg_lock);
+}
+
+/**
+ * @brief       发送一帧(multipart的一个部分)
+ * @param       req : 异步请求
+ * @param       fb  : 帧缓存
+ * @retval      ESP_OK:成功; 其他:客户端已断开
+ */
+static esp_err_t mjpeg_send_part(httpd_req_t *req, const camera_fb_t *fb)
+{
+    char part[128];
+    int len;
+    esp_err_t err;
+
+    len = snprintf(part, sizeof(part),
+                   "\r\n--" MJPEG_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %lld.%06ld\r\n\r\n",
+                   (unsigned)fb->len, (long long)fb->timestamp.tv_sec, (long)fb->timestamp.tv_usec);
+
+    err = httpd_resp_send_chunk(req, part, len);
+
+    if (err == ESP_OK)
+    {
+        err = httpd_resp_send_chunk(req, (const char *)fb->buf, fb->len);
+    }
+
+    return err;
+}
+
+#if CONFIG_HTTPD_WS_SUPPORT
+/**
+ * @brief       以一个WebSocket二进制消息发送一帧: 帧头为首个分片, 图像数据为后续分片, 不拼接拷贝
+ * @param       c    : 客户端
+ * @param       item : 帧
+ * @retval      ESP_OK:成功; 其他:客户端已断开
+ */
+static esp_err_t mjpeg_send_ws(mjpeg_client_t *c, const mjpeg_item_t *item)
+{
+    frame_header_t hdr;
+    httpd_ws_frame_t frame;
+    esp_err_t err;
+
+    /* 套接字已被服务关闭(编号可能已分给新连接)时不再发送 */
+    if (c->fd < 0 || httpd_ws_get_fd_info(g_mjpeg_httpd, c->fd) != HTTPD_WS_CLIENT_WEBSOCKET)
+    {
+        return ESP_FAIL;
+    }
+
+    frame_header_fill(&hdr, item->fb, item->seq);
+
+    memset(&frame, 0, sizeof(frame));
+    frame.type = HTTPD_WS_TYPE_BINARY;
+    frame.fragmented = true;
+    frame.final = false;
+    frame.payload = (uint8_t *)&hdr;
+    frame.len = sizeof(hdr);
+    err = httpd_ws_send_frame_async(g_mjpeg_httpd, c->fd, &frame);
+
+    if (err == ESP_OK)
+    {
+        frame.type = HTTPD_WS_TYPE_CONTINUE;
+        frame.final = true;
+        frame.payload = item->fb->buf;
+        frame.len = item->fb->len;
+        err = httpd_ws_send_frame_async(g_mjpeg_httpd, c->fd, &frame);
+    }
+
+    return err;
+}
+#endif
+
+#if JPG_REQUANT_EN
+/**
+ * @brief       按客户端的质量在压缩域转码一帧
+ * @note        格式不支持、输出缓冲不足或内存不足时发送原图
+ * @param       c   : 客户端
+ * @param       fb  : 帧缓存
+ * @param       tmp : 转码结果(与 fb 相同的帧信息, 数据指向客户端的输出缓冲)
+ * @retval      要发送的帧(tmp 或 fb)
+ */
+static const camera_fb_t *mjpeg_requant(mjpeg_client_t *c, const camera_fb_t *fb, camera_fb_t *tmp)
+{
+    size_t len = 0;
+
+    if (c->quality == 0 || fb->format != PIXFORMAT_JPEG)
+    {
+        return fb;
+    }
+
+    if (c->rq == NULL)
+    {
+        c->rq = heap_stats_malloc(HEAP_TAG_REQUANT, sizeof(jpg_requant_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        c->rq_buf = heap_stats_malloc(HEAP_TAG_REQUANT, MJPEG_REQUANT_BUF_SIZE, MALLOC_CAP_SPIRAM);
+
+        if (c->rq == NULL || c->rq_buf == NULL)
+        {
+            ESP_LOGW("TAG", "no memory for requant, sending original frames");
+            c->quality = 0;
+            c->adaptive = 0;
+            return fb;
+        }
+    }
+
+    if (jpg_requant(c->rq, fb->buf, fb->len, c->quality, c->rq_buf, MJPEG_REQUANT_BUF_SIZE, &len) != JPG_REQUANT_OK ||
+        len >= fb->len)
+    {
+        return fb;                                                  /* 不支持或转码后不更小 */
+    }
+
+    *tmp = *fb;
+    tmp->buf = c->rq_buf;
+    tmp->len = len;
+    return tmp;
+}
+#endif
+
+/**
+ * @brief       读取请求的 ?q=NN(转码质量) 或 ?q=auto
+ * @param       req : 请求
+ * @retval      1~100:转码质量; 0:未指定或超出范围(发送原图); MJPEG_Q_AUTO:自动
+ */
+static uint8_t mjpeg_query_quality(httpd_req_t *req)
+{
+    char query[MJPEG_QUERY_MAX];
+    char val[8];
+    int q;
+
+#if JPG_REQUANT_EN
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "q", val, sizeof(val)) == ESP_OK)
+    {
+        if (strcmp(val, "auto") == 0)
+        {
+            return MJPEG_Q_AUTO;
+        }
+
+        q = atoi(val);
+        return (q >= 1 && q <= 100) ? (uint8_t)q : 0;
+    }
+#else
+    (void)req; (void)query; (void)val; (void)q;
+#endif
+
+    return 0;
+}
+
+/**
+ * @brief       客户端发送线程: 等待分到的帧并发送, 客户端断开后退出
+ * @param       pvParameters : 客户端(mjpeg_client_t *)
+ * @retval      无
+ */
+static void mjpeg_client_thread(void *pvParameters)
+{
+    mjpeg_client_t *c = (mjpeg_client_t *)pvParameters;
+    httpd_req_t *req = c->req;
+    mjpeg_item_t item;
+    mjpeg_item_t send;
+    camera_fb_t tmp;
+    esp_err_t err = ESP_OK;
+
+    if (c->kind == MJPEG_CLIENT_HTTP)
+    {
+        httpd_resp_set_type(req, "multipart/x-mixed-replace;boundary=" MJPEG_BOUNDARY);
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    }
+
+    while (err == ESP_OK)
+    {
+        if (xQueueReceive(c->queue, &item, pdMS_TO_TICKS(MJPEG_WAIT_MS)) != pdTRUE)
+        {
+#if CONFIG_HTTPD_WS_SUPPORT
+            err = (c->kind == MJPEG_CLIENT_WS && c->fd < 0) ? ESP_FAIL : ESP_OK;
+#endif
+            continue;                                               /* 暂时没有新帧(摄像头正在重新配置等) */
+        }
+
+        send = item;
+#if JPG_REQUANT_EN
+        send.fb = (camera_fb_t *)mjpeg_requant(c, item.fb, &tmp);
+
+        if (send.fb != item.fb)                                     /* 已转码到自己的缓冲, 尽早归还帧缓存 */
+        {
+            mjpeg_release(NULL, item.fb);
+            item.fb = NULL;
+        }
+#endif
+#if CONFIG_HTTPD_WS_SUPPORT
+        err = (c->kind == MJPEG_CLIENT_WS) ? mjpeg_send_ws(c, &send) : mjpeg_send_part(req, send.fb);
+#else
+        err = mjpeg_send_part(req, send.fb);
+#endif
+
+        if (err == ESP_OK)
+        {
+            mjpeg_account(c, send.fb->len);
+        }
+
+        mjpeg_release(c, item.fb);
+    }
+
+#if JPG_REQUANT_EN
+    heap_stats_free(HEAP_TAG_REQUANT, c->rq_buf);                   /* 客户端槽位释放前归还, 之后可被新客户端占用 */
+    heap_stats_free(HEAP_TAG_REQUANT, c->rq);
+    c->rq_buf = NULL;
+    c->rq = NULL;
+#endif
+
+    xSemaphoreTake(g_mjpeg_lock, portMAX_DELAY);
+
+    while (xQueueReceive(c->queue, &item, 0) == pdTRUE)             /* 断开前刚分到的帧: 槽位释放前归还, 新客户端不会接手 */
+    {
+        mjpeg_unhold(item.fb);
+        esp_camera_fb_return(item.fb);
+    }
+
+    c->busy = 0;
+    c->kind = MJPEG_CLIENT_FREE;
+    g_mjpeg_clients--;
+    mjpeg_update_active();
+    xSemaphoreGive(g_mjpeg_lock);
+
+    ESP_LOGI("TAG", "viewer left, %u watching", (unsigned)g_mjpeg_clients);
+
+    if (req != NULL)
+    {
+        httpd_req_async_handler_complete(req);
+    }
+
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief       占用一个空闲客户端并启动其发送线程
+ * @param       kind : MJPEG_CLIENT_xxx
+ * @param       req  : HTTP异步请求(WS为NULL)
+ * @param       fd   : WS套接字(HTTP为-1)
+ * @param       quality : 转码质量(1~100), 0:发送原图
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:客户端已满或线程创建失败
+ */
+static esp_err_t mjpeg_client_start(uint8_t kind, httpd_req_t *req, int fd, uint8_t quality)
+{
+    mjpeg_client_t *c = NULL;
+    mjpeg_item_t stale;
+
+    xSemaphoreTake(g_mjpeg_lock, portMAX_DELAY);
+
+    for (int i = 0; i < MJPEG_CLIENT_MAX && c == NULL; i++)
+    {
+        if (g_mjpeg_client[i].kind == MJPEG_CLIENT_FREE)
+        {
+            c = &g_mjpeg_client[i];
+        }
+    }
+
+    if (c == NULL)
+    {
+        xSemaphoreGive(g_mjpeg_lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    while (xQueueReceive(c->queue, &stale, 0) == pdTRUE)            /* 上一个客户端退出时的残留(退出时已清空, 仅防御) */
+    {
+        mjpeg_unhold(stale.fb);
+        esp_camera_fb_return(stale.fb);
+    }
+
+    c->kind = kind;
+    c->req = req;
+    c->fd = fd;
+    c->busy = 0;
+    c->adaptive = (quality == MJPEG_Q_AUTO);
+    c->quality = c->adaptive ? g_mjpeg_tiers[0] : quality;
+    c->tier = 0;
+    c->sent = 0;
+    c->skipped = 0;
+    c->bytes = 0;
+    c->kbps = 0;
+    c->win_offered = 0;
+    c->win_skipped = 0;
+    c->win_bytes = 0;
+    c->win_start_us = esp_timer_get_time();
+
+    if (xTaskCreatePinnedToCore(mjpeg_client_thread, "mjpeg_client", MJPEG_CLIENT_THREAD_STACK, c,
+                                MJPEG_CLIENT_THREAD_PRIO, NULL, MJPEG_CLIENT_THREAD_CORE) != pdPASS)
+    {
+        c->kind = MJPEG_CLIENT_FREE;
+        xSemaphoreGive(g_mjpeg_lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_mjpeg_clients++;
+    mjpeg_update_active();
+    xSemaphoreGive(g_mjpeg_lock);
+
+    ESP_LOGI("TAG", "%s viewer joined (q=%s%u), %u watching", (kind == MJPEG_CLIENT_WS) ? "ws" : "mjpeg",
+             c->adaptive ? "auto " : "", (unsigned)c->quality, (unsigned)g_mjpeg_clients);
+    return ESP_OK;
+}
+
+/**
+ * @brief       /stream 请求: 转为异步请求并交给新的客户端线程, HTTP服务线程立即返回
+ * @param       req : 请求
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+static esp_err_t mjpeg_stream_handler(httpd_req_t *req)
+{
+    httpd_req_t *async = NULL;
+
+    if (g_mjpeg_clients >= MJPEG_CLIENT_MAX || httpd_req_async_handler_begin(req, &async) != ESP_OK)
+    {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, "too many viewers", HTTPD_RESP_USE_STRLEN);
+    }
+
+    net_qos_set(httpd_req_to_sockfd(req), NET_QOS_MJPEG_DSCP);      /* 预览帧走AC_VI */
+
+    if (mjpeg_client_start(MJPEG_CLIENT_HTTP, async, -1, mjpeg_query_quality(req)) != ESP_OK)
+    {
+        httpd_req_async_handler_complete(async);                    /* 直接关闭连接 */
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+#if CONFIG_HTTPD_WS_SUPPORT
+/**
+ * @brief       /ws 请求: 握手时登记客户端; 之后收到的消息读取后丢弃
+ * @param       req : 请求
+ * @retval      ESP_OK:成功; 其他:关闭连接
+ */
+static esp_err_t mjpeg_ws_handler(httpd_req_t *req)
+{
+    uint8_t buf[MJPEG_WS_RX_MAX];
+    httpd_ws_frame_t frame;
+
+    if (req->method == HTTP_GET)                                    /* 握手完成 */
+    {
+        net_qos_set(httpd_req_to_sockfd(req), NET_QOS_MJPEG_DSCP);
+        return mjpeg_client_start(MJPEG_CLIENT_WS, NULL, httpd_req_to_sockfd(req), mjpeg_query_quality(req));
+    }
+
+    memset(&frame, 0, sizeof(frame));
+
+    if (httpd_ws_recv_frame(req, &frame, 0) != ESP_OK || frame.len > sizeof(buf))
+    {
+        return ESP_FAIL;
+    }
+
+    frame.payload = buf;
+    return httpd_ws_recv_frame(req, &frame, frame.len);
+}
+
+/**
+ * @brief       /ws.html 请求: 返回WebSocket观看页
+ * @param       req : 请求
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+static esp_err_t mjpeg_ws_page_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, g_mjpeg_ws_page, sizeof(g_mjpeg_ws_page) - 1);
+}
+#endif
+
+/**
+ * @brief       HTTP服务关闭套接字时的回调: 作废使用该套接字的WS客户端, 防止编号被复用后发错连接
+ * @param       hd : 服务句柄
+ * @param       fd : 套接字
+ * @retval      无
+ */
+static void mjpeg_close_fn(httpd_handle_t hd, int fd)
+{
+    (void)hd;
+
+    xSemaphoreTake(g_mjpeg_lock, portMAX_DELAY);
+
+    for (int i = 0; i < MJPEG_CLIENT_MAX; i++)
+    {
+        if (g_mjpeg_client[i].kind == MJPEG_CLIENT_WS && g_mjpeg_client[i].fd == fd)
+        {
+            g_mjpeg_client[i].fd = -1;
+        }
+    }
+
+    xSemaphoreGive(g_mjpeg_lock);
+    close(fd);
+}
+
+/**
+ * @brief       / 请求: 返回内嵌视频流的页面
+ * @param       req : 请求
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+static esp_err_t mjpeg_index_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, g_mjpeg_index, sizeof(g_mjpeg_index) - 1);
+}
+
+/**
+ * @brief       启动HTTP服务
+ * @param       event      : 事件组, 有客户端时置位 active_bit(发送线程据此在无PC连接时也采集)
+ * @param       active_bit : 事件位
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+esp_err_t mjpeg_server_init(EventGroupHandle_t event, EventBits_t active_bit)
+{
+#if MJPEG_SERVER_EN
+    static StaticSemaphore_t lock_buf;
+    static StaticQueue_t queue_buf[MJPEG_CLIENT_MAX];
+    static uint8_t queue_storage[MJPEG_CLIENT_MAX][sizeof(mjpeg_item_t)];
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    httpd_uri_t index_uri = { .uri = "/", .method = HTTP_GET, .handler = mjpeg_index_handler };
+    httpd_uri_t stream_uri = { .uri = "/stream", .method = HTTP_GET, .handler = mjpeg_stream_handler };
+#if CONFIG_HTTPD_WS_SUPPORT
+    httpd_uri_t ws_uri = { .uri = "/ws", .method = HTTP_GET, .handler = mjpeg_ws_handler, .is_websocket = true };
+    httpd_uri_t ws_page_uri = { .uri = "/ws.html", .method = HTTP_GET, .handler = mjpeg_ws_page_handler };
+#endif
+    esp_err_t err;
+
+    g_mjpeg_lock = xSemaphoreCreateMutexStatic(&lock_buf);
+
+    for (int i = 0; i < MJPEG_CLIENT_MAX; i++)
+    {
+        g_mjpeg_client[i].queue = xQueueCreateStatic(1, sizeof(mjpeg_item_t), queue_storage[i], &queue_buf[i]);
+    }
+
+    g_mjpeg_event = event;
+    g_mjpeg_active_bit = active_bit;
+
+    config.server_port = MJPEG_SERVER_PORT;
+    config.core_id = MJPEG_HTTPD_CORE;
+    config.task_priority = MJPEG_HTTPD_PRIO;
+    config.stack_size = MJPEG_HTTPD_STACK;
+    config.max_open_sockets = MJPEG_CLIENT_MAX + 2;                 /* 视频流之外留给页面请求 */
+    config.lru_purge_enable = true;
+    config.close_fn = mjpeg_close_fn;
+
+    err = httpd_start(&g_mjpeg_httpd, &config);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE("TAG", "mjpeg server start failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    httpd_register_uri_handler(g_mjpeg_httpd, &index_uri);
+    httpd_register_uri_handler(g_mjpeg_httpd, &stream_uri);
+#if CONFIG_HTTPD_WS_SUPPORT
+    httpd_register_uri_handler(g_mjpeg_httpd, &ws_uri);
+    httpd_register_uri_handler(g_mjpeg_httpd, &ws_page_uri);
+#endif
+    metrics_register(g_mjpeg_httpd);                                /* Prometheus 抓取地址 /metrics */
+    trace_register(g_mjpeg_httpd);                                  /* 跟踪事件导出 /trace */
+    snapshot_register(g_mjpeg_httpd);                               /* 最新帧抓图 /snapshot.jpg */
+    ESP_LOGI("TAG", "mjpeg server on port %d", MJPEG_SERVER_PORT);
+#else
+    (void)event;
+    (void)active_bit;
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief       提交一帧给所有空闲的客户端(发送线程调用, 不阻塞)
+ * @note        每个分到帧的客户端增加一次引用计数, 发送完后归还; 持有的不同帧数已达上限时本帧跳过
+ * @param       fb : 帧缓存
+ * @retval      无
+ */
+void mjpeg_server_offer(camera_fb_t *fb)
+{
+#if MJPEG_SERVER_EN
+    mjpeg_held_t *held = NULL;
+    mjpeg_item_t item;
+
+    if (g_mjpeg_clients == 0 || fb->format != PIXFORMAT_JPEG)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_mjpeg_lock, portMAX_DELAY);
+
+    for (int i = 0; i < MJPEG_FB_HELD_MAX && held == NULL; i++)
+    {
+        if (g_mjpeg_held[i].fb == NULL)
+        {
+            held = &g_mjpeg_held[i];
+        }
+    }
+
+    item.fb = fb;
+    item.seq = g_mjpeg_seq++;
+
+    for (int i = 0; i < MJPEG_CLIENT_MAX; i++)
+    {
+        mjpeg_client_t *c = &g_mjpeg_client[i];
+
+        if (c->kind == MJPEG_CLIENT_FREE)
+        {
+            continue;
+        }
+
+        c->win_offered++;
+
+        if (held == NULL || c->busy || esp_camera_fb_acquire(fb) == NULL)
+        {
+            c->skipped++;                                           /* 还在发送上一帧(或持有帧数已满): 跳过本帧 */
+            c->win_skipped++;
+            continue;
+        }
+
+        if (xQueueSend(c->queue, &item, 0) != pdTRUE)
+        {
+            esp_camera_fb_return(fb);
+            continue;
+        }
+
+        c->busy = 1;
+        held->fb = fb;
+        held->refs++;
+    }
+
+    xSemaphoreGive(g_mjpeg_lock);
+#else
+    (void)fb;
+#endif
+}
+
+/**
+ * @brief       读取各客户端的发送统计(任意线程调用)
+ * @param       stats : 输出
+ * @param       max   : stats 的项数
+ * @retval      写入的客户端数
+ */
+int mjpeg_server_clients(mjpeg_client_stats_t *stats, int max)
+{
+    int n = 0;
+
+#if MJPEG_SERVER_EN
+    if (g_mjpeg_lock == NULL)
+    {
+        return 0;
+    }
+
+    xSemaphoreTake(g_mjpeg_lock, portMAX_DELAY);
+
+    for (int i = 0; i < MJPEG_CLIENT_MAX && n < max; i++)
+    {
+        mjpeg_client_t *c = &g_mjpeg_client[i];
+
+        if (c->kind == MJPEG_CLIENT_FREE)
+        {
+            continue;
+        }
+
+        stats[n].slot = (uint8_t)i;
+        stats[n].ws = (c->kind == MJPEG_CLIENT_WS);
+        stats[n].adaptive = c->adaptive;
+        stats[n].quality = c->quality;
+        stats[n].pending = c->busy;
+        stats[n].sent = c->sent;
+        stats[n].skipped = c->skipped;
+        stats[n].bytes = c->bytes;
+        stats[n].kbps = c->kbps;
+        n++;
+    }
+
+    xSemaphoreGive(g_mjpeg_lock);
+#else
+    (void)stats;
+    (void)max;
+#endif
+    return n;
+}
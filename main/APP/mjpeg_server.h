@@ -0,0 +1,73 @@
+/**
+ ****************************************************************************************************
+ * @file        mjpeg_server.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       板载MJPEG HTTP服务(multipart/x-mixed-replace与WebSocket, 多客户端共享帧)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 浏览器打开 http://<板子IP>/ 即可观看, 视频流地址为 /stream.
+ * 每个客户端由一个独立线程发送(异步请求), 发送线程通过 mjpeg_server_offer() 把同一帧交给所有空闲的客户端,
+ * 每个客户端增加一次帧引用计数, 不拷贝; 正在发送上一帧的客户端跳过本帧, 慢客户端不会拖慢快客户端.
+ * 同时被客户端持有的不同帧最多 MJPEG_FB_HELD_MAX 个, 保证DMA与网络发送始终有空闲帧缓存.
+ * 使能 CONFIG_HTTPD_WS_SUPPORT 时另有 /ws: 每帧一个WebSocket二进制消息, 内容为 frame_header_t(见 frame_proto.h)
+ * 加JPEG数据, 浏览器可直接 createImageBitmap 解码绘制(观看页 /ws.html); 与 /stream 共用客户端数与帧引用.
+ * 同一服务上另有 /metrics(Prometheus文本格式, 见 metrics.h)与 /snapshot.jpg(最新帧抓图, 见 snapshot.h).
+ * /stream?q=NN 与 /ws?q=NN 为该客户端在压缩域转码到质量 NN(1~100, 见 jpg_requant.h)后发送, 给慢速链路一路更低的码率;
+ * 转码在客户端自己的发送线程中进行, 不影响其他客户端与摄像头的发送.
+ * ?q=auto 时按客户端自己的跳帧率在 MJPEG_ADAPT_TIERS 之间自动升降质量: 每个客户端只持有最新一帧的引用(队列长度1),
+ * 链路慢的客户端先丢帧再降质量; 转码后立即归还帧缓存, 只在自己的输出缓冲上发送. 各客户端的码率、跳帧与质量见
+ * mjpeg_server_clients() 与 /metrics 的 camera_viewer_*.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __MJPEG_SERVER_H
+#define __MJPEG_SERVER_H
+
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+
+#define MJPEG_SERVER_EN             1                               /* 1:使能板载MJPEG HTTP服务 */
+#define MJPEG_SERVER_PORT           80                              /* HTTP端口 */
+#define MJPEG_CLIENT_MAX            4                               /* 同时观看的客户端数上限 */
+#define MJPEG_FB_HELD_MAX           2                               /* 客户端同时持有的不同帧数上限(占用的帧缓存) */
+#define MJPEG_REQUANT_BUF_SIZE      (96 * 1024)                     /* 每个转码客户端的输出缓冲(PSRAM), 不足时发送原图 */
+#define MJPEG_ADAPT_TIERS           { 0, 70, 50, 30, 15 }           /* ?q=auto 的质量档位(0:原图), 从原图开始 */
+#define MJPEG_ADAPT_TIER_NUM        5
+#define MJPEG_ADAPT_WINDOW_MS       2000                            /* 码率与跳帧率的统计窗口 */
+#define MJPEG_ADAPT_DOWN_PCT        50                              /* 窗口内跳帧超过该比例时降一档 */
+#define MJPEG_ADAPT_UP_PCT          10                              /* 窗口内跳帧低于该比例时升一档 */
+
+/* 一个客户端的发送统计(mjpeg_server_clients) */
+typedef struct
+{
+    uint8_t slot;                                                   /* 客户端槽位 */
+    uint8_t ws;                                                     /* 1:/ws; 0:/stream */
+    uint8_t adaptive;                                               /* 1:?q=auto */
+    uint8_t quality;                                                /* 当前转码质量, 0:原图 */
+    uint8_t pending;                                                /* 已分到、尚未发送完的帧数(0或1) */
+    uint32_t sent;                                                  /* 已发送的帧 */
+    uint32_t skipped;                                               /* 因还在发送上一帧而跳过的帧 */
+    uint64_t bytes;                                                 /* 已发送的JPEG字节数 */
+    uint32_t kbps;                                                  /* 最近 MJPEG_ADAPT_WINDOW_MS 的发送码率 */
+} mjpeg_client_stats_t;
+
+/* 函数声明 */
+esp_err_t mjpeg_server_init(EventGroupHandle_t event, EventBits_t active_bit);  /* 启动HTTP服务, 有客户端时置位 active_bit */
+void mjpeg_server_offer(camera_fb_t *fb);                           /* 提交一帧给所有空闲的客户端(不阻塞) */
+int mjpeg_server_clients(mjpeg_client_stats_t *stats, int max);     /* 读取各客户端的发送统计, 返回客户端数 */
+
+#endif
@@ -0,0 +1,355 @@
+/**
+ ****************************************************************************************************
+ * @file        motion_detect.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       移动侦测(1/8缩放解码的亮度网格 + 背景模型), 无移动时降低上传帧率
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "motion_detect.h"
+#include "task_topo.h"
+#include "load_gov.h"
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "heap_stats.h"
+#include "img_converters.h"
+#include "sd_recorder.h"
+#include "mqtt_events.h"
+#include "clock_sync.h"
+
+
+#define MOTION_CELLS                (MOTION_GRID_W * MOTION_GRID_H)
+#define MOTION_THUMB_MAX            ((1600 / 8) * (1200 / 8))       /* 缩略图缓冲大小(UXGA的1/8) */
+#define MOTION_TRIGGER_MS           1000                            /* 持续移动时重复触发事件录像的间隔 */
+
+/* 一帧的分析状态 */
+typedef struct
+{
+    const uint8_t *thumb;                                           /* 1/8亮度缩略图 */
+    uint16_t width;                                                 /* 缩略图宽度 */
+    uint16_t height;                                                /* 缩略图高度 */
+    int64_t timestamp_us;                                           /* 帧的采集时间 */
+    uint32_t sum[MOTION_CELLS];                                     /* 各区域的亮度和 */
+    uint16_t count[MOTION_CELLS];                                   /* 各区域的像素数 */
+} motion_ctx_t;
+
+static QueueHandle_t g_motion_queue = NULL;                         /* 发送线程 -> 侦测线程, 长度1 */
+static uint8_t *g_motion_thumb = NULL;                              /* 缩略图缓冲(PSRAM) */
+static SemaphoreHandle_t g_motion_lock = NULL;                      /* 保护 g_motion_result */
+static motion_result_t g_motion_result;
+static int32_t g_motion_bg[MOTION_CELLS];                           /* 各区域背景亮度(Q8定点) */
+static uint16_t g_motion_bg_w = 0;                                  /* 建立背景时的缩放后宽高, 0:背景无效 */
+static uint16_t g_motion_bg_h = 0;
+static int64_t g_motion_trigger_us = 0;                             /* 上一次触发事件录像的时间 */
+static int64_t g_gate_last_us = 0;                                  /* 无移动期间上一次放行上传的时间 */
+static int64_t g_motion_last_us = 0;                                /* 上一次接收侦测帧的时间 */
+static esp_jpg_dec_t g_motion_dec;                                  /* 解码器工作区(内部RAM) */
+#if MQTT_EVENTS_EN
+static bool g_motion_reported = false;                              /* 上一个分析帧已发布移动事件 */
+#endif
+
+
+/**
+ * @brief       把缩略图的亮度按位置累加到各区域
+ * @param       ctx : 分析状态(width/height/thumb已填入)
+ * @retval      true:成功; false:图像太小, 无法划分网格
+ */
+static bool motion_accumulate(motion_ctx_t *ctx)
+{
+    const uint8_t *p = ctx->thumb;
+    uint32_t row;
+    uint32_t cell;
+
+    if (ctx->width < MOTION_GRID_W || ctx->height < MOTION_GRID_H)
+    {
+        return false;
+    }
+
+    for (uint16_t y = 0; y < ctx->height; y++)
+    {
+        row = (uint32_t)y * MOTION_GRID_H / ctx->height * MOTION_GRID_W;
+
+        for (uint16_t x = 0; x < ctx->width; x++)
+        {
+            cell = row + (uint32_t)x * MOTION_GRID_W / ctx->width;
+            ctx->sum[cell] += *p++;
+            ctx->count[cell]++;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief       把一帧的区域亮度与背景比较, 更新背景与侦测结果
+ * @param       ctx : 累加完成的状态
+ * @retval      1:检测到移动; 0:无移动
+ */
+static int motion_analyze(const motion_ctx_t *ctx)
+{
+    uint16_t regions[MOTION_GRID_H] = {0};
+    int32_t cur[MOTION_CELLS];
+    uint32_t changed = 0;
+    int seed = (g_motion_bg_w != ctx->width || g_motion_bg_h != ctx->height);
+    int64_t now = esp_timer_get_time();
+    int motion;
+
+    for (uint32_t i = 0; i < MOTION_CELLS; i++)
+    {
+        cur[i] = (ctx->count[i] > 0) ? (int32_t)(ctx->sum[i] / ctx->count[i]) : 0;
+
+        if (!seed && abs(cur[i] - (g_motion_bg[i] >> 8)) > MOTION_CELL_THRESHOLD)
+        {
+            regions[i / MOTION_GRID_W] |= 1U << (i % MOTION_GRID_W);
+            changed++;
+        }
+    }
+
+    if (changed * 100 > MOTION_LIGHT_PERCENT * MOTION_CELLS)
+    {
+        ESP_LOGD("TAG", "motion: global light change, reseed background");
+        seed = 1;
+        changed = 0;
+        memset(regions, 0, sizeof(regions));
+    }
+
+    for (uint32_t i = 0; i < MOTION_CELLS; i++)
+    {
+        if (seed)
+        {
+            g_motion_bg[i] = cur[i] << 8;
+        }
+        else
+        {
+            int shift = (regions[i / MOTION_GRID_W] & (1U << (i % MOTION_GRID_W))) ? MOTION_BG_SHIFT_ACTIVE : MOTION_BG_SHIFT;
+            g_motion_bg[i] += ((cur[i] << 8) - g_motion_bg[i]) >> shift;
+        }
+    }
+
+    g_motion_bg_w = ctx->width;
+    g_motion_bg_h = ctx->height;
+    motion = (changed >= MOTION_CELLS_MIN);
+
+    xSemaphoreTake(g_motion_lock, portMAX_DELAY);
+    g_motion_result.score = (uint8_t)(changed * 100 / MOTION_CELLS);
+    memcpy(g_motion_result.regions, regions, sizeof(regions));
+    g_motion_result.frames++;
+
+    if (motion)
+    {
+        g_motion_result.last_motion_us = now;
+    }
+
+    xSemaphoreGive(g_motion_lock);
+
+#if MQTT_EVENTS_EN
+    if (motion || g_motion_reported)                                /* 移动期间每帧一条, 结束时一条 */
+    {
+        mqtt_event_t event = {0};
+
+        event.type = motion ? MQTT_EVENT_MOTION : MQTT_EVENT_MOTION_END;
+        event.timestamp_us = clock_sync_to_common(ctx->timestamp_us);
+        event.seq = g_motion_result.frames;                         /* 只由本线程修改 */
+        event.score = (uint8_t)(changed * 100 / MOTION_CELLS);
+        event.regions = motion ? regions : NULL;
+        mqtt_events_put(&event);
+        g_motion_reported = motion;
+    }
+#endif
+
+    return motion;
+}
+
+/**
+ * @brief       侦测线程函数
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void motion_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    camera_fb_t *fb = NULL;
+    static motion_ctx_t ctx;
+    int64_t now;
+
+    load_gov_watch(LOAD_GOV_ANALYTICS);
+
+    while (1)
+    {
+        xQueueReceive(g_motion_queue, &fb, portMAX_DELAY);
+
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.thumb = g_motion_thumb;
+        ctx.timestamp_us = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+
+        if (!jpg2thumb(&g_motion_dec, fb->buf, fb->len, JPG_STRIP_GRAY, g_motion_thumb, MOTION_THUMB_MAX, &ctx.width, &ctx.height))
+        {
+            ESP_LOGD("TAG", "motion decode failed");
+            esp_camera_fb_return(fb);
+            continue;
+        }
+
+        esp_camera_fb_return(fb);                                   /* 缩略图已提取, 尽早归还帧缓存 */
+
+        if (motion_accumulate(&ctx) && motion_analyze(&ctx))
+        {
+            now = esp_timer_get_time();
+
+            if (now - g_motion_trigger_us >= (int64_t)MOTION_TRIGGER_MS * 1000)
+            {
+                g_motion_trigger_us = now;
+                sd_recorder_trigger();                              /* 事件录像模式下保存移动片段, 连续模式下为空操作 */
+            }
+        }
+    }
+}
+
+/**
+ * @brief       初始化侦测线程
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:内存不足
+ */
+esp_err_t motion_detect_init(void)
+{
+#if MOTION_DETECT_EN
+    static StaticQueue_t queue_buf;
+    static uint8_t queue_storage[sizeof(camera_fb_t *)];
+    static StaticSemaphore_t lock_buf;
+    static StackType_t stack[MOTION_THREAD_STACK];                 /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+
+    g_motion_thumb = heap_stats_malloc(HEAP_TAG_MOTION, MOTION_THUMB_MAX, MALLOC_CAP_SPIRAM);
+
+    if (g_motion_thumb == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_motion_lock = xSemaphoreCreateMutexStatic(&lock_buf);
+    g_motion_queue = xQueueCreateStatic(1, sizeof(camera_fb_t *), queue_storage, &queue_buf);
+    xTaskCreateStaticPinnedToCore(motion_thread, "motion_thread", MOTION_THREAD_STACK, NULL,
+                                  MOTION_THREAD_PRIO, stack, &tcb, MOTION_THREAD_CORE);
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief       提交一帧用于侦测(发送线程调用, 不阻塞)
+ * @note        侦测线程忙或过载时距上一次不足 MOTION_SHED_INTERVAL_MS 倍数时直接忽略; 否则增加帧的引用计数, 分析完成后由侦测线程归还
+ * @param       fb : 帧缓存
+ * @retval      无
+ */
+void motion_detect_offer(camera_fb_t *fb)
+{
+#if MOTION_DETECT_EN
+    int64_t now = esp_timer_get_time();
+    uint32_t scale = load_gov_scale(LOAD_GOV_ANALYTICS);
+
+    if (g_motion_queue == NULL || fb->format != PIXFORMAT_JPEG ||
+        uxQueueSpacesAvailable(g_motion_queue) == 0 ||
+        (scale > 1 && now - g_motion_last_us < (int64_t)MOTION_SHED_INTERVAL_MS * 1000 * scale))
+    {
+        return;
+    }
+
+    if (esp_camera_fb_acquire(fb) == NULL)
+    {
+        return;
+    }
+
+    if (xQueueSend(g_motion_queue, &fb, 0) != pdTRUE)
+    {
+        esp_camera_fb_return(fb);
+        return;
+    }
+
+    g_motion_last_us = now;
+#else
+    (void)fb;
+#endif
+}
+
+/**
+ * @brief       读取最近一次的侦测结果
+ * @param       result : 输出结果
+ * @retval      无
+ */
+void motion_detect_get(motion_result_t *result)
+{
+    memset(result, 0, sizeof(motion_result_t));
+
+    if (g_motion_lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_motion_lock, portMAX_DELAY);
+    *result = g_motion_result;
+    xSemaphoreGive(g_motion_lock);
+
+    result->active = (result->last_motion_us != 0 &&
+                      esp_timer_get_time() - result->last_motion_us < (int64_t)MOTION_HOLD_MS * 1000);
+}
+
+/**
+ * @brief       是否处于移动状态(最后一次检测到移动后 MOTION_HOLD_MS 内)
+ * @param       无
+ * @retval      1:移动; 0:无移动或未使能
+ */
+int motion_detect_active(void)
+{
+    motion_result_t result;
+
+    motion_detect_get(&result);
+
+    return result.active;
+}
+
+/**
+ * @brief       判断本帧是否上传(发送线程调用)
+ * @note        移动状态下全部放行; 无移动时每隔 MOTION_IDLE_INTERVAL_MS 放行一帧;
+ *              侦测未运行(未使能、初始化失败或非JPEG格式)时全部放行
+ * @param       fb : 帧缓存
+ * @retval      1:上传; 0:跳过
+ */
+int motion_detect_gate(const camera_fb_t *fb)
+{
+#if MOTION_DETECT_EN && MOTION_GATE_EN
+    int64_t now = esp_timer_get_time();
+
+    if (g_motion_queue == NULL || fb->format != PIXFORMAT_JPEG || motion_detect_active())
+    {
+        return 1;
+    }
+
+    if (now - g_gate_last_us >= (int64_t)MOTION_IDLE_INTERVAL_MS * 1000)
+    {
+        g_gate_last_us = now;
+        return 1;
+    }
+
+    return 0;
+#else
+    (void)fb;
+    return 1;
+#endif
+}
@@ -0,0 +1,67 @@
+/**
+ ****************************************************************************************************
+ * @file        motion_detect.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       移动侦测(1/8缩放解码的亮度网格 + 背景模型), 无移动时降低上传帧率
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 经 jpg2thumb() 提取1/8灰度缩略图(每个8x8块只取DC系数, 不做IDCT), 开销远小于全尺寸解码,
+ * 可以在核1上对每一帧运行. 缩略图像素按位置累加到 MOTION_GRID_W x MOTION_GRID_H 个区域求平均亮度,
+ * 与各区域的背景亮度(指数滑动平均)比较, 差值超过 MOTION_CELL_THRESHOLD 的区域记为变化区域.
+ * 变化区域数达到 MOTION_CELLS_MIN 判为移动; 超过 MOTION_LIGHT_PERCENT 视为整体光照变化(开关灯、自动曝光),
+ * 不判为移动并重新建立背景. 结果(变化比例与区域位图)由 motion_detect_get() 读取.
+ * MOTION_GATE_EN 为1时, 无移动期间只每隔 MOTION_IDLE_INTERVAL_MS 上传一帧, 移动结束后保持 MOTION_HOLD_MS 全帧率;
+ * 取景、MJPEG/WebSocket客户端与SD录像不受影响. 事件录像模式下移动开始时触发一次 sd_recorder_trigger().
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __MOTION_DETECT_H
+#define __MOTION_DETECT_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+
+#define MOTION_DETECT_EN            1                               /* 1:使能移动侦测 */
+#define MOTION_GATE_EN              1                               /* 1:无移动时降低上传帧率; 0:只侦测不限制 */
+#define MOTION_GRID_W               16                              /* 区域网格列数(不超过16, 每行一个16位位图) */
+#define MOTION_GRID_H               12                              /* 区域网格行数 */
+#define MOTION_CELL_THRESHOLD       12                              /* 区域平均亮度与背景的差值门限(0~255) */
+#define MOTION_CELLS_MIN            3                               /* 判为移动的最少变化区域数 */
+#define MOTION_LIGHT_PERCENT        80                              /* 变化区域超过该比例视为整体光照变化 */
+#define MOTION_BG_SHIFT             4                               /* 背景更新速度: bg += (cur - bg) >> SHIFT */
+#define MOTION_BG_SHIFT_ACTIVE      7                               /* 变化区域的背景更新速度(更慢, 避免把移动物体吸收进背景) */
+#define MOTION_HOLD_MS              2000                            /* 最后一次检测到移动后保持全帧率的时间 */
+#define MOTION_IDLE_INTERVAL_MS     1000                            /* 无移动时的上传间隔 */
+#define MOTION_SHED_INTERVAL_MS     100                             /* 过载时两次侦测的最小间隔(乘以负载调控的倍数), 未过载时不限制 */
+
+/* 侦测结果 */
+typedef struct
+{
+    uint8_t  score;                                                 /* 变化区域占比(%) */
+    uint8_t  active;                                                /* 1:处于移动状态(含保持时间) */
+    uint16_t regions[MOTION_GRID_H];                                /* 每行一个位图, bit x 为1表示第x列区域变化 */
+    int64_t  last_motion_us;                                        /* 最后一次检测到移动的时间, 0:从未 */
+    uint32_t frames;                                                /* 已分析的帧数 */
+} motion_result_t;
+
+/* 函数声明 */
+esp_err_t motion_detect_init(void);                                 /* 初始化侦测线程 */
+void motion_detect_offer(camera_fb_t *fb);                          /* 提交一帧用于侦测(侦测线程忙时忽略) */
+void motion_detect_get(motion_result_t *result);                    /* 读取最近一次的侦测结果 */
+int motion_detect_active(void);                                     /* 是否处于移动状态 */
+int motion_detect_gate(const camera_fb_t *fb);                      /* 本帧是否上传(发送线程调用) */
+
+#endif
@@ -0,0 +1,516 @@
+/**
+ ****************************************************************************************************
+ * @file        mqtt_events.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       移动侦测/人脸检测事件批量发布到MQTT(CBOR编码, 按大小或时间刷新, 断线期间缓存)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "mqtt_events.h"
+#include "task_topo.h"
+#include "heap_stats.h"
+#include "motion_detect.h"
+#include "frame_proto.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_heap_caps.h"
+#if MQTT_EVENTS_EN
+#include "mqtt_client.h"
+#endif
+
+
+#define MQTT_EVENTS_SLOTS           (MQTT_EVENTS_BACKLOG + 1)       /* 封存的批次 + 正在写入的批次 */
+#define MQTT_EVENTS_RECORD_MAX      96                              /* 一条记录编码后的最大长度(4个人脸框约70字节) */
+#define MQTT_EVENTS_POLL_MS         200                             /* 发布线程检查刷新时间的间隔 */
+
+/* 一个批次(一条MQTT消息的负载) */
+typedef struct
+{
+    uint32_t seq;                                                   /* 批次序号 */
+    uint16_t len;                                                   /* 已编码长度, 0:未开始 */
+    uint8_t data[MQTT_EVENTS_BATCH_BYTES];
+} mqtt_batch_t;
+
+#if MQTT_EVENTS_EN
+static SemaphoreHandle_t g_mqtt_lock = NULL;                        /* 保护环形缓存、在途状态与统计 */
+static mqtt_batch_t *g_mqtt_ring = NULL;                            /* 批次环形缓存(PSRAM) */
+static uint32_t g_mqtt_head = 0;                                    /* 最旧的封存批次 */
+static uint32_t g_mqtt_count = 0;                                   /* 封存批次数, 正在写入的批次为 (head + count) % SLOTS */
+static uint32_t g_mqtt_seq = 0;                                     /* 下一个批次的序号 */
+static int64_t g_mqtt_base_us = 0;                                  /* 正在写入批次的基准时间 */
+static int64_t g_mqtt_open_us = 0;                                  /* 正在写入批次第一条记录的本地时间 */
+static bool g_mqtt_inflight = false;                                /* QoS 1: 最旧批次已发布, 等待 PUBACK */
+static int g_mqtt_inflight_msg = -1;                                /* 在途批次的消息ID */
+static int g_mqtt_acked_msg = -1;                                   /* 发布调用返回前已收到的 PUBACK */
+static mqtt_events_stats_t g_mqtt_stats;
+static esp_mqtt_client_handle_t g_mqtt_client = NULL;
+static TaskHandle_t g_mqtt_task = NULL;
+static char g_mqtt_topic[64];
+static char g_mqtt_client_id[32];
+
+
+/**
+ * @brief       写入CBOR数据项头(主类型 + 参数)
+ * @param       p     : 输出位置
+ * @param       major : 主类型(0:无符号整数, 1:负整数, 2:字节串, 4:数组)
+ * @param       v     : 参数
+ * @retval      写入的字节数
+ */
+static uint32_t mqtt_cbor_head(uint8_t *p, uint8_t major, uint64_t v)
+{
+    major <<= 5;
+
+    if (v < 24)
+    {
+        p[0] = major | (uint8_t)v;
+        return 1;
+    }
+    else if (v <= 0xFF)
+    {
+        p[0] = major | 24;
+        p[1] = (uint8_t)v;
+        return 2;
+    }
+    else if (v <= 0xFFFF)
+    {
+        p[0] = major | 25;
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)v;
+        return 3;
+    }
+    else if (v <= 0xFFFFFFFFULL)
+    {
+        p[0] = major | 26;
+
+        for (int i = 0; i < 4; i++)
+        {
+            p[1 + i] = (uint8_t)(v >> (24 - 8 * i));
+        }
+
+        return 5;
+    }
+
+    p[0] = major | 27;
+
+    for (int i = 0; i < 8; i++)
+    {
+        p[1 + i] = (uint8_t)(v >> (56 - 8 * i));
+    }
+
+    return 9;
+}
+
+/**
+ * @brief       写入CBOR有符号整数
+ * @param       p : 输出位置
+ * @param       v : 值
+ * @retval      写入的字节数
+ */
+static uint32_t mqtt_cbor_int(uint8_t *p, int64_t v)
+{
+    return (v < 0) ? mqtt_cbor_head(p, 1, (uint64_t)(-1 - v)) : mqtt_cbor_head(p, 0, (uint64_t)v);
+}
+
+/**
+ * @brief       编码一条记录 [类型, 时间差us, 帧序号, 得分, 框]
+ * @param       p       : 输出位置, 至少 MQTT_EVENTS_RECORD_MAX 字节
+ * @param       event   : 事件
+ * @param       base_us : 批次基准时间
+ * @retval      写入的字节数
+ */
+static uint32_t mqtt_events_encode(uint8_t *p, const mqtt_event_t *event, int64_t base_us)
+{
+    uint32_t n = 0;
+    uint8_t count = (event->box_count > FRAME_DETECT_BOX_MAX) ? FRAME_DETECT_BOX_MAX : event->box_count;
+
+    n += mqtt_cbor_head(p + n, 4, 5);
+    n += mqtt_cbor_head(p + n, 0, (uint64_t)event->type);
+    n += mqtt_cbor_int(p + n, event->timestamp_us - base_us);
+    n += mqtt_cbor_head(p + n, 0, event->seq);
+    n += mqtt_cbor_head(p + n, 0, event->score);
+
+    if (event->regions != NULL)
+    {
+        n += mqtt_cbor_head(p + n, 2, MOTION_GRID_H * 2);
+
+        for (int i = 0; i < MOTION_GRID_H; i++)
+        {
+            p[n++] = (uint8_t)event->regions[i];
+            p[n++] = (uint8_t)(event->regions[i] >> 8);
+        }
+    }
+    else
+    {
+        n += mqtt_cbor_head(p + n, 4, (event->boxes != NULL) ? count : 0);
+
+        for (uint8_t i = 0; event->boxes != NULL && i < count; i++)
+        {
+            n += mqtt_cbor_head(p + n, 4, 5);
+            n += mqtt_cbor_head(p + n, 0, event->boxes[i].x);
+            n += mqtt_cbor_head(p + n, 0, event->boxes[i].y);
+            n += mqtt_cbor_head(p + n, 0, event->boxes[i].w);
+            n += mqtt_cbor_head(p + n, 0, event->boxes[i].h);
+            n += mqtt_cbor_head(p + n, 0, event->boxes[i].score);
+        }
+    }
+
+    return n;
+}
+
+/**
+ * @brief       开始一个新批次: 写入外层数组头、版本、批次序号、基准时间与记录数组的开始(调用者持有锁)
+ * @param       batch   : 正在写入的批次
+ * @param       base_us : 基准时间(第一条记录的采集时间)
+ * @retval      无
+ */
+static void mqtt_events_open(mqtt_batch_t *batch, int64_t base_us)
+{
+    uint32_t n = 0;
+
+    batch->seq = g_mqtt_seq++;
+    n += mqtt_cbor_head(batch->data + n, 4, 4);
+    n += mqtt_cbor_head(batch->data + n, 0, 1);                     /* 负载格式版本 */
+    n += mqtt_cbor_head(batch->data + n, 0, batch->seq);
+    n += mqtt_cbor_int(batch->data + n, base_us);
+    batch->data[n++] = 0x9F;                                        /* 记录数组(不定长, 封存时以 0xFF 结束) */
+    batch->len = (uint16_t)n;
+    g_mqtt_base_us = base_us;
+    g_mqtt_open_us = esp_timer_get_time();
+}
+
+/**
+ * @brief       封存正在写入的批次(调用者持有锁)
+ * @note        缓存已满时丢弃最旧的批次; 若它正在途, 之后收到的 PUBACK 不再匹配, 直接忽略
+ * @param       无
+ * @retval      无
+ */
+static void mqtt_events_seal(void)
+{
+    mqtt_batch_t *batch = &g_mqtt_ring[(g_mqtt_head + g_mqtt_count) % MQTT_EVENTS_SLOTS];
+
+    batch->data[batch->len++] = 0xFF;
+
+    if (g_mqtt_count == MQTT_EVENTS_BACKLOG)
+    {
+        g_mqtt_inflight = false;
+        g_mqtt_head = (g_mqtt_head + 1) % MQTT_EVENTS_SLOTS;
+        g_mqtt_count--;
+        g_mqtt_stats.dropped++;
+    }
+
+    g_mqtt_count++;
+    g_mqtt_stats.batches++;
+    g_mqtt_ring[(g_mqtt_head + g_mqtt_count) % MQTT_EVENTS_SLOTS].len = 0;
+}
+
+/**
+ * @brief       删除已发布的最旧批次(调用者持有锁)
+ * @param       无
+ * @retval      无
+ */
+static void mqtt_events_pop(void)
+{
+    g_mqtt_inflight = false;
+    g_mqtt_inflight_msg = -1;
+    g_mqtt_head = (g_mqtt_head + 1) % MQTT_EVENTS_SLOTS;
+    g_mqtt_count--;
+    g_mqtt_stats.published++;
+}
+
+/**
+ * @brief       MQTT客户端事件回调(esp-mqtt 任务中运行)
+ * @note        断线时保留在途批次: esp-mqtt 重连后会从发件箱重发它; 只有发件箱超时删除(MQTT_EVENT_DELETED)
+ *              时才清除在途状态, 由发布线程重新发布
+ * @param       handler_args : 未用到
+ * @param       base         : 事件基
+ * @param       event_id     : esp_mqtt_event_id_t
+ * @param       event_data   : esp_mqtt_event_handle_t
+ * @retval      无
+ */
+static void mqtt_events_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+
+    (void)handler_args;
+    (void)base;
+
+    xSemaphoreTake(g_mqtt_lock, portMAX_DELAY);
+
+    switch ((esp_mqtt_event_id_t)event_id)
+    {
+        case MQTT_EVENT_CONNECTED:
+            g_mqtt_stats.connected = 1;
+            g_mqtt_stats.connects++;
+            break;
+
+        case MQTT_EVENT_DISCONNECTED:
+            g_mqtt_stats.connected = 0;
+            break;
+
+        case MQTT_EVENT_PUBLISHED:
+            if (g_mqtt_inflight && event->msg_id == g_mqtt_inflight_msg)
+            {
+                mqtt_events_pop();
+            }
+            else
+            {
+                g_mqtt_acked_msg = event->msg_id;                   /* 可能早于发布线程记录消息ID */
+            }
+            break;
+
+        case MQTT_EVENT_DELETED:
+            if (g_mqtt_inflight && event->msg_id == g_mqtt_inflight_msg)
+            {
+                g_mqtt_inflight = false;
+                g_mqtt_inflight_msg = -1;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    xSemaphoreGive(g_mqtt_lock);
+    xTaskNotifyGive(g_mqtt_task);
+}
+
+/**
+ * @brief       发布线程函数
+ * @note        按顺序发布最旧的封存批次, 同一时刻最多一个批次在途; 拷贝到静态缓冲后在锁外调用发布,
+ *              侦测线程追加记录不会等待网络
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void mqtt_events_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    static mqtt_batch_t tx;                                         /* 正在发布的批次的副本 */
+    bool send;
+    bool sent = false;
+    int msg_id;
+
+    while (1)
+    {
+        if (!sent)
+        {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MQTT_EVENTS_POLL_MS));
+        }
+
+        sent = false;
+
+        xSemaphoreTake(g_mqtt_lock, portMAX_DELAY);
+
+        if (g_mqtt_ring[(g_mqtt_head + g_mqtt_count) % MQTT_EVENTS_SLOTS].len > 0 &&
+            esp_timer_get_time() - g_mqtt_open_us >= (int64_t)MQTT_EVENTS_FLUSH_MS * 1000)
+        {
+            mqtt_events_seal();
+        }
+
+        send = (g_mqtt_stats.connected && g_mqtt_count > 0 && !g_mqtt_inflight);
+
+        if (send)
+        {
+            memcpy(&tx, &g_mqtt_ring[g_mqtt_head], sizeof(tx));
+        }
+
+        xSemaphoreGive(g_mqtt_lock);
+
+        if (!send)
+        {
+            continue;
+        }
+
+        msg_id = esp_mqtt_client_publish(g_mqtt_client, g_mqtt_topic, (const char *)tx.data, tx.len, MQTT_EVENTS_QOS, 0);
+
+        if (msg_id < 0)
+        {
+            ESP_LOGD("TAG", "mqtt publish batch %lu failed", (unsigned long)tx.seq);
+            continue;                                               /* 断线, 等待重连 */
+        }
+
+        xSemaphoreTake(g_mqtt_lock, portMAX_DELAY);
+
+        if (g_mqtt_count > 0 && g_mqtt_ring[g_mqtt_head].seq == tx.seq) /* 发布期间未被丢弃 */
+        {
+            if (MQTT_EVENTS_QOS == 0 || msg_id == g_mqtt_acked_msg)
+            {
+                mqtt_events_pop();
+                sent = true;
+            }
+            else
+            {
+                g_mqtt_inflight = true;
+                g_mqtt_inflight_msg = msg_id;
+            }
+        }
+
+        xSemaphoreGive(g_mqtt_lock);
+    }
+}
+#endif
+
+/**
+ * @brief       申请批次缓存, 启动MQTT客户端与发布线程
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_SUPPORTED:未使能; ESP_ERR_NO_MEM:内存不足; ESP_FAIL:启动客户端失败
+ */
+esp_err_t mqtt_events_init(void)
+{
+#if MQTT_EVENTS_EN
+    static StaticSemaphore_t lock_buf;
+    static StackType_t stack[MQTT_EVENTS_THREAD_STACK];            /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+    esp_mqtt_client_config_t cfg = {0};
+    uint8_t mac[6];
+
+    g_mqtt_ring = heap_stats_malloc(HEAP_TAG_MQTT, sizeof(mqtt_batch_t) * MQTT_EVENTS_SLOTS, MALLOC_CAP_SPIRAM);
+
+    if (g_mqtt_ring == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(g_mqtt_ring, 0, sizeof(mqtt_batch_t) * MQTT_EVENTS_SLOTS);
+    g_mqtt_lock = xSemaphoreCreateMutexStatic(&lock_buf);
+
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(g_mqtt_topic, sizeof(g_mqtt_topic), "%s/%02X%02X%02X%02X%02X%02X/events", MQTT_EVENTS_TOPIC,
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(g_mqtt_client_id, sizeof(g_mqtt_client_id), "esp32cam-%02X%02X%02X%02X%02X%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    cfg.broker.address.uri = MQTT_EVENTS_URI;
+    cfg.credentials.client_id = g_mqtt_client_id;
+    cfg.session.keepalive = MQTT_EVENTS_KEEPALIVE_S;
+    cfg.buffer.size = MQTT_EVENTS_BATCH_BYTES + 128;                /* 一条消息(批次 + 主题与报文头) */
+    cfg.task.priority = MQTT_CLIENT_PRIO;
+    cfg.task.stack_size = MQTT_CLIENT_STACK;
+
+    if (MQTT_EVENTS_USER[0] != '\0')
+    {
+        cfg.credentials.username = MQTT_EVENTS_USER;
+        cfg.credentials.authentication.password = MQTT_EVENTS_PASS;
+    }
+
+    g_mqtt_task = xTaskCreateStaticPinnedToCore(mqtt_events_thread, "mqtt_events", MQTT_EVENTS_THREAD_STACK, NULL,
+                                                MQTT_EVENTS_THREAD_PRIO, stack, &tcb, MQTT_EVENTS_THREAD_CORE);
+    g_mqtt_client = esp_mqtt_client_init(&cfg);
+
+    if (g_mqtt_client == NULL)
+    {
+        ESP_LOGE("TAG", "mqtt client init failed");
+        return ESP_FAIL;
+    }
+
+    esp_mqtt_client_register_event(g_mqtt_client, ESP_EVENT_ANY_ID, mqtt_events_handler, NULL);
+
+    if (esp_mqtt_client_start(g_mqtt_client) != ESP_OK)
+    {
+        ESP_LOGE("TAG", "mqtt client start failed");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI("TAG", "mqtt events: %s topic %s qos %d", MQTT_EVENTS_URI, g_mqtt_topic, MQTT_EVENTS_QOS);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       追加一条事件记录
+ * @note        只在锁内编码几十字节; 批次写满时封存并唤醒发布线程. 未初始化或未使能时忽略
+ * @param       event : 事件(框与位图只在调用期间读取)
+ * @retval      无
+ */
+void mqtt_events_put(const mqtt_event_t *event)
+{
+#if MQTT_EVENTS_EN
+    uint8_t rec[MQTT_EVENTS_RECORD_MAX];
+    mqtt_batch_t *batch;
+    uint32_t len;
+    bool full;
+
+    if (g_mqtt_ring == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_mqtt_lock, portMAX_DELAY);
+
+    batch = &g_mqtt_ring[(g_mqtt_head + g_mqtt_count) % MQTT_EVENTS_SLOTS];
+
+    if (batch->len == 0)
+    {
+        mqtt_events_open(batch, event->timestamp_us);
+    }
+
+    len = mqtt_events_encode(rec, event, g_mqtt_base_us);
+
+    if (batch->len + len + 1 > MQTT_EVENTS_BATCH_BYTES)             /* 留 1 字节给数组结束符 */
+    {
+        mqtt_events_seal();
+        batch = &g_mqtt_ring[(g_mqtt_head + g_mqtt_count) % MQTT_EVENTS_SLOTS];
+        mqtt_events_open(batch, event->timestamp_us);
+        len = mqtt_events_encode(rec, event, g_mqtt_base_us);      /* 时间差相对新批次 */
+    }
+
+    memcpy(batch->data + batch->len, rec, len);
+    batch->len += len;
+    g_mqtt_stats.records++;
+    full = (batch->len + MQTT_EVENTS_RECORD_MAX + 1 > MQTT_EVENTS_BATCH_BYTES);
+
+    if (full)
+    {
+        mqtt_events_seal();
+    }
+
+    xSemaphoreGive(g_mqtt_lock);
+
+    if (full)
+    {
+        xTaskNotifyGive(g_mqtt_task);
+    }
+#else
+    (void)event;
+#endif
+}
+
+/**
+ * @brief       读取统计
+ * @param       stats : 输出
+ * @retval      无
+ */
+void mqtt_events_get_stats(mqtt_events_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+#if MQTT_EVENTS_EN
+    if (g_mqtt_lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_mqtt_lock, portMAX_DELAY);
+    *stats = g_mqtt_stats;
+    stats->backlog = g_mqtt_count;
+    xSemaphoreGive(g_mqtt_lock);
+#endif
+}
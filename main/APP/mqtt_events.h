@@ -0,0 +1,108 @@
+/**
+ ****************************************************************************************************
+ * @file        mqtt_events.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       移动侦测/人脸检测事件批量发布到MQTT(CBOR编码, 按大小或时间刷新, 断线期间缓存)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 侦测/检测线程每分析出一个事件调用 mqtt_events_put(), 记录编码进当前批次(只拷贝几十字节, 不等待网络).
+ * 批次写满 MQTT_EVENTS_BATCH_BYTES 或第一条记录已等待 MQTT_EVENTS_FLUSH_MS 时封存, 放入最多 MQTT_EVENTS_BACKLOG
+ * 个批次的环形缓存(PSRAM), 发布线程按顺序以一条MQTT消息发布到 MQTT_EVENTS_TOPIC/<设备MAC>/events.
+ * QoS 0: 交给协议栈即从缓存删除; QoS 1: 同一时刻只有一个批次在途, 收到 PUBACK 才删除, 断线重连后从该批次继续.
+ * 断线期间缓存写满时丢弃最旧的批次(计入 dropped), 不阻塞侦测线程.
+ * 消息负载(CBOR, RFC 8949): [1, 批次序号, 基准时间us, [记录...]], 记录为
+ *     [类型, 时间差us, 帧序号, 得分, 框]
+ * 类型见 mqtt_event_type_t; 时间为采集时间(clock_sync_to_common, 已校时为Unix时间), 时间差相对批次的基准时间(可为负);
+ * 帧序号为侦测/检测模块已分析的帧数(与 FRAME_PIXFORMAT_DETECT 元数据帧的序号相同); 得分为变化区域占比或最高人脸得分(%);
+ * 框: 移动为区域位图(字节串, MOTION_GRID_H 个小端 uint16), 人脸为 [[x, y, w, h, 得分], ...](原始帧坐标),
+ * 结束事件为空数组. 批次序号每次开机从0开始, QoS 1 重传时接收端可据此去重.
+ * 需要 ESP-IDF 自带的 mqtt 组件; MQTT_EVENTS_URI 可用 mqtt:// 或 mqtts://(后者需加大 MQTT_CLIENT_STACK).
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __MQTT_EVENTS_H
+#define __MQTT_EVENTS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+
+#define MQTT_EVENTS_EN              0                               /* 1:侦测事件发布到MQTT */
+#define MQTT_EVENTS_URI             "mqtt://192.168.1.100:1883"     /* 代理地址 */
+#define MQTT_EVENTS_USER            ""                              /* 用户名(空:不认证) */
+#define MQTT_EVENTS_PASS            ""
+#define MQTT_EVENTS_TOPIC           "camera"                        /* 主题前缀, 完整主题为 <前缀>/<MAC>/events */
+#define MQTT_EVENTS_QOS             0                               /* 0 或 1 */
+#define MQTT_EVENTS_BATCH_BYTES     1024                            /* 批次大小上限(一条MQTT消息的负载) */
+#define MQTT_EVENTS_FLUSH_MS        2000                            /* 批次中第一条记录的最长等待时间 */
+#define MQTT_EVENTS_BACKLOG         16                              /* 未发布批次的缓存个数(断线期间) */
+#define MQTT_EVENTS_KEEPALIVE_S     60
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 事件类型 */
+typedef enum
+{
+    MQTT_EVENT_MOTION = 0,                                          /* 检测到移动(每个分析帧一条) */
+    MQTT_EVENT_MOTION_END,                                          /* 移动结束(第一个无移动的分析帧) */
+    MQTT_EVENT_FACE,                                                /* 检测到人脸 */
+    MQTT_EVENT_FACE_END,                                            /* 人脸消失 */
+} mqtt_event_type_t;
+
+/* 一个框 */
+typedef struct
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+    uint8_t  score;                                                 /* 得分(%) */
+} mqtt_event_box_t;
+
+/* 一条事件记录 */
+typedef struct
+{
+    mqtt_event_type_t type;
+    int64_t  timestamp_us;                                          /* 采集时间(公共时间) */
+    uint32_t seq;                                                   /* 帧序号 */
+    uint8_t  score;                                                 /* 得分(%) */
+    uint8_t  box_count;                                             /* boxes 中的框数(人脸) */
+    const mqtt_event_box_t *boxes;
+    const uint16_t *regions;                                        /* 区域位图(移动, MOTION_GRID_H 个), NULL:无 */
+} mqtt_event_t;
+
+/* 统计 */
+typedef struct
+{
+    uint32_t records;                                               /* 编码的记录数 */
+    uint32_t batches;                                               /* 封存的批次数 */
+    uint32_t published;                                             /* 已发布(QoS 1 为已确认)的批次数 */
+    uint32_t dropped;                                               /* 缓存满时丢弃的批次数 */
+    uint32_t backlog;                                               /* 当前缓存中的批次数 */
+    uint32_t connects;                                              /* 连接代理的次数 */
+    uint8_t  connected;                                             /* 1:已连接代理 */
+} mqtt_events_stats_t;
+
+/* 函数声明 */
+esp_err_t mqtt_events_init(void);                                   /* 申请缓存, 启动MQTT客户端与发布线程(联网后调用) */
+void mqtt_events_put(const mqtt_event_t *event);                    /* 追加一条记录(任意线程, 不阻塞网络) */
+void mqtt_events_get_stats(mqtt_events_stats_t *stats);             /* 读取统计 */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
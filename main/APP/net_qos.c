@@ -0,0 +1,73 @@
+/**
+ ****************************************************************************************************
+ * @file        net_qos.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       套接字的DSCP标记(WMM接入类别)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "net_qos.h"
+#include <errno.h>
+#include "lwip/sockets.h"
+#include "esp_log.h"
+
+
+/**
+ * @brief       DSCP对应的TOS字节
+ * @param       dscp: DSCP(0~63)
+ * @retval      TOS字节, NET_QOS_EN为0或dscp为0时为0
+ */
+uint8_t net_qos_tos(uint8_t dscp)
+{
+#if NET_QOS_EN
+    return (uint8_t)((dscp & 0x3F) << 2);                           /* 低2位为ECN, 不设置 */
+#else
+    (void)dscp;
+    return 0;
+#endif
+}
+
+/**
+ * @brief       设置套接字的DSCP(在connect之前调用)
+ * @param       sock: 套接字
+ * @param       dscp: DSCP, 0:不标记
+ * @retval      0:成功或不标记; -1:设置失败
+ */
+int net_qos_set(int sock, uint8_t dscp)
+{
+    int tos = net_qos_tos(dscp);
+    int check = 0;
+    socklen_t len = sizeof(check);
+
+    if (tos == 0)
+    {
+        return 0;
+    }
+
+    if (setsockopt(sock, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) != 0)
+    {
+        ESP_LOGW("TAG", "IP_TOS %d failed: errno %d", tos, errno);
+        return -1;
+    }
+
+    /* 读回确认协议栈已接受(lwIP 写入 pcb->tos, 此后每个报文的IP头都带该值) */
+    if (getsockopt(sock, IPPROTO_IP, IP_TOS, &check, &len) != 0 || check != tos)
+    {
+        ESP_LOGW("TAG", "IP_TOS readback %d != %d", check, tos);
+        return -1;
+    }
+
+    return 0;
+}
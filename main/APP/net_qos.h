@@ -0,0 +1,53 @@
+/**
+ ****************************************************************************************************
+ * @file        net_qos.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       套接字的DSCP标记(WMM接入类别)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 共享AP上, 同一射频的所有流量默认都在AC_BE排队, 语音与控制要等在大块JPEG帧后面.
+ * WIFI驱动发送时取IP头TOS字节的高3位(DSCP>>3)作为802.11用户优先级, 按802.1D映射到WMM接入类别:
+ * 1~2 -> AC_BK, 0/3 -> AC_BE, 4~5 -> AC_VI, 6~7 -> AC_VO. 因此只需给每种传输的套接字设置 IP_TOS
+ * (DSCP<<2), 在 connect() 之前设置使SYN与重传也带相同标记. 需要AP开启WMM(现今的AP默认开启),
+ * 否则标记被忽略, 与不标记相同.
+ * 每种传输的DSCP在下面单独配置, 0为不标记. 注意: lwip_demo 的主连接在一条TCP上顺序承载视频、控制、
+ * 音频(AV_AUDIO_EN)与断线回填, 同一连接的报文不能分到不同接入类别(否则空中乱序触发TCP重传),
+ * 因此整条连接按视频标记; 音频要进入AC_VO需走独立的套接字(如 atk_s3_audio_stream 的 CONFIG_STREAM_DSCP_*).
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __NET_QOS_H
+#define __NET_QOS_H
+
+#include <stdint.h>
+
+
+#define NET_QOS_EN                  1                               /* 1:按下面的配置标记各传输 */
+
+/* 常用DSCP取值与对应的接入类别 */
+#define NET_QOS_DSCP_EF             46                              /* 加速转发: AC_VO */
+#define NET_QOS_DSCP_AF41           34                              /* 交互视频: AC_VI */
+#define NET_QOS_DSCP_CS1            8                               /* 低优先级批量: AC_BK */
+
+/* 各传输的DSCP, 0:不标记(AC_BE) */
+#define NET_QOS_STREAM_DSCP         NET_QOS_DSCP_AF41               /* lwip_demo 主连接(视频/控制/音频/回填) */
+#define NET_QOS_RTP_DSCP            NET_QOS_DSCP_AF41               /* RTP/JPEG 视频 */
+#define NET_QOS_MJPEG_DSCP          NET_QOS_DSCP_AF41               /* HTTP MJPEG/WebSocket 预览 */
+#define NET_QOS_BULK_DSCP           NET_QOS_DSCP_CS1                /* 定时拍照上传与带宽测试 */
+
+/* 函数声明 */
+int net_qos_set(int sock, uint8_t dscp);                            /* 设置套接字的DSCP, 0:成功或不标记 */
+uint8_t net_qos_tos(uint8_t dscp);                                  /* DSCP对应的TOS字节(NET_QOS_EN为0时为0) */
+
+#endif
@@ -0,0 +1,304 @@
+/**
+ ****************************************************************************************************
+ * @file        perf_prof.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       热点区间的CPU性能计数: 周期、指令数与取指/数据停顿, 用于判断哪些代码与数据值得放入IRAM/内部RAM
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "perf_prof.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#if PERF_PROF_EN
+#include "esp_cpu.h"
+#include "esp_ipc.h"
+#include "xtensa_perfmon_access.h"
+#include "xtensa_perfmon_masks.h"
+#endif
+
+
+static const char *const g_prof_names[PERF_REGION_NUM] =
+{
+    "cam_copy", "eoi_search", "convert_image", "jpg_decode", "send",
+};
+
+#if PERF_PROF_EN
+/* 标记中的数据(camera_prof_mark_t.data) */
+#define PERF_MARK_CYCLES            0                               /* CCOUNT */
+#define PERF_MARK_INSN              1                               /* 计数器0 */
+#define PERF_MARK_STALL             2                               /* 计数器1 */
+#define PERF_MARK_CORE              3                               /* 开始时所在的核 */
+#define PERF_MARK_GEN               4                               /* 开始时该核计数器1的配置序号 */
+#define PERF_MARK_RUN               5                               /* 开始时任务的累计运行时间 */
+
+static const uint16_t g_stall_select[PERF_STALL_NUM] = { XTPERF_CNT_I_STALL, XTPERF_CNT_D_STALL };
+static const uint16_t g_stall_mask[PERF_STALL_NUM] = { XTPERF_MASK_I_STALL_ALL, XTPERF_MASK_D_STALL_ALL };
+
+static perf_prof_stats_t g_prof[PERF_REGION_NUM];
+static portMUX_TYPE g_prof_mux = portMUX_INITIALIZER_UNLOCKED;     /* 两个核上的区间同时结束 */
+static volatile uint32_t g_prof_gen[portNUM_PROCESSORS];           /* 各核计数器1的配置序号 */
+static volatile perf_stall_t g_prof_kind[portNUM_PROCESSORS];      /* 各核计数器1当前计数的停顿 */
+static perf_stall_t g_prof_next = PERF_STALL_FETCH;
+static esp_timer_handle_t g_prof_timer = NULL;
+
+static void perf_prof_hook_end(int region, const camera_prof_mark_t *mark);
+static const camera_prof_hooks_t g_prof_hooks = { perf_prof_begin, perf_prof_hook_end };
+
+
+/**
+ * @brief       读取当前任务的累计运行时间(只在任务切出时更新, 区间前后不同即区间内被切换过)
+ * @param       无
+ * @retval      运行时间
+ */
+static inline uint32_t perf_prof_run_time(void)
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    return (uint32_t)ulTaskGetRunTimeCounter(NULL);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief       在调用的核上配置两个计数器(经 esp_ipc 在目标核上运行)
+ * @param       arg : 计数器1计数的停顿(perf_stall_t)
+ * @retval      无
+ */
+static void perf_prof_program(void *arg)
+{
+    perf_stall_t kind = (perf_stall_t)(intptr_t)arg;
+    int core = xPortGetCoreID();
+
+    xtensa_perfmon_stop();
+    xtensa_perfmon_init(0, XTPERF_CNT_INSN, XTPERF_MASK_INSN_ALL, 0, -1);
+    xtensa_perfmon_init(1, g_stall_select[kind], g_stall_mask[kind], 0, -1);
+    g_prof_kind[core] = kind;
+    g_prof_gen[core]++;                                             /* 跨过本次切换的区间不计停顿 */
+    xtensa_perfmon_start();
+}
+
+/**
+ * @brief       定时切换计数器1的停顿类型(esp_timer 回调)
+ * @param       arg : 未用到
+ * @retval      无
+ */
+static void perf_prof_rotate(void *arg)
+{
+    (void)arg;
+    g_prof_next = (perf_stall_t)((g_prof_next + 1) % PERF_STALL_NUM);
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        esp_ipc_call_blocking(core, perf_prof_program, (void *)(intptr_t)g_prof_next);
+    }
+}
+
+/**
+ * @brief       驱动区间结束的回调
+ * @param       region : camera_prof_region_t
+ * @param       mark   : 区间开始时的标记
+ * @retval      无
+ */
+static void perf_prof_hook_end(int region, const camera_prof_mark_t *mark)
+{
+    perf_prof_end((perf_region_t)region, mark);
+}
+#endif
+
+/**
+ * @brief       配置两核的计数器并注册驱动回调(上电后调用一次)
+ * @param       无
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+esp_err_t perf_prof_init(void)
+{
+#if PERF_PROF_EN
+    const esp_timer_create_args_t args = { .callback = perf_prof_rotate, .name = "perf_prof" };
+
+    if (g_prof_timer != NULL)
+    {
+        return ESP_OK;
+    }
+
+    for (int i = 0; i < PERF_REGION_NUM; i++)
+    {
+        g_prof[i].name = g_prof_names[i];
+    }
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        esp_ipc_call_blocking(core, perf_prof_program, (void *)(intptr_t)g_prof_next);
+    }
+
+    if (esp_timer_create(&args, &g_prof_timer) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    esp_timer_start_periodic(g_prof_timer, PERF_PROF_ROTATE_MS * 1000);
+    camera_prof_set_hooks(&g_prof_hooks);
+    ESP_LOGI("perf_prof", "profiling %d regions, stall counter switches every %d ms", PERF_REGION_NUM, PERF_PROF_ROTATE_MS);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       区间开始: 记录周期、两个计数器、所在核与任务运行时间
+ * @param       mark : 标记(调用者栈上)
+ * @retval      无
+ */
+void perf_prof_begin(camera_prof_mark_t *mark)
+{
+#if PERF_PROF_EN
+    int core;
+
+    mark->hooks = &g_prof_hooks;
+    mark->data[PERF_MARK_RUN] = perf_prof_run_time();
+    core = xPortGetCoreID();
+    mark->data[PERF_MARK_CORE] = core;
+    mark->data[PERF_MARK_GEN] = g_prof_gen[core];
+    mark->data[PERF_MARK_INSN] = xtensa_perfmon_value(0);
+    mark->data[PERF_MARK_STALL] = xtensa_perfmon_value(1);
+    mark->data[PERF_MARK_CYCLES] = esp_cpu_get_cycle_count();
+#else
+    mark->hooks = NULL;
+#endif
+}
+
+/**
+ * @brief       区间结束: 累计到该区间(任务在区间内被切换过时只计调用次数)
+ * @param       region : 区间
+ * @param       mark   : perf_prof_begin() 填写的标记
+ * @retval      无
+ */
+void perf_prof_end(perf_region_t region, const camera_prof_mark_t *mark)
+{
+#if PERF_PROF_EN
+    uint32_t cycles = esp_cpu_get_cycle_count() - mark->data[PERF_MARK_CYCLES];  /* 先读计数器, 不计入本函数的开销 */
+    uint32_t stall = xtensa_perfmon_value(1) - mark->data[PERF_MARK_STALL];
+    uint32_t insn = xtensa_perfmon_value(0) - mark->data[PERF_MARK_INSN];
+    int core = xPortGetCoreID();
+    perf_stall_t kind = g_prof_kind[core];
+    bool same_gen = (g_prof_gen[core] == mark->data[PERF_MARK_GEN]);
+    bool switched = (perf_prof_run_time() != mark->data[PERF_MARK_RUN]) || (core != (int)mark->data[PERF_MARK_CORE]);
+    perf_prof_stats_t *r = &g_prof[region];
+
+    if (mark->hooks == NULL || region >= PERF_REGION_NUM)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL_SAFE(&g_prof_mux);
+    r->calls++;
+
+    if (switched)
+    {
+        r->switched++;
+    }
+    else
+    {
+        r->cycles += cycles;
+        r->cycles_max = (cycles > r->cycles_max) ? cycles : r->cycles_max;
+        r->insn += insn;
+
+        if (same_gen)
+        {
+            r->stall[kind] += stall;
+            r->stall_window[kind] += cycles;
+        }
+    }
+
+    portEXIT_CRITICAL_SAFE(&g_prof_mux);
+#else
+    (void)region;
+    (void)mark;
+#endif
+}
+
+/**
+ * @brief       读取一个区间的累计值(任意线程调用)
+ * @param       region : 区间
+ * @param       stats  : 输出
+ * @retval      无
+ */
+void perf_prof_get(perf_region_t region, perf_prof_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->name = (region < PERF_REGION_NUM) ? g_prof_names[region] : "";
+#if PERF_PROF_EN
+    if (region < PERF_REGION_NUM)
+    {
+        portENTER_CRITICAL(&g_prof_mux);
+        *stats = g_prof[region];
+        portEXIT_CRITICAL(&g_prof_mux);
+        stats->name = g_prof_names[region];
+    }
+#endif
+}
+
+/**
+ * @brief       输出各区间的统计表(上电以来的累计值)
+ * @param       buf  : 输出缓冲
+ * @param       size : 缓冲大小
+ * @retval      长度
+ */
+int perf_prof_format(char *buf, size_t size)
+{
+#if PERF_PROF_EN
+    perf_prof_stats_t s;
+    uint32_t clean;
+    int len;
+    int n;
+
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    len = snprintf(buf, size, "region          calls switched avg_cyc max_cyc  ipc fetch%% data%%\n");
+
+    for (int i = 0; i < PERF_REGION_NUM && len > 0 && (size_t)len < size; i++)
+    {
+        perf_prof_get((perf_region_t)i, &s);
+        clean = s.calls - s.switched;
+        n = snprintf(buf + len, size - len, "%-14s %6lu %8lu %7lu %7lu %4.2f %6.1f %5.1f\n",
+                     s.name, (unsigned long)s.calls, (unsigned long)s.switched,
+                     (unsigned long)(clean ? s.cycles / clean : 0), (unsigned long)s.cycles_max,
+                     s.cycles ? (double)s.insn / s.cycles : 0.0,
+                     s.stall_window[PERF_STALL_FETCH] ? 100.0 * s.stall[PERF_STALL_FETCH] / s.stall_window[PERF_STALL_FETCH] : 0.0,
+                     s.stall_window[PERF_STALL_DATA] ? 100.0 * s.stall[PERF_STALL_DATA] / s.stall_window[PERF_STALL_DATA] : 0.0);
+
+        if (n < 0)
+        {
+            return len;
+        }
+
+        len += n;
+    }
+
+    return ((size_t)len < size) ? len : (int)size - 1;
+#else
+    (void)buf;
+    (void)size;
+    return 0;
+#endif
+}
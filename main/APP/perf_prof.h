@@ -0,0 +1,88 @@
+/**
+ ****************************************************************************************************
+ * @file        perf_prof.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       热点区间的CPU性能计数: 周期、指令数与取指/数据停顿, 用于判断哪些代码与数据值得放入IRAM/内部RAM
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 剖析固件: idf.py -B build_prof -D PROF_BUILD=1 build(需 CONFIG_CAMERA_PROF_HOOKS, 默认打开).
+ * 区间: 驱动经 camera_prof_set_hooks() 回调的 cam_task 拷贝(DMA直写PSRAM时为缓存同步)、JPEG结束符搜索、
+ * convert_image(JPEG编码)、esp_jpg_decode(JPEG解码), 以及发送线程中一帧的发送(PERF_REGION_SEND).
+ * 计数: 周期取自 CCOUNT; 两个性能计数器(ESP32-S3 的 Xtensa 核只有2个, 各核独立)中计数器0固定计数完成的指令,
+ * 计数器1每 PERF_PROF_ROTATE_MS 在两核上同时切换一次: 取指停顿(XTPERF_CNT_I_STALL, 含 Flash 缓存缺失时的等待)
+ * 与数据停顿(XTPERF_CNT_D_STALL, 含 PSRAM 缓存缺失、存储缓冲满). 每种停顿只在它被计数期间的样本上累计,
+ * 同时累计这些样本的周期数, 停顿占比 = 停顿周期 / 同期样本周期. ESP32-S3 的 Flash/PSRAM 缓存在核外,
+ * Xtensa 计数器没有缓存缺失次数, 停顿周期就是缺失的代价.
+ * 区间内任务被切换(阻塞、被抢占、切换计数事件的IPC)时样本只计入调用次数与 switched, 不计入周期与计数,
+ * 因此发送区间反映的是不阻塞时写入协议栈的CPU开销; 中断处理的时间仍计入所在区间.
+ * 结果: /metrics 的 camera_prof_* 计数器(服务器端 rate() 相除得到每次周期、IPC与停顿占比), 以及统计帧/
+ * 周期性统计文本中的一张表(每区间调用次数、被切换次数、平均/最大周期、IPC、取指/数据停顿占比).
+ * 切换性能计数器会覆盖 apptrace/GDB 对同一计数器的使用.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __PERF_PROF_H
+#define __PERF_PROF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "camera_prof.h"
+
+
+#ifndef PERF_PROF_EN
+#define PERF_PROF_EN                0                               /* 1:剖析固件(CMake -D PROF_BUILD=1 时置1) */
+#endif
+#define PERF_PROF_ROTATE_MS         1000                            /* 计数器1切换停顿类型的间隔 */
+
+/* 区间(前几项与驱动的 camera_prof_region_t 相同) */
+typedef enum
+{
+    PERF_REGION_CAM_COPY = CAMERA_PROF_COPY,                        /* cam_task 拷贝/缓存同步 */
+    PERF_REGION_EOI = CAMERA_PROF_EOI,                              /* JPEG结束符搜索 */
+    PERF_REGION_CONVERT = CAMERA_PROF_CONVERT,                      /* convert_image */
+    PERF_REGION_JPG_DECODE = CAMERA_PROF_JPG_DECODE,                /* esp_jpg_decode */
+    PERF_REGION_SEND = CAMERA_PROF_REGION_NUM,                      /* 一帧的发送 */
+    PERF_REGION_NUM
+} perf_region_t;
+
+/* 计数器1轮流计数的停顿 */
+typedef enum
+{
+    PERF_STALL_FETCH = 0,                                           /* 取指停顿 */
+    PERF_STALL_DATA,                                                /* 数据停顿 */
+    PERF_STALL_NUM
+} perf_stall_t;
+
+/* 一个区间的累计值 */
+typedef struct
+{
+    const char *name;
+    uint32_t calls;                                                 /* 调用次数 */
+    uint32_t switched;                                              /* 区间内任务被切换的次数(不计入以下各项) */
+    uint64_t cycles;                                                /* 周期 */
+    uint32_t cycles_max;                                            /* 单次最大周期 */
+    uint64_t insn;                                                  /* 完成的指令 */
+    uint64_t stall[PERF_STALL_NUM];                                 /* 停顿周期 */
+    uint64_t stall_window[PERF_STALL_NUM];                          /* 计数该停顿期间的样本周期 */
+} perf_prof_stats_t;
+
+/* 函数声明 */
+esp_err_t perf_prof_init(void);                                     /* 配置两核的计数器并注册驱动回调 */
+void perf_prof_begin(camera_prof_mark_t *mark);                     /* 区间开始(应用自己的区间) */
+void perf_prof_end(perf_region_t region, const camera_prof_mark_t *mark);   /* 区间结束 */
+void perf_prof_get(perf_region_t region, perf_prof_stats_t *stats); /* 读取一个区间的累计值 */
+int perf_prof_format(char *buf, size_t size);                       /* 输出各区间的统计表, 返回长度 */
+
+#endif
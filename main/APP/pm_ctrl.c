@@ -0,0 +1,188 @@
+/**
+ ****************************************************************************************************
+ * @file        pm_ctrl.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       动态调频与自动浅睡眠(各流水线只在工作期间持有电源管理锁)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "pm_ctrl.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+
+static const char *g_pm_user_name[PM_CTRL_USER_NUM] = { "net", "audio", "lcd" };
+
+static portMUX_TYPE g_pm_mux = portMUX_INITIALIZER_UNLOCKED;
+static pm_ctrl_stats_t g_pm_stats;
+static uint8_t g_pm_depth[PM_CTRL_USER_NUM];                        /* 同一使用者可在多个线程中同时持有 */
+static int64_t g_pm_since_us[PM_CTRL_USER_NUM];
+static uint8_t g_pm_busy = 0;                                       /* 持有锁的使用者数 */
+static int64_t g_pm_boost_since_us = 0;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t g_pm_lock[PM_CTRL_USER_NUM];
+#endif
+
+
+/**
+ * @brief       配置动态调频与自动浅睡眠
+ * @note        PM_CTRL_EN 为0或未开启 CONFIG_PM_ENABLE 时CPU保持 CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, 只统计持有时间
+ * @param       无
+ * @retval      无
+ */
+void pm_ctrl_init(void)
+{
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = PM_CTRL_EN ? PM_CTRL_MIN_FREQ_MHZ : CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = PM_CTRL_EN && PM_CTRL_LIGHT_SLEEP_EN,
+#endif
+    };
+    esp_err_t ret;
+
+    for (int i = 0; i < PM_CTRL_USER_NUM; i++)
+    {
+        if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, g_pm_user_name[i], &g_pm_lock[i]) != ESP_OK)
+        {
+            g_pm_lock[i] = NULL;
+        }
+    }
+
+    ret = esp_pm_configure(&config);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW("TAG", "pm: configure failed: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    g_pm_stats.dfs = (config.min_freq_mhz < config.max_freq_mhz);
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    g_pm_stats.light_sleep = config.light_sleep_enable;
+#endif
+    g_pm_stats.max_mhz = config.max_freq_mhz;
+    g_pm_stats.min_mhz = config.min_freq_mhz;
+    ESP_LOGI("TAG", "pm: %d-%d MHz, light sleep %s", config.min_freq_mhz, config.max_freq_mhz,
+             g_pm_stats.light_sleep ? "on" : "off");
+#else
+    g_pm_stats.max_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    g_pm_stats.min_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+#endif
+}
+
+/**
+ * @brief       开始工作: CPU升到最高频率(可嵌套, 与 pm_ctrl_release 成对调用)
+ * @param       user : 使用者
+ * @retval      无
+ */
+void pm_ctrl_acquire(pm_ctrl_user_t user)
+{
+    int64_t now = esp_timer_get_time();
+
+#if CONFIG_PM_ENABLE
+    if (g_pm_lock[user] != NULL)
+    {
+        esp_pm_lock_acquire(g_pm_lock[user]);                       /* 锁自身计数, 嵌套时可重复获取 */
+    }
+#endif
+
+    portENTER_CRITICAL(&g_pm_mux);
+
+    if (g_pm_depth[user]++ == 0)
+    {
+        g_pm_since_us[user] = now;
+        g_pm_stats.user[user].acquires++;
+
+        if (g_pm_busy++ == 0)
+        {
+            g_pm_boost_since_us = now;
+        }
+    }
+
+    portEXIT_CRITICAL(&g_pm_mux);
+}
+
+/**
+ * @brief       工作结束
+ * @param       user : 使用者
+ * @retval      无
+ */
+void pm_ctrl_release(pm_ctrl_user_t user)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_pm_mux);
+
+    if (g_pm_depth[user] > 0 && --g_pm_depth[user] == 0)
+    {
+        g_pm_stats.user[user].held_us += now - g_pm_since_us[user];
+
+        if (--g_pm_busy == 0)
+        {
+            g_pm_stats.boost_us += now - g_pm_boost_since_us;
+        }
+    }
+
+    portEXIT_CRITICAL(&g_pm_mux);
+
+#if CONFIG_PM_ENABLE
+    if (g_pm_lock[user] != NULL)
+    {
+        esp_pm_lock_release(g_pm_lock[user]);
+    }
+#endif
+}
+
+/**
+ * @brief       读取统计(正在持有的时间计入到当前时刻)
+ * @param       stats : 输出统计
+ * @retval      无
+ */
+void pm_ctrl_get_stats(pm_ctrl_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_pm_mux);
+    *stats = g_pm_stats;
+
+    for (int i = 0; i < PM_CTRL_USER_NUM; i++)
+    {
+        if (g_pm_depth[i] > 0)
+        {
+            stats->user[i].held_us += now - g_pm_since_us[i];
+        }
+    }
+
+    if (g_pm_busy > 0)
+    {
+        stats->boost_us += now - g_pm_boost_since_us;
+    }
+
+    portEXIT_CRITICAL(&g_pm_mux);
+}
+
+/**
+ * @brief       使用者名称
+ * @param       user : 使用者
+ * @retval      名称
+ */
+const char *pm_ctrl_user_name(pm_ctrl_user_t user)
+{
+    return (user < PM_CTRL_USER_NUM) ? g_pm_user_name[user] : "?";
+}
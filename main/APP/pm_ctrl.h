@@ -0,0 +1,74 @@
+/**
+ ****************************************************************************************************
+ * @file        pm_ctrl.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       动态调频与自动浅睡眠(各流水线只在工作期间持有电源管理锁)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * PM_CTRL_EN 为1且 sdkconfig 开启 CONFIG_PM_ENABLE 时, pm_ctrl_init() 配置动态调频:
+ * 没有锁时CPU降到 PM_CTRL_MIN_FREQ_MHZ, PM_CTRL_LIGHT_SLEEP_EN 时空闲任务进入自动浅睡眠(需 CONFIG_FREERTOS_USE_TICKLESS_IDLE).
+ * 电源管理锁的持有者:
+ * 摄像头驱动   采集期间(esp_camera_resume ~ esp_camera_suspend)持有 APB_FREQ_MAX, XCLK由LEDC从APB分频且
+ *              LCD_CAM按APB采样PCLK; cam_task 处理事件期间持有 CPU_FREQ_MAX
+ * 发送(NET)    每帧裁剪、分块编码与写入协议栈期间 CPU_FREQ_MAX; WIFI关闭modem sleep时驱动自身持有APB锁
+ * 音频(AUDIO)  每个音频帧读出后的处理与发送期间 CPU_FREQ_MAX; I2S通道使能期间驱动自身持有APB锁
+ * 取景(LCD)    每帧解码缩放期间 CPU_FREQ_MAX; SPI传输期间驱动自身持有APB锁
+ * 推流时摄像头驱动一直持有APB锁, 不会浅睡眠, 帧间空闲时CPU降到80MHz, 有工作时在几十us内升回最高频率.
+ * pm_ctrl_get_stats() 按使用者统计持有时间, 与空闲任务的CPU时间一起经 /metrics 输出, 用于估算功耗.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __PM_CTRL_H
+#define __PM_CTRL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define PM_CTRL_EN                  1                               /* 1:配置动态调频(需 CONFIG_PM_ENABLE) */
+#define PM_CTRL_MIN_FREQ_MHZ        40                              /* 无锁时的CPU频率(XTAL) */
+#define PM_CTRL_LIGHT_SLEEP_EN      1                               /* 1:空闲时自动浅睡眠(WIFI按DTIM唤醒时有效) */
+
+/* 锁的使用者(摄像头驱动的锁在驱动内部) */
+typedef enum
+{
+    PM_CTRL_NET = 0,                                                /* 网络发送 */
+    PM_CTRL_AUDIO,                                                  /* 音频采集 */
+    PM_CTRL_LCD,                                                    /* LCD取景 */
+    PM_CTRL_USER_NUM,
+} pm_ctrl_user_t;
+
+/* 统计 */
+typedef struct
+{
+    bool dfs;                                                       /* 已配置动态调频 */
+    bool light_sleep;                                               /* 已使能自动浅睡眠 */
+    uint16_t max_mhz;
+    uint16_t min_mhz;
+    uint64_t boost_us;                                              /* 任一使用者持有锁的时间 */
+    struct
+    {
+        uint64_t held_us;                                           /* 持有锁的时间 */
+        uint32_t acquires;                                          /* 获取次数 */
+    } user[PM_CTRL_USER_NUM];
+} pm_ctrl_stats_t;
+
+/* 函数声明 */
+void pm_ctrl_init(void);                                            /* 配置动态调频与自动浅睡眠(其他模块初始化之前调用) */
+void pm_ctrl_acquire(pm_ctrl_user_t user);                          /* 开始工作: CPU升到最高频率 */
+void pm_ctrl_release(pm_ctrl_user_t user);                          /* 工作结束 */
+void pm_ctrl_get_stats(pm_ctrl_stats_t *stats);                     /* 读取统计 */
+const char *pm_ctrl_user_name(pm_ctrl_user_t user);                 /* 使用者名称(metrics标签) */
+
+#endif
@@ -0,0 +1,445 @@
+/**
+ ****************************************************************************************************
+ * @file        rate_ctrl.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       闭环码率控制(运行时调整JPEG质量与分辨率)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "rate_ctrl.h"
+#include "task_topo.h"
+#include "sensor_fps.h"
+#include "roi_stream.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+
+/* 可切换的分辨率档位(由低到高) */
+static const framesize_t g_rate_sizes[] = {
+    FRAMESIZE_QQVGA,
+    FRAMESIZE_QCIF,
+    FRAMESIZE_HQVGA,
+    FRAMESIZE_QVGA,
+    FRAMESIZE_CIF,
+    FRAMESIZE_HVGA,
+    FRAMESIZE_VGA,
+    FRAMESIZE_SVGA,
+    FRAMESIZE_XGA,
+    FRAMESIZE_HD,
+    FRAMESIZE_SXGA,
+    FRAMESIZE_UXGA,
+};
+
+#define RATE_SIZE_NUM   (sizeof(g_rate_sizes) / sizeof(g_rate_sizes[0]))
+
+static uint8_t g_rate_enable = 0;                               /* 仅JPEG格式下控制 */
+static int g_quality_best = 12;                                 /* JPEG质量上限(初始为配置值, 可由控制命令修改) */
+static int g_quality = 12;                                      /* 当前JPEG质量 */
+static volatile int g_quality_shed = 0;                         /* 负载调控放宽的质量上限(load_gov) */
+static int g_size_max = 0;                                      /* 分辨率档位上限(可由控制命令调低) */
+static int g_size_limit = 0;                                    /* 初始配置的分辨率档位(帧缓存按该尺寸分配) */
+static int g_size = 0;                                          /* 当前分辨率档位 */
+static int64_t g_period_start = 0;                              /* 本统计周期起始时间 */
+static uint32_t g_frames = 0;                                   /* 本周期发送帧数 */
+static uint32_t g_drops = 0;                                    /* 本周期丢帧数 */
+static uint64_t g_bytes = 0;                                    /* 本周期发送字节数 */
+static uint64_t g_send_us = 0;                                  /* 本周期发送耗时总和 */
+static uint8_t g_idle_periods = 0;                              /* 连续空闲周期数 */
+static int g_applied_quality = 12;                              /* 已写入传感器的JPEG质量(仅配置线程访问) */
+static int g_applied_size = 0;                                  /* 已写入传感器的分辨率档位(仅配置线程访问) */
+static volatile uint8_t g_rate_hold = 0;                        /* >0:暂停自适应, 保持最高分辨率与质量(连拍、硬件触发, 可叠加) */
+static volatile uint8_t g_window_dirty = 0;                     /* 1:须重新写入分辨率与窗口(ROI改变) */
+static TaskHandle_t g_rate_task = NULL;                         /* 传感器配置线程 */
+
+
+/**
+ * @brief       传感器配置线程: 把最新的质量与分辨率写入传感器
+ * @note        SCCB寄存器写入是阻塞的I2C传输(切换分辨率需写整张寄存器表), 放在本线程执行, 不占用发送线程;
+ *              只写入与上次不同的参数, 连续多次调整只按最新值写一次
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void rate_ctrl_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    sensor_t *s;
+    int quality;
+    int size;
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        s = esp_camera_sensor_get();
+        quality = g_quality;
+        size = g_size;
+
+        if (s == NULL)
+        {
+            continue;
+        }
+
+        esp_camera_sensor_lock();                               /* 驱动的质量调节与寄存器采样也在访问传感器 */
+
+        if ((size != g_applied_size || g_window_dirty) && s->set_framesize != NULL)
+        {
+            g_window_dirty = 0;
+            s->set_framesize(s, g_rate_sizes[size]);
+            roi_stream_apply(s);                                /* 有ROI时在该分辨率下重新开窗 */
+            sensor_fps_reapply();                               /* set_framesize 恢复了驱动默认的时钟分频 */
+            g_applied_size = size;
+            g_applied_quality = -1;                             /* 部分传感器切换分辨率时重载压缩参数, 质量须重新写入 */
+        }
+
+        if (quality != g_applied_quality && s->set_quality != NULL)
+        {
+            s->set_quality(s, quality);
+            g_applied_quality = quality;
+        }
+
+        esp_camera_sensor_unlock();
+
+        ESP_LOGI("TAG", "rate ctrl: quality %d, framesize %d", quality, (int)g_rate_sizes[size]);
+    }
+}
+
+/**
+ * @brief       当前生效的JPEG质量上限(控制命令设置的上限再放宽负载调控的步长)
+ * @param       无
+ * @retval      JPEG质量
+ */
+static int rate_ctrl_best(void)
+{
+    int quality = g_quality_best + g_quality_shed;
+
+    return (quality > RATE_CTRL_QUALITY_WORST) ? RATE_CTRL_QUALITY_WORST : quality;
+}
+
+/**
+ * @brief       请求把当前质量与分辨率写入传感器(不阻塞)
+ * @param       无
+ * @retval      无
+ */
+static void rate_ctrl_apply(void)
+{
+    if (g_rate_task != NULL)
+    {
+        xTaskNotifyGive(g_rate_task);
+    }
+}
+
+/**
+ * @brief       请求重新写入分辨率与传感器窗口(ROI改变时调用, 不阻塞)
+ * @param       无
+ * @retval      无
+ */
+void rate_ctrl_refresh(void)
+{
+    g_window_dirty = 1;
+    rate_ctrl_apply();
+}
+
+/**
+ * @brief       初始化码率控制
+ * @param       config : 摄像头配置(以其质量与分辨率作为上限)
+ * @retval      无
+ */
+void rate_ctrl_init(const camera_config_t *config)
+{
+    static StackType_t stack[RATE_CTRL_THREAD_STACK];              /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+    int i;
+
+    g_rate_enable = (RATE_CTRL_EN && config->pixel_format == PIXFORMAT_JPEG);
+    g_quality_best = config->jpeg_quality;
+    g_quality = config->jpeg_quality;
+    g_size_max = 0;
+
+    /* 找到不超过配置分辨率的最高档位 */
+    for (i = 0; i < (int)RATE_SIZE_NUM; i++)
+    {
+        if (g_rate_sizes[i] <= config->frame_size)
+        {
+            g_size_max = i;
+        }
+    }
+
+    g_size = g_size_max;
+    g_size_limit = g_size_max;
+    g_applied_quality = g_quality;
+    g_applied_size = g_size;
+    g_period_start = esp_timer_get_time();
+
+    if (config->pixel_format == PIXFORMAT_JPEG && g_rate_task == NULL)
+    {
+        g_rate_task = xTaskCreateStaticPinnedToCore(rate_ctrl_thread, "rate_ctrl_thread", RATE_CTRL_THREAD_STACK, NULL,
+                                                    RATE_CTRL_THREAD_PRIO, stack, &tcb, RATE_CTRL_THREAD_CORE);
+    }
+}
+
+/**
+ * @brief       设置分辨率上限(控制命令)
+ * @note        码率控制使能时在该上限内自动调节, 否则直接使用该分辨率
+ * @param       size : 分辨率, 不能超过初始化时配置的 frame_size
+ * @retval      ESP_OK:成功; ESP_ERR_INVALID_ARG:分辨率不在可切换档位内或超过配置值
+ */
+esp_err_t rate_ctrl_set_framesize(framesize_t size)
+{
+    for (int i = 0; i <= g_size_limit; i++)
+    {
+        if (g_rate_sizes[i] == size)
+        {
+            g_size_max = i;
+
+            if (g_rate_hold)
+            {
+                return ESP_OK;                                  /* 连拍结束后生效 */
+            }
+
+            if (!g_rate_enable || g_size > g_size_max)
+            {
+                g_size = g_size_max;
+            }
+
+            g_idle_periods = 0;
+            rate_ctrl_apply();
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_INVALID_ARG;
+}
+
+/**
+ * @brief       暂停/恢复自适应(连拍、硬件触发期间保持初始配置的最高分辨率与质量上限)
+ * @note        按次数计: 每次暂停须对应一次恢复, 最后一次恢复后才回到自适应
+ * @param       hold : 1:暂停并切换到最高分辨率与质量上限; 0:恢复自适应(分辨率回到控制命令设置的上限以内)
+ * @retval      保持期间的分辨率
+ */
+framesize_t rate_ctrl_hold(int hold)
+{
+    if (hold)
+    {
+        if (g_rate_hold++ > 0)
+        {
+            return g_rate_sizes[g_size_limit];                      /* 已在保持中 */
+        }
+
+        g_size = g_size_limit;
+        g_quality = g_quality_best;
+    }
+    else
+    {
+        if (g_rate_hold == 0 || --g_rate_hold > 0)
+        {
+            return g_rate_sizes[g_size_limit];                      /* 还有其他使用者在保持 */
+        }
+
+        if (!g_rate_enable || g_size > g_size_max)
+        {
+            g_size = g_size_max;
+        }
+
+        if (g_quality < rate_ctrl_best())
+        {
+            g_quality = rate_ctrl_best();                           /* 保持期间负载调控放宽了上限 */
+        }
+    }
+
+    g_idle_periods = 0;
+    rate_ctrl_apply();
+
+    return g_rate_sizes[g_size_limit];
+}
+
+/**
+ * @brief       设置JPEG质量上限(控制命令)
+ * @note        码率控制使能时在该上限与 RATE_CTRL_QUALITY_WORST 之间自动调节, 否则直接使用该质量
+ * @param       quality : JPEG质量(数值越小质量越高), 0 ~ RATE_CTRL_QUALITY_WORST
+ * @retval      ESP_OK:成功; ESP_ERR_INVALID_ARG:超出范围
+ */
+esp_err_t rate_ctrl_set_quality(int quality)
+{
+    if (quality < 0 || quality > RATE_CTRL_QUALITY_WORST)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    g_quality_best = quality;
+
+    if (!g_rate_enable || g_quality < rate_ctrl_best())
+    {
+        g_quality = rate_ctrl_best();
+    }
+
+    g_idle_periods = 0;
+    rate_ctrl_apply();
+    return ESP_OK;
+}
+
+/**
+ * @brief       负载调控放宽JPEG质量上限(调控线程调用)
+ * @note        降低质量可减少传感器输出与协议栈处理的数据量; 连拍期间仍使用控制命令设置的上限
+ * @param       worse : 在控制命令设置的上限上放宽的步长, 0:恢复
+ * @retval      无
+ */
+void rate_ctrl_shed(int worse)
+{
+    if (worse == g_quality_shed)
+    {
+        return;
+    }
+
+    g_quality_shed = (worse > 0) ? worse : 0;
+
+    if (g_rate_hold)
+    {
+        return;
+    }
+
+    if (!g_rate_enable || g_quality < rate_ctrl_best())
+    {
+        g_quality = rate_ctrl_best();                               /* 放宽时立即生效, 恢复时由空闲周期逐步提升 */
+    }
+
+    g_idle_periods = 0;
+    rate_ctrl_apply();
+}
+
+/**
+ * @brief       统计周期结束, 根据帧率/码率/发送耗时调整编码参数
+ * @param       elapsed_us : 本周期时长
+ * @retval      无
+ */
+static void rate_ctrl_update(int64_t elapsed_us)
+{
+    uint32_t kbps = (uint32_t)(g_bytes * 8 * 1000 / elapsed_us);
+    uint32_t fps_x10 = (uint32_t)((uint64_t)g_frames * 10000000 / elapsed_us);
+    uint32_t budget_us = 1000000 / RATE_CTRL_TARGET_FPS;        /* 每帧可用的发送时间 */
+    uint32_t avg_us = g_frames ? (uint32_t)(g_send_us / g_frames) : budget_us;
+    int congested;
+    int idle;
+
+    congested = (g_drops > 0) ||
+                (kbps > RATE_CTRL_MAX_KBPS) ||
+                (avg_us > budget_us * 4 / 5);
+    idle = (g_drops == 0) &&
+           (kbps < RATE_CTRL_MAX_KBPS * 7 / 10) &&
+           (avg_us < budget_us / 2);
+
+    ESP_LOGD("TAG", "rate ctrl: %lu.%lu fps, %lu kbps, send %lu us, drop %lu",
+             (unsigned long)(fps_x10 / 10), (unsigned long)(fps_x10 % 10),
+             (unsigned long)kbps, (unsigned long)avg_us, (unsigned long)g_drops);
+
+    if (congested)
+    {
+        g_idle_periods = 0;
+
+        if (g_quality < RATE_CTRL_QUALITY_WORST)
+        {
+            g_quality += RATE_CTRL_QUALITY_DOWN;
+            g_quality = (g_quality > RATE_CTRL_QUALITY_WORST) ? RATE_CTRL_QUALITY_WORST : g_quality;
+            rate_ctrl_apply();
+        }
+        else if (g_size > 0)
+        {
+            /* 质量已到下限, 降一档分辨率, 质量回到中间值 */
+            g_size--;
+            g_quality = (rate_ctrl_best() + RATE_CTRL_QUALITY_WORST) / 2;
+            rate_ctrl_apply();
+        }
+    }
+    else if (idle)
+    {
+        if (++g_idle_periods < RATE_CTRL_UP_PERIODS)
+        {
+            return;
+        }
+
+        g_idle_periods = 0;
+
+        if (g_quality > rate_ctrl_best())
+        {
+            g_quality -= RATE_CTRL_QUALITY_UP;
+            g_quality = (g_quality < rate_ctrl_best()) ? rate_ctrl_best() : g_quality;
+            rate_ctrl_apply();
+        }
+        else if (g_size < g_size_max)
+        {
+            /* 升一档分辨率时先用最低质量, 再逐步提升 */
+            g_size++;
+            g_quality = RATE_CTRL_QUALITY_WORST;
+            rate_ctrl_apply();
+        }
+    }
+    else
+    {
+        g_idle_periods = 0;
+    }
+}
+
+/**
+ * @brief       统计周期到期时执行一次控制
+ * @param       无
+ * @retval      无
+ */
+static void rate_ctrl_poll(void)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - g_period_start;
+
+    if (elapsed < (int64_t)RATE_CTRL_PERIOD_MS * 1000)
+    {
+        return;
+    }
+
+    if (g_rate_enable && !g_rate_hold)
+    {
+        rate_ctrl_update(elapsed);
+    }
+
+    g_period_start = now;
+    g_frames = 0;
+    g_drops = 0;
+    g_bytes = 0;
+    g_send_us = 0;
+}
+
+/**
+ * @brief       上报已发送的一帧(由发送线程调用)
+ * @param       bytes   : 帧长度(含帧头)
+ * @param       send_us : 本帧发送耗时
+ * @retval      无
+ */
+void rate_ctrl_on_frame(size_t bytes, uint32_t send_us)
+{
+    g_frames++;
+    g_bytes += bytes;
+    g_send_us += send_us;
+    rate_ctrl_poll();
+}
+
+/**
+ * @brief       上报一次丢帧(由发送线程调用)
+ * @param       无
+ * @retval      无
+ */
+void rate_ctrl_on_drop(void)
+{
+    g_drops++;
+    rate_ctrl_poll();
+}
@@ -0,0 +1,55 @@
+/**
+ ****************************************************************************************************
+ * @file        rate_ctrl.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       闭环码率控制(运行时调整JPEG质量与分辨率)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 发送线程每发出一帧上报一次(字节数、发送耗时), 每个统计周期计算实际帧率与码率:
+ * 链路拥塞时先降低JPEG质量, 质量降到下限后再降低分辨率; 链路连续空闲时按相反顺序恢复,
+ * 分辨率最高恢复到初始化时配置的 frame_size(帧缓存按该尺寸分配).
+ * 切换分辨率只调用 set_framesize 改写传感器寄存器, 不重新初始化摄像头驱动(帧缓存与DMA描述符保持不变);
+ * 寄存器写入在单独的低优先级线程中进行, 只写入变化的参数, 发送线程不被SCCB传输阻塞;
+ * 每次写入分辨率后由 roi_stream 重新开窗、sensor_fps 恢复帧率档位
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __RATE_CTRL_H
+#define __RATE_CTRL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_camera.h"
+
+
+#define RATE_CTRL_EN                1                               /* 1:使能码率控制; 0:固定质量与分辨率 */
+#define RATE_CTRL_TARGET_FPS        20                              /* 目标帧率 */
+#define RATE_CTRL_MAX_KBPS          6000                            /* 码率上限(kbit/s), 多台设备共享信道时调低 */
+#define RATE_CTRL_PERIOD_MS         1000                            /* 统计周期 */
+#define RATE_CTRL_QUALITY_WORST     40                              /* JPEG质量下限(数值越大质量越差) */
+#define RATE_CTRL_QUALITY_DOWN      4                               /* 拥塞时每次降低的质量步长 */
+#define RATE_CTRL_QUALITY_UP        2                               /* 空闲时每次提升的质量步长 */
+#define RATE_CTRL_UP_PERIODS        3                               /* 连续空闲多少个周期后才提升 */
+
+/* 函数声明 */
+void rate_ctrl_init(const camera_config_t *config);                 /* 初始化码率控制 */
+void rate_ctrl_on_frame(size_t bytes, uint32_t send_us);            /* 上报已发送的一帧 */
+void rate_ctrl_on_drop(void);                                       /* 上报一次丢帧 */
+esp_err_t rate_ctrl_set_framesize(framesize_t size);                /* 设置分辨率上限(控制命令) */
+esp_err_t rate_ctrl_set_quality(int quality);                       /* 设置JPEG质量上限(控制命令) */
+void rate_ctrl_shed(int worse);                                     /* 负载调控放宽JPEG质量上限 */
+framesize_t rate_ctrl_hold(int hold);                               /* 暂停/恢复自适应(连拍、硬件触发, 按次数计), 返回保持的分辨率 */
+void rate_ctrl_refresh(void);                                       /* 重新写入分辨率与传感器窗口(ROI改变) */
+
+#endif
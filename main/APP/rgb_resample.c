@@ -0,0 +1,364 @@
+/**
+ ****************************************************************************************************
+ * @file        rgb_resample.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       RGB565分条缩放与旋转(最近邻/双线性, 0/90/180/270度), 输出到LCD的DMA条带缓存
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "rgb_resample.h"
+#include <string.h>
+
+
+#define RGB_RESAMPLE_MASK           0x07E0F81FU                     /* 展开后的RGB565: G(21~26), R(11~15), B(0~4) */
+
+/**
+ * @brief       RGB565展开为32位, 各分量之间留出5位余量
+ * @param       c : RGB565
+ * @retval      展开后的值
+ */
+static inline uint32_t rs_expand(uint16_t c)
+{
+    return ((uint32_t)c | ((uint32_t)c << 16)) & RGB_RESAMPLE_MASK;
+}
+
+/**
+ * @brief       两个展开值按权重插值, 三个分量同时计算
+ * @param       a : 权重 32-w 的值
+ * @param       b : 权重 w 的值
+ * @param       w : 权重(0~32)
+ * @retval      插值结果(展开形式)
+ */
+static inline uint32_t rs_lerp(uint32_t a, uint32_t b, uint32_t w)
+{
+    return ((a * (32 - w) + b * w) >> 5) & RGB_RESAMPLE_MASK;
+}
+
+/**
+ * @brief       展开值还原为RGB565大端(LCD的字节顺序)
+ * @param       v : 展开值
+ * @retval      RGB565大端
+ */
+static inline uint16_t rs_pack_be(uint32_t v)
+{
+    return __builtin_bswap16((uint16_t)(v | (v >> 16)));
+}
+
+/**
+ * @brief       计算一个输出行(旋转前)对应的源行与权重
+ * @param       rs : 缩放状态
+ * @param       oy : 输出行
+ * @param       r0 : 上方源行
+ * @param       r1 : 下方源行
+ * @param       wy : 下方源行的权重(0~31), 最近邻时为0
+ * @retval      无
+ */
+static void rs_row_pos(const rgb_resample_t *rs, uint16_t oy, uint16_t *r0, uint16_t *r1, uint32_t *wy)
+{
+    int32_t pos = (int32_t)(oy * rs->step_y + (rs->step_y >> 1));
+
+    if (rs->filter == RGB_FILTER_BILINEAR)
+    {
+        pos -= 0x8000;                                              /* 像素中心对齐 */
+
+        if (pos < 0)
+        {
+            pos = 0;
+        }
+
+        *r0 = (uint16_t)(pos >> 16);
+        *wy = (uint32_t)(pos & 0xFFFF) >> 11;
+    }
+    else
+    {
+        *r0 = (uint16_t)(pos >> 16);
+        *wy = 0;
+    }
+
+    if (*r0 >= rs->src_h - 1)
+    {
+        *r0 = rs->src_h - 1;
+        *wy = 0;
+    }
+
+    *r1 = (*wy != 0) ? *r0 + 1 : *r0;
+}
+
+/**
+ * @brief       取得一个源行
+ * @param       rs   : 缩放状态
+ * @param       rows : 当前条带
+ * @param       y    : 当前条带的起始行
+ * @param       r    : 源行号
+ * @retval      该行的像素
+ */
+static inline const uint16_t *rs_src_row(const rgb_resample_t *rs, const uint16_t *rows, uint16_t y, uint16_t r)
+{
+    if (r < y)
+    {
+        return (rs->prev_y == r) ? rs->prev : rows;                 /* 上一条带的最后一行(条带不连续时用本条带首行代替) */
+    }
+
+    return rows + (size_t)(r - y) * rs->src_w;
+}
+
+/**
+ * @brief       缩放一行, 按 step 写入输出(旋转后相邻的输出像素在缓冲中的间距)
+ * @param       rs   : 缩放状态
+ * @param       s0   : 上方源行
+ * @param       s1   : 下方源行
+ * @param       wy   : 下方源行的权重(0~31)
+ * @param       out  : 第一个输出像素
+ * @param       step : 输出像素间距
+ * @retval      无
+ */
+static void rs_row(const rgb_resample_t *rs, const uint16_t *s0, const uint16_t *s1, uint32_t wy,
+                   uint16_t *out, int step)
+{
+    const uint16_t *xi = rs->xi;
+    uint16_t vw = rs->vw;
+
+    if (rs->filter == RGB_FILTER_NEAREST)
+    {
+        for (uint16_t x = 0; x < vw; x++, out += step)
+        {
+            *out = __builtin_bswap16(s0[xi[x]]);
+        }
+    }
+    else if (wy == 0)
+    {
+        for (uint16_t x = 0; x < vw; x++, out += step)
+        {
+            const uint16_t *p = s0 + xi[x];
+
+            *out = rs_pack_be(rs_lerp(rs_expand(p[0]), rs_expand(p[1]), rs->xf[x]));
+        }
+    }
+    else
+    {
+        for (uint16_t x = 0; x < vw; x++, out += step)
+        {
+            const uint16_t *p = s0 + xi[x];
+            const uint16_t *q = s1 + xi[x];
+            uint32_t wx = rs->xf[x];
+            uint32_t top = rs_lerp(rs_expand(p[0]), rs_expand(p[1]), wx);
+            uint32_t bot = rs_lerp(rs_expand(q[0]), rs_expand(q[1]), wx);
+
+            *out = rs_pack_be(rs_lerp(top, bot, wy));
+        }
+    }
+}
+
+/**
+ * @brief       初始化一帧的缩放
+ * @param       rs         : 缩放状态
+ * @param       src_w      : 源图像宽度(2 ~ RGB_RESAMPLE_SRC_MAX_W)
+ * @param       src_h      : 源图像高度
+ * @param       out_w      : 输出(屏幕上)宽度
+ * @param       out_h      : 输出(屏幕上)高度
+ * @param       rotate     : 旋转方向
+ * @param       filter     : 插值方式
+ * @param       buf        : 第一块输出缓冲
+ * @param       buf_pixels : 每块输出缓冲的像素数(不小于旋转前的输出宽度)
+ * @param       cb         : 输出回调
+ * @param       arg        : 回调参数
+ * @retval      true:成功; false:参数超出范围
+ */
+bool rgb_resample_init(rgb_resample_t *rs, uint16_t src_w, uint16_t src_h, uint16_t out_w, uint16_t out_h,
+                       rgb_rotate_t rotate, rgb_filter_t filter,
+                       uint16_t *buf, size_t buf_pixels, rgb_resample_cb cb, void *arg)
+{
+    bool swap = (rotate == RGB_ROTATE_90 || rotate == RGB_ROTATE_270);
+    uint16_t vw = swap ? out_h : out_w;
+    uint16_t vh = swap ? out_w : out_h;
+    uint32_t step_x;
+
+    if (src_w < 2 || src_w > RGB_RESAMPLE_SRC_MAX_W || src_h == 0 ||
+        vw == 0 || vw > RGB_RESAMPLE_MAX_W || vh == 0 || buf == NULL || buf_pixels < vw)
+    {
+        return false;
+    }
+
+    rs->src_w = src_w;
+    rs->src_h = src_h;
+    rs->out_w = out_w;
+    rs->out_h = out_h;
+    rs->vw = vw;
+    rs->vh = vh;
+    rs->rotate = rotate;
+    rs->filter = filter;
+    rs->step_y = ((uint32_t)src_h << 16) / vh;
+    rs->next_y = 0;
+    rs->prev_y = -1;
+    rs->buf = buf;
+    rs->buf_pixels = buf_pixels;
+    rs->cb = cb;
+    rs->arg = arg;
+
+    step_x = ((uint32_t)src_w << 16) / vw;
+
+    for (uint16_t x = 0; x < vw; x++)
+    {
+        int32_t pos = (int32_t)(x * step_x + (step_x >> 1));
+
+        if (filter == RGB_FILTER_BILINEAR)
+        {
+            pos = (pos > 0x8000) ? pos - 0x8000 : 0;
+            rs->xi[x] = (uint16_t)(pos >> 16);
+            rs->xf[x] = (uint8_t)((pos & 0xFFFF) >> 11);
+
+            if (rs->xi[x] >= src_w - 1)
+            {
+                rs->xi[x] = src_w - 2;                             /* 保证右侧列有效, 权重全部给右侧 */
+                rs->xf[x] = 32;
+            }
+        }
+        else
+        {
+            rs->xi[x] = (uint16_t)(pos >> 16);
+            rs->xf[x] = 0;
+
+            if (rs->xi[x] >= src_w)
+            {
+                rs->xi[x] = src_w - 1;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief       送入一个源条带, 输出其中可以算出的全部行
+ * @note        条带须按从上到下的顺序送入; 输出缓冲写满或条带用完时调用输出回调
+ * @param       rs    : 缩放状态
+ * @param       rows  : 条带像素(RGB565小端, 行优先, 行宽为源图像宽度)
+ * @param       y     : 条带起始行
+ * @param       lines : 条带行数
+ * @retval      true:还需要后续条带; false:已输出全部行或回调要求结束
+ */
+bool rgb_resample_rows(rgb_resample_t *rs, const uint16_t *rows, uint16_t y, uint16_t lines)
+{
+    uint32_t end = (uint32_t)y + lines;
+    uint16_t batch = (uint16_t)((rs->buf_pixels / rs->vw > 0xFFFF) ? 0xFFFF : rs->buf_pixels / rs->vw);
+    uint16_t avail = 0;
+    uint16_t r0, r1;
+    uint32_t wy;
+
+    if (rs->buf == NULL)
+    {
+        return false;
+    }
+
+    while (rs->next_y + avail < rs->vh)                             /* 本条带内可以算出的输出行数 */
+    {
+        rs_row_pos(rs, rs->next_y + avail, &r0, &r1, &wy);
+
+        if (r1 >= end)
+        {
+            break;
+        }
+
+        avail++;
+    }
+
+    while (avail > 0)
+    {
+        uint16_t n = (avail < batch) ? avail : batch;
+        uint16_t oy0 = rs->next_y;
+        uint16_t vw = rs->vw;
+        uint16_t vh = rs->vh;
+        uint16_t x, yy, w, h;
+
+        for (uint16_t k = 0; k < n; k++)
+        {
+            uint16_t *base;
+            int step;
+
+            rs_row_pos(rs, oy0 + k, &r0, &r1, &wy);
+
+            switch (rs->rotate)
+            {
+                case RGB_ROTATE_90:
+                    base = rs->buf + (n - 1 - k);
+                    step = n;
+                    break;
+
+                case RGB_ROTATE_180:
+                    base = rs->buf + (size_t)(n - 1 - k) * vw + vw - 1;
+                    step = -1;
+                    break;
+
+                case RGB_ROTATE_270:
+                    base = rs->buf + (size_t)(vw - 1) * n + k;
+                    step = -(int)n;
+                    break;
+
+                default:
+                    base = rs->buf + (size_t)k * vw;
+                    step = 1;
+                    break;
+            }
+
+            rs_row(rs, rs_src_row(rs, rows, y, r0), rs_src_row(rs, rows, y, r1), wy, base, step);
+        }
+
+        switch (rs->rotate)
+        {
+            case RGB_ROTATE_90:
+                x = vh - oy0 - n; yy = 0; w = n; h = vw;
+                break;
+
+            case RGB_ROTATE_180:
+                x = 0; yy = vh - oy0 - n; w = vw; h = n;
+                break;
+
+            case RGB_ROTATE_270:
+                x = oy0; yy = 0; w = n; h = vw;
+                break;
+
+            default:
+                x = 0; yy = oy0; w = vw; h = n;
+                break;
+        }
+
+        rs->next_y += n;
+        avail -= n;
+
+        if (!rs->cb(rs->arg, x, yy, w, h, &rs->buf) || rs->buf == NULL)
+        {
+            rs->buf = NULL;
+            return false;
+        }
+    }
+
+    if (lines > 0)
+    {
+        memcpy(rs->prev, rows + (size_t)(lines - 1) * rs->src_w, rs->src_w * sizeof(uint16_t));
+        rs->prev_y = (int32_t)end - 1;
+    }
+
+    return rs->next_y < rs->vh;
+}
+
+/**
+ * @brief       是否已输出全部行
+ * @param       rs : 缩放状态
+ * @retval      true:已输出全部行
+ */
+bool rgb_resample_done(const rgb_resample_t *rs)
+{
+    return rs->next_y >= rs->vh;
+}
@@ -0,0 +1,91 @@
+/**
+ ****************************************************************************************************
+ * @file        rgb_resample.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       RGB565分条缩放与旋转(最近邻/双线性, 0/90/180/270度), 输出到LCD的DMA条带缓存
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * jpg2strips 的缩放只有 1/1、1/2、1/4、1/8, 摄像头分辨率与屏幕(SPI_LCD_TYPE 为320x240或240x240)一般不成比例.
+ * 本模块接在 jpg2strips() 的条带回调之后: 源图像按条带(任意行数, RGB565小端)依次送入, 每个条带内可以算出的
+ * 输出行立即缩放、旋转并写入调用者的输出缓冲(RGB565大端, 即LCD的字节顺序), 输出缓冲满或条带用完时回调一次,
+ * 由调用者DMA刷屏并换上下一块缓冲; 整个过程没有整帧的中间缓冲.
+ * 1 坐标映射为16.16定点数(像素中心对齐), 每个输出列的源列号与权重在初始化时查表, 每行只算一次行号与权重;
+ * 2 双线性插值把RGB565展开为 0x07E0F81F 排列的32位数(G在高位, R、B在低位, 各留5位余量), 一次乘法同时计算三个分量;
+ * 3 双线性需要相邻两行, 上一条带的最后一行保存在 prev 中, 跨条带的输出行不丢失;
+ * 4 旋转在写输出时完成(按旋转后的矩形写入缓冲), 90/270度时每批输出行在屏幕上是一个竖条.
+ * ESP32-S3 的PIE向量指令只能按16字节对齐连续存取, 不适合查表取列的缩放, 这里用32位寄存器内并行(SWAR)实现.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __RGB_RESAMPLE_H
+#define __RGB_RESAMPLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+
+#define RGB_RESAMPLE_MAX_W          320                             /* 旋转前输出宽度的上限 */
+#define RGB_RESAMPLE_SRC_MAX_W      800                             /* 源图像宽度的上限(保存上一行) */
+
+/* 插值方式 */
+typedef enum
+{
+    RGB_FILTER_NEAREST = 0,                                         /* 最近邻 */
+    RGB_FILTER_BILINEAR,                                            /* 双线性 */
+} rgb_filter_t;
+
+/* 旋转方向(顺时针) */
+typedef enum
+{
+    RGB_ROTATE_0 = 0,
+    RGB_ROTATE_90,
+    RGB_ROTATE_180,
+    RGB_ROTATE_270,
+} rgb_rotate_t;
+
+/* 输出回调: 输出缓冲 *buf 中是屏幕上 (x, y) 起 w x h 的矩形(相对于输出图像左上角), 返回true:继续(*buf 换成下一块输出缓冲); false:结束 */
+typedef bool (*rgb_resample_cb)(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t **buf);
+
+/* 缩放状态(约3KB) */
+typedef struct
+{
+    uint16_t src_w;                                                 /* 源图像宽高 */
+    uint16_t src_h;
+    uint16_t out_w;                                                 /* 输出(屏幕上)宽高 */
+    uint16_t out_h;
+    uint16_t vw;                                                    /* 旋转前的输出宽高 */
+    uint16_t vh;
+    rgb_rotate_t rotate;
+    rgb_filter_t filter;
+    uint32_t step_y;                                                /* 输出行对应的源行步长(16.16) */
+    uint16_t next_y;                                                /* 下一个待输出的行(旋转前) */
+    int32_t prev_y;                                                 /* prev 中保存的源行号, -1:无 */
+    uint16_t *buf;                                                  /* 当前输出缓冲 */
+    size_t buf_pixels;                                              /* 输出缓冲的像素数 */
+    rgb_resample_cb cb;
+    void *arg;
+    uint16_t xi[RGB_RESAMPLE_MAX_W];                                /* 各输出列的源列号 */
+    uint8_t xf[RGB_RESAMPLE_MAX_W];                                 /* 各输出列的右侧权重(0~32, 双线性) */
+    uint16_t prev[RGB_RESAMPLE_SRC_MAX_W];                          /* 上一条带的最后一行 */
+} rgb_resample_t;
+
+/* 函数声明 */
+bool rgb_resample_init(rgb_resample_t *rs, uint16_t src_w, uint16_t src_h, uint16_t out_w, uint16_t out_h,
+                       rgb_rotate_t rotate, rgb_filter_t filter,
+                       uint16_t *buf, size_t buf_pixels, rgb_resample_cb cb, void *arg);   /* 初始化一帧的缩放 */
+bool rgb_resample_rows(rgb_resample_t *rs, const uint16_t *rows, uint16_t y, uint16_t lines); /* 送入一个源条带 */
+bool rgb_resample_done(const rgb_resample_t *rs);                   /* 是否已输出全部行 */
+
+#endif
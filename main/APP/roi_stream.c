@@ -0,0 +1,380 @@
+/**
+ ****************************************************************************************************
+ * @file        roi_stream.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       感兴趣区域(ROI)推流: 由传感器开窗裁剪并缩放到当前分辨率(数字变焦)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "roi_stream.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "rate_ctrl.h"
+#include "heap_stats.h"
+#include "jpg_requant.h"
+#include <string.h>
+
+
+/* OV3660/OV5640 的4:3全幅读出参数(与驱动 ratio_table 的4:3项相同) */
+typedef struct
+{
+    uint16_t max_w;                                                 /* ISP输入窗口 */
+    uint16_t max_h;
+    uint16_t offset_x;                                              /* 读出范围到ISP窗口的边距 */
+    uint16_t offset_y;
+    uint16_t total_x;                                               /* HTS */
+    uint16_t total_y;                                               /* VTS */
+} roi_array_t;
+
+static const roi_array_t g_ov5640_array = {2560, 1920, 32, 16, 2844, 1968};
+static const roi_array_t g_ov3660_array = {2048, 1536, 16, 6, 2300, 1564};
+
+static SemaphoreHandle_t g_roi_lock = NULL;                         /* 保护 g_roi, 第一次设置时创建 */
+static roi_rect_t g_roi = {0, 0, ROI_STREAM_FULL, ROI_STREAM_FULL};
+static volatile uint8_t g_roi_crop = 0;                             /* 1:ROI由压缩域裁剪实现(传感器不支持开窗) */
+#if ROI_STREAM_CROP_EN
+static jpg_crop_t *g_crop = NULL;                                   /* 裁剪状态(内部RAM, 首次裁剪时申请) */
+static uint8_t *g_crop_buf = NULL;                                  /* 裁剪输出(PSRAM) */
+static size_t g_crop_cap = 0;
+#endif
+
+
+/**
+ * @brief       把千分比ROI换算为像素窗口(按输出宽高比扩展, 不小于输出尺寸, 限制在视场内)
+ * @param       roi    : ROI
+ * @param       full_w : 视场宽度(像素)
+ * @param       full_h : 视场高度(像素)
+ * @param       out_w  : 输出宽度
+ * @param       out_h  : 输出高度
+ * @param       align  : 窗口尺寸对齐
+ * @param       win    : 输出窗口(像素)
+ * @retval      true:成功; false:视场小于输出尺寸
+ */
+static bool roi_stream_window(const roi_rect_t *roi, uint32_t full_w, uint32_t full_h,
+                              uint32_t out_w, uint32_t out_h, uint32_t align, roi_rect_t *win)
+{
+    uint32_t w = full_w * roi->w / ROI_STREAM_FULL;
+    uint32_t h = full_h * roi->h / ROI_STREAM_FULL;
+    uint32_t cx = full_w * (roi->x * 2 + roi->w) / (ROI_STREAM_FULL * 2);    /* ROI中心 */
+    uint32_t cy = full_h * (roi->y * 2 + roi->h) / (ROI_STREAM_FULL * 2);
+
+    if (full_w < out_w || full_h < out_h)
+    {
+        return false;
+    }
+
+    if (w * out_h < h * out_w)                                      /* 按输出宽高比扩展较窄的一边 */
+    {
+        w = h * out_w / out_h;
+    }
+    else
+    {
+        h = w * out_h / out_w;
+    }
+
+    w = (w < out_w) ? out_w : w;
+    h = (h < out_h) ? out_h : h;
+    w = (w > full_w) ? full_w : w;
+    h = (h > full_h) ? full_h : h;
+    w -= w % align;
+    h -= h % align;
+
+    win->w = w;
+    win->h = h;
+    win->x = (cx < w / 2) ? 0 : ((cx - w / 2 + w > full_w) ? full_w - w : cx - w / 2);
+    win->y = (cy < h / 2) ? 0 : ((cy - h / 2 + h > full_h) ? full_h - h : cy - h / 2);
+
+    return true;
+}
+
+/**
+ * @brief       OV2640: 在读出模式中开窗
+ * @param       s     : 传感器
+ * @param       roi   : ROI
+ * @param       out_w : 输出宽度
+ * @param       out_h : 输出高度
+ * @retval      0:成功; 其他:失败
+ */
+static int roi_stream_ov2640(sensor_t *s, const roi_rect_t *roi, uint16_t out_w, uint16_t out_h)
+{
+    /* 读出模式 UXGA/SVGA/CIF(驱动 ov2640_sensor_mode_t 的顺序)的视场, CIF的行数驱动限制为296 */
+    static const uint16_t mode_w[] = {1600, 800, 400};
+    static const uint16_t mode_h[] = {1200, 600, 296};
+    framesize_t size = s->status.framesize;
+    int mode = (size <= FRAMESIZE_CIF) ? 2 : ((size <= FRAMESIZE_SVGA) ? 1 : 0);
+    roi_rect_t win;
+
+    /* 窗口小于输出尺寸时改用更高分辨率的读出模式, 保证只缩小不放大 */
+    while (mode > 0 &&
+           ((uint32_t)mode_w[mode] * roi->w / ROI_STREAM_FULL < out_w ||
+            (uint32_t)mode_h[mode] * roi->h / ROI_STREAM_FULL < out_h))
+    {
+        mode--;
+    }
+
+    if (!roi_stream_window(roi, mode_w[mode], mode_h[mode], out_w, out_h, 4, &win))
+    {
+        return -1;
+    }
+
+    return s->set_res_raw(s, mode, 0, 0, 0, win.x, win.y, win.w, win.h, out_w, out_h, false, false);
+}
+
+/**
+ * @brief       OV3660/OV5640: 设置读出起止地址
+ * @param       s     : 传感器
+ * @param       a     : 全幅读出参数
+ * @param       roi   : ROI
+ * @param       out_w : 输出宽度
+ * @param       out_h : 输出高度
+ * @retval      0:成功; 其他:失败
+ */
+static int roi_stream_ov5640(sensor_t *s, const roi_array_t *a, const roi_rect_t *roi, uint16_t out_w, uint16_t out_h)
+{
+    roi_rect_t win;
+    bool scale;
+
+    if (!roi_stream_window(roi, a->max_w, a->max_h, out_w, out_h, 4, &win))
+    {
+        return -1;
+    }
+
+    scale = (win.w != out_w || win.h != out_h);
+
+    /* 读出范围 = 窗口 + 两侧边距; VTS减去未读出的行数, 保持原有的场消隐 */
+    return s->set_res_raw(s, win.x, win.y,
+                          win.x + win.w + 2 * a->offset_x - 1, win.y + win.h + 2 * a->offset_y - 1,
+                          a->offset_x, a->offset_y,
+                          a->total_x, a->total_y - (a->max_h - win.h),
+                          out_w, out_h, scale, false);
+}
+
+/**
+ * @brief       设置ROI
+ * @note        只保存并通知配置线程, 不阻塞; ROI为全视场时恢复 set_framesize 的默认窗口
+ * @param       roi : ROI(全视场的千分比)
+ * @retval      ESP_OK:成功; ESP_ERR_INVALID_ARG:超出视场或小于 ROI_STREAM_MIN; ESP_ERR_NOT_SUPPORTED:传感器不支持
+ */
+esp_err_t roi_stream_set(const roi_rect_t *roi)
+{
+#if ROI_STREAM_EN
+    sensor_t *s = esp_camera_sensor_get();
+    uint8_t crop;
+
+    if (s == NULL || s->pixformat != PIXFORMAT_JPEG)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    crop = (s->set_res_raw == NULL || (s->id.PID != OV2640_PID && s->id.PID != OV3660_PID && s->id.PID != OV5640_PID));
+
+    if (crop && !ROI_STREAM_CROP_EN)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (roi->w < ROI_STREAM_MIN || roi->h < ROI_STREAM_MIN ||
+        roi->x + roi->w > ROI_STREAM_FULL || roi->y + roi->h > ROI_STREAM_FULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (g_roi_lock == NULL)
+    {
+        g_roi_lock = xSemaphoreCreateMutex();
+
+        if (g_roi_lock == NULL)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(g_roi_lock, portMAX_DELAY);
+    g_roi = *roi;
+    g_roi_crop = crop;
+    xSemaphoreGive(g_roi_lock);
+
+    if (!crop)
+    {
+        rate_ctrl_refresh();                                        /* 由配置线程重写分辨率与窗口 */
+    }
+
+    return ESP_OK;
+#else
+    (void)roi;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       读取当前ROI
+ * @param       roi : 输出ROI
+ * @retval      无
+ */
+void roi_stream_get(roi_rect_t *roi)
+{
+    if (g_roi_lock == NULL)
+    {
+        *roi = g_roi;
+        return;
+    }
+
+    xSemaphoreTake(g_roi_lock, portMAX_DELAY);
+    *roi = g_roi;
+    xSemaphoreGive(g_roi_lock);
+}
+
+/**
+ * @brief       把ROI写入传感器窗口(码率控制配置线程在 set_framesize 之后调用)
+ * @param       s : 传感器
+ * @retval      0:成功或无ROI; 其他:写入失败
+ */
+int roi_stream_apply(sensor_t *s)
+{
+#if ROI_STREAM_EN
+    roi_rect_t roi;
+    uint16_t out_w;
+    uint16_t out_h;
+    int ret;
+
+    roi_stream_get(&roi);
+
+    if ((roi.w >= ROI_STREAM_FULL && roi.h >= ROI_STREAM_FULL) || g_roi_crop)
+    {
+        return 0;                                                   /* 全视场或压缩域裁剪, set_framesize 的窗口即可 */
+    }
+
+    out_w = resolution[s->status.framesize].width;
+    out_h = resolution[s->status.framesize].height;
+
+    switch (s->id.PID)
+    {
+        case OV2640_PID:
+            ret = roi_stream_ov2640(s, &roi, out_w, out_h);
+            break;
+
+        case OV5640_PID:
+            ret = roi_stream_ov5640(s, &g_ov5640_array, &roi, out_w, out_h);
+            break;
+
+        case OV3660_PID:
+            ret = roi_stream_ov5640(s, &g_ov3660_array, &roi, out_w, out_h);
+            break;
+
+        default:
+            return -1;
+    }
+
+    if (ret != 0)
+    {
+        ESP_LOGW("TAG", "roi: set window failed");
+    }
+
+    return ret;
+#else
+    (void)s;
+    return 0;
+#endif
+}
+
+/**
+ * @brief       是否以压缩域裁剪实现ROI(需要完整帧的发送方式据此回退)
+ * @param       无
+ * @retval      1:已设置压缩域裁剪的ROI; 0:无ROI或由传感器开窗
+ */
+int roi_stream_crop_active(void)
+{
+    roi_rect_t roi;
+
+    if (!g_roi_crop)
+    {
+        return 0;
+    }
+
+    roi_stream_get(&roi);
+    return roi.w < ROI_STREAM_FULL || roi.h < ROI_STREAM_FULL;
+}
+
+/**
+ * @brief       压缩域裁剪一帧JPEG(ROI由 jpg_crop 实现时, 发送线程调用)
+ * @note        输出缓冲在下一次调用前有效; ROI按MCU向外对齐, w/h 为输出图像的宽高
+ * @param       fb  : 摄像头帧缓存
+ * @param       len : 输出长度
+ * @param       w   : 输出宽度
+ * @param       h   : 输出高度
+ * @retval      裁剪后的JPEG; NULL:未设置压缩域裁剪或裁剪失败, 按原图发送
+ */
+const uint8_t *roi_stream_crop(const camera_fb_t *fb, size_t *len, uint16_t *w, uint16_t *h)
+{
+#if ROI_STREAM_EN && ROI_STREAM_CROP_EN
+    jpg_crop_rect_t rect;
+    roi_rect_t roi;
+    size_t cap = fb->len + 2048;                                    /* 以标准霍夫曼表重新编码, 留出表头与码长差异 */
+
+    if (!roi_stream_crop_active() || fb->format != PIXFORMAT_JPEG)
+    {
+        return NULL;
+    }
+
+    roi_stream_get(&roi);
+
+    if (g_crop == NULL)
+    {
+        g_crop = heap_stats_malloc(HEAP_TAG_REQUANT, sizeof(jpg_crop_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+        if (g_crop == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    if (g_crop_cap < cap)
+    {
+        heap_stats_free(HEAP_TAG_REQUANT, g_crop_buf);
+        g_crop_buf = heap_stats_malloc(HEAP_TAG_REQUANT, cap, MALLOC_CAP_SPIRAM);
+        g_crop_cap = (g_crop_buf != NULL) ? cap : 0;
+
+        if (g_crop_buf == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    memset(&rect, 0, sizeof(rect));
+    rect.x = (uint16_t)((uint32_t)fb->width * roi.x / ROI_STREAM_FULL);
+    rect.y = (uint16_t)((uint32_t)fb->height * roi.y / ROI_STREAM_FULL);
+    rect.w = (uint16_t)((uint32_t)fb->width * roi.w / ROI_STREAM_FULL);
+    rect.h = (uint16_t)((uint32_t)fb->height * roi.h / ROI_STREAM_FULL);
+    rect.out = g_crop_buf;
+    rect.cap = g_crop_cap;
+
+    if (jpg_crop(g_crop, fb->buf, fb->len, ROI_STREAM_CROP_QUALITY, &rect, 1) != JPG_REQUANT_OK || rect.ret != JPG_REQUANT_OK)
+    {
+        return NULL;
+    }
+
+    *len = rect.len;
+    *w = rect.w;
+    *h = rect.h;
+    return g_crop_buf;
+#else
+    (void)fb;
+    (void)len;
+    (void)w;
+    (void)h;
+    return NULL;
+#endif
+}
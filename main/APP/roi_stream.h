@@ -0,0 +1,63 @@
+/**
+ ****************************************************************************************************
+ * @file        roi_stream.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       感兴趣区域(ROI)推流: 由传感器开窗裁剪并缩放到当前分辨率(数字变焦), 或在压缩域裁剪JPEG
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * ROI以全视场的千分比表示(x, y, w, h), 输出尺寸仍是码率控制当前的分辨率, ROI越小变焦倍数越大.
+ * ROI按输出宽高比向外扩展(不拉伸), 并且不小于输出尺寸(传感器只缩小不放大), 超出视场时平移回视场内.
+ * 经 sensor_t::set_res_raw 写入传感器窗口:
+ * OV2640          : 在 set_framesize 使用的读出模式(CIF/SVGA/UXGA)中开窗, 窗口小于输出尺寸时改用更高分辨率的读出模式;
+ * OV3660/OV5640   : 在4:3全幅读出范围内设置起止地址, 关闭binning, 帧高(VTS)随窗口高度减小, 小窗口帧率更高.
+ * 输出尺寸不超过初始化时的 frame_size, 原有帧缓存与DMA描述符足够存放, 不重新初始化摄像头驱动;
+ * 传感器只读出与压缩窗口内的像素, JPEG体积与DMA传输量随之减少.
+ * 寄存器写入由码率控制的配置线程执行(每次写入分辨率后恢复ROI), 与分辨率切换不会交错.
+ * 其他传感器(GC0308、BF3005等)输出JPEG时改为压缩域裁剪(ROI_STREAM_CROP_EN, jpg_crop): 发送线程对每帧做霍夫曼解码,
+ * 只把ROI内的块重新熵编码为一张JPEG, 不做IDCT/DCT. 输出为ROI的原始像素(按MCU向外对齐, 不缩放),
+ * 传感器仍采集整幅画面, 节省的是上行码率.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __ROI_STREAM_H
+#define __ROI_STREAM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+
+#define ROI_STREAM_EN               1                               /* 1:使能ROI推流 */
+#define ROI_STREAM_FULL             1000                            /* 全视场(千分比) */
+#define ROI_STREAM_MIN              50                              /* ROI宽高下限(千分比, 即最大20倍变焦) */
+#define ROI_STREAM_CROP_EN          1                               /* 1:传感器不支持开窗时在压缩域裁剪JPEG */
+#define ROI_STREAM_CROP_QUALITY     100                             /* 压缩域裁剪的输出质量, 100:沿用源量化表(系数不变) */
+
+/* 感兴趣区域(全视场的千分比) */
+typedef struct
+{
+    uint16_t x;                                                     /* 左上角 */
+    uint16_t y;
+    uint16_t w;                                                     /* 宽高 */
+    uint16_t h;
+} roi_rect_t;
+
+/* 函数声明 */
+esp_err_t roi_stream_set(const roi_rect_t *roi);                    /* 设置ROI(全视场即取消) */
+void roi_stream_get(roi_rect_t *roi);                               /* 读取当前ROI */
+int roi_stream_apply(sensor_t *s);                                  /* 把ROI写入传感器窗口(码率控制配置线程调用) */
+const uint8_t *roi_stream_crop(const camera_fb_t *fb, size_t *len, uint16_t *w, uint16_t *h);  /* 压缩域裁剪一帧(发送线程调用) */
+int roi_stream_crop_active(void);                                   /* 1:已设置压缩域裁剪的ROI */
+
+#endif
@@ -0,0 +1,728 @@
+/**
+ ****************************************************************************************************
+ * @file        rtp_jpeg.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       RTP/JPEG(RFC 2435)经UDP发送图像帧
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "rtp_jpeg.h"
+#include "jpg_requant.h"
+#include "img_converters.h"
+#include "heap_stats.h"
+#include "net_qos.h"
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_random.h"
+#include "esp_log.h"
+
+
+#define RTP_JPEG_MAX_DIM            2040                            /* JPEG头中宽高以8像素为单位, 占1字节 */
+#define RTP_JPEG_Q_DYNAMIC          255                             /* 量化表随帧发送且可能逐帧变化 */
+#define RTP_JPEG_TYPE_RESTART       64                              /* 带重启间隔时 type 加64 */
+#define RTP_JPEG_HDR_MAX            (12 + 8 + 4 + 4 + 2 * 128)      /* RTP头 + JPEG头 + 重启头 + 量化表头与两张表 */
+#define RTP_JPEG_RAW_HDR            (12 + 8)                        /* 原始帧边编码边发送时的RTP头 + JPEG头(不带量化表头) */
+
+/* 解析出的JPEG帧信息 */
+typedef struct
+{
+    uint8_t type;                                                   /* 0:YUV422; 1:YUV420 */
+    uint8_t width8;                                                 /* 宽度/8 */
+    uint8_t height8;                                                /* 高度/8 */
+    uint16_t dri;                                                   /* 重启间隔(0:无) */
+    const uint8_t *qt[2];                                           /* 亮度/色度量化表(zigzag顺序) */
+    uint8_t qt_len[2];                                              /* 64:8位精度; 128:16位精度 */
+    const uint8_t *scan;                                            /* 熵编码数据 */
+    size_t scan_len;
+} rtp_jpeg_info_t;
+
+/* 原始帧边编码边发送的上下文 */
+typedef struct
+{
+    int sock;
+    const rtp_jpeg_info_t *info;
+    uint8_t q;                                                      /* RFC 2435 Q因子, 接收端据此生成量化表 */
+    uint32_t ts;
+} rtp_jpeg_raw_t;
+
+static uint32_t g_rtp_ssrc = 0;
+static uint16_t g_rtp_seq = 0;
+static uint32_t g_rtp_bad_frames = 0;                               /* 无法按RFC 2435发送的帧数 */
+static uint8_t g_rtp_quality = RTP_JPEG_QUALITY;                    /* 转码质量, 0:发送原图 */
+static uint8_t *g_rtp_work = NULL;                                  /* 原始帧编码的扫描行与MCU行缓冲(内部RAM, 保留到下一帧) */
+static size_t g_rtp_work_size = 0;
+static uint8_t g_rtp_chunk[RTP_JPEG_PAYLOAD_MAX - RTP_JPEG_RAW_HDR]; /* 编码输出分片, 满一个即发送 */
+#if JPG_REQUANT_EN
+static jpg_requant_t *g_rtp_rq = NULL;                              /* 转码状态(内部RAM, 第一帧时分配) */
+static uint8_t *g_rtp_rq_buf = NULL;                                /* 转码输出缓冲(PSRAM) */
+#endif
+
+
+/**
+ * @brief       读取大端16位数
+ * @param       p : 数据
+ * @retval      数值
+ */
+static uint16_t rtp_jpeg_be16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/**
+ * @brief       解析JPEG标记段, 取得量化表、尺寸、采样格式与熵编码数据位置
+ * @param       buf  : JPEG数据
+ * @param       len  : 数据长度
+ * @param       info : 输出帧信息
+ * @retval      0:成功; -1:格式不支持或数据损坏
+ */
+static int rtp_jpeg_parse(const uint8_t *buf, size_t len, rtp_jpeg_info_t *info)
+{
+    size_t pos = 2;
+
+    memset(info, 0, sizeof(*info));
+
+    if (len < 4 || buf[0] != 0xFF || buf[1] != 0xD8)
+    {
+        return -1;
+    }
+
+    while (pos + 4 <= len)
+    {
+        uint8_t marker;
+        uint16_t seg_len;
+        const uint8_t *seg;
+
+        if (buf[pos] != 0xFF)
+        {
+            return -1;
+        }
+
+        marker = buf[pos + 1];
+
+        if (marker == 0xFF)                                         /* 填充字节 */
+        {
+            pos++;
+            continue;
+        }
+
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+        {
+            pos += 2;                                               /* 无长度字段的标记 */
+            continue;
+        }
+
+        seg_len = rtp_jpeg_be16(buf + pos + 2);
+        seg = buf + pos + 4;
+
+        if (seg_len < 2 || pos + 2 + seg_len > len)
+        {
+            return -1;
+        }
+
+        seg_len -= 2;
+
+        switch (marker)
+        {
+            case 0xDB:                                              /* DQT: 一个段中可有多张表 */
+                for (size_t off = 0; off < seg_len; )
+                {
+                    uint8_t pq = seg[off] >> 4;
+                    uint8_t tq = seg[off] & 0x0F;
+                    uint8_t n = pq ? 128 : 64;
+
+                    if (off + 1 + n > seg_len)
+                    {
+                        return -1;
+                    }
+
+                    if (tq < 2)
+                    {
+                        info->qt[tq] = seg + off + 1;
+                        info->qt_len[tq] = n;
+                    }
+
+                    off += 1 + n;
+                }
+                break;
+
+            case 0xC0:                                              /* SOF0: 只支持基线JPEG */
+            {
+                uint16_t height;
+                uint16_t width;
+
+                if (seg_len < 15)
+                {
+                    return -1;
+                }
+
+                height = rtp_jpeg_be16(seg + 1);
+                width = rtp_jpeg_be16(seg + 3);
+
+                if (seg[5] != 3 || seg[10] != 0x11 || seg[13] != 0x11 ||
+                    width == 0 || height == 0 || width > RTP_JPEG_MAX_DIM || height > RTP_JPEG_MAX_DIM)
+                {
+                    return -1;
+                }
+
+                if (seg[7] == 0x21)
+                {
+                    info->type = 0;
+                }
+                else if (seg[7] == 0x22)
+                {
+                    info->type = 1;
+                }
+                else
+                {
+                    return -1;
+                }
+
+                info->width8 = (uint8_t)((width + 7) / 8);
+                info->height8 = (uint8_t)((height + 7) / 8);
+                break;
+            }
+
+            case 0xC1: case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+            case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+                return -1;                                          /* 渐进/无损等RFC 2435不支持的编码 */
+
+            case 0xDD:                                              /* DRI */
+                info->dri = (seg_len >= 2) ? rtp_jpeg_be16(seg) : 0;
+                break;
+
+            case 0xDA:                                              /* SOS: 之后直到EOI都是熵编码数据 */
+                info->scan = seg + seg_len;
+                info->scan_len = len - (size_t)(info->scan - buf);
+
+                while (info->scan_len >= 2 && !(info->scan[info->scan_len - 2] == 0xFF && info->scan[info->scan_len - 1] == 0xD9))
+                {
+                    info->scan_len--;                               /* 去掉EOI之后的填充 */
+                }
+
+                if (info->scan_len >= 2)
+                {
+                    info->scan_len -= 2;                            /* 去掉EOI, 接收端自行补上 */
+                }
+
+                return (info->width8 != 0 && info->qt[0] != NULL && info->qt[1] != NULL && info->scan_len > 0) ? 0 : -1;
+
+            default:                                                /* APPn/DHT/COM等: 接收端使用标准Huffman表 */
+                break;
+        }
+
+        pos += 4 + seg_len;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief       创建连接到接收端的UDP套接字
+ * @param       ip   : 接收端IP地址(点分十进制)
+ * @param       port : 接收端端口号
+ * @retval      >=0:套接字; -1:失败
+ */
+int rtp_jpeg_open(const char *ip, uint16_t port)
+{
+    struct sockaddr_in addr;
+    int sock;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1)
+    {
+        return -1;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    if (sock < 0)
+    {
+        return -1;
+    }
+
+    if (IN_MULTICAST(ntohl(addr.sin_addr.s_addr)))                 /* 组播: 限制范围, 不回环给本机 */
+    {
+        uint8_t ttl = RTP_JPEG_MCAST_TTL;
+        uint8_t loop = 0;
+
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        ESP_LOGI("TAG", "RTP multicast to %s:%u, ttl %u", ip, port, ttl);
+    }
+
+    net_qos_set(sock, NET_QOS_RTP_DSCP);
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        closesocket(sock);
+        return -1;
+    }
+
+    if (g_rtp_ssrc == 0)
+    {
+        g_rtp_ssrc = esp_random();
+        g_rtp_seq = (uint16_t)esp_random();
+    }
+
+    return sock;
+}
+
+/**
+ * @brief       写RTP头、JPEG头与重启头(不含量化表头)
+ * @param       hdr    : 输出缓冲
+ * @param       info   : 帧信息(type、宽高与重启间隔)
+ * @param       q      : JPEG头的Q字段
+ * @param       ts     : RTP时间戳(90kHz)
+ * @param       offset : 分片在熵编码数据中的偏移
+ * @param       last   : 1:帧的最后一个分片(置Marker位)
+ * @retval      写入的字节数
+ */
+static size_t rtp_jpeg_write_hdr(uint8_t *hdr, const rtp_jpeg_info_t *info, uint8_t q, uint32_t ts, size_t offset, int last)
+{
+    size_t n = 0;
+
+    /* RTP头: V=2, M在最后一个分片置位 */
+    hdr[n++] = 0x80;
+    hdr[n++] = RTP_JPEG_PT | (last ? 0x80 : 0);
+    hdr[n++] = g_rtp_seq >> 8;
+    hdr[n++] = g_rtp_seq & 0xFF;
+    hdr[n++] = ts >> 24;
+    hdr[n++] = ts >> 16;
+    hdr[n++] = ts >> 8;
+    hdr[n++] = ts & 0xFF;
+    hdr[n++] = g_rtp_ssrc >> 24;
+    hdr[n++] = g_rtp_ssrc >> 16;
+    hdr[n++] = g_rtp_ssrc >> 8;
+    hdr[n++] = g_rtp_ssrc & 0xFF;
+
+    /* JPEG头: type-specific, 24位分片偏移, type, Q, 宽/8, 高/8 */
+    hdr[n++] = 0;
+    hdr[n++] = offset >> 16;
+    hdr[n++] = offset >> 8;
+    hdr[n++] = offset & 0xFF;
+    hdr[n++] = info->type + (info->dri ? RTP_JPEG_TYPE_RESTART : 0);
+    hdr[n++] = q;
+    hdr[n++] = info->width8;
+    hdr[n++] = info->height8;
+
+    if (info->dri)                                                  /* 重启头: 重启间隔与分片不对齐, F=L=1, count=0x3FFF */
+    {
+        hdr[n++] = info->dri >> 8;
+        hdr[n++] = info->dri & 0xFF;
+        hdr[n++] = 0xFF;
+        hdr[n++] = 0xFF;
+    }
+
+    return n;
+}
+
+/**
+ * @brief       发送一个RTP包(头与负载分开, 不拼接拷贝)
+ * @note        发送缓冲不足(ENOMEM)时稍后重试, 仍失败则放弃
+ * @param       sock    : 套接字
+ * @param       hdr     : RTP头 + JPEG头(及附加头)
+ * @param       hdr_len : 头长度
+ * @param       data    : 熵编码数据分片
+ * @param       len     : 分片长度
+ * @retval      0:发送成功; -1:发送失败
+ */
+static int rtp_jpeg_send_packet(int sock, const uint8_t *hdr, size_t hdr_len, const uint8_t *data, size_t len)
+{
+    struct iovec iov[2];
+    struct msghdr msg;
+
+    iov[0].iov_base = (void *)hdr;
+    iov[0].iov_len = hdr_len;
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    for (int i = 0; i <= RTP_JPEG_SEND_RETRY; i++)
+    {
+        if (sendmsg(sock, &msg, 0) >= 0)
+        {
+            return 0;
+        }
+
+        if (errno != ENOMEM && errno != EAGAIN)
+        {
+            return -1;
+        }
+
+        vTaskDelay(1);                                              /* Wi-Fi发送队列已满 */
+    }
+
+    return -1;
+}
+
+/**
+ * @brief       设置转码质量
+ * @note        在发送线程之外调用时, 最迟下一帧生效
+ * @param       quality : 1~100; 0:发送原图
+ * @retval      无
+ */
+void rtp_jpeg_set_quality(uint8_t quality)
+{
+    g_rtp_quality = (quality > 100) ? 100 : quality;
+}
+
+#if JPG_REQUANT_EN
+/**
+ * @brief       按 g_rtp_quality 在压缩域转码一帧
+ * @note        格式不支持、输出缓冲不足或内存不足时发送原图
+ * @param       fb  : 帧缓存
+ * @param       tmp : 转码结果(与 fb 相同的帧信息, 数据指向输出缓冲)
+ * @retval      要发送的帧(tmp 或 fb)
+ */
+static const camera_fb_t *rtp_jpeg_requant(const camera_fb_t *fb, camera_fb_t *tmp)
+{
+    uint8_t quality = g_rtp_quality;
+    size_t len = 0;
+
+    if (quality == 0 || fb->format != PIXFORMAT_JPEG)
+    {
+        return fb;
+    }
+
+    if (g_rtp_rq == NULL)
+    {
+        g_rtp_rq = heap_stats_malloc(HEAP_TAG_REQUANT, sizeof(jpg_requant_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        g_rtp_rq_buf = heap_stats_malloc(HEAP_TAG_REQUANT, RTP_JPEG_REQUANT_BUF_SIZE, MALLOC_CAP_SPIRAM);
+
+        if (g_rtp_rq == NULL || g_rtp_rq_buf == NULL)
+        {
+            ESP_LOGW("TAG", "no memory for requant, sending original frames");
+            heap_stats_free(HEAP_TAG_REQUANT, g_rtp_rq_buf);
+            heap_stats_free(HEAP_TAG_REQUANT, g_rtp_rq);
+            g_rtp_rq_buf = NULL;
+            g_rtp_rq = NULL;
+            g_rtp_quality = 0;
+            return fb;
+        }
+    }
+
+    if (jpg_requant(g_rtp_rq, fb->buf, fb->len, quality, g_rtp_rq_buf, RTP_JPEG_REQUANT_BUF_SIZE, &len) != JPG_REQUANT_OK ||
+        len >= fb->len)
+    {
+        return fb;                                                  /* 不支持或转码后不更小 */
+    }
+
+    *tmp = *fb;
+    tmp->buf = g_rtp_rq_buf;
+    tmp->len = len;
+    return tmp;
+}
+#endif
+
+/**
+ * @brief       原始帧编码输出的分片回调: 加上RTP/JPEG头后立即发送
+ * @param       arg   : rtp_jpeg_raw_t
+ * @param       index : 分片在熵编码数据中的偏移
+ * @param       data  : 分片数据
+ * @param       len   : 分片长度
+ * @param       last  : 帧的最后一个分片
+ * @retval      true:继续编码; false:发送失败, 放弃本帧
+ */
+static bool rtp_jpeg_raw_chunk(void *arg, size_t index, const uint8_t *data, size_t len, bool last)
+{
+    rtp_jpeg_raw_t *raw = (rtp_jpeg_raw_t *)arg;
+    uint8_t hdr[RTP_JPEG_RAW_HDR + 4];
+    size_t n = rtp_jpeg_write_hdr(hdr, raw->info, raw->q, raw->ts, index, last);
+
+    if (rtp_jpeg_send_packet(raw->sock, hdr, n, data, len) != 0)
+    {
+        return false;
+    }
+
+    g_rtp_seq++;
+    return true;
+}
+
+/**
+ * @brief       边编码边发送一帧原始图像(RGB565/RGB888/YUV422)
+ * @note        只编码熵编码数据(不写文件头), 每满一个分片即发送, 不缓存整帧JPEG; 量化表由Q因子
+ *              (RTP_JPEG_RAW_QUALITY)确定, 与编码器的量化表相同, 不发送量化表头. 双核编码时帧带重启标记,
+ *              间隔由 fmt2jpg_restart_interval() 预先得到
+ * @param       sock : 套接字
+ * @param       fb   : 原始格式的帧缓存
+ * @param       ts   : RTP时间戳(90kHz)
+ * @retval      0:发送成功; -1:格式不支持、内存不足或发送失败
+ */
+static int rtp_jpeg_send_raw(int sock, const camera_fb_t *fb, uint32_t ts)
+{
+    rtp_jpeg_info_t info;
+    rtp_jpeg_raw_t raw;
+    size_t work_size;
+
+    if ((fb->format != PIXFORMAT_RGB565 && fb->format != PIXFORMAT_RGB888 && fb->format != PIXFORMAT_YUV422) ||
+        fb->width == 0 || fb->height == 0 || fb->width > RTP_JPEG_MAX_DIM || fb->height > RTP_JPEG_MAX_DIM)
+    {
+        return -1;                                                  /* 灰度只有一个分量, RFC 2435 不支持 */
+    }
+
+    work_size = fmt2jpg_work_size(fb->width, fb->format);
+
+    if (work_size > g_rtp_work_size)                                /* 分辨率变大时重新分配 */
+    {
+        heap_stats_free(HEAP_TAG_RTP, g_rtp_work);
+        g_rtp_work = heap_stats_malloc(HEAP_TAG_RTP, work_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        g_rtp_work_size = (g_rtp_work != NULL) ? work_size : 0;
+
+        if (g_rtp_work == NULL)
+        {
+            return -1;
+        }
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.type = 1;                                                  /* 编码器的彩色输出为 4:2:0 */
+    info.width8 = (uint8_t)((fb->width + 7) / 8);
+    info.height8 = (uint8_t)((fb->height + 7) / 8);
+    info.dri = fmt2jpg_restart_interval(fb->width, fb->height, fb->format);
+
+    raw.sock = sock;
+    raw.info = &info;
+    raw.q = RTP_JPEG_RAW_QUALITY;
+    raw.ts = ts;
+
+    return fmt2jpg_chunks(fb->buf, fb->len, fb->width, fb->height, fb->format, RTP_JPEG_RAW_QUALITY, true,
+                          g_rtp_chunk, sizeof(g_rtp_chunk) - (info.dri ? 4 : 0), g_rtp_work, rtp_jpeg_raw_chunk, &raw) ? 0 : -1;
+}
+
+/**
+ * @brief       分片发送一帧JPEG
+ * @note        同步发送, 返回后帧缓存即可归还; 中途失败时放弃本帧剩余分片(接收端丢弃该帧).
+ *              原始格式的帧由 rtp_jpeg_send_raw() 边编码边发送
+ * @param       sock : rtp_jpeg_open 创建的套接字
+ * @param       fb   : JPEG格式的帧缓存
+ * @retval      0:发送成功; -1:格式不支持或发送失败
+ */
+int rtp_jpeg_send_frame(int sock, const camera_fb_t *fb)
+{
+    static uint8_t hdr[RTP_JPEG_HDR_MAX];
+    rtp_jpeg_info_t info;
+    uint32_t ts;
+    size_t offset = 0;
+#if JPG_REQUANT_EN
+    camera_fb_t tmp;
+
+    fb = rtp_jpeg_requant(fb, &tmp);
+#endif
+
+    /* 90kHz时钟, 来自帧的采集时间 */
+    ts = (uint32_t)(((uint64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec) * 9 / 100);
+
+    if (fb->format != PIXFORMAT_JPEG)
+    {
+        if (rtp_jpeg_send_raw(sock, fb, ts) == 0)
+        {
+            return 0;
+        }
+    }
+
+    if (fb->format != PIXFORMAT_JPEG || rtp_jpeg_parse(fb->buf, fb->len, &info) != 0)
+    {
+        if ((g_rtp_bad_frames++ % 100) == 0)
+        {
+            ESP_LOGW("TAG", "frame not sendable as RTP/JPEG (RFC 2435: baseline YUV422/420, <= %d px)", RTP_JPEG_MAX_DIM);
+        }
+
+        return -1;
+    }
+
+    while (offset < info.scan_len)
+    {
+        size_t n;
+        size_t chunk;
+        int last;
+
+        n = rtp_jpeg_write_hdr(hdr, &info, RTP_JPEG_Q_DYNAMIC, ts, offset, 0);
+
+        if (offset == 0)                                            /* 量化表头只在第一个分片 */
+        {
+            uint16_t qlen = info.qt_len[0] + info.qt_len[1];
+
+            hdr[n++] = 0;                                           /* MBZ */
+            hdr[n++] = ((info.qt_len[0] == 128) ? 0x01 : 0) | ((info.qt_len[1] == 128) ? 0x02 : 0);
+            hdr[n++] = qlen >> 8;
+            hdr[n++] = qlen & 0xFF;
+            memcpy(hdr + n, info.qt[0], info.qt_len[0]);
+            n += info.qt_len[0];
+            memcpy(hdr + n, info.qt[1], info.qt_len[1]);
+            n += info.qt_len[1];
+        }
+
+        chunk = RTP_JPEG_PAYLOAD_MAX - n;
+        chunk = (chunk > info.scan_len - offset) ? (info.scan_len - offset) : chunk;
+        last = (offset + chunk == info.scan_len);
+
+        if (last)
+        {
+            hdr[1] |= 0x80;
+        }
+
+        if (rtp_jpeg_send_packet(sock, hdr, n, info.scan + offset, chunk) != 0)
+        {
+            return -1;
+        }
+
+        g_rtp_seq++;
+        offset += chunk;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief       在Annex-B码流中查找下一个起始码(00 00 01 或 00 00 00 01)
+ * @param       p   : 查找起点
+ * @param       end : 码流末尾
+ * @param       sc  : 输出起始码长度(3或4), 找不到时为0
+ * @retval      起始码位置, 找不到时为 end
+ */
+static const uint8_t *rtp_h264_next_nal(const uint8_t *p, const uint8_t *end, size_t *sc)
+{
+    *sc = 0;
+
+    for (; p + 3 <= end; p++)
+    {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+        {
+            *sc = 3;
+            return p;
+        }
+
+        if (p + 4 <= end && p[0] == 0 && p[1] == 0 && p[2] == 0 && p[3] == 1)
+        {
+            *sc = 4;
+            return p;
+        }
+    }
+
+    return end;
+}
+
+/**
+ * @brief       分包发送一帧H.264码流(一个访问单元, Annex-B格式)
+ * @note        不超过 RTP_JPEG_PAYLOAD_MAX 的NAL单元单独成包, 更大的按FU-A分片; 同步发送, 返回后缓冲即可复用
+ * @param       sock : rtp_jpeg_open 创建的套接字
+ * @param       data : Annex-B码流
+ * @param       len  : 码流长度
+ * @param       ts   : RTP时间戳(90kHz)
+ * @retval      0:发送成功; -1:发送失败(放弃本帧剩余的包)
+ */
+int rtp_h264_send_au(int sock, const uint8_t *data, size_t len, uint32_t ts)
+{
+    uint8_t hdr[12 + 2];
+    const uint8_t *end = data + len;
+    const uint8_t *nal;
+    const uint8_t *next;
+    size_t sc;
+
+    if (g_rtp_ssrc == 0)
+    {
+        g_rtp_ssrc = esp_random();
+        g_rtp_seq = (uint16_t)esp_random();
+    }
+
+    nal = rtp_h264_next_nal(data, end, &sc);
+
+    while (nal < end)
+    {
+        size_t nal_len;
+        size_t offset = 1;
+        int last_nal;
+
+        nal += sc;
+        next = rtp_h264_next_nal(nal, end, &sc);
+        nal_len = (size_t)(next - nal);
+        last_nal = (next >= end);
+
+        while (nal_len > 0 && nal[nal_len - 1] == 0 && !last_nal)
+        {
+            nal_len--;                                              /* 4字节起始码前多出的0(trailing_zero) */
+        }
+
+        if (nal_len == 0)
+        {
+            nal = next;
+            continue;
+        }
+
+        /* RTP头: V=2, PT, 序号, 时间戳, SSRC; M在访问单元的最后一个包置位 */
+        hdr[0] = 0x80;
+        hdr[1] = RTP_H264_PT;
+        hdr[4] = ts >> 24;
+        hdr[5] = ts >> 16;
+        hdr[6] = ts >> 8;
+        hdr[7] = ts & 0xFF;
+        hdr[8] = g_rtp_ssrc >> 24;
+        hdr[9] = g_rtp_ssrc >> 16;
+        hdr[10] = g_rtp_ssrc >> 8;
+        hdr[11] = g_rtp_ssrc & 0xFF;
+
+        if (nal_len <= RTP_JPEG_PAYLOAD_MAX)                        /* 单NAL单元包 */
+        {
+            hdr[1] = RTP_H264_PT | (last_nal ? 0x80 : 0);
+            hdr[2] = g_rtp_seq >> 8;
+            hdr[3] = g_rtp_seq & 0xFF;
+
+            if (rtp_jpeg_send_packet(sock, hdr, 12, nal, nal_len) != 0)
+            {
+                return -1;
+            }
+
+            g_rtp_seq++;
+        }
+        else                                                        /* FU-A: FU indicator(F、NRI, 类型28) + FU header(S/E, 原类型) */
+        {
+            while (offset < nal_len)
+            {
+                size_t chunk = RTP_JPEG_PAYLOAD_MAX - 2;
+                int last;
+
+                chunk = (chunk > nal_len - offset) ? (nal_len - offset) : chunk;
+                last = (offset + chunk == nal_len);
+                hdr[1] = RTP_H264_PT | ((last && last_nal) ? 0x80 : 0);
+                hdr[2] = g_rtp_seq >> 8;
+                hdr[3] = g_rtp_seq & 0xFF;
+                hdr[12] = (nal[0] & 0xE0) | 28;
+                hdr[13] = (nal[0] & 0x1F) | ((offset == 1) ? 0x80 : 0) | (last ? 0x40 : 0);
+
+                if (rtp_jpeg_send_packet(sock, hdr, sizeof(hdr), nal + offset, chunk) != 0)
+                {
+                    return -1;
+                }
+
+                g_rtp_seq++;
+                offset += chunk;
+            }
+        }
+
+        nal = next;
+    }
+
+    return 0;
+}
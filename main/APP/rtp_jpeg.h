@@ -0,0 +1,65 @@
+/**
+ ****************************************************************************************************
+ * @file        rtp_jpeg.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       RTP/JPEG(RFC 2435)经UDP发送图像帧, 以及H.264(RFC 6184)码流的分包发送
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 每帧JPEG解析出量化表、图像尺寸与采样格式后, 只发送熵编码数据, 按 RTP_JPEG_PAYLOAD_MAX 分片,
+ * 每个分片带RTP头(PT=26, 90kHz时间戳)与JPEG头(分片偏移), 帧的最后一个分片置Marker位.
+ * Q=255, 量化表随每帧第一个分片发送(码率控制会动态修改JPEG质量). 接收端按RFC 2435使用标准Huffman表
+ * 重建JPEG头, 摄像头输出的即为标准表. 宽高须不超过2040, 仅支持YUV422/YUV420.
+ * 丢失任何一个分片只影响该帧, 接收端丢弃不完整的帧, 不会阻塞后续帧.
+ * RTP_JPEG_QUALITY(或 rtp_jpeg_set_quality)不为0时, 每帧先用 jpg_requant 在压缩域降低质量再分片, 用于上行受限的链路;
+ * 转码输出即为标准霍夫曼表且不带重同步标记, 与RFC 2435接收端重建的文件头一致.
+ * 原始格式的帧(RGB565/RGB888/YUV422)边编码边发送: fmt2jpg_chunks() 只输出熵编码数据, 每满一个分片(RTP_JPEG_PAYLOAD_MAX
+ * 减去头长)即发送, 不等整帧编码完成, 也不缓存整帧JPEG; Q=RTP_JPEG_RAW_QUALITY, 接收端按RFC 2435由Q生成的量化表与编码器相同,
+ * 不发送量化表头. TCP帧协议的帧头需要先给出负载长度, 仍按整帧编码后发送.
+ *
+ * 接收示例:
+ *   gst-launch-1.0 udpsrc port=5004 caps="application/x-rtp,media=video,encoding-name=JPEG,clock-rate=90000,payload=26" ! rtpjpegdepay ! jpegdec ! autovideosink
+ *   ffplay -protocol_whitelist file,udp,rtp camera.sdp    (m=video 5004 RTP/AVP 26)
+ * 目的地址为组播地址(224.0.0.0/4)时每帧只发送一次, 任意数量的接收端加入该组即可观看:
+ *   gst-launch-1.0 udpsrc address=239.255.0.1 port=5004 auto-multicast=true caps="..." ! rtpjpegdepay ! jpegdec ! autovideosink
+ *   (SDP中写 c=IN IP4 239.255.0.1/1). 发送端无需加入组, IGMP成员关系由接收端主机维护, 交换机据此转发
+ * rtp_h264_send_au() 供 h264_stream 使用: 同一套接字、SSRC与序号, PT=RTP_H264_PT; 不超过 RTP_JPEG_PAYLOAD_MAX 的
+ * NAL单元单独成包, 更大的按FU-A分片, 一帧(访问单元)的最后一个包置Marker位.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __RTP_JPEG_H
+#define __RTP_JPEG_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+
+#define RTP_JPEG_PORT               5004                            /* 接收端UDP端口(RTP惯用端口) */
+#define RTP_JPEG_PAYLOAD_MAX        1400                            /* 每个UDP包的RTP负载上限(含JPEG头), 不超过MTU避免IP分片 */
+#define RTP_JPEG_PT                 26                              /* RTP静态负载类型: JPEG */
+#define RTP_JPEG_SEND_RETRY         20                              /* 发送缓冲不足时的重试次数(每次等待1个tick) */
+#define RTP_JPEG_MCAST_TTL          1                               /* 组播TTL, 1:不出本网段 */
+#define RTP_JPEG_QUALITY            0                               /* >0:先在压缩域转码到该质量(1~100, 见 jpg_requant.h)再发送 */
+#define RTP_JPEG_REQUANT_BUF_SIZE   (96 * 1024)                     /* 转码输出缓冲(PSRAM), 不足时发送原图 */
+#define RTP_JPEG_RAW_QUALITY        60                              /* 原始格式帧边编码边发送的JPEG质量(1~99, 即RFC 2435的Q因子) */
+#define RTP_H264_PT                 96                              /* RTP动态负载类型: H.264(SDP中 a=rtpmap:96 H264/90000) */
+
+/* 函数声明 */
+int rtp_jpeg_open(const char *ip, uint16_t port);                   /* 创建连接到接收端(单播或组播地址)的UDP套接字 */
+int rtp_jpeg_send_frame(int sock, const camera_fb_t *fb);           /* 分片发送一帧JPEG(原始格式的帧边编码边发送) */
+void rtp_jpeg_set_quality(uint8_t quality);                         /* 设置转码质量(0:发送原图) */
+int rtp_h264_send_au(int sock, const uint8_t *data, size_t len, uint32_t ts);   /* 分包发送一帧Annex-B码流 */
+
+#endif
@@ -0,0 +1,1153 @@
+/**
+ ****************************************************************************************************
+ * @file        sd_recorder.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       SD卡连续录像(分段MJPEG/AVI文件, 含麦克风音频)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "sd_recorder.h"
+#include "task_topo.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "heap_stats.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_vfs_fat.h"
+#include "sdmmc_cmd.h"
+#include "my_spi.h"
+
+
+#define SD_AVI_HEADER_LEN           512                             /* AVI头(含JUNK填充)长度, 帧数据从扇区边界开始 */
+#define SD_AVI_MOVI_OFFSET          508                             /* 'movi'四字符码在文件中的位置, idx1偏移以此为基准 */
+#define SD_SECTOR_SIZE              512
+#define SD_AVI_STREAMS              (SD_RECORD_AUDIO_EN ? 2 : 1)
+#define SD_AVI_HDRL_LEN             (192 + (SD_RECORD_AUDIO_EN ? 102 : 0))  /* 'hdrl'列表长度(含音频流的strl) */
+#define SD_AUDIO_GAP_US             30000                           /* 音频块早于/晚于预期超过该值时补静音或截去重叠部分 */
+
+/* 环形缓冲中的一帧或一段音频(描述符), 数据在 g_rec_ring 中从 offset 开始, 可能跨越缓冲末尾 */
+typedef struct
+{
+    int64_t timestamp_us;
+    uint32_t offset;
+    uint32_t len;
+    uint16_t width;                                                 /* 视频: 图像宽高; 音频: 采样率与声道数 */
+    uint16_t height;
+    uint8_t audio;                                                  /* 1:PCM音频块 */
+} sd_rec_item_t;
+
+/* 索引项 */
+typedef struct
+{
+    uint32_t offset;                                                /* 相对 'movi' 的偏移 */
+    uint32_t size;
+    uint8_t audio;
+} sd_avi_index_t;
+
+/* 正在写的分段文件 */
+typedef struct
+{
+    FILE *f;
+    char path[32];
+    uint32_t pos;                                                   /* 文件逻辑长度(含批量缓冲中未写出的部分) */
+    uint32_t frames;
+    uint32_t chunks;                                                /* 索引项数(帧 + 音频块) */
+    uint32_t max_len;                                               /* 最大帧长 */
+    uint16_t width;
+    uint16_t height;
+    int64_t first_us;
+    int64_t last_us;
+    uint16_t audio_rate;                                            /* 0:尚无音频 */
+    uint8_t audio_channels;
+    uint32_t audio_start;                                           /* 音频流起点(相对第一帧的采样数) */
+    uint32_t audio_bytes;
+    uint32_t audio_max_len;
+    int64_t audio_next_us;                                          /* 下一个采样点按已写采样数推算的时间 */
+    sd_avi_index_t *index;                                          /* SD_RECORD_SEGMENT_CHUNKS 项, 位于PSRAM */
+} sd_segment_t;
+
+static SemaphoreHandle_t g_rec_lock = NULL;                         /* 保护环形缓冲与片段时间窗 */
+static uint8_t *g_rec_ring = NULL;                                  /* 帧数据环形缓冲(PSRAM), 按字节预算而非帧数 */
+static uint32_t g_rec_ring_head = 0;                                /* 下一帧数据的写入位置 */
+static uint32_t g_rec_ring_used = 0;
+static sd_rec_item_t g_rec_items[SD_RECORD_ITEM_MAX];               /* 帧描述符(先进先出) */
+static uint16_t g_rec_item_first = 0;
+static uint16_t g_rec_item_count = 0;
+static uint8_t g_rec_item_busy = 0;                                 /* 1:最旧的帧正在写卡, 不可覆盖 */
+static TaskHandle_t g_rec_task = NULL;
+static int64_t g_rec_clip_from = 0;                                 /* 事件模式: 当前片段的起止时间, 0:无片段 */
+static int64_t g_rec_clip_until = 0;
+static uint8_t *g_rec_batch = NULL;                                 /* 批量写缓冲(内部DMA内存) */
+static uint32_t g_rec_batch_len = 0;
+static uint8_t g_rec_hdr[SD_AVI_HEADER_LEN] __attribute__((aligned(4)));
+static sd_segment_t g_rec_seg;
+static sdmmc_card_t *g_rec_card = NULL;
+static volatile uint8_t g_rec_running = 0;
+static volatile uint32_t g_rec_dropped = 0;                         /* 环形缓冲满而丢弃的帧数 */
+static uint32_t g_rec_first = 0;                                    /* 卡上最旧的录像序号 */
+static uint32_t g_rec_next = 0;                                     /* 下一个录像序号 */
+static EventGroupHandle_t g_rec_event = NULL;
+static EventBits_t g_rec_active_bit = 0;
+static bool g_rec_bus_prio = false;                                 /* 已请求SD卡优先占用总线 */
+
+
+/**
+ * @brief       小端写入
+ */
+static uint8_t *sd_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+static uint8_t *sd_put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *sd_putfcc(uint8_t *p, const char *fcc)
+{
+    memcpy(p, fcc, 4);
+    return p + 4;
+}
+
+/**
+ * @brief       生成AVI头(RIFF/hdrl/JUNK/movi列表头), 共 SD_AVI_HEADER_LEN 字节
+ * @param       hdr : 输出缓冲
+ * @param       seg : 分段(帧数为0时生成占位头, 关闭分段时以实际值重写)
+ * @retval      无
+ */
+static void sd_avi_header(uint8_t *hdr, const sd_segment_t *seg)
+{
+    uint32_t us_per_frame = 0;
+    uint32_t movi_len = seg->pos - SD_AVI_MOVI_OFFSET;
+    uint16_t align = (uint16_t)((seg->audio_channels ? seg->audio_channels : 1) * sizeof(int16_t));
+    uint32_t rate = seg->audio_rate ? seg->audio_rate : 8000;      /* 分段中没有音频时的占位格式(长度为0) */
+    uint8_t *p = hdr;
+
+    if (seg->frames > 1)
+    {
+        us_per_frame = (uint32_t)((seg->last_us - seg->first_us) / (seg->frames - 1));
+    }
+
+    if (us_per_frame == 0)
+    {
+        us_per_frame = 33333;
+    }
+
+    if (seg->frames == 0)
+    {
+        movi_len = 4;
+    }
+
+    memset(hdr, 0, SD_AVI_HEADER_LEN);
+
+    p = sd_putfcc(p, "RIFF");
+    p = sd_put32(p, (seg->frames == 0) ? 0 : (seg->pos + 8 + seg->chunks * 16 - 8));
+    p = sd_putfcc(p, "AVI ");
+
+    p = sd_putfcc(p, "LIST");
+    p = sd_put32(p, SD_AVI_HDRL_LEN);
+    p = sd_putfcc(p, "hdrl");
+
+    p = sd_putfcc(p, "avih");                                       /* MainAVIHeader */
+    p = sd_put32(p, 56);
+    p = sd_put32(p, us_per_frame);
+    p = sd_put32(p, (uint32_t)((uint64_t)seg->max_len * 1000000 / us_per_frame) + (SD_RECORD_AUDIO_EN ? rate * align : 0));
+    p = sd_put32(p, 0);
+    p = sd_put32(p, 0x10);                                          /* AVIF_HASINDEX */
+    p = sd_put32(p, seg->frames);
+    p = sd_put32(p, 0);
+    p = sd_put32(p, SD_AVI_STREAMS);
+    p = sd_put32(p, seg->max_len);
+    p = sd_put32(p, seg->width);
+    p = sd_put32(p, seg->height);
+    p += 16;
+
+    p = sd_putfcc(p, "LIST");
+    p = sd_put32(p, 116);
+    p = sd_putfcc(p, "strl");
+
+    p = sd_putfcc(p, "strh");                                       /* AVIStreamHeader */
+    p = sd_put32(p, 56);
+    p = sd_putfcc(p, "vids");
+    p = sd_putfcc(p, "MJPG");
+    p = sd_put32(p, 0);
+    p = sd_put32(p, 0);
+    p = sd_put32(p, 0);
+    p = sd_put32(p, us_per_frame);                                  /* dwScale / dwRate = 每帧秒数 */
+    p = sd_put32(p, 1000000);
+    p = sd_put32(p, 0);
+    p = sd_put32(p, seg->frames);
+    p = sd_put32(p, seg->max_len);
+    p = sd_put32(p, 0xFFFFFFFF);
+    p = sd_put32(p, 0);
+    p = sd_put16(p, 0);
+    p = sd_put16(p, 0);
+    p = sd_put16(p, seg->width);
+    p = sd_put16(p, seg->height);
+
+    p = sd_putfcc(p, "strf");                                       /* BITMAPINFOHEADER */
+    p = sd_put32(p, 40);
+    p = sd_put32(p, 40);
+    p = sd_put32(p, seg->width);
+    p = sd_put32(p, seg->height);
+    p = sd_put16(p, 1);
+    p = sd_put16(p, 24);
+    p = sd_putfcc(p, "MJPG");
+    p = sd_put32(p, (uint32_t)seg->width * seg->height * 3);
+    p += 16;
+
+#if SD_RECORD_AUDIO_EN
+    p = sd_putfcc(p, "LIST");
+    p = sd_put32(p, 94);
+    p = sd_putfcc(p, "strl");
+
+    p = sd_putfcc(p, "strh");                                       /* AVIStreamHeader, 时间单位为采样点 */
+    p = sd_put32(p, 56);
+    p = sd_putfcc(p, "auds");
+    p = sd_put32(p, 0);
+    p = sd_put32(p, 0);
+    p = sd_put32(p, 0);
+    p = sd_put32(p, 0);
+    p = sd_put32(p, align);                                         /* dwScale / dwRate = 每采样点秒数 */
+    p = sd_put32(p, rate * align);
+    p = sd_put32(p, seg->audio_start);                              /* 相对第一帧的起点, 音画对齐 */
+    p = sd_put32(p, seg->audio_bytes / align);
+    p = sd_put32(p, seg->audio_max_len);
+    p = sd_put32(p, 0xFFFFFFFF);
+    p = sd_put32(p, align);
+    p += 8;
+
+    p = sd_putfcc(p, "strf");                                       /* WAVEFORMATEX, 16位PCM */
+    p = sd_put32(p, 18);
+    p = sd_put16(p, 1);
+    p = sd_put16(p, (uint16_t)(align / sizeof(int16_t)));
+    p = sd_put32(p, rate);
+    p = sd_put32(p, rate * align);
+    p = sd_put16(p, align);
+    p = sd_put16(p, 16);
+    p = sd_put16(p, 0);
+#endif
+
+    p = sd_putfcc(p, "JUNK");                                       /* 填充到 SD_AVI_MOVI_OFFSET - 8 */
+    p = sd_put32(p, (uint32_t)(SD_AVI_MOVI_OFFSET - 8 - (p + 4 - hdr)));
+    p = hdr + SD_AVI_MOVI_OFFSET - 8;
+
+    p = sd_putfcc(p, "LIST");
+    p = sd_put32(p, movi_len);
+    sd_putfcc(p, "movi");
+}
+
+/**
+ * @brief       写出批量缓冲
+ * @param       whole : 1:只写出整扇区部分(余下的移到缓冲开头, 保持后续写入扇区对齐); 0:全部写出
+ * @retval      ESP_OK:成功; ESP_FAIL:写卡失败
+ */
+static esp_err_t sd_rec_flush(uint8_t whole)
+{
+    uint32_t len = whole ? (g_rec_batch_len & ~(SD_SECTOR_SIZE - 1)) : g_rec_batch_len;
+    int64_t start;
+    size_t written;
+
+    if (len == 0)
+    {
+        return ESP_OK;
+    }
+
+    start = esp_timer_get_time();
+    written = fwrite(g_rec_batch, 1, len, g_rec_seg.f);
+
+    my_spi_account(MY_SPI_DEV_SD, (uint32_t)written, (uint32_t)(esp_timer_get_time() - start));
+
+    if (written != len)
+    {
+        return ESP_FAIL;
+    }
+
+    g_rec_batch_len -= len;
+    memmove(g_rec_batch, g_rec_batch + len, g_rec_batch_len);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       追加数据到当前分段, 批量缓冲满时写卡
+ * @param       data : 数据
+ * @param       len  : 长度
+ * @retval      ESP_OK:成功; ESP_FAIL:写卡失败
+ */
+static esp_err_t sd_rec_put(const void *data, uint32_t len)
+{
+    const uint8_t *src = (const uint8_t *)data;
+    uint32_t n;
+
+    g_rec_seg.pos += len;
+
+    while (len > 0)
+    {
+        n = SD_RECORD_BATCH_SIZE - g_rec_batch_len;
+        n = (n < len) ? n : len;
+        memcpy(g_rec_batch + g_rec_batch_len, src, n);
+        g_rec_batch_len += n;
+        src += n;
+        len -= n;
+
+        if (g_rec_batch_len == SD_RECORD_BATCH_SIZE && sd_rec_flush(0) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       录像文件路径
+ */
+static void sd_rec_path(char *path, size_t size, uint32_t index)
+{
+    snprintf(path, size, SD_RECORD_MOUNT "/REC%05u.AVI", (unsigned)index);
+}
+
+/**
+ * @brief       扫描卡上已有的录像, 确定最旧与下一个序号
+ * @param       无
+ * @retval      无
+ */
+static void sd_rec_scan(void)
+{
+    DIR *dir = opendir(SD_RECORD_MOUNT);
+    struct dirent *ent;
+    unsigned int index;
+    uint8_t found = 0;
+
+    g_rec_first = 0;
+    g_rec_next = 0;
+
+    if (dir == NULL)
+    {
+        return;
+    }
+
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (sscanf(ent->d_name, "REC%5u.AVI", &index) != 1)
+        {
+            continue;
+        }
+
+        if (!found || index < g_rec_first)
+        {
+            g_rec_first = index;
+        }
+
+        if (!found || index + 1 > g_rec_next)
+        {
+            g_rec_next = index + 1;
+        }
+
+        found = 1;
+    }
+
+    closedir(dir);
+}
+
+/**
+ * @brief       保证剩余空间足够一个分段, 不足时依次删除最旧的录像
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:已无可删除的录像
+ */
+static esp_err_t sd_rec_make_room(void)
+{
+    uint64_t total = 0;
+    uint64_t free_bytes = 0;
+    char path[32];
+
+    while (esp_vfs_fat_info(SD_RECORD_MOUNT, &total, &free_bytes) == ESP_OK &&
+           free_bytes < (uint64_t)SD_RECORD_SEGMENT_BYTES + SD_RECORD_BATCH_SIZE)
+    {
+        if (g_rec_first >= g_rec_next)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+
+        sd_rec_path(path, sizeof(path), g_rec_first++);
+
+        if (unlink(path) == 0)
+        {
+            ESP_LOGI("TAG", "card full, removed %s", path);
+        }
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       新建分段文件: 预分配连续簇并写入占位AVI头
+ * @param       width  : 图像宽度
+ * @param       height : 图像高度
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+static esp_err_t sd_segment_open(uint16_t width, uint16_t height)
+{
+    sd_segment_t *seg = &g_rec_seg;
+
+    if (sd_rec_make_room() != ESP_OK)
+    {
+        ESP_LOGE("TAG", "sd card full");
+        return ESP_ERR_NO_MEM;
+    }
+
+    sd_rec_path(seg->path, sizeof(seg->path), g_rec_next++);
+
+    /* 预分配后以"r+b"打开(不截断), 写入已分配的簇; 卡上碎片过多无法预分配时退回普通追加写 */
+    if (esp_vfs_fat_create_contiguous_file(SD_RECORD_MOUNT, seg->path, SD_RECORD_SEGMENT_BYTES, true) == ESP_OK)
+    {
+        seg->f = fopen(seg->path, "r+b");
+    }
+    else
+    {
+        ESP_LOGW("TAG", "%s not preallocated", seg->path);
+        seg->f = fopen(seg->path, "wb");
+    }
+
+    if (seg->f == NULL)
+    {
+        return ESP_FAIL;
+    }
+
+    setvbuf(seg->f, NULL, _IONBF, 0);                               /* 已有批量缓冲, 不需要stdio缓冲 */
+
+    seg->pos = 0;
+    seg->frames = 0;
+    seg->chunks = 0;
+    seg->max_len = 0;
+    seg->audio_rate = 0;
+    seg->audio_channels = 0;
+    seg->audio_start = 0;
+    seg->audio_bytes = 0;
+    seg->audio_max_len = 0;
+    seg->width = width;
+    seg->height = height;
+    g_rec_batch_len = 0;
+
+    sd_avi_header(g_rec_hdr, seg);
+    return sd_rec_put(g_rec_hdr, SD_AVI_HEADER_LEN);
+}
+
+/**
+ * @brief       关闭分段文件: 写索引, 截断到实际长度, 以实际帧数与帧率重写AVI头
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_FAIL:写卡失败
+ */
+static esp_err_t sd_segment_close(void)
+{
+    sd_segment_t *seg = &g_rec_seg;
+    uint8_t entry[16];
+    esp_err_t err = ESP_OK;
+
+    sd_putfcc(entry, "idx1");
+    sd_put32(entry + 4, seg->chunks * 16);
+    err = sd_rec_put(entry, 8);
+
+    for (uint32_t i = 0; i < seg->chunks && err == ESP_OK; i++)
+    {
+        sd_putfcc(entry, seg->index[i].audio ? "01wb" : "00dc");
+        sd_put32(entry + 4, 0x10);                                  /* AVIIF_KEYFRAME */
+        sd_put32(entry + 8, seg->index[i].offset);
+        sd_put32(entry + 12, seg->index[i].size);
+        err = sd_rec_put(entry, 16);
+    }
+
+    /* 索引已计入 pos, 头中的RIFF长度按不含索引的movi末尾计算 */
+    seg->pos -= 8 + seg->chunks * 16;
+
+    if (err == ESP_OK)
+    {
+        err = sd_rec_flush(0);
+    }
+
+    if (err == ESP_OK && ftruncate(fileno(seg->f), seg->pos + 8 + seg->chunks * 16) != 0)
+    {
+        err = ESP_FAIL;
+    }
+
+    if (err == ESP_OK)
+    {
+        sd_avi_header(g_rec_hdr, seg);
+
+        if (fseek(seg->f, 0, SEEK_SET) != 0 || fwrite(g_rec_hdr, 1, SD_AVI_HEADER_LEN, seg->f) != SD_AVI_HEADER_LEN)
+        {
+            err = ESP_FAIL;
+        }
+    }
+
+    fsync(fileno(seg->f));
+    fclose(seg->f);
+    seg->f = NULL;
+
+    ESP_LOGI("TAG", "%s: %u frames, %u ms, %u ms audio, %u dropped", seg->path, (unsigned)seg->frames,
+             (unsigned)((seg->last_us - seg->first_us) / 1000),
+             (unsigned)(seg->audio_rate ? (uint64_t)seg->audio_bytes * 1000 / (seg->audio_rate * seg->audio_channels * 2) : 0),
+             (unsigned)g_rec_dropped);
+
+    return err;
+}
+
+/**
+ * @brief       把环形缓冲中的一段数据追加到当前分段(可能跨越缓冲末尾, 分两段写入)
+ * @param       offset : 在 g_rec_ring 中的起点(可大于缓冲长度)
+ * @param       len    : 长度
+ * @retval      ESP_OK:成功; ESP_FAIL:写卡失败
+ */
+static esp_err_t sd_rec_put_ring(uint32_t offset, uint32_t len)
+{
+    uint32_t first;
+    esp_err_t err;
+
+    offset %= SD_RECORD_RING_SIZE;
+    first = SD_RECORD_RING_SIZE - offset;
+    first = (first < len) ? first : len;
+    err = sd_rec_put(g_rec_ring + offset, first);
+
+    if (err == ESP_OK && first < len)
+    {
+        err = sd_rec_put(g_rec_ring, len - first);
+    }
+
+    return err;
+}
+
+/**
+ * @brief       写入一个块头并登记索引项
+ * @param       fcc   : 块类型('00dc'/'01wb')
+ * @param       len   : 块数据长度
+ * @retval      ESP_OK:成功; ESP_FAIL:写卡失败
+ */
+static esp_err_t sd_chunk_begin(const char *fcc, uint32_t len)
+{
+    sd_segment_t *seg = &g_rec_seg;
+    uint8_t chunk[8];
+
+    seg->index[seg->chunks].offset = seg->pos - SD_AVI_MOVI_OFFSET;
+    seg->index[seg->chunks].size = len;
+    seg->index[seg->chunks].audio = (fcc[3] == 'b');
+    seg->chunks++;
+
+    sd_putfcc(chunk, fcc);
+    sd_put32(chunk + 4, len);
+    return sd_rec_put(chunk, sizeof(chunk));
+}
+
+/**
+ * @brief       把一段音频写入当前分段(无分段时丢弃: 分段总以视频帧开始)
+ * @note        第一块早于分段第一帧时截去前面的采样, 晚于时记为音频流起点(dwStart);
+ *              之后按已写采样数推算下一块的时间, 缺口(缓冲溢出丢块)补静音, 重叠截去, 音频不随丢块漂移
+ * @param       item : 音频块
+ * @retval      ESP_OK:成功; ESP_FAIL:写卡失败
+ */
+static esp_err_t sd_segment_write_audio(const sd_rec_item_t *item)
+{
+    static const uint8_t silence[SD_SECTOR_SIZE];
+    sd_segment_t *seg = &g_rec_seg;
+    uint32_t align = (uint32_t)item->height * sizeof(int16_t);
+    int64_t late_us;
+    int64_t samples;
+    uint32_t skip = 0;
+    uint32_t pad = 0;
+    uint32_t n;
+    esp_err_t err;
+
+    if (seg->f == NULL)
+    {
+        return ESP_OK;
+    }
+
+    if (seg->audio_rate == 0)
+    {
+        late_us = item->timestamp_us - seg->first_us;
+
+        if (late_us < 0)
+        {
+            skip = (uint32_t)((-late_us * item->width + 999999) / 1000000) * align;
+        }
+
+        if (skip >= item->len)
+        {
+            return ESP_OK;                                          /* 整块早于分段第一帧 */
+        }
+
+        seg->audio_rate = item->width;
+        seg->audio_channels = (uint8_t)item->height;
+        seg->audio_start = (late_us > 0) ? (uint32_t)(late_us * item->width / 1000000) : 0;
+    }
+    else if (item->width != seg->audio_rate || item->height != seg->audio_channels)
+    {
+        return ESP_OK;                                              /* 格式在分段中途改变: 下一分段再录 */
+    }
+    else
+    {
+        late_us = item->timestamp_us - seg->audio_next_us;
+        samples = ((late_us < 0) ? -late_us : late_us) * item->width / 1000000;
+
+        if (late_us > SD_AUDIO_GAP_US)
+        {
+            pad = (uint32_t)samples * align;
+        }
+        else if (late_us < -SD_AUDIO_GAP_US)
+        {
+            skip = (uint32_t)samples * align;
+        }
+
+        if (skip >= item->len)
+        {
+            return ESP_OK;
+        }
+    }
+
+    if (seg->chunks >= SD_RECORD_SEGMENT_CHUNKS ||
+        seg->pos + 8 + pad + item->len + 8 + (uint64_t)(seg->chunks + 1) * 16 > SD_RECORD_SEGMENT_BYTES)
+    {
+        return ESP_OK;                                              /* 分段已满, 下一帧换新分段 */
+    }
+
+    n = pad + item->len - skip;                                     /* 16位采样, 块长总为偶数 */
+    err = sd_chunk_begin("01wb", n);
+
+    while (err == ESP_OK && pad > 0)
+    {
+        err = sd_rec_put(silence, (pad < sizeof(silence)) ? pad : sizeof(silence));
+        pad -= (pad < sizeof(silence)) ? pad : sizeof(silence);
+    }
+
+    if (err == ESP_OK)
+    {
+        err = sd_rec_put_ring(item->offset + skip, item->len - skip);
+    }
+
+    seg->audio_bytes += n;
+    seg->audio_max_len = (n > seg->audio_max_len) ? n : seg->audio_max_len;
+    seg->audio_next_us = item->timestamp_us + (int64_t)(item->len / align) * 1000000 / item->width;
+
+    return err;
+}
+
+/**
+ * @brief       把一帧写入当前分段(需时先换新分段)
+ * @param       item : 帧
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+static esp_err_t sd_segment_write(const sd_rec_item_t *item)
+{
+    sd_segment_t *seg = &g_rec_seg;
+    uint8_t pad = 0;
+    uint64_t need = 8 + item->len + 1 + 8 + (uint64_t)(seg->chunks + 1) * 16;
+    esp_err_t err;
+
+    if (item->audio)
+    {
+        return sd_segment_write_audio(item);
+    }
+
+    if (seg->f != NULL &&
+        (seg->chunks >= SD_RECORD_SEGMENT_CHUNKS || seg->pos + need > SD_RECORD_SEGMENT_BYTES ||
+         item->timestamp_us - seg->first_us >= (int64_t)SD_RECORD_SEGMENT_SEC * 1000000 ||
+         item->width != seg->width || item->height != seg->height))
+    {
+        err = sd_segment_close();
+
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+
+    if (seg->f == NULL)
+    {
+        err = sd_segment_open(item->width, item->height);
+
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+
+        seg->first_us = item->timestamp_us;
+    }
+
+    err = sd_chunk_begin("00dc", item->len);
+
+    if (err == ESP_OK)
+    {
+        err = sd_rec_put_ring(item->offset, item->len);
+    }
+
+    if (err == ESP_OK && (item->len & 1))                           /* RIFF块按偶数字节对齐 */
+    {
+        err = sd_rec_put(&pad, 1);
+    }
+
+    seg->frames++;
+    seg->last_us = item->timestamp_us;
+    seg->max_len = (item->len > seg->max_len) ? item->len : seg->max_len;
+
+    return err;
+}
+
+/**
+ * @brief       按待写积压请求/取消SD卡优先占用SPI总线(调用者持有 g_rec_lock)
+ * @note        事件模式下无片段时缓冲中的帧是事件前录像, 不算积压
+ * @param       无
+ * @retval      无
+ */
+static void sd_rec_bus_update(void)
+{
+    uint32_t backlog = (!SD_RECORD_EVENT_EN || g_rec_clip_until != 0) ? g_rec_ring_used : 0;
+    uint32_t on = (uint32_t)((uint64_t)SD_RECORD_RING_SIZE * SD_RECORD_BUS_PRIO_PCT / 100);
+
+    if (!g_rec_bus_prio && backlog >= on)
+    {
+        g_rec_bus_prio = true;
+        my_spi_sd_priority(true);
+    }
+    else if (g_rec_bus_prio && backlog < on / 2)
+    {
+        g_rec_bus_prio = false;
+        my_spi_sd_priority(false);
+    }
+}
+
+/**
+ * @brief       取最旧的一帧(标记为写卡中, 不会被新帧覆盖)
+ * @param       item : 输出帧描述符
+ * @retval      true:成功; false:缓冲为空
+ */
+static bool sd_ring_peek(sd_rec_item_t *item)
+{
+    bool ok = false;
+
+    xSemaphoreTake(g_rec_lock, portMAX_DELAY);
+
+    if (g_rec_item_count > 0)
+    {
+        *item = g_rec_items[g_rec_item_first];
+        g_rec_item_busy = 1;
+        ok = true;
+    }
+
+    xSemaphoreGive(g_rec_lock);
+    return ok;
+}
+
+/**
+ * @brief       丢弃最旧的一帧(写卡完成或不需要)
+ * @param       无
+ * @retval      无
+ */
+static void sd_ring_pop(void)
+{
+    xSemaphoreTake(g_rec_lock, portMAX_DELAY);
+
+    if (g_rec_item_count > 0)
+    {
+        g_rec_ring_used -= g_rec_items[g_rec_item_first].len;
+        g_rec_item_first = (g_rec_item_first + 1) % SD_RECORD_ITEM_MAX;
+        g_rec_item_count--;
+    }
+
+    g_rec_item_busy = 0;
+    sd_rec_bus_update();
+    xSemaphoreGive(g_rec_lock);
+}
+
+/**
+ * @brief       保留最旧的一帧(取消写卡中标记)
+ * @param       无
+ * @retval      无
+ */
+static void sd_ring_pop_cancel(void)
+{
+    xSemaphoreTake(g_rec_lock, portMAX_DELAY);
+    g_rec_item_busy = 0;
+    xSemaphoreGive(g_rec_lock);
+}
+
+#if SD_RECORD_EVENT_EN
+/**
+ * @brief       查询事件片段是否进行中; 结束时间已过且之后没有新帧到来时(采集停止)结束片段
+ * @param       无
+ * @retval      true:进行中; false:无片段
+ */
+static bool sd_clip_active(void)
+{
+    bool active;
+
+    xSemaphoreTake(g_rec_lock, portMAX_DELAY);
+
+    if (g_rec_clip_until != 0 && g_rec_item_count == 0 &&
+        esp_timer_get_time() > g_rec_clip_until + (int64_t)SD_RECORD_SYNC_MS * 1000)
+    {
+        g_rec_clip_until = 0;
+    }
+
+    active = (g_rec_clip_until != 0);
+    xSemaphoreGive(g_rec_lock);
+
+    return active;
+}
+#endif
+
+/**
+ * @brief       判断最旧的一帧如何处理
+ * @note        连续模式全部写卡; 事件模式只写片段时间窗内的帧, 无片段时保留在缓冲中作为事件前录像
+ * @param       item : 帧
+ * @retval      0:保留在缓冲中(等待触发); 1:写卡; 2:丢弃(早于片段起点)
+ */
+static uint8_t sd_ring_action(const sd_rec_item_t *item)
+{
+#if SD_RECORD_EVENT_EN
+    uint8_t action;
+
+    xSemaphoreTake(g_rec_lock, portMAX_DELAY);
+
+    if (g_rec_clip_until == 0)
+    {
+        action = 0;
+    }
+    else if (item->timestamp_us < g_rec_clip_from)
+    {
+        action = 2;
+    }
+    else if (item->timestamp_us <= g_rec_clip_until)
+    {
+        action = 1;
+    }
+    else
+    {
+        action = 0;                                                 /* 片段已结束, 本帧留作下次的事件前录像 */
+        g_rec_clip_until = 0;
+    }
+
+    xSemaphoreGive(g_rec_lock);
+    return action;
+#else
+    (void)item;
+    return 1;
+#endif
+}
+
+/**
+ * @brief       写卡线程: 从环形缓冲取帧写入分段文件, 空闲或定时把已写数据同步到卡上
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void sd_recorder_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+    sd_rec_item_t item;
+    uint8_t action;
+    int64_t last_sync = esp_timer_get_time();
+    int64_t sync_start;
+    esp_err_t err = ESP_OK;
+
+    while (err == ESP_OK)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SD_RECORD_SYNC_MS)); /* 新帧或触发时唤醒 */
+
+        while (err == ESP_OK && sd_ring_peek(&item))
+        {
+            action = sd_ring_action(&item);
+
+            if (action == 0)
+            {
+                sd_ring_pop_cancel();
+                break;
+            }
+
+            if (action == 1)
+            {
+                err = sd_segment_write(&item);
+            }
+
+            sd_ring_pop();
+        }
+
+#if SD_RECORD_EVENT_EN
+        /* 片段结束: 关闭文件, 之后的帧留在缓冲中作为下次的事件前录像 */
+        if (err == ESP_OK && g_rec_seg.f != NULL && !sd_clip_active())
+        {
+            err = sd_segment_close();
+        }
+#endif
+
+        /* 只写出整扇区部分, 掉电时最多丢失最近 SD_RECORD_SYNC_MS 的录像 */
+        if (err == ESP_OK && g_rec_seg.f != NULL &&
+            esp_timer_get_time() - last_sync >= (int64_t)SD_RECORD_SYNC_MS * 1000)
+        {
+            err = sd_rec_flush(1);
+            sync_start = esp_timer_get_time();
+            fsync(fileno(g_rec_seg.f));
+            last_sync = esp_timer_get_time();
+            my_spi_account(MY_SPI_DEV_SD, 0, (uint32_t)(last_sync - sync_start));   /* FAT表与目录项 */
+        }
+    }
+
+    ESP_LOGE("TAG", "sd card write failed, recording stopped");
+    g_rec_running = 0;
+    g_rec_bus_prio = false;
+    my_spi_sd_priority(false);
+
+    if (g_rec_event != NULL)
+    {
+        xEventGroupClearBits(g_rec_event, g_rec_active_bit);
+    }
+
+    if (g_rec_seg.f != NULL)
+    {
+        fclose(g_rec_seg.f);
+        g_rec_seg.f = NULL;
+    }
+
+    sd_ring_pop_cancel();
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief       挂载SD卡并启动写卡线程
+ * @param       event      : 事件组, 录像运行期间置位 active_bit(发送线程据此在无网络连接时也采集)
+ * @param       active_bit : 事件位
+ * @retval      ESP_OK:成功; 其他:未插卡或内存不足(不录像)
+ */
+esp_err_t sd_recorder_init(EventGroupHandle_t event, EventBits_t active_bit)
+{
+#if SD_RECORD_EN
+    static StaticSemaphore_t lock_buf;
+    static StackType_t stack[SD_RECORD_THREAD_STACK];              /* 栈与TCB在内部RAM静态区 */
+    static StaticTask_t tcb;
+    sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+    sdspi_device_config_t slot = SDSPI_DEVICE_CONFIG_DEFAULT();
+    esp_vfs_fat_mount_config_t mount_config = {
+        .format_if_mount_failed = false,
+        .max_files = 2,
+        .allocation_unit_size = 32 * 1024,
+    };
+    esp_err_t err;
+
+    host.slot = MY_SPI_HOST;
+    slot.host_id = MY_SPI_HOST;
+    slot.gpio_cs = SD_CS_PIN;
+
+    /* 总线已由 my_spi_init() 初始化; SD卡片选改由sdspi驱动管理 */
+    if (MY_SD_Handle != NULL)
+    {
+        spi_bus_remove_device(MY_SD_Handle);
+        MY_SD_Handle = NULL;
+    }
+
+    err = esp_vfs_fat_sdspi_mount(SD_RECORD_MOUNT, &host, &slot, &mount_config, &g_rec_card);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGW("TAG", "no sd card, recording off (%s)", esp_err_to_name(err));
+        return err;
+    }
+
+    sdmmc_card_print_info(stdout, g_rec_card);
+
+    g_rec_batch = heap_stats_aligned_alloc(HEAP_TAG_SD_RECORD, 4, SD_RECORD_BATCH_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    g_rec_seg.index = heap_stats_malloc(HEAP_TAG_SD_RECORD, SD_RECORD_SEGMENT_CHUNKS * sizeof(sd_avi_index_t), MALLOC_CAP_SPIRAM);
+    g_rec_ring = heap_stats_malloc(HEAP_TAG_SD_RECORD, SD_RECORD_RING_SIZE, MALLOC_CAP_SPIRAM);
+
+    if (g_rec_batch == NULL || g_rec_seg.index == NULL || g_rec_ring == NULL)
+    {
+        ESP_LOGE("TAG", "Memory for sd recorder is not enough");
+        return ESP_ERR_NO_MEM;
+    }
+
+    g_rec_lock = xSemaphoreCreateMutexStatic(&lock_buf);
+    sd_rec_scan();
+    g_rec_event = event;
+    g_rec_active_bit = active_bit;
+
+    g_rec_task = xTaskCreateStaticPinnedToCore(sd_recorder_thread, "sd_recorder_thread", SD_RECORD_THREAD_STACK, NULL,
+                                               SD_RECORD_THREAD_PRIO, stack, &tcb, SD_RECORD_THREAD_CORE);
+    g_rec_running = 1;
+
+    if (event != NULL)
+    {
+        xEventGroupSetBits(event, active_bit);
+    }
+
+    ESP_LOGI("TAG", "%s recording to " SD_RECORD_MOUNT ", next REC%05u.AVI",
+             SD_RECORD_EVENT_EN ? "event" : "continuous", (unsigned)g_rec_next);
+#else
+    (void)event;
+    (void)active_bit;
+#endif
+    return ESP_OK;
+}
+
+#if SD_RECORD_EN
+/**
+ * @brief       拷贝一帧或一段音频到环形缓冲(不等待写卡)
+ * @note        缓冲按字节预算: 空间或描述符不足时覆盖最旧的项(连续模式下计为丢帧), 最旧的项正在写卡时丢弃本项
+ * @param       data         : 数据
+ * @param       len          : 长度
+ * @param       timestamp_us : 采集时间戳
+ * @param       width        : 视频: 图像宽度; 音频: 采样率
+ * @param       height       : 视频: 图像高度; 音频: 声道数
+ * @param       audio        : 1:PCM音频块
+ * @retval      无
+ */
+static void sd_ring_push(const uint8_t *data, uint32_t len, int64_t timestamp_us, uint16_t width, uint16_t height, uint8_t audio)
+{
+    sd_rec_item_t *item;
+    uint32_t first;
+
+    xSemaphoreTake(g_rec_lock, portMAX_DELAY);
+
+    while (g_rec_item_count > 0 &&
+           (g_rec_ring_used + len > SD_RECORD_RING_SIZE || g_rec_item_count == SD_RECORD_ITEM_MAX))
+    {
+        if (g_rec_item_busy)                                        /* 最旧的项正在写卡: 丢弃本项 */
+        {
+            g_rec_dropped++;
+            xSemaphoreGive(g_rec_lock);
+            return;
+        }
+
+        g_rec_ring_used -= g_rec_items[g_rec_item_first].len;
+        g_rec_item_first = (g_rec_item_first + 1) % SD_RECORD_ITEM_MAX;
+        g_rec_item_count--;
+        g_rec_dropped += !SD_RECORD_EVENT_EN;
+    }
+
+    item = &g_rec_items[(g_rec_item_first + g_rec_item_count) % SD_RECORD_ITEM_MAX];
+    item->timestamp_us = timestamp_us;
+    item->offset = g_rec_ring_head;
+    item->len = len;
+    item->width = width;
+    item->height = height;
+    item->audio = audio;
+
+    first = SD_RECORD_RING_SIZE - g_rec_ring_head;
+    first = (first < len) ? first : len;
+    memcpy(g_rec_ring + g_rec_ring_head, data, first);
+    memcpy(g_rec_ring, data + first, len - first);
+
+    g_rec_ring_head = (g_rec_ring_head + len) % SD_RECORD_RING_SIZE;
+    g_rec_ring_used += len;
+    g_rec_item_count++;
+    sd_rec_bus_update();
+
+    xSemaphoreGive(g_rec_lock);
+
+    if (!SD_RECORD_EVENT_EN || g_rec_clip_until != 0)
+    {
+        xTaskNotifyGive(g_rec_task);
+    }
+}
+#endif
+
+/**
+ * @brief       拷贝一帧到录像缓冲(发送线程调用, 不等待写卡)
+ * @note        调用返回后帧缓存即可归还(事件前录像需要数秒的帧, 远多于摄像头帧缓存数, 无法以引用计数持有)
+ * @param       fb : 帧缓存
+ * @retval      无
+ */
+void sd_recorder_offer(const camera_fb_t *fb)
+{
+#if SD_RECORD_EN
+    if (!g_rec_running || fb->format != PIXFORMAT_JPEG || fb->len > SD_RECORD_RING_SIZE / 2)
+    {
+        return;
+    }
+
+    sd_ring_push(fb->buf, (uint32_t)fb->len, (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec,
+                 (uint16_t)fb->width, (uint16_t)fb->height, 0);
+#else
+    (void)fb;
+#endif
+}
+
+/**
+ * @brief       拷贝一段麦克风PCM到录像缓冲(音频采集线程调用, 不等待写卡)
+ * @note        与视频帧进入同一环形缓冲, 由写卡线程交织写入同一文件; 未录像或 SD_RECORD_AUDIO_EN 为0时直接返回
+ * @param       pcm          : 16位PCM数据(多声道交织)
+ * @param       len          : 数据长度(字节)
+ * @param       sample_rate  : 采样率
+ * @param       channels     : 声道数
+ * @param       timestamp_us : 第一个采样点的时间戳(us, 与 fb->timestamp 同一时钟)
+ * @retval      无
+ */
+void sd_recorder_offer_audio(const void *pcm, size_t len, uint16_t sample_rate, uint8_t channels, uint64_t timestamp_us)
+{
+#if SD_RECORD_EN && SD_RECORD_AUDIO_EN
+    if (!g_rec_running || channels == 0 || len == 0 || len % (channels * sizeof(int16_t)) != 0)
+    {
+        return;
+    }
+
+    sd_ring_push((const uint8_t *)pcm, (uint32_t)len, (int64_t)timestamp_us, sample_rate, channels, 1);
+#else
+    (void)pcm;
+    (void)len;
+    (void)sample_rate;
+    (void)channels;
+    (void)timestamp_us;
+#endif
+}
+
+/**
+ * @brief       触发一次事件录像(按键、网络命令等, 不阻塞)
+ * @note        片段从 SD_RECORD_PRE_SEC 秒前(缓冲中尚存的最早帧)开始, 到最后一次触发后 SD_RECORD_POST_SEC 秒结束,
+ *              片段进行中再次触发则延长; 事件前的帧以写卡速度写出. 连续录像模式下忽略
+ * @param       无
+ * @retval      无
+ */
+void sd_recorder_trigger(void)
+{
+#if SD_RECORD_EN && SD_RECORD_EVENT_EN
+    int64_t now = esp_timer_get_time();
+
+    if (!g_rec_running)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_rec_lock, portMAX_DELAY);
+
+    if (g_rec_clip_until == 0)
+    {
+        g_rec_clip_from = now - (int64_t)SD_RECORD_PRE_SEC * 1000000;
+    }
+
+    g_rec_clip_until = now + (int64_t)SD_RECORD_POST_SEC * 1000000;
+    xSemaphoreGive(g_rec_lock);
+
+    xTaskNotifyGive(g_rec_task);
+    ESP_LOGI("TAG", "event clip triggered");
+#endif
+}
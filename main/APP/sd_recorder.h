@@ -0,0 +1,67 @@
+/**
+ ****************************************************************************************************
+ * @file        sd_recorder.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       SD卡连续录像(分段MJPEG/AVI文件, 含麦克风音频)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * SD卡挂在MY_SPI总线上(与LCD共用SPI2, SD_CS_PIN), 以sdspi驱动挂载FAT文件系统于 SD_RECORD_MOUNT.
+ * 发送线程通过 sd_recorder_offer() 把帧拷贝到PSRAM环形缓冲(不阻塞, 缓冲满时覆盖最旧的帧并计数),
+ * 帧缓存立即可以归还, 采集与网络发送不受SD卡写入延时尖峰影响.
+ * 写卡线程把多个帧攒成 SD_RECORD_BATCH_SIZE 字节(扇区对齐, 位于内部DMA内存)后一次 fwrite,
+ * FATFS对整扇区直接多块写入, 不经扇区缓存; 每个分段文件创建时按 SD_RECORD_SEGMENT_BYTES 预分配连续簇,
+ * 写入期间不再分配簇, 关闭时截断到实际长度并补写AVI索引与帧数.
+ * 文件名 RECnnnnn.AVI, 序号递增; 剩余空间不足一个分段时删除最旧的录像(循环录像).
+ * 有SD卡时录像不依赖网络连接, Wi-Fi断开期间也持续采集与保存.
+ * SD_RECORD_EVENT_EN 为1时只保存事件片段: 环形缓冲始终保存最近的帧(按字节预算, 满时覆盖最旧的帧),
+ * sd_recorder_trigger()(按键、网络命令)后把 SD_RECORD_PRE_SEC 秒前至触发后 SD_RECORD_POST_SEC 秒的帧写成一个文件,
+ * 事件前的帧以写卡速度写出, 事件后的帧边采集边写.
+ * SD_RECORD_AUDIO_EN 为1时 sd_recorder_offer_audio() 把麦克风PCM块放入同一环形缓冲, 写卡线程按到达顺序把
+ * JPEG帧('00dc')与PCM块('01wb')交织写入同一文件, 两路共用批量写缓冲, 不各自产生小块写入.
+ * 两路时间戳为同一 esp_timer 时钟: 音频流以 dwStart 对齐到分段第一帧, 音频块之间的缺口(缓冲溢出)补静音.
+ * SD卡与LCD共用SPI总线: 待写积压达到 SD_RECORD_BUS_PRIO_PCT 时请求SD卡优先(my_spi_sd_priority), LCD取景让出总线.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __SD_RECORDER_H
+#define __SD_RECORDER_H
+
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+
+#define SD_RECORD_EN                1                               /* 1:使能SD卡录像(未插卡时自动关闭) */
+#define SD_RECORD_MOUNT             "/sdcard"                       /* 挂载点 */
+#define SD_RECORD_EVENT_EN          0                               /* 1:只录事件片段(含事件前录像); 0:连续录像 */
+#define SD_RECORD_PRE_SEC           3                               /* 事件模式: 触发前保留的秒数(受缓冲大小限制) */
+#define SD_RECORD_POST_SEC          10                              /* 事件模式: 最后一次触发后继续录像的秒数 */
+#define SD_RECORD_RING_SIZE         (4 * 1024 * 1024)               /* PSRAM环形缓冲字节预算(JPEG帧长不定, 不按帧数), 连续模式下吸收写卡停顿 */
+#define SD_RECORD_AUDIO_EN          1                               /* 1:同时录制麦克风音频(16位PCM, 需 AV_AUDIO_EN) */
+#define SD_RECORD_ITEM_MAX          1024                            /* 缓冲中的帧与音频块数上限(描述符表大小) */
+#define SD_RECORD_BATCH_SIZE        (32 * 1024)                     /* 每次fwrite的字节数(扇区的整数倍) */
+#define SD_RECORD_SEGMENT_SEC       60                              /* 分段时长 */
+#define SD_RECORD_SEGMENT_BYTES     (96 * 1024 * 1024)              /* 分段文件预分配大小(达到即提前分段) */
+#define SD_RECORD_SEGMENT_CHUNKS    8192                            /* 分段中帧与音频块数上限(索引表大小) */
+#define SD_RECORD_SYNC_MS           2000                            /* 至少每隔该时间把已写数据同步到卡上 */
+#define SD_RECORD_BUS_PRIO_PCT      25                              /* 待写积压达到缓冲的该百分比时SD卡优先占用SPI总线(降到一半时恢复) */
+
+/* 函数声明 */
+esp_err_t sd_recorder_init(EventGroupHandle_t event, EventBits_t active_bit);  /* 挂载SD卡并启动写卡线程, 成功后置位 active_bit */
+void sd_recorder_offer(const camera_fb_t *fb);                      /* 拷贝一帧到录像缓冲(不阻塞) */
+void sd_recorder_offer_audio(const void *pcm, size_t len, uint16_t sample_rate, uint8_t channels, uint64_t timestamp_us);   /* 拷贝一段PCM到录像缓冲(不阻塞) */
+void sd_recorder_trigger(void);                                     /* 触发一次事件录像(不阻塞) */
+
+#endif
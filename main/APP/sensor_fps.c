@@ -0,0 +1,267 @@
+/**
+ ****************************************************************************************************
+ * @file        sensor_fps.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       传感器端帧率控制(按型号分频内部时钟, 降低输出帧率而不是丢帧)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "sensor_fps.h"
+#include "esp_log.h"
+
+
+/* 一种型号的分频档位 */
+typedef struct
+{
+    uint16_t pid;
+    uint16_t reg;                                                   /* 分频寄存器(地址格式与 sensor_t::set_reg 相同) */
+    uint8_t  mask;
+    uint8_t  shift;
+    uint8_t  field[SENSOR_FPS_STEPS];                               /* 各档位写入的分频值 */
+    uint8_t  num[SENSOR_FPS_STEPS];                                 /* 各档位帧率 = 全速帧率 x num / den */
+    uint8_t  den[SENSOR_FPS_STEPS];
+} sensor_fps_table_t;
+
+static const sensor_fps_table_t g_fps_tables[] = {
+    /* OV2640: CLKRC(传感器寄存器组), 分频 div+1 */
+    {OV2640_PID, 0x111, 0x3F, 0, {0, 1, 2, 3, 5, 7},   {1, 1, 1, 1, 1, 1}, {1, 2, 3, 4, 6, 8}},
+    /* OV5640: SC_PLL_CONTRL1[7:4] 系统分频, 驱动JPEG模式为4 */
+    {OV5640_PID, 0x3035, 0xF0, 4, {4, 5, 6, 8, 10, 12}, {4, 4, 4, 4, 4, 4}, {4, 5, 6, 8, 10, 12}},
+    /* OV3660: SC_PLLS_CTRL2[3:0] 系统分频, 驱动JPEG模式为1 */
+    {OV3660_PID, 0x303C, 0x0F, 0, {1, 2, 3, 4, 6, 8},   {1, 1, 1, 1, 1, 1}, {1, 2, 3, 4, 6, 8}},
+};
+
+static uint8_t g_fps_step = 0;                                      /* 当前档位 */
+static volatile int64_t g_fps_interval_us = 0;                      /* 帧间隔(滑动平均), 0:尚未测得 */
+static int64_t g_fps_last_us = 0;                                   /* 上一帧的采集时间戳 */
+static framesize_t g_fps_size = FRAMESIZE_INVALID;                  /* 测量帧间隔时的分辨率 */
+static uint16_t g_fps_full_x10[FRAMESIZE_INVALID];                  /* 各分辨率的全速帧率(x10), 0:尚未测得 */
+
+
+/**
+ * @brief       取得当前传感器的分频档位表
+ * @param       s : 传感器
+ * @retval      档位表, NULL:不支持
+ */
+static const sensor_fps_table_t *sensor_fps_table(const sensor_t *s)
+{
+    if (s == NULL || s->set_reg == NULL || s->pixformat != PIXFORMAT_JPEG)
+    {
+        return NULL;                                                /* 非JPEG格式下驱动的PLL配置不同, 档位比例不成立 */
+    }
+
+    for (size_t i = 0; i < sizeof(g_fps_tables) / sizeof(g_fps_tables[0]); i++)
+    {
+        if (g_fps_tables[i].pid == s->id.PID)
+        {
+            return &g_fps_tables[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief       写入档位的分频值
+ * @param       s    : 传感器
+ * @param       t    : 档位表
+ * @param       step : 档位
+ * @retval      ESP_OK:成功; ESP_FAIL:SCCB写入失败
+ */
+static esp_err_t sensor_fps_write(sensor_t *s, const sensor_fps_table_t *t, uint8_t step)
+{
+    if (s->set_reg(s, t->reg, t->mask, t->field[step] << t->shift) != 0)
+    {
+        ESP_LOGW("TAG", "sensor fps: write step %u failed", step);
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       直接选择档位
+ * @param       step : 档位, 0为全速, 越大越慢
+ * @retval      ESP_OK:成功; ESP_ERR_INVALID_ARG:档位超出范围; ESP_ERR_NOT_SUPPORTED:传感器不支持
+ */
+esp_err_t sensor_fps_set_step(uint8_t step)
+{
+#if SENSOR_FPS_EN
+    sensor_t *s = esp_camera_sensor_get();
+    const sensor_fps_table_t *t = sensor_fps_table(s);
+
+    if (t == NULL)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (step >= SENSOR_FPS_STEPS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (step == g_fps_step)
+    {
+        return ESP_OK;
+    }
+
+    if (sensor_fps_write(s, t, step) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI("TAG", "sensor fps: step %u -> %u (%u/%u)", g_fps_step, step, t->num[step], t->den[step]);
+    g_fps_step = step;
+    g_fps_interval_us = 0;                                          /* 按新档位重新测量 */
+    g_fps_last_us = 0;
+    return ESP_OK;
+#else
+    (void)step;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       选择帧率不低于fps的最慢档位
+ * @note        当前分辨率的全速帧率尚未测得时, 只在 fps 为0时切回全速, 其余情况保持当前档位
+ * @param       fps : 需要的帧率, 0:全速
+ * @retval      ESP_OK:成功; ESP_ERR_INVALID_STATE:尚未测得全速帧率; 其他见 sensor_fps_set_step
+ */
+esp_err_t sensor_fps_set(uint32_t fps)
+{
+#if SENSOR_FPS_EN
+    const sensor_fps_table_t *t = sensor_fps_table(esp_camera_sensor_get());
+    uint16_t full;
+    uint8_t step = 0;
+
+    if (t == NULL)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (fps == 0)
+    {
+        return sensor_fps_set_step(0);
+    }
+
+    full = (g_fps_size < FRAMESIZE_INVALID) ? g_fps_full_x10[g_fps_size] : 0;
+
+    if (full == 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    while (step + 1 < SENSOR_FPS_STEPS &&
+           (uint32_t)full * t->num[step + 1] >= fps * 10 * t->den[step + 1])
+    {
+        step++;
+    }
+
+    return sensor_fps_set_step(step);
+#else
+    (void)fps;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       当前分辨率下各档位的帧率
+ * @param       fps_x10 : 输出各档位帧率(x10), 全速帧率尚未测得时为0
+ * @param       max     : 数组长度
+ * @retval      档位数, 0:不支持
+ */
+int sensor_fps_steps(uint16_t *fps_x10, int max)
+{
+    const sensor_fps_table_t *t = sensor_fps_table(esp_camera_sensor_get());
+    uint16_t full;
+    int n;
+
+    if (t == NULL)
+    {
+        return 0;
+    }
+
+    full = (g_fps_size < FRAMESIZE_INVALID) ? g_fps_full_x10[g_fps_size] : 0;
+    n = (max < SENSOR_FPS_STEPS) ? max : SENSOR_FPS_STEPS;
+
+    for (int i = 0; i < n; i++)
+    {
+        fps_x10[i] = (uint16_t)((uint32_t)full * t->num[i] / t->den[i]);
+    }
+
+    return n;
+}
+
+/**
+ * @brief       以采集时间戳测量帧间隔, 并换算出当前分辨率的全速帧率
+ * @param       fb : 帧缓存
+ * @retval      无
+ */
+void sensor_fps_observe(const camera_fb_t *fb)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    const sensor_fps_table_t *t = sensor_fps_table(s);
+    int64_t ts = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    int64_t interval = g_fps_interval_us;
+    framesize_t size = (s != NULL) ? s->status.framesize : FRAMESIZE_INVALID;
+
+    if (size != g_fps_size)                                         /* 分辨率改变, 重新测量 */
+    {
+        g_fps_size = size;
+        interval = 0;
+        g_fps_last_us = 0;
+    }
+
+    if (g_fps_last_us != 0 && ts > g_fps_last_us && ts - g_fps_last_us < 1000000)
+    {
+        interval = (interval == 0) ? ts - g_fps_last_us : interval + (ts - g_fps_last_us - interval) / 8;
+
+        if (t != NULL && size < FRAMESIZE_INVALID && interval > 0)
+        {
+            g_fps_full_x10[size] = (uint16_t)(10000000LL * t->den[g_fps_step] / (interval * t->num[g_fps_step]));
+        }
+    }
+
+    g_fps_interval_us = interval;
+    g_fps_last_us = ts;
+}
+
+/**
+ * @brief       当前帧间隔
+ * @param       无
+ * @retval      帧间隔(us, 滑动平均), 0:尚未测得
+ */
+int64_t sensor_fps_interval_us(void)
+{
+    return g_fps_interval_us;
+}
+
+/**
+ * @brief       切换分辨率后恢复当前档位(set_framesize 会把分频恢复为驱动默认值)
+ * @param       无
+ * @retval      无
+ */
+void sensor_fps_reapply(void)
+{
+#if SENSOR_FPS_EN
+    sensor_t *s = esp_camera_sensor_get();
+    const sensor_fps_table_t *t = sensor_fps_table(s);
+
+    if (t != NULL && g_fps_step != 0)
+    {
+        sensor_fps_write(s, t, g_fps_step);
+    }
+#endif
+}
@@ -0,0 +1,49 @@
+/**
+ ****************************************************************************************************
+ * @file        sensor_fps.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       传感器端帧率控制(按型号分频内部时钟, 降低输出帧率而不是丢帧)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 传感器的行/帧时序(HTS/VTS)由内部系统时钟驱动, 帧率与系统时钟成正比. 各型号提供一组分频档位:
+ * OV2640  : CLKRC[5:0] 时钟分频, 帧率为全速的 1/(div+1)
+ * OV5640  : PLL系统分频(0x3035[7:4]), JPEG模式下驱动配置为4, 帧率为全速的 4/sys_div
+ * OV3660  : PLL系统分频(0x303C[3:0]), JPEG模式下驱动配置为1, 帧率为全速的 1/sys_div
+ * 只改分频字段, 倍频与PCLK分频保持驱动按分辨率设置的值, 各档位都是驱动已使用过的PLL组合的整数倍降频.
+ * 全速帧率按分辨率由实测的帧间隔(sensor_fps_observe)换算得到并记录, 各档帧率 = 全速帧率 x 档位比例.
+ * set_framesize 会重写这些寄存器, 切换分辨率后需调用 sensor_fps_reapply() 恢复当前档位.
+ * 其他型号或非JPEG格式不支持, sensor_fps_set() 返回 ESP_ERR_NOT_SUPPORTED.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __SENSOR_FPS_H
+#define __SENSOR_FPS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+
+#define SENSOR_FPS_EN               1                               /* 1:使能传感器端帧率控制 */
+#define SENSOR_FPS_STEPS            6                               /* 每种型号的分频档位数 */
+
+/* 函数声明 */
+esp_err_t sensor_fps_set(uint32_t fps);                             /* 选择不低于fps的最慢档位, 0:全速 */
+esp_err_t sensor_fps_set_step(uint8_t step);                        /* 直接选择档位(0为全速) */
+int sensor_fps_steps(uint16_t *fps_x10, int max);                   /* 当前分辨率下各档位的帧率(x10), 返回档位数 */
+void sensor_fps_observe(const camera_fb_t *fb);                     /* 以采集时间戳测量帧间隔(发送线程调用) */
+int64_t sensor_fps_interval_us(void);                               /* 当前帧间隔(滑动平均), 0:尚未测得 */
+void sensor_fps_reapply(void);                                      /* 切换分辨率后恢复当前档位 */
+
+#endif
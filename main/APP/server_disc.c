@@ -0,0 +1,614 @@
+/**
+ ****************************************************************************************************
+ * @file        server_disc.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       接收服务器的发现(mDNS/DNS-SD)与多服务器切换
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "server_disc.h"
+#include "lwip_demo.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#if SERVER_DISC_MDNS_EN
+#include "mdns.h"
+#endif
+
+
+/* 服务器表项 */
+typedef struct
+{
+    server_ep_t ep;
+    uint16_t prio;                                                  /* 优先级, 越小越优先 */
+    uint8_t used;
+    uint8_t mdns;                                                   /* 1:mDNS发现; 0:静态列表 */
+    uint8_t missed;                                                 /* 连续查询不到的次数 */
+    uint8_t fails;                                                  /* 连续连接失败的次数 */
+    int64_t down_until_us;                                          /* 冷却结束时间, 0:可用 */
+} server_entry_t;
+
+/* 进行中的健康探测 */
+typedef struct
+{
+    int sock;                                                       /* -1:未探测 */
+    server_ep_t ep;
+} server_probe_t;
+
+static const char *const g_disc_static[] = SERVER_DISC_STATIC;
+static SemaphoreHandle_t g_disc_lock = NULL;
+static server_entry_t g_disc_tab[SERVER_DISC_MAX];
+static uint8_t g_disc_mac[6];
+static server_ep_t g_disc_cur;                                      /* 当前连接的服务器, ip为空:未连接 */
+static volatile uint8_t g_disc_move = 0;                            /* 1:首选服务器已变化; 2:已通知断开, 等待断线 */
+static uint32_t g_disc_failovers = 0;
+static uint32_t g_disc_moves = 0;
+static server_probe_t g_disc_probe[SERVER_DISC_MAX];
+static int64_t g_disc_probe_us = 0;                                 /* 本轮探测的开始时间 */
+static int64_t g_disc_period_us = 0;                                /* 本轮查询与探测的开始时间 */
+#if SERVER_DISC_MDNS_EN
+static mdns_search_once_t *g_disc_search = NULL;                    /* 进行中的异步mDNS查询 */
+#endif
+
+
+/**
+ * @brief       设备与服务器的rendezvous哈希(FNV-1a, 末尾再混合一次)
+ * @param       ep : 服务器地址
+ * @retval      哈希值
+ */
+static uint32_t server_disc_hash(const server_ep_t *ep)
+{
+    uint32_t h = 2166136261u;
+
+    for (int i = 0; i < sizeof(g_disc_mac); i++)
+    {
+        h = (h ^ g_disc_mac[i]) * 16777619u;
+    }
+
+    for (const char *p = ep->ip; *p; p++)
+    {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+
+    h = (h ^ (ep->port & 0xFF)) * 16777619u;
+    h = (h ^ (ep->port >> 8)) * 16777619u;
+    h ^= h >> 16;                                                   /* FNV的低位扩散较差, 再混合一次 */
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h;
+}
+
+/**
+ * @brief       首选服务器(调用者持有 g_disc_lock)
+ * @param       now : 当前时间(us)
+ * @retval      表项下标, -1:全部在冷却中
+ */
+static int server_disc_best(int64_t now)
+{
+    int best = -1;
+    uint32_t best_hash = 0;
+    uint32_t hash;
+
+    for (int i = 0; i < SERVER_DISC_MAX; i++)
+    {
+        server_entry_t *e = &g_disc_tab[i];
+
+        if (!e->used || e->down_until_us > now)
+        {
+            continue;
+        }
+
+        hash = SERVER_DISC_SPREAD_EN ? server_disc_hash(&e->ep) : 0;
+
+        if (best < 0 || e->prio < g_disc_tab[best].prio || (e->prio == g_disc_tab[best].prio && hash > best_hash))
+        {
+            best = i;
+            best_hash = hash;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief       查找服务器(调用者持有 g_disc_lock)
+ * @param       ep : 服务器地址
+ * @retval      表项下标, -1:不在表中
+ */
+static int server_disc_find(const server_ep_t *ep)
+{
+    for (int i = 0; i < SERVER_DISC_MAX; i++)
+    {
+        if (g_disc_tab[i].used && g_disc_tab[i].ep.port == ep->port && strcmp(g_disc_tab[i].ep.ip, ep->ip) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief       检查首选服务器是否已变化
+ * @param       无
+ * @retval      无
+ */
+static void server_disc_check_move(void)
+{
+    int best;
+
+    xSemaphoreTake(g_disc_lock, portMAX_DELAY);
+    best = server_disc_best(esp_timer_get_time());
+
+    if (g_disc_cur.ip[0] != '\0' && !g_disc_move && best >= 0 &&
+        (g_disc_tab[best].ep.port != g_disc_cur.port || strcmp(g_disc_tab[best].ep.ip, g_disc_cur.ip) != 0))
+    {
+        g_disc_move = 1;
+        g_disc_moves++;
+        ESP_LOGI("TAG", "server disc: moving %s:%u -> %s:%u", g_disc_cur.ip, g_disc_cur.port,
+                 g_disc_tab[best].ep.ip, g_disc_tab[best].ep.port);
+    }
+
+    xSemaphoreGive(g_disc_lock);
+}
+
+#if SERVER_DISC_MDNS_EN
+/**
+ * @brief       以mDNS查询结果更新表中mDNS发现的项
+ * @param       results : 查询结果(可为NULL:没有任何实例应答)
+ * @retval      无
+ */
+static void server_disc_update(mdns_result_t *results)
+{
+    uint8_t seen[SERVER_DISC_MAX] = { 0 };
+    server_ep_t ep;
+    uint16_t prio;
+    int idx;
+
+    xSemaphoreTake(g_disc_lock, portMAX_DELAY);
+
+    for (mdns_result_t *r = results; r != NULL; r = r->next)
+    {
+        mdns_ip_addr_t *a = r->addr;
+
+        while (a != NULL && a->addr.type != ESP_IPADDR_TYPE_V4)
+        {
+            a = a->next;
+        }
+
+        if (a == NULL || r->port == 0)
+        {
+            continue;
+        }
+
+        snprintf(ep.ip, sizeof(ep.ip), IPSTR, IP2STR(&a->addr.u_addr.ip4));
+        ep.port = r->port;
+        prio = 0;
+
+        for (size_t i = 0; i < r->txt_count; i++)
+        {
+            if (strcmp(r->txt[i].key, "prio") == 0 && r->txt[i].value != NULL)
+            {
+                prio = (uint16_t)atoi(r->txt[i].value);
+            }
+        }
+
+        idx = server_disc_find(&ep);
+
+        for (int i = 0; idx < 0 && i < SERVER_DISC_MAX; i++)
+        {
+            if (!g_disc_tab[i].used)
+            {
+                idx = i;
+                memset(&g_disc_tab[idx], 0, sizeof(g_disc_tab[idx]));
+                g_disc_tab[idx].ep = ep;
+                g_disc_tab[idx].used = 1;
+                g_disc_tab[idx].mdns = 1;
+                ESP_LOGI("TAG", "server disc: found %s:%u prio %u", ep.ip, ep.port, prio);
+            }
+        }
+
+        if (idx >= 0 && g_disc_tab[idx].mdns)
+        {
+            g_disc_tab[idx].prio = prio;
+            g_disc_tab[idx].missed = 0;
+            seen[idx] = 1;
+        }
+    }
+
+    for (int i = 0; i < SERVER_DISC_MAX; i++)
+    {
+        if (g_disc_tab[i].used && g_disc_tab[i].mdns && !seen[i] && ++g_disc_tab[i].missed >= SERVER_DISC_EXPIRE_N)
+        {
+            ESP_LOGI("TAG", "server disc: %s:%u gone", g_disc_tab[i].ep.ip, g_disc_tab[i].ep.port);
+            g_disc_tab[i].used = 0;
+        }
+    }
+
+    xSemaphoreGive(g_disc_lock);
+}
+
+/**
+ * @brief       推进mDNS查询: 周期开始时发出异步查询, 之后每次轮询只检查是否已结束(不等待)
+ * @param       start : 1:开始新一轮查询
+ * @retval      无
+ */
+static void server_disc_query(int start)
+{
+    mdns_result_t *results = NULL;
+    uint8_t num = 0;
+
+    if (g_disc_search == NULL)
+    {
+        if (start)
+        {
+            g_disc_search = mdns_query_async_new(NULL, SERVER_DISC_SERVICE, "_tcp", MDNS_TYPE_PTR,
+                                                 SERVER_DISC_QUERY_MS, SERVER_DISC_MAX, NULL);
+        }
+
+        return;
+    }
+
+    if (!mdns_query_async_get_results(g_disc_search, 0, &results, &num))
+    {
+        return;                                                     /* 查询仍在进行 */
+    }
+
+    mdns_query_async_delete(g_disc_search);
+    g_disc_search = NULL;
+    server_disc_update(results);
+
+    if (results != NULL)
+    {
+        mdns_query_results_free(results);
+    }
+}
+#endif
+
+/**
+ * @brief       对冷却中的服务器发起TCP连接探测(非阻塞connect, 由 server_disc_probe_check 收取结果)
+ * @param       无
+ * @retval      无
+ */
+static void server_disc_probe_start(void)
+{
+    struct sockaddr_in addr = { 0 };
+    int64_t now = esp_timer_get_time();
+    int sock;
+
+    for (int i = 0; i < SERVER_DISC_MAX; i++)
+    {
+        if (!g_disc_tab[i].used || g_disc_tab[i].down_until_us <= now || g_disc_probe[i].sock >= 0)
+        {
+            continue;
+        }
+
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(g_disc_tab[i].ep.port);
+        inet_pton(AF_INET, g_disc_tab[i].ep.ip, &addr.sin_addr);
+        sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+
+        if (sock < 0)
+        {
+            break;
+        }
+
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+        if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 && errno != EINPROGRESS)
+        {
+            closesocket(sock);
+            continue;
+        }
+
+        g_disc_probe[i].sock = sock;
+        g_disc_probe[i].ep = g_disc_tab[i].ep;                      /* 探测期间表项可能被替换 */
+    }
+
+    g_disc_probe_us = now;
+}
+
+/**
+ * @brief       收取探测结果(不等待): 连通的服务器提前恢复, 超过 SERVER_DISC_PROBE_MS 仍未连通的放弃
+ * @param       无
+ * @retval      无
+ */
+static void server_disc_probe_check(void)
+{
+    struct timeval tv = { 0 };
+    bool expired = (esp_timer_get_time() - g_disc_probe_us) > (int64_t)SERVER_DISC_PROBE_MS * 1000;
+    int so_err;
+    socklen_t len;
+    fd_set wset;
+    int maxfd = -1;
+    int idx;
+
+    FD_ZERO(&wset);
+
+    for (int i = 0; i < SERVER_DISC_MAX; i++)
+    {
+        if (g_disc_probe[i].sock >= 0)
+        {
+            FD_SET(g_disc_probe[i].sock, &wset);
+            maxfd = (g_disc_probe[i].sock > maxfd) ? g_disc_probe[i].sock : maxfd;
+        }
+    }
+
+    if (maxfd < 0 || select(maxfd + 1, NULL, &wset, NULL, &tv) < 0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < SERVER_DISC_MAX; i++)
+    {
+        if (g_disc_probe[i].sock < 0 || (!FD_ISSET(g_disc_probe[i].sock, &wset) && !expired))
+        {
+            continue;
+        }
+
+        so_err = -1;
+        len = sizeof(so_err);
+
+        if (FD_ISSET(g_disc_probe[i].sock, &wset))
+        {
+            getsockopt(g_disc_probe[i].sock, SOL_SOCKET, SO_ERROR, &so_err, &len);
+        }
+
+        closesocket(g_disc_probe[i].sock);
+        g_disc_probe[i].sock = -1;
+
+        if (so_err != 0)
+        {
+            continue;
+        }
+
+        xSemaphoreTake(g_disc_lock, portMAX_DELAY);
+        idx = server_disc_find(&g_disc_probe[i].ep);
+
+        if (idx >= 0)
+        {
+            g_disc_tab[idx].fails = 0;
+            g_disc_tab[idx].down_until_us = 0;
+            ESP_LOGI("TAG", "server disc: %s:%u is back", g_disc_probe[i].ep.ip, g_disc_probe[i].ep.port);
+        }
+
+        xSemaphoreGive(g_disc_lock);
+    }
+}
+
+/**
+ * @brief       推进服务器发现(网络事件循环每次唤醒时调用, 不阻塞)
+ * @note        每 SERVER_DISC_PERIOD_S 秒发出一轮mDNS查询与健康探测, 其余调用只收取结果;
+ *              所有工作都在网络事件循环中完成, 不单独占用线程栈
+ * @param       无
+ * @retval      无
+ */
+void server_disc_poll(void)
+{
+    int64_t now = esp_timer_get_time();
+    int start = (now - g_disc_period_us) >= (int64_t)SERVER_DISC_PERIOD_S * 1000000;
+
+    if (g_disc_lock == NULL)
+    {
+        return;
+    }
+
+    if (start)
+    {
+        g_disc_period_us = now;
+        server_disc_probe_start();
+    }
+
+#if SERVER_DISC_MDNS_EN
+    server_disc_query(start);
+#endif
+    server_disc_probe_check();
+    server_disc_check_move();
+}
+
+/**
+ * @brief       载入静态列表, 启动mDNS(WIFI连接后调用, 只初始化一次)
+ * @param       无
+ * @retval      无
+ */
+void server_disc_init(void)
+{
+    int n = sizeof(g_disc_static) / sizeof(g_disc_static[0]);
+
+    if (g_disc_lock != NULL)
+    {
+        return;
+    }
+
+    g_disc_lock = xSemaphoreCreateMutex();
+    esp_read_mac(g_disc_mac, ESP_MAC_WIFI_STA);
+
+    for (int i = 0; i < n && i < SERVER_DISC_MAX; i++)
+    {
+        strlcpy(g_disc_tab[i].ep.ip, g_disc_static[i], sizeof(g_disc_tab[i].ep.ip));
+        g_disc_tab[i].ep.port = LWIP_DEMO_PORT;
+        g_disc_tab[i].prio = SERVER_DISC_STATIC_PRIO + i;
+        g_disc_tab[i].used = 1;
+    }
+
+#if SERVER_DISC_MDNS_EN
+    if (mdns_init() != ESP_OK)
+    {
+        ESP_LOGW("TAG", "server disc: mdns init failed, static list only");
+    }
+#endif
+
+    for (int i = 0; i < SERVER_DISC_MAX; i++)
+    {
+        g_disc_probe[i].sock = -1;
+    }
+
+    g_disc_period_us = esp_timer_get_time() - (int64_t)SERVER_DISC_PERIOD_S * 1000000;  /* 首次轮询即开始查询 */
+}
+
+/**
+ * @brief       选择要连接的服务器
+ * @param       ep : 输出服务器地址
+ * @retval      true:选中可用的服务器; false:全部在冷却中, ep 为最先结束冷却的一台(调用者退避后连接)
+ */
+bool server_disc_pick(server_ep_t *ep)
+{
+    int64_t now = esp_timer_get_time();
+    int best;
+
+    xSemaphoreTake(g_disc_lock, portMAX_DELAY);
+    best = server_disc_best(now);
+
+    if (best < 0)
+    {
+        for (int i = 0; i < SERVER_DISC_MAX; i++)
+        {
+            if (g_disc_tab[i].used && (best < 0 || g_disc_tab[i].down_until_us < g_disc_tab[best].down_until_us))
+            {
+                best = i;
+            }
+        }
+    }
+
+    *ep = g_disc_tab[best].ep;                                      /* 静态列表至少有一项, 不会删除 */
+    xSemaphoreGive(g_disc_lock);
+    return g_disc_tab[best].down_until_us <= now;
+}
+
+/**
+ * @brief       报告连接结果
+ * @param       ep : 服务器地址
+ * @param       ok : true:已连接; false:连接失败
+ * @retval      连接失败时: true:还有其他可用服务器(立即改连, 不退避); false:全部在冷却中
+ */
+bool server_disc_report(const server_ep_t *ep, bool ok)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t cooldown;
+    bool others = false;
+    int idx;
+
+    xSemaphoreTake(g_disc_lock, portMAX_DELAY);
+    idx = server_disc_find(ep);
+
+    if (ok)
+    {
+        if (idx >= 0)
+        {
+            g_disc_tab[idx].fails = 0;
+            g_disc_tab[idx].down_until_us = 0;
+        }
+
+        g_disc_cur = *ep;
+        g_disc_move = 0;
+    }
+    else
+    {
+        if (idx >= 0)
+        {
+            g_disc_tab[idx].fails = (g_disc_tab[idx].fails < 16) ? g_disc_tab[idx].fails + 1 : 16;
+            cooldown = SERVER_DISC_COOLDOWN_MS << (g_disc_tab[idx].fails - 1);
+            cooldown = (cooldown > SERVER_DISC_COOLDOWN_MAX_MS) ? SERVER_DISC_COOLDOWN_MAX_MS : cooldown;
+            g_disc_tab[idx].down_until_us = now + (int64_t)cooldown * 1000;
+        }
+
+        others = server_disc_best(now) >= 0;
+        g_disc_failovers += others;
+    }
+
+    xSemaphoreGive(g_disc_lock);
+
+    if (!ok && others)
+    {
+        ESP_LOGW("TAG", "server disc: %s:%u failed, failing over", ep->ip, ep->port);
+    }
+
+    return others;
+}
+
+/**
+ * @brief       已连接期间首选服务器是否已变化(网络事件循环调用)
+ * @param       无
+ * @retval      true:应断开并改连首选服务器(每次变化只返回一次)
+ */
+bool server_disc_should_move(void)
+{
+    bool move = false;
+
+    if (g_disc_move == 1)
+    {
+        xSemaphoreTake(g_disc_lock, portMAX_DELAY);
+        move = (g_disc_move == 1);
+        g_disc_move = move ? 2 : g_disc_move;
+        xSemaphoreGive(g_disc_lock);
+    }
+
+    return move;
+}
+
+/**
+ * @brief       连接断开
+ * @param       无
+ * @retval      无
+ */
+void server_disc_disconnected(void)
+{
+    xSemaphoreTake(g_disc_lock, portMAX_DELAY);
+    g_disc_cur.ip[0] = '\0';
+    g_disc_move = 0;
+    xSemaphoreGive(g_disc_lock);
+}
+
+/**
+ * @brief       读取统计
+ * @param       stats : 输出统计
+ * @retval      无
+ */
+void server_disc_get_stats(server_disc_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+
+    memset(stats, 0, sizeof(*stats));
+
+    if (g_disc_lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_disc_lock, portMAX_DELAY);
+
+    for (int i = 0; i < SERVER_DISC_MAX; i++)
+    {
+        if (g_disc_tab[i].used)
+        {
+            stats->servers++;
+            stats->discovered += g_disc_tab[i].mdns;
+            stats->up += (g_disc_tab[i].down_until_us <= now);
+        }
+    }
+
+    stats->failovers = g_disc_failovers;
+    stats->moves = g_disc_moves;
+    stats->current = g_disc_cur;
+    xSemaphoreGive(g_disc_lock);
+}
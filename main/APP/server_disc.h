@@ -0,0 +1,89 @@
+/**
+ ****************************************************************************************************
+ * @file        server_disc.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       接收服务器的发现(mDNS/DNS-SD)与多服务器切换
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 原先每台设备只连接 IP_ADDR, 该服务器重启期间所有设备停在重连退避中. 本模块维护一张服务器表:
+ * 1. mDNS发现: SERVER_DISC_MDNS_EN 为1时每 SERVER_DISC_PERIOD_S 秒查询 SERVER_DISC_SERVICE 服务
+ *    (ingest_server.py 默认发布), 实例的TXT记录 prio=N 为优先级(越小越优先, 默认0, 备用服务器发布更大的值);
+ *    连续 SERVER_DISC_EXPIRE_N 次查询不到的实例从表中删除
+ * 2. 静态列表: SERVER_DISC_STATIC 按顺序排列, 优先级为 SERVER_DISC_STATIC_PRIO 加序号,
+ *    即没有发现任何服务器(或发现的全部不可用)时才依次使用; 只有 IP_ADDR 一项且不开启mDNS时与原先的行为相同
+ * 3. 健康状态: 连接失败的服务器进入冷却(SERVER_DISC_COOLDOWN_MS 起按次数加倍, 不超过 SERVER_DISC_COOLDOWN_MAX_MS),
+ *    冷却期间不选择; 每周期对冷却中的服务器做TCP连接探测, 连通即提前恢复
+ * 选择: 不在冷却中且优先级最小的一组里, SERVER_DISC_SPREAD_EN 为1时按设备MAC与服务器地址的哈希取最大者
+ * (rendezvous哈希), 否则取表中靠前者. 同优先级的多台服务器因此分摊设备, 增加一台只会把约1/n的设备迁过去.
+ * lwip_demo 连接失败时立即改连下一台可用服务器(不退避, 只在全部不可用时退避);
+ * 已连接期间首选服务器发生变化(优先级更高的服务器恢复, 或新服务器使哈希结果改变)时,
+ * server_disc_should_move() 返回真, lwip_demo 断开后改连首选服务器.
+ * 本模块没有自己的线程: 查询(异步mDNS)与探测(非阻塞connect)由 lwip_demo 的网络事件循环每次唤醒时
+ * 调用 server_disc_poll() 推进, 不阻塞控制通道的接收.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __SERVER_DISC_H
+#define __SERVER_DISC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+
+#if CONFIG_APP_SERVER_DISC_MDNS                                      /* menuconfig 中设置, 同时决定是否拉取 espressif/mdns */
+#define SERVER_DISC_MDNS_EN         1                               /* 1:以mDNS查询服务器(需 espressif/mdns 组件) */
+#else
+#define SERVER_DISC_MDNS_EN         0
+#endif
+#define SERVER_DISC_SERVICE         "_camingest"                    /* DNS-SD服务类型(协议 _tcp) */
+#define SERVER_DISC_STATIC          { IP_ADDR }                     /* 静态服务器列表(按顺序备用), 端口均为 LWIP_DEMO_PORT */
+#define SERVER_DISC_STATIC_PRIO     100                             /* 静态列表第一项的优先级(低于mDNS发现的服务器) */
+#define SERVER_DISC_SPREAD_EN       1                               /* 1:同优先级的服务器按设备MAC分摊 */
+#define SERVER_DISC_MAX             8                               /* 服务器表容量 */
+#define SERVER_DISC_PERIOD_S        10                              /* mDNS查询与健康探测周期 */
+#define SERVER_DISC_QUERY_MS        1500                            /* 每次mDNS查询的等待时间 */
+#define SERVER_DISC_EXPIRE_N        3                               /* 连续这么多次查询不到的实例删除 */
+#define SERVER_DISC_PROBE_MS        1000                            /* 健康探测的连接超时 */
+#define SERVER_DISC_COOLDOWN_MS     2000                            /* 连接失败后的冷却时间(按连续失败次数加倍) */
+#define SERVER_DISC_COOLDOWN_MAX_MS 60000
+
+/* 服务器地址 */
+typedef struct
+{
+    char ip[16];                                                    /* IPv4点分十进制 */
+    uint16_t port;
+} server_ep_t;
+
+/* 统计 */
+typedef struct
+{
+    uint8_t servers;                                                /* 表中的服务器数 */
+    uint8_t discovered;                                             /* 其中mDNS发现的 */
+    uint8_t up;                                                     /* 不在冷却中的 */
+    uint32_t failovers;                                             /* 连接失败后改连其他服务器的次数 */
+    uint32_t moves;                                                 /* 首选服务器变化而主动迁移的次数 */
+    server_ep_t current;                                            /* 当前连接的服务器, ip为空:未连接 */
+} server_disc_stats_t;
+
+/* 函数声明 */
+void server_disc_init(void);                                        /* 载入静态列表, 启动mDNS(WIFI连接后调用) */
+void server_disc_poll(void);                                        /* 推进查询与探测(网络事件循环调用, 不阻塞) */
+bool server_disc_pick(server_ep_t *ep);                             /* 选择要连接的服务器, false:全部在冷却中(调用者退避) */
+bool server_disc_report(const server_ep_t *ep, bool ok);            /* 报告连接结果, 失败时返回是否有其他可用服务器 */
+bool server_disc_should_move(void);                                 /* 已连接期间首选服务器是否已变化(每次变化只返回一次) */
+void server_disc_disconnected(void);                                /* 连接断开 */
+void server_disc_get_stats(server_disc_stats_t *stats);             /* 读取统计 */
+
+#endif
@@ -0,0 +1,288 @@
+/**
+ ****************************************************************************************************
+ * @file        snapshot.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       /snapshot.jpg: 由最新帧缓存应答的单帧抓图(引用计数, ETag/If-None-Match)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "snapshot.h"
+#include "frame_pool.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_log.h"
+
+
+#define SNAPSHOT_POLL_MS            20                              /* 等待新帧时的查询间隔 */
+#define SNAPSHOT_ETAG_MAX           24                              /* "xxxxxxxx-nnnnnnnnnn" */
+
+/* 一帧缓存 */
+typedef struct
+{
+    uint8_t *buf;                                                   /* frame_pool 槽位 */
+    size_t len;
+    uint32_t seq;                                                   /* 缓存序号(ETag) */
+    int64_t captured_us;                                            /* 帧的采集时间 */
+    struct timeval timestamp;
+    uint8_t refs;                                                   /* 最新帧自身1次 + 正在发送的请求数 */
+} snapshot_entry_t;
+
+static SemaphoreHandle_t g_snapshot_lock = NULL;                    /* 保护缓存与引用计数 */
+static snapshot_entry_t g_snapshot_entry[3];                        /* 最新帧与仍在发送的旧帧(HTTP服务单线程, 同时最多一个请求) */
+static snapshot_entry_t *g_snapshot_latest = NULL;
+static uint32_t g_snapshot_seq = 0;
+static uint32_t g_snapshot_boot = 0;                                /* 开机随机数, 重启后ETag不重复 */
+static volatile uint32_t g_snapshot_req_ms = 0;                     /* 最近一次请求的时间 */
+static volatile uint8_t g_snapshot_active = 0;                      /* 1:最近 SNAPSHOT_ACTIVE_MS 内有请求 */
+static int64_t g_snapshot_last_us = 0;                              /* 最近一次更新缓存 */
+static EventGroupHandle_t g_snapshot_event = NULL;
+static EventBits_t g_snapshot_active_bit = 0;
+
+
+/**
+ * @brief       归还一次缓存引用, 最后一个引用归还时释放槽位
+ * @param       e : 缓存
+ * @retval      无
+ */
+static void snapshot_unref(snapshot_entry_t *e)
+{
+    uint8_t *buf = NULL;
+
+    xSemaphoreTake(g_snapshot_lock, portMAX_DELAY);
+
+    if (--e->refs == 0)
+    {
+        buf = e->buf;
+        e->buf = NULL;
+    }
+
+    xSemaphoreGive(g_snapshot_lock);
+    frame_pool_free(buf);
+}
+
+/**
+ * @brief       提交一帧(发送线程调用, 不阻塞)
+ * @note        最近没有请求或距上次更新不足 SNAPSHOT_MIN_INTERVAL_MS 时直接返回; 否则拷贝到 frame_pool 槽位
+ * @param       fb : 帧缓存
+ * @retval      无
+ */
+void snapshot_offer(const camera_fb_t *fb)
+{
+#if SNAPSHOT_EN
+    int64_t now = esp_timer_get_time();
+    snapshot_entry_t *e = NULL;
+    snapshot_entry_t *old;
+    uint8_t *buf;
+
+    if (g_snapshot_lock == NULL || !g_snapshot_active || fb->format != PIXFORMAT_JPEG)
+    {
+        return;
+    }
+
+    if ((uint32_t)(now / 1000) - g_snapshot_req_ms >= SNAPSHOT_ACTIVE_MS)
+    {
+        g_snapshot_active = 0;
+        xEventGroupClearBits(g_snapshot_event, g_snapshot_active_bit);  /* 轮询停止, 不再为抓图采集 */
+        return;
+    }
+
+    if (now - g_snapshot_last_us < (int64_t)SNAPSHOT_MIN_INTERVAL_MS * 1000 || fb->len > frame_pool_max())
+    {
+        return;
+    }
+
+    buf = frame_pool_alloc(fb->len);
+
+    if (buf == NULL)
+    {
+        return;                                                     /* 池已满: 保留旧缓存 */
+    }
+
+    memcpy(buf, fb->buf, fb->len);
+
+    xSemaphoreTake(g_snapshot_lock, portMAX_DELAY);
+
+    for (int i = 0; i < (int)(sizeof(g_snapshot_entry) / sizeof(g_snapshot_entry[0])) && e == NULL; i++)
+    {
+        if (g_snapshot_entry[i].refs == 0)
+        {
+            e = &g_snapshot_entry[i];
+        }
+    }
+
+    if (e == NULL)
+    {
+        xSemaphoreGive(g_snapshot_lock);
+        frame_pool_free(buf);                                       /* 旧缓存都还在发送: 本帧不更新 */
+        return;
+    }
+
+    e->buf = buf;
+    e->len = fb->len;
+    e->seq = ++g_snapshot_seq;
+    e->captured_us = now;
+    e->timestamp = fb->timestamp;
+    e->refs = 1;
+    old = g_snapshot_latest;
+    g_snapshot_latest = e;
+    g_snapshot_last_us = now;
+    xSemaphoreGive(g_snapshot_lock);
+
+    if (old != NULL)
+    {
+        snapshot_unref(old);
+    }
+#else
+    (void)fb;
+#endif
+}
+
+#if SNAPSHOT_EN
+/**
+ * @brief       取得最新帧的一个引用
+ * @param       max_age_us : 可接受的最大帧龄, 超过时返回NULL
+ * @retval      缓存, NULL:没有足够新的帧
+ */
+static snapshot_entry_t *snapshot_acquire(int64_t max_age_us)
+{
+    snapshot_entry_t *e;
+
+    xSemaphoreTake(g_snapshot_lock, portMAX_DELAY);
+    e = g_snapshot_latest;
+
+    if (e != NULL && esp_timer_get_time() - e->captured_us <= max_age_us)
+    {
+        e->refs++;
+    }
+    else
+    {
+        e = NULL;
+    }
+
+    xSemaphoreGive(g_snapshot_lock);
+    return e;
+}
+
+/**
+ * @brief       /snapshot.jpg 请求: 应答最新帧, If-None-Match 与当前ETag相同时应答304
+ * @param       req : 请求
+ * @retval      ESP_OK:成功; 其他:发送失败
+ */
+static esp_err_t snapshot_handler(httpd_req_t *req)
+{
+    char etag[SNAPSHOT_ETAG_MAX];
+    char match[SNAPSHOT_ETAG_MAX];
+    char ts[32];
+    snapshot_entry_t *e;
+    esp_err_t err;
+
+    g_snapshot_req_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    g_snapshot_active = 1;
+    xEventGroupSetBits(g_snapshot_event, g_snapshot_active_bit);   /* 无其他使用者时也开始采集 */
+
+    e = snapshot_acquire((int64_t)SNAPSHOT_MAX_AGE_MS * 1000);
+
+    for (int waited = 0; e == NULL && waited < SNAPSHOT_WAIT_MS; waited += SNAPSHOT_POLL_MS)
+    {
+        vTaskDelay(pdMS_TO_TICKS(SNAPSHOT_POLL_MS));
+        e = snapshot_acquire((int64_t)SNAPSHOT_MAX_AGE_MS * 1000);
+    }
+
+    if (e == NULL)
+    {
+        e = snapshot_acquire(INT64_MAX);                            /* 等不到新帧: 返回最后一帧 */
+    }
+
+    if (e == NULL)
+    {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        return httpd_resp_send(req, "no frame yet", HTTPD_RESP_USE_STRLEN);
+    }
+
+    snprintf(etag, sizeof(etag), "\"%08lx-%lu\"", (unsigned long)g_snapshot_boot, (unsigned long)e->seq);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK && strcmp(match, etag) == 0)
+    {
+        snapshot_unref(e);
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    snprintf(ts, sizeof(ts), "%lld.%06ld", (long long)e->timestamp.tv_sec, (long)e->timestamp.tv_usec);
+    httpd_resp_set_hdr(req, "X-Timestamp", ts);
+    httpd_resp_set_type(req, "image/jpeg");
+    err = httpd_resp_send(req, (const char *)e->buf, e->len);       /* 发送期间持有引用, 缓存可被替换但不会释放 */
+    snapshot_unref(e);
+    return err;
+}
+#endif
+
+/**
+ * @brief       初始化
+ * @param       event      : 事件组, 有轮询者时置位 active_bit(发送线程据此在无其他使用者时也采集)
+ * @param       active_bit : 事件位
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+esp_err_t snapshot_init(EventGroupHandle_t event, EventBits_t active_bit)
+{
+#if SNAPSHOT_EN
+    static StaticSemaphore_t lock_buf;
+    esp_err_t err = frame_pool_init();
+
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    g_snapshot_lock = xSemaphoreCreateMutexStatic(&lock_buf);
+    g_snapshot_event = event;
+    g_snapshot_active_bit = active_bit;
+    g_snapshot_boot = esp_random();
+#else
+    (void)event;
+    (void)active_bit;
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief       在HTTP服务上注册 /snapshot.jpg
+ * @param       server : HTTP服务句柄
+ * @retval      ESP_OK:成功; ESP_ERR_INVALID_STATE:未初始化; 其他:注册失败
+ */
+esp_err_t snapshot_register(httpd_handle_t server)
+{
+#if SNAPSHOT_EN
+    httpd_uri_t uri = { .uri = "/snapshot.jpg", .method = HTTP_GET, .handler = snapshot_handler };
+
+    if (g_snapshot_lock == NULL || g_snapshot_event == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return httpd_register_uri_handler(server, &uri);
+#else
+    (void)server;
+    return ESP_OK;
+#endif
+}
@@ -0,0 +1,49 @@
+/**
+ ****************************************************************************************************
+ * @file        snapshot.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       /snapshot.jpg: 由最新帧缓存应答的单帧抓图(引用计数, ETag/If-None-Match)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 监控系统每隔几秒轮询每台摄像头的 /snapshot.jpg; 每个请求调用 esp_camera_fb_get() 会与推流争抢帧缓存.
+ * 发送线程经 snapshot_offer() 把完成的帧拷贝到 frame_pool 槽位作为"最新帧", 请求只对该缓存增加一次引用后发送,
+ * 不占用驱动帧缓存, 多个轮询者同时请求也不产生额外的采集; 替换时旧缓存在最后一个请求发送完后才归还.
+ * 最近 SNAPSHOT_ACTIVE_MS 内没有请求时不拷贝(也不为抓图保持采集). 缓存比 SNAPSHOT_MAX_AGE_MS 旧时,
+ * 请求置位活动事件位并最多等待 SNAPSHOT_WAIT_MS 取得新帧. ETag 为开机随机数与缓存序号,
+ * If-None-Match 相同(帧未更新)时应答 304, 不重传图像.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __SNAPSHOT_H
+#define __SNAPSHOT_H
+
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+
+#define SNAPSHOT_EN                 1                               /* 1:使能 /snapshot.jpg */
+#define SNAPSHOT_ACTIVE_MS          30000                           /* 最后一次请求后继续更新缓存的时间 */
+#define SNAPSHOT_MIN_INTERVAL_MS    200                             /* 缓存更新的最小间隔(限制拷贝开销) */
+#define SNAPSHOT_MAX_AGE_MS         1000                            /* 缓存比该值旧时请求等待新帧 */
+#define SNAPSHOT_WAIT_MS            500                             /* 等待新帧的上限, 超时后返回旧帧或503 */
+
+/* 函数声明 */
+esp_err_t snapshot_init(EventGroupHandle_t event, EventBits_t active_bit);  /* 初始化, 有轮询者时置位 active_bit */
+esp_err_t snapshot_register(httpd_handle_t server);                 /* 在HTTP服务上注册 /snapshot.jpg */
+void snapshot_offer(const camera_fb_t *fb);                         /* 提交一帧(发送线程调用, 不阻塞) */
+
+#endif
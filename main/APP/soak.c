@@ -0,0 +1,269 @@
+/**
+ ****************************************************************************************************
+ * @file        soak.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       长时间稳定性测试: 推流期间每分钟汇总吞吐、时延、丢帧、各类堆内存与各任务栈余量, 用于发布前发现缓慢劣化
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "soak.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_log.h"
+#include "esp_camera.h"
+#include "wifi_config.h"
+#include "task_topo.h"
+#include "heap_stats.h"
+#include "frame_stats.h"
+#include "metrics.h"
+
+
+#if SOAK_EN
+static char g_soak_line[SOAK_LINE_SIZE];                            /* 采样线程生成的一行 */
+static int g_soak_len = 0;                                          /* 待发送的长度, 0:已取走 */
+static SemaphoreHandle_t g_soak_lock = NULL;
+static TaskStatus_t *g_soak_tasks = NULL;                           /* 任务状态表(PSRAM) */
+
+
+/**
+ * @brief       在行尾追加格式化文本(空间不足时截断, 之后的追加不再写入)
+ * @param       buf  : 缓冲
+ * @param       size : 缓冲大小
+ * @param       len  : 已有长度
+ * @param       fmt  : 格式
+ * @retval      新的长度(不超过 size - 1)
+ */
+static int soak_append(char *buf, size_t size, int len, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if ((size_t)len >= size - 1)
+    {
+        return len;
+    }
+
+    va_start(ap, fmt);
+    n = vsnprintf(buf + len, size - len, fmt, ap);
+    va_end(ap);
+
+    if (n < 0)
+    {
+        return len;
+    }
+
+    return ((size_t)(len + n) >= size) ? (int)size - 1 : len + n;
+}
+
+/**
+ * @brief       生成一分钟的JSON行
+ * @param       buf     : 输出缓冲(SOAK_LINE_SIZE)
+ * @param       minute  : 第几分钟
+ * @param       elapsed : 距上次采样的时间(us)
+ * @param       snap    : 本次 metrics 快照
+ * @param       last    : 上次 metrics 快照
+ * @param       cs      : 本次驱动统计
+ * @param       last_cs : 上次驱动统计
+ * @retval      长度, 0:缓冲不足
+ */
+static int soak_format(char *buf, uint32_t minute, int64_t elapsed,
+                       const metrics_snapshot_t *snap, const metrics_snapshot_t *last,
+                       const camera_stats_t *cs, const camera_stats_t *last_cs)
+{
+    heap_stats_caps_t caps[HEAP_STATS_CLASS_NUM];
+    wifi_ap_record_t ap;
+    uint32_t p50 = 0;
+    uint32_t p99 = 0;
+    uint32_t frames = snap->frames_sent - last->frames_sent;
+    double sec = (elapsed > 0) ? elapsed / 1e6 : 1.0;
+    int rssi = (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) ? ap.rssi : 0;
+    int len;
+
+    frame_stats_latency(FRAME_STAGE_TOTAL, &p50, &p99);
+    heap_stats_get(caps);
+
+    len = soak_append(buf, SOAK_LINE_SIZE, 0,
+                      "{\"min\":%lu,\"uptime_s\":%lld,\"frames\":%lu,\"fps\":%.2f,\"kbps\":%.1f,"
+                      "\"p50_us\":%lu,\"p99_us\":%lu,\"stale\":%lu,\"send_err\":%lu,\"offline\":%lu,"
+                      "\"fb_ovf\":%lu,\"fbq_ovf\":%lu,\"no_eoi\":%lu,\"disc\":%lu,\"rssi\":%d,\"heap\":{",
+                      (unsigned long)minute, (long long)(esp_timer_get_time() / 1000000),
+                      (unsigned long)frames, frames / sec, (snap->bytes_sent - last->bytes_sent) * 8 / 1000.0 / sec,
+                      (unsigned long)p50, (unsigned long)p99,
+                      (unsigned long)(snap->counters[METRIC_DROP_STALE] - last->counters[METRIC_DROP_STALE]),
+                      (unsigned long)(snap->counters[METRIC_DROP_SEND_ERROR] - last->counters[METRIC_DROP_SEND_ERROR]),
+                      (unsigned long)(snap->counters[METRIC_DROP_OFFLINE] - last->counters[METRIC_DROP_OFFLINE]),
+                      (unsigned long)(cs->fb_overflow - last_cs->fb_overflow),
+                      (unsigned long)(cs->fbq_overflow - last_cs->fbq_overflow),
+                      (unsigned long)(cs->no_eoi - last_cs->no_eoi),
+                      (unsigned long)wifi_sta_disconnects(), rssi);
+
+    for (int i = 0; i < HEAP_STATS_CLASS_NUM; i++)
+    {
+        len = soak_append(buf, SOAK_LINE_SIZE, len, "%s\"%s\":{\"free\":%u,\"largest\":%u,\"min_free\":%u,\"fails\":%lu}",
+                          (i > 0) ? "," : "", caps[i].name, (unsigned)caps[i].free_size, (unsigned)caps[i].largest,
+                          (unsigned)caps[i].min_free, (unsigned long)caps[i].fails);
+    }
+
+    len = soak_append(buf, SOAK_LINE_SIZE, len, "},\"stack\":{");
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    UBaseType_t count = uxTaskGetSystemState(g_soak_tasks, TASK_TOPO_TASK_MAX, NULL);
+
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        len = soak_append(buf, SOAK_LINE_SIZE, len, "%s\"%s\":%u", (i > 0) ? "," : "",
+                          g_soak_tasks[i].pcTaskName, (unsigned)g_soak_tasks[i].usStackHighWaterMark);  /* ESP-IDF中单位为字节 */
+    }
+#endif
+
+    len = soak_append(buf, SOAK_LINE_SIZE, len, "}}\n");
+
+    if (buf[len - 1] != '\n')
+    {
+        ESP_LOGW("soak", "report truncated, raise SOAK_LINE_SIZE");
+        return 0;
+    }
+
+    return len;
+}
+
+/**
+ * @brief       采样线程: 每 SOAK_REPORT_SEC 生成一行, 打印到串口并留给发送线程
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void soak_thread(void *pvParameters)
+{
+    static char line[SOAK_LINE_SIZE];
+    metrics_snapshot_t snap;
+    metrics_snapshot_t last;
+    camera_stats_t cs;
+    camera_stats_t last_cs;
+    TickType_t wake = xTaskGetTickCount();
+    int64_t last_us = esp_timer_get_time();
+    uint32_t minute = 0;
+    int len;
+
+    (void)pvParameters;
+    metrics_snapshot(&last);
+    esp_camera_get_stats(&last_cs);
+
+    while (1)
+    {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(SOAK_REPORT_SEC * 1000));
+
+        int64_t now = esp_timer_get_time();
+
+        minute++;
+        metrics_snapshot(&snap);
+        esp_camera_get_stats(&cs);
+        len = soak_format(line, minute, now - last_us, &snap, &last, &cs, &last_cs);
+        last = snap;
+        last_cs = cs;
+        last_us = now;
+
+        if (len > 0)
+        {
+            printf("SOAK %s", line);
+            xSemaphoreTake(g_soak_lock, portMAX_DELAY);
+            memcpy(g_soak_line, line, len);
+            g_soak_len = len;                                       /* 上一行未发出(断线)时被覆盖, 串口上仍完整 */
+            xSemaphoreGive(g_soak_lock);
+        }
+
+#if SOAK_WIFI_DROP_MIN > 0
+        if ((minute % SOAK_WIFI_DROP_MIN) == 0)
+        {
+            ESP_LOGI("soak", "minute %lu: dropping Wi-Fi", (unsigned long)minute);
+            esp_wifi_disconnect();                                  /* 断线事件中立即重连 */
+        }
+#endif
+    }
+}
+#endif
+
+/**
+ * @brief       启动采样线程(推流开始之前调用)
+ * @param       无
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+esp_err_t soak_start(void)
+{
+#if SOAK_EN
+    if (g_soak_lock != NULL)
+    {
+        return ESP_OK;
+    }
+
+    g_soak_tasks = heap_stats_malloc(HEAP_TAG_SOAK, TASK_TOPO_TASK_MAX * sizeof(TaskStatus_t), MALLOC_CAP_SPIRAM);
+    g_soak_lock = xSemaphoreCreateMutex();
+
+    if (g_soak_tasks == NULL || g_soak_lock == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(soak_thread, "soak_thread", SOAK_THREAD_STACK, NULL,
+                                SOAK_THREAD_PRIO, NULL, SOAK_THREAD_CORE) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI("soak", "reporting every %d s", SOAK_REPORT_SEC);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       取出待发送的一行(发送线程调用)
+ * @param       buf  : 输出缓冲
+ * @param       size : 缓冲大小(不小于 SOAK_LINE_SIZE)
+ * @retval      长度, 0:没有新的一行
+ */
+int soak_take(char *buf, size_t size)
+{
+#if SOAK_EN
+    int len = 0;
+
+    if (g_soak_lock == NULL || g_soak_len == 0)
+    {
+        return 0;
+    }
+
+    xSemaphoreTake(g_soak_lock, portMAX_DELAY);
+
+    if ((size_t)g_soak_len <= size)
+    {
+        len = g_soak_len;
+        memcpy(buf, g_soak_line, len);
+    }
+
+    g_soak_len = 0;
+    xSemaphoreGive(g_soak_lock);
+    return len;
+#else
+    (void)buf;
+    (void)size;
+    return 0;
+#endif
+}
@@ -0,0 +1,54 @@
+/**
+ ****************************************************************************************************
+ * @file        soak.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       长时间稳定性测试: 推流期间每分钟汇总吞吐、时延、丢帧、各类堆内存与各任务栈余量, 用于发布前发现缓慢劣化
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 稳定性测试固件: idf.py -B build_soak -D SOAK_BUILD=1 build(正常推流, 只多一个低优先级的采样线程).
+ * 每 SOAK_REPORT_SEC 输出一行JSON(以 "SOAK " 开头, 与基准测试的 "BENCH " 行相同的用法):
+ *     min/uptime_s     第几分钟/开机时间
+ *     frames/fps/kbps  本分钟发送的帧数、平均帧率与码率(metrics 的累计值之差)
+ *     p50_us/p99_us    最近一个完整统计窗口的端到端时延(frame_stats FRAME_STAGE_TOTAL), 没有窗口时为0
+ *     stale/send_err/offline  本分钟按原因分类的丢帧(metrics 计数之差)
+ *     fb_ovf/fbq_ovf/no_eoi   本分钟驱动丢帧(esp_camera_get_stats 之差)
+ *     disc/rssi        Wi-Fi累计断线次数与当前RSSI(未连接时为0)
+ *     heap             各类内存(dram/dma/psram)的剩余、最大空闲块、上电以来最小剩余与累计分配失败次数
+ *     stack            各任务栈的历史最小余量(字节, 需 CONFIG_FREERTOS_USE_TRACE_FACILITY)
+ * 已连接服务器时同一行以 FRAME_FLAG_STATS 帧在下一帧之前发送(lwip_send_pending), tools/pc_viewer/soak.py
+ * 作为服务器接收并写成每分钟一行的CSV, 同时按计划制造扰动(重启服务器、经控制通道切换分辨率、调用脚本关闭/打开AP),
+ * 结束时对帧率下降、各类内存的最小剩余/最大空闲块的变化斜率、栈余量与驱动丢帧按阈值判定, 超限时返回非0.
+ * SOAK_WIFI_DROP_MIN 非0时设备每隔这么多分钟主动断开一次Wi-Fi(事件处理立即重连), 不需要控制AP也能覆盖重连路径.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __SOAK_H
+#define __SOAK_H
+
+#include <stddef.h>
+#include "esp_err.h"
+
+
+#ifndef SOAK_EN
+#define SOAK_EN                     0                               /* 1:稳定性测试固件(CMake -D SOAK_BUILD=1 时置1) */
+#endif
+#define SOAK_REPORT_SEC             60                              /* 采样间隔 */
+#define SOAK_LINE_SIZE              2048                            /* 一行JSON的上限(约40个任务的栈余量) */
+#define SOAK_WIFI_DROP_MIN          0                               /* 每隔多少分钟主动断开一次Wi-Fi, 0:不断开 */
+
+/* 函数声明 */
+esp_err_t soak_start(void);                                         /* 启动采样线程 */
+int soak_take(char *buf, size_t size);                              /* 取出待发送的一行, 返回长度, 0:没有新的一行 */
+
+#endif
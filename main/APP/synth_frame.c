@@ -0,0 +1,289 @@
+/**
+ ****************************************************************************************************
+ * @file        synth_frame.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       合成帧源: 不经摄像头驱动, 以预分配的PSRAM缓冲按设定的帧率与帧长分布产生帧, 单独测量网络发送
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "synth_frame.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_log.h"
+#include "img_converters.h"
+#include "heap_stats.h"
+#include "metrics.h"
+
+
+#if SYNTH_FRAME_EN
+static camera_fb_t g_synth_fb[SYNTH_FRAME_BUFS];                    /* 帧描述, buf 指向各自的PSRAM缓冲 */
+static QueueHandle_t g_synth_free = NULL;                           /* 空闲缓冲 */
+static size_t g_synth_min = 0;                                      /* 实际最小帧长(不小于彩条JPEG) */
+static int64_t g_synth_next_us = 0;                                 /* 下一帧的节拍 */
+static uint32_t g_synth_seq = 0;
+
+/* 统计(只在取帧线程中更新) */
+static int64_t g_synth_report_us = 0;
+static uint32_t g_synth_frames = 0;
+static uint64_t g_synth_bytes = 0;
+static uint32_t g_synth_starved = 0;                                /* 无空闲缓冲 */
+static uint32_t g_synth_late = 0;                                   /* 取帧晚于节拍一个帧间隔以上 */
+
+
+/**
+ * @brief       生成RGB565彩条(白黄青绿品红蓝黑, 大端字节序, 与传感器输出相同)
+ * @param       buf    : 输出缓冲(width * height * 2 字节)
+ * @param       width  : 宽度
+ * @param       height : 高度
+ * @retval      无
+ */
+static void synth_frame_bars(uint8_t *buf, uint16_t width, uint16_t height)
+{
+    static const uint16_t bars[8] = { 0xFFFF, 0xFFE0, 0x07FF, 0x07E0, 0xF81F, 0xF800, 0x001F, 0x0000 };
+
+    for (uint16_t y = 0; y < height; y++)
+    {
+        for (uint16_t x = 0; x < width; x++)
+        {
+            uint16_t c = bars[(uint32_t)x * 8 / width];
+
+            *buf++ = (uint8_t)(c >> 8);
+            *buf++ = (uint8_t)c;
+        }
+    }
+}
+
+/**
+ * @brief       按分布选择本帧长度
+ * @param       无
+ * @retval      帧长
+ */
+static size_t synth_frame_size(void)
+{
+#if SYNTH_FRAME_DIST == SYNTH_DIST_FIXED
+    return SYNTH_FRAME_SIZE_MAX;
+#elif SYNTH_FRAME_DIST == SYNTH_DIST_KEY
+    return ((g_synth_seq % SYNTH_FRAME_KEY_INTERVAL) == 0) ? SYNTH_FRAME_SIZE_MAX : g_synth_min;
+#else
+    return g_synth_min + esp_random() % (SYNTH_FRAME_SIZE_MAX - g_synth_min + 1);
+#endif
+}
+
+/**
+ * @brief       每 SYNTH_FRAME_REPORT_MS 输出一行产生与发送的统计
+ * @param       now : 当前时间(us)
+ * @retval      无
+ */
+static void synth_frame_report(int64_t now)
+{
+    metrics_snapshot_t snap;
+    uint32_t ms;
+
+    if (g_synth_report_us == 0)
+    {
+        g_synth_report_us = now;
+        return;
+    }
+
+    ms = (uint32_t)((now - g_synth_report_us) / 1000);
+
+    if (ms < SYNTH_FRAME_REPORT_MS)
+    {
+        return;
+    }
+
+    metrics_snapshot(&snap);
+    ESP_LOGI("synth", "offered %.1f fps %.2f Mbps, sent %.1f fps %.2f Mbps, starved %lu, late %lu, stale %lu",
+             g_synth_frames * 1000.0f / ms, g_synth_bytes * 8.0f / ms / 1000.0f, snap.fps, snap.bitrate / 1e6f,
+             (unsigned long)g_synth_starved, (unsigned long)g_synth_late,
+             (unsigned long)snap.counters[METRIC_DROP_STALE]);
+
+    g_synth_report_us = now;
+    g_synth_frames = 0;
+    g_synth_bytes = 0;
+    g_synth_starved = 0;
+    g_synth_late = 0;
+}
+#endif
+
+/**
+ * @brief       分配缓冲并编码彩条JPEG
+ * @note        每个缓冲 SYNTH_FRAME_SIZE_MAX 字节: 彩条JPEG + 随机数据, 之后只改写帧长
+ * @param       无
+ * @retval      ESP_OK:成功; 其他:失败
+ */
+esp_err_t synth_frame_init(void)
+{
+#if SYNTH_FRAME_EN
+    size_t rgb_len = (size_t)SYNTH_FRAME_WIDTH * SYNTH_FRAME_HEIGHT * 2;
+    uint8_t *rgb;
+    size_t jpg_len = 0;
+    bool ok;
+
+    if (g_synth_free != NULL)
+    {
+        return ESP_OK;
+    }
+
+    for (int i = 0; i < SYNTH_FRAME_BUFS; i++)
+    {
+        g_synth_fb[i].buf = heap_stats_malloc(HEAP_TAG_SYNTH, SYNTH_FRAME_SIZE_MAX, MALLOC_CAP_SPIRAM);
+
+        if (g_synth_fb[i].buf == NULL)
+        {
+            ESP_LOGE("synth", "no memory for %d x %d bytes", SYNTH_FRAME_BUFS, SYNTH_FRAME_SIZE_MAX);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    rgb = heap_stats_malloc(HEAP_TAG_SYNTH, rgb_len, MALLOC_CAP_SPIRAM);
+
+    if (rgb == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    synth_frame_bars(rgb, SYNTH_FRAME_WIDTH, SYNTH_FRAME_HEIGHT);
+    ok = fmt2jpg_buf(rgb, rgb_len, SYNTH_FRAME_WIDTH, SYNTH_FRAME_HEIGHT, PIXFORMAT_RGB565, SYNTH_FRAME_QUALITY,
+                     g_synth_fb[0].buf, SYNTH_FRAME_SIZE_MAX, NULL, &jpg_len);
+    heap_stats_free(HEAP_TAG_SYNTH, rgb);
+
+    if (!ok)
+    {
+        ESP_LOGE("synth", "test pattern does not fit in %d bytes", SYNTH_FRAME_SIZE_MAX);
+        return ESP_FAIL;
+    }
+
+    esp_fill_random(g_synth_fb[0].buf + jpg_len, SYNTH_FRAME_SIZE_MAX - jpg_len);   /* 不可压缩, 与真实的熵编码数据相当 */
+    g_synth_min = (jpg_len > SYNTH_FRAME_SIZE_MIN) ? jpg_len : SYNTH_FRAME_SIZE_MIN;
+
+    g_synth_free = xQueueCreate(SYNTH_FRAME_BUFS, sizeof(camera_fb_t *));
+
+    if (g_synth_free == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < SYNTH_FRAME_BUFS; i++)
+    {
+        camera_fb_t *fb = &g_synth_fb[i];
+
+        if (i > 0)
+        {
+            memcpy(fb->buf, g_synth_fb[0].buf, SYNTH_FRAME_SIZE_MAX);
+        }
+
+        fb->width = SYNTH_FRAME_WIDTH;
+        fb->height = SYNTH_FRAME_HEIGHT;
+        fb->format = PIXFORMAT_JPEG;
+        xQueueSend(g_synth_free, &fb, 0);
+    }
+
+    ESP_LOGI("synth", "%d fps, %u..%d bytes (dist %d), %d buffers, pattern %u bytes",
+             SYNTH_FRAME_FPS, (unsigned)g_synth_min, SYNTH_FRAME_SIZE_MAX, SYNTH_FRAME_DIST, SYNTH_FRAME_BUFS,
+             (unsigned)jpg_len);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief       按帧率节拍取一帧(代替 esp_camera_fb_get)
+ * @note        节拍落后一个帧间隔以上时从当前时刻重新计时, 不补发积压的帧(与传感器的行为相同)
+ * @param       无
+ * @retval      帧缓存, NULL:SYNTH_FRAME_WAIT_MS 内没有空闲缓冲
+ */
+camera_fb_t *synth_frame_get(void)
+{
+#if SYNTH_FRAME_EN
+    const int64_t period = 1000000 / SYNTH_FRAME_FPS;
+    camera_fb_t *fb = NULL;
+    int64_t now = esp_timer_get_time();
+
+    if (g_synth_free == NULL)
+    {
+        vTaskDelay(pdMS_TO_TICKS(SYNTH_FRAME_WAIT_MS));
+        return NULL;
+    }
+
+    if (g_synth_next_us == 0 || now - g_synth_next_us > period)
+    {
+        g_synth_late += (g_synth_next_us != 0);
+        g_synth_next_us = now;
+    }
+    else if (g_synth_next_us > now)
+    {
+        vTaskDelay(pdMS_TO_TICKS((g_synth_next_us - now + 999) / 1000));
+    }
+
+    g_synth_next_us += period;
+
+    if (xQueueReceive(g_synth_free, &fb, pdMS_TO_TICKS(SYNTH_FRAME_WAIT_MS)) != pdTRUE)
+    {
+        g_synth_starved++;
+        return NULL;
+    }
+
+    now = esp_timer_get_time();
+    fb->len = synth_frame_size();
+    fb->timestamp.tv_sec = now / 1000000;
+    fb->timestamp.tv_usec = now % 1000000;
+    g_synth_seq++;
+    g_synth_frames++;
+    g_synth_bytes += fb->len;
+
+    synth_frame_report(now);
+    return fb;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * @brief       归还缓冲(代替 esp_camera_fb_return)
+ * @param       fb : synth_frame_get() 取得的帧
+ * @retval      无
+ */
+void synth_frame_return(camera_fb_t *fb)
+{
+#if SYNTH_FRAME_EN
+    if (synth_frame_is(fb))
+    {
+        xQueueSend(g_synth_free, &fb, 0);
+    }
+#else
+    (void)fb;
+#endif
+}
+
+/**
+ * @brief       判断帧缓存是否为合成帧
+ * @param       fb : 帧缓存
+ * @retval      1:是; 0:否
+ */
+int synth_frame_is(const camera_fb_t *fb)
+{
+#if SYNTH_FRAME_EN
+    return fb >= &g_synth_fb[0] && fb < &g_synth_fb[SYNTH_FRAME_BUFS];
+#else
+    (void)fb;
+    return 0;
+#endif
+}
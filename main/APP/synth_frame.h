@@ -0,0 +1,65 @@
+/**
+ ****************************************************************************************************
+ * @file        synth_frame.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       合成帧源: 不经摄像头驱动, 以预分配的PSRAM缓冲按设定的帧率与帧长分布产生帧, 单独测量网络发送
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 合成帧固件: idf.py -B build_synth -D SYNTH_BUILD=1 build.
+ * SYNTH_FRAME_EN 为1时推流线程从 synth_frame_get() 取帧而不是 esp_camera_fb_get(), 其余发送路径
+ * (流水线/串行、零拷贝、拥塞丢帧、码率控制)不变, 边采集边发送关闭; app_main 不启动取景、移动侦测、人脸检测与音频.
+ * 每个缓冲开头是启动时编码一次的彩条JPEG, EOI之后以随机数据补足到本帧长度(接收端按长度收帧, 解码时忽略EOI之后的数据),
+ * 每帧只改写长度与时间戳, 不拷贝数据, 因此帧源本身几乎不占CPU.
+ * 结果与摄像头推流使用相同的统计出口: frame_stats(APPQ 为产生到开始发送, TX 为发送阻塞时间, TOTAL 为产生到确认)、
+ * /metrics(推流帧率、码率、发送耗时直方图)与屏幕状态显示; 帧源另每 SYNTH_FRAME_REPORT_MS 输出一行
+ * 产生帧率、产生码率、无空闲缓冲次数(缓冲全部在发送或等待确认)与未赶上节拍的次数.
+ * 与只测采集的基准测试(bench.h)互补: 后者测量传感器与驱动, 本模式只测量网络.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __SYNTH_FRAME_H
+#define __SYNTH_FRAME_H
+
+#include "esp_camera.h"
+#include "esp_err.h"
+
+
+#ifndef SYNTH_FRAME_EN
+#define SYNTH_FRAME_EN              0                               /* 1:合成帧固件(CMake -D SYNTH_BUILD=1 时置1) */
+#endif
+
+/* 帧长分布 */
+#define SYNTH_DIST_FIXED            0                               /* 每帧 SYNTH_FRAME_SIZE_MAX */
+#define SYNTH_DIST_UNIFORM          1                               /* SYNTH_FRAME_SIZE_MIN..MAX 均匀分布 */
+#define SYNTH_DIST_KEY              2                               /* 每 SYNTH_FRAME_KEY_INTERVAL 帧一帧 MAX, 其余 MIN */
+
+#define SYNTH_FRAME_FPS             25                              /* 产生帧率 */
+#define SYNTH_FRAME_DIST            SYNTH_DIST_UNIFORM              /* 帧长分布 */
+#define SYNTH_FRAME_SIZE_MIN        (20 * 1024)                     /* 最小帧长(不小于彩条JPEG本身) */
+#define SYNTH_FRAME_SIZE_MAX        (60 * 1024)                     /* 最大帧长, 也是每个缓冲的大小 */
+#define SYNTH_FRAME_KEY_INTERVAL    25                              /* SYNTH_DIST_KEY 的大帧间隔 */
+#define SYNTH_FRAME_BUFS            4                               /* 缓冲数(相当于驱动的 fb_count) */
+#define SYNTH_FRAME_WIDTH           320                             /* 彩条JPEG的分辨率 */
+#define SYNTH_FRAME_HEIGHT          240
+#define SYNTH_FRAME_QUALITY         12                              /* 彩条JPEG的质量 */
+#define SYNTH_FRAME_WAIT_MS         1000                            /* 无空闲缓冲时的最长等待(与驱动取帧超时相当) */
+#define SYNTH_FRAME_REPORT_MS       5000                            /* 统计输出间隔 */
+
+/* 函数声明 */
+esp_err_t synth_frame_init(void);                                   /* 分配缓冲并编码彩条JPEG */
+camera_fb_t *synth_frame_get(void);                                 /* 按帧率节拍取一帧, NULL:无空闲缓冲 */
+void synth_frame_return(camera_fb_t *fb);                           /* 归还缓冲 */
+int synth_frame_is(const camera_fb_t *fb);                          /* 1:fb 是合成帧 */
+
+#endif
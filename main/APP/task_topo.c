@@ -0,0 +1,206 @@
+/**
+ ****************************************************************************************************
+ * @file        task_topo.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       任务布局: 所有线程的运行核、优先级与栈大小, 以及各任务的CPU占用统计
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "task_topo.h"
+#include <stdio.h>
+#include <string.h>
+
+
+#if TASK_TOPO_STATS_EN && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+static TaskStatus_t g_topo_status[TASK_TOPO_TASK_MAX];              /* 本次快照 */
+static TaskHandle_t g_topo_prev_handle[TASK_TOPO_TASK_MAX];         /* 上次快照的任务与运行时间 */
+static configRUN_TIME_COUNTER_TYPE g_topo_prev_counter[TASK_TOPO_TASK_MAX];
+static UBaseType_t g_topo_prev_count = 0;
+static configRUN_TIME_COUNTER_TYPE g_topo_prev_total = 0;
+static configRUN_TIME_COUNTER_TYPE g_load_prev_idle[portNUM_PROCESSORS];  /* task_topo_core_load() 上次的空闲任务运行时间 */
+static configRUN_TIME_COUNTER_TYPE g_load_prev_total = 0;
+
+/**
+ * @brief       查找任务在上次快照中的运行时间
+ * @param       handle : 任务句柄
+ * @retval      上次的运行时间, 新建的任务为0
+ */
+static configRUN_TIME_COUNTER_TYPE task_topo_prev(TaskHandle_t handle)
+{
+    for (UBaseType_t i = 0; i < g_topo_prev_count; i++)
+    {
+        if (g_topo_prev_handle[i] == handle)
+        {
+            return g_topo_prev_counter[i];
+        }
+    }
+
+    return 0;
+}
+#endif
+
+/**
+ * @brief       输出自上次调用以来各任务的CPU占用(只由发送线程调用, 不可重入)
+ * @note        基于 uxTaskGetSystemState()(vTaskGetRunTimeStats() 的底层接口, 可限制输出长度并计算区间占用),
+ *              占用按单核100%计算, 每行: 任务名 核 优先级 占用% 栈剩余字节; 首次调用输出上电以来的累计占用
+ * @param       buf  : 输出缓冲
+ * @param       size : 缓冲大小
+ * @retval      输出长度; 0:未使能运行时间统计
+ */
+int task_topo_format(char *buf, size_t size)
+{
+#if TASK_TOPO_STATS_EN && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    configRUN_TIME_COUNTER_TYPE elapsed;
+    configRUN_TIME_COUNTER_TYPE run;
+    UBaseType_t count;
+    BaseType_t core;
+    int len;
+    int n;
+
+    count = uxTaskGetSystemState(g_topo_status, TASK_TOPO_TASK_MAX, &total);
+
+    if (count == 0 || size == 0)
+    {
+        return 0;                                                   /* 任务数超过 TASK_TOPO_TASK_MAX */
+    }
+
+    elapsed = total - g_topo_prev_total;
+    len = snprintf(buf, size, "task            core prio  cpu%%  stack\n");
+
+    for (UBaseType_t i = 0; i < count && len > 0 && (size_t)len < size; i++)
+    {
+        run = g_topo_status[i].ulRunTimeCounter - task_topo_prev(g_topo_status[i].xHandle);
+        core = xTaskGetCoreID(g_topo_status[i].xHandle);
+
+        n = snprintf(buf + len, size - len, "%-16s %-3s %4u %5.1f %6u\n",
+                     g_topo_status[i].pcTaskName,
+                     (core == tskNO_AFFINITY) ? "-" : (core == 0) ? "0" : "1",
+                     (unsigned)g_topo_status[i].uxCurrentPriority,
+                     (elapsed > 0) ? (double)run * 100.0 / (double)elapsed : 0.0,
+                     (unsigned)g_topo_status[i].usStackHighWaterMark);
+
+        if (n < 0)
+        {
+            break;
+        }
+
+        len += n;
+    }
+
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        g_topo_prev_handle[i] = g_topo_status[i].xHandle;
+        g_topo_prev_counter[i] = g_topo_status[i].ulRunTimeCounter;
+    }
+
+    g_topo_prev_count = count;
+    g_topo_prev_total = total;
+
+    return ((size_t)len < size) ? len : (int)size - 1;
+#else
+    (void)buf;
+    (void)size;
+    return 0;
+#endif
+}
+
+/**
+ * @brief       计算自上次调用以来各核的CPU占用(只由一个线程调用, 与 task_topo_format() 共用快照缓冲)
+ * @note        占用 = 100% - 该核空闲任务的运行时间占比; 首次调用为上电以来的平均占用
+ * @param       load : 输出各核占用(%), 未使能运行时间统计时为0
+ * @retval      无
+ */
+void task_topo_core_load(float load[portNUM_PROCESSORS])
+{
+#if TASK_TOPO_STATS_EN && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    configRUN_TIME_COUNTER_TYPE idle;
+    configRUN_TIME_COUNTER_TYPE elapsed;
+    UBaseType_t count;
+
+    count = uxTaskGetSystemState(g_topo_status, TASK_TOPO_TASK_MAX, &total);
+    elapsed = total - g_load_prev_total;
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        idle = 0;
+        load[core] = 0;
+
+        for (UBaseType_t i = 0; i < count; i++)
+        {
+            if (g_topo_status[i].xHandle == xTaskGetIdleTaskHandleForCore(core))
+            {
+                idle = g_topo_status[i].ulRunTimeCounter;
+                break;
+            }
+        }
+
+        if (count > 0 && elapsed > 0)
+        {
+            load[core] = 100.0f - (float)(idle - g_load_prev_idle[core]) * 100.0f / (float)elapsed;
+        }
+
+        g_load_prev_idle[core] = idle;
+    }
+
+    g_load_prev_total = total;
+#else
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        load[core] = 0;
+    }
+#endif
+}
+
+/**
+ * @brief       计算自上次采样以来单个任务的CPU占用(可重入, 不使用快照缓冲)
+ * @note        基于 vTaskGetInfo() 只读取一个任务; 空闲任务的占用即该核的空闲比例; 首次采样(cursor 清零)为上电以来的平均占用
+ * @param       handle : 任务句柄
+ * @param       cursor : 调用者持有的采样点, 返回时更新为本次采样
+ * @retval      占用(%, 按单核100%计算); 任务句柄为NULL或未使能运行时间统计时为0
+ */
+float task_topo_task_load(TaskHandle_t handle, task_topo_cursor_t *cursor)
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    TaskStatus_t status;
+    configRUN_TIME_COUNTER_TYPE total;
+    configRUN_TIME_COUNTER_TYPE elapsed;
+    float load = 0;
+
+    if (handle == NULL)
+    {
+        return 0;
+    }
+
+    vTaskGetInfo(handle, &status, pdFALSE, eRunning);               /* 不计算栈剩余, 不查询状态 */
+    total = portGET_RUN_TIME_COUNTER_VALUE();
+    elapsed = total - cursor->total;
+
+    if (elapsed > 0)
+    {
+        load = (float)(status.ulRunTimeCounter - cursor->run) * 100.0f / (float)elapsed;
+        load = (load > 100.0f) ? 100.0f : load;
+    }
+
+    cursor->total = total;
+    cursor->run = status.ulRunTimeCounter;
+    return load;
+#else
+    (void)handle;
+    (void)cursor;
+    return 0;
+#endif
+}
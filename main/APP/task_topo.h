@@ -0,0 +1,167 @@
+/**
+ ****************************************************************************************************
+ * @file        task_topo.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       任务布局: 所有线程的运行核、优先级与栈大小, 以及各任务的CPU占用统计
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 本文件集中定义固件创建的每一个线程的运行核(_CORE)、优先级(_PRIO)与栈大小(_STACK), 各模块只引用这里的宏.
+ * 推荐布局: 核0(TASK_CORE_NET)运行 Wi-Fi、lwIP(tiT)与所有套接字收发线程, 核1(TASK_CORE_CAM)运行
+ * 摄像头驱动(cam_task)、采集与所有解码/编码/分析线程, 两个核上的高优先级线程互不抢占.
+ * 不由本工程创建的任务在 sdkconfig 中固定:
+ *     cam_task        CONFIG_CAMERA_CORE1                      优先级 configMAX_PRIORITIES - 2
+ *     tiT(lwIP)       CONFIG_LWIP_TCPIP_TASK_AFFINITY_CPU0     优先级 CONFIG_LWIP_TCPIP_TASK_PRIO
+ *     wifi            CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_0
+ *     main/esp_timer  CONFIG_ESP_MAIN_TASK_AFFINITY_CPU0 / CONFIG_ESP_TIMER_TASK_AFFINITY_CPU0
+ *                     main 任务最后运行 lwip_demo() 的网络事件循环(连接、控制通道接收、断线处理、服务器发现)
+ *     xl9555_event    components/BSP/XL9555 中创建, 不绑定核(只等待IO中断)
+ *     mqtt_task       CONFIG_MQTT_USE_CORE_0                   优先级 MQTT_CLIENT_PRIO(MQTT_EVENTS_EN 时由 esp-mqtt 创建)
+ * 同一个核上的优先级顺序: 采集/发送(10) > 音频(8) > 负载调控(7) > 码率控制、MJPEG客户端(6) > 取景、启动、按键(5)
+ *     > 移动侦测、转码、写卡(4) > 断线缓存、连拍、事件发布(3) > 屏幕状态显示(2).
+ * 长期运行的线程及其队列/信号量/事件组均为静态创建(xTaskCreateStaticPinnedToCore、xQueueCreateStatic 等):
+ *     栈(ESP-IDF 中 StackType_t 为字节, 数组长度即 _STACK)、TCB与队列存储是各模块内的静态数组, 链接时放在内部RAM,
+ *     上电即占用固定大小, 断线重连、切换分辨率后不会因堆碎片而创建失败. cam_task 与驱动的帧队列由
+ *     CONFIG_CAMERA_TASK_STATIC 同样静态创建. 只运行一次或按连接创建后自行删除的线程(启动、连拍、MJPEG客户端、
+ *     测试固件)仍从堆创建. 调整 _STACK 时参考 task_topo_format() 输出的栈剩余(静态栈占用固定的内部RAM, 过大即浪费).
+ * TASK_TOPO_STATS_EN 为1时(需 CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS), task_topo_format() 输出自上次调用以来
+ * 每个任务的核、优先级、CPU占用与栈剩余, 附在服务器的"stats"回复之后.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __TASK_TOPO_H
+#define __TASK_TOPO_H
+
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+
+#define TASK_CORE_NET               0                               /* Wi-Fi、lwIP与套接字收发 */
+#define TASK_CORE_CAM               1                               /* 摄像头驱动、采集、编解码与分析 */
+#define TASK_TOPO_STATS_EN          1                               /* 1:"stats"回复中附带各任务CPU占用 */
+#define TASK_TOPO_TASK_MAX          40                              /* 统计的任务数上限 */
+
+/* 启动(main.c) */
+#define BOOT_NET_CORE               TASK_CORE_NET                   /* LCD/WIFI启动线程 */
+#define BOOT_NET_PRIO               5
+#define BOOT_NET_STACK              (6 * 1024)
+
+/* 采集与发送(lwip_demo.c) */
+#define LWIP_CAPTURE_THREAD_CORE    TASK_CORE_CAM                   /* 采集线程, 与 cam_task 同核 */
+#define LWIP_CAPTURE_THREAD_PRIO    10
+#define LWIP_CAPTURE_THREAD_STACK   (2 * 1024)
+#define LWIP_SEND_THREAD_CORE       TASK_CORE_NET                   /* 发送线程, 与 lwIP 同核 */
+#define LWIP_SEND_THREAD_PRIO       10
+#define LWIP_SEND_THREAD_STACK      (4 * 1024)
+#define LWIP_KEY_THREAD_CORE        tskNO_AFFINITY                  /* 按键事件线程 */
+#define LWIP_KEY_THREAD_PRIO        5
+#define LWIP_KEY_THREAD_STACK       (2 * 1024)
+
+/* 音频(av_audio.cc) */
+#define AV_AUDIO_THREAD_CORE        TASK_CORE_CAM                   /* 高于取景, 低于采集 */
+#define AV_AUDIO_THREAD_PRIO        8
+#define AV_AUDIO_THREAD_STACK       (4 * 1024)
+
+/* 码率控制(rate_ctrl.c) */
+#define RATE_CTRL_THREAD_CORE       TASK_CORE_CAM                   /* 传感器配置(SCCB), 低于采集与发送 */
+#define RATE_CTRL_THREAD_PRIO       6
+#define RATE_CTRL_THREAD_STACK      (3 * 1024)
+
+/* 负载调控(load_gov.c) */
+#define LOAD_GOV_THREAD_CORE        TASK_CORE_NET                   /* 每周期采样一次, 不与摄像头核上被调控的线程争抢 */
+#define LOAD_GOV_THREAD_PRIO        7
+#define LOAD_GOV_THREAD_STACK       (3 * 1024)
+
+/* MJPEG HTTP服务(mjpeg_server.c) */
+#define MJPEG_HTTPD_CORE            TASK_CORE_NET                   /* httpd 任务 */
+#define MJPEG_HTTPD_PRIO            5
+#define MJPEG_HTTPD_STACK           (4 * 1024)
+#define MJPEG_CLIENT_THREAD_CORE    TASK_CORE_NET                   /* 客户端发送线程, 低于摄像头发送线程 */
+#define MJPEG_CLIENT_THREAD_PRIO    6
+#define MJPEG_CLIENT_THREAD_STACK   (4 * 1024)                      /* 含 jpg_requant 转码 */
+
+/* LCD取景(lcd_preview.c) */
+#define LCD_PREVIEW_THREAD_CORE     TASK_CORE_CAM                   /* 解码 + SPI刷屏, 低于网络收发 */
+#define LCD_PREVIEW_THREAD_PRIO     5
+#define LCD_PREVIEW_THREAD_STACK    (4 * 1024)
+#define LCD_HUD_THREAD_CORE         TASK_CORE_CAM                   /* 状态显示(lcd_hud.c), 非网络核上最低 */
+#define LCD_HUD_THREAD_PRIO         2
+#define LCD_HUD_THREAD_STACK        (3 * 1024)
+
+/* 分析与转码 */
+#define MOTION_THREAD_CORE          TASK_CORE_CAM                   /* 移动侦测(motion_detect.c), 低于取景 */
+#define MOTION_THREAD_PRIO          4
+#define MOTION_THREAD_STACK         (4 * 1024)
+#define FACE_DETECT_THREAD_CORE     TASK_CORE_CAM                   /* 人脸检测(face_detect.cc), 与移动侦测同级 */
+#define FACE_DETECT_THREAD_PRIO     4
+#define FACE_DETECT_THREAD_STACK    (8 * 1024)                      /* ESP-DL 推理 */
+#define DUAL_STREAM_THREAD_CORE     TASK_CORE_CAM                   /* 低分辨率转码(dual_stream.c) */
+#define DUAL_STREAM_THREAD_PRIO     4
+#define DUAL_STREAM_THREAD_STACK    (6 * 1024)
+#define H264_STREAM_THREAD_CORE     TASK_CORE_CAM                   /* H.264软件编码(h264_stream.c), 与转码同级 */
+#define H264_STREAM_THREAD_PRIO     4
+#define H264_STREAM_THREAD_STACK    (8 * 1024)                      /* 软件编码器的运动搜索与码率控制 */
+
+/* 存储 */
+#define SD_RECORD_THREAD_CORE       TASK_CORE_CAM                   /* 写卡线程(sd_recorder.c), 低于采集/发送/取景 */
+#define SD_RECORD_THREAD_PRIO       4
+#define SD_RECORD_THREAD_STACK      (4 * 1024)
+#define FRAME_SPOOL_THREAD_CORE     TASK_CORE_NET                   /* 断线缓存写入/回填(frame_spool.c), 回填经发送回调走网络 */
+#define FRAME_SPOOL_THREAD_PRIO     3
+#define FRAME_SPOOL_THREAD_STACK    (4 * 1024)
+#define BURST_CAPTURE_THREAD_CORE   TASK_CORE_CAM                   /* 连拍(burst_capture.c), 恢复传感器设置、选帧评分、交付整批 */
+#define BURST_CAPTURE_THREAD_PRIO   3
+#define BURST_CAPTURE_THREAD_STACK  (4 * 1024)
+#define FRAME_REPLAY_THREAD_CORE    TASK_CORE_CAM                   /* 录像重放(frame_replay.c), 代替 cam_task 注入帧, 与采集线程同优先级 */
+#define FRAME_REPLAY_THREAD_PRIO    10
+#define FRAME_REPLAY_THREAD_STACK   (4 * 1024)
+
+/* 事件发布(mqtt_events.c) */
+#define MQTT_EVENTS_THREAD_CORE     TASK_CORE_NET                   /* 封存与发布批次, 与断线缓存同级 */
+#define MQTT_EVENTS_THREAD_PRIO     3
+#define MQTT_EVENTS_THREAD_STACK    (3 * 1024)
+#define MQTT_CLIENT_PRIO            3                               /* esp-mqtt 任务(核由 CONFIG_MQTT_USE_CORE_0 固定) */
+#define MQTT_CLIENT_STACK           (4 * 1024)                      /* mqtts:// 需加大到 6K 以上 */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 基准测试固件(bench.c, BENCH_EN), 替代采集/发送线程 */
+#define BENCH_THREAD_CORE           TASK_CORE_NET                   /* 采集 + 阻塞发送, 与 lwIP 同核 */
+#define BENCH_THREAD_PRIO           10
+#define BENCH_THREAD_STACK          (6 * 1024)
+
+/* 长时间稳定性测试(soak.c, SOAK_EN), 每分钟采样一次 */
+#define SOAK_THREAD_CORE            TASK_CORE_NET                   /* 只读取统计, 不与摄像头核上的线程争抢 */
+#define SOAK_THREAD_PRIO            2
+#define SOAK_THREAD_STACK           (4 * 1024)
+
+/* 单个任务的CPU占用采样点(调用者持有, 各调用者互不影响) */
+typedef struct
+{
+    configRUN_TIME_COUNTER_TYPE total;                              /* 上次采样的运行时间基准 */
+    configRUN_TIME_COUNTER_TYPE run;                                /* 上次采样时任务的运行时间 */
+} task_topo_cursor_t;
+
+/* 函数声明 */
+int task_topo_format(char *buf, size_t size);                       /* 输出自上次调用以来各任务的CPU占用, 返回长度 */
+void task_topo_core_load(float load[portNUM_PROCESSORS]);           /* 自上次调用以来各核的CPU占用(%) */
+float task_topo_task_load(TaskHandle_t handle, task_topo_cursor_t *cursor);    /* 自上次采样以来单个任务的CPU占用(%, 可重入) */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
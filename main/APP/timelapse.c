@@ -0,0 +1,248 @@
+/**
+ ****************************************************************************************************
+ * @file        timelapse.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       定时拍摄(两次拍摄之间传感器待机、CPU浅睡眠, WIFI保持关联)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "timelapse.h"
+#include "lwip_demo.h"
+#include "frame_proto.h"
+#include "cam_resume.h"
+#include "clock_sync.h"
+#include "wifi_profile.h"
+#include "pm_ctrl.h"
+#include "tls_stream.h"
+#include "net_qos.h"
+#include "xl9555.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+
+/**
+ * @brief       发送全部数据(TLS_STREAM_EN 时加密发送)
+ * @param       sock : 套接字(已设置 SO_SNDTIMEO)
+ * @param       data : 数据
+ * @param       len  : 数据长度
+ * @retval      0:成功; -1:出错或超时
+ */
+static int timelapse_send_all(int sock, const void *data, size_t len)
+{
+#if TLS_STREAM_EN
+    (void)sock;
+    return tls_stream_send(data, len);
+#else
+    const uint8_t *p = (const uint8_t *)data;
+    int ret;
+
+    while (len > 0)
+    {
+        ret = send(sock, p, len, 0);
+
+        if (ret > 0)
+        {
+            p += ret;
+            len -= ret;
+        }
+        else if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+#endif
+}
+
+/**
+ * @brief       连接服务器并发送一帧, 发完后断开
+ * @param       addr : 服务器地址
+ * @param       fb   : 帧缓存
+ * @param       seq  : 帧序号
+ * @retval      0:成功; -1:失败
+ */
+static int timelapse_upload(const struct sockaddr_in *addr, const camera_fb_t *fb, uint32_t seq)
+{
+    frame_header_t hdr;
+    struct timeval tv = { .tv_sec = TIMELAPSE_CONNECT_MS / 1000, .tv_usec = (TIMELAPSE_CONNECT_MS % 1000) * 1000 };
+    int so_err = 0;
+    socklen_t len = sizeof(so_err);
+    fd_set wset;
+    int flags;
+    int ret = -1;
+    int sock;
+
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+
+    if (sock < 0)
+    {
+        return -1;
+    }
+
+    net_qos_set(sock, NET_QOS_BULK_DSCP);                           /* 上传不急, 走AC_BK让出空口 */
+
+    /* 非阻塞连接, 超时放弃 */
+    flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+    if (connect(sock, (const struct sockaddr *)addr, sizeof(*addr)) == 0)
+    {
+        ret = 0;
+    }
+    else if (errno == EINPROGRESS)
+    {
+        FD_ZERO(&wset);
+        FD_SET(sock, &wset);
+
+        if (select(sock + 1, NULL, &wset, NULL, &tv) > 0 &&
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &so_err, &len) == 0 && so_err == 0)
+        {
+            ret = 0;
+        }
+    }
+
+    fcntl(sock, F_SETFL, flags);
+
+    if (ret == 0)
+    {
+        tv.tv_sec = TIMELAPSE_SEND_TIMEOUT_MS / 1000;
+        tv.tv_usec = (TIMELAPSE_SEND_TIMEOUT_MS % 1000) * 1000;
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+#if TLS_STREAM_EN
+        ret = tls_stream_open(sock);                                /* 每个周期重连, 第二次起以会话票据恢复 */
+#endif
+    }
+
+    if (ret == 0)
+    {
+        frame_header_fill(&hdr, fb, seq);
+        hdr.timestamp_us = clock_sync_to_common((int64_t)hdr.timestamp_us);
+
+        ret = timelapse_send_all(sock, &hdr, sizeof(hdr));
+
+        if (ret == 0)
+        {
+            ret = timelapse_send_all(sock, fb->buf, fb->len);
+        }
+
+#if TLS_STREAM_EN
+        tls_stream_close();                                         /* close_notify */
+#endif
+        shutdown(sock, SHUT_WR);                                    /* 发送FIN, 服务器读完本帧后关闭 */
+    }
+
+    closesocket(sock);
+    return ret;
+}
+
+/**
+ * @brief       定时拍摄模式(不返回)
+ * @param       config : 摄像头配置(驱动已由 init_camera 初始化并完成曝光收敛)
+ * @retval      无
+ */
+void timelapse_run(camera_config_t *config)
+{
+    struct sockaddr_in addr;
+    camera_fb_t *fb;
+    uint32_t seq = 0;
+    int64_t next_us;
+    int64_t wake_us;
+    int64_t now;
+    int first = 1;
+    pm_ctrl_stats_t pm;
+
+    (void)config;
+    pm_ctrl_get_stats(&pm);
+
+    if (!pm.light_sleep)
+    {
+        ESP_LOGW("TAG", "timelapse: light sleep not configured, CPU stays awake between captures");
+    }
+
+    clock_sync_init();                                              /* 校时前帧头仍为 esp_timer 时间 */
+
+    memset(&addr, 0, sizeof(addr));
+    inet_pton(AF_INET, IP_ADDR, &addr.sin_addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(LWIP_DEMO_PORT);
+
+    next_us = esp_timer_get_time();
+
+    while (1)
+    {
+        pm_ctrl_acquire(PM_CTRL_NET);
+        wifi_profile_apply(WIFI_PROFILE_LATENCY);                   /* 上传期间不等待DTIM */
+
+        /* 首次拍摄时传感器已在运行并完成曝光收敛 */
+        if (!first)
+        {
+            wake_us = esp_timer_get_time();
+            xl9555_pin_write(OV_PWDN_IO, 0);
+            esp_camera_resume();                                    /* 驱动重新持有APB锁, 采集期间不浅睡眠 */
+
+            if (cam_resume_wake(wake_us) != ESP_OK)
+            {
+                ESP_LOGW("TAG", "timelapse: no frame after wakeup");
+            }
+        }
+
+        first = 0;
+        fb = esp_camera_fb_get();
+
+        if (fb != NULL)
+        {
+            if (timelapse_upload(&addr, fb, seq) == 0)
+            {
+                ESP_LOGI("TAG", "timelapse: frame %lu, %u bytes", (unsigned long)seq, (unsigned)fb->len);
+            }
+            else
+            {
+                ESP_LOGW("TAG", "timelapse: upload failed: errno %d", errno);
+            }
+
+            seq++;
+            esp_camera_fb_return(fb);
+        }
+
+        /* 传感器待机, 寄存器保持 */
+        cam_resume_standby();
+        esp_camera_suspend();                                       /* 停止采集并释放驱动的APB锁 */
+        xl9555_pin_write(OV_PWDN_IO, 1);
+        wifi_profile_apply(WIFI_PROFILE_BATTERY);                   /* 按DTIM唤醒, 保持关联 */
+        pm_ctrl_release(PM_CTRL_NET);
+
+        /* 按固定节拍拍摄, 错过的周期不补拍 */
+        now = esp_timer_get_time();
+        next_us += (int64_t)TIMELAPSE_INTERVAL_S * 1000000;
+
+        if (next_us <= now)
+        {
+            next_us = now + (int64_t)TIMELAPSE_INTERVAL_S * 1000000;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS((uint32_t)((next_us - now) / 1000)));
+    }
+}
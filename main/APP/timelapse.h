@@ -0,0 +1,49 @@
+/**
+ ****************************************************************************************************
+ * @file        timelapse.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       定时拍摄(两次拍摄之间传感器待机、CPU浅睡眠, WIFI保持关联)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * TIMELAPSE_EN 为1时每 TIMELAPSE_INTERVAL_S 秒拍摄一帧上传, 不运行推流流水线. 每个周期:
+ * 1. 唤醒: CPU升到最高频率(pm_ctrl), WIFI切换到latency组合(关闭modem sleep)
+ * 2. 拉低 XL9555 OV_PWDN 退出待机, esp_camera_resume() 恢复采集, cam_resume_wake() 写回上次的曝光/增益,
+ *    丢弃待机前残留的帧
+ * 3. 取一帧, 连接服务器(IP_ADDR:LWIP_DEMO_PORT), 以 frame_header_t + JPEG 一次发完后断开
+ * 4. cam_resume_standby() 记下曝光/增益, esp_camera_suspend() 停止采集(驱动释放APB锁),
+ *    拉高 OV_PWDN 使传感器待机(寄存器保持, 不需要重新初始化)
+ * 5. WIFI切换到battery组合(按DTIM唤醒, 保持关联), 释放锁后延时到下一周期
+ * 延时期间没有任务运行, 动态调频与自动浅睡眠由 pm_ctrl 配置, 空闲任务使CPU浅睡眠, 只在DTIM信标时短暂唤醒;
+ * 未开启浅睡眠时只有WIFI的modem sleep.
+ * 只在冷启动时经 init_camera 探测传感器(NVS中缓存的型号)并等待曝光收敛, 之后不再重新初始化驱动.
+ * 每个周期新建连接, 两次拍摄之间没有TCP保活报文唤醒射频, 服务器端与普通推流使用同一接收程序.
+ * TLS_STREAM_EN 时每个周期重新握手, 第二次起提交会话票据恢复会话, 省去证书交换与ECDHE运算.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __TIMELAPSE_H
+#define __TIMELAPSE_H
+
+#include "esp_camera.h"
+
+
+#define TIMELAPSE_EN                0                               /* 1:定时拍摄模式, 不推流 */
+#define TIMELAPSE_INTERVAL_S        30                              /* 拍摄间隔(s) */
+#define TIMELAPSE_CONNECT_MS        3000                            /* 连接服务器的超时时间 */
+#define TIMELAPSE_SEND_TIMEOUT_MS   3000                            /* 发送无进展的超时时间 */
+
+/* 函数声明 */
+void timelapse_run(camera_config_t *config);                        /* 定时拍摄模式(不返回) */
+
+#endif
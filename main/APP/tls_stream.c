@@ -0,0 +1,456 @@
+/**
+ ****************************************************************************************************
+ * @file        tls_stream.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       推流连接的TLS加密(硬件AES/SHA/MPI, 大记录, 会话票据恢复)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "tls_stream.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/x509_crt.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <errno.h>
+#include <string.h>
+
+
+/* 只协商 ECDHE + AES-128-GCM: AES由硬件计算, 密钥交换的大数运算由MPI加速器计算 */
+static const int g_tls_suites[] =
+{
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    0
+};
+
+static const char *g_tls_ca_pem = TLS_STREAM_CA_PEM;
+static const char *g_tls_server_name = TLS_STREAM_SERVER_NAME;
+
+static SemaphoreHandle_t g_tls_lock = NULL;                         /* 串行读写, 保护 g_tls_ssl */
+static mbedtls_ssl_config g_tls_conf;
+static mbedtls_x509_crt g_tls_ca;
+static mbedtls_ssl_context g_tls_ssl;
+static mbedtls_ssl_session g_tls_session;                           /* 上一次握手得到的会话(含票据) */
+static uint8_t g_tls_session_valid = 0;
+static uint8_t g_tls_ready = 0;                                     /* 1:配置已初始化 */
+static uint8_t g_tls_open = 0;                                      /* 1:会话可用(只在持有互斥量时修改) */
+static volatile uint8_t g_tls_closing = 0;                          /* 1:发送 close_notify, 套接字不阻塞 */
+static uint8_t g_tls_verified = 0;                                  /* 本次握手收到了服务器证书(完整握手) */
+static int g_tls_sock = -1;
+static tls_stream_stats_t g_tls_stats;
+
+
+#if CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC
+/**
+ * @brief       mbedTLS 的内存分配(sdkconfig 选择 CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC 时由 mbedTLS 调用)
+ * @note        收发记录缓冲等大块放在PSRAM, 会话、密钥与其他小对象放在内部RAM; 首选区域不足时使用另一个
+ * @param       n    : 元素个数
+ * @param       size : 元素大小
+ * @retval      清零的内存, NULL:失败
+ */
+void *esp_mbedtls_mem_calloc(size_t n, size_t size)
+{
+    if (n * size >= TLS_STREAM_PSRAM_MIN)
+    {
+        return heap_caps_calloc_prefer(n, size, 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+
+    return heap_caps_calloc_prefer(n, size, 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+/**
+ * @brief       mbedTLS 的内存释放
+ * @param       ptr : 内存
+ * @retval      无
+ */
+void esp_mbedtls_mem_free(void *ptr)
+{
+    heap_caps_free(ptr);
+}
+#endif
+
+/**
+ * @brief       随机数(硬件随机数发生器, WIFI开启时为真随机数)
+ * @param       ctx : 未用到
+ * @param       buf : 输出
+ * @param       len : 长度
+ * @retval      0
+ */
+static int tls_stream_rng(void *ctx, unsigned char *buf, size_t len)
+{
+    (void)ctx;
+    esp_fill_random(buf, len);
+    return 0;
+}
+
+/**
+ * @brief       证书校验回调(只在完整握手中调用, 会话恢复时服务器不发送证书)
+ * @param       ctx   : 未用到
+ * @param       crt   : 证书
+ * @param       depth : 证书链深度
+ * @param       flags : 校验结果, 未配置CA时清除
+ * @retval      0
+ */
+static int tls_stream_verify(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+    (void)ctx;
+    (void)crt;
+    (void)depth;
+    g_tls_verified = 1;
+
+    if (g_tls_ca_pem == NULL)
+    {
+        *flags = 0;                                                 /* 只加密, 不认证服务器 */
+    }
+
+    return 0;
+}
+
+/**
+ * @brief       mbedTLS 发送回调(阻塞, 超时由套接字的 SO_SNDTIMEO 决定)
+ * @param       ctx : 套接字
+ * @param       buf : 数据
+ * @param       len : 长度
+ * @retval      发送的字节数; MBEDTLS_ERR_NET_SEND_FAILED:出错或超时
+ */
+static int tls_stream_bio_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    int sock = *(int *)ctx;
+    int ret;
+
+    do
+    {
+        ret = send(sock, buf, len, g_tls_closing ? MSG_DONTWAIT : 0);
+    } while (ret < 0 && errno == EINTR);
+
+    return (ret >= 0) ? ret : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+/**
+ * @brief       mbedTLS 接收回调(不阻塞, 等待在互斥量之外进行)
+ * @param       ctx : 套接字
+ * @param       buf : 输出
+ * @param       len : 长度
+ * @retval      接收的字节数, 0:对端关闭; MBEDTLS_ERR_SSL_WANT_READ:暂无数据; MBEDTLS_ERR_NET_RECV_FAILED:出错
+ */
+static int tls_stream_bio_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    int sock = *(int *)ctx;
+    int ret = recv(sock, buf, len, MSG_DONTWAIT);
+
+    if (ret >= 0)
+    {
+        return ret;
+    }
+
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+/**
+ * @brief       等待套接字可读
+ * @param       sock       : 套接字
+ * @param       timeout_ms : 超时时间, <0:一直等待
+ * @retval      >0:可读(或已关闭); 0:超时; <0:出错
+ */
+static int tls_stream_wait(int sock, int timeout_ms)
+{
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    fd_set rset;
+
+    FD_ZERO(&rset);
+    FD_SET(sock, &rset);
+    return select(sock + 1, &rset, NULL, NULL, (timeout_ms < 0) ? NULL : &tv);
+}
+
+/**
+ * @brief       初始化TLS配置(首次握手前调用一次)
+ * @param       无
+ * @retval      0:成功; -1:失败
+ */
+static int tls_stream_setup(void)
+{
+    int ret;
+
+    g_tls_lock = xSemaphoreCreateMutex();
+
+    if (g_tls_lock == NULL)
+    {
+        return -1;
+    }
+
+    mbedtls_ssl_config_init(&g_tls_conf);
+    mbedtls_x509_crt_init(&g_tls_ca);
+    mbedtls_ssl_session_init(&g_tls_session);
+
+    ret = mbedtls_ssl_config_defaults(&g_tls_conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                      MBEDTLS_SSL_PRESET_DEFAULT);
+
+    if (ret != 0)
+    {
+        ESP_LOGE("TAG", "tls: config failed: -0x%04x", -ret);
+        return -1;
+    }
+
+    mbedtls_ssl_conf_rng(&g_tls_conf, tls_stream_rng, NULL);
+    mbedtls_ssl_conf_ciphersuites(&g_tls_conf, g_tls_suites);
+    mbedtls_ssl_conf_verify(&g_tls_conf, tls_stream_verify, NULL);
+#if CONFIG_MBEDTLS_CLIENT_SSL_SESSION_TICKETS
+    mbedtls_ssl_conf_session_tickets(&g_tls_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+    if (g_tls_ca_pem != NULL)
+    {
+        ret = mbedtls_x509_crt_parse(&g_tls_ca, (const unsigned char *)g_tls_ca_pem, strlen(g_tls_ca_pem) + 1);
+
+        if (ret != 0)
+        {
+            ESP_LOGE("TAG", "tls: CA parse failed: -0x%04x", -ret);
+            return -1;
+        }
+
+        mbedtls_ssl_conf_ca_chain(&g_tls_conf, &g_tls_ca, NULL);
+        mbedtls_ssl_conf_authmode(&g_tls_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    }
+    else
+    {
+        /* OPTIONAL: 仍解析服务器证书并调用校验回调(用于区分完整握手与会话恢复), 回调中忽略校验结果 */
+        mbedtls_ssl_conf_authmode(&g_tls_conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
+        ESP_LOGW("TAG", "tls: no CA configured, server certificate is not verified");
+    }
+
+    ESP_LOGI("TAG", "tls: max record %d bytes", CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN);
+    g_tls_ready = 1;
+    return 0;
+}
+
+/**
+ * @brief       在已连接的套接字上进行TLS握手(有上次的会话时提交票据恢复会话)
+ * @note        须在套接字设置 SO_SNDTIMEO 之后、其他线程使用连接之前调用
+ * @param       sock : 已连接的TCP套接字
+ * @retval      0:成功; -1:失败或超时
+ */
+int tls_stream_open(int sock)
+{
+    int64_t start = esp_timer_get_time();
+    int64_t left_ms;
+    int ret;
+
+    if (!g_tls_ready && tls_stream_setup() != 0)
+    {
+        return -1;
+    }
+
+    g_tls_sock = sock;
+    g_tls_closing = 0;
+    g_tls_verified = 0;
+    mbedtls_ssl_init(&g_tls_ssl);
+    ret = mbedtls_ssl_setup(&g_tls_ssl, &g_tls_conf);               /* 分配收发记录缓冲 */
+
+    if (ret == 0)
+    {
+        ret = mbedtls_ssl_set_hostname(&g_tls_ssl, g_tls_server_name);
+    }
+
+    if (ret == 0 && g_tls_session_valid)
+    {
+        mbedtls_ssl_set_session(&g_tls_ssl, &g_tls_session);        /* 服务器不接受票据时照常完整握手 */
+    }
+
+    mbedtls_ssl_set_bio(&g_tls_ssl, &g_tls_sock, tls_stream_bio_send, tls_stream_bio_recv, NULL);
+
+    while (ret == 0 && (ret = mbedtls_ssl_handshake(&g_tls_ssl)) != 0)
+    {
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            break;
+        }
+
+        left_ms = TLS_STREAM_HANDSHAKE_MS - (esp_timer_get_time() - start) / 1000;
+
+        if (left_ms <= 0 || tls_stream_wait(sock, (int)left_ms) <= 0)
+        {
+            ret = MBEDTLS_ERR_SSL_TIMEOUT;
+            break;
+        }
+
+        ret = 0;
+    }
+
+    if (ret != 0)
+    {
+        ESP_LOGW("TAG", "tls: handshake failed: -0x%04x", -ret);
+        mbedtls_ssl_free(&g_tls_ssl);
+        g_tls_session_valid = 0;                                    /* 下次完整握手 */
+        g_tls_stats.failures++;
+        return -1;
+    }
+
+    /* 保存会话与服务器新发的票据, 供下次重连 */
+    mbedtls_ssl_session_free(&g_tls_session);
+    mbedtls_ssl_session_init(&g_tls_session);
+    g_tls_session_valid = (mbedtls_ssl_get_session(&g_tls_ssl, &g_tls_session) == 0);
+
+    g_tls_stats.handshakes++;
+    g_tls_stats.resumed += g_tls_verified ? 0 : 1;
+    g_tls_stats.last_handshake_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    ESP_LOGI("TAG", "tls: %s handshake in %lu ms, %s", g_tls_verified ? "full" : "resumed",
+             (unsigned long)g_tls_stats.last_handshake_ms, mbedtls_ssl_get_ciphersuite(&g_tls_ssl));
+
+    xSemaphoreTake(g_tls_lock, portMAX_DELAY);
+    g_tls_open = 1;
+    xSemaphoreGive(g_tls_lock);
+    return 0;
+}
+
+/**
+ * @brief       加密发送全部数据(每个记录最多 CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN 字节明文)
+ * @note        多个线程可同时调用, 一次调用的数据不会与其他线程的数据交错
+ * @param       data : 数据
+ * @param       len  : 数据长度
+ * @retval      0:成功; -1:连接未建立、出错或发送超时
+ */
+int tls_stream_send(const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    int ret;
+
+    if (g_tls_lock == NULL)
+    {
+        return -1;
+    }
+
+    xSemaphoreTake(g_tls_lock, portMAX_DELAY);
+
+    while (len > 0 && g_tls_open)
+    {
+        ret = mbedtls_ssl_write(&g_tls_ssl, p, len);                /* 每次加密并发送一个记录 */
+
+        if (ret <= 0)
+        {
+            break;
+        }
+
+        p += ret;
+        len -= ret;
+        g_tls_stats.records++;
+        g_tls_stats.bytes += ret;
+    }
+
+    xSemaphoreGive(g_tls_lock);
+    return (len == 0) ? 0 : -1;
+}
+
+/**
+ * @brief       接收解密后的数据(阻塞到有数据、对端关闭或出错)
+ * @param       buf : 输出缓冲
+ * @param       len : 缓冲大小
+ * @retval      接收的字节数; 0:对端关闭; -1:出错
+ */
+int tls_stream_recv(void *buf, size_t len)
+{
+    int ret;
+
+    if (g_tls_lock == NULL)
+    {
+        return -1;
+    }
+
+    while (1)
+    {
+        xSemaphoreTake(g_tls_lock, portMAX_DELAY);
+        ret = g_tls_open ? mbedtls_ssl_read(&g_tls_ssl, (unsigned char *)buf, len) : -1;
+        xSemaphoreGive(g_tls_lock);
+
+        if (ret > 0)
+        {
+            return ret;
+        }
+
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            if (tls_stream_wait(g_tls_sock, -1) < 0)                /* 不持有互斥量等待, 发送照常进行 */
+            {
+                return -1;
+            }
+
+            continue;
+        }
+
+        return (ret == 0 || ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) ? 0 : -1;
+    }
+}
+
+/**
+ * @brief       限时等待可接收的数据
+ * @note        已解密但未读出的数据在 mbedtls 内部, 套接字上看不到, 先检查这部分
+ * @param       timeout_ms : 超时时间
+ * @retval      >0:可接收(或已关闭, 由 tls_stream_recv 返回); 0:超时; <0:出错
+ */
+int tls_stream_poll(int timeout_ms)
+{
+    size_t avail;
+
+    if (g_tls_lock == NULL)
+    {
+        return -1;
+    }
+
+    xSemaphoreTake(g_tls_lock, portMAX_DELAY);
+    avail = g_tls_open ? mbedtls_ssl_get_bytes_avail(&g_tls_ssl) : 0;
+    xSemaphoreGive(g_tls_lock);
+
+    return (avail > 0) ? 1 : tls_stream_wait(g_tls_sock, timeout_ms);
+}
+
+/**
+ * @brief       结束TLS会话: 尽力发送 close_notify(不阻塞), 释放记录缓冲; 套接字由调用者关闭
+ * @param       无
+ * @retval      无
+ */
+void tls_stream_close(void)
+{
+    if (g_tls_lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(g_tls_lock, portMAX_DELAY);
+
+    if (g_tls_open)
+    {
+        g_tls_closing = 1;
+        mbedtls_ssl_close_notify(&g_tls_ssl);
+        mbedtls_ssl_free(&g_tls_ssl);
+        g_tls_open = 0;
+    }
+
+    xSemaphoreGive(g_tls_lock);
+}
+
+/**
+ * @brief       读取统计
+ * @param       stats : 输出统计
+ * @retval      无
+ */
+void tls_stream_get_stats(tls_stream_stats_t *stats)
+{
+    *stats = g_tls_stats;
+}
@@ -0,0 +1,68 @@
+/**
+ ****************************************************************************************************
+ * @file        tls_stream.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       推流连接的TLS加密(硬件AES/SHA/MPI, 大记录, 会话票据恢复)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * TLS_STREAM_EN 为1时, 与服务器的TCP连接(图像、音频、控制命令与定时拍摄上传)建立后先进行TLS 1.2握手,
+ * 之后所有数据经 mbedTLS 加密; 服务器须以 --tls-cert/--tls-key 启动(tools/pc_viewer/ingest_server.py、viewer.py).
+ * 开启后 lwip_demo 改用套接字拷贝发送(不使用零拷贝与RTP): 加密本来就要把明文拷入记录缓冲.
+ * 降低CPU占用的做法:
+ * 1. sdkconfig 开启 CONFIG_MBEDTLS_HARDWARE_AES/SHA/MPI, 加密、摘要与握手的大数运算由S3的加速器完成;
+ *    只协商 ECDHE + AES-128-GCM, AES由硬件计算(分组较多时经DMA), 不使用软件实现的 ChaCha20
+ * 2. CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN=16384: 每个记录最多携带16KB明文, 一帧JPEG只拆成几个记录,
+ *    每条记录的头部、认证标签与一次 send() 的开销分摊到16KB上
+ * 3. CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC: 不小于 TLS_STREAM_PSRAM_MIN 的分配(收发记录缓冲)放在PSRAM, 不占内部RAM
+ * 4. 会话票据(RFC 5077): 握手成功后保存会话, 重连(断线、漫游、定时拍摄每个周期)时提交票据,
+ *    服务器接受则跳过证书交换与ECDHE, 只需一次往返和少量对称运算
+ * TLS_STREAM_CA_PEM 为NULL时不验证服务器证书(只防窃听, 不防中间人), 正式部署时填入签发服务器证书的CA.
+ * 连接只有一个: 发送线程与音频线程的写入、接收循环的读取经内部互斥量串行, 读取时套接字不阻塞,
+ * 等待数据时不持有互斥量, 不会阻塞发送.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __TLS_STREAM_H
+#define __TLS_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#define TLS_STREAM_EN               0                               /* 1:推流连接使用TLS加密 */
+#define TLS_STREAM_CA_PEM           NULL                            /* 签发服务器证书的CA(PEM字符串), NULL:不验证服务器证书 */
+#define TLS_STREAM_SERVER_NAME      NULL                            /* 服务器证书中的名称(SNI与主机名校验), NULL:不校验名称 */
+#define TLS_STREAM_HANDSHAKE_MS     5000                            /* 握手超时时间 */
+#define TLS_STREAM_PSRAM_MIN        4096                            /* mbedTLS 不小于该长度的分配放在PSRAM */
+
+/* 统计 */
+typedef struct
+{
+    uint32_t handshakes;                                            /* 成功的握手次数 */
+    uint32_t resumed;                                               /* 其中以会话票据恢复的次数(服务器未发送证书) */
+    uint32_t failures;                                              /* 握手失败次数 */
+    uint32_t last_handshake_ms;                                     /* 最近一次成功握手的耗时 */
+    uint64_t records;                                               /* 发送的记录数 */
+    uint64_t bytes;                                                 /* 加密发送的明文字节数 */
+} tls_stream_stats_t;
+
+/* 函数声明 */
+int tls_stream_open(int sock);                                      /* 在已连接的套接字上握手, 0:成功 */
+int tls_stream_send(const void *data, size_t len);                  /* 加密发送全部数据, 0:成功 */
+int tls_stream_recv(void *buf, size_t len);                         /* 接收解密后的数据, 返回长度, 0:对端关闭, <0:出错 */
+int tls_stream_poll(int timeout_ms);                                /* 限时等待可接收的数据, 0:超时 */
+void tls_stream_close(void);                                        /* 结束TLS会话(不关闭套接字) */
+void tls_stream_get_stats(tls_stream_stats_t *stats);               /* 读取统计 */
+
+#endif
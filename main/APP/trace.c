@@ -0,0 +1,349 @@
+/**
+ ****************************************************************************************************
+ * @file        trace.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       时延跟踪事件记录(PSRAM环形缓冲, 以 Chrome trace JSON 导出, Perfetto 可直接打开)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "trace.h"
+#include "heap_stats.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_camera.h"
+
+
+#define TRACE_CORE_NONE             0xFF                            /* 由驱动时间戳补记的事件, 不属于某个核 */
+#define TRACE_DUR_INSTANT           0xFFFFFFFF                      /* 瞬时事件(驱动探针)的持续时间 */
+#define TRACE_DRAIN_NUM             32                              /* 每次从驱动取出的探针事件数 */
+
+/* 一个事件(24字节) */
+typedef struct
+{
+    int64_t start_us;                                               /* 开始时间(esp_timer) */
+    uint32_t dur_us;                                                /* 持续时间 */
+    uint32_t arg;                                                   /* 参数(字节数等) */
+    uint8_t id;                                                     /* trace_id_t */
+    uint8_t core;                                                   /* 记录时所在的核, TRACE_CORE_NONE:驱动 */
+    uint8_t probe;                                                  /* TRACE_CAM_PROBE 的 camera_trace_id_t */
+    uint8_t reserved;
+} trace_event_t;
+
+/* 事件的显示名称与轨道 */
+typedef struct
+{
+    const char *name;
+    uint8_t track;                                                  /* 下标见 g_trace_tracks */
+} trace_info_t;
+
+/* 轨道(Chrome trace 的 tid 为下标+1); 同一轨道上的事件先后发生或互相嵌套 */
+static const char *const g_trace_tracks[] = { "cam dma", "cam_task", "fb queue", "lwip_send", "av_audio", "lcd_preview" };
+
+static const trace_info_t g_trace_info[TRACE_ID_NUM] =
+{
+    [TRACE_CAM_SENSOR] = { "sensor", 0 },
+    [TRACE_CAM_TASK]   = { "cam_task", 1 },
+    [TRACE_CAM_QUEUE]  = { "fb_queue", 2 },
+    [TRACE_CAM_TAKE]   = { "cam_take", 3 },
+    [TRACE_SEND_FRAME] = { "send_frame", 3 },
+    [TRACE_SEND_AUDIO] = { "send_audio", 4 },
+    [TRACE_I2S_READ]   = { "i2s_read", 4 },
+    [TRACE_LCD_DECODE] = { "lcd_decode", 5 },
+    [TRACE_LCD_WAIT]   = { "lcd_wait", 5 },
+    [TRACE_CAM_PROBE]  = { "cam_probe", 1 },
+};
+
+/* 驱动探针: 中断在 cam dma 轨道, cam_task 在 cam_task 轨道, cam_take 在调用它的发送线程轨道 */
+static const trace_info_t g_trace_probe_info[CAMERA_TRACE_ID_NUM] =
+{
+    [CAMERA_TRACE_VSYNC_ISR]    = { "vsync_isr", 0 },
+    [CAMERA_TRACE_EOF_ISR]      = { "eof_isr", 0 },
+    [CAMERA_TRACE_TASK_STATE]   = { "task_state", 1 },
+    [CAMERA_TRACE_FRAME_START]  = { "frame_start", 1 },
+    [CAMERA_TRACE_FRAME_QUEUED] = { "frame_queued", 1 },
+    [CAMERA_TRACE_TAKE_BEGIN]   = { "take_begin", 3 },
+    [CAMERA_TRACE_TAKE_NO_EOI]  = { "take_no_eoi", 3 },
+    [CAMERA_TRACE_TAKE_END]     = { "take_end", 3 },
+};
+
+/* 导出状态: 缓冲满时以HTTP分块发出 */
+typedef struct
+{
+    httpd_req_t *req;
+    char *buf;
+    size_t len;
+    esp_err_t err;
+} trace_out_t;
+
+static trace_event_t *g_trace_ring = NULL;                          /* 环形缓冲(PSRAM) */
+static uint32_t g_trace_head = 0;                                   /* 已写入的事件总数(原子递增) */
+static volatile uint8_t g_trace_paused = 0;                         /* 导出期间暂停记录 */
+static char *g_trace_out = NULL;                                    /* 导出缓冲(PSRAM), 只由HTTP服务线程使用 */
+
+
+/**
+ * @brief       分配环形缓冲(上电后尽早调用, 之前的事件被忽略)
+ * @param       无
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:内存不足
+ */
+esp_err_t trace_init(void)
+{
+#if TRACE_EN
+    g_trace_ring = heap_stats_malloc(HEAP_TAG_TRACE, TRACE_EVENT_NUM * sizeof(trace_event_t), MALLOC_CAP_SPIRAM);
+
+    if (g_trace_ring == NULL)
+    {
+        ESP_LOGE("TAG", "Memory for trace ring is not enough");
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief       记录一个区间事件(任意任务调用, 不加锁)
+ * @note        driver 事件(TRACE_CAM_SENSOR ~ TRACE_CAM_TAKE)的时间来自驱动, 不记录核号
+ * @param       id       : 事件号
+ * @param       start_us : 开始时间(esp_timer_get_time)
+ * @param       end_us   : 结束时间
+ * @param       arg      : 参数
+ * @retval      无
+ */
+void trace_complete(trace_id_t id, int64_t start_us, int64_t end_us, uint32_t arg)
+{
+#if TRACE_EN
+    trace_event_t *ev;
+    uint32_t index;
+
+    if (g_trace_ring == NULL || g_trace_paused || start_us <= 0 || end_us < start_us)
+    {
+        return;                                                     /* 驱动未记录该时间戳时为0 */
+    }
+
+    index = __atomic_fetch_add(&g_trace_head, 1, __ATOMIC_RELAXED);
+    ev = &g_trace_ring[index & (TRACE_EVENT_NUM - 1)];
+    ev->start_us = start_us;
+    ev->dur_us = (uint32_t)(end_us - start_us);
+    ev->arg = arg;
+    ev->id = (uint8_t)id;
+    ev->core = (id <= TRACE_CAM_TAKE) ? TRACE_CORE_NONE : (uint8_t)xPortGetCoreID();
+#else
+    (void)id;
+    (void)start_us;
+    (void)end_us;
+    (void)arg;
+#endif
+}
+
+/**
+ * @brief       取出驱动探针事件, 作为瞬时事件写入环形缓冲
+ * @note        驱动的探针缓冲只允许一个读者, 只由发送线程在每取一帧后调用
+ * @param       无
+ * @retval      无
+ */
+void trace_camera_drain(void)
+{
+#if TRACE_EN
+    camera_trace_event_t probes[TRACE_DRAIN_NUM];
+    trace_event_t *ev;
+    uint32_t index;
+    uint32_t lost;
+    size_t num;
+
+    do
+    {
+        num = esp_camera_trace_read(probes, TRACE_DRAIN_NUM, &lost);
+
+        if (lost != 0)
+        {
+            ESP_LOGW("TAG", "trace: %lu camera probe events lost", (unsigned long)lost);
+        }
+
+        if (g_trace_ring == NULL || g_trace_paused)
+        {
+            continue;                                               /* 导出期间取出并丢弃, 不让驱动缓冲溢出 */
+        }
+
+        for (size_t i = 0; i < num; i++)
+        {
+            if (probes[i].id >= CAMERA_TRACE_ID_NUM)
+            {
+                continue;
+            }
+
+            index = __atomic_fetch_add(&g_trace_head, 1, __ATOMIC_RELAXED);
+            ev = &g_trace_ring[index & (TRACE_EVENT_NUM - 1)];
+            ev->start_us = probes[i].time_us;
+            ev->dur_us = TRACE_DUR_INSTANT;
+            ev->arg = probes[i].arg;
+            ev->id = TRACE_CAM_PROBE;
+            ev->core = probes[i].core;
+            ev->probe = probes[i].id;
+        }
+    } while (num == TRACE_DRAIN_NUM);
+#endif
+}
+
+#if TRACE_EN
+/**
+ * @brief       向导出缓冲追加一段格式化文本, 放不下时先把缓冲作为一个HTTP分块发出
+ * @param       out : 导出状态
+ * @param       fmt : 格式
+ * @retval      无
+ */
+static void trace_printf(trace_out_t *out, const char *fmt, ...)
+{
+    va_list ap;
+    int len;
+
+    for (int retry = 0; retry < 2 && out->err == ESP_OK; retry++)
+    {
+        va_start(ap, fmt);
+        len = vsnprintf(out->buf + out->len, TRACE_OUT_SIZE - out->len, fmt, ap);
+        va_end(ap);
+
+        if (len < 0)
+        {
+            return;
+        }
+
+        if (out->len + len < TRACE_OUT_SIZE)
+        {
+            out->len += len;
+            return;
+        }
+
+        if (out->len == 0)
+        {
+            return;                                                 /* 单条超过缓冲大小, 丢弃 */
+        }
+
+        out->err = httpd_resp_send_chunk(out->req, out->buf, out->len);
+        out->len = 0;
+    }
+}
+
+/**
+ * @brief       /trace 请求处理(Chrome trace 事件格式 JSON)
+ * @param       req : HTTP请求
+ * @retval      ESP_OK:成功; 其他:发送失败
+ */
+static esp_err_t trace_handler(httpd_req_t *req)
+{
+    trace_out_t out = { .req = req, .buf = g_trace_out, .len = 0, .err = ESP_OK };
+    const trace_event_t *ev;
+    const trace_info_t *info;
+    uint32_t head;
+    uint32_t first;
+
+    g_trace_paused = 1;
+    head = __atomic_load_n(&g_trace_head, __ATOMIC_RELAXED);
+    first = (head > TRACE_EVENT_NUM) ? head - TRACE_EVENT_NUM : 0;
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"trace.json\"");
+
+    trace_printf(&out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                       "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"esp32-camera\"}}");
+
+    for (uint32_t i = 0; i < sizeof(g_trace_tracks) / sizeof(g_trace_tracks[0]); i++)
+    {
+        trace_printf(&out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+                     (unsigned long)(i + 1), g_trace_tracks[i]);
+    }
+
+    for (uint32_t n = first; n != head && out.err == ESP_OK; n++)
+    {
+        ev = &g_trace_ring[n & (TRACE_EVENT_NUM - 1)];
+
+        if (ev->id >= TRACE_ID_NUM)
+        {
+            continue;
+        }
+
+        if (ev->dur_us == TRACE_DUR_INSTANT)                        /* 驱动探针: 线程范围的瞬时事件 */
+        {
+            if (ev->probe >= CAMERA_TRACE_ID_NUM)
+            {
+                continue;
+            }
+
+            info = &g_trace_probe_info[ev->probe];
+            trace_printf(&out, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lld,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%lu",
+                         info->name, (long long)ev->start_us, (unsigned)(info->track + 1), (unsigned long)ev->arg);
+        }
+        else
+        {
+            info = &g_trace_info[ev->id];
+            trace_printf(&out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lu,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%lu",
+                         info->name, (long long)ev->start_us, (unsigned long)ev->dur_us, (unsigned)(info->track + 1),
+                         (unsigned long)ev->arg);
+        }
+
+        if (ev->core != TRACE_CORE_NONE)
+        {
+            trace_printf(&out, ",\"core\":%u", (unsigned)ev->core);
+        }
+
+        trace_printf(&out, "}}");
+    }
+
+    trace_printf(&out, "\n]}\n");
+    g_trace_paused = 0;
+
+    if (out.err == ESP_OK && out.len > 0)
+    {
+        out.err = httpd_resp_send_chunk(req, out.buf, out.len);
+    }
+
+    if (out.err != ESP_OK)
+    {
+        return out.err;
+    }
+
+    ESP_LOGI("TAG", "trace: %lu events dumped", (unsigned long)(head - first));
+
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+#endif
+
+/**
+ * @brief       在HTTP服务上注册 /trace
+ * @param       server : HTTP服务句柄
+ * @retval      ESP_OK:成功; ESP_ERR_NO_MEM:内存不足; 其他:注册失败
+ */
+esp_err_t trace_register(httpd_handle_t server)
+{
+#if TRACE_EN
+    httpd_uri_t uri = { .uri = "/trace", .method = HTTP_GET, .handler = trace_handler };
+
+    g_trace_out = heap_stats_malloc(HEAP_TAG_TRACE, TRACE_OUT_SIZE, MALLOC_CAP_SPIRAM);
+
+    if (g_trace_out == NULL || g_trace_ring == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return httpd_register_uri_handler(server, &uri);
+#else
+    (void)server;
+    return ESP_OK;
+#endif
+}
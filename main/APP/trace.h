@@ -0,0 +1,64 @@
+/**
+ ****************************************************************************************************
+ * @file        trace.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       时延跟踪事件记录(PSRAM环形缓冲, 以 Chrome trace JSON 导出, Perfetto 可直接打开)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 每个事件24字节(开始时间、持续时间、参数、事件号、CPU核), 写入时只原子递增写位置并填入一个槽,
+ * 不加锁, 缓冲满后覆盖最旧的事件, 开销约为两次 esp_timer_get_time(), 可以在现场设备上常开.
+ * 时间戳统一为 esp_timer 微秒(两个核共用一个时钟, 与驱动的帧时间戳同源, 不需要换算各核的周期计数).
+ * 驱动各阶段: 发送线程取到帧后按 esp_camera_fb_get_timing() 的 VSYNC/DMA结束/入队/出队/取走时间
+ * 补记为区间事件; 开启 CONFIG_CAMERA_TRACE 时, 驱动在 VSYNC/DMA EOF 中断、cam_task 状态切换与
+ * cam_take 中记录的探针事件也由发送线程取出(trace_camera_drain), 作为瞬时事件放到对应轨道.
+ * 其余事件(发送、I2S读取、LCD取景解码与等待条带)在任务中记录. 板载HTTP服务 /trace 导出当前缓冲(导出期间暂停记录), 另存为 .json 后
+ * 用 ui.perfetto.dev 或 chrome://tracing 打开, 每个事件按 trace_id_t 分到对应的轨道.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+
+#define TRACE_EN                    1                               /* 1:使能跟踪记录与 /trace */
+#define TRACE_EVENT_NUM             8192                            /* 环形缓冲事件数(2的幂), 共192KB PSRAM, 30fps推流约保存20秒 */
+#define TRACE_OUT_SIZE              2048                            /* 导出时的分块缓冲 */
+
+/* 事件号 */
+typedef enum
+{
+    TRACE_CAM_SENSOR = 0,                                           /* VSYNC -> DMA结束: 传感器输出一帧 */
+    TRACE_CAM_TASK,                                                 /* DMA结束 -> 入队: cam_task 收尾 */
+    TRACE_CAM_QUEUE,                                                /* 入队 -> 出队: 在帧队列中等待 */
+    TRACE_CAM_TAKE,                                                 /* 出队 -> 取走: cam_take 校验JPEG结束符 */
+    TRACE_SEND_FRAME,                                               /* 一帧的 send(), 参数为字节数 */
+    TRACE_SEND_AUDIO,                                               /* 一个音频帧的 send(), 参数为字节数 */
+    TRACE_I2S_READ,                                                 /* 读取一个音频帧(阻塞到I2S DMA完成), 参数为字节数 */
+    TRACE_LCD_DECODE,                                               /* LCD取景一帧的解码与条带提交, 参数为JPEG字节数 */
+    TRACE_LCD_WAIT,                                                 /* 等待SPI刷屏完成归还条带缓存 */
+    TRACE_CAM_PROBE,                                                /* 驱动探针(瞬时事件), 种类见 camera_trace_id_t */
+    TRACE_ID_NUM
+} trace_id_t;
+
+/* 函数声明 */
+esp_err_t trace_init(void);                                         /* 分配环形缓冲 */
+void trace_complete(trace_id_t id, int64_t start_us, int64_t end_us, uint32_t arg);  /* 记录一个区间事件(任意任务调用) */
+void trace_camera_drain(void);                                      /* 取出驱动探针事件(只由一个任务调用) */
+esp_err_t trace_register(httpd_handle_t server);                    /* 在HTTP服务上注册 /trace */
+
+#endif
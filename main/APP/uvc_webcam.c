@@ -0,0 +1,219 @@
+/**
+ ****************************************************************************************************
+ * @file        uvc_webcam.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       USB UVC摄像头模式(ESP32-S3 USB OTG, MJPEG)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "uvc_webcam.h"
+#include "sensor_fps.h"
+#include "heap_stats.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#if UVC_WEBCAM_EN
+#include "usb_device_uvc.h"
+#endif
+
+
+#if UVC_WEBCAM_EN
+static camera_fb_t *g_uvc_cam_fb = NULL;                            /* 协议栈正在拷贝的驱动帧缓存 */
+static uvc_fb_t g_uvc_fb;
+static framesize_t g_uvc_size = FRAMESIZE_INVALID;                  /* 主机选择的分辨率 */
+static volatile uint32_t g_uvc_frames = 0;
+
+
+/**
+ * @brief       主机开始取流: 切换到请求的分辨率与帧率
+ * @param       format : 格式(只提供MJPEG)
+ * @param       width  : 宽度
+ * @param       height : 高度
+ * @param       rate   : 帧率
+ * @param       cb_ctx : 回调参数(未用到)
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_SUPPORTED:传感器不支持该分辨率
+ */
+static esp_err_t uvc_webcam_start(uvc_format_t format, int width, int height, int rate, void *cb_ctx)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    framesize_t size = FRAMESIZE_INVALID;
+
+    (void)cb_ctx;
+
+    for (int i = 0; i < FRAMESIZE_INVALID; i++)
+    {
+        if (resolution[i].width == width && resolution[i].height == height)
+        {
+            size = (framesize_t)i;
+            break;
+        }
+    }
+
+    if (format != UVC_FORMAT_JPEG || s == NULL || size == FRAMESIZE_INVALID || s->set_framesize(s, size) != 0)
+    {
+        ESP_LOGE("TAG", "uvc: %dx%d not supported", width, height);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    g_uvc_size = size;
+    sensor_fps_reapply();                                           /* set_framesize 恢复了驱动默认的时钟分频 */
+
+    if (sensor_fps_set((uint32_t)rate) != ESP_OK)
+    {
+        ESP_LOGW("TAG", "uvc: sensor cannot slow down to %d fps, extra frames are skipped by the host", rate);
+    }
+
+    ESP_LOGI("TAG", "uvc: streaming %dx%d MJPEG at %d fps", width, height, rate);
+    return ESP_OK;
+}
+
+/**
+ * @brief       主机停止取流
+ * @param       cb_ctx : 回调参数(未用到)
+ * @retval      无
+ */
+static void uvc_webcam_stop(void *cb_ctx)
+{
+    (void)cb_ctx;
+    ESP_LOGI("TAG", "uvc: stopped");
+}
+
+/**
+ * @brief       取一帧交给协议栈(协议栈线程调用)
+ * @note        丢弃切换分辨率前采集的帧; 帧缓存在 uvc_webcam_fb_return 中归还
+ * @param       cb_ctx : 回调参数(未用到)
+ * @retval      帧, NULL:取帧失败
+ */
+static uvc_fb_t *uvc_webcam_fb_get(void *cb_ctx)
+{
+    camera_fb_t *fb;
+
+    (void)cb_ctx;
+
+    while (1)
+    {
+        fb = esp_camera_fb_get();
+
+        if (fb == NULL)
+        {
+            return NULL;
+        }
+
+        if (fb->format == PIXFORMAT_JPEG && fb->width == resolution[g_uvc_size].width &&
+            fb->height == resolution[g_uvc_size].height && fb->len <= UVC_WEBCAM_XFER_SIZE)
+        {
+            break;
+        }
+
+        esp_camera_fb_return(fb);
+    }
+
+    sensor_fps_observe(fb);
+
+    g_uvc_cam_fb = fb;
+    g_uvc_fb.buf = fb->buf;
+    g_uvc_fb.len = fb->len;
+    g_uvc_fb.width = fb->width;
+    g_uvc_fb.height = fb->height;
+    g_uvc_fb.format = UVC_FORMAT_JPEG;
+    g_uvc_fb.timestamp = fb->timestamp;
+    return &g_uvc_fb;
+}
+
+/**
+ * @brief       协议栈已拷贝完一帧, 归还驱动帧缓存
+ * @param       fb     : uvc_webcam_fb_get 返回的帧
+ * @param       cb_ctx : 回调参数(未用到)
+ * @retval      无
+ */
+static void uvc_webcam_fb_return(uvc_fb_t *fb, void *cb_ctx)
+{
+    (void)fb;
+    (void)cb_ctx;
+
+    if (g_uvc_cam_fb != NULL)
+    {
+        esp_camera_fb_return(g_uvc_cam_fb);
+        g_uvc_cam_fb = NULL;
+        g_uvc_frames++;
+    }
+}
+#endif
+
+/**
+ * @brief       USB UVC摄像头模式(在 app_main 中调用, 只在初始化失败时返回)
+ * @note        不推流; 主机选择分辨率前按 config->frame_size 采集
+ * @param       config : 摄像头配置(改为JPEG、UVC_WEBCAM_FB_NUM 个帧缓存后重新初始化)
+ * @retval      无
+ */
+void uvc_webcam_run(camera_config_t *config)
+{
+#if UVC_WEBCAM_EN
+    uvc_device_config_t uvc_config = {
+        .start_cb = uvc_webcam_start,
+        .fb_get_cb = uvc_webcam_fb_get,
+        .fb_return_cb = uvc_webcam_fb_return,
+        .stop_cb = uvc_webcam_stop,
+        .cb_ctx = NULL,
+    };
+    int64_t log_start;
+    int64_t now;
+    uint32_t frames;
+
+    esp_camera_deinit();
+    config->pixel_format = PIXFORMAT_JPEG;
+    config->fb_count = UVC_WEBCAM_FB_NUM;
+    config->fb_location = CAMERA_FB_IN_PSRAM;
+    config->grab_mode = CAMERA_GRAB_LATEST;
+    g_uvc_size = config->frame_size;
+
+    uvc_config.uvc_buffer_size = UVC_WEBCAM_XFER_SIZE;
+    uvc_config.uvc_buffer = heap_stats_malloc(HEAP_TAG_UVC, UVC_WEBCAM_XFER_SIZE, MALLOC_CAP_SPIRAM);
+
+    if (uvc_config.uvc_buffer == NULL || esp_camera_init(config) != ESP_OK)
+    {
+        ESP_LOGE("TAG", "uvc: no memory or camera setup failed");
+        return;
+    }
+
+    if (uvc_device_config(0, &uvc_config) != ESP_OK || uvc_device_init() != ESP_OK)
+    {
+        ESP_LOGE("TAG", "uvc: usb device init failed");
+        return;
+    }
+
+    ESP_LOGI("TAG", "uvc: webcam ready on usb otg");
+    log_start = esp_timer_get_time();
+
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(UVC_WEBCAM_LOG_MS));
+        frames = g_uvc_frames;
+        g_uvc_frames = 0;
+        now = esp_timer_get_time();
+
+        if (frames > 0)
+        {
+            ESP_LOGI("TAG", "uvc: %.1f fps", (double)frames * 1e6 / (double)(now - log_start));
+        }
+
+        log_start = now;
+    }
+#else
+    (void)config;
+#endif
+}
@@ -0,0 +1,47 @@
+/**
+ ****************************************************************************************************
+ * @file        uvc_webcam.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       USB UVC摄像头模式(ESP32-S3 USB OTG, MJPEG)
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * UVC_WEBCAM_EN 为1时板子经 USB OTG 口(GPIO19/20, 全速12Mbit/s)枚举为标准UVC摄像头(不推流), 任何系统无需驱动
+ * 即可用 VLC/ffplay/OBS 等打开. 协议栈为 espressif/usb_device_uvc(TinyUSB), 主机可选的分辨率与帧率列表、
+ * 批量(bulk)或同步(isochronous)传输在 menuconfig 的 USB Device UVC 中配置(全速下推荐批量传输).
+ * 主机开始取流时按请求的宽高 set_framesize, 帧率经 sensor_fps 降低传感器内部时钟分频, 多余的帧不再采集;
+ * 取帧回调直接交出 cam_hal 的JPEG帧缓存, 协议栈拷入传输缓冲后立即归还, USB传输期间驱动照常采集下一帧.
+ * USB OTG 与 USB-Serial-JTAG 共用引脚, 此模式下日志需从UART0输出.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __UVC_WEBCAM_H
+#define __UVC_WEBCAM_H
+
+#include "sdkconfig.h"
+#include "esp_camera.h"
+
+
+#if CONFIG_APP_UVC_WEBCAM                                            /* menuconfig 中设置, 同时决定是否拉取 espressif/usb_device_uvc */
+#define UVC_WEBCAM_EN               1                               /* 1:USB UVC摄像头模式, 不推流 */
+#else
+#define UVC_WEBCAM_EN               0
+#endif
+#define UVC_WEBCAM_FB_NUM           3                               /* 此模式的帧缓存数 */
+#define UVC_WEBCAM_XFER_SIZE        (160 * 1024)                    /* 传输缓冲(PSRAM), 须容纳最大一帧JPEG */
+#define UVC_WEBCAM_LOG_MS           5000                            /* 输出帧率的间隔 */
+
+/* 函数声明 */
+void uvc_webcam_run(camera_config_t *config);                       /* USB UVC摄像头模式(只在初始化失败时返回) */
+
+#endif
@@ -19,6 +19,15 @@
  */
 
 #include "wifi_config.h"
+#include "wifi_profile.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#if WIFI_ROAM_EN
+#include "esp_rrm.h"
+#include "esp_wnm.h"
+#endif
 
 
 /* 链接wifi名称 */
@@ -34,15 +43,317 @@ network_connet_info network_connet;
 static const char *TAG = "static_ip";
 char lcd_buff[100] = {0};
 
+/* 上一次连接的AP(保存在NVS, 重连时跳过全信道扫描) */
+typedef struct
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t reserved;
+} wifi_ap_cache_t;
+
+static wifi_ap_cache_t g_ap_cache;                  /* 已保存的AP信息 */
+static uint8_t g_ap_cache_used = 0;                 /* 1:本次按缓存的BSSID/信道连接 */
+static volatile uint32_t g_sta_disconnects = 0;     /* 上电以来的断开次数(含连接失败后的重试) */
+
 /* WIFI默认配置 */
 #define WIFICONFIG()   {                            \
     .sta = {                                        \
         .ssid = DEFAULT_SSID,                       \
         .password = DEFAULT_PWD,                    \
         .threshold.authmode = WIFI_AUTH_WPA2_PSK,   \
+        .rm_enabled = WIFI_ROAM_EN,                 \
+        .btm_enabled = WIFI_ROAM_EN,                \
+        .ft_enabled = WIFI_ROAM_EN,                 \
     },                                              \
 }
 
+#if WIFI_ROAM_EN
+/* 漫游状态 */
+enum
+{
+    WIFI_ROAM_IDLE = 0,                             /* 等待信号变弱(或冷却中) */
+    WIFI_ROAM_SEARCH,                               /* 已向AP请求邻居报告/BTM, 等待引导 */
+    WIFI_ROAM_SCAN,                                 /* 自行后台扫描中 */
+    WIFI_ROAM_SWITCH,                               /* 正在切换到另一个AP */
+};
+
+static volatile uint8_t g_roam_state = WIFI_ROAM_IDLE;
+static volatile int64_t g_roam_switch_us = 0;       /* 进入 WIFI_ROAM_SWITCH 的时间 */
+static uint16_t g_roam_channels = 0;                /* 邻居报告中的信道(第n位为信道n), 0:扫描全部信道 */
+static esp_timer_handle_t g_roam_timer = NULL;      /* 等待引导超时 / 冷却结束 */
+#endif
+
+#if WIFI_FAST_CONNECT_EN
+/**
+ * @brief       读取缓存的AP信息
+ * @param       cache : 输出AP信息
+ * @retval      ESP_OK:成功; 其他:没有缓存
+ */
+static esp_err_t wifi_cache_load(wifi_ap_cache_t *cache)
+{
+    nvs_handle_t handle;
+    size_t len = sizeof(wifi_ap_cache_t);
+    esp_err_t ret;
+
+    memset(cache, 0, sizeof(wifi_ap_cache_t));
+    ret = nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &handle);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    ret = nvs_get_blob(handle, "ap", cache, &len);
+    nvs_close(handle);
+
+    if (ret == ESP_OK && (len != sizeof(wifi_ap_cache_t) || cache->channel == 0))
+    {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief       保存当前连接的AP信息(与已保存的相同时不写Flash)
+ * @param       无
+ * @retval      无
+ */
+static void wifi_cache_save(void)
+{
+    wifi_ap_record_t ap;
+    wifi_ap_cache_t cache;
+    nvs_handle_t handle;
+
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK)
+    {
+        return;
+    }
+
+    memset(&cache, 0, sizeof(cache));
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+    cache.channel = ap.primary;
+
+    if (memcmp(&cache, &g_ap_cache, sizeof(cache)) == 0)
+    {
+        return;
+    }
+
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK)
+    {
+        if (nvs_set_blob(handle, "ap", &cache, sizeof(cache)) == ESP_OK)
+        {
+            nvs_commit(handle);
+            g_ap_cache = cache;
+        }
+
+        nvs_close(handle);
+    }
+}
+#endif
+
+#if WIFI_STATIC_IP_EN
+/**
+ * @brief       设置静态IP(关闭DHCP客户端)
+ * @param       netif : STA网卡
+ * @retval      无
+ */
+static void wifi_static_ip_set(esp_netif_t *netif)
+{
+    esp_netif_ip_info_t ip_info;
+    esp_netif_dns_info_t dns;
+
+    memset(&ip_info, 0, sizeof(ip_info));
+    ip_info.ip.addr = esp_ip4addr_aton(WIFI_STATIC_IP);
+    ip_info.gw.addr = esp_ip4addr_aton(WIFI_STATIC_GW);
+    ip_info.netmask.addr = esp_ip4addr_aton(WIFI_STATIC_NETMASK);
+
+    memset(&dns, 0, sizeof(dns));
+    dns.ip.u_addr.ip4.addr = esp_ip4addr_aton(WIFI_STATIC_DNS);
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+
+    esp_netif_dhcpc_stop(netif);
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(netif, &ip_info));
+    esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns);
+}
+#endif
+
+#if WIFI_ROAM_EN
+/**
+ * @brief       启动漫游定时器(等待引导超时或冷却结束)
+ * @param       ms : 时间
+ * @retval      无
+ */
+static void wifi_roam_timer_start(uint32_t ms)
+{
+    esp_timer_stop(g_roam_timer);
+    esp_timer_start_once(g_roam_timer, (uint64_t)ms * 1000);
+}
+
+/**
+ * @brief       结束一次寻找, 冷却后重新监视信号强度
+ * @param       无
+ * @retval      无
+ */
+static void wifi_roam_idle(void)
+{
+    g_roam_state = WIFI_ROAM_IDLE;
+    g_roam_channels = 0;
+    wifi_roam_timer_start(WIFI_ROAM_COOLDOWN_MS);
+}
+
+/**
+ * @brief       后台扫描同名AP(AP不支持802.11k/v或没有引导时)
+ * @note        每个信道之间回到当前信道 30ms, 扫描期间推流不中断
+ * @param       无
+ * @retval      无
+ */
+static void wifi_roam_scan(void)
+{
+    wifi_scan_config_t scan = {
+        .ssid = (uint8_t *)DEFAULT_SSID,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active = { .min = 20, .max = 40 },
+        .home_chan_dwell_time = 30,
+    };
+
+    scan.channel_bitmap.ghz_2_channels = g_roam_channels;
+    g_roam_state = WIFI_ROAM_SCAN;
+
+    if (esp_wifi_scan_start(&scan, false) != ESP_OK)
+    {
+        wifi_roam_idle();
+    }
+}
+
+/**
+ * @brief       信号变弱: 优先请AP给出邻居报告(802.11k)或直接引导(802.11v BTM), 都不支持时自行扫描
+ * @param       无
+ * @retval      无
+ */
+static void wifi_roam_search(void)
+{
+    g_roam_state = WIFI_ROAM_SEARCH;
+
+    if (esp_rrm_is_rrm_supported_connection() && esp_rrm_send_neighbor_report_request() == 0)
+    {
+        wifi_roam_timer_start(WIFI_ROAM_QUERY_MS);
+    }
+    else if (esp_wnm_is_btm_supported_connection() && esp_wnm_send_bss_transition_mgmt_query(REASON_RSSI, NULL, 0) == 0)
+    {
+        wifi_roam_timer_start(WIFI_ROAM_QUERY_MS);
+    }
+    else
+    {
+        wifi_roam_scan();
+    }
+}
+
+/**
+ * @brief       收到邻居报告: 记下邻居所在信道; 支持BTM时请AP引导(由协议栈完成切换, 支持802.11r时为FT), 否则扫描这些信道
+ * @param       event : 邻居报告(一串 Neighbor Report 元素)
+ * @retval      无
+ */
+static void wifi_roam_neighbor_report(const wifi_event_neighbor_report_t *event)
+{
+    const uint8_t *pos = event->report;
+    int left = event->report_len;
+
+    g_roam_channels = 0;
+
+    while (left >= 2 && left >= 2 + pos[1])
+    {
+        /* 元素ID 52: BSSID(6) + BSSID信息(4) + 操作类(1) + 信道(1) + PHY类型(1) */
+        if (pos[0] == 52 && pos[1] >= 13 && pos[2 + 11] >= 1 && pos[2 + 11] <= 14)
+        {
+            g_roam_channels |= (uint16_t)(1 << pos[2 + 11]);
+        }
+
+        left -= 2 + pos[1];
+        pos += 2 + pos[1];
+    }
+
+    ESP_LOGI(TAG, "roam: neighbor report, channels 0x%04x", g_roam_channels);
+
+    if (esp_wnm_is_btm_supported_connection() && esp_wnm_send_bss_transition_mgmt_query(REASON_RSSI, NULL, 0) == 0)
+    {
+        wifi_roam_timer_start(WIFI_ROAM_QUERY_MS);
+    }
+    else
+    {
+        wifi_roam_scan();
+    }
+}
+
+/**
+ * @brief       后台扫描完成: 有明显更强的同名AP时切换过去
+ * @param       无
+ * @retval      无
+ */
+static void wifi_roam_scan_done(void)
+{
+    static wifi_ap_record_t records[16];
+    uint16_t num = sizeof(records) / sizeof(records[0]);
+    wifi_ap_record_t cur;
+    wifi_config_t wifi_config = WIFICONFIG();
+    int best = -1;
+
+    if (esp_wifi_scan_get_ap_records(&num, records) != ESP_OK || esp_wifi_sta_get_ap_info(&cur) != ESP_OK)
+    {
+        wifi_roam_idle();
+        return;
+    }
+
+    for (int i = 0; i < num; i++)
+    {
+        if (memcmp(records[i].bssid, cur.bssid, sizeof(cur.bssid)) != 0 &&
+            records[i].rssi >= cur.rssi + WIFI_ROAM_HYST_DB && (best < 0 || records[i].rssi > records[best].rssi))
+        {
+            best = i;
+        }
+    }
+
+    if (best < 0)
+    {
+        ESP_LOGI(TAG, "roam: no better AP than %d dBm", cur.rssi);
+        wifi_roam_idle();
+        return;
+    }
+
+    ESP_LOGI(TAG, "roam: " MACSTR " %d dBm -> " MACSTR " %d dBm, channel %d", MAC2STR(cur.bssid), cur.rssi,
+             MAC2STR(records[best].bssid), records[best].rssi, records[best].primary);
+
+    /* 指定BSSID与信道重新关联; 失败时按缓存失败的流程恢复为全信道扫描 */
+    wifi_config.sta.bssid_set = 1;
+    memcpy(wifi_config.sta.bssid, records[best].bssid, sizeof(wifi_config.sta.bssid));
+    wifi_config.sta.channel = records[best].primary;
+    g_ap_cache_used = 1;
+    g_roam_switch_us = esp_timer_get_time();
+    g_roam_state = WIFI_ROAM_SWITCH;
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    esp_wifi_disconnect();                          /* 断开事件中立即连接新AP */
+}
+
+/**
+ * @brief       漫游定时器回调
+ * @param       arg : 未用到
+ * @retval      无
+ */
+static void wifi_roam_timer_cb(void *arg)
+{
+    (void)arg;
+
+    if (g_roam_state == WIFI_ROAM_SEARCH)
+    {
+        wifi_roam_scan();                           /* AP没有引导 */
+    }
+    else if (g_roam_state == WIFI_ROAM_IDLE)
+    {
+        esp_wifi_set_rssi_threshold(WIFI_ROAM_RSSI_DBM);    /* 冷却结束, 事件只触发一次, 须重新设置 */
+    }
+}
+#endif
+
 /**
  * @brief       链接显示
  * @param       flag:2->链接;1->链接失败;0->再链接中
@@ -103,9 +414,39 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
     /* 连接WIFI失败事件 */
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
     {
+#if WIFI_ROAM_EN
+        wifi_event_sta_disconnected_t *disconn = (wifi_event_sta_disconnected_t *)event_data;
+
+        if (disconn->reason == WIFI_REASON_ROAMING)
+        {
+            g_roam_switch_us = esp_timer_get_time();    /* BTM/FT切换由协议栈完成, 不重连 */
+            g_roam_state = WIFI_ROAM_SWITCH;
+            return;
+        }
+
+        if (g_roam_state == WIFI_ROAM_SWITCH && esp_timer_get_time() - g_roam_switch_us < WIFI_ROAM_HOLD_MS * 1000LL)
+        {
+            esp_wifi_connect();                         /* 自行扫描选中的AP, 不计入断线 */
+            return;
+        }
+
+        g_roam_state = WIFI_ROAM_IDLE;
+#endif
         network_connet.connet_state |= 0x02;
-        /* 尝试连接 */
-        if (s_retry_num < 20)
+        g_sta_disconnects++;
+
+        /* 按缓存的BSSID/信道连接失败(AP换了信道或更换了AP): 恢复为全信道扫描 */
+        if (g_ap_cache_used)
+        {
+            wifi_config_t wifi_config = WIFICONFIG();
+
+            g_ap_cache_used = 0;
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+            ESP_LOGI(TAG, "cached AP not found, full scan");
+        }
+
+        /* 尝试连接(启动后的断线一直重试) */
+        if (s_retry_num < 20 || wifi_event == NULL)
         {
             esp_wifi_connect();
             s_retry_num ++;
@@ -126,10 +467,43 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "static ip:" IPSTR, IP2STR(&event->ip_info.ip));
         s_retry_num = 0;
+#if WIFI_FAST_CONNECT_EN
+        wifi_cache_save();
+#endif
+#if WIFI_ROAM_EN
+        if (g_roam_state == WIFI_ROAM_SWITCH)
+        {
+            ESP_LOGI(TAG, "roam: done in %lld ms", (esp_timer_get_time() - g_roam_switch_us) / 1000);
+        }
+
+        g_roam_state = WIFI_ROAM_IDLE;
+        g_roam_channels = 0;
+        esp_wifi_set_rssi_threshold(WIFI_ROAM_RSSI_DBM);
+#endif
         sprintf(network_connet.ip_buf, "static ip:" IPSTR, IP2STR(&event->ip_info.ip));
         network_connet.fun(network_connet.connet_state);
-        xEventGroupSetBits(wifi_event, WIFI_CONNECTED_BIT);
+
+        if (wifi_event != NULL)
+        {
+            xEventGroupSetBits(wifi_event, WIFI_CONNECTED_BIT);
+        }
+    }
+#if WIFI_ROAM_EN
+    /* 当前AP信号低于 WIFI_ROAM_RSSI_DBM */
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_BSS_RSSI_LOW)
+    {
+        ESP_LOGI(TAG, "roam: rssi %d dBm, searching", ((wifi_event_bss_rssi_low_t *)event_data)->rssi);
+        wifi_roam_search();
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_NEIGHBOR_REP && g_roam_state == WIFI_ROAM_SEARCH)
+    {
+        wifi_roam_neighbor_report((wifi_event_neighbor_report_t *)event_data);
     }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE && g_roam_state == WIFI_ROAM_SCAN)
+    {
+        wifi_roam_scan_done();
+    }
+#endif
 }
 
 /**
@@ -155,9 +529,31 @@ void wifi_sta_init(void)
     ESP_ERROR_CHECK( esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL) );
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));    
     wifi_config_t  wifi_config = WIFICONFIG();
+#if WIFI_ROAM_EN
+    const esp_timer_create_args_t roam_timer_args = {
+        .callback = wifi_roam_timer_cb,
+        .name = "wifi_roam",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&roam_timer_args, &g_roam_timer));
+#endif
+#if WIFI_FAST_CONNECT_EN
+    /* 有缓存时只在上次的信道上查找上次的AP, 省去全信道扫描 */
+    if (wifi_cache_load(&g_ap_cache) == ESP_OK)
+    {
+        wifi_config.sta.bssid_set = 1;
+        memcpy(wifi_config.sta.bssid, g_ap_cache.bssid, sizeof(g_ap_cache.bssid));
+        wifi_config.sta.channel = g_ap_cache.channel;
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+        g_ap_cache_used = 1;
+    }
+#endif
+#if WIFI_STATIC_IP_EN
+    wifi_static_ip_set(sta_netif);
+#endif
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK( esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start());
+    wifi_profile_apply(WIFI_PROFILE_DEFAULT);   /* 省电模式/带宽/发射功率 */
 
     /* 等待链接成功后、ip生成 */
     EventBits_t bits = xEventGroupWaitBits( wifi_event,
@@ -183,4 +579,115 @@ void wifi_sta_init(void)
     }
 
     vEventGroupDelete(wifi_event);
+    wifi_event = NULL;                  /* 之后的断线由事件回调一直重连 */
+}
+
+/**
+ * @brief       上电以来STA断开的次数(每次重连尝试失败也计一次)
+ * @param       无
+ * @retval      次数
+ */
+uint32_t wifi_sta_disconnects(void)
+{
+    return g_sta_disconnects;
+}
+
+/**
+ * @brief       是否正在切换AP(漫游)
+ * @note        从断开当前AP到在新AP上获得IP, 最长 WIFI_ROAM_HOLD_MS; 期间TCP连接保持, 发送线程暂存帧
+ * @param       无
+ * @retval      1:切换中; 0:未在切换
+ */
+int wifi_sta_roaming(void)
+{
+#if WIFI_ROAM_EN
+    return g_roam_state == WIFI_ROAM_SWITCH && esp_timer_get_time() - g_roam_switch_us < WIFI_ROAM_HOLD_MS * 1000LL;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief       热点事件回调(客户端加入/离开/分配到地址)
+ * @param       arg:未用到
+ * @param       event_base:事件类型
+ * @param       event_id:事件ID
+ * @param       event_data:事件数据
+ * @retval      无
+ */
+static void wifi_ap_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STACONNECTED)
+    {
+        wifi_event_ap_staconnected_t *event = (wifi_event_ap_staconnected_t *)event_data;
+        ESP_LOGI(TAG, "client " MACSTR " joined", MAC2STR(event->mac));
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STADISCONNECTED)
+    {
+        wifi_event_ap_stadisconnected_t *event = (wifi_event_ap_stadisconnected_t *)event_data;
+        ESP_LOGI(TAG, "client " MACSTR " left", MAC2STR(event->mac));
+        g_sta_disconnects++;
+        spilcd_show_string(0, 170, 240, 16, 16, "client: none         ", MAGENTA);
+    }
+    else if (event_base == IP_EVENT && event_id == IP_EVENT_AP_STAIPASSIGNED)
+    {
+        ip_event_ap_staipassigned_t *event = (ip_event_ap_staipassigned_t *)event_data;
+        ESP_LOGI(TAG, "client ip:" IPSTR, IP2STR(&event->ip));
+        sprintf(lcd_buff, "client: " IPSTR "   ", IP2STR(&event->ip));
+        spilcd_show_string(0, 170, 240, 16, 16, lcd_buff, MAGENTA);
+    }
+}
+
+/**
+ * @brief       热点初始化(代替 wifi_sta_init, 热点启动后立即返回, 不等待客户端)
+ * @param       无
+ * @retval      无
+ */
+void wifi_softap_init(void)
+{
+    esp_netif_t *ap_netif;
+    esp_netif_ip_info_t ip_info;
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    wifi_config_t wifi_config = {
+        .ap = {
+            .ssid = WIFI_SOFTAP_SSID,
+            .ssid_len = sizeof(WIFI_SOFTAP_SSID) - 1,
+            .password = WIFI_SOFTAP_PWD,
+            .channel = WIFI_SOFTAP_CHANNEL,
+            .authmode = WIFI_AUTH_WPA2_PSK,
+            .max_connection = WIFI_SOFTAP_MAX_CONN,
+            .beacon_interval = WIFI_SOFTAP_BEACON_TU,
+            .dtim_period = WIFI_SOFTAP_DTIM,
+            .pmf_cfg = {
+                .required = false,
+            },
+        },
+    };
+
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    ap_netif = esp_netif_create_default_wifi_ap();
+    assert(ap_netif);
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_ap_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_AP_STAIPASSIGNED, &wifi_ap_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
+    ESP_ERROR_CHECK(esp_wifi_start());
+    wifi_profile_apply(WIFI_SOFTAP_HT40_EN ? WIFI_PROFILE_THROUGHPUT : WIFI_PROFILE_LATENCY);
+    esp_wifi_set_inactive_time(WIFI_IF_AP, WIFI_SOFTAP_INACTIVE_S);
+
+    esp_netif_get_ip_info(ap_netif, &ip_info);
+    ESP_LOGI(TAG, "softap %s on channel %d, http://" IPSTR "/", WIFI_SOFTAP_SSID, WIFI_SOFTAP_CHANNEL,
+             IP2STR(&ip_info.ip));
+
+    spilcd_fill(0, 90, 320, 240, WHITE);
+    sprintf(lcd_buff, "ap:%s", WIFI_SOFTAP_SSID);
+    spilcd_show_string(0, 90, 240, 16, 16, lcd_buff, BLUE);
+    sprintf(lcd_buff, "psw:%s", WIFI_SOFTAP_PWD);
+    spilcd_show_string(0, 110, 240, 16, 16, lcd_buff, BLUE);
+    sprintf(lcd_buff, "http://" IPSTR "/", IP2STR(&ip_info.ip));
+    spilcd_show_string(0, 150, 240, 16, 16, lcd_buff, MAGENTA);
+    spilcd_show_string(0, 170, 240, 16, 16, "client: none", MAGENTA);
 }
@@ -33,6 +33,33 @@
 #include "spilcd.h"
 
 
+#define WIFI_FAST_CONNECT_EN    1                   /* 1:缓存上次连接的BSSID与信道, 重连时只扫描该信道 */
+#define WIFI_CACHE_NAMESPACE    "wifi_cache"        /* AP缓存的NVS命名空间 */
+#define WIFI_ROAM_EN            1                   /* 1:漫游(802.11k邻居报告/802.11v BTM/802.11r FT, 信号弱时后台扫描) */
+#define WIFI_ROAM_RSSI_DBM      -70                 /* 当前AP信号低于该值时开始寻找更好的AP */
+#define WIFI_ROAM_HYST_DB       8                   /* 自行扫描时新AP须比当前强这么多才切换 */
+#define WIFI_ROAM_QUERY_MS      1000                /* 等待AP邻居报告/BTM引导的时间, 超时改为自行扫描 */
+#define WIFI_ROAM_COOLDOWN_MS   10000               /* 一次寻找没有结果后, 隔这么久再允许触发 */
+#define WIFI_ROAM_HOLD_MS       3000                /* 切换AP的最长时间, 期间发送线程暂存帧; 超过按断线处理 */
+#define WIFI_STATIC_IP_EN       0                   /* 1:使用静态IP(不经DHCP); 0:DHCP(恢复上次租约, CONFIG_LWIP_DHCP_RESTORE_LAST_IP) */
+#define WIFI_STATIC_IP          "192.168.31.200"    /* 静态IP配置, 须与路由器网段一致且不在DHCP地址池内 */
+#define WIFI_STATIC_GW          "192.168.31.1"
+#define WIFI_STATIC_NETMASK     "255.255.255.0"
+#define WIFI_STATIC_DNS         "192.168.31.1"
+
+/* 热点直连模式: 板子自建热点(不经路由器), 手机/电脑连上后打开 http://192.168.4.1/ 观看(板载MJPEG/WebSocket服务),
+ * 电脑上的 viewer.py 也可接收推流(第一个DHCP地址 WIFI_SOFTAP_CLIENT_IP). 只接入一个客户端, 空口全部留给它 */
+#define WIFI_SOFTAP_EN          0                   /* 1:热点模式(代替STA); 0:连接路由器 */
+#define WIFI_SOFTAP_SSID        "ESP32-CAMERA"      /* 热点名称 */
+#define WIFI_SOFTAP_PWD         "12345678"          /* 热点密码(WPA2, 至少8位) */
+#define WIFI_SOFTAP_CHANNEL     1                   /* 固定信道; HT40时次信道在上方, 须为1~7 */
+#define WIFI_SOFTAP_HT40_EN     1                   /* 1:HT40(throughput组合); 0:HT20(latency组合), 信道拥挤时用HT20 */
+#define WIFI_SOFTAP_MAX_CONN    1                   /* 客户端数上限 */
+#define WIFI_SOFTAP_BEACON_TU   100                 /* 信标间隔(TU=1.024ms) */
+#define WIFI_SOFTAP_DTIM        1                   /* 每个信标都是DTIM: 省电中的手机每个信标醒来取缓存的帧, 不多等 */
+#define WIFI_SOFTAP_INACTIVE_S  10                  /* 客户端无数据多久视为离开(释放唯一的连接名额) */
+#define WIFI_SOFTAP_CLIENT_IP   "192.168.4.2"       /* 推流目标: 热点分配的第一个地址 */
+
 /* WIFI设备信息 */
 typedef struct _network_connet_info_t
 {
@@ -46,5 +73,8 @@ extern network_connet_info network_connet;
 
 /* 声明函数 */
 void wifi_sta_init(void);
+void wifi_softap_init(void);
+uint32_t wifi_sta_disconnects(void);
+int wifi_sta_roaming(void);
 
 #endif
@@ -0,0 +1,117 @@
+/**
+ ****************************************************************************************************
+ * @file        wifi_profile.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       WIFI推流参数组合(省电模式、带宽、发射功率), 运行时可切换
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ ****************************************************************************************************
+ */
+
+#include "wifi_profile.h"
+#include <string.h>
+#include "esp_wifi.h"
+#include "esp_log.h"
+
+
+/* 一种组合的参数 */
+typedef struct
+{
+    const char *name;
+    wifi_ps_type_t ps;                                              /* 省电模式 */
+    wifi_bandwidth_t bandwidth;                                     /* 信道带宽 */
+    int8_t tx_power;                                                /* 最大发射功率(0.25dBm) */
+} wifi_profile_param_t;
+
+static const wifi_profile_param_t g_wifi_profiles[WIFI_PROFILE_NUM] = {
+    [WIFI_PROFILE_THROUGHPUT] = {"throughput", WIFI_PS_NONE,      WIFI_BW_HT40, WIFI_PROFILE_MAX_TX_POWER},
+    [WIFI_PROFILE_LATENCY]    = {"latency",    WIFI_PS_NONE,      WIFI_BW_HT20, WIFI_PROFILE_MAX_TX_POWER},
+    [WIFI_PROFILE_BATTERY]    = {"battery",    WIFI_PS_MAX_MODEM, WIFI_BW_HT20, WIFI_PROFILE_BATTERY_TX_POWER},
+};
+
+static wifi_profile_t g_wifi_profile = WIFI_PROFILE_DEFAULT;
+
+
+/**
+ * @brief       切换推流参数组合
+ * @param       profile : 组合
+ * @retval      ESP_OK:成功; ESP_ERR_INVALID_ARG:组合无效; 其他:WIFI驱动返回的错误
+ */
+esp_err_t wifi_profile_apply(wifi_profile_t profile)
+{
+    const wifi_profile_param_t *param;
+    wifi_mode_t mode = WIFI_MODE_STA;
+    esp_err_t ret;
+
+    if (profile >= WIFI_PROFILE_NUM)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    param = &g_wifi_profiles[profile];
+    ret = esp_wifi_set_ps(param->ps);
+
+    if (ret == ESP_OK && esp_wifi_get_mode(&mode) == ESP_OK)
+    {
+        ret = esp_wifi_set_bandwidth(mode == WIFI_MODE_AP ? WIFI_IF_AP : WIFI_IF_STA, param->bandwidth);
+    }
+
+    if (ret == ESP_OK)
+    {
+        ret = esp_wifi_set_max_tx_power(param->tx_power);
+    }
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW("TAG", "wifi profile %s: %s", param->name, esp_err_to_name(ret));
+        return ret;
+    }
+
+    g_wifi_profile = profile;
+    ESP_LOGI("TAG", "wifi profile: %s", param->name);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief       按名称切换推流参数组合
+ * @param       name : "throughput", "latency" 或 "battery"(可带结尾的换行)
+ * @retval      ESP_OK:成功; ESP_ERR_NOT_FOUND:名称无效; 其他:WIFI驱动返回的错误
+ */
+esp_err_t wifi_profile_apply_name(const char *name)
+{
+    size_t len;
+
+    for (int i = 0; i < WIFI_PROFILE_NUM; i++)
+    {
+        len = strlen(g_wifi_profiles[i].name);
+
+        if (strncmp(name, g_wifi_profiles[i].name, len) == 0 &&
+            (name[len] == '\0' || name[len] == '\r' || name[len] == '\n' || name[len] == ' '))
+        {
+            return wifi_profile_apply((wifi_profile_t)i);
+        }
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief       取得当前推流参数组合
+ * @param       无
+ * @retval      当前组合
+ */
+wifi_profile_t wifi_profile_get(void)
+{
+    return g_wifi_profile;
+}
@@ -0,0 +1,53 @@
+/**
+ ****************************************************************************************************
+ * @file        wifi_profile.h
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       WIFI推流参数组合(省电模式、带宽、发射功率), 运行时可切换
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 实验平台:正点原子 ESP32-S3 开发板
+ * 在线视频:www.yuanzige.com
+ * 技术论坛:www.openedv.com
+ * 公司网址:www.alientek.com
+ * 购买地址:openedv.taobao.com
+ *
+ * 三种组合, 服务器发送 "wifi <名称>" 切换:
+ * throughput : 关闭modem sleep, HT40, 最大发射功率. 信道干净时码率最高
+ * latency    : 关闭modem sleep, HT20, 最大发射功率. 不等待DTIM唤醒, 拥挤的2.4G信道下重传更少
+ * battery    : 最大modem sleep(按DTIM唤醒), HT20, 发射功率降到 WIFI_PROFILE_BATTERY_TX_POWER
+ * HT40需要AP同时支持, 切换带宽在下次关联时生效; 热点模式(WIFI_SOFTAP_EN)下设置的是板子自己热点的带宽.
+ * A-MPDU窗口与收发缓冲数量是编译期参数(sdkconfig, 按throughput组合设置),
+ * 无法在运行时切换.
+ *
+ ****************************************************************************************************
+ */
+
+#ifndef __WIFI_PROFILE_H
+#define __WIFI_PROFILE_H
+
+#include "esp_err.h"
+
+
+#define WIFI_PROFILE_DEFAULT            WIFI_PROFILE_LATENCY    /* 启动时使用的组合 */
+#define WIFI_PROFILE_MAX_TX_POWER       78                      /* 最大发射功率(单位0.25dBm, 78=19.5dBm) */
+#define WIFI_PROFILE_BATTERY_TX_POWER   52                      /* battery组合的发射功率(13dBm) */
+
+/* 推流参数组合 */
+typedef enum
+{
+    WIFI_PROFILE_THROUGHPUT = 0,
+    WIFI_PROFILE_LATENCY,
+    WIFI_PROFILE_BATTERY,
+    WIFI_PROFILE_NUM,
+} wifi_profile_t;
+
+/* 函数声明 */
+esp_err_t wifi_profile_apply(wifi_profile_t profile);               /* 切换推流参数组合(esp_wifi_start之后调用) */
+esp_err_t wifi_profile_apply_name(const char *name);                /* 按名称切换(控制命令) */
+wifi_profile_t wifi_profile_get(void);                              /* 当前组合 */
+
+#endif
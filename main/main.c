@@ -19,6 +19,7 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 #include "nvs_flash.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
@@ -30,6 +31,27 @@
 #include "xl9555.h"
 #include "wifi_config.h"
 #include "lwip_demo.h"
+#include "lcd_preview.h"
+#include "lcd_hud.h"
+#include "motion_detect.h"
+#include "face_detect.h"
+#include "cam_resume.h"
+#include "av_audio.h"
+#include "task_topo.h"
+#include "synth_frame.h"
+#include "frame_replay.h"
+#include "soak.h"
+#include "perf_prof.h"
+#include "heap_stats.h"
+#include "trace.h"
+#include "bench.h"
+#include "h264_stream.h"
+#include "uvc_webcam.h"
+#include "espnow_link.h"
+#include "timelapse.h"
+#include "pm_ctrl.h"
+#include "mqtt_events.h"
+#include "metrics.h"
 #include "esp_camera.h"
 #include <stdio.h>
 
@@ -52,6 +74,10 @@
 #define CAM_PIN_D6      GPIO_NUM_17
 #define CAM_PIN_D7      GPIO_NUM_18
 
+/* 并行启动 */
+#define BOOT_LCD_BIT    BIT0            /* LCD初始化完成 */
+#define BOOT_WIFI_BIT   BIT1            /* WIFI已连接(或重试失败) */
+
 
 #define CAM_PWDN(x)         do{ x ? \
                                 (xl9555_pin_write(OV_PWDN_IO, 1)):       \
@@ -63,6 +89,8 @@
                                 (xl9555_pin_write(OV_RESET_IO, 0));       \
                             }while(0)
 
+static EventGroupHandle_t g_boot_event = NULL;  /* 启动线程 -> app_main */
+
 /* 摄像头配置 */
 static camera_config_t camera_config = {
     /* 引脚配置 */
@@ -84,16 +112,16 @@ static camera_config_t camera_config = {
     .pin_href = CAM_PIN_HREF,
     .pin_pclk = CAM_PIN_PCLK,
 
-    /* XCLK 20MHz or 10MHz for OV2640 double FPS (Experimental) */
+    /* XCLK 20MHz or 10MHz for OV2640 double FPS (Experimental); 运行时降低帧率用 sensor_fps(分频传感器内部时钟) */
     .xclk_freq_hz = 15000000,
     .ledc_timer = LEDC_TIMER_0,
     .ledc_channel = LEDC_CHANNEL_0,
 
-    .pixel_format = PIXFORMAT_JPEG,     /* YUV422,GRAYSCALE,RGB565,JPEG */
-    .frame_size = FRAMESIZE_QVGA,       /* QQVGA-UXGA, For ESP32, do not use sizes above QVGA when not JPEG. The performance of the ESP32-S series has improved a lot, but JPEG mode always gives better frame rates */
+    .pixel_format = H264_STREAM_EN ? PIXFORMAT_YUV422 : PIXFORMAT_JPEG, /* YUV422,GRAYSCALE,RGB565,JPEG; H.264编码(h264_stream)读取YUV422 */
+    .frame_size = FRAMESIZE_QVGA,       /* QQVGA-UXGA, For ESP32, do not use sizes above QVGA when not JPEG. The performance of the ESP32-S series has improved a lot, but JPEG mode always gives better frame rates; 码率控制(rate_ctrl)以此为最高分辨率 */
 
-    .jpeg_quality = 12,                 /* 0-63, for OV series camera sensors, lower number means higher quality */
-    .fb_count = 2,                      /* When jpeg mode is used, if fb_count more than one, the driver will work in continuous mode */
+    .jpeg_quality = 12,                 /* 0-63, for OV series camera sensors, lower number means higher quality; 码率控制(rate_ctrl)以此为最高质量 */
+    .fb_count = 6,                      /* When jpeg mode is used, if fb_count more than one, the driver will work in continuous mode; fb_count - 1 frames can be in flight on the network (one fewer with LCD_PREVIEW_EN, MJPEG_FB_HELD_MAX fewer with MJPEG_SERVER_EN) */
     .fb_location = CAMERA_FB_IN_PSRAM,
     .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
 };
@@ -105,12 +133,18 @@ static camera_config_t camera_config = {
  */
 static esp_err_t init_camera(void)
 {
-    if (CAM_PIN_PWDN == GPIO_NUM_NC)
+    if (CAM_PIN_PWDN == GPIO_NUM_NC && CAM_PIN_RESET == GPIO_NUM_NC)
+    {
+        xl9555_pins_write(OV_PWDN_IO | OV_RESET_IO, 0);     /* 退出掉电并拉低复位, 一次写入 */
+        vTaskDelay(pdMS_TO_TICKS(20));
+        CAM_RST(1);
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    else if (CAM_PIN_PWDN == GPIO_NUM_NC)
     {
         CAM_PWDN(0);
     } 
-
-    if (CAM_PIN_RESET == GPIO_NUM_NC)
+    else if (CAM_PIN_RESET == GPIO_NUM_NC)
     { 
         CAM_RST(0);
         vTaskDelay(pdMS_TO_TICKS(20));
@@ -141,11 +175,47 @@ static esp_err_t init_camera(void)
         s->set_vflip(s, 1);         /* 向后翻转 */
     }
 
+    cam_resume_start();             /* 唤醒时恢复曝光快照, 冷启动时等待曝光收敛并保存快照 */
+
     return ESP_OK;
 }
 
+/**
+ * @brief       LCD与WIFI启动线程, 与摄像头初始化并行
+ * @note        WIFI连接状态显示在LCD上, 所以先初始化LCD; 无头模式(MY_SPI_LCD_PANEL)下LCD阶段立即完成,
+ *              各处的状态文字不显示, 由 /metrics 读取. 完成后删除自身
+ * @param       pvParameters : 传入参数(未用到)
+ * @retval      无
+ */
+static void boot_net_thread(void *pvParameters)
+{
+    pvParameters = pvParameters;
+
+    if (spilcd_init() == ESP_OK)    /* LCD屏初始化 */
+    {
+        spilcd_show_string(0, 0, 240, 32, 32, "ESP32-S3", RED);
+        spilcd_show_string(0, 40, 240, 24, 24, "WiFi CAMERA Test", RED);
+        spilcd_show_string(0, 70, 240, 16, 16, "ATOM@ALIENTEK", RED);
+    }
+
+    xEventGroupSetBits(g_boot_event, BOOT_LCD_BIT);
+
+#if ESPNOW_LINK_EN && !BENCH_EN
+    espnow_link_wifi_init();    /* 只启动射频与ESP-NOW, 不关联AP */
+#elif WIFI_SOFTAP_EN
+    wifi_softap_init();         /* 自建热点, 不等待客户端 */
+#else
+    wifi_sta_init();            /* 阻塞到获得IP */
+#endif
+    xEventGroupSetBits(g_boot_event, BOOT_WIFI_BIT);
+
+    vTaskDelete(NULL);
+}
+
 /**
  * @brief       程序入口
+ * @note        LCD复位延时与WIFI扫描/关联/DHCP在启动线程中进行, 同时本线程探测传感器、分配帧缓存并等待曝光收敛,
+ *              两者都完成后开始推流
  * @param       无
  * @retval      无
  */
@@ -153,6 +223,13 @@ void app_main(void)
 {
     esp_err_t ret;
 
+    heap_stats_init();          /* 分配失败计数, 须在其他模块分配之前 */
+    trace_init();               /* 跟踪事件环形缓冲 */
+    pm_ctrl_init();             /* 动态调频与自动浅睡眠, 须在摄像头与WIFI初始化之前 */
+#if PERF_PROF_EN
+    perf_prof_init();           /* 热点区间性能计数, 须在摄像头初始化之前注册驱动回调 */
+#endif
+
     ret = nvs_flash_init();     /* 初始化NVS */
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
     {
@@ -164,19 +241,64 @@ void app_main(void)
     my_spi_init();              /* SPI初始化 */
     myiic_init();               /* IIC初始化 */  
     xl9555_init();              /* 初始化按键 */
-    spilcd_init();              /* LCD屏初始化 */
- 
-    spilcd_show_string(0, 0, 240, 32, 32, "ESP32-S3", RED);
-    spilcd_show_string(0, 40, 240, 24, 24, "WiFi CAMERA Test", RED);
-    spilcd_show_string(0, 70, 240, 16, 16, "ATOM@ALIENTEK", RED);
-    wifi_sta_init();
-
-    /* 初始化摄像头 */
+
+    g_boot_event = xEventGroupCreate();
+    assert(g_boot_event);
+    xTaskCreatePinnedToCore(boot_net_thread, "boot_net_thread", BOOT_NET_STACK, NULL, BOOT_NET_PRIO, NULL, BOOT_NET_CORE);
+
+    /* 初始化摄像头(与LCD/WIFI并行) */
     while (init_camera())
     {
+        xEventGroupWaitBits(g_boot_event, BOOT_LCD_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
         spilcd_show_string(30, 110, 200, 16, 16, "CAMERA Fail!", BLUE);
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
 
-    lwip_demo();            /* lwip测试代码 */
+#if LCD_PASSTHROUGH_EN && !BENCH_EN
+    xEventGroupWaitBits(g_boot_event, BOOT_LCD_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    lcd_passthrough_run(&camera_config);    /* 本地取景直通模式, 不推流(只在初始化失败时返回) */
+#endif
+
+#if UVC_WEBCAM_EN && !BENCH_EN
+    uvc_webcam_run(&camera_config);         /* USB UVC摄像头模式, 不推流(只在初始化失败时返回) */
+#endif
+
+#if ESPNOW_LINK_EN && !BENCH_EN
+    xEventGroupWaitBits(g_boot_event, BOOT_LCD_BIT | BOOT_WIFI_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    espnow_link_run(&camera_config);        /* ESP-NOW图传到网关板, 不推流(不返回) */
+#endif
+
+#if TIMELAPSE_EN && !BENCH_EN
+    xEventGroupWaitBits(g_boot_event, BOOT_LCD_BIT | BOOT_WIFI_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    timelapse_run(&camera_config);          /* 定时拍摄, 两次拍摄之间浅睡眠, 不推流(不返回) */
+#endif
+
+#if SYNTH_FRAME_EN
+    synth_frame_init();         /* 合成帧固件: 推流帧由预分配缓冲产生, 不启动本地使用者与音频 */
+#elif !BENCH_EN
+    xEventGroupWaitBits(g_boot_event, BOOT_LCD_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    lcd_preview_init();         /* LCD实时取景(无屏时不启动) */
+    motion_detect_init();       /* 移动侦测, 无移动时降低上传帧率 */
+    face_detect_init(&camera_config);   /* 人脸检测, 结果以元数据帧上传 */
+    av_audio_init();            /* 麦克风采集, 与图像同一连接发送 */
+#endif
+#if FRAME_REPLAY_EN
+    frame_replay_start();       /* 重放固件: 录像预载完成后代替传感器向驱动注入帧 */
+#endif
+
+    /* 等待LCD与WIFI就绪后开始推流 */
+    xEventGroupWaitBits(g_boot_event, BOOT_LCD_BIT | BOOT_WIFI_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+#if SOAK_EN
+    soak_start();               /* 稳定性测试固件: 每分钟输出吞吐、时延、内存与栈余量 */
+#endif
+#if !BENCH_EN
+    lcd_hud_init();             /* 屏幕状态显示(帧率/码率/时延/RSSI/丢帧/内存) */
+    mqtt_events_init();         /* 侦测事件批量发布到MQTT */
+#endif
+#if BENCH_EN
+    bench_run(&camera_config);  /* 基准测试固件: 扫描参数组合, 结果以JSON行输出 */
+#else
+    metrics_boot_done();        /* 启动耗时(camera_boot_seconds) */
+    lwip_demo(&camera_config);  /* lwip测试代码 */
+#endif
 }
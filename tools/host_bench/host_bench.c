@@ -0,0 +1,737 @@
+/**
+ ****************************************************************************************************
+ * @file        host_bench.c
+ * @author      正点原子团队(ALIENTEK)
+ * @version     V1.0
+ * @date        2025-01-01
+ * @brief       转换函数的主机基准测试: 在PC上运行 esp32-camera conversions 与 main/APP 的解码、转码函数
+ * @license     Copyright (c) 2020-2032, 广州市星翼电子科技有限公司
+ ****************************************************************************************************
+ * @attention
+ *
+ * 与设备上的 bench_kernel.c 测量同一组函数, 输出同样格式的JSON行(每像素纳秒数), 用于在PC上快速迭代算法,
+ * 可直接用 perf record / valgrind --tool=cachegrind 分析. 绝对数值与ESP32-S3不可比, 只比较改动前后的相对变化.
+ * 用法: host_bench [-n 重复次数] [JPEG文件...], 不指定文件时使用 esp32-camera 的三张测试图片.
+ * 测量前先在各缩放比例下比较 jpg2strips()(jpg_fast)与 esp_jpg_decode()(tjpgd)的RGB888输出,
+ * 输出 "verify" 行(PSNR与最大差值), PSNR低于 HOST_BENCH_MIN_PSNR 时返回失败; 再以 tjpgd 解码 jpg_requant 的输出,
+ * 输出 "requant" 行(转码前后的长度与PSNR), 输出不小于原图或PSNR低于 HOST_BENCH_REQUANT_PSNR 时返回失败;
+ * 最后把原图与中间画上方块的图各编码一次, jpg_tiles_encode() 先后输出完整帧与增量帧, 按接收端的方法拼回JPEG,
+ * 输出 "tiles" 行(发送的分块数、字节数与PSNR), 拼回的图与方块图的解码输出PSNR低于 HOST_BENCH_TILES_PSNR 时返回失败.
+ *
+ ****************************************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "img_converters.h"
+#include "rgb_resample.h"
+#include "jpg_requant.h"
+
+
+#define HOST_BENCH_REPEAT           20                              /* 默认重复次数(取最小值) */
+#define HOST_BENCH_QUALITY          12                              /* fmt2jpg 的编码质量, 与设备一致 */
+#define HOST_BENCH_STRIP_LINES      16                              /* jpg2strips 的条带行数(与LCD取景一致) */
+#define HOST_BENCH_MIN_PSNR         30.0                            /* jpg_fast 与 tjpgd 输出的最低PSNR(dB) */
+#define HOST_BENCH_LCD_SIZE         240                             /* rgb_resample 的输出尺寸(240x240屏, 旋转90度) */
+#define HOST_BENCH_REQUANT_QUALITY  30                              /* jpg_requant 的输出质量 */
+#define HOST_BENCH_REQUANT_PSNR     22.0                            /* 转码结果与原图解码输出的最低PSNR(dB) */
+#define HOST_BENCH_TILES_BOX        32                              /* 增量帧测试在画面中间画的方块边长 */
+#define HOST_BENCH_TILES_PSNR       40.0                            /* 拼回的图与方块图解码输出的最低PSNR(dB), 低于阈值的块变化不发送 */
+
+/* 一张图片的输入与输出缓冲 */
+typedef struct
+{
+    uint8_t *jpg;
+    size_t jpg_len;
+    uint8_t *rgb565;                                                /* w*h*2, 同时作为YUV422输入 */
+    uint8_t *rgb888;                                                /* w*h*3 */
+    uint8_t *strip;                                                 /* jpg2strips 的条带缓冲 */
+    size_t strip_size;
+    uint16_t width;
+    uint16_t height;
+} host_bench_buf_t;
+
+typedef bool (*host_bench_fn_t)(host_bench_buf_t *buf);
+
+void yuv2rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t *r, uint8_t *g, uint8_t *b);
+
+
+/**
+ * @brief       单调时钟(ns)
+ * @param       无
+ * @retval      当前时间
+ */
+static uint64_t host_bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief       从SOF标记读出JPEG的宽高
+ * @param       jpg    : JPEG数据
+ * @param       len    : 长度
+ * @param       width  : 输出宽度
+ * @param       height : 输出高度
+ * @retval      true:成功; false:没有找到SOF
+ */
+static bool host_bench_jpg_size(const uint8_t *jpg, size_t len, uint16_t *width, uint16_t *height)
+{
+    size_t i = 2;
+
+    while (i + 9 < len)
+    {
+        if (jpg[i] != 0xFF)
+        {
+            return false;
+        }
+
+        if (jpg[i + 1] >= 0xC0 && jpg[i + 1] <= 0xC2)               /* SOF0/1/2 */
+        {
+            *height = (uint16_t)((jpg[i + 5] << 8) | jpg[i + 6]);
+            *width = (uint16_t)((jpg[i + 7] << 8) | jpg[i + 8]);
+            return true;
+        }
+
+        i += 2 + ((jpg[i + 2] << 8) | jpg[i + 3]);
+    }
+
+    return false;
+}
+
+static bool host_bench_jpg2rgb565(host_bench_buf_t *buf)
+{
+    return jpg2rgb565(buf->jpg, buf->jpg_len, buf->rgb565, JPG_SCALE_NONE);
+}
+
+static bool host_bench_fmt2rgb888(host_bench_buf_t *buf)
+{
+    return fmt2rgb888(buf->jpg, buf->jpg_len, PIXFORMAT_JPEG, buf->rgb888);
+}
+
+static bool host_bench_fmt2jpg(host_bench_buf_t *buf)
+{
+    uint8_t *out = NULL;
+    size_t out_len = 0;
+    bool ok = fmt2jpg(buf->rgb565, (size_t)buf->width * buf->height * 2, buf->width, buf->height,
+                      PIXFORMAT_RGB565, HOST_BENCH_QUALITY, &out, &out_len);
+
+    free(out);
+    return ok;
+}
+
+static bool host_bench_fmt2jpg_yuv(host_bench_buf_t *buf)
+{
+    uint8_t *out = NULL;
+    size_t out_len = 0;
+    bool ok = fmt2jpg(buf->rgb565, (size_t)buf->width * buf->height * 2, buf->width & ~1, buf->height,
+                      PIXFORMAT_YUV422, HOST_BENCH_QUALITY, &out, &out_len);
+
+    free(out);
+    return ok;
+}
+
+static bool host_bench_fmt2bmp(host_bench_buf_t *buf)
+{
+    uint8_t *out = NULL;
+    size_t out_len = 0;
+    bool ok = fmt2bmp(buf->rgb565, (size_t)buf->width * buf->height * 2, buf->width, buf->height,
+                      PIXFORMAT_RGB565, &out, &out_len);
+
+    free(out);
+    return ok;
+}
+
+static bool host_bench_yuv2rgb(host_bench_buf_t *buf)
+{
+    const uint8_t *in = buf->rgb565;
+    uint8_t *rgb = buf->rgb888;
+    size_t pixels = (size_t)buf->width * buf->height;
+
+    for (size_t i = 0; i < pixels; i += 2)                          /* Y0 U Y1 V */
+    {
+        yuv2rgb(in[0], in[1], in[3], &rgb[0], &rgb[1], &rgb[2]);
+        yuv2rgb(in[2], in[1], in[3], &rgb[3], &rgb[4], &rgb[5]);
+        in += 4;
+        rgb += 6;
+    }
+
+    return true;
+}
+
+static bool host_bench_strip_cb(void *arg, jpg_strip_t *strip)
+{
+    (void)arg;
+    (void)strip;
+    return true;
+}
+
+static bool host_bench_jpg_strip(host_bench_buf_t *buf)
+{
+    static esp_jpg_dec_t dec;
+
+    return jpg2strips(&dec, buf->jpg, buf->jpg_len, JPG_SCALE_NONE, JPG_STRIP_RGB565_BE, buf->strip, buf->strip_size,
+                       HOST_BENCH_STRIP_LINES, host_bench_strip_cb, NULL);
+}
+
+static bool host_bench_resample_out(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t **buf)
+{
+    uint16_t **out = (uint16_t **)arg;
+
+    (void)x;
+    (void)y;
+    (void)w;
+    (void)h;
+    *buf = (*buf == out[0]) ? out[1] : out[0];                      /* 与取景相同的双缓冲 */
+    return true;
+}
+
+static bool host_bench_resample_strip(void *arg, jpg_strip_t *strip)
+{
+    rgb_resample_t *rs = (rgb_resample_t *)arg;
+
+    return rgb_resample_rows(rs, (const uint16_t *)strip->data, strip->y, strip->lines);
+}
+
+static bool host_bench_rgb_resample(host_bench_buf_t *buf)
+{
+    static esp_jpg_dec_t dec;
+    static rgb_resample_t rs;
+    static uint16_t out[2][HOST_BENCH_LCD_SIZE * HOST_BENCH_STRIP_LINES];
+    static uint16_t *bufs[2] = { out[0], out[1] };
+    jpg_scale_t scale = JPG_SCALE_NONE;
+
+    while (scale < JPG_SCALE_MAX &&                                 /* 与 lcd_preview 相同: 解码到不小于输出的最大比例 */
+           (buf->width >> (scale + 1)) >= HOST_BENCH_LCD_SIZE && (buf->height >> (scale + 1)) >= HOST_BENCH_LCD_SIZE)
+    {
+        scale++;
+    }
+
+    if ((buf->width >> scale) > RGB_RESAMPLE_SRC_MAX_W ||
+        !rgb_resample_init(&rs, buf->width >> scale, buf->height >> scale, HOST_BENCH_LCD_SIZE, HOST_BENCH_LCD_SIZE,
+                           RGB_ROTATE_90, RGB_FILTER_BILINEAR, out[0], HOST_BENCH_LCD_SIZE * HOST_BENCH_STRIP_LINES,
+                           host_bench_resample_out, bufs))
+    {
+        return false;
+    }
+
+    return jpg2strips(&dec, buf->jpg, buf->jpg_len, scale, JPG_STRIP_RGB565, buf->strip, buf->strip_size,
+                       HOST_BENCH_STRIP_LINES, host_bench_resample_strip, &rs) && rgb_resample_done(&rs);
+}
+
+static bool host_bench_jpg_requant(host_bench_buf_t *buf)
+{
+    static jpg_requant_t rq;
+    size_t out_len;
+
+    return jpg_requant(&rq, buf->jpg, buf->jpg_len, HOST_BENCH_REQUANT_QUALITY,
+                       buf->rgb888, (size_t)buf->width * buf->height * 3, &out_len) == JPG_REQUANT_OK;
+}
+
+static bool host_bench_jpg_tiles(host_bench_buf_t *buf)
+{
+    static jpg_tiles_t jt;
+    static int16_t *ref = NULL;
+    static size_t ref_cap = 0;
+    size_t need = ((size_t)buf->width / 8 + 1) * (buf->height / 8 + 1) * 3;
+    size_t out_len;
+    bool key;
+
+    if (ref_cap < need)
+    {
+        free(ref);
+        ref = calloc(need, sizeof(int16_t));
+        ref_cap = need;
+        jpg_tiles_reset(&jt);
+    }
+
+    jt.ref = ref;
+    jt.ref_cap = ref_cap;                                           /* 第一次为完整帧, 之后为静止画面的增量帧 */
+    return jpg_tiles_encode(&jt, buf->jpg, buf->jpg_len, 100, buf->rgb888, (size_t)buf->width * buf->height * 3, &out_len, &key) == JPG_REQUANT_OK;
+}
+
+static bool host_bench_jpg_thumb(host_bench_buf_t *buf)
+{
+    static esp_jpg_dec_t dec;
+    uint16_t w;
+    uint16_t h;
+
+    return jpg2thumb(&dec, buf->jpg, buf->jpg_len, JPG_STRIP_GRAY, buf->rgb888, (size_t)buf->width * buf->height * 3, &w, &h);
+}
+
+/* 被测函数, fmt2jpg/fmt2bmp 使用 jpg2rgb565 的输出, 必须排在其后 */
+static const struct
+{
+    const char *name;
+    host_bench_fn_t fn;
+} g_host_kernels[] = {
+    { "jpg2rgb565", host_bench_jpg2rgb565 },
+    { "fmt2rgb888", host_bench_fmt2rgb888 },
+    { "fmt2jpg",    host_bench_fmt2jpg },
+    { "fmt2jpg_yuv", host_bench_fmt2jpg_yuv },
+    { "fmt2bmp",    host_bench_fmt2bmp },
+    { "yuv2rgb",    host_bench_yuv2rgb },
+    { "jpg_strip",  host_bench_jpg_strip },
+    { "jpg_thumb",  host_bench_jpg_thumb },
+    { "rgb_resample", host_bench_rgb_resample },
+    { "jpg_requant", host_bench_jpg_requant },
+    { "jpg_tiles",  host_bench_jpg_tiles },
+};
+
+/* tjpgd 参考解码的输出 */
+typedef struct
+{
+    const uint8_t *jpg;
+    size_t jpg_len;
+    uint8_t *rgb;                                                   /* 整幅RGB888 */
+    uint16_t width;
+    uint16_t height;
+} host_bench_ref_t;
+
+static size_t host_bench_ref_read(void *arg, size_t index, uint8_t *buf, size_t len)
+{
+    host_bench_ref_t *ref = (host_bench_ref_t *)arg;
+
+    if (buf != NULL)
+    {
+        memcpy(buf, ref->jpg + index, len);
+    }
+
+    return len;
+}
+
+static bool host_bench_ref_write(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    host_bench_ref_t *ref = (host_bench_ref_t *)arg;
+
+    if (data == NULL)
+    {
+        if (x == 0 && y == 0)
+        {
+            ref->width = w;
+            ref->height = h;
+        }
+
+        return true;
+    }
+
+    for (uint16_t iy = 0; iy < h && y + iy < ref->height; iy++)
+    {
+        uint16_t n = (x + w > ref->width) ? ref->width - x : w;
+
+        memcpy(ref->rgb + ((size_t)(y + iy) * ref->width + x) * 3, data + (size_t)iy * w * 3, (size_t)n * 3);
+    }
+
+    return true;
+}
+
+/**
+ * @brief       以 tjpgd 解码 jpg_requant 的输出, 与原图的解码输出比较
+ * @param       path : 文件路径(只用于输出)
+ * @param       buf  : 图片缓冲(rgb888 作为原图的解码输出)
+ * @param       ref  : 参考解码(rgb 作为转码结果的解码输出)
+ * @retval      0:成功; -1:转码失败、输出没有变小或差别过大
+ */
+static int host_bench_verify_requant(const char *path, host_bench_buf_t *buf, host_bench_ref_t *ref)
+{
+    static jpg_requant_t rq;
+    static esp_jpg_dec_t dec;
+    size_t size = (size_t)buf->width * buf->height * 3;
+    uint8_t *out = malloc(buf->jpg_len);
+    size_t out_len = 0;
+    double sse = 0;
+    double psnr;
+    int ret;
+
+    ret = jpg_requant(&rq, buf->jpg, buf->jpg_len, HOST_BENCH_REQUANT_QUALITY, out, buf->jpg_len, &out_len);
+    ref->jpg = out;
+    ref->jpg_len = out_len;
+
+    if (ret != JPG_REQUANT_OK ||
+        esp_jpg_decode(out_len, JPG_SCALE_NONE, host_bench_ref_read, host_bench_ref_write, ref) != ESP_OK ||
+        !jpg2strips(&dec, buf->jpg, buf->jpg_len, JPG_SCALE_NONE, JPG_STRIP_RGB888, buf->rgb888, size, 0, NULL, NULL))
+    {
+        printf("{\"file\":\"%s\",\"requant\":%d,\"error\":\"%s\"}\n", path, HOST_BENCH_REQUANT_QUALITY,
+               (ret == JPG_REQUANT_OK) ? "decode failed" : "requant failed");
+        free(out);
+        return -1;
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        int diff = (int)buf->rgb888[i] - (int)ref->rgb[i];
+
+        sse += (double)diff * diff;
+    }
+
+    psnr = (sse == 0) ? 99.0 : 10.0 * log10(255.0 * 255.0 * size / sse);
+    printf("{\"file\":\"%s\",\"requant\":%d,\"bytes_in\":%zu,\"bytes_out\":%zu,\"ratio\":%.3f,\"psnr\":%.2f}\n",
+           path, HOST_BENCH_REQUANT_QUALITY, buf->jpg_len, out_len, (double)out_len / buf->jpg_len, psnr);
+
+    free(out);
+    return (out_len < buf->jpg_len && psnr >= HOST_BENCH_REQUANT_PSNR) ? 0 : -1;
+}
+
+/**
+ * @brief       按接收端的方法拼接: 以增量帧中的分块替换完整帧对应的重同步间隔
+ * @param       key     : 完整帧(带DRI)
+ * @param       key_len : 完整帧长度
+ * @param       delta   : 增量帧(jpg_tiles_delta_t)
+ * @param       out     : 输出JPEG
+ * @param       cap     : 输出缓冲大小
+ * @retval      输出长度, 0:格式错误
+ */
+static size_t host_bench_tiles_splice(const uint8_t *key, size_t key_len, const uint8_t *delta, uint8_t *out, size_t cap)
+{
+    const jpg_tiles_delta_t *dh = (const jpg_tiles_delta_t *)delta;
+    const uint8_t **seg = calloc(dh->tiles, sizeof(*seg));
+    size_t *seg_len = calloc(dh->tiles, sizeof(*seg_len));
+    const uint8_t *p = delta + sizeof(*dh);
+    size_t pos = 2;
+    size_t n = 0;
+    size_t len = 0;
+    uint16_t tiles = 0;
+
+    while (pos + 4 <= key_len && key[pos] == 0xFF && key[pos + 1] != 0xDA)  /* 找到SOS */
+    {
+        pos += 2 + ((key[pos + 2] << 8) | key[pos + 3]);
+    }
+
+    pos += 2 + ((key[pos + 2] << 8) | key[pos + 3]);
+    memcpy(out, key, pos);
+    len = pos;
+    seg[0] = key + pos;
+
+    for (size_t i = pos; i + 1 < key_len && tiles < dh->tiles; i++)  /* 按RST/EOI切分(数据中的0xFF后都是0x00) */
+    {
+        if (key[i] == 0xFF && key[i + 1] != 0x00)
+        {
+            seg_len[tiles] = (size_t)(key + i - seg[tiles]);
+
+            if (++tiles < dh->tiles)
+            {
+                seg[tiles] = key + i + 2;
+            }
+
+            i++;
+        }
+    }
+
+    for (uint16_t k = 0; k < dh->count && tiles == dh->tiles; k++)
+    {
+        const jpg_tile_entry_t *e = (const jpg_tile_entry_t *)p;
+
+        seg[e->index] = p + sizeof(*e);
+        seg_len[e->index] = e->len;
+        p += sizeof(*e) + e->len;
+    }
+
+    for (uint16_t t = 0; t < dh->tiles && tiles == dh->tiles && len + seg_len[t] + 4 <= cap; t++, n++)
+    {
+        memcpy(out + len, seg[t], seg_len[t]);
+        len += seg_len[t];
+        out[len++] = 0xFF;
+        out[len++] = (t + 1 < dh->tiles) ? (uint8_t)(0xD0 + (t & 7)) : 0xD9;
+    }
+
+    free(seg);
+    free(seg_len);
+    return (n == dh->tiles) ? len : 0;
+}
+
+/**
+ * @brief       增量帧测试: 原图与画上方块的图依次分块编码, 拼回后与方块图的解码输出比较
+ * @param       path : 文件路径(只用于输出)
+ * @param       buf  : 图片缓冲(rgb565 作为重新编码的输入)
+ * @param       ref  : 参考解码(rgb 作为拼回结果的解码输出)
+ * @retval      0:一致; -1:编码失败或拼回的图与方块图差别过大
+ */
+static int host_bench_verify_tiles(const char *path, host_bench_buf_t *buf, host_bench_ref_t *ref)
+{
+    static jpg_tiles_t jt;
+    static esp_jpg_dec_t dec;
+    size_t size = (size_t)buf->width * buf->height * 3;
+    size_t need = ((size_t)buf->width / 8 + 1) * (buf->height / 8 + 1) * 3;
+    uint8_t *a = NULL;
+    uint8_t *b = NULL;
+    size_t a_len = 0;
+    size_t b_len = 0;
+    size_t cap;
+    uint8_t *key_jpg;
+    uint8_t *delta;
+    uint8_t *joined;
+    size_t key_len = 0;
+    size_t delta_len = 0;
+    size_t joined_len = 0;
+    uint16_t *px = (uint16_t *)buf->rgb565;
+    bool key_a = false;
+    bool key_b = true;
+    double sse = 0;
+    double psnr;
+    int ret = -1;
+
+    if (!jpg2rgb565(buf->jpg, buf->jpg_len, buf->rgb565, JPG_SCALE_NONE) ||
+        !fmt2jpg(buf->rgb565, size / 3 * 2, buf->width, buf->height, PIXFORMAT_RGB565, HOST_BENCH_QUALITY, &a, &a_len))
+    {
+        return -1;
+    }
+
+    for (int y = (buf->height - HOST_BENCH_TILES_BOX) / 2; y < (buf->height + HOST_BENCH_TILES_BOX) / 2; y++)
+    {
+        for (int x = (buf->width - HOST_BENCH_TILES_BOX) / 2; x < (buf->width + HOST_BENCH_TILES_BOX) / 2; x++)
+        {
+            px[(size_t)y * buf->width + x] = 0xFFFF;
+        }
+    }
+
+    fmt2jpg(buf->rgb565, size / 3 * 2, buf->width, buf->height, PIXFORMAT_RGB565, HOST_BENCH_QUALITY, &b, &b_len);
+    cap = a_len * 2 + b_len * 2 + 4096;
+    key_jpg = malloc(cap);
+    delta = malloc(cap);
+    joined = malloc(cap);
+    jt.ref = calloc(need, sizeof(int16_t));
+    jt.ref_cap = need;
+    jpg_tiles_reset(&jt);
+
+    if (b != NULL &&
+        jpg_tiles_encode(&jt, a, a_len, 100, key_jpg, cap, &key_len, &key_a) == JPG_REQUANT_OK &&
+        jpg_tiles_encode(&jt, b, b_len, 100, delta, cap, &delta_len, &key_b) == JPG_REQUANT_OK && key_a && !key_b)
+    {
+        joined_len = host_bench_tiles_splice(key_jpg, key_len, delta, joined, cap);
+    }
+
+    ref->jpg = joined;
+    ref->jpg_len = joined_len;
+
+    if (joined_len > 0 &&
+        esp_jpg_decode(joined_len, JPG_SCALE_NONE, host_bench_ref_read, host_bench_ref_write, ref) == ESP_OK &&
+        jpg2strips(&dec, b, b_len, JPG_SCALE_NONE, JPG_STRIP_RGB888, buf->rgb888, size, 0, NULL, NULL))
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            int diff = (int)buf->rgb888[i] - (int)ref->rgb[i];
+
+            sse += (double)diff * diff;
+        }
+
+        psnr = (sse == 0) ? 99.0 : 10.0 * log10(255.0 * 255.0 * size / sse);
+        ret = (psnr >= HOST_BENCH_TILES_PSNR) ? 0 : -1;
+        printf("{\"file\":\"%s\",\"tiles\":%u,\"sent\":%u,\"bytes_full\":%zu,\"bytes_delta\":%zu,\"ratio\":%.3f,\"psnr\":%.2f}\n",
+               path, ((jpg_tiles_delta_t *)delta)->tiles, ((jpg_tiles_delta_t *)delta)->count, key_len, delta_len,
+               (double)delta_len / key_len, psnr);
+    }
+    else
+    {
+        printf("{\"file\":\"%s\",\"tiles\":0,\"error\":\"encode or splice failed\"}\n", path);
+    }
+
+    free(a);
+    free(b);
+    free(key_jpg);
+    free(delta);
+    free(joined);
+    free(jt.ref);
+    return ret;
+}
+
+/**
+ * @brief       在各缩放比例下比较 jpg2strips() 与 tjpgd 参考解码的输出
+ * @param       path : 文件路径(只用于输出)
+ * @param       buf  : 图片缓冲(rgb888 作为 jpg2strips 的输出)
+ * @retval      0:一致(PSNR不低于 HOST_BENCH_MIN_PSNR); -1:解码失败或差别过大
+ */
+static int host_bench_verify(const char *path, host_bench_buf_t *buf)
+{
+    static esp_jpg_dec_t dec;
+    host_bench_ref_t ref = { .jpg = buf->jpg, .jpg_len = buf->jpg_len };
+    size_t size = (size_t)buf->width * buf->height * 3;
+    double sse;
+    double psnr;
+    size_t n;
+    int max_diff;
+    int diff;
+    int ret = 0;
+
+    ref.rgb = calloc(size, 1);
+
+    for (int scale = JPG_SCALE_NONE; scale <= JPG_SCALE_MAX && ret == 0; scale++)
+    {
+        if (esp_jpg_decode(buf->jpg_len, (jpg_scale_t)scale, host_bench_ref_read, host_bench_ref_write, &ref) != ESP_OK ||
+            !jpg2strips(&dec, buf->jpg, buf->jpg_len, (jpg_scale_t)scale, JPG_STRIP_RGB888, buf->rgb888, size, 0, NULL, NULL))
+        {
+            printf("{\"file\":\"%s\",\"verify\":%d,\"error\":\"decode failed\"}\n", path, scale);
+            ret = -1;
+            break;
+        }
+
+        n = (size_t)ref.width * ref.height * 3;
+        sse = 0;
+        max_diff = 0;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            diff = abs((int)buf->rgb888[i] - (int)ref.rgb[i]);
+            max_diff = (diff > max_diff) ? diff : max_diff;
+            sse += (double)diff * diff;
+        }
+
+        psnr = (sse == 0) ? 99.0 : 10.0 * log10(255.0 * 255.0 * n / sse);
+        printf("{\"file\":\"%s\",\"verify\":%d,\"width\":%u,\"height\":%u,\"psnr\":%.2f,\"max_diff\":%d}\n",
+               path, scale, ref.width, ref.height, psnr, max_diff);
+        ret = (psnr >= HOST_BENCH_MIN_PSNR) ? 0 : -1;
+    }
+
+    if (ret == 0)
+    {
+        ret = host_bench_verify_requant(path, buf, &ref);
+    }
+
+    if (ret == 0)
+    {
+        ret = host_bench_verify_tiles(path, buf, &ref);
+    }
+
+    free(ref.rgb);
+    return ret;
+}
+
+/**
+ * @brief       读入整个文件
+ * @param       path : 文件路径
+ * @param       len  : 输出长度
+ * @retval      文件内容(malloc), NULL:读取失败
+ */
+static uint8_t *host_bench_load(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *data = NULL;
+    long size;
+
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0)
+    {
+        data = malloc(size);
+
+        if (data != NULL && fread(data, 1, size, f) != (size_t)size)
+        {
+            free(data);
+            data = NULL;
+        }
+
+        *len = (size_t)size;
+    }
+
+    fclose(f);
+    return data;
+}
+
+/**
+ * @brief       测量一张图片
+ * @param       path   : 文件路径
+ * @param       repeat : 每项重复次数
+ * @retval      0:成功; -1:文件无法读取或解码
+ */
+static int host_bench_file(const char *path, int repeat)
+{
+    host_bench_buf_t buf;
+    uint64_t best;
+    uint64_t start;
+    uint64_t ns;
+    size_t pixels;
+    int ret = 0;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.jpg = host_bench_load(path, &buf.jpg_len);
+
+    if (buf.jpg == NULL || !host_bench_jpg_size(buf.jpg, buf.jpg_len, &buf.width, &buf.height))
+    {
+        fprintf(stderr, "%s: not a baseline JPEG\n", path);
+        free(buf.jpg);
+        return -1;
+    }
+
+    pixels = (size_t)buf.width * buf.height;
+    buf.rgb565 = calloc(pixels, 2);
+    buf.rgb888 = calloc(pixels, 3);
+    buf.strip_size = (size_t)buf.width * HOST_BENCH_STRIP_LINES * 2;
+    buf.strip = malloc(buf.strip_size);
+    ret = host_bench_verify(path, &buf);
+
+    for (size_t k = 0; k < sizeof(g_host_kernels) / sizeof(g_host_kernels[0]) && ret == 0; k++)
+    {
+        best = UINT64_MAX;
+
+        for (int i = 0; i < repeat; i++)
+        {
+            start = host_bench_now_ns();
+
+            if (!g_host_kernels[k].fn(&buf))
+            {
+                printf("{\"file\":\"%s\",\"kernel\":\"%s\",\"error\":\"failed\"}\n", path, g_host_kernels[k].name);
+                ret = -1;
+                break;
+            }
+
+            ns = host_bench_now_ns() - start;
+            best = (ns < best) ? ns : best;
+        }
+
+        if (ret == 0)
+        {
+            printf("{\"file\":\"%s\",\"kernel\":\"%s\",\"width\":%u,\"height\":%u,\"ns\":%llu,\"ns_per_pixel\":%.3f}\n",
+                   path, g_host_kernels[k].name, buf.width, buf.height,
+                   (unsigned long long)best, (double)best / pixels);
+        }
+    }
+
+    free(buf.jpg);
+    free(buf.rgb565);
+    free(buf.rgb888);
+    free(buf.strip);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *defaults[] = {
+        HOST_BENCH_PICTURES "/testimg.jpeg",
+        HOST_BENCH_PICTURES "/test_inside.jpeg",
+        HOST_BENCH_PICTURES "/test_outside.jpeg",
+    };
+    int repeat = HOST_BENCH_REPEAT;
+    int first = 1;
+    int failed = 0;
+
+    if (argc > 2 && strcmp(argv[1], "-n") == 0)
+    {
+        repeat = atoi(argv[2]);
+        repeat = (repeat > 0) ? repeat : 1;
+        first = 3;
+    }
+
+    if (first >= argc)
+    {
+        for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++)
+        {
+            failed += (host_bench_file(defaults[i], repeat) != 0);
+        }
+    }
+    else
+    {
+        for (int i = first; i < argc; i++)
+        {
+            failed += (host_bench_file(argv[i], repeat) != 0);
+        }
+    }
+
+    return failed ? 1 : 0;
+}
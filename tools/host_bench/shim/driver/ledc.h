@@ -0,0 +1,5 @@
+/* 主机构建: esp_camera.h 只用到LEDC的类型 */
+#pragma once
+
+typedef int ledc_timer_t;
+typedef int ledc_channel_t;
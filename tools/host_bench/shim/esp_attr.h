@@ -0,0 +1,7 @@
+/* 主机构建: 段属性为空 */
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define EXT_RAM_BSS_ATTR
+#define RTC_DATA_ATTR
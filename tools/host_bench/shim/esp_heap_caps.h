@@ -0,0 +1,15 @@
+/* 主机构建: heap_caps 直接使用 malloc, 忽略内存类型 */
+#pragma once
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT         (1 << 2)
+#define MALLOC_CAP_DMA          (1 << 3)
+#define MALLOC_CAP_SPIRAM       (1 << 10)
+#define MALLOC_CAP_INTERNAL     (1 << 11)
+#define MALLOC_CAP_DEFAULT      (1 << 12)
+
+#define heap_caps_malloc(size, caps)            malloc(size)
+#define heap_caps_calloc(n, size, caps)         calloc(n, size)
+#define heap_caps_realloc(ptr, size, caps)      realloc(ptr, size)
+#define heap_caps_aligned_alloc(a, size, caps)  aligned_alloc(a, ((size) + (a) - 1) / (a) * (a))
+#define heap_caps_free(ptr)                     free(ptr)
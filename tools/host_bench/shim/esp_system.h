@@ -0,0 +1,5 @@
+/* 主机构建: esp_jpg_decode.c 以 IDF 5 处理, 未定义芯片型号时使用 target/tjpgd.c 软件解码 */
+#pragma once
+#include "esp_err.h"
+
+#define ESP_IDF_VERSION_MAJOR   5
@@ -0,0 +1,4 @@
+/* 主机构建: 不使用PSRAM分配路径 */
+#pragma once
+
+#define CONFIG_CAMERA_JPEG_FAST_DECODE 1
@@ -0,0 +1,2 @@
+/* 主机构建: 转换代码不访问eFuse */
+#pragma once
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+ESP-NOW 网关串口转发（固件 ESPNOW_LINK_EN + espnow_gateway 工程）
+- 从网关板的 USB 串口读取转发帧：16 字节头（'ENGW'、摄像头 MAC、保留、长度，小端）+ 帧（帧头 + JPEG，与 TCP 推流相同）
+- 每台摄像头（按 MAC）建立一条 TCP 连接，把帧原样交给 viewer.py / ingest_server.py，接收端无需修改
+- ingest_server 按对端 IP 区分摄像头，目标在本机时每路连接绑定不同的回环源地址 127.<MAC后三字节>（Linux/Windows 可用）
+- 串口数据断续（网关写超时丢帧）时按 'ENGW' 重新同步
+
+用法示例：
+    pip install pyserial
+    python ./tools/pc_viewer/espnow_serial.py --serial /dev/ttyACM0 --host 127.0.0.1 --port 8000
+"""
+import argparse
+import socket
+import struct
+import sys
+import time
+from typing import Dict
+
+import serial
+
+RELAY_MAGIC = b"ENGW"
+RELAY_HEADER = struct.Struct("<4s6sHI")
+RELAY_MAX = 1 << 20  # 大于网关重组缓冲，超过即视为失步
+RECONNECT_S = 2.0
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="ESP-NOW gateway serial -> TCP relay")
+    parser.add_argument("--serial", required=True, help="网关 USB 串口，如 /dev/ttyACM0 或 COM5")
+    parser.add_argument("--host", default="127.0.0.1", help="viewer/ingest_server 地址，默认 127.0.0.1")
+    parser.add_argument("--port", type=int, default=8000, help="viewer/ingest_server 端口，默认 8000")
+    return parser.parse_args()
+
+
+def read_exact(port: serial.Serial, n: int) -> bytes:
+    buf = bytearray()
+    while len(buf) < n:
+        chunk = port.read(n - len(buf))
+        if chunk:
+            buf += chunk
+    return bytes(buf)
+
+
+def sync(port: serial.Serial) -> None:
+    """读到 'ENGW' 为止（之后的数据从 MAC 开始）。"""
+    window = b""
+    while True:
+        window = (window + read_exact(port, 1))[-len(RELAY_MAGIC):]
+        if window == RELAY_MAGIC:
+            return
+
+
+class Relay:
+    """每台摄像头一条 TCP 连接，断开后 RECONNECT_S 内丢帧再重连。"""
+
+    def __init__(self, host: str, port: int):
+        self.host = host
+        self.port = port
+        self.local = host.startswith("127.") or host == "localhost"
+        self.conns: Dict[bytes, socket.socket] = {}
+        self.retry_at: Dict[bytes, float] = {}
+        self.frames: Dict[bytes, int] = {}
+
+    def _connect(self, mac: bytes) -> socket.socket:
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        if self.local:
+            try:
+                sock.bind(("127.%d.%d.%d" % (mac[3], mac[4], mac[5]), 0))
+            except OSError as exc:
+                print(f"[WARN] 无法绑定回环源地址（{exc}），多台摄像头会共用 ingest_server 的同一槽位")
+        sock.connect((self.host, self.port))
+        return sock
+
+    def send(self, mac: bytes, frame: bytes) -> None:
+        sock = self.conns.get(mac)
+        if sock is None:
+            if time.monotonic() < self.retry_at.get(mac, 0.0):
+                return
+            try:
+                sock = self.conns[mac] = self._connect(mac)
+                print(f"[INFO] {mac.hex(':')} -> {self.host}:{self.port}")
+            except OSError as exc:
+                print(f"[WARN] {mac.hex(':')}: 连接失败 {exc}")
+                self.retry_at[mac] = time.monotonic() + RECONNECT_S
+                return
+        try:
+            sock.sendall(frame)
+            self.frames[mac] = self.frames.get(mac, 0) + 1
+        except OSError as exc:
+            print(f"[WARN] {mac.hex(':')}: 连接断开 {exc}")
+            sock.close()
+            del self.conns[mac]
+            self.retry_at[mac] = time.monotonic() + RECONNECT_S
+
+
+def main() -> int:
+    args = parse_args()
+    relay = Relay(args.host, args.port)
+    port = serial.Serial(args.serial, baudrate=921600, timeout=1.0)  # USB-Serial-JTAG 忽略波特率
+    print(f"[INFO] 读取 {args.serial}")
+    last_log = time.monotonic()
+    resync = 0
+    try:
+        while True:
+            sync(port)
+            _, mac, _, length = RELAY_HEADER.unpack(RELAY_MAGIC + read_exact(port, RELAY_HEADER.size - 4))
+            if length == 0 or length > RELAY_MAX:
+                resync += 1
+                continue
+            relay.send(mac, read_exact(port, length))
+            now = time.monotonic()
+            if now - last_log >= 5.0:
+                rates = ", ".join(f"{m.hex(':')} {n / (now - last_log):.1f} fps" for m, n in relay.frames.items())
+                print(f"[INFO] {rates or '无帧'}; 失步 {resync} 次")
+                relay.frames.clear()
+                resync = 0
+                last_log = now
+    except KeyboardInterrupt:
+        pass
+    finally:
+        port.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
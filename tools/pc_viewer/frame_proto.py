@@ -0,0 +1,491 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+ESP32 摄像头 TCP 上行帧协议解析
+- 与固件 main/APP/frame_proto.h 中的 frame_header_t 一一对应（小端）
+- 每帧 = 28 字节帧头 + payload_len 字节图像数据，按长度 recv_into 到复用的缓冲，无需搜索 SOI/EOI
+- iter_frames(zero_copy=True) 直接产出缓冲的 memoryview（np.frombuffer 解码不再拷贝），只在下一次迭代前有效
+- 兼容旧固件：若连接首字节为 JPEG SOI，则回退到标记搜索方式（只扫描新到的数据）
+- 音频帧（FRAME_FLAG_AUDIO）与图像复用同一连接，timestamp_us 与图像帧同一时钟（设备 esp_timer）
+- 回填帧（FRAME_FLAG_SPOOL）与实时帧交错到达，不按实时画面产出
+- 下行控制命令用 build_command() 生成 16 字节 ctrl_cmd_t，设备以 FRAME_FLAG_CTRL 帧应答
+- 发送 build_command(CTRL_CMD_JPEG_ABBREV, 1) 后，表头不变的 JPEG 帧只带 SOS 之后的数据（未置 FRAME_FLAG_KEY），
+  iter_frames 按帧头扩展中的表头编号补上缓存的表头，产出的仍是完整 JPEG
+- 发送 build_command(CTRL_CMD_JPEG_TILES, 1) 并以 iter_frames(tiles=True) 接收时，完整帧为带重同步间隔（DRI）的 JPEG，
+  增量帧（pixformat=PIXFORMAT_JPEG_TILES）只带变化的分块，iter_frames 替换上一帧对应的分块后产出完整 JPEG
+- 发送 build_command(CTRL_CMD_DETECT, 1 或 2) 后，设备端人脸检测的结果以元数据帧（pixformat=PIXFORMAT_DETECT）上传，
+  交给 on_detect(帧头, [(x, y, w, h, score), ...])；arg=2 时设备只在检测到人脸期间上传图像
+- 发送 build_command(CTRL_CMD_STATIC_SKIP, 最长间隔 ms) 后，设备以压缩数据签名（长度 + 熵编码数据抽样哈希）判断画面未变化，
+  以占位帧（pixformat=PIXFORMAT_UNCHANGED，无负载，占用帧序号）代替，至少每隔该时间上传一帧真实图像；占位帧交给 on_unchanged(帧头)
+- 校时：发送若干 CTRL_CMD_CLOCK_PING（arg=本机 Unix 时间 us），应答负载为 CTRL_CLOCK_ACK，
+  clock_sample() 算出偏移与往返时间，取往返最短的一次以 CTRL_CMD_CLOCK_SET 下发；
+  此后所有帧头的 timestamp_us 为 Unix 时间（us），大于 CLOCK_SYNCED_MIN 即表示设备已校时（SNTP 或服务器）
+- 图像帧头可带驱动采样的传感器寄存器（ext_flags 置 FRAME_EXT_META，frame_header_meta_t），
+  iter_frames 解析后交给 on_meta(帧头, dict)，OV2640/OV3660/OV5640 另解出曝光行数、增益倍数与白平衡增益
+- 校时后 CTRL_CMD_CAPTURE_AT（arg=Unix 时间 us）让设备上传采集时间最接近该时刻的一帧，多台摄像头同时下发即同步抓拍
+- 边采集边发送的图像帧（ext_flags 置 FRAME_EXT_CHUNKED）payload_len 为 0，负载为若干（uint32 长度 + 数据）分段，
+  长度 0 的分段之后为实际长度；iter_frames 拼接后按普通帧产出，作废的帧（FRAME_CHUNK_ABORT）直接跳过
+- 固件 TLS_STREAM_EN 时连接先做 TLS 握手，接收端用 tls_server_context() 的上下文包装套接字，帧格式不变
+"""
+import re
+import socket
+import ssl
+import struct
+import time
+from typing import Callable, Iterator, NamedTuple, Optional, Tuple, Union
+
+FRAME_MAGIC = 0x46414D43  # 'CAMF'
+FRAME_VERSION = 1
+FRAME_HEADER = struct.Struct('<IBBBBIQHHI')
+FRAME_MAX_PAYLOAD = 8 * 1024 * 1024  # 超过则视为数据错乱
+FRAME_BUF_INIT = 256 * 1024  # 负载缓冲的初始大小，遇到更大的帧时按倍数增长
+LEGACY_CHUNK = 64 * 1024  # 旧协议每次 recv_into 的大小
+LEGACY_MAX = 1024 * 1024  # 旧协议下找不到 EOI 的累积上限，超过则丢弃重新同步
+FRAME_FLAG_KEY = 0x01  # 完整的独立帧；未置位的 JPEG 帧省略了表头
+FRAME_FLAG_STATS = 0x02  # 负载为时延统计文本（向设备发送 b"stats" 请求）
+FRAME_FLAG_AUDIO = 0x04  # 负载为 16 位小端 PCM，width=采样率，height=声道数
+FRAME_FLAG_SPOOL = 0x08  # 断线期间缓存在设备 Flash、重连后回填的历史帧（seq/timestamp_us 为原采集值）
+FRAME_FLAG_MOTION = 0x10  # 采集时设备检测到移动；无移动期间设备只以低帧率上传
+FRAME_FLAG_CTRL = 0x20  # 负载为控制命令应答 ctrl_ack_t
+FRAME_FLAG_PREVIEW = 0x40  # 设备由高分辨率帧缩小转码的子码流（高分辨率帧录在设备 SD 卡），照常显示
+FRAME_FLAG_BURST = 0x80  # 连拍帧（seq 为批内序号），交给 on_burst，不按实时画面产出
+
+CTRL_PROTO_MAGIC = 0x434D4143  # 'CAMC'
+CTRL_CMD = struct.Struct('<IBBHq')
+CTRL_ACK = struct.Struct('<BBbB')
+CTRL_CMD_SET_FRAMESIZE = 0x01  # arg: framesize_t（分辨率上限，不超过设备启动配置）
+CTRL_CMD_SET_QUALITY = 0x02  # arg: JPEG 质量上限（数值越小质量越高）
+CTRL_CMD_SET_FPS_CAP = 0x03  # arg: 上传帧率上限，0 不限制
+CTRL_CMD_SNAPSHOT = 0x04
+CTRL_CMD_START = 0x05
+CTRL_CMD_STOP = 0x06
+CTRL_CMD_STATS = 0x07
+CTRL_CMD_WIFI_PROFILE = 0x08  # arg: 0 throughput / 1 latency / 2 battery
+CTRL_CMD_CLIP = 0x09
+CTRL_CMD_REPLAY = 0x0A  # arg: 采集时间（us）
+CTRL_CMD_SET_ROI = 0x0B  # arg: 见 build_roi()
+CTRL_CMD_BURST = 0x0C  # arg: 帧数（1~16），锁定曝光以最高分辨率连拍
+CTRL_CMD_JPEG_ABBREV = 0x0D  # arg: 1 省略不变的 JPEG 表头（帧头后附 1 字节表头编号 + 3 字节保留），0 关闭
+CTRL_CMD_JPEG_TILES = 0x0E  # arg: 1 静态场景只发送变化的分块（增量帧 pixformat=PIXFORMAT_JPEG_TILES），0 关闭
+CTRL_CMD_DETECT = 0x0F  # arg: 1 上传人脸检测元数据，2 同时只在有人时上传图像，0 关闭
+CTRL_CMD_CLOCK_PING = 0x10  # arg: 本机发送时间（Unix us），应答为 CTRL_CLOCK_ACK
+CTRL_CMD_CLOCK_SET = 0x11  # arg: 偏移（us），设备时间戳 = esp_timer 时间 + arg
+CTRL_CMD_CAPTURE_AT = 0x12  # arg: Unix 时间（us），上传最接近该时刻的一帧（不受暂停限制），-1 取消
+CTRL_CMD_STATIC_SKIP = 0x13  # arg: 静止画面两次上传图像的最长间隔（ms），其间以 PIXFORMAT_UNCHANGED 占位帧代替，0 关闭
+CTRL_CLOCK_ACK = struct.Struct('<BBbBqq')  # cmd, seq, status, reserved, t1_us, device_us
+CLOCK_SYNCED_MIN = 10 ** 15  # 大于该值的 timestamp_us 为 Unix 时间（未校时为设备开机后的 esp_timer 时间）
+CTRL_STATUS_TEXT = {0: "ok", -1: "invalid arg", -2: "unsupported", -3: "failed"}
+
+FRAME_EXT_META = 0x01  # 扩展帧头 ext_flags：之后附 FRAME_META
+FRAME_EXT_META_OFFSET = 4  # table_id, ext_flags, reserved[2] 之后
+FRAME_META = struct.Struct('<HBB12H12B')  # sensor_pid, count, age, reg[12], value[12]
+FRAME_EXT_CHUNKED = 0x02  # 扩展帧头 ext_flags：payload_len 为 0，负载为分段
+FRAME_CHUNK_ABORT = 0xFFFFFFFF  # 分段长度：设备作废了本帧
+CHUNK_LEN = struct.Struct('<I')  # 分段长度；长度 0 结束本帧，其后再跟一个 uint32 实际长度
+OV2640_PID = 0x26
+OV3660_PID = 0x3660
+OV5640_PID = 0x5640
+
+PIXFORMAT_JPEG = 4  # pixformat_t
+PIXFORMAT_JPEG_TILES = 0x80  # 分块增量帧：jpg_tiles_delta_t + count 个（jpg_tile_entry_t + 熵编码数据）
+TILES_DELTA = struct.Struct('<HH')  # tiles, count
+TILES_ENTRY = struct.Struct('<HH')  # index, len
+PIXFORMAT_DETECT = 0x81  # 检测元数据帧：frame_detect_t（框数 + 3 字节保留 + count 个框），width/height 为被检测帧的宽高
+DETECT_BOX = struct.Struct('<HHHHBB')  # x, y, w, h, score(%), reserved
+PIXFORMAT_UNCHANGED = 0x82  # 占位帧：画面与上一次上传的图像几乎相同，无负载，接收端沿用上一帧
+RST_MARKER = re.compile(rb"\xff[\xd0-\xd7]")
+SOI = b"\xff\xd8"  # JPEG Start Of Image
+EOI = b"\xff\xd9"  # JPEG End Of Image
+
+
+class FrameHeader(NamedTuple):
+    magic: int
+    version: int
+    header_len: int
+    pixformat: int
+    flags: int
+    seq: int
+    timestamp_us: int
+    width: int
+    height: int
+    payload_len: int
+
+
+class ProtocolError(Exception):
+    """帧头校验失败（魔数/版本/长度异常）"""
+
+
+def recv_into_exact(conn: socket.socket, view: memoryview) -> bool:
+    """把 view 填满，对端关闭返回 False（接收超时不致命，继续等待）"""
+    got = 0
+    n = len(view)
+    while got < n:
+        try:
+            r = conn.recv_into(view[got:], n - got)
+        except socket.timeout:
+            continue
+        if r == 0:
+            return False
+        got += r
+    return True
+
+
+def recv_exact(conn: socket.socket, n: int) -> Optional[bytearray]:
+    """精确读取 n 字节，对端关闭返回 None"""
+    buf = bytearray(n)
+    return buf if recv_into_exact(conn, memoryview(buf)) else None
+
+
+def parse_header(raw: bytes) -> FrameHeader:
+    hdr = FrameHeader(*FRAME_HEADER.unpack_from(raw))
+    if hdr.magic != FRAME_MAGIC:
+        raise ProtocolError(f"bad magic 0x{hdr.magic:08x}")
+    if hdr.version != FRAME_VERSION or hdr.header_len < FRAME_HEADER.size:
+        raise ProtocolError(f"unsupported version={hdr.version} header_len={hdr.header_len}")
+    chunked = hdr.payload_len == 0 and hdr.header_len > FRAME_HEADER.size  # 由扩展帧头的 FRAME_EXT_CHUNKED 确认
+    unchanged = hdr.payload_len == 0 and hdr.pixformat == PIXFORMAT_UNCHANGED  # 静止画面占位帧只有帧头
+    if (hdr.payload_len == 0 and not (chunked or unchanged)) or hdr.payload_len > FRAME_MAX_PAYLOAD:
+        raise ProtocolError(f"bad payload_len={hdr.payload_len}")
+    return hdr
+
+
+def is_chunked(hdr: FrameHeader, ext: Union[bytes, memoryview]) -> bool:
+    """ext 为帧头之后的扩展部分（table_id, ext_flags, ...）"""
+    return hdr.payload_len == 0 and hdr.pixformat == PIXFORMAT_JPEG and len(ext) >= 2 and bool(ext[1] & FRAME_EXT_CHUNKED)
+
+
+def recv_chunked(conn: socket.socket, buf: bytearray) -> Optional[Tuple[bytearray, int]]:
+    """把分段负载（FRAME_EXT_CHUNKED）依次接收到 buf，放不下时换一块新缓冲（调用者可能仍持有旧缓冲的 memoryview）。
+    返回 (缓冲, 图像长度)，长度为 -1 表示设备作废了本帧；对端关闭返回 None"""
+    raw = bytearray(CHUNK_LEN.size)
+    got = 0
+    while True:
+        if not recv_into_exact(conn, memoryview(raw)):
+            return None
+        n, = CHUNK_LEN.unpack(raw)
+        if n == FRAME_CHUNK_ABORT:
+            return buf, -1
+        if n == 0:
+            if not recv_into_exact(conn, memoryview(raw)):
+                return None
+            total, = CHUNK_LEN.unpack(raw)
+            if total == 0 or total > got:
+                raise ProtocolError(f"bad chunked length {total} (received {got})")
+            return buf, total  # 已收到的数据可能多出 EOI 之后的 DMA 填充
+        if got + n > FRAME_MAX_PAYLOAD:
+            raise ProtocolError(f"chunked payload over {FRAME_MAX_PAYLOAD}")
+        if got + n > len(buf):
+            grown = bytearray(max(got + n, 2 * len(buf)))
+            grown[:got] = buf[:got]
+            buf = grown
+        if not recv_into_exact(conn, memoryview(buf)[got:got + n]):
+            return None
+        got += n
+
+
+def jpeg_sos(data: Union[bytes, memoryview]) -> int:
+    """返回 JPEG 中 SOS 标记的偏移（只遍历标记段），找不到返回 0"""
+    n = len(data)
+    if n < 4 or data[0] != 0xFF or data[1] != 0xD8:
+        return 0
+    pos = 2
+    while pos + 4 <= n:
+        if data[pos] != 0xFF:
+            return 0
+        marker = data[pos + 1]
+        if marker == 0xFF:
+            pos += 1
+        elif marker == 0xDA:
+            return pos
+        elif marker in (0xD8, 0x01) or 0xD0 <= marker <= 0xD7:
+            pos += 2
+        else:
+            pos += 2 + (data[pos + 2] << 8 | data[pos + 3])
+    return 0
+
+
+def tiles_split(data: Union[bytes, memoryview]) -> Optional[Tuple[bytes, list]]:
+    """把带 DRI 的完整帧拆成（SOS 段及之前的表头, 各分块的熵编码数据），不是 JPEG 返回 None"""
+    sos = jpeg_sos(data)
+    if not sos:
+        return None
+    data = bytes(data)
+    start = sos + 2 + (data[sos + 2] << 8 | data[sos + 3])
+    end = data.rfind(EOI)
+    if end < start:
+        return None
+    return data[:start], RST_MARKER.split(data[start:end])
+
+
+def tiles_merge(header: bytes, segs: list, delta: Union[bytes, memoryview]) -> Optional[bytes]:
+    """用增量帧替换 segs 中的分块并拼回完整 JPEG；分块数与完整帧不一致返回 None（等待下一帧完整帧）"""
+    tiles, count = TILES_DELTA.unpack_from(delta)
+    if tiles != len(segs):
+        return None
+    pos = TILES_DELTA.size
+    for _ in range(count):
+        index, n = TILES_ENTRY.unpack_from(delta, pos)
+        pos += TILES_ENTRY.size
+        if index >= tiles:
+            return None
+        segs[index] = bytes(delta[pos:pos + n])
+        pos += n
+    out = bytearray(header)
+    for i, seg in enumerate(segs):
+        if i:
+            out += bytes((0xFF, 0xD0 + ((i - 1) & 7)))
+        out += seg
+    out += EOI
+    return bytes(out)
+
+
+def parse_detect(data: Union[bytes, memoryview]) -> list:
+    """解析检测元数据帧的负载，返回 [(x, y, w, h, score), ...]（原始帧像素坐标，score 为百分比）"""
+    count = data[0] if len(data) else 0
+    return [DETECT_BOX.unpack_from(data, 4 + i * DETECT_BOX.size)[:5] for i in range(count)]
+
+
+def sensor_decode(pid: int, regs: dict) -> dict:
+    """把寄存器换算为曝光（行）、增益（倍）与白平衡增益；寄存器不全或型号未知时返回空 dict"""
+    try:
+        if pid == OV2640_PID:
+            g = regs[0x100]
+            gain = (1 + (g & 0x0F) / 16) * ((g >> 4 & 1) + 1) * ((g >> 5 & 1) + 1) * ((g >> 6 & 1) + 1) * ((g >> 7 & 1) + 1)
+            return {"exposure_lines": (regs[0x145] & 0x3F) << 10 | regs[0x110] << 2 | regs[0x104] & 0x03,
+                    "gain": round(gain, 3), "awb_blue": regs[0x101], "awb_red": regs[0x102]}
+        if pid in (OV3660_PID, OV5640_PID):
+            def awb(hi: int) -> float:
+                return round(((regs[hi] & 0x0F) << 8 | regs[hi + 1]) / 0x400, 3)
+            return {"exposure_lines": ((regs[0x3500] & 0x0F) << 16 | regs[0x3501] << 8 | regs[0x3502]) >> 4,
+                    "gain": round(((regs[0x350A] & 0x03) << 8 | regs[0x350B]) / 16, 3),
+                    "awb_red": awb(0x3400), "awb_green": awb(0x3402), "awb_blue": awb(0x3404)}
+    except KeyError:
+        pass
+    return {}
+
+
+def parse_meta(ext: Union[bytes, memoryview]) -> Optional[dict]:
+    """解析扩展帧头（帧头之后 header_len - 28 字节）中的寄存器采样，没有时返回 None。
+    返回 {"sensor_pid", "age"（采样后经过的帧数）, "regs"{地址: 值}} 加上 sensor_decode() 的字段"""
+    if len(ext) < FRAME_EXT_META_OFFSET + FRAME_META.size or not ext[1] & FRAME_EXT_META:
+        return None
+    fields = FRAME_META.unpack_from(ext, FRAME_EXT_META_OFFSET)
+    pid, count, age = fields[:3]
+    regs = dict(zip(fields[3:3 + count], fields[15:15 + count]))
+    meta = {"sensor_pid": pid, "age": age, "regs": regs}
+    meta.update(sensor_decode(pid, regs))
+    return meta
+
+
+def tls_server_context(cert: str, key: str) -> ssl.SSLContext:
+    """设备 TLS_STREAM_EN 时的服务端上下文：TLS 1.2 起，会话票据默认开启（设备重连时恢复会话，跳过证书与 ECDHE）。
+    自签证书可用：openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:P-256 -nodes -days 3650
+                  -keyout key.pem -out cert.pem -subj /CN=camera-server"""
+    ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    ctx.minimum_version = ssl.TLSVersion.TLSv1_2
+    ctx.load_cert_chain(cert, key)
+    return ctx
+
+
+def build_command(cmd: int, arg: int = 0, seq: int = 0) -> bytes:
+    """生成一条下行控制命令（conn.sendall 发送）"""
+    return CTRL_CMD.pack(CTRL_PROTO_MAGIC, cmd, seq & 0xFF, 0, arg)
+
+
+def clock_sample(t1_us: int, device_us: int, t4_us: int) -> Tuple[int, int]:
+    """一次 CTRL_CMD_CLOCK_PING 往返：返回 (CTRL_CMD_CLOCK_SET 的 arg, 往返时间 us)。
+    假设上下行时延相同，设备应答时刻对应本机 (t1 + t4) / 2，误差不超过往返时间的一半"""
+    return (t1_us + t4_us) // 2 - device_us, t4_us - t1_us
+
+
+def build_roi(x: int, y: int, w: int, h: int, seq: int = 0) -> bytes:
+    """生成设置 ROI 的命令，参数为全视场的千分比；build_roi(0, 0, 1000, 1000) 取消 ROI"""
+    arg = (x & 0xFFFF) | (y & 0xFFFF) << 16 | (w & 0xFFFF) << 32 | (h & 0xFFFF) << 48
+    if arg >= 1 << 63:
+        arg -= 1 << 64  # ctrl_cmd_t.arg 为有符号数
+    return build_command(CTRL_CMD_SET_ROI, arg, seq)
+
+
+def _iter_legacy(conn: socket.socket, buf: bytearray) -> Iterator[Tuple[Optional[FrameHeader], bytes]]:
+    """旧固件裸 JPEG 流：按 SOI/EOI 切帧。EOI 从上次扫描到的位置继续找（每个字节只扫描一次），
+    产出的帧为拷贝（缓冲前部随即删除）"""
+    chunk = memoryview(bytearray(LEGACY_CHUNK))
+    scan = 2  # 下一次查找 EOI 的起点
+    while True:
+        while True:
+            start = buf.find(SOI)
+            if start < 0:
+                del buf[:-1]  # 保留最后一个字节，SOI 可能跨两次接收
+                break
+            if start > 0:
+                del buf[:start]
+                scan = 2
+            end = buf.find(EOI, scan)
+            if end < 0:
+                scan = max(2, len(buf) - 1)
+                if len(buf) > LEGACY_MAX:
+                    buf.clear()
+                    scan = 2
+                break
+            end += 2
+            frame = bytes(buf[:end])
+            del buf[:end]
+            scan = 2
+            yield None, frame
+        try:
+            r = conn.recv_into(chunk)
+        except socket.timeout:
+            continue
+        if r == 0:
+            return
+        buf += chunk[:r]
+
+
+def iter_frames(conn: socket.socket,
+                on_audio: Optional[Callable[[FrameHeader, bytes], None]] = None,
+                on_spool: Optional[Callable[[FrameHeader, bytes], None]] = None,
+                on_burst: Optional[Callable[[FrameHeader, bytes], None]] = None,
+                on_detect: Optional[Callable[[FrameHeader, list], None]] = None,
+                on_meta: Optional[Callable[[FrameHeader, dict], None]] = None,
+                on_unchanged: Optional[Callable[[FrameHeader], None]] = None,
+                on_stats: Optional[Callable[[FrameHeader, str], None]] = None,
+                zero_copy: bool = False,
+                tiles: bool = False
+                ) -> Iterator[Tuple[Optional[FrameHeader], Union[bytes, memoryview]]]:
+    """逐帧产出 (帧头, 图像数据)；旧协议下帧头为 None。连接关闭时结束迭代。
+    音频帧不产出，交给 on_audio(帧头, PCM)；回填帧不产出，交给 on_spool(帧头, JPEG)；
+    连拍帧不产出，交给 on_burst(帧头, JPEG)；检测元数据不产出，交给 on_detect(帧头, 框列表)；
+    占位帧不产出，交给 on_unchanged(帧头)；未提供回调时丢弃。
+    统计帧不产出，交给 on_stats(帧头, 文本)，未提供时打印。
+    带寄存器采样的图像帧在产出前先调用 on_meta(帧头, parse_meta() 的结果)。
+    zero_copy=True 时图像数据为接收缓冲的 memoryview，下一次迭代会被覆盖，需要保存时自行 bytes()；
+    旧协议下始终产出 bytes。tiles=True 时保存完整帧的分块，增量帧合成后以 PIXFORMAT_JPEG 产出（bytes）。"""
+    hdr_buf = bytearray(FRAME_HEADER.size)
+    hdr_view = memoryview(hdr_buf)
+    if not recv_into_exact(conn, hdr_view[:4]):
+        return
+    if hdr_buf[:2] == SOI:
+        yield from _iter_legacy(conn, bytearray(hdr_buf[:4]))
+        return
+
+    buf = bytearray(FRAME_BUF_INIT)
+    view = memoryview(buf)
+    have = 4
+    tables = {}  # 表头编号 -> SOS 之前的数据（CTRL_CMD_JPEG_ABBREV）
+    tile_ref = None  # (表头, 各分块)（CTRL_CMD_JPEG_TILES）
+    while True:
+        if not recv_into_exact(conn, hdr_view[have:]):
+            return
+        have = 0
+        hdr = parse_header(hdr_buf)
+        extra = hdr.header_len - FRAME_HEADER.size
+        if extra and not recv_into_exact(conn, view[:extra]):
+            return
+        table_id = view[0] if extra and hdr.pixformat == PIXFORMAT_JPEG else None
+        meta = parse_meta(view[:extra]) if extra and on_meta is not None else None
+        if is_chunked(hdr, view[:extra]):
+            got = recv_chunked(conn, buf)
+            if got is None:
+                return
+            if got[0] is not buf:
+                buf = got[0]
+                view = memoryview(buf)
+            if got[1] < 0:
+                continue
+            hdr = hdr._replace(payload_len=got[1])
+            payload = view[:got[1]]
+        else:
+            prefix = b""
+            if table_id is not None and not hdr.flags & FRAME_FLAG_KEY:
+                prefix = tables.get(table_id)
+                if prefix is None:
+                    raise ProtocolError(f"unknown jpeg table set {table_id}")
+            total = len(prefix) + hdr.payload_len
+            if total > len(buf):
+                # 换一块新缓冲（调用者可能仍持有旧缓冲的 memoryview，不能原地扩容）
+                buf = bytearray(max(total, 2 * len(buf)))
+                view = memoryview(buf)
+            view[:len(prefix)] = prefix  # 省略表头的帧：缓存的表头之后直接接收 SOS 起的数据，不再拷贝
+            payload = view[:total]
+            if not recv_into_exact(conn, payload[len(prefix):]):
+                return
+        if table_id is not None and hdr.flags & FRAME_FLAG_KEY:
+            sos = jpeg_sos(payload)
+            if sos:
+                tables[table_id] = bytes(payload[:sos])
+        if hdr.flags & FRAME_FLAG_STATS:
+            text = bytes(payload).decode("utf-8", errors="replace")
+            if on_stats is not None:
+                on_stats(hdr, text)
+            else:
+                print("[STATS]\n" + text)
+            continue
+        if hdr.flags & FRAME_FLAG_CTRL:
+            cmd, seq, status, _ = CTRL_ACK.unpack_from(payload)
+            if cmd == CTRL_CMD_CLOCK_PING and len(payload) >= CTRL_CLOCK_ACK.size:
+                offset, rtt = clock_sample(*CTRL_CLOCK_ACK.unpack_from(payload)[4:], time.time_ns() // 1000)
+                print(f"[CTRL] clock ping seq={seq} offset={offset} us rtt={rtt} us")
+                continue
+            print(f"[CTRL] cmd=0x{cmd:02x} seq={seq} {CTRL_STATUS_TEXT.get(status, status)}")
+            continue
+        if hdr.flags & FRAME_FLAG_AUDIO:
+            if on_audio is not None:
+                on_audio(hdr, bytes(payload))
+            continue
+        if hdr.flags & FRAME_FLAG_SPOOL:
+            if on_spool is not None:
+                on_spool(hdr, bytes(payload))
+            continue
+        if hdr.flags & FRAME_FLAG_BURST:
+            if on_burst is not None:
+                on_burst(hdr, bytes(payload))
+            continue
+        if hdr.pixformat == PIXFORMAT_DETECT:
+            if on_detect is not None:
+                on_detect(hdr, parse_detect(payload))
+            continue
+        if hdr.pixformat == PIXFORMAT_UNCHANGED:
+            if on_unchanged is not None:
+                on_unchanged(hdr)
+            continue
+        if hdr.pixformat == PIXFORMAT_JPEG_TILES:
+            jpeg = tiles_merge(tile_ref[0], tile_ref[1], payload) if tile_ref else None
+            if jpeg is not None:
+                if meta is not None:
+                    on_meta(hdr, meta)
+                yield hdr._replace(pixformat=PIXFORMAT_JPEG, payload_len=len(jpeg)), jpeg
+            continue
+        if tiles and hdr.pixformat == PIXFORMAT_JPEG and hdr.flags & FRAME_FLAG_KEY:
+            tile_ref = tiles_split(payload)
+        if meta is not None:
+            on_meta(hdr, meta)
+        yield hdr, payload if zero_copy else bytes(payload)
+
+
+def _selftest() -> None:
+    """帧头打包/解析往返检查：python frame_proto.py"""
+    raw = FRAME_HEADER.pack(FRAME_MAGIC, FRAME_VERSION, FRAME_HEADER.size, PIXFORMAT_JPEG, FRAME_FLAG_KEY,
+                            7, 123456, 320, 240, 1000)
+    hdr = parse_header(raw)
+    assert (hdr.seq, hdr.width, hdr.height, hdr.payload_len) == (7, 320, 240, 1000)
+
+    # 静止画面占位帧（lwip_send_unchanged）：只有 28 字节帧头，payload_len=0
+    raw = FRAME_HEADER.pack(FRAME_MAGIC, FRAME_VERSION, FRAME_HEADER.size, PIXFORMAT_UNCHANGED, FRAME_FLAG_MOTION,
+                            8, 223456, 320, 240, 0)
+    hdr = parse_header(raw)
+    assert hdr.pixformat == PIXFORMAT_UNCHANGED and hdr.payload_len == 0 and hdr.seq == 8
+    assert FRAME_HEADER.pack(*hdr) == raw
+
+    # 其他格式的空负载仍是错误
+    raw = FRAME_HEADER.pack(FRAME_MAGIC, FRAME_VERSION, FRAME_HEADER.size, PIXFORMAT_JPEG, 0, 9, 0, 320, 240, 0)
+    try:
+        parse_header(raw)
+    except ProtocolError:
+        pass
+    else:
+        raise AssertionError("empty JPEG frame accepted")
+    print("frame_proto selftest ok")
+
+
+if __name__ == "__main__":
+    _selftest()
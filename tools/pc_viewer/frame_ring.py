@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+进程间共享内存帧环（multiprocessing.shared_memory）
+- 一个写入进程、任意多个读取进程；共 slots 个定长槽位，第 seq 帧写入 seq % slots 号槽位
+- 区头: magic, slots, slot_size, 保留, head(最新帧序号)；槽位头: seq, len；序号从 1 开始，0 表示正在写入
+- 写入：槽位 seq 置 0 → 拷入数据 → 写 seq/len → 更新 head → 唤醒等待者；帧不经 pickle，也不经 Queue
+- 读取：wait_view() 返回槽位的 memoryview（np.frombuffer/cv2.imdecode 直接使用，不拷贝），
+  用完后以 valid(seq) 确认槽位未被覆盖（写入方绕环一圈才会覆盖，读取方落后 slots-1 帧以上时结果作废）
+- wait() 拷贝出 bytes，同一进程内的所有读取者共享同一份拷贝（HTTP 客户端使用）
+- 对象可作为 multiprocessing.Process 的参数传给子进程（按共享内存名重新映射）
+"""
+import struct
+import threading
+from multiprocessing import shared_memory
+from typing import Optional, Tuple
+
+RING_MAGIC = 0x474E5246  # 'FRNG'
+RING_HEADER = struct.Struct('<IIIIQ')  # magic, slots, slot_size, reserved, head
+RING_HEADER_SIZE = 64
+SLOT_HEADER = struct.Struct('<QI4x')  # seq, len
+HEAD_OFFSET = 16
+RING_ALIGN = 64
+
+
+def _stride(slot_size: int) -> int:
+    return (SLOT_HEADER.size + slot_size + RING_ALIGN - 1) // RING_ALIGN * RING_ALIGN
+
+
+class FrameRing:
+    """共享内存中的最新帧环：接口与 FrameChannel 相同（publish/wait），另有零拷贝的 wait_view/valid"""
+
+    def __init__(self, shm: shared_memory.SharedMemory, cond, owner: bool):
+        self._shm = shm
+        self._buf = shm.buf
+        self._cond = cond
+        self._owner = owner
+        magic, self.slots, self.slot_size, _, _ = RING_HEADER.unpack_from(self._buf, 0)
+        if magic != RING_MAGIC:
+            raise ValueError(f"not a frame ring: {shm.name}")
+        self._stride = _stride(self.slot_size)
+        self._seq = self._head()
+        self._cache_lock = threading.Lock()
+        self._cache: Tuple[int, Optional[bytes]] = (0, None)
+        self.dropped = 0  # 超过槽位大小而丢弃的帧数
+
+    @classmethod
+    def create(cls, ctx, slots: int, slot_size: int) -> "FrameRing":
+        """创建共享内存（ctx 为 multiprocessing 上下文，用于创建跨进程的条件变量）"""
+        shm = shared_memory.SharedMemory(create=True, size=RING_HEADER_SIZE + slots * _stride(slot_size))
+        RING_HEADER.pack_into(shm.buf, 0, RING_MAGIC, slots, slot_size, 0, 0)
+        return cls(shm, ctx.Condition(), True)
+
+    @property
+    def name(self) -> str:
+        return self._shm.name
+
+    def __getstate__(self):
+        return {'name': self._shm.name, 'cond': self._cond}
+
+    def __setstate__(self, state):
+        try:
+            shm = shared_memory.SharedMemory(name=state['name'], track=False)  # Python 3.13+：由创建方负责删除
+        except TypeError:
+            shm = shared_memory.SharedMemory(name=state['name'])
+        self.__init__(shm, state['cond'], False)
+
+    def _head(self) -> int:
+        return struct.unpack_from('<Q', self._buf, HEAD_OFFSET)[0]
+
+    def _slot(self, seq: int) -> int:
+        return RING_HEADER_SIZE + (seq % self.slots) * self._stride
+
+    def publish(self, data) -> int:
+        """写入一帧（bytes/bytearray/memoryview），返回帧序号；超过槽位大小时丢弃并返回 0。只允许一个写入进程"""
+        n = len(data)
+        if n > self.slot_size:
+            self.dropped += 1
+            return 0
+        seq = self._seq + 1
+        off = self._slot(seq)
+        SLOT_HEADER.pack_into(self._buf, off, 0, 0)
+        self._buf[off + SLOT_HEADER.size:off + SLOT_HEADER.size + n] = data
+        SLOT_HEADER.pack_into(self._buf, off, seq, n)
+        struct.pack_into('<Q', self._buf, HEAD_OFFSET, seq)
+        self._seq = seq
+        with self._cond:
+            self._cond.notify_all()
+        return seq
+
+    def valid(self, seq: int) -> bool:
+        """第 seq 帧所在槽位是否仍是这一帧"""
+        return SLOT_HEADER.unpack_from(self._buf, self._slot(seq))[0] == seq
+
+    def wait_view(self, version: int, timeout: float) -> Tuple[int, Optional[memoryview]]:
+        """等待序号大于 version 的帧，返回 (最新序号, 槽位数据的 memoryview)；超时返回 (version, None)"""
+        if self._head() <= version:
+            with self._cond:
+                if not self._cond.wait_for(lambda: self._head() > version, timeout):
+                    return version, None
+        while True:
+            seq = self._head()
+            off = self._slot(seq)
+            slot_seq, n = SLOT_HEADER.unpack_from(self._buf, off)
+            if slot_seq == seq:
+                return seq, self._buf[off + SLOT_HEADER.size:off + SLOT_HEADER.size + n]
+            # head 已读出但写入方又开始覆盖该槽位（落后整整一圈），重读 head
+
+    def wait(self, version: int, timeout: float) -> Tuple[int, Optional[bytes]]:
+        """同 wait_view，但返回 bytes；同一帧在本进程内只拷贝一次"""
+        while True:
+            seq, view = self.wait_view(version, timeout)
+            if view is None:
+                return version, None
+            with self._cache_lock:
+                if self._cache[0] < seq:
+                    data = bytes(view)
+                    if not self.valid(seq):
+                        continue
+                    self._cache = (seq, data)
+                return self._cache
+
+    def unlink(self) -> None:
+        if self._owner:
+            self._shm.unlink()
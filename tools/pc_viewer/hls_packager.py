@@ -0,0 +1,510 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+低延迟 HLS（LL-HLS / CMAF）打包：每路摄像头转码一次，观看者数量与设备、接入服务的负载无关
+- 每路摄像头一个转码线程：JPEG 解码一次 → H.264（libx264，zerolatency，无 B 帧）→ fMP4（CMAF）
+  初始化段 init<N>.mp4、部分段 s<序号>.<部分>.m4s（约 --hls-part-ms 一个）与完整段 s<序号>.m4s（部分段首尾相接）
+- 每 --hls-segment 秒强制一个 IDR 帧并切段，段首的部分段标 INDEPENDENT=YES；分辨率变化时重建编码器、
+  生成新的初始化段并插入 EXT-X-DISCONTINUITY
+- 时间戳取设备帧头的 timestamp_us（采集时间，帧间隔不受网络抖动影响），设备重启或校时跳变时接续前一帧；
+  EXT-X-PROGRAM-DATE-TIME 为接收时的墙钟
+- 内存模式：接入服务的 HTTP 端口提供 /hls/<摄像头>/index.m3u8，支持阻塞式刷新（_HLS_msn/_HLS_part）
+  与 EXT-X-PRELOAD-HINT（请求尚未生成的部分段时挂起到生成为止），CDN 直接回源到该端口即可
+- 目录模式（--hls-dir）：同时写入 <目录>/<摄像头>/，播放列表不声明阻塞式刷新与预加载提示，
+  可交给任意静态文件服务器或对象存储作为 CDN 源站（播放器退回轮询，时延约多一个部分段）
+- 编码跟不上时丢弃最旧的待编码帧（/cameras 中的 hls_dropped），接收与其他转发不受影响
+
+依赖：PyAV（pip install av，需带 libx264）
+"""
+import asyncio
+import fractions
+import os
+import queue
+import struct
+import threading
+import time
+from typing import Callable, Dict, List, Optional, Tuple
+
+try:
+    import av
+    try:
+        PICT_I = av.video.frame.PictureType.I
+    except AttributeError:
+        PICT_I = "I"  # 旧版 PyAV 以字符串设置帧类型
+except ImportError:
+    av = None
+
+TIMESCALE = 90000  # 视频轨道的时间刻度
+QUEUE_MAX = 2  # 每路待编码帧数上限，超过则丢弃最旧的帧
+TS_JUMP_US = 10_000_000  # 帧时间戳倒退或跳变超过该值视为设备重启/校时，接续前一帧
+TS_GAP_DEFAULT = TIMESCALE // 15  # 接续时假定的帧间隔
+PART_WINDOW = 3  # 最近几段（含正在生成的一段）列出部分段
+SAMPLE_KEY = 0x02000000  # sample_depends_on=2
+SAMPLE_NON_KEY = 0x01010000  # sample_depends_on=1，sample_is_non_sync_sample=1
+MATRIX = struct.pack('>9I', 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000)
+PLAYLIST = "index.m3u8"
+CONTENT_TYPES = {".m3u8": "application/vnd.apple.mpegurl", ".mp4": "video/mp4", ".m4s": "video/iso.segment"}
+
+
+# ---------------- fMP4（CMAF）封装 ----------------
+
+def box(kind: bytes, *payload: bytes) -> bytes:
+    body = b"".join(payload)
+    return struct.pack('>I', 8 + len(body)) + kind + body
+
+
+def full_box(kind: bytes, version: int, flags: int, *payload: bytes) -> bytes:
+    return box(kind, struct.pack('>I', (version << 24) | flags), *payload)
+
+
+def split_nals(annexb: bytes) -> List[bytes]:
+    """Annex-B 码流拆成 NAL（不含起始码）"""
+    nals = []
+    start = annexb.find(b"\x00\x00\x01")
+    while start >= 0:
+        start += 3
+        end = annexb.find(b"\x00\x00\x01", start)
+        nal = annexb[start:end if end >= 0 else len(annexb)]
+        if end >= 0 and nal.endswith(b"\x00"):
+            nal = nal[:-1]  # 下一个四字节起始码的前导 0
+        if nal:
+            nals.append(nal)
+        start = end
+    return nals
+
+
+def init_segment(sps: bytes, pps: bytes, width: int, height: int) -> bytes:
+    """初始化段：ftyp + moov（一条 H.264 视频轨道，样本全部在分片中）"""
+    ftyp = box(b"ftyp", b"iso6", struct.pack('>I', 0), b"iso6cmfcisomavc1")
+    mvhd = full_box(b"mvhd", 0, 0, struct.pack('>IIIIIH', 0, 0, 1000, 0, 0x00010000, 0x0100), bytes(10), MATRIX,
+                    bytes(24), struct.pack('>I', 2))
+    tkhd = full_box(b"tkhd", 0, 3, struct.pack('>IIIII', 0, 0, 1, 0, 0), bytes(8), struct.pack('>hhHH', 0, 0, 0, 0),
+                    MATRIX, struct.pack('>II', width << 16, height << 16))
+    mdhd = full_box(b"mdhd", 0, 0, struct.pack('>IIIIHH', 0, 0, TIMESCALE, 0, 0x55C4, 0))  # 语言 und
+    hdlr = full_box(b"hdlr", 0, 0, struct.pack('>I', 0), b"vide", bytes(12), b"VideoHandler\x00")
+    avcc = box(b"avcC", bytes([1, sps[1], sps[2], sps[3], 0xFF, 0xE1]), struct.pack('>H', len(sps)), sps,
+               b"\x01", struct.pack('>H', len(pps)), pps)
+    avc1 = box(b"avc1", bytes(6), struct.pack('>H', 1), bytes(16),
+               struct.pack('>HHIIIH', width, height, 0x00480000, 0x00480000, 0, 1), bytes(32),
+               struct.pack('>Hh', 0x18, -1), avcc)
+    stbl = box(b"stbl", full_box(b"stsd", 0, 0, struct.pack('>I', 1), avc1), full_box(b"stts", 0, 0, bytes(4)),
+               full_box(b"stsc", 0, 0, bytes(4)), full_box(b"stsz", 0, 0, bytes(8)), full_box(b"stco", 0, 0, bytes(4)))
+    dinf = box(b"dinf", full_box(b"dref", 0, 0, struct.pack('>I', 1), full_box(b"url ", 0, 1)))
+    minf = box(b"minf", full_box(b"vmhd", 0, 1, bytes(8)), dinf, stbl)
+    trak = box(b"trak", tkhd, box(b"mdia", mdhd, hdlr, minf))
+    mvex = box(b"mvex", full_box(b"trex", 0, 0, struct.pack('>IIIII', 1, 1, 0, 0, 0)))
+    return ftyp + box(b"moov", mvhd, trak, mvex)
+
+
+def fragment(seq: int, base_dts: int, samples: List[Tuple[bytes, int, bool]]) -> bytes:
+    """一个 CMAF 分片（moof + mdat），samples 为 (长度前缀格式的访问单元, 时长, 是否关键帧)"""
+    entries = b"".join(struct.pack('>III', dur, len(data), SAMPLE_KEY if key else SAMPLE_NON_KEY)
+                       for data, dur, key in samples)
+
+    def moof(data_offset: int) -> bytes:
+        tfhd = full_box(b"tfhd", 0, 0x020000, struct.pack('>I', 1))  # default-base-is-moof
+        tfdt = full_box(b"tfdt", 1, 0, struct.pack('>Q', base_dts))
+        trun = full_box(b"trun", 0, 0x000701, struct.pack('>Ii', len(samples), data_offset), entries)
+        return box(b"moof", full_box(b"mfhd", 0, 0, struct.pack('>I', seq)), box(b"traf", tfhd, tfdt, trun))
+
+    head = moof(len(moof(0)) + 8)
+    return head + box(b"mdat", *(data for data, _, _ in samples))
+
+
+# ---------------- 播放列表 ----------------
+
+class Segment:
+    """一段：若干部分段，完整段为其拼接"""
+
+    def __init__(self, msn: int, init: int, discontinuity: bool, wall: float):
+        self.msn = msn
+        self.init = init
+        self.discontinuity = discontinuity
+        self.wall = wall  # 第一帧的接收墙钟，EXT-X-PROGRAM-DATE-TIME
+        self.parts: List[bytes] = []
+        self.durations: List[float] = []
+        self.independent: List[bool] = []
+        self.complete = False
+
+    @property
+    def duration(self) -> float:
+        return sum(self.durations)
+
+
+class CameraPackager:
+    """一路摄像头：write() 在事件循环中调用，只入队；转码与封装在本路的线程中运行"""
+
+    def __init__(self, owner: "HlsPackager", cam_id: str):
+        self.owner = owner
+        self.id = cam_id
+        self.dir = os.path.join(owner.root, cam_id.replace(":", "_")) if owner.root else None
+        self.dropped = 0
+        self.encoded = 0
+        self.lock = threading.Lock()  # 保护以下播放列表状态（转码线程写，HTTP 读）
+        self.segments: List[Segment] = []
+        self.inits: Dict[int, bytes] = {}
+        self.discontinuity_seq = 0
+        self.target = owner.segment_s  # EXT-X-TARGETDURATION，只增不减
+        self._queue: "queue.Queue" = queue.Queue(maxsize=QUEUE_MAX)
+        try:
+            self._loop: Optional[asyncio.AbstractEventLoop] = asyncio.get_running_loop()
+        except RuntimeError:
+            self._loop = None
+        self._event: Optional[asyncio.Event] = None
+        # 以下只在转码线程中访问
+        self._decoder = None
+        self._encoder = None
+        self._size: Optional[Tuple[int, int]] = None
+        self._init_id = -1
+        self._sps = self._pps = None
+        self._last_ts: Optional[int] = None
+        self._pts = 0
+        self._seg_start: Optional[int] = None
+        self._pending: Optional[Tuple[int, bytes, bool, float]] = None  # 等下一帧确定时长的样本
+        self._part: List[Tuple[bytes, int, bool]] = []
+        self._part_dts = 0
+        self._part_ticks = 0
+        self._frag_seq = 0
+        self._new_init = False
+        self._thread = threading.Thread(target=self._run, name=f"hls-{cam_id}", daemon=True)
+        self._thread.start()
+
+    def write(self, timestamp_us: int, jpeg: bytes) -> None:
+        item = (timestamp_us, time.time(), jpeg)
+        try:
+            self._queue.put_nowait(item)
+        except queue.Full:
+            try:
+                self._queue.get_nowait()  # 丢弃最旧的帧，保持最低时延
+                self.dropped += 1
+            except queue.Empty:
+                pass
+            self._queue.put_nowait(item)
+
+    # ---------------- 转码线程 ----------------
+
+    def _run(self) -> None:
+        self._decoder = av.CodecContext.create("mjpeg", "r")
+        while True:
+            item = self._queue.get()
+            if item is None:
+                break
+            try:
+                self._encode(*item)
+            except (av.error.FFmpegError, ValueError) as e:
+                print(f"[WARN] HLS 转码失败 {self.id}: {e}")
+                self._encoder = None  # 下一帧重建编码器与初始化段
+                self._size = None
+
+    def _open_encoder(self, width: int, height: int) -> None:
+        enc = av.CodecContext.create("libx264", "w")
+        enc.width = width
+        enc.height = height
+        enc.pix_fmt = "yuv420p"
+        enc.time_base = fractions.Fraction(1, TIMESCALE)
+        enc.framerate = fractions.Fraction(15, 1)  # 只用于码率控制的初值，实际按时间戳
+        enc.bit_rate = self.owner.bitrate
+        enc.gop_size = 100000  # 只在切段处强制 IDR
+        enc.options = {"preset": "veryfast", "tune": "zerolatency", "profile": "baseline", "forced-idr": "1",
+                       "x264-params": "scenecut=0"}
+        self._flush_pending()
+        self._encoder = enc
+        self._size = (width, height)
+        self._seg_start = None  # 新编码器的第一帧为 IDR，从它开始新的一段
+
+    def _timestamp(self, timestamp_us: int) -> int:
+        if self._last_ts is not None and 0 < timestamp_us - self._last_ts < TS_JUMP_US:
+            self._pts += (timestamp_us - self._last_ts) * TIMESCALE // 1000000
+        elif self._last_ts is not None:
+            self._pts += TS_GAP_DEFAULT
+        self._last_ts = timestamp_us
+        return self._pts
+
+    def _encode(self, timestamp_us: int, wall: float, jpeg: bytes) -> None:
+        frames = self._decoder.decode(av.Packet(jpeg))
+        if not frames:
+            return
+        frame = frames[-1]
+        if self._encoder is None or self._size != (frame.width, frame.height):
+            self._open_encoder(frame.width, frame.height)
+        pts = self._timestamp(timestamp_us)
+        frame = frame.reformat(format="yuv420p")
+        frame.pts = pts
+        frame.time_base = fractions.Fraction(1, TIMESCALE)
+        if self._seg_start is None or pts - self._seg_start >= self.owner.segment_s * TIMESCALE:
+            frame.pict_type = PICT_I
+            self._seg_start = pts
+        for packet in self._encoder.encode(frame):
+            self._packet(packet.pts, bytes(packet), packet.is_keyframe, wall)
+
+    def _packet(self, pts: int, annexb: bytes, key: bool, wall: float) -> None:
+        nals = split_nals(annexb)
+        for nal in nals:
+            if nal[0] & 0x1F == 7:
+                self._new_init = self._new_init or nal != self._sps
+                self._sps = nal
+            elif nal[0] & 0x1F == 8:
+                self._new_init = self._new_init or nal != self._pps
+                self._pps = nal
+        data = b"".join(struct.pack('>I', len(nal)) + nal for nal in nals if nal[0] & 0x1F not in (7, 8, 9))
+        if self._sps is None or self._pps is None or not data:
+            return
+        if self._pending is not None:
+            self._sample(self._pending, max(1, pts - self._pending[0]))
+        self._pending = (pts, data, key, wall)
+
+    def _flush_pending(self) -> None:
+        """编码器重建前：最后一帧按上一帧的间隔收尾，结束当前段"""
+        if self._pending is not None:
+            self._sample(self._pending, TS_GAP_DEFAULT)
+            self._pending = None
+        self._close_part()
+        with self.lock:
+            done = self._complete()
+        self._write_segment(done)
+
+    def _sample(self, sample: Tuple[int, bytes, bool, float], dur: int) -> None:
+        pts, data, key, wall = sample
+        if key:
+            self._close_part()
+            self._new_segment(wall)
+        elif self._part_ticks and self._part_ticks + dur > self.owner.part_s * TIMESCALE:
+            self._close_part()
+        if not self.segments:
+            return  # 还没有关键帧
+        if not self._part:
+            self._part_dts = pts
+        self._part.append((data, dur, key))
+        self._part_ticks += dur
+        if self._part_ticks >= self.owner.part_s * TIMESCALE * 0.85:
+            self._close_part()
+        self.encoded += 1
+
+    def _new_segment(self, wall: float) -> None:
+        discontinuity = False
+        if self._new_init:
+            self._init_id += 1
+            init = init_segment(self._sps, self._pps, *self._size)
+            with self.lock:
+                self.inits[self._init_id] = init
+            self._write_file(f"init{self._init_id}.mp4", init)
+            discontinuity = self._init_id > 0
+            self._new_init = False
+        with self.lock:
+            done = self._complete()
+            msn = self.segments[-1].msn + 1 if self.segments else 0
+            self.segments.append(Segment(msn, self._init_id, discontinuity, wall))
+            self._evict()
+        self._write_segment(done)
+        self._publish()
+
+    def _close_part(self) -> None:
+        if not self._part:
+            return
+        self._frag_seq += 1
+        data = fragment(self._frag_seq, self._part_dts, self._part)
+        independent = self._part[0][2]
+        duration = self._part_ticks / TIMESCALE
+        self._part = []
+        self._part_ticks = 0
+        with self.lock:
+            seg = self.segments[-1]
+            seg.parts.append(data)
+            seg.durations.append(duration)
+            seg.independent.append(independent)
+        self._write_file(f"s{seg.msn}.{len(seg.parts) - 1}.m4s", data)
+        self._publish()
+
+    def _complete(self) -> Optional[Segment]:
+        """结束正在生成的一段（调用者持有 lock），返回该段"""
+        seg = self.segments[-1] if self.segments else None
+        if seg is None or seg.complete or not seg.parts:
+            return None
+        seg.complete = True
+        self.target = max(self.target, round(seg.duration))
+        return seg
+
+    def _write_segment(self, seg: Optional[Segment]) -> None:
+        if seg is not None and self.dir is not None:
+            self._write_file(f"s{seg.msn}.m4s", b"".join(seg.parts))
+
+    def _evict(self) -> None:
+        """滑动窗口：保留最近 window 个完整段（调用者持有 lock）"""
+        while sum(s.complete for s in self.segments) > self.owner.window:
+            old = self.segments.pop(0)
+            if old.discontinuity:
+                self.discontinuity_seq += 1
+            if self.segments[0].init != old.init:
+                self.inits.pop(old.init, None)
+            if self.dir is not None:
+                for name in [f"s{old.msn}.m4s"] + [f"s{old.msn}.{i}.m4s" for i in range(len(old.parts))]:
+                    try:
+                        os.remove(os.path.join(self.dir, name))
+                    except OSError:
+                        pass
+
+    def _write_file(self, name: str, data: bytes) -> None:
+        """目录模式：先写临时文件再改名，源站不会读到写了一半的文件"""
+        if self.dir is None:
+            return
+        try:
+            os.makedirs(self.dir, exist_ok=True)
+            tmp = os.path.join(self.dir, "." + name)
+            with open(tmp, "wb") as f:
+                f.write(data)
+            os.replace(tmp, os.path.join(self.dir, name))
+        except OSError as e:
+            print(f"[WARN] HLS 写入失败 {self.dir}: {e}")
+
+    def _publish(self) -> None:
+        """播放列表变化：更新目录中的播放列表，唤醒阻塞的 HTTP 请求"""
+        if self.dir is not None:
+            text = self.playlist(blocking=False)
+            if text is not None:
+                self._write_file(PLAYLIST, text.encode())
+        if self._loop is not None:
+            try:
+                self._loop.call_soon_threadsafe(self._wake)
+            except RuntimeError:
+                pass  # 事件循环已关闭
+
+    # ---------------- 读取（事件循环） ----------------
+
+    def _wake(self) -> None:
+        if self._event is not None:
+            self._event.set()
+            self._event = None
+
+    async def _wait(self, ready: Callable[[], bool], timeout: float) -> bool:
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + timeout
+        while not ready():
+            if self._event is None:
+                self._event = asyncio.Event()
+            remaining = deadline - loop.time()
+            if remaining <= 0:
+                return False
+            try:
+                await asyncio.wait_for(self._event.wait(), remaining)
+            except asyncio.TimeoutError:
+                return ready()
+        return True
+
+    def _reached(self, msn: int, part: Optional[int]) -> bool:
+        with self.lock:
+            if not self.segments:
+                return False
+            last = self.segments[-1]
+            if msn < last.msn:
+                return True
+            if msn > last.msn:
+                return False
+            return last.complete if part is None else len(last.parts) > part
+
+    def playlist(self, blocking: bool = True) -> Optional[str]:
+        with self.lock:
+            segs = [s for s in self.segments if s.parts]
+            if not segs:
+                return None
+            part_s = self.owner.part_s
+            lines = ["#EXTM3U", "#EXT-X-VERSION:9", f"#EXT-X-TARGETDURATION:{self.target}",
+                     f"#EXT-X-SERVER-CONTROL:{'CAN-BLOCK-RELOAD=YES,' if blocking else ''}PART-HOLD-BACK={3 * part_s:.3f}",
+                     f"#EXT-X-PART-INF:PART-TARGET={part_s:.3f}", f"#EXT-X-MEDIA-SEQUENCE:{segs[0].msn}",
+                     f"#EXT-X-DISCONTINUITY-SEQUENCE:{self.discontinuity_seq}"]
+            first_part_msn = self.segments[-1].msn - PART_WINDOW + 1
+            prev_init = None
+            for seg in segs:
+                if seg.discontinuity:
+                    lines.append("#EXT-X-DISCONTINUITY")
+                if seg.init != prev_init:
+                    lines.append(f'#EXT-X-MAP:URI="init{seg.init}.mp4"')
+                    prev_init = seg.init
+                lines.append("#EXT-X-PROGRAM-DATE-TIME:" + time.strftime("%Y-%m-%dT%H:%M:%S", time.gmtime(seg.wall)) +
+                             f".{int(seg.wall * 1000) % 1000:03d}Z")
+                if seg.msn >= first_part_msn:
+                    for i, (dur, ind) in enumerate(zip(seg.durations, seg.independent)):
+                        lines.append(f'#EXT-X-PART:DURATION={dur:.5f},URI="s{seg.msn}.{i}.m4s"' +
+                                     (",INDEPENDENT=YES" if ind else ""))
+                if seg.complete:
+                    lines.append(f"#EXTINF:{seg.duration:.5f},")
+                    lines.append(f"s{seg.msn}.m4s")
+            if blocking:
+                last = self.segments[-1]
+                hint = f"s{last.msn + 1}.0.m4s" if last.complete else f"s{last.msn}.{len(last.parts)}.m4s"
+                lines.append(f'#EXT-X-PRELOAD-HINT:TYPE=PART,URI="{hint}"')
+        return "\n".join(lines) + "\n"
+
+    def _get(self, name: str) -> Optional[bytes]:
+        with self.lock:
+            if name.startswith("init") and name.endswith(".mp4"):
+                return self.inits.get(int(name[4:-4]))
+            fields = name[1:-4].split(".") if name.startswith("s") and name.endswith(".m4s") else []
+            seg = next((s for s in self.segments if fields and s.msn == int(fields[0])), None)
+            if seg is None:
+                return None
+            if len(fields) == 1:
+                return b"".join(seg.parts) if seg.complete else None
+            part = int(fields[1])
+            return seg.parts[part] if part < len(seg.parts) else None
+
+    async def fetch(self, name: str, query: Dict[str, List[str]]) -> Tuple[str, str, bytes, str]:
+        """HTTP 请求：返回 (状态, Content-Type, 内容, Cache-Control)"""
+        hold = 3 * self.target  # 阻塞请求最长挂起时间
+        if name == PLAYLIST:
+            cache = "no-cache"
+            if "_HLS_msn" in query:
+                msn = int(query["_HLS_msn"][0])
+                part = int(query["_HLS_part"][0]) if "_HLS_part" in query else None
+                with self.lock:
+                    last = self.segments[-1].msn if self.segments else -1
+                if msn > last + 2:
+                    return "400 Bad Request", "text/plain", b"_HLS_msn too far ahead\n", "no-store"
+                if not await self._wait(lambda: self._reached(msn, part), hold):
+                    return "503 Service Unavailable", "text/plain", b"stream stalled\n", "no-store"
+                cache = f"public, max-age={6 * self.target}"  # 同一查询的结果不再变化，CDN 可缓存
+            text = self.playlist()
+            if text is None:
+                return "404 Not Found", "text/plain", b"no segments yet\n", "no-store"
+            return "200 OK", CONTENT_TYPES[".m3u8"], text.encode(), cache
+        ext = os.path.splitext(name)[1]
+        if ext not in CONTENT_TYPES:
+            return "404 Not Found", "text/plain", b"not found\n", "no-store"
+        try:
+            data = self._get(name)
+            if data is None and ext == ".m4s":
+                await self._wait(lambda: self._get(name) is not None, hold)  # 预加载提示的部分段：生成后立即返回
+                data = self._get(name)
+        except ValueError:
+            data = None
+        if data is None:
+            return "404 Not Found", "text/plain", b"not found\n", "no-store"
+        return "200 OK", CONTENT_TYPES[ext], data, f"public, max-age={self.owner.window * self.target}"
+
+    def close(self) -> None:
+        self._queue.put(None)
+        self._thread.join()
+
+
+class HlsPackager:
+    """所有摄像头的打包参数；root 为 None 时只在内存中保留"""
+
+    def __init__(self, root: Optional[str], part_ms: int, segment_s: int, bitrate_kbps: int, window: int):
+        self.root = root
+        self.part_s = max(0.05, part_ms / 1000)
+        self.segment_s = max(1, segment_s)
+        self.bitrate = bitrate_kbps * 1000
+        self.window = max(2, window)
+        self.cameras: List[CameraPackager] = []
+
+    def camera(self, cam_id: str) -> CameraPackager:
+        pkg = CameraPackager(self, cam_id)
+        self.cameras.append(pkg)
+        return pkg
+
+    def close(self) -> None:
+        for pkg in self.cameras:
+            pkg.close()
+
+
+def available() -> bool:
+    return av is not None
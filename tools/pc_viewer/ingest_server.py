@@ -0,0 +1,611 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+多摄像头接入服务（asyncio）
+- 单进程同时接收任意多路 ESP32 连接（帧头协议见 frame_proto.py，兼容旧固件的裸 JPEG 流）
+- 每路摄像头只保留最新一帧（覆盖写入，不排队），慢的网页客户端不会拖慢接收，也不会积压内存
+- 接收端不解码 JPEG，只转发，单核可承载 50 路以上；摄像头以对端 IP 区分，设备重连后沿用同一槽位
+- 内置 HTTP 服务（无额外依赖）：
+    /                          各路最新画面的网格（每秒刷新）
+    /cameras                   各路统计 JSON（帧率、码率、序号缺口、音频/回填/统计帧数、断线次数等）
+    /cameras/<id>/latest.jpg   最新一帧
+    /cameras/<id>/stream       MJPEG 流（客户端跟不上时跳帧）
+    /cameras/<id>/stats        向设备请求分段时延统计，设备回复的文本在 /cameras 的 device_stats 中
+    /hls/<id>/index.m3u8       低延迟 HLS 播放列表（--hls，支持 _HLS_msn/_HLS_part 阻塞式刷新），同目录下为初始化段与分段
+    /capture?in_ms=500         同步抓拍：所有已校时的摄像头上传采集时间最接近 当前+in_ms 的一帧
+    /cameras/<id>/capture.jpg  最近一次同步抓拍中该路的帧（/cameras 中 capture_error_us 为与目标时刻之差）
+    /mosaic.jpg、/mosaic/stream 各路拼成一幅的电视墙画面及其 MJPEG 流（--mosaic 列数）
+- 校时：每路连接每 CLOCK_PERIOD_S 秒发送 CLOCK_PINGS 次 CTRL_CMD_CLOCK_PING，取往返最短的一次估计偏移并下发，
+  之后设备帧头的 timestamp_us 为本机 Unix 时间（us），各路之间可直接对齐
+- --record <目录>：各路设备 JPEG 原样写入按时间分段的 MJPEG 文件，附时间→偏移索引（见 recorder.py）
+- --hls：每路摄像头转码一次为低延迟 HLS（LL-HLS/CMAF 部分段，见 hls_packager.py），/hls/<id>/index.m3u8 供播放器或 CDN 回源，
+  观看者数量不增加设备与本服务的负载；--hls-dir 另写入目录供静态源站使用
+- --mosaic <列数>：各路设备开启 CTRL_CMD_JPEG_TILES（完整帧带 DRI，增量帧在此合成完整帧），表头相同的各路
+  在压缩域按 MCU 行拼接为一幅 JPEG，不解码（见 mosaic.py）；表头不同时退回缩放转码；拼接结果按 --mosaic-fps 缓存，
+  观看者数量不增加拼接次数
+- --tls-cert/--tls-key：设备端口使用 TLS（固件 TLS_STREAM_EN），HTTP 端口不变
+- 服务发现：安装 zeroconf 后以 mDNS 发布 _camingest._tcp（TXT prio=--prio），固件 server_disc.c 自动发现并连接；
+  多台同 prio 的服务器按设备 MAC 分摊，备用服务器用更大的 --prio，主服务器不可用时设备立即改连
+
+用法示例：
+    python ./tools/pc_viewer/ingest_server.py --host 0.0.0.0 --port 8000 --http-port 8080
+    curl http://localhost:8080/cameras
+"""
+import argparse
+import asyncio
+import json
+import socket
+import sys
+import time
+from typing import Dict, List, Optional, Tuple
+from urllib.parse import parse_qs
+
+from frame_proto import (CHUNK_LEN, CTRL_ACK, CTRL_CLOCK_ACK, CTRL_CMD_CAPTURE_AT, CTRL_CMD_CLOCK_PING,
+                         CTRL_CMD_CLOCK_SET, CTRL_CMD_JPEG_TILES, CTRL_CMD_STATIC_SKIP, EOI, FRAME_CHUNK_ABORT, FRAME_FLAG_AUDIO,
+                         FRAME_FLAG_BURST, FRAME_FLAG_CTRL, FRAME_FLAG_KEY, FRAME_FLAG_SPOOL, FRAME_FLAG_STATS, FRAME_HEADER,
+                         FRAME_MAX_PAYLOAD, LEGACY_CHUNK, LEGACY_MAX, PIXFORMAT_JPEG, PIXFORMAT_JPEG_TILES, PIXFORMAT_UNCHANGED, SOI,
+                         FrameHeader, ProtocolError, build_command, clock_sample, is_chunked, parse_header, parse_meta, tiles_merge,
+                         tiles_split, tls_server_context)
+from hls_packager import CameraPackager, HlsPackager, available as hls_available
+from mosaic import Mosaic
+from recorder import CameraRecorder, Recorder
+
+RATE_WINDOW_S = 1.0  # 帧率/码率的测量窗口
+CLOCK_PINGS = 8  # 每轮校时的往返次数
+CLOCK_PING_GAP_S = 0.05  # 往返之间的间隔
+CLOCK_PERIOD_S = 30.0  # 校时周期（设备晶振漂移约 10~20 ppm，30 秒内 < 1ms）
+CAPTURE_WINDOW_US = 500_000  # 同步抓拍时只接受与目标时刻相差不超过该值的帧
+
+
+def now_us() -> int:
+    return time.time_ns() // 1000
+
+INDEX_HTML = b'''<!DOCTYPE html>
+<html><head><meta charset="utf-8"><title>ESP32 Cameras</title>
+<style>body{background:#111;color:#ddd;font-family:sans-serif}
+.grid{display:grid;grid-template-columns:repeat(auto-fill,minmax(320px,1fr));gap:8px}
+figure{margin:0}img{width:100%;background:#000}figcaption{font-size:12px}</style></head>
+<body><div class="grid" id="grid"></div><script>
+async function tick(){
+  const r=await fetch('/cameras'); const cams=await r.json(); const g=document.getElementById('grid');
+  for(const c of cams.cameras){
+    let f=document.getElementById('cam-'+c.id);
+    if(!f){f=document.createElement('figure');f.id='cam-'+c.id;
+      f.innerHTML='<a href="/cameras/'+c.id+'/stream"><img></a><figcaption></figcaption>';g.appendChild(f);}
+    f.querySelector('img').src='/cameras/'+c.id+'/latest.jpg?'+c.frames;
+    f.querySelector('figcaption').textContent=
+      c.id+(c.connected?'':' (offline)')+' '+c.fps.toFixed(1)+' fps '+(c.kbps/1000).toFixed(2)+' Mbps lost '+c.seq_lost;
+  }
+}
+setInterval(tick,1000);tick();
+</script></body></html>'''
+
+
+class CameraSlot:
+    """一路摄像头：最新帧与统计"""
+
+    def __init__(self, cam_id: str):
+        self.id = cam_id
+        self.jpeg: Optional[bytes] = None
+        self.hdr: Optional[FrameHeader] = None
+        self.cond = asyncio.Condition()
+        self.writer: Optional[asyncio.StreamWriter] = None
+        self.connected = False
+        self.connects = 0
+        self.connected_since = 0.0
+        self.last_frame_time = 0.0
+        self.frames = 0
+        self.bytes = 0
+        self.seq_lost = 0  # 帧序号缺口之和（设备端丢帧或跳帧）
+        self.last_seq: Optional[int] = None
+        self.audio_frames = 0
+        self.audio_subs: List[asyncio.Queue] = []  # 音频订阅者（webrtc_gateway.py 的音频轨道），队列满时丢弃最旧的一包
+        self.spool_frames = 0
+        self.burst_frames = 0
+        self.unchanged_frames = 0  # 画面未变化的占位帧（CTRL_CMD_STATIC_SKIP）
+        self.device_stats = ""  # 设备最近一次回复的统计文本
+        self.clock_samples: List[Tuple[int, int]] = []  # 本轮校时的 (偏移, 往返时间)
+        self.clock_offset_us: Optional[int] = None  # 最近一次下发的偏移
+        self.clock_rtt_us: Optional[int] = None  # 该次估计的往返时间（误差不超过其一半）
+        self.capture_target_us: Optional[int] = None  # 最近一次同步抓拍的目标时刻
+        self.capture_jpeg: Optional[bytes] = None  # 其中最接近目标时刻的帧
+        self.capture_error_us: Optional[int] = None
+        self.sensor_meta: Optional[dict] = None  # 最近一帧的寄存器采样（曝光/增益/白平衡）
+        self.tile_ref: Optional[tuple] = None  # 最近一帧完整帧的 (表头, 各分块)，增量帧据此合成（CTRL_CMD_JPEG_TILES）
+        self.recorder: Optional[CameraRecorder] = None
+        self.hls: Optional[CameraPackager] = None
+        self.fps = 0.0
+        self.kbps = 0.0
+        self._win_start = 0.0
+        self._win_frames = 0
+        self._win_bytes = 0
+
+    async def publish(self, hdr: Optional[FrameHeader], jpeg: bytes) -> None:
+        """覆盖最新帧并唤醒等待的 MJPEG 客户端"""
+        now = time.monotonic()
+        if hdr is not None:
+            if self.last_seq is not None and hdr.seq > self.last_seq + 1:
+                self.seq_lost += hdr.seq - self.last_seq - 1
+            self.last_seq = hdr.seq
+        self.jpeg = jpeg
+        self.hdr = hdr
+        if hdr is not None and self.capture_target_us is not None:
+            error = hdr.timestamp_us - self.capture_target_us
+            if abs(error) <= CAPTURE_WINDOW_US and (self.capture_error_us is None or
+                                                    abs(error) < abs(self.capture_error_us)):
+                self.capture_jpeg = jpeg
+                self.capture_error_us = error
+        if self.recorder is not None:
+            self.recorder.write(hdr.seq if hdr is not None else 0, jpeg)
+        if self.hls is not None:
+            self.hls.write(hdr.timestamp_us if hdr is not None else now_us(), jpeg)
+        self.frames += 1
+        self.bytes += len(jpeg)
+        self.last_frame_time = time.time()
+        self._win_frames += 1
+        self._win_bytes += len(jpeg)
+        elapsed = now - self._win_start
+        if elapsed >= RATE_WINDOW_S:
+            if self._win_start:
+                self.fps = self._win_frames / elapsed
+                self.kbps = self._win_bytes * 8 / 1000 / elapsed
+            self._win_start = now
+            self._win_frames = 0
+            self._win_bytes = 0
+        async with self.cond:
+            self.cond.notify_all()
+
+    def publish_audio(self, hdr: FrameHeader, pcm: bytes) -> None:
+        """分发一包 PCM 给各订阅者，订阅者跟不上时丢弃最旧的包，不阻塞接收"""
+        self.audio_frames += 1
+        for queue in self.audio_subs:
+            if queue.full():
+                queue.get_nowait()
+            queue.put_nowait((hdr, pcm))
+
+    def to_dict(self) -> dict:
+        stale = time.time() - self.last_frame_time > 2 * RATE_WINDOW_S
+        return {
+            "id": self.id,
+            "connected": self.connected,
+            "connects": self.connects,
+            "connected_since": self.connected_since,
+            "last_frame_time": self.last_frame_time,
+            "frames": self.frames,
+            "bytes": self.bytes,
+            "fps": 0.0 if stale else self.fps,
+            "kbps": 0.0 if stale else self.kbps,
+            "seq": self.last_seq,
+            "seq_lost": self.seq_lost,
+            "width": self.hdr.width if self.hdr else None,
+            "height": self.hdr.height if self.hdr else None,
+            "audio_frames": self.audio_frames,
+            "spool_frames": self.spool_frames,
+            "burst_frames": self.burst_frames,
+            "unchanged_frames": self.unchanged_frames,
+            "device_stats": self.device_stats,
+            "clock_offset_us": self.clock_offset_us,
+            "clock_rtt_us": self.clock_rtt_us,
+            "capture_target_us": self.capture_target_us,
+            "capture_error_us": self.capture_error_us,
+            "sensor_meta": self.sensor_meta,
+            "rec_frames": self.recorder.frames if self.recorder else 0,
+            "rec_bytes": self.recorder.bytes if self.recorder else 0,
+            "rec_dropped": self.recorder.dropped if self.recorder else 0,
+            "rec_segment": self.recorder.segment if self.recorder else None,
+            "hls_frames": self.hls.encoded if self.hls else 0,
+            "hls_dropped": self.hls.dropped if self.hls else 0,
+        }
+
+
+class IngestServer:
+    def __init__(self, idle_timeout: float, recorder: Optional[Recorder] = None, static_skip_ms: int = 0,
+                 hls: Optional[HlsPackager] = None, mosaic: Optional[Mosaic] = None, mosaic_fps: float = 5.0):
+        self.idle_timeout = idle_timeout
+        self.recorder = recorder
+        self.hls = hls
+        self.static_skip_ms = static_skip_ms
+        self.cameras: Dict[str, CameraSlot] = {}
+        self.mosaic = mosaic
+        self.mosaic_period = 1.0 / max(mosaic_fps, 0.1)
+        self._mosaic_lock = asyncio.Lock()  # Mosaic 不可重入，同一时刻只拼接一次
+        self._mosaic_jpeg: Optional[bytes] = None
+        self._mosaic_time = 0.0
+
+    # ---------------- 设备连接 ----------------
+
+    def slot(self, cam_id: str) -> CameraSlot:
+        """取摄像头槽位，首次出现时创建（及其录像）"""
+        slot = self.cameras.get(cam_id)
+        if slot is None:
+            slot = self.cameras[cam_id] = CameraSlot(cam_id)
+            if self.recorder is not None:
+                slot.recorder = self.recorder.camera(cam_id)
+            if self.hls is not None:
+                slot.hls = self.hls.camera(cam_id)
+        return slot
+
+    async def _read(self, reader: asyncio.StreamReader, n: int) -> bytes:
+        return await asyncio.wait_for(reader.readexactly(n), self.idle_timeout)
+
+    async def _recv_chunked(self, reader: asyncio.StreamReader) -> Optional[bytes]:
+        """边采集边发送的帧（FRAME_EXT_CHUNKED）：拼接各分段，设备作废本帧时返回 None"""
+        parts = []
+        got = 0
+        while True:
+            n, = CHUNK_LEN.unpack(await self._read(reader, CHUNK_LEN.size))
+            if n == FRAME_CHUNK_ABORT:
+                return None
+            if n == 0:
+                total, = CHUNK_LEN.unpack(await self._read(reader, CHUNK_LEN.size))
+                if total == 0 or total > got:
+                    raise ProtocolError(f"bad chunked length {total} (received {got})")
+                return b"".join(parts)[:total]  # 去掉 EOI 之后的 DMA 填充
+            got += n
+            if got > FRAME_MAX_PAYLOAD:
+                raise ProtocolError(f"chunked payload over {FRAME_MAX_PAYLOAD}")
+            parts.append(await self._read(reader, n))
+
+    async def _recv_framed(self, reader: asyncio.StreamReader, slot: CameraSlot, first: bytes) -> None:
+        """帧头协议：按长度读取"""
+        raw = first + await self._read(reader, FRAME_HEADER.size - len(first))
+        while True:
+            hdr = parse_header(raw)
+            extra = hdr.header_len - FRAME_HEADER.size
+            ext = await self._read(reader, extra) if extra else b""
+            meta = parse_meta(ext) if extra else None
+            if is_chunked(hdr, ext):
+                payload = await self._recv_chunked(reader)
+                raw = await self._read(reader, FRAME_HEADER.size)
+                if payload is None:
+                    continue
+                if meta is not None:
+                    slot.sensor_meta = meta
+                await slot.publish(hdr._replace(payload_len=len(payload)), payload)
+                continue
+            payload = await self._read(reader, hdr.payload_len)
+            if hdr.flags & FRAME_FLAG_STATS:
+                slot.device_stats = payload.decode("utf-8", errors="replace")
+            elif hdr.flags & FRAME_FLAG_AUDIO:
+                slot.publish_audio(hdr, payload)
+            elif hdr.flags & FRAME_FLAG_SPOOL:
+                slot.spool_frames += 1
+            elif hdr.flags & FRAME_FLAG_BURST:
+                slot.burst_frames += 1
+            elif hdr.pixformat == PIXFORMAT_UNCHANGED:
+                slot.unchanged_frames += 1
+                slot.last_seq = hdr.seq  # 占位帧占用序号，最新帧保持不变
+            elif hdr.pixformat == PIXFORMAT_JPEG_TILES:
+                jpeg = tiles_merge(slot.tile_ref[0], slot.tile_ref[1], payload) if slot.tile_ref else None
+                if jpeg is not None:  # 尚未收到完整帧或分块数不一致时丢弃，等待下一帧完整帧
+                    if meta is not None:
+                        slot.sensor_meta = meta
+                    await slot.publish(hdr._replace(pixformat=PIXFORMAT_JPEG, payload_len=len(jpeg)), jpeg)
+            elif hdr.flags & FRAME_FLAG_CTRL:
+                if CTRL_ACK.unpack_from(payload)[0] == CTRL_CMD_CLOCK_PING and len(payload) >= CTRL_CLOCK_ACK.size:
+                    slot.clock_samples.append(clock_sample(*CTRL_CLOCK_ACK.unpack_from(payload)[4:], now_us()))
+            else:
+                if meta is not None:
+                    slot.sensor_meta = meta
+                if self.mosaic is not None and hdr.pixformat == PIXFORMAT_JPEG and hdr.flags & FRAME_FLAG_KEY:
+                    slot.tile_ref = tiles_split(payload)
+                await slot.publish(hdr, payload)
+            raw = await self._read(reader, FRAME_HEADER.size)
+
+    async def _clock_sync(self, slot: CameraSlot, writer: asyncio.StreamWriter) -> None:
+        """周期性校时：往返最短的一次受排队影响最小，以它的偏移为准"""
+        while True:
+            slot.clock_samples = []
+            for seq in range(CLOCK_PINGS):
+                writer.write(build_command(CTRL_CMD_CLOCK_PING, now_us(), seq))
+                await asyncio.sleep(CLOCK_PING_GAP_S)
+            await asyncio.sleep(CLOCK_PING_GAP_S * 4)  # 等最后几个应答
+            if slot.clock_samples:
+                offset, rtt = min(slot.clock_samples, key=lambda s: s[1])
+                writer.write(build_command(CTRL_CMD_CLOCK_SET, offset))
+                slot.clock_offset_us = offset
+                slot.clock_rtt_us = rtt
+            await asyncio.sleep(CLOCK_PERIOD_S)
+
+    async def _recv_legacy(self, reader: asyncio.StreamReader, slot: CameraSlot, first: bytes) -> None:
+        """旧固件裸 JPEG 流：按 SOI/EOI 切帧，EOI 从上次扫描到的位置继续找"""
+        buf = bytearray(first)
+        scan = 2
+        while True:
+            while True:
+                start = buf.find(SOI)
+                if start < 0:
+                    del buf[:-1]
+                    break
+                if start > 0:
+                    del buf[:start]
+                    scan = 2
+                end = buf.find(EOI, scan)
+                if end < 0:
+                    scan = max(2, len(buf) - 1)
+                    if len(buf) > LEGACY_MAX:
+                        buf.clear()
+                        scan = 2
+                    break
+                end += 2
+                await slot.publish(None, bytes(buf[:end]))
+                del buf[:end]
+                scan = 2
+            data = await asyncio.wait_for(reader.read(LEGACY_CHUNK), self.idle_timeout)
+            if not data:
+                raise asyncio.IncompleteReadError(b"", None)
+            buf += data
+
+    async def handle_device(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter) -> None:
+        peer = writer.get_extra_info("peername")
+        cam_id = peer[0] if peer else "unknown"
+        slot = self.slot(cam_id)
+        if slot.writer is not None:
+            slot.writer.close()  # 设备重启后重连，旧连接尚未超时
+        slot.writer = writer
+        slot.connected = True
+        slot.connects += 1
+        slot.connected_since = time.time()
+        print(f"[INFO] 摄像头 {cam_id} 已连接 {peer}，共 {sum(c.connected for c in self.cameras.values())} 路")
+        try:
+            first = await self._read(reader, 4)
+            if first[:2] == SOI:
+                await self._recv_legacy(reader, slot, first)
+            else:
+                if self.static_skip_ms:
+                    writer.write(build_command(CTRL_CMD_STATIC_SKIP, self.static_skip_ms))
+                if self.mosaic is not None:
+                    slot.tile_ref = None
+                    writer.write(build_command(CTRL_CMD_JPEG_TILES, 1))  # 完整帧带 DRI，才能在压缩域拼接
+                clock = asyncio.ensure_future(self._clock_sync(slot, writer))
+                try:
+                    await self._recv_framed(reader, slot, first)
+                finally:
+                    clock.cancel()
+        except asyncio.IncompleteReadError:
+            print(f"[INFO] 摄像头 {cam_id} 断开连接")
+        except asyncio.TimeoutError:
+            print(f"[WARN] 摄像头 {cam_id} {self.idle_timeout:.0f} 秒无数据，断开")
+        except ProtocolError as e:
+            print(f"[WARN] 摄像头 {cam_id} 帧头错误，断开连接: {e}")
+        except (ConnectionError, OSError) as e:
+            print(f"[WARN] 摄像头 {cam_id} 连接异常: {e}")
+        finally:
+            if slot.writer is writer:
+                slot.writer = None
+                slot.connected = False
+            writer.close()
+
+    def capture(self, in_ms: int) -> dict:
+        """同步抓拍：向已校时的各路下发同一目标时刻，帧到达后按采集时间选出最接近的一帧"""
+        target = now_us() + in_ms * 1000
+        armed = []
+        for slot in self.cameras.values():
+            if slot.writer is None or slot.clock_offset_us is None:
+                continue
+            slot.capture_target_us = target
+            slot.capture_jpeg = None
+            slot.capture_error_us = None
+            slot.writer.write(build_command(CTRL_CMD_CAPTURE_AT, target))
+            armed.append(slot.id)
+        return {"target_us": target, "cameras": sorted(armed)}
+
+    async def mosaic_jpeg(self) -> Optional[bytes]:
+        """电视墙画面：距上次拼接不足一个周期时直接返回上次的结果，各路按 id 排序依次填入格子"""
+        async with self._mosaic_lock:
+            if self._mosaic_jpeg is None or time.monotonic() - self._mosaic_time >= self.mosaic_period:
+                tiles = [c.jpeg for c in sorted(self.cameras.values(), key=lambda c: c.id)]
+                jpeg, _ = await asyncio.get_running_loop().run_in_executor(None, self.mosaic.compose, tiles)
+                self._mosaic_jpeg = jpeg
+                self._mosaic_time = time.monotonic()
+            return self._mosaic_jpeg
+
+    async def _mosaic_stream(self, writer: asyncio.StreamWriter) -> None:
+        """电视墙 MJPEG 流：每个周期发送一次最新的拼接结果"""
+        writer.write(b"HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+                     b"Cache-Control: no-store\r\nConnection: close\r\n\r\n")
+        sent = None
+        while True:
+            jpeg = await self.mosaic_jpeg()
+            if jpeg is not None and jpeg is not sent:
+                writer.write(b"--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %d\r\n\r\n" % len(jpeg))
+                writer.write(jpeg)
+                writer.write(b"\r\n")
+                await writer.drain()
+                sent = jpeg
+            await asyncio.sleep(self.mosaic_period)
+
+    # ---------------- HTTP 服务 ----------------
+
+    @staticmethod
+    async def _respond(writer: asyncio.StreamWriter, status: str, ctype: str, body: bytes, cache: str = "no-store",
+                       cors: bool = False) -> None:
+        extra = "Access-Control-Allow-Origin: *\r\n" if cors else ""
+        writer.write(f"HTTP/1.1 {status}\r\nContent-Type: {ctype}\r\nContent-Length: {len(body)}\r\n"
+                     f"Cache-Control: {cache}\r\n{extra}Connection: close\r\n\r\n".encode() + body)
+        await writer.drain()
+
+    async def _stream(self, writer: asyncio.StreamWriter, slot: CameraSlot) -> None:
+        """MJPEG 流：每次发送时取最新帧，发送期间到达的帧被跳过"""
+        writer.write(b"HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+                     b"Cache-Control: no-store\r\nConnection: close\r\n\r\n")
+        sent = None
+        while True:
+            async with slot.cond:
+                await slot.cond.wait_for(lambda: slot.jpeg is not None and slot.jpeg is not sent)
+                jpeg = slot.jpeg
+            writer.write(b"--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %d\r\n\r\n" % len(jpeg))
+            writer.write(jpeg)
+            writer.write(b"\r\n")
+            await writer.drain()
+            sent = jpeg
+
+    async def handle_http(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter) -> None:
+        try:
+            request = await asyncio.wait_for(reader.readuntil(b"\r\n\r\n"), 10.0)
+            parts = request.split(b"\r\n", 1)[0].decode("latin-1").split()
+            if len(parts) < 2 or parts[0] != "GET":
+                await self._respond(writer, "405 Method Not Allowed", "text/plain", b"GET only\n")
+                return
+            path, _, query = parts[1].partition("?")
+            path = path.rstrip("/") or "/"
+            if path == "/":
+                await self._respond(writer, "200 OK", "text/html; charset=utf-8", INDEX_HTML)
+                return
+            if path == "/capture":
+                body = json.dumps(self.capture(int(parse_qs(query).get("in_ms", ["500"])[0]))).encode()
+                await self._respond(writer, "200 OK", "application/json", body)
+                return
+            if path == "/cameras":
+                info = {"cameras": [c.to_dict() for c in sorted(self.cameras.values(), key=lambda c: c.id)]}
+                if self.mosaic is not None:
+                    info["mosaic"] = self.mosaic.to_dict()
+                body = json.dumps(info, ensure_ascii=False).encode()
+                await self._respond(writer, "200 OK", "application/json", body)
+                return
+            if path in ("/mosaic.jpg", "/mosaic/stream"):
+                if self.mosaic is None:
+                    await self._respond(writer, "404 Not Found", "text/plain", b"mosaic disabled (--mosaic)\n")
+                elif path == "/mosaic/stream":
+                    await self._mosaic_stream(writer)
+                else:
+                    jpeg = await self.mosaic_jpeg()
+                    if jpeg is None:
+                        await self._respond(writer, "503 Service Unavailable", "text/plain", b"no mosaic yet\n")
+                    else:
+                        await self._respond(writer, "200 OK", "image/jpeg", jpeg)
+                return
+            route = path.split("/")
+            if len(route) == 4 and route[1] == "hls":
+                slot = self.cameras.get(route[2])
+                if slot is None or slot.hls is None:
+                    await self._respond(writer, "404 Not Found", "text/plain", b"not found\n")
+                    return
+                status, ctype, body, cache = await slot.hls.fetch(route[3], parse_qs(query))
+                await self._respond(writer, status, ctype, body, cache, cors=True)  # 跨域：播放页面可在其他站点
+                return
+            slot = self.cameras.get(route[2]) if len(route) == 4 and route[1] == "cameras" else None
+            if slot is None:
+                await self._respond(writer, "404 Not Found", "text/plain", b"not found\n")
+            elif route[3] == "latest.jpg" and slot.jpeg is not None:
+                await self._respond(writer, "200 OK", "image/jpeg", slot.jpeg)
+            elif route[3] == "capture.jpg" and slot.capture_jpeg is not None:
+                await self._respond(writer, "200 OK", "image/jpeg", slot.capture_jpeg)
+            elif route[3] == "stream":
+                await self._stream(writer, slot)
+            elif route[3] == "stats" and slot.writer is not None:
+                slot.writer.write(b"stats\n")  # 设备以 FRAME_FLAG_STATS 帧回复
+                await self._respond(writer, "202 Accepted", "text/plain", b"requested\n")
+            else:
+                await self._respond(writer, "404 Not Found", "text/plain", b"not available\n")
+        except (asyncio.IncompleteReadError, asyncio.LimitOverrunError, asyncio.TimeoutError,
+                ConnectionError, OSError, ValueError):
+            pass
+        finally:
+            writer.close()
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="ESP32 WiFi Camera multi-camera ingest server")
+    parser.add_argument("--host", default="0.0.0.0", help="监听地址，默认 0.0.0.0")
+    parser.add_argument("--port", type=int, default=8000, help="设备连接端口，需与固件一致，默认 8000")
+    parser.add_argument("--http-port", type=int, default=8080, help="HTTP 服务端口，默认 8080")
+    parser.add_argument("--idle-timeout", type=float, default=15.0, help="设备连接无数据多少秒后断开，默认 15")
+    parser.add_argument("--record", metavar="DIR", help="录像根目录，设备 JPEG 原样分段写入；不指定则不录像")
+    parser.add_argument("--segment", type=int, default=300, help="录像分段时长（秒），默认 300")
+    parser.add_argument("--hls", action="store_true", help="每路摄像头转码一次为低延迟 HLS，/hls/<id>/index.m3u8（需 PyAV）")
+    parser.add_argument("--hls-dir", metavar="DIR", help="HLS 分段同时写入该目录（供静态源站/CDN），隐含 --hls")
+    parser.add_argument("--hls-part-ms", type=int, default=200, help="HLS 部分段时长（ms），默认 200")
+    parser.add_argument("--hls-segment", type=int, default=2, help="HLS 分段时长（秒，每段一个 IDR），默认 2")
+    parser.add_argument("--hls-bitrate", type=int, default=1500, help="HLS 的 H.264 码率（kbps），默认 1500")
+    parser.add_argument("--hls-window", type=int, default=6, help="播放列表保留的完整分段数，默认 6")
+    parser.add_argument("--static-skip", type=int, default=5000, metavar="MS",
+                        help="画面未变化时设备只发占位帧，至少每隔 MS 毫秒上传一帧图像，0 关闭，默认 5000")
+    parser.add_argument("--mosaic", type=int, default=0, metavar="COLS",
+                        help="电视墙拼接的列数，/mosaic.jpg 与 /mosaic/stream，设备开启分块模式以便压缩域拼接，0 关闭，默认 0")
+    parser.add_argument("--mosaic-fps", type=float, default=5.0, help="电视墙的拼接帧率上限，默认 5")
+    parser.add_argument("--mosaic-scale", type=int, default=2, choices=(1, 2, 4, 8),
+                        help="表头不同而退回转码时，每格为第一路画面的 1/N，默认 2")
+    parser.add_argument("--tls-cert", metavar="PEM", help="设备端口的 TLS 证书（固件 TLS_STREAM_EN），需同时指定 --tls-key")
+    parser.add_argument("--tls-key", metavar="PEM", help="TLS 证书的私钥")
+    parser.add_argument("--prio", type=int, default=0, help="mDNS 发布的优先级，越小越优先，备用服务器设大一些，默认 0")
+    parser.add_argument("--no-advertise", action="store_true", help="不以 mDNS 发布本服务（设备只用静态列表）")
+    return parser.parse_args()
+
+
+async def run(args: argparse.Namespace, recorder: Optional[Recorder], hls: Optional[HlsPackager]) -> None:
+    mosaic = Mosaic(args.mosaic, args.mosaic_scale) if args.mosaic > 0 else None
+    server = IngestServer(args.idle_timeout, recorder, args.static_skip, hls, mosaic, args.mosaic_fps)
+    tls = tls_server_context(args.tls_cert, args.tls_key) if args.tls_cert else None
+    devices = await asyncio.start_server(server.handle_device, args.host, args.port, backlog=128, ssl=tls,
+                                         ssl_handshake_timeout=10.0 if tls else None)
+    http = await asyncio.start_server(server.handle_http, args.host, args.http_port)
+    print(f"[INFO] 设备端口 {args.host}:{args.port}{'（TLS）' if tls else ''}，HTTP http://{args.host}:{args.http_port}/")
+    async with devices, http:
+        await asyncio.gather(devices.serve_forever(), http.serve_forever())
+
+
+def local_ip(host: str) -> str:
+    """发布到 mDNS 的本机地址：监听地址为 0.0.0.0 时取默认路由所在网卡的地址"""
+    if host not in ("", "0.0.0.0"):
+        return host
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        try:
+            s.connect(("10.255.255.255", 1))  # UDP 不发包，只选路
+            return s.getsockname()[0]
+        except OSError:
+            return "127.0.0.1"
+
+
+def advertise(args: argparse.Namespace):
+    """以 mDNS 发布 _camingest._tcp 服务，返回 (zeroconf, info)；未安装 zeroconf 时返回 None"""
+    try:
+        from zeroconf import ServiceInfo, Zeroconf  # 可选，未安装时设备只用固件中的静态列表
+    except ImportError:
+        print("[INFO] 未安装 zeroconf，不发布 mDNS 服务")
+        return None
+    ip = local_ip(args.host)
+    name = f"ingest-{socket.gethostname()}-{args.port}._camingest._tcp.local."
+    info = ServiceInfo("_camingest._tcp.local.", name, addresses=[socket.inet_aton(ip)], port=args.port,
+                       properties={"prio": str(args.prio)})
+    zc = Zeroconf()
+    zc.register_service(info)
+    print(f"[INFO] mDNS 发布 {name} {ip}:{args.port} prio={args.prio}")
+    return zc, info
+
+
+def main() -> int:
+    args = parse_args()
+    if (args.hls or args.hls_dir) and not hls_available():
+        print("[ERROR] --hls 需要 PyAV：pip install av")
+        return 2
+    mdns = None if args.no_advertise else advertise(args)  # 须在事件循环之外使用同步接口
+    try:
+        import uvloop  # 可选，安装后事件循环开销更低
+        uvloop.install()
+    except ImportError:
+        pass
+    recorder = Recorder(args.record, args.segment) if args.record else None
+    hls = None
+    if args.hls or args.hls_dir:
+        hls = HlsPackager(args.hls_dir, args.hls_part_ms, args.hls_segment, args.hls_bitrate, args.hls_window)
+    try:
+        asyncio.run(run(args, recorder, hls))
+    except KeyboardInterrupt:
+        print("\n[INFO] 已中断")
+    except OSError as e:
+        print(f"[ERROR] 监听失败: {e}")
+        return 3
+    finally:
+        if recorder is not None:
+            recorder.close()
+        if hls is not None:
+            hls.close()
+        if mdns is not None:
+            mdns[0].unregister_service(mdns[1])  # 发送 goodbye 报文，设备之后的查询不再发现本机
+            mdns[0].close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+JPEG 解码后端（启动时选择）
+- cv2：cv2.imdecode；scale>1 时用 IMREAD_REDUCED_COLOR_*，由 libjpeg 在 DCT 域直接输出 1/2、1/4、1/8 尺寸
+- turbojpeg：PyTurboJPEG（pip install PyTurboJPEG，需系统安装 libjpeg-turbo），scaling_factor 同样在 DCT 域缩小，
+  SIMD 解码，ctypes 调用期间释放 GIL，多个标注线程可并行解码
+- auto：能加载 turbojpeg 时用 turbojpeg，否则用 cv2
+缩小解码跳过了高频系数的反变换和色度上采样，1/4 尺寸时解码耗时约为全尺寸的 1/4~1/3，适合只需要低分辨率的分析
+"""
+from typing import Optional
+
+import cv2
+import numpy as np
+
+DECODE_BACKENDS = ("auto", "cv2", "turbojpeg")
+DECODE_SCALES = (1, 2, 4, 8)
+_CV2_REDUCED = {1: cv2.IMREAD_COLOR, 2: cv2.IMREAD_REDUCED_COLOR_2,
+                4: cv2.IMREAD_REDUCED_COLOR_4, 8: cv2.IMREAD_REDUCED_COLOR_8}
+
+
+class JpegDecoder:
+    """decode(JPEG) -> BGR 图像（宽高为原图的 1/scale，向上取整），失败返回 None；可在多个线程中同时调用"""
+
+    def __init__(self, backend: str = "auto", scale: int = 1):
+        if scale not in DECODE_SCALES:
+            raise ValueError(f"decode scale must be one of {DECODE_SCALES}")
+        self.scale = scale
+        self._tj = None
+        if backend in ("auto", "turbojpeg"):
+            try:
+                from turbojpeg import TJPF_BGR, TurboJPEG
+                self._tj = TurboJPEG()
+                self._tj_bgr = TJPF_BGR
+            except (ImportError, OSError, RuntimeError) as e:
+                if backend == "turbojpeg":
+                    raise RuntimeError(f"turbojpeg backend unavailable: {e}") from e
+        self.backend = "turbojpeg" if self._tj is not None else "cv2"
+
+    def decode(self, data) -> Optional[np.ndarray]:
+        """data 可为 bytes 或 memoryview（不拷贝）"""
+        if self._tj is not None:
+            try:
+                return self._tj.decode(np.frombuffer(data, dtype=np.uint8), pixel_format=self._tj_bgr,
+                                       scaling_factor=(1, self.scale))
+            except (OSError, ValueError):
+                return None
+        return cv2.imdecode(np.frombuffer(data, dtype=np.uint8), _CV2_REDUCED[self.scale])
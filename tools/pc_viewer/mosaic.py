@@ -0,0 +1,264 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+多路摄像头拼接（电视墙）：把各路最新帧拼成一幅 JPEG
+- 压缩域拼接：各路 JPEG 的表头（量化表、霍夫曼表、SOF 采样因子与宽高、DRI、SOS）完全相同，宽高为 MCU 的整数倍，
+  且重同步间隔（DRI）整除每行 MCU 数时，每个重同步间隔都是一行内的一段 MCU，DC 预测在间隔边界清零、数据按字节对齐。
+  拼接图的每行 MCU 依次取各列摄像头同一行的间隔，按顺序重新插入 RST0~7，改写 SOF 的宽高即可，不解码、不重编码，
+  开销只与字节数有关。设备开启 CTRL_CMD_JPEG_TILES 后完整帧即为以分块为间隔的 JPEG（固件 jpg_tiles_encode），
+  同型号、同质量的摄像头表头相同
+- 没有画面的格子用中灰的间隔填充（每个 8x8 块只有 DC 差值 0 和 EOB，由该表头的霍夫曼表编码）
+- 表头不同、没有 DRI 或宽高不是 MCU 整数倍时退回缩放转码：各路以 DCT 域缩小解码（jpeg_decode.py）到格子大小后
+  拼接再编码（需要 OpenCV，只在退回时加载）
+- compose() 返回 (JPEG, "compressed" 或 "transcode")；各路的解析结果按帧对象缓存，帧未变化时不再解析
+"""
+import struct
+from typing import Dict, List, NamedTuple, Optional, Sequence, Tuple
+
+from frame_proto import EOI, RST_MARKER, SOI
+
+MOSAIC_FILL = 128  # 空格子的亮度（转码时），与压缩域填充的中灰一致
+MOSAIC_QUALITY = 80  # 退回转码时的 JPEG 质量
+MOSAIC_MAX_DIM = 65535  # JPEG 宽高上限
+RST = [bytes((0xFF, 0xD0 + i)) for i in range(8)]
+SEG_LEN = struct.Struct('>H')
+FILLER_CACHE_MAX = 16  # 按表头缓存的填充间隔数
+
+_fillers: Dict[bytes, Optional[bytes]] = {}  # 表头 -> 中灰间隔
+
+
+class JpegLayout(NamedTuple):
+    """一帧 JPEG 的拼接所需信息"""
+    header: bytes  # 去掉 APPn/COM 之后 SOI 到 SOS 段的全部表头，相同即可压缩域拼接，拼接图的表头以它为模板
+    sof: int  # header 中 SOF 段的偏移
+    width: int
+    height: int
+    mcu_w: int
+    mcu_h: int
+    interval: int  # 重同步间隔的 MCU 数，0:没有 DRI
+    segs: List[bytes]  # 各重同步间隔的熵编码数据
+    filler: Optional[bytes]  # 一个中灰间隔的熵编码数据，霍夫曼表缺少所需码字时为 None
+
+
+def _huff_codes(counts: bytes, symbols: bytes) -> Dict[int, Tuple[int, int]]:
+    """按 DHT 的码长计数生成规范霍夫曼码：符号 -> (码字, 码长)"""
+    codes = {}
+    code = 0
+    k = 0
+    for length in range(1, 17):
+        for _ in range(counts[length - 1]):
+            codes[symbols[k]] = (code, length)
+            code += 1
+            k += 1
+        code <<= 1
+    return codes
+
+
+def _filler(interval: int, blocks: List[Tuple[int, int, int]], dc: dict, ac: dict) -> Optional[bytes]:
+    """一个间隔的中灰 MCU：每块 DC 差值 0（类别 0）后接 EOB；blocks 为各分量的 (块数, DC 表号, AC 表号)"""
+    bits = 0
+    n = 0
+    for _ in range(interval):
+        for count, td, ta in blocks:
+            dc0 = dc.get(td, {}).get(0x00)
+            eob = ac.get(ta, {}).get(0x00)
+            if dc0 is None or eob is None:
+                return None
+            for _ in range(count):
+                for code, length in (dc0, eob):
+                    bits = bits << length | code
+                    n += length
+    pad = -n % 8
+    bits = bits << pad | ((1 << pad) - 1)  # 末尾不足一个字节时补 1
+    data = bits.to_bytes((n + pad) // 8, "big")
+    return data.replace(b"\xff", b"\xff\x00")
+
+
+def jpeg_layout(data: bytes) -> Optional[JpegLayout]:
+    """解析基线 JPEG 的表头并按 RST 切分熵编码数据，不是基线 JPEG 返回 None"""
+    n = len(data)
+    if n < 4 or data[:2] != SOI:
+        return None
+    header = bytearray(SOI)
+    sof = 0
+    width = height = 0
+    comps = {}  # 分量号 -> (水平采样, 垂直采样)
+    dc = {}
+    ac = {}
+    interval = 0
+    pos = 2
+    while pos + 4 <= n:
+        if data[pos] != 0xFF:
+            return None
+        marker = data[pos + 1]
+        if marker == 0xFF:
+            pos += 1
+            continue
+        length = SEG_LEN.unpack_from(data, pos + 2)[0]
+        seg = data[pos:pos + 2 + length]
+        body = seg[4:]
+        if 0xE0 <= marker <= 0xEF or marker == 0xFE:
+            pos += 2 + length  # APPn/COM 与拼接无关
+            continue
+        if marker in (0xC0, 0xC1):
+            sof = len(header)
+            height, width = struct.unpack_from('>HH', body, 1)
+            for i in range(body[5]):
+                cid, hv = body[6 + 3 * i], body[7 + 3 * i]
+                comps[cid] = (hv >> 4, hv & 0x0F)
+        elif 0xC2 <= marker <= 0xCF and marker not in (0xC4, 0xC8, 0xCC):
+            return None  # 渐进式、无损、算术编码
+        elif marker == 0xC4:
+            k = 0
+            while k + 17 <= len(body):
+                tc, th = body[k] >> 4, body[k] & 0x0F
+                total = sum(body[k + 1:k + 17])
+                (dc if tc == 0 else ac)[th] = _huff_codes(body[k + 1:k + 17], body[k + 17:k + 17 + total])
+                k += 17 + total
+        elif marker == 0xDD:
+            interval = SEG_LEN.unpack_from(body)[0]
+        header += seg
+        pos += 2 + length
+        if marker != 0xDA:
+            continue
+        if not sof or not comps:
+            return None
+        hmax = max(h for h, _ in comps.values())
+        vmax = max(v for _, v in comps.values())
+        scan = []
+        for i in range(body[0]):
+            cid, tables = body[1 + 2 * i], body[2 + 2 * i]
+            h, v = comps.get(cid, (1, 1))
+            scan.append((h * v if body[0] > 1 else 1, tables >> 4, tables & 0x0F))
+        if body[0] == 1:
+            hmax = vmax = 1  # 单分量扫描不交织，MCU 为一个 8x8 块
+        end = data.rfind(EOI)
+        if end < pos:
+            return None
+        segs = RST_MARKER.split(data[pos:end]) if interval else [data[pos:end]]
+        header = bytes(header)
+        if interval and header not in _fillers:
+            if len(_fillers) >= FILLER_CACHE_MAX:
+                _fillers.clear()
+            _fillers[header] = _filler(interval, scan, dc, ac)
+        return JpegLayout(header, sof, width, height, 8 * hmax, 8 * vmax, interval, segs, _fillers.get(header))
+    return None
+
+
+def compose_compressed(cells: Sequence[Optional[JpegLayout]], cols: int) -> Optional[bytes]:
+    """压缩域拼接：cells 按行优先排列（None 为空格子），表头不同或不满足拼接条件时返回 None"""
+    ref = next((c for c in cells if c is not None), None)
+    if ref is None or not ref.interval or ref.filler is None or ref.width % ref.mcu_w or ref.height % ref.mcu_h:
+        return None
+    per_row = ref.width // ref.mcu_w
+    if per_row % ref.interval:
+        return None
+    k = per_row // ref.interval  # 每行 MCU 的间隔数
+    mcu_rows = ref.height // ref.mcu_h
+    rows = (len(cells) + cols - 1) // cols
+    if ref.width * cols > MOSAIC_MAX_DIM or ref.height * rows > MOSAIC_MAX_DIM:
+        return None
+    for c in cells:
+        if c is not None and (c.header != ref.header or len(c.segs) != k * mcu_rows):
+            return None
+    header = bytearray(ref.header)
+    struct.pack_into('>HH', header, ref.sof + 5, ref.height * rows, ref.width * cols)
+    out = [bytes(header)]
+    idx = 0
+    for r in range(rows):
+        row = list(cells[r * cols:(r + 1) * cols]) + [None] * (cols * (r + 1) - len(cells))
+        for y in range(mcu_rows):
+            for cell in row:
+                for j in range(k):
+                    if idx:
+                        out.append(RST[(idx - 1) & 7])
+                    out.append(cell.segs[y * k + j] if cell is not None else ref.filler)
+                    idx += 1
+    out.append(EOI)
+    return b"".join(out)
+
+
+class Mosaic:
+    """按固定列数拼接多路 JPEG；可在一个线程中反复调用 compose()"""
+
+    def __init__(self, cols: int, scale: int = 2, backend: str = "auto", quality: int = MOSAIC_QUALITY):
+        self.cols = max(1, cols)
+        self.scale = scale  # 退回转码时格子为第一路画面的 1/scale
+        self.backend = backend
+        self.quality = quality
+        self.compressed = 0
+        self.transcoded = 0
+        self.last_mode = ""
+        self.last_bytes = 0
+        self._layouts: Dict[int, Tuple[bytes, Optional[JpegLayout]]] = {}  # 格子 -> (帧, 解析结果)
+        self._decoders = {}
+
+    def _layout(self, i: int, jpeg: bytes) -> Optional[JpegLayout]:
+        cached = self._layouts.get(i)
+        if cached is not None and cached[0] is jpeg:
+            return cached[1]
+        layout = jpeg_layout(jpeg)
+        self._layouts[i] = (jpeg, layout)
+        return layout
+
+    def _transcode(self, tiles: Sequence[Optional[bytes]]) -> Optional[bytes]:
+        """缩放转码：DCT 域缩小解码到格子大小，必要时再缩放，拼接后编码"""
+        try:
+            import cv2
+            import numpy as np
+            from jpeg_decode import DECODE_SCALES, JpegDecoder
+        except ImportError:
+            return None  # 未安装 OpenCV 时只能压缩域拼接
+
+        first = next((self._layouts[i][1] for i, t in enumerate(tiles) if t is not None and self._layouts[i][1]), None)
+        if first is None:
+            return None
+        cw, ch = max(1, first.width // self.scale), max(1, first.height // self.scale)
+        rows = (len(tiles) + self.cols - 1) // self.cols
+        canvas = np.full((rows * ch, self.cols * cw, 3), MOSAIC_FILL, dtype=np.uint8)
+        for i, jpeg in enumerate(tiles):
+            layout = self._layouts[i][1] if jpeg is not None else None
+            if layout is None:
+                continue
+            s = max(s for s in DECODE_SCALES if s == 1 or (layout.width // s >= cw and layout.height // s >= ch))
+            dec = self._decoders.get(s)
+            if dec is None:
+                dec = self._decoders[s] = JpegDecoder(self.backend, s)
+            img = dec.decode(jpeg)
+            if img is None:
+                continue
+            if img.shape[1] != cw or img.shape[0] != ch:
+                img = cv2.resize(img, (cw, ch), interpolation=cv2.INTER_AREA)
+            y, x = i // self.cols * ch, i % self.cols * cw
+            canvas[y:y + ch, x:x + cw] = img
+        ok, enc = cv2.imencode(".jpg", canvas, [cv2.IMWRITE_JPEG_QUALITY, self.quality])
+        return enc.tobytes() if ok else None
+
+    def compose(self, tiles: Sequence[Optional[bytes]]) -> Tuple[Optional[bytes], str]:
+        """tiles 按行优先排列的各格最新帧（None 为空格子），返回 (拼接图, 方式)；全部为空时返回 (None, "")"""
+        for i in [i for i in self._layouts if i >= len(tiles)]:
+            del self._layouts[i]
+        cells = [self._layout(i, t) if t is not None else None for i, t in enumerate(tiles)]
+        jpeg = compose_compressed(cells, self.cols)
+        mode = "compressed"
+        if jpeg is None:
+            jpeg = self._transcode(tiles)
+            mode = "transcode"
+        if jpeg is None:
+            return None, ""
+        if mode == "compressed":
+            self.compressed += 1
+        else:
+            self.transcoded += 1
+        self.last_mode = mode
+        self.last_bytes = len(jpeg)
+        return jpeg, mode
+
+    def to_dict(self) -> dict:
+        return {
+            "cols": self.cols,
+            "compressed": self.compressed,
+            "transcoded": self.transcoded,
+            "last_mode": self.last_mode,
+            "last_bytes": self.last_bytes,
+        }
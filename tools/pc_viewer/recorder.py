@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+分段录像（原样写入设备 JPEG，不解码不转码）
+- 每路摄像头一个目录，按墙钟时间切成 --segment 秒的段：<根目录>/<摄像头>/<YYYYmmdd-HHMMSS>.mjpeg
+  段文件为 JPEG 首尾相接的 MJPEG 流（ffplay -f mjpeg / VLC 可直接播放）
+- 每段配一个索引文件 .idx：每帧一条 INDEX_ENTRY（接收时间 us、段内偏移、长度、设备帧序号），按时间递增，
+  回放/导出按时间二分查找偏移，不扫描 JPEG 标记
+- 写盘在独立线程中进行（大块缓冲写，每秒 flush 一次），不占用接收的事件循环；
+  磁盘跟不上时写入队列满，新帧丢弃并计数，接收与转发不受影响
+
+用法示例（导出一段时间内的录像）：
+    python ./tools/pc_viewer/recorder.py export rec/192.168.1.50 --start "2026-10-15 12:00:00" --end "2026-10-15 12:05:00" -o cut.mjpeg
+"""
+import argparse
+import os
+import queue
+import struct
+import sys
+import threading
+import time
+from typing import Iterator, List, Optional, Tuple
+
+INDEX_ENTRY = struct.Struct('<QQII')  # wall_us, offset, len, seq（旧协议帧 seq 为 0）
+SEGMENT_EXT = ".mjpeg"
+INDEX_EXT = ".idx"
+WRITE_BUF = 1024 * 1024  # 段文件的写缓冲
+QUEUE_MAX = 256  # 待写帧数上限，超过则丢帧
+FLUSH_S = 1.0  # 写入线程至多每隔这么久 flush 一次，正在录制的段也能按索引回放
+COPY_CHUNK = 1024 * 1024
+
+
+class CameraRecorder:
+    """一路摄像头的录像：write() 在事件循环中调用，只入队；其余方法在写入线程中运行"""
+
+    def __init__(self, owner: "Recorder", cam_id: str):
+        self.owner = owner
+        self.dir = os.path.join(owner.root, cam_id.replace(":", "_"))
+        self.frames = 0
+        self.bytes = 0
+        self.dropped = 0
+        self.segment: Optional[str] = None  # 当前段文件名
+        self._data = None
+        self._index = None
+        self._offset = 0
+        self._segment_end = 0
+
+    def write(self, seq: int, jpeg: bytes) -> None:
+        try:
+            self.owner.queue.put_nowait((self, time.time_ns() // 1000, seq, jpeg))
+        except queue.Full:
+            self.dropped += 1
+
+    def _open(self, wall_us: int) -> None:
+        self.close()
+        seg_us = self.owner.segment_s * 1000000
+        start = wall_us // seg_us * seg_us  # 段边界与墙钟对齐，各路摄像头同时切段
+        self._segment_end = start + seg_us
+        os.makedirs(self.dir, exist_ok=True)
+        name = time.strftime("%Y%m%d-%H%M%S", time.localtime(wall_us / 1e6))
+        path = os.path.join(self.dir, name)
+        self._data = open(path + SEGMENT_EXT, "ab", buffering=WRITE_BUF)
+        self._index = open(path + INDEX_EXT, "ab", buffering=64 * 1024)
+        self._offset = self._data.tell()  # 同一秒内重启时续写同名段
+        self.segment = name + SEGMENT_EXT
+
+    def _append(self, wall_us: int, seq: int, jpeg: bytes) -> None:
+        if self._data is None or wall_us >= self._segment_end:
+            self._open(wall_us)
+        self._data.write(jpeg)
+        self._index.write(INDEX_ENTRY.pack(wall_us, self._offset, len(jpeg), seq & 0xFFFFFFFF))
+        self._offset += len(jpeg)
+        self.frames += 1
+        self.bytes += len(jpeg)
+
+    def flush(self) -> None:
+        if self._data is not None:
+            self._data.flush()  # 先数据后索引，索引指向的数据总已落盘
+            self._index.flush()
+
+    def close(self) -> None:
+        if self._data is not None:
+            self.flush()
+            self._data.close()
+            self._index.close()
+            self._data = self._index = None
+
+
+class Recorder:
+    """所有摄像头共用的写入线程"""
+
+    def __init__(self, root: str, segment_s: int):
+        self.root = root
+        self.segment_s = max(1, segment_s)
+        self.queue: "queue.Queue" = queue.Queue(maxsize=QUEUE_MAX)
+        self.cameras: List[CameraRecorder] = []
+        self._thread = threading.Thread(target=self._run, name="recorder", daemon=True)
+        self._thread.start()
+
+    def camera(self, cam_id: str) -> CameraRecorder:
+        rec = CameraRecorder(self, cam_id)
+        self.cameras.append(rec)
+        return rec
+
+    def _run(self) -> None:
+        flushed = time.monotonic()
+        while True:
+            try:
+                item = self.queue.get(timeout=FLUSH_S)
+            except queue.Empty:
+                item = ()
+            if item is None:
+                break
+            if item:
+                rec, wall_us, seq, jpeg = item
+                try:
+                    rec._append(wall_us, seq, jpeg)
+                except OSError as e:
+                    rec.dropped += 1
+                    print(f"[WARN] 录像写入失败 {rec.dir}: {e}")
+                    rec.close()
+            if time.monotonic() - flushed >= FLUSH_S:
+                flushed = time.monotonic()
+                for rec in list(self.cameras):
+                    rec.flush()
+        for rec in list(self.cameras):
+            rec.close()
+
+    def close(self) -> None:
+        """写完队列中的帧后关闭所有段"""
+        self.queue.put(None)
+        self._thread.join()
+
+
+# ---------------- 读取 / 导出 ----------------
+
+def read_index(path: str) -> bytes:
+    with open(path, "rb") as f:
+        data = f.read()
+    return data[:len(data) // INDEX_ENTRY.size * INDEX_ENTRY.size]  # 忽略写了一半的末条
+
+
+def index_entry(index: bytes, i: int) -> Tuple[int, int, int, int]:
+    return INDEX_ENTRY.unpack_from(index, i * INDEX_ENTRY.size)
+
+
+def index_find(index: bytes, wall_us: int) -> int:
+    """第一条接收时间 >= wall_us 的帧号（二分查找），全部更早时返回条目数"""
+    lo, hi = 0, len(index) // INDEX_ENTRY.size
+    while lo < hi:
+        mid = (lo + hi) // 2
+        if index_entry(index, mid)[0] < wall_us:
+            lo = mid + 1
+        else:
+            hi = mid
+    return lo
+
+
+def segment_ranges(cam_dir: str, start_us: int, end_us: int) -> Iterator[Tuple[str, int, int]]:
+    """按时间顺序产出与 [start_us, end_us) 相交的各段 (段文件, 起始偏移, 结束偏移)；只读索引，不读段文件"""
+    for name in sorted(os.listdir(cam_dir)):
+        if not name.endswith(INDEX_EXT):
+            continue
+        index = read_index(os.path.join(cam_dir, name))
+        count = len(index) // INDEX_ENTRY.size
+        if not count or index_entry(index, 0)[0] >= end_us or index_entry(index, count - 1)[0] < start_us:
+            continue
+        first = index_find(index, start_us)
+        last = index_find(index, end_us)
+        if first < last:
+            _, begin, _, _ = index_entry(index, first)
+            _, off, length, _ = index_entry(index, last - 1)
+            yield os.path.join(cam_dir, name[:-len(INDEX_EXT)] + SEGMENT_EXT), begin, off + length
+
+
+def export(cam_dir: str, start_us: int, end_us: int, out_path: str) -> int:
+    """把时间段内的帧原样拷贝为一个 MJPEG 文件（同一段内的帧是连续的，按字节区间整块拷贝），返回字节数"""
+    total = 0
+    with open(out_path, "wb") as out:
+        for seg, begin, end in segment_ranges(cam_dir, start_us, end_us):
+            with open(seg, "rb") as f:
+                f.seek(begin)
+                left = end - begin
+                while left > 0:
+                    chunk = f.read(min(COPY_CHUNK, left))
+                    if not chunk:
+                        break
+                    out.write(chunk)
+                    left -= len(chunk)
+                    total += len(chunk)
+    return total
+
+
+def _parse_time(text: str) -> int:
+    return int(time.mktime(time.strptime(text, "%Y-%m-%d %H:%M:%S")) * 1000000)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="ESP32 camera segmented recording tools")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    ex = sub.add_parser("export", help="按时间导出一路摄像头的录像")
+    ex.add_argument("dir", help="摄像头录像目录（<录像根目录>/<摄像头>）")
+    ex.add_argument("--start", required=True, help='起始时间 "YYYY-mm-dd HH:MM:SS"（本地时间）')
+    ex.add_argument("--end", required=True, help='结束时间 "YYYY-mm-dd HH:MM:SS"（本地时间）')
+    ex.add_argument("-o", "--output", required=True, help="输出 MJPEG 文件")
+    args = parser.parse_args()
+    try:
+        n = export(args.dir, _parse_time(args.start), _parse_time(args.end), args.output)
+    except (OSError, ValueError) as e:
+        print(f"[ERROR] 导出失败: {e}")
+        return 1
+    print(f"[INFO] 导出 {n} 字节到 {args.output}")
+    return 0 if n else 2
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+RTP/JPEG（RFC 2435）接收端：把固件 main/APP/rtp_jpeg.c 的分片重组为完整 JPEG
+- 每个分片 = 12 字节 RTP 头 + 8 字节 JPEG 头（分片偏移、type、Q、宽/8、高/8）
+  [+ 4 字节重启头（type >= 64）] [+ 量化表头（Q >= 128，只在偏移 0 的分片）] + 熵编码数据
+- 同一帧的分片时间戳相同，最后一个分片置 Marker 位；分片按偏移写入，缺任何一段即丢弃整帧，不影响后续帧
+- 文件头按 RFC 2435 附录重建：DQT（随帧发送的量化表）、SOF0（type 0 为 4:2:2，1 为 4:2:0）、标准 Huffman 表、
+  [DRI]、SOS；摄像头与固件的压缩域转码输出的都是标准 Huffman 表，重建的文件与设备原图的熵编码数据逐字节相同
+- 不解码 JPEG，每帧只做一次拼接
+
+用法示例（单独验证接收，按帧打印尺寸）：
+    python ./tools/pc_viewer/rtp_jpeg.py --port 5004
+"""
+import argparse
+import socket
+import struct
+import sys
+from typing import Dict, List, Optional, Tuple
+
+RTP_HEADER = struct.Struct('>BBHII')  # V/P/X/CC, M/PT, seq, timestamp, ssrc
+JPEG_HEADER = struct.Struct('>BBHBBBB')  # type-specific, 偏移高 8 位, 偏移低 16 位, type, Q, 宽/8, 高/8
+RESTART_HEADER = struct.Struct('>HH')  # 重启间隔, F/L/count
+QUANT_HEADER = struct.Struct('>BBH')  # MBZ, precision, length
+RTP_JPEG_PT = 26
+RTP_JPEG_PORT = 5004
+FRAME_MAX = 4 * 1024 * 1024  # 分片偏移超过该值视为错乱
+
+# 标准 Huffman 表（ITU-T T.81 附录 K.3，与 conversions/jpge.cpp 相同）：各码长的码字数 + 符号
+DC_LUM_BITS = bytes([0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0])
+DC_CHROMA_BITS = bytes([0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0])
+DC_VALS = bytes(range(12))
+AC_LUM_BITS = bytes([0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d])
+AC_LUM_VALS = bytes([
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa])
+AC_CHROMA_BITS = bytes([0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77])
+AC_CHROMA_VALS = bytes([
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa])
+
+
+def _segment(marker: int, body: bytes) -> bytes:
+    return struct.pack('>BBH', 0xFF, marker, len(body) + 2) + body
+
+
+def make_header(jtype: int, width: int, height: int, qtables: List[bytes], dri: int = 0) -> bytes:
+    """按 RFC 2435 附录 B 重建 SOI 到 SOS 的文件头（qtables 为 zigzag 顺序，64 字节 8 位或 128 字节 16 位）"""
+    out = [b"\xff\xd8"]
+    for tq, table in enumerate(qtables):
+        out.append(_segment(0xDB, bytes([(0x10 if len(table) == 128 else 0) | tq]) + table))
+    if dri:
+        out.append(_segment(0xDD, struct.pack('>H', dri)))
+    luma = 0x21 if (jtype & 0x3F) == 0 else 0x22  # 0: 4:2:2，1: 4:2:0
+    chroma_q = 1 if len(qtables) > 1 else 0
+    out.append(_segment(0xC0, struct.pack('>BHHB', 8, height, width, 3) +
+                        bytes([1, luma, 0, 2, 0x11, chroma_q, 3, 0x11, chroma_q])))
+    for tc_th, bits, vals in ((0x00, DC_LUM_BITS, DC_VALS), (0x10, AC_LUM_BITS, AC_LUM_VALS),
+                              (0x01, DC_CHROMA_BITS, DC_VALS), (0x11, AC_CHROMA_BITS, AC_CHROMA_VALS)):
+        out.append(_segment(0xC4, bytes([tc_th]) + bits + vals))
+    out.append(_segment(0xDA, bytes([3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0])))
+    return b"".join(out)
+
+
+class RtpJpegAssembler:
+    """一路 RTP/JPEG 流（一个 SSRC）的分片重组"""
+
+    def __init__(self):
+        self.timestamp: Optional[int] = None
+        self.parts: Dict[int, bytes] = {}
+        self.header: Optional[Tuple[int, int, int, int]] = None  # type, 宽, 高, 重启间隔
+        self.qtables: Optional[List[bytes]] = None
+        self.end: Optional[int] = None  # 置 Marker 位的分片结束偏移，即熵编码数据总长
+        self.frames = 0
+        self.dropped = 0  # 缺分片或格式错误丢弃的帧
+
+    def _reset(self, timestamp: Optional[int]) -> None:
+        if self.parts:
+            self.dropped += 1
+        self.timestamp = timestamp
+        self.parts = {}
+        self.header = None
+        self.qtables = None
+        self.end = None
+
+    def feed(self, packet: bytes) -> Optional[Tuple[int, bytes]]:
+        """输入一个 UDP 包，帧完整时返回 (RTP 时间戳, JPEG)，否则返回 None"""
+        if len(packet) < RTP_HEADER.size + JPEG_HEADER.size:
+            return None
+        vpxcc, mpt, _, timestamp, _ = RTP_HEADER.unpack_from(packet)
+        if vpxcc >> 6 != 2 or (mpt & 0x7F) != RTP_JPEG_PT:
+            return None
+        pos = RTP_HEADER.size + (vpxcc & 0x0F) * 4
+        _, off_hi, off_lo, jtype, q, w8, h8 = JPEG_HEADER.unpack_from(packet, pos)
+        pos += JPEG_HEADER.size
+        offset = (off_hi << 16) | off_lo
+        if timestamp != self.timestamp:
+            self._reset(timestamp)  # 新的一帧开始，上一帧未收齐即丢弃
+        dri = 0
+        if jtype >= 64:
+            dri, _ = RESTART_HEADER.unpack_from(packet, pos)
+            pos += RESTART_HEADER.size
+        if offset == 0:
+            if q < 128:
+                self._reset(None)  # 固件总是随帧发送量化表（Q=255），不支持按 Q 值生成的表
+                return None
+            _, precision, qlen = QUANT_HEADER.unpack_from(packet, pos)
+            pos += QUANT_HEADER.size
+            len0 = 128 if precision & 0x01 else 64
+            table = packet[pos:pos + qlen]
+            pos += qlen
+            self.qtables = [bytes(table[:len0]), bytes(table[len0:])] if qlen > len0 else [bytes(table)]
+            self.header = (jtype, w8 * 8, h8 * 8, dri)
+        data = packet[pos:]
+        if offset + len(data) > FRAME_MAX:
+            self._reset(None)
+            return None
+        self.parts[offset] = data
+        if mpt & 0x80:
+            self.end = offset + len(data)
+        if self.end is None or self.header is None:
+            return None
+        scan = bytearray()
+        for off in sorted(self.parts):
+            if off != len(scan):
+                return None  # 中间的分片尚未到达（或已丢失，由下一帧的时间戳触发丢弃）
+            scan += self.parts[off]
+        if len(scan) != self.end:
+            return None
+        jtype, width, height, dri = self.header
+        jpeg = make_header(jtype, width, height, self.qtables, dri) + bytes(scan)
+        if not jpeg.endswith(b"\xff\xd9"):
+            jpeg += b"\xff\xd9"
+        self.parts = {}
+        self.timestamp = None
+        self.frames += 1
+        return timestamp, jpeg
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="RTP/JPEG (RFC 2435) receiver check")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=RTP_JPEG_PORT)
+    args = parser.parse_args()
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+    sock.bind((args.host, args.port))
+    streams: Dict[Tuple[str, int], RtpJpegAssembler] = {}
+    try:
+        while True:
+            packet, peer = sock.recvfrom(65536)
+            asm = streams.setdefault(peer, RtpJpegAssembler())
+            frame = asm.feed(packet)
+            if frame is not None:
+                print(f"{peer[0]} ts={frame[0]} {len(frame[1])} bytes, frames={asm.frames} dropped={asm.dropped}")
+    except KeyboardInterrupt:
+        return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
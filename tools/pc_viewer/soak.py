@@ -0,0 +1,330 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+长时间稳定性测试（配合稳定性测试固件：idf.py -B build_soak -D SOAK_BUILD=1 build，见 main/APP/soak.h）
+- 作为推流服务器运行 --hours 小时，设备每分钟上传一行 "SOAK {json}"（FRAME_FLAG_STATS 帧），
+  写成每分钟一行的 CSV：帧率、码率、端到端时延 p50/p99、按原因分类的丢帧、驱动丢帧、断线次数、RSSI、
+  各类内存（dram/dma/psram）的剩余/最大空闲块/最小剩余/分配失败次数、所有任务中最小的栈余量，以及本机收到的帧数
+- 按计划制造扰动，事件记录在 CSV 的 events 列：
+    --restart-every  每隔 N 分钟关闭监听与连接，--restart-down 秒后重新监听（设备走断线缓存与重连路径）
+    --framesizes     每隔 --framesize-every 分钟经控制通道依次切换分辨率（CTRL_CMD_SET_FRAMESIZE，framesize_t 数值）
+    --ap-off-cmd/--ap-on-cmd  每隔 --ap-every 分钟执行关闭 AP 的命令，--ap-down 秒后执行打开的命令（如路由器的 ssh 命令）
+- 结束时（或用 --analyze 对已有的 CSV）按阈值判定，超限时返回 1：
+    设备重启（uptime 回退）；同一分辨率下最后一段相对第一段的帧率下降；
+    各类内存剩余与最大空闲块的线性趋势（字节/小时）；最小剩余的下降；栈余量下限；驱动丢帧率；分配失败次数增加
+  预热（--warmup 分钟）之内以及扰动当分钟与下一分钟的行不参与帧率与内存趋势的判定
+
+用法示例：
+    python ./tools/pc_viewer/soak.py --hours 12 --restart-every 90 --framesizes 6,10,11 --framesize-every 30
+    python ./tools/pc_viewer/soak.py --hours 24 --ap-every 120 --ap-off-cmd "ssh root@ap wifi down" --ap-on-cmd "ssh root@ap wifi up"
+    python ./tools/pc_viewer/soak.py --analyze soak.csv
+"""
+import argparse
+import csv
+import json
+import os
+import socket
+import subprocess
+import sys
+import threading
+import time
+from typing import Dict, List, Optional
+
+from frame_proto import CTRL_CMD_SET_FRAMESIZE, FrameHeader, ProtocolError, build_command, iter_frames
+
+HEAP_CLASSES = ("dram", "dma", "psram")
+HEAP_FIELDS = ("free", "largest", "min_free", "fails")
+COLUMNS = (["time", "min", "uptime_s", "framesize", "fps", "host_fps", "kbps", "p50_us", "p99_us",
+            "stale", "send_err", "offline", "fb_ovf", "fbq_ovf", "no_eoi", "disc", "rssi"]
+           + [f"{c}_{f}" for c in HEAP_CLASSES for f in HEAP_FIELDS]
+           + ["stack_min", "stack_min_task", "events"])
+
+
+class Soak:
+    """服务器与扰动计划：接收线程处理连接，主线程按分钟执行扰动"""
+
+    def __init__(self, args: argparse.Namespace):
+        self.args = args
+        self.lock = threading.Lock()
+        self.stop = threading.Event()
+        self.listener: Optional[socket.socket] = None
+        self.conn: Optional[socket.socket] = None
+        self.down_until = 0.0  # 重启服务器期间不监听
+        self.framesize = -1  # 最近一次下发的分辨率，-1 为设备启动配置
+        self.host_frames = 0
+        self.host_ts = time.time()
+        self.events: List[str] = []  # 上一行之后发生的扰动
+        self.rows: List[Dict[str, object]] = []
+        self.file = open(args.csv, "w", newline="", encoding="utf-8")
+        self.writer = csv.DictWriter(self.file, fieldnames=COLUMNS)
+        self.writer.writeheader()
+
+    def event(self, text: str) -> None:
+        print(f"[SOAK] {time.strftime('%H:%M:%S')} {text}")
+        with self.lock:
+            self.events.append(text)
+
+    # ---------------- 接收 ----------------
+    def on_stats(self, _hdr: FrameHeader, text: str) -> None:
+        if not text.startswith("SOAK ") or self.stop.is_set():
+            return
+        try:
+            rec = json.loads(text[5:])
+        except ValueError:
+            print(f"[WARN] 无法解析：{text.strip()}")
+            return
+        now = time.time()
+        with self.lock:
+            host_fps = self.host_frames / max(now - self.host_ts, 1e-3)
+            self.host_frames = 0
+            self.host_ts = now
+            events = ";".join(self.events)
+            self.events.clear()
+        row = {k: rec.get(k, 0) for k in COLUMNS if k in rec}
+        row.update(time=time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(now)), framesize=self.framesize,
+                   host_fps=round(host_fps, 2), events=events)
+        for c in HEAP_CLASSES:
+            for f in HEAP_FIELDS:
+                row[f"{c}_{f}"] = rec.get("heap", {}).get(c, {}).get(f, "")
+        stack = rec.get("stack", {})
+        if stack:
+            task = min(stack, key=stack.get)
+            row.update(stack_min=stack[task], stack_min_task=task)
+        self.rows.append(row)
+        self.writer.writerow(row)
+        self.file.flush()
+        print(f"[SOAK] min {row['min']}: {row['fps']} fps {row['kbps']} kbps p99 {row['p99_us']} us, "
+              f"psram largest {row['psram_largest']}, dram free {row['dram_free']}, stack min {row.get('stack_min')}"
+              + (f", events {events}" if events else ""))
+
+    def serve(self) -> None:
+        while not self.stop.is_set():
+            if time.time() < self.down_until:
+                time.sleep(0.5)
+                continue
+            if self.listener is None:
+                s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+                s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+                s.bind((self.args.host, self.args.port))
+                s.listen(1)
+                s.settimeout(1.0)
+                self.listener = s
+            try:
+                conn, addr = self.listener.accept()
+            except socket.timeout:
+                continue
+            except OSError:
+                self.listener = None  # 被重启计划关闭
+                continue
+            conn.settimeout(30.0)
+            self.conn = conn
+            self.event(f"connect {addr[0]}")
+            try:
+                if self.framesize >= 0:
+                    conn.sendall(build_command(CTRL_CMD_SET_FRAMESIZE, self.framesize))  # 重连后沿用当前分辨率
+                for _hdr, _frame in iter_frames(conn, on_stats=self.on_stats, zero_copy=True):
+                    with self.lock:
+                        self.host_frames += 1
+                    if self.stop.is_set():
+                        break
+            except (OSError, ProtocolError) as e:
+                self.event(f"disconnect ({e.__class__.__name__})")
+            else:
+                self.event("disconnect")
+            finally:
+                self.conn = None
+                conn.close()
+
+    # ---------------- 扰动 ----------------
+    def restart_server(self) -> None:
+        self.event(f"server restart ({self.args.restart_down:.0f} s down)")
+        self.down_until = time.time() + self.args.restart_down
+        for s in (self.conn, self.listener):
+            if s is not None:
+                try:
+                    s.shutdown(socket.SHUT_RDWR)
+                except OSError:
+                    pass
+                s.close()
+        self.listener = None
+
+    def switch_framesize(self, fs: int) -> None:
+        self.framesize = fs
+        self.event(f"framesize {fs}")
+        conn = self.conn
+        if conn is not None:
+            try:
+                conn.sendall(build_command(CTRL_CMD_SET_FRAMESIZE, fs))
+            except OSError:
+                pass  # 重连时再下发
+
+    def cycle_ap(self) -> None:
+        self.event("ap off")
+        subprocess.run(self.args.ap_off_cmd, shell=True)
+        time.sleep(self.args.ap_down)
+        subprocess.run(self.args.ap_on_cmd, shell=True)
+        self.event("ap on")
+
+    def run(self) -> None:
+        threading.Thread(target=self.serve, daemon=True).start()
+        sizes = [int(x) for x in self.args.framesizes.split(",") if x.strip()] if self.args.framesizes else []
+        start = time.time()
+        end = start + self.args.hours * 3600
+        minute = 0
+        print(f"[SOAK] 监听 {self.args.host}:{self.args.port}，运行 {self.args.hours} 小时，写入 {self.args.csv}")
+        while time.time() < end:
+            minute += 1
+            time.sleep(max(0.0, min(start + minute * 60, end) - time.time()))
+            if time.time() >= end:
+                break
+            a = self.args
+            if a.restart_every and minute % a.restart_every == 0:
+                self.restart_server()
+            if sizes and a.framesize_every and minute % a.framesize_every == 0:
+                self.switch_framesize(sizes[(minute // a.framesize_every - 1) % len(sizes)])
+            if a.ap_off_cmd and a.ap_on_cmd and a.ap_every and minute % a.ap_every == 0:
+                self.cycle_ap()
+        self.stop.set()
+        self.restart_server()
+        self.file.close()
+
+
+# ---------------- 判定 ----------------
+def load_rows(path: str) -> List[Dict[str, object]]:
+    rows = []
+    with open(path, newline="", encoding="utf-8") as f:
+        for r in csv.DictReader(f):
+            for k, v in r.items():
+                if k not in ("time", "stack_min_task", "events") and v not in ("", None):
+                    r[k] = float(v)
+            rows.append(r)
+    return rows
+
+
+def slope_per_hour(xs: List[float], ys: List[float]) -> float:
+    """最小二乘斜率（ys 单位 / 小时），xs 为分钟"""
+    n = len(xs)
+    if n < 2:
+        return 0.0
+    mx = sum(xs) / n
+    my = sum(ys) / n
+    den = sum((x - mx) ** 2 for x in xs)
+    return 60.0 * sum((x - mx) * (y - my) for x, y in zip(xs, ys)) / den if den else 0.0
+
+
+def analyze(rows: List[Dict[str, object]], args: argparse.Namespace) -> Dict[str, object]:
+    """返回报告：各项测量值与超限项（failures 为空表示通过）"""
+    failures = []
+    report: Dict[str, object] = {"minutes": len(rows)}
+    for prev, cur in zip(rows, rows[1:]):
+        if cur["uptime_s"] < prev["uptime_s"]:
+            failures.append(f"device rebooted before minute {int(cur['min'])} ({cur['time']})")
+            break
+    steady = [r for r in rows if r["min"] > args.warmup]
+    if len(steady) < 2:
+        report["failures"] = failures + ["not enough samples after warmup"]
+        return report
+    quiet = [cur for prev, cur in zip(steady, steady[1:]) if not prev["events"] and not cur["events"]]
+
+    # 帧率：同一分辨率下，最后 --window 分钟相对最初 --window 分钟
+    fps_drop = {}
+    for fs in sorted({r["framesize"] for r in quiet}):
+        sel = [r["fps"] for r in quiet if r["framesize"] == fs]
+        n = min(args.window, len(sel) // 2)
+        if n < 2:
+            continue
+        first = sum(sel[:n]) / n
+        last = sum(sel[-n:]) / n
+        drop = 100.0 * (first - last) / first if first > 0 else 0.0
+        fps_drop[int(fs)] = {"first": round(first, 2), "last": round(last, 2), "drop_pct": round(drop, 1)}
+        if drop > args.max_fps_drop:
+            failures.append(f"framesize {int(fs)}: fps {first:.2f} -> {last:.2f} (-{drop:.1f}% > {args.max_fps_drop}%)")
+    report["fps"] = fps_drop
+
+    # 内存：剩余与最大空闲块的趋势，最小剩余的下降，分配失败次数
+    heap = {}
+    xs = [r["min"] for r in quiet]
+    for c in HEAP_CLASSES:
+        if steady[0].get(f"{c}_free") in ("", None):
+            continue
+        h = {f: round(slope_per_hour(xs, [r[f"{c}_{f}"] for r in quiet]), 1) for f in ("free", "largest")}
+        h["min_free_drop"] = int(steady[0][f"{c}_min_free"] - steady[-1][f"{c}_min_free"])
+        h["new_fails"] = int(steady[-1][f"{c}_fails"] - steady[0][f"{c}_fails"])
+        heap[c] = h
+        for f in ("free", "largest"):
+            if -h[f] > args.max_heap_slope:
+                failures.append(f"{c} {f} falls {-h[f]:.0f} B/h (> {args.max_heap_slope})")
+        if h["min_free_drop"] > args.max_min_free_drop:
+            failures.append(f"{c} min_free dropped {h['min_free_drop']} B after warmup (> {args.max_min_free_drop})")
+        if h["new_fails"] > 0:
+            failures.append(f"{c}: {h['new_fails']} allocation failures after warmup")
+    report["heap_slope_bytes_per_hour"] = heap
+
+    # 栈余量与驱动丢帧
+    stacks = [r for r in rows if r.get("stack_min") not in ("", None)]
+    if stacks:
+        worst = min(stacks, key=lambda r: r["stack_min"])
+        report["stack_min"] = {"task": worst["stack_min_task"], "bytes": int(worst["stack_min"])}
+        if worst["stack_min"] < args.min_stack:
+            failures.append(f"task {worst['stack_min_task']} stack headroom {int(worst['stack_min'])} B (< {args.min_stack})")
+    hours = len(steady) / 60.0
+    ovf = sum(r["fb_ovf"] + r["fbq_ovf"] + r["no_eoi"] for r in steady) / hours
+    report["driver_drops_per_hour"] = round(ovf, 1)
+    if ovf > args.max_driver_drops:
+        failures.append(f"driver drops {ovf:.1f}/h (> {args.max_driver_drops})")
+    report["disconnects"] = int(steady[-1]["disc"] - steady[0]["disc"])
+    report["failures"] = failures
+    return report
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="ESP32 camera soak test server")
+    parser.add_argument("--host", default="0.0.0.0", help="监听地址，默认 0.0.0.0")
+    parser.add_argument("--port", type=int, default=8000, help="监听端口，需与固件一致，默认 8000")
+    parser.add_argument("--hours", type=float, default=8.0, help="运行时间（小时）")
+    parser.add_argument("--csv", default="soak.csv", help="每分钟一行的输出文件")
+    parser.add_argument("--report", default="soak_report.json", help="判定结果")
+    parser.add_argument("--analyze", default=None, help="不运行，只对已有的 CSV 判定")
+    parser.add_argument("--restart-every", type=int, default=0, help="每隔多少分钟重启服务器，0 不重启")
+    parser.add_argument("--restart-down", type=float, default=20.0, help="重启时停止监听的秒数")
+    parser.add_argument("--framesizes", default="", help="依次切换的 framesize_t 数值，逗号分隔（如 6,10,11）")
+    parser.add_argument("--framesize-every", type=int, default=30, help="切换分辨率的间隔（分钟）")
+    parser.add_argument("--ap-off-cmd", default=None, help="关闭 AP 的命令")
+    parser.add_argument("--ap-on-cmd", default=None, help="打开 AP 的命令")
+    parser.add_argument("--ap-every", type=int, default=0, help="每隔多少分钟关闭一次 AP，0 不关闭")
+    parser.add_argument("--ap-down", type=float, default=60.0, help="AP 关闭的秒数")
+    parser.add_argument("--warmup", type=int, default=10, help="不参与判定的预热分钟数")
+    parser.add_argument("--window", type=int, default=60, help="帧率比较的首尾窗口（分钟）")
+    parser.add_argument("--max-fps-drop", type=float, default=10.0, help="帧率下降上限（%%）")
+    parser.add_argument("--max-heap-slope", type=float, default=4096.0, help="剩余/最大空闲块下降趋势上限（字节/小时）")
+    parser.add_argument("--max-min-free-drop", type=int, default=16384, help="预热后最小剩余的下降上限（字节）")
+    parser.add_argument("--min-stack", type=int, default=512, help="任务栈余量下限（字节）")
+    parser.add_argument("--max-driver-drops", type=float, default=60.0, help="驱动丢帧上限（帧/小时）")
+    args = parser.parse_args()
+
+    path = args.analyze
+    if path is None:
+        soak = Soak(args)
+        try:
+            soak.run()
+        except KeyboardInterrupt:
+            print("\n[SOAK] 中断，对已记录的部分判定")
+            soak.stop.set()
+            soak.file.close()
+        path = args.csv
+    if not os.path.exists(path):
+        print(f"[ERROR] 找不到 {path}")
+        return 2
+
+    report = analyze(load_rows(path), args)
+    with open(args.report, "w", encoding="utf-8") as f:
+        json.dump(report, f, indent=2, ensure_ascii=False)
+    print(json.dumps(report, indent=2, ensure_ascii=False))
+    for text in report["failures"]:
+        print(f"[FAIL] {text}")
+    print("[SOAK] PASS" if not report["failures"] else f"[SOAK] FAIL ({len(report['failures'])})")
+    return 1 if report["failures"] else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
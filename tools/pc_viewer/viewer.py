@@ -3,26 +3,33 @@
 r"""
 TCP 服务器端 Python 显示程序
 - 在 PC 上运行，监听指定端口，等待 ESP32 连接
-- 从套接字读取连续 JPEG 帧（以 0xFFD8 开始，0xFFD9 结束）
+- 从套接字按帧头(frame_proto.py)读取 JPEG 帧，recv_into 复用接收缓冲、np.frombuffer 直接解码；兼容旧固件的裸 JPEG 流
 - 使用 OpenCV 实时解码与显示
 
 用法示例（Windows PowerShell）：
     python ./tools/pc_viewer/viewer.py --host 0.0.0.0 --port 8000
+    python ./tools/pc_viewer/viewer.py --wav audio.wav   # 同时保存设备上传的音频，标题显示音画时间差
+    python ./tools/pc_viewer/viewer.py --spool-dir spool # 保存断线期间设备缓存、重连后回填的帧
+    python ./tools/pc_viewer/viewer.py --tls-cert cert.pem --tls-key key.pem  # 固件 TLS_STREAM_EN
 
 按键：
   q  退出
+  s  请求设备回传分段时延统计（VSYNC -> DMA -> 队列 -> 发送 -> ACK）
 """
 import argparse
+import os
 import socket
+import ssl
 import sys
 import time
-from typing import Tuple
+import wave
+from typing import Optional
 
 import cv2
 import numpy as np
 
-SOI = b"\xff\xd8"  # JPEG Start Of Image
-EOI = b"\xff\xd9"  # JPEG End Of Image
+from frame_proto import (CTRL_CMD_JPEG_ABBREV, CTRL_CMD_JPEG_TILES, CTRL_CMD_STATIC_SKIP, ProtocolError, build_command,
+                         iter_frames, tls_server_context)
 
 
 def parse_args() -> argparse.Namespace:
@@ -31,54 +38,74 @@ def parse_args() -> argparse.Namespace:
     parser.add_argument("--port", type=int, default=8000, help="监听端口，需与固件一致，默认 8000")
     parser.add_argument("--window", default="ESP32 Camera", help="显示窗口标题")
     parser.add_argument("--timeout", type=float, default=10.0, help="等待连接超时（秒）")
+    parser.add_argument("--wav", default=None, help="保存音频帧到该 WAV 文件（固件 AV_AUDIO_EN）")
+    parser.add_argument("--spool-dir", default=None, help="保存回填帧（固件 FRAME_SPOOL_EN）到该目录，文件名含序号与采集时间")
+    parser.add_argument("--tls-cert", default=None, help="TLS 证书（固件 TLS_STREAM_EN），需同时指定 --tls-key")
+    parser.add_argument("--tls-key", default=None, help="TLS 证书的私钥")
     return parser.parse_args()
 
 
-def recv_images(conn: socket.socket, window: str) -> None:
-    buf = bytearray()
+class AudioSink:
+    """接收音频帧：写入 WAV，并记录最新音频时间戳（设备时钟, us）"""
+
+    def __init__(self, path: Optional[str]):
+        self.path = path
+        self.wav = None
+        self.last_end_us = None
+
+    def __call__(self, hdr, pcm: bytes) -> None:
+        rate, channels = hdr.width, max(hdr.height, 1)
+        self.last_end_us = hdr.timestamp_us + len(pcm) // (2 * channels) * 1000000 // max(rate, 1)
+        if self.path is None:
+            return
+        if self.wav is None:
+            self.wav = wave.open(self.path, "wb")
+            self.wav.setnchannels(channels)
+            self.wav.setsampwidth(2)
+            self.wav.setframerate(rate)
+        self.wav.writeframes(pcm)
+
+    def close(self) -> None:
+        if self.wav is not None:
+            self.wav.close()
+            self.wav = None
+
+
+class SpoolSink:
+    """接收回填帧（断线期间的历史帧）：不显示，按序号保存为 JPEG 文件"""
+
+    def __init__(self, path: Optional[str]):
+        self.path = path
+        self.count = 0
+        if path is not None:
+            os.makedirs(path, exist_ok=True)
+
+    def __call__(self, hdr, jpeg: bytes) -> None:
+        self.count += 1
+        if self.path is None:
+            return
+        name = f"seq{hdr.seq:08d}_{hdr.timestamp_us}us.jpg"
+        with open(os.path.join(self.path, name), "wb") as f:
+            f.write(jpeg)
+
+
+def recv_images(conn: socket.socket, window: str, audio: "AudioSink", spool: "SpoolSink") -> None:
     last_ts = time.time()
     frames = 0
+    unchanged = [0]
+
+    def on_unchanged(hdr) -> None:
+        unchanged[0] += 1
+        cv2.waitKey(1)  # 画面未变化期间窗口仍响应
 
     conn.settimeout(5.0)
-    while True:
-        try:
-            data = conn.recv(4096)
-            if not data:
-                print("[INFO] 对端关闭连接")
-                break
-            buf.extend(data)
-        except socket.timeout:
-            # 超时不致命，继续等待
-            continue
-        except ConnectionResetError:
-            print("[WARN] 连接被重置")
-            break
-        except Exception as e:
-            print(f"[ERROR] 接收失败: {e}")
-            break
-
-        # 丢弃 SOI 之前的冗余
-        start = buf.find(SOI)
-        if start > 0:
-            del buf[:start]
-        elif start < 0 and len(buf) > 1024 * 1024:
-            # 避免内存无限增长
-            buf.clear()
-            continue
-
-        # 可能存在多个完整帧，尽量逐个消费
-        while True:
-            start = buf.find(SOI)
-            if start < 0:
-                break
-            end = buf.find(EOI, start + 2)
-            if end < 0:
-                break
-            end += 2  # 包含 EOI
-            frame = bytes(buf[start:end])
-            del buf[:end]
-
-            # 解码并显示
+    try:
+        conn.sendall(build_command(CTRL_CMD_JPEG_ABBREV, 1))  # 表头不变的帧省略表头，iter_frames 负责补回
+        conn.sendall(build_command(CTRL_CMD_JPEG_TILES, 1, seq=1))  # 静态场景只发送变化的分块，iter_frames 负责合成
+        conn.sendall(build_command(CTRL_CMD_STATIC_SKIP, 3000, seq=2))  # 画面未变化时只发占位帧，至少每 3 秒一帧图像
+        for hdr, frame in iter_frames(conn, on_audio=audio, on_spool=spool, on_unchanged=on_unchanged,
+                                      zero_copy=True, tiles=True):
+            # 解码并显示（frame 为接收缓冲的视图，imdecode 之后即可被下一帧覆盖）
             np_frame = np.frombuffer(frame, dtype=np.uint8)
             img = cv2.imdecode(np_frame, cv2.IMREAD_COLOR)
             if img is None:
@@ -91,15 +118,34 @@ def recv_images(conn: socket.socket, window: str) -> None:
             now = time.time()
             if now - last_ts >= 1.0:
                 fps = frames / (now - last_ts)
-                cv2.setWindowTitle(window, f"ESP32 Camera - {fps:.1f} FPS")
+                seq = f" seq={hdr.seq}" if hdr is not None else ""
+                if hdr is not None and audio.last_end_us is not None:
+                    # 正值: 图像领先于已收到的音频
+                    seq += f" av={(hdr.timestamp_us - audio.last_end_us) / 1000:.0f}ms"
+                if spool.count:
+                    seq += f" backfilled={spool.count}"
+                if unchanged[0]:
+                    seq += f" unchanged={unchanged[0]}"
+                cv2.setWindowTitle(window, f"ESP32 Camera - {fps:.1f} FPS{seq}")
                 frames = 0
                 last_ts = now
 
-            if cv2.waitKey(1) & 0xFF == ord('q'):
+            key = cv2.waitKey(1) & 0xFF
+            if key == ord('q'):
                 return
-
-
-def run_server(host: str, port: int, window: str, timeout: float) -> int:
+            if key == ord('s'):
+                conn.sendall(b"stats\n")  # 请求设备回传分段时延统计
+        print("[INFO] 对端关闭连接")
+    except ProtocolError as e:
+        print(f"[WARN] 帧头错误，断开连接: {e}")
+    except ConnectionResetError:
+        print("[WARN] 连接被重置")
+    except Exception as e:
+        print(f"[ERROR] 接收失败: {e}")
+
+
+def run_server(host: str, port: int, window: str, timeout: float, wav: Optional[str] = None,
+               spool_dir: Optional[str] = None, tls_cert: Optional[str] = None, tls_key: Optional[str] = None) -> int:
     def _get_default_iface_ip() -> str:
         try:
             tmp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
@@ -151,11 +197,22 @@ def run_server(host: str, port: int, window: str, timeout: float) -> int:
             print("[ERROR] 等待连接超时，请确认 ESP32 端已将 IP_ADDR 指向本机，并允许出站连接")
             return 2
 
+        if tls_cert:
+            try:
+                conn = tls_server_context(tls_cert, tls_key).wrap_socket(conn, server_side=True)
+            except (ssl.SSLError, OSError) as e:
+                print(f"[ERROR] TLS 握手失败：{e}")
+                conn.close()
+                return 2
+
         print(f"[INFO] 已连接：{addr}")
+        audio = AudioSink(wav)
+        spool = SpoolSink(spool_dir)
         with conn:
             try:
-                recv_images(conn, window)
+                recv_images(conn, window, audio, spool)
             finally:
+                audio.close()
                 cv2.destroyAllWindows()
     return 0
 
@@ -163,7 +220,8 @@ def run_server(host: str, port: int, window: str, timeout: float) -> int:
 def main() -> int:
     args = parse_args()
     try:
-        return run_server(args.host, args.port, args.window, args.timeout)
+        return run_server(args.host, args.port, args.window, args.timeout, args.wav, args.spool_dir,
+                          args.tls_cert, args.tls_key)
     except KeyboardInterrupt:
         print("\n[INFO] 已中断")
         return 0
@@ -5,6 +5,10 @@ ESP32 WiFi摄像头Web显示程序
 - 基于Flask的Web服务器，在浏览器中显示摄像头画面
 - 从TCP连接接收ESP32发送的JPEG图像数据
 - 使用MJPEG流的方式在网页上实时显示
+- 每帧只解码、标注、编码一次（标注线程池），所有浏览器客户端共享同一份MJPEG数据；
+  关闭标注（--no-annotate）时设备的JPEG原样转发，服务器CPU占用与观看人数无关
+- --mp：标注放在独立的分析进程中，接收/HTTP 进程与分析进程经共享内存帧环（frame_ring.py）传帧，
+  帧不经 pickle，两边的解释器不再争用同一个 GIL
 
 用法示例：
     python web_camera_viewer.py --host 0.0.0.0 --port 8000 --web-port 5000
@@ -14,25 +18,56 @@ ESP32 WiFi摄像头Web显示程序
 """
 
 import argparse
+import multiprocessing
+import queue
 import socket
 import sys
 import time
 import threading
-from typing import Optional
-from queue import Queue, Empty
-import io
+from concurrent.futures import ThreadPoolExecutor
+from typing import Optional, Tuple
 
 from flask import Flask, render_template_string, Response, jsonify
 import cv2
 import numpy as np
 
-SOI = b"\xff\xd8"  # JPEG Start Of Image
-EOI = b"\xff\xd9"  # JPEG End Of Image
+from frame_proto import CTRL_CMD_DETECT, ProtocolError, build_command, iter_frames
+from frame_ring import FrameRing
+from jpeg_decode import DECODE_BACKENDS, DECODE_SCALES, JpegDecoder
 
-# 全局变量用于存储最新的图像帧
-latest_frame = None
-frame_lock = threading.Lock()
-frame_queue = Queue(maxsize=10)  # 限制队列大小避免内存溢出
+class FrameChannel:
+    """最新一帧的发布槽：写入方覆盖，读取方按版本号等待新帧（不排队，慢客户端自动跳帧）"""
+
+    def __init__(self):
+        self._cond = threading.Condition()
+        self._version = 0
+        self._data: Optional[bytes] = None
+
+    def publish(self, data: bytes) -> None:
+        with self._cond:
+            self._data = data
+            self._version += 1
+            self._cond.notify_all()
+
+    def wait(self, version: int, timeout: float) -> Tuple[int, Optional[bytes]]:
+        """等待版本号大于 version 的帧，超时返回 (version, None)"""
+        with self._cond:
+            if not self._cond.wait_for(lambda: self._version > version, timeout):
+                return version, None
+            return self._version, self._data
+
+
+def _mjpeg_part(jpeg: bytes) -> bytes:
+    return b'--frame\r\nContent-Type: image/jpeg\r\n\r\n' + jpeg + b'\r\n'
+
+
+raw_channel = FrameChannel()  # 设备上传的原始JPEG（--mp 时为共享内存帧环）
+out_channel = FrameChannel()  # 发给浏览器的MJPEG分段（已标注并编码一次，或原样转发；--mp 时为共享内存帧环）
+annotate_enabled = True
+RING_SLOTS = 8  # --mp 帧环槽位数
+RING_SLOT_SIZE = 2 * 1024 * 1024  # --mp 帧环每槽位字节数，更大的帧丢弃
+detect_queue = None  # --mp 时接收进程把设备端检测结果经此队列交给分析进程
+jpeg_decoder: Optional[JpegDecoder] = None  # 标注用的解码后端，启动时按 --decoder/--decode-scale 创建
 
 # =============== 人脸检测 / 识别 ===============
 face_lock = threading.Lock()
@@ -40,7 +75,9 @@ face_db = {}  # face_id -> {id, embedding, first_seen, last_seen, seen_count, th
 next_face_id = 1
 face_enabled = True
 face_cascade = None
-_face_frame_counter = 0
+device_detect_mode = 1  # CTRL_CMD_DETECT 参数：0 不用设备端检测，1 上传检测元数据，2 同时只在有人时上传图像
+device_faces = None  # (接收时间, 被检测帧宽, 高, [(x, y, w, h, score), ...])，设备端检测结果
+DEVICE_FACES_FRESH_S = 1.0  # 设备端结果在该时间内有效，期间不在PC上运行 Haar 检测
 
 def _init_face_detector():
     global face_cascade, face_enabled
@@ -69,22 +106,64 @@ def _compute_embedding(gray_roi: np.ndarray) -> Optional[np.ndarray]:
     vec /= norm
     return vec
 
+class FaceIndex:
+    """人脸特征索引：所有特征存为一个连续的 float32 矩阵，匹配时一次矩阵乘法算出到全部特征的距离。
+    快照 (ids, 矩阵, 各行平方和) 只读，匹配无锁地取当前快照；新增与更新在写锁下复制出新快照后整体替换（写时复制），
+    匹配不会阻塞写入。已有人脸的特征每次检测都会滑动更新，这类更新先记下，至多每 flush_s 秒合并进一次快照。"""
+
+    def __init__(self, flush_s: float = 1.0):
+        self._lock = threading.Lock()
+        self._snap = (np.zeros(0, dtype=np.int64), None, None)
+        self._pending = {}  # face_id -> 尚未合并进快照的特征
+        self._flush_s = flush_s
+        self._flush_at = 0.0
+
+    def match(self, embedding: np.ndarray, threshold: float) -> Optional[int]:
+        """返回欧氏距离最小且不超过 threshold 的 face_id"""
+        ids, mat, sq = self._snap
+        if not len(ids) or mat.shape[1] != embedding.shape[0]:
+            return None
+        d2 = sq - 2.0 * (mat @ embedding) + float(embedding @ embedding)  # |a-b|^2 = |a|^2 - 2ab + |b|^2
+        best = int(np.argmin(d2))
+        return int(ids[best]) if d2[best] <= threshold * threshold else None
+
+    def add(self, fid: int, embedding: np.ndarray) -> None:
+        with self._lock:
+            ids, mat, sq = self._snap
+            row = embedding.astype(np.float32)[None, :]
+            if mat is None:
+                mat, sq, ids = row, np.zeros(0, dtype=np.float32), np.zeros(0, dtype=np.int64)
+            else:
+                mat = np.concatenate((mat, row))
+            self._snap = (np.append(ids, fid), mat, np.append(sq, np.float32(row[0] @ row[0])))
+
+    def update(self, fid: int, embedding: np.ndarray) -> None:
+        with self._lock:
+            self._pending[fid] = embedding
+            now = time.monotonic()
+            if now < self._flush_at:
+                return
+            self._flush_at = now + self._flush_s
+            ids, mat, sq = self._snap
+            if mat is None:
+                return
+            mat = mat.copy()
+            sq = sq.copy()
+            rows = {int(f): i for i, f in enumerate(ids)}
+            for f, emb in self._pending.items():
+                i = rows.get(f)
+                if i is not None:
+                    mat[i] = emb
+                    sq[i] = float(mat[i] @ mat[i])
+            self._pending.clear()
+            self._snap = (ids, mat, sq)
+
+
+face_index = FaceIndex()
+
 def _match_face(embedding: np.ndarray, threshold: float = 0.36) -> Optional[int]:
-    """在face_db中查找最相近的人脸，欧氏距离小于阈值则视为同一人。"""
-    with face_lock:
-        best_id = None
-        best_dist = 1e9
-        for fid, info in face_db.items():
-            emb = info.get('embedding')
-            if emb is None or emb.shape != embedding.shape:
-                continue
-            d = np.linalg.norm(emb - embedding)
-            if d < best_dist:
-                best_dist = d
-                best_id = fid
-        if best_dist <= threshold:
-            return best_id
-        return None
+    """在人脸索引中查找最相近的人脸，欧氏距离小于阈值则视为同一人（不持有 face_lock）。"""
+    return face_index.match(embedding, threshold)
 
 def _make_thumbnail(bgr: np.ndarray, size: int = 112) -> Optional[bytes]:
     try:
@@ -117,10 +196,12 @@ def _update_face_db(face_img_bgr: np.ndarray, gray_roi: np.ndarray, embedding: n
                 'seen_count': 1,
                 'thumb_jpeg': thumb,
             }
+            face_index.add(fid, embedding)
         else:
             info = face_db.get(fid)
             if info is not None:
                 info['embedding'] = 0.8 * info['embedding'] + 0.2 * embedding
+                face_index.update(fid, info['embedding'])
                 info['last_seen'] = now
                 info['seen_count'] += 1
                 if info['seen_count'] % 20 == 0 and thumb is not None:
@@ -723,6 +804,16 @@ def parse_args() -> argparse.Namespace:
     parser.add_argument("--port", type=int, default=8000, help="TCP监听端口，需与ESP32固件一致，默认 8000")
     parser.add_argument("--web-port", type=int, default=5000, help="Web服务端口，默认 5000")
     parser.add_argument("--timeout", type=float, default=10.0, help="等待连接超时（秒）")
+    parser.add_argument("--workers", type=int, default=2, help="标注线程数（解码+人脸检测+编码），默认 2")
+    parser.add_argument("--no-annotate", action="store_true", help="关闭人脸标注，设备的JPEG原样转发")
+    parser.add_argument("--decoder", choices=DECODE_BACKENDS, default="auto",
+                        help="JPEG解码后端：turbojpeg（PyTurboJPEG）、cv2，auto 优先 turbojpeg（默认）")
+    parser.add_argument("--decode-scale", type=int, choices=DECODE_SCALES, default=1,
+                        help="标注时按 1/N 尺寸解码（DCT 域缩小，输出画面同样缩小），默认 1")
+    parser.add_argument("--mp", action="store_true",
+                        help="人脸标注在独立进程中运行，与接收/HTTP 进程经共享内存帧环传帧")
+    parser.add_argument("--device-detect", type=int, choices=(0, 1, 2), default=1,
+                        help="设备端人脸检测：0 关闭，1 使用设备上传的人脸框（默认），2 同时只在有人时上传图像")
     return parser.parse_args()
 
 
@@ -778,145 +869,301 @@ def recv_images_thread(host: str, port: int, timeout: float) -> None:
             continue
 
 
+def _on_device_detect(hdr, boxes: list) -> None:
+    """设备端人脸检测结果（元数据帧）"""
+    global device_faces
+    device_faces = (time.time(), hdr.width, hdr.height, boxes)
+    if detect_queue is not None:
+        try:
+            detect_queue.put_nowait(device_faces)
+        except queue.Full:
+            pass
+
+
 def recv_images_from_connection(conn: socket.socket) -> None:
     """从TCP连接接收图像数据"""
-    global latest_frame
-    
-    buf = bytearray()
     conn.settimeout(5.0)
-    
-    while True:
-        try:
-            data = conn.recv(4096)
-            if not data:
-                print("[INFO] ESP32断开连接")
-                break
-            buf.extend(data)
-        except socket.timeout:
-            continue
-        except Exception as e:
-            print(f"[ERROR] 接收数据失败: {e}")
-            break
-
-        # 查找JPEG帧边界
-        start = buf.find(SOI)
-        if start > 0:
-            del buf[:start]
-        elif start < 0 and len(buf) > 1024 * 1024:
-            buf.clear()
-            continue
 
-        # 提取完整的JPEG帧
-        while True:
-            start = buf.find(SOI)
-            if start < 0:
-                break
-            end = buf.find(EOI, start + 2)
-            if end < 0:
-                break
-            end += 2
-            
-            frame_data = bytes(buf[start:end])
-            del buf[:end]
-            
-            # 将帧数据放入队列
-            try:
-                frame_queue.put_nowait(frame_data)
-            except:
-                # 队列满时丢弃旧帧
-                try:
-                    frame_queue.get_nowait()
-                    frame_queue.put_nowait(frame_data)
-                except Empty:
-                    pass
+    try:
+        if device_detect_mode:
+            conn.sendall(build_command(CTRL_CMD_DETECT, device_detect_mode))  # 固件未使能检测时应答 unsupported，照常在PC上检测
+        # 写入帧环时直接从接收缓冲拷入共享内存
+        for _hdr, frame_data in iter_frames(conn, on_detect=_on_device_detect,
+                                            zero_copy=isinstance(raw_channel, FrameRing)):
+            if annotate_enabled and face_enabled:
+                raw_channel.publish(frame_data)  # 交给标注线程池
+            else:
+                out_channel.publish(_mjpeg_part(frame_data))  # 原样转发
+        print("[INFO] ESP32断开连接")
+    except ProtocolError as e:
+        print(f"[WARN] 帧头错误，断开连接: {e}")
+    except Exception as e:
+        print(f"[ERROR] 接收数据失败: {e}")
+
 
+# 检测/跟踪分离：每 DETECT_EVERY_N 帧（或跟踪丢失后）做一次完整检测，其间用模板相关跟踪已有人脸，
+# 只有新出现的轨迹才计算特征并查询人脸库
+DETECT_EVERY_N = 10  # 完整检测的间隔帧数
+TRACK_SCALE = 0.5  # 跟踪在缩小的灰度图上进行
+TRACK_SEARCH = 0.5  # 搜索窗口在框的每边扩展框尺寸的该比例
+TRACK_MIN_SCORE = 0.55  # 归一化相关得分低于该值视为跟踪丢失，下一帧重新检测
+TRACK_IOU_MATCH = 0.3  # 检测框与轨迹框的交并比不低于该值视为同一张脸
+TRACK_MAX_MISSES = 2  # 连续这么多次完整检测都没有对上的轨迹删除
 
-def _annotate_and_track(frame_bgr: np.ndarray) -> np.ndarray:
-    """对图像做人脸检测、识别与标注，返回标注后的BGR图。"""
-    global _face_frame_counter
-    h, w = frame_bgr.shape[:2]
+_track_lock = threading.Lock()  # 标注线程池中的多个线程共用轨迹
+_tracks = []  # [{'fid', 'box': (x, y, w, h), 'tmpl': 缩小灰度图中的模板, 'misses'}]
+_track_seq = 0  # 最近一次更新轨迹的帧序号，更早的帧只按当前轨迹标注
+_track_force = True  # 下一帧做完整检测
 
+
+def _iou(a, b) -> float:
+    ax1, ay1 = a[0] + a[2], a[1] + a[3]
+    bx1, by1 = b[0] + b[2], b[1] + b[3]
+    iw = max(0, min(ax1, bx1) - max(a[0], b[0]))
+    ih = max(0, min(ay1, by1) - max(a[1], b[1]))
+    inter = iw * ih
+    union = a[2] * a[3] + b[2] * b[3] - inter
+    return inter / union if union > 0 else 0.0
+
+
+def _detect_faces(gray: np.ndarray, w: int, h: int) -> list:
+    """完整检测：优先用设备端上传的人脸框，否则在PC上运行 Haar 检测"""
+    device = device_faces
+    if device is not None and time.time() - device[0] < DEVICE_FACES_FRESH_S and device[1] and device[2]:
+        sx = w / device[1]; sy = h / device[2]
+        return [(int(x*sx), int(y*sy), int(ww*sx), int(hh*sy)) for (x, y, ww, hh, _score) in device[3]]
+    rects_out = []
+    try:
+        scale = 0.6
+        small = cv2.resize(gray, (max(1, int(w*scale)), max(1, int(h*scale))), interpolation=cv2.INTER_AREA)
+        rects = face_cascade.detectMultiScale(small, scaleFactor=1.15, minNeighbors=5, minSize=(50, 50))
+        for (x, y, ww, hh) in rects:
+            X = int(x/scale); Y = int(y/scale); W = int(ww/scale); H = int(hh/scale)
+            pad = int(0.1 * max(W, H))
+            X0 = max(0, X - pad); Y0 = max(0, Y - pad)
+            X1 = min(w, X + W + pad); Y1 = min(h, Y + H + pad)
+            rects_out.append((X0, Y0, X1 - X0, Y1 - Y0))
+    except Exception:
+        return []
+    return rects_out
+
+
+def _track_template(small: np.ndarray, box) -> Optional[np.ndarray]:
+    x, y, ww, hh = (int(v * TRACK_SCALE) for v in box)
+    tmpl = small[y:y+hh, x:x+ww]
+    return tmpl.copy() if tmpl.shape[0] >= 8 and tmpl.shape[1] >= 8 else None
+
+
+def _track_step(small: np.ndarray, track: dict) -> bool:
+    """在上一位置附近的搜索窗口内做归一化相关匹配，更新轨迹位置；得分过低返回 False"""
+    tmpl = track['tmpl']
+    if tmpl is None:
+        return False
+    th, tw = tmpl.shape[:2]
+    sh, sw = small.shape[:2]
+    x, y = int(track['box'][0] * TRACK_SCALE), int(track['box'][1] * TRACK_SCALE)
+    mx, my = int(tw * TRACK_SEARCH), int(th * TRACK_SEARCH)
+    x0 = max(0, x - mx); y0 = max(0, y - my)
+    x1 = min(sw, x + tw + mx); y1 = min(sh, y + th + my)
+    if x1 - x0 < tw or y1 - y0 < th:
+        return False
+    res = cv2.matchTemplate(small[y0:y1, x0:x1], tmpl, cv2.TM_CCOEFF_NORMED)
+    _, score, _, loc = cv2.minMaxLoc(res)
+    if score < TRACK_MIN_SCORE:
+        return False
+    bx, by, bw, bh = track['box']
+    track['box'] = (int((x0 + loc[0]) / TRACK_SCALE), int((y0 + loc[1]) / TRACK_SCALE), bw, bh)
+    return True
+
+
+def _new_track(frame_bgr: np.ndarray, gray: np.ndarray, small: np.ndarray, box) -> Optional[dict]:
+    """新出现的人脸：计算特征、查询/更新人脸库，建立轨迹"""
+    x, y, ww, hh = box
+    roi_gray = gray[y:y+hh, x:x+ww]
+    emb = _compute_embedding(roi_gray)
+    if emb is None:
+        return None
+    fid = _update_face_db(frame_bgr[y:y+hh, x:x+ww], roi_gray, emb)
+    return {'fid': fid, 'box': box, 'tmpl': _track_template(small, box), 'misses': 0}
+
+
+def _update_tracks(frame_bgr: np.ndarray, gray: np.ndarray, seq: int) -> list:
+    """按帧序号推进检测/跟踪，返回本帧的 [(face_id, box)]"""
+    global _tracks, _track_seq, _track_force
+    h, w = gray.shape[:2]
+    with _track_lock:
+        if seq <= _track_seq:
+            return [(t['fid'], t['box']) for t in _tracks]  # 线程池中迟到的旧帧
+        detect = _track_force or (seq // DETECT_EVERY_N) != (_track_seq // DETECT_EVERY_N)
+        _track_seq = seq
+        small = cv2.resize(gray, (max(1, int(w*TRACK_SCALE)), max(1, int(h*TRACK_SCALE))), interpolation=cv2.INTER_AREA)
+
+        if not detect:
+            kept = [t for t in _tracks if _track_step(small, t)]
+            _track_force = len(kept) != len(_tracks)
+            _tracks = kept
+            return [(t['fid'], t['box']) for t in _tracks]
+
+        _track_force = False
+        for t in _tracks:
+            _track_step(small, t)  # 先推进到本帧位置再与检测结果关联
+        matched = set()
+        for box in _detect_faces(gray, w, h):
+            best, best_iou = None, TRACK_IOU_MATCH
+            for i, t in enumerate(_tracks):
+                iou = _iou(box, t['box'])
+                if i not in matched and iou >= best_iou:
+                    best, best_iou = i, iou
+            if best is not None:
+                t = _tracks[best]
+                t['box'] = box
+                t['tmpl'] = _track_template(small, box)
+                t['misses'] = 0
+                matched.add(best)
+            else:
+                t = _new_track(frame_bgr, gray, small, box)
+                if t is not None:
+                    _tracks.append(t)
+                    matched.add(len(_tracks) - 1)
+        for i, t in enumerate(_tracks):
+            if i not in matched:
+                t['misses'] += 1
+        _tracks = [t for t in _tracks if t['misses'] <= TRACK_MAX_MISSES]
+        return [(t['fid'], t['box']) for t in _tracks]
+
+
+def _annotate_and_track(frame_bgr: np.ndarray, seq: int) -> np.ndarray:
+    """对图像做人脸检测/跟踪、识别与标注，返回标注后的BGR图。"""
     if not face_enabled or face_cascade is None:
         return frame_bgr
 
-    # 降频检测以降低CPU占用
-    _face_frame_counter = (_face_frame_counter + 1) % 3
-    do_detect = (_face_frame_counter == 0)
-
     try:
         gray = cv2.cvtColor(frame_bgr, cv2.COLOR_BGR2GRAY)
     except Exception:
         return frame_bgr
 
-    faces_rects = []
-    if do_detect:
-        try:
-            scale = 0.6
-            small = cv2.resize(gray, (max(1, int(w*scale)), max(1, int(h*scale))), interpolation=cv2.INTER_AREA)
-            rects = face_cascade.detectMultiScale(small, scaleFactor=1.15, minNeighbors=5, minSize=(50, 50))
-            for (x, y, ww, hh) in rects:
-                X = int(x/scale); Y = int(y/scale); W = int(ww/scale); H = int(hh/scale)
-                pad = int(0.1 * max(W, H))
-                X0 = max(0, X - pad); Y0 = max(0, Y - pad)
-                X1 = min(w, X + W + pad); Y1 = min(h, Y + H + pad)
-                faces_rects.append((X0, Y0, X1 - X0, Y1 - Y0))
-        except Exception:
-            faces_rects = []
-
-    for (x, y, ww, hh) in faces_rects:
+    for fid, (x, y, ww, hh) in _update_tracks(frame_bgr, gray, seq):
+        cv2.rectangle(frame_bgr, (x, y), (x+ww, y+hh), (0, 200, 255), 2)
+        cv2.putText(frame_bgr, f"ID {fid}", (x, max(0, y-8)), cv2.FONT_HERSHEY_SIMPLEX, 0.6, (0, 200, 255), 2, cv2.LINE_AA)
+
+    return frame_bgr
+
+def _annotate_jpeg(frame_data: bytes, seq: int) -> bytes:
+    """解码、人脸标注、重新编码一帧（seq 为帧的先后序号），返回MJPEG分段；解码失败时原样转发"""
+    frame = jpeg_decoder.decode(frame_data)
+    if isinstance(raw_channel, FrameRing) and not raw_channel.valid(seq):
+        return None  # 解码期间帧环槽位已被覆盖，结果作废
+    if frame is None:
+        return _mjpeg_part(frame_data)
+    try:
+        out_img = _annotate_and_track(frame, seq)
+    except Exception:
+        out_img = frame
+    ok, enc = cv2.imencode('.jpg', out_img, [int(cv2.IMWRITE_JPEG_QUALITY), 80])
+    return _mjpeg_part(enc.tobytes() if ok else frame_data)
+
+
+def annotate_thread(workers: int) -> None:
+    """标注调度线程：取最新原始帧交给线程池（cv2 解码/检测/编码时释放GIL），
+    在途帧数达到 workers 时等待，期间到达的帧被更新的帧替换；结果按帧的先后发布，迟到的旧帧丢弃"""
+    pool = ThreadPoolExecutor(max_workers=workers, thread_name_prefix="annotate")
+    slots = threading.Semaphore(workers)
+    order_lock = threading.Lock()
+    published = [0]
+    version = 0
+
+    def _done(seq: int, fut) -> None:
+        slots.release()
         try:
-            roi_gray = gray[y:y+hh, x:x+ww]
-            roi_bgr = frame_bgr[y:y+hh, x:x+ww]
-            emb = _compute_embedding(roi_gray)
-            if emb is None:
-                continue
-            fid = _update_face_db(roi_bgr, roi_gray, emb)
-            cv2.rectangle(frame_bgr, (x, y), (x+ww, y+hh), (0, 200, 255), 2)
-            cv2.putText(frame_bgr, f"ID {fid}", (x, max(0, y-8)), cv2.FONT_HERSHEY_SIMPLEX, 0.6, (0, 200, 255), 2, cv2.LINE_AA)
-        except Exception:
+            part = fut.result()
+        except Exception as e:
+            print(f"[WARN] 标注失败: {e}")
+            return
+        if part is None:
+            return
+        with order_lock:
+            if seq > published[0]:
+                published[0] = seq
+                out_channel.publish(part)
+
+    wait = raw_channel.wait_view if isinstance(raw_channel, FrameRing) else raw_channel.wait  # 帧环：直接解码共享内存
+    while True:
+        slots.acquire()
+        version, frame_data = wait(version, 1.0)
+        if frame_data is None:
+            slots.release()
             continue
+        fut = pool.submit(_annotate_jpeg, frame_data, version)
+        fut.add_done_callback(lambda f, seq=version: _done(seq, f))
 
-    return frame_bgr
 
-def generate_frames():
-    """生成MJPEG流帧"""
-    # 初始化人脸检测器
-    if face_enabled and (face_cascade is None):
-        _init_face_detector()
+def _export_faces_thread(faces_q) -> None:
+    """分析进程：人脸库有变化时（至多每秒一次）把不含特征的副本交给接收/HTTP 进程，供 /faces 使用"""
+    last = None
     while True:
+        time.sleep(1.0)
+        with face_lock:
+            stamp = (len(face_db), sum(info['seen_count'] for info in face_db.values()))
+            if stamp == last:
+                continue
+            snap = {fid: {k: v for k, v in info.items() if k != 'embedding'} for fid, info in face_db.items()}
         try:
-            # 从队列获取最新帧
-            frame_data = frame_queue.get(timeout=1.0)
-            # 解码、标注后再编码
-            npbuf = np.frombuffer(frame_data, dtype=np.uint8)
-            frame = cv2.imdecode(npbuf, cv2.IMREAD_COLOR)
-            if frame is None:
-                out_bytes = frame_data
-            else:
-                # 人脸检测与标注
-                try:
-                    out_img = _annotate_and_track(frame)
-                except NameError:
-                    # 尚未定义标注函数（安全兜底）
-                    out_img = frame
-                ok, enc = cv2.imencode('.jpg', out_img, [int(cv2.IMWRITE_JPEG_QUALITY), 80])
-                out_bytes = enc.tobytes() if ok else frame_data
-            # 构造MJPEG边界
-            yield (b'--frame\r\n'
-                   b'Content-Type: image/jpeg\r\n\r\n' + out_bytes + b'\r\n')
-                   
-        except Empty:
-            # 队列为空时发送空白帧
-            # 创建一个简单的"等待连接"图像
-            img = np.zeros((240, 320, 3), dtype=np.uint8)
-            cv2.putText(img, "Waiting for ESP32...", (50, 120), 
-                       cv2.FONT_HERSHEY_SIMPLEX, 0.7, (255, 255, 255), 2)
-            
-            _, buffer = cv2.imencode('.jpg', img)
-            frame_data = buffer.tobytes()
-            
-            yield (b'--frame\r\n'
-                   b'Content-Type: image/jpeg\r\n\r\n' + frame_data + b'\r\n')
+            faces_q.put_nowait(snap)
+            last = stamp
+        except queue.Full:
+            pass
+
+
+def _import_faces_thread(faces_q) -> None:
+    """接收/HTTP 进程：用分析进程导出的人脸库副本替换本地 face_db"""
+    global face_db
+    while True:
+        snap = faces_q.get()
+        with face_lock:
+            face_db = snap
+
+
+def _import_detect_thread(detect_q) -> None:
+    """分析进程：接收进程转来的设备端检测结果"""
+    global device_faces
+    while True:
+        device_faces = detect_q.get()
+
+
+def _init_decoder(backend: str, scale: int) -> None:
+    global jpeg_decoder
+    jpeg_decoder = JpegDecoder(backend, scale)
+    print(f"[INFO] JPEG解码后端: {jpeg_decoder.backend}，1/{scale} 尺寸")
+
+
+def analytics_process(raw: FrameRing, out: FrameRing, workers: int, detect_q, faces_q,
+                      decoder: str, decode_scale: int) -> None:
+    """--mp 分析进程入口：从 raw 帧环取帧标注，结果写入 out 帧环"""
+    global raw_channel, out_channel
+    raw_channel, out_channel = raw, out
+    _init_decoder(decoder, decode_scale)
+    _init_face_detector()
+    threading.Thread(target=_import_detect_thread, args=(detect_q,), daemon=True).start()
+    threading.Thread(target=_export_faces_thread, args=(faces_q,), daemon=True).start()
+    annotate_thread(workers)
+
+
+def generate_frames():
+    """生成MJPEG流帧：所有客户端共享 out_channel 中同一份已编码的数据"""
+    version = 0
+    waiting = None
+    while True:
+        version, part = out_channel.wait(version, 1.0)
+        if part is None:
+            # 1秒内没有新帧时发送"等待连接"图像
+            if waiting is None:
+                img = np.zeros((240, 320, 3), dtype=np.uint8)
+                cv2.putText(img, "Waiting for ESP32...", (50, 120),
+                           cv2.FONT_HERSHEY_SIMPLEX, 0.7, (255, 255, 255), 2)
+                _, buffer = cv2.imencode('.jpg', img)
+                waiting = _mjpeg_part(buffer.tobytes())
+            part = waiting
+        yield part
 
 
 # 创建Flask应用
@@ -966,12 +1213,29 @@ def face_thumbnail(face_id: int):
     return resp
 
 def main() -> int:
+    global annotate_enabled, device_detect_mode, raw_channel, out_channel, detect_queue
     args = parse_args()
+    annotate_enabled = not args.no_annotate
+    device_detect_mode = args.device_detect
     
     print("ESP32 WiFi摄像头Web显示程序")
     print("=" * 50)
     print(f"TCP监听地址: {args.host}:{args.port}")
     print(f"Web服务端口: {args.web_port}")
+
+    rings = []
+    if annotate_enabled and args.mp:
+        # 分析进程与本进程经共享内存帧环传帧；spawn 启动，各平台行为一致
+        ctx = multiprocessing.get_context("spawn")
+        rings = [FrameRing.create(ctx, RING_SLOTS, RING_SLOT_SIZE) for _ in range(2)]
+        detect_queue = ctx.Queue(maxsize=8)
+        faces_q = ctx.Queue(maxsize=2)
+        ctx.Process(target=analytics_process, name="analytics",
+                    args=(rings[0], rings[1], max(1, args.workers), detect_queue, faces_q,
+                          args.decoder, args.decode_scale), daemon=True).start()
+        raw_channel, out_channel = rings
+        threading.Thread(target=_import_faces_thread, args=(faces_q,), daemon=True).start()
+        print(f"分析进程: 共享内存帧环 {rings[0].name} -> {rings[1].name}")
     
     # 启动TCP图像接收线程
     tcp_thread = threading.Thread(
@@ -980,6 +1244,11 @@ def main() -> int:
         daemon=True
     )
     tcp_thread.start()
+
+    if annotate_enabled and not args.mp:
+        _init_decoder(args.decoder, args.decode_scale)
+        _init_face_detector()
+        threading.Thread(target=annotate_thread, args=(max(1, args.workers),), daemon=True).start()
     
     # 获取本机IP用于显示访问地址
     local_ip = get_default_ip()
@@ -991,7 +1260,6 @@ def main() -> int:
     
     try:
         # 启动Flask Web服务器
-        _init_face_detector()
         app.run(host='0.0.0.0', port=args.web_port, debug=False, threaded=True)
     except KeyboardInterrupt:
         print("\n[INFO] 程序已退出")
@@ -999,6 +1267,9 @@ def main() -> int:
     except Exception as e:
         print(f"[ERROR] Web服务器启动失败: {e}")
         return 1
+    finally:
+        for ring in rings:
+            ring.unlink()
 
 
 if __name__ == "__main__":
@@ -20,14 +20,13 @@ import sys
 import time
 import threading
 from typing import Optional
-from queue import Queue, Empty
+from queue import Queue, Empty, Full
 import io
 import base64
 
 from flask import Flask, render_template_string, Response
 
-SOI = b"\xff\xd8"  # JPEG Start Of Image
-EOI = b"\xff\xd9"  # JPEG End Of Image
+from frame_proto import ProtocolError, iter_frames
 
 # 全局变量用于存储最新的图像帧
 frame_queue = Queue(maxsize=10)  # 限制队列大小避免内存溢出
@@ -276,54 +275,25 @@ def recv_images_thread(host: str, port: int, timeout: float) -> None:
 
 def recv_images_from_connection(conn: socket.socket) -> None:
     """从TCP连接接收图像数据"""
-    
-    buf = bytearray()
     conn.settimeout(5.0)
-    
-    while True:
-        try:
-            data = conn.recv(4096)
-            if not data:
-                print("[INFO] ESP32断开连接")
-                break
-            buf.extend(data)
-        except socket.timeout:
-            continue
-        except Exception as e:
-            print(f"[ERROR] 接收数据失败: {e}")
-            break
 
-        # 查找JPEG帧边界
-        start = buf.find(SOI)
-        if start > 0:
-            del buf[:start]
-        elif start < 0 and len(buf) > 1024 * 1024:
-            buf.clear()
-            continue
-
-        # 提取完整的JPEG帧
-        while True:
-            start = buf.find(SOI)
-            if start < 0:
-                break
-            end = buf.find(EOI, start + 2)
-            if end < 0:
-                break
-            end += 2
-            
-            frame_data = bytes(buf[start:end])
-            del buf[:end]
-            
+    try:
+        for _hdr, frame_data in iter_frames(conn):
             # 将帧数据放入队列
             try:
                 frame_queue.put_nowait(frame_data)
-            except:
+            except Full:
                 # 队列满时丢弃旧帧
                 try:
                     frame_queue.get_nowait()
                     frame_queue.put_nowait(frame_data)
-                except Empty:
+                except (Empty, Full):
                     pass
+        print("[INFO] ESP32断开连接")
+    except ProtocolError as e:
+        print(f"[WARN] 帧头错误，断开连接: {e}")
+    except Exception as e:
+        print(f"[ERROR] 接收数据失败: {e}")
 
 
 def create_waiting_image() -> bytes:
@@ -0,0 +1,434 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+r"""
+WebRTC 网关：把设备的 JPEG 与音频转发给浏览器，适合跨公网、弱网的远程观看
+- 接入：设备 TCP 连接（帧头协议，图像 + FRAME_FLAG_AUDIO 音频，复用 ingest_server.py 的 IngestServer），
+  以及固件 LWIP_RTP_EN 发出的 RTP/JPEG（RFC 2435，UDP --rtp-port，见 rtp_jpeg.py）；两者都按对端 IP 归入同一摄像头槽位
+- 图像默认走数据通道（不解码）：浏览器建立名为 "jpeg" 的可靠有序通道，每帧原样 JPEG 分成 ≤16KB 的消息发送，
+  浏览器用 createImageBitmap 解码。发送速率由 SCTP 拥塞控制决定；通道中积压超过 --dc-buffer 字节时跳过新帧，
+  只发送最新帧，帧率随带宽自动下降，时延不随积压增长
+- --h264：每路摄像头只解码一次 JPEG（所有观看者共用解码结果），各观看者的 H.264 编码器按接收端的带宽估计（REMB）
+  调整码率。aiortc 的每个发送者各自持有编码器和带宽估计，不同带宽的观看者无法共用同一份码流，因此编码按观看者进行
+- 音频：设备的 16 位 PCM 按 Opus 编码为音频轨道（RTP 模式的设备不发送音频，此时没有音频轨道）；
+  观看者跟不上时丢弃最旧的音频包
+- 信令：本进程的 HTTP 端口（--webrtc-port）提供观看页面与 POST /offer（一次性交换 SDP，不使用 trickle ICE）；
+  跨 NAT 观看时用 --ice 指定 STUN/TURN 服务器（同时写入页面，浏览器与网关使用同一组服务器）
+- 原有的接入服务 HTTP 接口（--http-port：/cameras、MJPEG 流、录像等）保持不变
+
+依赖：pip install aiortc（PyAV 随 aiortc 安装）
+
+用法示例：
+    python ./tools/pc_viewer/webrtc_gateway.py --port 8000 --rtp-port 5004 --webrtc-port 8090
+    python ./tools/pc_viewer/webrtc_gateway.py --h264 --ice stun:stun.l.google.com:19302
+    浏览器打开 http://<网关IP>:8090/
+"""
+import argparse
+import asyncio
+import fractions
+import json
+import struct
+import sys
+import time
+from typing import Dict, List, Optional, Set
+from urllib.parse import parse_qs
+
+from frame_proto import FrameHeader, tls_server_context
+from ingest_server import CameraSlot, IngestServer
+from rtp_jpeg import RTP_JPEG_PORT, RtpJpegAssembler
+
+try:
+    import av
+    from aiortc import (MediaStreamTrack, RTCConfiguration, RTCIceServer, RTCPeerConnection, RTCRtpSender,
+                        RTCSessionDescription)
+except ImportError:
+    av = None
+    MediaStreamTrack = object
+
+DC_CHUNK = 16 * 1024  # 数据通道单条消息上限（各浏览器都支持的大小）
+DC_FRAME_HEADER = struct.Struct('>IIQ')  # 每帧第一条消息的头：帧序号、JPEG 总长、采集时间 us（设备已校时为 Unix 时间）
+AUDIO_QUEUE = 25  # 每个音频轨道最多缓存的 PCM 包数
+VIDEO_CLOCK = 90000
+
+INDEX_HTML = '''<!DOCTYPE html>
+<html><head><meta charset="utf-8"><title>ESP32 Cameras (WebRTC)</title>
+<style>body{background:#111;color:#ddd;font-family:sans-serif}canvas,video{max-width:100%;background:#000}
+#info{font-size:12px}</style></head>
+<body><select id="cam"></select> <label><input type="checkbox" id="h264" %H264%>H.264</label>
+<button id="go">观看</button> <span id="info"></span><br>
+<canvas id="canvas"></canvas><video id="video" autoplay playsinline></video><script>
+const ICE=%ICE%; let pc=null;
+async function cams(){
+  const r=await fetch('/cameras'); const list=(await r.json()).cameras; const s=document.getElementById('cam');
+  s.innerHTML=list.map(c=>`<option>${c}</option>`).join('');
+}
+async function watch(){
+  if(pc) pc.close();
+  const cam=document.getElementById('cam').value, h264=document.getElementById('h264').checked;
+  const canvas=document.getElementById('canvas'), video=document.getElementById('video'), info=document.getElementById('info');
+  pc=new RTCPeerConnection({iceServers:ICE});
+  pc.addTransceiver('audio',{direction:'recvonly'});
+  if(h264) pc.addTransceiver('video',{direction:'recvonly'});
+  pc.ontrack=e=>{video.srcObject=e.streams[0]||new MediaStream([e.track]);};
+  video.style.display=h264?'':'none'; canvas.style.display=h264?'none':'';
+  if(!h264){
+    const dc=pc.createDataChannel('jpeg',{ordered:true}); dc.binaryType='arraybuffer';
+    let parts=[], need=0, busy=false, frames=0, t0=performance.now();
+    dc.onmessage=async e=>{
+      let buf=e.data;
+      if(need===0){const v=new DataView(buf); need=v.getUint32(4); parts=[]; buf=buf.slice(16);}
+      parts.push(buf); need-=buf.byteLength;
+      if(need>0) return;
+      need=0; if(busy) return;  // 上一帧还在解码，丢弃本帧
+      busy=true;
+      try{const bmp=await createImageBitmap(new Blob(parts,{type:'image/jpeg'}));
+        canvas.width=bmp.width; canvas.height=bmp.height; canvas.getContext('2d').drawImage(bmp,0,0); bmp.close(); frames++;
+      }catch(err){} busy=false;
+      const dt=performance.now()-t0; if(dt>1000){info.textContent=`${(frames*1000/dt).toFixed(1)} fps`; frames=0; t0=performance.now();}
+    };
+  }
+  await pc.setLocalDescription(await pc.createOffer());
+  await new Promise(ok=>{if(pc.iceGatheringState==='complete') ok(); else pc.onicegatheringstatechange=()=>{if(pc.iceGatheringState==='complete') ok();};});
+  const r=await fetch('/offer?cam='+encodeURIComponent(cam)+'&h264='+(h264?1:0),{method:'POST',headers:{'Content-Type':'application/json'},
+    body:JSON.stringify({sdp:pc.localDescription.sdp,type:pc.localDescription.type})});
+  if(!r.ok){info.textContent=await r.text(); return;}
+  await pc.setRemoteDescription(await r.json());
+}
+document.getElementById('go').onclick=watch; cams();
+</script></body></html>'''
+
+
+class SharedDecoder:
+    """一路摄像头的 JPEG → 视频帧：只解码一次，该路所有 H.264 观看者共用"""
+
+    def __init__(self, slot: CameraSlot):
+        self.slot = slot
+        self.codec = av.CodecContext.create("mjpeg", "r")
+        self.frame = None
+        self.cond = asyncio.Condition()
+        self.users = 0
+        self.decoded = 0
+        self.task: Optional[asyncio.Task] = None
+        self._start = time.monotonic()
+
+    def _decode(self, jpeg: bytes):
+        frames = self.codec.decode(av.Packet(jpeg))
+        return frames[-1] if frames else None
+
+    async def _run(self) -> None:
+        loop = asyncio.get_running_loop()
+        slot = self.slot
+        done = None
+        while True:
+            async with slot.cond:
+                await slot.cond.wait_for(lambda: slot.jpeg is not None and slot.jpeg is not done)
+                jpeg = slot.jpeg
+            done = jpeg
+            try:
+                frame = await loop.run_in_executor(None, self._decode, jpeg)  # 解码期间到达的帧被跳过
+            except (av.error.FFmpegError, ValueError):
+                continue
+            if frame is None:
+                continue
+            frame.pts = int((time.monotonic() - self._start) * VIDEO_CLOCK)  # 各观看者共用同一时间戳
+            frame.time_base = fractions.Fraction(1, VIDEO_CLOCK)
+            self.decoded += 1
+            async with self.cond:
+                self.frame = frame
+                self.cond.notify_all()
+
+    def acquire(self) -> None:
+        self.users += 1
+        if self.task is None:
+            self.task = asyncio.ensure_future(self._run())
+
+    def release(self) -> None:
+        self.users -= 1
+        if self.users <= 0 and self.task is not None:
+            self.task.cancel()  # 没有观看者时不解码
+            self.task = None
+            self.frame = None
+
+
+class CameraVideoTrack(MediaStreamTrack):
+    """H.264 观看者的视频轨道：每次编码时取共用解码器的最新帧"""
+    kind = "video"
+
+    def __init__(self, decoder: SharedDecoder):
+        super().__init__()
+        self.decoder = decoder
+        self.last = None
+        decoder.acquire()
+
+    async def recv(self):
+        decoder = self.decoder
+        async with decoder.cond:
+            await decoder.cond.wait_for(lambda: decoder.frame is not None and decoder.frame is not self.last)
+            self.last = decoder.frame
+        return self.last
+
+    def stop(self) -> None:
+        if self.readyState != "ended":
+            self.decoder.release()
+        super().stop()
+
+
+class CameraAudioTrack(MediaStreamTrack):
+    """设备 PCM → 音频轨道（aiortc 重采样并编码为 Opus）"""
+    kind = "audio"
+
+    def __init__(self, slot: CameraSlot):
+        super().__init__()
+        self.slot = slot
+        self.queue: asyncio.Queue = asyncio.Queue(AUDIO_QUEUE)
+        self.pts = 0
+        slot.audio_subs.append(self.queue)
+
+    async def recv(self):
+        hdr, pcm = await self.queue.get()
+        channels = 2 if hdr.height == 2 else 1  # 固件只发送单声道或立体声
+        samples = len(pcm) // (2 * channels)
+        frame = av.AudioFrame(format="s16", layout="mono" if channels == 1 else "stereo", samples=samples)
+        frame.planes[0].update(pcm[:samples * 2 * channels])
+        frame.sample_rate = hdr.width
+        frame.time_base = fractions.Fraction(1, hdr.width)
+        frame.pts = self.pts
+        self.pts += samples
+        return frame
+
+    def stop(self) -> None:
+        if self.queue in self.slot.audio_subs:
+            self.slot.audio_subs.remove(self.queue)
+        super().stop()
+
+
+class RtpJpegProtocol(asyncio.DatagramProtocol):
+    """RTP/JPEG 接收：每个对端 IP 一个重组器，完整帧发布到同名槽位"""
+
+    def __init__(self, ingest: IngestServer):
+        self.ingest = ingest
+        self.streams: Dict[str, RtpJpegAssembler] = {}
+
+    def datagram_received(self, data: bytes, addr) -> None:
+        asm = self.streams.get(addr[0])
+        if asm is None:
+            asm = self.streams[addr[0]] = RtpJpegAssembler()
+            print(f"[INFO] 收到 {addr[0]} 的 RTP/JPEG 流")
+        frame = asm.feed(data)
+        if frame is not None:
+            slot = self.ingest.slot(addr[0])
+            asyncio.ensure_future(slot.publish(None, frame[1]))
+
+
+class Viewer:
+    """一个浏览器连接"""
+
+    def __init__(self, pc, slot: CameraSlot, h264: bool):
+        self.pc = pc
+        self.slot = slot
+        self.h264 = h264
+        self.frames = 0
+        self.skipped = 0  # 通道积压时跳过的帧
+        self.tracks: List[MediaStreamTrack] = []
+        self.task: Optional[asyncio.Task] = None
+
+    def to_dict(self) -> dict:
+        return {"camera": self.slot.id, "h264": self.h264, "state": self.pc.connectionState,
+                "frames": self.frames, "skipped": self.skipped}
+
+
+class WebRtcGateway:
+    def __init__(self, ingest: IngestServer, ice: List[str], ice_user: Optional[str], ice_pass: Optional[str],
+                 h264: bool, dc_buffer: int):
+        self.ingest = ingest
+        self.ice = [RTCIceServer(urls=url, username=ice_user if url.startswith("turn") else None,
+                                 credential=ice_pass if url.startswith("turn") else None) for url in ice]
+        self.h264 = h264
+        self.dc_buffer = dc_buffer
+        self.decoders: Dict[str, SharedDecoder] = {}
+        self.viewers: Set[Viewer] = set()
+        page_ice = [{"urls": s.urls, **({"username": s.username, "credential": s.credential} if s.username else {})}
+                    for s in self.ice]
+        self.index = INDEX_HTML.replace("%ICE%", json.dumps(page_ice)).replace("%H264%", "checked" if h264 else "").encode()
+
+    async def _send_jpeg(self, viewer: Viewer, channel) -> None:
+        """数据通道发送：每次取最新帧，通道积压（拥塞控制限速）时跳过，不排队"""
+        slot = viewer.slot
+        sent = None
+        seq = 0
+        while channel.readyState == "open":
+            async with slot.cond:
+                await slot.cond.wait_for(lambda: slot.jpeg is not None and slot.jpeg is not sent)
+                jpeg = slot.jpeg
+                hdr: Optional[FrameHeader] = slot.hdr
+            sent = jpeg
+            if channel.readyState != "open":
+                break
+            if channel.bufferedAmount > self.dc_buffer:
+                viewer.skipped += 1
+                continue
+            seq = hdr.seq if hdr is not None else seq + 1
+            first = DC_CHUNK - DC_FRAME_HEADER.size
+            channel.send(DC_FRAME_HEADER.pack(seq & 0xFFFFFFFF, len(jpeg), hdr.timestamp_us if hdr else 0) + jpeg[:first])
+            for off in range(first, len(jpeg), DC_CHUNK):
+                channel.send(jpeg[off:off + DC_CHUNK])
+            viewer.frames += 1
+
+    async def _close(self, viewer: Viewer) -> None:
+        if viewer not in self.viewers:
+            return
+        self.viewers.discard(viewer)
+        if viewer.task is not None:
+            viewer.task.cancel()
+        for track in viewer.tracks:
+            track.stop()
+        await viewer.pc.close()
+        print(f"[INFO] 观看者断开（{viewer.slot.id}），共 {len(self.viewers)} 个")
+
+    async def offer(self, cam_id: str, h264: bool, body: bytes) -> dict:
+        """处理浏览器的 offer，返回 answer"""
+        slot = self.ingest.cameras.get(cam_id)
+        if slot is None:
+            raise KeyError(cam_id)
+        params = json.loads(body)
+        pc = RTCPeerConnection(RTCConfiguration(iceServers=self.ice) if self.ice else None)
+        viewer = Viewer(pc, slot, h264)
+        self.viewers.add(viewer)
+
+        @pc.on("datachannel")
+        def on_datachannel(channel) -> None:
+            if channel.label == "jpeg" and viewer.task is None:
+                viewer.task = asyncio.ensure_future(self._send_jpeg(viewer, channel))
+
+        @pc.on("connectionstatechange")
+        async def on_state() -> None:
+            if pc.connectionState in ("failed", "closed"):
+                await self._close(viewer)
+
+        await pc.setRemoteDescription(RTCSessionDescription(sdp=params["sdp"], type=params["type"]))
+        for transceiver in pc.getTransceivers():
+            if transceiver.kind == "audio" and slot.audio_frames:
+                track = CameraAudioTrack(slot)
+                viewer.tracks.append(track)
+                pc.addTrack(track)
+            elif transceiver.kind == "video" and h264:
+                decoder = self.decoders.get(cam_id)
+                if decoder is None:
+                    decoder = self.decoders[cam_id] = SharedDecoder(slot)
+                track = CameraVideoTrack(decoder)
+                viewer.tracks.append(track)
+                pc.addTrack(track)
+                transceiver.setCodecPreferences([c for c in RTCRtpSender.getCapabilities("video").codecs
+                                                 if c.mimeType == "video/H264"])
+        await pc.setLocalDescription(await pc.createAnswer())  # aiortc 在此收集完全部候选地址
+        print(f"[INFO] 观看者接入 {cam_id}（{'H.264' if h264 else 'JPEG 数据通道'}），共 {len(self.viewers)} 个")
+        return {"sdp": pc.localDescription.sdp, "type": pc.localDescription.type}
+
+    def stats(self) -> dict:
+        return {"viewers": [v.to_dict() for v in self.viewers],
+                "decoders": {k: {"users": d.users, "decoded": d.decoded} for k, d in self.decoders.items()}}
+
+    # ---------------- 信令 HTTP ----------------
+
+    async def handle_http(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter) -> None:
+        try:
+            request = await asyncio.wait_for(reader.readuntil(b"\r\n\r\n"), 10.0)
+            lines = request.decode("latin-1").split("\r\n")
+            parts = lines[0].split()
+            if len(parts) < 2:
+                return
+            path, _, query = parts[1].partition("?")
+            path = path.rstrip("/") or "/"
+            if parts[0] == "GET" and path == "/":
+                await IngestServer._respond(writer, "200 OK", "text/html; charset=utf-8", self.index)
+            elif parts[0] == "GET" and path == "/cameras":
+                body = json.dumps({"cameras": sorted(c.id for c in self.ingest.cameras.values() if c.jpeg is not None)})
+                await IngestServer._respond(writer, "200 OK", "application/json", body.encode())
+            elif parts[0] == "GET" and path == "/viewers":
+                await IngestServer._respond(writer, "200 OK", "application/json", json.dumps(self.stats()).encode())
+            elif parts[0] == "POST" and path == "/offer":
+                length = 0
+                for line in lines[1:]:
+                    name, _, value = line.partition(":")
+                    if name.strip().lower() == "content-length":
+                        length = int(value)
+                if not 0 < length <= 64 * 1024:
+                    await IngestServer._respond(writer, "400 Bad Request", "text/plain", b"bad offer\n")
+                    return
+                body = await asyncio.wait_for(reader.readexactly(length), 10.0)
+                q = parse_qs(query)
+                try:
+                    answer = await self.offer(q.get("cam", [""])[0], q.get("h264", ["0"])[0] == "1", body)
+                except KeyError:
+                    await IngestServer._respond(writer, "404 Not Found", "text/plain", b"no such camera\n")
+                    return
+                await IngestServer._respond(writer, "200 OK", "application/json", json.dumps(answer).encode())
+            else:
+                await IngestServer._respond(writer, "404 Not Found", "text/plain", b"not found\n")
+        except (asyncio.IncompleteReadError, asyncio.LimitOverrunError, asyncio.TimeoutError,
+                ConnectionError, OSError, ValueError):
+            pass
+        finally:
+            writer.close()
+
+    async def close(self) -> None:
+        for viewer in list(self.viewers):
+            await self._close(viewer)
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description="ESP32 WiFi Camera WebRTC gateway")
+    parser.add_argument("--host", default="0.0.0.0", help="监听地址，默认 0.0.0.0")
+    parser.add_argument("--port", type=int, default=8000, help="设备 TCP 连接端口，默认 8000")
+    parser.add_argument("--rtp-port", type=int, default=RTP_JPEG_PORT, help=f"RTP/JPEG 接收端口，0 关闭，默认 {RTP_JPEG_PORT}")
+    parser.add_argument("--http-port", type=int, default=8080, help="接入服务的 HTTP 端口（/cameras、MJPEG 流），默认 8080")
+    parser.add_argument("--webrtc-port", type=int, default=8090, help="观看页面与信令的 HTTP 端口，默认 8090")
+    parser.add_argument("--idle-timeout", type=float, default=15.0, help="设备连接无数据多少秒后断开，默认 15")
+    parser.add_argument("--h264", action="store_true", help="页面默认选择 H.264 轨道（每路解码一次，按观看者编码）")
+    parser.add_argument("--dc-buffer", type=int, default=256 * 1024, metavar="BYTES",
+                        help="数据通道积压超过该字节数时跳过新帧，默认 262144")
+    parser.add_argument("--ice", action="append", default=[], metavar="URL",
+                        help="STUN/TURN 服务器，如 stun:stun.l.google.com:19302、turn:turn.example.com:3478，可重复")
+    parser.add_argument("--ice-user", help="TURN 用户名")
+    parser.add_argument("--ice-pass", help="TURN 密码")
+    parser.add_argument("--tls-cert", metavar="PEM", help="设备端口的 TLS 证书（固件 TLS_STREAM_EN），需同时指定 --tls-key")
+    parser.add_argument("--tls-key", metavar="PEM", help="TLS 证书的私钥")
+    return parser.parse_args()
+
+
+async def run(args: argparse.Namespace) -> None:
+    ingest = IngestServer(args.idle_timeout)
+    gateway = WebRtcGateway(ingest, args.ice, args.ice_user, args.ice_pass, args.h264, args.dc_buffer)
+    tls = tls_server_context(args.tls_cert, args.tls_key) if args.tls_cert else None
+    devices = await asyncio.start_server(ingest.handle_device, args.host, args.port, backlog=128, ssl=tls,
+                                         ssl_handshake_timeout=10.0 if tls else None)
+    http = await asyncio.start_server(ingest.handle_http, args.host, args.http_port)
+    signalling = await asyncio.start_server(gateway.handle_http, args.host, args.webrtc_port)
+    if args.rtp_port:
+        loop = asyncio.get_running_loop()
+        await loop.create_datagram_endpoint(lambda: RtpJpegProtocol(ingest), local_addr=(args.host, args.rtp_port))
+    print(f"[INFO] 设备端口 {args.host}:{args.port}，RTP {args.rtp_port or '关闭'}，"
+          f"观看页面 http://{args.host}:{args.webrtc_port}/")
+    try:
+        async with devices, http, signalling:
+            await asyncio.gather(devices.serve_forever(), http.serve_forever(), signalling.serve_forever())
+    finally:
+        await gateway.close()
+
+
+def main() -> int:
+    args = parse_args()
+    if av is None:
+        print("[ERROR] 需要 aiortc：pip install aiortc")
+        return 2
+    try:
+        asyncio.run(run(args))
+    except KeyboardInterrupt:
+        print("\n[INFO] 已中断")
+    except OSError as e:
+        print(f"[ERROR] 监听失败: {e}")
+        return 3
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())